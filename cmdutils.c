@@ -732,16 +732,13 @@ void uninit_parse_context(OptionParseContext *octx)
     uninit_opts();
 }
 
-int split_commandline(OptionParseContext *octx, int argc, char *argv[],
-                      const OptionDef *options,
-                      const OptionGroupDef *groups, int nb_groups)
+int split_arglist(OptionParseContext *octx, int argc, char *argv[],
+                  const OptionDef *options,
+                  const OptionGroupDef *groups, int nb_groups)
 {
     int optindex = 1;
     int dashdash = -2;
 
-    /* perform system-dependent conversions for arguments list */
-    prepare_app_arguments(&argc, &argv);
-
     init_parse_context(octx, groups, nb_groups);
     av_log(NULL, AV_LOG_DEBUG, "Splitting the commandline.\n");
 
@@ -838,6 +835,16 @@ do {                                                                           \
     return 0;
 }
 
+int split_commandline(OptionParseContext *octx, int argc, char *argv[],
+                      const OptionDef *options,
+                      const OptionGroupDef *groups, int nb_groups)
+{
+    /* perform system-dependent conversions for arguments list */
+    prepare_app_arguments(&argc, &argv);
+
+    return split_arglist(octx, argc, argv, options, groups, nb_groups);
+}
+
 int opt_cpuflags(void *optctx, const char *opt, const char *arg)
 {
     int ret;
@@ -331,6 +331,15 @@ int split_commandline(OptionParseContext *octx, int argc, char *argv[],
                       const OptionDef *options,
                       const OptionGroupDef *groups, int nb_groups);
 
+/**
+ * Split an argument list which is not the commandline of the program, e.g.
+ * built from a command received at runtime, like split_commandline().
+ * argv[0] is skipped and argv[argc] must be NULL.
+ */
+int split_arglist(OptionParseContext *octx, int argc, char *argv[],
+                  const OptionDef *options,
+                  const OptionGroupDef *groups, int nb_groups);
+
 /**
  * Free all allocated memory in an OptionParseContext.
  */
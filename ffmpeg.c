@@ -122,6 +122,7 @@ const char *const forced_keyframes_const_names[] = {
 
 static void do_video_stats(OutputStream *ost, int frame_size);
 static int64_t getutime(void);
+static int64_t getstime(void);
 static int64_t getmaxrss(void);
 
 static int run_as_daemon  = 0;
@@ -134,6 +135,8 @@ AVIOContext *progress_avio = NULL;
 
 static uint8_t *subtitle_out;
 
+static AVExecutor *shared_executor;
+
 InputStream **input_streams = NULL;
 int        nb_input_streams = 0;
 InputFile   **input_files   = NULL;
@@ -156,6 +159,8 @@ static int restore_tty;
 
 #if HAVE_PTHREADS
 static void free_input_threads(void);
+static void free_encoder_threads(void);
+static void free_mux_threads(void);
 #endif
 
 /* sub2video hack:
@@ -465,9 +470,15 @@ static void ffmpeg_cleanup(int ret)
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%ikB\n", maxrss);
     }
 
+#if HAVE_PTHREADS
+    free_encoder_threads();
+    free_mux_threads();
+#endif
+
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
         avfilter_graph_free(&fg->graph);
+        av_freep(&fg->filter_stats);
         for (j = 0; j < fg->nb_inputs; j++) {
             av_freep(&fg->inputs[j]->name);
             av_freep(&fg->inputs[j]);
@@ -529,6 +540,7 @@ static void ffmpeg_cleanup(int ret)
 
         av_dict_free(&ost->sws_dict);
 
+        chunk_encoder_free(ost);
         avcodec_free_context(&ost->enc_ctx);
 
         av_freep(&output_streams[i]);
@@ -550,6 +562,7 @@ static void ffmpeg_cleanup(int ret)
         av_frame_free(&ist->sub2video.frame);
         av_freep(&ist->filters);
         av_freep(&ist->hwaccel_device);
+        av_freep(&ist->dts_buffer);
 
         avcodec_free_context(&ist->dec_ctx);
 
@@ -563,6 +576,8 @@ static void ffmpeg_cleanup(int ret)
                    av_err2str(AVERROR(errno)));
     }
     av_freep(&vstats_filename);
+    bench_report_uninit();
+    av_executor_free(&shared_executor);
 
     av_freep(&input_streams);
     av_freep(&input_files);
@@ -632,10 +647,276 @@ static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream,
     }
 }
 
+/*
+ * -pace: hold a packet back until the wall clock reaches its DTS, measured
+ * from the first packet of the file, less the burst allowance.  Timestamp
+ * jumps and stalls longer than -dts_delta_threshold restart the clock
+ * instead of being waited out or caught up with a burst.
+ */
+static void pace_packet(OutputFile *of, AVRational time_base, const AVPacket *pkt)
+{
+    int64_t ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+    int64_t threshold = (int64_t)(dts_delta_threshold * AV_TIME_BASE);
+    int64_t now, due;
+
+    if (ts == AV_NOPTS_VALUE)
+        return;
+    ts  = av_rescale_q(ts, time_base, AV_TIME_BASE_Q);
+    now = av_gettime_relative();
+
+    if (of->pace_start == AV_NOPTS_VALUE) {
+        of->pace_start = now;
+        of->pace_dts   = ts;
+        return;
+    }
+
+    due = of->pace_start + ts - of->pace_dts - of->pace_burst;
+    if (due - now > threshold || now - due > threshold + of->pace_burst) {
+        av_log(NULL, AV_LOG_VERBOSE, "Pacing of output file %s restarted\n",
+               of->ctx->filename);
+        of->pace_start = now;
+        of->pace_dts   = ts;
+        return;
+    }
+    if (due > now)
+        av_usleep(due - now);
+}
+
+#if HAVE_PTHREADS
+#define MUX_THREAD_QUEUE_SIZE 8
+
+static void mux_batch_free(MuxBatch **batch)
+{
+    int i;
+
+    if (!*batch)
+        return;
+    for (i = 0; i < (*batch)->nb_packets; i++)
+        av_packet_unref(&(*batch)->packets[i]);
+    av_freep(batch);
+}
+
+static void mux_queue_free(void *msg)
+{
+    mux_batch_free(msg);
+}
+
+/*
+ * Muxing worker, with -mux_threads: writes the packet batches of one output
+ * file, which the main thread has already checked and timestamped. A muxing
+ * error is returned to the main thread by the next send to the queue.
+ */
+static void *mux_thread(void *arg)
+{
+    OutputFile *of = arg;
+    MuxBatch *batch;
+    int i, ret;
+
+    while ((ret = av_thread_message_queue_recv(of->mux_queue, &batch, 0)) >= 0) {
+        for (i = 0; i < batch->nb_packets && ret >= 0; i++) {
+            AVPacket *pkt = &batch->packets[i];
+            StageTimer timer;
+
+            if (of->pace)
+                pace_packet(of, of->ctx->streams[pkt->stream_index]->time_base, pkt);
+            stage_timer_start(&timer);
+            ret = av_interleaved_write_frame(of->ctx, pkt);
+            stage_timer_stop(&of->mux_stats, &timer);
+        }
+        mux_batch_free(&batch);
+
+        pthread_mutex_lock(&of->mux_pos_lock);
+        of->mux_pos = of->ctx->pb ? avio_tell(of->ctx->pb) : 0;
+        pthread_mutex_unlock(&of->mux_pos_lock);
+        if (ret < 0)
+            break;
+    }
+
+    of->mux_thread_ret = ret;
+    av_thread_message_queue_set_err_send(of->mux_queue, ret);
+
+    return NULL;
+}
+
+static void report_mux_error(OutputFile *of, int ret)
+{
+    print_error("av_interleaved_write_frame()", ret);
+    main_return_code = 1;
+    close_all_output_streams(output_streams[of->ost_index],
+                             MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
+}
+
+static void send_mux_batch(OutputFile *of)
+{
+    int ret;
+
+    if (!of->mux_batch)
+        return;
+
+    ret = av_thread_message_queue_send(of->mux_queue, &of->mux_batch, 0);
+    if (ret < 0) {
+        mux_batch_free(&of->mux_batch);
+        if (ret != AVERROR_EOF) {
+            report_mux_error(of, ret);
+            /* drop what is still sent, without reporting again; the
+             * thread has stopped, so mux_thread_ret can be reset */
+            av_thread_message_queue_set_err_send(of->mux_queue, AVERROR_EOF);
+            of->mux_thread_ret = AVERROR_EOF;
+        }
+    }
+    of->mux_batch = NULL;
+}
+
+static void send_mux_batches(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_files; i++)
+        if (output_files[i]->mux_thread_running)
+            send_mux_batch(output_files[i]);
+}
+
+/* take ownership of pkt, reference counting it if needed */
+static void queue_mux_packet(OutputFile *of, AVPacket *pkt)
+{
+    MuxBatch *batch = of->mux_batch;
+
+    if (!batch && !(batch = of->mux_batch = av_mallocz(sizeof(*batch)))) {
+        av_log(NULL, AV_LOG_FATAL, "Could not allocate a packet batch\n");
+        exit_program(1);
+    }
+
+    if (pkt->buf) {
+        av_packet_move_ref(&batch->packets[batch->nb_packets], pkt);
+    } else {
+        int ret = av_packet_ref(&batch->packets[batch->nb_packets], pkt);
+        av_packet_unref(pkt);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Could not reference a packet: %s\n",
+                   av_err2str(ret));
+            exit_program(1);
+        }
+    }
+
+    if (++batch->nb_packets == MUX_BATCH_SIZE)
+        send_mux_batch(of);
+}
+
+static int init_mux_thread(OutputFile *of)
+{
+    int ret;
+
+    if (!mux_threads)
+        return 0;
+
+#if FF_API_LAVF_FMT_RAWPICTURE
+    /* the packets point to AVPictures on the stack */
+    if (of->ctx->oformat->flags & AVFMT_RAWPICTURE)
+        return 0;
+#endif
+
+    ret = av_thread_message_queue_alloc(&of->mux_queue, MUX_THREAD_QUEUE_SIZE,
+                                        sizeof(MuxBatch *));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(of->mux_queue, mux_queue_free);
+
+    if ((ret = pthread_mutex_init(&of->mux_pos_lock, NULL))) {
+        av_thread_message_queue_free(&of->mux_queue);
+        return AVERROR(ret);
+    }
+    of->mux_pos = of->ctx->pb ? avio_tell(of->ctx->pb) : 0;
+
+    if ((ret = pthread_create(&of->mux_thread, NULL, mux_thread, of))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        pthread_mutex_destroy(&of->mux_pos_lock);
+        av_thread_message_queue_free(&of->mux_queue);
+        return AVERROR(ret);
+    }
+    of->mux_thread_running = 1;
+    return 0;
+}
+
+static int init_mux_threads(void)
+{
+    int i, ret;
+
+    for (i = 0; i < nb_output_files; i++)
+        if ((ret = init_mux_thread(output_files[i])) < 0)
+            return ret;
+    return 0;
+}
+
+/* let the muxing thread of a file write the queued packets and join it */
+static void stop_mux_thread(OutputFile *of)
+{
+    if (!of->mux_thread_running)
+        return;
+
+    send_mux_batch(of);
+    av_thread_message_queue_set_err_recv(of->mux_queue, AVERROR_EOF);
+    pthread_join(of->mux_thread, NULL);
+    of->mux_thread_running = 0;
+    pthread_mutex_destroy(&of->mux_pos_lock);
+    av_thread_message_queue_free(&of->mux_queue);
+
+    /* an error not reported by send_mux_batch() yet */
+    if (of->mux_thread_ret < 0 && of->mux_thread_ret != AVERROR_EOF)
+        report_mux_error(of, of->mux_thread_ret);
+}
+
+static void stop_mux_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_files; i++)
+        stop_mux_thread(output_files[i]);
+}
+
+static void free_mux_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+
+        if (!of || !of->mux_thread_running)
+            continue;
+
+        av_thread_message_queue_set_err_send(of->mux_queue, AVERROR_EOF);
+        av_thread_message_queue_set_err_recv(of->mux_queue, AVERROR_EOF);
+        av_thread_message_flush(of->mux_queue);
+
+        pthread_join(of->mux_thread, NULL);
+        of->mux_thread_running = 0;
+        pthread_mutex_destroy(&of->mux_pos_lock);
+        av_thread_message_queue_free(&of->mux_queue);
+        mux_batch_free(&of->mux_batch);
+    }
+}
+#endif
+
+/* position in the output file, which a muxing thread may be writing */
+static int64_t output_file_pos(OutputFile *of)
+{
+#if HAVE_PTHREADS
+    if (of->mux_thread_running) {
+        int64_t pos;
+        pthread_mutex_lock(&of->mux_pos_lock);
+        pos = of->mux_pos;
+        pthread_mutex_unlock(&of->mux_pos_lock);
+        return pos;
+    }
+#endif
+    return of->ctx->pb ? avio_tell(of->ctx->pb) : 0;
+}
+
 static void write_frame(AVFormatContext *s, AVPacket *pkt, OutputStream *ost)
 {
+    OutputFile *of = output_files[ost->file_index];
     AVBitStreamFilterContext *bsfc = ost->bitstream_filters;
     AVCodecContext          *avctx = ost->encoding_needed ? ost->enc_ctx : ost->st->codec;
+    StageTimer timer;
     int ret;
 
     if (!ost->st->codec->extradata_size && ost->enc_ctx->extradata_size) {
@@ -750,7 +1031,19 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, OutputStream *ost)
               );
     }
 
+#if HAVE_PTHREADS
+    if (of->mux_thread_running) {
+        queue_mux_packet(of, pkt);
+        return;
+    }
+#endif
+
+    if (of->pace)
+        pace_packet(of, ost->st->time_base, pkt);
+
+    stage_timer_start(&timer);
     ret = av_interleaved_write_frame(s, pkt);
+    stage_timer_stop(&of->mux_stats, &timer);
     if (ret < 0) {
         print_error("av_interleaved_write_frame()", ret);
         main_return_code = 1;
@@ -783,17 +1076,333 @@ static int check_recording_time(OutputStream *ost)
     return 1;
 }
 
-static void do_audio_out(AVFormatContext *s, OutputStream *ost,
-                         AVFrame *frame)
+static int output_encoded_packet(OutputStream *ost, AVPacket *pkt)
+{
+    AVFormatContext *s = output_files[ost->file_index]->ctx;
+    int pkt_size = pkt->size;
+
+    if (ost->finished & MUXER_FINISHED) {
+        av_packet_unref(pkt);
+        return 0;
+    }
+    write_frame(s, pkt, ost);
+    if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename && pkt_size)
+        do_video_stats(ost, pkt_size);
+    return 0;
+}
+
+static int output_new_packet(OutputStream *ost, const AVFrame *frame, AVPacket *pkt,
+                             int (*output)(OutputStream *ost, AVPacket *pkt))
+{
+    AVCodecContext *enc = ost->enc_ctx;
+
+    /* if two pass, output log */
+    if (ost->logfile && enc->stats_out)
+        fprintf(ost->logfile, "%s", enc->stats_out);
+
+    if (debug_ts) {
+        av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
+               "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+               av_get_media_type_string(enc->codec_type),
+               av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
+               av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base));
+    }
+
+    if (frame && enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+        pkt->pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+        pkt->pts = frame->pts;
+
+    av_packet_rescale_ts(pkt, enc->time_base, ost->st->time_base);
+
+    return output(ost, pkt);
+}
+
+/*
+ * Encode frame, or drain the encoder of ost if frame is NULL, and pass every
+ * resulting packet, in the stream time base, to output. The encoder may
+ * return any number of packets for a frame, as they become available.
+ */
+static int encode_frame(OutputStream *ost, const AVFrame *frame,
+                        int (*output)(OutputStream *ost, AVPacket *pkt))
 {
     AVCodecContext *enc = ost->enc_ctx;
+    StageTimer timer;
     AVPacket pkt;
-    int got_packet = 0;
+    int ret;
 
     av_init_packet(&pkt);
     pkt.data = NULL;
     pkt.size = 0;
 
+    if (ost->chunk_enc) {
+        int got_packet;
+
+        do {
+            stage_timer_start(&timer);
+            ret = chunk_encode_video(ost, &pkt, frame, &got_packet);
+            stage_timer_stop(&ost->enc_stats, &timer);
+            if (ret < 0)
+                return ret;
+            if (got_packet && (ret = output_new_packet(ost, frame, &pkt, output)) < 0)
+                return ret;
+        } while (!frame && got_packet);
+        return 0;
+    }
+
+    stage_timer_start(&timer);
+    ret = avcodec_send_frame(enc, frame);
+    stage_timer_stop(&ost->enc_stats, &timer);
+    if (ret < 0)
+        return ret;
+
+    for (;;) {
+        stage_timer_start(&timer);
+        ret = avcodec_receive_packet(enc, &pkt);
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        if (ret == AVERROR_EOF) {
+            /* some encoders only write their final pass 1 stats at the end */
+            if (ost->logfile && enc->stats_out)
+                fprintf(ost->logfile, "%s", enc->stats_out);
+            return 0;
+        }
+        stage_timer_stop(&ost->enc_stats, &timer);
+        if (ret < 0)
+            return ret;
+        if ((ret = output_new_packet(ost, frame, &pkt, output)) < 0)
+            return ret;
+    }
+}
+
+#if HAVE_PTHREADS
+#define ENC_THREAD_QUEUE_SIZE 8
+
+static void enc_frame_queue_free(void *msg)
+{
+    av_frame_free(msg);
+}
+
+static void enc_pkt_queue_free(void *msg)
+{
+    av_packet_unref(msg);
+}
+
+static int queue_encoded_packet(OutputStream *ost, AVPacket *pkt)
+{
+    int ret = av_thread_message_queue_send(ost->enc_pkt_queue, pkt, 0);
+
+    /* on success, the queue owns the packet data now */
+    if (ret < 0)
+        av_packet_unref(pkt);
+    av_init_packet(pkt);
+    pkt->data = NULL;
+    pkt->size = 0;
+    return ret;
+}
+
+/*
+ * Encoder worker: takes frames from enc_frame_queue, encodes them and hands
+ * the resulting packets, already in the stream time base, back to the main
+ * thread, which does all the muxing. The queue errors are used to propagate
+ * EOF and encoding failures in both directions.
+ */
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    AVFrame *frame;
+    int ret;
+
+    while ((ret = av_thread_message_queue_recv(ost->enc_frame_queue, &frame, 0)) >= 0) {
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO && !ost->frame_aspect_ratio.num)
+            enc->sample_aspect_ratio = frame->sample_aspect_ratio;
+        ret = encode_frame(ost, frame, queue_encoded_packet);
+        av_frame_free(&frame);
+        if (ret < 0)
+            break;
+    }
+
+    av_thread_message_queue_set_err_send(ost->enc_frame_queue, ret);
+    av_thread_message_queue_set_err_recv(ost->enc_pkt_queue, ret);
+
+    return NULL;
+}
+
+static void check_encoder_thread_error(OutputStream *ost, int ret)
+{
+    if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+        av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+               av_get_media_type_string(ost->enc_ctx->codec_type),
+               av_err2str(ret));
+        exit_program(1);
+    }
+}
+
+/*
+ * Mux every packet the encoder thread of ost has produced so far, without
+ * blocking. Returns the number of packets taken from the queue.
+ */
+static int reap_encoded_packets(OutputStream *ost)
+{
+    AVPacket pkt;
+    int ret, nb_packets = 0;
+
+    while ((ret = av_thread_message_queue_recv(ost->enc_pkt_queue, &pkt,
+                                               AV_THREAD_MESSAGE_NONBLOCK)) >= 0) {
+        output_encoded_packet(ost, &pkt);
+        nb_packets++;
+    }
+    check_encoder_thread_error(ost, ret);
+
+    return nb_packets;
+}
+
+static void reap_encoder_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_streams; i++)
+        if (output_streams[i]->enc_thread_running)
+            reap_encoded_packets(output_streams[i]);
+}
+
+static void send_frame_to_encoder_thread(OutputStream *ost, AVFrame *frame)
+{
+    AVFrame *clone = av_frame_clone(frame);
+    int ret;
+
+    if (!clone) {
+        av_log(NULL, AV_LOG_FATAL, "Could not allocate frame for the encoder thread\n");
+        exit_program(1);
+    }
+
+    stage_stats_add_queue_depth(&ost->enc_stats,
+                                av_thread_message_queue_nb_elems(ost->enc_frame_queue));
+
+    /* The encoder thread may be blocked on a full packet queue, so keep
+     * muxing its output while waiting for room in the frame queue. */
+    while ((ret = av_thread_message_queue_send(ost->enc_frame_queue, &clone,
+                                               AV_THREAD_MESSAGE_NONBLOCK)) == AVERROR(EAGAIN)) {
+        if (!reap_encoded_packets(ost))
+            av_usleep(1000);
+    }
+    if (ret < 0) {
+        av_frame_free(&clone);
+        while (reap_encoded_packets(ost))
+            ;
+        check_encoder_thread_error(ost, ret);
+    }
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+    int ret;
+
+    if (!parallel_encode || !ost->encoding_needed ||
+        (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO))
+        return 0;
+#if FF_API_LAVF_FMT_RAWPICTURE
+    if (enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+        (output_files[ost->file_index]->ctx->oformat->flags & AVFMT_RAWPICTURE) &&
+        enc->codec->id == AV_CODEC_ID_RAWVIDEO)
+        return 0;
+#endif
+
+    ret = av_thread_message_queue_alloc(&ost->enc_frame_queue,
+                                        ENC_THREAD_QUEUE_SIZE, sizeof(AVFrame *));
+    if (ret < 0)
+        return ret;
+    ret = av_thread_message_queue_alloc(&ost->enc_pkt_queue,
+                                        ENC_THREAD_QUEUE_SIZE, sizeof(AVPacket));
+    if (ret < 0) {
+        av_thread_message_queue_free(&ost->enc_frame_queue);
+        return ret;
+    }
+    av_thread_message_queue_set_free_func(ost->enc_frame_queue, enc_frame_queue_free);
+    av_thread_message_queue_set_free_func(ost->enc_pkt_queue, enc_pkt_queue_free);
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        av_thread_message_queue_free(&ost->enc_pkt_queue);
+        av_thread_message_queue_free(&ost->enc_frame_queue);
+        return AVERROR(ret);
+    }
+    ost->enc_thread_running = 1;
+    return 0;
+}
+
+static int init_encoder_threads(void)
+{
+    int i, ret;
+
+    for (i = 0; i < nb_output_streams; i++)
+        if ((ret = init_encoder_thread(output_streams[i])) < 0)
+            return ret;
+    return 0;
+}
+
+/*
+ * Let the encoder thread of ost consume its queued frames, mux the remaining
+ * packets and join it. The encoder is left open so that it can be flushed
+ * from the main thread.
+ */
+static void stop_encoder_thread(OutputStream *ost)
+{
+    AVPacket pkt;
+    int ret;
+
+    if (!ost->enc_thread_running)
+        return;
+
+    av_thread_message_queue_set_err_recv(ost->enc_frame_queue, AVERROR_EOF);
+    while ((ret = av_thread_message_queue_recv(ost->enc_pkt_queue, &pkt, 0)) >= 0)
+        output_encoded_packet(ost, &pkt);
+
+    pthread_join(ost->enc_thread, NULL);
+    ost->enc_thread_running = 0;
+    av_thread_message_queue_free(&ost->enc_frame_queue);
+    av_thread_message_queue_free(&ost->enc_pkt_queue);
+    check_encoder_thread_error(ost, ret);
+}
+
+static void stop_encoder_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_streams; i++)
+        stop_encoder_thread(output_streams[i]);
+}
+
+static void free_encoder_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (!ost || !ost->enc_thread_running)
+            continue;
+
+        av_thread_message_queue_set_err_send(ost->enc_pkt_queue, AVERROR_EOF);
+        av_thread_message_queue_set_err_recv(ost->enc_frame_queue, AVERROR_EOF);
+        av_thread_message_flush(ost->enc_frame_queue);
+        av_thread_message_flush(ost->enc_pkt_queue);
+
+        pthread_join(ost->enc_thread, NULL);
+        ost->enc_thread_running = 0;
+        av_thread_message_queue_free(&ost->enc_frame_queue);
+        av_thread_message_queue_free(&ost->enc_pkt_queue);
+    }
+}
+#endif
+
+static void do_audio_out(AVFormatContext *s, OutputStream *ost,
+                         AVFrame *frame)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+    int ret;
+
     if (!check_recording_time(ost))
         return;
 
@@ -803,7 +1412,6 @@ static void do_audio_out(AVFormatContext *s, OutputStream *ost,
     ost->samples_encoded += frame->nb_samples;
     ost->frames_encoded++;
 
-    av_assert0(pkt.size || !pkt.data);
     update_benchmark(NULL);
     if (debug_ts) {
         av_log(NULL, AV_LOG_INFO, "encoder <- type:audio "
@@ -812,24 +1420,19 @@ static void do_audio_out(AVFormatContext *s, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
-    if (avcodec_encode_audio2(enc, &pkt, frame, &got_packet) < 0) {
-        av_log(NULL, AV_LOG_FATAL, "Audio encoding failed (avcodec_encode_audio2)\n");
-        exit_program(1);
+#if HAVE_PTHREADS
+    if (ost->enc_thread_running) {
+        send_frame_to_encoder_thread(ost, frame);
+        return;
     }
-    update_benchmark("encode_audio %d.%d", ost->file_index, ost->index);
-
-    if (got_packet) {
-        av_packet_rescale_ts(&pkt, enc->time_base, ost->st->time_base);
-
-        if (debug_ts) {
-            av_log(NULL, AV_LOG_INFO, "encoder -> type:audio "
-                   "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                   av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->st->time_base),
-                   av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->st->time_base));
-        }
+#endif
 
-        write_frame(s, &pkt, ost);
+    ret = encode_frame(ost, frame, output_encoded_packet);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Audio encoding failed: %s\n", av_err2str(ret));
+        exit_program(1);
     }
+    update_benchmark("encode_audio %d.%d", ost->file_index, ost->index);
 }
 
 static void do_subtitle_out(AVFormatContext *s,
@@ -841,6 +1444,7 @@ static void do_subtitle_out(AVFormatContext *s,
     int subtitle_out_size, nb, i;
     AVCodecContext *enc;
     AVPacket pkt;
+    StageTimer timer;
     int64_t pts;
 
     if (sub->pts == AV_NOPTS_VALUE) {
@@ -889,8 +1493,10 @@ static void do_subtitle_out(AVFormatContext *s,
 
         ost->frames_encoded++;
 
+        stage_timer_start(&timer);
         subtitle_out_size = avcodec_encode_subtitle(enc, subtitle_out,
                                                     subtitle_out_max_size, sub);
+        stage_timer_stop(&ost->enc_stats, &timer);
         if (i == 1)
             sub->num_rects = save_num_rects;
         if (subtitle_out_size < 0) {
@@ -928,7 +1534,6 @@ static void do_video_out(AVFormatContext *s,
     int nb_frames, nb0_frames, i;
     double delta, delta0;
     double duration = 0;
-    int frame_size = 0;
     InputStream *ist = NULL;
     AVFilterContext *filter = ost->filter->filter;
 
@@ -1097,7 +1702,7 @@ static void do_video_out(AVFormatContext *s,
     } else
 #endif
     {
-        int got_packet, forced_keyframe = 0;
+        int forced_keyframe = 0;
         double pts_time;
 
         if (enc->flags & (AV_CODEC_FLAG_INTERLACED_DCT | AV_CODEC_FLAG_INTERLACED_ME) &&
@@ -1164,41 +1769,18 @@ static void do_video_out(AVFormatContext *s,
 
         ost->frames_encoded++;
 
-        ret = avcodec_encode_video2(enc, &pkt, in_picture, &got_packet);
+#if HAVE_PTHREADS
+        if (ost->enc_thread_running) {
+            send_frame_to_encoder_thread(ost, in_picture);
+            ret = 0;
+        } else
+#endif
+        ret = encode_frame(ost, in_picture, output_encoded_packet);
         update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
         if (ret < 0) {
             av_log(NULL, AV_LOG_FATAL, "Video encoding failed\n");
             exit_program(1);
         }
-
-        if (got_packet) {
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                       av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
-                       av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
-            }
-
-            if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
-                pkt.pts = ost->sync_opts;
-
-            av_packet_rescale_ts(&pkt, enc->time_base, ost->st->time_base);
-
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                    "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                    av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->st->time_base),
-                    av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->st->time_base));
-            }
-
-            frame_size = pkt.size;
-            write_frame(s, &pkt, ost);
-
-            /* if two pass, output log */
-            if (ost->logfile && enc->stats_out) {
-                fprintf(ost->logfile, "%s", enc->stats_out);
-            }
-        }
     }
     ost->sync_opts++;
     /*
@@ -1207,9 +1789,6 @@ static void do_video_out(AVFormatContext *s,
      * flush, we need to limit them here, before they go into encoder.
      */
     ost->frame_number++;
-
-    if (vstats_filename && frame_size)
-        do_video_stats(ost, frame_size);
   }
 
     if (!ost->last_frame)
@@ -1296,7 +1875,8 @@ static int reap_filters(int flush)
         AVCodecContext *enc = ost->enc_ctx;
         int ret = 0;
 
-        if (!ost->filter)
+        /* the filter of a removed output may be freed */
+        if (!ost->filter || !ost->filter->filter)
             continue;
         filter = ost->filter->filter;
 
@@ -1345,6 +1925,10 @@ static int reap_filters(int flush)
 
             switch (filter->inputs[0]->type) {
             case AVMEDIA_TYPE_VIDEO:
+#if HAVE_PTHREADS
+                /* done by the encoder thread, if there is one */
+                if (!ost->enc_thread_running)
+#endif
                 if (!ost->frame_aspect_ratio.num)
                     enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
 
@@ -1375,6 +1959,10 @@ static int reap_filters(int flush)
         }
     }
 
+#if HAVE_PTHREADS
+    reap_encoder_threads();
+#endif
+
     return 0;
 }
 
@@ -1531,9 +2119,17 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 
     oc = output_files[0]->ctx;
 
-    total_size = avio_size(oc->pb);
-    if (total_size <= 0) // FIXME improve avio_size() so it works with non seekable output too
-        total_size = avio_tell(oc->pb);
+#if HAVE_PTHREADS
+    /* avio_size() is not safe while the muxing thread writes */
+    if (output_files[0]->mux_thread_running)
+        total_size = output_file_pos(output_files[0]);
+    else
+#endif
+    {
+        total_size = avio_size(oc->pb);
+        if (total_size <= 0) // FIXME improve avio_size() so it works with non seekable output too
+            total_size = avio_tell(oc->pb);
+    }
 
     buf[0] = '\0';
     vid = 0;
@@ -1687,83 +2283,50 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         print_final_stats(total_size);
 }
 
-static void flush_encoders(void)
+static void flush_encoder(OutputStream *ost)
 {
-    int i, ret;
-
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream   *ost = output_streams[i];
-        AVCodecContext *enc = ost->enc_ctx;
-        AVFormatContext *os = output_files[ost->file_index]->ctx;
-        int stop_encoding = 0;
+    AVCodecContext *enc = ost->enc_ctx;
+    AVFormatContext *os = output_files[ost->file_index]->ctx;
+    int ret;
 
-        if (!ost->encoding_needed)
-            continue;
+    /* the encoders of removed outputs are closed */
+    if (!ost->encoding_needed || !avcodec_is_open(enc))
+        return;
 
-        if (enc->codec_type == AVMEDIA_TYPE_AUDIO && enc->frame_size <= 1)
-            continue;
+    if (enc->codec_type == AVMEDIA_TYPE_AUDIO && enc->frame_size <= 1)
+        return;
 #if FF_API_LAVF_FMT_RAWPICTURE
-        if (enc->codec_type == AVMEDIA_TYPE_VIDEO && (os->oformat->flags & AVFMT_RAWPICTURE) && enc->codec->id == AV_CODEC_ID_RAWVIDEO)
-            continue;
+    if (enc->codec_type == AVMEDIA_TYPE_VIDEO && (os->oformat->flags & AVFMT_RAWPICTURE) && enc->codec->id == AV_CODEC_ID_RAWVIDEO)
+        return;
 #endif
 
-        for (;;) {
-            int (*encode)(AVCodecContext*, AVPacket*, const AVFrame*, int*) = NULL;
-            const char *desc;
+    if (enc->codec_type != AVMEDIA_TYPE_AUDIO &&
+        enc->codec_type != AVMEDIA_TYPE_VIDEO)
+        return;
 
-            switch (enc->codec_type) {
-            case AVMEDIA_TYPE_AUDIO:
-                encode = avcodec_encode_audio2;
-                desc   = "audio";
-                break;
-            case AVMEDIA_TYPE_VIDEO:
-                encode = avcodec_encode_video2;
-                desc   = "video";
-                break;
-            default:
-                stop_encoding = 1;
-            }
+    update_benchmark(NULL);
+    ret = encode_frame(ost, NULL, output_encoded_packet);
+    update_benchmark("flush_%s %d.%d",
+                     av_get_media_type_string(enc->codec_type),
+                     ost->file_index, ost->index);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+               av_get_media_type_string(enc->codec_type),
+               av_err2str(ret));
+        exit_program(1);
+    }
+}
 
-            if (encode) {
-                AVPacket pkt;
-                int pkt_size;
-                int got_packet;
-                av_init_packet(&pkt);
-                pkt.data = NULL;
-                pkt.size = 0;
-
-                update_benchmark(NULL);
-                ret = encode(enc, &pkt, NULL, &got_packet);
-                update_benchmark("flush_%s %d.%d", desc, ost->file_index, ost->index);
-                if (ret < 0) {
-                    av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
-                           desc,
-                           av_err2str(ret));
-                    exit_program(1);
-                }
-                if (ost->logfile && enc->stats_out) {
-                    fprintf(ost->logfile, "%s", enc->stats_out);
-                }
-                if (!got_packet) {
-                    stop_encoding = 1;
-                    break;
-                }
-                if (ost->finished & MUXER_FINISHED) {
-                    av_packet_unref(&pkt);
-                    continue;
-                }
-                av_packet_rescale_ts(&pkt, enc->time_base, ost->st->time_base);
-                pkt_size = pkt.size;
-                write_frame(os, &pkt, ost);
-                if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename) {
-                    do_video_stats(ost, pkt_size);
-                }
-            }
+static void flush_encoders(void)
+{
+    int i;
 
-            if (stop_encoding)
-                break;
-        }
-    }
+#if HAVE_PTHREADS
+    stop_encoder_threads();
+#endif
+
+    for (i = 0; i < nb_output_streams; i++)
+        flush_encoder(output_streams[i]);
 }
 
 /*
@@ -1877,6 +2440,12 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
         opkt.data = pkt->data;
         opkt.size = pkt->size;
     }
+    /* reference the input data, rather than have the muxer copy it */
+    if (!opkt.buf && pkt->buf && opkt.data == pkt->data) {
+        opkt.buf = av_buffer_ref(pkt->buf);
+        if (!opkt.buf)
+            exit_program(1);
+    }
     av_copy_packet_side_data(&opkt, pkt);
 
 #if FF_API_LAVF_FMT_RAWPICTURE
@@ -1890,6 +2459,7 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
                    av_err2str(ret));
             exit_program(1);
         }
+        av_buffer_unref(&opkt.buf);
         opkt.data = (uint8_t *)&pict;
         opkt.size = sizeof(AVPicture);
         opkt.flags |= AV_PKT_FLAG_KEY;
@@ -1899,6 +2469,22 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
     write_frame(of->ctx, &opkt, ost);
 }
 
+int use_shared_executor(AVExecutor **executor)
+{
+    int ret;
+
+    if (shared_threads < 0)
+        return 0;
+    if (!shared_executor &&
+        (ret = av_executor_alloc(&shared_executor, shared_threads)) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Error creating the shared threads: %s\n",
+               av_err2str(ret));
+        return ret;
+    }
+    *executor = shared_executor;
+    return 0;
+}
+
 int guess_input_channel_layout(InputStream *ist)
 {
     AVCodecContext *dec = ist->dec_ctx;
@@ -1916,7 +2502,34 @@ int guess_input_channel_layout(InputStream *ist)
         av_log(NULL, AV_LOG_WARNING, "Guessed Channel Layout for  Input Stream "
                "#%d.%d : %s\n", ist->file_index, ist->st->index, layout_name);
     }
-    return 1;
+    return 1;
+}
+
+// This does not quite work like avcodec_decode_audio4/avcodec_decode_video2.
+// There is the following difference: if you got a frame, you must call
+// it again with pkt=NULL. pkt==NULL is treated differently from pkt.size==0
+// (pkt==NULL means get more output, pkt.size==0 is a flush/drain packet)
+static int decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacket *pkt)
+{
+    int ret;
+
+    *got_frame = 0;
+
+    if (pkt) {
+        ret = avcodec_send_packet(avctx, pkt);
+        // In particular, we don't expect AVERROR(EAGAIN), because we read all
+        // decoded frames with avcodec_receive_frame() until done.
+        if (ret < 0 && ret != AVERROR_EOF)
+            return ret;
+    }
+
+    ret = avcodec_receive_frame(avctx, frame);
+    if (ret < 0 && ret != AVERROR(EAGAIN))
+        return ret;
+    if (ret >= 0)
+        *got_frame = 1;
+
+    return 0;
 }
 
 static void check_decode_result(InputStream *ist, int *got_output, int ret)
@@ -1939,6 +2552,7 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
 {
     AVFrame *decoded_frame, *f;
     AVCodecContext *avctx = ist->dec_ctx;
+    StageTimer timer;
     int i, ret, err = 0, resample_changed;
     AVRational decoded_frame_tb;
 
@@ -1949,7 +2563,9 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
     decoded_frame = ist->decoded_frame;
 
     update_benchmark(NULL);
-    ret = avcodec_decode_audio4(avctx, decoded_frame, got_output, pkt);
+    stage_timer_start(&timer);
+    ret = decode(avctx, decoded_frame, got_output, pkt);
+    stage_timer_stop(&ist->dec_stats, &timer);
     update_benchmark("decode_audio %d.%d", ist->file_index, ist->st->index);
 
     if (ret >= 0 && avctx->sample_rate <= 0) {
@@ -1957,7 +2573,8 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
         ret = AVERROR_INVALIDDATA;
     }
 
-    check_decode_result(ist, got_output, ret);
+    if (ret != AVERROR_EOF)
+        check_decode_result(ist, got_output, ret);
 
     if (!*got_output || ret < 0)
         return ret;
@@ -2025,14 +2642,15 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
     } else if (decoded_frame->pkt_pts != AV_NOPTS_VALUE) {
         decoded_frame->pts = decoded_frame->pkt_pts;
         decoded_frame_tb   = ist->st->time_base;
-    } else if (pkt->pts != AV_NOPTS_VALUE) {
+    } else if (pkt && pkt->pts != AV_NOPTS_VALUE) {
         decoded_frame->pts = pkt->pts;
         decoded_frame_tb   = ist->st->time_base;
     }else {
         decoded_frame->pts = ist->dts;
         decoded_frame_tb   = AV_TIME_BASE_Q;
     }
-    pkt->pts           = AV_NOPTS_VALUE;
+    if (pkt)
+        pkt->pts       = AV_NOPTS_VALUE;
     if (decoded_frame->pts != AV_NOPTS_VALUE)
         decoded_frame->pts = av_rescale_delta(decoded_frame_tb, decoded_frame->pts,
                                               (AVRational){1, avctx->sample_rate}, decoded_frame->nb_samples, &ist->filter_in_rescale_delta_last,
@@ -2060,23 +2678,48 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
     return err < 0 ? err : ret;
 }
 
-static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output)
+static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int eof)
 {
     AVFrame *decoded_frame, *f;
+    StageTimer timer;
     int i, ret = 0, err = 0, resample_changed;
     int64_t best_effort_timestamp;
+    int64_t dts = AV_NOPTS_VALUE;
     AVRational *frame_sample_aspect;
+    AVPacket avpkt;
+
+    // With fate-indeo3-2, we're getting 0-sized packets before EOF for some
+    // reason. This seems like a semi-critical bug. Don't trigger EOF, and
+    // skip the packet.
+    if (!eof && pkt && pkt->size == 0)
+        return 0;
 
     if (!ist->decoded_frame && !(ist->decoded_frame = av_frame_alloc()))
         return AVERROR(ENOMEM);
     if (!ist->filter_frame && !(ist->filter_frame = av_frame_alloc()))
         return AVERROR(ENOMEM);
     decoded_frame = ist->decoded_frame;
-    pkt->dts  = av_rescale_q(ist->dts, AV_TIME_BASE_Q, ist->st->time_base);
+    if (ist->dts != AV_NOPTS_VALUE)
+        dts = av_rescale_q(ist->dts, AV_TIME_BASE_Q, ist->st->time_base);
+    if (pkt) {
+        avpkt = *pkt;
+        avpkt.dts = dts; // ffmpeg.c probably shouldn't do this
+    }
+
+    // The old code used to set dts on the drain packet, which does not work
+    // with the new API anymore.
+    if (eof) {
+        void *new = av_realloc_array(ist->dts_buffer, ist->nb_dts_buffer + 1, sizeof(ist->dts_buffer[0]));
+        if (!new)
+            return AVERROR(ENOMEM);
+        ist->dts_buffer = new;
+        ist->dts_buffer[ist->nb_dts_buffer++] = dts;
+    }
 
     update_benchmark(NULL);
-    ret = avcodec_decode_video2(ist->dec_ctx,
-                                decoded_frame, got_output, pkt);
+    stage_timer_start(&timer);
+    ret = decode(ist->dec_ctx, decoded_frame, got_output, pkt ? &avpkt : NULL);
+    stage_timer_stop(&ist->dec_stats, &timer);
     update_benchmark("decode_video %d.%d", ist->file_index, ist->st->index);
 
     // The following line may be required in some cases where there is no parser
@@ -2094,7 +2737,8 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output)
                    ist->st->codec->has_b_frames);
     }
 
-    check_decode_result(ist, got_output, ret);
+    if (ret != AVERROR_EOF)
+        check_decode_result(ist, got_output, ret);
 
     if (*got_output && ret >= 0) {
         if (ist->dec_ctx->width  != decoded_frame->width ||
@@ -2126,6 +2770,15 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output)
     ist->hwaccel_retrieved_pix_fmt = decoded_frame->format;
 
     best_effort_timestamp= av_frame_get_best_effort_timestamp(decoded_frame);
+
+    if (eof && best_effort_timestamp == AV_NOPTS_VALUE && ist->nb_dts_buffer > 0) {
+        best_effort_timestamp = ist->dts_buffer[0];
+
+        for (i = 0; i < ist->nb_dts_buffer - 1; i++)
+            ist->dts_buffer[i] = ist->dts_buffer[i + 1];
+        ist->nb_dts_buffer--;
+    }
+
     if(best_effort_timestamp != AV_NOPTS_VALUE) {
         int64_t ts = av_rescale_q(decoded_frame->pts = best_effort_timestamp, ist->st->time_base, AV_TIME_BASE_Q);
 
@@ -2144,8 +2797,6 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output)
                ist->st->time_base.num, ist->st->time_base.den);
     }
 
-    pkt->size = 0;
-
     if (ist->st->sample_aspect_ratio.num)
         decoded_frame->sample_aspect_ratio = ist->st->sample_aspect_ratio;
 
@@ -2164,8 +2815,17 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output)
         ist->resample_pix_fmt = decoded_frame->format;
 
         for (i = 0; i < nb_filtergraphs; i++) {
-            if (ist_in_filtergraph(filtergraphs[i], ist) && ist->reinit_filters &&
-                configure_filtergraph(filtergraphs[i]) < 0) {
+            FilterGraph *fg = filtergraphs[i];
+            int renegotiated;
+            if (!ist_in_filtergraph(fg, ist) || !ist->reinit_filters)
+                continue;
+            renegotiated = filtergraph_renegotiate_input(fg, ist, decoded_frame);
+            if (renegotiated > 0) {
+                av_log(NULL, AV_LOG_VERBOSE, "Passed the new frame parameters "
+                       "to the scaler of filtergraph %d\n", fg->index);
+                continue;
+            }
+            if (renegotiated < 0 || configure_filtergraph(fg) < 0) {
                 av_log(NULL, AV_LOG_FATAL, "Error reinitializing filters!\n");
                 exit_program(1);
             }
@@ -2203,8 +2863,12 @@ fail:
 static int transcode_subtitles(InputStream *ist, AVPacket *pkt, int *got_output)
 {
     AVSubtitle subtitle;
-    int i, ret = avcodec_decode_subtitle2(ist->dec_ctx,
-                                          &subtitle, got_output, pkt);
+    StageTimer timer;
+    int i, ret;
+
+    stage_timer_start(&timer);
+    ret = avcodec_decode_subtitle2(ist->dec_ctx, &subtitle, got_output, pkt);
+    stage_timer_stop(&ist->dec_stats, &timer);
 
     check_decode_result(NULL, got_output, ret);
 
@@ -2274,7 +2938,8 @@ static int send_filter_eof(InputStream *ist)
 static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eof)
 {
     int ret = 0, i;
-    int got_output = 0;
+    int repeating = 0;
+    int eof_reached = 0;
 
     AVPacket avpkt;
     if (!ist->saw_first_ts) {
@@ -2297,63 +2962,65 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
         av_init_packet(&avpkt);
         avpkt.data = NULL;
         avpkt.size = 0;
-        goto handle_eof;
     } else {
         avpkt = *pkt;
     }
 
-    if (pkt->dts != AV_NOPTS_VALUE) {
+    if (pkt && pkt->dts != AV_NOPTS_VALUE) {
         ist->next_dts = ist->dts = av_rescale_q(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q);
         if (ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO || !ist->decoding_needed)
             ist->next_pts = ist->pts = ist->dts;
     }
 
     // while we have more to decode or while the decoder did output something on EOF
-    while (ist->decoding_needed && (avpkt.size > 0 || (!pkt && got_output))) {
-        int duration;
-    handle_eof:
+    while (ist->decoding_needed) {
+        int duration = 0;
+        int got_output = 0;
 
         ist->pts = ist->next_pts;
         ist->dts = ist->next_dts;
 
-        if (avpkt.size && avpkt.size != pkt->size &&
-            !(ist->dec->capabilities & AV_CODEC_CAP_SUBFRAMES)) {
-            av_log(NULL, ist->showed_multi_packet_warning ? AV_LOG_VERBOSE : AV_LOG_WARNING,
-                   "Multiple frames in a packet from stream %d\n", pkt->stream_index);
-            ist->showed_multi_packet_warning = 1;
-        }
-
         switch (ist->dec_ctx->codec_type) {
         case AVMEDIA_TYPE_AUDIO:
-            ret = decode_audio    (ist, &avpkt, &got_output);
+            ret = decode_audio    (ist, repeating ? NULL : &avpkt, &got_output);
             break;
         case AVMEDIA_TYPE_VIDEO:
-            ret = decode_video    (ist, &avpkt, &got_output);
-            if (avpkt.duration) {
-                duration = av_rescale_q(avpkt.duration, ist->st->time_base, AV_TIME_BASE_Q);
-            } else if(ist->dec_ctx->framerate.num != 0 && ist->dec_ctx->framerate.den != 0) {
-                int ticks= av_stream_get_parser(ist->st) ? av_stream_get_parser(ist->st)->repeat_pict+1 : ist->dec_ctx->ticks_per_frame;
-                duration = ((int64_t)AV_TIME_BASE *
-                                ist->dec_ctx->framerate.den * ticks) /
-                                ist->dec_ctx->framerate.num / ist->dec_ctx->ticks_per_frame;
-            } else
-                duration = 0;
+            ret = decode_video    (ist, repeating ? NULL : &avpkt, &got_output, !pkt);
+            if (!repeating || !pkt || got_output) {
+                if (pkt && pkt->duration) {
+                    duration = av_rescale_q(pkt->duration, ist->st->time_base, AV_TIME_BASE_Q);
+                } else if(ist->dec_ctx->framerate.num != 0 && ist->dec_ctx->framerate.den != 0) {
+                    int ticks= av_stream_get_parser(ist->st) ? av_stream_get_parser(ist->st)->repeat_pict+1 : ist->dec_ctx->ticks_per_frame;
+                    duration = ((int64_t)AV_TIME_BASE *
+                                    ist->dec_ctx->framerate.den * ticks) /
+                                    ist->dec_ctx->framerate.num / ist->dec_ctx->ticks_per_frame;
+                }
 
-            if(ist->dts != AV_NOPTS_VALUE && duration) {
-                ist->next_dts += duration;
-            }else
-                ist->next_dts = AV_NOPTS_VALUE;
+                if(ist->dts != AV_NOPTS_VALUE && duration) {
+                    ist->next_dts += duration;
+                }else
+                    ist->next_dts = AV_NOPTS_VALUE;
+            }
 
             if (got_output)
                 ist->next_pts += duration; //FIXME the duration is not correct in some cases
             break;
         case AVMEDIA_TYPE_SUBTITLE:
+            if (repeating)
+                break;
             ret = transcode_subtitles(ist, &avpkt, &got_output);
+            if (!pkt && ret >= 0)
+                ret = AVERROR_EOF;
             break;
         default:
             return -1;
         }
 
+        if (ret == AVERROR_EOF) {
+            eof_reached = 1;
+            break;
+        }
+
         if (ret < 0) {
             av_log(NULL, AV_LOG_ERROR, "Error while decoding stream #%d:%d: %s\n",
                    ist->file_index, ist->st->index, av_err2str(ret));
@@ -2362,26 +3029,24 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
             break;
         }
 
-        avpkt.dts=
-        avpkt.pts= AV_NOPTS_VALUE;
+        if (!got_output)
+            break;
 
-        // touch data and size only if not EOF
-        if (pkt) {
-            if(ist->dec_ctx->codec_type != AVMEDIA_TYPE_AUDIO)
-                ret = avpkt.size;
-            avpkt.data += ret;
-            avpkt.size -= ret;
-        }
-        if (!got_output) {
-            continue;
-        }
-        if (got_output && !pkt)
+        // During draining, we might get multiple output frames in this loop.
+        // ffmpeg.c does not drain the filter chain on configuration changes,
+        // which means if we send multiple frames at once to the filters, and
+        // one of those frames changes configuration, the buffered frames will
+        // be lost. Decode only 1 frame per call on EOF, the caller repeats
+        // the call until the decoder is drained.
+        if (!pkt)
             break;
+
+        repeating = 1;
     }
 
     /* after flushing, send an EOF on all the filter inputs attached to the stream */
     /* except when looping we need to flush but not to send an EOF */
-    if (!pkt && ist->decoding_needed && !got_output && !no_eof) {
+    if (!pkt && ist->decoding_needed && eof_reached && !no_eof) {
         int ret = send_filter_eof(ist);
         if (ret < 0) {
             av_log(NULL, AV_LOG_FATAL, "Error marking filters as finished\n");
@@ -2425,7 +3090,7 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
         do_streamcopy(ist, ost, pkt);
     }
 
-    return got_output;
+    return !eof_reached;
 }
 
 static void print_sdp(void)
@@ -2554,6 +3219,8 @@ static int init_input_stream(int ist_index, char *error, int error_len)
 
         if (!av_dict_get(ist->decoder_opts, "threads", NULL, 0))
             av_dict_set(&ist->decoder_opts, "threads", "auto", 0);
+        if ((ret = use_shared_executor(&ist->dec_ctx->executor)) < 0)
+            return ret;
         if ((ret = avcodec_open2(ist->dec_ctx, codec, &ist->decoder_opts)) < 0) {
             if (ret == AVERROR_EXPERIMENTAL)
                 abort_codec_experimental(codec, 0);
@@ -2618,6 +3285,16 @@ static int init_output_stream(OutputStream *ost, char *error, int error_len)
                 return AVERROR(ENOMEM);
         }
 
+        if (ost->chunk_frames > 0 && ost->enc->type == AVMEDIA_TYPE_VIDEO &&
+            (ret = chunk_encoder_init(ost)) < 0) {
+            snprintf(error, error_len,
+                     "Error initializing the chunked encoding of output stream #%d:%d",
+                     ost->file_index, ost->index);
+            return ret;
+        }
+
+        if ((ret = use_shared_executor(&ost->enc_ctx->executor)) < 0)
+            return ret;
         if ((ret = avcodec_open2(ost->enc_ctx, codec, &ost->encoder_opts)) < 0) {
             if (ret == AVERROR_EXPERIMENTAL)
                 abort_codec_experimental(codec, 1);
@@ -2801,7 +3478,12 @@ static void set_encoder_id(OutputFile *of, OutputStream *ost)
                 AV_DICT_DONT_STRDUP_VAL | AV_DICT_DONT_OVERWRITE);
 }
 
-static int transcode_init(void)
+/*
+ * Set up the output files from first_file on, with their encoders and the
+ * decoders they need, and write their headers. This is done for all files
+ * before transcoding, then for each file added while transcoding.
+ */
+static int transcode_init(int first_file)
 {
     int ret = 0, i, j, k;
     AVFormatContext *oc;
@@ -2809,6 +3491,7 @@ static int transcode_init(void)
     InputStream *ist;
     char error[1024] = {0};
     int want_sdp = 1;
+    int first_ost = output_files[first_file]->ost_index;
 
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
@@ -2826,7 +3509,7 @@ static int transcode_init(void)
     }
 
     /* init framerate emulation */
-    for (i = 0; i < nb_input_files; i++) {
+    for (i = 0; i < nb_input_files && !transcode_init_done; i++) {
         InputFile *ifile = input_files[i];
         if (ifile->rate_emu)
             for (j = 0; j < ifile->nb_streams; j++)
@@ -2834,7 +3517,7 @@ static int transcode_init(void)
     }
 
     /* for each output stream, we compute the right encoding parameters */
-    for (i = 0; i < nb_output_streams; i++) {
+    for (i = first_ost; i < nb_output_streams; i++) {
         AVCodecContext *enc_ctx;
         AVCodecContext *dec_ctx = NULL;
         ost = output_streams[i];
@@ -3054,9 +3737,10 @@ static int transcode_init(void)
                  enc_ctx->codec_type == AVMEDIA_TYPE_AUDIO)) {
                     FilterGraph *fg;
                     fg = init_simple_filtergraph(ist, ost);
-                    if (configure_filtergraph(fg)) {
-                        av_log(NULL, AV_LOG_FATAL, "Error opening filters!\n");
-                        exit_program(1);
+                    if ((ret = configure_filtergraph(fg)) < 0) {
+                        snprintf(error, sizeof(error), "Error opening filters for output stream #%d:%d",
+                                 ost->file_index, ost->index);
+                        goto dump_format;
                     }
             }
 
@@ -3209,18 +3893,23 @@ static int transcode_init(void)
         }
     }
 
-    /* init input streams */
-    for (i = 0; i < nb_input_streams; i++)
+    /* init input streams, or only open the decoders which new outputs need */
+    for (i = 0; i < nb_input_streams; i++) {
+        ist = input_streams[i];
+        if (transcode_init_done &&
+            (!ist->decoding_needed || avcodec_is_open(ist->dec_ctx)))
+            continue;
         if ((ret = init_input_stream(i, error, sizeof(error))) < 0) {
-            for (i = 0; i < nb_output_streams; i++) {
+            for (i = first_ost; i < nb_output_streams; i++) {
                 ost = output_streams[i];
                 avcodec_close(ost->enc_ctx);
             }
             goto dump_format;
         }
+    }
 
     /* open each encoder */
-    for (i = 0; i < nb_output_streams; i++) {
+    for (i = first_ost; i < nb_output_streams; i++) {
         ret = init_output_stream(output_streams[i], error, sizeof(error));
         if (ret < 0)
             goto dump_format;
@@ -3243,7 +3932,7 @@ static int transcode_init(void)
     }
 
     /* open files and write file headers */
-    for (i = 0; i < nb_output_files; i++) {
+    for (i = first_file; i < nb_output_files; i++) {
         oc = output_files[i]->ctx;
         oc->interrupt_callback = int_cb;
         if ((ret = avformat_write_header(oc, &output_files[i]->opts)) < 0) {
@@ -3263,13 +3952,13 @@ static int transcode_init(void)
  dump_format:
     /* dump the file output parameters - cannot be done before in case
        of stream copy */
-    for (i = 0; i < nb_output_files; i++) {
+    for (i = first_file; i < nb_output_files; i++) {
         av_dump_format(output_files[i]->ctx, i, output_files[i]->ctx->filename, 1);
     }
 
     /* dump the stream mapping */
     av_log(NULL, AV_LOG_INFO, "Stream mapping:\n");
-    for (i = 0; i < nb_input_streams; i++) {
+    for (i = 0; i < nb_input_streams && !transcode_init_done; i++) {
         ist = input_streams[i];
 
         for (j = 0; j < ist->nb_filters; j++) {
@@ -3284,7 +3973,7 @@ static int transcode_init(void)
         }
     }
 
-    for (i = 0; i < nb_output_streams; i++) {
+    for (i = first_ost; i < nb_output_streams; i++) {
         ost = output_streams[i];
 
         if (ost->attachment_filename) {
@@ -3355,7 +4044,7 @@ static int transcode_init(void)
         return ret;
     }
 
-    if (sdp_filename || want_sdp) {
+    if (!transcode_init_done && (sdp_filename || want_sdp)) {
         print_sdp();
     }
 
@@ -3375,7 +4064,7 @@ static int need_output(void)
         AVFormatContext *os  = output_files[ost->file_index]->ctx;
 
         if (ost->finished ||
-            (os->pb && avio_tell(os->pb) >= of->limit_filesize))
+            (os->pb && output_file_pos(of) >= of->limit_filesize))
             continue;
         if (ost->frame_number >= ost->max_frames) {
             int j;
@@ -3429,6 +4118,247 @@ static void set_tty_echo(int on)
 #endif
 }
 
+/*
+ * Stop writing to an output file and release its filters and encoders, for
+ * an output removed while transcoding or one which could not be added.
+ */
+static void close_output_file(int file_index, int write_trailer)
+{
+    OutputFile *of = output_files[file_index];
+    int i, ret;
+
+    for (i = of->ost_index; i < of->ost_index + of->ctx->nb_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        /* the complex filtergraphs are shared with other outputs */
+        if (ost->filter && !ost->filter->graph->graph_desc)
+            close_simple_filtergraph(ost->filter->graph);
+#if HAVE_PTHREADS
+        stop_encoder_thread(ost);
+#endif
+        if (write_trailer)
+            flush_encoder(ost);
+        ost->finished = ENCODER_FINISHED | MUXER_FINISHED;
+        avcodec_close(ost->enc_ctx);
+    }
+#if HAVE_PTHREADS
+    stop_mux_thread(of);
+#endif
+
+    if (write_trailer) {
+        ret = av_write_trailer(of->ctx);
+        if (ret < 0)
+            av_log(NULL, AV_LOG_ERROR, "Error writing trailer of %s: %s\n",
+                   of->ctx->filename, av_err2str(ret));
+    }
+    if (!(of->ctx->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&of->ctx->pb);
+    of->closed = 1;
+}
+
+static int add_output_file(int argc, char **argv)
+{
+    int first_file = nb_output_files;
+    int i, ret, header_written = 0;
+
+    ret = ffmpeg_parse_output_options(argc, argv);
+    if (ret >= 0 && nb_output_files > first_file) {
+        ret = transcode_init(first_file);
+        header_written = ret >= 0;
+    }
+#if HAVE_PTHREADS
+    if (ret >= 0) {
+        for (i = output_files[first_file]->ost_index; i < nb_output_streams && ret >= 0; i++)
+            ret = init_encoder_thread(output_streams[i]);
+        if (ret >= 0)
+            ret = init_mux_thread(output_files[first_file]);
+    }
+#endif
+
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Could not add the output: %s\n", av_err2str(ret));
+        if (nb_output_files > first_file)
+            close_output_file(first_file, header_written);
+        /* do not decode for the outputs which failed */
+        for (i = 0; i < nb_input_streams; i++) {
+            InputStream *ist = input_streams[i];
+            if (ist->decoding_needed && !avcodec_is_open(ist->dec_ctx))
+                ist->decoding_needed = 0;
+        }
+        return ret;
+    }
+
+    av_log(NULL, AV_LOG_INFO, "Added output file #%d %s\n",
+           first_file, output_files[first_file]->ctx->filename);
+    return 0;
+}
+
+/*
+ * Run a command adding or removing an output file while transcoding, from
+ * the keyboard or from -control:
+ *   add [output options] <output url>
+ *   remove <output file index>
+ *   list
+ */
+static int run_control_command(const char *cmd)
+{
+    char **argv = NULL;
+    int argc = 0, ret = 0, i;
+
+    while (*(cmd += strspn(cmd, " \t\r\n"))) {
+        char *arg = av_get_token(&cmd, " \t\r\n");
+        if (!arg || (ret = av_dynarray_add_nofree(&argv, &argc, arg)) < 0) {
+            av_free(arg);
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+    }
+    if (!argc)
+        goto end;
+    /* the option parser expects argv[argc] == NULL */
+    if ((ret = av_dynarray_add_nofree(&argv, &argc, NULL)) < 0)
+        goto end;
+    argc--;
+
+    if (!strcmp(argv[0], "add") && argc > 1) {
+        ret = add_output_file(argc, argv);
+    } else if (!strcmp(argv[0], "remove") && argc == 2) {
+        char *tail;
+        long file_index = strtol(argv[1], &tail, 10);
+
+        if (*tail || file_index < 0 || file_index >= nb_output_files ||
+            output_files[file_index]->closed) {
+            av_log(NULL, AV_LOG_ERROR, "No output file #%s to remove\n", argv[1]);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        close_output_file(file_index, 1);
+        av_log(NULL, AV_LOG_INFO, "Removed output file #%ld %s\n",
+               file_index, output_files[file_index]->ctx->filename);
+    } else if (!strcmp(argv[0], "list") && argc == 1) {
+        for (i = 0; i < nb_output_files; i++)
+            av_log(NULL, AV_LOG_INFO, "Output file #%d %s%s\n", i,
+                   output_files[i]->ctx->filename,
+                   output_files[i]->closed ? " (removed)" : "");
+    } else {
+        av_log(NULL, AV_LOG_ERROR, "Invalid command '%s', expected "
+               "add [options] <output>, remove <index> or list\n", argv[0]);
+        ret = AVERROR(EINVAL);
+    }
+
+end:
+    for (i = 0; i < argc; i++)
+        av_free(argv[i]);
+    av_free(argv);
+    return ret;
+}
+
+#if HAVE_PTHREADS
+static AVThreadMessageQueue *control_queue;
+static pthread_t control_tid;
+static volatile int control_exit;
+
+static int control_interrupt_cb(void *ctx)
+{
+    return control_exit || decode_interrupt_cb(ctx);
+}
+
+static const AVIOInterruptCB control_int_cb = { control_interrupt_cb, NULL };
+
+static void send_control_command(const char *line)
+{
+    char *cmd = av_strdup(line);
+
+    if (!cmd || av_thread_message_queue_send(control_queue, &cmd, 0) < 0)
+        av_free(cmd);
+}
+
+/*
+ * Read the -control commands, one per line. A connection or a pipe which is
+ * closed is opened again to wait for the next one, a regular file is only
+ * read once.
+ */
+static void *control_thread(void *arg)
+{
+    char line[4096];
+    int ret = 0, seekable = 0;
+
+    while (!control_exit && !seekable) {
+        AVIOContext *pb = NULL;
+        int len = 0;
+
+        ret = avio_open2(&pb, control_url, AVIO_FLAG_READ, &control_int_cb, NULL);
+        if (ret < 0)
+            break;
+        seekable = pb->seekable;
+
+        while (!control_exit) {
+            int c = avio_r8(pb);
+
+            if (avio_feof(pb) || c == '\n' || c == '\r') {
+                line[len] = 0;
+                if (len)
+                    send_control_command(line);
+                len = 0;
+                if (avio_feof(pb))
+                    break;
+            } else if (len < sizeof(line) - 1) {
+                line[len++] = c;
+            }
+        }
+        ret = pb->error;
+        avio_closep(&pb);
+        if (ret < 0)
+            break;
+    }
+
+    if (ret < 0 && !control_exit)
+        av_log(NULL, AV_LOG_ERROR, "Error reading control commands from %s: %s\n",
+               control_url, av_err2str(ret));
+    return NULL;
+}
+
+static int init_control_thread(void)
+{
+    int ret;
+
+    if (!control_url)
+        return 0;
+
+    ret = av_thread_message_queue_alloc(&control_queue, 8, sizeof(char *));
+    if (ret < 0)
+        return ret;
+    if ((ret = pthread_create(&control_tid, NULL, control_thread, NULL))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        av_thread_message_queue_free(&control_queue);
+        return AVERROR(ret);
+    }
+    /* it may block in a read which cannot be interrupted, on a named pipe */
+    pthread_detach(control_tid);
+    return 0;
+}
+
+static void run_control_commands(void)
+{
+    char *cmd;
+
+    while (av_thread_message_queue_recv(control_queue, &cmd,
+                                        AV_THREAD_MESSAGE_NONBLOCK) >= 0) {
+        av_log(NULL, AV_LOG_INFO, "Control command: %s\n", cmd);
+        run_control_command(cmd);
+        av_free(cmd);
+    }
+}
+
+/* the thread is detached, so the queue is left for it until the exit */
+static void stop_control_thread(void)
+{
+    control_exit = 1;
+    if (control_queue)
+        av_thread_message_queue_set_err_send(control_queue, AVERROR_EOF);
+}
+#endif
+
 static int check_keyboard_interaction(int64_t cur_time)
 {
     int i, ret, key;
@@ -3495,6 +4425,21 @@ static int check_keyboard_interaction(int64_t cur_time)
                    "only %d given in string '%s'\n", n, buf);
         }
     }
+    if (key == 'o'){
+        char buf[4096];
+        int k;
+        fprintf(stderr, "\nEnter output command: add [options] <output>|remove <index>|list\n");
+        i = 0;
+        set_tty_echo(1);
+        while ((k = read_key()) != '\n' && k != '\r' && i < sizeof(buf)-1)
+            if (k > 0)
+                buf[i++] = k;
+        buf[i] = 0;
+        set_tty_echo(0);
+        fprintf(stderr, "\n");
+        if (k > 0)
+            run_control_command(buf);
+    }
     if (key == 'd' || key == 'D'){
         int debug=0;
         if(key == 'D') {
@@ -3535,6 +4480,7 @@ static int check_keyboard_interaction(int64_t cur_time)
                         "C      Send/Que command to all matching filters\n"
                         "D      cycle through available debug modes\n"
                         "h      dump packets/hex press to cycle through the 3 states\n"
+                        "o      add, remove or list output files\n"
                         "q      quit\n"
                         "s      Show QP histogram\n"
         );
@@ -3543,6 +4489,26 @@ static int check_keyboard_interaction(int64_t cur_time)
 }
 
 #if HAVE_PTHREADS
+static void set_input_thread_err(InputFile *f, int err)
+{
+    int i;
+
+    if (f->in_thread_queue)
+        av_thread_message_queue_set_err_recv(f->in_thread_queue, err);
+    for (i = 0; i < f->nb_prg_queues; i++)
+        av_thread_message_queue_set_err_recv(f->prg_queues[i], err);
+}
+
+static AVThreadMessageQueue *input_thread_queue(InputFile *f, int stream_index)
+{
+    if (!f->nb_prg_queues)
+        return f->in_thread_queue;
+    /* streams which appeared after the thread started are in no program */
+    if (stream_index >= f->nb_streams)
+        return f->prg_queues[f->nb_prg_queues - 1];
+    return f->prg_queues[f->stream_prg_queue[stream_index]];
+}
+
 static void *input_thread(void *arg)
 {
     InputFile *f = arg;
@@ -3550,6 +4516,7 @@ static void *input_thread(void *arg)
     int ret = 0;
 
     while (1) {
+        AVThreadMessageQueue *queue;
         AVPacket pkt;
         ret = av_read_frame(f->ctx, &pkt);
 
@@ -3558,13 +4525,23 @@ static void *input_thread(void *arg)
             continue;
         }
         if (ret < 0) {
-            av_thread_message_queue_set_err_recv(f->in_thread_queue, ret);
+            set_input_thread_err(f, ret);
             break;
         }
-        ret = av_thread_message_queue_send(f->in_thread_queue, &pkt, flags);
+        queue = input_thread_queue(f, pkt.stream_index);
+        ret = av_thread_message_queue_send(queue, &pkt, flags);
+        if (flags && ret == AVERROR(EAGAIN) && f->nb_prg_queues) {
+            /* do not hold the other programs back for a late one */
+            av_log(f->ctx, AV_LOG_WARNING,
+                   "Program queue full, discarding packet; consider raising "
+                   "the thread_queue_size option (current value: %d)\n",
+                   f->thread_queue_size);
+            av_packet_unref(&pkt);
+            continue;
+        }
         if (flags && ret == AVERROR(EAGAIN)) {
             flags = 0;
-            ret = av_thread_message_queue_send(f->in_thread_queue, &pkt, flags);
+            ret = av_thread_message_queue_send(queue, &pkt, flags);
             av_log(f->ctx, AV_LOG_WARNING,
                    "Thread message queue blocking; consider raising the "
                    "thread_queue_size option (current value: %d)\n",
@@ -3576,7 +4553,7 @@ static void *input_thread(void *arg)
                        "Unable to send packet to main thread: %s\n",
                        av_err2str(ret));
             av_packet_unref(&pkt);
-            av_thread_message_queue_set_err_recv(f->in_thread_queue, ret);
+            set_input_thread_err(f, ret);
             break;
         }
     }
@@ -3584,55 +4561,139 @@ static void *input_thread(void *arg)
     return NULL;
 }
 
-static void free_input_threads(void)
+static void drain_input_thread_queue(AVThreadMessageQueue *queue)
+{
+    AVPacket pkt;
+
+    av_thread_message_queue_set_err_send(queue, AVERROR_EOF);
+    while (av_thread_message_queue_recv(queue, &pkt, AV_THREAD_MESSAGE_NONBLOCK) >= 0)
+        av_packet_unref(&pkt);
+}
+
+static void free_prg_queues(InputFile *f)
 {
     int i;
 
+    for (i = 0; i < f->nb_prg_queues; i++)
+        av_thread_message_queue_free(&f->prg_queues[i]);
+    av_freep(&f->prg_queues);
+    av_freep(&f->stream_prg_queue);
+    f->nb_prg_queues = 0;
+}
+
+static void free_input_threads(void)
+{
+    int i, j;
+
     for (i = 0; i < nb_input_files; i++) {
         InputFile *f = input_files[i];
         AVPacket pkt;
 
-        if (!f || !f->in_thread_queue)
+        if (!f || (!f->in_thread_queue && !f->nb_prg_queues))
             continue;
-        av_thread_message_queue_set_err_send(f->in_thread_queue, AVERROR_EOF);
-        while (av_thread_message_queue_recv(f->in_thread_queue, &pkt, 0) >= 0)
-            av_packet_unref(&pkt);
+        if (f->in_thread_queue) {
+            av_thread_message_queue_set_err_send(f->in_thread_queue, AVERROR_EOF);
+            while (av_thread_message_queue_recv(f->in_thread_queue, &pkt, 0) >= 0)
+                av_packet_unref(&pkt);
+        } else {
+            /* the thread may be blocked on any of the queues */
+            for (j = 0; j < f->nb_prg_queues; j++)
+                drain_input_thread_queue(f->prg_queues[j]);
+        }
 
         pthread_join(f->thread, NULL);
         f->joined = 1;
         av_thread_message_queue_free(&f->in_thread_queue);
+        free_prg_queues(f);
+    }
+}
+
+static int alloc_prg_queues(InputFile *f)
+{
+    AVFormatContext *ic = f->ctx;
+    int i, j, ret;
+
+    f->stream_prg_queue = av_malloc_array(f->nb_streams, sizeof(*f->stream_prg_queue));
+    f->prg_queues       = av_mallocz_array(ic->nb_programs + 1, sizeof(*f->prg_queues));
+    if (!f->stream_prg_queue || !f->prg_queues)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < f->nb_streams; i++)
+        f->stream_prg_queue[i] = ic->nb_programs;
+    /* a stream in several programs is queued with the first one */
+    for (i = ic->nb_programs - 1; i >= 0; i--)
+        for (j = 0; j < ic->programs[i]->nb_stream_indexes; j++)
+            if (ic->programs[i]->stream_index[j] < f->nb_streams)
+                f->stream_prg_queue[ic->programs[i]->stream_index[j]] = i;
+
+    for (i = 0; i <= ic->nb_programs; i++) {
+        ret = av_thread_message_queue_alloc2(&f->prg_queues[i],
+                                             f->thread_queue_size, sizeof(AVPacket),
+                                             AV_THREAD_MESSAGE_QUEUE_SPSC);
+        if (ret < 0)
+            return ret;
+        f->nb_prg_queues++;
     }
+    return 0;
 }
 
 static int init_input_threads(void)
 {
     int i, ret;
 
-    if (nb_input_files == 1)
-        return 0;
-
     for (i = 0; i < nb_input_files; i++) {
         InputFile *f = input_files[i];
 
+        if (nb_input_files == 1 && !f->program_queues)
+            return 0;
+
         if (f->ctx->pb ? !f->ctx->pb->seekable :
             strcmp(f->ctx->iformat->name, "lavfi"))
             f->non_blocking = 1;
-        ret = av_thread_message_queue_alloc(&f->in_thread_queue,
-                                            f->thread_queue_size, sizeof(AVPacket));
+        if (f->program_queues)
+            ret = alloc_prg_queues(f);
+        else
+            ret = av_thread_message_queue_alloc2(&f->in_thread_queue,
+                                                 f->thread_queue_size, sizeof(AVPacket),
+                                                 AV_THREAD_MESSAGE_QUEUE_SPSC);
         if (ret < 0)
             return ret;
 
         if ((ret = pthread_create(&f->thread, NULL, input_thread, f))) {
             av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
             av_thread_message_queue_free(&f->in_thread_queue);
+            free_prg_queues(f);
             return AVERROR(ret);
         }
     }
     return 0;
 }
 
+/* Take the packet from the queue of the program wanted by the caller if it
+ * has one, or else from the next queue which has one. This never blocks, as
+ * the thread may be waiting on any full queue. */
+static int get_input_packet_prg(InputFile *f, AVPacket *pkt)
+{
+    int i, ret, err = AVERROR_EOF;
+
+    for (i = 0; i < f->nb_prg_queues; i++) {
+        int q = (f->next_prg_queue + i) % f->nb_prg_queues;
+        ret = av_thread_message_queue_recv(f->prg_queues[q], pkt,
+                                           AV_THREAD_MESSAGE_NONBLOCK);
+        if (ret >= 0)
+            return ret;
+        if (ret == AVERROR(EAGAIN) || err == AVERROR(EAGAIN))
+            err = AVERROR(EAGAIN);
+        else
+            err = ret;
+    }
+    return err;
+}
+
 static int get_input_packet_mt(InputFile *f, AVPacket *pkt)
 {
+    if (f->nb_prg_queues)
+        return get_input_packet_prg(f, pkt);
     return av_thread_message_queue_recv(f->in_thread_queue, pkt,
                                         f->non_blocking ?
                                         AV_THREAD_MESSAGE_NONBLOCK : 0);
@@ -3647,13 +4708,16 @@ static int get_input_packet(InputFile *f, AVPacket *pkt)
             InputStream *ist = input_streams[f->ist_index + i];
             int64_t pts = av_rescale(ist->dts, 1000000, AV_TIME_BASE);
             int64_t now = av_gettime_relative() - ist->start;
-            if (pts > now)
+            if (pts > now) {
+                f->rate_emu_wakeup = ist->start + pts;
                 return AVERROR(EAGAIN);
+            }
         }
+        f->rate_emu_wakeup = AV_NOPTS_VALUE;
     }
 
 #if HAVE_PTHREADS
-    if (nb_input_files > 1)
+    if (nb_input_files > 1 || f->nb_prg_queues)
         return get_input_packet_mt(f, pkt);
 #endif
     return av_read_frame(f->ctx, pkt);
@@ -3668,6 +4732,22 @@ static int got_eagain(void)
     return 0;
 }
 
+/* how long to sleep when no output can make progress: until the earliest
+ * packet -re holds back is due, or 10ms when waiting for anything else */
+static int64_t eagain_sleep_time(void)
+{
+    int64_t now = av_gettime_relative();
+    int64_t wait = 10000;
+    int i;
+
+    for (i = 0; i < nb_input_files; i++) {
+        InputFile *f = input_files[i];
+        if (f->eagain && f->rate_emu && f->rate_emu_wakeup != AV_NOPTS_VALUE)
+            wait = FFMIN(wait, f->rate_emu_wakeup - now);
+    }
+    return FFMAX(wait, 0);
+}
+
 static void reset_eagain(void)
 {
     int i;
@@ -3834,6 +4914,12 @@ static int process_input(int file_index)
     ist->data_size += pkt.size;
     ist->nb_packets++;
 
+#if HAVE_PTHREADS
+    if (ifile->in_thread_queue || ifile->nb_prg_queues)
+        stage_stats_add_queue_depth(&ist->dec_stats,
+                                    av_thread_message_queue_nb_elems(input_thread_queue(ifile, pkt.stream_index)));
+#endif
+
     if (ist->discard)
         goto discard_packet;
 
@@ -4068,8 +5154,13 @@ static int transcode_step(void)
     ost = choose_output();
     if (!ost) {
         if (got_eagain()) {
+            int64_t wait = eagain_sleep_time();
             reset_eagain();
-            av_usleep(10000);
+#if HAVE_PTHREADS
+            send_mux_batches();
+#endif
+            if (wait)
+                av_usleep(wait);
             return 0;
         }
         av_log(NULL, AV_LOG_VERBOSE, "No more inputs to read from, finishing.\n");
@@ -4086,6 +5177,13 @@ static int transcode_step(void)
         ist = input_streams[ost->source_index];
     }
 
+#if HAVE_PTHREADS
+    if (input_files[ist->file_index]->nb_prg_queues) {
+        InputFile *ifile = input_files[ist->file_index];
+        ifile->next_prg_queue = ifile->stream_prg_queue[ist->st->index];
+    }
+#endif
+
     ret = process_input(ist->file_index);
     if (ret == AVERROR(EAGAIN)) {
         if (input_files[ist->file_index]->eagain)
@@ -4108,10 +5206,10 @@ static int transcode(void)
     AVFormatContext *os;
     OutputStream *ost;
     InputStream *ist;
-    int64_t timer_start;
+    int64_t timer_start, total_time;
     int64_t total_packets_written = 0;
 
-    ret = transcode_init();
+    ret = transcode_init(0);
     if (ret < 0)
         goto fail;
 
@@ -4124,6 +5222,12 @@ static int transcode(void)
 #if HAVE_PTHREADS
     if ((ret = init_input_threads()) < 0)
         goto fail;
+    if ((ret = init_encoder_threads()) < 0)
+        goto fail;
+    if ((ret = init_mux_threads()) < 0)
+        goto fail;
+    if ((ret = init_control_thread()) < 0)
+        goto fail;
 #endif
 
     while (!received_sigterm) {
@@ -4133,6 +5237,10 @@ static int transcode(void)
         if (stdin_interaction)
             if (check_keyboard_interaction(cur_time) < 0)
                 break;
+#if HAVE_PTHREADS
+        if (control_queue)
+            run_control_commands();
+#endif
 
         /* check if there's any stream where output is still needed */
         if (!need_output()) {
@@ -4151,9 +5259,11 @@ static int transcode(void)
 
         /* dump report by using the output first video and audio streams */
         print_report(0, timer_start, cur_time);
+        write_bench_report(0, timer_start, cur_time);
     }
 #if HAVE_PTHREADS
     free_input_threads();
+    stop_control_thread();
 #endif
 
     /* at the end of stream, we must flush the decoder buffers */
@@ -4164,13 +5274,23 @@ static int transcode(void)
         }
     }
     flush_encoders();
+#if HAVE_PTHREADS
+    stop_mux_threads();
+#endif
 
     term_exit();
 
     /* write the trailer if needed and close file */
     for (i = 0; i < nb_output_files; i++) {
+        StageTimer timer;
+
+        if (output_files[i]->closed)
+            continue;
         os = output_files[i]->ctx;
-        if ((ret = av_write_trailer(os)) < 0) {
+        stage_timer_start(&timer);
+        ret = av_write_trailer(os);
+        stage_timer_stop(&output_files[i]->mux_stats, &timer);
+        if (ret < 0) {
             av_log(NULL, AV_LOG_ERROR, "Error writing trailer of %s: %s", os->filename, av_err2str(ret));
             if (exit_on_error)
                 exit_program(1);
@@ -4178,7 +5298,11 @@ static int transcode(void)
     }
 
     /* dump report by using the first video and audio streams */
-    print_report(1, timer_start, av_gettime_relative());
+    total_time = av_gettime_relative();
+    print_report(1, timer_start, total_time);
+    write_bench_report(1, timer_start, total_time);
+    if (do_benchmark)
+        print_bench_memory();
 
     /* close each encoder */
     for (i = 0; i < nb_output_streams; i++) {
@@ -4210,6 +5334,7 @@ static int transcode(void)
  fail:
 #if HAVE_PTHREADS
     free_input_threads();
+    stop_control_thread();
 #endif
 
     if (output_streams) {
@@ -4255,6 +5380,24 @@ static int64_t getutime(void)
 #endif
 }
 
+static int64_t getstime(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage rusage;
+
+    getrusage(RUSAGE_SELF, &rusage);
+    return (rusage.ru_stime.tv_sec * 1000000LL) + rusage.ru_stime.tv_usec;
+#elif HAVE_GETPROCESSTIMES
+    HANDLE proc;
+    FILETIME c, e, k, u;
+    proc = GetCurrentProcess();
+    GetProcessTimes(proc, &c, &e, &k, &u);
+    return ((int64_t) k.dwHighDateTime << 32 | k.dwLowDateTime) / 10;
+#else
+    return 0;
+#endif
+}
+
 static int64_t getmaxrss(void)
 {
 #if HAVE_GETRUSAGE && HAVE_STRUCT_RUSAGE_RU_MAXRSS
@@ -4280,7 +5423,7 @@ static void log_callback_null(void *ptr, int level, const char *fmt, va_list vl)
 int main(int argc, char **argv)
 {
     int ret;
-    int64_t ti;
+    int64_t ti, st, rt;
 
     register_exit(ffmpeg_cleanup);
 
@@ -4331,11 +5474,16 @@ int main(int argc, char **argv)
 //     }
 
     current_time = ti = getutime();
+    st = getstime();
+    rt = av_gettime_relative();
     if (transcode() < 0)
         exit_program(1);
     ti = getutime() - ti;
+    st = getstime() - st;
+    rt = av_gettime_relative() - rt;
     if (do_benchmark) {
-        av_log(NULL, AV_LOG_INFO, "bench: utime=%0.3fs\n", ti / 1000000.0);
+        av_log(NULL, AV_LOG_INFO, "bench: utime=%0.3fs stime=%0.3fs rtime=%0.3fs\n",
+               ti / 1000000.0, st / 1000000.0, rt / 1000000.0);
     }
     av_log(NULL, AV_LOG_DEBUG, "%"PRIu64" frames successfully decoded, %"PRIu64" decoding errors\n",
            decode_error_stat[0], decode_error_stat[1]);
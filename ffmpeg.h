@@ -117,6 +117,7 @@ typedef struct OptionsContext {
     int rate_emu;
     int accurate_seek;
     int thread_queue_size;
+    int program_queues;
 
     SpecifierOpt *ts_scale;
     int        nb_ts_scale;
@@ -148,6 +149,8 @@ typedef struct OptionsContext {
     float mux_preload;
     float mux_max_delay;
     int shortest;
+    int pace;
+    float pace_burst;
 
     int video_disable;
     int audio_disable;
@@ -218,6 +221,10 @@ typedef struct OptionsContext {
     int        nb_disposition;
     SpecifierOpt *program;
     int        nb_program;
+    SpecifierOpt *chunk_frames;
+    int        nb_chunk_frames;
+    SpecifierOpt *chunk_threads;
+    int        nb_chunk_threads;
 } OptionsContext;
 
 typedef struct InputFilter {
@@ -238,6 +245,31 @@ typedef struct OutputFilter {
     enum AVMediaType     type;
 } OutputFilter;
 
+#define STAGE_STATS_NB_BINS 160
+
+/* time spent in one processing stage, for -bench_report */
+typedef struct StageStats {
+    int64_t nb_calls;
+    int64_t wall_time;          /* in microseconds */
+    int64_t cpu_time;           /* of the calling thread, in microseconds */
+    int     has_cpu_time;
+    int64_t max_time;
+    /* number of calls per duration, in quarters of powers of 2 */
+    uint32_t time_bins[STAGE_STATS_NB_BINS];
+
+    /* depth of the queue feeding the stage, sampled at each input */
+    int64_t queue_depth_sum;
+    int64_t nb_queue_samples;
+    int     max_queue_depth;
+} StageStats;
+
+typedef struct StageTimer {
+    int64_t wall_time;
+    int64_t cpu_time;
+} StageTimer;
+
+typedef struct ChunkEncoder ChunkEncoder;
+
 typedef struct FilterGraph {
     int            index;
     const char    *graph_desc;
@@ -249,6 +281,9 @@ typedef struct FilterGraph {
     int          nb_inputs;
     OutputFilter **outputs;
     int         nb_outputs;
+
+    StageStats   *filter_stats;     /* indexed as graph->filters */
+    int        nb_filter_stats;
 } FilterGraph;
 
 typedef struct InputStream {
@@ -343,6 +378,13 @@ typedef struct InputStream {
     // number of frames/samples retrieved from the decoder
     uint64_t frames_decoded;
     uint64_t samples_decoded;
+
+    StageStats dec_stats;
+
+    /* dts of the drain packets sent at EOF, for the frames returned without
+     * a timestamp while draining the decoder */
+    int64_t *dts_buffer;
+    int nb_dts_buffer;
 } InputStream;
 
 typedef struct InputFile {
@@ -365,6 +407,7 @@ typedef struct InputFile {
                              from ctx.nb_streams if new streams appear during av_read_frame() */
     int nb_streams_warn;  /* number of streams that the user was warned of */
     int rate_emu;
+    int64_t rate_emu_wakeup; /* wall clock time at which -re lets the next packet through */
     int accurate_seek;
 
 #if HAVE_PTHREADS
@@ -373,6 +416,15 @@ typedef struct InputFile {
     int non_blocking;           /* reading packets from the thread should not block */
     int joined;                 /* the thread has been joined */
     int thread_queue_size;      /* maximum number of queued packets */
+
+    /* with -program_queues, the thread queues the packets of each program
+     * separately instead of using in_thread_queue, the last queue getting the
+     * packets of the streams which are in no program */
+    int program_queues;
+    AVThreadMessageQueue **prg_queues;
+    int nb_prg_queues;
+    int *stream_prg_queue;      /* index in prg_queues of each stream */
+    int next_prg_queue;         /* queue to read the next packet from first */
 #endif
 } InputFile;
 
@@ -484,8 +536,30 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+    StageStats enc_stats;
+
+    /* encoding of the video frames in chunks by several encoder instances */
+    int chunk_frames;
+    int chunk_threads;
+    ChunkEncoder *chunk_enc;
+
+#if HAVE_PTHREADS
+    AVThreadMessageQueue *enc_frame_queue; /* frames sent to the encoder thread */
+    AVThreadMessageQueue *enc_pkt_queue;   /* packets sent back to the main thread */
+    pthread_t enc_thread;                  /* thread running this stream's encoder */
+    int enc_thread_running;                /* the encoder thread has been started and not joined */
+#endif
 } OutputStream;
 
+#define MUX_BATCH_SIZE 32
+
+/* packets handed over to a muxing thread together */
+typedef struct MuxBatch {
+    int nb_packets;
+    AVPacket packets[MUX_BATCH_SIZE];
+} MuxBatch;
+
 typedef struct OutputFile {
     AVFormatContext *ctx;
     AVDictionary *opts;
@@ -495,6 +569,24 @@ typedef struct OutputFile {
     uint64_t limit_filesize; /* filesize limit expressed in bytes */
 
     int shortest;
+    int closed;          /* removed while transcoding, nothing more is written */
+
+    int pace;            /* release packets to the muxer in realtime, by DTS */
+    int64_t pace_burst;  /* how far ahead of realtime packets may be released, in microseconds */
+    int64_t pace_start;  /* wall clock time matching pace_dts, AV_NOPTS_VALUE until the first packet */
+    int64_t pace_dts;
+
+    StageStats mux_stats;
+
+#if HAVE_PTHREADS
+    AVThreadMessageQueue *mux_queue;  /* packet batches sent to the muxing thread */
+    MuxBatch *mux_batch;              /* packets collected but not sent yet */
+    pthread_t mux_thread;             /* thread muxing this file, with -mux_threads */
+    int mux_thread_running;
+    int mux_thread_ret;               /* muxing error, valid once the thread is joined */
+    pthread_mutex_t mux_pos_lock;
+    int64_t mux_pos;                  /* bytes written by the muxing thread so far */
+#endif
 } OutputFile;
 
 extern InputStream **input_streams;
@@ -534,6 +626,14 @@ extern int exit_on_error;
 extern int abort_on_flags;
 extern int print_stats;
 extern int qp_hist;
+extern int parallel_encode;
+extern int filter_branch_threads;
+extern int mux_threads;
+extern char *filter_thread_affinity;
+extern int shared_threads;
+extern char *bench_report_filename;
+extern float bench_report_period;
+extern char *control_url;
 extern int stdin_interaction;
 extern int frame_bits_per_raw_sample;
 extern AVIOContext *progress_avio;
@@ -558,6 +658,7 @@ void remove_avoptions(AVDictionary **a, AVDictionary *b);
 void assert_avoptions(AVDictionary *m);
 
 int guess_input_channel_layout(InputStream *ist);
+int use_shared_executor(AVExecutor **executor);
 
 enum AVPixelFormat choose_pixel_fmt(AVStream *st, AVCodecContext *avctx, AVCodec *codec, enum AVPixelFormat target);
 void choose_sample_fmt(AVStream *st, AVCodec *codec);
@@ -565,10 +666,42 @@ void choose_sample_fmt(AVStream *st, AVCodec *codec);
 int configure_filtergraph(FilterGraph *fg);
 int configure_output_filter(FilterGraph *fg, OutputFilter *ofilter, AVFilterInOut *out);
 int ist_in_filtergraph(FilterGraph *fg, InputStream *ist);
+/**
+ * Let the graph take the frames of ist with the size and format of frame
+ * without being configured again, if possible.
+ * @return 1 if it was possible, 0 if the graph must be configured again,
+ *         a negative error code on failure
+ */
+int filtergraph_renegotiate_input(FilterGraph *fg, InputStream *ist,
+                                  const AVFrame *frame);
 FilterGraph *init_simple_filtergraph(InputStream *ist, OutputStream *ost);
+/**
+ * Disconnect a simple filtergraph from its input stream and free the graph,
+ * for an output removed while transcoding.
+ */
+void close_simple_filtergraph(FilterGraph *fg);
 int init_complex_filtergraph(FilterGraph *fg);
 
 int ffmpeg_parse_options(int argc, char **argv);
+/**
+ * Open one more output file while transcoding, from the options and the
+ * output filename in argv, which only output options are allowed in.
+ */
+int ffmpeg_parse_output_options(int argc, char **argv);
+
+void stage_timer_start(StageTimer *t);
+void stage_timer_stop(StageStats *st, const StageTimer *t);
+void stage_stats_add_queue_depth(StageStats *st, int depth);
+void bench_report_filter_frame_time(AVFilterContext *filter, int64_t time);
+int  bench_report_init_filtergraph(FilterGraph *fg);
+void write_bench_report(int is_last_report, int64_t timer_start, int64_t cur_time);
+void print_bench_memory(void);
+void bench_report_uninit(void);
+
+int  chunk_encoder_init(OutputStream *ost);
+int  chunk_encode_video(OutputStream *ost, AVPacket *pkt, const AVFrame *frame,
+                        int *got_packet);
+void chunk_encoder_free(OutputStream *ost);
 
 int vdpau_init(AVCodecContext *s);
 int dxva2_init(AVCodecContext *s);
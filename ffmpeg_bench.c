@@ -0,0 +1,343 @@
+/*
+ * ffmpeg per-stage profiling report
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ffmpeg.h"
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#if HAVE_PTHREADS
+/* the encoder threads and the filtergraph branch threads update their
+ * stages while the main thread may be writing a report */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+#define STATS_LOCK()   pthread_mutex_lock(&stats_lock)
+#define STATS_UNLOCK() pthread_mutex_unlock(&stats_lock)
+#else
+#define STATS_LOCK()
+#define STATS_UNLOCK()
+#endif
+
+static FILE *bench_report_file;
+static int bench_report_failed;
+static int64_t last_report_time = AV_NOPTS_VALUE;
+
+static int64_t get_thread_cpu_time(void)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+
+    if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+#endif
+    return AV_NOPTS_VALUE;
+}
+
+/* 4 bins per power of 2: 1, 1.25, 1.5, 1.75, 2, 2.5, ... microseconds */
+static int time_to_bin(int64_t t)
+{
+    int l;
+
+    if (t <= 0)
+        return 0;
+    l = av_log2(FFMIN(t, INT_MAX));
+    return FFMIN(1 + 4 * l + (int)(((t << 2) >> l) & 3), STAGE_STATS_NB_BINS - 1);
+}
+
+/* upper bound of the durations counted in a bin */
+static int64_t bin_to_time(int bin)
+{
+    int l, sub;
+
+    if (!bin)
+        return 0;
+    l   = (bin - 1) / 4;
+    sub = (bin - 1) % 4;
+    return ((int64_t)(4 + sub + 1) << l) >> 2;
+}
+
+static void stage_stats_add(StageStats *st, int64_t wall_time, int64_t cpu_time)
+{
+    STATS_LOCK();
+    st->nb_calls++;
+    st->wall_time += wall_time;
+    if (cpu_time != AV_NOPTS_VALUE) {
+        st->cpu_time += cpu_time;
+        st->has_cpu_time = 1;
+    }
+    st->max_time   = FFMAX(st->max_time, wall_time);
+    st->time_bins[time_to_bin(wall_time)]++;
+    STATS_UNLOCK();
+}
+
+void stage_timer_start(StageTimer *t)
+{
+    if (!bench_report_filename)
+        return;
+    t->wall_time = av_gettime_relative();
+    t->cpu_time  = get_thread_cpu_time();
+}
+
+void stage_timer_stop(StageStats *st, const StageTimer *t)
+{
+    int64_t cpu_time = AV_NOPTS_VALUE;
+
+    if (!bench_report_filename)
+        return;
+    if (t->cpu_time != AV_NOPTS_VALUE)
+        cpu_time = get_thread_cpu_time() - t->cpu_time;
+    stage_stats_add(st, av_gettime_relative() - t->wall_time, cpu_time);
+}
+
+void stage_stats_add_queue_depth(StageStats *st, int depth)
+{
+    if (!bench_report_filename || depth < 0)
+        return;
+    STATS_LOCK();
+    st->queue_depth_sum += depth;
+    st->nb_queue_samples++;
+    st->max_queue_depth  = FFMAX(st->max_queue_depth, depth);
+    STATS_UNLOCK();
+}
+
+void bench_report_filter_frame_time(AVFilterContext *filter, int64_t time)
+{
+    FilterGraph *fg = filter->graph->opaque;
+    int i;
+
+    for (i = 0; i < fg->nb_filter_stats; i++) {
+        if (fg->graph->filters[i] == filter) {
+            /* the CPU time of the filter is not measured separately */
+            stage_stats_add(&fg->filter_stats[i], time, AV_NOPTS_VALUE);
+            break;
+        }
+    }
+}
+
+int bench_report_init_filtergraph(FilterGraph *fg)
+{
+    if (!bench_report_filename)
+        return 0;
+
+    /* the filters may have changed with the reconfiguration of the graph */
+    av_freep(&fg->filter_stats);
+    fg->nb_filter_stats = 0;
+    fg->filter_stats = av_mallocz_array(fg->graph->nb_filters, sizeof(*fg->filter_stats));
+    if (!fg->filter_stats)
+        return AVERROR(ENOMEM);
+    fg->nb_filter_stats = fg->graph->nb_filters;
+
+    fg->graph->opaque            = fg;
+    fg->graph->filter_frame_time = bench_report_filter_frame_time;
+    return 0;
+}
+
+static int64_t stats_percentile(const StageStats *st, double p)
+{
+    int64_t target = ceil(st->nb_calls * p), count = 0;
+    int i;
+
+    for (i = 0; i < STAGE_STATS_NB_BINS; i++) {
+        count += st->time_bins[i];
+        if (count >= target)
+            return FFMIN(bin_to_time(i), st->max_time);
+    }
+    return st->max_time;
+}
+
+static void print_json_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; s && *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(f, "\\u%04x", *s);
+        else
+            fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+static void print_stage_stats(FILE *f, const StageStats *st)
+{
+    fprintf(f, "\"calls\":%"PRId64",\"wall_us\":%"PRId64, st->nb_calls, st->wall_time);
+    if (st->has_cpu_time)
+        fprintf(f, ",\"cpu_us\":%"PRId64, st->cpu_time);
+    if (st->nb_calls)
+        fprintf(f, ",\"mean_us\":%"PRId64",\"p50_us\":%"PRId64
+                   ",\"p90_us\":%"PRId64",\"p99_us\":%"PRId64",\"max_us\":%"PRId64,
+                st->wall_time / st->nb_calls,
+                stats_percentile(st, 0.50), stats_percentile(st, 0.90),
+                stats_percentile(st, 0.99), st->max_time);
+    if (st->nb_queue_samples)
+        fprintf(f, ",\"queue_depth_mean\":%.2f,\"queue_depth_max\":%d",
+                (double)st->queue_depth_sum / st->nb_queue_samples,
+                st->max_queue_depth);
+}
+
+/*
+ * Write one report, as a single line of JSON, either each
+ * -bench_report_period seconds or at the end.
+ */
+void write_bench_report(int is_last_report, int64_t timer_start, int64_t cur_time)
+{
+    FILE *f;
+    int i, j, first;
+
+    if (!bench_report_filename || bench_report_failed)
+        return;
+    if (!is_last_report) {
+        if (bench_report_period <= 0)
+            return;
+        if (last_report_time == AV_NOPTS_VALUE)
+            last_report_time = timer_start;
+        if (cur_time - last_report_time < bench_report_period * 1000000)
+            return;
+    }
+    last_report_time = cur_time;
+
+    if (!bench_report_file) {
+        bench_report_file = fopen(bench_report_filename, "w");
+        if (!bench_report_file) {
+            av_log(NULL, AV_LOG_ERROR, "Cannot open %s for the benchmark report: %s\n",
+                   bench_report_filename, strerror(errno));
+            bench_report_failed = 1;
+            return;
+        }
+    }
+    f = bench_report_file;
+
+    STATS_LOCK();
+    fprintf(f, "{\"time\":%.3f,\"final\":%s,\"decoders\":[",
+            (cur_time - timer_start) / 1000000.0, is_last_report ? "true" : "false");
+    for (i = 0, first = 1; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+        if (!ist->decoding_needed)
+            continue;
+        fprintf(f, "%s{\"stream\":\"%d:%d\",\"codec\":", first ? "" : ",",
+                ist->file_index, ist->st->index);
+        print_json_string(f, ist->dec ? ist->dec->name : NULL);
+        fputc(',', f);
+        print_stage_stats(f, &ist->dec_stats);
+        fputc('}', f);
+        first = 0;
+    }
+
+    fprintf(f, "],\"filters\":[");
+    for (i = 0, first = 1; i < nb_filtergraphs; i++) {
+        FilterGraph *fg = filtergraphs[i];
+        for (j = 0; j < fg->nb_filter_stats; j++) {
+            AVFilterContext *filter = fg->graph->filters[j];
+            /* the sources get their frames from ffmpeg, not from a filter */
+            if (!filter->nb_inputs)
+                continue;
+            fprintf(f, "%s{\"graph\":%d,\"name\":", first ? "" : ",", fg->index);
+            print_json_string(f, filter->name);
+            fprintf(f, ",\"filter\":");
+            print_json_string(f, filter->filter->name);
+            fputc(',', f);
+            print_stage_stats(f, &fg->filter_stats[j]);
+            fputc('}', f);
+            first = 0;
+        }
+    }
+
+    fprintf(f, "],\"encoders\":[");
+    for (i = 0, first = 1; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        if (!ost->encoding_needed)
+            continue;
+        fprintf(f, "%s{\"stream\":\"%d:%d\",\"codec\":", first ? "" : ",",
+                ost->file_index, ost->index);
+        print_json_string(f, ost->enc ? ost->enc->name : NULL);
+        fputc(',', f);
+        print_stage_stats(f, &ost->enc_stats);
+        fputc('}', f);
+        first = 0;
+    }
+
+    fprintf(f, "],\"muxers\":[");
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+        fprintf(f, "%s{\"file\":%d,\"format\":", i ? "," : "", i);
+        print_json_string(f, of->ctx->oformat->name);
+        fputc(',', f);
+        print_stage_stats(f, &of->mux_stats);
+        fputc('}', f);
+    }
+    fprintf(f, "]}\n");
+    STATS_UNLOCK();
+
+    fflush(f);
+}
+
+/*
+ * Print the peak heap usage of each codec and filtergraph for -benchmark,
+ * when libavutil was built with --enable-memory-tracking.
+ */
+void print_bench_memory(void)
+{
+    int64_t current, peak;
+    int i;
+
+    if (av_mem_get_usage(NULL, &current, &peak) < 0)
+        return;
+    av_log(NULL, AV_LOG_INFO, "bench: mem peak=%"PRId64"kB\n", peak >> 10);
+
+    for (i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+        if (ist->decoding_needed &&
+            av_mem_get_usage(ist->dec_ctx, &current, &peak) >= 0)
+            av_log(NULL, AV_LOG_INFO, "bench: mem decoder %d:%d (%s) peak=%"PRId64"kB\n",
+                   ist->file_index, ist->st->index, ist->dec->name, peak >> 10);
+    }
+    for (i = 0; i < nb_filtergraphs; i++) {
+        FilterGraph *fg = filtergraphs[i];
+        if (fg->graph && av_mem_get_usage(fg->graph, &current, &peak) >= 0)
+            av_log(NULL, AV_LOG_INFO, "bench: mem filtergraph %d peak=%"PRId64"kB\n",
+                   fg->index, peak >> 10);
+    }
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        if (ost->encoding_needed &&
+            av_mem_get_usage(ost->enc_ctx, &current, &peak) >= 0)
+            av_log(NULL, AV_LOG_INFO, "bench: mem encoder %d:%d (%s) peak=%"PRId64"kB\n",
+                   ost->file_index, ost->index, ost->enc->name, peak >> 10);
+    }
+}
+
+void bench_report_uninit(void)
+{
+    if (bench_report_file) {
+        if (fclose(bench_report_file))
+            av_log(NULL, AV_LOG_ERROR, "Error closing the benchmark report file: %s\n",
+                   av_err2str(AVERROR(errno)));
+        bench_report_file = NULL;
+    }
+    av_freep(&bench_report_filename);
+}
@@ -0,0 +1,372 @@
+/*
+ * ffmpeg chunked parallel video encoding
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * With -chunk_frames, the frames of a video output stream are cut into
+ * chunks, and every chunk is encoded in one of -chunk_threads threads by a
+ * fresh instance of the encoder, which starts it with a key frame. The
+ * packets are handed back in chunk order, as if they came out of a single
+ * encoder.
+ */
+
+#include <string.h>
+
+#include "ffmpeg.h"
+
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+
+#if HAVE_PTHREADS
+
+typedef struct Chunk {
+    AVFrame **frames;
+    int nb_frames;
+    AVFifoBuffer *pkts;             /* AVPacket, in coding order */
+    int ret;
+    int finished;
+    struct Chunk *next;
+} Chunk;
+
+struct ChunkEncoder {
+    OutputStream *ost;
+    AVCodecContext *config;         /* unopened copy of the encoder settings */
+    AVDictionary *opts;
+
+    pthread_t *threads;
+    int nb_threads;
+    AVThreadMessageQueue *queue;    /* Chunk *, waiting for a thread */
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    Chunk *filling;                 /* chunk receiving the next frames */
+    Chunk *head, *tail;             /* chunks sent to the threads, oldest first */
+    int nb_sent;
+
+    AVFifoBuffer *pts_fifo;         /* pts of the frames not used as a dts yet */
+    int64_t nb_packets;
+};
+
+static void free_chunk_frames(Chunk *chunk)
+{
+    int i;
+
+    for (i = 0; i < chunk->nb_frames; i++)
+        av_frame_free(&chunk->frames[i]);
+    chunk->nb_frames = 0;
+}
+
+static void free_chunk(Chunk **pchunk)
+{
+    Chunk *chunk = *pchunk;
+    AVPacket pkt;
+
+    if (!chunk)
+        return;
+    free_chunk_frames(chunk);
+    while (chunk->pkts && av_fifo_size(chunk->pkts) >= sizeof(pkt)) {
+        av_fifo_generic_read(chunk->pkts, &pkt, sizeof(pkt), NULL);
+        av_packet_unref(&pkt);
+    }
+    av_fifo_freep(&chunk->pkts);
+    av_freep(&chunk->frames);
+    av_freep(pchunk);
+}
+
+static Chunk *alloc_chunk(int nb_frames)
+{
+    Chunk *chunk = av_mallocz(sizeof(*chunk));
+
+    if (!chunk)
+        return NULL;
+    chunk->frames = av_malloc_array(nb_frames, sizeof(*chunk->frames));
+    chunk->pkts   = av_fifo_alloc_array(nb_frames, sizeof(AVPacket));
+    if (!chunk->frames || !chunk->pkts)
+        free_chunk(&chunk);
+    return chunk;
+}
+
+/* Returns 1 if a packet was stored, 0 if not, or a negative error code. */
+static int encode_chunk_frame(AVCodecContext *enc, Chunk *chunk, AVFrame *frame)
+{
+    AVPacket pkt;
+    int got_packet, ret;
+
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+    ret = avcodec_encode_video2(enc, &pkt, frame, &got_packet);
+    if (ret < 0 || !got_packet)
+        return ret < 0 ? ret : 0;
+    if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+        pkt.pts = frame->pts;
+
+    if (av_fifo_space(chunk->pkts) < sizeof(pkt) &&
+        (ret = av_fifo_grow(chunk->pkts, av_fifo_size(chunk->pkts) + sizeof(pkt))) < 0) {
+        av_packet_unref(&pkt);
+        return ret;
+    }
+    av_fifo_generic_write(chunk->pkts, &pkt, sizeof(pkt), NULL);
+    return 1;
+}
+
+static int encode_chunk(ChunkEncoder *ce, Chunk *chunk)
+{
+    AVCodecContext *enc = avcodec_alloc_context3(ce->ost->enc);
+    AVDictionary *opts = NULL;
+    int i, ret;
+
+    if (!enc)
+        return AVERROR(ENOMEM);
+    if ((ret = avcodec_copy_context(enc, ce->config)) < 0)
+        goto end;
+    av_dict_copy(&opts, ce->opts, 0);
+    ret = avcodec_open2(enc, ce->ost->enc, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        goto end;
+
+    for (i = 0; i < chunk->nb_frames && ret >= 0; i++)
+        ret = encode_chunk_frame(enc, chunk, chunk->frames[i]);
+    if (ret >= 0) {
+        do {
+            ret = encode_chunk_frame(enc, chunk, NULL);
+        } while (ret > 0);
+    }
+
+end:
+    avcodec_free_context(&enc);
+    return ret;
+}
+
+static void *chunk_thread(void *arg)
+{
+    ChunkEncoder *ce = arg;
+    Chunk *chunk;
+
+    while (av_thread_message_queue_recv(ce->queue, &chunk, 0) >= 0) {
+        int ret = encode_chunk(ce, chunk);
+
+        free_chunk_frames(chunk);
+
+        pthread_mutex_lock(&ce->lock);
+        chunk->ret      = ret;
+        chunk->finished = 1;
+        pthread_cond_broadcast(&ce->cond);
+        pthread_mutex_unlock(&ce->lock);
+    }
+
+    return NULL;
+}
+
+int chunk_encoder_init(OutputStream *ost)
+{
+    ChunkEncoder *ce;
+    int i, ret;
+
+    if (ost->enc_ctx->flags & (AV_CODEC_FLAG_PASS1 | AV_CODEC_FLAG_PASS2)) {
+        av_log(NULL, AV_LOG_ERROR, "Chunked encoding does not support 2-pass encoding\n");
+        return AVERROR(EINVAL);
+    }
+
+    ce = ost->chunk_enc = av_mallocz(sizeof(*ce));
+    if (!ce)
+        return AVERROR(ENOMEM);
+    ce->ost = ost;
+
+    ce->config   = avcodec_alloc_context3(ost->enc);
+    ce->pts_fifo = av_fifo_alloc_array(ost->chunk_frames, sizeof(int64_t));
+    if (!ce->config || !ce->pts_fifo)
+        return AVERROR(ENOMEM);
+    /* taken before the main encoder is opened, so that every instance is
+     * set up from the same settings and options */
+    if ((ret = avcodec_copy_context(ce->config, ost->enc_ctx)) < 0 ||
+        (ret = av_dict_copy(&ce->opts, ost->encoder_opts, 0)) < 0)
+        return ret;
+
+    ce->nb_threads = ost->chunk_threads > 0 ? ost->chunk_threads : av_cpu_count();
+    ce->threads    = av_malloc_array(ce->nb_threads, sizeof(*ce->threads));
+    if (!ce->threads)
+        return AVERROR(ENOMEM);
+    if ((ret = av_thread_message_queue_alloc(&ce->queue, ce->nb_threads,
+                                             sizeof(Chunk *))) < 0)
+        return ret;
+    pthread_mutex_init(&ce->lock, NULL);
+    pthread_cond_init(&ce->cond, NULL);
+
+    for (i = 0; i < ce->nb_threads; i++) {
+        if ((ret = pthread_create(&ce->threads[i], NULL, chunk_thread, ce))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+            ce->nb_threads = i;
+            return AVERROR(ret);
+        }
+    }
+
+    av_log(NULL, AV_LOG_VERBOSE, "Encoding output stream #%d:%d in chunks of %d frames "
+           "with %d threads\n", ost->file_index, ost->index, ost->chunk_frames,
+           ce->nb_threads);
+    return 0;
+}
+
+static int send_chunk(ChunkEncoder *ce)
+{
+    Chunk *chunk = ce->filling;
+    int ret;
+
+    ce->filling = NULL;
+    if ((ret = av_thread_message_queue_send(ce->queue, &chunk, 0)) < 0) {
+        free_chunk(&chunk);
+        return ret;
+    }
+    if (ce->tail)
+        ce->tail->next = chunk;
+    else
+        ce->head = chunk;
+    ce->tail = chunk;
+    ce->nb_sent++;
+    return 0;
+}
+
+/*
+ * Every instance starts with its own reordering delay, so the dts are
+ * recomputed over the whole stream: the dts of a packet is the pts of the
+ * frame coming reorder-delay frames earlier in presentation order, which
+ * keeps them increasing and never above the pts.
+ */
+static void set_packet_dts(ChunkEncoder *ce, AVPacket *pkt)
+{
+    int delay = ce->ost->enc_ctx->has_b_frames;
+
+    if (ce->nb_packets++ >= delay && av_fifo_size(ce->pts_fifo) >= sizeof(int64_t))
+        av_fifo_generic_read(ce->pts_fifo, &pkt->dts, sizeof(int64_t), NULL);
+}
+
+int chunk_encode_video(OutputStream *ost, AVPacket *pkt, const AVFrame *frame,
+                       int *got_packet)
+{
+    ChunkEncoder *ce = ost->chunk_enc;
+    int ret;
+
+    *got_packet = 0;
+
+    if (frame) {
+        AVFrame *clone;
+
+        if (!ce->filling && !(ce->filling = alloc_chunk(ost->chunk_frames)))
+            return AVERROR(ENOMEM);
+        if (!(clone = av_frame_clone(frame)))
+            return AVERROR(ENOMEM);
+        ce->filling->frames[ce->filling->nb_frames++] = clone;
+
+        if (av_fifo_space(ce->pts_fifo) < sizeof(int64_t) &&
+            (ret = av_fifo_grow(ce->pts_fifo, av_fifo_size(ce->pts_fifo))) < 0)
+            return ret;
+        av_fifo_generic_write(ce->pts_fifo, &clone->pts, sizeof(int64_t), NULL);
+    }
+
+    if (ce->filling && (ce->filling->nb_frames == ost->chunk_frames || !frame) &&
+        (ret = send_chunk(ce)) < 0)
+        return ret;
+
+    while (ce->head) {
+        Chunk *chunk = ce->head;
+        /* only block once every thread has a chunk, or when flushing */
+        int wait = !frame || ce->nb_sent > ce->nb_threads;
+        int finished;
+
+        pthread_mutex_lock(&ce->lock);
+        while (wait && !chunk->finished)
+            pthread_cond_wait(&ce->cond, &ce->lock);
+        finished = chunk->finished;
+        pthread_mutex_unlock(&ce->lock);
+        if (!finished)
+            return 0;
+
+        if (av_fifo_size(chunk->pkts) >= sizeof(*pkt)) {
+            av_fifo_generic_read(chunk->pkts, pkt, sizeof(*pkt), NULL);
+            set_packet_dts(ce, pkt);
+            *got_packet = 1;
+            return 0;
+        }
+
+        ret = chunk->ret;
+        ce->head = chunk->next;
+        if (!ce->head)
+            ce->tail = NULL;
+        ce->nb_sent--;
+        free_chunk(&chunk);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+void chunk_encoder_free(OutputStream *ost)
+{
+    ChunkEncoder *ce = ost->chunk_enc;
+    int i;
+
+    if (!ce)
+        return;
+
+    if (ce->queue) {
+        /* the chunks not taken by a thread yet are freed with the list */
+        av_thread_message_flush(ce->queue);
+        av_thread_message_queue_set_err_recv(ce->queue, AVERROR_EOF);
+        for (i = 0; i < ce->nb_threads; i++)
+            pthread_join(ce->threads[i], NULL);
+        pthread_cond_destroy(&ce->cond);
+        pthread_mutex_destroy(&ce->lock);
+        av_thread_message_queue_free(&ce->queue);
+    }
+    while (ce->head) {
+        Chunk *chunk = ce->head;
+        ce->head = chunk->next;
+        free_chunk(&chunk);
+    }
+    free_chunk(&ce->filling);
+
+    av_fifo_freep(&ce->pts_fifo);
+    av_dict_free(&ce->opts);
+    avcodec_free_context(&ce->config);
+    av_freep(&ce->threads);
+    av_freep(&ost->chunk_enc);
+}
+
+#else
+
+int chunk_encoder_init(OutputStream *ost)
+{
+    av_log(NULL, AV_LOG_ERROR, "Chunked encoding needs pthreads\n");
+    return AVERROR(ENOSYS);
+}
+
+int chunk_encode_video(OutputStream *ost, AVPacket *pkt, const AVFrame *frame,
+                       int *got_packet)
+{
+    return AVERROR(ENOSYS);
+}
+
+void chunk_encoder_free(OutputStream *ost)
+{
+}
+
+#endif /* HAVE_PTHREADS */
@@ -24,6 +24,7 @@
 
 #include "libavfilter/avfilter.h"
 #include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
 
 #include "libavresample/avresample.h"
 
@@ -38,6 +39,10 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/samplefmt.h"
 
+#if CONFIG_SWSCALE
+#include "libswscale/swscale.h"
+#endif
+
 
 static const enum AVPixelFormat *get_compliance_unofficial_pix_fmts(enum AVCodecID codec_id, const enum AVPixelFormat default_formats[])
 {
@@ -224,6 +229,28 @@ FilterGraph *init_simple_filtergraph(InputStream *ist, OutputStream *ost)
     return fg;
 }
 
+void close_simple_filtergraph(FilterGraph *fg)
+{
+    InputStream *ist = fg->inputs[0]->ist;
+    int i;
+
+    for (i = 0; i < ist->nb_filters; i++) {
+        if (ist->filters[i] == fg->inputs[0]) {
+            memmove(&ist->filters[i], &ist->filters[i + 1],
+                    (ist->nb_filters - i - 1) * sizeof(*ist->filters));
+            ist->nb_filters--;
+            break;
+        }
+    }
+
+    avfilter_graph_free(&fg->graph);
+    fg->inputs[0]->filter  = NULL;
+    fg->outputs[0]->filter = NULL;
+    /* the statistics are indexed by the filters of the freed graph */
+    av_freep(&fg->filter_stats);
+    fg->nb_filter_stats = 0;
+}
+
 static void init_input_filter(FilterGraph *fg, AVFilterInOut *in)
 {
     InputStream *ist = NULL;
@@ -969,6 +996,13 @@ int configure_filtergraph(FilterGraph *fg)
     avfilter_graph_free(&fg->graph);
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
+    if (filter_branch_threads)
+        fg->graph->thread_type |= AVFILTER_THREAD_BRANCH;
+    if (filter_thread_affinity &&
+        (ret = av_opt_set(fg->graph, "thread_affinity", filter_thread_affinity, 0)) < 0)
+        return ret;
+    if ((ret = use_shared_executor(&fg->graph->executor)) < 0)
+        return ret;
 
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
@@ -1049,6 +1083,8 @@ int configure_filtergraph(FilterGraph *fg)
 
     if ((ret = avfilter_graph_config(fg->graph, NULL)) < 0)
         return ret;
+    if ((ret = bench_report_init_filtergraph(fg)) < 0)
+        return ret;
 
     fg->reconfiguration = 1;
 
@@ -1070,6 +1106,115 @@ int configure_filtergraph(FilterGraph *fg)
     return 0;
 }
 
+/* filters passing video frames through regardless of their size */
+static int filter_is_size_agnostic(AVFilterContext *ctx, const AVFrame *frame)
+{
+    const char *name = ctx->filter->name;
+
+    if (ctx->nb_inputs != 1 || ctx->nb_outputs != 1)
+        return 0;
+    if (!strcmp(name, "null") || !strcmp(name, "copy") ||
+        !strcmp(name, "trim") || !strcmp(name, "setpts"))
+        return 1;
+    return !strcmp(name, "format") && ctx->inputs[0]->format == frame->format;
+}
+
+/* whether a scale filter option is a size not depending on the input */
+static int scale_size_is_constant(AVFilterContext *scale, const char *name)
+{
+    uint8_t *str;
+    char *end;
+    long val;
+
+    if (av_opt_get(scale->priv, name, 0, &str) < 0)
+        return 0;
+    val = strtol(str, &end, 10);
+    val = !*end && end != (char *)str && val > 0;
+    av_free(str);
+    return val;
+}
+
+/*
+ * Check whether the video frames of an input can change their size or
+ * format without configuring the graph again: this is the case when they
+ * reach a scale filter through filters which do not depend on them, the
+ * scaler then reinitializing itself for the new input while its output,
+ * and so the rest of the graph, is unchanged. If apply is set, update the
+ * links up to the scaler.
+ */
+static int ifilter_renegotiate(InputFilter *ifilter, const AVFrame *frame,
+                               int apply)
+{
+#if CONFIG_SWSCALE
+    AVFilterContext *cur = ifilter->filter;
+    AVFilterLink *links[16];
+    int nb_links = 0, i, ret;
+    int64_t val;
+
+    if (cur->outputs[0]->type != AVMEDIA_TYPE_VIDEO || frame->hw_frames_ctx ||
+        !sws_isSupportedInput(frame->format))
+        return 0;
+
+    for (;;) {
+        if (cur->nb_outputs != 1 || nb_links == FF_ARRAY_ELEMS(links))
+            return 0;
+        links[nb_links++] = cur->outputs[0];
+        cur = cur->outputs[0]->dst;
+        if (!strcmp(cur->filter->name, "scale"))
+            break;
+        if (!filter_is_size_agnostic(cur, frame))
+            return 0;
+    }
+    /* the output size must not depend on the input one */
+    if (av_opt_get_int(cur->priv, "eval", 0, &val) < 0 || val ||
+        av_opt_get_int(cur->priv, "force_original_aspect_ratio", 0, &val) < 0 || val ||
+        !scale_size_is_constant(cur, "w") || !scale_size_is_constant(cur, "h"))
+        return 0;
+
+    if (apply) {
+        AVBufferSrcParameters *par = av_buffersrc_parameters_alloc();
+        if (!par)
+            return AVERROR(ENOMEM);
+        par->format              = frame->format;
+        par->width               = frame->width;
+        par->height              = frame->height;
+        par->sample_aspect_ratio = frame->sample_aspect_ratio;
+        ret = av_buffersrc_parameters_set(ifilter->filter, par);
+        av_freep(&par);
+        if (ret < 0)
+            return ret;
+
+        /* the scaler detects the change on its own input link */
+        for (i = 0; i < nb_links - 1; i++) {
+            links[i]->format              = frame->format;
+            links[i]->w                   = frame->width;
+            links[i]->h                   = frame->height;
+            links[i]->sample_aspect_ratio = frame->sample_aspect_ratio;
+        }
+    }
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+int filtergraph_renegotiate_input(FilterGraph *fg, InputStream *ist,
+                                  const AVFrame *frame)
+{
+    int i, ret;
+
+    if (!fg->graph)
+        return 0;
+    for (i = 0; i < fg->nb_inputs; i++)
+        if (fg->inputs[i]->ist == ist && !ifilter_renegotiate(fg->inputs[i], frame, 0))
+            return 0;
+    for (i = 0; i < fg->nb_inputs; i++)
+        if (fg->inputs[i]->ist == ist &&
+            (ret = ifilter_renegotiate(fg->inputs[i], frame, 1)) < 0)
+            return ret;
+    return 1;
+}
+
 int ist_in_filtergraph(FilterGraph *fg, InputStream *ist)
 {
     int i;
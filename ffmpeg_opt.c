@@ -108,6 +108,14 @@ int exit_on_error     = 0;
 int abort_on_flags    = 0;
 int print_stats       = -1;
 int qp_hist           = 0;
+int parallel_encode   = 0;
+int filter_branch_threads = 0;
+int mux_threads       = 0;
+int shared_threads    = -1;
+char *filter_thread_affinity = NULL;
+char *bench_report_filename = NULL;
+float bench_report_period = 0;
+char *control_url     = NULL;
 int stdin_interaction = 1;
 int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
@@ -161,6 +169,7 @@ static void init_options(OptionsContext *o)
 
     o->stop_time = INT64_MAX;
     o->mux_max_delay  = 0.7;
+    o->pace_burst     = 0.05;
     o->start_time     = AV_NOPTS_VALUE;
     o->start_time_eof = AV_NOPTS_VALUE;
     o->recording_time = INT64_MAX;
@@ -1028,12 +1037,14 @@ static int open_input_file(OptionsContext *o, const char *filename)
     f->ts_offset  = o->input_ts_offset - (copy_ts ? (start_at_zero && ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0) : timestamp);
     f->nb_streams = ic->nb_streams;
     f->rate_emu   = o->rate_emu;
+    f->rate_emu_wakeup = AV_NOPTS_VALUE;
     f->accurate_seek = o->accurate_seek;
     f->loop = o->loop;
     f->duration = 0;
     f->time_base = (AVRational){ 1, 1 };
 #if HAVE_PTHREADS
     f->thread_queue_size = o->thread_queue_size > 0 ? o->thread_queue_size : 8;
+    f->program_queues = o->program_queues && ic->nb_programs > 1;
 #endif
 
     /* check if all codec options have been used */
@@ -1565,6 +1576,9 @@ static OutputStream *new_video_stream(OptionsContext *o, AVFormatContext *oc, in
 
         MATCH_PER_STREAM_OPT(force_fps, i, ost->force_fps, oc, st);
 
+        MATCH_PER_STREAM_OPT(chunk_frames,  i, ost->chunk_frames,  oc, st);
+        MATCH_PER_STREAM_OPT(chunk_threads, i, ost->chunk_threads, oc, st);
+
         ost->top_field_first = -1;
         MATCH_PER_STREAM_OPT(top_field_first, i, ost->top_field_first, oc, st);
 
@@ -1934,6 +1948,9 @@ static int open_output_file(OptionsContext *o, const char *filename)
     of->start_time     = o->start_time;
     of->limit_filesize = o->limit_filesize;
     of->shortest       = o->shortest;
+    of->pace           = o->pace;
+    of->pace_burst     = (int64_t)(o->pace_burst * AV_TIME_BASE);
+    of->pace_start     = AV_NOPTS_VALUE;
     av_dict_copy(&of->opts, o->g->format_opts, 0);
 
     if (!strcmp(filename, "-"))
@@ -3073,6 +3090,33 @@ fail:
     return ret;
 }
 
+int ffmpeg_parse_output_options(int argc, char **argv)
+{
+    OptionParseContext octx;
+    int ret;
+
+    memset(&octx, 0, sizeof(octx));
+
+    ret = split_arglist(&octx, argc, argv, options, groups,
+                        FF_ARRAY_ELEMS(groups));
+    if (ret < 0)
+        goto fail;
+
+    if (octx.global_opts.nb_opts || octx.groups[GROUP_INFILE].nb_groups ||
+        octx.groups[GROUP_OUTFILE].nb_groups != 1) {
+        av_log(NULL, AV_LOG_ERROR, "Exactly one output file with its options "
+               "is expected, global options and inputs are not allowed.\n");
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+
+    ret = open_files(&octx.groups[GROUP_OUTFILE], "output", open_output_file);
+
+fail:
+    uninit_parse_context(&octx);
+    return ret;
+}
+
 static int opt_progress(void *optctx, const char *opt, const char *arg)
 {
     AVIOContext *avio = NULL;
@@ -3166,6 +3210,22 @@ const OptionDef options[] = {
         "add timings for benchmarking" },
     { "benchmark_all",  OPT_BOOL | OPT_EXPERT,                       { &do_benchmark_all },
       "add timings for each task" },
+    { "bench_report",   HAS_ARG | OPT_STRING | OPT_EXPERT,           { &bench_report_filename },
+      "write the time spent in each decoder, filter, encoder and muxer to file, in JSON", "file" },
+    { "bench_report_period", HAS_ARG | OPT_FLOAT | OPT_EXPERT,       { &bench_report_period },
+      "also write the report every given number of seconds", "seconds" },
+    { "parallel_encode", OPT_BOOL | OPT_EXPERT,                      { &parallel_encode },
+      "run each audio and video encoder in its own thread" },
+    { "filter_branch_threads", OPT_BOOL | OPT_EXPERT,                { &filter_branch_threads },
+      "process independent branches of the filtergraphs in parallel" },
+    { "mux_threads",    OPT_BOOL | OPT_EXPERT,                       { &mux_threads },
+      "mux each output file in its own thread" },
+    { "filter_thread_affinity", HAS_ARG | OPT_STRING | OPT_EXPERT,   { &filter_thread_affinity },
+      "restrict the filtergraph threads to a set of CPUs", "cpus" },
+    { "shared_threads", HAS_ARG | OPT_INT | OPT_EXPERT,              { &shared_threads },
+      "run the slice threads of all decoders, encoders and filtergraphs on one pool of threads (0 for one per CPU)", "number" },
+    { "control",        HAS_ARG | OPT_STRING | OPT_EXPERT,           { &control_url },
+      "read commands adding and removing outputs from the given URL", "url" },
     { "progress",       HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
     { "stdin",          OPT_BOOL | OPT_EXPERT,                       { &stdin_interaction },
@@ -3199,6 +3259,12 @@ const OptionDef options[] = {
     { "shortest",       OPT_BOOL | OPT_EXPERT | OPT_OFFSET |
                         OPT_OUTPUT,                                  { .off = OFFSET(shortest) },
         "finish encoding within shortest input" },
+    { "pace",           OPT_BOOL | OPT_EXPERT | OPT_OFFSET |
+                        OPT_OUTPUT,                                  { .off = OFFSET(pace) },
+        "send packets to the muxer in realtime, according to their DTS" },
+    { "pace_burst",     OPT_FLOAT | HAS_ARG | OPT_EXPERT | OPT_OFFSET |
+                        OPT_OUTPUT,                                  { .off = OFFSET(pace_burst) },
+        "how far ahead of realtime -pace may send packets", "seconds" },
     { "apad",           OPT_STRING | HAS_ARG | OPT_SPEC |
                         OPT_OUTPUT,                                  { .off = OFFSET(apad) },
         "audio pad", "" },
@@ -3263,6 +3329,8 @@ const OptionDef options[] = {
     { "thread_queue_size", HAS_ARG | OPT_INT | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
                                                                      { .off = OFFSET(thread_queue_size) },
         "set the maximum number of queued packets from the demuxer" },
+    { "program_queues", OPT_BOOL | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,  { .off = OFFSET(program_queues) },
+        "queue the packets of each program of the input separately" },
 
     /* video options */
     { "vframes",      OPT_VIDEO | HAS_ARG  | OPT_PERFILE | OPT_OUTPUT,           { .func_arg = opt_video_frames },
@@ -3332,6 +3400,12 @@ const OptionDef options[] = {
     { "force_fps",    OPT_VIDEO | OPT_BOOL | OPT_EXPERT  | OPT_SPEC |
                       OPT_OUTPUT,                                                { .off = OFFSET(force_fps) },
         "force the selected framerate, disable the best supported framerate selection" },
+    { "chunk_frames", OPT_VIDEO | OPT_INT | HAS_ARG | OPT_EXPERT | OPT_SPEC |
+                      OPT_OUTPUT,                                                { .off = OFFSET(chunk_frames) },
+        "encode the video in chunks of the given number of frames, in parallel", "frames" },
+    { "chunk_threads", OPT_VIDEO | OPT_INT | HAS_ARG | OPT_EXPERT | OPT_SPEC |
+                      OPT_OUTPUT,                                                { .off = OFFSET(chunk_threads) },
+        "set the number of chunks encoded in parallel", "count" },
     { "streamid",     OPT_VIDEO | HAS_ARG | OPT_EXPERT | OPT_PERFILE |
                       OPT_OUTPUT,                                                { .func_arg = opt_streamid },
         "set the value of an outfile streamid", "streamIndex:value" },
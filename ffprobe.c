@@ -33,6 +33,7 @@
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
+#include "libavutil/cpu.h"
 #include "libavutil/display.h"
 #include "libavutil/hash.h"
 #include "libavutil/opt.h"
@@ -41,6 +42,7 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/libm.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/threadmessage.h"
 #include "libavutil/timecode.h"
 #include "libavutil/timestamp.h"
 #include "libavdevice/avdevice.h"
@@ -49,6 +51,10 @@
 #include "libpostproc/postprocess.h"
 #include "cmdutils.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 const char program_name[] = "ffprobe";
 const int program_birth_year = 2007;
 
@@ -85,9 +91,12 @@ static int use_byte_value_binary_prefix = 0;
 static int use_value_sexagesimal_format = 0;
 static int show_private_data            = 1;
 
+static int parallel_intervals           = 0;
+
 static char *print_format;
 static char *stream_specifier;
 static char *show_data_hash;
+static char *index_output;
 
 typedef struct ReadInterval {
     int id;             ///< identifier
@@ -95,6 +104,12 @@ typedef struct ReadInterval {
     int has_start, has_end;
     int start_is_offset, end_is_offset;
     int duration_frames;
+    /**
+     * Read the packets from the first keyframe at or after start to the
+     * first keyframe at or after end, both of a single stream, so that
+     * consecutive intervals read each packet once and in the file order.
+     */
+    int keyframe_aligned;
 } ReadInterval;
 
 static ReadInterval *read_intervals;
@@ -628,6 +643,15 @@ end:
 #define PRINT_STRING_OPT      1
 #define PRINT_STRING_VALIDATE 2
 
+/* printable ASCII is valid for all the writers, and needs no validation */
+static inline int is_printable_ascii(const char *s)
+{
+    for (; *s; s++)
+        if ((uint8_t)*s < 0x20 || (uint8_t)*s >= 0x80)
+            return 0;
+    return 1;
+}
+
 static inline int writer_print_string(WriterContext *wctx,
                                       const char *key, const char *val, int flags)
 {
@@ -639,7 +663,8 @@ static inline int writer_print_string(WriterContext *wctx,
         return 0;
 
     if (section->show_all_entries || av_dict_get(section->entries_to_show, key, NULL, 0)) {
-        if (flags & PRINT_STRING_VALIDATE) {
+        if ((flags & PRINT_STRING_VALIDATE) &&
+            !(is_printable_ascii(key) && is_printable_ascii(val))) {
             char *key1 = NULL, *val1 = NULL;
             ret = validate_string(wctx, &key1, key);
             if (ret < 0) goto end;
@@ -914,8 +939,12 @@ static const Writer default_writer = {
  */
 static const char *c_escape_str(AVBPrint *dst, const char *src, const char sep, void *log_ctx)
 {
+    char meta_chars[] = { '\b', '\f', '\n', '\r', '\\', sep, '\0' };
     const char *p;
 
+    if (!src[strcspn(src, meta_chars)])
+        return src;
+
     for (p = src; *p; p++) {
         switch (*p) {
         case '\b': av_bprintf(dst, "%s", "\\b");  break;
@@ -940,16 +969,16 @@ static const char *csv_escape_str(AVBPrint *dst, const char *src, const char sep
     char meta_chars[] = { sep, '"', '\n', '\r', '\0' };
     int needs_quoting = !!src[strcspn(src, meta_chars)];
 
-    if (needs_quoting)
-        av_bprint_chars(dst, '"', 1);
+    if (!needs_quoting)
+        return src;
 
+    av_bprint_chars(dst, '"', 1);
     for (; *src; src++) {
         if (*src == '"')
             av_bprint_chars(dst, '"', 1);
         av_bprint_chars(dst, *src, 1);
     }
-    if (needs_quoting)
-        av_bprint_chars(dst, '"', 1);
+    av_bprint_chars(dst, '"', 1);
     return dst->str;
 }
 
@@ -1380,6 +1409,13 @@ static const char *json_escape_str(AVBPrint *dst, const char *src, void *log_ctx
     static const char json_subst[]  = {'"', '\\',  'b',  'f',  'n',  'r',  't', 0};
     const char *p;
 
+    /* most keys and values need no escaping */
+    for (p = src; *p; p++)
+        if ((unsigned char)*p < 32 || *p == '"' || *p == '\\')
+            break;
+    if (!*p)
+        return src;
+
     for (p = src; *p; p++) {
         char *s = strchr(json_escape, *p);
         if (s) {
@@ -1411,15 +1447,17 @@ static void json_print_section_header(WriterContext *wctx)
         printf("{\n");
         json->indent_level++;
     } else {
+        const char *name;
+
         av_bprint_init(&buf, 1, AV_BPRINT_SIZE_UNLIMITED);
-        json_escape_str(&buf, section->name, wctx);
+        name = json_escape_str(&buf, section->name, wctx);
         JSON_INDENT();
 
         json->indent_level++;
         if (section->flags & SECTION_FLAG_IS_ARRAY) {
-            printf("\"%s\": [\n", buf.str);
+            printf("\"%s\": [\n", name);
         } else if (parent_section && !(parent_section->flags & SECTION_FLAG_IS_ARRAY)) {
-            printf("\"%s\": {%s", buf.str, json->item_start_end);
+            printf("\"%s\": {%s", name, json->item_start_end);
         } else {
             printf("{%s", json->item_start_end);
 
@@ -1811,6 +1849,46 @@ static void show_packet(WriterContext *w, AVFormatContext *fmt_ctx, AVPacket *pk
     fflush(stdout);
 }
 
+/* packet index file, as loaded by the index_file option of lavf demuxers */
+static AVIOContext *index_pb;
+static unsigned int index_nb_streams;
+
+static int open_index_output(AVFormatContext *fmt_ctx)
+{
+    int ret, i;
+
+    if ((ret = avio_open(&index_pb, index_output, AVIO_FLAG_WRITE)) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Could not open index file %s: %s\n",
+               index_output, av_err2str(ret));
+        return ret;
+    }
+    index_nb_streams = FFMIN(fmt_ctx->nb_streams, 0xFFFF);
+
+    avio_wb32(index_pb, MKBETAG('F', 'F', 'I', 'X'));
+    avio_wb32(index_pb, 1);
+    avio_wb64(index_pb, FFMAX(avio_size(fmt_ctx->pb), 0));
+    avio_wb32(index_pb, index_nb_streams);
+    for (i = 0; i < index_nb_streams; i++) {
+        AVStream *st = fmt_ctx->streams[i];
+        avio_wb32(index_pb, st->id);
+        avio_wb32(index_pb, st->time_base.num);
+        avio_wb32(index_pb, st->time_base.den);
+    }
+    return 0;
+}
+
+static void write_index_entry(const AVPacket *pkt)
+{
+    if (pkt->stream_index >= index_nb_streams)
+        return;
+    avio_wb16(index_pb, pkt->stream_index);
+    avio_wb16(index_pb, pkt->flags);
+    avio_wb64(index_pb, pkt->pts);
+    avio_wb64(index_pb, pkt->dts);
+    avio_wb64(index_pb, pkt->pos);
+    avio_wb32(index_pb, pkt->size);
+}
+
 static void show_subtitle(WriterContext *w, AVSubtitle *sub, AVStream *stream,
                           AVFormatContext *fmt_ctx)
 {
@@ -1933,9 +2011,109 @@ static void show_frame(WriterContext *w, AVFrame *frame, AVStream *stream,
     fflush(stdout);
 }
 
+/**
+ * Packets, frames and subtitles read by a read interval worker, printed by
+ * the main thread.
+ */
+typedef struct ProbeMessage {
+    enum {
+        PROBE_MSG_PACKET,
+        PROBE_MSG_FRAME,
+        PROBE_MSG_SUBTITLE,
+    } type;
+    int stream_index;
+    AVPacket pkt;
+    AVFrame *frame;             ///< the properties of the frame, without data
+    AVSubtitle sub;
+} ProbeMessage;
+
+/* maximum number of messages queued by a read interval worker */
+#define INTERVAL_QUEUE_SIZE 4096
+
+typedef struct IntervalWorker {
+    const ReadInterval *interval;
+    AVThreadMessageQueue *queue;
+    int error;                  ///< error sending a message, if any
+#if HAVE_PTHREADS
+    pthread_t thread;
+#endif
+} IntervalWorker;
+
+static void free_probe_message(void *arg)
+{
+    ProbeMessage *msg = arg;
+
+    av_packet_unref(&msg->pkt);
+    av_frame_free(&msg->frame);
+    if (msg->type == PROBE_MSG_SUBTITLE)
+        avsubtitle_free(&msg->sub);
+}
+
+static int send_probe_message(IntervalWorker *iw, ProbeMessage *msg)
+{
+    int ret = av_thread_message_queue_send(iw->queue, msg, 0);
+
+    if (ret < 0) {
+        free_probe_message(msg);
+        iw->error = ret;
+    }
+    return ret;
+}
+
+static int send_packet_message(IntervalWorker *iw, const AVPacket *pkt)
+{
+    ProbeMessage msg = { .type = PROBE_MSG_PACKET, .stream_index = pkt->stream_index };
+    int ret;
+
+    av_init_packet(&msg.pkt);
+    if (do_show_packets || index_pb) {
+        /* the data is only needed to be printed or hashed */
+        if (do_show_packets && (do_show_data || hash)) {
+            ret = av_packet_ref(&msg.pkt, pkt);
+        } else {
+            ret = av_packet_copy_props(&msg.pkt, pkt);
+            msg.pkt.size = pkt->size;
+        }
+        if (ret < 0)
+            return iw->error = ret;
+    }
+    return send_probe_message(iw, &msg);
+}
+
+static int send_frame_message(IntervalWorker *iw, int stream_index,
+                              const AVFrame *frame, AVSubtitle *sub)
+{
+    ProbeMessage msg = { .type = sub ? PROBE_MSG_SUBTITLE : PROBE_MSG_FRAME,
+                         .stream_index = stream_index };
+    int ret;
+
+    av_init_packet(&msg.pkt);
+    if (sub) {
+        if (do_show_frames)
+            msg.sub = *sub;
+        else
+            avsubtitle_free(sub);
+    } else if (do_show_frames) {
+        if (!(msg.frame = av_frame_alloc()))
+            return iw->error = AVERROR(ENOMEM);
+        msg.frame->format         = frame->format;
+        msg.frame->width          = frame->width;
+        msg.frame->height         = frame->height;
+        msg.frame->nb_samples     = frame->nb_samples;
+        msg.frame->channel_layout = frame->channel_layout;
+        av_frame_set_channels(msg.frame, av_frame_get_channels(frame));
+        if ((ret = av_frame_copy_props(msg.frame, frame)) < 0) {
+            av_frame_free(&msg.frame);
+            return iw->error = ret;
+        }
+    }
+    return send_probe_message(iw, &msg);
+}
+
 static av_always_inline int process_frame(WriterContext *w,
                                           AVFormatContext *fmt_ctx,
-                                          AVFrame *frame, AVPacket *pkt)
+                                          AVFrame *frame, AVPacket *pkt,
+                                          IntervalWorker *iw)
 {
     AVCodecContext *dec_ctx = fmt_ctx->streams[pkt->stream_index]->codec;
     AVSubtitle sub;
@@ -1962,7 +2140,11 @@ static av_always_inline int process_frame(WriterContext *w,
     ret = FFMIN(ret, pkt->size); /* guard against bogus return values */
     pkt->data += ret;
     pkt->size -= ret;
-    if (got_frame) {
+    if (got_frame && iw) {
+        int is_sub = (dec_ctx->codec_type == AVMEDIA_TYPE_SUBTITLE);
+        if (send_frame_message(iw, pkt->stream_index, frame, is_sub ? &sub : NULL) < 0)
+            return iw->error;
+    } else if (got_frame) {
         int is_sub = (dec_ctx->codec_type == AVMEDIA_TYPE_SUBTITLE);
         nb_streams_frames[pkt->stream_index]++;
         if (do_show_frames)
@@ -2000,14 +2182,19 @@ static void log_read_interval(const ReadInterval *interval, void *log_ctx, int l
     av_log(log_ctx, log_level, "\n");
 }
 
+/* longest GOP expected when reading keyframe aligned intervals */
+#define MAX_GOP_DURATION (60 * AV_TIME_BASE)
+
 static int read_interval_packets(WriterContext *w, AVFormatContext *fmt_ctx,
-                                 const ReadInterval *interval, int64_t *cur_ts)
+                                 const ReadInterval *interval, int64_t *cur_ts,
+                                 IntervalWorker *iw)
 {
     AVPacket pkt, pkt1;
     AVFrame *frame = NULL;
     int ret = 0, i = 0, frame_count = 0;
     int64_t start = -INT64_MAX, end = interval->end;
     int has_start = 0, has_end = interval->has_end && !interval->end_is_offset;
+    int ref_stream = -1, started = !interval->has_start;
 
     av_init_packet(&pkt);
 
@@ -2031,60 +2218,115 @@ static int read_interval_packets(WriterContext *w, AVFormatContext *fmt_ctx,
 
         av_log(NULL, AV_LOG_VERBOSE, "Seeking to read interval start point %s\n",
                av_ts2timestr(target, &AV_TIME_BASE_Q));
-        if ((ret = avformat_seek_file(fmt_ctx, -1, -INT64_MAX, target, INT64_MAX, 0)) < 0) {
+        /* an aligned interval must not miss its first keyframe */
+        if ((ret = avformat_seek_file(fmt_ctx, -1, -INT64_MAX, target,
+                                      interval->keyframe_aligned ? target : INT64_MAX, 0)) < 0) {
             av_log(NULL, AV_LOG_ERROR, "Could not seek to position %"PRId64": %s\n",
                    interval->start, av_err2str(ret));
             goto end;
         }
     }
 
+    if (interval->keyframe_aligned) {
+        /* the interval starts and ends at keyframes of a single stream, so
+         * that adjacent intervals share the packets order of the file */
+        for (i = 0; i < FFMIN(fmt_ctx->nb_streams, nb_streams); i++) {
+            if (!selected_streams[i])
+                continue;
+            if (ref_stream < 0 ||
+                fmt_ctx->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO &&
+                fmt_ctx->streams[ref_stream]->codec->codec_type != AVMEDIA_TYPE_VIDEO)
+                ref_stream = i;
+        }
+        i = 0;
+    }
+
     frame = av_frame_alloc();
     if (!frame) {
         ret = AVERROR(ENOMEM);
         goto end;
     }
     while (!av_read_frame(fmt_ctx, &pkt)) {
-        if (fmt_ctx->nb_streams > nb_streams) {
+        if (!iw && fmt_ctx->nb_streams > nb_streams) {
             REALLOCZ_ARRAY_STREAM(nb_streams_frames,  nb_streams, fmt_ctx->nb_streams);
             REALLOCZ_ARRAY_STREAM(nb_streams_packets, nb_streams, fmt_ctx->nb_streams);
             REALLOCZ_ARRAY_STREAM(selected_streams,   nb_streams, fmt_ctx->nb_streams);
             nb_streams = fmt_ctx->nb_streams;
         }
-        if (selected_streams[pkt.stream_index]) {
+        if (pkt.stream_index < nb_streams && selected_streams[pkt.stream_index]) {
             AVRational tb = fmt_ctx->streams[pkt.stream_index]->time_base;
+            int in_interval = 1;
 
             if (pkt.pts != AV_NOPTS_VALUE)
                 *cur_ts = av_rescale_q(pkt.pts, tb, AV_TIME_BASE_Q);
 
-            if (!has_start && *cur_ts != AV_NOPTS_VALUE) {
-                start = *cur_ts;
-                has_start = 1;
-            }
-
-            if (has_start && !has_end && interval->end_is_offset) {
-                end = start + interval->end;
-                has_end = 1;
-            }
-
-            if (interval->end_is_offset && interval->duration_frames) {
-                if (frame_count >= interval->end)
+            if (interval->keyframe_aligned) {
+                int64_t ts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts;
+
+                if (ts != AV_NOPTS_VALUE) {
+                    ts = av_rescale_q(ts, tb, AV_TIME_BASE_Q);
+                    if (pkt.stream_index == ref_stream && pkt.flags & AV_PKT_FLAG_KEY) {
+                        if (!started && ts >= interval->start)
+                            started = 1;
+                        if (started && interval->has_end && ts >= interval->end) {
+                            av_packet_unref(&pkt);
+                            break;
+                        }
+                    }
+                    /* a stream without another keyframe is not waited for
+                     * longer than a GOP */
+                    if (interval->has_end && ts >= interval->end + MAX_GOP_DURATION) {
+                        av_packet_unref(&pkt);
+                        break;
+                    }
+                }
+                in_interval = started;
+            } else {
+                if (!has_start && *cur_ts != AV_NOPTS_VALUE) {
+                    start = *cur_ts;
+                    has_start = 1;
+                }
+
+                if (has_start && !has_end && interval->end_is_offset) {
+                    end = start + interval->end;
+                    has_end = 1;
+                }
+
+                if (interval->end_is_offset && interval->duration_frames) {
+                    if (frame_count >= interval->end) {
+                        av_packet_unref(&pkt);
+                        break;
+                    }
+                } else if (has_end && *cur_ts != AV_NOPTS_VALUE && *cur_ts >= end) {
+                    av_packet_unref(&pkt);
                     break;
-            } else if (has_end && *cur_ts != AV_NOPTS_VALUE && *cur_ts >= end) {
-                break;
+                }
             }
 
-            frame_count++;
-            if (do_read_packets) {
-                if (do_show_packets)
-                    show_packet(w, fmt_ctx, &pkt, i++);
-                nb_streams_packets[pkt.stream_index]++;
-            }
-            if (do_read_frames) {
-                pkt1 = pkt;
-                while (pkt1.size && process_frame(w, fmt_ctx, frame, &pkt1) > 0);
+            if (in_interval) {
+                frame_count++;
+                if (do_read_packets) {
+                    if (iw) {
+                        send_packet_message(iw, &pkt);
+                    } else {
+                        if (do_show_packets)
+                            show_packet(w, fmt_ctx, &pkt, i++);
+                        if (index_pb)
+                            write_index_entry(&pkt);
+                        nb_streams_packets[pkt.stream_index]++;
+                    }
+                }
+                if (do_read_frames) {
+                    pkt1 = pkt;
+                    while (pkt1.size && process_frame(w, fmt_ctx, frame, &pkt1, iw) > 0);
+                }
             }
         }
         av_packet_unref(&pkt);
+        if (iw && iw->error) {
+            ret = iw->error;
+            goto end;
+        }
     }
     av_init_packet(&pkt);
     pkt.data = NULL;
@@ -2093,29 +2335,218 @@ static int read_interval_packets(WriterContext *w, AVFormatContext *fmt_ctx,
     for (i = 0; i < fmt_ctx->nb_streams; i++) {
         pkt.stream_index = i;
         if (do_read_frames)
-            while (process_frame(w, fmt_ctx, frame, &pkt) > 0);
+            while (process_frame(w, fmt_ctx, frame, &pkt, iw) > 0);
+        if (iw && iw->error) {
+            ret = iw->error;
+            goto end;
+        }
     }
 
 end:
     av_frame_free(&frame);
-    if (ret < 0) {
+    if (ret < 0 && ret != AVERROR_EXIT) {
         av_log(NULL, AV_LOG_ERROR, "Could not read packets in interval ");
         log_read_interval(interval, NULL, AV_LOG_ERROR);
     }
     return ret;
 }
 
+#if HAVE_PTHREADS
+static int open_input_file(AVFormatContext **fmt_ctx_ptr, const char *filename,
+                           int dump_format);
+static void close_input_file(AVFormatContext **ctx_ptr);
+
+static void *interval_worker_thread(void *arg)
+{
+    IntervalWorker *iw = arg;
+    AVFormatContext *fmt_ctx = NULL;
+    int64_t cur_ts;
+    int ret;
+
+    if ((ret = open_input_file(&fmt_ctx, input_filename, 0)) >= 0) {
+        cur_ts = fmt_ctx->start_time;
+        ret = read_interval_packets(NULL, fmt_ctx, iw->interval, &cur_ts, iw);
+    }
+    if (fmt_ctx)
+        close_input_file(&fmt_ctx);
+
+    av_thread_message_queue_set_err_recv(iw->queue, ret < 0 ? ret : AVERROR_EOF);
+    return NULL;
+}
+
+static int start_interval_worker(IntervalWorker *iw, const ReadInterval *interval)
+{
+    int ret;
+
+    memset(iw, 0, sizeof(*iw));
+    iw->interval = interval;
+    if ((ret = av_thread_message_queue_alloc(&iw->queue, INTERVAL_QUEUE_SIZE,
+                                             sizeof(ProbeMessage))) < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(iw->queue, free_probe_message);
+
+    if ((ret = pthread_create(&iw->thread, NULL, interval_worker_thread, iw))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+        av_thread_message_queue_free(&iw->queue);
+        return AVERROR(ret);
+    }
+    return 0;
+}
+
+static void stop_interval_worker(IntervalWorker *iw)
+{
+    if (!iw->queue)
+        return;
+    av_thread_message_queue_set_err_send(iw->queue, AVERROR_EXIT);
+    av_thread_message_flush(iw->queue);
+    pthread_join(iw->thread, NULL);
+    av_thread_message_queue_free(&iw->queue);
+}
+
+static int print_interval_output(WriterContext *w, AVFormatContext *fmt_ctx,
+                                 IntervalWorker *iw, int *packet_idx)
+{
+    ProbeMessage msg;
+    int ret;
+
+    while ((ret = av_thread_message_queue_recv(iw->queue, &msg, 0)) >= 0) {
+        AVStream *st = fmt_ctx->streams[msg.stream_index];
+
+        switch (msg.type) {
+        case PROBE_MSG_PACKET:
+            if (do_show_packets)
+                show_packet(w, fmt_ctx, &msg.pkt, (*packet_idx)++);
+            if (index_pb)
+                write_index_entry(&msg.pkt);
+            nb_streams_packets[msg.stream_index]++;
+            break;
+        case PROBE_MSG_FRAME:
+            if (do_show_frames)
+                show_frame(w, msg.frame, st, fmt_ctx);
+            nb_streams_frames[msg.stream_index]++;
+            break;
+        case PROBE_MSG_SUBTITLE:
+            if (do_show_frames)
+                show_subtitle(w, &msg.sub, st, fmt_ctx);
+            nb_streams_frames[msg.stream_index]++;
+            break;
+        }
+        free_probe_message(&msg);
+    }
+    return ret == AVERROR_EOF ? 0 : ret;
+}
+
+/**
+ * Get the intervals to read in parallel: the read intervals if they do not
+ * depend on each other, or else keyframe aligned parts of the input.
+ */
+static int get_parallel_intervals(AVFormatContext *fmt_ctx,
+                                  ReadInterval **intervals, int *nb_intervals)
+{
+    int64_t start_time = fmt_ctx->start_time != AV_NOPTS_VALUE ? fmt_ctx->start_time : 0;
+    int64_t duration = fmt_ctx->duration, part;
+    ReadInterval *parts;
+    int i, nb_parts;
+
+    *nb_intervals = 0;
+    if (read_intervals_nb) {
+        for (i = 0; i < read_intervals_nb; i++) {
+            if (read_intervals[i].start_is_offset) {
+                av_log(NULL, AV_LOG_WARNING, "Read intervals with a relative "
+                       "start are read serially\n");
+                return 0;
+            }
+        }
+        *intervals    = read_intervals;
+        *nb_intervals = read_intervals_nb;
+        return 0;
+    }
+
+    if (duration == AV_NOPTS_VALUE || duration <= 0 ||
+        !fmt_ctx->pb || !fmt_ctx->pb->seekable) {
+        av_log(NULL, AV_LOG_WARNING, "The input cannot be split in parts as "
+               "it is not seekable or has no known duration, reading it serially\n");
+        return 0;
+    }
+
+    /* parts short enough for the messages of several to be queued together */
+    part = FFMAX(FFMIN(duration / parallel_intervals, MAX_GOP_DURATION), AV_TIME_BASE);
+    nb_parts = FFMIN((duration + part - 1) / part, INT_MAX / sizeof(*parts));
+    if (!(parts = av_mallocz_array(nb_parts, sizeof(*parts))))
+        return AVERROR(ENOMEM);
+    for (i = 0; i < nb_parts; i++) {
+        parts[i].id               = i;
+        parts[i].has_start        = i > 0;
+        parts[i].start            = start_time + i * part;
+        parts[i].has_end          = i < nb_parts - 1;
+        parts[i].end              = start_time + (i + 1) * part;
+        parts[i].keyframe_aligned = 1;
+    }
+    *intervals    = parts;
+    *nb_intervals = nb_parts;
+    return 0;
+}
+
+static int read_packets_parallel(WriterContext *w, AVFormatContext *fmt_ctx,
+                                 const ReadInterval *intervals, int nb_intervals)
+{
+    IntervalWorker *workers;
+    int i, next = 0, packet_idx = 0, ret = 0;
+
+    if (!(workers = av_mallocz_array(parallel_intervals, sizeof(*workers))))
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_intervals; i++) {
+        IntervalWorker *iw = &workers[i % parallel_intervals];
+
+        /* keep parallel_intervals intervals being read, printing the oldest */
+        while (ret >= 0 && next < FFMIN(nb_intervals, i + parallel_intervals)) {
+            ret = start_interval_worker(&workers[next % parallel_intervals], &intervals[next]);
+            if (ret >= 0)
+                next++;
+        }
+        if (ret >= 0 && i < next)
+            ret = print_interval_output(w, fmt_ctx, iw, &packet_idx);
+        if (i < next)
+            stop_interval_worker(iw);
+        if (ret < 0)
+            break;
+    }
+    for (i++; i < next; i++)
+        stop_interval_worker(&workers[i % parallel_intervals]);
+
+    av_free(workers);
+    return ret;
+}
+#endif /* HAVE_PTHREADS */
+
 static int read_packets(WriterContext *w, AVFormatContext *fmt_ctx)
 {
     int i, ret = 0;
     int64_t cur_ts = fmt_ctx->start_time;
 
+#if HAVE_PTHREADS
+    if (parallel_intervals > 1) {
+        ReadInterval *intervals = NULL;
+        int nb_intervals;
+
+        if ((ret = get_parallel_intervals(fmt_ctx, &intervals, &nb_intervals)) < 0)
+            return ret;
+        if (nb_intervals) {
+            ret = read_packets_parallel(w, fmt_ctx, intervals, nb_intervals);
+            if (intervals != read_intervals)
+                av_free(intervals);
+            return ret;
+        }
+    }
+#endif
+
     if (read_intervals_nb == 0) {
         ReadInterval interval = (ReadInterval) { .has_start = 0, .has_end = 0 };
-        ret = read_interval_packets(w, fmt_ctx, &interval, &cur_ts);
+        ret = read_interval_packets(w, fmt_ctx, &interval, &cur_ts, NULL);
     } else {
         for (i = 0; i < read_intervals_nb; i++) {
-            ret = read_interval_packets(w, fmt_ctx, &read_intervals[i], &cur_ts);
+            ret = read_interval_packets(w, fmt_ctx, &read_intervals[i], &cur_ts, NULL);
             if (ret < 0)
                 break;
         }
@@ -2499,30 +2930,55 @@ static void show_error(WriterContext *w, int err)
     writer_print_section_footer(w);
 }
 
-static int open_input_file(AVFormatContext **fmt_ctx_ptr, const char *filename)
+/* set the default number of decoding threads */
+static void set_decoder_threads(AVDictionary **opts)
+{
+    if (!av_dict_get(*opts, "threads", NULL, 0)) {
+        if (parallel_intervals > 1)
+            av_dict_set_int(opts, "threads",
+                            FFMAX(av_cpu_count() / parallel_intervals, 1), 0);
+        else
+            av_dict_set(opts, "threads", "auto", 0);
+    }
+    /* frame threading would delay the frames relatively to the packets */
+    if (do_show_packets && do_show_frames &&
+        !av_dict_get(*opts, "thread_type", NULL, 0))
+        av_dict_set(opts, "thread_type", "slice", 0);
+}
+
+/* format_opts is not modified, so that the input can be opened again by the
+ * read interval workers */
+static int open_input_file(AVFormatContext **fmt_ctx_ptr, const char *filename,
+                           int dump_format)
 {
     int err, i, orig_nb_streams;
     AVFormatContext *fmt_ctx = NULL;
     AVDictionaryEntry *t;
     AVDictionary **opts;
+    AVDictionary *fopts = NULL;
     int scan_all_pmts_set = 0;
 
-    if (!av_dict_get(format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE)) {
-        av_dict_set(&format_opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
+    if ((err = av_dict_copy(&fopts, format_opts, 0)) < 0)
+        return err;
+    if (!av_dict_get(fopts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE)) {
+        av_dict_set(&fopts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
         scan_all_pmts_set = 1;
     }
     if ((err = avformat_open_input(&fmt_ctx, filename,
-                                   iformat, &format_opts)) < 0) {
+                                   iformat, &fopts)) < 0) {
         print_error(filename, err);
+        av_dict_free(&fopts);
         return err;
     }
     *fmt_ctx_ptr = fmt_ctx;
     if (scan_all_pmts_set)
-        av_dict_set(&format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE);
-    if ((t = av_dict_get(format_opts, "", NULL, AV_DICT_IGNORE_SUFFIX))) {
+        av_dict_set(&fopts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE);
+    if ((t = av_dict_get(fopts, "", NULL, AV_DICT_IGNORE_SUFFIX))) {
         av_log(NULL, AV_LOG_ERROR, "Option %s not found.\n", t->key);
+        av_dict_free(&fopts);
         return AVERROR_OPTION_NOT_FOUND;
     }
+    av_dict_free(&fopts);
 
     /* fill the streams in the format context */
     opts = setup_find_stream_info_opts(fmt_ctx, codec_opts);
@@ -2539,7 +2995,8 @@ static int open_input_file(AVFormatContext **fmt_ctx_ptr, const char *filename)
         return err;
     }
 
-    av_dump_format(fmt_ctx, 0, filename, 0);
+    if (dump_format)
+        av_dump_format(fmt_ctx, 0, filename, 0);
 
     /* bind a decoder to each input stream */
     for (i = 0; i < fmt_ctx->nb_streams; i++) {
@@ -2557,6 +3014,7 @@ static int open_input_file(AVFormatContext **fmt_ctx_ptr, const char *filename)
         } else {
             AVDictionary *opts = filter_codec_opts(codec_opts, stream->codec->codec_id,
                                                    fmt_ctx, stream, codec);
+            set_decoder_threads(&opts);
             if (avcodec_open2(stream->codec, codec, &opts) < 0) {
                 av_log(NULL, AV_LOG_WARNING, "Could not open codec for input stream %d\n",
                        stream->index);
@@ -2593,12 +3051,18 @@ static int probe_file(WriterContext *wctx, const char *filename)
     int section_id;
 
     do_read_frames = do_show_frames || do_count_frames;
-    do_read_packets = do_show_packets || do_count_packets;
+    do_read_packets = do_show_packets || do_count_packets || !!index_output;
 
-    ret = open_input_file(&fmt_ctx, filename);
+    ret = open_input_file(&fmt_ctx, filename, 1);
     if (ret < 0)
         goto end;
 
+    if (index_output) {
+        ret = open_index_output(fmt_ctx);
+        if (ret < 0)
+            goto end;
+    }
+
 #define CHECK_END if (ret < 0) goto end
 
     nb_streams = fmt_ctx->nb_streams;
@@ -2657,6 +3121,7 @@ static int probe_file(WriterContext *wctx, const char *filename)
 end:
     if (fmt_ctx)
         close_input_file(&fmt_ctx);
+    avio_closep(&index_pb);
     av_freep(&nb_streams_frames);
     av_freep(&nb_streams_packets);
     av_freep(&selected_streams);
@@ -3148,6 +3613,8 @@ static const OptionDef real_options[] = {
     { "private",           OPT_BOOL, {(void*)&show_private_data}, "same as show_private_data" },
     { "bitexact", OPT_BOOL, {&do_bitexact}, "force bitexact output" },
     { "read_intervals", HAS_ARG, {.func_arg = opt_read_intervals}, "set read intervals", "read_intervals" },
+    { "parallel_intervals", OPT_INT | HAS_ARG, {&parallel_intervals}, "read intervals in parallel with the given number of threads", "threads" },
+    { "write_index", OPT_STRING | HAS_ARG, {(void*)&index_output}, "write a binary index of the packets to the given file", "file" },
     { "default", HAS_ARG | OPT_AUDIO | OPT_VIDEO | OPT_EXPERT, {.func_arg = opt_default}, "generic catch all option", "" },
     { "i", HAS_ARG, {.func_arg = opt_input_file_i}, "read specified file", "input_file"},
     { NULL, },
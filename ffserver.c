@@ -23,6 +23,9 @@
  * multiple format streaming server based on the FFmpeg libraries
  */
 
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE     /* Needed for SO_REUSEPORT with glibc */
+
 #include "config.h"
 #if !HAVE_CLOSESOCKET
 #define closesocket close
@@ -43,6 +46,7 @@
 #include "libavformat/internal.h"
 #include "libavformat/url.h"
 
+#include "libavutil/atomic.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/lfg.h"
@@ -60,6 +64,9 @@
 #endif
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #if HAVE_POLL_H
 #include <poll.h>
 #endif
@@ -67,6 +74,9 @@
 #include <time.h>
 #include <sys/wait.h>
 #include <signal.h>
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #include "cmdutils.h"
 #include "ffserver_config.h"
@@ -127,12 +137,41 @@ typedef struct {
     int64_t time1, time2;
 } DataRateData;
 
+/* event loop serving a share of the connections */
+typedef struct HTTPWorker {
+    int server_fd;      /* HTTP listening socket, 0 if none */
+    int wake_fds[2];    /* pipe waking the worker up from poll() */
+    struct pollfd *poll_table;
+    struct HTTPContext **conns; /* connections handled in this iteration */
+    int64_t cur_time;   /* time of the current iteration, in ms */
+#if HAVE_PTHREADS
+    pthread_t thread;
+#endif
+} HTTPWorker;
+
+#define SHARED_OUTPUT_NB_CHUNKS 1024
+
+/* output of a SharedOutput stream, muxed once for all its clients */
+typedef struct SharedOutput {
+    AVFormatContext *fmt_in;  /* reader of the feed */
+    AVFormatContext fmt_ctx;  /* muxer */
+    AVBufferRef *header;
+    /* ring of the last muxed packets, chunk n is at n % SHARED_OUTPUT_NB_CHUNKS */
+    AVBufferRef *chunks[SHARED_OUTPUT_NB_CHUNKS];
+    int64_t nb_chunks;        /* number of chunks muxed so far */
+    int64_t last_key;         /* last chunk clients can start from, -1 if none */
+    int pending_key;          /* the next chunk starts with a key frame */
+    int has_video;
+    int nb_clients;
+} SharedOutput;
+
 /* context associated with one connection */
 typedef struct HTTPContext {
     enum HTTPState state;
     int fd; /* socket file descriptor */
     struct sockaddr_in from_addr; /* origin */
     struct pollfd *poll_entry; /* used when polling */
+    HTTPWorker *worker; /* worker serving the connection */
     int64_t timeout;
     uint8_t *buffer_ptr, *buffer_end;
     int http_error;
@@ -162,6 +201,9 @@ typedef struct HTTPContext {
     int switch_feed_streams[FFSERVER_MAX_STREAMS]; /* index of streams in the feed */
     int switch_pending;
     AVFormatContext fmt_ctx; /* instance of FFServerStream for one user */
+    SharedOutput *shared;    /* shared output, instead of fmt_in and fmt_ctx */
+    AVBufferRef *shared_chunk; /* chunk of the shared output being sent */
+    int64_t shared_pos;      /* next chunk of the shared output to send */
     int last_packet_sent; /* true if last data packet was sent */
     int suppress_log;
     DataRateData datarate;
@@ -197,16 +239,37 @@ typedef struct FeedData {
     float avg_frame_size;   /* frame size averaged over last frames with exponential mean */
 } FeedData;
 
+/* all the connections, of all the workers */
 static HTTPContext *first_http_ctx;
 
+static HTTPWorker *workers;
+
+#if HAVE_PTHREADS
+/* protects the connection list, and the state shared between the
+ * connections (feeds, streams, counters); only the sending of the stream
+ * data to the clients is done without it */
+static pthread_mutex_t server_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t log_lock    = PTHREAD_MUTEX_INITIALIZER;
+#define SERVER_LOCK()   pthread_mutex_lock(&server_lock)
+#define SERVER_UNLOCK() pthread_mutex_unlock(&server_lock)
+#define LOG_LOCK()      pthread_mutex_lock(&log_lock)
+#define LOG_UNLOCK()    pthread_mutex_unlock(&log_lock)
+#else
+#define SERVER_LOCK()
+#define SERVER_UNLOCK()
+#define LOG_LOCK()
+#define LOG_UNLOCK()
+#endif
+
 static FFServerConfig config = {
     .nb_max_http_connections = 2000,
     .nb_max_connections = 5,
     .max_bandwidth = 1000,
     .use_defaults = 1,
+    .nb_workers = 1,
 };
 
-static void new_connection(int server_fd, int is_rtsp);
+static void new_connection(HTTPWorker *w, int server_fd, int is_rtsp);
 static void close_connection(HTTPContext *c);
 
 /* HTTP handling */
@@ -214,6 +277,9 @@ static int handle_connection(HTTPContext *c);
 static inline void print_stream_params(AVIOContext *pb, FFServerStream *stream);
 static void compute_status(HTTPContext *c);
 static int open_input_stream(HTTPContext *c, const char *info);
+static int shared_output_open(HTTPContext *c, const char *info);
+static void shared_output_close(HTTPContext *c);
+static void shared_output_update(FFServerStream *stream);
 static int http_parse_request(HTTPContext *c);
 static int http_send_data(HTTPContext *c);
 static int http_start_receive_data(HTTPContext *c);
@@ -258,9 +324,6 @@ static unsigned int nb_connections;
 
 static uint64_t current_bandwidth;
 
-/* Making this global saves on passing it around everywhere */
-static int64_t cur_time;
-
 static AVLFG random_state;
 
 static FILE *logfile = NULL;
@@ -377,6 +440,98 @@ static void ffm_set_write_index(AVFormatContext *s, int64_t pos,
     av_opt_set_int(s, "ffm_file_size", file_size, AV_OPT_SEARCH_CHILDREN);
 }
 
+/* publish the write index and size of a mapped feed to its clients, after
+ * the data they cover has been written */
+static void feed_map_update(FFServerStream *feed)
+{
+    if (!feed->feed_map)
+        return;
+    avpriv_atomic_int_set(&feed->feed_map_size,
+                          feed->feed_size / FFM_PACKET_SIZE);
+    avpriv_atomic_int_set(&feed->feed_map_write,
+                          feed->feed_write_index / FFM_PACKET_SIZE);
+}
+
+static int64_t feed_map_write_index(FFServerStream *feed)
+{
+    return (int64_t)avpriv_atomic_int_get(&feed->feed_map_write) * FFM_PACKET_SIZE;
+}
+
+static int64_t feed_map_size(FFServerStream *feed)
+{
+    return (int64_t)avpriv_atomic_int_get(&feed->feed_map_size) * FFM_PACKET_SIZE;
+}
+
+typedef struct FeedMapReader {
+    FFServerStream *feed;
+    int64_t pos;
+} FeedMapReader;
+
+/* the clients only read the feed up to its published size, the mapping
+ * may extend beyond the end of the file */
+static int feed_map_read(void *opaque, uint8_t *buf, int buf_size)
+{
+    FeedMapReader *r = opaque;
+    int64_t size = feed_map_size(r->feed);
+
+    if (r->pos >= size)
+        return AVERROR_EOF;
+    buf_size = FFMIN(buf_size, size - r->pos);
+    memcpy(buf, r->feed->feed_map + r->pos, buf_size);
+    r->pos += buf_size;
+    return buf_size;
+}
+
+static int64_t feed_map_seek(void *opaque, int64_t offset, int whence)
+{
+    FeedMapReader *r = opaque;
+
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return feed_map_size(r->feed);
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += r->pos;
+        break;
+    case SEEK_END:
+        offset += feed_map_size(r->feed);
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (offset < 0)
+        return AVERROR(EINVAL);
+    return r->pos = offset;
+}
+
+static AVIOContext *feed_map_alloc_pb(FFServerStream *feed)
+{
+    FeedMapReader *r = av_mallocz(sizeof(*r));
+    uint8_t *buf     = av_malloc(FFM_PACKET_SIZE);
+    AVIOContext *pb  = NULL;
+
+    if (r && buf)
+        pb = avio_alloc_context(buf, FFM_PACKET_SIZE, 0, r,
+                                feed_map_read, NULL, feed_map_seek);
+    if (!pb) {
+        av_free(r);
+        av_free(buf);
+        return NULL;
+    }
+    r->feed = feed;
+    return pb;
+}
+
+static void feed_map_free_pb(AVIOContext **pb)
+{
+    if (!*pb)
+        return;
+    av_freep(&(*pb)->opaque);
+    av_freep(&(*pb)->buffer);
+    av_freep(pb);
+}
+
 static char *ctime1(char *buf2, size_t buf_size)
 {
     time_t ti;
@@ -395,6 +550,7 @@ static char *ctime1(char *buf2, size_t buf_size)
     return buf2;
 }
 
+/* must be called with log_lock held */
 static void http_vlog(const char *fmt, va_list vargs)
 {
     static int print_prefix = 1;
@@ -412,15 +568,28 @@ static void http_vlog(const char *fmt, va_list vargs)
     fflush(logfile);
 }
 
+#ifdef __GNUC__
+__attribute__ ((format (printf, 1, 2)))
+#endif
+static void http_log_unlocked(const char *fmt, ...)
+{
+    va_list vargs;
+    va_start(vargs, fmt);
+    http_vlog(fmt, vargs);
+    va_end(vargs);
+}
+
 #ifdef __GNUC__
 __attribute__ ((format (printf, 1, 2)))
 #endif
 static void http_log(const char *fmt, ...)
 {
     va_list vargs;
+    LOG_LOCK();
     va_start(vargs, fmt);
     http_vlog(fmt, vargs);
     va_end(vargs);
+    LOG_UNLOCK();
 }
 
 static void http_av_log(void *ptr, int level, const char *fmt, va_list vargs)
@@ -429,10 +598,12 @@ static void http_av_log(void *ptr, int level, const char *fmt, va_list vargs)
     AVClass *avc = ptr ? *(AVClass**)ptr : NULL;
     if (level > av_log_get_level())
         return;
+    LOG_LOCK();
     if (print_prefix && avc)
-        http_log("[%s @ %p]", avc->item_name(ptr), ptr);
+        http_log_unlocked("[%s @ %p]", avc->item_name(ptr), ptr);
     print_prefix = strstr(fmt, "\n") != NULL;
     http_vlog(fmt, vargs);
+    LOG_UNLOCK();
 }
 
 static void log_connection(HTTPContext *c)
@@ -445,7 +616,7 @@ static void log_connection(HTTPContext *c)
              c->protocol, (c->http_error ? c->http_error : 200), c->data_count);
 }
 
-static void update_datarate(DataRateData *drd, int64_t count)
+static void update_datarate(DataRateData *drd, int64_t count, int64_t cur_time)
 {
     if (!drd->time1 && !drd->count1) {
         drd->time1 = drd->time2 = cur_time;
@@ -459,7 +630,7 @@ static void update_datarate(DataRateData *drd, int64_t count)
 }
 
 /* In bytes per second */
-static int compute_datarate(DataRateData *drd, int64_t count)
+static int compute_datarate(DataRateData *drd, int64_t count, int64_t cur_time)
 {
     if (cur_time == drd->time1)
         return 0;
@@ -512,6 +683,14 @@ static void start_children(FFServerStream *feed)
 
         feed->pid_start = time(0);
 
+        /* logged before forking, the log lock may be held by a worker */
+        http_log("Launch command line: ");
+        http_log("%s ", pathname);
+
+        for (i = 1; feed->child_argv[i] && feed->child_argv[i][0]; i++)
+            http_log("%s ", feed->child_argv[i]);
+        http_log("\n");
+
         feed->pid = fork();
         if (feed->pid < 0) {
             http_log("Unable to create children: %s\n", strerror(errno));
@@ -524,13 +703,6 @@ static void start_children(FFServerStream *feed)
 
         /* In child */
 
-        http_log("Launch command line: ");
-        http_log("%s ", pathname);
-
-        for (i = 1; feed->child_argv[i] && feed->child_argv[i][0]; i++)
-            http_log("%s ", feed->child_argv[i]);
-        http_log("\n");
-
         for (i = 3; i < 256; i++)
             close(i);
 
@@ -551,8 +723,8 @@ static void start_children(FFServerStream *feed)
     av_free (pathname);
 }
 
-/* open a listening socket */
-static int socket_open_listen(struct sockaddr_in *my_addr)
+/* open a listening socket, possibly one of several bound to the same port */
+static int socket_open_listen(struct sockaddr_in *my_addr, int reuse_port)
 {
     int server_fd, tmp;
 
@@ -565,6 +737,13 @@ static int socket_open_listen(struct sockaddr_in *my_addr)
     tmp = 1;
     if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &tmp, sizeof(tmp)))
         av_log(NULL, AV_LOG_WARNING, "setsockopt SO_REUSEADDR failed\n");
+#ifdef SO_REUSEPORT
+    if (reuse_port &&
+        setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &tmp, sizeof(tmp))) {
+        perror ("setsockopt SO_REUSEPORT");
+        goto fail;
+    }
+#endif
 
     my_addr->sin_family = AF_INET;
     if (bind (server_fd, (struct sockaddr *) my_addr, sizeof (*my_addr)) < 0) {
@@ -650,51 +829,29 @@ static void start_multicast(void)
     }
 }
 
-/* main loop of the HTTP server */
-static int http_server(void)
+/* wake a worker up from poll(), e.g. when a feed has new data for one of
+ * its connections */
+static void wake_worker(HTTPWorker *w)
 {
-    int server_fd = 0, rtsp_server_fd = 0;
-    int ret, delay;
-    struct pollfd *poll_table, *poll_entry;
-    HTTPContext *c, *c_next;
+    static const uint8_t byte = 0;
 
-    poll_table = av_mallocz_array(config.nb_max_http_connections + 2,
-                                  sizeof(*poll_table));
-    if(!poll_table) {
-        http_log("Impossible to allocate a poll table handling %d "
-                 "connections.\n", config.nb_max_http_connections);
-        return -1;
-    }
-
-    if (config.http_addr.sin_port) {
-        server_fd = socket_open_listen(&config.http_addr);
-        if (server_fd < 0)
-            goto quit;
-    }
-
-    if (config.rtsp_addr.sin_port) {
-        rtsp_server_fd = socket_open_listen(&config.rtsp_addr);
-        if (rtsp_server_fd < 0) {
-            closesocket(server_fd);
-            goto quit;
-        }
-    }
-
-    if (!rtsp_server_fd && !server_fd) {
-        http_log("HTTP and RTSP disabled.\n");
-        goto quit;
-    }
-
-    http_log("FFserver started.\n");
-
-    start_children(config.first_feed);
+    /* if the pipe is full, the worker is being woken up anyway */
+    if (w->wake_fds[1] >= 0 && write(w->wake_fds[1], &byte, 1) < 0)
+        return;
+}
 
-    start_multicast();
+/* main loop of a worker: the first one, in the main thread, also serves
+ * RTSP and the RTP streams, and starts the feeders */
+static int http_worker_loop(HTTPWorker *w, int rtsp_server_fd)
+{
+    int ret, delay, i, nb_conns;
+    struct pollfd *poll_table = w->poll_table, *poll_entry;
+    HTTPContext *c;
 
     for(;;) {
         poll_entry = poll_table;
-        if (server_fd) {
-            poll_entry->fd = server_fd;
+        if (w->server_fd) {
+            poll_entry->fd = w->server_fd;
             poll_entry->events = POLLIN;
             poll_entry++;
         }
@@ -703,12 +860,21 @@ static int http_server(void)
             poll_entry->events = POLLIN;
             poll_entry++;
         }
+        if (w->wake_fds[0] >= 0) {
+            poll_entry->fd = w->wake_fds[0];
+            poll_entry->events = POLLIN;
+            poll_entry++;
+        }
 
         /* wait for events on each HTTP handle */
-        c = first_http_ctx;
+        SERVER_LOCK();
+        nb_conns = 0;
         delay = 1000;
-        while (c) {
+        for (c = first_http_ctx; c; c = c->next) {
             int fd;
+            if (c->worker != w)
+                continue;
+            w->conns[nb_conns++] = c;
             fd = c->fd;
             switch(c->state) {
             case HTTPSTATE_SEND_HEADER:
@@ -751,8 +917,8 @@ static int http_server(void)
                 c->poll_entry = NULL;
                 break;
             }
-            c = c->next;
         }
+        SERVER_UNLOCK();
 
         /* wait for an event on one connection. We poll at least every
          * second to handle timeouts */
@@ -760,44 +926,155 @@ static int http_server(void)
             ret = poll(poll_table, poll_entry - poll_table, delay);
             if (ret < 0 && ff_neterrno() != AVERROR(EAGAIN) &&
                 ff_neterrno() != AVERROR(EINTR)) {
-                goto quit;
+                return -1;
             }
         } while (ret < 0);
 
-        cur_time = av_gettime() / 1000;
+        w->cur_time = av_gettime() / 1000;
+
+        if (w->wake_fds[0] >= 0) {
+            uint8_t buf[64];
+            while (read(w->wake_fds[0], buf, sizeof(buf)) > 0)
+                ;
+        }
 
-        if (need_to_start_children) {
+        if (w == workers && need_to_start_children) {
             need_to_start_children = 0;
+            SERVER_LOCK();
             start_children(config.first_feed);
+            SERVER_UNLOCK();
         }
 
         /* now handle the events */
-        for(c = first_http_ctx; c; c = c_next) {
-            c_next = c->next;
-            if (handle_connection(c) < 0) {
+        for (i = 0; i < nb_conns; i++) {
+            c = w->conns[i];
+            SERVER_LOCK();
+            /* the stream data is muxed and sent without the lock, so that
+             * the workers serve their clients in parallel */
+            if (c->state == HTTPSTATE_SEND_DATA_HEADER ||
+                c->state == HTTPSTATE_SEND_DATA ||
+                c->state == HTTPSTATE_SEND_DATA_TRAILER) {
+                SERVER_UNLOCK();
+                ret = handle_connection(c);
+                SERVER_LOCK();
+            } else
+                ret = handle_connection(c);
+            if (ret < 0) {
                 log_connection(c);
                 /* close and free the connection */
                 close_connection(c);
             }
+            SERVER_UNLOCK();
         }
 
         poll_entry = poll_table;
-        if (server_fd) {
+        if (w->server_fd) {
             /* new HTTP connection request ? */
             if (poll_entry->revents & POLLIN)
-                new_connection(server_fd, 0);
+                new_connection(w, w->server_fd, 0);
             poll_entry++;
         }
         if (rtsp_server_fd) {
             /* new RTSP connection request ? */
             if (poll_entry->revents & POLLIN)
-                new_connection(rtsp_server_fd, 1);
+                new_connection(w, rtsp_server_fd, 1);
         }
     }
+}
 
-quit:
-    av_free(poll_table);
-    return -1;
+#if HAVE_PTHREADS
+static void *http_worker_thread(void *arg)
+{
+    HTTPWorker *w = arg;
+
+    http_worker_loop(w, 0);
+    http_log("Worker %d stopped: %s\n", (int)(w - workers), strerror(errno));
+    exit(1);
+    return NULL;
+}
+#endif
+
+/* main loop of the HTTP server */
+static int http_server(void)
+{
+    int rtsp_server_fd = 0;
+    int i;
+
+    workers = av_mallocz_array(config.nb_workers, sizeof(*workers));
+    if (!workers)
+        return -1;
+    for (i = 0; i < config.nb_workers; i++) {
+        HTTPWorker *w = &workers[i];
+
+        w->wake_fds[0] = w->wake_fds[1] = -1;
+        if (config.nb_workers > 1) {
+            if (pipe(w->wake_fds) < 0) {
+                http_log("Could not create the worker pipe: %s\n",
+                         strerror(errno));
+                return -1;
+            }
+            fcntl(w->wake_fds[0], F_SETFL, O_NONBLOCK);
+            fcntl(w->wake_fds[1], F_SETFL, O_NONBLOCK);
+        }
+
+        w->poll_table = av_mallocz_array(config.nb_max_http_connections + 3,
+                                         sizeof(*w->poll_table));
+        w->conns      = av_mallocz_array(config.nb_max_http_connections,
+                                         sizeof(*w->conns));
+        if (!w->poll_table || !w->conns) {
+            http_log("Impossible to allocate a poll table handling %d "
+                     "connections.\n", config.nb_max_http_connections);
+            return -1;
+        }
+
+        if (config.http_addr.sin_port) {
+#ifndef SO_REUSEPORT
+            /* all the workers accept from the same socket */
+            if (i) {
+                w->server_fd = workers[0].server_fd;
+                continue;
+            }
+#endif
+            /* else each has its own, the kernel shares out the
+             * connections */
+            w->server_fd = socket_open_listen(&config.http_addr,
+                                              config.nb_workers > 1);
+            if (w->server_fd < 0)
+                return -1;
+        }
+    }
+
+    if (config.rtsp_addr.sin_port) {
+        rtsp_server_fd = socket_open_listen(&config.rtsp_addr, 0);
+        if (rtsp_server_fd < 0) {
+            closesocket(workers[0].server_fd);
+            return -1;
+        }
+    }
+
+    if (!rtsp_server_fd && !workers[0].server_fd) {
+        http_log("HTTP and RTSP disabled.\n");
+        return -1;
+    }
+
+    http_log("FFserver started.\n");
+
+    start_children(config.first_feed);
+
+    start_multicast();
+
+#if HAVE_PTHREADS
+    for (i = 1; i < config.nb_workers; i++) {
+        int ret = pthread_create(&workers[i].thread, NULL,
+                                 http_worker_thread, &workers[i]);
+        if (ret) {
+            http_log("Could not start worker %d: %s\n", i, strerror(ret));
+            return -1;
+        }
+    }
+#endif
+
+    return http_worker_loop(&workers[0], rtsp_server_fd);
 }
 
 /* start waiting for a new HTTP/RTSP request */
@@ -807,7 +1084,7 @@ static void start_wait_request(HTTPContext *c, int is_rtsp)
     c->buffer_end = c->buffer + c->buffer_size - 1; /* leave room for '\0' */
 
     c->state = is_rtsp ? RTSPSTATE_WAIT_REQUEST : HTTPSTATE_WAIT_REQUEST;
-    c->timeout = cur_time +
+    c->timeout = c->worker->cur_time +
                  (is_rtsp ? RTSP_REQUEST_TIMEOUT : HTTP_REQUEST_TIMEOUT);
 }
 
@@ -833,7 +1110,7 @@ static void http_send_too_busy_reply(int fd)
 }
 
 
-static void new_connection(int server_fd, int is_rtsp)
+static void new_connection(HTTPWorker *w, int server_fd, int is_rtsp)
 {
     struct sockaddr_in from_addr;
     socklen_t len;
@@ -844,12 +1121,15 @@ static void new_connection(int server_fd, int is_rtsp)
     fd = accept(server_fd, (struct sockaddr *)&from_addr,
                 &len);
     if (fd < 0) {
-        http_log("error during accept %s\n", strerror(errno));
+        /* another worker may have accepted it from the same socket */
+        if (ff_neterrno() != AVERROR(EAGAIN))
+            http_log("error during accept %s\n", strerror(errno));
         return;
     }
     if (ff_socket_nonblock(fd, 1) < 0)
         av_log(NULL, AV_LOG_WARNING, "ff_socket_nonblock failed\n");
 
+    SERVER_LOCK();
     if (nb_connections >= config.nb_max_connections) {
         http_send_too_busy_reply(fd);
         goto fail;
@@ -862,6 +1142,7 @@ static void new_connection(int server_fd, int is_rtsp)
 
     c->fd = fd;
     c->poll_entry = NULL;
+    c->worker = w;
     c->from_addr = from_addr;
     c->buffer_size = IOBUFFER_INIT_SIZE;
     c->buffer = av_malloc(c->buffer_size);
@@ -873,10 +1154,12 @@ static void new_connection(int server_fd, int is_rtsp)
     nb_connections++;
 
     start_wait_request(c, is_rtsp);
+    SERVER_UNLOCK();
 
     return;
 
  fail:
+    SERVER_UNLOCK();
     if (c) {
         av_freep(&c->buffer);
         av_free(c);
@@ -884,12 +1167,41 @@ static void new_connection(int server_fd, int is_rtsp)
     closesocket(fd);
 }
 
+static void close_input_stream(AVFormatContext **ps)
+{
+    AVIOContext *pb;
+    int i;
+
+    if (!*ps)
+        return;
+    /* only the feeds read from their mapping use custom I/O */
+    pb = (*ps)->flags & AVFMT_FLAG_CUSTOM_IO ? (*ps)->pb : NULL;
+    /* close each frame parser */
+    for(i=0;i<(*ps)->nb_streams;i++) {
+        AVStream *st = (*ps)->streams[i];
+        if (st->codec->codec)
+            avcodec_close(st->codec);
+    }
+    avformat_close_input(ps);
+    feed_map_free_pb(&pb);
+}
+
+/* free the streams set up by open_stream_output() */
+static void close_stream_output(AVFormatContext *ctx)
+{
+    int i;
+
+    for(i=0; i<ctx->nb_streams; i++)
+        av_freep(&ctx->streams[i]);
+    av_freep(&ctx->streams);
+    av_freep(&ctx->priv_data);
+}
+
 static void close_connection(HTTPContext *c)
 {
     HTTPContext **cp, *c1;
     int i, nb_streams;
     AVFormatContext *ctx;
-    AVStream *st;
 
     /* remove connection from list */
     cp = &first_http_ctx;
@@ -910,15 +1222,8 @@ static void close_connection(HTTPContext *c)
     /* remove connection associated resources */
     if (c->fd >= 0)
         closesocket(c->fd);
-    if (c->fmt_in) {
-        /* close each frame parser */
-        for(i=0;i<c->fmt_in->nb_streams;i++) {
-            st = c->fmt_in->streams[i];
-            if (st->codec->codec)
-                avcodec_close(st->codec);
-        }
-        avformat_close_input(&c->fmt_in);
-    }
+    close_input_stream(&c->fmt_in);
+    shared_output_close(c);
 
     /* free RTP output streams if any */
     nb_streams = 0;
@@ -947,10 +1252,7 @@ static void close_connection(HTTPContext *c)
         }
     }
 
-    for(i=0; i<ctx->nb_streams; i++)
-        av_freep(&ctx->streams[i]);
-    av_freep(&ctx->streams);
-    av_freep(&ctx->priv_data);
+    close_stream_output(ctx);
 
     if (c->stream && !c->post && c->stream->stream_type == STREAM_TYPE_LIVE)
         current_bandwidth -= c->stream->bandwidth;
@@ -977,7 +1279,7 @@ static int handle_connection(HTTPContext *c)
     case HTTPSTATE_WAIT_REQUEST:
     case RTSPSTATE_WAIT_REQUEST:
         /* timeout ? */
-        if ((c->timeout - cur_time) < 0)
+        if ((c->timeout - c->worker->cur_time) < 0)
             return -1;
         if (c->poll_entry->revents & (POLLERR | POLLHUP))
             return -1;
@@ -1068,7 +1370,10 @@ static int handle_connection(HTTPContext *c)
             return -1;
         /* Check if it is a single jpeg frame 123 */
         if (c->stream->single_frame && c->data_count > c->cur_frame_bytes && c->cur_frame_bytes > 0) {
+            /* the stream data is sent without the server lock */
+            SERVER_LOCK();
             close_connection(c);
+            SERVER_UNLOCK();
         }
         break;
     case HTTPSTATE_RECEIVE_DATA:
@@ -1429,7 +1734,7 @@ static int http_parse_request(HTTPContext *c)
     char *encoded_msg = NULL;
     const char *mime_type;
     FFServerStream *stream;
-    int i;
+    int i, ret;
     char ratebuf[32];
     const char *useragent = 0;
 
@@ -1792,7 +2097,11 @@ static int http_parse_request(HTTPContext *c)
         goto send_status;
 
     /* open input stream */
-    if (open_input_stream(c, info) < 0) {
+    if (c->stream->shared_output)
+        ret = shared_output_open(c, info);
+    else
+        ret = open_input_stream(c, info);
+    if (ret < 0) {
         snprintf(msg, sizeof(msg), "Input stream corresponding to '%s' not found", url);
         goto send_error;
     }
@@ -2125,7 +2434,7 @@ static void compute_status(HTTPContext *c)
                     c1->protocol, http_state[c1->state]);
         fmt_bytecount(pb, bitrate);
         avio_printf(pb, "<td align=right>");
-        fmt_bytecount(pb, compute_datarate(&c1->datarate, c1->data_count) * 8);
+        fmt_bytecount(pb, compute_datarate(&c1->datarate, c1->data_count, c->worker->cur_time) * 8);
         avio_printf(pb, "<td align=right>");
         fmt_bytecount(pb, c1->data_count);
         avio_printf(pb, "\n");
@@ -2149,6 +2458,7 @@ static int open_input_stream(HTTPContext *c, const char *info)
     char buf[128];
     char input_filename[1024];
     AVFormatContext *s = NULL;
+    AVIOContext *pb = NULL;
     int buf_size, i, ret;
     int64_t stream_pos;
 
@@ -2184,12 +2494,25 @@ static int open_input_stream(HTTPContext *c, const char *info)
         return AVERROR(EINVAL);
     }
 
+    /* a mapped feed is read directly from the mapping */
+    if (c->stream->feed && c->stream->feed->feed_map) {
+        if (!(s = avformat_alloc_context()) ||
+            !(pb = feed_map_alloc_pb(c->stream->feed))) {
+            avformat_free_context(s);
+            return AVERROR(ENOMEM);
+        }
+        s->pb     = pb;
+        s->flags |= AVFMT_FLAG_CUSTOM_IO;
+        buf_size  = 0;
+    }
+
     /* open stream */
     ret = avformat_open_input(&s, input_filename, c->stream->ifmt,
                               &c->stream->in_opts);
     if (ret < 0) {
         http_log("Could not open input '%s': %s\n",
                  input_filename, av_err2str(ret));
+        feed_map_free_pb(&pb);
         return ret;
     }
 
@@ -2224,7 +2547,7 @@ static int open_input_stream(HTTPContext *c, const char *info)
     if (c->fmt_in->iformat->read_seek)
         av_seek_frame(c->fmt_in, -1, stream_pos, 0);
     /* set the start time (needed for maxtime and RTP packet timing) */
-    c->start_time = cur_time;
+    c->start_time = c->worker->cur_time;
     c->first_pts = AV_NOPTS_VALUE;
     return 0;
 }
@@ -2233,7 +2556,7 @@ static int open_input_stream(HTTPContext *c, const char *info)
 static int64_t get_server_clock(HTTPContext *c)
 {
     /* compute current pts value from system time */
-    return (cur_time - c->start_time) * 1000;
+    return (c->worker->cur_time - c->start_time) * 1000;
 }
 
 /* return the estimated time (in us) at which the current packet must be sent */
@@ -2251,86 +2574,323 @@ static int64_t get_packet_send_clock(HTTPContext *c)
 }
 
 
-static int http_prepare_data(HTTPContext *c)
+/* set up the muxing of a stream and mux its header, return the header size */
+static int open_stream_output(AVFormatContext *fmt_ctx, FFServerStream *stream,
+                              uint8_t **header)
 {
-    int i, len, ret;
     AVFormatContext *ctx;
+    int i, ret;
 
-    av_freep(&c->pb_buffer);
-    switch(c->state) {
-    case HTTPSTATE_SEND_DATA_HEADER:
-        ctx = avformat_alloc_context();
-        if (!ctx)
-            return AVERROR(ENOMEM);
-        c->fmt_ctx = *ctx;
-        av_freep(&ctx);
-        av_dict_copy(&(c->fmt_ctx.metadata), c->stream->metadata, 0);
-        c->fmt_ctx.streams = av_mallocz_array(c->stream->nb_streams,
-                                              sizeof(AVStream *));
-        if (!c->fmt_ctx.streams)
-            return AVERROR(ENOMEM);
+    ctx = avformat_alloc_context();
+    if (!ctx)
+        return AVERROR(ENOMEM);
+    *fmt_ctx = *ctx;
+    av_freep(&ctx);
+    av_dict_copy(&(fmt_ctx->metadata), stream->metadata, 0);
+    fmt_ctx->streams = av_mallocz_array(stream->nb_streams,
+                                        sizeof(AVStream *));
+    if (!fmt_ctx->streams)
+        return AVERROR(ENOMEM);
+
+    for(i=0;i<stream->nb_streams;i++) {
+        AVStream *src;
+        fmt_ctx->streams[i] = av_mallocz(sizeof(AVStream));
+
+        /* if file or feed, then just take streams from FFServerStream
+         * struct */
+        if (!stream->feed ||
+            stream->feed == stream)
+            src = stream->streams[i];
+        else
+            src = stream->feed->streams[stream->feed_streams[i]];
 
-        for(i=0;i<c->stream->nb_streams;i++) {
-            AVStream *src;
-            c->fmt_ctx.streams[i] = av_mallocz(sizeof(AVStream));
+        *(fmt_ctx->streams[i]) = *src;
+        fmt_ctx->streams[i]->priv_data = 0;
+        /* XXX: should be done in AVStream, not in codec */
+        fmt_ctx->streams[i]->codec->frame_number = 0;
+    }
+    /* set output format parameters */
+    fmt_ctx->oformat = stream->fmt;
+    fmt_ctx->nb_streams = stream->nb_streams;
 
-            /* if file or feed, then just take streams from FFServerStream
-             * struct */
-            if (!c->stream->feed ||
-                c->stream->feed == c->stream)
-                src = c->stream->streams[i];
-            else
-                src = c->stream->feed->streams[c->stream->feed_streams[i]];
+    /* prepare header and save header data in a stream */
+    if (avio_open_dyn_buf(&fmt_ctx->pb) < 0) {
+        /* XXX: potential leak */
+        return -1;
+    }
+    fmt_ctx->pb->seekable = 0;
+
+    /*
+     * HACK to avoid MPEG-PS muxer to spit many underflow errors
+     * Default value from FFmpeg
+     * Try to set it using configuration option
+     */
+    fmt_ctx->max_delay = (int)(0.7*AV_TIME_BASE);
+
+    if ((ret = avformat_write_header(fmt_ctx, NULL)) < 0) {
+        http_log("Error writing output header for stream '%s': %s\n",
+                 stream->filename, av_err2str(ret));
+        return ret;
+    }
+    av_dict_free(&fmt_ctx->metadata);
+
+    return avio_close_dyn_buf(fmt_ctx->pb, header);
+}
+
+/* mux the header of the stream for a client */
+static int http_write_data_header(HTTPContext *c)
+{
+    int len;
+
+    c->got_key_frame = 0;
+
+    len = open_stream_output(&c->fmt_ctx, c->stream, &c->pb_buffer);
+    if (len < 0)
+        return len;
+    c->buffer_ptr = c->pb_buffer;
+    c->buffer_end = c->pb_buffer + len;
+
+    c->state = HTTPSTATE_SEND_DATA;
+    c->last_packet_sent = 0;
+    return 0;
+}
+
+/* attach a client to the shared output of its stream, opening it first if
+ * the client is the only one */
+static int shared_output_open(HTTPContext *c, const char *info)
+{
+    FFServerStream *stream = c->stream;
+    SharedOutput *so = stream->shared;
+    uint8_t *header;
+    int i, len, ret;
 
-            *(c->fmt_ctx.streams[i]) = *src;
-            c->fmt_ctx.streams[i]->priv_data = 0;
-            /* XXX: should be done in AVStream, not in codec */
-            c->fmt_ctx.streams[i]->codec->frame_number = 0;
+    c->shared_pos = -1;
+    c->start_time = c->worker->cur_time;
+    if (so) {
+        so->nb_clients++;
+        c->shared = so;
+        return 0;
+    }
+
+    so = av_mallocz(sizeof(*so));
+    if (!so)
+        return AVERROR(ENOMEM);
+    so->last_key = -1;
+    so->nb_clients = 1;
+    stream->shared = so;
+    c->shared = so;
+
+    /* the output starts at the position requested by this client */
+    if ((ret = open_input_stream(c, info)) < 0)
+        goto fail;
+    so->fmt_in = c->fmt_in;
+    c->fmt_in = NULL;
+
+    for (i = 0; i < stream->nb_streams; i++)
+        if (stream->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO)
+            so->has_video = 1;
+
+    if ((len = open_stream_output(&so->fmt_ctx, stream, &header)) < 0) {
+        ret = len;
+        goto fail;
+    }
+    so->header = av_buffer_create(header, len, av_buffer_default_free, NULL, 0);
+    if (!so->header) {
+        av_free(header);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* mux what the feed already has from the start position */
+    shared_output_update(stream);
+    return 0;
+fail:
+    shared_output_close(c);
+    return ret;
+}
+
+/* detach a client from its shared output, closing it after the last one */
+static void shared_output_close(HTTPContext *c)
+{
+    SharedOutput *so = c->shared;
+    int i;
+
+    if (!so)
+        return;
+    av_buffer_unref(&c->shared_chunk);
+    c->shared = NULL;
+    if (--so->nb_clients > 0)
+        return;
+    c->stream->shared = NULL;
+
+    close_input_stream(&so->fmt_in);
+    if (so->header && avio_open_dyn_buf(&so->fmt_ctx.pb) >= 0) {
+        av_write_trailer(&so->fmt_ctx);
+        ffio_free_dyn_buf(&so->fmt_ctx.pb);
+    }
+    close_stream_output(&so->fmt_ctx);
+    av_buffer_unref(&so->header);
+    for (i = 0; i < SHARED_OUTPUT_NB_CHUNKS; i++)
+        av_buffer_unref(&so->chunks[i]);
+    av_free(so);
+}
+
+/* mux the packets written to the feed since the last update */
+static void shared_output_update(FFServerStream *stream)
+{
+    SharedOutput *so = stream->shared;
+    AVFormatContext *ctx = &so->fmt_ctx;
+    AVPacket pkt;
+
+    if (!so->header)
+        return;
+    ffm_set_write_index(so->fmt_in, stream->feed->feed_write_index,
+                        stream->feed->feed_size);
+
+    while (av_read_frame(so->fmt_in, &pkt) >= 0) {
+        AVStream *ist = so->fmt_in->streams[pkt.stream_index], *ost;
+        AVBufferRef *chunk;
+        uint8_t *data;
+        int i, len, ret;
+
+        for (i = 0; i < stream->nb_streams; i++)
+            if (stream->feed_streams[i] == pkt.stream_index)
+                break;
+        if (i == stream->nb_streams) {
+            av_packet_unref(&pkt);
+            continue;
         }
-        /* set output format parameters */
-        c->fmt_ctx.oformat = c->stream->fmt;
-        c->fmt_ctx.nb_streams = c->stream->nb_streams;
+        pkt.stream_index = i;
+        ost = ctx->streams[i];
 
-        c->got_key_frame = 0;
+        /* clients can only start with a video key frame, if there is video */
+        if (!so->has_video ||
+            (pkt.flags & AV_PKT_FLAG_KEY &&
+             ist->codec->codec_type == AVMEDIA_TYPE_VIDEO))
+            so->pending_key = 1;
 
-        /* prepare header and save header data in a stream */
-        if (avio_open_dyn_buf(&c->fmt_ctx.pb) < 0) {
-            /* XXX: potential leak */
-            return -1;
+        if (avio_open_dyn_buf(&ctx->pb) < 0) {
+            av_packet_unref(&pkt);
+            break;
         }
-        c->fmt_ctx.pb->seekable = 0;
+        ctx->pb->seekable = 0;
+        if (pkt.dts != AV_NOPTS_VALUE)
+            pkt.dts = av_rescale_q(pkt.dts, ist->time_base, ost->time_base);
+        if (pkt.pts != AV_NOPTS_VALUE)
+            pkt.pts = av_rescale_q(pkt.pts, ist->time_base, ost->time_base);
+        pkt.duration = av_rescale_q(pkt.duration, ist->time_base,
+                                    ost->time_base);
+        if ((ret = av_write_frame(ctx, &pkt)) < 0)
+            http_log("Error writing frame to output for stream '%s': %s\n",
+                     stream->filename, av_err2str(ret));
+        av_packet_unref(&pkt);
 
-        /*
-         * HACK to avoid MPEG-PS muxer to spit many underflow errors
-         * Default value from FFmpeg
-         * Try to set it using configuration option
-         */
-        c->fmt_ctx.max_delay = (int)(0.7*AV_TIME_BASE);
+        len = avio_close_dyn_buf(ctx->pb, &data);
+        ctx->pb = NULL;
+        if (len <= 0) {
+            av_free(data);
+            continue;
+        }
+        chunk = av_buffer_create(data, len, av_buffer_default_free, NULL, 0);
+        if (!chunk) {
+            av_free(data);
+            continue;
+        }
 
-        if ((ret = avformat_write_header(&c->fmt_ctx, NULL)) < 0) {
-            http_log("Error writing output header for stream '%s': %s\n",
-                     c->stream->filename, av_err2str(ret));
-            return ret;
+        i = so->nb_chunks % SHARED_OUTPUT_NB_CHUNKS;
+        av_buffer_unref(&so->chunks[i]);
+        so->chunks[i] = chunk;
+        if (so->pending_key) {
+            so->last_key = so->nb_chunks;
+            so->pending_key = 0;
         }
-        av_dict_free(&c->fmt_ctx.metadata);
+        so->nb_chunks++;
+    }
+}
 
-        len = avio_close_dyn_buf(c->fmt_ctx.pb, &c->pb_buffer);
-        c->buffer_ptr = c->pb_buffer;
-        c->buffer_end = c->pb_buffer + len;
+/* take a reference to the next chunk of the shared output for a client,
+ * return AVERROR(EAGAIN) if the client has to wait for the feed */
+static int shared_output_next_chunk(HTTPContext *c)
+{
+    SharedOutput *so = c->shared;
+    int64_t oldest = so->nb_chunks - SHARED_OUTPUT_NB_CHUNKS;
+
+    /* a client too slow to follow the ring starts again from a key frame */
+    if (c->shared_pos >= 0 && c->shared_pos < oldest)
+        c->shared_pos = -1;
+    if (c->shared_pos < 0 && so->last_key >= 0 && so->last_key >= oldest)
+        c->shared_pos = so->last_key;
+    if (c->shared_pos < 0 || c->shared_pos >= so->nb_chunks)
+        return AVERROR(EAGAIN);
+
+    c->shared_chunk = av_buffer_ref(so->chunks[c->shared_pos % SHARED_OUTPUT_NB_CHUNKS]);
+    if (!c->shared_chunk)
+        return AVERROR(ENOMEM);
+    c->shared_pos++;
+    c->buffer_ptr = c->shared_chunk->data;
+    c->buffer_end = c->shared_chunk->data + c->shared_chunk->size;
+    return 0;
+}
+
+static int http_prepare_data(HTTPContext *c)
+{
+    int i, len, ret;
+    int64_t write_index = 0;
+    AVFormatContext *ctx;
 
-        c->state = HTTPSTATE_SEND_DATA;
-        c->last_packet_sent = 0;
+    av_freep(&c->pb_buffer);
+    av_buffer_unref(&c->shared_chunk);
+    switch(c->state) {
+    case HTTPSTATE_SEND_DATA_HEADER:
+        if (c->shared) {
+            /* the header was muxed once for all the clients */
+            c->shared_chunk = av_buffer_ref(c->shared->header);
+            if (!c->shared_chunk)
+                return AVERROR(ENOMEM);
+            c->buffer_ptr = c->shared_chunk->data;
+            c->buffer_end = c->shared_chunk->data + c->shared_chunk->size;
+            c->state = HTTPSTATE_SEND_DATA;
+            break;
+        }
+        /* the streams, and their codec contexts, are shared with the feed */
+        SERVER_LOCK();
+        ret = http_write_data_header(c);
+        SERVER_UNLOCK();
+        if (ret < 0)
+            return ret;
         break;
     case HTTPSTATE_SEND_DATA:
+        if (c->shared) {
+            if (c->stream->max_time &&
+                c->stream->max_time + c->start_time - c->worker->cur_time < 0)
+                return -1;
+            SERVER_LOCK();
+            ret = shared_output_next_chunk(c);
+            if (ret == AVERROR(EAGAIN))
+                c->state = HTTPSTATE_WAIT_FEED;
+            SERVER_UNLOCK();
+            if (ret == AVERROR(EAGAIN))
+                return 1; /* state changed */
+            if (ret < 0)
+                return ret;
+            break;
+        }
         /* find a new packet */
         /* read a packet from the input stream */
-        if (c->stream->feed)
-            ffm_set_write_index(c->fmt_in,
-                                c->stream->feed->feed_write_index,
+        if (c->stream->feed && c->stream->feed->feed_map) {
+            write_index = feed_map_write_index(c->stream->feed);
+            ffm_set_write_index(c->fmt_in, write_index,
+                                feed_map_size(c->stream->feed));
+        } else if (c->stream->feed) {
+            SERVER_LOCK();
+            write_index = c->stream->feed->feed_write_index;
+            ffm_set_write_index(c->fmt_in, write_index,
                                 c->stream->feed->feed_size);
+            SERVER_UNLOCK();
+        }
 
         if (c->stream->max_time &&
-            c->stream->max_time + c->start_time - cur_time < 0)
+            c->stream->max_time + c->start_time - c->worker->cur_time < 0)
             /* We have timed out */
             c->state = HTTPSTATE_SEND_DATA_TRAILER;
         else {
@@ -2340,8 +2900,12 @@ static int http_prepare_data(HTTPContext *c)
             if (ret < 0) {
                 if (c->stream->feed) {
                     /* if coming from feed, it means we reached the end of the
-                     * ffm file, so must wait for more data */
-                    c->state = HTTPSTATE_WAIT_FEED;
+                     * ffm file, so must wait for more data, unless the feed
+                     * was written to meanwhile */
+                    SERVER_LOCK();
+                    if (c->stream->feed->feed_write_index == write_index)
+                        c->state = HTTPSTATE_WAIT_FEED;
+                    SERVER_UNLOCK();
                     return 1; /* state changed */
                 }
                 if (ret == AVERROR(EAGAIN)) {
@@ -2350,7 +2914,10 @@ static int http_prepare_data(HTTPContext *c)
                 }
                 if (c->stream->loop) {
                     avformat_close_input(&c->fmt_in);
-                    if (open_input_stream(c, "") < 0)
+                    SERVER_LOCK();
+                    ret = open_input_stream(c, "");
+                    SERVER_UNLOCK();
+                    if (ret < 0)
                         goto no_loop;
                     goto redo;
                 } else {
@@ -2363,11 +2930,12 @@ static int http_prepare_data(HTTPContext *c)
                 /* update first pts if needed */
                 if (c->first_pts == AV_NOPTS_VALUE && pkt.dts != AV_NOPTS_VALUE) {
                     c->first_pts = av_rescale_q(pkt.dts, c->fmt_in->streams[pkt.stream_index]->time_base, AV_TIME_BASE_Q);
-                    c->start_time = cur_time;
+                    c->start_time = c->worker->cur_time;
                 }
                 /* send it to the appropriate stream */
                 if (c->stream->feed) {
                     /* if coming from a feed, select the right stream */
+                    SERVER_LOCK();
                     if (c->switch_pending) {
                         c->switch_pending = 0;
                         for(i=0;i<c->stream->nb_streams;i++) {
@@ -2378,6 +2946,7 @@ static int http_prepare_data(HTTPContext *c)
                                 c->switch_pending = 1;
                         }
                     }
+                    SERVER_UNLOCK();
                     for(i=0;i<c->stream->nb_streams;i++) {
                         if (c->stream->feed_streams[i] == pkt.stream_index) {
                             AVStream *st = c->fmt_in->streams[source_index];
@@ -2460,7 +3029,9 @@ static int http_prepare_data(HTTPContext *c)
                     c->buffer_ptr = c->pb_buffer;
                     c->buffer_end = c->pb_buffer + len;
 
+                    SERVER_LOCK();
                     codec->frame_number++;
+                    SERVER_UNLOCK();
                     if (len == 0) {
                         av_packet_unref(&pkt);
                         goto redo;
@@ -2473,7 +3044,7 @@ static int http_prepare_data(HTTPContext *c)
     default:
     case HTTPSTATE_SEND_DATA_TRAILER:
         /* last packet test ? */
-        if (c->last_packet_sent || c->is_packetized)
+        if (c->last_packet_sent || c->is_packetized || c->shared)
             return -1;
         ctx = &c->fmt_ctx;
         /* prepare header */
@@ -2482,7 +3053,9 @@ static int http_prepare_data(HTTPContext *c)
             return -1;
         }
         c->fmt_ctx.pb->seekable = 0;
+        SERVER_LOCK();
         av_write_trailer(ctx);
+        SERVER_UNLOCK();
         len = avio_close_dyn_buf(ctx->pb, &c->pb_buffer);
         c->buffer_ptr = c->pb_buffer;
         c->buffer_end = c->pb_buffer + len;
@@ -2531,9 +3104,12 @@ static int http_send_data(HTTPContext *c)
                 }
 
                 c->data_count += len;
-                update_datarate(&c->datarate, c->data_count);
-                if (c->stream)
+                update_datarate(&c->datarate, c->data_count, c->worker->cur_time);
+                if (c->stream) {
+                    SERVER_LOCK();
                     c->stream->bytes_served += len;
+                    SERVER_UNLOCK();
+                }
 
                 if (c->rtp_protocol == RTSP_LOWER_TRANSPORT_TCP) {
                     /* RTP packets are sent inside the RTSP TCP connection */
@@ -2608,9 +3184,12 @@ static int http_send_data(HTTPContext *c)
                 c->buffer_ptr += len;
 
                 c->data_count += len;
-                update_datarate(&c->datarate, c->data_count);
-                if (c->stream)
+                update_datarate(&c->datarate, c->data_count, c->worker->cur_time);
+                if (c->stream) {
+                    SERVER_LOCK();
                     c->stream->bytes_served += len;
+                    SERVER_UNLOCK();
+                }
                 break;
             }
         }
@@ -2651,7 +3230,10 @@ static int http_start_receive_data(HTTPContext *c)
         /* truncate feed file */
         ffm_write_write_index(c->feed_fd, FFM_PACKET_SIZE);
         http_log("Truncating feed file '%s'\n", c->stream->feed_filename);
-        if (ftruncate(c->feed_fd, FFM_PACKET_SIZE) < 0) {
+        /* a mapped feed file is not shrunk, its clients may be reading
+         * its end; the previous data is overwritten instead */
+        if (!c->stream->feed_map &&
+            ftruncate(c->feed_fd, FFM_PACKET_SIZE) < 0) {
             ret = AVERROR(errno);
             http_log("Error truncating feed file '%s': %s\n",
                      c->stream->feed_filename, strerror(errno));
@@ -2670,7 +3252,10 @@ static int http_start_receive_data(HTTPContext *c)
     c->stream->feed_write_index = FFMAX(ffm_read_write_index(fd),
                                         FFM_PACKET_SIZE);
     c->stream->feed_size = lseek(fd, 0, SEEK_END);
+    if (c->stream->truncate && c->stream->feed_map)
+        c->stream->feed_size = FFM_PACKET_SIZE;
     lseek(fd, 0, SEEK_SET);
+    feed_map_update(c->stream);
 
     /* init buffer input */
     c->buffer_ptr = c->buffer;
@@ -2683,6 +3268,7 @@ static int http_start_receive_data(HTTPContext *c)
 static int http_receive_data(HTTPContext *c)
 {
     HTTPContext *c1;
+    FFServerStream *stream;
     int len, loop_run = 0;
 
     while (c->chunked_encoding && !c->chunk_size &&
@@ -2728,7 +3314,7 @@ static int http_receive_data(HTTPContext *c)
             c->chunk_size -= len;
             c->buffer_ptr += len;
             c->data_count += len;
-            update_datarate(&c->datarate, c->data_count);
+            update_datarate(&c->datarate, c->data_count, c->worker->cur_time);
         }
     }
 
@@ -2745,14 +3331,21 @@ static int http_receive_data(HTTPContext *c)
         /* a packet has been received : write it in the store, except
          * if header */
         if (c->data_count > FFM_PACKET_SIZE) {
-            /* XXX: use llseek or url_seek
-             * XXX: Should probably fail? */
-            if (lseek(c->feed_fd, feed->feed_write_index, SEEK_SET) == -1)
-                http_log("Seek to %"PRId64" failed\n", feed->feed_write_index);
-
-            if (write(c->feed_fd, c->buffer, FFM_PACKET_SIZE) < 0) {
-                http_log("Error writing to feed file: %s\n", strerror(errno));
-                goto fail;
+            if (feed->feed_map &&
+                feed->feed_write_index + FFM_PACKET_SIZE <= feed->feed_size) {
+                memcpy(feed->feed_map + feed->feed_write_index, c->buffer,
+                       FFM_PACKET_SIZE);
+            } else {
+                /* XXX: use llseek or url_seek
+                 * XXX: Should probably fail? */
+                if (lseek(c->feed_fd, feed->feed_write_index, SEEK_SET) == -1)
+                    http_log("Seek to %"PRId64" failed\n", feed->feed_write_index);
+
+                /* this also extends the file, and so the mapped part of it */
+                if (write(c->feed_fd, c->buffer, FFM_PACKET_SIZE) < 0) {
+                    http_log("Error writing to feed file: %s\n", strerror(errno));
+                    goto fail;
+                }
             }
 
             feed->feed_write_index += FFM_PACKET_SIZE;
@@ -2766,17 +3359,30 @@ static int http_receive_data(HTTPContext *c)
                 feed->feed_write_index = FFM_PACKET_SIZE;
 
             /* write index */
-            if (ffm_write_write_index(c->feed_fd, feed->feed_write_index) < 0) {
+            if (feed->feed_map) {
+                AV_WB64(feed->feed_map + 8, feed->feed_write_index);
+                feed_map_update(feed);
+            } else if (ffm_write_write_index(c->feed_fd, feed->feed_write_index) < 0) {
                 http_log("Error writing index to feed file: %s\n",
                          strerror(errno));
                 goto fail;
             }
 
+            /* mux the new data once for the streams shared by their
+             * clients */
+            for(stream = config.first_stream; stream; stream = stream->next) {
+                if (stream->shared && stream->feed == feed)
+                    shared_output_update(stream);
+            }
+
             /* wake up any waiting connections */
             for(c1 = first_http_ctx; c1; c1 = c1->next) {
                 if (c1->state == HTTPSTATE_WAIT_FEED &&
-                    c1->stream->feed == c->stream->feed)
+                    c1->stream->feed == c->stream->feed) {
                     c1->state = HTTPSTATE_SEND_DATA;
+                    if (c1->worker != c->worker)
+                        wake_worker(c1->worker);
+                }
             }
         } else {
             /* We have a header in our hands that contains useful data */
@@ -2834,8 +3440,11 @@ static int http_receive_data(HTTPContext *c)
     /* wake up any waiting connections to stop waiting for feed */
     for(c1 = first_http_ctx; c1; c1 = c1->next) {
         if (c1->state == HTTPSTATE_WAIT_FEED &&
-            c1->stream->feed == c->stream->feed)
+            c1->stream->feed == c->stream->feed) {
             c1->state = HTTPSTATE_SEND_DATA_TRAILER;
+            if (c1->worker != c->worker)
+                wake_worker(c1->worker);
+        }
     }
     return -1;
 }
@@ -3359,6 +3968,8 @@ static HTTPContext *rtp_new_connection(struct sockaddr_in *from_addr,
 
     c->fd = -1;
     c->poll_entry = NULL;
+    /* the RTP connections are served by the first worker, with RTSP */
+    c->worker = workers;
     c->from_addr = *from_addr;
     c->buffer_size = IOBUFFER_INIT_SIZE;
     c->buffer = av_malloc(c->buffer_size);
@@ -3744,6 +4355,35 @@ int check_codec_match(AVCodecContext *ccf, AVCodecContext *ccs, int stream)
     return matches;
 }
 
+#if HAVE_MMAP
+static void feed_map_open(FFServerStream *feed)
+{
+    int fd, prot = PROT_READ | (feed->readonly ? 0 : PROT_WRITE);
+    void *map;
+
+    if (!feed->feed_max_size) {
+        http_log("Cannot map feed file '%s' of unlimited size\n",
+                 feed->feed_filename);
+        return;
+    }
+    fd = open(feed->feed_filename, feed->readonly ? O_RDONLY : O_RDWR);
+    if (fd < 0) {
+        http_log("Could not open feed file '%s': %s\n",
+                 feed->feed_filename, strerror(errno));
+        return;
+    }
+    map = mmap(NULL, feed->feed_max_size, prot, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        http_log("Could not map feed file '%s': %s\n",
+                 feed->feed_filename, strerror(errno));
+        return;
+    }
+    feed->feed_map = map;
+    feed_map_update(feed);
+}
+#endif
+
 /* compute the needed AVStream for each feed */
 static int build_feed_streams(void)
 {
@@ -3886,6 +4526,14 @@ drop:
             feed->feed_max_size = feed->feed_size;
 
         close(fd);
+
+        if (feed->feed_mmap) {
+#if HAVE_MMAP
+            feed_map_open(feed);
+#else
+            http_log("Feed file mapping is not supported on this system\n");
+#endif
+        }
     }
     return 0;
 
@@ -659,6 +659,15 @@ static int ffserver_parse_config_global(FFServerConfig *config, const char *cmd,
                   "MaxHTTPConnections(%d)\n", config->nb_max_connections,
                   config->nb_max_http_connections);
         }
+    } else if (!av_strcasecmp(cmd, "Workers")) {
+        ffserver_get_arg(arg, sizeof(arg), p);
+        ffserver_set_int_param(&val, arg, 0, 1, 64, config,
+                "Invalid Workers: '%s'\n", arg);
+#if !HAVE_PTHREADS
+        if (val > 1)
+            ERROR("Workers > 1 requires threads support\n");
+#endif
+        config->nb_workers = val;
     } else if (!av_strcasecmp(cmd, "MaxBandwidth")) {
         int64_t llval;
         char *tailp;
@@ -785,6 +794,8 @@ static int ffserver_parse_config_feed(FFServerConfig *config, const char *cmd,
             ERROR("Feed max file size is too small. Must be at least %d.\n",
                   FFM_PACKET_SIZE*4);
         }
+    } else if (!av_strcasecmp(cmd, "FileMMap")) {
+        feed->feed_mmap = 1;
     } else if (!av_strcasecmp(cmd, "</Feed>")) {
         *pfeed = NULL;
     } else {
@@ -912,6 +923,8 @@ static int ffserver_parse_config_stream(FFServerConfig *config, const char *cmd,
         stream->prebuffer = atof(arg) * 1000;
     } else if (!av_strcasecmp(cmd, "StartSendOnKey")) {
         stream->send_on_key = 1;
+    } else if (!av_strcasecmp(cmd, "SharedOutput")) {
+        stream->shared_output = 1;
     } else if (!av_strcasecmp(cmd, "AudioCodec")) {
         ffserver_get_arg(arg, sizeof(arg), p);
         ffserver_set_codec(config->dummy_actx, arg, config);
@@ -1118,6 +1131,10 @@ static int ffserver_parse_config_stream(FFServerConfig *config, const char *cmd,
         stream->loop = 0;
     } else if (!av_strcasecmp(cmd, "</Stream>")) {
         config->stream_use_defaults &= 1;
+        if (stream->shared_output && !stream->feed) {
+            WARNING("SharedOutput is only supported for streams from a feed\n");
+            stream->shared_output = 0;
+        }
         if (stream->feed && stream->fmt && strcmp(stream->fmt->name, "ffm")) {
             if (config->dummy_actx->codec_id == AV_CODEC_ID_NONE)
                 config->dummy_actx->codec_id = config->guessed_audio_codec_id;
@@ -80,6 +80,8 @@ typedef struct FFServerStream {
     int multicast_ttl;
     int loop;                     /* if true, send the stream in loops (only meaningful if file) */
     char single_frame;            /* only single frame */
+    int shared_output;            /* if true, mux the feed once for all the clients */
+    struct SharedOutput *shared;  /* output muxed for the current clients */
 
     /* feed specific */
     int feed_opened;              /* true if someone is writing to the feed */
@@ -91,6 +93,10 @@ typedef struct FFServerStream {
     int64_t feed_max_size;        /* maximum storage size, zero means unlimited */
     int64_t feed_write_index;     /* current write position in feed (it wraps around) */
     int64_t feed_size;            /* current size of feed */
+    int feed_mmap;                /* true if the feed file must be mapped in memory */
+    uint8_t *feed_map;            /* mapping of the feed file, of feed_max_size bytes */
+    volatile int feed_map_write;  /* write index of a mapped feed, in packets */
+    volatile int feed_map_size;   /* size of a mapped feed, in packets */
     struct FFServerStream *next_feed;
 } FFServerStream;
 
@@ -100,6 +106,7 @@ typedef struct FFServerConfig {
     FFServerStream *first_stream; /* contains all streams, including feeds */
     unsigned int nb_max_http_connections;
     unsigned int nb_max_connections;
+    int nb_workers;
     uint64_t max_bandwidth;
     int debug;
     char logfilename[1024];
@@ -31,7 +31,6 @@
  * the following functions from aacenc_quantization/util.h. They're not included
  * explicitly here to make it possible to provide alternative implementations:
  *  - quantize_band_cost_bits
- *  - abs_pow34_v
  */
 
 #ifndef AVCODEC_AACCODER_TRELLIS_H
@@ -70,7 +69,7 @@ static void codebook_trellis_rate(AACEncContext *s, SingleChannelElement *sce,
     float next_minbits = INFINITY;
     int next_mincb = 0;
 
-    abs_pow34_v(s->scoefs, sce->coeffs, 1024);
+    s->aacdsp.abs_pow34(s->scoefs, sce->coeffs, 1024);
     start = win*128;
     for (cb = 0; cb < CB_TOT_ALL; cb++) {
         path[0][cb].cost     = run_bits+4;
@@ -31,7 +31,6 @@
  * the following functions from aacenc_quantization/util.h. They're not included
  * explicitly here to make it possible to provide alternative implementations:
  *  - quantize_band_cost
- *  - abs_pow34_v
  *  - find_max_val
  *  - find_min_book
  *  - find_form_factor
@@ -291,7 +290,7 @@ static void search_for_quantizers_twoloop(AVCodecContext *avctx,
 
     if (!allz)
         return;
-    abs_pow34_v(s->scoefs, sce->coeffs, 1024);
+    s->aacdsp.abs_pow34(s->scoefs, sce->coeffs, 1024);
     ff_quantize_band_cost_cache_init(s);
 
     for (w = 0; w < sce->ics.num_windows; w += sce->ics.group_len[w]) {
@@ -506,6 +506,19 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+static int search_for_quantizers_thread(AVCodecContext *avctx, void *arg,
+                                        int jobnr, int threadnr)
+{
+    AACEncContext *s = avctx->priv_data;
+    AACEncContext *t = s->thread[jobnr];
+    SingleChannelElement *sce = ((SingleChannelElement **)arg)[jobnr];
+
+    if (t->options.pns && t->coder->mark_pns)
+        t->coder->mark_pns(t, avctx, sce);
+    t->coder->search_for_quantizers(avctx, t, sce, t->lambda);
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
@@ -519,6 +532,10 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
     int ms_mode = 0, is_mode = 0, tns_mode = 0, pred_mode = 0;
     int chan_el_counter[4];
     FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
+    SingleChannelElement *search_sce[AAC_MAX_CHANNELS];
+    /* The analysis of an element reads the psy cutoff that twoloop settles
+     * on during the first frame, so only search in parallel after it. */
+    int threaded = s->thread && avctx->frame_number > 1;
 
     if (s->last_frame == 2)
         return 0;
@@ -554,6 +571,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             if (!frame)
                 la = NULL;
             if (tag == TYPE_LFE) {
+                memset(&wi[ch], 0, sizeof(wi[ch]));
                 wi[ch].window_type[0] = ONLY_LONG_SEQUENCE;
                 wi[ch].window_shape   = 0;
                 wi[ch].num_windows    = 1;
@@ -627,7 +645,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             put_bitstream_info(s, LIBAVCODEC_IDENT);
         start_ch = 0;
         target_bits = 0;
-        memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < s->chan_map[0]; i++) {
             FFPsyWindowInfo* wi = windows + start_ch;
             const float *coeffs[2];
@@ -637,8 +654,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             cpe->common_window = 0;
             memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
             memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
-            put_bits(&s->pb, 3, tag);
-            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             for (ch = 0; ch < chans; ch++) {
                 sce = &cpe->ch[ch];
                 coeffs[ch] = sce->coeffs;
@@ -663,10 +678,36 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             s->cur_type = tag;
             for (ch = 0; ch < chans; ch++) {
                 s->cur_channel = start_ch + ch;
+                if (threaded) {
+                    AACEncContext *t = s->thread[s->cur_channel];
+                    t->psy         = s->psy;
+                    t->lambda      = s->lambda;
+                    t->cur_type    = tag;
+                    t->cur_channel = s->cur_channel;
+                    search_sce[s->cur_channel] = &cpe->ch[ch];
+                    continue;
+                }
                 if (s->options.pns && s->coder->mark_pns)
                     s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
                 s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
             }
+            start_ch += chans;
+        }
+        if (threaded) {
+            avctx->execute2(avctx, search_for_quantizers_thread, search_sce,
+                            NULL, s->channels);
+            s->psy.cutoff = s->thread[s->channels - 1]->psy.cutoff;
+        }
+
+        start_ch = 0;
+        memset(chan_el_counter, 0, sizeof(chan_el_counter));
+        for (i = 0; i < s->chan_map[0]; i++) {
+            FFPsyWindowInfo* wi = windows + start_ch;
+            tag      = s->chan_map[i+1];
+            chans    = tag == TYPE_CPE ? 2 : 1;
+            cpe      = &s->cpe[i];
+            put_bits(&s->pb, 3, tag);
+            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             if (chans > 1
                 && wi[0].window_type[0] == wi[1].window_type[0]
                 && wi[0].window_shape   == wi[1].window_shape) {
@@ -706,6 +747,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                         s->coder->search_for_pred(s, sce);
                     if (cpe->ch[ch].ics.predictor_present) pred_mode = 1;
                 }
+                s->cur_channel = start_ch;
                 if (s->coder->adjust_common_pred)
                     s->coder->adjust_common_pred(s, cpe);
                 for (ch = 0; ch < chans; ch++) {
@@ -841,9 +883,16 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 static av_cold int aac_encode_end(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
+    int ch;
 
     av_log(avctx, AV_LOG_INFO, "Qavg: %.3f\n", s->lambda_sum / s->lambda_count);
 
+    if (s->thread) {
+        for (ch = 0; ch < s->channels; ch++)
+            av_freep(&s->thread[ch]);
+        av_freep(&s->thread);
+    }
+
     ff_mdct_end(&s->mdct1024);
     ff_mdct_end(&s->mdct128);
     ff_psy_end(&s->psy);
@@ -865,6 +914,8 @@ static av_cold int dsp_init(AVCodecContext *avctx, AACEncContext *s)
     if (!s->fdsp)
         return AVERROR(ENOMEM);
 
+    ff_aacenc_dsp_init(&s->aacdsp);
+
     // window init
     ff_kbd_window_init(ff_aac_kbd_long_1024, 4.0, 1024);
     ff_kbd_window_init(ff_aac_kbd_short_128, 6.0, 128);
@@ -1027,6 +1078,26 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
 
     ff_af_queue_init(avctx, &s->afq);
 
+    /* The quantizer search of each channel runs on its own copy of the
+     * context, so that the scratch buffers and the cost cache it uses
+     * are not shared. */
+    if (avctx->active_thread_type & FF_THREAD_SLICE && s->channels > 1) {
+        s->thread = av_mallocz_array(s->channels, sizeof(*s->thread));
+        if (!s->thread) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        for (i = 0; i < s->channels; i++) {
+            s->thread[i] = av_malloc(sizeof(AACEncContext));
+            if (!s->thread[i]) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+            memcpy(s->thread[i], s, sizeof(AACEncContext));
+            s->thread[i]->thread = NULL;
+        }
+    }
+
     return 0;
 fail:
     aac_encode_end(avctx);
@@ -1072,7 +1143,8 @@ AVCodec ff_aac_encoder = {
     .defaults       = aac_encode_defaults,
     .supported_samplerates = mpeg4audio_sample_rates,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_FLTP,
                                                      AV_SAMPLE_FMT_NONE },
     .priv_class     = &aacenc_class,
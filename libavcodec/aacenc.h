@@ -28,6 +28,7 @@
 #include "put_bits.h"
 
 #include "aac.h"
+#include "aacencdsp.h"
 #include "audio_frame_queue.h"
 #include "psymodel.h"
 
@@ -100,6 +101,7 @@ typedef struct AACEncContext {
     FFTContext mdct1024;                         ///< long (1024 samples) frame transform context
     FFTContext mdct128;                          ///< short (128 samples) frame transform context
     AVFloatDSPContext *fdsp;
+    AACEncDSPContext aacdsp;
     AVLFG lfg;                                   ///< PRNG needed for PNS
     float *planar_samples[8];                    ///< saved preprocessed input
 
@@ -132,6 +134,8 @@ typedef struct AACEncContext {
     struct {
         float *samples;
     } buffer;
+
+    struct AACEncContext **thread;               ///< per-channel contexts for the threaded quantizer search
 } AACEncContext;
 
 void ff_aac_coder_init_mips(AACEncContext *c);
@@ -62,21 +62,6 @@ static inline int quant(float coef, const float Q, const float rounding)
     return sqrtf(a * sqrtf(a)) + rounding;
 }
 
-static inline void quantize_bands(int *out, const float *in, const float *scaled,
-                                  int size, float Q34, int is_signed, int maxval,
-                                  const float rounding)
-{
-    int i;
-    for (i = 0; i < size; i++) {
-        float qc = scaled[i] * Q34;
-        int tmp = (int)FFMIN(qc + rounding, (float)maxval);
-        if (is_signed && in[i] < 0.0f) {
-            tmp = -tmp;
-        }
-        out[i] = tmp;
-    }
-}
-
 static inline float find_max_val(int group_len, int swb_size, const float *scaled)
 {
     float maxval = 0.0f;
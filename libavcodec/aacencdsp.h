@@ -0,0 +1,49 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_AACENCDSP_H
+#define AVCODEC_AACENCDSP_H
+
+typedef struct AACEncDSPContext {
+    /**
+     * Compute |in[i]|^(3/4) for each coefficient.
+     * @param out  output buffer, 16-byte aligned
+     * @param in   input coefficients, 16-byte aligned
+     * @param size number of coefficients, a multiple of 4
+     */
+    void (*abs_pow34)(float *out, const float *in, const int size);
+
+    /**
+     * Quantize the scaled coefficients of a band with the given quantizer.
+     * @param out       quantized values, 16-byte aligned
+     * @param in        input coefficients, only their sign is used, 16-byte aligned
+     * @param scaled    input coefficients after abs_pow34(), 16-byte aligned
+     * @param size      number of coefficients, a multiple of 4
+     * @param is_signed whether to copy the sign of in[] to the output
+     * @param maxval    maximum absolute quantized value
+     * @param Q34       quantizer, raised to the 3/4 power
+     * @param rounding  rounding offset added before truncation
+     */
+    void (*quant_bands)(int *out, const float *in, const float *scaled,
+                        int size, int is_signed, int maxval, const float Q34,
+                        const float rounding);
+} AACEncDSPContext;
+
+void ff_aacenc_dsp_init(AACEncDSPContext *s);
+
+#endif /* AVCODEC_AACENCDSP_H */
@@ -75,12 +75,12 @@ av_cold int AC3_NAME(mdct_init)(AC3EncodeContext *s)
  * Normalize the input samples to use the maximum available precision.
  * This assumes signed 16-bit input samples.
  */
-static int normalize_samples(AC3EncodeContext *s)
+static int normalize_samples(AC3EncodeContext *s, int16_t *windowed_samples)
 {
-    int v = s->ac3dsp.ac3_max_msb_abs_int16(s->windowed_samples, AC3_WINDOW_SIZE);
+    int v = s->ac3dsp.ac3_max_msb_abs_int16(windowed_samples, AC3_WINDOW_SIZE);
     v = 14 - av_log2(v);
     if (v > 0)
-        s->ac3dsp.ac3_lshift_int16(s->windowed_samples, AC3_WINDOW_SIZE, v);
+        s->ac3dsp.ac3_lshift_int16(windowed_samples, AC3_WINDOW_SIZE, v);
     /* +6 to right-shift from 31-bit to 25-bit */
     return v + 6;
 }
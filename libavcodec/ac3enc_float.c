@@ -90,7 +90,7 @@ av_cold int ff_ac3_float_mdct_init(AC3EncodeContext *s)
  * Normalize the input samples.
  * Not needed for the floating-point encoder.
  */
-static int normalize_samples(AC3EncodeContext *s)
+static int normalize_samples(AC3EncodeContext *s, float *windowed_samples)
 {
     return 0;
 }
@@ -156,6 +156,7 @@ AVCodec ff_ac3_encoder = {
     .close           = ff_ac3_encode_close,
     .sample_fmts     = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_FLTP,
                                                       AV_SAMPLE_FMT_NONE },
+    .capabilities    = AV_CODEC_CAP_SLICE_THREADS,
     .priv_class      = &ac3enc_class,
     .channel_layouts = ff_ac3_channel_layouts,
     .defaults        = ac3_defaults,
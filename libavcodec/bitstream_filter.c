@@ -23,6 +23,7 @@
 #include "avcodec.h"
 #include "libavutil/atomic.h"
 #include "libavutil/mem.h"
+#include "libavutil/opt.h"
 
 static AVBitStreamFilter *first_bitstream_filter = NULL;
 
@@ -41,6 +42,15 @@ void av_register_bitstream_filter(AVBitStreamFilter *bsf)
     } while(bsf->next != avpriv_atomic_ptr_cas((void * volatile *)&first_bitstream_filter, bsf->next, bsf));
 }
 
+/**
+ * Private data of the filters implementing the AVBSFContext API when they
+ * are used through the av_bitstream_filter_*() calls.
+ */
+typedef struct BSFCompatContext {
+    AVBSFContext *ctx;
+    int extradata_updated;
+} BSFCompatContext;
+
 AVBitStreamFilterContext *av_bitstream_filter_init(const char *name)
 {
     AVBitStreamFilter *bsf = NULL;
@@ -49,12 +59,14 @@ AVBitStreamFilterContext *av_bitstream_filter_init(const char *name)
         if (!strcmp(name, bsf->name)) {
             AVBitStreamFilterContext *bsfc =
                 av_mallocz(sizeof(AVBitStreamFilterContext));
+            int priv_data_size = bsf->filter_packet ? sizeof(BSFCompatContext)
+                                                    : bsf->priv_data_size;
             if (!bsfc)
                 return NULL;
             bsfc->filter    = bsf;
             bsfc->priv_data = NULL;
-            if (bsf->priv_data_size) {
-                bsfc->priv_data = av_mallocz(bsf->priv_data_size);
+            if (priv_data_size) {
+                bsfc->priv_data = av_mallocz(priv_data_size);
                 if (!bsfc->priv_data) {
                     av_freep(&bsfc);
                     return NULL;
@@ -70,7 +82,10 @@ void av_bitstream_filter_close(AVBitStreamFilterContext *bsfc)
 {
     if (!bsfc)
         return;
-    if (bsfc->filter->close)
+    if (bsfc->filter->filter_packet) {
+        BSFCompatContext *priv = bsfc->priv_data;
+        av_bsf_free(&priv->ctx);
+    } else if (bsfc->filter->close)
         bsfc->filter->close(bsfc);
     av_freep(&bsfc->priv_data);
     av_freep(&bsfc->args);
@@ -78,11 +93,132 @@ void av_bitstream_filter_close(AVBitStreamFilterContext *bsfc)
     av_free(bsfc);
 }
 
+static int compat_init(AVBitStreamFilterContext *bsfc, AVCodecContext *avctx,
+                       const char *args)
+{
+    BSFCompatContext *priv = bsfc->priv_data;
+    AVBSFContext *ctx;
+    int ret;
+
+    ret = av_bsf_alloc(bsfc->filter, &priv->ctx);
+    if (ret < 0)
+        return ret;
+    ctx = priv->ctx;
+
+    if (avctx) {
+        ret = avcodec_parameters_from_context(ctx->par_in, avctx);
+        if (ret < 0)
+            goto fail;
+        ctx->time_base_in = avctx->time_base;
+    }
+
+    if (args && bsfc->filter->priv_class) {
+        ret = av_set_options_string(ctx->priv_data, args, "=", ":");
+        if (ret < 0)
+            goto fail;
+    }
+
+    ret = av_bsf_init(ctx);
+    if (ret < 0)
+        goto fail;
+
+    return 0;
+fail:
+    av_bsf_free(&priv->ctx);
+    return ret;
+}
+
+static int compat_filter(AVBitStreamFilterContext *bsfc,
+                         AVCodecContext *avctx, const char *args,
+                         uint8_t **poutbuf, int *poutbuf_size,
+                         const uint8_t *buf, int buf_size, int keyframe)
+{
+    BSFCompatContext *priv = bsfc->priv_data;
+    AVPacket pkt = { 0 };
+    int ret;
+
+    if (!priv->ctx) {
+        ret = compat_init(bsfc, avctx, args);
+        if (ret < 0)
+            return ret;
+    }
+
+    /* the input is not reference-counted, which lets the filters pass it
+     * through without a copy */
+    pkt.data = (uint8_t *)buf;
+    pkt.size = buf_size;
+    if (keyframe)
+        pkt.flags |= AV_PKT_FLAG_KEY;
+
+    ret = av_bsf_send_packet(priv->ctx, &pkt);
+    if (ret < 0)
+        return ret;
+
+    *poutbuf      = NULL;
+    *poutbuf_size = 0;
+
+    ret = av_bsf_receive_packet(priv->ctx, &pkt);
+    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+        ret = 0;
+    } else if (ret < 0) {
+        return ret;
+    } else if (!pkt.buf) {
+        /* the output points into the input buffer */
+        *poutbuf      = pkt.data;
+        *poutbuf_size = pkt.size;
+        ret = 0;
+    } else {
+        *poutbuf = av_malloc(pkt.size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!*poutbuf) {
+            av_packet_unref(&pkt);
+            return AVERROR(ENOMEM);
+        }
+        memcpy(*poutbuf, pkt.data, pkt.size);
+        memset(*poutbuf + pkt.size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        *poutbuf_size = pkt.size;
+        av_packet_unref(&pkt);
+        ret = 1;
+    }
+
+    /* only one output packet can be returned through this API, drop the
+     * others */
+    while (av_bsf_receive_packet(priv->ctx, &pkt) >= 0)
+        av_packet_unref(&pkt);
+
+    if (avctx && !priv->extradata_updated &&
+        !(args && strstr(args, "private_spspps_buf"))) {
+        AVCodecParameters *par = priv->ctx->par_out;
+
+        priv->extradata_updated = 1;
+        if (par->extradata_size != avctx->extradata_size ||
+            (par->extradata_size &&
+             memcmp(par->extradata, avctx->extradata, par->extradata_size))) {
+            uint8_t *extradata = av_mallocz(par->extradata_size +
+                                            AV_INPUT_BUFFER_PADDING_SIZE);
+            if (!extradata) {
+                if (ret > 0)
+                    av_freep(poutbuf);
+                return AVERROR(ENOMEM);
+            }
+            memcpy(extradata, par->extradata, par->extradata_size);
+            av_freep(&avctx->extradata);
+            avctx->extradata      = extradata;
+            avctx->extradata_size = par->extradata_size;
+        }
+    }
+
+    return ret;
+}
+
 int av_bitstream_filter_filter(AVBitStreamFilterContext *bsfc,
                                AVCodecContext *avctx, const char *args,
                                uint8_t **poutbuf, int *poutbuf_size,
                                const uint8_t *buf, int buf_size, int keyframe)
 {
+    if (bsfc->filter->filter_packet)
+        return compat_filter(bsfc, avctx, args ? args : bsfc->args,
+                             poutbuf, poutbuf_size, buf, buf_size, keyframe);
+
     *poutbuf      = (uint8_t *)buf;
     *poutbuf_size = buf_size;
     return bsfc->filter->filter(bsfc, avctx, args ? args : bsfc->args,
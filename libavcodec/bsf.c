@@ -0,0 +1,350 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+
+#include "avcodec.h"
+#include "bsf.h"
+
+struct AVBSFInternal {
+    AVPacket *buffer_pkt;
+    int eof;
+
+    /* filters without filter_packet() are run through their legacy
+     * callbacks, on a codec context holding the stream parameters */
+    AVBitStreamFilterContext *legacy;
+    AVCodecContext *legacy_avctx;
+};
+
+const AVBitStreamFilter *av_bsf_get_by_name(const char *name)
+{
+    const AVBitStreamFilter *f = NULL;
+
+    if (!name)
+        return NULL;
+
+    while ((f = av_bitstream_filter_next(f)))
+        if (!strcmp(f->name, name))
+            return f;
+
+    return NULL;
+}
+
+static const char *bsf_to_name(void *bsf)
+{
+    return ((AVBSFContext *)bsf)->filter->name;
+}
+
+static void *bsf_child_next(void *obj, void *prev)
+{
+    AVBSFContext *ctx = obj;
+
+    if (!prev && ctx->filter->priv_class)
+        return ctx->priv_data;
+    return NULL;
+}
+
+static const AVClass *bsf_child_class_next(const AVClass *prev)
+{
+    const AVBitStreamFilter *f = NULL;
+
+    /* find the filter that corresponds to prev */
+    while (prev && (f = av_bitstream_filter_next(f)))
+        if (f->priv_class == prev)
+            break;
+
+    /* find next filter with priv options */
+    while ((f = av_bitstream_filter_next(f)))
+        if (f->priv_class)
+            return f->priv_class;
+    return NULL;
+}
+
+static const AVClass bsf_class = {
+    .class_name       = "AVBSFContext",
+    .item_name        = bsf_to_name,
+    .version          = LIBAVUTIL_VERSION_INT,
+    .child_next       = bsf_child_next,
+    .child_class_next = bsf_child_class_next,
+};
+
+const AVClass *av_bsf_get_class(void)
+{
+    return &bsf_class;
+}
+
+void av_bsf_free(AVBSFContext **pctx)
+{
+    AVBSFContext *ctx;
+
+    if (!pctx || !*pctx)
+        return;
+    ctx = *pctx;
+
+    if (ctx->internal) {
+        if (ctx->internal->legacy)
+            av_bitstream_filter_close(ctx->internal->legacy);
+        else if (ctx->filter->uninit)
+            ctx->filter->uninit(ctx);
+        avcodec_free_context(&ctx->internal->legacy_avctx);
+        av_packet_free(&ctx->internal->buffer_pkt);
+        av_freep(&ctx->internal);
+    }
+    if (ctx->filter->priv_class && ctx->priv_data)
+        av_opt_free(ctx->priv_data);
+    av_freep(&ctx->priv_data);
+
+    avcodec_parameters_free(&ctx->par_in);
+    avcodec_parameters_free(&ctx->par_out);
+
+    av_freep(pctx);
+}
+
+int av_bsf_alloc(const AVBitStreamFilter *filter, AVBSFContext **pctx)
+{
+    AVBSFContext *ctx;
+    int ret;
+
+    ctx = av_mallocz(sizeof(*ctx));
+    if (!ctx)
+        return AVERROR(ENOMEM);
+
+    ctx->av_class = &bsf_class;
+    ctx->filter   = filter;
+
+    ctx->par_in  = avcodec_parameters_alloc();
+    ctx->par_out = avcodec_parameters_alloc();
+    if (!ctx->par_in || !ctx->par_out) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ctx->internal = av_mallocz(sizeof(*ctx->internal));
+    if (!ctx->internal) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ctx->internal->buffer_pkt = av_packet_alloc();
+    if (!ctx->internal->buffer_pkt) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* allocate priv data and init private options; the legacy filters
+     * allocate their own */
+    if (filter->filter_packet && filter->priv_data_size) {
+        ctx->priv_data = av_mallocz(filter->priv_data_size);
+        if (!ctx->priv_data) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        if (filter->priv_class) {
+            *(const AVClass **)ctx->priv_data = filter->priv_class;
+            av_opt_set_defaults(ctx->priv_data);
+        }
+    }
+
+    *pctx = ctx;
+    return 0;
+fail:
+    av_bsf_free(&ctx);
+    return ret;
+}
+
+static int legacy_init(AVBSFContext *ctx)
+{
+    AVBSFInternal *bsfi = ctx->internal;
+    AVBitStreamFilterContext *bsfc;
+
+    bsfc = av_mallocz(sizeof(*bsfc));
+    if (!bsfc)
+        return AVERROR(ENOMEM);
+    bsfc->filter = (AVBitStreamFilter *)ctx->filter;
+    bsfi->legacy = bsfc;
+
+    if (ctx->filter->priv_data_size &&
+        !(bsfc->priv_data = av_mallocz(ctx->filter->priv_data_size)))
+        return AVERROR(ENOMEM);
+
+    if (!(bsfi->legacy_avctx = avcodec_alloc_context3(NULL)))
+        return AVERROR(ENOMEM);
+    return avcodec_parameters_to_context(bsfi->legacy_avctx, ctx->par_in);
+}
+
+int av_bsf_init(AVBSFContext *ctx)
+{
+    int ret, i;
+
+    /* check that the codec is supported */
+    if (ctx->filter->codec_ids) {
+        for (i = 0; ctx->filter->codec_ids[i] != AV_CODEC_ID_NONE; i++)
+            if (ctx->par_in->codec_id == ctx->filter->codec_ids[i])
+                break;
+        if (ctx->filter->codec_ids[i] == AV_CODEC_ID_NONE) {
+            const AVCodecDescriptor *desc = avcodec_descriptor_get(ctx->par_in->codec_id);
+            av_log(ctx, AV_LOG_ERROR, "Codec '%s' (%d) is not supported by the "
+                   "bitstream filter '%s'. Supported codecs are: ",
+                   desc ? desc->name : "unknown", ctx->par_in->codec_id, ctx->filter->name);
+            for (i = 0; ctx->filter->codec_ids[i] != AV_CODEC_ID_NONE; i++) {
+                desc = avcodec_descriptor_get(ctx->filter->codec_ids[i]);
+                av_log(ctx, AV_LOG_ERROR, "%s (%d) ",
+                       desc ? desc->name : "unknown", ctx->filter->codec_ids[i]);
+            }
+            av_log(ctx, AV_LOG_ERROR, "\n");
+            return AVERROR(EINVAL);
+        }
+    }
+
+    /* initialize output parameters to be the same as input
+     * init below might overwrite that */
+    ret = avcodec_parameters_copy(ctx->par_out, ctx->par_in);
+    if (ret < 0)
+        return ret;
+
+    ctx->time_base_out = ctx->time_base_in;
+
+    if (!ctx->filter->filter_packet)
+        return legacy_init(ctx);
+
+    if (ctx->filter->init) {
+        ret = ctx->filter->init(ctx);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+int av_bsf_send_packet(AVBSFContext *ctx, AVPacket *pkt)
+{
+    if (!pkt || (!pkt->data && !pkt->side_data_elems)) {
+        ctx->internal->eof = 1;
+        return 0;
+    }
+
+    if (ctx->internal->eof) {
+        av_log(ctx, AV_LOG_ERROR, "A non-NULL packet sent after an EOF.\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (ctx->internal->buffer_pkt->data ||
+        ctx->internal->buffer_pkt->side_data_elems)
+        return AVERROR(EAGAIN);
+
+    av_packet_move_ref(ctx->internal->buffer_pkt, pkt);
+
+    return 0;
+}
+
+int ff_bsf_get_packet_ref(AVBSFContext *ctx, AVPacket *pkt)
+{
+    AVBSFInternal *bsfi = ctx->internal;
+
+    if (!bsfi->buffer_pkt->data && !bsfi->buffer_pkt->side_data_elems)
+        return bsfi->eof ? AVERROR_EOF : AVERROR(EAGAIN);
+
+    av_packet_move_ref(pkt, bsfi->buffer_pkt);
+
+    return 0;
+}
+
+/* the legacy filters may replace the extradata of their codec context */
+static int legacy_update_extradata(AVBSFContext *ctx)
+{
+    AVCodecContext *avctx = ctx->internal->legacy_avctx;
+    AVCodecParameters *par = ctx->par_out;
+
+    if (avctx->extradata_size == par->extradata_size &&
+        (!par->extradata_size ||
+         !memcmp(avctx->extradata, par->extradata, par->extradata_size)))
+        return 0;
+
+    av_freep(&par->extradata);
+    par->extradata_size = 0;
+    if (avctx->extradata_size > 0) {
+        par->extradata = av_mallocz(avctx->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!par->extradata)
+            return AVERROR(ENOMEM);
+        memcpy(par->extradata, avctx->extradata, avctx->extradata_size);
+        par->extradata_size = avctx->extradata_size;
+    }
+    return 0;
+}
+
+static int legacy_filter(AVBSFContext *ctx, AVPacket *out)
+{
+    AVBSFInternal *bsfi = ctx->internal;
+    AVPacket in;
+    uint8_t *data;
+    int size, ret;
+
+    ret = ff_bsf_get_packet_ref(ctx, &in);
+    if (ret < 0)
+        return ret;
+
+    ret = av_bitstream_filter_filter(bsfi->legacy, bsfi->legacy_avctx, NULL,
+                                     &data, &size, in.data, in.size,
+                                     in.flags & AV_PKT_FLAG_KEY);
+    if (ret < 0) {
+        av_packet_unref(&in);
+        return ret;
+    }
+
+    if (!ret && !size && !in.side_data_elems) {
+        /* the packet is dropped */
+        av_packet_unref(&in);
+        ret = AVERROR(EAGAIN);
+    } else if (ret > 0) {
+        AVBufferRef *buf = av_buffer_create(data, size, av_buffer_default_free,
+                                            NULL, 0);
+        if (!buf) {
+            av_free(data);
+            av_packet_unref(&in);
+            return AVERROR(ENOMEM);
+        }
+        av_packet_move_ref(out, &in);
+        av_buffer_unref(&out->buf);
+        out->buf  = buf;
+        out->data = data;
+        out->size = size;
+        ret = 0;
+    } else {
+        /* the output is a part of the input buffer */
+        av_packet_move_ref(out, &in);
+        out->data = data;
+        out->size = size;
+    }
+
+    if (legacy_update_extradata(ctx) < 0) {
+        av_packet_unref(out);
+        return AVERROR(ENOMEM);
+    }
+    return ret;
+}
+
+int av_bsf_receive_packet(AVBSFContext *ctx, AVPacket *pkt)
+{
+    if (ctx->internal->legacy)
+        return legacy_filter(ctx, pkt);
+    return ctx->filter->filter_packet(ctx, pkt);
+}
@@ -0,0 +1,38 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_BSF_H
+#define AVCODEC_BSF_H
+
+#include "avcodec.h"
+
+/**
+ * Called by the bitstream filters to get the next packet for filtering.
+ * The packet is moved into pkt, and the filter is responsible for either
+ * unreferencing it or passing it to the caller.
+ *
+ * The packet is not necessarily reference-counted, e.g. when it comes
+ * through the legacy av_bitstream_filter_filter() API, so filters must not
+ * keep references to its data after returning without referencing it first.
+ *
+ * @return 0 on success, AVERROR(EAGAIN) if no packet is available,
+ *         AVERROR_EOF at the end of the stream
+ */
+int ff_bsf_get_packet_ref(AVBSFContext *ctx, AVPacket *pkt);
+
+#endif /* AVCODEC_BSF_H */
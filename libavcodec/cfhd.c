@@ -46,6 +46,8 @@ static av_cold int cfhd_decode_init(AVCodecContext *avctx)
     avctx->width               = 0;
     avctx->height              = 0;
 
+    ff_cfhddsp_init(&s->dsp);
+
     return ff_cfhd_init_vlcs(s);
 }
 
@@ -79,63 +81,6 @@ static inline int dequant_and_decompand(int level, int quantisation)
     return (abslevel + ((768 * abslevel * abslevel * abslevel) / (255 * 255 * 255))) * FFSIGN(level) * quantisation;
 }
 
-static inline void filter(int16_t *output, ptrdiff_t out_stride, int16_t *low, ptrdiff_t low_stride,
-                          int16_t *high, ptrdiff_t high_stride, int len, uint8_t clip)
-{
-    int16_t tmp;
-
-    int i;
-    for (i = 0; i < len; i++) {
-        if (i == 0) {
-            tmp = (11*low[0*low_stride] - 4*low[1*low_stride] + low[2*low_stride] + 4) >> 3;
-            output[(2*i+0)*out_stride] = (tmp + high[0*high_stride]) >> 1;
-            if (clip)
-                output[(2*i+0)*out_stride] = av_clip_uintp2_c(output[(2*i+0)*out_stride], clip);
-
-            tmp = ( 5*low[0*low_stride] + 4*low[1*low_stride] - low[2*low_stride] + 4) >> 3;
-            output[(2*i+1)*out_stride] = (tmp - high[0*high_stride]) >> 1;
-            if (clip)
-                output[(2*i+1)*out_stride] = av_clip_uintp2_c(output[(2*i+1)*out_stride], clip);
-        } else if (i == len-1) {
-            tmp = ( 5*low[i*low_stride] + 4*low[(i-1)*low_stride] - low[(i-2)*low_stride] + 4) >> 3;
-            output[(2*i+0)*out_stride] = (tmp + high[i*high_stride]) >> 1;
-            if (clip)
-                output[(2*i+0)*out_stride] = av_clip_uintp2_c(output[(2*i+0)*out_stride], clip);
-
-            tmp = (11*low[i*low_stride] - 4*low[(i-1)*low_stride] + low[(i-2)*low_stride] + 4) >> 3;
-            output[(2*i+1)*out_stride] = (tmp - high[i*high_stride]) >> 1;
-            if (clip)
-                output[(2*i+1)*out_stride] = av_clip_uintp2_c(output[(2*i+1)*out_stride], clip);
-        } else {
-            tmp = (low[(i-1)*low_stride] - low[(i+1)*low_stride] + 4) >> 3;
-            output[(2*i+0)*out_stride] = (tmp + low[i*low_stride] + high[i*high_stride]) >> 1;
-            if (clip)
-                output[(2*i+0)*out_stride] = av_clip_uintp2_c(output[(2*i+0)*out_stride], clip);
-
-            tmp = (low[(i+1)*low_stride] - low[(i-1)*low_stride] + 4) >> 3;
-            output[(2*i+1)*out_stride] = (tmp + low[i*low_stride] - high[i*high_stride]) >> 1;
-            if (clip)
-                output[(2*i+1)*out_stride] = av_clip_uintp2_c(output[(2*i+1)*out_stride], clip);
-        }
-    }
-}
-
-static void horiz_filter(int16_t *output, int16_t *low, int16_t *high, int width)
-{
-    filter(output, 1, low, 1, high, 1, width, 0);
-}
-
-static void horiz_filter_clip(int16_t *output, int16_t *low, int16_t *high, int width, uint8_t clip)
-{
-    filter(output, 1, low, 1, high, 1, width, clip);
-}
-
-static void vert_filter(int16_t *output, int out_stride, int16_t *low, int low_stride,
-                        int16_t *high, int high_stride, int len)
-{
-    filter(output, out_stride, low, low_stride, high, high_stride, len, 0);
-}
-
 static void free_buffers(AVCodecContext *avctx)
 {
     CFHDContext *s = avctx->priv_data;
@@ -220,6 +165,102 @@ static int alloc_buffers(AVCodecContext *avctx)
     return 0;
 }
 
+/* inverse wavelet transform of the three levels of a plane, run for each
+ * plane as a separate job */
+static int reconstruct_plane(AVCodecContext *avctx, void *arg,
+                             int plane, int threadnr)
+{
+    CFHDContext *s = avctx->priv_data;
+    AVFrame *pic   = arg;
+    Plane *p       = &s->plane[plane];
+    /* level 1 */
+    int lowpass_height  = p->band[0][0].height;
+    int lowpass_width   = p->band[0][0].width;
+    int highpass_stride = p->band[0][1].stride;
+    int act_plane = plane == 1 ? 2 : plane == 2 ? 1 : plane;
+    int16_t *output;
+    int i, j;
+
+    if (lowpass_height > p->band[0][0].a_height || lowpass_width > p->band[0][0].a_width ||
+        !highpass_stride || p->band[0][1].width > p->band[0][1].a_width) {
+        av_log(avctx, AV_LOG_ERROR, "Invalid plane dimensions\n");
+        return AVERROR(EINVAL);
+    }
+
+    av_log(avctx, AV_LOG_DEBUG, "Decoding level 1 plane %i %i %i %i\n", plane, lowpass_height, lowpass_width, highpass_stride);
+
+    s->dsp.vert_filter(p->l_h[0], lowpass_width, p->subband[0], lowpass_width,
+                       p->subband[2], highpass_stride, lowpass_width, lowpass_height);
+    // note the stride of "low" is highpass_stride
+    s->dsp.vert_filter(p->l_h[1], lowpass_width, p->subband[1], highpass_stride,
+                       p->subband[3], highpass_stride, lowpass_width, lowpass_height);
+
+    s->dsp.horiz_filter(p->subband[0], lowpass_width * 2, p->l_h[0], lowpass_width,
+                        p->l_h[1], lowpass_width, lowpass_width, lowpass_height * 2);
+    if (s->bpc == 12) {
+        output = p->subband[0];
+        for (i = 0; i < lowpass_height * 2; i++) {
+            for (j = 0; j < lowpass_width * 2; j++)
+                output[j] <<= 2;
+
+            output += lowpass_width * 2;
+        }
+    }
+
+    /* level 2 */
+    lowpass_height  = p->band[1][1].height;
+    lowpass_width   = p->band[1][1].width;
+    highpass_stride = p->band[1][1].stride;
+
+    if (lowpass_height > p->band[1][1].a_height || lowpass_width > p->band[1][1].a_width ||
+        !highpass_stride || p->band[1][1].width > p->band[1][1].a_width) {
+        av_log(avctx, AV_LOG_ERROR, "Invalid plane dimensions\n");
+        return AVERROR(EINVAL);
+    }
+
+    av_log(avctx, AV_LOG_DEBUG, "Level 2 plane %i %i %i %i\n", plane, lowpass_height, lowpass_width, highpass_stride);
+
+    s->dsp.vert_filter(p->l_h[3], lowpass_width, p->subband[0], lowpass_width,
+                       p->subband[5], highpass_stride, lowpass_width, lowpass_height);
+    s->dsp.vert_filter(p->l_h[4], lowpass_width, p->subband[4], highpass_stride,
+                       p->subband[6], highpass_stride, lowpass_width, lowpass_height);
+
+    s->dsp.horiz_filter(p->subband[0], lowpass_width * 2, p->l_h[3], lowpass_width,
+                        p->l_h[4], lowpass_width, lowpass_width, lowpass_height * 2);
+
+    output = p->subband[0];
+    for (i = 0; i < lowpass_height * 2; i++) {
+        for (j = 0; j < lowpass_width * 2; j++)
+            output[j] <<= 2;
+
+        output += lowpass_width * 2;
+    }
+
+    /* level 3 */
+    lowpass_height  = p->band[2][1].height;
+    lowpass_width   = p->band[2][1].width;
+    highpass_stride = p->band[2][1].stride;
+
+    if (lowpass_height > p->band[2][1].a_height || lowpass_width > p->band[2][1].a_width ||
+        !highpass_stride || p->band[2][1].width > p->band[2][1].a_width) {
+        av_log(avctx, AV_LOG_ERROR, "Invalid plane dimensions\n");
+        return AVERROR(EINVAL);
+    }
+
+    av_log(avctx, AV_LOG_DEBUG, "Level 3 plane %i %i %i %i\n", plane, lowpass_height, lowpass_width, highpass_stride);
+
+    s->dsp.vert_filter(p->l_h[6], lowpass_width, p->subband[0], lowpass_width,
+                       p->subband[8], highpass_stride, lowpass_width, lowpass_height);
+    s->dsp.vert_filter(p->l_h[7], lowpass_width, p->subband[7], highpass_stride,
+                       p->subband[9], highpass_stride, lowpass_width, lowpass_height);
+
+    s->dsp.horiz_filter_clip((int16_t *)pic->data[act_plane], pic->linesize[act_plane] / 2,
+                             p->l_h[6], lowpass_width, p->l_h[7], lowpass_width,
+                             lowpass_width, lowpass_height * 2, s->bpc);
+
+    return 0;
+}
+
 static int cfhd_decode(AVCodecContext *avctx, void *data, int *got_frame,
                        AVPacket *avpkt)
 {
@@ -228,6 +269,7 @@ static int cfhd_decode(AVCodecContext *avctx, void *data, int *got_frame,
     ThreadFrame frame = { .f = data };
     AVFrame *pic = data;
     int ret = 0, i, j, planes, plane, got_buffer = 0;
+    int plane_ret[4];
     int16_t *coeff_data;
 
     s->coded_format = AV_PIX_FMT_YUV422P10;
@@ -584,160 +626,10 @@ static int cfhd_decode(AVCodecContext *avctx, void *data, int *got_frame,
     }
 
     planes = av_pix_fmt_count_planes(avctx->pix_fmt);
-    for (plane = 0; plane < planes && !ret; plane++) {
-        /* level 1 */
-        int lowpass_height  = s->plane[plane].band[0][0].height;
-        int lowpass_width   = s->plane[plane].band[0][0].width;
-        int highpass_stride = s->plane[plane].band[0][1].stride;
-        int act_plane = plane == 1 ? 2 : plane == 2 ? 1 : plane;
-        int16_t *low, *high, *output, *dst;
-
-        if (lowpass_height > s->plane[plane].band[0][0].a_height || lowpass_width > s->plane[plane].band[0][0].a_width ||
-            !highpass_stride || s->plane[plane].band[0][1].width > s->plane[plane].band[0][1].a_width) {
-            av_log(avctx, AV_LOG_ERROR, "Invalid plane dimensions\n");
-            ret = AVERROR(EINVAL);
-            goto end;
-        }
-
-        av_log(avctx, AV_LOG_DEBUG, "Decoding level 1 plane %i %i %i %i\n", plane, lowpass_height, lowpass_width, highpass_stride);
-
-        low    = s->plane[plane].subband[0];
-        high   = s->plane[plane].subband[2];
-        output = s->plane[plane].l_h[0];
-        for (i = 0; i < lowpass_width; i++) {
-            vert_filter(output, lowpass_width, low, lowpass_width, high, highpass_stride, lowpass_height);
-            low++;
-            high++;
-            output++;
-        }
-
-        low    = s->plane[plane].subband[1];
-        high   = s->plane[plane].subband[3];
-        output = s->plane[plane].l_h[1];
-
-        for (i = 0; i < lowpass_width; i++) {
-            // note the stride of "low" is highpass_stride
-            vert_filter(output, lowpass_width, low, highpass_stride, high, highpass_stride, lowpass_height);
-            low++;
-            high++;
-            output++;
-        }
-
-        low    = s->plane[plane].l_h[0];
-        high   = s->plane[plane].l_h[1];
-        output = s->plane[plane].subband[0];
-        for (i = 0; i < lowpass_height * 2; i++) {
-            horiz_filter(output, low, high, lowpass_width);
-            low    += lowpass_width;
-            high   += lowpass_width;
-            output += lowpass_width * 2;
-        }
-        if (s->bpc == 12) {
-            output = s->plane[plane].subband[0];
-            for (i = 0; i < lowpass_height * 2; i++) {
-                for (j = 0; j < lowpass_width * 2; j++)
-                    output[j] <<= 2;
-
-                output += lowpass_width * 2;
-            }
-        }
-
-        /* level 2 */
-        lowpass_height  = s->plane[plane].band[1][1].height;
-        lowpass_width   = s->plane[plane].band[1][1].width;
-        highpass_stride = s->plane[plane].band[1][1].stride;
-
-        if (lowpass_height > s->plane[plane].band[1][1].a_height || lowpass_width > s->plane[plane].band[1][1].a_width ||
-            !highpass_stride || s->plane[plane].band[1][1].width > s->plane[plane].band[1][1].a_width) {
-            av_log(avctx, AV_LOG_ERROR, "Invalid plane dimensions\n");
-            ret = AVERROR(EINVAL);
-            goto end;
-        }
-
-        av_log(avctx, AV_LOG_DEBUG, "Level 2 plane %i %i %i %i\n", plane, lowpass_height, lowpass_width, highpass_stride);
-
-        low    = s->plane[plane].subband[0];
-        high   = s->plane[plane].subband[5];
-        output = s->plane[plane].l_h[3];
-        for (i = 0; i < lowpass_width; i++) {
-            vert_filter(output, lowpass_width, low, lowpass_width, high, highpass_stride, lowpass_height);
-            low++;
-            high++;
-            output++;
-        }
-
-        low    = s->plane[plane].subband[4];
-        high   = s->plane[plane].subband[6];
-        output = s->plane[plane].l_h[4];
-        for (i = 0; i < lowpass_width; i++) {
-            vert_filter(output, lowpass_width, low, highpass_stride, high, highpass_stride, lowpass_height);
-            low++;
-            high++;
-            output++;
-        }
-
-        low    = s->plane[plane].l_h[3];
-        high   = s->plane[plane].l_h[4];
-        output = s->plane[plane].subband[0];
-        for (i = 0; i < lowpass_height * 2; i++) {
-            horiz_filter(output, low, high, lowpass_width);
-            low    += lowpass_width;
-            high   += lowpass_width;
-            output += lowpass_width * 2;
-        }
-
-        output = s->plane[plane].subband[0];
-        for (i = 0; i < lowpass_height * 2; i++) {
-            for (j = 0; j < lowpass_width * 2; j++)
-                output[j] <<= 2;
-
-            output += lowpass_width * 2;
-        }
-
-        /* level 3 */
-        lowpass_height  = s->plane[plane].band[2][1].height;
-        lowpass_width   = s->plane[plane].band[2][1].width;
-        highpass_stride = s->plane[plane].band[2][1].stride;
-
-        if (lowpass_height > s->plane[plane].band[2][1].a_height || lowpass_width > s->plane[plane].band[2][1].a_width ||
-            !highpass_stride || s->plane[plane].band[2][1].width > s->plane[plane].band[2][1].a_width) {
-            av_log(avctx, AV_LOG_ERROR, "Invalid plane dimensions\n");
-            ret = AVERROR(EINVAL);
-            goto end;
-        }
-
-        av_log(avctx, AV_LOG_DEBUG, "Level 3 plane %i %i %i %i\n", plane, lowpass_height, lowpass_width, highpass_stride);
-
-        low    = s->plane[plane].subband[0];
-        high   = s->plane[plane].subband[8];
-        output = s->plane[plane].l_h[6];
-        for (i = 0; i < lowpass_width; i++) {
-            vert_filter(output, lowpass_width, low, lowpass_width, high, highpass_stride, lowpass_height);
-            low++;
-            high++;
-            output++;
-        }
-
-        low    = s->plane[plane].subband[7];
-        high   = s->plane[plane].subband[9];
-        output = s->plane[plane].l_h[7];
-        for (i = 0; i < lowpass_width; i++) {
-            vert_filter(output, lowpass_width, low, highpass_stride, high, highpass_stride, lowpass_height);
-            low++;
-            high++;
-            output++;
-        }
-
-        dst = (int16_t *)pic->data[act_plane];
-        low  = s->plane[plane].l_h[6];
-        high = s->plane[plane].l_h[7];
-        for (i = 0; i < lowpass_height * 2; i++) {
-            horiz_filter_clip(dst, low, high, lowpass_width, s->bpc);
-            low  += lowpass_width;
-            high += lowpass_width;
-            dst  += pic->linesize[act_plane] / 2;
-        }
-    }
+    avctx->execute2(avctx, reconstruct_plane, pic, plane_ret, planes);
+    for (plane = 0; plane < planes; plane++)
+        if (plane_ret[plane] < 0)
+            ret = plane_ret[plane];
 
 
 end:
@@ -771,6 +663,7 @@ AVCodec ff_cfhd_decoder = {
     .init           = cfhd_decode_init,
     .close          = cfhd_close_decoder,
     .decode         = cfhd_decode,
-    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_INIT_CLEANUP,
 };
@@ -26,6 +26,7 @@
 #include "libavutil/avassert.h"
 
 #include "avcodec.h"
+#include "cfhddsp.h"
 #include "get_bits.h"
 
 #define VLC_BITS 9
@@ -107,6 +108,8 @@ typedef struct CFHDContext {
     uint8_t prescale_shift[3];
     Plane plane[4];
 
+    CFHDDSPContext dsp;
+
 } CFHDContext;
 
 int ff_cfhd_init_vlcs(CFHDContext *s);
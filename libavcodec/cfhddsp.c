@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2015-2016 Kieran Kunhya <kieran@kunhya.com>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/common.h"
+
+#include "cfhddsp.h"
+
+static av_always_inline void filter(int16_t *output, ptrdiff_t out_stride,
+                                    const int16_t *low, ptrdiff_t low_stride,
+                                    const int16_t *high, ptrdiff_t high_stride,
+                                    int len, int clip)
+{
+    int16_t tmp;
+
+    int i;
+    for (i = 0; i < len; i++) {
+        if (i == 0) {
+            tmp = (11*low[0*low_stride] - 4*low[1*low_stride] + low[2*low_stride] + 4) >> 3;
+            output[(2*i+0)*out_stride] = (tmp + high[0*high_stride]) >> 1;
+            if (clip)
+                output[(2*i+0)*out_stride] = av_clip_uintp2_c(output[(2*i+0)*out_stride], clip);
+
+            tmp = ( 5*low[0*low_stride] + 4*low[1*low_stride] - low[2*low_stride] + 4) >> 3;
+            output[(2*i+1)*out_stride] = (tmp - high[0*high_stride]) >> 1;
+            if (clip)
+                output[(2*i+1)*out_stride] = av_clip_uintp2_c(output[(2*i+1)*out_stride], clip);
+        } else if (i == len-1) {
+            tmp = ( 5*low[i*low_stride] + 4*low[(i-1)*low_stride] - low[(i-2)*low_stride] + 4) >> 3;
+            output[(2*i+0)*out_stride] = (tmp + high[i*high_stride]) >> 1;
+            if (clip)
+                output[(2*i+0)*out_stride] = av_clip_uintp2_c(output[(2*i+0)*out_stride], clip);
+
+            tmp = (11*low[i*low_stride] - 4*low[(i-1)*low_stride] + low[(i-2)*low_stride] + 4) >> 3;
+            output[(2*i+1)*out_stride] = (tmp - high[i*high_stride]) >> 1;
+            if (clip)
+                output[(2*i+1)*out_stride] = av_clip_uintp2_c(output[(2*i+1)*out_stride], clip);
+        } else {
+            tmp = (low[(i-1)*low_stride] - low[(i+1)*low_stride] + 4) >> 3;
+            output[(2*i+0)*out_stride] = (tmp + low[i*low_stride] + high[i*high_stride]) >> 1;
+            if (clip)
+                output[(2*i+0)*out_stride] = av_clip_uintp2_c(output[(2*i+0)*out_stride], clip);
+
+            tmp = (low[(i+1)*low_stride] - low[(i-1)*low_stride] + 4) >> 3;
+            output[(2*i+1)*out_stride] = (tmp + low[i*low_stride] - high[i*high_stride]) >> 1;
+            if (clip)
+                output[(2*i+1)*out_stride] = av_clip_uintp2_c(output[(2*i+1)*out_stride], clip);
+        }
+    }
+}
+
+static void cfhd_horiz_filter_c(int16_t *output, ptrdiff_t out_stride,
+                                const int16_t *low, ptrdiff_t low_stride,
+                                const int16_t *high, ptrdiff_t high_stride,
+                                int width, int height)
+{
+    int i;
+
+    for (i = 0; i < height; i++) {
+        filter(output, 1, low, 1, high, 1, width, 0);
+        output += out_stride;
+        low    += low_stride;
+        high   += high_stride;
+    }
+}
+
+static void cfhd_horiz_filter_clip_c(int16_t *output, ptrdiff_t out_stride,
+                                     const int16_t *low, ptrdiff_t low_stride,
+                                     const int16_t *high, ptrdiff_t high_stride,
+                                     int width, int height, int clip)
+{
+    int i;
+
+    for (i = 0; i < height; i++) {
+        filter(output, 1, low, 1, high, 1, width, clip);
+        output += out_stride;
+        low    += low_stride;
+        high   += high_stride;
+    }
+}
+
+static void cfhd_vert_filter_c(int16_t *output, ptrdiff_t out_stride,
+                               const int16_t *low, ptrdiff_t low_stride,
+                               const int16_t *high, ptrdiff_t high_stride,
+                               int width, int height)
+{
+    int i;
+
+    for (i = 0; i < width; i++)
+        filter(output + i, out_stride, low + i, low_stride,
+               high + i, high_stride, height, 0);
+}
+
+av_cold void ff_cfhddsp_init(CFHDDSPContext *c)
+{
+    c->horiz_filter      = cfhd_horiz_filter_c;
+    c->horiz_filter_clip = cfhd_horiz_filter_clip_c;
+    c->vert_filter       = cfhd_vert_filter_c;
+}
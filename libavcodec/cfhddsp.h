@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2015-2016 Kieran Kunhya <kieran@kunhya.com>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_CFHDDSP_H
+#define AVCODEC_CFHDDSP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct CFHDDSPContext {
+    /**
+     * Inverse wavelet transform of the rows of a band: each row of width
+     * low and high samples gives a row of 2 * width output samples.
+     * All the strides are in samples.
+     */
+    void (*horiz_filter)(int16_t *output, ptrdiff_t out_stride,
+                         const int16_t *low, ptrdiff_t low_stride,
+                         const int16_t *high, ptrdiff_t high_stride,
+                         int width, int height);
+
+    /**
+     * Same as horiz_filter, with the output clipped to clip bits.
+     */
+    void (*horiz_filter_clip)(int16_t *output, ptrdiff_t out_stride,
+                              const int16_t *low, ptrdiff_t low_stride,
+                              const int16_t *high, ptrdiff_t high_stride,
+                              int width, int height, int clip);
+
+    /**
+     * Inverse wavelet transform of the columns of a band: height rows of
+     * low and high samples give 2 * height output rows.
+     */
+    void (*vert_filter)(int16_t *output, ptrdiff_t out_stride,
+                        const int16_t *low, ptrdiff_t low_stride,
+                        const int16_t *high, ptrdiff_t high_stride,
+                        int width, int height);
+} CFHDDSPContext;
+
+void ff_cfhddsp_init(CFHDDSPContext *c);
+
+#endif /* AVCODEC_CFHDDSP_H */
@@ -1715,6 +1715,35 @@ static int interpolate_refplane(DiracContext *s, DiracFrame *ref, int plane, int
     return 0;
 }
 
+/**
+ * Inverse transform of a whole intra plane, straight into the frame.
+ * Planes are independent, so they are run as parallel jobs.
+ */
+static int idwt_plane(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    DiracContext *s = avctx->priv_data;
+    Plane *p        = &s->plane[jobnr];
+    uint8_t *frame  = s->current_picture->avframe->data[jobnr];
+    const int idx   = (s->bit_depth - 8) >> 1;
+    DWTContext d;
+    int y, ret;
+
+    ret = ff_spatial_idwt_init(&d, &p->idwt, s->wavelet_idx+2,
+                               s->wavelet_depth, s->bit_depth);
+    if (ret < 0)
+        return ret;
+
+    for (y = 0; y < p->height; y += 16) {
+        ff_spatial_idwt_slice2(&d, y+16); /* decode */
+        s->diracdsp.put_signed_rect_clamped[idx](frame + y*p->stride,
+                                                 p->stride,
+                                                 p->idwt.buf + y*p->idwt.stride,
+                                                 p->idwt.stride, p->width, 16);
+    }
+
+    return 0;
+}
+
 /**
  * Dirac Specification ->
  * 13.0 Transform data syntax. transform_data()
@@ -1737,74 +1766,76 @@ static int dirac_decode_frame_internal(DiracContext *s)
         }
     }
 
+    if (!s->zero_res && !s->low_delay) {
+        for (comp = 0; comp < 3; comp++) {
+            Plane *p = &s->plane[comp];
+            memset(p->idwt.buf, 0, p->idwt.stride * p->idwt.height);
+            decode_component(s, comp); /* [DIRAC_STD] 13.4.1 core_transform_data() */
+        }
+    }
+
+    if (!s->num_refs) { /* intra */
+        int rets[3];
+
+        s->avctx->execute2(s->avctx, idwt_plane, NULL, rets, 3);
+        for (comp = 0; comp < 3; comp++)
+            if (rets[comp] < 0)
+                return rets[comp];
+        return 0;
+    }
+
+    /* inter */
     for (comp = 0; comp < 3; comp++) {
         Plane *p       = &s->plane[comp];
         uint8_t *frame = s->current_picture->avframe->data[comp];
+        int rowheight  = p->ybsep*p->stride;
 
         /* FIXME: small resolutions */
         for (i = 0; i < 4; i++)
             s->edge_emu_buffer[i] = s->edge_emu_buffer_base + i*FFALIGN(p->width, 16);
 
-        if (!s->zero_res && !s->low_delay)
-        {
-            memset(p->idwt.buf, 0, p->idwt.stride * p->idwt.height);
-            decode_component(s, comp); /* [DIRAC_STD] 13.4.1 core_transform_data() */
-        }
         ret = ff_spatial_idwt_init(&d, &p->idwt, s->wavelet_idx+2,
                                    s->wavelet_depth, s->bit_depth);
         if (ret < 0)
             return ret;
 
-        if (!s->num_refs) { /* intra */
-            for (y = 0; y < p->height; y += 16) {
-                int idx = (s->bit_depth - 8) >> 1;
-                ff_spatial_idwt_slice2(&d, y+16); /* decode */
-                s->diracdsp.put_signed_rect_clamped[idx](frame + y*p->stride,
-                                                         p->stride,
-                                                         p->idwt.buf + y*p->idwt.stride,
-                                                         p->idwt.stride, p->width, 16);
-            }
-        } else { /* inter */
-            int rowheight = p->ybsep*p->stride;
+        select_dsp_funcs(s, p->width, p->height, p->xblen, p->yblen);
 
-            select_dsp_funcs(s, p->width, p->height, p->xblen, p->yblen);
-
-            for (i = 0; i < s->num_refs; i++) {
-                int ret = interpolate_refplane(s, s->ref_pics[i], comp, p->width, p->height);
-                if (ret < 0)
-                    return ret;
-            }
+        for (i = 0; i < s->num_refs; i++) {
+            int ret = interpolate_refplane(s, s->ref_pics[i], comp, p->width, p->height);
+            if (ret < 0)
+                return ret;
+        }
 
-            memset(s->mctmp, 0, 4*p->yoffset*p->stride);
+        memset(s->mctmp, 0, 4*p->yoffset*p->stride);
 
-            dsty = -p->yoffset;
-            for (y = 0; y < s->blheight; y++) {
-                int h     = 0,
-                    start = FFMAX(dsty, 0);
-                uint16_t *mctmp    = s->mctmp + y*rowheight;
-                DiracBlock *blocks = s->blmotion + y*s->blwidth;
+        dsty = -p->yoffset;
+        for (y = 0; y < s->blheight; y++) {
+            int h     = 0,
+                start = FFMAX(dsty, 0);
+            uint16_t *mctmp    = s->mctmp + y*rowheight;
+            DiracBlock *blocks = s->blmotion + y*s->blwidth;
 
-                init_obmc_weights(s, p, y);
+            init_obmc_weights(s, p, y);
 
-                if (y == s->blheight-1 || start+p->ybsep > p->height)
-                    h = p->height - start;
-                else
-                    h = p->ybsep - (start - dsty);
-                if (h < 0)
-                    break;
+            if (y == s->blheight-1 || start+p->ybsep > p->height)
+                h = p->height - start;
+            else
+                h = p->ybsep - (start - dsty);
+            if (h < 0)
+                break;
 
-                memset(mctmp+2*p->yoffset*p->stride, 0, 2*rowheight);
-                mc_row(s, blocks, mctmp, comp, dsty);
+            memset(mctmp+2*p->yoffset*p->stride, 0, 2*rowheight);
+            mc_row(s, blocks, mctmp, comp, dsty);
 
-                mctmp += (start - dsty)*p->stride + p->xoffset;
-                ff_spatial_idwt_slice2(&d, start + h); /* decode */
-                /* NOTE: add_rect_clamped hasn't been templated hence the shifts.
-                 * idwt.stride is passed as pixels, not in bytes as in the rest of the decoder */
-                s->diracdsp.add_rect_clamped(frame + start*p->stride, mctmp, p->stride,
-                                             (int16_t*)(p->idwt.buf) + start*(p->idwt.stride >> 1), (p->idwt.stride >> 1), p->width, h);
+            mctmp += (start - dsty)*p->stride + p->xoffset;
+            ff_spatial_idwt_slice2(&d, start + h); /* decode */
+            /* NOTE: add_rect_clamped hasn't been templated hence the shifts.
+             * idwt.stride is passed as pixels, not in bytes as in the rest of the decoder */
+            s->diracdsp.add_rect_clamped(frame + start*p->stride, mctmp, p->stride,
+                                         (int16_t*)(p->idwt.buf) + start*(p->idwt.stride >> 1), (p->idwt.stride >> 1), p->width, h);
 
-                dsty += p->ybsep;
-            }
+            dsty += p->ybsep;
         }
     }
 
@@ -49,6 +49,13 @@ static const AVOption options[] = {
     { "ibias", "intra quant bias",
         offsetof(DNXHDEncContext, intra_quant_bias), AV_OPT_TYPE_INT,
         { .i64 = 0 }, INT_MIN, INT_MAX, VE },
+    { "rc_mode", "rate control qscale search",
+        offsetof(DNXHDEncContext, rc_mode), AV_OPT_TYPE_INT,
+        { .i64 = DNXHD_RC_EXHAUSTIVE }, DNXHD_RC_EXHAUSTIVE, DNXHD_RC_ESTIMATE, VE, "rc_mode" },
+    { "exhaustive", "try every qscale (rd) or step through qscales (fast)", 0, AV_OPT_TYPE_CONST,
+        { .i64 = DNXHD_RC_EXHAUSTIVE }, 0, 0, VE, "rc_mode" },
+    { "estimate", "try a geometric ladder of qscales (rd) or predict the qscale from the bit count (fast)", 0, AV_OPT_TYPE_CONST,
+        { .i64 = DNXHD_RC_ESTIMATE }, 0, 0, VE, "rc_mode" },
     { NULL }
 };
 
@@ -97,37 +104,72 @@ void dnxhd_10bit_get_pixels_8x4_sym(int16_t *av_restrict block,
     memcpy(block + 4 * 8, pixels + 3 * line_size, 8 * sizeof(*block));
 }
 
-static int dnxhd_10bit_dct_quantize(MpegEncContext *ctx, int16_t *block,
-                                    int n, int qscale, int *overflow)
+static void dnxhd_10bit_quantize_c(int16_t *block, const int *qmat)
 {
-    const uint8_t *scantable= ctx->intra_scantable.scantable;
-    const int *qmat = n<4 ? ctx->q_intra_matrix[qscale] : ctx->q_chroma_intra_matrix[qscale];
-    int last_non_zero = 0;
     int i;
 
-    ctx->fdsp.fdct(block);
+    for (i = 0; i < 64; i++) {
+        int sign = FF_SIGNBIT(block[i]);
+        int level = (block[i] ^ sign) - sign;
+        level = level * qmat[i] >> DNX10BIT_QMAT_SHIFT;
+        block[i] = (level ^ sign) - sign;
+    }
+}
+
+static int dnxhd_10bit_dct_quantize(DNXHDEncContext *ctx, int16_t *block,
+                                    int n, int qscale)
+{
+    const uint8_t *scantable = ctx->m.intra_scantable.scantable;
+    const int *qmat = n < 4 ? ctx->m.q_intra_matrix[qscale]
+                            : ctx->m.q_chroma_intra_matrix[qscale];
+    int last_non_zero, dc;
+
+    ctx->m.fdsp.fdct(block);
 
     // Divide by 4 with rounding, to compensate scaling of DCT coefficients
-    block[0] = (block[0] + 2) >> 2;
-
-    for (i = 1; i < 64; ++i) {
-        int j = scantable[i];
-        int sign = FF_SIGNBIT(block[j]);
-        int level = (block[j] ^ sign) - sign;
-        level = level * qmat[j] >> DNX10BIT_QMAT_SHIFT;
-        block[j] = (level ^ sign) - sign;
-        if (level)
-            last_non_zero = i;
-    }
+    dc = (block[0] + 2) >> 2;
+
+    // qmat[0] is 0, the DC coefficient is restored afterwards
+    ctx->quantize_10bit(block, qmat);
+    block[0] = dc;
+
+    for (last_non_zero = 63; last_non_zero > 0; last_non_zero--)
+        if (block[scantable[last_non_zero]])
+            break;
 
     /* we need this permutation so that we correct the IDCT, we only permute the !=0 elements */
-    if (ctx->idsp.perm_type != FF_IDCT_PERM_NONE)
-        ff_block_permute(block, ctx->idsp.idct_permutation,
+    if (ctx->m.idsp.perm_type != FF_IDCT_PERM_NONE)
+        ff_block_permute(block, ctx->m.idsp.idct_permutation,
                          scantable, last_non_zero);
 
     return last_non_zero;
 }
 
+static av_always_inline
+int dnxhd_dct_quantize(DNXHDEncContext *ctx, int16_t *block, int n, int qscale)
+{
+    int overflow;
+
+    if (ctx->cid_table->bit_depth == 10)
+        return dnxhd_10bit_dct_quantize(ctx, block, n, qscale);
+    return ctx->m.dct_quantize(&ctx->m, block, n, qscale, &overflow);
+}
+
+av_cold void ff_dnxhdenc_init(DNXHDEncContext *ctx)
+{
+    if (ctx->cid_table->bit_depth == 10) {
+        ctx->get_pixels_8x4_sym = dnxhd_10bit_get_pixels_8x4_sym;
+        ctx->quantize_10bit     = dnxhd_10bit_quantize_c;
+        ctx->block_width_l2     = 4;
+    } else {
+        ctx->get_pixels_8x4_sym = dnxhd_8bit_get_pixels_8x4_sym;
+        ctx->block_width_l2     = 3;
+    }
+
+    if (ARCH_X86)
+        ff_dnxhdenc_init_x86(ctx);
+}
+
 static av_cold int dnxhd_init_vlc(DNXHDEncContext *ctx)
 {
     int i, j, level, run;
@@ -333,17 +375,7 @@ static av_cold int dnxhd_encode_init(AVCodecContext *avctx)
     if (!ctx->m.dct_quantize)
         ctx->m.dct_quantize = ff_dct_quantize_c;
 
-    if (ctx->cid_table->bit_depth == 10) {
-        ctx->m.dct_quantize     = dnxhd_10bit_dct_quantize;
-        ctx->get_pixels_8x4_sym = dnxhd_10bit_get_pixels_8x4_sym;
-        ctx->block_width_l2     = 4;
-    } else {
-        ctx->get_pixels_8x4_sym = dnxhd_8bit_get_pixels_8x4_sym;
-        ctx->block_width_l2     = 3;
-    }
-
-    if (ARCH_X86)
-        ff_dnxhdenc_init_x86(ctx);
+    ff_dnxhdenc_init(ctx);
 
     ctx->m.mb_height = (avctx->height + 15) / 16;
     ctx->m.mb_width  = (avctx->width  + 15) / 16;
@@ -382,7 +414,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     FF_ALLOCZ_OR_GOTO(ctx->m.avctx, ctx->mb_bits,
                       ctx->m.mb_num * sizeof(uint16_t), fail);
     FF_ALLOCZ_OR_GOTO(ctx->m.avctx, ctx->mb_qscale,
-                      ctx->m.mb_num * sizeof(uint8_t), fail);
+                      ctx->m.mb_num * sizeof(uint16_t), fail);
 
 #if FF_API_CODED_FRAME
 FF_DISABLE_DEPRECATION_WARNINGS
@@ -636,12 +668,11 @@ static int dnxhd_calc_bits_thread(AVCodecContext *avctx, void *arg,
 
         for (i = 0; i < 8; i++) {
             int16_t *src_block = ctx->blocks[i];
-            int overflow, nbits, diff, last_index;
+            int nbits, diff, last_index;
             int n = dnxhd_switch_matrix(ctx, i);
 
             memcpy(block, src_block, 64 * sizeof(*block));
-            last_index = ctx->m.dct_quantize(&ctx->m, block, 4 & (2*i),
-                                             qscale, &overflow);
+            last_index = dnxhd_dct_quantize(ctx, block, 4 & (2*i), qscale);
             ac_bits   += dnxhd_calc_ac_bits(ctx, block, last_index);
 
             diff = block[0] - ctx->m.last_dc[n];
@@ -691,9 +722,8 @@ static int dnxhd_encode_thread(AVCodecContext *avctx, void *arg,
 
         for (i = 0; i < 8; i++) {
             int16_t *block = ctx->blocks[i];
-            int overflow, n = dnxhd_switch_matrix(ctx, i);
-            int last_index = ctx->m.dct_quantize(&ctx->m, block, 4 & (2*i),
-                                                 qscale, &overflow);
+            int n = dnxhd_switch_matrix(ctx, i);
+            int last_index = dnxhd_dct_quantize(ctx, block, 4 & (2*i), qscale);
             // START_TIMER;
             dnxhd_encode_block(ctx, block, last_index, n);
             // STOP_TIMER("encode_block");
@@ -792,13 +822,25 @@ static int dnxhd_mb_var_thread(AVCodecContext *avctx, void *arg,
     return 0;
 }
 
+/**
+ * Next qscale tried by the RD search. In estimate mode only a ladder of
+ * qscales growing by about 25% is evaluated, which takes a few dozen
+ * trials per macroblock instead of one per qscale up to qmax.
+ */
+static av_always_inline int dnxhd_next_rdo_qscale(DNXHDEncContext *ctx, int q)
+{
+    if (ctx->rc_mode == DNXHD_RC_ESTIMATE)
+        return q + FFMAX(1, q >> 2);
+    return q + 1;
+}
+
 static int dnxhd_encode_rdo(AVCodecContext *avctx, DNXHDEncContext *ctx)
 {
     int lambda, up_step, down_step;
     int last_lower = INT_MAX, last_higher = 0;
     int x, y, q;
 
-    for (q = 1; q < avctx->qmax; q++) {
+    for (q = 1; q < avctx->qmax; q = dnxhd_next_rdo_qscale(ctx, q)) {
         ctx->qscale = q;
         avctx->execute2(avctx, dnxhd_calc_bits_thread,
                         NULL, NULL, ctx->m.mb_height);
@@ -815,12 +857,13 @@ static int dnxhd_encode_rdo(AVCodecContext *avctx, DNXHDEncContext *ctx)
         }
         for (y = 0; y < ctx->m.mb_height; y++) {
             for (x = 0; x < ctx->m.mb_width; x++) {
-                unsigned min = UINT_MAX;
+                uint64_t min = UINT64_MAX;
                 int qscale = 1;
                 int mb     = y * ctx->m.mb_width + x;
-                for (q = 1; q < avctx->qmax; q++) {
-                    unsigned score = ctx->mb_rc[q][mb].bits * lambda +
-                                     ((unsigned) ctx->mb_rc[q][mb].ssd << LAMBDA_FRAC_BITS);
+                for (q = 1; q < avctx->qmax; q = dnxhd_next_rdo_qscale(ctx, q)) {
+                    // the 10-bit SSDs overflow 32 bits once scaled
+                    uint64_t score = (uint64_t)ctx->mb_rc[q][mb].bits * lambda +
+                                     ((uint64_t)(unsigned)ctx->mb_rc[q][mb].ssd << LAMBDA_FRAC_BITS);
                     if (score < min) {
                         min    = score;
                         qscale = q;
@@ -870,6 +913,21 @@ static int dnxhd_encode_rdo(AVCodecContext *avctx, DNXHDEncContext *ctx)
     return 0;
 }
 
+/**
+ * Predict the qscale meeting the frame budget from the bits spent at
+ * qscale, assuming the AC bits are inversely proportional to the qscale
+ * and the rest does not depend on it.
+ */
+static int dnxhd_estimate_qscale(DNXHDEncContext *ctx, int qscale, int bits)
+{
+    // qscale, DC and EOB codes of the whole frame, roughly
+    int64_t fixed = (int64_t)ctx->m.mb_num * (12 + 8 * (ctx->vlc_bits[0] + 3));
+    int64_t ac    = FFMAX(bits - fixed, 1);
+    int64_t room  = FFMAX((int64_t)ctx->frame_bits - fixed, 1);
+
+    return av_clip64((ac * qscale + room - 1) / room, 1, ctx->m.avctx->qmax - 1);
+}
+
 static int dnxhd_find_qscale(DNXHDEncContext *ctx)
 {
     int bits = 0;
@@ -891,7 +949,8 @@ static int dnxhd_find_qscale(DNXHDEncContext *ctx)
             for (x = 0; x < ctx->m.mb_width; x++)
                 bits += ctx->mb_rc[qscale][y*ctx->m.mb_width+x].bits;
             bits = (bits+31)&~31; // padding
-            if (bits > ctx->frame_bits)
+            // the estimate needs the size of the whole frame
+            if (bits > ctx->frame_bits && ctx->rc_mode != DNXHD_RC_ESTIMATE)
                 break;
         }
         // ff_dlog(ctx->m.avctx,
@@ -908,6 +967,8 @@ static int dnxhd_find_qscale(DNXHDEncContext *ctx)
             last_lower = FFMIN(qscale, last_lower);
             if (last_higher != 0)
                 qscale = (qscale + last_higher) >> 1;
+            else if (ctx->rc_mode == DNXHD_RC_ESTIMATE)
+                qscale = FFMIN(qscale - 1, dnxhd_estimate_qscale(ctx, qscale, bits));
             else
                 qscale -= down_step++;
             if (qscale < 1)
@@ -917,10 +978,17 @@ static int dnxhd_find_qscale(DNXHDEncContext *ctx)
             if (last_lower == qscale + 1)
                 break;
             last_higher = FFMAX(qscale, last_higher);
-            if (last_lower != INT_MAX)
+            if (last_lower != INT_MAX) {
                 qscale = (qscale + last_lower) >> 1;
-            else
+            } else if (ctx->rc_mode == DNXHD_RC_ESTIMATE) {
+                qscale = FFMAX(qscale + 1, dnxhd_estimate_qscale(ctx, qscale, bits));
+                // qscale + 1 must remain available for dnxhd_encode_fast()
+                qscale = FFMIN(qscale, ctx->m.avctx->qmax - 1);
+                if (qscale <= last_higher)
+                    return AVERROR(EINVAL);
+            } else {
                 qscale += up_step++;
+            }
             down_step = 1;
             if (qscale >= ctx->m.avctx->qmax)
                 return AVERROR(EINVAL);
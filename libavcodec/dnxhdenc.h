@@ -39,6 +39,11 @@ typedef struct RCEntry {
     int bits;
 } RCEntry;
 
+enum DNXHDRCMode {
+    DNXHD_RC_EXHAUSTIVE,
+    DNXHD_RC_ESTIMATE,
+};
+
 typedef struct DNXHDEncContext {
     AVClass *class;
     BlockDSPContext bdsp;
@@ -64,6 +69,7 @@ typedef struct DNXHDEncContext {
     int nitris_compat;
     unsigned min_padding;
     int intra_quant_bias;
+    int rc_mode;
 
     DECLARE_ALIGNED(16, int16_t, blocks)[8][64];
 
@@ -86,15 +92,25 @@ typedef struct DNXHDEncContext {
     unsigned lambda;
 
     uint16_t *mb_bits;
-    uint8_t  *mb_qscale;
+    uint16_t *mb_qscale;
 
     RCCMPEntry *mb_cmp;
     RCEntry   (*mb_rc)[8160];
 
     void (*get_pixels_8x4_sym)(int16_t * /* align 16 */,
                                const uint8_t *, ptrdiff_t);
+    /**
+     * Quantize the 64 coefficients of a 10-bit block in raster order:
+     * block[i] = sign(block[i]) * (|block[i]| * qmat[i] >> 18)
+     */
+    void (*quantize_10bit)(int16_t *block /* align 16 */,
+                           const int *qmat /* align 16 */);
 } DNXHDEncContext;
 
+/**
+ * Set the DSP functions matching ctx->cid_table.
+ */
+void ff_dnxhdenc_init(DNXHDEncContext *ctx);
 void ff_dnxhdenc_init_x86(DNXHDEncContext *ctx);
 
 #endif /* AVCODEC_DNXHDENC_H */
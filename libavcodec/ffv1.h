@@ -115,6 +115,7 @@ typedef struct FFV1Context {
     int slice_damaged;
     int key_frame_ok;
     int context_model;
+    int gop_parallel;
 
     int bits_per_raw_sample;
     int packed_at_lsb;
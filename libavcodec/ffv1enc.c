@@ -1389,6 +1389,8 @@ static const AVOption options[] = {
             { .i64 = 1 }, INT_MIN, INT_MAX, VE, "coder" },
     { "context", "Context model", OFFSET(context_model), AV_OPT_TYPE_INT,
             { .i64 = 0 }, 0, 1, VE },
+    { "gop_parallel", "Encode whole GOPs in parallel with frame threads", OFFSET(gop_parallel), AV_OPT_TYPE_BOOL,
+            { .i64 = 0 }, 0, 1, VE },
 
     { NULL }
 };
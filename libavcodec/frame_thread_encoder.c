@@ -23,9 +23,12 @@
 #include "libavutil/fifo.h"
 #include "libavutil/avassert.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
 #include "libavutil/thread.h"
 #include "avcodec.h"
 #include "internal.h"
+#include "pthread_internal.h"
 #include "thread.h"
 
 #define MAX_THREADS 64
@@ -38,6 +41,19 @@ typedef struct{
     unsigned index;
 } Task;
 
+/**
+ * In GOP mode, each worker encodes whole GOPs, keeping its own reference
+ * frames and rate control, and the packets are returned in GOP order.
+ */
+typedef struct{
+    AVFrame **frames;
+    int nb_frames;
+    int64_t first_frame;    ///< index of the first frame in the whole stream
+    AVFifoBuffer *pkts;     ///< AVPacket, in the order the worker output them
+    int ret;
+    int finished;
+} GopTask;
+
 typedef struct{
     AVCodecContext *parent_avctx;
     pthread_mutex_t buffer_mutex;
@@ -55,12 +71,88 @@ typedef struct{
 
     pthread_t worker[MAX_THREADS];
     int exit;
+
+    int gop_size;           ///< frames per GOP task, 0 if not in GOP mode
+    GopTask gops[BUFFER_SIZE];
+    unsigned gop_fill;      ///< GOP receiving the input frames
+    unsigned gop_out;       ///< oldest GOP whose packets were not all returned
+    int64_t nb_frames_in;
+    int64_t timecode_frame_start;
+    int64_t last_ref_pts;
+    int has_last_ref_pts;
 } ThreadContext;
 
+static void free_gop_frames(ThreadContext *c, GopTask *gop)
+{
+    int i;
+
+    pthread_mutex_lock(&c->buffer_mutex);
+    for (i = 0; i < gop->nb_frames; i++)
+        av_frame_free(&gop->frames[i]);
+    pthread_mutex_unlock(&c->buffer_mutex);
+    gop->nb_frames = 0;
+}
+
+static int encode_gop_frame(AVCodecContext *avctx, GopTask *gop, AVFrame *frame)
+{
+    AVPacket pkt;
+    int got_packet, ret;
+
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+    ret = avcodec_encode_video2(avctx, &pkt, frame, &got_packet);
+    if (ret < 0 || !got_packet)
+        return ret < 0 ? ret : 0;
+
+    if (av_fifo_space(gop->pkts) < sizeof(pkt) &&
+        (ret = av_fifo_grow(gop->pkts, av_fifo_size(gop->pkts) + sizeof(pkt))) < 0) {
+        av_packet_unref(&pkt);
+        return ret;
+    }
+    av_fifo_generic_write(gop->pkts, &pkt, sizeof(pkt), NULL);
+    return 1;
+}
+
+static void encode_gop(AVCodecContext *avctx, GopTask *gop, int64_t *nb_frames_done)
+{
+    ThreadContext *c = avctx->internal->frame_thread_encoder;
+    int i, ret = 0;
+
+    /* keep the GOP timecodes continuous, even though the worker counts only
+     * the pictures it coded itself */
+    if (avctx->codec_id == AV_CODEC_ID_MPEG1VIDEO ||
+        avctx->codec_id == AV_CODEC_ID_MPEG2VIDEO)
+        av_opt_set_int(avctx->priv_data, "timecode_frame_start",
+                       c->timecode_frame_start + gop->first_frame - *nb_frames_done, 0);
+
+    for (i = 0; i < gop->nb_frames && ret >= 0; i++)
+        ret = encode_gop_frame(avctx, gop, gop->frames[i]);
+    *nb_frames_done += gop->nb_frames;
+    /* flush the delayed frames, the next GOP of this worker is not the next
+     * one in the stream */
+    if (ret >= 0) {
+        do {
+            ret = encode_gop_frame(avctx, gop, NULL);
+        } while (ret > 0);
+    }
+    free_gop_frames(c, gop);
+
+    pthread_mutex_lock(&c->finished_task_mutex);
+    gop->ret      = ret;
+    gop->finished = 1;
+    pthread_cond_broadcast(&c->finished_task_cond);
+    pthread_mutex_unlock(&c->finished_task_mutex);
+}
+
 static void * attribute_align_arg worker(void *v){
     AVCodecContext *avctx = v;
     ThreadContext *c = avctx->internal->frame_thread_encoder;
     AVPacket *pkt = NULL;
+    int64_t nb_frames_done = 0;
+
+    ff_thread_set_affinity(avctx);
+    av_mem_set_context(c->parent_avctx);
 
     while(!c->exit){
         int got_packet, ret;
@@ -81,6 +173,10 @@ static void * attribute_align_arg worker(void *v){
         }
         av_fifo_generic_read(c->task_fifo, &task, sizeof(task), NULL);
         pthread_mutex_unlock(&c->task_fifo_mutex);
+        if (c->gop_size) {
+            encode_gop(avctx, task.indata, &nb_frames_done);
+            continue;
+        }
         frame = task.indata;
 
         ret = avcodec_encode_video2(avctx, pkt, frame, &got_packet);
@@ -109,13 +205,48 @@ end:
     return NULL;
 }
 
+static int use_gop_mode(AVCodecContext *avctx)
+{
+    int64_t gop_parallel = 0;
+
+    if (avctx->codec_id != AV_CODEC_ID_MPEG1VIDEO &&
+        avctx->codec_id != AV_CODEC_ID_MPEG2VIDEO &&
+        avctx->codec_id != AV_CODEC_ID_MPEG4      &&
+        avctx->codec_id != AV_CODEC_ID_H263       &&
+        avctx->codec_id != AV_CODEC_ID_H263P      &&
+        avctx->codec_id != AV_CODEC_ID_FFV1)
+        return 0;
+    if (!avctx->codec->priv_class ||
+        av_opt_get_int(avctx->priv_data, "gop_parallel", 0, &gop_parallel) < 0 ||
+        !gop_parallel)
+        return 0;
+
+    if (avctx->gop_size <= 0) {
+        av_log(avctx, AV_LOG_WARNING, "GOP parallel encoding needs a fixed GOP size\n");
+        return 0;
+    }
+    if (avctx->flags & (AV_CODEC_FLAG_PASS1 | AV_CODEC_FLAG_PASS2)) {
+        av_log(avctx, AV_LOG_WARNING,
+               "GOP parallel encoding does not support 2-pass encoding\n");
+        return 0;
+    }
+    if (avctx->rc_buffer_size)
+        av_log(avctx, AV_LOG_WARNING,
+               "The VBV buffer is modeled separately for the GOPs of each thread "
+               "with GOP parallel encoding, the stream may not be compliant.\n");
+    return 1;
+}
+
 int ff_frame_thread_encoder_init(AVCodecContext *avctx, AVDictionary *options){
     int i=0;
     ThreadContext *c;
+    int gop_mode;
 
 
-    if(   !(avctx->thread_type & FF_THREAD_FRAME)
-       || !(avctx->codec->capabilities & AV_CODEC_CAP_INTRA_ONLY))
+    if(!(avctx->thread_type & FF_THREAD_FRAME))
+        return 0;
+    gop_mode = avctx->thread_count != 1 && use_gop_mode(avctx);
+    if(!gop_mode && !(avctx->codec->capabilities & AV_CODEC_CAP_INTRA_ONLY))
         return 0;
 
     if(   !avctx->thread_count
@@ -158,7 +289,7 @@ int ff_frame_thread_encoder_init(AVCodecContext *avctx, AVDictionary *options){
     }
 
     if(!avctx->thread_count) {
-        avctx->thread_count = av_cpu_count();
+        avctx->thread_count = ff_thread_cpu_count(avctx);
         avctx->thread_count = FFMIN(avctx->thread_count, MAX_THREADS);
     }
 
@@ -179,6 +310,19 @@ int ff_frame_thread_encoder_init(AVCodecContext *avctx, AVDictionary *options){
     if(!c->task_fifo)
         goto fail;
 
+    if (gop_mode) {
+        c->gop_size = avctx->gop_size;
+        for (i = 0; i < BUFFER_SIZE; i++) {
+            c->gops[i].frames = av_malloc_array(c->gop_size, sizeof(*c->gops[i].frames));
+            c->gops[i].pkts   = av_fifo_alloc_array(c->gop_size, sizeof(AVPacket));
+            if (!c->gops[i].frames || !c->gops[i].pkts) {
+                i = 0;
+                goto fail;
+            }
+        }
+        i = 0;
+    }
+
     pthread_mutex_init(&c->task_fifo_mutex, NULL);
     pthread_mutex_init(&c->finished_task_mutex, NULL);
     pthread_mutex_init(&c->buffer_mutex, NULL);
@@ -242,9 +386,109 @@ void ff_frame_thread_encoder_free(AVCodecContext *avctx){
     pthread_cond_destroy(&c->task_fifo_cond);
     pthread_cond_destroy(&c->finished_task_cond);
     av_fifo_freep(&c->task_fifo);
+    for (i = 0; i < BUFFER_SIZE; i++) {
+        GopTask *gop = &c->gops[i];
+        AVPacket pkt;
+
+        while (gop->pkts && av_fifo_size(gop->pkts) >= sizeof(pkt)) {
+            av_fifo_generic_read(gop->pkts, &pkt, sizeof(pkt), NULL);
+            av_packet_unref(&pkt);
+        }
+        av_fifo_freep(&gop->pkts);
+        for (; gop->nb_frames > 0; gop->nb_frames--)
+            av_frame_free(&gop->frames[gop->nb_frames - 1]);
+        av_freep(&gop->frames);
+    }
     av_freep(&avctx->internal->frame_thread_encoder);
 }
 
+static int gop_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
+                                  const AVFrame *frame, int *got_packet_ptr)
+{
+    ThreadContext *c = avctx->internal->frame_thread_encoder;
+    GopTask *gop = &c->gops[c->gop_fill % BUFFER_SIZE];
+    int ret = 0;
+
+    if (frame) {
+        AVFrame *new = av_frame_alloc();
+        if (!new)
+            return AVERROR(ENOMEM);
+        ret = av_frame_ref(new, frame);
+        if (ret < 0) {
+            av_frame_free(&new);
+            return ret;
+        }
+        if (!gop->nb_frames) {
+            gop->first_frame = c->nb_frames_in;
+            new->pict_type   = AV_PICTURE_TYPE_I;
+        }
+        gop->frames[gop->nb_frames++] = new;
+        c->nb_frames_in++;
+    }
+
+    if (gop->nb_frames == c->gop_size || (!frame && gop->nb_frames)) {
+        Task task = { .indata = gop, .index = c->gop_fill % BUFFER_SIZE };
+
+        /* set up by the init of the parent context, after ours */
+        if (!c->gop_fill && (avctx->codec_id == AV_CODEC_ID_MPEG1VIDEO ||
+                             avctx->codec_id == AV_CODEC_ID_MPEG2VIDEO)) {
+            av_opt_get_int(avctx->priv_data, "timecode_frame_start", 0,
+                           &c->timecode_frame_start);
+            c->timecode_frame_start = FFMAX(c->timecode_frame_start, 0);
+        }
+
+        pthread_mutex_lock(&c->task_fifo_mutex);
+        av_fifo_generic_write(c->task_fifo, &task, sizeof(task), NULL);
+        pthread_cond_signal(&c->task_fifo_cond);
+        pthread_mutex_unlock(&c->task_fifo_mutex);
+        c->gop_fill++;
+    }
+
+    while (c->gop_out != c->gop_fill) {
+        GopTask *out = &c->gops[c->gop_out % BUFFER_SIZE];
+        /* block only once every worker has a GOP, or when flushing */
+        int wait = !frame || c->gop_fill - c->gop_out > avctx->thread_count;
+        int finished;
+
+        pthread_mutex_lock(&c->finished_task_mutex);
+        while (wait && !out->finished)
+            pthread_cond_wait(&c->finished_task_cond, &c->finished_task_mutex);
+        finished = out->finished;
+        pthread_mutex_unlock(&c->finished_task_mutex);
+        if (!finished)
+            return 0;
+
+        if (av_fifo_size(out->pkts) >= sizeof(*pkt)) {
+            av_fifo_generic_read(out->pkts, pkt, sizeof(*pkt), NULL);
+            *got_packet_ptr = 1;
+
+            /* each worker restarts its reordering delay with its GOPs, so
+             * the dts of the reference frames, which is the pts of the
+             * previous reference frame, is taken from the whole stream */
+            if (pkt->dts != pkt->pts && pkt->dts != AV_NOPTS_VALUE) {
+                if (c->has_last_ref_pts)
+                    pkt->dts = c->last_ref_pts;
+                c->last_ref_pts     = pkt->pts;
+                c->has_last_ref_pts = 1;
+            }
+        }
+        if (av_fifo_size(out->pkts) < sizeof(*pkt)) {
+            ret           = out->ret;
+            out->ret      = 0;
+            out->finished = 0;
+            c->gop_out++;
+            if (ret < 0 && *got_packet_ptr) {
+                av_packet_unref(pkt);
+                *got_packet_ptr = 0;
+            }
+        }
+        if (*got_packet_ptr || ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt, const AVFrame *frame, int *got_packet_ptr){
     ThreadContext *c = avctx->internal->frame_thread_encoder;
     Task task;
@@ -252,6 +496,9 @@ int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt, const AVF
 
     av_assert1(!*got_packet_ptr);
 
+    if (c->gop_size)
+        return gop_video_encode_frame(avctx, pkt, frame, got_packet_ptr);
+
     if(frame){
         AVFrame *new = av_frame_alloc();
         if(!new)
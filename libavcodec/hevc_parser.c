@@ -25,6 +25,7 @@
 #include "golomb.h"
 #include "hevc.h"
 #include "parser.h"
+#include "startcode.h"
 
 #define START_CODE 0x000001 ///< start_code_prefix_one_3bytes
 
@@ -40,6 +41,8 @@ typedef struct HEVCParserContext {
 
     int parsed_extradata;
 
+    StartcodeContext sc;
+
 #if ADVANCED_PARSER
     HEVCContext h;
 #endif
@@ -136,11 +139,23 @@ static int parse_nal_units(AVCodecParserContext *s, const uint8_t *buf,
 static int hevc_find_frame_end(AVCodecParserContext *s, const uint8_t *buf,
                                int buf_size)
 {
+    HEVCParserContext *ctx = s->priv_data;
+    ParseContext       *pc = &ctx->pc;
     int i;
-    ParseContext *pc = s->priv_data;
 
     for (i = 0; i < buf_size; i++) {
         int nut;
+        uint32_t last = pc->state64;
+
+        /* If the last 4 bytes contain no zero byte, no start code can
+         * begin before the next zero byte, so skip to it. Those 4 bytes stay
+         * in state64, which keeps the skipped ones from forming a start
+         * code with the following bytes. */
+        if (!((last - 0x01010101U) & ~last & 0x80808080U)) {
+            i += ctx->sc.find_candidate(buf + i, buf_size - i);
+            if (i >= buf_size)
+                break;
+        }
 
         pc->state64 = (pc->state64 << 8) | buf[i];
 
@@ -481,9 +496,19 @@ static void hevc_parser_close(AVCodecParserContext *s)
     av_freep(&ctx->pc.buffer);
 }
 
+static av_cold int hevc_parser_init(AVCodecParserContext *s)
+{
+    HEVCParserContext *ctx = s->priv_data;
+
+    ff_startcode_init(&ctx->sc);
+
+    return 0;
+}
+
 AVCodecParser ff_hevc_parser = {
     .codec_ids      = { AV_CODEC_ID_HEVC },
     .priv_data_size = sizeof(HEVCParserContext),
+    .parser_init    = hevc_parser_init,
     .parser_parse   = hevc_parse,
     .parser_close   = hevc_parser_close,
     .split          = hevc_split,
@@ -29,6 +29,7 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 
 #include "libavutil/mem.h"
 
@@ -68,6 +69,73 @@ av_cold int ff_huffyuv_alloc_temp(HYuvContext *s)
     return 0;
 }
 
+int ff_huffyuv_alloc_slices(HYuvContext *s, int nb_slices, int stats)
+{
+    HYuvSlice *slices;
+    int i, j;
+
+    if (nb_slices <= s->nb_slice_ctx)
+        return 0;
+
+    slices = av_realloc_array(s->slice_ctx, nb_slices, sizeof(*slices));
+    if (!slices)
+        return AVERROR(ENOMEM);
+    s->slice_ctx = slices;
+
+    for (i = s->nb_slice_ctx; i < nb_slices; i++) {
+        HYuvSlice *sl = &slices[i];
+
+        memset(sl, 0, sizeof(*sl));
+        s->nb_slice_ctx = i + 1;
+
+        if (!i) {
+            for (j = 0; j < 3; j++) {
+                sl->temp[j]   = s->temp[j];
+                sl->temp16[j] = s->temp16[j];
+            }
+            sl->stats = s->stats;
+            continue;
+        }
+
+        for (j = 0; j < 3; j++) {
+            sl->temp[j] = av_malloc(4*s->width + 16);
+            if (!sl->temp[j])
+                return AVERROR(ENOMEM);
+            sl->temp16[j] = (uint16_t*)sl->temp[j];
+        }
+        if (stats) {
+            sl->stats = av_malloc(sizeof(s->stats));
+            if (!sl->stats)
+                return AVERROR(ENOMEM);
+        }
+    }
+    return 0;
+}
+
+/* Slices are cut on multiples of the chroma subsampling, of both fields
+ * when interlaced, and hold at least two such units so that the median
+ * predictor always has a line above. */
+static int slice_unit(const HYuvContext *s)
+{
+    return (1 << s->chroma_v_shift) << s->interlaced;
+}
+
+int ff_huffyuv_max_slices(const HYuvContext *s)
+{
+    return FFMAX(1, s->height / slice_unit(s) / 2);
+}
+
+void ff_huffyuv_slice_rows(const HYuvContext *s, int nb_slices, int slice,
+                           int *y_start, int *y_end)
+{
+    const int unit  = slice_unit(s);
+    const int units = s->height / unit;
+
+    *y_start = units * slice / nb_slices * unit;
+    *y_end   = slice + 1 < nb_slices ? units * (slice + 1) / nb_slices * unit
+                                     : s->height;
+}
+
 av_cold void ff_huffyuv_common_init(AVCodecContext *avctx)
 {
     HYuvContext *s = avctx->priv_data;
@@ -92,4 +160,15 @@ av_cold void ff_huffyuv_common_end(HYuvContext *s)
         av_freep(&s->temp[i]);
         s->temp16[i] = NULL;
     }
+
+    for (i = 1; i < s->nb_slice_ctx; i++) {
+        HYuvSlice *sl = &s->slice_ctx[i];
+        int j;
+
+        for (j = 0; j < 3; j++)
+            av_freep(&sl->temp[j]);
+        av_freep(&sl->stats);
+    }
+    av_freep(&s->slice_ctx);
+    s->nb_slice_ctx = 0;
 }
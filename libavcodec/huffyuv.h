@@ -51,6 +51,20 @@ typedef enum Predictor {
     MEDIAN,
 } Predictor;
 
+/**
+ * State of one horizontal band of a multi-slice ffvhuff frame, coded as
+ * an independent picture of its own.
+ */
+typedef struct HYuvSlice {
+    GetBitContext gb;
+    PutBitContext pb;
+    uint8_t *temp[3];
+    uint16_t *temp16[3];                    ///< identical to temp but 16bit type
+    uint64_t (*stats)[MAX_VLC_N];           ///< symbol counts of this slice, NULL if unused
+    int y_start, y_end;                     ///< luma rows covered by the slice
+    int size;                               ///< coded size in bytes, or a negative error code
+} HYuvSlice;
+
 typedef struct HYuvContext {
     AVClass *class;
     AVCodecContext *avctx;
@@ -90,11 +104,19 @@ typedef struct HYuvContext {
     HuffYUVEncDSPContext hencdsp;
     LLVidDSPContext llviddsp;
     int non_determ; // non-deterministic, multi-threaded encoder allowed
+    int sliced;                             ///< packets carry a slice table (extradata[3] == 2)
+    int nb_slices;
+    HYuvSlice *slice_ctx;                   ///< slice 0 shares temp and stats with the context
+    int nb_slice_ctx;
 } HYuvContext;
 
 void ff_huffyuv_common_init(AVCodecContext *s);
 void ff_huffyuv_common_end(HYuvContext *s);
 int  ff_huffyuv_alloc_temp(HYuvContext *s);
+int  ff_huffyuv_alloc_slices(HYuvContext *s, int nb_slices, int stats);
+int  ff_huffyuv_max_slices(const HYuvContext *s);
+void ff_huffyuv_slice_rows(const HYuvContext *s, int nb_slices, int slice,
+                           int *y_start, int *y_end);
 int ff_huffyuv_generate_bits_table(uint32_t *dst, const uint8_t *len_table, int n);
 
 #endif /* AVCODEC_HUFFYUV_H */
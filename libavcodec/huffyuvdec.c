@@ -38,6 +38,7 @@
 #include "huffyuvdsp.h"
 #include "thread.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/pixdesc.h"
 
 #define classic_shift_luma_table_size 42
@@ -339,6 +340,7 @@ static av_cold int decode_init(AVCodecContext *avctx)
             s->yuv   = !!(avctx->extradata[2] & 1);
             s->chroma= !!(avctx->extradata[2] & 3);
             s->alpha = !!(avctx->extradata[2] & 4);
+            s->sliced = avctx->extradata[3] == 2;
         }
         interlace     = (avctx->extradata[2] & 0x30) >> 4;
         s->interlaced = (interlace == 1) ? 1 : (interlace == 2) ? 0 : s->interlaced;
@@ -560,7 +562,8 @@ static av_cold int decode_init(AVCodecContext *avctx)
         goto error;
     }
 
-    if ((ret = ff_huffyuv_alloc_temp(s)) < 0) {
+    if ((ret = ff_huffyuv_alloc_temp(s)) < 0 ||
+        (ret = ff_huffyuv_alloc_slices(s, 1, 0)) < 0) {
         ff_huffyuv_common_end(s);
         goto error;
     }
@@ -577,7 +580,10 @@ static av_cold int decode_init_thread_copy(AVCodecContext *avctx)
     HYuvContext *s = avctx->priv_data;
     int i, ret;
 
-    if ((ret = ff_huffyuv_alloc_temp(s)) < 0) {
+    s->slice_ctx    = NULL;
+    s->nb_slice_ctx = 0;
+    if ((ret = ff_huffyuv_alloc_temp(s)) < 0 ||
+        (ret = ff_huffyuv_alloc_slices(s, 1, 0)) < 0) {
         ff_huffyuv_common_end(s);
         return ret;
     }
@@ -681,8 +687,8 @@ static void decode_422_bitstream(HYuvContext *s, int count)
 }
 
 #define READ_2PIX_PLANE(dst0, dst1, plane, OP) \
-    UPDATE_CACHE(re, &s->gb); \
-    GET_VLC_DUAL(dst0, dst1, re, &s->gb, s->vlc[4+plane].table, \
+    UPDATE_CACHE(re, &sl->gb); \
+    GET_VLC_DUAL(dst0, dst1, re, &sl->gb, s->vlc[4+plane].table, \
                  s->vlc[plane].table, s->vlc[plane].table, VLC_BITS, 3, OP)
 
 #define OP14bits(dst0, dst1, code) dst0 = code>>8; dst1 = sign_extend(code, 8)
@@ -690,68 +696,68 @@ static void decode_422_bitstream(HYuvContext *s, int count)
 /* TODO instead of restarting the read when the code isn't in the first level
  * of the joint table, jump into the 2nd level of the individual table. */
 #define READ_2PIX_PLANE16(dst0, dst1, plane){\
-    dst0 = get_vlc2(&s->gb, s->vlc[plane].table, VLC_BITS, 3)<<2;\
-    dst0 += get_bits(&s->gb, 2);\
-    dst1 = get_vlc2(&s->gb, s->vlc[plane].table, VLC_BITS, 3)<<2;\
-    dst1 += get_bits(&s->gb, 2);\
+    dst0 = get_vlc2(&sl->gb, s->vlc[plane].table, VLC_BITS, 3)<<2;\
+    dst0 += get_bits(&sl->gb, 2);\
+    dst1 = get_vlc2(&sl->gb, s->vlc[plane].table, VLC_BITS, 3)<<2;\
+    dst1 += get_bits(&sl->gb, 2);\
 }
-static void decode_plane_bitstream(HYuvContext *s, int width, int plane)
+static void decode_plane_bitstream(HYuvContext *s, HYuvSlice *sl, int width, int plane)
 {
     int i, count = width/2;
 
     if (s->bps <= 8) {
-        OPEN_READER(re, &s->gb);
-        if (count >= (get_bits_left(&s->gb)) / (32 * 2)) {
-            for (i = 0; i < count && BITS_LEFT(re, &s->gb) > 0; i++) {
-                READ_2PIX_PLANE(s->temp[0][2 * i], s->temp[0][2 * i + 1], plane, OP8bits);
+        OPEN_READER(re, &sl->gb);
+        if (count >= (get_bits_left(&sl->gb)) / (32 * 2)) {
+            for (i = 0; i < count && BITS_LEFT(re, &sl->gb) > 0; i++) {
+                READ_2PIX_PLANE(sl->temp[0][2 * i], sl->temp[0][2 * i + 1], plane, OP8bits);
             }
         } else {
             for(i=0; i<count; i++){
-                READ_2PIX_PLANE(s->temp[0][2 * i], s->temp[0][2 * i + 1], plane, OP8bits);
+                READ_2PIX_PLANE(sl->temp[0][2 * i], sl->temp[0][2 * i + 1], plane, OP8bits);
             }
         }
-        if( width&1 && BITS_LEFT(re, &s->gb)>0 ) {
+        if( width&1 && BITS_LEFT(re, &sl->gb)>0 ) {
             unsigned int index;
             int nb_bits, code, n;
-            UPDATE_CACHE(re, &s->gb);
-            index = SHOW_UBITS(re, &s->gb, VLC_BITS);
-            VLC_INTERN(s->temp[0][width-1], s->vlc[plane].table,
-                       &s->gb, re, VLC_BITS, 3);
+            UPDATE_CACHE(re, &sl->gb);
+            index = SHOW_UBITS(re, &sl->gb, VLC_BITS);
+            VLC_INTERN(sl->temp[0][width-1], s->vlc[plane].table,
+                       &sl->gb, re, VLC_BITS, 3);
         }
-        CLOSE_READER(re, &s->gb);
+        CLOSE_READER(re, &sl->gb);
     } else if (s->bps <= 14) {
-        OPEN_READER(re, &s->gb);
-        if (count >= (get_bits_left(&s->gb)) / (32 * 2)) {
-            for (i = 0; i < count && BITS_LEFT(re, &s->gb) > 0; i++) {
-                READ_2PIX_PLANE(s->temp16[0][2 * i], s->temp16[0][2 * i + 1], plane, OP14bits);
+        OPEN_READER(re, &sl->gb);
+        if (count >= (get_bits_left(&sl->gb)) / (32 * 2)) {
+            for (i = 0; i < count && BITS_LEFT(re, &sl->gb) > 0; i++) {
+                READ_2PIX_PLANE(sl->temp16[0][2 * i], sl->temp16[0][2 * i + 1], plane, OP14bits);
             }
         } else {
             for(i=0; i<count; i++){
-                READ_2PIX_PLANE(s->temp16[0][2 * i], s->temp16[0][2 * i + 1], plane, OP14bits);
+                READ_2PIX_PLANE(sl->temp16[0][2 * i], sl->temp16[0][2 * i + 1], plane, OP14bits);
             }
         }
-        if( width&1 && BITS_LEFT(re, &s->gb)>0 ) {
+        if( width&1 && BITS_LEFT(re, &sl->gb)>0 ) {
             unsigned int index;
             int nb_bits, code, n;
-            UPDATE_CACHE(re, &s->gb);
-            index = SHOW_UBITS(re, &s->gb, VLC_BITS);
-            VLC_INTERN(s->temp16[0][width-1], s->vlc[plane].table,
-                       &s->gb, re, VLC_BITS, 3);
+            UPDATE_CACHE(re, &sl->gb);
+            index = SHOW_UBITS(re, &sl->gb, VLC_BITS);
+            VLC_INTERN(sl->temp16[0][width-1], s->vlc[plane].table,
+                       &sl->gb, re, VLC_BITS, 3);
         }
-        CLOSE_READER(re, &s->gb);
+        CLOSE_READER(re, &sl->gb);
     } else {
-        if (count >= (get_bits_left(&s->gb)) / (32 * 2)) {
-            for (i = 0; i < count && get_bits_left(&s->gb) > 0; i++) {
-                READ_2PIX_PLANE16(s->temp16[0][2 * i], s->temp16[0][2 * i + 1], plane);
+        if (count >= (get_bits_left(&sl->gb)) / (32 * 2)) {
+            for (i = 0; i < count && get_bits_left(&sl->gb) > 0; i++) {
+                READ_2PIX_PLANE16(sl->temp16[0][2 * i], sl->temp16[0][2 * i + 1], plane);
             }
         } else {
             for(i=0; i<count; i++){
-                READ_2PIX_PLANE16(s->temp16[0][2 * i], s->temp16[0][2 * i + 1], plane);
+                READ_2PIX_PLANE16(sl->temp16[0][2 * i], sl->temp16[0][2 * i + 1], plane);
             }
         }
-        if( width&1 && get_bits_left(&s->gb)>0 ) {
-            int dst = get_vlc2(&s->gb, s->vlc[plane].table, VLC_BITS, 3)<<2;
-            s->temp16[0][width-1] = dst + get_bits(&s->gb, 2);
+        if( width&1 && get_bits_left(&sl->gb)>0 ) {
+            int dst = get_vlc2(&sl->gb, s->vlc[plane].table, VLC_BITS, 3)<<2;
+            sl->temp16[0][width-1] = dst + get_bits(&sl->gb, 2);
         }
     }
 }
@@ -901,6 +907,91 @@ static void add_median_prediction(HYuvContext *s, uint8_t *dst, const uint8_t *s
         s->llviddsp.add_hfyu_median_pred_int16((uint16_t *)dst, (const uint16_t *)src, (const uint16_t *)diff, s->n-1, w, left, left_top);
     }
 }
+static void decode_slice(HYuvContext *s, HYuvSlice *sl, AVFrame *p,
+                         int y_start, int y_end)
+{
+    const int fake_ystride = s->interlaced ? p->linesize[0] * 2 : p->linesize[0];
+    int plane;
+
+    for (plane = 0; plane < 1 + 2*s->chroma + s->alpha; plane++) {
+        int left, lefttop, y;
+        int w = s->width;
+        int y0 = y_start, y1 = y_end;
+        int fake_stride = fake_ystride;
+        int h;
+        uint8_t *data;
+
+        if (s->chroma && (plane == 1 || plane == 2)) {
+            w >>= s->chroma_h_shift;
+            y0 >>= s->chroma_v_shift;
+            y1 >>= s->chroma_v_shift;
+            fake_stride = s->interlaced ? p->linesize[plane] * 2 : p->linesize[plane];
+        }
+        h    = y1 - y0;
+        data = p->data[plane] + p->linesize[plane] * y0;
+
+        switch (s->predictor) {
+        case LEFT:
+        case PLANE:
+            decode_plane_bitstream(s, sl, w, plane);
+            left = left_prediction(s, data, sl->temp[0], w, 0);
+
+            for (y = 1; y < h; y++) {
+                uint8_t *dst = data + p->linesize[plane]*y;
+
+                decode_plane_bitstream(s, sl, w, plane);
+                left = left_prediction(s, dst, sl->temp[0], w, left);
+                if (s->predictor == PLANE) {
+                    if (y > s->interlaced) {
+                        add_bytes(s, dst, dst - fake_stride, w);
+                    }
+                }
+            }
+
+            break;
+        case MEDIAN:
+            decode_plane_bitstream(s, sl, w, plane);
+            left= left_prediction(s, data, sl->temp[0], w, 0);
+
+            y = 1;
+
+            /* second line is left predicted for interlaced case */
+            if (s->interlaced) {
+                decode_plane_bitstream(s, sl, w, plane);
+                left = left_prediction(s, data + p->linesize[plane], sl->temp[0], w, left);
+                y++;
+            }
+
+            lefttop = data[0];
+            decode_plane_bitstream(s, sl, w, plane);
+            add_median_prediction(s, data + fake_stride, data, sl->temp[0], w, &left, &lefttop);
+            y++;
+
+            for (; y<h; y++) {
+                uint8_t *dst;
+
+                decode_plane_bitstream(s, sl, w, plane);
+
+                dst = data + p->linesize[plane] * y;
+
+                add_median_prediction(s, dst, dst - fake_stride, sl->temp[0], w, &left, &lefttop);
+            }
+
+            break;
+        }
+    }
+}
+
+static int decode_slice_thread(AVCodecContext *avctx, void *arg,
+                               int jobnr, int threadnr)
+{
+    HYuvContext *s = avctx->priv_data;
+    HYuvSlice *sl  = &s->slice_ctx[jobnr];
+
+    decode_slice(s, sl, arg, sl->y_start, sl->y_end);
+    return 0;
+}
+
 static int decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
                         AVPacket *avpkt)
 {
@@ -913,7 +1004,21 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
     int fake_ystride, fake_ustride, fake_vstride;
     ThreadFrame frame = { .f = data };
     AVFrame *const p = data;
-    int table_size = 0, ret;
+    const uint8_t *slice_sizes = NULL;
+    int table_size = 0, nb_slices = 1, ret;
+
+    if (s->sliced) {
+        if (buf_size < 4)
+            return AVERROR_INVALIDDATA;
+        nb_slices = AV_RL32(buf + buf_size - 4);
+        if (nb_slices < 1 || nb_slices > ff_huffyuv_max_slices(s) ||
+            buf_size < 4 * (nb_slices + 1)) {
+            av_log(avctx, AV_LOG_ERROR, "Invalid number of slices %d\n", nb_slices);
+            return AVERROR_INVALIDDATA;
+        }
+        buf_size   -= 4 * (nb_slices + 1);
+        slice_sizes = buf + buf_size;
+    }
 
     av_fast_padded_malloc(&s->bitstream_buffer,
                    &s->bitstream_buffer_size,
@@ -940,6 +1045,24 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
                              (buf_size - table_size) * 8)) < 0)
         return ret;
 
+    if (s->sliced) {
+        int i, offset = table_size;
+
+        if ((ret = ff_huffyuv_alloc_slices(s, nb_slices, 0)) < 0)
+            return ret;
+
+        for (i = 0; i < nb_slices; i++) {
+            HYuvSlice *sl = &s->slice_ctx[i];
+            unsigned size = AV_RL32(slice_sizes + 4 * i);
+
+            if (size > buf_size - offset)
+                return AVERROR_INVALIDDATA;
+            init_get_bits(&sl->gb, s->bitstream_buffer + offset, size * 8);
+            ff_huffyuv_slice_rows(s, nb_slices, i, &sl->y_start, &sl->y_end);
+            offset += size;
+        }
+    }
+
     fake_ystride = s->interlaced ? p->linesize[0] * 2 : p->linesize[0];
     fake_ustride = s->interlaced ? p->linesize[1] * 2 : p->linesize[1];
     fake_vstride = s->interlaced ? p->linesize[2] * 2 : p->linesize[2];
@@ -947,68 +1070,14 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
     s->last_slice_end = 0;
 
     if (s->version > 2) {
-        int plane;
-        for(plane = 0; plane < 1 + 2*s->chroma + s->alpha; plane++) {
-            int left, lefttop, y;
-            int w = width;
-            int h = height;
-            int fake_stride = fake_ystride;
-
-            if (s->chroma && (plane == 1 || plane == 2)) {
-                w >>= s->chroma_h_shift;
-                h >>= s->chroma_v_shift;
-                fake_stride = plane == 1 ? fake_ustride : fake_vstride;
-            }
-
-            switch (s->predictor) {
-            case LEFT:
-            case PLANE:
-                decode_plane_bitstream(s, w, plane);
-                left = left_prediction(s, p->data[plane], s->temp[0], w, 0);
-
-                for (y = 1; y < h; y++) {
-                    uint8_t *dst = p->data[plane] + p->linesize[plane]*y;
-
-                    decode_plane_bitstream(s, w, plane);
-                    left = left_prediction(s, dst, s->temp[0], w, left);
-                    if (s->predictor == PLANE) {
-                        if (y > s->interlaced) {
-                            add_bytes(s, dst, dst - fake_stride, w);
-                        }
-                    }
-                }
-
-                break;
-            case MEDIAN:
-                decode_plane_bitstream(s, w, plane);
-                left= left_prediction(s, p->data[plane], s->temp[0], w, 0);
-
-                y = 1;
-
-                /* second line is left predicted for interlaced case */
-                if (s->interlaced) {
-                    decode_plane_bitstream(s, w, plane);
-                    left = left_prediction(s, p->data[plane] + p->linesize[plane], s->temp[0], w, left);
-                    y++;
-                }
-
-                lefttop = p->data[plane][0];
-                decode_plane_bitstream(s, w, plane);
-                add_median_prediction(s, p->data[plane] + fake_stride, p->data[plane], s->temp[0], w, &left, &lefttop);
-                y++;
-
-                for (; y<h; y++) {
-                    uint8_t *dst;
-
-                    decode_plane_bitstream(s, w, plane);
-
-                    dst = p->data[plane] + p->linesize[plane] * y;
-
-                    add_median_prediction(s, dst, dst - fake_stride, s->temp[0], w, &left, &lefttop);
-                }
+        if (s->sliced) {
+            avctx->execute2(avctx, decode_slice_thread, p, NULL, nb_slices);
+        } else {
+            HYuvSlice *sl = &s->slice_ctx[0];
 
-                break;
-            }
+            sl->gb = s->gb;
+            decode_slice(s, sl, p, 0, height);
+            s->gb = sl->gb;
         }
         draw_slice(s, p, height);
     } else if (s->bitstream_bpp < 24) {
@@ -1233,6 +1302,8 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
 
     *got_frame = 1;
 
+    if (s->sliced)
+        return avpkt->size;
     return (get_bits_count(&s->gb) + 31) / 32 * 4 + table_size;
 }
 
@@ -1261,7 +1332,7 @@ AVCodec ff_ffvhuff_decoder = {
     .close            = decode_end,
     .decode           = decode_frame,
     .capabilities     = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DRAW_HORIZ_BAND |
-                        AV_CODEC_CAP_FRAME_THREADS,
+                        AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS,
     .init_thread_copy = ONLY_IF_THREADS_ENABLED(decode_init_thread_copy),
 };
 #endif /* CONFIG_FFVHUFF_DECODER */
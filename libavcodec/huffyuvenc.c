@@ -34,6 +34,7 @@
 #include "huffyuvencdsp.h"
 #include "internal.h"
 #include "put_bits.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 
@@ -361,6 +362,26 @@ FF_ENABLE_DEPRECATION_WARNINGS
                    "using huffyuv 2.2.0 or newer interlacing flag\n");
     }
 
+    s->nb_slices = 1;
+    if (avctx->slices > 1) {
+        if (avctx->codec->id != AV_CODEC_ID_FFVHUFF) {
+            av_log(avctx, AV_LOG_ERROR,
+                   "Error: multiple slices are not supported "
+                   "by huffyuv; use vcodec=ffvhuff\n");
+            return AVERROR(EINVAL);
+        }
+        if (s->version < 3) {
+            if (!(desc->flags & AV_PIX_FMT_FLAG_PLANAR)) {
+                av_log(avctx, AV_LOG_ERROR,
+                       "Error: multiple slices require a planar format\n");
+                return AVERROR(EINVAL);
+            }
+            /* 4:2:2 and 4:2:0 are sliced as generic planar content */
+            s->version = 3;
+        }
+        s->nb_slices = FFMIN(avctx->slices, ff_huffyuv_max_slices(s));
+    }
+
     if (s->version > 3 && avctx->strict_std_compliance > FF_COMPLIANCE_EXPERIMENTAL) {
         av_log(avctx, AV_LOG_ERROR, "Ver > 3 is under development, files encoded with it may not be decodable with future versions!!!\n"
                "Use vstrict=-2 / -strict -2 to use it anyway.\n");
@@ -386,7 +407,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
             ((uint8_t*)avctx->extradata)[2] |= s->yuv ? 1 : 2;
         if (s->alpha)
             ((uint8_t*)avctx->extradata)[2] |= 4;
-        ((uint8_t*)avctx->extradata)[3] = 1;
+        ((uint8_t*)avctx->extradata)[3] = s->nb_slices > 1 ? 2 : 1;
     }
     s->avctx->extradata_size = 4;
 
@@ -437,10 +458,15 @@ FF_ENABLE_DEPRECATION_WARNINGS
                 s->stats[i][j]= 0;
     }
 
-    if (ff_huffyuv_alloc_temp(s)) {
+    if (ff_huffyuv_alloc_temp(s) ||
+        ff_huffyuv_alloc_slices(s, s->nb_slices,
+                                s->context || (s->flags & AV_CODEC_FLAG_PASS1))) {
         ff_huffyuv_common_end(s);
         return AVERROR(ENOMEM);
     }
+    for (i = 0; i < s->nb_slices; i++)
+        ff_huffyuv_slice_rows(s, s->nb_slices, i, &s->slice_ctx[i].y_start,
+                              &s->slice_ctx[i].y_end);
 
     s->picture_number=0;
 
@@ -501,54 +527,54 @@ static int encode_422_bitstream(HYuvContext *s, int offset, int count)
     return 0;
 }
 
-static int encode_plane_bitstream(HYuvContext *s, int width, int plane)
+static int encode_plane_bitstream(HYuvContext *s, HYuvSlice *sl, int width, int plane)
 {
     int i, count = width/2;
 
-    if (s->pb.buf_end - s->pb.buf - (put_bits_count(&s->pb) >> 3) < count * s->bps / 2) {
+    if (sl->pb.buf_end - sl->pb.buf - (put_bits_count(&sl->pb) >> 3) < count * s->bps / 2) {
         av_log(s->avctx, AV_LOG_ERROR, "encoded frame too large\n");
         return -1;
     }
 
 #define LOADEND\
-            int y0 = s->temp[0][width-1];
+            int y0 = sl->temp[0][width-1];
 #define LOADEND_14\
-            int y0 = s->temp16[0][width-1] & mask;
+            int y0 = sl->temp16[0][width-1] & mask;
 #define LOADEND_16\
-            int y0 = s->temp16[0][width-1];
+            int y0 = sl->temp16[0][width-1];
 #define STATEND\
-            s->stats[plane][y0]++;
+            sl->stats[plane][y0]++;
 #define STATEND_16\
-            s->stats[plane][y0>>2]++;
+            sl->stats[plane][y0>>2]++;
 #define WRITEEND\
-            put_bits(&s->pb, s->len[plane][y0], s->bits[plane][y0]);
+            put_bits(&sl->pb, s->len[plane][y0], s->bits[plane][y0]);
 #define WRITEEND_16\
-            put_bits(&s->pb, s->len[plane][y0>>2], s->bits[plane][y0>>2]);\
-            put_bits(&s->pb, 2, y0&3);
+            put_bits(&sl->pb, s->len[plane][y0>>2], s->bits[plane][y0>>2]);\
+            put_bits(&sl->pb, 2, y0&3);
 
 #define LOAD2\
-            int y0 = s->temp[0][2 * i];\
-            int y1 = s->temp[0][2 * i + 1];
+            int y0 = sl->temp[0][2 * i];\
+            int y1 = sl->temp[0][2 * i + 1];
 #define LOAD2_14\
-            int y0 = s->temp16[0][2 * i] & mask;\
-            int y1 = s->temp16[0][2 * i + 1] & mask;
+            int y0 = sl->temp16[0][2 * i] & mask;\
+            int y1 = sl->temp16[0][2 * i + 1] & mask;
 #define LOAD2_16\
-            int y0 = s->temp16[0][2 * i];\
-            int y1 = s->temp16[0][2 * i + 1];
+            int y0 = sl->temp16[0][2 * i];\
+            int y1 = sl->temp16[0][2 * i + 1];
 #define STAT2\
-            s->stats[plane][y0]++;\
-            s->stats[plane][y1]++;
+            sl->stats[plane][y0]++;\
+            sl->stats[plane][y1]++;
 #define STAT2_16\
-            s->stats[plane][y0>>2]++;\
-            s->stats[plane][y1>>2]++;
+            sl->stats[plane][y0>>2]++;\
+            sl->stats[plane][y1>>2]++;
 #define WRITE2\
-            put_bits(&s->pb, s->len[plane][y0], s->bits[plane][y0]);\
-            put_bits(&s->pb, s->len[plane][y1], s->bits[plane][y1]);
+            put_bits(&sl->pb, s->len[plane][y0], s->bits[plane][y0]);\
+            put_bits(&sl->pb, s->len[plane][y1], s->bits[plane][y1]);
 #define WRITE2_16\
-            put_bits(&s->pb, s->len[plane][y0>>2], s->bits[plane][y0>>2]);\
-            put_bits(&s->pb, 2, y0&3);\
-            put_bits(&s->pb, s->len[plane][y1>>2], s->bits[plane][y1>>2]);\
-            put_bits(&s->pb, 2, y1&3);
+            put_bits(&sl->pb, s->len[plane][y0>>2], s->bits[plane][y0>>2]);\
+            put_bits(&sl->pb, 2, y0&3);\
+            put_bits(&sl->pb, s->len[plane][y1>>2], s->bits[plane][y1>>2]);\
+            put_bits(&sl->pb, 2, y1&3);
 
     if (s->bps <= 8) {
     if (s->flags & AV_CODEC_FLAG_PASS1) {
@@ -759,6 +785,129 @@ static inline int encode_bgra_bitstream(HYuvContext *s, int count, int planes)
     return 0;
 }
 
+static int encode_slice(HYuvContext *s, HYuvSlice *sl, const AVFrame *p,
+                        int y_start, int y_end)
+{
+    const int fake_ystride = s->interlaced ? p->linesize[0]*2 : p->linesize[0];
+    int plane, ret = 0;
+
+    for (plane = 0; plane < 1 + 2*s->chroma + s->alpha; plane++) {
+        int left, y;
+        int w = s->width;
+        int y0 = y_start, y1 = y_end;
+        int fake_stride = fake_ystride;
+        int h;
+        const uint8_t *data;
+
+        if (s->chroma && (plane == 1 || plane == 2)) {
+            w >>= s->chroma_h_shift;
+            y0 >>= s->chroma_v_shift;
+            y1 >>= s->chroma_v_shift;
+            fake_stride = s->interlaced ? p->linesize[plane]*2 : p->linesize[plane];
+        }
+        h    = y1 - y0;
+        data = p->data[plane] + p->linesize[plane] * y0;
+
+        left = sub_left_prediction(s, sl->temp[0], data, w , 0);
+
+        ret |= encode_plane_bitstream(s, sl, w, plane);
+
+        if (s->predictor==MEDIAN) {
+            int lefttop;
+            y = 1;
+            if (s->interlaced) {
+                left = sub_left_prediction(s, sl->temp[0], data + p->linesize[plane], w , left);
+
+                ret |= encode_plane_bitstream(s, sl, w, plane);
+                y++;
+            }
+
+            lefttop = data[0];
+
+            for (; y < h; y++) {
+                const uint8_t *dst = data + p->linesize[plane] * y;
+
+                sub_median_prediction(s, sl->temp[0], dst - fake_stride, dst, w , &left, &lefttop);
+
+                ret |= encode_plane_bitstream(s, sl, w, plane);
+            }
+        } else {
+            for (y = 1; y < h; y++) {
+                const uint8_t *dst = data + p->linesize[plane] * y;
+
+                if (s->predictor == PLANE && s->interlaced < y) {
+                    diff_bytes(s, sl->temp[1], dst, dst - fake_stride, w);
+
+                    left = sub_left_prediction(s, sl->temp[0], sl->temp[1], w , left);
+                } else {
+                    left = sub_left_prediction(s, sl->temp[0], dst, w , left);
+                }
+
+                ret |= encode_plane_bitstream(s, sl, w, plane);
+            }
+        }
+    }
+    return ret;
+}
+
+static int encode_slice_thread(AVCodecContext *avctx, void *arg,
+                               int jobnr, int threadnr)
+{
+    HYuvContext *s = avctx->priv_data;
+    HYuvSlice *sl  = &s->slice_ctx[jobnr];
+    int i;
+
+    if (sl->stats && jobnr)
+        for (i = 0; i < 4; i++)
+            memset(sl->stats[i], 0, s->vlc_n * sizeof(**sl->stats));
+
+    if (encode_slice(s, sl, arg, sl->y_start, sl->y_end) < 0) {
+        sl->size = AVERROR(EINVAL);
+        return sl->size;
+    }
+    flush_put_bits(&sl->pb);
+    sl->size = put_bits_count(&sl->pb) >> 3;
+    return 0;
+}
+
+static int encode_slices(AVCodecContext *avctx, AVPacket *pkt,
+                         const AVFrame *p, int offset)
+{
+    HYuvContext *s = avctx->priv_data;
+    uint8_t *buf = pkt->data + offset;
+    /* keep room for the padding word and the slice table */
+    const int64_t room = pkt->size - offset - 4 * (s->nb_slices + 2);
+    int i, j, k, size = 0;
+
+    for (i = 0; i < s->nb_slices; i++) {
+        HYuvSlice *sl = &s->slice_ctx[i];
+        int start = room * sl->y_start / s->height;
+        int end   = room * sl->y_end   / s->height;
+
+        init_put_bits(&sl->pb, buf + start, end - start);
+    }
+
+    avctx->execute2(avctx, encode_slice_thread, (void *)p, NULL, s->nb_slices);
+
+    for (i = 0; i < s->nb_slices; i++) {
+        HYuvSlice *sl = &s->slice_ctx[i];
+
+        if (sl->size < 0) {
+            av_log(avctx, AV_LOG_ERROR, "encoded frame too large\n");
+            return sl->size;
+        }
+        memmove(buf + size, sl->pb.buf, sl->size);
+        size += sl->size;
+
+        /* slice 0 counts straight into the context statistics */
+        if (i && sl->stats)
+            for (j = 0; j < 4; j++)
+                for (k = 0; k < s->vlc_n; k++)
+                    s->stats[j][k] += sl->stats[j][k];
+    }
+    return size;
+}
+
 static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                         const AVFrame *pict, int *got_packet)
 {
@@ -787,8 +936,9 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
     init_put_bits(&s->pb, pkt->data + size, pkt->size - size);
 
-    if (avctx->pix_fmt == AV_PIX_FMT_YUV422P ||
-        avctx->pix_fmt == AV_PIX_FMT_YUV420P) {
+    if (s->version < 3 &&
+        (avctx->pix_fmt == AV_PIX_FMT_YUV422P ||
+         avctx->pix_fmt == AV_PIX_FMT_YUV420P)) {
         int lefty, leftu, leftv, y, cy;
 
         put_bits(&s->pb, 8, leftv = p->data[2][0]);
@@ -949,59 +1099,19 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
             }
             encode_bgra_bitstream(s, width, 3);
         }
+    } else if (s->version > 2 && s->nb_slices > 1) {
+        ret = encode_slices(avctx, pkt, p, size);
+        if (ret < 0)
+            return ret;
+        /* the padding goes after the slices */
+        init_put_bits(&s->pb, pkt->data + size + ret, pkt->size - size - ret);
+        size += ret;
     } else if (s->version > 2) {
-        int plane;
-        for (plane = 0; plane < 1 + 2*s->chroma + s->alpha; plane++) {
-            int left, y;
-            int w = width;
-            int h = height;
-            int fake_stride = fake_ystride;
-
-            if (s->chroma && (plane == 1 || plane == 2)) {
-                w >>= s->chroma_h_shift;
-                h >>= s->chroma_v_shift;
-                fake_stride = plane == 1 ? fake_ustride : fake_vstride;
-            }
-
-            left = sub_left_prediction(s, s->temp[0], p->data[plane], w , 0);
-
-            encode_plane_bitstream(s, w, plane);
-
-            if (s->predictor==MEDIAN) {
-                int lefttop;
-                y = 1;
-                if (s->interlaced) {
-                    left = sub_left_prediction(s, s->temp[0], p->data[plane] + p->linesize[plane], w , left);
-
-                    encode_plane_bitstream(s, w, plane);
-                    y++;
-                }
-
-                lefttop = p->data[plane][0];
+        HYuvSlice *sl = &s->slice_ctx[0];
 
-                for (; y < h; y++) {
-                    uint8_t *dst = p->data[plane] + p->linesize[plane] * y;
-
-                    sub_median_prediction(s, s->temp[0], dst - fake_stride, dst, w , &left, &lefttop);
-
-                    encode_plane_bitstream(s, w, plane);
-                }
-            } else {
-                for (y = 1; y < h; y++) {
-                    uint8_t *dst = p->data[plane] + p->linesize[plane] * y;
-
-                    if (s->predictor == PLANE && s->interlaced < y) {
-                        diff_bytes(s, s->temp[1], dst, dst - fake_stride, w);
-
-                        left = sub_left_prediction(s, s->temp[0], s->temp[1], w , left);
-                    } else {
-                        left = sub_left_prediction(s, s->temp[0], dst, w , left);
-                    }
-
-                    encode_plane_bitstream(s, w, plane);
-                }
-            }
-        }
+        sl->pb = s->pb;
+        encode_slice(s, sl, p, 0, height);
+        s->pb = sl->pb;
     } else {
         av_log(avctx, AV_LOG_ERROR, "Format not supported!\n");
     }
@@ -1038,6 +1148,16 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
     pkt->size   = size * 4;
     pkt->flags |= AV_PKT_FLAG_KEY;
+
+    if (s->nb_slices > 1) {
+        for (i = 0; i < s->nb_slices; i++) {
+            AV_WL32(pkt->data + pkt->size, s->slice_ctx[i].size);
+            pkt->size += 4;
+        }
+        AV_WL32(pkt->data + pkt->size, s->nb_slices);
+        pkt->size += 4;
+    }
+
     *got_packet = 1;
 
     return 0;
@@ -1121,7 +1241,8 @@ AVCodec ff_ffvhuff_encoder = {
     .init           = encode_init,
     .encode2        = encode_frame,
     .close          = encode_end,
-    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_INTRA_ONLY,
+    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS |
+                      AV_CODEC_CAP_INTRA_ONLY,
     .priv_class     = &ff_class,
     .pix_fmts       = (const enum AVPixelFormat[]){
         AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV411P,
@@ -87,6 +87,9 @@ av_cold void ff_imdct15_uninit(IMDCT15Context **ps)
 static void imdct15_half(IMDCT15Context *s, float *dst, const float *src,
                          ptrdiff_t stride, float scale);
 
+static void imdct15_postrotate(FFTComplex *z, const FFTComplex *exptab,
+                               ptrdiff_t len8, float scale);
+
 av_cold int ff_imdct15_init(IMDCT15Context **ps, int N)
 {
     IMDCT15Context *s;
@@ -135,6 +138,7 @@ av_cold int ff_imdct15_init(IMDCT15Context **ps, int N)
         s->exptab[0][j] = s->exptab[0][j - 15];
 
     s->imdct_half = imdct15_half;
+    s->postrotate = imdct15_postrotate;
 
     if (ARCH_AARCH64)
         ff_imdct15_init_aarch64(s);
@@ -261,11 +265,19 @@ static void imdct15_half(IMDCT15Context *s, float *dst, const float *src,
 
     fft_calc(s, z, s->tmp, s->fft_n, 1);
 
+    s->postrotate(z, s->twiddle_exptab, len8, scale);
+}
+
+static void imdct15_postrotate(FFTComplex *z, const FFTComplex *exptab,
+                               ptrdiff_t len8, float scale)
+{
+    int i;
+
     for (i = 0; i < len8; i++) {
         float r0, i0, r1, i1;
 
-        CMUL3(r0, i1, z[len8 - i - 1].im, z[len8 - i - 1].re,  s->twiddle_exptab[len8 - i - 1].im, s->twiddle_exptab[len8 - i - 1].re);
-        CMUL3(r1, i0, z[len8 + i].im,     z[len8 + i].re,      s->twiddle_exptab[len8 + i].im,     s->twiddle_exptab[len8 + i].re);
+        CMUL3(r0, i1, z[len8 - i - 1].im, z[len8 - i - 1].re,  exptab[len8 - i - 1].im, exptab[len8 - i - 1].re);
+        CMUL3(r1, i0, z[len8 + i].im,     z[len8 + i].re,      exptab[len8 + i].im,     exptab[len8 + i].re);
         z[len8 - i - 1].re = scale * r0;
         z[len8 - i - 1].im = scale * i0;
         z[len8 + i].re     = scale * r1;
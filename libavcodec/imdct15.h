@@ -39,6 +39,13 @@ typedef struct IMDCT15Context {
      */
     void (*imdct_half)(struct IMDCT15Context *s, float *dst, const float *src,
                        ptrdiff_t src_stride, float scale);
+
+    /**
+     * Rotate and scale the FFT output in place, the len8 values on each side
+     * of z + len8 being combined pairwise with those on the other side
+     */
+    void (*postrotate)(FFTComplex *z, const FFTComplex *exptab,
+                       ptrdiff_t len8, float scale);
 } IMDCT15Context;
 
 /**
@@ -86,6 +86,7 @@ typedef struct {
     Jpeg2000QuantStyle  qntsty;
 
     Jpeg2000Tile *tile;
+    int *tile_ret; ///< return values of the tile coding jobs
 
     int format;
     int pred;
@@ -370,6 +371,9 @@ static int init_tiles(Jpeg2000EncoderContext *s)
     s->numXtiles = ff_jpeg2000_ceildiv(s->width, s->tile_width);
     s->numYtiles = ff_jpeg2000_ceildiv(s->height, s->tile_height);
 
+    s->tile_ret = av_malloc_array(s->numXtiles, s->numYtiles * sizeof(*s->tile_ret));
+    if (!s->tile_ret)
+        return AVERROR(ENOMEM);
     s->tile = av_malloc_array(s->numXtiles, s->numYtiles * sizeof(Jpeg2000Tile));
     if (!s->tile)
         return AVERROR(ENOMEM);
@@ -913,12 +917,20 @@ static int encode_tile(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile, int tileno
 
     av_log(s->avctx, AV_LOG_DEBUG, "rate control\n");
     truncpasses(s, tile);
-    if ((ret = encode_packets(s, tile, tileno)) < 0)
-        return ret;
     av_log(s->avctx, AV_LOG_DEBUG, "after rate control\n");
     return 0;
 }
 
+static int encode_tile_thread(AVCodecContext *avctx, void *arg,
+                              int jobnr, int threadnr)
+{
+    Jpeg2000EncoderContext *s = avctx->priv_data;
+    int *ret = arg;
+
+    ret[jobnr] = encode_tile(s, s->tile + jobnr, jobnr);
+    return 0;
+}
+
 static void cleanup(Jpeg2000EncoderContext *s)
 {
     int tileno, compno;
@@ -932,6 +944,7 @@ static void cleanup(Jpeg2000EncoderContext *s)
         av_freep(&s->tile[tileno].comp);
     }
     av_freep(&s->tile);
+    av_freep(&s->tile_ret);
 }
 
 static void reinit(Jpeg2000EncoderContext *s)
@@ -1034,14 +1047,21 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
     if ((ret = put_com(s, 0)) < 0)
         return ret;
 
+    /* tier-1 coding and rate control of the tiles are independent, only
+     * the packets have to be written in order */
+    avctx->execute2(avctx, encode_tile_thread, s->tile_ret, NULL,
+                    s->numXtiles * s->numYtiles);
+
     for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++){
         uint8_t *psotptr;
+        if ((ret = s->tile_ret[tileno]) < 0)
+            return ret;
         if (!(psotptr = put_sot(s, tileno)))
             return -1;
         if (s->buf_end - s->buf < 2)
             return -1;
         bytestream_put_be16(&s->buf, JPEG2000_SOD);
-        if ((ret = encode_tile(s, s->tile + tileno, tileno)) < 0)
+        if ((ret = encode_packets(s, s->tile + tileno, tileno)) < 0)
             return ret;
         bytestream_put_be32(&psotptr, s->buf - psotptr + 6);
     }
@@ -1170,6 +1190,7 @@ AVCodec ff_jpeg2000_encoder = {
     .init           = j2kenc_init,
     .encode2        = encode_frame,
     .close          = j2kenc_destroy,
+    .capabilities   = AV_CODEC_CAP_SLICE_THREADS,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_YUV444P, AV_PIX_FMT_GRAY8,
         AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P,
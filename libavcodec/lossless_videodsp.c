@@ -111,7 +111,7 @@ static int add_hfyu_left_pred_int16_c(uint16_t *dst, const uint16_t *src, unsign
         dst[i]= acc & mask;
     }
 
-    return acc;
+    return acc & mask;
 }
 
 
@@ -664,10 +664,11 @@ unk_pixfmt:
     return 0;
 }
 
-static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
+static inline int mjpeg_decode_dc(MJpegDecodeContext *s, GetBitContext *gb,
+                                  int dc_index)
 {
     int code;
-    code = get_vlc2(&s->gb, s->vlcs[0][dc_index].table, 9, 2);
+    code = get_vlc2(gb, s->vlcs[0][dc_index].table, 9, 2);
     if (code < 0 || code > 16) {
         av_log(s->avctx, AV_LOG_WARNING,
                "mjpeg_decode_dc: bad vlc: %d:%d (%p)\n",
@@ -676,47 +677,48 @@ static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
     }
 
     if (code)
-        return get_xbits(&s->gb, code);
+        return get_xbits(gb, code);
     else
         return 0;
 }
 
 /* decode block and dequantize */
-static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
+static int decode_block(MJpegDecodeContext *s, GetBitContext *gb, int *last_dc,
+                        int16_t *block, int component,
                         int dc_index, int ac_index, int16_t *quant_matrix)
 {
     int code, i, j, level, val;
 
     /* DC coef */
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
     }
-    val = val * quant_matrix[0] + s->last_dc[component];
+    val = val * quant_matrix[0] + last_dc[component];
     val = FFMIN(val, 32767);
-    s->last_dc[component] = val;
+    last_dc[component] = val;
     block[0] = val;
     /* AC coefs */
     i = 0;
-    {OPEN_READER(re, &s->gb);
+    {OPEN_READER(re, gb);
     do {
-        UPDATE_CACHE(re, &s->gb);
-        GET_VLC(code, re, &s->gb, s->vlcs[1][ac_index].table, 9, 2);
+        UPDATE_CACHE(re, gb);
+        GET_VLC(code, re, gb, s->vlcs[1][ac_index].table, 9, 2);
 
         i += ((unsigned)code) >> 4;
             code &= 0xf;
         if (code) {
             if (code > MIN_CACHE_BITS - 16)
-                UPDATE_CACHE(re, &s->gb);
+                UPDATE_CACHE(re, gb);
 
             {
-                int cache = GET_CACHE(re, &s->gb);
+                int cache = GET_CACHE(re, gb);
                 int sign  = (~cache) >> 31;
                 level     = (NEG_USR32(sign ^ cache,code) ^ sign) - sign;
             }
 
-            LAST_SKIP_BITS(re, &s->gb, code);
+            LAST_SKIP_BITS(re, gb, code);
 
             if (i > 63) {
                 av_log(s->avctx, AV_LOG_ERROR, "error count: %d\n", i);
@@ -726,7 +728,7 @@ static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
             block[j] = level * quant_matrix[j];
         }
     } while (i < 63);
-    CLOSE_READER(re, &s->gb);}
+    CLOSE_READER(re, gb);}
 
     return 0;
 }
@@ -737,7 +739,7 @@ static int decode_dc_progressive(MJpegDecodeContext *s, int16_t *block,
 {
     int val;
     s->bdsp.clear_block(block);
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, &s->gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
@@ -1001,7 +1003,7 @@ static int ljpeg_decode_rgb_scan(MJpegDecodeContext *s, int nb_components, int p
 
                 PREDICT(pred, topleft[i], top[i], left[i], modified_predictor);
 
-                dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                 if(dc == 0xFFFFF)
                     return -1;
 
@@ -1109,7 +1111,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for(j=0; j<n; j++) {
                         int pred, dc;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if (   h * mb_x + x >= s->width
@@ -1180,7 +1182,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for (j = 0; j < n; j++) {
                         int pred;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if (   h * mb_x + x >= s->width
@@ -1249,6 +1251,163 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
+static int decode_block_put(MJpegDecodeContext *s, GetBitContext *gb,
+                            int *last_dc, int16_t *block, int i,
+                            uint8_t *ptr, int linesize)
+{
+    s->bdsp.clear_block(block);
+    if (decode_block(s, gb, last_dc, block, i,
+                     s->dc_index[i], s->ac_index[i],
+                     s->quant_matrixes[s->quant_sindex[i]]) < 0)
+        return AVERROR_INVALIDDATA;
+    if (ptr) {
+        s->idsp.idct_put(ptr, linesize, block);
+        if (s->bits & 7)
+            shift_output(s, ptr, linesize);
+    }
+    return 0;
+}
+
+/* scan state shared by the slice threads decoding its restart intervals */
+typedef struct ScanSliceContext {
+    int nb_components;
+    int nb_intervals;
+    int start_bits;         ///< position of the first interval in s->gb
+    const int *rst_offsets; ///< byte offsets of the following intervals
+    uint8_t *data[MAX_COMPONENTS];
+    int linesize[MAX_COMPONENTS];
+    int chroma_width, chroma_height;
+} ScanSliceContext;
+
+static int decode_scan_slice(AVCodecContext *avctx, void *arg,
+                             int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    const ScanSliceContext *sc = arg;
+    LOCAL_ALIGNED_32(int16_t, block, [64]);
+    int last_dc[MAX_COMPONENTS];
+    int bytes_per_pixel = 1 + (s->bits > 8);
+    int mb_start = jobnr * s->restart_interval;
+    int mb_end   = FFMIN(mb_start + s->restart_interval,
+                         s->mb_width * s->mb_height);
+    int mb, i;
+    GetBitContext gb;
+
+    /* each interval ends where the next RSTn marker begins */
+    if (jobnr < sc->nb_intervals - 1)
+        init_get_bits(&gb, s->gb.buffer, (sc->rst_offsets[jobnr] - 2) * 8);
+    else
+        init_get_bits(&gb, s->gb.buffer, s->gb.size_in_bits);
+    skip_bits_long(&gb, jobnr ? sc->rst_offsets[jobnr - 1] * 8 : sc->start_bits);
+
+    for (i = 0; i < sc->nb_components; i++)
+        last_dc[i] = 4 << s->bits;
+
+    for (mb = mb_start; mb < mb_end; mb++) {
+        int mb_x = mb % s->mb_width;
+        int mb_y = mb / s->mb_width;
+
+        if (get_bits_left(&gb) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "overread %d\n", -get_bits_left(&gb));
+            return AVERROR_INVALIDDATA;
+        }
+        for (i = 0; i < sc->nb_components; i++) {
+            int n = s->nb_blocks[i];
+            int c = s->comp_index[i];
+            int h = s->h_scount[i];
+            int v = s->v_scount[i];
+            int x = 0, y = 0, j;
+
+            for (j = 0; j < n; j++) {
+                int block_offset = (((sc->linesize[c] * (v * mb_y + y) * 8) +
+                                     (h * mb_x + x) * 8 * bytes_per_pixel) >> avctx->lowres);
+                uint8_t *ptr = NULL;
+
+                if (s->interlaced && s->bottom_field)
+                    block_offset += sc->linesize[c] >> 1;
+                if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? sc->chroma_width  : s->width)
+                    && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? sc->chroma_height : s->height))
+                    ptr = sc->data[c] + block_offset;
+
+                if (decode_block_put(s, &gb, last_dc, block, i,
+                                     ptr, sc->linesize[c]) < 0) {
+                    av_log(avctx, AV_LOG_ERROR,
+                           "error y=%d x=%d\n", mb_y, mb_x);
+                    return AVERROR_INVALIDDATA;
+                }
+                if (++x == h) {
+                    x = 0;
+                    y++;
+                }
+            }
+        }
+    }
+
+    /* the following data is read from the end of the last interval */
+    if (jobnr == sc->nb_intervals - 1)
+        s->scan_end_bits = get_bits_count(&gb);
+
+    return 0;
+}
+
+/**
+ * Decode the restart intervals of a sequential DCT scan in parallel, each
+ * interval being independently decodable thanks to the resets of the
+ * DC predictors at the RSTn markers.
+ *
+ * @return 0 on success, 1 if the scan must be decoded serially, a negative
+ *         error code on failure
+ */
+static int decode_scan_slices(MJpegDecodeContext *s, int nb_components,
+                              uint8_t *data[MAX_COMPONENTS],
+                              const int linesize[MAX_COMPONENTS],
+                              int chroma_width, int chroma_height)
+{
+    ScanSliceContext sc = { 0 };
+    int nb_intervals = (s->mb_width * s->mb_height + s->restart_interval - 1) /
+                       s->restart_interval;
+    int first, i, ret;
+
+    if (nb_intervals < 2)
+        return 1;
+
+    /* only the markers following the current position belong to this scan */
+    for (first = 0; first < s->nb_rst_offsets; first++)
+        if (s->rst_offsets[first] * 8 > get_bits_count(&s->gb))
+            break;
+    if (s->nb_rst_offsets - first < nb_intervals - 1)
+        return 1;
+
+    av_fast_malloc(&s->slice_ret, &s->slice_ret_size,
+                   nb_intervals * sizeof(*s->slice_ret));
+    if (!s->slice_ret)
+        return AVERROR(ENOMEM);
+
+    sc.nb_components = nb_components;
+    sc.nb_intervals  = nb_intervals;
+    sc.start_bits    = get_bits_count(&s->gb);
+    sc.rst_offsets   = s->rst_offsets + first;
+    sc.chroma_width  = chroma_width;
+    sc.chroma_height = chroma_height;
+    for (i = 0; i < MAX_COMPONENTS; i++) {
+        sc.data[i]     = data[i];
+        sc.linesize[i] = linesize[i];
+    }
+
+    s->scan_end_bits = get_bits_count(&s->gb);
+    s->avctx->execute2(s->avctx, decode_scan_slice, &sc,
+                       s->slice_ret, nb_intervals);
+
+    ret = 0;
+    for (i = 0; i < nb_intervals; i++)
+        if (s->slice_ret[i] < 0)
+            ret = s->slice_ret[i];
+
+    skip_bits_long(&s->gb, s->scan_end_bits - get_bits_count(&s->gb));
+
+    return ret;
+}
+
 static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                              int Al, const uint8_t *mb_bitmask,
                              int mb_bitmask_size,
@@ -1284,6 +1443,14 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
         s->coefs_finished[c] |= 1;
     }
 
+    if (s->restart_interval && !s->progressive && !mb_bitmask &&
+        s->avctx->active_thread_type & FF_THREAD_SLICE) {
+        int ret = decode_scan_slices(s, nb_components, data, linesize,
+                                     chroma_width, chroma_height);
+        if (ret <= 0)
+            return ret;
+    }
+
     for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
         for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
             const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
@@ -1323,20 +1490,11 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                                 mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
                                                 linesize[c], s->avctx->lowres);
 
-                        } else {
-                            s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
-                                             s->dc_index[i], s->ac_index[i],
-                                             s->quant_matrixes[s->quant_sindex[i]]) < 0) {
-                                av_log(s->avctx, AV_LOG_ERROR,
-                                       "error y=%d x=%d\n", mb_y, mb_x);
-                                return AVERROR_INVALIDDATA;
-                            }
-                            if (ptr) {
-                                s->idsp.idct_put(ptr, linesize[c], s->block);
-                                if (s->bits & 7)
-                                    shift_output(s, ptr, linesize[c]);
-                            }
+                        } else if (decode_block_put(s, &s->gb, s->last_dc, s->block,
+                                                    i, ptr, linesize[c]) < 0) {
+                            av_log(s->avctx, AV_LOG_ERROR,
+                                   "error y=%d x=%d\n", mb_y, mb_x);
+                            return AVERROR_INVALIDDATA;
                         }
                     } else {
                         int block_idx  = s->block_stride[c] * (v * mb_y + y) +
@@ -1944,6 +2102,11 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
             }                                         \
         } while (0)
 
+        /* the offsets of the RSTn markers are only needed by the slice
+         * threads */
+        int record_rst = !!(s->avctx->active_thread_type & FF_THREAD_SLICE);
+        s->nb_rst_offsets = 0;
+
         if (s->avctx->codec_id == AV_CODEC_ID_THP) {
             ptr = buf_end;
             copy_data_segment(0);
@@ -1972,6 +2135,17 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                         copy_data_segment(1);
                         if (x)
                             break;
+                    } else if (record_rst) {
+                        /* offset of the data following the marker, which
+                         * is kept in the unescaped buffer */
+                        int *offsets = av_fast_realloc(s->rst_offsets, &s->rst_offsets_size,
+                                                       (s->nb_rst_offsets + 1) * sizeof(*offsets));
+                        if (offsets) {
+                            s->rst_offsets = offsets;
+                            s->rst_offsets[s->nb_rst_offsets++] = (dst - s->buffer) + (ptr - src);
+                        } else {
+                            record_rst = 0;
+                        }
                     }
                 }
             }
@@ -2464,6 +2638,8 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
         av_frame_unref(s->picture_ptr);
 
     av_freep(&s->buffer);
+    av_freep(&s->rst_offsets);
+    av_freep(&s->slice_ret);
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size = 0;
@@ -2512,7 +2688,7 @@ AVCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     .decode         = ff_mjpeg_decode_frame,
     .flush          = decode_flush,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .max_lowres     = 3,
     .priv_class     = &mjpegdec_class,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE |
@@ -111,6 +111,13 @@ typedef struct MJpegDecodeContext {
     int restart_interval;
     int restart_count;
 
+    int *rst_offsets;      ///< offsets of the data following the RSTn markers in the unescaped buffer
+    int nb_rst_offsets;
+    unsigned int rst_offsets_size;
+    int *slice_ret;        ///< return values of the restart interval slice threads
+    unsigned int slice_ret_size;
+    int scan_end_bits;     ///< position of the end of the last restart interval
+
     int buggy_avid;
     int cs_itu601;
     int interlace_polarity;
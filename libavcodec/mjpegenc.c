@@ -30,6 +30,8 @@
  * MJPEG encoder.
  */
 
+#include "libavutil/avassert.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/pixdesc.h"
 
 #include "avcodec.h"
@@ -118,29 +120,92 @@ av_cold void ff_mjpeg_encode_close(MpegEncContext *s)
     av_freep(&s->mjpeg_ctx);
 }
 
-static void encode_block(MpegEncContext *s, int16_t *block, int n)
+/**
+ * 64-bit bit writer for the entropy coded data of the macroblocks.
+ * The Huffman code of a symbol and the following mantissa bits are written
+ * at once; as they make at most 27 bits, fewer than 64 bits are ever pending
+ * and a single test per code is needed to output them 32 bits at a time.
+ */
+typedef struct MJpegBitWriter {
+    uint64_t buf;
+    int      count;     ///< number of pending bits in buf
+    uint8_t *ptr, *end;
+} MJpegBitWriter;
+
+static av_always_inline void bw_init(MJpegBitWriter *bw, const PutBitContext *pb)
+{
+    bw->buf   = pb->bit_buf;
+    bw->count = 32 - pb->bit_left;
+    bw->ptr   = pb->buf_ptr;
+    bw->end   = pb->buf_end;
+}
+
+static av_always_inline void bw_put(MJpegBitWriter *bw, int n, uint32_t value)
+{
+    av_assert2(n <= 27 && value < (1U << n));
+
+    bw->buf    = bw->buf << n | value;
+    bw->count += n;
+    if (bw->count >= 32) {
+        bw->count -= 32;
+        if (3 < bw->end - bw->ptr) {
+            AV_WB32(bw->ptr, bw->buf >> bw->count);
+            bw->ptr += 4;
+        } else {
+            av_log(NULL, AV_LOG_ERROR, "Internal error, put_bits buffer too small\n");
+            av_assert2(0);
+        }
+    }
+}
+
+static av_always_inline void bw_flush(const MJpegBitWriter *bw, PutBitContext *pb)
 {
+    pb->bit_buf  = bw->buf & ((1ULL << bw->count) - 1);
+    pb->bit_left = 32 - bw->count;
+    pb->buf_ptr  = bw->ptr;
+}
+
+static void encode_block(MpegEncContext *s, MJpegBitWriter *bwp,
+                         int16_t *block, int n)
+{
+    /* local copy, so that the writer state is kept in registers */
+    MJpegBitWriter bw_local = *bwp, *bw = &bw_local;
     int mant, nbits, code, i, j;
     int component, dc, run, last_index, val;
     MJpegContext *m = s->mjpeg_ctx;
-    uint8_t *huff_size_ac;
-    uint16_t *huff_code_ac;
+    const uint8_t *huff_size_dc, *huff_size_ac;
+    const uint16_t *huff_code_dc, *huff_code_ac;
 
     /* DC coef */
     component = (n <= 3 ? 0 : (n&1) + 1);
     dc = block[0]; /* overflow is impossible */
     val = dc - s->last_dc[component];
     if (n < 4) {
-        ff_mjpeg_encode_dc(&s->pb, val, m->huff_size_dc_luminance, m->huff_code_dc_luminance);
+        huff_size_dc = m->huff_size_dc_luminance;
+        huff_code_dc = m->huff_code_dc_luminance;
         huff_size_ac = m->huff_size_ac_luminance;
         huff_code_ac = m->huff_code_ac_luminance;
     } else {
-        ff_mjpeg_encode_dc(&s->pb, val, m->huff_size_dc_chrominance, m->huff_code_dc_chrominance);
+        huff_size_dc = m->huff_size_dc_chrominance;
+        huff_code_dc = m->huff_code_dc_chrominance;
         huff_size_ac = m->huff_size_ac_chrominance;
         huff_code_ac = m->huff_code_ac_chrominance;
     }
     s->last_dc[component] = dc;
 
+    if (val == 0) {
+        bw_put(bw, huff_size_dc[0], huff_code_dc[0]);
+    } else {
+        mant = val;
+        if (val < 0) {
+            val = -val;
+            mant--;
+        }
+        nbits = av_log2_16bit(val) + 1;
+        bw_put(bw, huff_size_dc[nbits] + nbits,
+               huff_code_dc[nbits] << nbits | (mant & ((1 << nbits) - 1)));
+    }
+
     /* AC coefs */
 
     run = 0;
@@ -152,7 +217,7 @@ static void encode_block(MpegEncContext *s, int16_t *block, int n)
             run++;
         } else {
             while (run >= 16) {
-                put_bits(&s->pb, huff_size_ac[0xf0], huff_code_ac[0xf0]);
+                bw_put(bw, huff_size_ac[0xf0], huff_code_ac[0xf0]);
                 run -= 16;
             }
             mant = val;
@@ -164,50 +229,57 @@ static void encode_block(MpegEncContext *s, int16_t *block, int n)
             nbits= av_log2_16bit(val) + 1;
             code = (run << 4) | nbits;
 
-            put_bits(&s->pb, huff_size_ac[code], huff_code_ac[code]);
-
-            put_sbits(&s->pb, nbits, mant);
+            bw_put(bw, huff_size_ac[code] + nbits,
+                   huff_code_ac[code] << nbits | (mant & ((1 << nbits) - 1)));
             run = 0;
         }
     }
 
     /* output EOB only if not already 64 values */
     if (last_index < 63 || run != 0)
-        put_bits(&s->pb, huff_size_ac[0], huff_code_ac[0]);
+        bw_put(bw, huff_size_ac[0], huff_code_ac[0]);
+
+    *bwp = bw_local;
 }
 
 void ff_mjpeg_encode_mb(MpegEncContext *s, int16_t block[12][64])
 {
+    MJpegBitWriter bw;
     int i;
+
+    bw_init(&bw, &s->pb);
+
     if (s->chroma_format == CHROMA_444) {
-        encode_block(s, block[0], 0);
-        encode_block(s, block[2], 2);
-        encode_block(s, block[4], 4);
-        encode_block(s, block[8], 8);
-        encode_block(s, block[5], 5);
-        encode_block(s, block[9], 9);
+        encode_block(s, &bw, block[0], 0);
+        encode_block(s, &bw, block[2], 2);
+        encode_block(s, &bw, block[4], 4);
+        encode_block(s, &bw, block[8], 8);
+        encode_block(s, &bw, block[5], 5);
+        encode_block(s, &bw, block[9], 9);
 
         if (16*s->mb_x+8 < s->width) {
-            encode_block(s, block[1], 1);
-            encode_block(s, block[3], 3);
-            encode_block(s, block[6], 6);
-            encode_block(s, block[10], 10);
-            encode_block(s, block[7], 7);
-            encode_block(s, block[11], 11);
+            encode_block(s, &bw, block[1], 1);
+            encode_block(s, &bw, block[3], 3);
+            encode_block(s, &bw, block[6], 6);
+            encode_block(s, &bw, block[10], 10);
+            encode_block(s, &bw, block[7], 7);
+            encode_block(s, &bw, block[11], 11);
         }
     } else {
         for(i=0;i<5;i++) {
-            encode_block(s, block[i], i);
+            encode_block(s, &bw, block[i], i);
         }
         if (s->chroma_format == CHROMA_420) {
-            encode_block(s, block[5], 5);
+            encode_block(s, &bw, block[5], 5);
         } else {
-            encode_block(s, block[6], 6);
-            encode_block(s, block[5], 5);
-            encode_block(s, block[7], 7);
+            encode_block(s, &bw, block[6], 6);
+            encode_block(s, &bw, block[5], 5);
+            encode_block(s, &bw, block[7], 7);
         }
     }
 
+    bw_flush(&bw, &s->pb);
+
     s->i_tex_bits += get_bits_diff(s);
 }
 
@@ -29,11 +29,13 @@
 #include "libavutil/channel_layout.h"
 #include "libavutil/float_dsp.h"
 #include "libavutil/libm.h"
+#include "libavutil/thread.h"
 #include "avcodec.h"
 #include "get_bits.h"
 #include "internal.h"
 #include "mathops.h"
 #include "mpegaudiodsp.h"
+#include "thread.h"
 
 /*
  * TODO:
@@ -78,6 +80,13 @@ typedef struct MPADecodeContext {
     DECLARE_ALIGNED(32, MPA_INT, synth_buf)[MPA_MAX_CHANNELS][512 * 2];
     int synth_buf_offset[MPA_MAX_CHANNELS];
     DECLARE_ALIGNED(32, INTFLOAT, sb_samples)[MPA_MAX_CHANNELS][36][SBLIMIT];
+    /* frame threading: the synthesis filter state only depends on the last
+     * 16 subband sample vectors, which are passed to the next thread to
+     * rebuild it (synth_prime) while this one runs its own filter */
+    DECLARE_ALIGNED(32, INTFLOAT, synth_history)[MPA_MAX_CHANNELS][16][SBLIMIT];
+    DECLARE_ALIGNED(32, INTFLOAT, synth_prime)[MPA_MAX_CHANNELS][16][SBLIMIT];
+    int synth_next_offset[MPA_MAX_CHANNELS];
+    int prime_synth;
     INTFLOAT mdct_buf[MPA_MAX_CHANNELS][SBLIMIT * 18]; /* previous samples, for layer 3 MDCT */
     GranuleDef granules[2][2]; /* Used in Layer 3 */
     int adu_mode; ///< 0 for standard mp3, 1 for adu formatted mp3
@@ -418,13 +427,10 @@ static av_cold int decode_close(AVCodecContext * avctx)
 
 static av_cold int decode_init(AVCodecContext * avctx)
 {
-    static int initialized_tables = 0;
+    static AVOnce init_static_once = AV_ONCE_INIT;
     MPADecodeContext *s = avctx->priv_data;
 
-    if (!initialized_tables) {
-        decode_init_static();
-        initialized_tables = 1;
-    }
+    ff_thread_once(&init_static_once, decode_init_static);
 
     s->avctx = avctx;
 
@@ -1553,6 +1559,37 @@ static int mp_decode_layer3(MPADecodeContext *s)
     return nb_granules * 18;
 }
 
+static void save_synth_history(MPADecodeContext *s, int nb_frames)
+{
+    int ch, keep = FFMAX(16 - nb_frames, 0);
+
+    for (ch = 0; ch < s->nb_channels; ch++) {
+        INTFLOAT (*hist)[SBLIMIT] = s->synth_history[ch];
+
+        memmove(hist, hist + 16 - keep, keep * sizeof(*hist));
+        memcpy(hist + keep, s->sb_samples[ch] + nb_frames - (16 - keep),
+               (16 - keep) * sizeof(*hist));
+        s->synth_next_offset[ch] = (s->synth_buf_offset[ch] - 32 * nb_frames) & 511;
+    }
+}
+
+/* Rebuild the synthesis buffer of the previous frame: the window only reads
+ * the dct32 output of the last 16 vectors and its copy past 512. */
+static void prime_synth_filter(MPADecodeContext *s)
+{
+    int ch, i;
+
+    for (ch = 0; ch < s->nb_channels; ch++) {
+        for (i = 0; i < 16; i++) {
+            MPA_INT *buf = s->synth_buf[ch] +
+                           ((s->synth_buf_offset[ch] - 32 * i) & 511);
+
+            s->mpadsp.RENAME(dct32)(buf, s->synth_prime[ch][i]);
+            memcpy(buf + 512, buf, 32 * sizeof(*buf));
+        }
+    }
+}
+
 static int mp_decode_frame(MPADecodeContext *s, OUT_INT **samples,
                            const uint8_t *buf, int buf_size)
 {
@@ -1611,13 +1648,24 @@ static int mp_decode_frame(MPADecodeContext *s, OUT_INT **samples,
 
     /* get output buffer */
     if (!samples) {
+        ThreadFrame tframe = { .f = s->frame };
         av_assert0(s->frame);
         s->frame->nb_samples = s->avctx->frame_size;
-        if ((ret = ff_get_buffer(s->avctx, s->frame, 0)) < 0)
+        if ((ret = ff_thread_get_buffer(s->avctx, &tframe, 0)) < 0)
             return ret;
         samples = (OUT_INT **)s->frame->extended_data;
     }
 
+    /* everything the next frame depends on is known at this point, the
+     * synthesis filter only needs the state rebuilt from the history */
+    if (s->avctx->active_thread_type & FF_THREAD_FRAME)
+        save_synth_history(s, nb_frames);
+    ff_thread_finish_setup(s->avctx);
+    if (s->prime_synth) {
+        prime_synth_filter(s);
+        s->prime_synth = 0;
+    }
+
     /* apply the synthesis filter */
     for (ch = 0; ch < s->nb_channels; ch++) {
         int sample_stride;
@@ -1715,8 +1763,10 @@ static void mp_flush(MPADecodeContext *ctx)
 {
     memset(ctx->synth_buf, 0, sizeof(ctx->synth_buf));
     memset(ctx->mdct_buf, 0, sizeof(ctx->mdct_buf));
+    memset(ctx->synth_history, 0, sizeof(ctx->synth_history));
     ctx->last_buf_size = 0;
     ctx->dither_state = 0;
+    ctx->prime_synth = 0;
 }
 
 static void flush(AVCodecContext *avctx)
@@ -1724,6 +1774,43 @@ static void flush(AVCodecContext *avctx)
     mp_flush(avctx->priv_data);
 }
 
+#if USE_FLOATS && HAVE_THREADS
+static int init_thread_copy(AVCodecContext *avctx)
+{
+    MPADecodeContext *s = avctx->priv_data;
+
+    s->avctx = avctx;
+    s->fdsp  = avpriv_float_dsp_alloc(avctx->flags & AV_CODEC_FLAG_BITEXACT);
+    if (!s->fdsp)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+static int update_thread_context(AVCodecContext *dst, const AVCodecContext *src)
+{
+    MPADecodeContext *s = dst->priv_data, *s1 = src->priv_data;
+    int ch;
+
+    if (dst == src)
+        return 0;
+
+    memcpy(s->last_buf, s1->last_buf, s1->last_buf_size);
+    s->last_buf_size = s1->last_buf_size;
+    memcpy(s->mdct_buf, s1->mdct_buf, sizeof(s->mdct_buf));
+
+    memcpy(s->synth_history, s1->synth_history, sizeof(s->synth_history));
+    memcpy(s->synth_prime,   s1->synth_history, sizeof(s->synth_prime));
+    for (ch = 0; ch < MPA_MAX_CHANNELS; ch++) {
+        s->synth_buf_offset[ch]  = s1->synth_next_offset[ch];
+        s->synth_next_offset[ch] = s1->synth_next_offset[ch];
+    }
+    s->prime_synth = 1;
+
+    return 0;
+}
+#endif
+
 #if CONFIG_MP3ADU_DECODER || CONFIG_MP3ADUFLOAT_DECODER
 static int decode_frame_adu(AVCodecContext *avctx, void *data,
                             int *got_frame_ptr, AVPacket *avpkt)
@@ -684,6 +684,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     }
 
     if (s->avctx->thread_count > 1         &&
+        !(s->avctx->active_thread_type & FF_THREAD_FRAME) &&
         s->codec_id != AV_CODEC_ID_MPEG4      &&
         s->codec_id != AV_CODEC_ID_MPEG1VIDEO &&
         s->codec_id != AV_CODEC_ID_MPEG2VIDEO &&
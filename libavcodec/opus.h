@@ -152,6 +152,10 @@ typedef struct OpusStreamContext {
 
     OpusPacket packet;
 
+    /* data of the sub-packet to decode from the current packet */
+    const uint8_t *input;
+    int input_size;
+
     int redundancy_idx;
 } OpusStreamContext;
 
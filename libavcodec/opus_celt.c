@@ -31,6 +31,7 @@
 
 #include "imdct15.h"
 #include "opus.h"
+#include "opusdsp.h"
 
 enum CeltSpread {
     CELT_SPREAD_NONE,
@@ -64,6 +65,7 @@ struct CeltContext {
     AVCodecContext    *avctx;
     IMDCT15Context    *imdct[4];
     AVFloatDSPContext  *dsp;
+    OpusDSPContext     opusdsp;
     int output_channels;
 
     // values that have inter-frame effect and must be reset on flush
@@ -1730,36 +1732,13 @@ static void celt_postfilter_apply_transition(CeltFrame *frame, float *data)
     }
 }
 
-static void celt_postfilter_apply(CeltFrame *frame,
+static void celt_postfilter_apply(CeltContext *s, CeltFrame *frame,
                                   float *data, int len)
 {
-    const int T = frame->pf_period;
-    float g0, g1, g2;
-    float x0, x1, x2, x3, x4;
-    int i;
-
     if (frame->pf_gains[0] == 0.0 || len <= 0)
         return;
 
-    g0 = frame->pf_gains[0];
-    g1 = frame->pf_gains[1];
-    g2 = frame->pf_gains[2];
-
-    x4 = data[-T - 2];
-    x3 = data[-T - 1];
-    x2 = data[-T];
-    x1 = data[-T + 1];
-
-    for (i = 0; i < len; i++) {
-        x0 = data[i - T + 2];
-        data[i] += g0 * x2        +
-                   g1 * (x1 + x3) +
-                   g2 * (x0 + x4);
-        x4 = x3;
-        x3 = x2;
-        x2 = x1;
-        x1 = x0;
-    }
+    s->opusdsp.postfilter(data, frame->pf_period, frame->pf_gains, len);
 }
 
 static void celt_postfilter(CeltContext *s, CeltFrame *frame)
@@ -1776,7 +1755,7 @@ static void celt_postfilter(CeltContext *s, CeltFrame *frame)
 
     if (len > CELT_OVERLAP) {
         celt_postfilter_apply_transition(frame, frame->buf + 1024 + CELT_OVERLAP);
-        celt_postfilter_apply(frame, frame->buf + 1024 + 2 * CELT_OVERLAP,
+        celt_postfilter_apply(s, frame, frame->buf + 1024 + 2 * CELT_OVERLAP,
                               len - 2 * CELT_OVERLAP);
 
         frame->pf_period_old = frame->pf_period;
@@ -2216,6 +2195,8 @@ int ff_celt_init(AVCodecContext *avctx, CeltContext **ps, int output_channels)
         goto fail;
     }
 
+    ff_opus_dsp_init(&s->opusdsp);
+
     ff_celt_flush(s);
 
     *ps = s;
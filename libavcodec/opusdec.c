@@ -444,6 +444,20 @@ finish:
     return output_samples;
 }
 
+static int opus_decode_stream(AVCodecContext *avctx, void *arg,
+                              int jobnr, int threadnr)
+{
+    OpusContext *c       = avctx->priv_data;
+    OpusStreamContext *s = &c->streams[jobnr];
+    const int *coded_samples = arg;
+
+    c->decoded_samples[jobnr] = opus_decode_subpacket(s, s->input, s->input_size,
+                                                      c->out + 2 * jobnr,
+                                                      c->out_size[jobnr],
+                                                      *coded_samples);
+    return 0;
+}
+
 static int opus_decode_packet(AVCodecContext *avctx, void *data,
                               int *got_frame_ptr, AVPacket *avpkt)
 {
@@ -529,7 +543,7 @@ static int opus_decode_packet(AVCodecContext *avctx, void *data,
         c->out_size[i] = frame->linesize[0] - ret * sizeof(float);
     }
 
-    /* decode each sub-packet */
+    /* parse the headers of the sub-packets */
     for (i = 0; i < c->nb_streams; i++) {
         OpusStreamContext *s = &c->streams[i];
 
@@ -548,15 +562,23 @@ static int opus_decode_packet(AVCodecContext *avctx, void *data,
             s->silk_samplerate = get_silk_samplerate(s->packet.config);
         }
 
-        ret = opus_decode_subpacket(&c->streams[i], buf, s->packet.data_size,
-                                    c->out + 2 * i, c->out_size[i], coded_samples);
-        if (ret < 0)
-            return ret;
-        c->decoded_samples[i] = ret;
-        decoded_samples       = FFMIN(decoded_samples, ret);
+        s->input      = buf;
+        s->input_size = s->packet.data_size;
 
-        buf      += s->packet.packet_size;
-        buf_size -= s->packet.packet_size;
+        if (buf) {
+            buf      += s->packet.packet_size;
+            buf_size -= s->packet.packet_size;
+        }
+    }
+
+    /* the streams are independent, decode them in parallel */
+    avctx->execute2(avctx, opus_decode_stream, &coded_samples, NULL,
+                    c->nb_streams);
+
+    for (i = 0; i < c->nb_streams; i++) {
+        if (c->decoded_samples[i] < 0)
+            return c->decoded_samples[i];
+        decoded_samples = FFMIN(decoded_samples, c->decoded_samples[i]);
     }
 
     /* buffer the extra samples */
@@ -756,5 +778,6 @@ AVCodec ff_opus_decoder = {
     .close           = opus_decode_close,
     .decode          = opus_decode_packet,
     .flush           = opus_decode_flush,
-    .capabilities    = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY,
+    .capabilities    = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
+                       AV_CODEC_CAP_SLICE_THREADS,
 };
@@ -0,0 +1,36 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_OPUSDSP_H
+#define AVCODEC_OPUSDSP_H
+
+typedef struct OpusDSPContext {
+    /**
+     * Apply the CELT comb postfilter in place.
+     * @param data   samples to filter, preceded by at least period + 2
+     *               samples of history
+     * @param period pitch period, at least CELT_POSTFILTER_MINPERIOD
+     * @param gains  the three filter taps
+     * @param len    number of samples, a multiple of 8
+     */
+    void (*postfilter)(float *data, int period, const float *gains, int len);
+} OpusDSPContext;
+
+void ff_opus_dsp_init(OpusDSPContext *ctx);
+
+#endif /* AVCODEC_OPUSDSP_H */
@@ -37,6 +37,10 @@
 
 #define IOBUF_SIZE 4096
 
+/* like mixed, but choose the filter from an estimate of the cost made on a
+ * subset of the row bytes, and only filter the row once */
+#define PNG_FILTER_VALUE_FAST_MIXED 6
+
 typedef struct APNGFctlChunk {
     uint32_t sequence_number;
     uint32_t width, height;
@@ -45,6 +49,16 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+typedef struct PNGEncSlice {
+    z_stream zstream;       ///< raw deflate stream of the slice
+    uint8_t *crow_base;
+    uint8_t *buf;           ///< compressed data
+    unsigned buf_size;
+    int len;
+    uLong adler;            ///< Adler-32 of the uncompressed data
+    int ret;
+} PNGEncSlice;
+
 typedef struct PNGEncContext {
     AVClass *class;
     HuffYUVEncDSPContext hdsp;
@@ -57,6 +71,9 @@ typedef struct PNGEncContext {
 
     z_stream zstream;
     uint8_t buf[IOBUF_SIZE];
+    int zlib_header;
+    int slices;                  ///< number of row groups deflated independently
+    PNGEncSlice *slice;
     int dpi;                     ///< Physical pixel density, in dots per inch, if set
     int dpm;                     ///< Physical pixel density, in dots per meter, if set
 
@@ -188,6 +205,32 @@ static void png_filter_row(PNGEncContext *c, uint8_t *dst, int filter_type,
     }
 }
 
+static int png_estimate_filter(const uint8_t *src, const uint8_t *top,
+                               int size, int bpp)
+{
+    int cost[5] = { 0 };
+    int i, pred, best = 0;
+
+    /* the step is coprime with all the pixel sizes, so that all the
+     * components are sampled */
+    for (i = bpp; i < size; i += 7) {
+        int x = src[i], a = src[i - bpp], b = top[i], c = top[i - bpp];
+        int p  = a + b - c;
+        int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+        int paeth = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+
+        cost[PNG_FILTER_VALUE_NONE]  += abs((int8_t)x);
+        cost[PNG_FILTER_VALUE_SUB]   += abs((int8_t)(x - a));
+        cost[PNG_FILTER_VALUE_UP]    += abs((int8_t)(x - b));
+        cost[PNG_FILTER_VALUE_AVG]   += abs((int8_t)(x - ((a + b) >> 1)));
+        cost[PNG_FILTER_VALUE_PAETH] += abs((int8_t)(x - paeth));
+    }
+    for (pred = 1; pred < 5; pred++)
+        if (cost[pred] < cost[best])
+            best = pred;
+    return best;
+}
+
 static uint8_t *png_choose_filter(PNGEncContext *s, uint8_t *dst,
                                   uint8_t *src, uint8_t *top, int size, int bpp)
 {
@@ -195,6 +238,8 @@ static uint8_t *png_choose_filter(PNGEncContext *s, uint8_t *dst,
     av_assert0(bpp || !pred);
     if (!top && pred)
         pred = PNG_FILTER_VALUE_SUB;
+    if (pred == PNG_FILTER_VALUE_FAST_MIXED)
+        pred = png_estimate_filter(src, top, size, bpp);
     if (pred == PNG_FILTER_VALUE_MIXED) {
         int i;
         int cost, bcost = INT_MAX;
@@ -286,6 +331,113 @@ static int png_write_row(AVCodecContext *avctx, const uint8_t *data, int size)
     return 0;
 }
 
+static int png_encode_slice(AVCodecContext *avctx, void *arg,
+                            int jobnr, int threadnr)
+{
+    PNGEncContext *s       = avctx->priv_data;
+    const AVFrame *const p = arg;
+    PNGEncSlice *sl        = &s->slice[jobnr];
+    int row_size = (p->width * s->bits_per_pixel + 7) >> 3;
+    int y_start  = p->height *  jobnr      / s->slices;
+    int y_end    = p->height * (jobnr + 1) / s->slices;
+    int last     = jobnr == s->slices - 1;
+    uint8_t *crow_buf = sl->crow_base + 15;
+    uint8_t *ptr, *crow, *top = NULL;
+    unsigned size;
+    int y, ret;
+
+    /* the prediction only depends on the source rows, so the first row of
+     * the slice can use the last one of the previous slice */
+    if (y_start)
+        top = p->data[0] + (y_start - 1) * p->linesize[0];
+
+    /* a sync flush appends an empty stored block to the slice */
+    size = deflateBound(&sl->zstream, (row_size + 1) * (y_end - y_start)) + 16;
+    av_fast_malloc(&sl->buf, &sl->buf_size, size);
+    if (!sl->buf)
+        return sl->ret = AVERROR(ENOMEM);
+    sl->zstream.next_out  = sl->buf;
+    sl->zstream.avail_out = sl->buf_size;
+    sl->adler = adler32(0, NULL, 0);
+
+    for (y = y_start; y < y_end; y++) {
+        ptr  = p->data[0] + y * p->linesize[0];
+        crow = png_choose_filter(s, crow_buf, ptr, top,
+                                 row_size, s->bits_per_pixel >> 3);
+        sl->adler = adler32(sl->adler, crow, row_size + 1);
+        sl->zstream.next_in  = crow;
+        sl->zstream.avail_in = row_size + 1;
+        if (deflate(&sl->zstream, Z_NO_FLUSH) != Z_OK || sl->zstream.avail_in)
+            goto fail;
+        top = ptr;
+    }
+    ret = deflate(&sl->zstream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret != (last ? Z_STREAM_END : Z_OK))
+        goto fail;
+
+    sl->len = sl->buf_size - sl->zstream.avail_out;
+    deflateReset(&sl->zstream);
+    return sl->ret = 0;
+fail:
+    deflateReset(&sl->zstream);
+    return sl->ret = -1;
+}
+
+static void png_write_slice_data(AVCodecContext *avctx, int *pos,
+                                 const uint8_t *data, int len)
+{
+    PNGEncContext *s = avctx->priv_data;
+
+    while (len > 0) {
+        int n = FFMIN(len, IOBUF_SIZE - *pos);
+        memcpy(s->buf + *pos, data, n);
+        *pos += n;
+        data += n;
+        len  -= n;
+        if (*pos == IOBUF_SIZE) {
+            if (s->bytestream_end - s->bytestream > IOBUF_SIZE + 100)
+                png_write_image_data(avctx, s->buf, IOBUF_SIZE);
+            *pos = 0;
+        }
+    }
+}
+
+/**
+ * Compress the rows of a non-interlaced frame as independent raw deflate
+ * streams in parallel and stitch them into a single zlib stream. All the
+ * slices but the last end with a sync flush, so they end on a byte boundary
+ * and the concatenation is a valid deflate stream.
+ */
+static int encode_frame_slices(AVCodecContext *avctx, const AVFrame *pict)
+{
+    PNGEncContext *s = avctx->priv_data;
+    int row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
+    uLong adler  = adler32(0, NULL, 0);
+    uint8_t tmp[4];
+    int i, pos = 0;
+
+    avctx->execute2(avctx, png_encode_slice, (void *)pict, NULL, s->slices);
+
+    AV_WB16(tmp, s->zlib_header);
+    png_write_slice_data(avctx, &pos, tmp, 2);
+    for (i = 0; i < s->slices; i++) {
+        PNGEncSlice *sl = &s->slice[i];
+        int rows = pict->height * (i + 1) / s->slices -
+                   pict->height *  i      / s->slices;
+
+        if (sl->ret < 0)
+            return sl->ret;
+        png_write_slice_data(avctx, &pos, sl->buf, sl->len);
+        adler = adler32_combine(adler, sl->adler, (z_off_t)(row_size + 1) * rows);
+    }
+    AV_WB32(tmp, adler);
+    png_write_slice_data(avctx, &pos, tmp, 4);
+    if (pos > 0 && s->bytestream_end - s->bytestream > pos + 100)
+        png_write_image_data(avctx, s->buf, pos);
+
+    return 0;
+}
+
 #define AV_WB32_PNG(buf, n) AV_WB32(buf, lrint((n) * 100000))
 static int png_get_chrm(enum AVColorPrimaries prim,  uint8_t *buf)
 {
@@ -436,6 +588,9 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
     uint8_t *progressive_buf = NULL;
     uint8_t *top_buf         = NULL;
 
+    if (s->slice && !s->is_progressive)
+        return encode_frame_slices(avctx, pict);
+
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
     crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
@@ -1074,6 +1229,34 @@ FF_ENABLE_DEPRECATION_WARNINGS
     if (deflateInit2(&s->zstream, compression_level, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
         return -1;
 
+    if (!s->slices)
+        s->slices = avctx->active_thread_type & FF_THREAD_SLICE ? avctx->thread_count : 1;
+    s->slices = FFMIN(s->slices, avctx->height);
+    if (s->slices > 1 && !s->is_progressive) {
+        int row_size = (avctx->width * s->bits_per_pixel + 7) >> 3;
+        int level    = compression_level == Z_DEFAULT_COMPRESSION ? 6 : compression_level;
+        int i;
+
+        /* the zlib stream header, as written by deflate() */
+        s->zlib_header  = 0x7800 | (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+        s->zlib_header += 31 - s->zlib_header % 31;
+
+        s->slice = av_mallocz_array(s->slices, sizeof(*s->slice));
+        if (!s->slice)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < s->slices; i++) {
+            PNGEncSlice *sl = &s->slice[i];
+            sl->crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+            if (!sl->crow_base)
+                return AVERROR(ENOMEM);
+            sl->zstream.zalloc = ff_png_zalloc;
+            sl->zstream.zfree  = ff_png_zfree;
+            sl->zstream.opaque = NULL;
+            if (deflateInit2(&sl->zstream, compression_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                return -1;
+        }
+    }
+
     return 0;
 }
 
@@ -1082,6 +1265,15 @@ static av_cold int png_enc_close(AVCodecContext *avctx)
     PNGEncContext *s = avctx->priv_data;
 
     deflateEnd(&s->zstream);
+    if (s->slice) {
+        int i;
+        for (i = 0; i < s->slices; i++) {
+            deflateEnd(&s->slice[i].zstream);
+            av_freep(&s->slice[i].crow_base);
+            av_freep(&s->slice[i].buf);
+        }
+        av_freep(&s->slice);
+    }
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1093,13 +1285,15 @@ static av_cold int png_enc_close(AVCodecContext *avctx)
 static const AVOption options[] = {
     {"dpi", "Set image resolution (in dots per inch)",  OFFSET(dpi), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 0x10000, VE},
     {"dpm", "Set image resolution (in dots per meter)", OFFSET(dpm), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 0x10000, VE},
-    { "pred", "Prediction method", OFFSET(filter_type), AV_OPT_TYPE_INT, { .i64 = PNG_FILTER_VALUE_NONE }, PNG_FILTER_VALUE_NONE, PNG_FILTER_VALUE_MIXED, VE, "pred" },
+    { "pred", "Prediction method", OFFSET(filter_type), AV_OPT_TYPE_INT, { .i64 = PNG_FILTER_VALUE_NONE }, PNG_FILTER_VALUE_NONE, PNG_FILTER_VALUE_FAST_MIXED, VE, "pred" },
         { "none",  NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_NONE },  INT_MIN, INT_MAX, VE, "pred" },
         { "sub",   NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_SUB },   INT_MIN, INT_MAX, VE, "pred" },
         { "up",    NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_UP },    INT_MIN, INT_MAX, VE, "pred" },
         { "avg",   NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_AVG },   INT_MIN, INT_MAX, VE, "pred" },
         { "paeth", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_PAETH }, INT_MIN, INT_MAX, VE, "pred" },
         { "mixed", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_MIXED }, INT_MIN, INT_MAX, VE, "pred" },
+        { "fast_mixed", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_FAST_MIXED }, INT_MIN, INT_MAX, VE, "pred" },
+    { "slices", "Number of row groups deflated independently, 0 for one per slice thread", OFFSET(slices), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VE },
     { NULL},
 };
 
@@ -1126,7 +1320,8 @@ AVCodec ff_png_encoder = {
     .init           = png_enc_init,
     .close          = png_enc_close,
     .encode2        = encode_png,
-    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_INTRA_ONLY,
+    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS |
+                      AV_CODEC_CAP_INTRA_ONLY,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA,
         AV_PIX_FMT_RGB48BE, AV_PIX_FMT_RGBA64BE,
@@ -56,6 +56,11 @@ enum {
     QUANT_MAT_DEFAULT,
 };
 
+enum {
+    QUANT_SEARCH_FULL = 0,
+    QUANT_SEARCH_FAST,
+};
+
 static const uint8_t prores_quant_matrices[][64] = {
     { // proxy
          4,  7,  9, 11, 13, 14, 15, 63,
@@ -210,6 +215,7 @@ typedef struct ProresContext {
     int num_planes;
     int bits_per_mb;
     int force_quant;
+    int quant_search;
     int alpha_bits;
     int warn;
 
@@ -746,6 +752,35 @@ static int estimate_alpha_plane(ProresContext *ctx, int *error,
     return bits;
 }
 
+static int estimate_slice(ProresContext *ctx, int *error, int q,
+                          const uint16_t *src, const int *linesize,
+                          int mbs_per_slice, const int *num_cblocks,
+                          const int *plane_factor, ProresThreadData *td)
+{
+    int16_t *qmat;
+    int i, bits = 0;
+
+    if (q < MAX_STORED_Q) {
+        qmat = ctx->quants[q];
+    } else {
+        qmat = td->custom_q;
+        for (i = 0; i < 64; i++)
+            qmat[i] = ctx->quant_mat[i] * q;
+    }
+    *error = 0;
+    for (i = 0; i < ctx->num_planes - !!ctx->alpha_bits; i++) {
+        bits += estimate_slice_plane(ctx, error, i,
+                                     src, linesize[i],
+                                     mbs_per_slice,
+                                     num_cblocks[i], plane_factor[i],
+                                     qmat, td);
+    }
+    if (ctx->alpha_bits)
+        bits += estimate_alpha_plane(ctx, error, src, linesize[3],
+                                     mbs_per_slice, q, td->blocks[3]);
+    return bits;
+}
+
 static int find_slice_quant(AVCodecContext *avctx,
                             int trellis_node, int x, int y, int mbs_per_slice,
                             ProresThreadData *td)
@@ -762,7 +797,6 @@ static int find_slice_quant(AVCodecContext *avctx,
     int mbs, prev, cur, new_score;
     int slice_bits[TRELLIS_WIDTH], slice_score[TRELLIS_WIDTH];
     int overquant;
-    uint16_t *qmat;
     int linesize[4], line_add;
 
     if (ctx->pictures_per_frame == 1)
@@ -811,49 +845,64 @@ static int find_slice_quant(AVCodecContext *avctx,
 
     // todo: maybe perform coarser quantising to fit into frame size when needed
     for (q = min_quant; q <= max_quant; q++) {
-        bits  = 0;
-        error = 0;
-        for (i = 0; i < ctx->num_planes - !!ctx->alpha_bits; i++) {
-            bits += estimate_slice_plane(ctx, &error, i,
-                                         src, linesize[i],
-                                         mbs_per_slice,
-                                         num_cblocks[i], plane_factor[i],
-                                         ctx->quants[q], td);
-        }
-        if (ctx->alpha_bits)
-            bits += estimate_alpha_plane(ctx, &error, src, linesize[3],
-                                         mbs_per_slice, q, td->blocks[3]);
+        /* the fast search only estimates every other quantiser and
+         * interpolates the bits and distortion of the ones in between */
+        if (ctx->quant_search == QUANT_SEARCH_FAST &&
+            ((q - min_quant) & 1) && q < max_quant)
+            continue;
+        bits = estimate_slice(ctx, &error, q, src, linesize, mbs_per_slice,
+                              num_cblocks, plane_factor, td);
         if (bits > 65000 * 8)
             error = SCORE_LIMIT;
 
         slice_bits[q]  = bits;
         slice_score[q] = error;
     }
+    if (ctx->quant_search == QUANT_SEARCH_FAST) {
+        for (q = min_quant + 1; q < max_quant; q += 2) {
+            if (slice_score[q - 1] < SCORE_LIMIT && slice_score[q + 1] < SCORE_LIMIT) {
+                slice_bits[q]  = (slice_bits[q - 1]  + slice_bits[q + 1]  + 1) >> 1;
+                slice_score[q] = (slice_score[q - 1] + slice_score[q + 1] + 1) >> 1;
+            } else {
+                slice_bits[q]  = estimate_slice(ctx, &slice_score[q], q, src,
+                                                linesize, mbs_per_slice,
+                                                num_cblocks, plane_factor, td);
+                if (slice_bits[q] > 65000 * 8)
+                    slice_score[q] = SCORE_LIMIT;
+            }
+        }
+    }
     if (slice_bits[max_quant] <= ctx->bits_per_mb * mbs_per_slice) {
         slice_bits[max_quant + 1]  = slice_bits[max_quant];
         slice_score[max_quant + 1] = slice_score[max_quant] + 1;
         overquant = max_quant;
-    } else {
-        for (q = max_quant + 1; q < 128; q++) {
-            bits  = 0;
-            error = 0;
-            if (q < MAX_STORED_Q) {
-                qmat = ctx->quants[q];
+    } else if (ctx->quant_search == QUANT_SEARCH_FAST) {
+        /* the size decreases with the quantiser, so bisect for the finest
+         * one which fits */
+        int lo = max_quant + 1, hi = 127, best_error = 0;
+        int best_bits = estimate_slice(ctx, &best_error, hi, src, linesize,
+                                       mbs_per_slice, num_cblocks,
+                                       plane_factor, td);
+        while (lo < hi) {
+            q    = (lo + hi) >> 1;
+            bits = estimate_slice(ctx, &error, q, src, linesize,
+                                  mbs_per_slice, num_cblocks, plane_factor, td);
+            if (bits <= ctx->bits_per_mb * mbs_per_slice) {
+                hi         = q;
+                best_bits  = bits;
+                best_error = error;
             } else {
-                qmat = td->custom_q;
-                for (i = 0; i < 64; i++)
-                    qmat[i] = ctx->quant_mat[i] * q;
-            }
-            for (i = 0; i < ctx->num_planes - !!ctx->alpha_bits; i++) {
-                bits += estimate_slice_plane(ctx, &error, i,
-                                             src, linesize[i],
-                                             mbs_per_slice,
-                                             num_cblocks[i], plane_factor[i],
-                                             qmat, td);
+                lo = q + 1;
             }
-            if (ctx->alpha_bits)
-                bits += estimate_alpha_plane(ctx, &error, src, linesize[3],
-                                             mbs_per_slice, q, td->blocks[3]);
+        }
+
+        slice_bits[max_quant + 1]  = best_bits;
+        slice_score[max_quant + 1] = best_error;
+        overquant = hi;
+    } else {
+        for (q = max_quant + 1; q < 128; q++) {
+            bits = estimate_slice(ctx, &error, q, src, linesize, mbs_per_slice,
+                                  num_cblocks, plane_factor, td);
             if (bits <= ctx->bits_per_mb * mbs_per_slice)
                 break;
         }
@@ -1328,6 +1377,12 @@ static const AVOption options[] = {
         0, 0, VE, "quant_mat" },
     { "alpha_bits", "bits for alpha plane", OFFSET(alpha_bits), AV_OPT_TYPE_INT,
         { .i64 = 16 }, 0, 16, VE },
+    { "quant_search", "slice quantiser search", OFFSET(quant_search), AV_OPT_TYPE_INT,
+        { .i64 = QUANT_SEARCH_FULL }, QUANT_SEARCH_FULL, QUANT_SEARCH_FAST, VE, "quant_search" },
+    { "full",          NULL, 0, AV_OPT_TYPE_CONST, { .i64 = QUANT_SEARCH_FULL },
+        0, 0, VE, "quant_search" },
+    { "fast",          NULL, 0, AV_OPT_TYPE_CONST, { .i64 = QUANT_SEARCH_FAST },
+        0, 0, VE, "quant_search" },
     { NULL }
 };
 
@@ -29,6 +29,8 @@
  * @see doc/multithreading.txt
  */
 
+#include "libavutil/cpu.h"
+
 #include "avcodec.h"
 #include "internal.h"
 #include "pthread_internal.h"
@@ -67,8 +69,31 @@ static void validate_thread_parameters(AVCodecContext *avctx)
                avctx->thread_count, MAX_AUTO_THREADS);
 }
 
+int ff_thread_cpu_count(AVCodecContext *avctx)
+{
+    if (avctx->thread_affinity) {
+        int nb_cpus = av_cpu_affinity_count(avctx->thread_affinity);
+        if (nb_cpus > 0)
+            return nb_cpus;
+    }
+    return av_cpu_count();
+}
+
+void ff_thread_set_affinity(AVCodecContext *avctx)
+{
+    if (avctx->thread_affinity)
+        av_cpu_set_thread_affinity(avctx->thread_affinity);
+}
+
 int ff_thread_init(AVCodecContext *avctx)
 {
+    if (avctx->thread_affinity &&
+        av_cpu_affinity_count(avctx->thread_affinity) < 0) {
+        av_log(avctx, AV_LOG_ERROR, "Invalid thread affinity '%s'\n",
+               avctx->thread_affinity);
+        return AVERROR(EINVAL);
+    }
+
     validate_thread_parameters(avctx);
 
     if (avctx->active_thread_type&FF_THREAD_SLICE)
@@ -103,6 +103,7 @@ typedef struct PerThreadContext {
 typedef struct FrameThreadContext {
     PerThreadContext *threads;     ///< The contexts for each thread.
     PerThreadContext *prev_thread; ///< The last thread submit_packet() was called on.
+    AVCodecContext   *owner;       ///< The client context, for the memory accounting.
 
     pthread_mutex_t buffer_mutex;  ///< Mutex used to protect get/release_buffer().
 
@@ -131,6 +132,9 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
     AVCodecContext *avctx = p->avctx;
     const AVCodec *codec = avctx->codec;
 
+    ff_thread_set_affinity(avctx);
+    av_mem_set_context(p->parent->owner);
+
     pthread_mutex_lock(&p->mutex);
     while (1) {
             while (p->state == STATE_INPUT_READY && !p->die)
@@ -614,7 +618,7 @@ int ff_frame_thread_init(AVCodecContext *avctx)
 #endif
 
     if (!thread_count) {
-        int nb_cpus = av_cpu_count();
+        int nb_cpus = ff_thread_cpu_count(avctx);
         if ((avctx->debug & (FF_DEBUG_VIS_QP | FF_DEBUG_VIS_MB_TYPE)) || avctx->debug_mv)
             nb_cpus = 1;
         // use number of cores + 1 as thread count if there is more than one
@@ -641,6 +645,7 @@ int ff_frame_thread_init(AVCodecContext *avctx)
 
     pthread_mutex_init(&fctx->buffer_mutex, NULL);
     fctx->delaying = 1;
+    fctx->owner    = avctx;
 
     for (i = 0; i < thread_count; i++) {
         AVCodecContext *copy = av_malloc(sizeof(AVCodecContext));
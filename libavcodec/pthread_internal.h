@@ -31,4 +31,16 @@ void ff_slice_thread_free(AVCodecContext *avctx);
 int ff_frame_thread_init(AVCodecContext *avctx);
 void ff_frame_thread_free(AVCodecContext *avctx, int thread_count);
 
+/**
+ * Get the number of CPUs the threads of the codec may run on, for the
+ * automatic thread count.
+ */
+int ff_thread_cpu_count(AVCodecContext *avctx);
+
+/**
+ * Restrict the calling thread to AVCodecContext.thread_affinity, if set.
+ * Called by the worker threads when they start.
+ */
+void ff_thread_set_affinity(AVCodecContext *avctx);
+
 #endif // AVCODEC_PTHREAD_INTERNAL_H
@@ -32,6 +32,7 @@
 #include "libavutil/avassert.h"
 #include "libavutil/common.h"
 #include "libavutil/cpu.h"
+#include "libavutil/executor.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 
@@ -57,6 +58,7 @@ typedef struct SliceThreadContext {
     int *entries;
     int entries_count;
     int thread_count;
+    int nb_workers;
     pthread_cond_t *progress_cond;
     pthread_mutex_t *progress_mutex;
 } SliceThreadContext;
@@ -64,12 +66,15 @@ typedef struct SliceThreadContext {
 static void* attribute_align_arg worker(void *v)
 {
     AVCodecContext *avctx = v;
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     unsigned last_execute = 0;
     int our_job = c->job_count;
-    int thread_count = avctx->thread_count;
+    int thread_count = c->thread_count;
     int self_id;
 
+    ff_thread_set_affinity(avctx);
+    av_mem_set_context(avctx);
+
     pthread_mutex_lock(&c->current_job_lock);
     self_id = c->current_job++;
     for (;;){
@@ -102,23 +107,25 @@ static void* attribute_align_arg worker(void *v)
 
 void ff_slice_thread_free(AVCodecContext *avctx)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     int i;
 
     pthread_mutex_lock(&c->current_job_lock);
     c->done = 1;
     pthread_cond_broadcast(&c->current_job_cond);
-    for (i = 0; i < c->thread_count; i++)
-        pthread_cond_broadcast(&c->progress_cond[i]);
+    if (c->progress_cond)
+        for (i = 0; i < c->thread_count; i++)
+            pthread_cond_broadcast(&c->progress_cond[i]);
     pthread_mutex_unlock(&c->current_job_lock);
 
-    for (i=0; i<avctx->thread_count; i++)
+    for (i = 0; i < c->nb_workers; i++)
          pthread_join(c->workers[i], NULL);
 
-    for (i = 0; i < c->thread_count; i++) {
-        pthread_mutex_destroy(&c->progress_mutex[i]);
-        pthread_cond_destroy(&c->progress_cond[i]);
-    }
+    if (c->progress_mutex)
+        for (i = 0; i < c->thread_count; i++) {
+            pthread_mutex_destroy(&c->progress_mutex[i]);
+            pthread_cond_destroy(&c->progress_cond[i]);
+        }
 
     pthread_mutex_destroy(&c->current_job_lock);
     pthread_cond_destroy(&c->current_job_cond);
@@ -129,7 +136,7 @@ void ff_slice_thread_free(AVCodecContext *avctx)
     av_freep(&c->progress_cond);
 
     av_freep(&c->workers);
-    av_freep(&avctx->internal->thread_ctx);
+    av_freep(&avctx->internal->slice_thread_ctx);
 }
 
 static av_always_inline void thread_park_workers(SliceThreadContext *c, int thread_count)
@@ -141,9 +148,9 @@ static av_always_inline void thread_park_workers(SliceThreadContext *c, int thre
 
 static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
 
-    if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
+    if (!c || c->thread_count <= 1)
         return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
 
     if (job_count <= 0)
@@ -151,7 +158,7 @@ static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, i
 
     pthread_mutex_lock(&c->current_job_lock);
 
-    c->current_job = avctx->thread_count;
+    c->current_job = c->thread_count;
     c->job_count = job_count;
     c->job_size = job_size;
     c->args = arg;
@@ -164,49 +171,54 @@ static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, i
     c->current_execute++;
     pthread_cond_broadcast(&c->current_job_cond);
 
-    thread_park_workers(c, avctx->thread_count);
+    thread_park_workers(c, c->thread_count);
 
     return 0;
 }
 
 static int thread_execute2(AVCodecContext *avctx, action_func2* func2, void *arg, int *ret, int job_count)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     c->func2 = func2;
     return thread_execute(avctx, NULL, arg, ret, job_count, 0);
 }
 
-int ff_slice_thread_init(AVCodecContext *avctx)
+static int executor_job(void *arg, int jobnr, int threadnr)
 {
-    int i;
-    SliceThreadContext *c;
-    int thread_count = avctx->thread_count;
-
-#if HAVE_W32THREADS
-    w32thread_init();
-#endif
+    AVCodecContext *avctx = arg;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
 
-    // We cannot do this in the encoder init as the threads are created before
-    if (av_codec_is_encoder(avctx->codec) &&
-        avctx->codec_id == AV_CODEC_ID_MPEG1VIDEO &&
-        avctx->height > 2800)
-        thread_count = avctx->thread_count = 1;
+    return c->func ? c->func(avctx, (char*)c->args + jobnr*c->job_size):
+                     c->func2(avctx, c->args, jobnr, threadnr);
+}
 
-    if (!thread_count) {
-        int nb_cpus = av_cpu_count();
-        if  (avctx->height)
-            nb_cpus = FFMIN(nb_cpus, (avctx->height+15)/16);
-        // use number of cores + 1 as thread count if there is more than one
-        if (nb_cpus > 1)
-            thread_count = avctx->thread_count = FFMIN(nb_cpus + 1, MAX_AUTO_THREADS);
-        else
-            thread_count = avctx->thread_count = 1;
-    }
+static int executor_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
+{
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
 
-    if (thread_count <= 1) {
-        avctx->active_thread_type = 0;
+    if (job_count <= 0)
         return 0;
-    }
+
+    c->func     = func;
+    c->args     = arg;
+    c->job_size = job_size;
+    /* threadnr stays below thread_count, which the codec sized its per
+     * thread data and the progress arrays for */
+    return av_executor_execute(avctx->executor, executor_job, avctx, ret,
+                               job_count, c->thread_count);
+}
+
+static int executor_execute2(AVCodecContext *avctx, action_func2* func2, void *arg, int *ret, int job_count)
+{
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
+    c->func2 = func2;
+    return executor_execute(avctx, NULL, arg, ret, job_count, 0);
+}
+
+static int slice_thread_init(AVCodecContext *avctx, int thread_count)
+{
+    int i;
+    SliceThreadContext *c;
 
     c = av_mallocz(sizeof(SliceThreadContext));
     if (!c)
@@ -218,22 +230,31 @@ int ff_slice_thread_init(AVCodecContext *avctx)
         return -1;
     }
 
-    avctx->internal->thread_ctx = c;
+    avctx->internal->slice_thread_ctx = c;
     c->current_job = 0;
     c->job_count = 0;
     c->job_size = 0;
     c->done = 0;
+    c->thread_count = thread_count;
     pthread_cond_init(&c->current_job_cond, NULL);
     pthread_cond_init(&c->last_job_cond, NULL);
     pthread_mutex_init(&c->current_job_lock, NULL);
+
+    if (avctx->executor) {
+        avctx->execute  = executor_execute;
+        avctx->execute2 = executor_execute2;
+        return 0;
+    }
+
     pthread_mutex_lock(&c->current_job_lock);
     for (i=0; i<thread_count; i++) {
         if(pthread_create(&c->workers[i], NULL, worker, avctx)) {
-           avctx->thread_count = i;
+           c->nb_workers = c->thread_count = i;
            pthread_mutex_unlock(&c->current_job_lock);
-           ff_thread_free(avctx);
+           ff_slice_thread_free(avctx);
            return -1;
         }
+        c->nb_workers++;
     }
 
     thread_park_workers(c, thread_count);
@@ -243,9 +264,48 @@ int ff_slice_thread_init(AVCodecContext *avctx)
     return 0;
 }
 
+int ff_slice_thread_init(AVCodecContext *avctx)
+{
+    int thread_count = avctx->thread_count;
+
+#if HAVE_W32THREADS
+    w32thread_init();
+#endif
+
+    // We cannot do this in the encoder init as the threads are created before
+    if (av_codec_is_encoder(avctx->codec) &&
+        avctx->codec_id == AV_CODEC_ID_MPEG1VIDEO &&
+        avctx->height > 2800)
+        thread_count = avctx->thread_count = 1;
+
+    if (!thread_count && avctx->executor) {
+        // the executor threads and the calling thread
+        int nb_threads = av_executor_get_nb_threads(avctx->executor) + 1;
+        if  (avctx->height)
+            nb_threads = FFMIN(nb_threads, (avctx->height+15)/16);
+        thread_count = avctx->thread_count = FFMIN(nb_threads, MAX_AUTO_THREADS);
+    } else if (!thread_count) {
+        int nb_cpus = ff_thread_cpu_count(avctx);
+        if  (avctx->height)
+            nb_cpus = FFMIN(nb_cpus, (avctx->height+15)/16);
+        // use number of cores + 1 as thread count if there is more than one
+        if (nb_cpus > 1)
+            thread_count = avctx->thread_count = FFMIN(nb_cpus + 1, MAX_AUTO_THREADS);
+        else
+            thread_count = avctx->thread_count = 1;
+    }
+
+    if (thread_count <= 1) {
+        avctx->active_thread_type = 0;
+        return 0;
+    }
+
+    return slice_thread_init(avctx, thread_count);
+}
+
 void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, int n)
 {
-    SliceThreadContext *p = avctx->internal->thread_ctx;
+    SliceThreadContext *p = avctx->internal->slice_thread_ctx;
     int *entries = p->entries;
 
     pthread_mutex_lock(&p->progress_mutex[thread]);
@@ -256,7 +316,7 @@ void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, in
 
 void ff_thread_await_progress2(AVCodecContext *avctx, int field, int thread, int shift)
 {
-    SliceThreadContext *p  = avctx->internal->thread_ctx;
+    SliceThreadContext *p  = avctx->internal->slice_thread_ctx;
     int *entries      = p->entries;
 
     if (!entries || !field) return;
@@ -274,15 +334,10 @@ int ff_alloc_entries(AVCodecContext *avctx, int count)
 {
     int i;
 
-    if (avctx->active_thread_type & FF_THREAD_SLICE)  {
-        SliceThreadContext *p = avctx->internal->thread_ctx;
-
-        if (p->entries) {
-            av_assert0(p->thread_count == avctx->thread_count);
-            av_freep(&p->entries);
-        }
+    if (avctx->internal->slice_thread_ctx) {
+        SliceThreadContext *p = avctx->internal->slice_thread_ctx;
 
-        p->thread_count  = avctx->thread_count;
+        av_freep(&p->entries);
         p->entries       = av_mallocz_array(count, sizeof(int));
 
         if (!p->progress_mutex) {
@@ -309,6 +364,6 @@ int ff_alloc_entries(AVCodecContext *avctx, int count)
 
 void ff_reset_entries(AVCodecContext *avctx)
 {
-    SliceThreadContext *p = avctx->internal->thread_ctx;
+    SliceThreadContext *p = avctx->internal->slice_thread_ctx;
     memset(p->entries, 0, p->entries_count * sizeof(int));
 }
@@ -25,6 +25,8 @@
  * @author Michael Niedermayer <michaelni@gmx.at>
  */
 
+#include "libavutil/attributes.h"
+
 #include "startcode.h"
 #include "config.h"
 
@@ -55,3 +57,8 @@ int ff_startcode_find_candidate_c(const uint8_t *buf, int size)
             break;
     return i;
 }
+
+av_cold void ff_startcode_init(StartcodeContext *c)
+{
+    c->find_candidate = ff_startcode_find_candidate_c;
+}
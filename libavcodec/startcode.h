@@ -27,6 +27,25 @@
 
 #include <stdint.h>
 
+typedef struct StartcodeContext {
+    /**
+     * Search buf for the first byte that may begin a start code.
+     *
+     * @param buf  the buffer to search, followed by at least
+     *             AV_INPUT_BUFFER_PADDING_SIZE readable bytes
+     * @param size the number of bytes to search
+     * @return the index of the first zero byte in buf, or a value >= size
+     *         if there is none
+     */
+    int (*find_candidate)(const uint8_t *buf, int size);
+} StartcodeContext;
+
 int ff_startcode_find_candidate_c(const uint8_t *buf, int size);
 
+/**
+ * Initialize the start code search functions for the callers without a
+ * DSP context of their own.
+ */
+void ff_startcode_init(StartcodeContext *c);
+
 #endif /* AVCODEC_STARTCODE_H */
@@ -49,6 +49,15 @@ static void v210_planar_unpack_c(const uint32_t *src, uint16_t *y, uint16_t *u,
     }
 }
 
+av_cold void ff_v210dec_init(V210DecContext *s)
+{
+    s->unpack_frame  = v210_planar_unpack_c;
+    s->sample_factor = 1;
+
+    if (HAVE_MMX)
+        ff_v210_x86_init(s);
+}
+
 static av_cold int decode_init(AVCodecContext *avctx)
 {
     V210DecContext *s = avctx->priv_data;
@@ -56,10 +65,68 @@ static av_cold int decode_init(AVCodecContext *avctx)
     avctx->pix_fmt             = AV_PIX_FMT_YUV422P10;
     avctx->bits_per_raw_sample = 10;
 
-    s->unpack_frame            = v210_planar_unpack_c;
+    ff_v210dec_init(s);
 
-    if (HAVE_MMX)
-        ff_v210_x86_init(s);
+    return 0;
+}
+
+typedef struct ThreadData {
+    AVFrame *frame;
+    const uint8_t *buf;
+    int stride;
+    int nb_jobs;
+} ThreadData;
+
+static int v210_decode_slice(AVCodecContext *avctx, void *arg,
+                             int jobnr, int threadnr)
+{
+    V210DecContext *s = avctx->priv_data;
+    ThreadData *td    = arg;
+    AVFrame *pic      = td->frame;
+    int start         = (avctx->height *  jobnr)      / td->nb_jobs;
+    int end           = (avctx->height * (jobnr + 1)) / td->nb_jobs;
+    const int sample_size = 6 * s->sample_factor;
+    const uint8_t *psrc   = td->buf + start * td->stride;
+    int h, w;
+
+    for (h = start; h < end; h++) {
+        const uint32_t *src = (const uint32_t*)psrc;
+        uint16_t *y = (uint16_t*)(pic->data[0] + h * pic->linesize[0]);
+        uint16_t *u = (uint16_t*)(pic->data[1] + h * pic->linesize[1]);
+        uint16_t *v = (uint16_t*)(pic->data[2] + h * pic->linesize[2]);
+        uint32_t val;
+
+        w = (avctx->width / sample_size) * sample_size;
+        s->unpack_frame(src, y, u, v, w);
+
+        y += w;
+        u += w >> 1;
+        v += w >> 1;
+        src += (w << 1) / 3;
+
+        for (; w < avctx->width - 5; w += 6) {
+            READ_PIXELS(u, y, v);
+            READ_PIXELS(y, u, y);
+            READ_PIXELS(v, y, u);
+            READ_PIXELS(y, v, y);
+        }
+        if (w < avctx->width - 1) {
+            READ_PIXELS(u, y, v);
+
+            val  = av_le2ne32(*src++);
+            *y++ =  val & 0x3FF;
+            if (w < avctx->width - 3) {
+                *u++ = (val >> 10) & 0x3FF;
+                *y++ = (val >> 20) & 0x3FF;
+
+                val  = av_le2ne32(*src++);
+                *v++ =  val & 0x3FF;
+                *y++ = (val >> 10) & 0x3FF;
+            }
+        }
+
+        psrc += td->stride;
+    }
 
     return 0;
 }
@@ -69,10 +136,10 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
 {
     V210DecContext *s = avctx->priv_data;
 
-    int h, w, ret, stride, aligned_input;
+    ThreadData td;
+    int ret, stride, aligned_input;
     AVFrame *pic = data;
     const uint8_t *psrc = avpkt->data;
-    uint16_t *y, *u, *v;
 
     if (s->custom_stride )
         stride = s->custom_stride;
@@ -96,51 +163,20 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
     aligned_input = !((uintptr_t)psrc & 0xf) && !(stride & 0xf);
     if (aligned_input != s->aligned_input) {
         s->aligned_input = aligned_input;
-        if (HAVE_MMX)
-            ff_v210_x86_init(s);
+        ff_v210dec_init(s);
     }
 
     if ((ret = ff_get_buffer(avctx, pic, 0)) < 0)
         return ret;
 
-    y = (uint16_t*)pic->data[0];
-    u = (uint16_t*)pic->data[1];
-    v = (uint16_t*)pic->data[2];
     pic->pict_type = AV_PICTURE_TYPE_I;
     pic->key_frame = 1;
 
-    for (h = 0; h < avctx->height; h++) {
-        const uint32_t *src = (const uint32_t*)psrc;
-        uint32_t val;
-
-        w = (avctx->width / 6) * 6;
-        s->unpack_frame(src, y, u, v, w);
-
-        y += w;
-        u += w >> 1;
-        v += w >> 1;
-        src += (w << 1) / 3;
-
-        if (w < avctx->width - 1) {
-            READ_PIXELS(u, y, v);
-
-            val  = av_le2ne32(*src++);
-            *y++ =  val & 0x3FF;
-            if (w < avctx->width - 3) {
-                *u++ = (val >> 10) & 0x3FF;
-                *y++ = (val >> 20) & 0x3FF;
-
-                val  = av_le2ne32(*src++);
-                *v++ =  val & 0x3FF;
-                *y++ = (val >> 10) & 0x3FF;
-            }
-        }
-
-        psrc += stride;
-        y += pic->linesize[0] / 2 - avctx->width + (avctx->width & 1);
-        u += pic->linesize[1] / 2 - avctx->width / 2;
-        v += pic->linesize[2] / 2 - avctx->width / 2;
-    }
+    td.frame  = pic;
+    td.buf    = psrc;
+    td.stride  = stride;
+    td.nb_jobs = av_clip(avctx->thread_count, 1, avctx->height);
+    avctx->execute2(avctx, v210_decode_slice, &td, NULL, td.nb_jobs);
 
     if (avctx->field_order > AV_FIELD_PROGRESSIVE) {
         /* we have interlaced material flagged in container */
@@ -176,6 +212,6 @@ AVCodec ff_v210_decoder = {
     .priv_data_size = sizeof(V210DecContext),
     .init           = decode_init,
     .decode         = decode_frame,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .priv_class     = &v210dec_class,
 };
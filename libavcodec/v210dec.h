@@ -29,8 +29,16 @@ typedef struct {
     int aligned_input;
     int stride_warning_shown;
     void (*unpack_frame)(const uint32_t *src, uint16_t *y, uint16_t *u, uint16_t *v, int width);
+    int sample_factor;
 } V210DecContext;
 
+/**
+ * Set the unpack function for the current aligned_input value.
+ * unpack_frame() must be called with a width that is a multiple of
+ * 6 * sample_factor.
+ */
+void ff_v210dec_init(V210DecContext *s);
+
 void ff_v210_x86_init(V210DecContext *s);
 
 #endif /* AVCODEC_V210DEC_H */
@@ -113,32 +113,33 @@ FF_ENABLE_DEPRECATION_WARNINGS
     return 0;
 }
 
-static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
-                        const AVFrame *pic, int *got_packet)
+typedef struct ThreadData {
+    const AVFrame *frame;
+    uint8_t *buf;
+    int stride;
+    int nb_jobs;
+} ThreadData;
+
+static int v210_encode_slice(AVCodecContext *avctx, void *arg,
+                             int jobnr, int threadnr)
 {
     V210EncContext *s = avctx->priv_data;
-    int aligned_width = ((avctx->width + 47) / 48) * 48;
-    int stride = aligned_width * 8 / 3;
-    int line_padding = stride - ((avctx->width * 8 + 11) / 12) * 4;
-    int h, w, ret;
-    uint8_t *dst;
-
-    ret = ff_alloc_packet2(avctx, pkt, avctx->height * stride, avctx->height * stride);
-    if (ret < 0) {
-        av_log(avctx, AV_LOG_ERROR, "Error getting output packet.\n");
-        return ret;
-    }
-    dst = pkt->data;
+    ThreadData *td    = arg;
+    const AVFrame *pic = td->frame;
+    int start         = (avctx->height *  jobnr)      / td->nb_jobs;
+    int end           = (avctx->height * (jobnr + 1)) / td->nb_jobs;
+    int line_padding  = td->stride - ((avctx->width * 8 + 11) / 12) * 4;
+    uint8_t *dst      = td->buf + start * td->stride;
+    int h, w;
 
     if (pic->format == AV_PIX_FMT_YUV422P10) {
-        const uint16_t *y = (const uint16_t *)pic->data[0];
-        const uint16_t *u = (const uint16_t *)pic->data[1];
-        const uint16_t *v = (const uint16_t *)pic->data[2];
-
         const int sample_size = 6 * s->sample_factor_10;
         const int sample_w    = avctx->width / sample_size;
 
-        for (h = 0; h < avctx->height; h++) {
+        for (h = start; h < end; h++) {
+            const uint16_t *y = (const uint16_t *)(pic->data[0] + h * pic->linesize[0]);
+            const uint16_t *u = (const uint16_t *)(pic->data[1] + h * pic->linesize[1]);
+            const uint16_t *v = (const uint16_t *)(pic->data[2] + h * pic->linesize[2]);
             uint32_t val;
             w = sample_w * sample_size;
             s->pack_line_10(y, u, v, dst, w);
@@ -175,19 +176,15 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
             memset(dst, 0, line_padding);
             dst += line_padding;
-            y += pic->linesize[0] / 2 - avctx->width;
-            u += pic->linesize[1] / 2 - avctx->width / 2;
-            v += pic->linesize[2] / 2 - avctx->width / 2;
         }
     } else if(pic->format == AV_PIX_FMT_YUV422P) {
-        const uint8_t *y = pic->data[0];
-        const uint8_t *u = pic->data[1];
-        const uint8_t *v = pic->data[2];
-
         const int sample_size = 12 * s->sample_factor_8;
         const int sample_w    = avctx->width / sample_size;
 
-        for (h = 0; h < avctx->height; h++) {
+        for (h = start; h < end; h++) {
+            const uint8_t *y = pic->data[0] + h * pic->linesize[0];
+            const uint8_t *u = pic->data[1] + h * pic->linesize[1];
+            const uint8_t *v = pic->data[2] + h * pic->linesize[2];
             uint32_t val;
             w = sample_w * sample_size;
             s->pack_line_8(y, u, v, dst, w);
@@ -223,13 +220,32 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
             }
             memset(dst, 0, line_padding);
             dst += line_padding;
-
-            y += pic->linesize[0] - avctx->width;
-            u += pic->linesize[1] - avctx->width / 2;
-            v += pic->linesize[2] - avctx->width / 2;
         }
     }
 
+    return 0;
+}
+
+static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
+                        const AVFrame *pic, int *got_packet)
+{
+    int aligned_width = ((avctx->width + 47) / 48) * 48;
+    int stride = aligned_width * 8 / 3;
+    ThreadData td;
+    int ret;
+
+    ret = ff_alloc_packet2(avctx, pkt, avctx->height * stride, avctx->height * stride);
+    if (ret < 0) {
+        av_log(avctx, AV_LOG_ERROR, "Error getting output packet.\n");
+        return ret;
+    }
+
+    td.frame   = pic;
+    td.buf     = pkt->data;
+    td.stride  = stride;
+    td.nb_jobs = av_clip(avctx->thread_count, 1, avctx->height);
+    avctx->execute2(avctx, v210_encode_slice, &td, NULL, td.nb_jobs);
+
     pkt->flags |= AV_PKT_FLAG_KEY;
     *got_packet = 1;
     return 0;
@@ -243,5 +259,6 @@ AVCodec ff_v210_encoder = {
     .priv_data_size = sizeof(V210EncContext),
     .init           = encode_init,
     .encode2        = encode_frame,
+    .capabilities   = AV_CODEC_CAP_SLICE_THREADS,
     .pix_fmts       = (const enum AVPixelFormat[]){ AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV422P, AV_PIX_FMT_NONE },
 };
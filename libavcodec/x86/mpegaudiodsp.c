@@ -22,6 +22,7 @@
 #include "libavutil/attributes.h"
 #include "libavutil/cpu.h"
 #include "libavutil/internal.h"
+#include "libavutil/thread.h"
 #include "libavutil/x86/asm.h"
 #include "libavutil/x86/cpu.h"
 #include "libavcodec/mpegaudiodsp.h"
@@ -108,13 +109,67 @@ static void apply_window(const float *buf, const float *win1,
 #undef MULT
 }
 
-static void apply_window_mp3(float *in, float *win, int *unused, float *out,
-                             int incr)
+#if HAVE_AVX_INLINE
+static void apply_window_avx(const float *buf, const float *win1,
+                             const float *win2, float *sum1, float *sum2, int len)
 {
-    LOCAL_ALIGNED_16(float, suma, [17]);
-    LOCAL_ALIGNED_16(float, sumb, [17]);
-    LOCAL_ALIGNED_16(float, sumc, [17]);
-    LOCAL_ALIGNED_16(float, sumd, [17]);
+    x86_reg count = - 4*len;
+    const float *win1a = win1+len;
+    const float *win2a = win2+len;
+    const float *bufa  = buf+len;
+    float *sum1a = sum1+len;
+    float *sum2a = sum2+len;
+
+
+#define MULT(a, b)                                          \
+    "vmovups " #a "(%3,%0),          %%ymm2          \n\t"  \
+    "vmulps  " #a "(%1,%0), %%ymm2,  %%ymm1          \n\t"  \
+    "vsubps         %%ymm1, %%ymm0,  %%ymm0          \n\t"  \
+    "vmulps  " #b "(%2,%0), %%ymm2,  %%ymm2          \n\t"  \
+    "vsubps         %%ymm2, %%ymm4,  %%ymm4          \n\t"  \
+
+    __asm__ volatile(
+            "1:                                   \n\t"
+            "vxorps      %%ymm0, %%ymm0, %%ymm0   \n\t"
+            "vxorps      %%ymm4, %%ymm4, %%ymm4   \n\t"
+
+            MULT(   0,   0)
+            MULT( 256,  64)
+            MULT( 512, 128)
+            MULT( 768, 192)
+            MULT(1024, 256)
+            MULT(1280, 320)
+            MULT(1536, 384)
+            MULT(1792, 448)
+
+            "vmovups     %%ymm0, (%4,%0)          \n\t"
+            "vmovups     %%ymm4, (%5,%0)          \n\t"
+            "add            $32,  %0              \n\t"
+            "jl              1b                   \n\t"
+            "vzeroupper                           \n\t"
+            :"+&r"(count)
+            :"r"(win1a), "r"(win2a), "r"(bufa), "r"(sum1a), "r"(sum2a)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm4",)
+              "memory"
+            );
+
+#undef MULT
+}
+#endif /* HAVE_AVX_INLINE */
+
+static av_always_inline void apply_window_mp3_tmpl(float *in, float *win,
+                                                   float *out, int incr,
+                                                   void (*apply_window_half)(const float *buf,
+                                                                             const float *win1,
+                                                                             const float *win2,
+                                                                             float *sum1,
+                                                                             float *sum2,
+                                                                             int len))
+{
+    LOCAL_ALIGNED_32(float, suma, [17]);
+    LOCAL_ALIGNED_32(float, sumb, [17]);
+    LOCAL_ALIGNED_32(float, sumc, [17]);
+    LOCAL_ALIGNED_32(float, sumd, [17]);
 
     float sum;
 
@@ -140,8 +195,8 @@ static void apply_window_mp3(float *in, float *win, int *unused, float *out,
             :"memory"
             );
 
-    apply_window(in + 16, win     , win + 512, suma, sumc, 16);
-    apply_window(in + 32, win + 48, win + 640, sumb, sumd, 16);
+    apply_window_half(in + 16, win     , win + 512, suma, sumc, 16);
+    apply_window_half(in + 32, win + 48, win + 640, sumb, sumd, 16);
 
     SUM8(MACS, suma[0], win + 32, in + 48);
 
@@ -191,6 +246,20 @@ static void apply_window_mp3(float *in, float *win, int *unused, float *out,
     *out = sum;
 }
 
+static void apply_window_mp3(float *in, float *win, int *unused, float *out,
+                             int incr)
+{
+    apply_window_mp3_tmpl(in, win, out, incr, apply_window);
+}
+
+#if HAVE_AVX_INLINE
+static void apply_window_mp3_avx(float *in, float *win, int *unused, float *out,
+                                 int incr)
+{
+    apply_window_mp3_tmpl(in, win, out, incr, apply_window_avx);
+}
+#endif
+
 #endif /* HAVE_6REGS && HAVE_SSE_INLINE */
 
 #if HAVE_YASM
@@ -239,10 +308,8 @@ DECL_IMDCT_BLOCKS(avx,avx)
 #endif
 #endif /* HAVE_YASM */
 
-av_cold void ff_mpadsp_init_x86(MPADSPContext *s)
+static av_cold void mpadsp_init_tabs_sse(void)
 {
-    av_unused int cpu_flags = av_get_cpu_flags();
-
     int i, j;
     for (j = 0; j < 4; j++) {
         for (i = 0; i < 40; i ++) {
@@ -256,11 +323,24 @@ av_cold void ff_mpadsp_init_x86(MPADSPContext *s)
             mdct_win_sse[1][j][4*i + 3] = ff_mdct_win_float[j + 4][i];
         }
     }
+}
+
+av_cold void ff_mpadsp_init_x86(MPADSPContext *s)
+{
+    static AVOnce init_static_once = AV_ONCE_INIT;
+    av_unused int cpu_flags = av_get_cpu_flags();
+
+    ff_thread_once(&init_static_once, mpadsp_init_tabs_sse);
 
 #if HAVE_6REGS && HAVE_SSE_INLINE
     if (INLINE_SSE(cpu_flags)) {
         s->apply_window_float = apply_window_mp3;
     }
+#if HAVE_AVX_INLINE
+    if (INLINE_AVX_FAST(cpu_flags)) {
+        s->apply_window_float = apply_window_mp3_avx;
+    }
+#endif
 #endif /* HAVE_SSE_INLINE */
 
 #if HAVE_YASM
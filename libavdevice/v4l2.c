@@ -37,8 +37,6 @@
 #include <libv4l2.h>
 #endif
 
-static const int desired_video_buffers = 256;
-
 #define V4L_ALLFORMATS  3
 #define V4L_RAWFORMATS  1
 #define V4L_COMPFORMATS 2
@@ -81,6 +79,7 @@ struct video_data {
     volatile int buffers_queued;
     void **buf_start;
     unsigned int *buf_len;
+    int *buf_fd;            /**< DMA-BUF file descriptors, if exported */
     char *standard;
     v4l2_std_id std_id;
     int channel;
@@ -90,6 +89,9 @@ struct video_data {
     char *framerate;    /**< Set by a private option. */
 
     int use_libv4l2;
+    int nb_buffers;         /**< Set by a private option. */
+    int min_queued;         /**< Set by a private option. */
+    int export_dmabuf;      /**< Set by a private option. */
     int (*open_f)(const char *file, int oflag, ...);
     int (*close_f)(int fd);
     int (*dup_f)(int fd);
@@ -334,7 +336,7 @@ static int mmap_init(AVFormatContext *ctx)
     struct video_data *s = ctx->priv_data;
     struct v4l2_requestbuffers req = {
         .type   = V4L2_BUF_TYPE_VIDEO_CAPTURE,
-        .count  = desired_video_buffers,
+        .count  = s->nb_buffers,
         .memory = V4L2_MEMORY_MMAP
     };
 
@@ -360,6 +362,23 @@ static int mmap_init(AVFormatContext *ctx)
         av_freep(&s->buf_start);
         return AVERROR(ENOMEM);
     }
+    if (s->export_dmabuf) {
+#ifdef VIDIOC_EXPBUF
+        s->buf_fd = av_malloc_array(s->buffers, sizeof(*s->buf_fd));
+        if (!s->buf_fd) {
+            av_freep(&s->buf_start);
+            av_freep(&s->buf_len);
+            return AVERROR(ENOMEM);
+        }
+        for (i = 0; i < s->buffers; i++)
+            s->buf_fd[i] = -1;
+#else
+        av_log(ctx, AV_LOG_ERROR, "DMA-BUF export is not supported by the V4L2 headers\n");
+        av_freep(&s->buf_start);
+        av_freep(&s->buf_len);
+        return AVERROR(ENOSYS);
+#endif
+    }
 
     for (i = 0; i < req.count; i++) {
         struct v4l2_buffer buf = {
@@ -389,6 +408,23 @@ static int mmap_init(AVFormatContext *ctx)
             av_log(ctx, AV_LOG_ERROR, "mmap: %s\n", av_err2str(res));
             return res;
         }
+
+#ifdef VIDIOC_EXPBUF
+        if (s->buf_fd) {
+            struct v4l2_exportbuffer expbuf = {
+                .type  = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+                .index = i,
+                .flags = O_RDONLY,
+            };
+            if (v4l2_ioctl(s->fd, VIDIOC_EXPBUF, &expbuf) < 0) {
+                res = AVERROR(errno);
+                av_log(ctx, AV_LOG_ERROR, "ioctl(VIDIOC_EXPBUF): %s\n", av_err2str(res));
+                return res;
+            }
+            s->buf_fd[i] = expbuf.fd;
+            fcntl(expbuf.fd, F_SETFD, FD_CLOEXEC);
+        }
+#endif
     }
 
     return 0;
@@ -538,7 +574,8 @@ static int mmap_read_frame(AVFormatContext *ctx, AVPacket *pkt)
     }
 
     /* Image is at s->buff_start[buf.index] */
-    if (avpriv_atomic_int_get(&s->buffers_queued) == FFMAX(s->buffers / 8, 1)) {
+    if (avpriv_atomic_int_get(&s->buffers_queued) ==
+        FFMAX(s->min_queued ? FFMIN(s->min_queued, s->buffers - 1) : s->buffers / 8, 1)) {
         /* when we start getting low on queued buffers, fall back on copying data */
         res = av_new_packet(pkt, buf.bytesused);
         if (res < 0) {
@@ -580,6 +617,16 @@ static int mmap_read_frame(AVFormatContext *ctx, AVPacket *pkt)
             av_freep(&buf_descriptor);
             return AVERROR(ENOMEM);
         }
+
+        if (s->buf_fd) {
+            uint8_t *fd = av_packet_new_side_data(pkt, AV_PKT_DATA_DMABUF,
+                                                  sizeof(*s->buf_fd));
+            if (!fd) {
+                av_packet_unref(pkt);
+                return AVERROR(ENOMEM);
+            }
+            memcpy(fd, &s->buf_fd[buf.index], sizeof(*s->buf_fd));
+        }
     }
     pkt->pts = buf.timestamp.tv_sec * INT64_C(1000000) + buf.timestamp.tv_usec;
     convert_timestamp(ctx, &pkt->pts);
@@ -632,9 +679,12 @@ static void mmap_close(struct video_data *s)
     v4l2_ioctl(s->fd, VIDIOC_STREAMOFF, &type);
     for (i = 0; i < s->buffers; i++) {
         v4l2_munmap(s->buf_start[i], s->buf_len[i]);
+        if (s->buf_fd && s->buf_fd[i] >= 0)
+            close(s->buf_fd[i]);
     }
     av_freep(&s->buf_start);
     av_freep(&s->buf_len);
+    av_freep(&s->buf_fd);
 }
 
 static int v4l2_set_parameters(AVFormatContext *ctx)
@@ -1113,6 +1163,9 @@ static const AVOption options[] = {
     { "abs",          "use absolute timestamps (wall clock)",                     OFFSET(ts_mode),      AV_OPT_TYPE_CONST,  {.i64 = V4L_TS_ABS      }, 0, 2, DEC, "timestamps" },
     { "mono2abs",     "force conversion from monotonic to absolute timestamps",   OFFSET(ts_mode),      AV_OPT_TYPE_CONST,  {.i64 = V4L_TS_MONO2ABS }, 0, 2, DEC, "timestamps" },
     { "use_libv4l2",  "use libv4l2 (v4l-utils) conversion functions",             OFFSET(use_libv4l2),  AV_OPT_TYPE_BOOL,   {.i64 = 0}, 0, 1, DEC },
+    { "buffers",      "set number of capture buffers to request",                 OFFSET(nb_buffers),   AV_OPT_TYPE_INT,    {.i64 = 256}, 2, INT_MAX, DEC },
+    { "min_queued_buffers", "set number of queued buffers below which frames are copied, 0 for 1/8 of the buffers", OFFSET(min_queued), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, DEC },
+    { "export_dmabuf", "export the capture buffers as DMA-BUF file descriptors",   OFFSET(export_dmabuf), AV_OPT_TYPE_BOOL,  {.i64 = 0}, 0, 1, DEC },
     { NULL },
 };
 
@@ -34,7 +34,6 @@
 #include "libavutil/avstring.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/common.h"
-#include "libavutil/float_dsp.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/samplefmt.h"
@@ -51,6 +50,13 @@
 #define DURATION_SHORTEST 1
 #define DURATION_FIRST    2
 
+#define MAX_INPUTS 32
+
+#define PRECISION_FIXED 0
+#define PRECISION_FLOAT 1
+
+/** number of samples per channel mixed at a time, from all the inputs */
+#define MIX_BLOCK_SIZE  256
 
 typedef struct FrameInfo {
     int nb_samples;
@@ -71,15 +77,22 @@ typedef struct FrameList {
     int nb_samples;
     FrameInfo *list;
     FrameInfo *end;
+    FrameInfo *unused;          /**< removed entries, reused by frame_list_add_frame() */
 } FrameList;
 
+static void frame_list_release(FrameList *frame_list, FrameInfo *info)
+{
+    info->next = frame_list->unused;
+    frame_list->unused = info;
+}
+
 static void frame_list_clear(FrameList *frame_list)
 {
     if (frame_list) {
         while (frame_list->list) {
             FrameInfo *info = frame_list->list;
             frame_list->list = info->next;
-            av_free(info);
+            frame_list_release(frame_list, info);
         }
         frame_list->nb_frames  = 0;
         frame_list->nb_samples = 0;
@@ -87,6 +100,18 @@ static void frame_list_clear(FrameList *frame_list)
     }
 }
 
+static void frame_list_free(FrameList *frame_list)
+{
+    if (frame_list) {
+        frame_list_clear(frame_list);
+        while (frame_list->unused) {
+            FrameInfo *info = frame_list->unused;
+            frame_list->unused = info->next;
+            av_free(info);
+        }
+    }
+}
+
 static int frame_list_next_frame_size(FrameList *frame_list)
 {
     if (!frame_list->list)
@@ -117,7 +142,7 @@ static void frame_list_remove_samples(FrameList *frame_list, int nb_samples)
                     frame_list->end = NULL;
                 frame_list->nb_frames--;
                 frame_list->nb_samples -= info->nb_samples;
-                av_free(info);
+                frame_list_release(frame_list, info);
             } else {
                 info->nb_samples       -= samples;
                 info->pts              += samples;
@@ -130,8 +155,11 @@ static void frame_list_remove_samples(FrameList *frame_list, int nb_samples)
 
 static int frame_list_add_frame(FrameList *frame_list, int nb_samples, int64_t pts)
 {
-    FrameInfo *info = av_malloc(sizeof(*info));
-    if (!info)
+    FrameInfo *info = frame_list->unused;
+
+    if (info)
+        frame_list->unused = info->next;
+    else if (!(info = av_malloc(sizeof(*info))))
         return AVERROR(ENOMEM);
     info->nb_samples = nb_samples;
     info->pts        = pts;
@@ -154,19 +182,21 @@ static int frame_list_add_frame(FrameList *frame_list, int nb_samples, int64_t p
 
 typedef struct MixContext {
     const AVClass *class;       /**< class for AVOptions */
-    AVFloatDSPContext *fdsp;
 
     int nb_inputs;              /**< number of inputs */
     int active_inputs;          /**< number of input currently active */
     int duration_mode;          /**< mode for determining duration */
     float dropout_transition;   /**< transition time when an input drops out */
+    int precision;              /**< mix integer or floating-point samples */
 
     int nb_channels;            /**< number of channels */
     int sample_rate;            /**< sample rate */
     int planar;
+    enum AVSampleFormat sample_fmt;
     AVAudioFifo **fifos;        /**< audio fifo for each input */
     uint8_t *input_state;       /**< current state of each input */
     float *input_scale;         /**< mixing scale factor for each input */
+    uint8_t **input_data;       /**< samples of each input, in its FIFO */
     float scale_norm;           /**< normalization factor for all inputs */
     int64_t next_pts;           /**< calculated pts for next output frame */
     FrameList *frame_list;      /**< list of frame info for the first input */
@@ -177,7 +207,7 @@ typedef struct MixContext {
 #define F AV_OPT_FLAG_FILTERING_PARAM
 static const AVOption amix_options[] = {
     { "inputs", "Number of inputs.",
-            OFFSET(nb_inputs), AV_OPT_TYPE_INT, { .i64 = 2 }, 1, 32, A|F },
+            OFFSET(nb_inputs), AV_OPT_TYPE_INT, { .i64 = 2 }, 1, MAX_INPUTS, A|F },
     { "duration", "How to determine the end-of-stream.",
             OFFSET(duration_mode), AV_OPT_TYPE_INT, { .i64 = DURATION_LONGEST }, 0,  2, A|F, "duration" },
         { "longest",  "Duration of longest input.",  0, AV_OPT_TYPE_CONST, { .i64 = DURATION_LONGEST  }, INT_MIN, INT_MAX, A|F, "duration" },
@@ -186,6 +216,10 @@ static const AVOption amix_options[] = {
     { "dropout_transition", "Transition time, in seconds, for volume "
                             "renormalization when an input stream ends.",
             OFFSET(dropout_transition), AV_OPT_TYPE_FLOAT, { .dbl = 2.0 }, 0, INT_MAX, A|F },
+    { "precision", "Select the sample formats to mix.",
+            OFFSET(precision), AV_OPT_TYPE_INT, { .i64 = PRECISION_FLOAT }, PRECISION_FIXED, PRECISION_FLOAT, A|F, "precision" },
+        { "fixed", "Mix 16 and 32-bit integer samples.", 0, AV_OPT_TYPE_CONST, { .i64 = PRECISION_FIXED }, INT_MIN, INT_MAX, A|F, "precision" },
+        { "float", "Mix 32-bit floating-point samples.", 0, AV_OPT_TYPE_CONST, { .i64 = PRECISION_FLOAT }, INT_MIN, INT_MAX, A|F, "precision" },
     { NULL }
 };
 
@@ -223,6 +257,7 @@ static int config_output(AVFilterLink *outlink)
     char buf[64];
 
     s->planar          = av_sample_fmt_is_planar(outlink->format);
+    s->sample_fmt      = av_get_packed_sample_fmt(outlink->format);
     s->sample_rate     = outlink->sample_rate;
     outlink->time_base = (AVRational){ 1, outlink->sample_rate };
     s->next_pts        = AV_NOPTS_VALUE;
@@ -251,6 +286,10 @@ static int config_output(AVFilterLink *outlink)
     s->input_scale = av_mallocz_array(s->nb_inputs, sizeof(*s->input_scale));
     if (!s->input_scale)
         return AVERROR(ENOMEM);
+    s->input_data = av_mallocz_array(s->nb_inputs * s->nb_channels,
+                                     sizeof(*s->input_data));
+    if (!s->input_data)
+        return AVERROR(ENOMEM);
     s->scale_norm = s->active_inputs;
     calculate_scales(s, 0);
 
@@ -263,6 +302,84 @@ static int config_output(AVFilterLink *outlink)
     return 0;
 }
 
+/* The inputs are added to the output in order, which gives the same result
+ * as accumulating them one at a time, with a single pass over the output
+ * for every 4 of them. */
+static void mix_flt(float *dst, const uint8_t **src, const float *scale,
+                    int nb_src, int offset, int len)
+{
+    int i, j;
+
+    for (j = 0; j < nb_src; j += 4) {
+        const float *src0 = (const float *)src[j] + offset;
+        const float *src1, *src2, *src3;
+
+        switch (FFMIN(nb_src - j, 4)) {
+        case 1:
+            for (i = 0; i < len; i++)
+                dst[i] = dst[i] + src0[i] * scale[j];
+            break;
+        case 2:
+            src1 = (const float *)src[j + 1] + offset;
+            for (i = 0; i < len; i++)
+                dst[i] = dst[i] + src0[i] * scale[j] + src1[i] * scale[j + 1];
+            break;
+        case 3:
+            src1 = (const float *)src[j + 1] + offset;
+            src2 = (const float *)src[j + 2] + offset;
+            for (i = 0; i < len; i++)
+                dst[i] = dst[i] + src0[i] * scale[j] + src1[i] * scale[j + 1] +
+                                  src2[i] * scale[j + 2];
+            break;
+        default:
+            src1 = (const float *)src[j + 1] + offset;
+            src2 = (const float *)src[j + 2] + offset;
+            src3 = (const float *)src[j + 3] + offset;
+            for (i = 0; i < len; i++)
+                dst[i] = dst[i] + src0[i] * scale[j] + src1[i] * scale[j + 1] +
+                                  src2[i] * scale[j + 2] + src3[i] * scale[j + 3];
+            break;
+        }
+    }
+}
+
+/* The sum of the scales is at most 1, so the 15-bit scaled samples of all
+ * the inputs can be accumulated in 32 bits, and the 30-bit scaled 32-bit
+ * samples in 64 bits. */
+static void mix_s16(int16_t *dst, const uint8_t **src, const float *scale,
+                    int nb_src, int offset, int len)
+{
+    int32_t acc[MIX_BLOCK_SIZE] = { 0 };
+    int i, j;
+
+    for (j = 0; j < nb_src; j++) {
+        const int16_t *src0 = (const int16_t *)src[j] + offset;
+        int32_t mul = lrintf(scale[j] * (1 << 15));
+
+        for (i = 0; i < len; i++)
+            acc[i] += src0[i] * mul;
+    }
+    for (i = 0; i < len; i++)
+        dst[i] = av_clip_int16((acc[i] + (1 << 14)) >> 15);
+}
+
+static void mix_s32(int32_t *dst, const uint8_t **src, const float *scale,
+                    int nb_src, int offset, int len)
+{
+    int64_t acc[MIX_BLOCK_SIZE] = { 0 };
+    int i, j;
+
+    for (j = 0; j < nb_src; j++) {
+        const int32_t *src0 = (const int32_t *)src[j] + offset;
+        int64_t mul = llrintf(scale[j] * (1 << 30));
+
+        for (i = 0; i < len; i++)
+            acc[i] += src0[i] * mul;
+    }
+    for (i = 0; i < len; i++)
+        dst[i] = av_clipl_int32((acc[i] + (1 << 29)) >> 30);
+}
+
 static int calc_active_inputs(MixContext *s);
 
 /**
@@ -272,8 +389,11 @@ static int output_frame(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
     MixContext      *s = ctx->priv;
-    AVFrame *out_buf, *in_buf;
-    int nb_samples, ns, ret, i;
+    AVFrame *out_buf;
+    const uint8_t *src[MAX_INPUTS];
+    float scale[MAX_INPUTS];
+    int nb_samples, ns, ret, i, p, offset, nb_src;
+    int planes, stride, bps, plane_size, pos, len;
 
     ret = calc_active_inputs(s);
     if (ret < 0)
@@ -316,31 +436,60 @@ static int output_frame(AVFilterLink *outlink)
     if (!out_buf)
         return AVERROR(ENOMEM);
 
-    in_buf = ff_get_audio_buffer(outlink, nb_samples);
-    if (!in_buf) {
-        av_frame_free(&out_buf);
-        return AVERROR(ENOMEM);
-    }
-
-    for (i = 0; i < s->nb_inputs; i++) {
-        if (s->input_state[i] & INPUT_ON) {
-            int planes, plane_size, p;
-
-            av_audio_fifo_read(s->fifos[i], (void **)in_buf->extended_data,
-                               nb_samples);
-
-            planes     = s->planar ? s->nb_channels : 1;
-            plane_size = nb_samples * (s->planar ? 1 : s->nb_channels);
-            plane_size = FFALIGN(plane_size, 16);
+    planes = s->planar ? s->nb_channels : 1;
+    stride = s->planar ? 1 : s->nb_channels;
+    bps    = av_get_bytes_per_sample(s->sample_fmt);
+
+    /* mix straight from the FIFOs, in as many segments as needed for the
+     * ones that wrap around, and block by block within each plane so that
+     * each block of the output stays in cache while accumulating */
+    for (pos = 0; pos < nb_samples; pos += len) {
+        len = nb_samples - pos;
+        for (i = 0; i < s->nb_inputs; i++) {
+            if (!(s->input_state[i] & INPUT_ON))
+                continue;
+            ret = av_audio_fifo_peek_ptr(s->fifos[i], s->input_data + i * planes,
+                                         len, pos);
+            if (ret <= 0) {
+                av_frame_free(&out_buf);
+                return ret < 0 ? ret : AVERROR_BUG;
+            }
+            len = FFMIN(len, ret);
+        }
+        plane_size = len * stride;
+
+        for (p = 0; p < planes; p++) {
+            for (i = 0, nb_src = 0; i < s->nb_inputs; i++) {
+                if (!(s->input_state[i] & INPUT_ON))
+                    continue;
+                src[nb_src]   = s->input_data[i * planes + p];
+                scale[nb_src] = s->input_scale[i];
+                nb_src++;
+            }
 
-            for (p = 0; p < planes; p++) {
-                s->fdsp->vector_fmac_scalar((float *)out_buf->extended_data[p],
-                                           (float *) in_buf->extended_data[p],
-                                           s->input_scale[i], plane_size);
+            for (offset = 0; offset < plane_size; offset += MIX_BLOCK_SIZE) {
+                int block = FFMIN(plane_size - offset, MIX_BLOCK_SIZE);
+                uint8_t *dst = out_buf->extended_data[p] +
+                               (pos * stride + offset) * bps;
+
+                switch (s->sample_fmt) {
+                case AV_SAMPLE_FMT_FLT:
+                    mix_flt((float *)dst, src, scale, nb_src, offset, block);
+                    break;
+                case AV_SAMPLE_FMT_S16:
+                    mix_s16((int16_t *)dst, src, scale, nb_src, offset, block);
+                    break;
+                case AV_SAMPLE_FMT_S32:
+                    mix_s32((int32_t *)dst, src, scale, nb_src, offset, block);
+                    break;
+                }
             }
         }
     }
-    av_frame_free(&in_buf);
+
+    for (i = 0; i < s->nb_inputs; i++)
+        if (s->input_state[i] & INPUT_ON)
+            av_audio_fifo_drain(s->fifos[i], nb_samples);
 
     out_buf->pts = s->next_pts;
     if (s->next_pts != AV_NOPTS_VALUE)
@@ -485,10 +634,6 @@ static av_cold int init(AVFilterContext *ctx)
         ff_insert_inpad(ctx, i, &pad);
     }
 
-    s->fdsp = avpriv_float_dsp_alloc(0);
-    if (!s->fdsp)
-        return AVERROR(ENOMEM);
-
     return 0;
 }
 
@@ -502,11 +647,11 @@ static av_cold void uninit(AVFilterContext *ctx)
             av_audio_fifo_free(s->fifos[i]);
         av_freep(&s->fifos);
     }
-    frame_list_clear(s->frame_list);
+    frame_list_free(s->frame_list);
     av_freep(&s->frame_list);
     av_freep(&s->input_state);
     av_freep(&s->input_scale);
-    av_freep(&s->fdsp);
+    av_freep(&s->input_data);
 
     for (i = 0; i < ctx->nb_inputs; i++)
         av_freep(&ctx->input_pads[i].name);
@@ -514,7 +659,22 @@ static av_cold void uninit(AVFilterContext *ctx)
 
 static int query_formats(AVFilterContext *ctx)
 {
-    AVFilterFormats *formats = NULL;
+    static const enum AVSampleFormat sample_fmts[][5] = {
+        [PRECISION_FIXED] = {
+            AV_SAMPLE_FMT_S16,
+            AV_SAMPLE_FMT_S16P,
+            AV_SAMPLE_FMT_S32,
+            AV_SAMPLE_FMT_S32P,
+            AV_SAMPLE_FMT_NONE
+        },
+        [PRECISION_FLOAT] = {
+            AV_SAMPLE_FMT_FLT,
+            AV_SAMPLE_FMT_FLTP,
+            AV_SAMPLE_FMT_NONE
+        },
+    };
+    MixContext *s = ctx->priv;
+    AVFilterFormats *formats;
     AVFilterChannelLayouts *layouts;
     int ret;
 
@@ -524,9 +684,13 @@ static int query_formats(AVFilterContext *ctx)
         goto fail;
     }
 
-    if ((ret = ff_add_format(&formats, AV_SAMPLE_FMT_FLT ))          < 0 ||
-        (ret = ff_add_format(&formats, AV_SAMPLE_FMT_FLTP))          < 0 ||
-        (ret = ff_set_common_formats        (ctx, formats))          < 0 ||
+    formats = ff_make_format_list(sample_fmts[s->precision]);
+    if (!formats) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = ff_set_common_formats        (ctx, formats))          < 0 ||
         (ret = ff_set_common_channel_layouts(ctx, layouts))          < 0 ||
         (ret = ff_set_common_samplerates(ctx, ff_all_samplerates())) < 0)
         goto fail;
@@ -81,11 +81,27 @@ static int config_props_output(AVFilterLink *outlink)
     return 0;
 }
 
+static int push_frame(AVFilterLink *outlink, AVFrame *outsamples)
+{
+    ASNSContext *asns = outlink->src->priv;
+    int ret, nb_out_samples = outsamples->nb_samples;
+
+    outsamples->pts = asns->next_out_pts;
+
+    if (asns->next_out_pts != AV_NOPTS_VALUE)
+        asns->next_out_pts += av_rescale_q(nb_out_samples, (AVRational){1, outlink->sample_rate}, outlink->time_base);
+
+    ret = ff_filter_frame(outlink, outsamples);
+    if (ret < 0)
+        return ret;
+    return nb_out_samples;
+}
+
 static int push_samples(AVFilterLink *outlink)
 {
     ASNSContext *asns = outlink->src->priv;
     AVFrame *outsamples = NULL;
-    int ret, nb_out_samples, nb_pad_samples;
+    int nb_out_samples, nb_pad_samples;
 
     if (asns->pad) {
         nb_out_samples = av_audio_fifo_size(asns->fifo) ? asns->nb_out_samples : 0;
@@ -102,25 +118,17 @@ static int push_samples(AVFilterLink *outlink)
     if (!outsamples)
         return AVERROR(ENOMEM);
 
-    av_audio_fifo_read(asns->fifo,
-                       (void **)outsamples->extended_data, nb_out_samples);
+    av_audio_fifo_read_frame(asns->fifo, outsamples, nb_out_samples);
+    outsamples->nb_samples = nb_out_samples;
 
     if (nb_pad_samples)
         av_samples_set_silence(outsamples->extended_data, nb_out_samples - nb_pad_samples,
                                nb_pad_samples, outlink->channels,
                                outlink->format);
-    outsamples->nb_samples     = nb_out_samples;
     outsamples->channel_layout = outlink->channel_layout;
     outsamples->sample_rate    = outlink->sample_rate;
-    outsamples->pts = asns->next_out_pts;
-
-    if (asns->next_out_pts != AV_NOPTS_VALUE)
-        asns->next_out_pts += av_rescale_q(nb_out_samples, (AVRational){1, outlink->sample_rate}, outlink->time_base);
 
-    ret = ff_filter_frame(outlink, outsamples);
-    if (ret < 0)
-        return ret;
-    return nb_out_samples;
+    return push_frame(outlink, outsamples);
 }
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
@@ -131,6 +139,14 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
     int ret;
     int nb_samples = insamples->nb_samples;
 
+    /* frames which already have the right size are passed through */
+    if (nb_samples == asns->nb_out_samples && !av_audio_fifo_size(asns->fifo)) {
+        if (asns->next_out_pts == AV_NOPTS_VALUE)
+            asns->next_out_pts = insamples->pts;
+        ret = push_frame(outlink, insamples);
+        return ret < 0 ? ret : 0;
+    }
+
     if (av_audio_fifo_space(asns->fifo) < nb_samples) {
         av_log(ctx, AV_LOG_DEBUG, "No space for %d samples, stretching audio fifo\n", nb_samples);
         ret = av_audio_fifo_realloc(asns->fifo, av_audio_fifo_size(asns->fifo) + nb_samples);
@@ -27,6 +27,7 @@
 #include <float.h>
 
 #include "libavutil/avassert.h"
+#include "libavutil/float_dsp.h"
 #include "libavutil/opt.h"
 
 #define FF_BUFQUEUE_SIZE 302
@@ -54,6 +55,7 @@ typedef struct DynamicAudioNormalizerContext {
     int dc_correction;
     int channels_coupled;
     int alt_boundary_mode;
+    int low_latency;
 
     double peak_value;
     double max_amplification;
@@ -71,6 +73,13 @@ typedef struct DynamicAudioNormalizerContext {
     cqueue **gain_history_original;
     cqueue **gain_history_minimum;
     cqueue **gain_history_smoothed;
+
+    /* low latency mode: cascaded moving averages instead of the Gaussian */
+    int box_size;
+    cqueue **box_history[3];
+    double *box_sum[3];
+
+    AVFloatDSPContext *fdsp;
 } DynamicAudioNormalizerContext;
 
 #define OFFSET(x) offsetof(DynamicAudioNormalizerContext, x)
@@ -86,6 +95,7 @@ static const AVOption dynaudnorm_options[] = {
     { "c", "set DC correction",                OFFSET(dc_correction),     AV_OPT_TYPE_BOOL,   {.i64 = 0},      0,     1, FLAGS },
     { "b", "set alternative boundary mode",    OFFSET(alt_boundary_mode), AV_OPT_TYPE_BOOL,   {.i64 = 0},      0,     1, FLAGS },
     { "s", "set the compress factor",          OFFSET(compress_factor),   AV_OPT_TYPE_DOUBLE, {.dbl = 0.0},  0.0,  30.0, FLAGS },
+    { "l", "set low latency mode",             OFFSET(low_latency),       AV_OPT_TYPE_BOOL,   {.i64 = 0},      0,     1, FLAGS },
     { NULL }
 };
 
@@ -253,12 +263,15 @@ static void init_gaussian_filter(DynamicAudioNormalizerContext *s)
     for (i = 0; i < s->filter_size; i++) {
         s->weights[i] *= adjust;
     }
+
+    // Three moving averages of this size have the variance of the Gaussian
+    s->box_size = FFMAX(lrint(sqrt(4.0 * sigma * sigma + 1.0)), 1);
 }
 
 static av_cold void uninit(AVFilterContext *ctx)
 {
     DynamicAudioNormalizerContext *s = ctx->priv;
-    int c;
+    int c, i;
 
     av_freep(&s->prev_amplification_factor);
     av_freep(&s->dc_correction_value);
@@ -273,13 +286,22 @@ static av_cold void uninit(AVFilterContext *ctx)
             cqueue_free(s->gain_history_minimum[c]);
         if (s->gain_history_smoothed)
             cqueue_free(s->gain_history_smoothed[c]);
+        for (i = 0; i < 3; i++)
+            if (s->box_history[i])
+                cqueue_free(s->box_history[i][c]);
     }
 
     av_freep(&s->gain_history_original);
     av_freep(&s->gain_history_minimum);
     av_freep(&s->gain_history_smoothed);
 
+    for (i = 0; i < 3; i++) {
+        av_freep(&s->box_history[i]);
+        av_freep(&s->box_sum[i]);
+    }
+
     av_freep(&s->weights);
+    av_freep(&s->fdsp);
 
     ff_bufqueue_discard_all(&s->queue);
 }
@@ -288,7 +310,7 @@ static int config_input(AVFilterLink *inlink)
 {
     AVFilterContext *ctx = inlink->dst;
     DynamicAudioNormalizerContext *s = ctx->priv;
-    int c;
+    int c, i;
 
     uninit(ctx);
 
@@ -308,12 +330,25 @@ static int config_input(AVFilterLink *inlink)
     s->gain_history_minimum = av_calloc(inlink->channels, sizeof(*s->gain_history_minimum));
     s->gain_history_smoothed = av_calloc(inlink->channels, sizeof(*s->gain_history_smoothed));
     s->weights = av_malloc_array(s->filter_size, sizeof(*s->weights));
+    s->fdsp = avpriv_float_dsp_alloc(0);
     if (!s->prev_amplification_factor || !s->dc_correction_value ||
         !s->compress_threshold || !s->fade_factors[0] || !s->fade_factors[1] ||
         !s->gain_history_original || !s->gain_history_minimum ||
-        !s->gain_history_smoothed || !s->weights)
+        !s->gain_history_smoothed || !s->weights || !s->fdsp)
         return AVERROR(ENOMEM);
 
+    precalculate_fade_factors(s->fade_factors, s->frame_len);
+    init_gaussian_filter(s);
+
+    if (s->low_latency) {
+        for (i = 0; i < 3; i++) {
+            s->box_history[i] = av_calloc(inlink->channels, sizeof(*s->box_history[i]));
+            s->box_sum[i] = av_calloc(inlink->channels, sizeof(*s->box_sum[i]));
+            if (!s->box_history[i] || !s->box_sum[i])
+                return AVERROR(ENOMEM);
+        }
+    }
+
     for (c = 0; c < inlink->channels; c++) {
         s->prev_amplification_factor[c] = 1.0;
 
@@ -324,13 +359,16 @@ static int config_input(AVFilterLink *inlink)
         if (!s->gain_history_original[c] || !s->gain_history_minimum[c] ||
             !s->gain_history_smoothed[c])
             return AVERROR(ENOMEM);
-    }
 
-    precalculate_fade_factors(s->fade_factors, s->frame_len);
-    init_gaussian_filter(s);
+        for (i = 0; i < 3 && s->low_latency; i++) {
+            s->box_history[i][c] = cqueue_create(s->box_size);
+            if (!s->box_history[i][c])
+                return AVERROR(ENOMEM);
+        }
+    }
 
     s->channels = inlink->channels;
-    s->delay = s->filter_size;
+    s->delay = s->low_latency ? 0 : s->filter_size;
 
     return 0;
 }
@@ -352,60 +390,65 @@ static inline double bound(const double threshold, const double val)
     return erf(CONST * (val / threshold)) * threshold;
 }
 
-static double find_peak_magnitude(AVFrame *frame, int channel)
+/**
+ * Update the peak magnitude and the energy with the samples of a channel.
+ * Four independent accumulators let the compiler vectorize the loop.
+ */
+static void channel_peak_energy(const double *src, int nb_samples,
+                                double *peak, double *energy)
 {
-    double max = DBL_EPSILON;
-    int c, i;
-
-    if (channel == -1) {
-        for (c = 0; c < av_frame_get_channels(frame); c++) {
-            double *data_ptr = (double *)frame->extended_data[c];
-
-            for (i = 0; i < frame->nb_samples; i++)
-                max = FFMAX(max, fabs(data_ptr[i]));
-        }
-    } else {
-        double *data_ptr = (double *)frame->extended_data[channel];
+    double max0 = *peak, max1 = *peak, max2 = *peak, max3 = *peak;
+    double sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+    int i;
 
-        for (i = 0; i < frame->nb_samples; i++)
-            max = FFMAX(max, fabs(data_ptr[i]));
+    for (i = 0; i + 3 < nb_samples; i += 4) {
+        max0 = FFMAX(max0, fabs(src[i    ]));
+        max1 = FFMAX(max1, fabs(src[i + 1]));
+        max2 = FFMAX(max2, fabs(src[i + 2]));
+        max3 = FFMAX(max3, fabs(src[i + 3]));
+        sum0 += pow2(src[i    ]);
+        sum1 += pow2(src[i + 1]);
+        sum2 += pow2(src[i + 2]);
+        sum3 += pow2(src[i + 3]);
+    }
+    for (; i < nb_samples; i++) {
+        max0 = FFMAX(max0, fabs(src[i]));
+        sum0 += pow2(src[i]);
     }
 
-    return max;
+    *peak    = FFMAX(FFMAX(max0, max1), FFMAX(max2, max3));
+    *energy += (sum0 + sum1) + (sum2 + sum3);
 }
 
-static double compute_frame_rms(AVFrame *frame, int channel)
+/**
+ * Compute the peak magnitude and the energy of a channel, or of all the
+ * channels if channel is -1, in a single pass.
+ */
+static void frame_peak_energy(AVFrame *frame, int channel,
+                              double *peak, double *energy)
 {
-    double rms_value = 0.0;
-    int c, i;
-
-    if (channel == -1) {
-        for (c = 0; c < av_frame_get_channels(frame); c++) {
-            const double *data_ptr = (double *)frame->extended_data[c];
-
-            for (i = 0; i < frame->nb_samples; i++) {
-                rms_value += pow2(data_ptr[i]);
-            }
-        }
-
-        rms_value /= frame->nb_samples * av_frame_get_channels(frame);
-    } else {
-        const double *data_ptr = (double *)frame->extended_data[channel];
-        for (i = 0; i < frame->nb_samples; i++) {
-            rms_value += pow2(data_ptr[i]);
-        }
-
-        rms_value /= frame->nb_samples;
-    }
+    const int first = channel == -1 ? 0 : channel;
+    const int last  = channel == -1 ? av_frame_get_channels(frame) : channel + 1;
+    int c;
 
-    return FFMAX(sqrt(rms_value), DBL_EPSILON);
+    *peak   = DBL_EPSILON;
+    *energy = 0.0;
+    for (c = first; c < last; c++)
+        channel_peak_energy((const double *)frame->extended_data[c],
+                            frame->nb_samples, peak, energy);
 }
 
 static double get_max_local_gain(DynamicAudioNormalizerContext *s, AVFrame *frame,
                                  int channel)
 {
-    const double maximum_gain = s->peak_value / find_peak_magnitude(frame, channel);
-    const double rms_gain = s->target_rms > DBL_EPSILON ? (s->target_rms / compute_frame_rms(frame, channel)) : DBL_MAX;
+    const int nb_channels = channel == -1 ? av_frame_get_channels(frame) : 1;
+    double peak, energy, maximum_gain, rms_gain;
+
+    frame_peak_energy(frame, channel, &peak, &energy);
+    maximum_gain = s->peak_value / peak;
+    rms_gain = s->target_rms > DBL_EPSILON ?
+               s->target_rms / FFMAX(sqrt(energy / (frame->nb_samples * nb_channels)), DBL_EPSILON) :
+               DBL_MAX;
     return bound(s->max_amplification, FFMIN(maximum_gain, rms_gain));
 }
 
@@ -474,6 +517,51 @@ static void update_gain_history(DynamicAudioNormalizerContext *s, int channel,
     }
 }
 
+/**
+ * Low latency variant of update_gain_history(): the minimum filter only
+ * looks at the current and the preceding frames, and three cascaded moving
+ * averages, updated incrementally, take the place of the Gaussian filter.
+ * The gain of a frame is thus known as soon as it has been analyzed.
+ */
+static void update_gain_history_low_latency(DynamicAudioNormalizerContext *s,
+                                            int channel,
+                                            double current_gain_factor)
+{
+    cqueue *q = s->gain_history_original[channel];
+    double minimum, smoothed, oldest;
+    int i;
+
+    if (cqueue_empty(q)) {
+        const double initial = s->alt_boundary_mode ? current_gain_factor : 1.0;
+
+        s->prev_amplification_factor[channel] = initial;
+
+        while (cqueue_size(q) < s->filter_size - 1)
+            cqueue_enqueue(q, initial);
+
+        for (i = 0; i < 3; i++) {
+            while (cqueue_size(s->box_history[i][channel]) < s->box_size)
+                cqueue_enqueue(s->box_history[i][channel], initial);
+            s->box_sum[i][channel] = initial * s->box_size;
+        }
+    }
+
+    cqueue_enqueue(q, current_gain_factor);
+    minimum = minimum_filter(q);
+    cqueue_pop(q);
+
+    smoothed = minimum;
+    for (i = 0; i < 3; i++) {
+        cqueue_dequeue(s->box_history[i][channel], &oldest);
+        cqueue_enqueue(s->box_history[i][channel], smoothed);
+        s->box_sum[i][channel] += smoothed - oldest;
+        smoothed = s->box_sum[i][channel] / s->box_size;
+    }
+
+    // Without lookahead, only the minimum reacts to a louder frame in time
+    cqueue_enqueue(s->gain_history_smoothed[channel], FFMIN(smoothed, minimum));
+}
+
 static inline double update_value(double new, double old, double aggressiveness)
 {
     av_assert0((aggressiveness >= 0.0) && (aggressiveness <= 1.0));
@@ -527,26 +615,11 @@ static double setup_compress_thresh(double threshold)
 static double compute_frame_std_dev(DynamicAudioNormalizerContext *s,
                                     AVFrame *frame, int channel)
 {
-    double variance = 0.0;
-    int i, c;
-
-    if (channel == -1) {
-        for (c = 0; c < s->channels; c++) {
-            const double *data_ptr = (double *)frame->extended_data[c];
-
-            for (i = 0; i < frame->nb_samples; i++) {
-                variance += pow2(data_ptr[i]);  // Assume that MEAN is *zero*
-            }
-        }
-        variance /= (s->channels * frame->nb_samples) - 1;
-    } else {
-        const double *data_ptr = (double *)frame->extended_data[channel];
+    const int nb_channels = channel == -1 ? s->channels : 1;
+    double peak, variance;
 
-        for (i = 0; i < frame->nb_samples; i++) {
-            variance += pow2(data_ptr[i]);      // Assume that MEAN is *zero*
-        }
-        variance /= frame->nb_samples - 1;
-    }
+    frame_peak_energy(frame, channel, &peak, &variance); // Assume that MEAN is *zero*
+    variance /= (nb_channels * frame->nb_samples) - 1;
 
     return FFMAX(sqrt(variance), DBL_EPSILON);
 }
@@ -598,6 +671,9 @@ static void perform_compression(DynamicAudioNormalizerContext *s, AVFrame *frame
 
 static void analyze_frame(DynamicAudioNormalizerContext *s, AVFrame *frame)
 {
+    void (*update)(DynamicAudioNormalizerContext *s, int channel, double gain) =
+        s->low_latency ? update_gain_history_low_latency : update_gain_history;
+
     if (s->dc_correction) {
         perform_dc_correction(s, frame);
     }
@@ -611,12 +687,12 @@ static void analyze_frame(DynamicAudioNormalizerContext *s, AVFrame *frame)
         int c;
 
         for (c = 0; c < s->channels; c++)
-            update_gain_history(s, c, current_gain_factor);
+            update(s, c, current_gain_factor);
     } else {
         int c;
 
         for (c = 0; c < s->channels; c++)
-            update_gain_history(s, c, get_max_local_gain(s, frame, c));
+            update(s, c, get_max_local_gain(s, frame, c));
     }
 }
 
@@ -630,17 +706,19 @@ static void amplify_frame(DynamicAudioNormalizerContext *s, AVFrame *frame)
 
         cqueue_dequeue(s->gain_history_smoothed[c], &current_amplification_factor);
 
-        for (i = 0; i < frame->nb_samples; i++) {
-            const double amplification_factor = fade(s->prev_amplification_factor[c],
-                                                     current_amplification_factor, i,
-                                                     s->fade_factors);
-
-            dst_ptr[i] *= amplification_factor;
-
-            if (fabs(dst_ptr[i]) > s->peak_value)
-                dst_ptr[i] = copysign(s->peak_value, dst_ptr[i]);
+        if (current_amplification_factor == s->prev_amplification_factor[c]) {
+            s->fdsp->vector_dmul_scalar(dst_ptr, dst_ptr, current_amplification_factor,
+                                        FFALIGN(frame->nb_samples, 8));
+        } else {
+            for (i = 0; i < frame->nb_samples; i++)
+                dst_ptr[i] *= fade(s->prev_amplification_factor[c],
+                                   current_amplification_factor, i,
+                                   s->fade_factors);
         }
 
+        for (i = 0; i < frame->nb_samples; i++)
+            dst_ptr[i] = av_clipd(dst_ptr[i], -s->peak_value, s->peak_value);
+
         s->prev_amplification_factor[c] = current_amplification_factor;
     }
 }
@@ -652,6 +730,12 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     AVFilterLink *outlink = inlink->dst->outputs[0];
     int ret = 0;
 
+    if (s->low_latency) {
+        analyze_frame(s, in);
+        amplify_frame(s, in);
+        return ff_filter_frame(outlink, in);
+    }
+
     if (!cqueue_empty(s->gain_history_smoothed[0])) {
         AVFrame *out = ff_bufqueue_get(&s->queue);
 
@@ -23,6 +23,7 @@
 #include "libavutil/avassert.h"
 #include "libavcodec/avfft.h"
 #include "avfilter.h"
+#include "fftconv.h"
 #include "internal.h"
 #include "audio.h"
 
@@ -60,6 +61,7 @@ typedef struct {
     RDFTContext   *analysis_irdft;
     RDFTContext   *rdft;
     RDFTContext   *irdft;
+    FFTContext    *fft_ctx;
     int           analysis_rdft_len;
     int           rdft_len;
 
@@ -68,6 +70,7 @@ typedef struct {
     float         *kernel_buf;
     float         *conv_buf;
     OverlapIndex  *conv_idx;
+    FFTConvContext conv;
     int           fir_len;
     int           nsamples_max;
     int64_t       next_pts;
@@ -83,6 +86,8 @@ typedef struct {
     int           wfunc;
     int           fixed;
     int           multi;
+    int           fft2;
+    int           partition_size;
 
     int           nb_gain_entry;
     int           gain_entry_err;
@@ -109,6 +114,8 @@ static const AVOption firequalizer_options[] = {
         { "bharris", "blackman-harris window", 0, AV_OPT_TYPE_CONST, { .i64 = WFUNC_BHARRIS }, 0, 0, FLAGS, "wfunc" },
     { "fixed", "set fixed frame samples", OFFSET(fixed), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
     { "multi", "set multi channels mode", OFFSET(multi), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+    { "fft2", "set 2-channels fft", OFFSET(fft2), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+    { "partition_size", "set partition size of partitioned convolution", OFFSET(partition_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 32768, FLAGS },
     { NULL }
 };
 
@@ -119,7 +126,10 @@ static void common_uninit(FIREqualizerContext *s)
     av_rdft_end(s->analysis_irdft);
     av_rdft_end(s->rdft);
     av_rdft_end(s->irdft);
+    av_fft_end(s->fft_ctx);
+    ff_fftconv_uninit(&s->conv);
     s->analysis_irdft = s->rdft = s->irdft = NULL;
+    s->fft_ctx = NULL;
 
     av_freep(&s->analysis_buf);
     av_freep(&s->kernel_tmp_buf);
@@ -206,6 +216,78 @@ static void fast_convolute(FIREqualizerContext *s, const float *kernel_buf, floa
     }
 }
 
+/* convolute two channels at once, one in the real part and one in the
+ * imaginary part of a complex fft; this only works because the kernel is
+ * zero-phase, i.e. its spectrum is real and symmetric. data1 may be NULL. */
+static void fast_convolute2(FIREqualizerContext *s, const float *kernel_buf, FFTComplex *conv_buf,
+                            OverlapIndex *idx, float *data0, float *data1, int nsamples)
+{
+    if (nsamples <= s->nsamples_max) {
+        FFTComplex *buf = conv_buf + idx->buf_idx * s->rdft_len;
+        FFTComplex *obuf = conv_buf + !idx->buf_idx * s->rdft_len + idx->overlap_idx;
+        int center = s->fir_len / 2;
+        int k;
+        float tmp;
+
+        /* delay the input by center samples to compensate the zero-phase kernel */
+        memset(buf, 0, center * sizeof(*buf));
+        for (k = 0; k < nsamples; k++) {
+            buf[center + k].re = data0[k];
+            buf[center + k].im = data1 ? data1[k] : 0.0f;
+        }
+        memset(buf + center + nsamples, 0, (s->rdft_len - nsamples - center) * sizeof(*buf));
+        av_fft_permute(s->fft_ctx, buf);
+        av_fft_calc(s->fft_ctx, buf);
+
+        /* the inverse fft is done with the forward fft_ctx by swapping re and im,
+         * the kernel is normalized for rdft, hence the 0.5f */
+        tmp = buf[0].re;
+        buf[0].re = 0.5f * kernel_buf[0] * buf[0].im;
+        buf[0].im = 0.5f * kernel_buf[0] * tmp;
+        for (k = 1; k < s->rdft_len / 2; k++) {
+            int m = s->rdft_len - k;
+            tmp = buf[k].re;
+            buf[k].re = 0.5f * kernel_buf[k] * buf[k].im;
+            buf[k].im = 0.5f * kernel_buf[k] * tmp;
+            tmp = buf[m].re;
+            buf[m].re = 0.5f * kernel_buf[k] * buf[m].im;
+            buf[m].im = 0.5f * kernel_buf[k] * tmp;
+        }
+        tmp = buf[k].re;
+        buf[k].re = 0.5f * kernel_buf[k] * buf[k].im;
+        buf[k].im = 0.5f * kernel_buf[k] * tmp;
+
+        av_fft_permute(s->fft_ctx, buf);
+        av_fft_calc(s->fft_ctx, buf);
+
+        for (k = 0; k < s->rdft_len - idx->overlap_idx; k++) {
+            buf[k].re += obuf[k].re;
+            buf[k].im += obuf[k].im;
+        }
+
+        /* re and im are still swapped */
+        for (k = 0; k < nsamples; k++)
+            data0[k] = buf[k].im;
+        if (data1) {
+            for (k = 0; k < nsamples; k++)
+                data1[k] = buf[k].re;
+        }
+        idx->buf_idx = !idx->buf_idx;
+        idx->overlap_idx = nsamples;
+    } else {
+        while (nsamples > s->nsamples_max * 2) {
+            fast_convolute2(s, kernel_buf, conv_buf, idx, data0, data1, s->nsamples_max);
+            data0 += s->nsamples_max;
+            if (data1)
+                data1 += s->nsamples_max;
+            nsamples -= s->nsamples_max;
+        }
+        fast_convolute2(s, kernel_buf, conv_buf, idx, data0, data1, nsamples/2);
+        fast_convolute2(s, kernel_buf, conv_buf, idx, data0 + nsamples/2,
+                        data1 ? data1 + nsamples/2 : NULL, nsamples - nsamples/2);
+    }
+}
+
 static double entry_func(void *p, double freq, double gain)
 {
     AVFilterContext *ctx = p;
@@ -390,16 +472,39 @@ static int generate_kernel(AVFilterContext *ctx, const char *gain, const char *g
             s->analysis_buf[k] *= (2.0/s->analysis_rdft_len) * (2.0/s->rdft_len) * win;
         }
 
-        for (k = 0; k < center - k; k++) {
-            float tmp = s->analysis_buf[k];
-            s->analysis_buf[k] = s->analysis_buf[center - k];
-            s->analysis_buf[center - k] = tmp;
+        if (s->fft_ctx) {
+            /* zero-phase kernel, the delay is added to the input instead */
+            memset(s->analysis_buf + center + 1, 0, (s->rdft_len - s->fir_len) * sizeof(*s->analysis_buf));
+            for (k = 1; k <= center; k++)
+                s->analysis_buf[s->rdft_len - k] = s->analysis_buf[k];
+        } else {
+            for (k = 0; k < center - k; k++) {
+                float tmp = s->analysis_buf[k];
+                s->analysis_buf[k] = s->analysis_buf[center - k];
+                s->analysis_buf[center - k] = tmp;
+            }
+
+            for (k = 1; k <= center; k++)
+                s->analysis_buf[center + k] = s->analysis_buf[center - k];
+
+            memset(s->analysis_buf + s->fir_len, 0, (s->rdft_len - s->fir_len) * sizeof(*s->analysis_buf));
         }
 
-        for (k = 1; k <= center; k++)
-            s->analysis_buf[center + k] = s->analysis_buf[center - k];
+        if (s->partition_size) {
+            /* keep the taps, they are transformed per partition below */
+            for (k = 0; k < s->fir_len; k++) {
+                if (isnan(s->analysis_buf[k]) || isinf(s->analysis_buf[k])) {
+                    av_log(ctx, AV_LOG_ERROR, "filter kernel contains nan or infinity.\n");
+                    av_expr_free(gain_expr);
+                    return AVERROR(EINVAL);
+                }
+            }
+            memcpy(s->kernel_tmp_buf + ch * s->rdft_len, s->analysis_buf, s->fir_len * sizeof(*s->analysis_buf));
+            if (!s->multi)
+                break;
+            continue;
+        }
 
-        memset(s->analysis_buf + s->fir_len, 0, (s->rdft_len - s->fir_len) * sizeof(*s->analysis_buf));
         av_rdft_calc(s->rdft, s->analysis_buf);
 
         for (k = 0; k < s->rdft_len; k++) {
@@ -410,13 +515,33 @@ static int generate_kernel(AVFilterContext *ctx, const char *gain, const char *g
             }
         }
 
-        memcpy(s->kernel_tmp_buf + ch * s->rdft_len, s->analysis_buf, s->rdft_len * sizeof(*s->analysis_buf));
+        if (s->fft_ctx) {
+            /* only keep the real part of the spectrum */
+            s->kernel_tmp_buf[0] = s->analysis_buf[0];
+            for (k = 1; k < s->rdft_len / 2; k++)
+                s->kernel_tmp_buf[k] = s->analysis_buf[2*k];
+            s->kernel_tmp_buf[k] = s->analysis_buf[1];
+        } else {
+            memcpy(s->kernel_tmp_buf + ch * s->rdft_len, s->analysis_buf, s->rdft_len * sizeof(*s->analysis_buf));
+        }
         if (!s->multi)
             break;
     }
 
-    memcpy(s->kernel_buf, s->kernel_tmp_buf, (s->multi ? inlink->channels : 1) * s->rdft_len * sizeof(*s->kernel_buf));
     av_expr_free(gain_expr);
+
+    if (s->partition_size) {
+        /* the taps carry the 2 / rdft_len normalization of irdft */
+        for (ch = 0; ch < inlink->channels; ch++) {
+            ret = ff_fftconv_set_ir(&s->conv, ch, ch, s->kernel_tmp_buf + (s->multi ? ch * s->rdft_len : 0),
+                                    s->fir_len, 0.5f * s->rdft_len);
+            if (ret < 0)
+                return ret;
+        }
+        return 0;
+    }
+
+    memcpy(s->kernel_buf, s->kernel_tmp_buf, (s->multi ? inlink->channels : 1) * s->rdft_len * sizeof(*s->kernel_buf));
     return 0;
 }
 
@@ -446,8 +571,23 @@ static int config_input(AVFilterLink *inlink)
         return AVERROR(EINVAL);
     }
 
-    if (!(s->rdft = av_rdft_init(rdft_bits, DFT_R2C)) || !(s->irdft = av_rdft_init(rdft_bits, IDFT_C2R)))
-        return AVERROR(ENOMEM);
+    if (s->partition_size) {
+        int ret;
+
+        if (s->partition_size < 8 || s->partition_size & (s->partition_size - 1)) {
+            av_log(ctx, AV_LOG_ERROR, "partition_size must be a power of 2 not less than 8.\n");
+            return AVERROR(EINVAL);
+        }
+        if ((ret = ff_fftconv_init(&s->conv, s->partition_size, s->fir_len, inlink->channels, inlink->channels)) < 0)
+            return ret;
+        s->nsamples_max = s->partition_size;
+    } else {
+        if (!(s->rdft = av_rdft_init(rdft_bits, DFT_R2C)) || !(s->irdft = av_rdft_init(rdft_bits, IDFT_C2R)))
+            return AVERROR(ENOMEM);
+
+        if (s->fft2 && !s->multi && inlink->channels > 1 && !(s->fft_ctx = av_fft_init(rdft_bits, 0)))
+            return AVERROR(ENOMEM);
+    }
 
     for ( ; rdft_bits <= RDFT_BITS_MAX; rdft_bits++) {
         s->analysis_rdft_len = 1 << rdft_bits;
@@ -466,7 +606,8 @@ static int config_input(AVFilterLink *inlink)
     s->analysis_buf = av_malloc_array(s->analysis_rdft_len, sizeof(*s->analysis_buf));
     s->kernel_tmp_buf = av_malloc_array(s->rdft_len * (s->multi ? inlink->channels : 1), sizeof(*s->kernel_tmp_buf));
     s->kernel_buf = av_malloc_array(s->rdft_len * (s->multi ? inlink->channels : 1), sizeof(*s->kernel_buf));
-    s->conv_buf   = av_calloc(2 * s->rdft_len * inlink->channels, sizeof(*s->conv_buf));
+    /* with fft2, each pair of channels uses 2 * rdft_len complex values */
+    s->conv_buf   = av_calloc(2 * s->rdft_len * FFALIGN(inlink->channels, s->fft_ctx ? 2 : 1), sizeof(*s->conv_buf));
     s->conv_idx   = av_calloc(inlink->channels, sizeof(*s->conv_idx));
     if (!s->analysis_buf || !s->kernel_tmp_buf || !s->kernel_buf || !s->conv_buf || !s->conv_idx)
         return AVERROR(ENOMEM);
@@ -487,10 +628,34 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     FIREqualizerContext *s = ctx->priv;
     int ch;
 
-    for (ch = 0; ch < inlink->channels; ch++) {
-        fast_convolute(s, s->kernel_buf + (s->multi ? ch * s->rdft_len : 0),
-                       s->conv_buf + 2 * ch * s->rdft_len, s->conv_idx + ch,
-                       (float *) frame->extended_data[ch], frame->nb_samples);
+    if (s->partition_size) {
+        FFTConvContext *c = &s->conv;
+        int i, n;
+
+        for (i = 0; i < frame->nb_samples; i += n) {
+            n = FFMIN(frame->nb_samples - i, c->block_size - c->fill);
+            /* each channel only feeds its own output */
+            for (ch = 0; ch < inlink->channels; ch++) {
+                float *data = (float *) frame->extended_data[ch] + i;
+
+                ff_fftconv_input(c, ch, data, 1, n);
+                ff_fftconv_output(c, ch, data, 1, n);
+            }
+            ff_fftconv_advance(c, n);
+        }
+    } else if (s->fft_ctx) {
+        for (ch = 0; ch < inlink->channels; ch += 2) {
+            fast_convolute2(s, s->kernel_buf, (FFTComplex *)(s->conv_buf + 2 * ch * s->rdft_len),
+                            s->conv_idx + ch, (float *) frame->extended_data[ch],
+                            ch + 1 < inlink->channels ? (float *) frame->extended_data[ch+1] : NULL,
+                            frame->nb_samples);
+        }
+    } else {
+        for (ch = 0; ch < inlink->channels; ch++) {
+            fast_convolute(s, s->kernel_buf + (s->multi ? ch * s->rdft_len : 0),
+                           s->conv_buf + 2 * ch * s->rdft_len, s->conv_idx + ch,
+                           (float *) frame->extended_data[ch], frame->nb_samples);
+        }
     }
 
     s->next_pts = frame->pts + av_rescale_q(frame->nb_samples, av_make_q(1, inlink->sample_rate), inlink->time_base);
@@ -28,17 +28,20 @@
 #include <math.h>
 #include <netcdf.h>
 
-#include "libavcodec/avfft.h"
 #include "libavutil/float_dsp.h"
 #include "libavutil/intmath.h"
 #include "libavutil/opt.h"
 #include "avfilter.h"
 #include "internal.h"
 #include "audio.h"
+#include "fftconv.h"
 
 #define TIME_DOMAIN      0
 #define FREQUENCY_DOMAIN 1
 
+#define PARTITION_SIZE_MIN  256
+#define PARTITION_SIZE_MAX 4096
+
 typedef struct NCSofa {  /* contains data of one SOFA file */
     int ncid;            /* netCDF ID of the opened SOFA file */
     int n_samples;       /* length of one impulse response (IR) */
@@ -72,7 +75,8 @@ typedef struct SOFAlizerContext {
     int write[2];               /* current write position to ringbuffer */
     int buffer_length;          /* is: longest IR plus max. delay in all SOFA files */
                                 /* then choose next power of 2 */
-    int n_fft;                  /* number of samples in one FFT block */
+    FFTConvContext conv;        /* partitioned convolution of all input */
+                                /* channels to both ears (freq. domain) */
 
                                 /* netCDF variables */
     int *delay[2];              /* broadband delay for each channel/IR to be convolved */
@@ -80,7 +84,6 @@ typedef struct SOFAlizerContext {
     float *data_ir[2];          /* IRs for all channels to be convolved */
                                 /* (this excludes the LFE) */
     float *temp_src[2];
-    FFTComplex *temp_fft[2];
 
                          /* control variables */
     float gain;          /* filter gain (in dB) */
@@ -89,9 +92,6 @@ typedef struct SOFAlizerContext {
     float radius;        /* distance virtual loudspeakers to listener (in metres) */
     int type;            /* processing type */
 
-    FFTContext *fft[2], *ifft[2];
-    FFTComplex *data_hrtf[2];
-
     AVFloatDSPContext *fdsp;
 } SOFAlizerContext;
 
@@ -513,7 +513,8 @@ typedef struct ThreadData {
     int *n_clippings;
     float **ringbuffer;
     float **temp_src;
-    FFTComplex **temp_fft;
+    int offset;          /* first sample of the current block piece */
+    int nb_samples;      /* length of the current block piece */
 } ThreadData;
 
 static int sofalizer_convolute(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
@@ -602,117 +603,36 @@ static int sofalizer_convolute(AVFilterContext *ctx, void *arg, int jobnr, int n
     return 0;
 }
 
-static int sofalizer_fast_convolute(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static int sofalizer_fast_input(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     SOFAlizerContext *s = ctx->priv;
     ThreadData *td = arg;
-    AVFrame *in = td->in, *out = td->out;
-    int offset = jobnr;
-    int *write = &td->write[jobnr];
-    FFTComplex *hrtf = s->data_hrtf[jobnr]; /* get pointers to current HRTF data */
-    int *n_clippings = &td->n_clippings[jobnr];
-    float *ringbuffer = td->ringbuffer[jobnr];
-    const int n_samples = s->sofa.n_samples; /* length of one IR */
-    const float *src = (const float *)in->data[0]; /* get pointer to audio input buffer */
-    float *dst = (float *)out->data[0]; /* get pointer to audio output buffer */
     const int in_channels = s->n_conv; /* number of input channels */
-    /* ring buffer length is: longest IR plus max. delay -> next power of 2 */
-    const int buffer_length = s->buffer_length;
-    /* -1 for AND instead of MODULO (applied to powers of 2): */
-    const uint32_t modulo = (uint32_t)buffer_length - 1;
-    FFTComplex *fft_in = s->temp_fft[jobnr]; /* temporary array for FFT input/output data */
-    FFTContext *ifft = s->ifft[jobnr];
-    FFTContext *fft = s->fft[jobnr];
-    const int n_conv = s->n_conv;
-    const int n_fft = s->n_fft;
-    int wr = *write;
-    int n_read;
-    int i, j;
-
-    dst += offset;
-
-    /* find minimum between number of samples and output buffer length:
-     * (important, if one IR is longer than the output buffer) */
-    n_read = FFMIN(s->sofa.n_samples, in->nb_samples);
-    for (j = 0; j < n_read; j++) {
-        /* initialize output buf with saved signal from overflow buf */
-        dst[2 * j]     = ringbuffer[wr];
-        ringbuffer[wr] = 0.0; /* re-set read samples to zero */
-        /* update ringbuffer read/write position */
-        wr  = (wr + 1) & modulo;
-    }
-
-    /* initialize rest of output buffer with 0 */
-    for (j = n_read; j < in->nb_samples; j++) {
-        dst[2 * j] = 0;
-    }
-
-    for (i = 0; i < n_conv; i++) {
-        if (i == s->lfe_channel) { /* LFE */
-            for (j = 0; j < in->nb_samples; j++) {
-                /* apply gain to LFE signal and add to output buffer */
-                dst[2 * j] += src[i + j * in_channels] * s->gain_lfe;
-            }
-            continue;
-        }
-
-        /* outer loop: go through all input channels to be convolved */
-        offset = i * n_fft; /* no. samples already processed */
-
-        /* fill FFT input with 0 (we want to zero-pad) */
-        memset(fft_in, 0, sizeof(FFTComplex) * n_fft);
-
-        for (j = 0; j < in->nb_samples; j++) {
-            /* prepare input for FFT */
-            /* write all samples of current input channel to FFT input array */
-            fft_in[j].re = src[j * in_channels + i];
-        }
-
-        /* transform input signal of current channel to frequency domain */
-        av_fft_permute(fft, fft_in);
-        av_fft_calc(fft, fft_in);
-        for (j = 0; j < n_fft; j++) {
-            const float re = fft_in[j].re;
-            const float im = fft_in[j].im;
-
-            /* complex multiplication of input signal and HRTFs */
-            /* output channel (real): */
-            fft_in[j].re = re * (hrtf + offset + j)->re - im * (hrtf + offset + j)->im;
-            /* output channel (imag): */
-            fft_in[j].im = re * (hrtf + offset + j)->im + im * (hrtf + offset + j)->re;
-        }
+    const float *src = (const float *)td->in->data[0] + td->offset * in_channels;
 
-        /* transform output signal of current channel back to time domain */
-        av_fft_permute(ifft, fft_in);
-        av_fft_calc(ifft, fft_in);
+    /* transform one input channel, the spectrum is shared by both ears */
+    ff_fftconv_input(&s->conv, jobnr, src + jobnr, in_channels, td->nb_samples);
 
-        for (j = 0; j < in->nb_samples; j++) {
-            /* write output signal of current channel to output buffer */
-            dst[2 * j] += fft_in[j].re / (float)n_fft;
-        }
+    return 0;
+}
 
-        for (j = 0; j < n_samples - 1; j++) { /* overflow length is IR length - 1 */
-            /* write the rest of output signal to overflow buffer */
-            int write_pos = (wr + j) & modulo;
+static int sofalizer_fast_output(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    SOFAlizerContext *s = ctx->priv;
+    ThreadData *td = arg;
+    int *n_clippings = &td->n_clippings[jobnr];
+    float *dst = (float *)td->out->data[0] + 2 * td->offset + jobnr;
+    int i;
 
-            *(ringbuffer + write_pos) += fft_in[in->nb_samples + j].re / (float)n_fft;
-        }
-    }
+    /* sum the contributions of all input channels to this ear */
+    ff_fftconv_output(&s->conv, jobnr, dst, 2, td->nb_samples);
 
     /* go through all samples of current output buffer: count clippings */
-    for (i = 0; i < out->nb_samples; i++) {
-        /* clippings counter */
-        if (fabs(*dst) > 1) { /* if current output sample > 1 */
+    for (i = 0; i < td->nb_samples; i++) {
+        if (fabs(dst[2 * i]) > 1)
             *n_clippings = *n_clippings + 1;
-        }
-
-        /* move output buffer pointer by +2 to get to next sample of processed channel: */
-        dst += 2;
     }
 
-    /* remember read/write position in ringbuffer for next call */
-    *write = wr;
-
     return 0;
 }
 
@@ -735,12 +655,20 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     td.in = in; td.out = out; td.write = s->write;
     td.delay = s->delay; td.ir = s->data_ir; td.n_clippings = n_clippings;
     td.ringbuffer = s->ringbuffer; td.temp_src = s->temp_src;
-    td.temp_fft = s->temp_fft;
 
     if (s->type == TIME_DOMAIN) {
         ctx->internal->execute(ctx, sofalizer_convolute, &td, NULL, 2);
     } else {
-        ctx->internal->execute(ctx, sofalizer_fast_convolute, &td, NULL, 2);
+        int n;
+
+        /* split the frame at the partition boundaries */
+        for (td.offset = 0; td.offset < in->nb_samples; td.offset += n) {
+            n = FFMIN(in->nb_samples - td.offset, s->conv.block_size - s->conv.fill);
+            td.nb_samples = n;
+            ctx->internal->execute(ctx, sofalizer_fast_input, &td, NULL, s->n_conv);
+            ctx->internal->execute(ctx, sofalizer_fast_output, &td, NULL, 2);
+            ff_fftconv_advance(&s->conv, n);
+        }
     }
     emms_c();
 
@@ -797,20 +725,17 @@ static int load_data(AVFilterContext *ctx, int azim, int elev, float radius)
     struct SOFAlizerContext *s = ctx->priv;
     const int n_samples = s->sofa.n_samples;
     int n_conv = s->n_conv; /* no. channels to convolve */
-    int n_fft = s->n_fft;
     int delay_l[16]; /* broadband delay for each IR */
     int delay_r[16];
     int nb_input_channels = ctx->inputs[0]->channels; /* no. input channels */
     float gain_lin = expf((s->gain - 3 * nb_input_channels) / 20 * M_LN10); /* gain - 3dB/channel */
-    FFTComplex *data_hrtf_l = NULL;
-    FFTComplex *data_hrtf_r = NULL;
-    FFTComplex *fft_in_l = NULL;
-    FFTComplex *fft_in_r = NULL;
+    float *ir_in_l = NULL;
+    float *ir_in_r = NULL;
     float *data_ir_l = NULL;
     float *data_ir_r = NULL;
     int offset = 0; /* used for faster pointer arithmetics in for-loop */
     int m[16]; /* measurement index m of IR closest to required source positions */
-    int i, j, azim_orig = azim, elev_orig = elev;
+    int i, j, ret, azim_orig = azim, elev_orig = elev;
 
     if (!s->sofa.ncid) { /* if an invalid SOFA file has been selected */
         av_log(ctx, AV_LOG_ERROR, "Selected SOFA file is invalid. Please select valid SOFA file.\n");
@@ -830,12 +755,12 @@ static int load_data(AVFilterContext *ctx, int azim, int elev, float radius)
             return AVERROR(ENOMEM);
         }
     } else {
-        /* get temporary HRTF memory for L and R channel */
-        data_hrtf_l = av_malloc_array(n_fft, sizeof(*data_hrtf_l) * n_conv);
-        data_hrtf_r = av_malloc_array(n_fft, sizeof(*data_hrtf_r) * n_conv);
-        if (!data_hrtf_r || !data_hrtf_l) {
-            av_free(data_hrtf_l);
-            av_free(data_hrtf_r);
+        /* get temporary IR memory for L and R channel, including the delay */
+        ir_in_l = av_malloc_array(s->buffer_length, sizeof(*ir_in_l));
+        ir_in_r = av_malloc_array(s->buffer_length, sizeof(*ir_in_r));
+        if (!ir_in_l || !ir_in_r) {
+            av_free(ir_in_l);
+            av_free(ir_in_r);
             return AVERROR(ENOMEM);
         }
     }
@@ -861,36 +786,29 @@ static int load_data(AVFilterContext *ctx, int azim, int elev, float radius)
                 *(data_ir_r + offset + j) = /* right channel */
                 *(s->sofa.data_ir + 2 * m[i] * n_samples + n_samples - 1 - j  + n_samples) * gain_lin;
             }
+        } else if (i == s->lfe_channel) {
+            /* LFE is an input channel but requires no convolution */
+            /* apply gain to LFE signal and add it to both ears */
+            if ((ret = ff_fftconv_set_ir(&s->conv, i, 0, &s->gain_lfe, 1, 1.f)) < 0 ||
+                (ret = ff_fftconv_set_ir(&s->conv, i, 1, &s->gain_lfe, 1, 1.f)) < 0)
+                goto fail;
         } else {
-            fft_in_l = av_calloc(n_fft, sizeof(*fft_in_l));
-            fft_in_r = av_calloc(n_fft, sizeof(*fft_in_r));
-            if (!fft_in_l || !fft_in_r) {
-                av_free(data_hrtf_l);
-                av_free(data_hrtf_r);
-                av_free(fft_in_l);
-                av_free(fft_in_r);
-                return AVERROR(ENOMEM);
-            }
-
-            offset = i * n_fft; /* no. samples already written */
+            memset(ir_in_l, 0, s->buffer_length * sizeof(*ir_in_l));
+            memset(ir_in_r, 0, s->buffer_length * sizeof(*ir_in_r));
             for (j = 0; j < n_samples; j++) {
                 /* load non-reversed IRs of the specified source position
                  * sample-by-sample and apply gain,
-                 * L channel is loaded to real part, R channel to imag part,
-                 * IRs ared shifted by L and R delay */
-                fft_in_l[delay_l[i] + j].re = /* left channel */
+                 * IRs are shifted by L and R delay */
+                ir_in_l[delay_l[i] + j] = /* left channel */
                 *(s->sofa.data_ir + 2 * m[i] * n_samples + j) * gain_lin;
-                fft_in_r[delay_r[i] + j].re = /* right channel */
+                ir_in_r[delay_r[i] + j] = /* right channel */
                 *(s->sofa.data_ir + (2 * m[i] + 1) * n_samples + j) * gain_lin;
             }
 
-            /* actually transform to frequency domain (IRs -> HRTFs) */
-            av_fft_permute(s->fft[0], fft_in_l);
-            av_fft_calc(s->fft[0], fft_in_l);
-            memcpy(data_hrtf_l + offset, fft_in_l, n_fft * sizeof(*fft_in_l));
-            av_fft_permute(s->fft[0], fft_in_r);
-            av_fft_calc(s->fft[0], fft_in_r);
-            memcpy(data_hrtf_r + offset, fft_in_r, n_fft * sizeof(*fft_in_r));
+            /* split into partitions and transform (IRs -> HRTFs) */
+            if ((ret = ff_fftconv_set_ir(&s->conv, i, 0, ir_in_l, delay_l[i] + n_samples, 1.f)) < 0 ||
+                (ret = ff_fftconv_set_ir(&s->conv, i, 1, ir_in_r, delay_r[i] + n_samples, 1.f)) < 0)
+                goto fail;
         }
 
         av_log(ctx, AV_LOG_DEBUG, "Index: %d, Azimuth: %f, Elevation: %f, Radius: %f of SOFA file.\n",
@@ -905,32 +823,18 @@ static int load_data(AVFilterContext *ctx, int azim, int elev, float radius)
         av_freep(&data_ir_l); /* free temporary IR memory */
         av_freep(&data_ir_r);
     } else {
-        s->data_hrtf[0] = av_malloc_array(n_fft * s->n_conv, sizeof(FFTComplex));
-        s->data_hrtf[1] = av_malloc_array(n_fft * s->n_conv, sizeof(FFTComplex));
-        if (!s->data_hrtf[0] || !s->data_hrtf[1]) {
-            av_freep(&data_hrtf_l);
-            av_freep(&data_hrtf_r);
-            av_freep(&fft_in_l);
-            av_freep(&fft_in_r);
-            return AVERROR(ENOMEM); /* memory allocation failed */
-        }
-
-        memcpy(s->data_hrtf[0], data_hrtf_l, /* copy HRTF data to */
-            sizeof(FFTComplex) * n_conv * n_fft); /* filter struct */
-        memcpy(s->data_hrtf[1], data_hrtf_r,
-            sizeof(FFTComplex) * n_conv * n_fft);
-
-        av_freep(&data_hrtf_l); /* free temporary HRTF memory */
-        av_freep(&data_hrtf_r);
-
-        av_freep(&fft_in_l); /* free temporary FFT memory */
-        av_freep(&fft_in_r);
+        av_freep(&ir_in_l); /* free temporary IR memory */
+        av_freep(&ir_in_r);
     }
 
     memcpy(s->delay[0], &delay_l[0], sizeof(int) * s->n_conv);
     memcpy(s->delay[1], &delay_r[0], sizeof(int) * s->n_conv);
 
     return 0;
+fail:
+    av_freep(&ir_in_l);
+    av_freep(&ir_in_r);
+    return ret;
 }
 
 static av_cold int init(AVFilterContext *ctx)
@@ -978,12 +882,6 @@ static int config_input(AVFilterLink *inlink)
     int n_max = 0;
     int ret;
 
-    if (s->type == FREQUENCY_DOMAIN) {
-        inlink->partial_buf_size =
-        inlink->min_samples =
-        inlink->max_samples = inlink->sample_rate;
-    }
-
     /* gain -3 dB per channel, -6 dB to get LFE on a similar level */
     s->gain_lfe = expf((s->gain - 3 * inlink->channels - 6) / 20 * M_LN10);
 
@@ -1001,21 +899,16 @@ static int config_input(AVFilterLink *inlink)
     /* buffer length is longest IR plus max. delay -> next power of 2
        (32 - count leading zeros gives required exponent)  */
     s->buffer_length = 1 << (32 - ff_clz(n_max));
-    s->n_fft         = 1 << (32 - ff_clz(n_max + inlink->sample_rate));
 
     if (s->type == FREQUENCY_DOMAIN) {
-        av_fft_end(s->fft[0]);
-        av_fft_end(s->fft[1]);
-        s->fft[0] = av_fft_init(log2(s->n_fft), 0);
-        s->fft[1] = av_fft_init(log2(s->n_fft), 0);
-        av_fft_end(s->ifft[0]);
-        av_fft_end(s->ifft[1]);
-        s->ifft[0] = av_fft_init(log2(s->n_fft), 1);
-        s->ifft[1] = av_fft_init(log2(s->n_fft), 1);
-
-        if (!s->fft[0] || !s->fft[1] || !s->ifft[0] || !s->ifft[1]) {
-            av_log(ctx, AV_LOG_ERROR, "Unable to create FFT contexts of size %d.\n", s->n_fft);
-            return AVERROR(ENOMEM);
+        /* a single partition for usual HRIRs, long ones are partitioned */
+        int partition_size = av_clip(s->buffer_length, PARTITION_SIZE_MIN, PARTITION_SIZE_MAX);
+
+        ff_fftconv_uninit(&s->conv);
+        ret = ff_fftconv_init(&s->conv, partition_size, n_max, s->n_conv, 2);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Unable to create FFT contexts of size %d.\n", 2 * partition_size);
+            return ret;
         }
     }
 
@@ -1027,18 +920,13 @@ static int config_input(AVFilterLink *inlink)
     s->delay[0] = av_malloc_array(s->n_conv, sizeof(float));
     s->delay[1] = av_malloc_array(s->n_conv, sizeof(float));
     /* length: (buffer length) * (number of input channels),
-     * OR: buffer length (if frequency domain processing)
+     * only needed for time domain processing
      * calloc zero-initializes the buffer */
 
     if (s->type == TIME_DOMAIN) {
         s->ringbuffer[0] = av_calloc(s->buffer_length, sizeof(float) * nb_input_channels);
         s->ringbuffer[1] = av_calloc(s->buffer_length, sizeof(float) * nb_input_channels);
-    } else {
-        s->ringbuffer[0] = av_calloc(s->buffer_length, sizeof(float));
-        s->ringbuffer[1] = av_calloc(s->buffer_length, sizeof(float));
-        s->temp_fft[0] = av_malloc_array(s->n_fft, sizeof(FFTComplex));
-        s->temp_fft[1] = av_malloc_array(s->n_fft, sizeof(FFTComplex));
-        if (!s->temp_fft[0] || !s->temp_fft[1])
+        if (!s->ringbuffer[0] || !s->ringbuffer[1])
             return AVERROR(ENOMEM);
     }
 
@@ -1048,7 +936,7 @@ static int config_input(AVFilterLink *inlink)
 
     /* memory allocation failed: */
     if (!s->data_ir[0] || !s->data_ir[1] || !s->delay[1] ||
-        !s->delay[0] || !s->ringbuffer[0] || !s->ringbuffer[1] ||
+        !s->delay[0] ||
         !s->speaker_azim || !s->speaker_elev)
         return AVERROR(ENOMEM);
 
@@ -1081,10 +969,7 @@ static av_cold void uninit(AVFilterContext *ctx)
         av_freep(&s->sofa.data_delay);
         av_freep(&s->sofa.data_ir);
     }
-    av_fft_end(s->ifft[0]);
-    av_fft_end(s->ifft[1]);
-    av_fft_end(s->fft[0]);
-    av_fft_end(s->fft[1]);
+    ff_fftconv_uninit(&s->conv);
     av_freep(&s->delay[0]);
     av_freep(&s->delay[1]);
     av_freep(&s->data_ir[0]);
@@ -1095,10 +980,6 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->speaker_elev);
     av_freep(&s->temp_src[0]);
     av_freep(&s->temp_src[1]);
-    av_freep(&s->temp_fft[0]);
-    av_freep(&s->temp_fft[1]);
-    av_freep(&s->data_hrtf[0]);
-    av_freep(&s->data_hrtf[1]);
     av_freep(&s->fdsp);
 }
 
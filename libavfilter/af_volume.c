@@ -221,7 +221,7 @@ static inline void scale_samples_s32(uint8_t *dst, const uint8_t *src,
         smp_dst[i] = av_clipl_int32((((int64_t)smp_src[i] * volume + 128) >> 8));
 }
 
-static av_cold void volume_init(VolumeContext *vol)
+av_cold void ff_volume_init(VolumeContext *vol)
 {
     vol->samples_align = 1;
 
@@ -281,7 +281,7 @@ static int set_volume(AVFilterContext *ctx)
     av_log(ctx, AV_LOG_VERBOSE, "volume:%f volume_dB:%f\n",
            vol->volume, 20.0*log10(vol->volume));
 
-    volume_init(vol);
+    ff_volume_init(vol);
     return 0;
 }
 
@@ -381,7 +381,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *buf)
                 vol->volume = FFMIN(vol->volume, 1.0 / p);
             vol->volume_i = (int)(vol->volume * 256 + 0.5);
 
-            volume_init(vol);
+            ff_volume_init(vol);
         }
         av_frame_remove_side_data(buf, AV_FRAME_DATA_REPLAYGAIN);
     }
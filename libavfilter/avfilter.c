@@ -29,10 +29,12 @@
 #include "libavutil/hwcontext.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
+#include "libavutil/mem_internal.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/time.h"
 
 #include "audio.h"
 #include "avfilter.h"
@@ -513,17 +515,31 @@ int avfilter_process_command(AVFilterContext *filter, const char *cmd, const cha
 static AVFilter *first_filter;
 static AVFilter **last_filter = &first_filter;
 
+/* the filters are also chained in hash buckets by name, in registration
+ * order, so that avfilter_get_by_name() only walks one bucket */
+#define FILTER_HASH_SIZE 256
+static AVFilter *filter_by_name[FILTER_HASH_SIZE];
+
+static unsigned filter_name_hash(const char *name)
+{
+    unsigned h = 2166136261U;
+
+    while (*name)
+        h = (h ^ (uint8_t)*name++) * 16777619U;
+    return h & (FILTER_HASH_SIZE - 1);
+}
+
 #if !FF_API_NOCONST_GET_NAME
 const
 #endif
 AVFilter *avfilter_get_by_name(const char *name)
 {
-    const AVFilter *f = NULL;
+    const AVFilter *f;
 
     if (!name)
         return NULL;
 
-    while ((f = avfilter_next(f)))
+    for (f = filter_by_name[filter_name_hash(name)]; f; f = f->next_by_name)
         if (!strcmp(f->name, name))
             return (AVFilter *)f;
 
@@ -543,6 +559,11 @@ int avfilter_register(AVFilter *filter)
         f = &(*f)->next;
     last_filter = &filter->next;
 
+    filter->next_by_name = NULL;
+    f = &filter_by_name[filter_name_hash(filter->name)];
+    while (*f || avpriv_atomic_ptr_cas((void * volatile *)f, NULL, filter))
+        f = &(*f)->next_by_name;
+
     return 0;
 }
 
@@ -613,8 +634,9 @@ static const AVClass *filter_child_class_next(const AVClass *prev)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM
 static const AVOption avfilter_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
-        { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
+        { .i64 = AVFILTER_THREAD_SLICE | AVFILTER_THREAD_BRANCH }, 0, INT_MAX, FLAGS, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .unit = "thread_type" },
+        { "branch", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_BRANCH }, .unit = "thread_type" },
     { "enable", "set enable expression", OFFSET(enable_str), AV_OPT_TYPE_STRING, {.str=NULL}, .flags = FLAGS },
     { NULL },
 };
@@ -775,6 +797,7 @@ void avfilter_free(AVFilterContext *filter)
     av_expr_free(filter->enable);
     filter->enable = NULL;
     av_freep(&filter->var_values);
+    av_freep(&filter->internal->branch_rets);
     av_freep(&filter->internal);
     av_free(filter);
 }
@@ -864,9 +887,9 @@ int avfilter_init_filter(AVFilterContext *filter, const char *args, void *opaque
 }
 #endif
 
-int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
+static int init_dict(AVFilterContext *ctx, AVDictionary **options)
 {
-    int ret = 0;
+    int ret = 0, thread_type;
 
     ret = av_opt_set_dict(ctx, options);
     if (ret < 0) {
@@ -874,14 +897,17 @@ int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
         return ret;
     }
 
+    thread_type      = ctx->thread_type & ctx->graph->thread_type;
+    ctx->thread_type = 0;
     if (ctx->filter->flags & AVFILTER_FLAG_SLICE_THREADS &&
-        ctx->thread_type & ctx->graph->thread_type & AVFILTER_THREAD_SLICE &&
+        thread_type & AVFILTER_THREAD_SLICE &&
         ctx->graph->internal->thread_execute) {
-        ctx->thread_type       = AVFILTER_THREAD_SLICE;
+        ctx->thread_type      |= AVFILTER_THREAD_SLICE;
         ctx->internal->execute = ctx->graph->internal->thread_execute;
-    } else {
-        ctx->thread_type = 0;
     }
+    if (thread_type & AVFILTER_THREAD_BRANCH &&
+        ctx->graph->internal->branch_execute)
+        ctx->thread_type |= AVFILTER_THREAD_BRANCH;
 
     if (ctx->filter->priv_class) {
         ret = av_opt_set_dict(ctx->priv, options);
@@ -901,6 +927,14 @@ int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
     return ret;
 }
 
+int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
+{
+    void *mem_ctx = avpriv_mem_enter(ctx->graph);
+    int ret = init_dict(ctx, options);
+    av_mem_set_context(mem_ctx);
+    return ret;
+}
+
 int avfilter_init_str(AVFilterContext *filter, const char *args)
 {
     AVDictionary *options = NULL;
@@ -1035,6 +1069,19 @@ static int default_filter_frame(AVFilterLink *link, AVFrame *frame)
     return ff_filter_frame(link->dst->outputs[0], frame);
 }
 
+/* Only read before and after the filter_frame() callback of ctx: branch
+ * threads filtering the frames of its outputs are done by then. */
+static int64_t outputs_frame_time(AVFilterContext *ctx)
+{
+    int64_t total = 0;
+    unsigned i;
+
+    for (i = 0; i < ctx->nb_outputs; i++)
+        if (ctx->outputs[i])
+            total += ctx->outputs[i]->frame_time;
+    return total;
+}
+
 static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
 {
     int (*filter_frame)(AVFilterLink *, AVFrame *);
@@ -1120,7 +1167,19 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
             (dstctx->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC))
             filter_frame = default_filter_frame;
     }
-    ret = filter_frame(link, out);
+    if (dstctx->graph && dstctx->graph->filter_frame_time) {
+        int64_t downstream = outputs_frame_time(dstctx);
+        int64_t start      = av_gettime_relative();
+        int64_t elapsed;
+
+        ret = filter_frame(link, out);
+        elapsed = av_gettime_relative() - start;
+        link->frame_time += elapsed;
+        downstream = outputs_frame_time(dstctx) - downstream;
+        dstctx->graph->filter_frame_time(dstctx, FFMAX(elapsed - downstream, 0));
+    } else {
+        ret = filter_frame(link, out);
+    }
     link->frame_count++;
     ff_update_link_current_pts(link, pts);
     return ret;
@@ -1225,6 +1284,107 @@ error:
     return AVERROR_PATCHWELCOME;
 }
 
+static int add_downstream_filters(AVFilterContext *f, AVFilterContext ***filters,
+                                  int *nb_filters)
+{
+    int i, j, ret;
+
+    for (i = 0; i < *nb_filters; i++)
+        if ((*filters)[i] == f)
+            return 0;
+    if ((ret = av_dynarray_add_nofree(filters, nb_filters, f)) < 0)
+        return ret;
+    for (j = 0; j < f->nb_outputs; j++)
+        if (f->outputs[j] &&
+            (ret = add_downstream_filters(f->outputs[j]->dst, filters, nb_filters)) < 0)
+            return ret;
+    return 0;
+}
+
+/* return 1 if the outputs of ctx lead to disjoint sets of filters, 0 if not */
+static int check_branches_disjoint(AVFilterContext *ctx)
+{
+    AVFilterContext **seen = NULL, **branch = NULL;
+    int nb_seen = 0, nb_branch, i, j, k, ret = 1;
+
+    for (i = 0; i < ctx->nb_outputs && ret > 0; i++) {
+        if (!ctx->outputs[i])
+            continue;
+        nb_branch = 0;
+        ret = add_downstream_filters(ctx->outputs[i]->dst, &branch, &nb_branch);
+        for (j = 0; j < nb_branch && ret > 0; j++)
+            for (k = 0; k < nb_seen; k++)
+                if (branch[j] == seen[k])
+                    ret = 0;
+        for (j = 0; j < nb_branch && ret > 0; j++)
+            if (av_dynarray_add_nofree(&seen, &nb_seen, branch[j]) < 0)
+                ret = AVERROR(ENOMEM);
+        av_freep(&branch);
+    }
+    av_freep(&seen);
+    return ret;
+}
+
+static int filter_frame_branch(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    AVFrame **frames = arg;
+
+    if (!frames[jobnr])
+        return 0;
+    return ff_filter_frame(ctx->outputs[jobnr], frames[jobnr]);
+}
+
+int ff_filter_frame_branches(AVFilterContext *ctx, AVFrame **frames)
+{
+    int i, ret = 0, nb_frames = 0;
+
+    for (i = 0; i < ctx->nb_outputs; i++)
+        nb_frames += !!frames[i];
+
+    if (ctx->thread_type & AVFILTER_THREAD_BRANCH && nb_frames > 1) {
+        AVFilterInternal *internal = ctx->internal;
+
+        if (!internal->branches_disjoint) {
+            ret = check_branches_disjoint(ctx);
+            if (ret > 0) {
+                internal->branch_rets = av_malloc_array(ctx->nb_outputs,
+                                                        sizeof(*internal->branch_rets));
+                if (!internal->branch_rets)
+                    ret = AVERROR(ENOMEM);
+            }
+            if (ret < 0)
+                goto fail;
+            if (!ret)
+                av_log(ctx, AV_LOG_VERBOSE, "Outputs are not independent, "
+                       "processing them in order.\n");
+            internal->branches_disjoint = ret ? 1 : -1;
+            ret = 0;
+        }
+        if (internal->branches_disjoint > 0 &&
+            ctx->graph->internal->branch_execute(ctx, filter_frame_branch, frames,
+                                                 internal->branch_rets,
+                                                 ctx->nb_outputs) >= 0) {
+            for (i = 0; i < ctx->nb_outputs; i++)
+                if (internal->branch_rets[i] < 0)
+                    return internal->branch_rets[i];
+            return 0;
+        }
+    }
+
+    for (i = 0; i < ctx->nb_outputs; i++) {
+        if (!frames[i])
+            continue;
+        ret = ff_filter_frame(ctx->outputs[i], frames[i]);
+        frames[i] = NULL;
+        if (ret < 0)
+            break;
+    }
+fail:
+    for (i = 0; i < ctx->nb_outputs; i++)
+        av_frame_free(&frames[i]);
+    return ret;
+}
+
 const AVClass *avfilter_get_class(void)
 {
     return &avfilter_class;
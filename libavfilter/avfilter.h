@@ -39,6 +39,7 @@
 #include "libavutil/avutil.h"
 #include "libavutil/buffer.h"
 #include "libavutil/dict.h"
+#include "libavutil/executor.h"
 #include "libavutil/frame.h"
 #include "libavutil/log.h"
 #include "libavutil/samplefmt.h"
@@ -292,6 +293,12 @@ typedef struct AVFilter {
      * used for providing binary data.
      */
     int (*init_opaque)(AVFilterContext *ctx, void *opaque);
+
+    /**
+     * Next filter with the same name hash, used by avfilter_get_by_name().
+     * Must not be touched by any other code.
+     */
+    struct AVFilter *next_by_name;
 } AVFilter;
 
 /**
@@ -299,6 +306,12 @@ typedef struct AVFilter {
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Process the outputs of filters duplicating their input, such as split,
+ * concurrently when they lead to disjoint parts of the graph.
+ */
+#define AVFILTER_THREAD_BRANCH (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
@@ -541,6 +554,13 @@ struct AVFilterLink {
      * cleared when a frame is filtered.
      */
     int frame_wanted_out;
+
+    /**
+     * Time spent filtering the frames sent through the link, by the
+     * destination filter and the filters after it, in microseconds.
+     * Only updated when AVFilterGraph.filter_frame_time is set.
+     */
+    int64_t frame_time;
 };
 
 /**
@@ -778,7 +798,9 @@ typedef struct AVFilterGraph {
      * of AVFILTER_THREAD_* flags.
      *
      * May be set by the caller at any point, the setting will apply to all
-     * filters initialized after that. The default is allowing everything.
+     * filters initialized after that. The default is allowing everything
+     * but AVFILTER_THREAD_BRANCH, which must be set before adding any filters
+     * to the graph.
      *
      * When a filter in this graph is initialized, this field is combined using
      * bit AND with AVFilterContext.thread_type to get the final mask used for
@@ -822,6 +844,39 @@ typedef struct AVFilterGraph {
 
     char *aresample_swr_opts; ///< swr options to use for the auto-inserted aresample filters, Access ONLY through AVOptions
 
+    /**
+     * If set, called each time the filter_frame() callback of a filter of
+     * the graph returns, with the time spent in it in microseconds, minus the
+     * time spent in the filter_frame() callbacks of the filters it passed
+     * frames to. It may be called from several threads at once, for different
+     * filters, when branch threading is used.
+     *
+     * May be set by the caller before sending frames to the graph.
+     */
+    void (*filter_frame_time)(AVFilterContext *filter, int64_t time);
+
+    /**
+     * CPUs the threads of the graph are restricted to, in the format
+     * described for av_cpu_affinity_count(), e.g. "0-7" or "node1". When set,
+     * the automatic thread count is the number of CPUs of the set plus one.
+     * May be set by the caller before adding any filters to the filtergraph.
+     */
+    char *thread_affinity;
+
+    /**
+     * If set, slice threading runs the jobs of the filters on the threads
+     * of this executor, which may be shared with other filtergraphs and
+     * codec contexts, instead of starting threads of its own. With an
+     * automatic thread count, the graph uses as many threads as the executor
+     * plus the calling thread. Branch threading still uses threads of its
+     * own.
+     *
+     * The executor is owned by the caller and must stay valid until the
+     * filtergraph is freed.
+     * May be set by the caller before adding any filters to the filtergraph.
+     */
+    AVExecutor *executor;
+
     /**
      * Private fields
      *
@@ -1075,7 +1130,9 @@ int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const
  * Dump a graph into a human-readable string representation.
  *
  * @param graph    the graph to dump
- * @param options  formatting options; currently ignored
+ * @param options  formatting options, a comma-separated list of flags;
+ *                 "timing" appends the time spent in each stage of the
+ *                 format negotiation by the last avfilter_graph_config()
  * @return  a string, or NULL in case of memory allocation failure;
  *          the string must be freed using av_free
  */
@@ -29,8 +29,10 @@
 #include "libavutil/bprint.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/internal.h"
+#include "libavutil/mem_internal.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
 
 #include "avfilter.h"
 #include "formats.h"
@@ -43,8 +45,11 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = FLAGS, .unit = "thread_type" },
+        { "branch", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_BRANCH }, .flags = FLAGS, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { "thread_affinity", "Restrict the threads to a set of CPUs", OFFSET(thread_affinity),
+        AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, FLAGS },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FLAGS },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
@@ -87,6 +92,7 @@ AVFilterGraph *avfilter_graph_alloc(void)
 
     ret->av_class = &filtergraph_class;
     av_opt_set_defaults(ret);
+    ff_mutex_init(&ret->internal->sink_links_lock, NULL);
 
     return ret;
 }
@@ -113,14 +119,17 @@ void avfilter_graph_free(AVFilterGraph **graph)
         avfilter_free((*graph)->filters[0]);
 
     ff_graph_thread_free(*graph);
+    ff_mutex_destroy(&(*graph)->internal->sink_links_lock);
 
     av_freep(&(*graph)->sink_links);
 
     av_freep(&(*graph)->scale_sws_opts);
     av_freep(&(*graph)->aresample_swr_opts);
     av_freep(&(*graph)->resample_lavr_opts);
+    av_freep(&(*graph)->thread_affinity);
     av_freep(&(*graph)->filters);
     av_freep(&(*graph)->internal);
+    av_mem_release_context(*graph);
     av_freep(graph);
 }
 
@@ -353,61 +362,6 @@ static int formats_declared(AVFilterContext *f)
     return 1;
 }
 
-static AVFilterFormats *clone_filter_formats(AVFilterFormats *arg)
-{
-    AVFilterFormats *a = av_memdup(arg, sizeof(*arg));
-    if (a) {
-        a->refcount = 0;
-        a->refs     = NULL;
-        a->formats  = av_memdup(a->formats, sizeof(*a->formats) * a->nb_formats);
-        if (!a->formats && arg->formats)
-            av_freep(&a);
-    }
-    return a;
-}
-
-static int can_merge_formats(AVFilterFormats *a_arg,
-                             AVFilterFormats *b_arg,
-                             enum AVMediaType type,
-                             int is_sample_rate)
-{
-    AVFilterFormats *a, *b, *ret;
-    if (a_arg == b_arg)
-        return 1;
-    a = clone_filter_formats(a_arg);
-    b = clone_filter_formats(b_arg);
-
-    if (!a || !b) {
-        if (a)
-            av_freep(&a->formats);
-        if (b)
-            av_freep(&b->formats);
-
-        av_freep(&a);
-        av_freep(&b);
-
-        return 0;
-    }
-
-    if (is_sample_rate) {
-        ret = ff_merge_samplerates(a, b);
-    } else {
-        ret = ff_merge_formats(a, b, type);
-    }
-    if (ret) {
-        av_freep(&ret->formats);
-        av_freep(&ret->refs);
-        av_freep(&ret);
-        return 1;
-    } else {
-        av_freep(&a->formats);
-        av_freep(&b->formats);
-        av_freep(&a);
-        av_freep(&b);
-        return 0;
-    }
-}
-
 /**
  * Perform one round of query_formats() and merging formats lists on the
  * filter graph.
@@ -454,15 +408,14 @@ static int query_formats(AVFilterGraph *graph, AVClass *log_ctx)
 
             if (link->in_formats != link->out_formats
                 && link->in_formats && link->out_formats)
-                if (!can_merge_formats(link->in_formats, link->out_formats,
-                                      link->type, 0))
+                if (!ff_can_merge_formats(link->in_formats, link->out_formats,
+                                          link->type))
                     convert_needed = 1;
             if (link->type == AVMEDIA_TYPE_AUDIO) {
                 if (link->in_samplerates != link->out_samplerates
                     && link->in_samplerates && link->out_samplerates)
-                    if (!can_merge_formats(link->in_samplerates,
-                                           link->out_samplerates,
-                                           0, 1))
+                    if (!ff_can_merge_samplerates(link->in_samplerates,
+                                                  link->out_samplerates))
                         convert_needed = 1;
             }
 
@@ -650,6 +603,105 @@ static enum AVSampleFormat find_best_sample_fmt_of_2(enum AVSampleFormat dst_fmt
     return score1 < score2 ? dst_fmt1 : dst_fmt2;
 }
 
+/**
+ * Filters left to visit in the format reduction and selection passes.
+ *
+ * The formats lists are shared between links, so changing one can affect
+ * filters far from the one making the change. The filters referencing a list
+ * are found from its refs, looked up in a table of the addresses of the lists
+ * fields of all the links, sorted by address.
+ */
+typedef struct FormatsRef {
+    const void *ref;
+    int filter;
+} FormatsRef;
+
+typedef struct FormatsWorklist {
+    FormatsRef *refs;
+    int nb_refs;
+    uint8_t *pending;
+    int changes;
+    int rounds;
+} FormatsWorklist;
+
+static int cmp_formats_ref(const void *a, const void *b)
+{
+    const FormatsRef *ra = a, *rb = b;
+    return FFDIFFSIGN((uintptr_t)ra->ref, (uintptr_t)rb->ref);
+}
+
+static int worklist_init(FormatsWorklist *wl, AVFilterGraph *graph)
+{
+    int i, j, k, nb_links = 0;
+
+    for (i = 0; i < graph->nb_filters; i++)
+        nb_links += graph->filters[i]->nb_inputs + graph->filters[i]->nb_outputs;
+
+    wl->refs    = av_malloc_array(nb_links, 6 * sizeof(*wl->refs));
+    wl->pending = av_malloc(graph->nb_filters);
+    if (!wl->refs || !wl->pending)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        for (j = 0; j < f->nb_inputs + f->nb_outputs; j++) {
+            AVFilterLink *l = j < f->nb_inputs ? f->inputs[j] :
+                                                 f->outputs[j - f->nb_inputs];
+            const void *fields[6];
+
+            if (!l)
+                continue;
+            fields[0] = &l->in_formats;
+            fields[1] = &l->out_formats;
+            fields[2] = &l->in_samplerates;
+            fields[3] = &l->out_samplerates;
+            fields[4] = &l->in_channel_layouts;
+            fields[5] = &l->out_channel_layouts;
+            for (k = 0; k < 6; k++) {
+                wl->refs[wl->nb_refs].ref    = fields[k];
+                wl->refs[wl->nb_refs].filter = i;
+                wl->nb_refs++;
+            }
+        }
+    }
+    qsort(wl->refs, wl->nb_refs, sizeof(*wl->refs), cmp_formats_ref);
+    memset(wl->pending, 1, graph->nb_filters);
+
+    return 0;
+}
+
+static void worklist_uninit(FormatsWorklist *wl)
+{
+    av_freep(&wl->refs);
+    av_freep(&wl->pending);
+}
+
+/* mark as pending the filters at both ends of the link owning ref */
+static void worklist_mark_ref(FormatsWorklist *wl, const void *ref)
+{
+    int lo = 0, hi = wl->nb_refs;
+
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if ((uintptr_t)wl->refs[mid].ref < (uintptr_t)ref)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (; lo < wl->nb_refs && wl->refs[lo].ref == ref; lo++)
+        wl->pending[wl->refs[lo].filter] = 1;
+}
+
+/* mark as pending all the filters using the formats list */
+#define WORKLIST_MARK(wl, list)                                        \
+do {                                                                   \
+    int r;                                                             \
+    for (r = 0; r < (list)->refcount; r++)                             \
+        worklist_mark_ref(wl, (list)->refs[r]);                        \
+    (wl)->changes++;                                                   \
+} while (0)
+
 static int pick_format(AVFilterLink *link, AVFilterLink *ref)
 {
     if (!link || !link->in_formats)
@@ -747,6 +799,7 @@ do {                                                                   \
             if (!out_link->in_ ## list->nb) {                          \
                 if ((ret = add_format(&out_link->in_ ##list, fmt)) < 0)\
                     return ret;                                        \
+                WORKLIST_MARK(wl, out_link->in_ ## list);              \
                 ret = 1;                                               \
                 break;                                                 \
             }                                                          \
@@ -755,6 +808,7 @@ do {                                                                   \
                 if (fmts->var[k] == fmt) {                             \
                     fmts->var[0]  = fmt;                               \
                     fmts->nb = 1;                                      \
+                    WORKLIST_MARK(wl, fmts);                           \
                     ret = 1;                                           \
                     break;                                             \
                 }                                                      \
@@ -762,7 +816,8 @@ do {                                                                   \
     }                                                                  \
 } while (0)
 
-static int reduce_formats_on_filter(AVFilterContext *filter)
+static int reduce_formats_on_filter(AVFilterContext *filter,
+                                    FormatsWorklist *wl)
 {
     int i, j, k, ret = 0;
 
@@ -795,6 +850,8 @@ static int reduce_formats_on_filter(AVFilterContext *filter)
                 fmts->all_layouts = fmts->all_counts  = 0;
                 if (ff_add_channel_layout(&outlink->in_channel_layouts, fmt) < 0)
                     ret = 1;
+                else
+                    WORKLIST_MARK(wl, outlink->in_channel_layouts);
                 break;
             }
 
@@ -802,6 +859,7 @@ static int reduce_formats_on_filter(AVFilterContext *filter)
                 if (fmts->channel_layouts[k] == fmt) {
                     fmts->channel_layouts[0]  = fmt;
                     fmts->nb_channel_layouts = 1;
+                    WORKLIST_MARK(wl, fmts);
                     ret = 1;
                     break;
                 }
@@ -812,16 +870,27 @@ static int reduce_formats_on_filter(AVFilterContext *filter)
     return ret;
 }
 
-static int reduce_formats(AVFilterGraph *graph)
+/* Only the pending filters are visited, in the order of the passes over the
+ * whole graph they replace, so that the result does not change. */
+static int reduce_formats(AVFilterGraph *graph, FormatsWorklist *wl)
 {
     int i, reduced, ret;
 
     do {
         reduced = 0;
+        wl->rounds++;
 
         for (i = 0; i < graph->nb_filters; i++) {
-            if ((ret = reduce_formats_on_filter(graph->filters[i])) < 0)
+            int changes = wl->changes;
+
+            if (!wl->pending[i])
+                continue;
+            wl->pending[i] = 0;
+            if ((ret = reduce_formats_on_filter(graph->filters[i], wl)) < 0)
                 return ret;
+            /* the outputs are not all looked at once a list was extended */
+            if (wl->changes != changes)
+                wl->pending[i] = 1;
             reduced |= ret;
         }
     } while (reduced);
@@ -1076,19 +1145,33 @@ static void swap_sample_fmts(AVFilterGraph *graph)
 
 }
 
-static int pick_formats(AVFilterGraph *graph)
+static int pick_format_mark(FormatsWorklist *wl, AVFilterLink *link,
+                            AVFilterLink *ref)
+{
+    /* the selected format ends up in all the links sharing the list */
+    if (link && link->in_formats)
+        WORKLIST_MARK(wl, link->in_formats);
+    return pick_format(link, ref);
+}
+
+static int pick_formats(AVFilterGraph *graph, FormatsWorklist *wl)
 {
     int i, j, ret;
     int change;
 
+    memset(wl->pending, 1, graph->nb_filters);
     do{
         change = 0;
+        wl->rounds++;
         for (i = 0; i < graph->nb_filters; i++) {
             AVFilterContext *filter = graph->filters[i];
+            if (!wl->pending[i])
+                continue;
+            wl->pending[i] = 0;
             if (filter->nb_inputs){
                 for (j = 0; j < filter->nb_inputs; j++){
                     if(filter->inputs[j]->in_formats && filter->inputs[j]->in_formats->nb_formats == 1) {
-                        if ((ret = pick_format(filter->inputs[j], NULL)) < 0)
+                        if ((ret = pick_format_mark(wl, filter->inputs[j], NULL)) < 0)
                             return ret;
                         change = 1;
                     }
@@ -1097,7 +1180,7 @@ static int pick_formats(AVFilterGraph *graph)
             if (filter->nb_outputs){
                 for (j = 0; j < filter->nb_outputs; j++){
                     if(filter->outputs[j]->in_formats && filter->outputs[j]->in_formats->nb_formats == 1) {
-                        if ((ret = pick_format(filter->outputs[j], NULL)) < 0)
+                        if ((ret = pick_format_mark(wl, filter->outputs[j], NULL)) < 0)
                             return ret;
                         change = 1;
                     }
@@ -1106,7 +1189,7 @@ static int pick_formats(AVFilterGraph *graph)
             if (filter->nb_inputs && filter->nb_outputs && filter->inputs[0]->format>=0) {
                 for (j = 0; j < filter->nb_outputs; j++) {
                     if(filter->outputs[j]->format<0) {
-                        if ((ret = pick_format(filter->outputs[j], filter->inputs[0])) < 0)
+                        if ((ret = pick_format_mark(wl, filter->outputs[j], filter->inputs[0])) < 0)
                             return ret;
                         change = 1;
                     }
@@ -1133,30 +1216,65 @@ static int pick_formats(AVFilterGraph *graph)
  */
 static int graph_config_formats(AVFilterGraph *graph, AVClass *log_ctx)
 {
+    AVFilterGraphInternal *gi = graph->internal;
+    FormatsWorklist wl = { 0 };
+    int64_t t0, t1;
     int ret;
 
+    memset(gi->formats_time,   0, sizeof(gi->formats_time));
+    memset(gi->formats_rounds, 0, sizeof(gi->formats_rounds));
+    t0 = av_gettime_relative();
+
     /* find supported formats from sub-filters, and merge along links */
-    while ((ret = query_formats(graph, log_ctx)) == AVERROR(EAGAIN))
+    gi->formats_rounds[FF_FORMATS_QUERY] = 1;
+    while ((ret = query_formats(graph, log_ctx)) == AVERROR(EAGAIN)) {
         av_log(graph, AV_LOG_DEBUG, "query_formats not finished\n");
+        gi->formats_rounds[FF_FORMATS_QUERY]++;
+    }
     if (ret < 0)
         return ret;
+    t1 = av_gettime_relative();
+    gi->formats_time[FF_FORMATS_QUERY] = t1 - t0;
+
+    /* no filter is inserted from here on */
+    if ((ret = worklist_init(&wl, graph)) < 0)
+        goto end;
 
     /* Once everything is merged, it's possible that we'll still have
      * multiple valid media format choices. We try to minimize the amount
      * of format conversion inside filters */
-    if ((ret = reduce_formats(graph)) < 0)
-        return ret;
+    if ((ret = reduce_formats(graph, &wl)) < 0)
+        goto end;
+    t0 = av_gettime_relative();
+    gi->formats_time[FF_FORMATS_REDUCE]   = t0 - t1;
+    gi->formats_rounds[FF_FORMATS_REDUCE] = wl.rounds;
 
     /* for audio filters, ensure the best format, sample rate and channel layout
      * is selected */
     swap_sample_fmts(graph);
     swap_samplerates(graph);
     swap_channel_layouts(graph);
-
-    if ((ret = pick_formats(graph)) < 0)
-        return ret;
-
-    return 0;
+    t1 = av_gettime_relative();
+    gi->formats_time[FF_FORMATS_SWAP]   = t1 - t0;
+    gi->formats_rounds[FF_FORMATS_SWAP] = 1;
+
+    wl.rounds = 0;
+    if ((ret = pick_formats(graph, &wl)) < 0)
+        goto end;
+    gi->formats_time[FF_FORMATS_PICK]   = av_gettime_relative() - t1;
+    gi->formats_rounds[FF_FORMATS_PICK] = wl.rounds;
+
+    av_log(graph, AV_LOG_DEBUG, "formats negotiated in %"PRId64"us: "
+           "query %"PRId64"us, reduce %"PRId64"us, swap %"PRId64"us, "
+           "pick %"PRId64"us\n",
+           gi->formats_time[FF_FORMATS_QUERY] + gi->formats_time[FF_FORMATS_REDUCE] +
+           gi->formats_time[FF_FORMATS_SWAP]  + gi->formats_time[FF_FORMATS_PICK],
+           gi->formats_time[FF_FORMATS_QUERY], gi->formats_time[FF_FORMATS_REDUCE],
+           gi->formats_time[FF_FORMATS_SWAP],  gi->formats_time[FF_FORMATS_PICK]);
+
+end:
+    worklist_uninit(&wl);
+    return ret;
 }
 
 static int graph_config_pointers(AVFilterGraph *graph,
@@ -1239,7 +1357,7 @@ static int graph_insert_fifos(AVFilterGraph *graph, AVClass *log_ctx)
     return 0;
 }
 
-int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
+static int graph_config(AVFilterGraph *graphctx, void *log_ctx)
 {
     int ret;
 
@@ -1257,6 +1375,14 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
     return 0;
 }
 
+int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
+{
+    void *mem_ctx = avpriv_mem_enter(graphctx);
+    int ret = graph_config(graphctx, log_ctx);
+    av_mem_set_context(mem_ctx);
+    return ret;
+}
+
 int avfilter_graph_send_command(AVFilterGraph *graph, const char *target, const char *cmd, const char *arg, char *res, int res_len, int flags)
 {
     int i, r = AVERROR(ENOSYS);
@@ -1360,12 +1486,14 @@ static void heap_bubble_down(AVFilterGraph *graph,
 
 void ff_avfilter_graph_update_heap(AVFilterGraph *graph, AVFilterLink *link)
 {
+    ff_mutex_lock(&graph->internal->sink_links_lock);
     heap_bubble_up  (graph, link, link->age_index);
     heap_bubble_down(graph, link, link->age_index);
+    ff_mutex_unlock(&graph->internal->sink_links_lock);
 }
 
 
-int avfilter_graph_request_oldest(AVFilterGraph *graph)
+static int request_oldest(AVFilterGraph *graph)
 {
     AVFilterLink *oldest = graph->sink_links[0];
     int r;
@@ -1395,6 +1523,14 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
+int avfilter_graph_request_oldest(AVFilterGraph *graph)
+{
+    void *mem_ctx = avpriv_mem_enter(graph);
+    int ret = request_oldest(graph);
+    av_mem_set_context(mem_ctx);
+    return ret;
+}
+
 static AVFilterLink *graph_run_once_find_filter(AVFilterGraph *graph)
 {
     unsigned i, j;
@@ -28,6 +28,7 @@
 #include "libavutil/channel_layout.h"
 #include "libavutil/common.h"
 #include "libavutil/internal.h"
+#include "libavutil/mem_internal.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 
@@ -125,7 +126,7 @@ int attribute_align_arg av_buffersink_get_frame(AVFilterContext *ctx, AVFrame *f
     return av_buffersink_get_frame_flags(ctx, frame, 0);
 }
 
-int attribute_align_arg av_buffersink_get_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
+static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags)
 {
     BufferSinkContext *buf = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
@@ -160,6 +161,14 @@ int attribute_align_arg av_buffersink_get_frame_flags(AVFilterContext *ctx, AVFr
     return 0;
 }
 
+int attribute_align_arg av_buffersink_get_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
+{
+    void *mem_ctx = avpriv_mem_enter(ctx->graph);
+    int ret = get_frame_internal(ctx, frame, flags);
+    av_mem_set_context(mem_ctx);
+    return ret;
+}
+
 static int read_from_fifo(AVFilterContext *ctx, AVFrame *frame,
                           int nb_samples)
 {
@@ -169,7 +178,7 @@ static int read_from_fifo(AVFilterContext *ctx, AVFrame *frame,
 
     if (!(tmp = ff_get_audio_buffer(link, nb_samples)))
         return AVERROR(ENOMEM);
-    av_audio_fifo_read(s->audio_fifo, (void**)tmp->extended_data, nb_samples);
+    av_audio_fifo_read_frame(s->audio_fifo, tmp, nb_samples);
 
     tmp->pts = s->next_pts;
     if (s->next_pts != AV_NOPTS_VALUE)
@@ -211,6 +220,20 @@ int attribute_align_arg av_buffersink_get_samples(AVFilterContext *ctx,
             return ret;
         }
 
+        /* frames which already have the right size are returned as is */
+        if (cur_frame->nb_samples == nb_samples &&
+            !av_audio_fifo_size(s->audio_fifo)) {
+            if (cur_frame->pts == AV_NOPTS_VALUE)
+                cur_frame->pts = s->next_pts;
+            s->next_pts = cur_frame->pts;
+            if (s->next_pts != AV_NOPTS_VALUE)
+                s->next_pts += av_rescale_q(nb_samples, (AVRational){1, link->sample_rate},
+                                            link->time_base);
+            av_frame_move_ref(frame, cur_frame);
+            av_frame_free(&cur_frame);
+            return 0;
+        }
+
         if (cur_frame->pts != AV_NOPTS_VALUE) {
             s->next_pts = cur_frame->pts -
                           av_rescale_q(av_audio_fifo_size(s->audio_fifo),
@@ -67,6 +67,11 @@ typedef struct BWDIFContext {
     int eof;
 } BWDIFContext;
 
+/**
+ * Set filter_intra, filter_line and filter_edge for the pixel format
+ * described by csp.
+ */
+void ff_bwdif_init(BWDIFContext *bwdif);
 void ff_bwdif_init_x86(BWDIFContext *bwdif);
 
 #endif /* AVFILTER_BWDIF_H */
@@ -0,0 +1,149 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#undef avg
+#undef ss
+#if SS_W == 0
+#define ss 444
+#define avg(a, b, c, d) (a)
+#elif SS_H == 0
+#define ss 422
+#define avg(a, b, c, d) (((a) + (b) + 1) >> 1)
+#else
+#define ss 420
+#define avg(a, b, c, d) (((a) + (b) + (c) + (d) + 2) >> 2)
+#endif
+
+#undef fn
+#undef fn2
+#undef fn3
+#define fn3(a, b, c) a##_##c##p##b##_c
+#define fn2(a, b, c) fn3(a, b, c)
+#define fn(a) fn2(a, BIT_DEPTH, ss)
+
+#undef pixel
+#undef av_clip_pixel
+#if BIT_DEPTH == 8
+#define pixel uint8_t
+#define av_clip_pixel(x) av_clip_uint8(x)
+#else
+#define pixel uint16_t
+#define av_clip_pixel(x) av_clip_uintp2(x, BIT_DEPTH)
+#endif
+
+static void fn(yuv2rgb)(int16_t *rgb[3], ptrdiff_t rgb_stride,
+                        uint8_t *_yuv[3], const ptrdiff_t yuv_stride[3],
+                        int w, int h, const int16_t yuv2rgb_coeffs[3][3][8],
+                        const int16_t yuv_offset[8])
+{
+    pixel **yuv = (pixel **) _yuv;
+    const pixel *yuv0 = yuv[0], *yuv1 = yuv[1], *yuv2 = yuv[2];
+    int16_t *rgb0 = rgb[0], *rgb1 = rgb[1], *rgb2 = rgb[2];
+    ptrdiff_t ystride = yuv_stride[0] / sizeof(pixel);
+    int y, x, i, j;
+    int cy  = yuv2rgb_coeffs[0][0][0];
+    int crv = yuv2rgb_coeffs[0][2][0];
+    int cgu = yuv2rgb_coeffs[1][1][0];
+    int cgv = yuv2rgb_coeffs[1][2][0];
+    int cbu = yuv2rgb_coeffs[2][1][0];
+    const int sh = BIT_DEPTH - 1, rnd = 1 << (sh - 1);
+    const int uv_offset = 128 << (BIT_DEPTH - 8);
+
+    w >>= SS_W;
+    h >>= SS_H;
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            int u = yuv1[x] - uv_offset, v = yuv2[x] - uv_offset;
+
+            for (j = 0; j < 1 << SS_H; j++) {
+                for (i = 0; i < 1 << SS_W; i++) {
+                    ptrdiff_t n = (x << SS_W) + i;
+                    int yy = yuv0[j * ystride + n] - yuv_offset[0];
+
+                    rgb0[j * rgb_stride + n] = av_clip_int16((yy * cy + crv * v + rnd) >> sh);
+                    rgb1[j * rgb_stride + n] = av_clip_int16((yy * cy + cgu * u +
+                                                              cgv * v + rnd) >> sh);
+                    rgb2[j * rgb_stride + n] = av_clip_int16((yy * cy + cbu * u + rnd) >> sh);
+                }
+            }
+        }
+
+        yuv0 += ystride << SS_H;
+        yuv1 += yuv_stride[1] / sizeof(pixel);
+        yuv2 += yuv_stride[2] / sizeof(pixel);
+        rgb0 += rgb_stride << SS_H;
+        rgb1 += rgb_stride << SS_H;
+        rgb2 += rgb_stride << SS_H;
+    }
+}
+
+static void fn(rgb2yuv)(uint8_t *_yuv[3], const ptrdiff_t yuv_stride[3],
+                        int16_t *rgb[3], ptrdiff_t s,
+                        int w, int h, const int16_t rgb2yuv_coeffs[3][3][8],
+                        const int16_t yuv_offset[8])
+{
+    pixel **yuv = (pixel **) _yuv;
+    pixel *yuv0 = yuv[0], *yuv1 = yuv[1], *yuv2 = yuv[2];
+    const int16_t *rgb0 = rgb[0], *rgb1 = rgb[1], *rgb2 = rgb[2];
+    ptrdiff_t ystride = yuv_stride[0] / sizeof(pixel);
+    int y, x, i, j;
+    int cry = rgb2yuv_coeffs[0][0][0];
+    int cgy = rgb2yuv_coeffs[0][1][0];
+    int cby = rgb2yuv_coeffs[0][2][0];
+    int cru = rgb2yuv_coeffs[1][0][0];
+    int cgu = rgb2yuv_coeffs[1][1][0];
+    int cbu = rgb2yuv_coeffs[1][2][0];
+    int crv = rgb2yuv_coeffs[2][0][0];
+    int cgv = rgb2yuv_coeffs[2][1][0];
+    int cbv = rgb2yuv_coeffs[2][2][0];
+    const int sh = 29 - BIT_DEPTH, rnd = 1 << (sh - 1);
+    const int uv_offset = 128 << (BIT_DEPTH - 8);
+
+    w >>= SS_W;
+    h >>= SS_H;
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            ptrdiff_t n = x << SS_W;
+            int r, g, b;
+
+            for (j = 0; j < 1 << SS_H; j++) {
+                for (i = 0; i < 1 << SS_W; i++) {
+                    r = rgb0[j * s + n + i];
+                    g = rgb1[j * s + n + i];
+                    b = rgb2[j * s + n + i];
+                    yuv0[j * ystride + n + i] =
+                        av_clip_pixel(yuv_offset[0] + ((r * cry + g * cgy +
+                                                        b * cby + rnd) >> sh));
+                }
+            }
+
+            r = avg(rgb0[n], rgb0[n + SS_W], rgb0[n + s * SS_H], rgb0[n + s * SS_H + SS_W]);
+            g = avg(rgb1[n], rgb1[n + SS_W], rgb1[n + s * SS_H], rgb1[n + s * SS_H + SS_W]);
+            b = avg(rgb2[n], rgb2[n + SS_W], rgb2[n + s * SS_H], rgb2[n + s * SS_H + SS_W]);
+            yuv1[x] = av_clip_pixel(uv_offset + ((r * cru + g * cgu + b * cbu + rnd) >> sh));
+            yuv2[x] = av_clip_pixel(uv_offset + ((r * crv + g * cgv + b * cbv + rnd) >> sh));
+        }
+
+        yuv0 += ystride << SS_H;
+        yuv1 += yuv_stride[1] / sizeof(pixel);
+        yuv2 += yuv_stride[2] / sizeof(pixel);
+        rgb0 += s << SS_H;
+        rgb1 += s << SS_H;
+        rgb2 += s << SS_H;
+    }
+}
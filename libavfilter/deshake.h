@@ -34,6 +34,7 @@
 enum SearchMethod {
     EXHAUSTIVE,        ///< Search all possible positions
     SMART_EXHAUSTIVE,  ///< Search most possible positions (faster)
+    HIERARCHICAL,      ///< Search at half resolution, then refine (fastest)
     SEARCH_COUNT
 };
 
@@ -86,6 +87,11 @@ typedef struct {
     int contrast;              ///< Contrast threshold
     int search;                ///< Motion search method
     av_pixelutils_sad_fn sad;  ///< Sum of the absolute difference function
+    av_pixelutils_sad_fn sad_half; ///< SAD function for the half resolution blocks
+    IntMotionVector *mvs;      ///< Scratch buffer for block motion vectors
+    unsigned mvs_size;
+    uint8_t *half[2];          ///< Half resolution luma of both frames
+    unsigned half_size[2];
     Transform last;            ///< Transform from last frame
     int refcount;              ///< Number of reference frames (defines averaging window)
     FILE *fp;
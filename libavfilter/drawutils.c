@@ -529,6 +529,9 @@ static void blend_pixel16(uint8_t *dst, unsigned src, unsigned alpha,
         mask += mask_linesize;
     }
     alpha = (t >> shift) * alpha;
+    /* the pixel is left unchanged by a null alpha */
+    if (!alpha)
+        return;
     AV_WL16(dst, ((0x10001 - alpha) * value + alpha * src) >> 16);
 }
 
@@ -552,6 +555,9 @@ static void blend_pixel(uint8_t *dst, unsigned src, unsigned alpha,
         mask += mask_linesize;
     }
     alpha = (t >> shift) * alpha;
+    /* the pixel is left unchanged by a null alpha */
+    if (!alpha)
+        return;
     *dst = ((0x1010101 - alpha) * *dst + alpha * src) >> 24;
 }
 
@@ -588,12 +594,37 @@ static void blend_line_hv(uint8_t *dst, int dst_delta,
 {
     int x;
 
+    /* one byte of the mask per pixel */
+    if (l2depth == 3 && !hsub && !vsub) {
+        mask += xm;
+        for (x = 0; x < w; x++) {
+            unsigned a = mask[x] * alpha;
+            if (a)
+                *dst = ((0x1010101 - a) * *dst + a * src) >> 24;
+            dst += dst_delta;
+        }
+        return;
+    }
+
     if (left) {
         blend_pixel(dst, src, alpha, mask, mask_linesize, l2depth,
                     left, hband, hsub + vsub, xm);
         dst += dst_delta;
         xm += left;
     }
+    /* 2x2 subsampled pixels, one byte of the mask per luma pixel */
+    if (l2depth == 3 && hsub == 1 && vsub == 1 && hband == 2) {
+        const uint8_t *m = mask + xm;
+        for (x = 0; x < w; x++) {
+            unsigned a = ((m[0] + m[1] + m[mask_linesize] + m[mask_linesize + 1]) >> 2) * alpha;
+            if (a)
+                *dst = ((0x1010101 - a) * *dst + a * src) >> 24;
+            dst += dst_delta;
+            m   += 2;
+        }
+        xm += 2 * w;
+        w = 0;
+    }
     for (x = 0; x < w; x++) {
         blend_pixel(dst, src, alpha, mask, mask_linesize, l2depth,
                     1 << hsub, hband, hsub + vsub, xm);
@@ -36,7 +36,6 @@
 #include "libavutil/xga_font_data.h"
 #include "libavutil/opt.h"
 #include "libavutil/timestamp.h"
-#include "libswresample/swresample.h"
 #include "audio.h"
 #include "avfilter.h"
 #include "formats.h"
@@ -58,6 +57,11 @@
 #define RLB_A1 -1.99004745483398
 #define RLB_A2  0.99007225036621
 
+/* true peak over-sampling filter, a Hann windowed sinc of
+ * TP_FACTOR * (TP_TAPS - 1) + 1 taps split in TP_FACTOR phases */
+#define TP_FACTOR 4
+#define TP_TAPS  13
+
 #define ABS_THRES    -70            ///< silence gate: we discard anything below this absolute (LUFS) threshold
 #define ABS_UP_THRES  10            ///< upper loud limit to consider (ABS_THRES being the minimum)
 #define HIST_GRAIN   100            ///< defines histogram precision
@@ -97,11 +101,9 @@ typedef struct {
     double *true_peaks;             ///< true peaks per channel
     double *sample_peaks;           ///< sample peaks per channel
     double *true_peaks_per_frame;   ///< true peaks in a frame per channel
-#if CONFIG_SWRESAMPLE
-    SwrContext *swr_ctx;            ///< over-sampling context for true peak metering
-    double *swr_buf;                ///< resampled audio data for true peak metering
-    int swr_linesize;
-#endif
+    double tp_coeffs[TP_FACTOR][TP_TAPS]; ///< polyphase over-sampling filter for true peak metering
+    double *tp_hist;                ///< last TP_TAPS samples per channel, stored twice to avoid wrapping
+    int tp_pos;                     ///< position of the newest sample in the true peak history
 
     /* video  */
     int do_video;                   ///< 1 if video output enabled, 0 otherwise
@@ -158,6 +160,7 @@ static const AVOption ebur128_options[] = {
     { "size",  "set video size",   OFFSET(w), AV_OPT_TYPE_IMAGE_SIZE, {.str = "640x480"}, 0, 0, V|F },
     { "meter", "set scale meter (+9 to +18)",  OFFSET(meter), AV_OPT_TYPE_INT, {.i64 = 9}, 9, 18, V|F },
     { "framelog", "force frame logging level", OFFSET(loglevel), AV_OPT_TYPE_INT, {.i64 = -1},   INT_MIN, INT_MAX, A|V|F, "level" },
+        { "quiet",   "only analyze, do not log",  0, AV_OPT_TYPE_CONST, {.i64 = AV_LOG_QUIET},   INT_MIN, INT_MAX, A|V|F, "level" },
         { "info",    "information logging level", 0, AV_OPT_TYPE_CONST, {.i64 = AV_LOG_INFO},    INT_MIN, INT_MAX, A|V|F, "level" },
         { "verbose", "verbose logging level",     0, AV_OPT_TYPE_CONST, {.i64 = AV_LOG_VERBOSE}, INT_MIN, INT_MAX, A|V|F, "level" },
     { "metadata", "inject metadata in the filtergraph", OFFSET(metadata), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, A|V|F },
@@ -351,10 +354,8 @@ static int config_audio_input(AVFilterLink *inlink)
 
     /* Force 100ms framing in case of metadata injection: the frames must have
      * a granularity of the window overlap to be accurately exploited.
-     * As for the true peaks mode, it just simplifies the resampling buffer
-     * allocation and the lookup in it (since sample buffers differ in size, it
-     * can be more complex to integrate in the one-sample loop of
-     * filter_frame()). */
+     * As for the true peaks mode, it makes the per frame true peaks those of
+     * the last 100ms. */
     if (ebur128->metadata || (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS))
         inlink->min_samples =
         inlink->max_samples =
@@ -400,31 +401,24 @@ static int config_audio_output(AVFilterLink *outlink)
             return AVERROR(ENOMEM);
     }
 
-#if CONFIG_SWRESAMPLE
     if (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS) {
-        int ret;
+        const int taps = TP_FACTOR * (TP_TAPS - 1) + 1;
 
-        ebur128->swr_buf    = av_malloc_array(nb_channels, 19200 * sizeof(double));
+        ebur128->tp_hist    = av_calloc(nb_channels, 2 * TP_TAPS * sizeof(*ebur128->tp_hist));
         ebur128->true_peaks = av_calloc(nb_channels, sizeof(*ebur128->true_peaks));
         ebur128->true_peaks_per_frame = av_calloc(nb_channels, sizeof(*ebur128->true_peaks_per_frame));
-        ebur128->swr_ctx    = swr_alloc();
-        if (!ebur128->swr_buf || !ebur128->true_peaks ||
-            !ebur128->true_peaks_per_frame || !ebur128->swr_ctx)
+        if (!ebur128->tp_hist || !ebur128->true_peaks ||
+            !ebur128->true_peaks_per_frame)
             return AVERROR(ENOMEM);
 
-        av_opt_set_int(ebur128->swr_ctx, "in_channel_layout",    outlink->channel_layout, 0);
-        av_opt_set_int(ebur128->swr_ctx, "in_sample_rate",       outlink->sample_rate, 0);
-        av_opt_set_sample_fmt(ebur128->swr_ctx, "in_sample_fmt", outlink->format, 0);
-
-        av_opt_set_int(ebur128->swr_ctx, "out_channel_layout",    outlink->channel_layout, 0);
-        av_opt_set_int(ebur128->swr_ctx, "out_sample_rate",       192000, 0);
-        av_opt_set_sample_fmt(ebur128->swr_ctx, "out_sample_fmt", outlink->format, 0);
-
-        ret = swr_init(ebur128->swr_ctx);
-        if (ret < 0)
-            return ret;
+        /* phase f of the output at 4 times the rate is the sum of the last
+         * input samples weighted by every TP_FACTOR-th tap from tap f */
+        for (i = 0; i < taps; i++) {
+            const double m = (i - (taps - 1) / 2.) * M_PI / TP_FACTOR;
+            const double w = 0.5 * (1 - cos(2 * M_PI * i / (taps - 1)));
+            ebur128->tp_coeffs[i % TP_FACTOR][i / TP_FACTOR] = (m ? sin(m) / m : 1) * w;
+        }
     }
-#endif
 
     if (ebur128->peak_mode & PEAK_MODE_SAMPLES_PEAKS) {
         ebur128->sample_peaks = av_calloc(nb_channels, sizeof(*ebur128->sample_peaks));
@@ -458,7 +452,8 @@ static av_cold int init(AVFilterContext *ctx)
     EBUR128Context *ebur128 = ctx->priv;
     AVFilterPad pad;
 
-    if (ebur128->loglevel != AV_LOG_INFO &&
+    if (ebur128->loglevel != AV_LOG_QUIET &&
+        ebur128->loglevel != AV_LOG_INFO  &&
         ebur128->loglevel != AV_LOG_VERBOSE) {
         if (ebur128->do_video || ebur128->metadata)
             ebur128->loglevel = AV_LOG_VERBOSE;
@@ -466,12 +461,6 @@ static av_cold int init(AVFilterContext *ctx)
             ebur128->loglevel = AV_LOG_INFO;
     }
 
-    if (!CONFIG_SWRESAMPLE && (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS)) {
-        av_log(ctx, AV_LOG_ERROR,
-               "True-peak mode requires libswresample to be performed\n");
-        return AVERROR(EINVAL);
-    }
-
     // if meter is  +9 scale, scale range is from -18 LU to  +9 LU (or 3*9)
     // if meter is +18 scale, scale range is from -36 LU to +18 LU (or 3*18)
     ebur128->scale_range = 3 * ebur128->meter;
@@ -537,99 +526,142 @@ static int gate_update(struct integrator *integ, double power,
     return gate_hist_pos;
 }
 
-static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
+/* Y[i] = X[i]*b0 + X[i-1]*b1 + X[i-2]*b2 - Y[i-1]*a1 - Y[i-2]*a2 */
+#define FILTER(y0, y1, y2, x0, x1, x2, name) do {                           \
+    y2 = y1;                                                                \
+    y1 = y0;                                                                \
+    y0 = x0*name##_B0 + x1*name##_B1 + x2*name##_B2 - y1*name##_A1 - y2*name##_A2; \
+} while (0)
+
+/**
+ * Run the samples of one channel through the K-weighting filters and the
+ * integration windows, and update its peaks. The filter and window states
+ * are kept in local variables for the whole run.
+ */
+static void filter_channel(EBUR128Context *ebur128, int ch,
+                           const double *samples, int nb_samples)
 {
-    int i, ch, idx_insample;
-    AVFilterContext *ctx = inlink->dst;
-    EBUR128Context *ebur128 = ctx->priv;
-    const int nb_channels = ebur128->nb_channels;
-    const int nb_samples  = insamples->nb_samples;
-    const double *samples = (double *)insamples->data[0];
-    AVFrame *pic = ebur128->outpicref;
+    const int stride = ebur128->nb_channels;
+    int i;
+
+    if (ebur128->peak_mode & PEAK_MODE_SAMPLES_PEAKS) {
+        double peak = ebur128->sample_peaks[ch];
+        for (i = 0; i < nb_samples; i++)
+            peak = FFMAX(peak, fabs(samples[i * stride]));
+        ebur128->sample_peaks[ch] = peak;
+    }
 
-#if CONFIG_SWRESAMPLE
     if (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS) {
-        const double *swr_samples = ebur128->swr_buf;
-        int ret = swr_convert(ebur128->swr_ctx, (uint8_t**)&ebur128->swr_buf, 19200,
-                              (const uint8_t **)insamples->data, nb_samples);
-        if (ret < 0)
-            return ret;
-        for (ch = 0; ch < nb_channels; ch++)
-            ebur128->true_peaks_per_frame[ch] = 0.0;
-        for (idx_insample = 0; idx_insample < ret; idx_insample++) {
-            for (ch = 0; ch < nb_channels; ch++) {
-                ebur128->true_peaks[ch] = FFMAX(ebur128->true_peaks[ch], fabs(*swr_samples));
-                ebur128->true_peaks_per_frame[ch] = FFMAX(ebur128->true_peaks_per_frame[ch],
-                                                          fabs(*swr_samples));
-                swr_samples++;
+        double *hist = ebur128->tp_hist + ch * 2 * TP_TAPS;
+        double peak = ebur128->true_peaks_per_frame[ch];
+        int pos = ebur128->tp_pos, f, t;
+
+        for (i = 0; i < nb_samples; i++) {
+            pos = pos ? pos - 1 : TP_TAPS - 1;
+            hist[pos] = hist[pos + TP_TAPS] = samples[i * stride];
+            for (f = 0; f < TP_FACTOR; f++) {
+                double v = 0;
+                for (t = 0; t < TP_TAPS; t++)
+                    v += ebur128->tp_coeffs[f][t] * hist[pos + t];
+                peak = FFMAX(peak, fabs(v));
             }
         }
+        ebur128->true_peaks_per_frame[ch] = peak;
+        ebur128->true_peaks[ch] = FFMAX(ebur128->true_peaks[ch], peak);
     }
-#endif
 
-    for (idx_insample = 0; idx_insample < nb_samples; idx_insample++) {
-        const int bin_id_400  = ebur128->i400.cache_pos;
-        const int bin_id_3000 = ebur128->i3000.cache_pos;
+    if (nb_samples)
+        ebur128->x[ch * 3] = samples[(nb_samples - 1) * stride]; // set X[i]
 
-#define MOVE_TO_NEXT_CACHED_ENTRY(time) do {                \
-    ebur128->i##time.cache_pos++;                           \
-    if (ebur128->i##time.cache_pos == I##time##_BINS) {     \
-        ebur128->i##time.filled    = 1;                     \
-        ebur128->i##time.cache_pos = 0;                     \
-    }                                                       \
-} while (0)
+    if (ebur128->ch_weighting[ch]) {
+        double x0, x1 = ebur128->x[ch * 3 + 1], x2 = ebur128->x[ch * 3 + 2];
+        double y0 = ebur128->y[ch * 3], y1 = ebur128->y[ch * 3 + 1], y2 = ebur128->y[ch * 3 + 2];
+        double z0 = ebur128->z[ch * 3], z1 = ebur128->z[ch * 3 + 1], z2 = ebur128->z[ch * 3 + 2];
+        double  sum_400 = ebur128->i400.sum [ch], *cache_400  = ebur128->i400.cache [ch];
+        double sum_3000 = ebur128->i3000.sum[ch], *cache_3000 = ebur128->i3000.cache[ch];
+        int bin_id_400  = ebur128->i400.cache_pos;
+        int bin_id_3000 = ebur128->i3000.cache_pos;
 
-        MOVE_TO_NEXT_CACHED_ENTRY(400);
-        MOVE_TO_NEXT_CACHED_ENTRY(3000);
-
-        for (ch = 0; ch < nb_channels; ch++) {
+        for (i = 0; i < nb_samples; i++) {
             double bin;
 
-            if (ebur128->peak_mode & PEAK_MODE_SAMPLES_PEAKS)
-                ebur128->sample_peaks[ch] = FFMAX(ebur128->sample_peaks[ch], fabs(*samples));
-
-            ebur128->x[ch * 3] = *samples++; // set X[i]
-
-            if (!ebur128->ch_weighting[ch])
-                continue;
-
-            /* Y[i] = X[i]*b0 + X[i-1]*b1 + X[i-2]*b2 - Y[i-1]*a1 - Y[i-2]*a2 */
-#define FILTER(Y, X, name) do {                                                 \
-            double *dst = ebur128->Y + ch*3;                                    \
-            double *src = ebur128->X + ch*3;                                    \
-            dst[2] = dst[1];                                                    \
-            dst[1] = dst[0];                                                    \
-            dst[0] = src[0]*name##_B0 + src[1]*name##_B1 + src[2]*name##_B2     \
-                                      - dst[1]*name##_A1 - dst[2]*name##_A2;    \
-} while (0)
-
+            x0 = samples[i * stride];
             // TODO: merge both filters in one?
-            FILTER(y, x, PRE);  // apply pre-filter
-            ebur128->x[ch * 3 + 2] = ebur128->x[ch * 3 + 1];
-            ebur128->x[ch * 3 + 1] = ebur128->x[ch * 3    ];
-            FILTER(z, y, RLB);  // apply RLB-filter
+            FILTER(y0, y1, y2, x0, x1, x2, PRE);  // apply pre-filter
+            x2 = x1;
+            x1 = x0;
+            FILTER(z0, z1, z2, y0, y1, y2, RLB);  // apply RLB-filter
 
-            bin = ebur128->z[ch * 3] * ebur128->z[ch * 3];
+            bin = z0 * z0;
 
             /* add the new value, and limit the sum to the cache size (400ms or 3s)
              * by removing the oldest one */
-            ebur128->i400.sum [ch] = ebur128->i400.sum [ch] + bin - ebur128->i400.cache [ch][bin_id_400];
-            ebur128->i3000.sum[ch] = ebur128->i3000.sum[ch] + bin - ebur128->i3000.cache[ch][bin_id_3000];
+            sum_400  = sum_400  + bin - cache_400 [bin_id_400];
+            sum_3000 = sum_3000 + bin - cache_3000[bin_id_3000];
 
             /* override old cache entry with the new value */
-            ebur128->i400.cache [ch][bin_id_400 ] = bin;
-            ebur128->i3000.cache[ch][bin_id_3000] = bin;
+            cache_400 [bin_id_400 ] = bin;
+            cache_3000[bin_id_3000] = bin;
+
+            if (++bin_id_400  == I400_BINS)
+                bin_id_400  = 0;
+            if (++bin_id_3000 == I3000_BINS)
+                bin_id_3000 = 0;
         }
 
+        ebur128->x[ch * 3 + 1] = x1; ebur128->x[ch * 3 + 2] = x2;
+        ebur128->y[ch * 3] = y0; ebur128->y[ch * 3 + 1] = y1; ebur128->y[ch * 3 + 2] = y2;
+        ebur128->z[ch * 3] = z0; ebur128->z[ch * 3 + 1] = z1; ebur128->z[ch * 3 + 2] = z2;
+        ebur128->i400.sum [ch] = sum_400;
+        ebur128->i3000.sum[ch] = sum_3000;
+    }
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
+{
+    int i, ch, idx_insample, nb;
+    AVFilterContext *ctx = inlink->dst;
+    EBUR128Context *ebur128 = ctx->priv;
+    const int nb_channels = ebur128->nb_channels;
+    const int nb_samples  = insamples->nb_samples;
+    const double *samples = (double *)insamples->data[0];
+    AVFrame *pic = ebur128->outpicref;
+
+    if (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS) {
+        for (ch = 0; ch < nb_channels; ch++)
+            ebur128->true_peaks_per_frame[ch] = 0.0;
+    }
+
+    /* the samples are processed channel by channel, in runs which end
+     * where the loudness has to be computed */
+    for (idx_insample = 0; idx_insample < nb_samples; idx_insample += nb) {
+        nb = FFMIN(nb_samples - idx_insample, 4800 - ebur128->sample_count);
+
+        for (ch = 0; ch < nb_channels; ch++)
+            filter_channel(ebur128, ch, samples + idx_insample * nb_channels + ch, nb);
+
+#define MOVE_CACHE_POS(time) do {                           \
+    ebur128->i##time.cache_pos += nb;                       \
+    if (ebur128->i##time.cache_pos >= I##time##_BINS) {     \
+        ebur128->i##time.filled     = 1;                    \
+        ebur128->i##time.cache_pos -= I##time##_BINS;       \
+    }                                                       \
+} while (0)
+
+        MOVE_CACHE_POS(400);
+        MOVE_CACHE_POS(3000);
+        ebur128->tp_pos = (ebur128->tp_pos + TP_TAPS - nb % TP_TAPS) % TP_TAPS;
+
         /* For integrated loudness, gating blocks are 400ms long with 75%
          * overlap (see BS.1770-2 p5), so a re-computation is needed each 100ms
          * (4800 samples at 48kHz). */
-        if (++ebur128->sample_count == 4800) {
+        ebur128->sample_count += nb;
+        if (ebur128->sample_count == 4800) {
             double loudness_400, loudness_3000;
             double power_400 = 1e-12, power_3000 = 1e-12;
             AVFilterLink *outlink = ctx->outputs[0];
             const int64_t pts = insamples->pts +
-                av_rescale_q(idx_insample, (AVRational){ 1, inlink->sample_rate },
+                av_rescale_q(idx_insample + nb - 1, (AVRational){ 1, inlink->sample_rate },
                              outlink->time_base);
 
             ebur128->sample_count = 0;
@@ -796,6 +828,9 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
                 SET_META_PEAK(true,   TRUE);
             }
 
+            if (ebur128->loglevel == AV_LOG_QUIET)
+                continue;
+
             av_log(ctx, ebur128->loglevel, "t: %-10s " LOG_FMT,
                    av_ts2timestr(pts, &outlink->time_base),
                    loudness_400, loudness_3000,
@@ -919,10 +954,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     for (i = 0; i < ctx->nb_outputs; i++)
         av_freep(&ctx->output_pads[i].name);
     av_frame_free(&ebur128->outpicref);
-#if CONFIG_SWRESAMPLE
-    av_freep(&ebur128->swr_buf);
-    swr_free(&ebur128->swr_ctx);
-#endif
+    av_freep(&ebur128->tp_hist);
 }
 
 static const AVFilterPad ebur128_inputs[] = {
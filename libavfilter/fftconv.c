@@ -0,0 +1,244 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "fftconv.h"
+
+int ff_fftconv_init(FFTConvContext *c, int block_size, int max_ir_len,
+                    int nb_inputs, int nb_outputs)
+{
+    const int len = 2 * block_size;
+    int i, bits;
+
+    memset(c, 0, sizeof(*c));
+
+    if (block_size < 8 || block_size > 32768 || block_size & (block_size - 1) ||
+        nb_inputs <= 0 || nb_outputs <= 0)
+        return AVERROR(EINVAL);
+
+    bits = av_log2(len);
+    c->block_size    = block_size;
+    c->nb_partitions = FFMAX(1, (max_ir_len + block_size - 1) / block_size);
+    c->nb_inputs     = nb_inputs;
+    c->nb_outputs    = nb_outputs;
+
+    c->rdft  = av_calloc(nb_inputs,  sizeof(*c->rdft));
+    c->time  = av_calloc(nb_inputs,  sizeof(*c->time));
+    c->fdl   = av_calloc(nb_inputs,  sizeof(*c->fdl));
+    c->irdft = av_calloc(nb_outputs, sizeof(*c->irdft));
+    c->accum = av_calloc(nb_outputs, sizeof(*c->accum));
+    c->ir    = av_calloc(nb_inputs * nb_outputs, sizeof(*c->ir));
+    c->ir_partitions = av_calloc(nb_inputs * nb_outputs, sizeof(*c->ir_partitions));
+    if (!c->rdft || !c->time || !c->fdl || !c->irdft || !c->accum ||
+        !c->ir || !c->ir_partitions)
+        goto fail;
+
+    /* the transforms keep scratch state, so each input and each output
+     * gets its own to allow processing them concurrently */
+    for (i = 0; i < nb_inputs; i++) {
+        c->rdft[i] = av_rdft_init(bits, DFT_R2C);
+        c->time[i] = av_calloc(len, sizeof(*c->time[i]));
+        c->fdl[i]  = av_calloc(len * c->nb_partitions, sizeof(*c->fdl[i]));
+        if (!c->rdft[i] || !c->time[i] || !c->fdl[i])
+            goto fail;
+    }
+
+    for (i = 0; i < nb_outputs; i++) {
+        c->irdft[i] = av_rdft_init(bits, IDFT_C2R);
+        c->accum[i] = av_malloc_array(len, sizeof(*c->accum[i]));
+        if (!c->irdft[i] || !c->accum[i])
+            goto fail;
+    }
+
+    return 0;
+fail:
+    ff_fftconv_uninit(c);
+    return AVERROR(ENOMEM);
+}
+
+int ff_fftconv_set_ir(FFTConvContext *c, int in, int out,
+                      const float *ir, int len, float gain)
+{
+    const int block_size = c->block_size;
+    /* fold the 2 / N normalization of the inverse transform into the IR */
+    const float scale = gain / block_size;
+    const int idx = in * c->nb_outputs + out;
+    float *h;
+    int p, k;
+
+    av_assert1(in >= 0 && in < c->nb_inputs && out >= 0 && out < c->nb_outputs);
+
+    if (!ir || len <= 0) {
+        av_freep(&c->ir[idx]);
+        c->ir_partitions[idx] = 0;
+        return 0;
+    }
+
+    if (len > block_size * c->nb_partitions)
+        return AVERROR(EINVAL);
+
+    if (!c->ir[idx]) {
+        c->ir[idx] = av_malloc_array(2 * block_size * c->nb_partitions, sizeof(*c->ir[idx]));
+        if (!c->ir[idx])
+            return AVERROR(ENOMEM);
+    }
+
+    h = c->ir[idx];
+    c->ir_partitions[idx] = (len + block_size - 1) / block_size;
+    for (p = 0; p < c->ir_partitions[idx]; p++) {
+        const int n = FFMIN(block_size, len - p * block_size);
+
+        for (k = 0; k < n; k++)
+            h[k] = ir[p * block_size + k] * scale;
+        memset(h + n, 0, (2 * block_size - n) * sizeof(*h));
+        av_rdft_calc(c->rdft[in], h);
+        h += 2 * block_size;
+    }
+
+    return 0;
+}
+
+void ff_fftconv_input(FFTConvContext *c, int in,
+                      const float *src, ptrdiff_t stride, int nb_samples)
+{
+    const int len = 2 * c->block_size;
+    float *time = c->time[in] + c->block_size + c->fill;
+    float *x = c->fdl[in] + c->fdl_pos * len;
+    int i;
+
+    av_assert1(c->fill + nb_samples <= c->block_size);
+
+    for (i = 0; i < nb_samples; i++)
+        time[i] = src[i * stride];
+
+    /* the rest of the current block is still zero */
+    memcpy(x, c->time[in], len * sizeof(*x));
+    av_rdft_calc(c->rdft[in], x);
+}
+
+static void cmac(float *acc, const float *x, const float *h, int len)
+{
+    int k;
+
+    /* DC and Nyquist are packed as two real values */
+    acc[0] += x[0] * h[0];
+    acc[1] += x[1] * h[1];
+    for (k = 2; k < len; k += 2) {
+        acc[k  ] += x[k] * h[k  ] - x[k+1] * h[k+1];
+        acc[k+1] += x[k] * h[k+1] + x[k+1] * h[k  ];
+    }
+}
+
+void ff_fftconv_output(FFTConvContext *c, int out,
+                       float *dst, ptrdiff_t stride, int nb_samples)
+{
+    const int len = 2 * c->block_size;
+    const int nb_partitions = c->nb_partitions;
+    float *acc = c->accum[out];
+    int in, p, i;
+
+    memset(acc, 0, len * sizeof(*acc));
+
+    for (in = 0; in < c->nb_inputs; in++) {
+        const int idx = in * c->nb_outputs + out;
+        const float *h = c->ir[idx];
+        int pos = c->fdl_pos;
+
+        if (!h)
+            continue;
+
+        for (p = 0; p < c->ir_partitions[idx]; p++) {
+            cmac(acc, c->fdl[in] + pos * len, h + p * len, len);
+            pos = pos ? pos - 1 : nb_partitions - 1;
+        }
+    }
+
+    av_rdft_calc(c->irdft[out], acc);
+
+    /* the second half of the window is free of circular aliasing */
+    acc += c->block_size + c->fill;
+    for (i = 0; i < nb_samples; i++)
+        dst[i * stride] = acc[i];
+}
+
+void ff_fftconv_advance(FFTConvContext *c, int nb_samples)
+{
+    const int block_size = c->block_size;
+    int in;
+
+    c->fill += nb_samples;
+    av_assert1(c->fill <= block_size);
+    if (c->fill < block_size)
+        return;
+
+    for (in = 0; in < c->nb_inputs; in++) {
+        memcpy(c->time[in], c->time[in] + block_size, block_size * sizeof(*c->time[in]));
+        memset(c->time[in] + block_size, 0, block_size * sizeof(*c->time[in]));
+    }
+    c->fill = 0;
+    c->fdl_pos = c->fdl_pos + 1 < c->nb_partitions ? c->fdl_pos + 1 : 0;
+}
+
+void ff_fftconv_reset(FFTConvContext *c)
+{
+    const int len = 2 * c->block_size;
+    int in;
+
+    for (in = 0; in < c->nb_inputs; in++) {
+        memset(c->time[in], 0, len * sizeof(*c->time[in]));
+        memset(c->fdl[in], 0, len * c->nb_partitions * sizeof(*c->fdl[in]));
+    }
+    c->fill    = 0;
+    c->fdl_pos = 0;
+}
+
+void ff_fftconv_uninit(FFTConvContext *c)
+{
+    int i;
+
+    for (i = 0; i < c->nb_inputs; i++) {
+        if (c->rdft)
+            av_rdft_end(c->rdft[i]);
+        if (c->time)
+            av_freep(&c->time[i]);
+        if (c->fdl)
+            av_freep(&c->fdl[i]);
+    }
+    for (i = 0; i < c->nb_outputs; i++) {
+        if (c->irdft)
+            av_rdft_end(c->irdft[i]);
+        if (c->accum)
+            av_freep(&c->accum[i]);
+    }
+    for (i = 0; c->ir && i < c->nb_inputs * c->nb_outputs; i++)
+        av_freep(&c->ir[i]);
+
+    av_freep(&c->rdft);
+    av_freep(&c->irdft);
+    av_freep(&c->time);
+    av_freep(&c->fdl);
+    av_freep(&c->ir);
+    av_freep(&c->ir_partitions);
+    av_freep(&c->accum);
+    c->nb_inputs = c->nb_outputs = 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Uniformly partitioned FFT convolution
+ *
+ * Each impulse response is cut into partitions of block_size taps, and
+ * convolved with the input by overlap-save on FFTs of 2 * block_size
+ * points. The spectra of the last input blocks are kept in a frequency
+ * domain delay line, so that every input is transformed once per block
+ * regardless of how many outputs it contributes to, and every output is
+ * transformed back once per block regardless of how many inputs feed it.
+ *
+ * Blocks may be fed in several pieces: the output is then computed from
+ * the partially filled block, which adds no latency at the cost of
+ * transforming the same block more than once.
+ */
+
+#ifndef AVFILTER_FFTCONV_H
+#define AVFILTER_FFTCONV_H
+
+#include <stddef.h>
+
+#include "libavcodec/avfft.h"
+
+typedef struct FFTConvContext {
+    int block_size;     ///< partition length in samples, a power of 2
+    int nb_partitions;  ///< number of partitions of the longest IR
+    int nb_inputs;
+    int nb_outputs;
+    int fill;           ///< samples already present in the current block
+    int fdl_pos;        ///< delay line slot of the current block
+
+    RDFTContext **rdft;     ///< one per input
+    RDFTContext **irdft;    ///< one per output
+    float **time;           ///< per input, previous and current block
+    float **fdl;            ///< per input, nb_partitions spectra
+    float **ir;             ///< per input/output pair, NULL if unused
+    int *ir_partitions;     ///< per input/output pair
+    float **accum;          ///< per output
+} FFTConvContext;
+
+/**
+ * Allocate the buffers and transforms.
+ *
+ * @param block_size partition length, a power of 2 between 8 and 32768
+ * @param max_ir_len length of the longest IR set with ff_fftconv_set_ir()
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int ff_fftconv_init(FFTConvContext *c, int block_size, int max_ir_len,
+                    int nb_inputs, int nb_outputs);
+
+/**
+ * Set the IR from an input to an output, scaled by gain. A NULL ir or a
+ * zero length removes the contribution of this input to this output.
+ * This may be called between blocks to change the IR on the fly.
+ *
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int ff_fftconv_set_ir(FFTConvContext *c, int in, int out,
+                      const float *ir, int len, float gain);
+
+/**
+ * Feed nb_samples samples, read every stride floats from src, to an
+ * input. nb_samples must not exceed the room left in the current block,
+ * that is block_size - fill.
+ */
+void ff_fftconv_input(FFTConvContext *c, int in,
+                      const float *src, ptrdiff_t stride, int nb_samples);
+
+/**
+ * Compute the nb_samples output samples matching the last
+ * ff_fftconv_input() calls, and write them every stride floats to dst.
+ * The inputs contributing to this output must have been fed first; dst
+ * may alias their source.
+ */
+void ff_fftconv_output(FFTConvContext *c, int out,
+                       float *dst, ptrdiff_t stride, int nb_samples);
+
+/**
+ * Account for nb_samples samples fed to all inputs and read from all
+ * outputs, and move to the next block when the current one is full.
+ */
+void ff_fftconv_advance(FFTConvContext *c, int nb_samples);
+
+/**
+ * Clear the input history, as if only silence had been fed so far.
+ */
+void ff_fftconv_reset(FFTConvContext *c);
+
+void ff_fftconv_uninit(FFTConvContext *c);
+
+#endif /* AVFILTER_FFTCONV_H */
@@ -89,42 +89,104 @@ do {
     MERGE_REF(ret, b, fmts, type, fail);                                        \
 } while (0)
 
+/* large enough for one bit per pixel or sample format */
+#define FMT_SET_WORDS ((FFMAX(AV_PIX_FMT_NB, AV_SAMPLE_FMT_NB) + 63) / 64)
+
+/**
+ * Find the formats common to a and b, in the order of a, looking them up in
+ * a bitset of the formats of b.
+ *
+ * @param common array of FFMIN(a->nb_formats, b->nb_formats) entries
+ *               receiving the common formats, or NULL
+ * @return the number of common formats, 0 if there is none or if the merge
+ *         would lose chroma or alpha, a negative value on duplicate formats
+ */
+static int common_formats(const AVFilterFormats *a, const AVFilterFormats *b,
+                          enum AVMediaType type, int *common)
+{
+    uint64_t set[FMT_SET_WORDS] = { 0 };
+    unsigned nb = type == AVMEDIA_TYPE_VIDEO ? AV_PIX_FMT_NB : AV_SAMPLE_FMT_NB;
+    int max = FFMIN(a->nb_formats, b->nb_formats);
+    int alpha1 = 0, alpha2 = 0, b_alpha  = 0;
+    int chroma1 = 0, chroma2 = 0, b_chroma = 0;
+    int i, k = 0;
+
+    for (i = 0; i < b->nb_formats; i++) {
+        unsigned fmt = b->formats[i];
+
+        if (fmt >= nb)
+            continue;
+        set[fmt >> 6] |= 1ULL << (fmt & 63);
+        if (type == AVMEDIA_TYPE_VIDEO) {
+            const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
+            b_alpha  |= desc->flags & AV_PIX_FMT_FLAG_ALPHA;
+            b_chroma |= desc->nb_components > 1;
+        }
+    }
+
+    for (i = 0; i < a->nb_formats; i++) {
+        unsigned fmt = a->formats[i];
+        int in_b;
+
+        if (fmt >= nb)
+            continue;
+        in_b = !!(set[fmt >> 6] & (1ULL << (fmt & 63)));
+        /* Do not lose chroma or alpha in merging.
+           It happens if both lists have formats with chroma (resp. alpha), but
+           the only formats in common do not have it (e.g. YUV+gray vs.
+           RGB+gray): in that case, the merging would select the gray format,
+           possibly causing a lossy conversion elsewhere in the graph.
+           To avoid that, pretend that there are no common formats to force the
+           insertion of a conversion filter. */
+        if (type == AVMEDIA_TYPE_VIDEO) {
+            const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
+            int alpha  = desc->flags & AV_PIX_FMT_FLAG_ALPHA;
+            int chroma = desc->nb_components > 1;
+
+            alpha2  |= alpha  & b_alpha;
+            chroma2 |= chroma & b_chroma;
+            if (in_b) {
+                alpha1  |= alpha;
+                chroma1 |= chroma;
+            }
+        }
+        if (in_b) {
+            if (k >= max) {
+                av_log(NULL, AV_LOG_ERROR, "Duplicate formats in avfilter_merge_formats() detected\n");
+                return AVERROR(EINVAL);
+            }
+            if (common)
+                common[k] = fmt;
+            k++;
+        }
+    }
+
+    // If chroma or alpha can be lost through merging then do not merge
+    if (alpha2 > alpha1 || chroma2 > chroma1)
+        return 0;
+
+    return k;
+}
+
 AVFilterFormats *ff_merge_formats(AVFilterFormats *a, AVFilterFormats *b,
                                   enum AVMediaType type)
 {
     AVFilterFormats *ret = NULL;
-    int i, j;
-    int alpha1=0, alpha2=0;
-    int chroma1=0, chroma2=0;
+    int count = FFMIN(a->nb_formats, b->nb_formats);
 
     if (a == b)
         return a;
 
-    /* Do not lose chroma or alpha in merging.
-       It happens if both lists have formats with chroma (resp. alpha), but
-       the only formats in common do not have it (e.g. YUV+gray vs.
-       RGB+gray): in that case, the merging would select the gray format,
-       possibly causing a lossy conversion elsewhere in the graph.
-       To avoid that, pretend that there are no common formats to force the
-       insertion of a conversion filter. */
-    if (type == AVMEDIA_TYPE_VIDEO)
-        for (i = 0; i < a->nb_formats; i++)
-            for (j = 0; j < b->nb_formats; j++) {
-                const AVPixFmtDescriptor *adesc = av_pix_fmt_desc_get(a->formats[i]);
-                const AVPixFmtDescriptor *bdesc = av_pix_fmt_desc_get(b->formats[j]);
-                alpha2 |= adesc->flags & bdesc->flags & AV_PIX_FMT_FLAG_ALPHA;
-                chroma2|= adesc->nb_components > 1 && bdesc->nb_components > 1;
-                if (a->formats[i] == b->formats[j]) {
-                    alpha1 |= adesc->flags & AV_PIX_FMT_FLAG_ALPHA;
-                    chroma1|= adesc->nb_components > 1;
-                }
-            }
-
-    // If chroma or alpha can be lost through merging then do not merge
-    if (alpha2 > alpha1 || chroma2 > chroma1)
+    if (!count)
         return NULL;
+    if (!(ret = av_mallocz(sizeof(*ret))) ||
+        !(ret->formats = av_malloc_array(count, sizeof(*ret->formats))))
+        goto fail;
+    if ((ret->nb_formats = common_formats(a, b, type, ret->formats)) <= 0)
+        goto fail;
 
-    MERGE_FORMATS(ret, a, b, formats, nb_formats, AVFilterFormats, fail);
+    MERGE_REF(ret, a, formats, AVFilterFormats, fail);
+    MERGE_REF(ret, b, formats, AVFilterFormats, fail);
 
     return ret;
 fail:
@@ -136,6 +198,26 @@ fail:
     return NULL;
 }
 
+int ff_can_merge_formats(const AVFilterFormats *a, const AVFilterFormats *b,
+                         enum AVMediaType type)
+{
+    return a == b || common_formats(a, b, type, NULL) > 0;
+}
+
+int ff_can_merge_samplerates(const AVFilterFormats *a,
+                             const AVFilterFormats *b)
+{
+    int i, j;
+
+    if (a == b || !a->nb_formats || !b->nb_formats)
+        return 1;
+    for (i = 0; i < a->nb_formats; i++)
+        for (j = 0; j < b->nb_formats; j++)
+            if (a->formats[i] == b->formats[j])
+                return 1;
+    return 0;
+}
+
 AVFilterFormats *ff_merge_samplerates(AVFilterFormats *a,
                                       AVFilterFormats *b)
 {
@@ -240,6 +240,15 @@ AVFilterFormats *ff_planar_sample_fmts(void);
 AVFilterFormats *ff_merge_formats(AVFilterFormats *a, AVFilterFormats *b,
                                   enum AVMediaType type);
 
+/**
+ * Check if ff_merge_formats() / ff_merge_samplerates() would succeed on a
+ * and b, without modifying or allocating anything.
+ */
+int ff_can_merge_formats(const AVFilterFormats *a, const AVFilterFormats *b,
+                         enum AVMediaType type);
+int ff_can_merge_samplerates(const AVFilterFormats *a,
+                             const AVFilterFormats *b);
+
 /**
  * Add *ref as a new reference to formats.
  * That is the pointers will point like in the ascii art below:
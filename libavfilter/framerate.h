@@ -0,0 +1,38 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_FRAMERATE_H
+#define AVFILTER_FRAMERATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct FrameRateDSPContext {
+    /**
+     * Blend one line of width samples as
+     * (src1 * factor1 + src2 * factor2 + half) >> shift,
+     * with factor1 + factor2 == 1 << shift.
+     * The lines must be padded to a multiple of 32 bytes.
+     */
+    void (*blend)(const uint8_t *src1, const uint8_t *src2, uint8_t *dst,
+                  ptrdiff_t width, int factor1, int factor2, int half, int shift);
+} FrameRateDSPContext;
+
+void ff_framerate_dsp_init(FrameRateDSPContext *dsp, int bitdepth);
+
+#endif /* AVFILTER_FRAMERATE_H */
@@ -21,6 +21,7 @@
 
 #include <string.h>
 
+#include "libavutil/avstring.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/bprint.h"
 #include "libavutil/pixdesc.h"
@@ -60,7 +61,29 @@ static int print_link_prop(AVBPrint *buf, AVFilterLink *link)
     return buf->len;
 }
 
-static void avfilter_graph_dump_to_buf(AVBPrint *buf, AVFilterGraph *graph)
+static void dump_formats_timing(AVBPrint *buf, AVFilterGraph *graph)
+{
+    static const char *const stages[FF_FORMATS_NB] = {
+        [FF_FORMATS_QUERY]  = "query_formats",
+        [FF_FORMATS_REDUCE] = "reduce_formats",
+        [FF_FORMATS_SWAP]   = "swap_formats",
+        [FF_FORMATS_PICK]   = "pick_formats",
+    };
+    AVFilterGraphInternal *gi = graph->internal;
+    int64_t total = 0;
+    int i;
+
+    for (i = 0; i < FF_FORMATS_NB; i++)
+        total += gi->formats_time[i];
+    av_bprintf(buf, "Format negotiation: %"PRId64"us\n", total);
+    for (i = 0; i < FF_FORMATS_NB; i++)
+        av_bprintf(buf, "  %-15s %10"PRId64"us  %d round%s\n", stages[i],
+                   gi->formats_time[i], gi->formats_rounds[i],
+                   gi->formats_rounds[i] == 1 ? "" : "s");
+}
+
+static void avfilter_graph_dump_to_buf(AVBPrint *buf, AVFilterGraph *graph,
+                                       int timing)
 {
     unsigned i, j, x, e;
 
@@ -150,17 +173,21 @@ static void avfilter_graph_dump_to_buf(AVBPrint *buf, AVFilterGraph *graph)
         av_bprintf(buf, "+\n");
         av_bprintf(buf, "\n");
     }
+
+    if (timing)
+        dump_formats_timing(buf, graph);
 }
 
 char *avfilter_graph_dump(AVFilterGraph *graph, const char *options)
 {
     AVBPrint buf;
     char *dump;
+    int timing = options && av_match_name("timing", options);
 
     av_bprint_init(&buf, 0, 0);
-    avfilter_graph_dump_to_buf(&buf, graph);
+    avfilter_graph_dump_to_buf(&buf, graph, timing);
     av_bprint_init(&buf, buf.len + 1, buf.len + 1);
-    avfilter_graph_dump_to_buf(&buf, graph);
+    avfilter_graph_dump_to_buf(&buf, graph, timing);
     av_bprint_finalize(&buf, &dump);
     return dump;
 }
@@ -25,6 +25,7 @@
  */
 
 #include "libavutil/internal.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "avfiltergraph.h"
 #include "formats.h"
@@ -144,13 +145,33 @@ struct AVFilterPad {
     int needs_writable;
 };
 
+enum FFFormatsStage {
+    FF_FORMATS_QUERY,
+    FF_FORMATS_REDUCE,
+    FF_FORMATS_SWAP,
+    FF_FORMATS_PICK,
+    FF_FORMATS_NB
+};
+
 struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
+    void *branch_thread;
+    avfilter_execute_func *branch_execute;
+    /* protects the sink links heap, updated from the branches */
+    AVMutex sink_links_lock;
+    /* duration in microseconds and number of rounds of the format
+     * negotiation stages of the last avfilter_graph_config() */
+    int64_t formats_time[FF_FORMATS_NB];
+    int formats_rounds[FF_FORMATS_NB];
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+    /* 1 if the outputs lead to disjoint parts of the graph, -1 if they do
+     * not, 0 if not checked yet */
+    int branches_disjoint;
+    int *branch_rets;
 };
 
 /**
@@ -366,6 +387,20 @@ int ff_request_frame_to_filter(AVFilterLink *link);
  */
 int ff_filter_frame(AVFilterLink *link, AVFrame *frame);
 
+/**
+ * Send a frame to each output of a filter.
+ *
+ * With AVFILTER_THREAD_BRANCH, the outputs are processed concurrently if
+ * they lead to disjoint parts of the graph; otherwise, they are processed
+ * in order and the remaining frames are dropped after an error.
+ *
+ * @param frames ctx->nb_outputs frames, frames[i] is sent to
+ *               ctx->outputs[i] and may be NULL to skip that output;
+ *               the references are always taken
+ * @return >= 0 on success, or the error of the first output which failed
+ */
+int ff_filter_frame_branches(AVFilterContext *ctx, AVFrame **frames);
+
 /**
  * Allocate a new filter context and return it.
  *
@@ -0,0 +1,45 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_NNEDI_H
+#define AVFILTER_NNEDI_H
+
+#include <stdint.h>
+
+typedef struct NNEDIDSPContext {
+    /**
+     * Compute the dot products of data with n consecutive neurons of len
+     * weights each, storing the unscaled sums.
+     * n must be a multiple of 4 and len a multiple of 16.
+     */
+    void (*dot_prod)(const float *data, const float *weights,
+                     float *sums, int n, int len);
+    void (*dot_prods)(const int16_t *data, const int16_t *weights,
+                      int32_t *sums, int n, int len);
+
+    /**
+     * First layer of the new prescreener: 4 neurons of 64 taps, with the
+     * weights interleaved by groups of 8 taps.
+     */
+    void (*dot_prods_new)(const int16_t *data, const int16_t *weights,
+                          int32_t sums[4]);
+} NNEDIDSPContext;
+
+void ff_nnedi_dsp_init(NNEDIDSPContext *dsp);
+
+#endif /* AVFILTER_NNEDI_H */
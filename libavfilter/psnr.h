@@ -28,6 +28,15 @@ typedef struct PSNRDSPContext {
     uint64_t (*sse_line)(const uint8_t *buf, const uint8_t *ref, int w);
 } PSNRDSPContext;
 
+void ff_psnr_init(PSNRDSPContext *dsp, int bpp);
 void ff_psnr_init_x86(PSNRDSPContext *dsp, int bpp);
 
+/**
+ * Sum of squared errors over h lines of w samples.
+ */
+uint64_t ff_psnr_sse_plane(const PSNRDSPContext *dsp,
+                           const uint8_t *main_line, int main_linesize,
+                           const uint8_t *ref_line, int ref_linesize,
+                           int w, int h);
+
 #endif /* AVFILTER_PSNR_H */
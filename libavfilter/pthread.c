@@ -25,6 +25,7 @@
 
 #include "libavutil/common.h"
 #include "libavutil/cpu.h"
+#include "libavutil/executor.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 
@@ -49,6 +50,8 @@ typedef struct ThreadContext {
     pthread_cond_t last_job_cond;
     pthread_cond_t current_job_cond;
     pthread_mutex_t current_job_lock;
+    /* serializes the execute calls, which may come from several branches */
+    pthread_mutex_t execute_lock;
     int current_job;
     unsigned int current_execute;
     int done;
@@ -62,6 +65,10 @@ static void* attribute_align_arg worker(void *v)
     unsigned int last_execute = 0;
     int self_id;
 
+    if (c->graph->thread_affinity)
+        av_cpu_set_thread_affinity(c->graph->thread_affinity);
+    av_mem_set_context(c->graph);
+
     pthread_mutex_lock(&c->current_job_lock);
     self_id = c->current_job++;
     for (;;) {
@@ -101,6 +108,7 @@ static void slice_thread_uninit(ThreadContext *c)
          pthread_join(c->workers[i], NULL);
 
     pthread_mutex_destroy(&c->current_job_lock);
+    pthread_mutex_destroy(&c->execute_lock);
     pthread_cond_destroy(&c->current_job_cond);
     pthread_cond_destroy(&c->last_job_cond);
     av_freep(&c->workers);
@@ -113,15 +121,12 @@ static void slice_thread_park_workers(ThreadContext *c)
     pthread_mutex_unlock(&c->current_job_lock);
 }
 
-static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
-                          void *arg, int *ret, int nb_jobs)
+static void thread_execute_locked(ThreadContext *c, AVFilterContext *ctx,
+                                  avfilter_action_func *func, void *arg,
+                                  int *ret, int nb_jobs)
 {
-    ThreadContext *c = ctx->graph->internal->thread;
     int dummy_ret;
 
-    if (nb_jobs <= 0)
-        return 0;
-
     pthread_mutex_lock(&c->current_job_lock);
 
     c->current_job = c->nb_threads;
@@ -141,16 +146,77 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
     pthread_cond_broadcast(&c->current_job_cond);
 
     slice_thread_park_workers(c);
+}
+
+static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                          void *arg, int *ret, int nb_jobs)
+{
+    ThreadContext *c = ctx->graph->internal->thread;
+
+    if (nb_jobs <= 0)
+        return 0;
+
+    pthread_mutex_lock(&c->execute_lock);
+    thread_execute_locked(c, ctx, func, arg, ret, nb_jobs);
+    pthread_mutex_unlock(&c->execute_lock);
+
+    return 0;
+}
+
+static int branch_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                          void *arg, int *ret, int nb_jobs)
+{
+    ThreadContext *c = ctx->graph->internal->branch_thread;
+
+    if (nb_jobs <= 0)
+        return 0;
+
+    /* already running branches: the caller is one of them and must process
+     * its own outputs itself */
+    if (pthread_mutex_trylock(&c->execute_lock))
+        return AVERROR(EAGAIN);
+    thread_execute_locked(c, ctx, func, arg, ret, nb_jobs);
+    pthread_mutex_unlock(&c->execute_lock);
 
     return 0;
 }
 
-static int thread_init_internal(ThreadContext *c, int nb_threads)
+typedef struct ExecutorJobs {
+    AVFilterContext *ctx;
+    avfilter_action_func *func;
+    void *arg;
+    int nb_jobs;
+} ExecutorJobs;
+
+static int executor_job(void *arg, int jobnr, int threadnr)
+{
+    ExecutorJobs *j = arg;
+    return j->func(j->ctx, j->arg, jobnr, j->nb_jobs);
+}
+
+static int executor_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                            void *arg, int *ret, int nb_jobs)
+{
+    ExecutorJobs j = { ctx, func, arg, nb_jobs };
+
+    if (nb_jobs <= 0)
+        return 0;
+
+    /* the calls of several branches run side by side, no lock is needed */
+    return av_executor_execute(ctx->graph->executor, executor_job, &j, ret,
+                               nb_jobs, ctx->graph->nb_threads);
+}
+
+static int thread_init_internal(ThreadContext *c, AVFilterGraph *graph,
+                                int nb_threads)
 {
     int i, ret;
 
+    c->graph = graph;
+
     if (!nb_threads) {
-        int nb_cpus = av_cpu_count();
+        int nb_cpus = graph->thread_affinity ? av_cpu_affinity_count(graph->thread_affinity)
+                                             : av_cpu_count();
         // use number of cores + 1 as thread count if there is more than one
         if (nb_cpus > 1)
             nb_threads = nb_cpus + 1;
@@ -174,6 +240,7 @@ static int thread_init_internal(ThreadContext *c, int nb_threads)
     pthread_cond_init(&c->last_job_cond,    NULL);
 
     pthread_mutex_init(&c->current_job_lock, NULL);
+    pthread_mutex_init(&c->execute_lock, NULL);
     pthread_mutex_lock(&c->current_job_lock);
     for (i = 0; i < nb_threads; i++) {
         ret = pthread_create(&c->workers[i], NULL, worker, c);
@@ -203,20 +270,56 @@ int ff_graph_thread_init(AVFilterGraph *graph)
         return 0;
     }
 
-    graph->internal->thread = av_mallocz(sizeof(ThreadContext));
-    if (!graph->internal->thread)
-        return AVERROR(ENOMEM);
+    if (graph->thread_affinity &&
+        av_cpu_affinity_count(graph->thread_affinity) < 0) {
+        av_log(graph, AV_LOG_ERROR, "Invalid thread affinity '%s'\n",
+               graph->thread_affinity);
+        return AVERROR(EINVAL);
+    }
 
-    ret = thread_init_internal(graph->internal->thread, graph->nb_threads);
-    if (ret <= 1) {
-        av_freep(&graph->internal->thread);
-        graph->thread_type = 0;
-        graph->nb_threads  = 1;
-        return (ret < 0) ? ret : 0;
+    if (graph->executor) {
+        // the executor threads and the calling thread
+        int nb_threads = av_executor_get_nb_threads(graph->executor) + 1;
+        if (graph->nb_threads)
+            nb_threads = FFMIN(nb_threads, graph->nb_threads);
+        if (nb_threads <= 1) {
+            graph->thread_type = 0;
+            graph->nb_threads  = 1;
+            return 0;
+        }
+        graph->nb_threads = nb_threads;
+
+        graph->internal->thread_execute = executor_execute;
+    } else {
+        graph->internal->thread = av_mallocz(sizeof(ThreadContext));
+        if (!graph->internal->thread)
+            return AVERROR(ENOMEM);
+
+        ret = thread_init_internal(graph->internal->thread, graph, graph->nb_threads);
+        if (ret <= 1) {
+            av_freep(&graph->internal->thread);
+            graph->thread_type = 0;
+            graph->nb_threads  = 1;
+            return (ret < 0) ? ret : 0;
+        }
+        graph->nb_threads = ret;
+
+        graph->internal->thread_execute = thread_execute;
     }
-    graph->nb_threads = ret;
 
-    graph->internal->thread_execute = thread_execute;
+    if (graph->thread_type & AVFILTER_THREAD_BRANCH) {
+        graph->internal->branch_thread = av_mallocz(sizeof(ThreadContext));
+        if (!graph->internal->branch_thread)
+            return AVERROR(ENOMEM);
+
+        ret = thread_init_internal(graph->internal->branch_thread, graph, graph->nb_threads);
+        if (ret <= 1) {
+            av_freep(&graph->internal->branch_thread);
+            graph->thread_type &= ~AVFILTER_THREAD_BRANCH;
+            return (ret < 0) ? ret : 0;
+        }
+        graph->internal->branch_execute = branch_execute;
+    }
 
     return 0;
 }
@@ -226,4 +329,7 @@ void ff_graph_thread_free(AVFilterGraph *graph)
     if (graph->internal->thread)
         slice_thread_uninit(graph->internal->thread);
     av_freep(&graph->internal->thread);
+    if (graph->internal->branch_thread)
+        slice_thread_uninit(graph->internal->branch_thread);
+    av_freep(&graph->internal->branch_thread);
 }
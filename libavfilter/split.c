@@ -39,6 +39,7 @@
 typedef struct SplitContext {
     const AVClass *class;
     int nb_outputs;
+    AVFrame **frames;
 } SplitContext;
 
 static av_cold int split_init(AVFilterContext *ctx)
@@ -59,39 +60,48 @@ static av_cold int split_init(AVFilterContext *ctx)
         ff_insert_outpad(ctx, i, &pad);
     }
 
+    s->frames = av_calloc(s->nb_outputs, sizeof(*s->frames));
+    if (!s->frames)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
 static av_cold void split_uninit(AVFilterContext *ctx)
 {
+    SplitContext *s = ctx->priv;
     int i;
 
     for (i = 0; i < ctx->nb_outputs; i++)
         av_freep(&ctx->output_pads[i].name);
+    av_freep(&s->frames);
 }
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
-    int i, ret = AVERROR_EOF;
+    SplitContext *s = ctx->priv;
+    int i, nb_frames = 0;
 
     for (i = 0; i < ctx->nb_outputs; i++) {
-        AVFrame *buf_out;
-
+        s->frames[i] = NULL;
         if (ctx->outputs[i]->status)
             continue;
-        buf_out = av_frame_clone(frame);
-        if (!buf_out) {
-            ret = AVERROR(ENOMEM);
-            break;
+        s->frames[i] = av_frame_clone(frame);
+        if (!s->frames[i]) {
+            while (i--)
+                av_frame_free(&s->frames[i]);
+            av_frame_free(&frame);
+            return AVERROR(ENOMEM);
         }
-
-        ret = ff_filter_frame(ctx->outputs[i], buf_out);
-        if (ret < 0)
-            break;
+        nb_frames++;
     }
     av_frame_free(&frame);
-    return ret;
+    if (!nb_frames)
+        return AVERROR_EOF;
+
+    /* the outputs may be processed concurrently with branch threading */
+    return ff_filter_frame_branches(ctx, s->frames);
 }
 
 #define OFFSET(x) offsetof(SplitContext, x)
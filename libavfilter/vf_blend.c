@@ -190,6 +190,19 @@ static void blend_## name##_8bit(const uint8_t *top, ptrdiff_t top_linesize,
     double opacity = param->opacity;                                           \
     int i, j;                                                                  \
                                                                                \
+    if (opacity == 1) {                                                        \
+        /* no conversion to double, so the loop can be vectorized */           \
+        for (i = 0; i < height; i++) {                                         \
+            for (j = 0; j < width; j++) {                                      \
+                dst[j] = expr;                                                 \
+            }                                                                  \
+            dst    += dst_linesize;                                            \
+            top    += top_linesize;                                            \
+            bottom += bottom_linesize;                                         \
+        }                                                                      \
+        return;                                                                \
+    }                                                                          \
+                                                                               \
     for (i = 0; i < height; i++) {                                             \
         for (j = 0; j < width; j++) {                                          \
             dst[j] = top[j] + ((expr) - top[j]) * opacity;                     \
@@ -216,6 +229,19 @@ static void blend_## name##_16bit(const uint8_t *_top, ptrdiff_t top_linesize,
     top_linesize /= 2;                                                         \
     bottom_linesize /= 2;                                                      \
                                                                                \
+    if (opacity == 1) {                                                        \
+        /* no conversion to double, so the loop can be vectorized */           \
+        for (i = 0; i < height; i++) {                                         \
+            for (j = 0; j < width; j++) {                                      \
+                dst[j] = expr;                                                 \
+            }                                                                  \
+            dst    += dst_linesize;                                            \
+            top    += top_linesize;                                            \
+            bottom += bottom_linesize;                                         \
+        }                                                                      \
+        return;                                                                \
+    }                                                                          \
+                                                                               \
     for (i = 0; i < height; i++) {                                             \
         for (j = 0; j < width; j++) {                                          \
             dst[j] = top[j] + ((expr) - top[j]) * opacity;                     \
@@ -0,0 +1,933 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Convert between colorspaces: matrix coefficients, primaries, transfer
+ * characteristics, range and bit depth, in a single pass.
+ *
+ * Conversions which only change the matrix coefficients, range or bit depth
+ * are done with a single 3x3 matrix in the YUV domain. Otherwise the frame
+ * is converted to 16-bit RGB, linearized, converted to the output primaries
+ * in linear light, delinearized and converted back to YUV.
+ */
+
+#include "libavutil/avassert.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/pixfmt.h"
+
+#include "avfilter.h"
+#include "colorspacedsp.h"
+#include "formats.h"
+#include "internal.h"
+#include "video.h"
+
+enum Colorspace {
+    CS_UNSPECIFIED,
+    CS_BT470M,
+    CS_BT470BG,
+    CS_BT601_6_525,
+    CS_BT601_6_625,
+    CS_BT709,
+    CS_SMPTE170M,
+    CS_SMPTE240M,
+    CS_BT2020,
+    CS_NB,
+};
+
+static const enum AVColorTransferCharacteristic default_trc[CS_NB + 1] = {
+    [CS_UNSPECIFIED] = AVCOL_TRC_UNSPECIFIED,
+    [CS_BT470M]      = AVCOL_TRC_GAMMA22,
+    [CS_BT470BG]     = AVCOL_TRC_GAMMA28,
+    [CS_BT601_6_525] = AVCOL_TRC_SMPTE170M,
+    [CS_BT601_6_625] = AVCOL_TRC_SMPTE170M,
+    [CS_BT709]       = AVCOL_TRC_BT709,
+    [CS_SMPTE170M]   = AVCOL_TRC_SMPTE170M,
+    [CS_SMPTE240M]   = AVCOL_TRC_SMPTE240M,
+    [CS_BT2020]      = AVCOL_TRC_BT2020_10,
+    [CS_NB]          = AVCOL_TRC_UNSPECIFIED,
+};
+
+static const enum AVColorPrimaries default_prm[CS_NB + 1] = {
+    [CS_UNSPECIFIED] = AVCOL_PRI_UNSPECIFIED,
+    [CS_BT470M]      = AVCOL_PRI_BT470M,
+    [CS_BT470BG]     = AVCOL_PRI_BT470BG,
+    [CS_BT601_6_525] = AVCOL_PRI_SMPTE170M,
+    [CS_BT601_6_625] = AVCOL_PRI_BT470BG,
+    [CS_BT709]       = AVCOL_PRI_BT709,
+    [CS_SMPTE170M]   = AVCOL_PRI_SMPTE170M,
+    [CS_SMPTE240M]   = AVCOL_PRI_SMPTE240M,
+    [CS_BT2020]      = AVCOL_PRI_BT2020,
+    [CS_NB]          = AVCOL_PRI_UNSPECIFIED,
+};
+
+static const enum AVColorSpace default_csp[CS_NB + 1] = {
+    [CS_UNSPECIFIED] = AVCOL_SPC_UNSPECIFIED,
+    [CS_BT470M]      = AVCOL_SPC_SMPTE170M,
+    [CS_BT470BG]     = AVCOL_SPC_BT470BG,
+    [CS_BT601_6_525] = AVCOL_SPC_SMPTE170M,
+    [CS_BT601_6_625] = AVCOL_SPC_BT470BG,
+    [CS_BT709]       = AVCOL_SPC_BT709,
+    [CS_SMPTE170M]   = AVCOL_SPC_SMPTE170M,
+    [CS_SMPTE240M]   = AVCOL_SPC_SMPTE240M,
+    [CS_BT2020]      = AVCOL_SPC_BT2020_NCL,
+    [CS_NB]          = AVCOL_SPC_UNSPECIFIED,
+};
+
+struct ColorPrimaries {
+    double xw, yw;              ///< white point
+    double xr, yr, xg, yg, xb, yb;
+};
+
+struct TransferCharacteristics {
+    double alpha, beta, gamma, delta;
+};
+
+struct LumaCoefficients {
+    double cr, cg, cb;
+};
+
+typedef struct ColorSpaceProps {
+    enum AVColorSpace csp;
+    enum AVColorRange rng;
+    enum AVColorTransferCharacteristic trc;
+    enum AVColorPrimaries prm;
+    enum AVPixelFormat format;
+} ColorSpaceProps;
+
+typedef struct ColorSpaceContext {
+    const AVClass *class;
+
+    ColorSpaceDSPContext dsp;
+
+    enum Colorspace user_all, user_iall;
+    enum AVColorSpace user_csp, user_icsp;
+    enum AVColorRange user_rng, user_irng;
+    enum AVColorTransferCharacteristic user_trc, user_itrc;
+    enum AVColorPrimaries user_prm, user_iprm;
+    enum AVPixelFormat user_format;
+    int fast_mode;
+
+    ColorSpaceProps in, out;    ///< properties the conversion was set up for
+    int configured;
+
+    int16_t *rgb[3];
+    ptrdiff_t rgb_stride;
+    int rgb_w, rgb_h;
+
+    int lrgb2lrgb_passthrough;
+    DECLARE_ALIGNED(16, int16_t, lrgb2lrgb_coeffs)[3][3][8];
+
+    int rgb2rgb_passthrough;
+    int16_t *lin_lut, *delin_lut;
+    enum AVColorTransferCharacteristic lut_in_trc, lut_out_trc;
+
+    int yuv2yuv_fastmode;
+    DECLARE_ALIGNED(16, int16_t, yuv2rgb_coeffs)[3][3][8];
+    DECLARE_ALIGNED(16, int16_t, rgb2yuv_coeffs)[3][3][8];
+    DECLARE_ALIGNED(16, int16_t, yuv2yuv_coeffs)[3][3][8];
+    DECLARE_ALIGNED(16, int16_t, yuv_offset)[2 /* in, out */][8];
+    yuv2rgb_fn yuv2rgb;
+    rgb2yuv_fn rgb2yuv;
+    yuv2yuv_fn yuv2yuv;
+    int slice_unit;             ///< lines per slice unit, a multiple of the chroma subsampling
+} ColorSpaceContext;
+
+static const struct LumaCoefficients luma_coefficients[AVCOL_SPC_NB] = {
+    [AVCOL_SPC_FCC]        = { 0.30,   0.59,   0.11   },
+    [AVCOL_SPC_BT470BG]    = { 0.299,  0.587,  0.114  },
+    [AVCOL_SPC_SMPTE170M]  = { 0.299,  0.587,  0.114  },
+    [AVCOL_SPC_BT709]      = { 0.2126, 0.7152, 0.0722 },
+    [AVCOL_SPC_SMPTE240M]  = { 0.212,  0.701,  0.087  },
+    [AVCOL_SPC_BT2020_NCL] = { 0.2627, 0.6780, 0.0593 },
+};
+
+static const struct LumaCoefficients *get_luma_coefficients(enum AVColorSpace csp)
+{
+    const struct LumaCoefficients *coeffs;
+
+    if (csp >= AVCOL_SPC_NB)
+        return NULL;
+    coeffs = &luma_coefficients[csp];
+    if (!coeffs->cr)
+        return NULL;
+
+    return coeffs;
+}
+
+#define WP_D65 0.3127, 0.3290
+#define WP_C   0.310,  0.316
+#define WP_E   1.0/3,  1.0/3
+
+static const struct ColorPrimaries color_primaries[AVCOL_PRI_NB] = {
+    [AVCOL_PRI_BT709]        = { WP_D65, 0.640, 0.330, 0.300, 0.600, 0.150, 0.060 },
+    [AVCOL_PRI_BT470M]       = { WP_C,   0.670, 0.330, 0.210, 0.710, 0.140, 0.080 },
+    [AVCOL_PRI_BT470BG]      = { WP_D65, 0.640, 0.330, 0.290, 0.600, 0.150, 0.060 },
+    [AVCOL_PRI_SMPTE170M]    = { WP_D65, 0.630, 0.340, 0.310, 0.595, 0.155, 0.070 },
+    [AVCOL_PRI_SMPTE240M]    = { WP_D65, 0.630, 0.340, 0.310, 0.595, 0.155, 0.070 },
+    [AVCOL_PRI_FILM]         = { WP_C,   0.681, 0.319, 0.243, 0.692, 0.145, 0.049 },
+    [AVCOL_PRI_BT2020]       = { WP_D65, 0.708, 0.292, 0.170, 0.797, 0.131, 0.046 },
+    [AVCOL_PRI_SMPTEST428_1] = { WP_E,   0.735, 0.265, 0.274, 0.718, 0.167, 0.009 },
+};
+
+static const struct ColorPrimaries *get_color_primaries(enum AVColorPrimaries prm)
+{
+    const struct ColorPrimaries *p;
+
+    if (prm >= AVCOL_PRI_NB)
+        return NULL;
+    p = &color_primaries[prm];
+    if (!p->xr)
+        return NULL;
+
+    return p;
+}
+
+static const struct TransferCharacteristics transfer_characteristics[AVCOL_TRC_NB] = {
+    [AVCOL_TRC_BT709]        = { 1.099,  0.018,     0.45,      4.5   },
+    [AVCOL_TRC_GAMMA22]      = { 1.0,    0.0,       1.0 / 2.2, 0.0   },
+    [AVCOL_TRC_GAMMA28]      = { 1.0,    0.0,       1.0 / 2.8, 0.0   },
+    [AVCOL_TRC_SMPTE170M]    = { 1.099,  0.018,     0.45,      4.5   },
+    [AVCOL_TRC_SMPTE240M]    = { 1.1115, 0.0228,    0.45,      4.0   },
+    [AVCOL_TRC_LINEAR]       = { 1.0,    0.0,       1.0,       0.0   },
+    [AVCOL_TRC_IEC61966_2_4] = { 1.099,  0.018,     0.45,      4.5   },
+    [AVCOL_TRC_IEC61966_2_1] = { 1.055,  0.0031308, 1.0 / 2.4, 12.92 },
+    [AVCOL_TRC_BT2020_10]    = { 1.099,  0.018,     0.45,      4.5   },
+    [AVCOL_TRC_BT2020_12]    = { 1.0993, 0.0181,    0.45,      4.5   },
+};
+
+static const struct TransferCharacteristics *
+    get_transfer_characteristics(enum AVColorTransferCharacteristic trc)
+{
+    const struct TransferCharacteristics *coeffs;
+
+    if (trc >= AVCOL_TRC_NB)
+        return NULL;
+    coeffs = &transfer_characteristics[trc];
+    if (!coeffs->alpha)
+        return NULL;
+
+    return coeffs;
+}
+
+static void invert_matrix3x3(const double in[3][3], double out[3][3])
+{
+    double m00 = in[0][0], m01 = in[0][1], m02 = in[0][2],
+           m10 = in[1][0], m11 = in[1][1], m12 = in[1][2],
+           m20 = in[2][0], m21 = in[2][1], m22 = in[2][2];
+    int i, j;
+    double det;
+
+    out[0][0] =  (m11 * m22 - m21 * m12);
+    out[0][1] = -(m01 * m22 - m21 * m02);
+    out[0][2] =  (m01 * m12 - m11 * m02);
+    out[1][0] = -(m10 * m22 - m20 * m12);
+    out[1][1] =  (m00 * m22 - m20 * m02);
+    out[1][2] = -(m00 * m12 - m10 * m02);
+    out[2][0] =  (m10 * m21 - m20 * m11);
+    out[2][1] = -(m00 * m21 - m20 * m01);
+    out[2][2] =  (m00 * m11 - m10 * m01);
+
+    det = m00 * out[0][0] + m10 * out[0][1] + m20 * out[0][2];
+    det = 1.0 / det;
+
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++)
+            out[i][j] *= det;
+    }
+}
+
+static void mul3x3(double dst[3][3], const double src1[3][3], const double src2[3][3])
+{
+    int m, n;
+
+    for (m = 0; m < 3; m++)
+        for (n = 0; n < 3; n++)
+            dst[m][n] = src1[m][0] * src2[0][n] +
+                        src1[m][1] * src2[1][n] +
+                        src1[m][2] * src2[2][n];
+}
+
+static void fill_rgb2xyz_table(const struct ColorPrimaries *coeffs,
+                               double rgb2xyz[3][3])
+{
+    double i[3][3], sr, sg, sb, xw, zw;
+
+    rgb2xyz[0][0] = coeffs->xr / coeffs->yr;
+    rgb2xyz[0][1] = coeffs->xg / coeffs->yg;
+    rgb2xyz[0][2] = coeffs->xb / coeffs->yb;
+    rgb2xyz[1][0] = rgb2xyz[1][1] = rgb2xyz[1][2] = 1.0;
+    rgb2xyz[2][0] = (1.0 - coeffs->xr - coeffs->yr) / coeffs->yr;
+    rgb2xyz[2][1] = (1.0 - coeffs->xg - coeffs->yg) / coeffs->yg;
+    rgb2xyz[2][2] = (1.0 - coeffs->xb - coeffs->yb) / coeffs->yb;
+    invert_matrix3x3(rgb2xyz, i);
+
+    /* scale the primaries so that RGB = 1.0 gives the white point at Y = 1.0 */
+    xw = coeffs->xw / coeffs->yw;
+    zw = (1.0 - coeffs->xw - coeffs->yw) / coeffs->yw;
+    sr = i[0][0] * xw + i[0][1] + i[0][2] * zw;
+    sg = i[1][0] * xw + i[1][1] + i[1][2] * zw;
+    sb = i[2][0] * xw + i[2][1] + i[2][2] * zw;
+    rgb2xyz[0][0] *= sr;
+    rgb2xyz[0][1] *= sg;
+    rgb2xyz[0][2] *= sb;
+    rgb2xyz[1][0] *= sr;
+    rgb2xyz[1][1] *= sg;
+    rgb2xyz[1][2] *= sb;
+    rgb2xyz[2][0] *= sr;
+    rgb2xyz[2][1] *= sg;
+    rgb2xyz[2][2] *= sb;
+}
+
+/* Bradford chromatic adaptation from the white point of src to that of dst */
+static void fill_whitepoint_conv_table(double out[3][3],
+                                       const struct ColorPrimaries *src,
+                                       const struct ColorPrimaries *dst)
+{
+    static const double ma[3][3] = {
+        {  0.8951,  0.2664, -0.1614 },
+        { -0.7502,  1.7135,  0.0367 },
+        {  0.0389, -0.0685,  1.0296 },
+    };
+    double ima[3][3], fac[3][3] = { { 0 } }, tmp[3][3];
+    double src_xyz[3] = { src->xw / src->yw, 1.0, (1.0 - src->xw - src->yw) / src->yw };
+    double dst_xyz[3] = { dst->xw / dst->yw, 1.0, (1.0 - dst->xw - dst->yw) / dst->yw };
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        double rs = ma[i][0] * src_xyz[0] + ma[i][1] * src_xyz[1] + ma[i][2] * src_xyz[2];
+        double rd = ma[i][0] * dst_xyz[0] + ma[i][1] * dst_xyz[1] + ma[i][2] * dst_xyz[2];
+
+        fac[i][i] = rd / rs;
+    }
+    invert_matrix3x3(ma, ima);
+    mul3x3(tmp, fac, ma);
+    mul3x3(out, ima, tmp);
+}
+
+static void fill_rgb2yuv_table(const struct LumaCoefficients *coeffs,
+                               double rgb2yuv[3][3])
+{
+    double bscale, rscale;
+
+    rgb2yuv[0][0] = coeffs->cr;
+    rgb2yuv[0][1] = coeffs->cg;
+    rgb2yuv[0][2] = coeffs->cb;
+    bscale = 0.5 / (coeffs->cb - 1.0);
+    rscale = 0.5 / (coeffs->cr - 1.0);
+    rgb2yuv[1][0] = bscale * coeffs->cr;
+    rgb2yuv[1][1] = bscale * coeffs->cg;
+    rgb2yuv[1][2] = 0.5;
+    rgb2yuv[2][0] = 0.5;
+    rgb2yuv[2][1] = rscale * coeffs->cg;
+    rgb2yuv[2][2] = rscale * coeffs->cb;
+}
+
+static int fill_gamma_table(ColorSpaceContext *s,
+                            const struct TransferCharacteristics *in_txchr,
+                            const struct TransferCharacteristics *out_txchr)
+{
+    int n;
+    double in_alpha  = in_txchr->alpha,  in_beta  = in_txchr->beta;
+    double in_gamma  = in_txchr->gamma,  in_delta = in_txchr->delta;
+    double in_ialpha = 1.0 / in_alpha,   in_igamma = 1.0 / in_gamma;
+    double out_alpha = out_txchr->alpha, out_beta  = out_txchr->beta;
+    double out_gamma = out_txchr->gamma, out_delta = out_txchr->delta;
+
+    if (!s->lin_lut) {
+        s->lin_lut = av_malloc(sizeof(*s->lin_lut) * 32768 * 2);
+        if (!s->lin_lut)
+            return AVERROR(ENOMEM);
+        s->delin_lut = &s->lin_lut[32768];
+    }
+
+    for (n = 0; n < 32768; n++) {
+        double v = (n - 2048.0) / 28672.0, d, l;
+
+        // delinearize
+        if (v <= -out_beta) {
+            d = -out_alpha * pow(-v, out_gamma) + (out_alpha - 1.0);
+        } else if (v < out_beta) {
+            d = out_delta * v;
+        } else {
+            d = out_alpha * pow(v, out_gamma) - (out_alpha - 1.0);
+        }
+        s->delin_lut[n] = av_clip_int16(lrint(d * 28672.0));
+
+        // linearize
+        if (v <= -in_beta * in_delta) {
+            l = -pow((1.0 - in_alpha - v) * in_ialpha, in_igamma);
+        } else if (v < in_beta * in_delta) {
+            l = v / in_delta;
+        } else {
+            l = pow((v + in_alpha - 1.0) * in_ialpha, in_igamma);
+        }
+        s->lin_lut[n] = av_clip_int16(lrint(l * 28672.0));
+    }
+
+    return 0;
+}
+
+static void get_range_off(int *off, int *y_rng, int *uv_rng,
+                          enum AVColorRange rng, int depth)
+{
+    if (rng == AVCOL_RANGE_JPEG) {
+        *off    = 0;
+        *y_rng  = *uv_rng = (256 << (depth - 8)) - 1;
+    } else {
+        *off    = 16 << (depth - 8);
+        *y_rng  = 219 << (depth - 8);
+        *uv_rng = 224 << (depth - 8);
+    }
+}
+
+static void apply_lut(int16_t *buf[3], ptrdiff_t stride,
+                      int w, int h, const int16_t *lut)
+{
+    int y, x, n;
+
+    for (n = 0; n < 3; n++) {
+        int16_t *data = buf[n];
+
+        for (y = 0; y < h; y++) {
+            for (x = 0; x < w; x++)
+                data[x] = lut[av_clip_uintp2(2048 + data[x], 15)];
+
+            data += stride;
+        }
+    }
+}
+
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    ptrdiff_t in_linesize[3], out_linesize[3];
+    int in_ss_h, out_ss_h;
+} ThreadData;
+
+static int convert(AVFilterContext *ctx, void *data, int job_nr, int n_jobs)
+{
+    const ThreadData *td = data;
+    ColorSpaceContext *s = ctx->priv;
+    uint8_t *in_data[3], *out_data[3];
+    int16_t *rgb[3];
+    int n_units = td->in->height / s->slice_unit;
+    int h1 = s->slice_unit * ( job_nr      * n_units / n_jobs);
+    int h2 = s->slice_unit * ((job_nr + 1) * n_units / n_jobs);
+    int w = td->in->width, h = h2 - h1;
+
+    in_data[0]  = td->in->data[0]  + td->in_linesize[0]  *  h1;
+    in_data[1]  = td->in->data[1]  + td->in_linesize[1]  * (h1 >> td->in_ss_h);
+    in_data[2]  = td->in->data[2]  + td->in_linesize[2]  * (h1 >> td->in_ss_h);
+    out_data[0] = td->out->data[0] + td->out_linesize[0] *  h1;
+    out_data[1] = td->out->data[1] + td->out_linesize[1] * (h1 >> td->out_ss_h);
+    out_data[2] = td->out->data[2] + td->out_linesize[2] * (h1 >> td->out_ss_h);
+
+    if (s->yuv2yuv_fastmode) {
+        s->yuv2yuv(out_data, td->out_linesize, in_data, td->in_linesize, w, h,
+                   s->yuv2yuv_coeffs, s->yuv_offset);
+    } else {
+        rgb[0] = s->rgb[0] + s->rgb_stride * h1;
+        rgb[1] = s->rgb[1] + s->rgb_stride * h1;
+        rgb[2] = s->rgb[2] + s->rgb_stride * h1;
+
+        s->yuv2rgb(rgb, s->rgb_stride, in_data, td->in_linesize, w, h,
+                   s->yuv2rgb_coeffs, s->yuv_offset[0]);
+        if (!s->rgb2rgb_passthrough) {
+            apply_lut(rgb, s->rgb_stride, w, h, s->lin_lut);
+            if (!s->lrgb2lrgb_passthrough)
+                s->dsp.multiply3x3(rgb, s->rgb_stride, w, h, s->lrgb2lrgb_coeffs);
+            apply_lut(rgb, s->rgb_stride, w, h, s->delin_lut);
+        }
+        s->rgb2yuv(out_data, td->out_linesize, rgb, s->rgb_stride, w, h,
+                   s->rgb2yuv_coeffs, s->yuv_offset[1]);
+    }
+
+    return 0;
+}
+
+static void fill_coeffs(int16_t dst[3][3][8], const double src[3][3],
+                        const double row_scale[3], const double col_scale[3])
+{
+    int m, n, o;
+
+    for (m = 0; m < 3; m++)
+        for (n = 0; n < 3; n++) {
+            int v = av_clip_int16(lrint(src[m][n] * row_scale[m] * col_scale[n]));
+
+            for (o = 0; o < 8; o++)
+                dst[m][n][o] = v;
+        }
+}
+
+static int create_filtergraph(AVFilterContext *ctx,
+                              const ColorSpaceProps *in, const ColorSpaceProps *out)
+{
+    ColorSpaceContext *s = ctx->priv;
+    const AVPixFmtDescriptor *in_desc  = av_pix_fmt_desc_get(in->format);
+    const AVPixFmtDescriptor *out_desc = av_pix_fmt_desc_get(out->format);
+    const struct LumaCoefficients *in_lumacoef, *out_lumacoef;
+    const struct ColorPrimaries *in_primaries, *out_primaries;
+    const struct TransferCharacteristics *in_txchr, *out_txchr;
+    int in_depth = in_desc->comp[0].depth, out_depth = out_desc->comp[0].depth;
+    int in_ss = in_desc->log2_chroma_w + in_desc->log2_chroma_h;
+    int out_ss = out_desc->log2_chroma_w + out_desc->log2_chroma_h;
+    int in_off, in_y_rng, in_uv_rng, out_off, out_y_rng, out_uv_rng;
+    double yuv2rgb[3][3], rgb2yuv[3][3], yuv2yuv[3][3];
+    double row_scale[3], col_scale[3];
+    int n, res;
+
+    in_lumacoef  = get_luma_coefficients(in->csp);
+    out_lumacoef = get_luma_coefficients(out->csp);
+    if (!in_lumacoef || !out_lumacoef) {
+        av_log(ctx, AV_LOG_ERROR, "Unsupported %s colorspace %d (%s)\n",
+               in_lumacoef ? "output" : "input",
+               in_lumacoef ? out->csp : in->csp,
+               av_color_space_name(in_lumacoef ? out->csp : in->csp));
+        return AVERROR(EINVAL);
+    }
+
+    s->lrgb2lrgb_passthrough = s->fast_mode || in->prm == out->prm;
+    s->rgb2rgb_passthrough   = s->fast_mode ||
+                               (s->lrgb2lrgb_passthrough && in->trc == out->trc);
+
+    if (!s->lrgb2lrgb_passthrough) {
+        double rgb2xyz[3][3], xyz2rgb[3][3], wp_adapt[3][3], tmp[3][3], lrgb2lrgb[3][3];
+
+        in_primaries  = get_color_primaries(in->prm);
+        out_primaries = get_color_primaries(out->prm);
+        if (!in_primaries || !out_primaries) {
+            av_log(ctx, AV_LOG_ERROR, "Unsupported %s primaries %d (%s)\n",
+                   in_primaries ? "output" : "input",
+                   in_primaries ? out->prm : in->prm,
+                   av_color_primaries_name(in_primaries ? out->prm : in->prm));
+            return AVERROR(EINVAL);
+        }
+
+        fill_rgb2xyz_table(out_primaries, tmp);
+        invert_matrix3x3(tmp, xyz2rgb);
+        fill_rgb2xyz_table(in_primaries, rgb2xyz);
+        if (in_primaries->xw != out_primaries->xw ||
+            in_primaries->yw != out_primaries->yw) {
+            fill_whitepoint_conv_table(wp_adapt, in_primaries, out_primaries);
+            mul3x3(tmp, wp_adapt, rgb2xyz);
+            memcpy(rgb2xyz, tmp, sizeof(tmp));
+        }
+        mul3x3(lrgb2lrgb, xyz2rgb, rgb2xyz);
+
+        for (n = 0; n < 3; n++) {
+            row_scale[n] = 1 << 14;
+            col_scale[n] = 1.0;
+        }
+        fill_coeffs(s->lrgb2lrgb_coeffs, lrgb2lrgb, row_scale, col_scale);
+    }
+
+    if (!s->rgb2rgb_passthrough &&
+        (!s->lin_lut || s->lut_in_trc != in->trc || s->lut_out_trc != out->trc)) {
+        in_txchr  = get_transfer_characteristics(in->trc);
+        out_txchr = get_transfer_characteristics(out->trc);
+        if (!in_txchr || !out_txchr) {
+            av_log(ctx, AV_LOG_ERROR, "Unsupported %s transfer characteristics %d (%s)\n",
+                   in_txchr ? "output" : "input",
+                   in_txchr ? out->trc : in->trc,
+                   av_color_transfer_name(in_txchr ? out->trc : in->trc));
+            return AVERROR(EINVAL);
+        }
+        res = fill_gamma_table(s, in_txchr, out_txchr);
+        if (res < 0)
+            return res;
+        s->lut_in_trc  = in->trc;
+        s->lut_out_trc = out->trc;
+    }
+
+    get_range_off(&in_off,  &in_y_rng,  &in_uv_rng,  in->rng,  in_depth);
+    get_range_off(&out_off, &out_y_rng, &out_uv_rng, out->rng, out_depth);
+    for (n = 0; n < 8; n++) {
+        s->yuv_offset[0][n] = in_off;
+        s->yuv_offset[1][n] = out_off;
+    }
+
+    fill_rgb2yuv_table(in_lumacoef, rgb2yuv);
+    invert_matrix3x3(rgb2yuv, yuv2rgb);
+    fill_rgb2yuv_table(out_lumacoef, rgb2yuv);
+
+    s->yuv2yuv_fastmode = s->rgb2rgb_passthrough && in_ss == out_ss &&
+                          in_desc->log2_chroma_w == out_desc->log2_chroma_w;
+    if (s->yuv2yuv_fastmode) {
+        mul3x3(yuv2yuv, rgb2yuv, yuv2rgb);
+        for (n = 0; n < 3; n++) {
+            row_scale[n] = (n ? out_uv_rng : out_y_rng) *
+                           (double)(1 << (14 + in_depth - out_depth));
+            col_scale[n] = 1.0 / (n ? in_uv_rng : in_y_rng);
+        }
+        fill_coeffs(s->yuv2yuv_coeffs, yuv2yuv, row_scale, col_scale);
+        s->yuv2yuv = s->dsp.yuv2yuv[(in_depth - 8) >> 1][(out_depth - 8) >> 1][in_ss];
+    } else {
+        for (n = 0; n < 3; n++) {
+            row_scale[n] = 28672.0 * (1 << (in_depth - 1));
+            col_scale[n] = 1.0 / (n ? in_uv_rng : in_y_rng);
+        }
+        fill_coeffs(s->yuv2rgb_coeffs, yuv2rgb, row_scale, col_scale);
+        for (n = 0; n < 3; n++) {
+            row_scale[n] = (n ? out_uv_rng : out_y_rng) *
+                           (double)(1 << (29 - out_depth)) / 28672.0;
+            col_scale[n] = 1.0;
+        }
+        fill_coeffs(s->rgb2yuv_coeffs, rgb2yuv, row_scale, col_scale);
+        s->yuv2rgb = s->dsp.yuv2rgb[(in_depth  - 8) >> 1][in_ss];
+        s->rgb2yuv = s->dsp.rgb2yuv[(out_depth - 8) >> 1][out_ss];
+    }
+
+    s->slice_unit = 1 << FFMAX(in_desc->log2_chroma_h, out_desc->log2_chroma_h);
+
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    ColorSpaceContext *s = ctx->priv;
+
+    ff_colorspacedsp_init(&s->dsp);
+
+    return 0;
+}
+
+static void uninit_rgb(ColorSpaceContext *s)
+{
+    av_freep(&s->rgb[0]);
+    av_freep(&s->rgb[1]);
+    av_freep(&s->rgb[2]);
+    s->rgb_w = s->rgb_h = 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    ColorSpaceContext *s = ctx->priv;
+
+    uninit_rgb(s);
+    av_freep(&s->lin_lut);
+}
+
+static int alloc_rgb(ColorSpaceContext *s, int w, int h)
+{
+    int n;
+
+    if (s->rgb[0] && s->rgb_w == w && s->rgb_h == h)
+        return 0;
+
+    uninit_rgb(s);
+    /* aligned rows, so that SIMD versions of the DSP functions may process
+     * whole vectors past the width */
+    s->rgb_stride = FFALIGN(w, 32);
+    for (n = 0; n < 3; n++) {
+        s->rgb[n] = av_malloc_array(s->rgb_stride * h, sizeof(*s->rgb[n]));
+        if (!s->rgb[n]) {
+            uninit_rgb(s);
+            return AVERROR(ENOMEM);
+        }
+    }
+    s->rgb_w = w;
+    s->rgb_h = h;
+
+    return 0;
+}
+
+static void get_props(ColorSpaceContext *s, const AVFrame *in,
+                      ColorSpaceProps *iprops, ColorSpaceProps *oprops,
+                      enum AVPixelFormat out_format)
+{
+    int iall = FFMIN(s->user_iall, CS_NB);
+    int all  = FFMIN(s->user_all,  CS_NB);
+
+#define GET_PROP(prop, user_in, user_out, def, frame_prop)                  \
+    iprops->prop = s->user_in != def ? s->user_in :                         \
+                   iall != CS_UNSPECIFIED ? default_##prop[iall] :          \
+                   in->frame_prop;                                          \
+    oprops->prop = s->user_out != def ? s->user_out :                       \
+                   all != CS_UNSPECIFIED ? default_##prop[all] :            \
+                   iprops->prop
+
+    GET_PROP(csp, user_icsp, user_csp, AVCOL_SPC_UNSPECIFIED, colorspace);
+    GET_PROP(trc, user_itrc, user_trc, AVCOL_TRC_UNSPECIFIED, color_trc);
+    GET_PROP(prm, user_iprm, user_prm, AVCOL_PRI_UNSPECIFIED, color_primaries);
+
+    iprops->rng = s->user_irng != AVCOL_RANGE_UNSPECIFIED ? s->user_irng :
+                  in->color_range == AVCOL_RANGE_JPEG ? AVCOL_RANGE_JPEG :
+                                                        AVCOL_RANGE_MPEG;
+    oprops->rng = s->user_rng != AVCOL_RANGE_UNSPECIFIED ? s->user_rng :
+                                                           iprops->rng;
+
+    iprops->format = in->format;
+    oprops->format = out_format;
+}
+
+static int filter_frame(AVFilterLink *link, AVFrame *in)
+{
+    AVFilterContext *ctx = link->dst;
+    AVFilterLink *outlink = ctx->outputs[0];
+    ColorSpaceContext *s = ctx->priv;
+    const AVPixFmtDescriptor *in_desc  = av_pix_fmt_desc_get(in->format);
+    const AVPixFmtDescriptor *out_desc = av_pix_fmt_desc_get(outlink->format);
+    ColorSpaceProps iprops, oprops;
+    ThreadData td;
+    AVFrame *out;
+    int res;
+
+    get_props(s, in, &iprops, &oprops, outlink->format);
+
+    if (iprops.csp == oprops.csp && iprops.trc == oprops.trc &&
+        iprops.prm == oprops.prm && iprops.rng == oprops.rng &&
+        iprops.format == oprops.format) {
+        in->colorspace      = oprops.csp;
+        in->color_trc       = oprops.trc;
+        in->color_primaries = oprops.prm;
+        in->color_range     = oprops.rng;
+        return ff_filter_frame(outlink, in);
+    }
+
+    if ((in->width  & ((1 << FFMAX(in_desc->log2_chroma_w, out_desc->log2_chroma_w)) - 1)) ||
+        (in->height & ((1 << FFMAX(in_desc->log2_chroma_h, out_desc->log2_chroma_h)) - 1))) {
+        av_log(ctx, AV_LOG_ERROR, "Unsupported odd width or height %dx%d\n",
+               in->width, in->height);
+        av_frame_free(&in);
+        return AVERROR_PATCHWELCOME;
+    }
+
+    if (!s->configured || memcmp(&iprops, &s->in, sizeof(iprops)) ||
+        memcmp(&oprops, &s->out, sizeof(oprops))) {
+        s->configured = 0;
+        res = create_filtergraph(ctx, &iprops, &oprops);
+        if (res < 0) {
+            av_frame_free(&in);
+            return res;
+        }
+        s->in  = iprops;
+        s->out = oprops;
+        s->configured = 1;
+    }
+
+    if (!s->yuv2yuv_fastmode) {
+        res = alloc_rgb(s, in->width, in->height);
+        if (res < 0) {
+            av_frame_free(&in);
+            return res;
+        }
+    }
+
+    out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+    if (!out) {
+        av_frame_free(&in);
+        return AVERROR(ENOMEM);
+    }
+    av_frame_copy_props(out, in);
+    out->colorspace      = oprops.csp;
+    out->color_trc       = oprops.trc;
+    out->color_primaries = oprops.prm;
+    out->color_range     = oprops.rng;
+
+    td.in  = in;
+    td.out = out;
+    td.in_linesize[0]  = in->linesize[0];
+    td.in_linesize[1]  = in->linesize[1];
+    td.in_linesize[2]  = in->linesize[2];
+    td.out_linesize[0] = out->linesize[0];
+    td.out_linesize[1] = out->linesize[1];
+    td.out_linesize[2] = out->linesize[2];
+    td.in_ss_h  = in_desc->log2_chroma_h;
+    td.out_ss_h = out_desc->log2_chroma_h;
+
+    ctx->internal->execute(ctx, convert, &td, NULL,
+                           FFMIN(in->height / s->slice_unit, ctx->graph->nb_threads));
+
+    av_frame_free(&in);
+
+    return ff_filter_frame(outlink, out);
+}
+
+static const enum AVPixelFormat pix_fmts[] = {
+    AV_PIX_FMT_YUV420P,   AV_PIX_FMT_YUV422P,   AV_PIX_FMT_YUV444P,
+    AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_YUV420P12, AV_PIX_FMT_YUV422P12, AV_PIX_FMT_YUV444P12,
+    AV_PIX_FMT_NONE
+};
+
+static int query_formats(AVFilterContext *ctx)
+{
+    ColorSpaceContext *s = ctx->priv;
+    AVFilterFormats *formats = ff_make_format_list(pix_fmts);
+    int res;
+
+    if (!formats)
+        return AVERROR(ENOMEM);
+    if (s->user_format == AV_PIX_FMT_NONE)
+        return ff_set_common_formats(ctx, formats);
+
+    res = ff_formats_ref(formats, &ctx->inputs[0]->out_formats);
+    if (res < 0)
+        return res;
+    formats = NULL;
+    res = ff_add_format(&formats, s->user_format);
+    if (res < 0)
+        return res;
+
+    return ff_formats_ref(formats, &ctx->outputs[0]->in_formats);
+}
+
+static int config_props(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    ColorSpaceContext *s = ctx->priv;
+    int n;
+
+    if (s->user_format != AV_PIX_FMT_NONE) {
+        for (n = 0; pix_fmts[n] != AV_PIX_FMT_NONE; n++)
+            if (pix_fmts[n] == s->user_format)
+                break;
+        if (pix_fmts[n] == AV_PIX_FMT_NONE) {
+            av_log(ctx, AV_LOG_ERROR, "Unsupported output format %s\n",
+                   av_get_pix_fmt_name(s->user_format));
+            return AVERROR(EINVAL);
+        }
+    }
+    s->configured = 0;
+
+    return 0;
+}
+
+#define OFFSET(x) offsetof(ColorSpaceContext, x)
+#define FLAGS AV_OPT_FLAG_FILTERING_PARAM | AV_OPT_FLAG_VIDEO_PARAM
+#define ENUM(x, y, z) { x, "", 0, AV_OPT_TYPE_CONST, { .i64 = y }, INT_MIN, INT_MAX, FLAGS, z }
+
+static const AVOption colorspace_options[] = {
+    { "all",        "Set all color properties together",
+      OFFSET(user_all),   AV_OPT_TYPE_INT, { .i64 = CS_UNSPECIFIED },
+      CS_UNSPECIFIED, CS_NB - 1, FLAGS, "all" },
+    ENUM("bt470m",      CS_BT470M,             "all"),
+    ENUM("bt470bg",     CS_BT470BG,            "all"),
+    ENUM("bt601-6-525", CS_BT601_6_525,        "all"),
+    ENUM("bt601-6-625", CS_BT601_6_625,        "all"),
+    ENUM("bt709",       CS_BT709,              "all"),
+    ENUM("smpte170m",   CS_SMPTE170M,          "all"),
+    ENUM("smpte240m",   CS_SMPTE240M,          "all"),
+    ENUM("bt2020",      CS_BT2020,             "all"),
+
+    { "space",      "Output colorspace",
+      OFFSET(user_csp),   AV_OPT_TYPE_INT, { .i64 = AVCOL_SPC_UNSPECIFIED },
+      AVCOL_SPC_RGB, AVCOL_SPC_NB - 1, FLAGS, "csp" },
+    ENUM("bt709",       AVCOL_SPC_BT709,       "csp"),
+    ENUM("fcc",         AVCOL_SPC_FCC,         "csp"),
+    ENUM("bt470bg",     AVCOL_SPC_BT470BG,     "csp"),
+    ENUM("smpte170m",   AVCOL_SPC_SMPTE170M,   "csp"),
+    ENUM("smpte240m",   AVCOL_SPC_SMPTE240M,   "csp"),
+    ENUM("bt2020ncl",   AVCOL_SPC_BT2020_NCL,  "csp"),
+
+    { "range",      "Output color range",
+      OFFSET(user_rng),   AV_OPT_TYPE_INT, { .i64 = AVCOL_RANGE_UNSPECIFIED },
+      AVCOL_RANGE_UNSPECIFIED, AVCOL_RANGE_NB - 1, FLAGS, "rng" },
+    ENUM("mpeg",        AVCOL_RANGE_MPEG,      "rng"),
+    ENUM("tv",          AVCOL_RANGE_MPEG,      "rng"),
+    ENUM("jpeg",        AVCOL_RANGE_JPEG,      "rng"),
+    ENUM("pc",          AVCOL_RANGE_JPEG,      "rng"),
+
+    { "primaries",  "Output color primaries",
+      OFFSET(user_prm),   AV_OPT_TYPE_INT, { .i64 = AVCOL_PRI_UNSPECIFIED },
+      AVCOL_PRI_RESERVED0, AVCOL_PRI_NB - 1, FLAGS, "prm" },
+    ENUM("bt709",       AVCOL_PRI_BT709,       "prm"),
+    ENUM("bt470m",      AVCOL_PRI_BT470M,      "prm"),
+    ENUM("bt470bg",     AVCOL_PRI_BT470BG,     "prm"),
+    ENUM("smpte170m",   AVCOL_PRI_SMPTE170M,   "prm"),
+    ENUM("smpte240m",   AVCOL_PRI_SMPTE240M,   "prm"),
+    ENUM("film",        AVCOL_PRI_FILM,        "prm"),
+    ENUM("bt2020",      AVCOL_PRI_BT2020,      "prm"),
+    ENUM("smpte428",    AVCOL_PRI_SMPTEST428_1, "prm"),
+
+    { "trc",        "Output transfer characteristics",
+      OFFSET(user_trc),   AV_OPT_TYPE_INT, { .i64 = AVCOL_TRC_UNSPECIFIED },
+      AVCOL_TRC_RESERVED0, AVCOL_TRC_NB - 1, FLAGS, "trc" },
+    ENUM("bt709",        AVCOL_TRC_BT709,        "trc"),
+    ENUM("gamma22",      AVCOL_TRC_GAMMA22,      "trc"),
+    ENUM("gamma28",      AVCOL_TRC_GAMMA28,      "trc"),
+    ENUM("smpte170m",    AVCOL_TRC_SMPTE170M,    "trc"),
+    ENUM("smpte240m",    AVCOL_TRC_SMPTE240M,    "trc"),
+    ENUM("linear",       AVCOL_TRC_LINEAR,       "trc"),
+    ENUM("srgb",         AVCOL_TRC_IEC61966_2_1, "trc"),
+    ENUM("iec61966-2-1", AVCOL_TRC_IEC61966_2_1, "trc"),
+    ENUM("xvycc",        AVCOL_TRC_IEC61966_2_4, "trc"),
+    ENUM("iec61966-2-4", AVCOL_TRC_IEC61966_2_4, "trc"),
+    ENUM("bt2020-10",    AVCOL_TRC_BT2020_10,    "trc"),
+    ENUM("bt2020-12",    AVCOL_TRC_BT2020_12,    "trc"),
+
+    { "format",     "Output pixel format",
+      OFFSET(user_format), AV_OPT_TYPE_PIXEL_FMT, { .i64 = AV_PIX_FMT_NONE },
+      AV_PIX_FMT_NONE, INT_MAX, FLAGS },
+
+    { "fast",       "Ignore primary chromaticity and gamma correction",
+      OFFSET(fast_mode),  AV_OPT_TYPE_BOOL, { .i64 = 0 },
+      0, 1, FLAGS },
+
+    { "iall",       "Set all input color properties together",
+      OFFSET(user_iall),  AV_OPT_TYPE_INT, { .i64 = CS_UNSPECIFIED },
+      CS_UNSPECIFIED, CS_NB - 1, FLAGS, "all" },
+    { "ispace",     "Input colorspace",
+      OFFSET(user_icsp),  AV_OPT_TYPE_INT, { .i64 = AVCOL_SPC_UNSPECIFIED },
+      AVCOL_SPC_RGB, AVCOL_SPC_NB - 1, FLAGS, "csp" },
+    { "irange",     "Input color range",
+      OFFSET(user_irng),  AV_OPT_TYPE_INT, { .i64 = AVCOL_RANGE_UNSPECIFIED },
+      AVCOL_RANGE_UNSPECIFIED, AVCOL_RANGE_NB - 1, FLAGS, "rng" },
+    { "iprimaries", "Input color primaries",
+      OFFSET(user_iprm),  AV_OPT_TYPE_INT, { .i64 = AVCOL_PRI_UNSPECIFIED },
+      AVCOL_PRI_RESERVED0, AVCOL_PRI_NB - 1, FLAGS, "prm" },
+    { "itrc",       "Input transfer characteristics",
+      OFFSET(user_itrc),  AV_OPT_TYPE_INT, { .i64 = AVCOL_TRC_UNSPECIFIED },
+      AVCOL_TRC_RESERVED0, AVCOL_TRC_NB - 1, FLAGS, "trc" },
+
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(colorspace);
+
+static const AVFilterPad inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .filter_frame = filter_frame,
+    },
+    { NULL }
+};
+
+static const AVFilterPad outputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_props,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_colorspace = {
+    .name            = "colorspace",
+    .description     = NULL_IF_CONFIG_SMALL("Convert between colorspaces."),
+    .init            = init,
+    .uninit          = uninit,
+    .query_formats   = query_formats,
+    .priv_size       = sizeof(ColorSpaceContext),
+    .priv_class      = &colorspace_class,
+    .inputs          = inputs,
+    .outputs         = outputs,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
+};
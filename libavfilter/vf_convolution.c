@@ -37,6 +37,7 @@ typedef struct ConvolutionContext {
 
     int bstride;
     uint8_t *buffer;
+    int nb_threads;
     int nb_planes;
     int planewidth[4];
     int planeheight[4];
@@ -44,9 +45,14 @@ typedef struct ConvolutionContext {
     int matrix_length[4];
     int copy[4];
 
-    void (*filter[4])(struct ConvolutionContext *s, AVFrame *in, AVFrame *out, int plane);
+    void (*filter[4])(struct ConvolutionContext *s, AVFrame *in, AVFrame *out,
+                      int plane, int slice_start, int slice_end, uint8_t *buffer);
 } ConvolutionContext;
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
 #define OFFSET(x) offsetof(ConvolutionContext, x)
 #define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
 
@@ -108,8 +114,9 @@ static int config_input(AVFilterLink *inlink)
 
     s->nb_planes = av_pix_fmt_count_planes(inlink->format);
 
+    s->nb_threads = FFMAX(1, FFMIN(inlink->dst->graph->nb_threads, s->planeheight[1]));
     s->bstride = s->planewidth[0] + 32;
-    s->buffer = av_malloc(5 * s->bstride);
+    s->buffer = av_malloc_array(5 * s->bstride, s->nb_threads);
     if (!s->buffer)
         return AVERROR(ENOMEM);
 
@@ -128,15 +135,27 @@ static inline void line_copy8(uint8_t *line, const uint8_t *srcp, int width, int
     }
 }
 
-static void filter_3x3(ConvolutionContext *s, AVFrame *in, AVFrame *out, int plane)
+/* row of the plane at index y, mirrored at the top and bottom edges */
+static inline const uint8_t *mirror_row(const uint8_t *src, int stride,
+                                        int y, int height)
+{
+    if (y < 0)
+        y = -y;
+    else if (y >= height)
+        y = 2 * (height - 1) - y;
+    return src + av_clip(y, 0, height - 1) * stride;
+}
+
+static void filter_3x3(ConvolutionContext *s, AVFrame *in, AVFrame *out,
+                       int plane, int slice_start, int slice_end, uint8_t *buffer)
 {
     const uint8_t *src = in->data[plane];
-    uint8_t *dst = out->data[plane];
+    uint8_t *dst = out->data[plane] + slice_start * out->linesize[plane];
     const int stride = in->linesize[plane];
     const int bstride = s->bstride;
     const int height = s->planeheight[plane];
     const int width  = s->planewidth[plane];
-    uint8_t *p0 = s->buffer + 16;
+    uint8_t *p0 = buffer + 16;
     uint8_t *p1 = p0 + bstride;
     uint8_t *p2 = p1 + bstride;
     uint8_t *orig = p0, *end = p2;
@@ -145,12 +164,11 @@ static void filter_3x3(ConvolutionContext *s, AVFrame *in, AVFrame *out, int pla
     const float bias = s->bias[plane];
     int y, x;
 
-    line_copy8(p0, src + stride, width, 1);
-    line_copy8(p1, src, width, 1);
+    line_copy8(p0, mirror_row(src, stride, slice_start - 1, height), width, 1);
+    line_copy8(p1, mirror_row(src, stride, slice_start,     height), width, 1);
 
-    for (y = 0; y < height; y++) {
-        src += stride * (y < height - 1 ? 1 : -1);
-        line_copy8(p2, src, width, 1);
+    for (y = slice_start; y < slice_end; y++) {
+        line_copy8(p2, mirror_row(src, stride, y + 1, height), width, 1);
 
         for (x = 0; x < width; x++) {
             int sum = p0[x - 1] * matrix[0] +
@@ -173,15 +191,16 @@ static void filter_3x3(ConvolutionContext *s, AVFrame *in, AVFrame *out, int pla
     }
 }
 
-static void filter_5x5(ConvolutionContext *s, AVFrame *in, AVFrame *out, int plane)
+static void filter_5x5(ConvolutionContext *s, AVFrame *in, AVFrame *out,
+                       int plane, int slice_start, int slice_end, uint8_t *buffer)
 {
     const uint8_t *src = in->data[plane];
-    uint8_t *dst = out->data[plane];
+    uint8_t *dst = out->data[plane] + slice_start * out->linesize[plane];
     const int stride = in->linesize[plane];
     const int bstride = s->bstride;
     const int height = s->planeheight[plane];
     const int width  = s->planewidth[plane];
-    uint8_t *p0 = s->buffer + 16;
+    uint8_t *p0 = buffer + 16;
     uint8_t *p1 = p0 + bstride;
     uint8_t *p2 = p1 + bstride;
     uint8_t *p3 = p2 + bstride;
@@ -192,14 +211,12 @@ static void filter_5x5(ConvolutionContext *s, AVFrame *in, AVFrame *out, int pla
     float bias = s->bias[plane];
     int y, x, i;
 
-    line_copy8(p0, src + 2 * stride, width, 2);
-    line_copy8(p1, src + stride, width, 2);
-    line_copy8(p2, src, width, 2);
-    src += stride;
-    line_copy8(p3, src, width, 2);
+    line_copy8(p0, mirror_row(src, stride, slice_start - 2, height), width, 2);
+    line_copy8(p1, mirror_row(src, stride, slice_start - 1, height), width, 2);
+    line_copy8(p2, mirror_row(src, stride, slice_start,     height), width, 2);
+    line_copy8(p3, mirror_row(src, stride, slice_start + 1, height), width, 2);
 
-
-    for (y = 0; y < height; y++) {
+    for (y = slice_start; y < slice_end; y++) {
         uint8_t *array[] = {
             p0 - 2, p0 - 1, p0, p0 + 1, p0 + 2,
             p1 - 2, p1 - 1, p1, p1 + 1, p1 + 2,
@@ -208,8 +225,7 @@ static void filter_5x5(ConvolutionContext *s, AVFrame *in, AVFrame *out, int pla
             p4 - 2, p4 - 1, p4, p4 + 1, p4 + 2
         };
 
-        src += stride * (y < height - 2 ? 1 : -1);
-        line_copy8(p4, src, width, 2);
+        line_copy8(p4, mirror_row(src, stride, y + 2, height), width, 2);
 
         for (x = 0; x < width; x++) {
             int sum = 0;
@@ -230,12 +246,41 @@ static void filter_5x5(ConvolutionContext *s, AVFrame *in, AVFrame *out, int pla
     }
 }
 
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ConvolutionContext *s = ctx->priv;
+    ThreadData *td = arg;
+    uint8_t *buffer = s->buffer + jobnr * 5 * s->bstride;
+    int plane;
+
+    for (plane = 0; plane < s->nb_planes; plane++) {
+        const int height = s->planeheight[plane];
+        const int slice_start = (height *  jobnr   ) / nb_jobs;
+        const int slice_end   = (height * (jobnr+1)) / nb_jobs;
+
+        if (s->copy[plane]) {
+            av_image_copy_plane(td->out->data[plane] + slice_start * td->out->linesize[plane],
+                                td->out->linesize[plane],
+                                td->in->data[plane] + slice_start * td->in->linesize[plane],
+                                td->in->linesize[plane],
+                                s->planewidth[plane],
+                                slice_end - slice_start);
+            continue;
+        }
+
+        s->filter[plane](s, td->in, td->out, plane, slice_start, slice_end, buffer);
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
-    ConvolutionContext *s = inlink->dst->priv;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
+    AVFilterContext *ctx = inlink->dst;
+    ConvolutionContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
     AVFrame *out;
-    int plane;
+    ThreadData td;
 
     out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
     if (!out) {
@@ -244,17 +289,9 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     }
     av_frame_copy_props(out, in);
 
-    for (plane = 0; plane < s->nb_planes; plane++) {
-        if (s->copy[plane]) {
-            av_image_copy_plane(out->data[plane], out->linesize[plane],
-                                in->data[plane], in->linesize[plane],
-                                s->planewidth[plane],
-                                s->planeheight[plane]);
-            continue;
-        }
-
-        s->filter[plane](s, in, out, plane);
-    }
+    td.in  = in;
+    td.out = out;
+    ctx->internal->execute(ctx, filter_slice, &td, NULL, s->nb_threads);
 
     av_frame_free(&in);
     return ff_filter_frame(outlink, out);
@@ -332,5 +369,5 @@ AVFilter ff_vf_convolution = {
     .query_formats = query_formats,
     .inputs        = convolution_inputs,
     .outputs       = convolution_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
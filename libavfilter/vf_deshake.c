@@ -82,6 +82,7 @@ static const AVOption deshake_options[] = {
     { "search",  "set search strategy", OFFSET(search), AV_OPT_TYPE_INT, {.i64=EXHAUSTIVE}, EXHAUSTIVE, SEARCH_COUNT-1, FLAGS, "smode" },
         { "exhaustive", "exhaustive search",      0, AV_OPT_TYPE_CONST, {.i64=EXHAUSTIVE},       INT_MIN, INT_MAX, FLAGS, "smode" },
         { "less",       "less exhaustive search", 0, AV_OPT_TYPE_CONST, {.i64=SMART_EXHAUSTIVE}, INT_MIN, INT_MAX, FLAGS, "smode" },
+        { "hierarchical", "half resolution search refined at full resolution", 0, AV_OPT_TYPE_CONST, {.i64=HIERARCHICAL}, INT_MIN, INT_MAX, FLAGS, "smode" },
     { "filename", "set motion search detailed log file name", OFFSET(filename), AV_OPT_TYPE_STRING, {.str=NULL}, .flags = FLAGS },
     { "opencl", "use OpenCL filtering capabilities", OFFSET(opencl), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, .flags = FLAGS },
     { NULL }
@@ -89,6 +90,14 @@ static const AVOption deshake_options[] = {
 
 AVFILTER_DEFINE_CLASS(deshake);
 
+typedef struct ThreadData {
+    uint8_t *src1, *src2;      ///< Previous and current frame
+    int width, height, stride;
+    uint8_t *half1, *half2;    ///< Half resolution copies, for HIERARCHICAL
+    int half_stride;
+    int nb_columns, nb_rows;   ///< Number of blocks
+} ThreadData;
+
 static int cmp(const void *a, const void *b)
 {
     return FFDIFFSIGN(*(const double *)a, *(const double *)b);
@@ -118,10 +127,12 @@ static double clean_mean(double *values, int count)
  * and ry attributes. Searches using a simple matrix of those shifts and
  * chooses the most likely shift by the smallest difference in blocks.
  */
-static void find_block_motion(DeshakeContext *deshake, uint8_t *src1,
-                              uint8_t *src2, int cx, int cy, int stride,
-                              IntMotionVector *mv)
+static void find_block_motion(DeshakeContext *deshake, const ThreadData *td,
+                              int cx, int cy, IntMotionVector *mv)
 {
+    uint8_t *src1 = td->src1;
+    uint8_t *src2 = td->src2;
+    int stride    = td->stride;
     int x, y;
     int diff;
     int smallest = INT_MAX;
@@ -164,6 +175,38 @@ static void find_block_motion(DeshakeContext *deshake, uint8_t *src1,
                 if (x == tmp && y == tmp2)
                     continue;
 
+                diff = CMP(cx - x, cy - y);
+                if (diff < smallest) {
+                    smallest = diff;
+                    mv->x = x;
+                    mv->y = y;
+                }
+            }
+        }
+    } else if (deshake->search == HIERARCHICAL) {
+        // Compare every possible position on the half resolution frames,
+        // with 8x8 blocks covering the same area
+        for (y = -deshake->ry / 2; y <= deshake->ry / 2; y++) {
+            for (x = -deshake->rx / 2; x <= deshake->rx / 2; x++) {
+                diff = deshake->sad_half(td->half1 + (cy / 2) * td->half_stride + cx / 2,
+                                         td->half_stride,
+                                         td->half2 + (cy / 2 - y) * td->half_stride + cx / 2 - x,
+                                         td->half_stride);
+                if (diff < smallest) {
+                    smallest = diff;
+                    mv->x = 2 * x;
+                    mv->y = 2 * y;
+                }
+            }
+        }
+
+        // Refine the match at full resolution
+        tmp = mv->x;
+        tmp2 = mv->y;
+        smallest = INT_MAX;
+
+        for (y = FFMAX(tmp2 - 1, -deshake->ry); y <= FFMIN(tmp2 + 1, deshake->ry); y++) {
+            for (x = FFMAX(tmp - 1, -deshake->rx); x <= FFMIN(tmp + 1, deshake->rx); x++) {
                 diff = CMP(cx - x, cy - y);
                 if (diff < smallest) {
                     smallest = diff;
@@ -226,6 +269,63 @@ static double block_angle(int x, int y, int cx, int cy, IntMotionVector *shift)
            diff;
 }
 
+/**
+ * Downscale a luma plane by two in both directions, duplicating the last
+ * row and column of odd sized planes.
+ */
+static void downscale_half(uint8_t *dst, int dst_stride, const uint8_t *src,
+                           int src_stride, int width, int height)
+{
+    int x, y;
+
+    for (y = 0; y < (height + 1) / 2; y++) {
+        const uint8_t *row0 = src + 2 * y * src_stride;
+        const uint8_t *row1 = 2 * y + 1 < height ? row0 + src_stride : row0;
+
+        for (x = 0; x < width / 2; x++)
+            dst[x] = (row0[2 * x] + row0[2 * x + 1] +
+                      row1[2 * x] + row1[2 * x + 1] + 2) >> 2;
+        if (width & 1)
+            dst[x] = (row0[2 * x] + row1[2 * x] + 1) >> 1;
+        dst += dst_stride;
+    }
+}
+
+/**
+ * Find the motion vectors of the blocks of a slice of rows of blocks.
+ * Blocks whose contrast is too low get the (-1, -1) vector, like the
+ * blocks for which no good match was found.
+ */
+static int find_motion_slice(AVFilterContext *ctx, void *arg, int jobnr,
+                             int nb_jobs)
+{
+    DeshakeContext *deshake = ctx->priv;
+    const ThreadData *td = arg;
+    const int row_start = (td->nb_rows *  jobnr     ) / nb_jobs;
+    const int row_end   = (td->nb_rows * (jobnr + 1)) / nb_jobs;
+    int row, column;
+
+    for (row = row_start; row < row_end; row++) {
+        const int y = deshake->ry + row * deshake->blocksize * 2;
+
+        for (column = 0; column < td->nb_columns; column++) {
+            // We use a width of 16 here to match the sad function
+            const int x = deshake->rx + column * 16;
+            IntMotionVector *mv = &deshake->mvs[row * td->nb_columns + column];
+
+            mv->x = mv->y = 0;
+            // If the contrast is too low, just skip this block as it probably
+            // won't be very useful to us.
+            if (block_contrast(td->src2, x, y, td->stride, deshake->blocksize) > deshake->contrast)
+                find_block_motion(deshake, td, x, y, mv);
+            else
+                mv->x = mv->y = -1;
+        }
+    }
+
+    return 0;
+}
+
 /**
  * Find the estimated global motion for a scene given the most likely shift
  * for each block in the frame. The global motion is estimated to be the
@@ -233,13 +333,13 @@ static double block_angle(int x, int y, int cx, int cy, IntMotionVector *shift)
  * move one pixel to the right and two pixels down, this would yield a
  * motion vector (1, -2).
  */
-static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
-                        int width, int height, int stride, Transform *t)
+static int find_motion(AVFilterContext *ctx, uint8_t *src1, uint8_t *src2,
+                       int width, int height, int stride, Transform *t)
 {
-    int x, y;
-    IntMotionVector mv = {0, 0};
+    DeshakeContext *deshake = ctx->priv;
+    ThreadData td;
+    int x, y, i;
     int count_max_value = 0;
-    int contrast;
 
     int pos;
     int center_x = 0, center_y = 0;
@@ -247,6 +347,36 @@ static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
 
     av_fast_malloc(&deshake->angles, &deshake->angles_size, width * height / (16 * deshake->blocksize) * sizeof(*deshake->angles));
 
+    td.src1   = src1;
+    td.src2   = src2;
+    td.width  = width;
+    td.height = height;
+    td.stride = stride;
+    td.nb_columns = FFMAX((width  - 2 * deshake->rx - 16 + 15) / 16, 0);
+    td.nb_rows    = FFMAX((height - 2 * deshake->ry - deshake->blocksize * 2 +
+                           deshake->blocksize * 2 - 1) / (deshake->blocksize * 2), 0);
+
+    av_fast_malloc(&deshake->mvs, &deshake->mvs_size,
+                   td.nb_columns * td.nb_rows * sizeof(*deshake->mvs));
+    if (!deshake->angles || !deshake->mvs)
+        return AVERROR(ENOMEM);
+
+    if (deshake->search == HIERARCHICAL) {
+        // Keep 8 more rows, the 8x8 blocks of the last row of blocks may
+        // reach below the downscaled frame
+        td.half_stride = FFALIGN((width + 1) / 2, 16);
+        for (i = 0; i < 2; i++) {
+            av_fast_malloc(&deshake->half[i], &deshake->half_size[i],
+                           td.half_stride * ((height + 1) / 2 + 8));
+            if (!deshake->half[i])
+                return AVERROR(ENOMEM);
+        }
+        td.half1 = deshake->half[0];
+        td.half2 = deshake->half[1];
+        downscale_half(td.half1, td.half_stride, src1, stride, width, height);
+        downscale_half(td.half2, td.half_stride, src2, stride, width, height);
+    }
+
     // Reset counts to zero
     for (x = 0; x < deshake->rx * 2 + 1; x++) {
         for (y = 0; y < deshake->ry * 2 + 1; y++) {
@@ -254,26 +384,25 @@ static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
         }
     }
 
+    // Find motion for every block, with the rows of blocks split in slices
+    if (td.nb_rows)
+        ctx->internal->execute(ctx, find_motion_slice, &td, NULL,
+                               FFMIN(td.nb_rows, ctx->graph->nb_threads));
+
     pos = 0;
-    // Find motion for every block and store the motion vector in the counts
-    for (y = deshake->ry; y < height - deshake->ry - (deshake->blocksize * 2); y += deshake->blocksize * 2) {
-        // We use a width of 16 here to match the sad function
-        for (x = deshake->rx; x < width - deshake->rx - 16; x += 16) {
-            // If the contrast is too low, just skip this block as it probably
-            // won't be very useful to us.
-            contrast = block_contrast(src2, x, y, stride, deshake->blocksize);
-            if (contrast > deshake->contrast) {
-                //av_log(NULL, AV_LOG_ERROR, "%d\n", contrast);
-                find_block_motion(deshake, src1, src2, x, y, stride, &mv);
-                if (mv.x != -1 && mv.y != -1) {
-                    deshake->counts[mv.x + deshake->rx][mv.y + deshake->ry] += 1;
-                    if (x > deshake->rx && y > deshake->ry)
-                        deshake->angles[pos++] = block_angle(x, y, 0, 0, &mv);
-
-                    center_x += mv.x;
-                    center_y += mv.y;
-                }
-            }
+    // Store the motion vectors in the counts, in the order of the blocks
+    for (i = 0; i < td.nb_rows * td.nb_columns; i++) {
+        IntMotionVector *mv = &deshake->mvs[i];
+        const int x = deshake->rx + (i % td.nb_columns) * 16;
+        const int y = deshake->ry + (i / td.nb_columns) * deshake->blocksize * 2;
+
+        if (mv->x != -1 && mv->y != -1) {
+            deshake->counts[mv->x + deshake->rx][mv->y + deshake->ry] += 1;
+            if (x > deshake->rx && y > deshake->ry)
+                deshake->angles[pos++] = block_angle(x, y, 0, 0, mv);
+
+            center_x += mv->x;
+            center_y += mv->y;
         }
     }
 
@@ -311,6 +440,7 @@ static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
     t->angle = av_clipf(t->angle, -0.1, 0.1);
 
     //av_log(NULL, AV_LOG_ERROR, "%d x %d\n", avg->x, avg->y);
+    return 0;
 }
 
 static int deshake_transform_c(AVFilterContext *ctx,
@@ -345,7 +475,8 @@ static av_cold int init(AVFilterContext *ctx)
     DeshakeContext *deshake = ctx->priv;
 
     deshake->sad = av_pixelutils_get_sad_fn(4, 4, 1, deshake); // 16x16, 2nd source unaligned
-    if (!deshake->sad)
+    deshake->sad_half = av_pixelutils_get_sad_fn(3, 3, 0, deshake); // 8x8, unaligned
+    if (!deshake->sad || !deshake->sad_half)
         return AVERROR(EINVAL);
 
     deshake->refcount = 20; // XXX: add to options?
@@ -422,6 +553,11 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_frame_free(&deshake->ref);
     av_freep(&deshake->angles);
     deshake->angles_size = 0;
+    av_freep(&deshake->mvs);
+    deshake->mvs_size = 0;
+    av_freep(&deshake->half[0]);
+    av_freep(&deshake->half[1]);
+    deshake->half_size[0] = deshake->half_size[1] = 0;
     if (deshake->fp)
         fclose(deshake->fp);
 }
@@ -455,7 +591,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
 
     if (deshake->cx < 0 || deshake->cy < 0 || deshake->cw < 0 || deshake->ch < 0) {
         // Find the most likely global motion for the current frame
-        find_motion(deshake, (deshake->ref == NULL) ? in->data[0] : deshake->ref->data[0], in->data[0], link->w, link->h, in->linesize[0], &t);
+        ret = find_motion(link->dst, (deshake->ref == NULL) ? in->data[0] : deshake->ref->data[0], in->data[0], link->w, link->h, in->linesize[0], &t);
     } else {
         uint8_t *src1 = (deshake->ref == NULL) ? in->data[0] : deshake->ref->data[0];
         uint8_t *src2 = in->data[0];
@@ -472,7 +608,12 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         src1 += deshake->cy * in->linesize[0] + deshake->cx;
         src2 += deshake->cy * in->linesize[0] + deshake->cx;
 
-        find_motion(deshake, src1, src2, deshake->cw, deshake->ch, in->linesize[0], &t);
+        ret = find_motion(link->dst, src1, src2, deshake->cw, deshake->ch, in->linesize[0], &t);
+    }
+    if (ret < 0) {
+        av_frame_free(&in);
+        av_frame_free(&out);
+        return ret;
     }
 
 
@@ -573,4 +714,5 @@ AVFilter ff_vf_deshake = {
     .inputs        = deshake_inputs,
     .outputs       = deshake_outputs,
     .priv_class    = &deshake_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
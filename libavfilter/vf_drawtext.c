@@ -134,6 +134,13 @@ enum expansion_mode {
     EXP_STRFTIME,
 };
 
+typedef struct TextMask {
+    uint8_t *buf;                   ///< 8-bit coverage of the glyphs
+    int linesize;
+    int x, y;                       ///< position relative to the text origin
+    int w, h;
+} TextMask;
+
 typedef struct DrawTextContext {
     const AVClass *class;
     int exp_mode;                   ///< expansion mode to use for the text
@@ -154,6 +161,12 @@ typedef struct DrawTextContext {
     int y;                          ///< y position to start drawing text
     int max_glyph_w;                ///< max glyph width
     int max_glyph_h;                ///< max glyph height
+    int max_glyph_a;                ///< max glyph ascent
+    int max_glyph_d;                ///< min glyph descent
+    int text_w, text_h;             ///< size of the laid out text
+    char *layout_text;              ///< expanded text the layout and masks were computed for
+    TextMask text_mask;             ///< glyphs of the laid out text
+    TextMask border_mask;           ///< glyph borders of the laid out text
     int shadowx, shadowy;
     int borderw;                    ///< border width
     unsigned int fontsize;          ///< font size to use
@@ -710,6 +723,9 @@ static av_cold void uninit(AVFilterContext *ctx)
     s->x_pexpr = s->y_pexpr = NULL;
     av_freep(&s->positions);
     s->nb_positions = 0;
+    av_freep(&s->layout_text);
+    av_freep(&s->text_mask.buf);
+    av_freep(&s->border_mask.buf);
 
 
     av_tree_enumerate(s->glyphs, NULL, NULL, glyph_enu_free);
@@ -1068,49 +1084,243 @@ static int expand_text(AVFilterContext *ctx, char *text, AVBPrint *bp)
     return 0;
 }
 
-static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
-                       int width, int height,
-                       FFDrawColor *color,
-                       int x, int y, int borderw)
+/**
+ * Render the glyphs (or their borders) of the laid out text into a single
+ * coverage mask, so that the text is blended with one call per frame.
+ */
+static int render_text_mask(DrawTextContext *s, TextMask *mask, int borderw)
 {
     char *text = s->expanded_text.str;
+    int x_min = INT_MAX, y_min = INT_MAX, x_max = INT_MIN, y_max = INT_MIN;
+    int pass, i, x, y;
     uint32_t code = 0;
-    int i, x1, y1;
     uint8_t *p;
-    Glyph *glyph = NULL;
 
+    av_freep(&mask->buf);
+    mask->w = mask->h = 0;
+
+    /* the first pass computes the bounding box, the second one draws */
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0, p = text; *p; i++) {
+            Glyph dummy = { 0 };
+            Glyph *glyph;
+            FT_Bitmap *bitmap;
+            int x1, y1;
+            GET_UTF8(code, *p++, continue;);
+
+            /* skip new line chars, just go to new line */
+            if (code == '\n' || code == '\r' || code == '\t')
+                continue;
+
+            dummy.code = code;
+            glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+
+            if (glyph->bitmap.pixel_mode != FT_PIXEL_MODE_MONO &&
+                glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
+                return AVERROR(EINVAL);
+
+            bitmap = borderw ? &glyph->border_bitmap : &glyph->bitmap;
+            if (!bitmap->width || !bitmap->rows)
+                continue;
+
+            x1 = s->positions[i].x - borderw;
+            y1 = s->positions[i].y - borderw;
+
+            if (!pass) {
+                x_min = FFMIN(x_min, x1);
+                y_min = FFMIN(y_min, y1);
+                x_max = FFMAX(x_max, x1 + (int)bitmap->width);
+                y_max = FFMAX(y_max, y1 + (int)bitmap->rows);
+                continue;
+            }
+
+            for (y = 0; y < bitmap->rows; y++) {
+                const uint8_t *src = bitmap->buffer + y * bitmap->pitch;
+                uint8_t *dst = mask->buf + (y1 - mask->y + y) * mask->linesize +
+                               x1 - mask->x;
+
+                for (x = 0; x < bitmap->width; x++) {
+                    unsigned v = bitmap->pixel_mode == FT_PIXEL_MODE_MONO ?
+                                 (src[x >> 3] >> (~x & 7) & 1) * 255 : src[x];
+                    /* overlapping glyphs cover each other */
+                    if (!dst[x])
+                        dst[x] = v;
+                    else if (v)
+                        dst[x] += v - (dst[x] * v + 127) / 255;
+                }
+            }
+        }
+
+        if (!pass) {
+            if (x_min >= x_max)
+                return 0;
+            mask->x = x_min;
+            mask->y = y_min;
+            mask->w = mask->linesize = x_max - x_min;
+            mask->h = y_max - y_min;
+            if (!(mask->buf = av_mallocz_array(mask->h, mask->linesize)))
+                return AVERROR(ENOMEM);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Compute the glyph positions and the size of the text, and render its
+ * masks. This only has to be done when the expanded text changes.
+ */
+static int layout_text(AVFilterContext *ctx)
+{
+    DrawTextContext *s = ctx->priv;
+    char *text = s->expanded_text.str;
+    uint32_t code = 0, prev_code = 0;
+    int x = 0, y = 0, i = 0, ret;
+    int max_text_line_w = 0;
+    uint8_t *p;
+    int y_min = 32000, y_max = -32000;
+    int x_min = 32000, x_max = -32000;
+    FT_Vector delta;
+    Glyph *glyph = NULL, *prev_glyph = NULL;
+    Glyph dummy = { 0 };
+
+    /* load and cache glyphs */
+    for (i = 0, p = text; *p; i++) {
+        GET_UTF8(code, *p++, continue;);
+
+        /* get glyph */
+        dummy.code = code;
+        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+        if (!glyph) {
+            load_glyph(ctx, &glyph, code);
+        }
+
+        y_min = FFMIN(glyph->bbox.yMin, y_min);
+        y_max = FFMAX(glyph->bbox.yMax, y_max);
+        x_min = FFMIN(glyph->bbox.xMin, x_min);
+        x_max = FFMAX(glyph->bbox.xMax, x_max);
+    }
+    s->max_glyph_h = y_max - y_min;
+    s->max_glyph_w = x_max - x_min;
+    s->max_glyph_a = y_max;
+    s->max_glyph_d = y_min;
+
+    /* compute and save position for each glyph */
+    glyph = NULL;
     for (i = 0, p = text; *p; i++) {
-        FT_Bitmap bitmap;
-        Glyph dummy = { 0 };
         GET_UTF8(code, *p++, continue;);
 
-        /* skip new line chars, just go to new line */
-        if (code == '\n' || code == '\r' || code == '\t')
+        /* skip the \n in the sequence \r\n */
+        if (prev_code == '\r' && code == '\n')
             continue;
 
+        prev_code = code;
+        if (is_newline(code)) {
+
+            max_text_line_w = FFMAX(max_text_line_w, x);
+            y += s->max_glyph_h;
+            x = 0;
+            continue;
+        }
+
+        /* get glyph */
+        prev_glyph = glyph;
         dummy.code = code;
         glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
 
-        bitmap = borderw ? glyph->border_bitmap : glyph->bitmap;
+        /* kerning */
+        if (s->use_kerning && prev_glyph && glyph->code) {
+            FT_Get_Kerning(s->face, prev_glyph->code, glyph->code,
+                           ft_kerning_default, &delta);
+            x += delta.x >> 6;
+        }
 
-        if (glyph->bitmap.pixel_mode != FT_PIXEL_MODE_MONO &&
-            glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
-            return AVERROR(EINVAL);
+        /* save position */
+        s->positions[i].x = x + glyph->bitmap_left;
+        s->positions[i].y = y - glyph->bitmap_top + y_max;
+        if (code == '\t') x  = (x / s->tabsize + 1)*s->tabsize;
+        else              x += glyph->advance;
+    }
 
-        x1 = s->positions[i].x+s->x+x - borderw;
-        y1 = s->positions[i].y+s->y+y - borderw;
+    s->text_w = FFMAX(x, max_text_line_w);
+    s->text_h = y + s->max_glyph_h;
 
-        ff_blend_mask(&s->dc, color,
-                      frame->data, frame->linesize, width, height,
-                      bitmap.buffer, bitmap.pitch,
-                      bitmap.width, bitmap.rows,
-                      bitmap.pixel_mode == FT_PIXEL_MODE_MONO ? 0 : 3,
-                      0, x1, y1);
-    }
+    av_freep(&s->layout_text);
+    av_freep(&s->border_mask.buf);
+    if ((ret = render_text_mask(s, &s->text_mask, 0)) < 0 ||
+        (s->borderw && (ret = render_text_mask(s, &s->border_mask, s->borderw)) < 0))
+        return ret;
+    if (!(s->layout_text = av_strdup(text)))
+        return AVERROR(ENOMEM);
 
     return 0;
 }
 
+typedef struct ThreadData {
+    AVFrame *frame;
+    FFDrawColor fontcolor;
+    FFDrawColor shadowcolor;
+    FFDrawColor bordercolor;
+    FFDrawColor boxcolor;
+    int box_w, box_h;
+    int y_start, y_end;             ///< rows of the frame touched by the text
+} ThreadData;
+
+static void blend_text_mask(DrawTextContext *s, AVFrame *frame,
+                            FFDrawColor *color, TextMask *mask,
+                            int x, int y, int slice_start, int slice_end)
+{
+    int y0 = FFMAX(y + mask->y, slice_start);
+    int y1 = FFMIN(y + mask->y + mask->h, slice_end);
+
+    if (!mask->buf || y0 >= y1)
+        return;
+
+    ff_blend_mask(&s->dc, color,
+                  frame->data, frame->linesize, frame->width, frame->height,
+                  mask->buf + (y0 - y - mask->y) * mask->linesize, mask->linesize,
+                  mask->w, y1 - y0, 3, 0, x + mask->x, y0);
+}
+
+static int draw_text_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    DrawTextContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *frame = td->frame;
+    /* the slices start on chroma rows, so that each of them is blended once */
+    const int align = (1 << s->dc.vsub_max) - 1;
+    const int rows = td->y_end - td->y_start;
+    const int slice_start = td->y_start + ((rows * jobnr) / nb_jobs & ~align);
+    const int slice_end   = jobnr == nb_jobs - 1 ? td->y_end :
+                            td->y_start + ((rows * (jobnr+1)) / nb_jobs & ~align);
+
+    if (slice_start >= slice_end)
+        return 0;
+
+    /* draw box */
+    if (s->draw_box) {
+        int y0 = FFMAX(s->y - s->boxborderw, slice_start);
+        int y1 = FFMIN(s->y - s->boxborderw + td->box_h + s->boxborderw * 2, slice_end);
+        if (y0 < y1)
+            ff_blend_rectangle(&s->dc, &td->boxcolor,
+                               frame->data, frame->linesize, frame->width, frame->height,
+                               s->x - s->boxborderw, y0,
+                               td->box_w + s->boxborderw * 2, y1 - y0);
+    }
+
+    if (s->shadowx || s->shadowy)
+        blend_text_mask(s, frame, &td->shadowcolor, &s->text_mask,
+                        s->x + s->shadowx, s->y + s->shadowy, slice_start, slice_end);
+
+    if (s->borderw)
+        blend_text_mask(s, frame, &td->bordercolor, &s->border_mask,
+                        s->x, s->y, slice_start, slice_end);
+
+    blend_text_mask(s, frame, &td->fontcolor, &s->text_mask,
+                    s->x, s->y, slice_start, slice_end);
+
+    return 0;
+}
 
 static void update_color_with_alpha(DrawTextContext *s, FFDrawColor *color, const FFDrawColor incolor)
 {
@@ -1140,27 +1350,14 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
     DrawTextContext *s = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
 
-    uint32_t code = 0, prev_code = 0;
-    int x = 0, y = 0, i = 0, ret;
-    int max_text_line_w = 0, len;
-    int box_w, box_h;
+    int ret, len, nb_jobs;
     char *text;
-    uint8_t *p;
-    int y_min = 32000, y_max = -32000;
-    int x_min = 32000, x_max = -32000;
-    FT_Vector delta;
-    Glyph *glyph = NULL, *prev_glyph = NULL;
-    Glyph dummy = { 0 };
+    ThreadData td;
 
     time_t now = time(0);
     struct tm ltime;
     AVBPrint *bp = &s->expanded_text;
 
-    FFDrawColor fontcolor;
-    FFDrawColor shadowcolor;
-    FFDrawColor bordercolor;
-    FFDrawColor boxcolor;
-
     av_bprint_clear(bp);
 
     if(s->basetime != AV_NOPTS_VALUE)
@@ -1211,74 +1408,18 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
         ff_draw_color(&s->dc, &s->fontcolor, s->fontcolor.rgba);
     }
 
-    x = 0;
-    y = 0;
-
-    /* load and cache glyphs */
-    for (i = 0, p = text; *p; i++) {
-        GET_UTF8(code, *p++, continue;);
-
-        /* get glyph */
-        dummy.code = code;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-        if (!glyph) {
-            load_glyph(ctx, &glyph, code);
-        }
-
-        y_min = FFMIN(glyph->bbox.yMin, y_min);
-        y_max = FFMAX(glyph->bbox.yMax, y_max);
-        x_min = FFMIN(glyph->bbox.xMin, x_min);
-        x_max = FFMAX(glyph->bbox.xMax, x_max);
-    }
-    s->max_glyph_h = y_max - y_min;
-    s->max_glyph_w = x_max - x_min;
-
-    /* compute and save position for each glyph */
-    glyph = NULL;
-    for (i = 0, p = text; *p; i++) {
-        GET_UTF8(code, *p++, continue;);
-
-        /* skip the \n in the sequence \r\n */
-        if (prev_code == '\r' && code == '\n')
-            continue;
-
-        prev_code = code;
-        if (is_newline(code)) {
-
-            max_text_line_w = FFMAX(max_text_line_w, x);
-            y += s->max_glyph_h;
-            x = 0;
-            continue;
-        }
-
-        /* get glyph */
-        prev_glyph = glyph;
-        dummy.code = code;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-
-        /* kerning */
-        if (s->use_kerning && prev_glyph && glyph->code) {
-            FT_Get_Kerning(s->face, prev_glyph->code, glyph->code,
-                           ft_kerning_default, &delta);
-            x += delta.x >> 6;
-        }
-
-        /* save position */
-        s->positions[i].x = x + glyph->bitmap_left;
-        s->positions[i].y = y - glyph->bitmap_top + y_max;
-        if (code == '\t') x  = (x / s->tabsize + 1)*s->tabsize;
-        else              x += glyph->advance;
+    if (!s->layout_text || strcmp(s->layout_text, text)) {
+        if ((ret = layout_text(ctx)) < 0)
+            return ret;
     }
 
-    max_text_line_w = FFMAX(x, max_text_line_w);
-
-    s->var_values[VAR_TW] = s->var_values[VAR_TEXT_W] = max_text_line_w;
-    s->var_values[VAR_TH] = s->var_values[VAR_TEXT_H] = y + s->max_glyph_h;
+    s->var_values[VAR_TW] = s->var_values[VAR_TEXT_W] = s->text_w;
+    s->var_values[VAR_TH] = s->var_values[VAR_TEXT_H] = s->text_h;
 
     s->var_values[VAR_MAX_GLYPH_W] = s->max_glyph_w;
     s->var_values[VAR_MAX_GLYPH_H] = s->max_glyph_h;
-    s->var_values[VAR_MAX_GLYPH_A] = s->var_values[VAR_ASCENT ] = y_max;
-    s->var_values[VAR_MAX_GLYPH_D] = s->var_values[VAR_DESCENT] = y_min;
+    s->var_values[VAR_MAX_GLYPH_A] = s->var_values[VAR_ASCENT ] = s->max_glyph_a;
+    s->var_values[VAR_MAX_GLYPH_D] = s->var_values[VAR_DESCENT] = s->max_glyph_d;
 
     s->var_values[VAR_LINE_H] = s->var_values[VAR_LH] = s->max_glyph_h;
 
@@ -1287,35 +1428,38 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
     s->x = s->var_values[VAR_X] = av_expr_eval(s->x_pexpr, s->var_values, &s->prng);
 
     update_alpha(s);
-    update_color_with_alpha(s, &fontcolor  , s->fontcolor  );
-    update_color_with_alpha(s, &shadowcolor, s->shadowcolor);
-    update_color_with_alpha(s, &bordercolor, s->bordercolor);
-    update_color_with_alpha(s, &boxcolor   , s->boxcolor   );
-
-    box_w = FFMIN(width - 1 , max_text_line_w);
-    box_h = FFMIN(height - 1, y + s->max_glyph_h);
-
-    /* draw box */
-    if (s->draw_box)
-        ff_blend_rectangle(&s->dc, &boxcolor,
-                           frame->data, frame->linesize, width, height,
-                           s->x - s->boxborderw, s->y - s->boxborderw,
-                           box_w + s->boxborderw * 2, box_h + s->boxborderw * 2);
-
+    update_color_with_alpha(s, &td.fontcolor  , s->fontcolor  );
+    update_color_with_alpha(s, &td.shadowcolor, s->shadowcolor);
+    update_color_with_alpha(s, &td.bordercolor, s->bordercolor);
+    update_color_with_alpha(s, &td.boxcolor   , s->boxcolor   );
+
+    td.frame = frame;
+    td.box_w = FFMIN(width - 1 , s->text_w);
+    td.box_h = FFMIN(height - 1, s->text_h);
+
+    /* rows covered by the box, the shadow, the border and the text */
+    td.y_start = s->y + s->text_mask.y;
+    td.y_end   = s->y + s->text_mask.y + s->text_mask.h;
+    if (s->draw_box) {
+        td.y_start = FFMIN(td.y_start, s->y - s->boxborderw);
+        td.y_end   = FFMAX(td.y_end,   s->y + td.box_h + s->boxborderw);
+    }
     if (s->shadowx || s->shadowy) {
-        if ((ret = draw_glyphs(s, frame, width, height,
-                               &shadowcolor, s->shadowx, s->shadowy, 0)) < 0)
-            return ret;
+        td.y_start = FFMIN(td.y_start, s->y + s->shadowy + s->text_mask.y);
+        td.y_end   = FFMAX(td.y_end,   s->y + s->shadowy + s->text_mask.y + s->text_mask.h);
     }
-
     if (s->borderw) {
-        if ((ret = draw_glyphs(s, frame, width, height,
-                               &bordercolor, 0, 0, s->borderw)) < 0)
-            return ret;
+        td.y_start = FFMIN(td.y_start, s->y + s->border_mask.y);
+        td.y_end   = FFMAX(td.y_end,   s->y + s->border_mask.y + s->border_mask.h);
     }
-    if ((ret = draw_glyphs(s, frame, width, height,
-                           &fontcolor, 0, 0, 0)) < 0)
-        return ret;
+    td.y_start = FFMAX(td.y_start, 0) & ~((1 << s->dc.vsub_max) - 1);
+    td.y_end   = FFMIN(td.y_end, height);
+    if (td.y_start >= td.y_end)
+        return 0;
+
+    nb_jobs = FFMAX(1, FFMIN((td.y_end - td.y_start) >> s->dc.vsub_max,
+                             ctx->graph->nb_threads));
+    ctx->internal->execute(ctx, draw_text_slice, &td, NULL, nb_jobs);
 
     return 0;
 }
@@ -1388,5 +1532,5 @@ AVFilter ff_vf_drawtext = {
     .inputs        = avfilter_vf_drawtext_inputs,
     .outputs       = avfilter_vf_drawtext_outputs,
     .process_command = command,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
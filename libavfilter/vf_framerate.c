@@ -36,6 +36,7 @@
 #include "libavutil/pixelutils.h"
 
 #include "avfilter.h"
+#include "framerate.h"
 #include "internal.h"
 #include "video.h"
 
@@ -73,13 +74,19 @@ typedef struct FrameRateContext {
     int64_t srce_pts_dest[N_SRCE];      ///< pts for source frames scaled to output timebase
     int64_t pts;                        ///< pts of frame we are working on
 
-    int (*blend_frames)(AVFilterContext *ctx, float interpolate,
-                        AVFrame *copy_src1, AVFrame *copy_src2);
+    FrameRateDSPContext dsp;
     int max;
     int bitdepth;
+    int nb_threads;
+    int64_t *job_sad;                   ///< per-job SAD of the scene score
     AVFrame *work;
 } FrameRateContext;
 
+typedef struct ThreadData {
+    AVFrame *src1, *src2, *out;
+    int factor1, factor2;
+} ThreadData;
+
 #define OFFSET(x) offsetof(FrameRateContext, x)
 #define V AV_OPT_FLAG_VIDEO_PARAM
 #define F AV_OPT_FLAG_FILTERING_PARAM
@@ -120,56 +127,32 @@ static void next_source(AVFilterContext *ctx)
     s->srce[s->frst] = NULL;
 }
 
-static av_always_inline int64_t sad_8x8_16(const uint16_t *src1, ptrdiff_t stride1,
-                                           const uint16_t *src2, ptrdiff_t stride2)
-{
-    int sum = 0;
-    int x, y;
-
-    for (y = 0; y < 8; y++) {
-        for (x = 0; x < 8; x++)
-            sum += FFABS(src1[x] - src2[x]);
-        src1 += stride1;
-        src2 += stride2;
-    }
-    return sum;
-}
-
-static double get_scene_score16(AVFilterContext *ctx, AVFrame *crnt, AVFrame *next)
+static int scene_sad_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     FrameRateContext *s = ctx->priv;
-    double ret = 0;
-
-    ff_dlog(ctx, "get_scene_score16()\n");
+    const ThreadData *td = arg;
+    const uint8_t *p1 = td->src1->data[0];
+    const uint8_t *p2 = td->src2->data[0];
+    const int p1_linesize = td->src1->linesize[0];
+    const int p2_linesize = td->src2->linesize[0];
+    const int nb_blocks = (td->src1->height + 7) >> 3;
+    const int block_start = (nb_blocks *  jobnr   ) / nb_jobs;
+    const int block_end   = (nb_blocks * (jobnr+1)) / nb_jobs;
+    const int step = s->bitdepth > 8 ? 16 : 8;
+    int64_t sad = 0;
+    int x, y;
 
-    if (crnt &&
-        crnt->height == next->height &&
-        crnt->width  == next->width) {
-        int x, y;
-        int64_t sad;
-        double mafd, diff;
-        const uint16_t *p1 = (const uint16_t *)crnt->data[0];
-        const uint16_t *p2 = (const uint16_t *)next->data[0];
-        const int p1_linesize = crnt->linesize[0] / 2;
-        const int p2_linesize = next->linesize[0] / 2;
-
-        ff_dlog(ctx, "get_scene_score16() process\n");
-
-        for (sad = y = 0; y < crnt->height; y += 8) {
-            for (x = 0; x < p1_linesize; x += 8) {
-                sad += sad_8x8_16(p1 + y * p1_linesize + x,
-                                  p1_linesize,
-                                  p2 + y * p2_linesize + x,
-                                  p2_linesize);
-            }
+    for (y = block_start * 8; y < block_end * 8; y += 8) {
+        for (x = 0; x < p1_linesize; x += step) {
+            sad += s->sad(p1 + y * p1_linesize + x,
+                          p1_linesize,
+                          p2 + y * p2_linesize + x,
+                          p2_linesize);
         }
-        mafd = sad / (crnt->height * crnt->width * 3);
-        diff = fabs(mafd - s->prev_mafd);
-        ret  = av_clipf(FFMIN(mafd, diff), 0, 100.0);
-        s->prev_mafd = mafd;
     }
-    ff_dlog(ctx, "get_scene_score16() result is:%f\n", ret);
-    return ret;
+    emms_c();
+    s->job_sad[jobnr] = sad;
+    return 0;
 }
 
 static double get_scene_score(AVFilterContext *ctx, AVFrame *crnt, AVFrame *next)
@@ -182,100 +165,54 @@ static double get_scene_score(AVFilterContext *ctx, AVFrame *crnt, AVFrame *next
     if (crnt &&
         crnt->height == next->height &&
         crnt->width  == next->width) {
-        int x, y;
-        int64_t sad;
+        const int nb_jobs = FFMIN((crnt->height + 7) >> 3, s->nb_threads);
+        ThreadData td = { .src1 = crnt, .src2 = next };
+        int64_t sad = 0;
         double mafd, diff;
-        uint8_t *p1 = crnt->data[0];
-        uint8_t *p2 = next->data[0];
-        const int p1_linesize = crnt->linesize[0];
-        const int p2_linesize = next->linesize[0];
+        int i;
 
         ff_dlog(ctx, "get_scene_score() process\n");
 
-        for (sad = y = 0; y < crnt->height; y += 8) {
-            for (x = 0; x < p1_linesize; x += 8) {
-                sad += s->sad(p1 + y * p1_linesize + x,
-                              p1_linesize,
-                              p2 + y * p2_linesize + x,
-                              p2_linesize);
-            }
-        }
-        emms_c();
+        ctx->internal->execute(ctx, scene_sad_slice, &td, NULL, nb_jobs);
+        for (i = 0; i < nb_jobs; i++)
+            sad += s->job_sad[i];
+
         mafd = sad / (crnt->height * crnt->width * 3);
         diff = fabs(mafd - s->prev_mafd);
         ret  = av_clipf(FFMIN(mafd, diff), 0, 100.0);
         s->prev_mafd = mafd;
     }
-        ff_dlog(ctx, "get_scene_score() result is:%f\n", ret);
+    ff_dlog(ctx, "get_scene_score() result is:%f\n", ret);
     return ret;
 }
 
-static int blend_frames16(AVFilterContext *ctx, float interpolate,
-                          AVFrame *copy_src1, AVFrame *copy_src2)
+static int blend_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     FrameRateContext *s = ctx->priv;
-    AVFilterLink *outlink = ctx->outputs[0];
-    double interpolate_scene_score = 0;
-
-    if ((s->flags & FRAMERATE_FLAG_SCD) && copy_src2) {
-        interpolate_scene_score = get_scene_score16(ctx, copy_src1, copy_src2);
-        ff_dlog(ctx, "blend_frames16() interpolate scene score:%f\n", interpolate_scene_score);
-    }
-    // decide if the shot-change detection allows us to blend two frames
-    if (interpolate_scene_score < s->scene_score && copy_src2) {
-        uint16_t src2_factor = fabsf(interpolate) * (1 << (s->bitdepth - 8));
-        uint16_t src1_factor = s->max - src2_factor;
-        const int half = s->max / 2;
-        const int uv = (s->max + 1) * half;
-        const int shift = s->bitdepth;
-        int plane, line, pixel;
-
-        // get work-space for output frame
-        s->work = ff_get_video_buffer(outlink, outlink->w, outlink->h);
-        if (!s->work)
-            return AVERROR(ENOMEM);
-
-        av_frame_copy_props(s->work, s->srce[s->crnt]);
-
-        ff_dlog(ctx, "blend_frames16() INTERPOLATE to create work frame\n");
-        for (plane = 0; plane < 4 && copy_src1->data[plane] && copy_src2->data[plane]; plane++) {
-            int cpy_line_width = s->line_size[plane];
-            const uint16_t *cpy_src1_data = (const uint16_t *)copy_src1->data[plane];
-            int cpy_src1_line_size = copy_src1->linesize[plane] / 2;
-            const uint16_t *cpy_src2_data = (const uint16_t *)copy_src2->data[plane];
-            int cpy_src2_line_size = copy_src2->linesize[plane] / 2;
-            int cpy_src_h = (plane > 0 && plane < 3) ? (copy_src1->height >> s->vsub) : (copy_src1->height);
-            uint16_t *cpy_dst_data = (uint16_t *)s->work->data[plane];
-            int cpy_dst_line_size = s->work->linesize[plane] / 2;
-
-            if (plane <1 || plane >2) {
-                // luma or alpha
-                for (line = 0; line < cpy_src_h; line++) {
-                    for (pixel = 0; pixel < cpy_line_width; pixel++)
-                        cpy_dst_data[pixel] = ((cpy_src1_data[pixel] * src1_factor) + (cpy_src2_data[pixel] * src2_factor) + half) >> shift;
-                    cpy_src1_data += cpy_src1_line_size;
-                    cpy_src2_data += cpy_src2_line_size;
-                    cpy_dst_data += cpy_dst_line_size;
-                }
-            } else {
-                // chroma
-                for (line = 0; line < cpy_src_h; line++) {
-                    for (pixel = 0; pixel < cpy_line_width; pixel++) {
-                        cpy_dst_data[pixel] = (((cpy_src1_data[pixel] - half) * src1_factor) + ((cpy_src2_data[pixel] - half) * src2_factor) + uv) >> shift;
-                    }
-                    cpy_src1_data += cpy_src1_line_size;
-                    cpy_src2_data += cpy_src2_line_size;
-                    cpy_dst_data += cpy_dst_line_size;
-                }
-            }
-        }
-        return 1;
+    const ThreadData *td = arg;
+    const int bps = (s->bitdepth + 7) >> 3;
+    int plane, line;
+
+    for (plane = 0; plane < 4 && td->src1->data[plane] && td->src2->data[plane]; plane++) {
+        const int height = (plane > 0 && plane < 3) ? AV_CEIL_RSHIFT(td->src1->height, s->vsub)
+                                                    : td->src1->height;
+        const int slice_start = (height *  jobnr   ) / nb_jobs;
+        const int slice_end   = (height * (jobnr+1)) / nb_jobs;
+        const int width = s->line_size[plane] / bps;
+
+        // chroma needs no special case: with factor1 + factor2 == max, centering
+        // the samples around half before blending cancels out
+        for (line = slice_start; line < slice_end; line++)
+            s->dsp.blend(td->src1->data[plane] + line * td->src1->linesize[plane],
+                         td->src2->data[plane] + line * td->src2->linesize[plane],
+                         td->out->data[plane]  + line * td->out->linesize[plane],
+                         width, td->factor1, td->factor2, s->max / 2, s->bitdepth);
     }
     return 0;
 }
 
-static int blend_frames8(AVFilterContext *ctx, float interpolate,
-                         AVFrame *copy_src1, AVFrame *copy_src2)
+static int blend_frames(AVFilterContext *ctx, float interpolate,
+                        AVFrame *copy_src1, AVFrame *copy_src2)
 {
     FrameRateContext *s = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
@@ -283,59 +220,28 @@ static int blend_frames8(AVFilterContext *ctx, float interpolate,
 
     if ((s->flags & FRAMERATE_FLAG_SCD) && copy_src2) {
         interpolate_scene_score = get_scene_score(ctx, copy_src1, copy_src2);
-        ff_dlog(ctx, "blend_frames8() interpolate scene score:%f\n", interpolate_scene_score);
+        ff_dlog(ctx, "blend_frames() interpolate scene score:%f\n", interpolate_scene_score);
     }
     // decide if the shot-change detection allows us to blend two frames
     if (interpolate_scene_score < s->scene_score && copy_src2) {
-        uint16_t src2_factor = fabsf(interpolate);
-        uint16_t src1_factor = 256 - src2_factor;
-        int plane, line, pixel;
+        ThreadData td;
+
+        td.src1    = copy_src1;
+        td.src2    = copy_src2;
+        td.factor2 = (uint16_t)(fabsf(interpolate) * (1 << (s->bitdepth - 8)));
+        td.factor1 = s->max - td.factor2;
 
         // get work-space for output frame
         s->work = ff_get_video_buffer(outlink, outlink->w, outlink->h);
         if (!s->work)
             return AVERROR(ENOMEM);
+        td.out = s->work;
 
         av_frame_copy_props(s->work, s->srce[s->crnt]);
 
-        ff_dlog(ctx, "blend_frames8() INTERPOLATE to create work frame\n");
-        for (plane = 0; plane < 4 && copy_src1->data[plane] && copy_src2->data[plane]; plane++) {
-            int cpy_line_width = s->line_size[plane];
-            uint8_t *cpy_src1_data = copy_src1->data[plane];
-            int cpy_src1_line_size = copy_src1->linesize[plane];
-            uint8_t *cpy_src2_data = copy_src2->data[plane];
-            int cpy_src2_line_size = copy_src2->linesize[plane];
-            int cpy_src_h = (plane > 0 && plane < 3) ? (copy_src1->height >> s->vsub) : (copy_src1->height);
-            uint8_t *cpy_dst_data = s->work->data[plane];
-            int cpy_dst_line_size = s->work->linesize[plane];
-            if (plane <1 || plane >2) {
-                // luma or alpha
-                for (line = 0; line < cpy_src_h; line++) {
-                    for (pixel = 0; pixel < cpy_line_width; pixel++) {
-                        // integer version of (src1 * src1_factor) + (src2 + src2_factor) + 0.5
-                        // 0.5 is for rounding
-                        // 128 is the integer representation of 0.5 << 8
-                        cpy_dst_data[pixel] = ((cpy_src1_data[pixel] * src1_factor) + (cpy_src2_data[pixel] * src2_factor) + 128) >> 8;
-                    }
-                    cpy_src1_data += cpy_src1_line_size;
-                    cpy_src2_data += cpy_src2_line_size;
-                    cpy_dst_data += cpy_dst_line_size;
-                }
-            } else {
-                // chroma
-                for (line = 0; line < cpy_src_h; line++) {
-                    for (pixel = 0; pixel < cpy_line_width; pixel++) {
-                        // as above
-                        // because U and V are based around 128 we have to subtract 128 from the components.
-                        // 32896 is the integer representation of 128.5 << 8
-                        cpy_dst_data[pixel] = (((cpy_src1_data[pixel] - 128) * src1_factor) + ((cpy_src2_data[pixel] - 128) * src2_factor) + 32896) >> 8;
-                    }
-                    cpy_src1_data += cpy_src1_line_size;
-                    cpy_src2_data += cpy_src2_line_size;
-                    cpy_dst_data += cpy_dst_line_size;
-                }
-            }
-        }
+        ff_dlog(ctx, "blend_frames() INTERPOLATE to create work frame\n");
+        ctx->internal->execute(ctx, blend_slice, &td, NULL,
+                               FFMIN(outlink->h, s->nb_threads));
         return 1;
     }
     return 0;
@@ -411,7 +317,7 @@ static int process_work_frame(AVFilterContext *ctx, int stop)
             ff_dlog(ctx, "process_work_frame() interpolate source is:PREV\n");
             copy_src2 = s->srce[s->prev];
         }
-        if (s->blend_frames(ctx, interpolate, copy_src1, copy_src2))
+        if (blend_frames(ctx, interpolate, copy_src1, copy_src2))
             goto copy_done;
         else
             ff_dlog(ctx, "process_work_frame() CUT - DON'T INTERPOLATE\n");
@@ -506,6 +412,32 @@ static void set_work_frame_pts(AVFilterContext *ctx)
             s->pts, s->dest_time_base.num, s->dest_time_base.den);
 }
 
+static void blend_c(const uint8_t *src1, const uint8_t *src2, uint8_t *dst,
+                    ptrdiff_t width, int factor1, int factor2, int half, int shift)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+        dst[x] = (src1[x] * factor1 + src2[x] * factor2 + half) >> shift;
+}
+
+static void blend16_c(const uint8_t *_src1, const uint8_t *_src2, uint8_t *_dst,
+                      ptrdiff_t width, int factor1, int factor2, int half, int shift)
+{
+    const uint16_t *src1 = (const uint16_t *)_src1;
+    const uint16_t *src2 = (const uint16_t *)_src2;
+    uint16_t *dst = (uint16_t *)_dst;
+    int x;
+
+    for (x = 0; x < width; x++)
+        dst[x] = (src1[x] * factor1 + src2[x] * factor2 + half) >> shift;
+}
+
+void ff_framerate_dsp_init(FrameRateDSPContext *dsp, int bitdepth)
+{
+    dsp->blend = bitdepth == 8 ? blend_c : blend16_c;
+}
+
 static av_cold int init(AVFilterContext *ctx)
 {
     FrameRateContext *s = ctx->priv;
@@ -531,6 +463,7 @@ static av_cold void uninit(AVFilterContext *ctx)
             av_frame_free(&s->srce[i]);
     }
     av_frame_free(&s->srce[s->last]);
+    av_freep(&s->job_sad);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -569,18 +502,24 @@ static int config_input(AVFilterLink *inlink)
     s->bitdepth = pix_desc->comp[0].depth;
     s->vsub = pix_desc->log2_chroma_h;
 
-    s->sad = av_pixelutils_get_sad_fn(3, 3, 2, s); // 8x8 both sources aligned
+    if (s->bitdepth == 8)
+        s->sad = av_pixelutils_get_sad_fn(3, 3, 2, s); // 8x8 both sources aligned
+    else
+        s->sad = av_pixelutils_get_sad16_fn(3, 3, 2, s);
     if (!s->sad)
         return AVERROR(EINVAL);
 
     s->srce_time_base = inlink->time_base;
 
-    if (s->bitdepth == 8)
-        s->blend_frames = blend_frames8;
-    else
-        s->blend_frames = blend_frames16;
+    ff_framerate_dsp_init(&s->dsp, s->bitdepth);
     s->max = 1 << (s->bitdepth);
 
+    s->nb_threads = FFMAX(1, ctx->graph->nb_threads);
+    av_freep(&s->job_sad);
+    s->job_sad = av_calloc(s->nb_threads, sizeof(*s->job_sad));
+    if (!s->job_sad)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -728,4 +667,5 @@ AVFilter ff_vf_framerate = {
     .query_formats = query_formats,
     .inputs        = framerate_inputs,
     .outputs       = framerate_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -34,6 +34,7 @@
 #include "dualinput.h"
 #include "formats.h"
 #include "internal.h"
+#include "lut3d.h"
 #include "video.h"
 
 #define R 0
@@ -48,13 +49,12 @@ enum interp_mode {
     NB_INTERP_MODE
 };
 
-struct rgbvec {
-    float r, g, b;
-};
+/* largest 1D shaper accepted in a cube file */
+#define MAX_1D_LEVEL 65536
 
-/* 3D LUT don't often go up to level 32, but it is common to have a Hald CLUT
- * of 512x512 (64x64x64) */
-#define MAX_LEVEL 64
+typedef void (*interp_line_func)(float *r, float *g, float *b,
+                                 const struct rgbvec (*lut)[MAX_LEVEL][MAX_LEVEL],
+                                 int lutmax, int w);
 
 typedef struct LUT3DContext {
     const AVClass *class;
@@ -62,13 +62,27 @@ typedef struct LUT3DContext {
     char *file;
     uint8_t rgba_map[4];
     int step;
-    avfilter_action_func *interp;
+    int is16bit;
+    int planar;
+    interp_line_func interp_line;
+    void (*unpack_line)(const struct LUT3DContext *lut3d, float *r, float *g, float *b,
+                        const AVFrame *in, int y);
+    void (*pack_line)(const struct LUT3DContext *lut3d, AVFrame *out, const AVFrame *in,
+                      const float *r, const float *g, const float *b, int y);
     struct rgbvec lut[MAX_LEVEL][MAX_LEVEL][MAX_LEVEL];
     int lutsize;
+    float *shaper;              ///< optional 1D LUT applied before the 3D LUT, planar r, g, b
+    int shaper_size;
+    float shaper_min, shaper_max;
+    float *prelut;              ///< shaper precomputed for every input value, in LUT coordinates
+    float *linebuf;             ///< per-thread r, g and b float lines
+    int linebuf_stride;
+    LUT3DDSPContext dsp;
 #if CONFIG_HALDCLUT_FILTER
     uint8_t clut_rgba_map[4];
     int clut_step;
     int clut_is16bit;
+    int clut_planar;
     int clut_width;
     FFDualInputContext dinput;
 #endif
@@ -102,35 +116,35 @@ static inline struct rgbvec lerp(const struct rgbvec *v0, const struct rgbvec *v
 
 #define NEAR(x) ((int)((x) + .5))
 #define PREV(x) ((int)(x))
-#define NEXT(x) (FFMIN((int)(x) + 1, lut3d->lutsize - 1))
+#define NEXT(x) (FFMIN((int)(x) + 1, lutmax))
 
 /**
  * Get the nearest defined point
  */
-static inline struct rgbvec interp_nearest(const LUT3DContext *lut3d,
-                                           const struct rgbvec *s)
+static inline struct rgbvec interp_nearest(const struct rgbvec (*lut)[MAX_LEVEL][MAX_LEVEL],
+                                           int lutmax, const struct rgbvec *s)
 {
-    return lut3d->lut[NEAR(s->r)][NEAR(s->g)][NEAR(s->b)];
+    return lut[NEAR(s->r)][NEAR(s->g)][NEAR(s->b)];
 }
 
 /**
  * Interpolate using the 8 vertices of a cube
  * @see https://en.wikipedia.org/wiki/Trilinear_interpolation
  */
-static inline struct rgbvec interp_trilinear(const LUT3DContext *lut3d,
-                                             const struct rgbvec *s)
+static inline struct rgbvec interp_trilinear(const struct rgbvec (*lut)[MAX_LEVEL][MAX_LEVEL],
+                                             int lutmax, const struct rgbvec *s)
 {
     const int prev[] = {PREV(s->r), PREV(s->g), PREV(s->b)};
     const int next[] = {NEXT(s->r), NEXT(s->g), NEXT(s->b)};
     const struct rgbvec d = {s->r - prev[0], s->g - prev[1], s->b - prev[2]};
-    const struct rgbvec c000 = lut3d->lut[prev[0]][prev[1]][prev[2]];
-    const struct rgbvec c001 = lut3d->lut[prev[0]][prev[1]][next[2]];
-    const struct rgbvec c010 = lut3d->lut[prev[0]][next[1]][prev[2]];
-    const struct rgbvec c011 = lut3d->lut[prev[0]][next[1]][next[2]];
-    const struct rgbvec c100 = lut3d->lut[next[0]][prev[1]][prev[2]];
-    const struct rgbvec c101 = lut3d->lut[next[0]][prev[1]][next[2]];
-    const struct rgbvec c110 = lut3d->lut[next[0]][next[1]][prev[2]];
-    const struct rgbvec c111 = lut3d->lut[next[0]][next[1]][next[2]];
+    const struct rgbvec c000 = lut[prev[0]][prev[1]][prev[2]];
+    const struct rgbvec c001 = lut[prev[0]][prev[1]][next[2]];
+    const struct rgbvec c010 = lut[prev[0]][next[1]][prev[2]];
+    const struct rgbvec c011 = lut[prev[0]][next[1]][next[2]];
+    const struct rgbvec c100 = lut[next[0]][prev[1]][prev[2]];
+    const struct rgbvec c101 = lut[next[0]][prev[1]][next[2]];
+    const struct rgbvec c110 = lut[next[0]][next[1]][prev[2]];
+    const struct rgbvec c111 = lut[next[0]][next[1]][next[2]];
     const struct rgbvec c00  = lerp(&c000, &c100, d.r);
     const struct rgbvec c10  = lerp(&c010, &c110, d.r);
     const struct rgbvec c01  = lerp(&c001, &c101, d.r);
@@ -145,51 +159,51 @@ static inline struct rgbvec interp_trilinear(const LUT3DContext *lut3d,
  * Tetrahedral interpolation. Based on code found in Truelight Software Library paper.
  * @see http://www.filmlight.ltd.uk/pdf/whitepapers/FL-TL-TN-0057-SoftwareLib.pdf
  */
-static inline struct rgbvec interp_tetrahedral(const LUT3DContext *lut3d,
-                                               const struct rgbvec *s)
+static inline struct rgbvec interp_tetrahedral(const struct rgbvec (*lut)[MAX_LEVEL][MAX_LEVEL],
+                                               int lutmax, const struct rgbvec *s)
 {
     const int prev[] = {PREV(s->r), PREV(s->g), PREV(s->b)};
     const int next[] = {NEXT(s->r), NEXT(s->g), NEXT(s->b)};
     const struct rgbvec d = {s->r - prev[0], s->g - prev[1], s->b - prev[2]};
-    const struct rgbvec c000 = lut3d->lut[prev[0]][prev[1]][prev[2]];
-    const struct rgbvec c111 = lut3d->lut[next[0]][next[1]][next[2]];
+    const struct rgbvec c000 = lut[prev[0]][prev[1]][prev[2]];
+    const struct rgbvec c111 = lut[next[0]][next[1]][next[2]];
     struct rgbvec c;
     if (d.r > d.g) {
         if (d.g > d.b) {
-            const struct rgbvec c100 = lut3d->lut[next[0]][prev[1]][prev[2]];
-            const struct rgbvec c110 = lut3d->lut[next[0]][next[1]][prev[2]];
+            const struct rgbvec c100 = lut[next[0]][prev[1]][prev[2]];
+            const struct rgbvec c110 = lut[next[0]][next[1]][prev[2]];
             c.r = (1-d.r) * c000.r + (d.r-d.g) * c100.r + (d.g-d.b) * c110.r + (d.b) * c111.r;
             c.g = (1-d.r) * c000.g + (d.r-d.g) * c100.g + (d.g-d.b) * c110.g + (d.b) * c111.g;
             c.b = (1-d.r) * c000.b + (d.r-d.g) * c100.b + (d.g-d.b) * c110.b + (d.b) * c111.b;
         } else if (d.r > d.b) {
-            const struct rgbvec c100 = lut3d->lut[next[0]][prev[1]][prev[2]];
-            const struct rgbvec c101 = lut3d->lut[next[0]][prev[1]][next[2]];
+            const struct rgbvec c100 = lut[next[0]][prev[1]][prev[2]];
+            const struct rgbvec c101 = lut[next[0]][prev[1]][next[2]];
             c.r = (1-d.r) * c000.r + (d.r-d.b) * c100.r + (d.b-d.g) * c101.r + (d.g) * c111.r;
             c.g = (1-d.r) * c000.g + (d.r-d.b) * c100.g + (d.b-d.g) * c101.g + (d.g) * c111.g;
             c.b = (1-d.r) * c000.b + (d.r-d.b) * c100.b + (d.b-d.g) * c101.b + (d.g) * c111.b;
         } else {
-            const struct rgbvec c001 = lut3d->lut[prev[0]][prev[1]][next[2]];
-            const struct rgbvec c101 = lut3d->lut[next[0]][prev[1]][next[2]];
+            const struct rgbvec c001 = lut[prev[0]][prev[1]][next[2]];
+            const struct rgbvec c101 = lut[next[0]][prev[1]][next[2]];
             c.r = (1-d.b) * c000.r + (d.b-d.r) * c001.r + (d.r-d.g) * c101.r + (d.g) * c111.r;
             c.g = (1-d.b) * c000.g + (d.b-d.r) * c001.g + (d.r-d.g) * c101.g + (d.g) * c111.g;
             c.b = (1-d.b) * c000.b + (d.b-d.r) * c001.b + (d.r-d.g) * c101.b + (d.g) * c111.b;
         }
     } else {
         if (d.b > d.g) {
-            const struct rgbvec c001 = lut3d->lut[prev[0]][prev[1]][next[2]];
-            const struct rgbvec c011 = lut3d->lut[prev[0]][next[1]][next[2]];
+            const struct rgbvec c001 = lut[prev[0]][prev[1]][next[2]];
+            const struct rgbvec c011 = lut[prev[0]][next[1]][next[2]];
             c.r = (1-d.b) * c000.r + (d.b-d.g) * c001.r + (d.g-d.r) * c011.r + (d.r) * c111.r;
             c.g = (1-d.b) * c000.g + (d.b-d.g) * c001.g + (d.g-d.r) * c011.g + (d.r) * c111.g;
             c.b = (1-d.b) * c000.b + (d.b-d.g) * c001.b + (d.g-d.r) * c011.b + (d.r) * c111.b;
         } else if (d.b > d.r) {
-            const struct rgbvec c010 = lut3d->lut[prev[0]][next[1]][prev[2]];
-            const struct rgbvec c011 = lut3d->lut[prev[0]][next[1]][next[2]];
+            const struct rgbvec c010 = lut[prev[0]][next[1]][prev[2]];
+            const struct rgbvec c011 = lut[prev[0]][next[1]][next[2]];
             c.r = (1-d.g) * c000.r + (d.g-d.b) * c010.r + (d.b-d.r) * c011.r + (d.r) * c111.r;
             c.g = (1-d.g) * c000.g + (d.g-d.b) * c010.g + (d.b-d.r) * c011.g + (d.r) * c111.g;
             c.b = (1-d.g) * c000.b + (d.g-d.b) * c010.b + (d.b-d.r) * c011.b + (d.r) * c111.b;
         } else {
-            const struct rgbvec c010 = lut3d->lut[prev[0]][next[1]][prev[2]];
-            const struct rgbvec c110 = lut3d->lut[next[0]][next[1]][prev[2]];
+            const struct rgbvec c010 = lut[prev[0]][next[1]][prev[2]];
+            const struct rgbvec c110 = lut[next[0]][next[1]][prev[2]];
             c.r = (1-d.g) * c000.r + (d.g-d.r) * c010.r + (d.r-d.b) * c110.r + (d.b) * c111.r;
             c.g = (1-d.g) * c000.g + (d.g-d.r) * c010.g + (d.r-d.b) * c110.g + (d.b) * c111.g;
             c.b = (1-d.g) * c000.b + (d.g-d.r) * c010.b + (d.r-d.b) * c110.b + (d.b) * c111.b;
@@ -198,53 +212,158 @@ static inline struct rgbvec interp_tetrahedral(const LUT3DContext *lut3d,
     return c;
 }
 
-#define DEFINE_INTERP_FUNC(name, nbits)                                                             \
-static int interp_##nbits##_##name(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)         \
+#define DEFINE_INTERP_LINE(name)                                                                    \
+static void interp_##name##_line(float *r, float *g, float *b,                                      \
+                                 const struct rgbvec (*lut)[MAX_LEVEL][MAX_LEVEL],                  \
+                                 int lutmax, int w)                                                 \
 {                                                                                                   \
-    int x, y;                                                                                       \
-    const LUT3DContext *lut3d = ctx->priv;                                                          \
-    const ThreadData *td = arg;                                                                     \
-    const AVFrame *in  = td->in;                                                                    \
-    const AVFrame *out = td->out;                                                                   \
+    int x;                                                                                          \
+                                                                                                    \
+    for (x = 0; x < w; x++) {                                                                       \
+        const struct rgbvec scaled_rgb = {r[x], g[x], b[x]};                                        \
+        const struct rgbvec vec = interp_##name(lut, lutmax, &scaled_rgb);                          \
+        r[x] = vec.r;                                                                               \
+        g[x] = vec.g;                                                                               \
+        b[x] = vec.b;                                                                               \
+    }                                                                                               \
+}
+
+DEFINE_INTERP_LINE(nearest)
+DEFINE_INTERP_LINE(trilinear)
+DEFINE_INTERP_LINE(tetrahedral)
+
+av_cold void ff_lut3d_dsp_init(LUT3DDSPContext *dsp)
+{
+    dsp->interp_tetrahedral = interp_tetrahedral_line;
+}
+
+/* Load a line of pixels as LUT coordinates, either scaled or through the
+ * precomputed shaper, and store the interpolated values back. */
+#define DEFINE_PACK_FUNCS(nbits)                                                                    \
+static void unpack_packed_##nbits(const LUT3DContext *lut3d, float *r, float *g, float *b,          \
+                                  const AVFrame *in, int y)                                         \
+{                                                                                                   \
+    const uint##nbits##_t *src = (const uint##nbits##_t *)(in->data[0] + y * in->linesize[0]);      \
+    const int step = lut3d->step;                                                                   \
+    const uint8_t rm = lut3d->rgba_map[R];                                                          \
+    const uint8_t gm = lut3d->rgba_map[G];                                                          \
+    const uint8_t bm = lut3d->rgba_map[B];                                                          \
+    const float scale = (1. / ((1<<nbits) - 1)) * (lut3d->lutsize - 1);                             \
+    int x;                                                                                          \
+                                                                                                    \
+    if (lut3d->prelut) {                                                                            \
+        const float *pr = lut3d->prelut;                                                            \
+        const float *pg = pr + (1 << nbits);                                                        \
+        const float *pb = pg + (1 << nbits);                                                        \
+        for (x = 0; x < in->width; x++, src += step) {                                              \
+            r[x] = pr[src[rm]];                                                                     \
+            g[x] = pg[src[gm]];                                                                     \
+            b[x] = pb[src[bm]];                                                                     \
+        }                                                                                           \
+    } else {                                                                                        \
+        for (x = 0; x < in->width; x++, src += step) {                                              \
+            r[x] = src[rm] * scale;                                                                 \
+            g[x] = src[gm] * scale;                                                                 \
+            b[x] = src[bm] * scale;                                                                 \
+        }                                                                                           \
+    }                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+static void pack_packed_##nbits(const LUT3DContext *lut3d, AVFrame *out, const AVFrame *in,         \
+                                const float *r, const float *g, const float *b, int y)              \
+{                                                                                                   \
+    uint##nbits##_t *dst = (uint##nbits##_t *)(out->data[0] + y * out->linesize[0]);                \
+    const uint##nbits##_t *src = (const uint##nbits##_t *)(in->data[0] + y * in->linesize[0]);      \
     const int direct = out == in;                                                                   \
     const int step = lut3d->step;                                                                   \
-    const uint8_t r = lut3d->rgba_map[R];                                                           \
-    const uint8_t g = lut3d->rgba_map[G];                                                           \
-    const uint8_t b = lut3d->rgba_map[B];                                                           \
-    const uint8_t a = lut3d->rgba_map[A];                                                           \
-    const int slice_start = (in->height *  jobnr   ) / nb_jobs;                                     \
-    const int slice_end   = (in->height * (jobnr+1)) / nb_jobs;                                     \
-    uint8_t       *dstrow = out->data[0] + slice_start * out->linesize[0];                          \
-    const uint8_t *srcrow = in ->data[0] + slice_start * in ->linesize[0];                          \
+    const uint8_t rm = lut3d->rgba_map[R];                                                          \
+    const uint8_t gm = lut3d->rgba_map[G];                                                          \
+    const uint8_t bm = lut3d->rgba_map[B];                                                          \
+    const uint8_t am = lut3d->rgba_map[A];                                                          \
+    int x;                                                                                          \
+                                                                                                    \
+    for (x = 0; x < out->width; x++, dst += step, src += step) {                                    \
+        dst[rm] = av_clip_uint##nbits(r[x] * (float)((1<<nbits) - 1));                              \
+        dst[gm] = av_clip_uint##nbits(g[x] * (float)((1<<nbits) - 1));                              \
+        dst[bm] = av_clip_uint##nbits(b[x] * (float)((1<<nbits) - 1));                              \
+        if (!direct && step == 4)                                                                   \
+            dst[am] = src[am];                                                                      \
+    }                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+static void unpack_planar_##nbits(const LUT3DContext *lut3d, float *r, float *g, float *b,          \
+                                  const AVFrame *in, int y)                                         \
+{                                                                                                   \
+    const uint##nbits##_t *srcg = (const uint##nbits##_t *)(in->data[0] + y * in->linesize[0]);     \
+    const uint##nbits##_t *srcb = (const uint##nbits##_t *)(in->data[1] + y * in->linesize[1]);     \
+    const uint##nbits##_t *srcr = (const uint##nbits##_t *)(in->data[2] + y * in->linesize[2]);     \
     const float scale = (1. / ((1<<nbits) - 1)) * (lut3d->lutsize - 1);                             \
+    int x;                                                                                          \
                                                                                                     \
-    for (y = slice_start; y < slice_end; y++) {                                                     \
-        uint##nbits##_t *dst = (uint##nbits##_t *)dstrow;                                           \
-        const uint##nbits##_t *src = (const uint##nbits##_t *)srcrow;                               \
-        for (x = 0; x < in->width * step; x += step) {                                              \
-            const struct rgbvec scaled_rgb = {src[x + r] * scale,                                   \
-                                              src[x + g] * scale,                                   \
-                                              src[x + b] * scale};                                  \
-            struct rgbvec vec = interp_##name(lut3d, &scaled_rgb);                                  \
-            dst[x + r] = av_clip_uint##nbits(vec.r * (float)((1<<nbits) - 1));                      \
-            dst[x + g] = av_clip_uint##nbits(vec.g * (float)((1<<nbits) - 1));                      \
-            dst[x + b] = av_clip_uint##nbits(vec.b * (float)((1<<nbits) - 1));                      \
-            if (!direct && step == 4)                                                               \
-                dst[x + a] = src[x + a];                                                            \
+    if (lut3d->prelut) {                                                                            \
+        const float *pr = lut3d->prelut;                                                            \
+        const float *pg = pr + (1 << nbits);                                                        \
+        const float *pb = pg + (1 << nbits);                                                        \
+        for (x = 0; x < in->width; x++) {                                                           \
+            r[x] = pr[srcr[x]];                                                                     \
+            g[x] = pg[srcg[x]];                                                                     \
+            b[x] = pb[srcb[x]];                                                                     \
+        }                                                                                           \
+    } else {                                                                                        \
+        for (x = 0; x < in->width; x++) {                                                           \
+            r[x] = srcr[x] * scale;                                                                 \
+            g[x] = srcg[x] * scale;                                                                 \
+            b[x] = srcb[x] * scale;                                                                 \
         }                                                                                           \
-        dstrow += out->linesize[0];                                                                 \
-        srcrow += in ->linesize[0];                                                                 \
     }                                                                                               \
-    return 0;                                                                                       \
+}                                                                                                   \
+                                                                                                    \
+static void pack_planar_##nbits(const LUT3DContext *lut3d, AVFrame *out, const AVFrame *in,         \
+                                const float *r, const float *g, const float *b, int y)              \
+{                                                                                                   \
+    uint##nbits##_t *dstg = (uint##nbits##_t *)(out->data[0] + y * out->linesize[0]);               \
+    uint##nbits##_t *dstb = (uint##nbits##_t *)(out->data[1] + y * out->linesize[1]);               \
+    uint##nbits##_t *dstr = (uint##nbits##_t *)(out->data[2] + y * out->linesize[2]);               \
+    int x;                                                                                          \
+                                                                                                    \
+    for (x = 0; x < out->width; x++) {                                                              \
+        dstr[x] = av_clip_uint##nbits(r[x] * (float)((1<<nbits) - 1));                              \
+        dstg[x] = av_clip_uint##nbits(g[x] * (float)((1<<nbits) - 1));                              \
+        dstb[x] = av_clip_uint##nbits(b[x] * (float)((1<<nbits) - 1));                              \
+    }                                                                                               \
+    if (out != in && in->data[3])                                                                   \
+        memcpy(out->data[3] + y * out->linesize[3],                                                 \
+               in ->data[3] + y * in ->linesize[3], out->width * sizeof(*dstr));                    \
 }
 
-DEFINE_INTERP_FUNC(nearest,     8)
-DEFINE_INTERP_FUNC(trilinear,   8)
-DEFINE_INTERP_FUNC(tetrahedral, 8)
+DEFINE_PACK_FUNCS(8)
+DEFINE_PACK_FUNCS(16)
 
-DEFINE_INTERP_FUNC(nearest,     16)
-DEFINE_INTERP_FUNC(trilinear,   16)
-DEFINE_INTERP_FUNC(tetrahedral, 16)
+static int interp_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    const LUT3DContext *lut3d = ctx->priv;
+    const ThreadData *td = arg;
+    const AVFrame *in  = td->in;
+    AVFrame *out = td->out;
+    const int w = FFALIGN(in->width, 8);
+    const int slice_start = (in->height *  jobnr   ) / nb_jobs;
+    const int slice_end   = (in->height * (jobnr+1)) / nb_jobs;
+    float *r = lut3d->linebuf + jobnr * 3 * lut3d->linebuf_stride;
+    float *g = r + lut3d->linebuf_stride;
+    float *b = g + lut3d->linebuf_stride;
+    int y;
+
+    for (y = slice_start; y < slice_end; y++) {
+        lut3d->unpack_line(lut3d, r, g, b, in, y);
+        /* keep the padding within the LUT for the SIMD versions */
+        memset(r + in->width, 0, (w - in->width) * sizeof(*r));
+        memset(g + in->width, 0, (w - in->width) * sizeof(*g));
+        memset(b + in->width, 0, (w - in->width) * sizeof(*b));
+        lut3d->interp_line(r, g, b, lut3d->lut, lut3d->lutsize - 1, w);
+        lut3d->pack_line(lut3d, out, in, r, g, b, y);
+    }
+    return 0;
+}
 
 #define MAX_LINE_SIZE 512
 
@@ -296,7 +415,38 @@ static int parse_dat(AVFilterContext *ctx, FILE *f)
     return 0;
 }
 
-/* Iridas format */
+/* 1D shaper of a cube file, listed before the 3D table */
+static int parse_cube_shaper(AVFilterContext *ctx, FILE *f)
+{
+    LUT3DContext *lut3d = ctx->priv;
+    char line[MAX_LINE_SIZE];
+    const int size = lut3d->shaper_size;
+    int i;
+
+    lut3d->shaper = av_malloc_array(size, 3 * sizeof(*lut3d->shaper));
+    if (!lut3d->shaper)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < size; i++) {
+        float *vec = lut3d->shaper + i;
+
+        do {
+            NEXT_LINE(0);
+            if (!strncmp(line, "LUT_1D_INPUT_RANGE ", 19))
+                sscanf(line + 19, "%f %f", &lut3d->shaper_min, &lut3d->shaper_max);
+        } while (skip_line(line) || (line[0] >= 'A' && line[0] <= 'Z')); /* keywords */
+        if (sscanf(line, "%f %f %f", vec, vec + size, vec + 2 * size) != 3)
+            return AVERROR_INVALIDDATA;
+    }
+
+    if (lut3d->shaper_max <= lut3d->shaper_min) {
+        av_log(ctx, AV_LOG_ERROR, "Invalid 1D LUT input range\n");
+        return AVERROR_INVALIDDATA;
+    }
+    return 0;
+}
+
+/* Iridas format, with the optional 1D shaper of the Resolve variant */
 static int parse_cube(AVFilterContext *ctx, FILE *f)
 {
     LUT3DContext *lut3d = ctx->priv;
@@ -305,8 +455,18 @@ static int parse_cube(AVFilterContext *ctx, FILE *f)
     float max[3] = {1.0, 1.0, 1.0};
 
     while (fgets(line, sizeof(line), f)) {
-        if (!strncmp(line, "LUT_3D_SIZE ", 12)) {
-            int i, j, k;
+        if (!strncmp(line, "LUT_1D_SIZE ", 12)) {
+            const int size = strtol(line + 12, NULL, 0);
+
+            if (size < 2 || size > MAX_1D_LEVEL) {
+                av_log(ctx, AV_LOG_ERROR, "Too large or invalid 1D LUT size\n");
+                return AVERROR(EINVAL);
+            }
+            lut3d->shaper_size = size;
+        } else if (!strncmp(line, "LUT_1D_INPUT_RANGE ", 19)) {
+            sscanf(line + 19, "%f %f", &lut3d->shaper_min, &lut3d->shaper_max);
+        } else if (!strncmp(line, "LUT_3D_SIZE ", 12)) {
+            int i, j, k, ret;
             const int size = strtol(line + 12, NULL, 0);
 
             if (size < 2 || size > MAX_LEVEL) {
@@ -314,6 +474,8 @@ static int parse_cube(AVFilterContext *ctx, FILE *f)
                 return AVERROR(EINVAL);
             }
             lut3d->lutsize = size;
+            if (lut3d->shaper_size && (ret = parse_cube_shaper(ctx, f)) < 0)
+                return ret;
             for (k = 0; k < size; k++) {
                 for (j = 0; j < size; j++) {
                     for (i = 0; i < size; i++) {
@@ -469,6 +631,8 @@ static int query_formats(AVFilterContext *ctx)
         AV_PIX_FMT_RGB0,   AV_PIX_FMT_BGR0,
         AV_PIX_FMT_RGB48,  AV_PIX_FMT_BGR48,
         AV_PIX_FMT_RGBA64, AV_PIX_FMT_BGRA64,
+        AV_PIX_FMT_GBRP,   AV_PIX_FMT_GBRAP,
+        AV_PIX_FMT_GBRP16, AV_PIX_FMT_GBRAP16,
         AV_PIX_FMT_NONE
     };
     AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
@@ -477,43 +641,83 @@ static int query_formats(AVFilterContext *ctx)
     return ff_set_common_formats(ctx, fmts_list);
 }
 
+/* Sample the shaper for every input value, straight into LUT coordinates. */
+static int build_prelut(LUT3DContext *lut3d, int depth)
+{
+    const int nb_values = 1 << depth;
+    const int size = lut3d->shaper_size;
+    const float lutmax = lut3d->lutsize - 1;
+    const float range = lut3d->shaper_max - lut3d->shaper_min;
+    int c, i;
+
+    av_freep(&lut3d->prelut);
+    lut3d->prelut = av_malloc_array(nb_values, 3 * sizeof(*lut3d->prelut));
+    if (!lut3d->prelut)
+        return AVERROR(ENOMEM);
+
+    for (c = 0; c < 3; c++) {
+        const float *shaper = lut3d->shaper + c * size;
+        float *prelut = lut3d->prelut + c * nb_values;
+
+        for (i = 0; i < nb_values; i++) {
+            const float x = av_clipf((i / (float)(nb_values - 1) - lut3d->shaper_min) / range,
+                                     0.f, 1.f) * (size - 1);
+            const int prev = x;
+            const int next = FFMIN(prev + 1, size - 1);
+
+            prelut[i] = av_clipf(lerpf(shaper[prev], shaper[next], x - prev), 0.f, 1.f) * lutmax;
+        }
+    }
+    return 0;
+}
+
 static int config_input(AVFilterLink *inlink)
 {
-    int is16bit = 0;
-    LUT3DContext *lut3d = inlink->dst->priv;
+    AVFilterContext *ctx = inlink->dst;
+    LUT3DContext *lut3d = ctx->priv;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+    const int nb_threads = FFMAX(1, ctx->graph->nb_threads);
+    int ret;
 
-    switch (inlink->format) {
-    case AV_PIX_FMT_RGB48:
-    case AV_PIX_FMT_BGR48:
-    case AV_PIX_FMT_RGBA64:
-    case AV_PIX_FMT_BGRA64:
-        is16bit = 1;
-    }
+    lut3d->is16bit = desc->comp[0].depth > 8;
+    lut3d->planar  = desc->flags & AV_PIX_FMT_FLAG_PLANAR;
 
     ff_fill_rgba_map(lut3d->rgba_map, inlink->format);
-    lut3d->step = av_get_padded_bits_per_pixel(desc) >> (3 + is16bit);
+    lut3d->step = av_get_padded_bits_per_pixel(desc) >> (3 + lut3d->is16bit);
 
-#define SET_FUNC(name) do {                             \
-    if (is16bit) lut3d->interp = interp_16_##name;      \
-    else         lut3d->interp = interp_8_##name;       \
-} while (0)
+    if (lut3d->planar) {
+        lut3d->unpack_line = lut3d->is16bit ? unpack_planar_16 : unpack_planar_8;
+        lut3d->pack_line   = lut3d->is16bit ? pack_planar_16   : pack_planar_8;
+    } else {
+        lut3d->unpack_line = lut3d->is16bit ? unpack_packed_16 : unpack_packed_8;
+        lut3d->pack_line   = lut3d->is16bit ? pack_packed_16   : pack_packed_8;
+    }
+
+    ff_lut3d_dsp_init(&lut3d->dsp);
 
     switch (lut3d->interpolation) {
-    case INTERPOLATE_NEAREST:     SET_FUNC(nearest);        break;
-    case INTERPOLATE_TRILINEAR:   SET_FUNC(trilinear);      break;
-    case INTERPOLATE_TETRAHEDRAL: SET_FUNC(tetrahedral);    break;
+    case INTERPOLATE_NEAREST:     lut3d->interp_line = interp_nearest_line;           break;
+    case INTERPOLATE_TRILINEAR:   lut3d->interp_line = interp_trilinear_line;         break;
+    case INTERPOLATE_TETRAHEDRAL: lut3d->interp_line = lut3d->dsp.interp_tetrahedral; break;
     default:
         av_assert0(0);
     }
 
+    lut3d->linebuf_stride = FFALIGN(inlink->w, 8);
+    av_freep(&lut3d->linebuf);
+    lut3d->linebuf = av_malloc_array(nb_threads, 3 * lut3d->linebuf_stride * sizeof(*lut3d->linebuf));
+    if (!lut3d->linebuf)
+        return AVERROR(ENOMEM);
+
+    if (lut3d->shaper && (ret = build_prelut(lut3d, lut3d->is16bit ? 16 : 8)) < 0)
+        return ret;
+
     return 0;
 }
 
 static AVFrame *apply_lut(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx = inlink->dst;
-    LUT3DContext *lut3d = ctx->priv;
     AVFilterLink *outlink = inlink->dst->outputs[0];
     AVFrame *out;
     ThreadData td;
@@ -531,7 +735,7 @@ static AVFrame *apply_lut(AVFilterLink *inlink, AVFrame *in)
 
     td.in  = in;
     td.out = out;
-    ctx->internal->execute(ctx, lut3d->interp, &td, NULL, FFMIN(outlink->h, ctx->graph->nb_threads));
+    ctx->internal->execute(ctx, interp_slice, &td, NULL, FFMIN(outlink->h, ctx->graph->nb_threads));
 
     if (out != in)
         av_frame_free(&in);
@@ -563,6 +767,8 @@ static av_cold int lut3d_init(AVFilterContext *ctx)
     const char *ext;
     LUT3DContext *lut3d = ctx->priv;
 
+    lut3d->shaper_max = 1.f;
+
     if (!lut3d->file) {
         set_identity_matrix(lut3d, 32);
         return 0;
@@ -606,6 +812,15 @@ end:
     return ret;
 }
 
+static av_cold void lut3d_uninit(AVFilterContext *ctx)
+{
+    LUT3DContext *lut3d = ctx->priv;
+
+    av_freep(&lut3d->shaper);
+    av_freep(&lut3d->prelut);
+    av_freep(&lut3d->linebuf);
+}
+
 static const AVFilterPad lut3d_inputs[] = {
     {
         .name         = "default",
@@ -629,6 +844,7 @@ AVFilter ff_vf_lut3d = {
     .description   = NULL_IF_CONFIG_SMALL("Adjust colors using a 3D LUT."),
     .priv_size     = sizeof(LUT3DContext),
     .init          = lut3d_init,
+    .uninit        = lut3d_uninit,
     .query_formats = query_formats,
     .inputs        = lut3d_inputs,
     .outputs       = lut3d_outputs,
@@ -669,8 +885,38 @@ static void update_clut(LUT3DContext *lut3d, const AVFrame *frame)
     }                                                                   \
 } while (0)
 
-    if (!lut3d->clut_is16bit) LOAD_CLUT(8);
-    else                      LOAD_CLUT(16);
+#define LOAD_CLUT_PLANAR(nbits) do {                                            \
+    int i, j, k, x = 0, y = 0;                                                  \
+                                                                                \
+    for (k = 0; k < level; k++) {                                               \
+        for (j = 0; j < level; j++) {                                           \
+            for (i = 0; i < level; i++) {                                       \
+                const uint##nbits##_t *gsrc = (const uint##nbits##_t *)         \
+                    (frame->data[0] + y*frame->linesize[0]);                    \
+                const uint##nbits##_t *bsrc = (const uint##nbits##_t *)         \
+                    (frame->data[1] + y*frame->linesize[1]);                    \
+                const uint##nbits##_t *rsrc = (const uint##nbits##_t *)         \
+                    (frame->data[2] + y*frame->linesize[2]);                    \
+                struct rgbvec *vec = &lut3d->lut[i][j][k];                      \
+                vec->r = rsrc[x] / (float)((1<<(nbits)) - 1);                   \
+                vec->g = gsrc[x] / (float)((1<<(nbits)) - 1);                   \
+                vec->b = bsrc[x] / (float)((1<<(nbits)) - 1);                   \
+                if (++x == w) {                                                 \
+                    x = 0;                                                      \
+                    y++;                                                        \
+                }                                                               \
+            }                                                                   \
+        }                                                                       \
+    }                                                                           \
+} while (0)
+
+    if (lut3d->clut_planar) {
+        if (!lut3d->clut_is16bit) LOAD_CLUT_PLANAR(8);
+        else                      LOAD_CLUT_PLANAR(16);
+    } else {
+        if (!lut3d->clut_is16bit) LOAD_CLUT(8);
+        else                      LOAD_CLUT(16);
+    }
 }
 
 
@@ -709,14 +955,8 @@ static int config_clut(AVFilterLink *inlink)
 
     av_assert0(desc);
 
-    lut3d->clut_is16bit = 0;
-    switch (inlink->format) {
-    case AV_PIX_FMT_RGB48:
-    case AV_PIX_FMT_BGR48:
-    case AV_PIX_FMT_RGBA64:
-    case AV_PIX_FMT_BGRA64:
-        lut3d->clut_is16bit = 1;
-    }
+    lut3d->clut_is16bit = desc->comp[0].depth > 8;
+    lut3d->clut_planar  = desc->flags & AV_PIX_FMT_FLAG_PLANAR;
 
     lut3d->clut_step = av_get_padded_bits_per_pixel(desc) >> 3;
     ff_fill_rgba_map(lut3d->clut_rgba_map, inlink->format);
@@ -769,6 +1009,7 @@ static av_cold void haldclut_uninit(AVFilterContext *ctx)
 {
     LUT3DContext *lut3d = ctx->priv;
     ff_dualinput_uninit(&lut3d->dinput);
+    av_freep(&lut3d->linebuf);
 }
 
 static const AVOption haldclut_options[] = {
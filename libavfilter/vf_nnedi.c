@@ -29,6 +29,7 @@
 #include "avfilter.h"
 #include "formats.h"
 #include "internal.h"
+#include "nnedi.h"
 #include "video.h"
 
 typedef struct FrameData {
@@ -43,8 +44,9 @@ typedef struct FrameData {
     int field[3];
 
     int32_t *lcount[3];
-    float *input;
-    float *temp;
+    float *input;        ///< 512 floats per thread
+    float *temp;         ///< temp_stride floats per thread
+    int temp_stride;
 } FrameData;
 
 typedef struct NNEDIContext {
@@ -59,6 +61,8 @@ typedef struct NNEDIContext {
     int64_t cur_pts;
 
     AVFloatDSPContext *fdsp;
+    NNEDIDSPContext dsp;
+    int nb_threads;
     int nb_planes;
     int linesize[4];
     int planeheight[4];
@@ -84,8 +88,8 @@ typedef struct NNEDIContext {
     int max_value;
 
     void (*copy_pad)(const AVFrame *, FrameData *, struct NNEDIContext *, int);
-    void (*evalfunc_0)(struct NNEDIContext *, FrameData *);
-    void (*evalfunc_1)(struct NNEDIContext *, FrameData *);
+    void (*evalfunc_0)(struct NNEDIContext *, FrameData *, int jobnr, int nb_jobs);
+    void (*evalfunc_1)(struct NNEDIContext *, FrameData *, int jobnr, int nb_jobs);
 
     // Functions used in evalfunc_0
     void (*readpixels)(const uint8_t *, const int, float *);
@@ -161,6 +165,8 @@ static int config_input(AVFilterLink *inlink)
     s->planeheight[1] = s->planeheight[2] = AV_CEIL_RSHIFT(inlink->h, desc->log2_chroma_h);
     s->planeheight[0] = s->planeheight[3] = inlink->h;
 
+    s->nb_threads = FFMAX(1, ctx->graph->nb_threads);
+
     return 0;
 }
 
@@ -265,17 +271,64 @@ static void elliott(float *data, const int n)
         data[i] = data[i] / (1.0f + FFABS(data[i]));
 }
 
+static void dot_prod_c(const float *data, const float *weights, float *sums, int n, int len)
+{
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        float sum = 0.0f;
+
+        for (j = 0; j < len; j++)
+            sum += data[j] * weights[i * len + j];
+        sums[i] = sum;
+    }
+}
+
+static void dot_prods_c(const int16_t *data, const int16_t *weights, int32_t *sums, int n, int len)
+{
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        int sum = 0;
+
+        for (j = 0; j < len; j++)
+            sum += data[j] * weights[i * len + j];
+        sums[i] = sum;
+    }
+}
+
+static void dot_prods_new_c(const int16_t *data, const int16_t *weights, int32_t sums[4])
+{
+    int i, j;
+
+    for (i = 0; i < 4; i++) {
+        int sum = 0;
+
+        for (j = 0; j < 64; j++)
+            sum += data[j] * weights[(i << 3) + ((j >> 3) << 5) + (j & 7)];
+        sums[i] = sum;
+    }
+}
+
 static void dot_prod(NNEDIContext *s, const float *data, const float *weights, float *vals, const int n, const int len, const float *scale)
 {
     int i;
 
-    for (i = 0; i < n; i++) {
-        float sum;
+    // the small layers of the prescreener do not fit the dsp functions
+    if (len & 15) {
+        for (i = 0; i < n; i++) {
+            float sum;
 
-        sum = s->fdsp->scalarproduct_float(data, &weights[i * len], len);
+            sum = s->fdsp->scalarproduct_float(data, &weights[i * len], len);
 
-        vals[i] = sum * scale[0] + weights[n * len + i];
+            vals[i] = sum * scale[0] + weights[n * len + i];
+        }
+        return;
     }
+
+    s->dsp.dot_prod(data, weights, vals, n, len);
+    for (i = 0; i < n; i++)
+        vals[i] = vals[i] * scale[0] + weights[n * len + i];
 }
 
 static void dot_prods(NNEDIContext *s, const float *dataf, const float *weightsf, float *vals, const int n, const int len, const float *scale)
@@ -283,14 +336,14 @@ static void dot_prods(NNEDIContext *s, const float *dataf, const float *weightsf
     const int16_t *data = (int16_t *)dataf;
     const int16_t *weights = (int16_t *)weightsf;
     const float *wf = (float *)&weights[n * len];
-    int i, j;
+    int32_t sums[512];
+    int i;
 
+    s->dsp.dot_prods(data, weights, sums, n, len);
     for (i = 0; i < n; i++) {
-        int sum = 0, off = ((i >> 2) << 3) + (i & 3);
-        for (j = 0; j < len; j++)
-            sum += data[j] * weights[i * len + j];
+        int off = ((i >> 2) << 3) + (i & 3);
 
-        vals[i] = sum * wf[off] * scale[0] + wf[off + 4];
+        vals[i] = sums[i] * wf[off] * scale[0] + wf[off + 4];
     }
 }
 
@@ -386,15 +439,13 @@ static void compute_network0new(NNEDIContext *s, const float *datai, const float
     int16_t *ws = (int16_t *)weights;
     float *wf = (float *)&ws[4 * 64];
     float vals[8];
+    int32_t sums[4];
     int mask, i, j;
 
+    s->dsp.dot_prods_new(data, ws, sums);
     for (i = 0; i < 4; i++) {
-        int sum = 0;
-        float t;
+        float t = sums[i] * wf[i] + wf[4 + i];
 
-        for (j = 0; j < 64; j++)
-            sum += data[j] * ws[(i << 3) + ((j >> 3) << 5) + (j & 7)];
-        t = sum * wf[i] + wf[4 + i];
         vals[i] = t / (1.0f + FFABS(t));
     }
 
@@ -415,11 +466,11 @@ static void compute_network0new(NNEDIContext *s, const float *datai, const float
     ((int *)d)[0] = mask;
 }
 
-static void evalfunc_0(NNEDIContext *s, FrameData *frame_data)
+static void evalfunc_0(NNEDIContext *s, FrameData *frame_data, int jobnr, int nb_jobs)
 {
-    float *input = frame_data->input;
+    float *input = frame_data->input + jobnr * 512;
     const float *weights0 = s->weights0;
-    float *temp = frame_data->temp;
+    float *temp = frame_data->temp + jobnr * frame_data->temp_stride;
     uint8_t *tempu = (uint8_t *)temp;
     int plane, x, y;
 
@@ -433,6 +484,9 @@ static void evalfunc_0(NNEDIContext *s, FrameData *frame_data)
 
         uint8_t *dstp = (uint8_t *)frame_data->dstp[plane];
         const int dst_stride = frame_data->dst_stride[plane] / sizeof(uint8_t);
+        const int slice_start = ((height - 12) * jobnr / nb_jobs) & ~1;
+        const int slice_end = jobnr == nb_jobs - 1 ? height - 12 :
+                              ((height - 12) * (jobnr + 1) / nb_jobs) & ~1;
         const uint8_t *src3p;
         int ystart, ystop;
         int32_t *lcount;
@@ -440,15 +494,15 @@ static void evalfunc_0(NNEDIContext *s, FrameData *frame_data)
         if (!(s->process_plane & (1 << plane)))
             continue;
 
-        for (y = 1 - frame_data->field[plane]; y < height - 12; y += 2) {
+        for (y = slice_start + 1 - frame_data->field[plane]; y < slice_end; y += 2) {
             memcpy(dstp + y * dst_stride,
                    srcp + 32 + (6 + y) * src_stride,
                    (width - 64) * sizeof(uint8_t));
 
         }
 
-        ystart = 6 + frame_data->field[plane];
-        ystop = height - 6;
+        ystart = 6 + slice_start + frame_data->field[plane];
+        ystop = 6 + slice_end;
         srcp += ystart * src_stride;
         dstp += (ystart - 6) * dst_stride - 32;
         src3p = srcp - src_stride * 3;
@@ -575,10 +629,10 @@ static void weighted_avg_elliott_mul5_m16(const float *w, const int n, float *ms
 }
 
 
-static void evalfunc_1(NNEDIContext *s, FrameData *frame_data)
+static void evalfunc_1(NNEDIContext *s, FrameData *frame_data, int jobnr, int nb_jobs)
 {
-    float *input = frame_data->input;
-    float *temp = frame_data->temp;
+    float *input = frame_data->input + jobnr * 512;
+    float *temp = frame_data->temp + jobnr * frame_data->temp_stride;
     float **weights1 = s->weights1;
     const int qual = s->qual;
     const int asize = s->asize;
@@ -599,8 +653,11 @@ static void evalfunc_1(NNEDIContext *s, FrameData *frame_data)
         uint8_t *dstp = (uint8_t *)frame_data->dstp[plane];
         const int dst_stride = frame_data->dst_stride[plane] / sizeof(uint8_t);
 
-        const int ystart = frame_data->field[plane];
-        const int ystop = height - 12;
+        const int slice_start = ((height - 12) * jobnr / nb_jobs) & ~1;
+        const int slice_end = jobnr == nb_jobs - 1 ? height - 12 :
+                              ((height - 12) * (jobnr + 1) / nb_jobs) & ~1;
+        const int ystart = slice_start + frame_data->field[plane];
+        const int ystop = slice_end;
         const uint8_t *srcpp;
 
         if (!(s->process_plane & (1 << plane)))
@@ -679,6 +736,13 @@ static void select_functions(NNEDIContext *s)
     s->expfunc = e2_m16;
 }
 
+av_cold void ff_nnedi_dsp_init(NNEDIDSPContext *dsp)
+{
+    dsp->dot_prod      = dot_prod_c;
+    dsp->dot_prods     = dot_prods_c;
+    dsp->dot_prods_new = dot_prods_new_c;
+}
+
 static int modnpf(const int m, const int n)
 {
     if ((m % n) == 0)
@@ -686,6 +750,20 @@ static int modnpf(const int m, const int n)
     return m + n - (m % n);
 }
 
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    NNEDIContext *s = ctx->priv;
+    FrameData *frame_data = arg;
+
+    // Handles prescreening and the cubic interpolation.
+    s->evalfunc_0(s, frame_data, jobnr, nb_jobs);
+
+    // The rest.
+    s->evalfunc_1(s, frame_data, jobnr, nb_jobs);
+
+    return 0;
+}
+
 static int get_frame(AVFilterContext *ctx, int is_second)
 {
     NNEDIContext *s = ctx->priv;
@@ -693,7 +771,6 @@ static int get_frame(AVFilterContext *ctx, int is_second)
     AVFrame *src = s->src;
     FrameData *frame_data;
     int effective_field = s->field;
-    size_t temp_size;
     int field_n;
     int plane;
 
@@ -766,15 +843,15 @@ static int get_frame(AVFilterContext *ctx, int is_second)
     }
 
     if (!frame_data->input) {
-        frame_data->input = av_malloc(512 * sizeof(float));
+        frame_data->input = av_malloc_array(s->nb_threads, 512 * sizeof(float));
         if (!frame_data->input)
             return AVERROR(ENOMEM);
     }
     // evalfunc_0 requires at least padded_width[0] bytes.
     // evalfunc_1 requires at least 512 floats.
     if (!frame_data->temp) {
-        temp_size = FFMAX(frame_data->padded_width[0], 512 * sizeof(float));
-        frame_data->temp = av_malloc(temp_size);
+        frame_data->temp_stride = FFALIGN(FFMAX(s->linesize[0] + 64, 512 * sizeof(float)), 64) / sizeof(float);
+        frame_data->temp = av_malloc_array(s->nb_threads, frame_data->temp_stride * sizeof(float));
         if (!frame_data->temp)
             return AVERROR(ENOMEM);
     }
@@ -782,11 +859,7 @@ static int get_frame(AVFilterContext *ctx, int is_second)
     // Copy src to a padded "frame" in frame_data and mirror the edges.
     s->copy_pad(src, frame_data, s, field_n);
 
-    // Handles prescreening and the cubic interpolation.
-    s->evalfunc_0(s, frame_data);
-
-    // The rest.
-    s->evalfunc_1(s, frame_data);
+    ctx->internal->execute(ctx, filter_slice, frame_data, NULL, s->nb_threads);
 
     return 0;
 }
@@ -1146,6 +1219,7 @@ static av_cold int init(AVFilterContext *ctx)
     s->max_value = 65535 >> 8;
 
     select_functions(s);
+    ff_nnedi_dsp_init(&s->dsp);
 
     s->fdsp = avpriv_float_dsp_alloc(0);
     if (!s->fdsp)
@@ -1207,5 +1281,5 @@ AVFilter ff_vf_nnedi = {
     .query_formats = query_formats,
     .inputs        = inputs,
     .outputs       = outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -394,15 +394,21 @@ static int config_output(AVFilterLink *outlink)
 // ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)) is a faster version of: 255 * (x + y)
 #define UNPREMULTIPLY_ALPHA(x, y) ((((x) << 16) - ((x) << 9) + (x)) / ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)))
 
+/* first row of the part of [start, end) processed by the job jobnr */
+#define SLICE_ROW(start, end, jobnr, nb_jobs) \
+    ((start) + ((end) - (start)) * (jobnr) / (nb_jobs))
+
 /**
  * Blend image in src to destination buffer dst at position (x, y).
+ * The rows of every plane are split in nb_jobs slices, of which only the
+ * slice jobnr is processed.
  */
 static void blend_image(AVFilterContext *ctx,
                         AVFrame *dst, const AVFrame *src,
-                        int x, int y)
+                        int x, int y, int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
-    int i, imax, j, jmax, k, kmax;
+    int i, imax, j, jmax, k, kmax, start, end;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
@@ -427,11 +433,14 @@ static void blend_image(AVFilterContext *ctx,
         const int main_has_alpha = s->main_has_alpha;
         uint8_t *s, *sp, *d, *dp;
 
-        i = FFMAX(-y, 0);
+        start = FFMAX(-y, 0);
+        end   = FFMIN(-y + dst_h, src_h);
+        i     = SLICE_ROW(start, end, jobnr,     nb_jobs);
+        imax  = SLICE_ROW(start, end, jobnr + 1, nb_jobs);
         sp = src->data[0] + i     * src->linesize[0];
         dp = dst->data[0] + (y+i) * dst->linesize[0];
 
-        for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+        for (; i < imax; i++) {
             j = FFMAX(-x, 0);
             s = sp + j     * sstep;
             d = dp + (x+j) * dstep;
@@ -485,11 +494,14 @@ static void blend_image(AVFilterContext *ctx,
             uint8_t alpha;          ///< the amount of overlay to blend on to main
             uint8_t *s, *sa, *d, *da;
 
-            i = FFMAX(-y, 0);
+            start = FFMAX(-y, 0);
+            end   = FFMIN(-y + dst_h, src_h);
+            i     = SLICE_ROW(start, end, jobnr,     nb_jobs);
+            imax  = SLICE_ROW(start, end, jobnr + 1, nb_jobs);
             sa = src->data[3] + i     * src->linesize[3];
             da = dst->data[3] + (y+i) * dst->linesize[3];
 
-            for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+            for (; i < imax; i++) {
                 j = FFMAX(-x, 0);
                 s = sa + j;
                 d = da + x+j;
@@ -528,12 +540,15 @@ static void blend_image(AVFilterContext *ctx,
             int xp = x>>hsub;
             uint8_t *s, *sp, *d, *dp, *a, *ap;
 
-            j = FFMAX(-yp, 0);
+            start = FFMAX(-yp, 0);
+            end   = FFMIN(-yp + dst_hp, src_hp);
+            j     = SLICE_ROW(start, end, jobnr,     nb_jobs);
+            jmax  = SLICE_ROW(start, end, jobnr + 1, nb_jobs);
             sp = src->data[i] + j         * src->linesize[i];
             dp = dst->data[i] + (yp+j)    * dst->linesize[i];
             ap = src->data[3] + (j<<vsub) * src->linesize[3];
 
-            for (jmax = FFMIN(-yp + dst_hp, src_hp); j < jmax; j++) {
+            for (; j < jmax; j++) {
                 k = FFMAX(-xp, 0);
                 d = dp + xp+k;
                 s = sp + k;
@@ -585,11 +600,27 @@ static void blend_image(AVFilterContext *ctx,
     }
 }
 
+typedef struct ThreadData {
+    AVFrame *dst;
+    const AVFrame *src;
+} ThreadData;
+
+static int blend_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+
+    blend_image(ctx, td->dst, td->src, s->x, s->y, jobnr, nb_jobs);
+    return 0;
+}
+
 static AVFrame *do_blend(AVFilterContext *ctx, AVFrame *mainpic,
                          const AVFrame *second)
 {
     OverlayContext *s = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
+    ThreadData td = { .dst = mainpic, .src = second };
+    int nb_jobs;
 
     if (s->eval_mode == EVAL_MODE_FRAME) {
         int64_t pos = av_frame_get_pkt_pos(mainpic);
@@ -611,7 +642,14 @@ static AVFrame *do_blend(AVFilterContext *ctx, AVFrame *mainpic,
                s->var_values[VAR_Y], s->y);
     }
 
-    blend_image(ctx, mainpic, second, s->x, s->y);
+    /* each job needs at least a few chroma rows of the overlay */
+    nb_jobs = FFMAX(1, FFMIN(ctx->graph->nb_threads, second->height >> (s->vsub + 2)));
+    /* with an alpha plane in main, the blend of vertically subsampled chroma
+     * reads the main chroma row below, which at a slice edge is written by
+     * the next job */
+    if (s->main_has_alpha && !s->main_is_packed_rgb && s->vsub)
+        nb_jobs = 1;
+    ctx->internal->execute(ctx, blend_slice, &td, NULL, nb_jobs);
     return mainpic;
 }
 
@@ -716,5 +754,6 @@ AVFilter ff_vf_overlay = {
     .process_command = process_command,
     .inputs        = avfilter_vf_overlay_inputs,
     .outputs       = avfilter_vf_overlay_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -29,6 +29,7 @@
 #include "libavutil/qsort.h"
 #include "dualinput.h"
 #include "avfilter.h"
+#include "internal.h"
 
 enum dithering_mode {
     DITHERING_NONE,
@@ -44,7 +45,8 @@ enum color_search_method {
     COLOR_SEARCH_NNS_ITERATIVE,
     COLOR_SEARCH_NNS_RECURSIVE,
     COLOR_SEARCH_BRUTEFORCE,
-    NB_COLOR_SEARCHES
+    NB_COLOR_SEARCHES,
+    COLOR_SEARCH_LUT = NB_COLOR_SEARCHES, ///< lookup table, not selectable
 };
 
 enum diff_mode {
@@ -75,13 +77,19 @@ struct cache_node {
 
 struct PaletteUseContext;
 
-typedef int (*set_frame_func)(struct PaletteUseContext *s, AVFrame *out, AVFrame *in,
+typedef int (*set_frame_func)(struct PaletteUseContext *s, struct cache_node *cache,
+                              AVFrame *out, AVFrame *in,
                               int x_start, int y_start, int width, int height);
 
 typedef struct PaletteUseContext {
     const AVClass *class;
     FFDualInputContext dinput;
-    struct cache_node cache[CACHE_SIZE];    /* lookup cache */
+    struct cache_node (*cache)[CACHE_SIZE]; /* lookup cache, one per thread */
+    int nb_threads;
+    int *slice_ret;
+    int lut_bits;
+    uint8_t *lut;                           /* full RGB lookup table, with lut_bits per component */
+    int new;
     struct color_node map[AVPALETTE_COUNT]; /* 3D-Tree (KD-Tree with K=3) for reverse colormap */
     uint32_t palette[AVPALETTE_COUNT];
     int palette_loaded;
@@ -113,6 +121,8 @@ static const AVOption paletteuse_options[] = {
     { "bayer_scale", "set scale for bayer dithering", OFFSET(bayer_scale), AV_OPT_TYPE_INT, {.i64=2}, 0, 5, FLAGS },
     { "diff_mode",   "set frame difference mode",     OFFSET(diff_mode),   AV_OPT_TYPE_INT, {.i64=DIFF_MODE_NONE}, 0, NB_DIFF_MODE-1, FLAGS, "diff_mode" },
         { "rectangle", "process smallest different rectangle", 0, AV_OPT_TYPE_CONST, {.i64=DIFF_MODE_RECTANGLE}, INT_MIN, INT_MAX, FLAGS, "diff_mode" },
+    { "lut_bits",    "set bits per component of the color lookup table (0 to search every color)", OFFSET(lut_bits), AV_OPT_TYPE_INT, {.i64=0}, 0, 6, FLAGS },
+    { "new",         "take new palette for each output frame", OFFSET(new), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS },
 
     /* following are the debug options, not part of the official API */
     { "debug_kdtree", "save Graphviz graph of the kdtree in specified file", OFFSET(dot_filename), AV_OPT_TYPE_STRING, {.str=NULL}, CHAR_MIN, CHAR_MAX, FLAGS },
@@ -319,10 +329,8 @@ end:
  * Note: r, g, and b are the component of c but are passed as well to avoid
  * recomputing them (they are generally computed by the caller for other uses).
  */
-static av_always_inline int color_get(struct cache_node *cache, uint32_t color,
-                                      uint8_t r, uint8_t g, uint8_t b,
-                                      const struct color_node *map,
-                                      const uint32_t *palette,
+static av_always_inline int color_get(const PaletteUseContext *s, struct cache_node *cache,
+                                      uint32_t color, uint8_t r, uint8_t g, uint8_t b,
                                       const enum color_search_method search_method)
 {
     int i;
@@ -334,6 +342,11 @@ static av_always_inline int color_get(struct cache_node *cache, uint32_t color,
     struct cache_node *node = &cache[hash];
     struct cached_color *e;
 
+    if (search_method == COLOR_SEARCH_LUT) {
+        const int bits = s->lut_bits, shift = 8 - bits;
+        return s->lut[((r >> shift) << bits | g >> shift) << bits | b >> shift];
+    }
+
     for (i = 0; i < node->nb_entries; i++) {
         e = &node->entries[i];
         if (e->color == color)
@@ -345,36 +358,32 @@ static av_always_inline int color_get(struct cache_node *cache, uint32_t color,
     if (!e)
         return AVERROR(ENOMEM);
     e->color = color;
-    e->pal_entry = COLORMAP_NEAREST(search_method, palette, map, rgb);
+    e->pal_entry = COLORMAP_NEAREST(search_method, s->palette, s->map, rgb);
     return e->pal_entry;
 }
 
-static av_always_inline int get_dst_color_err(struct cache_node *cache,
-                                              uint32_t c, const struct color_node *map,
-                                              const uint32_t *palette,
-                                              int *er, int *eg, int *eb,
+static av_always_inline int get_dst_color_err(const PaletteUseContext *s, struct cache_node *cache,
+                                              uint32_t c, int *er, int *eg, int *eb,
                                               const enum color_search_method search_method)
 {
     const uint8_t r = c >> 16 & 0xff;
     const uint8_t g = c >>  8 & 0xff;
     const uint8_t b = c       & 0xff;
-    const int dstx = color_get(cache, c, r, g, b, map, palette, search_method);
-    const uint32_t dstc = palette[dstx];
+    const int dstx = color_get(s, cache, c, r, g, b, search_method);
+    const uint32_t dstc = s->palette[dstx];
     *er = r - (dstc >> 16 & 0xff);
     *eg = g - (dstc >>  8 & 0xff);
     *eb = b - (dstc       & 0xff);
     return dstx;
 }
 
-static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFrame *in,
+static av_always_inline int set_frame(PaletteUseContext *s, struct cache_node *cache,
+                                      AVFrame *out, AVFrame *in,
                                       int x_start, int y_start, int w, int h,
                                       enum dithering_mode dither,
                                       const enum color_search_method search_method)
 {
     int x, y;
-    const struct color_node *map = s->map;
-    struct cache_node *cache = s->cache;
-    const uint32_t *palette = s->palette;
     const int src_linesize = in ->linesize[0] >> 2;
     const int dst_linesize = out->linesize[0];
     uint32_t *src = ((uint32_t *)in ->data[0]) + y_start*src_linesize;
@@ -396,7 +405,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
                 const uint8_t g = av_clip_uint8(g8 + d);
                 const uint8_t b = av_clip_uint8(b8 + d);
                 const uint32_t c = r<<16 | g<<8 | b;
-                const int color = color_get(cache, c, r, g, b, map, palette, search_method);
+                const int color = color_get(s, cache, c, r, g, b, search_method);
 
                 if (color < 0)
                     return color;
@@ -404,7 +413,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
 
             } else if (dither == DITHERING_HECKBERT) {
                 const int right = x < w - 1, down = y < h - 1;
-                const int color = get_dst_color_err(cache, src[x], map, palette, &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
                 if (color < 0)
                     return color;
@@ -416,7 +425,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
 
             } else if (dither == DITHERING_FLOYD_STEINBERG) {
                 const int right = x < w - 1, down = y < h - 1, left = x > x_start;
-                const int color = get_dst_color_err(cache, src[x], map, palette, &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
                 if (color < 0)
                     return color;
@@ -430,7 +439,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
             } else if (dither == DITHERING_SIERRA2) {
                 const int right  = x < w - 1, down  = y < h - 1, left  = x > x_start;
                 const int right2 = x < w - 2,                    left2 = x > x_start + 1;
-                const int color = get_dst_color_err(cache, src[x], map, palette, &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
                 if (color < 0)
                     return color;
@@ -449,7 +458,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
 
             } else if (dither == DITHERING_SIERRA2_4A) {
                 const int right = x < w - 1, down = y < h - 1, left = x > x_start;
-                const int color = get_dst_color_err(cache, src[x], map, palette, &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
                 if (color < 0)
                     return color;
@@ -463,7 +472,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
                 const uint8_t r = src[x] >> 16 & 0xff;
                 const uint8_t g = src[x] >>  8 & 0xff;
                 const uint8_t b = src[x]       & 0xff;
-                const int color = color_get(cache, src[x] & 0xffffff, r, g, b, map, palette, search_method);
+                const int color = color_get(s, cache, src[x] & 0xffffff, r, g, b, search_method);
 
                 if (color < 0)
                     return color;
@@ -851,12 +860,29 @@ static void set_processing_window(enum diff_mode diff_mode,
     *hp = height;
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int x, y, w, h;
+} ThreadData;
+
+static int set_frame_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    PaletteUseContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    const int slice_start = td->y + (td->h *  jobnr   ) / nb_jobs;
+    const int slice_end   = td->y + (td->h * (jobnr+1)) / nb_jobs;
+
+    return s->set_frame(s, s->cache[jobnr], td->out, td->in,
+                        td->x, slice_start, td->w, slice_end - slice_start);
+}
+
 static AVFrame *apply_palette(AVFilterLink *inlink, AVFrame *in)
 {
-    int x, y, w, h;
+    int i, x, y, w, h, nb_jobs;
     AVFilterContext *ctx = inlink->dst;
     PaletteUseContext *s = ctx->priv;
     AVFilterLink *outlink = inlink->dst->outputs[0];
+    ThreadData td;
 
     AVFrame *out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
     if (!out) {
@@ -881,9 +907,22 @@ static AVFrame *apply_palette(AVFilterLink *inlink, AVFrame *in)
     ff_dlog(ctx, "%dx%d rect: (%d;%d) -> (%d,%d) [area:%dx%d]\n",
             w, h, x, y, x+w, y+h, in->width, in->height);
 
-    if (s->set_frame(s, out, in, x, y, w, h) < 0) {
-        av_frame_free(&out);
-        return NULL;
+    /* error diffusion carries the errors across the whole frame */
+    nb_jobs = s->dither == DITHERING_NONE || s->dither == DITHERING_BAYER ?
+              FFMIN(h, s->nb_threads) : 1;
+    td.in  = in;
+    td.out = out;
+    td.x = x;
+    td.y = y;
+    td.w = w;
+    td.h = h;
+    ctx->internal->execute(ctx, set_frame_slice, &td, s->slice_ret, nb_jobs);
+    for (i = 0; i < nb_jobs; i++) {
+        if (s->slice_ret[i] < 0) {
+            av_frame_free(&in);
+            av_frame_free(&out);
+            return NULL;
+        }
     }
     memcpy(out->data[1], s->palette, AVPALETTE_SIZE);
     if (s->calc_mean_err)
@@ -904,6 +943,19 @@ static int config_output(AVFilterLink *outlink)
     outlink->time_base = ctx->inputs[0]->time_base;
     if ((ret = ff_dualinput_init(ctx, &s->dinput)) < 0)
         return ret;
+
+    if (!s->cache) {
+        s->nb_threads = FFMAX(1, ctx->graph->nb_threads);
+        s->cache     = av_calloc(s->nb_threads, sizeof(*s->cache));
+        s->slice_ret = av_calloc(s->nb_threads, sizeof(*s->slice_ret));
+        if (!s->cache || !s->slice_ret)
+            return AVERROR(ENOMEM);
+    }
+    if (s->lut_bits && !s->lut) {
+        s->lut = av_malloc(1 << (3 * s->lut_bits));
+        if (!s->lut)
+            return AVERROR(ENOMEM);
+    }
     return 0;
 }
 
@@ -922,12 +974,42 @@ static int config_input_palette(AVFilterLink *inlink)
     return 0;
 }
 
-static void load_palette(PaletteUseContext *s, const AVFrame *palette_frame)
+static int build_lut_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    PaletteUseContext *s = ctx->priv;
+    const int bits  = s->lut_bits;
+    const int shift = 8 - bits;
+    const int half  = 1 << (shift - 1);
+    const int start = (1 << bits) *  jobnr    / nb_jobs;
+    const int end   = (1 << bits) * (jobnr+1) / nb_jobs;
+    int r, g, b;
+
+    /* map the center of each cell of the color cube */
+    for (r = start; r < end; r++) {
+        for (g = 0; g < 1 << bits; g++) {
+            for (b = 0; b < 1 << bits; b++) {
+                const uint8_t rgb[] = { r << shift | half, g << shift | half, b << shift | half };
+                s->lut[(r << bits | g) << bits | b] =
+                    COLORMAP_NEAREST(s->color_search_method, s->palette, s->map, rgb);
+            }
+        }
+    }
+    return 0;
+}
+
+static void load_palette(AVFilterContext *ctx, const AVFrame *palette_frame)
 {
+    PaletteUseContext *s = ctx->priv;
     int i, x, y;
     const uint32_t *p = (const uint32_t *)palette_frame->data[0];
     const int p_linesize = palette_frame->linesize[0] >> 2;
 
+    /* the colors cached for the previous palette are stale */
+    if (s->palette_loaded) {
+        for (i = 0; i < s->nb_threads * CACHE_SIZE; i++)
+            s->cache[i / CACHE_SIZE][i % CACHE_SIZE].nb_entries = 0;
+    }
+
     i = 0;
     for (y = 0; y < palette_frame->height; y++) {
         for (x = 0; x < palette_frame->width; x++)
@@ -937,6 +1019,10 @@ static void load_palette(PaletteUseContext *s, const AVFrame *palette_frame)
 
     load_colormap(s);
 
+    if (s->lut)
+        ctx->internal->execute(ctx, build_lut_slice, NULL, NULL,
+                               FFMIN(1 << s->lut_bits, s->nb_threads));
+
     s->palette_loaded = 1;
 }
 
@@ -945,8 +1031,8 @@ static AVFrame *load_apply_palette(AVFilterContext *ctx, AVFrame *main,
 {
     AVFilterLink *inlink = ctx->inputs[0];
     PaletteUseContext *s = ctx->priv;
-    if (!s->palette_loaded) {
-        load_palette(s, second);
+    if (!s->palette_loaded || s->new) {
+        load_palette(ctx, second);
     }
     return apply_palette(inlink, main);
 }
@@ -957,11 +1043,12 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     return ff_dualinput_filter_frame(&s->dinput, inlink, in);
 }
 
-#define DEFINE_SET_FRAME(color_search, name, value)                             \
-static int set_frame_##name(PaletteUseContext *s, AVFrame *out, AVFrame *in,    \
-                            int x_start, int y_start, int w, int h)             \
-{                                                                               \
-    return set_frame(s, out, in, x_start, y_start, w, h, value, color_search);  \
+#define DEFINE_SET_FRAME(color_search, name, value)                                     \
+static int set_frame_##name(PaletteUseContext *s, struct cache_node *cache,             \
+                            AVFrame *out, AVFrame *in,                                  \
+                            int x_start, int y_start, int w, int h)                     \
+{                                                                                       \
+    return set_frame(s, cache, out, in, x_start, y_start, w, h, value, color_search);   \
 }
 
 #define DEFINE_SET_FRAME_COLOR_SEARCH(color_search, color_search_macro)                                 \
@@ -975,6 +1062,7 @@ static int set_frame_##name(PaletteUseContext *s, AVFrame *out, AVFrame *in,
 DEFINE_SET_FRAME_COLOR_SEARCH(nns_iterative, COLOR_SEARCH_NNS_ITERATIVE)
 DEFINE_SET_FRAME_COLOR_SEARCH(nns_recursive, COLOR_SEARCH_NNS_RECURSIVE)
 DEFINE_SET_FRAME_COLOR_SEARCH(bruteforce,    COLOR_SEARCH_BRUTEFORCE)
+DEFINE_SET_FRAME_COLOR_SEARCH(lut,           COLOR_SEARCH_LUT)
 
 #define DITHERING_ENTRIES(color_search) {       \
     set_frame_##color_search##_none,            \
@@ -985,10 +1073,11 @@ DEFINE_SET_FRAME_COLOR_SEARCH(bruteforce,    COLOR_SEARCH_BRUTEFORCE)
     set_frame_##color_search##_sierra2_4a,      \
 }
 
-static const set_frame_func set_frame_lut[NB_COLOR_SEARCHES][NB_DITHERING] = {
+static const set_frame_func set_frame_lut[NB_COLOR_SEARCHES + 1][NB_DITHERING] = {
     DITHERING_ENTRIES(nns_iterative),
     DITHERING_ENTRIES(nns_recursive),
     DITHERING_ENTRIES(bruteforce),
+    DITHERING_ENTRIES(lut),
 };
 
 static int dither_value(int p)
@@ -1005,7 +1094,7 @@ static av_cold int init(AVFilterContext *ctx)
     s->dinput.repeatlast = 1; // only 1 frame in the palette
     s->dinput.process    = load_apply_palette;
 
-    s->set_frame = set_frame_lut[s->color_search_method][s->dither];
+    s->set_frame = set_frame_lut[s->lut_bits ? COLOR_SEARCH_LUT : s->color_search_method][s->dither];
 
     if (s->dither == DITHERING_BAYER) {
         int i;
@@ -1030,8 +1119,11 @@ static av_cold void uninit(AVFilterContext *ctx)
     PaletteUseContext *s = ctx->priv;
 
     ff_dualinput_uninit(&s->dinput);
-    for (i = 0; i < CACHE_SIZE; i++)
-        av_freep(&s->cache[i].entries);
+    for (i = 0; s->cache && i < s->nb_threads * CACHE_SIZE; i++)
+        av_freep(&s->cache[i / CACHE_SIZE][i % CACHE_SIZE].entries);
+    av_freep(&s->cache);
+    av_freep(&s->slice_ret);
+    av_freep(&s->lut);
     av_frame_free(&s->last_in);
     av_frame_free(&s->last_out);
 }
@@ -1071,4 +1163,5 @@ AVFilter ff_vf_paletteuse = {
     .inputs        = paletteuse_inputs,
     .outputs       = paletteuse_outputs,
     .priv_class    = &paletteuse_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
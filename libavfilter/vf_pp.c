@@ -25,7 +25,9 @@
  */
 
 #include "libavutil/avassert.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
 #include "internal.h"
 
 #include "libpostproc/postprocess.h"
@@ -36,8 +38,28 @@ typedef struct {
     int mode_id;
     pp_mode *modes[PP_QUALITY_MAX + 1];
     void *pp_ctx;
+
+    /* per-slice contexts and scratch planes for slice threading */
+    int nb_slices;
+    void **slice_ctx;
+    uint8_t *slice_buf[3];
+    int slice_linesize[3];
+    size_t slice_size[3];
+    int slice_h;
+    int nb_planes, hsub, vsub;
 } PPFilterContext;
 
+/* rows of context processed above and below each slice, in units of
+ * 16 << vsub luma rows so that slices stay aligned to chroma macroblocks */
+#define SLICE_OVERLAP 2
+
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    const int8_t *qp_table;
+    int qstride, pict_type, w, h;
+    pp_mode *mode;
+} ThreadData;
+
 #define OFFSET(x) offsetof(PPFilterContext, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
 static const AVOption pp_options[] = {
@@ -95,7 +117,10 @@ static int pp_query_formats(AVFilterContext *ctx)
 static int pp_config_props(AVFilterLink *inlink)
 {
     int flags = PP_CPU_CAPS_AUTO;
-    PPFilterContext *pp = inlink->dst->priv;
+    AVFilterContext *ctx = inlink->dst;
+    PPFilterContext *pp = ctx->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+    int mb_rows, unit, i;
 
     switch (inlink->format) {
     case AV_PIX_FMT_GRAY8:
@@ -115,6 +140,95 @@ static int pp_config_props(AVFilterLink *inlink)
     pp->pp_ctx = pp_get_context(inlink->w, inlink->h, flags);
     if (!pp->pp_ctx)
         return AVERROR(ENOMEM);
+
+    /* Slices start on a multiple of 16 << vsub luma rows: the QP table has
+     * one row per 16 luma rows and the filters work on 8x8 chroma blocks. */
+    pp->nb_planes = av_pix_fmt_count_planes(inlink->format);
+    pp->hsub = desc->log2_chroma_w;
+    pp->vsub = desc->log2_chroma_h;
+    unit     = 16 << pp->vsub;
+    mb_rows  = (inlink->h + unit - 1) / unit;
+    pp->nb_slices = FFMIN(FFMAX(ctx->graph->nb_threads, 1), mb_rows / (2 * SLICE_OVERLAP));
+    if (pp->nb_slices < 2) {
+        pp->nb_slices = 1;
+        return 0;
+    }
+
+    pp->slice_ctx = av_mallocz_array(pp->nb_slices, sizeof(*pp->slice_ctx));
+    if (!pp->slice_ctx)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < pp->nb_slices; i++) {
+        pp->slice_ctx[i] = pp_get_context(inlink->w, inlink->h, flags);
+        if (!pp->slice_ctx[i])
+            return AVERROR(ENOMEM);
+    }
+
+    pp->slice_h = ((mb_rows + pp->nb_slices - 1) / pp->nb_slices + 2 * SLICE_OVERLAP) * unit;
+    return 0;
+}
+
+/* The scratch planes share the line size of the output frame, so that the
+ * filters, which read a few pixels past the edges of the picture, see the
+ * same layout as when filtering the whole frame in place. */
+static int pp_alloc_slice_bufs(PPFilterContext *pp, const AVFrame *out)
+{
+    int i;
+
+    for (i = 0; i < pp->nb_planes; i++) {
+        int h = i ? pp->slice_h >> pp->vsub : pp->slice_h;
+
+        if (pp->slice_buf[i] && pp->slice_linesize[i] == out->linesize[i])
+            continue;
+        av_freep(&pp->slice_buf[i]);
+        pp->slice_linesize[i] = out->linesize[i];
+        pp->slice_size[i]     = (size_t)out->linesize[i] * h;
+        pp->slice_buf[i] = av_mallocz_array(pp->nb_slices, pp->slice_size[i]);
+        if (!pp->slice_buf[i])
+            return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static int pp_filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    PPFilterContext *pp = ctx->priv;
+    ThreadData *td = arg;
+    const int unit    = 16 << pp->vsub;
+    const int mb_rows = (td->h + unit - 1) / unit;
+    const int start   = FFMIN(mb_rows *  jobnr      / nb_jobs * unit, td->h);
+    const int end     = FFMIN(mb_rows * (jobnr + 1) / nb_jobs * unit, td->h);
+    const int top     = FFMAX(start - SLICE_OVERLAP * unit, 0);
+    const int bottom  = FFMIN(end   + SLICE_OVERLAP * unit, td->h);
+    const int qp_rows = td->qp_table ? top >> 4 : 0;
+    const uint8_t *src[3];
+    uint8_t *dst[3];
+    int i;
+
+    if (start >= end)
+        return 0;
+
+    for (i = 0; i < 3; i++) {
+        int vsub = i ? pp->vsub : 0;
+
+        src[i] = i < pp->nb_planes ? td->in->data[i] + (top >> vsub) * td->in->linesize[i] : NULL;
+        dst[i] = i < pp->nb_planes ? pp->slice_buf[i] + jobnr * pp->slice_size[i] : NULL;
+    }
+
+    pp_postprocess(src, td->in->linesize, dst, pp->slice_linesize,
+                   td->w, bottom - top,
+                   td->qp_table ? td->qp_table + qp_rows * td->qstride : NULL,
+                   td->qstride, td->mode, pp->slice_ctx[jobnr], td->pict_type);
+
+    for (i = 0; i < pp->nb_planes; i++) {
+        int hsub = i ? pp->hsub : 0;
+        int vsub = i ? pp->vsub : 0;
+
+        av_image_copy_plane(td->out->data[i] + (start >> vsub) * td->out->linesize[i],
+                            td->out->linesize[i],
+                            dst[i] + ((start - top) >> vsub) * pp->slice_linesize[i],
+                            pp->slice_linesize[i],
+                            td->w >> hsub, (end >> vsub) - (start >> vsub));
+    }
     return 0;
 }
 
@@ -128,6 +242,7 @@ static int pp_filter_frame(AVFilterLink *inlink, AVFrame *inbuf)
     AVFrame *outbuf;
     int qstride, qp_type;
     int8_t *qp_table ;
+    pp_mode *mode = pp->modes[pp->mode_id];
 
     outbuf = ff_get_video_buffer(outlink, aligned_w, aligned_h);
     if (!outbuf) {
@@ -139,14 +254,35 @@ static int pp_filter_frame(AVFilterLink *inlink, AVFrame *inbuf)
     outbuf->height = inbuf->height;
     qp_table = av_frame_get_qp_table(inbuf, &qstride, &qp_type);
 
-    pp_postprocess((const uint8_t **)inbuf->data, inbuf->linesize,
-                   outbuf->data,                 outbuf->linesize,
-                   aligned_w, outlink->h,
-                   qp_table,
-                   qstride,
-                   pp->modes[pp->mode_id],
-                   pp->pp_ctx,
-                   outbuf->pict_type | (qp_type ? PP_PICT_TYPE_QP2 : 0));
+    if (pp->nb_slices > 1 && pp_mode_supports_slices(mode)) {
+        int ret = pp_alloc_slice_bufs(pp, outbuf);
+        ThreadData td = {
+            .in        = inbuf,
+            .out       = outbuf,
+            .qp_table  = qp_table,
+            .qstride   = qstride,
+            .pict_type = outbuf->pict_type | (qp_type ? PP_PICT_TYPE_QP2 : 0),
+            .w         = aligned_w,
+            .h         = outlink->h,
+            .mode      = mode,
+        };
+
+        if (ret < 0) {
+            av_frame_free(&inbuf);
+            av_frame_free(&outbuf);
+            return ret;
+        }
+        ctx->internal->execute(ctx, pp_filter_slice, &td, NULL, pp->nb_slices);
+    } else {
+        pp_postprocess((const uint8_t **)inbuf->data, inbuf->linesize,
+                       outbuf->data,                 outbuf->linesize,
+                       aligned_w, outlink->h,
+                       qp_table,
+                       qstride,
+                       mode,
+                       pp->pp_ctx,
+                       outbuf->pict_type | (qp_type ? PP_PICT_TYPE_QP2 : 0));
+    }
 
     av_frame_free(&inbuf);
     return ff_filter_frame(outlink, outbuf);
@@ -161,6 +297,12 @@ static av_cold void pp_uninit(AVFilterContext *ctx)
         pp_free_mode(pp->modes[i]);
     if (pp->pp_ctx)
         pp_free_context(pp->pp_ctx);
+    for (i = 0; i < pp->nb_slices && pp->slice_ctx; i++)
+        if (pp->slice_ctx[i])
+            pp_free_context(pp->slice_ctx[i]);
+    av_freep(&pp->slice_ctx);
+    for (i = 0; i < 3; i++)
+        av_freep(&pp->slice_buf[i]);
 }
 
 static const AVFilterPad pp_inputs[] = {
@@ -192,5 +334,5 @@ AVFilter ff_vf_pp = {
     .outputs         = pp_outputs,
     .process_command = pp_process_command,
     .priv_class      = &pp_class,
-    .flags           = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags           = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
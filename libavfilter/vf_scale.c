@@ -78,10 +78,14 @@ enum EvalMode {
 };
 
 
+#define MAX_SLICE_THREADS 32
+
 typedef struct ScaleContext {
     const AVClass *class;
     struct SwsContext *sws;     ///< software scaler context
     struct SwsContext *isws[2]; ///< software scaler context for interlaced material
+    struct SwsContext *slice_sws[MAX_SLICE_THREADS]; ///< software scaler contexts, each rendering one band of the output for slice threading
+    int nb_slice_sws;
     AVDictionary *opts;
 
     /**
@@ -115,6 +119,8 @@ typedef struct ScaleContext {
     int out_v_chr_pos;
     int in_h_chr_pos;
     int in_v_chr_pos;
+    int out_v_chr_pos_opt;      ///< values set by the user, the ones above
+    int in_v_chr_pos_opt;       ///< being overridden for YUV420P
 
     int force_original_aspect_ratio;
 
@@ -157,6 +163,9 @@ static av_cold int init_dict(AVFilterContext *ctx, AVDictionary **opts)
     if (!scale->h_expr)
         av_opt_set(scale, "h", "ih", 0);
 
+    scale->in_v_chr_pos_opt  = scale->in_v_chr_pos;
+    scale->out_v_chr_pos_opt = scale->out_v_chr_pos;
+
     av_log(ctx, AV_LOG_VERBOSE, "w:%s h:%s flags:'%s' interl:%d\n",
            scale->w_expr, scale->h_expr, (char *)av_x_if_null(scale->flags_str, ""), scale->interlaced);
 
@@ -176,9 +185,21 @@ static av_cold int init_dict(AVFilterContext *ctx, AVDictionary **opts)
     return 0;
 }
 
+static void free_slice_contexts(ScaleContext *scale)
+{
+    int i;
+
+    for (i = 0; i < scale->nb_slice_sws; i++) {
+        sws_freeContext(scale->slice_sws[i]);
+        scale->slice_sws[i] = NULL;
+    }
+    scale->nb_slice_sws = 0;
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     ScaleContext *scale = ctx->priv;
+    free_slice_contexts(scale);
     sws_freeContext(scale->sws);
     sws_freeContext(scale->isws[0]);
     sws_freeContext(scale->isws[1]);
@@ -246,6 +267,70 @@ static const int *parse_yuv_type(const char *s, enum AVColorSpace colorspace)
     return sws_getCoefficients(colorspace);
 }
 
+/**
+ * Allocate and initialize a scaler context for the current configuration.
+ * field is 0 for progressive scaling and 1 or 2 for the top and bottom
+ * fields in interlaced mode; a non-zero slice_h restricts the output to
+ * slice_h lines starting at slice_y.
+ */
+static int init_sws_context(ScaleContext *scale, struct SwsContext **s,
+                            AVFilterLink *inlink0, AVFilterLink *outlink,
+                            enum AVPixelFormat outfmt, int field,
+                            int slice_y, int slice_h)
+{
+    int ret;
+
+    *s = sws_alloc_context();
+    if (!*s)
+        return AVERROR(ENOMEM);
+
+    av_opt_set_int(*s, "srcw", inlink0 ->w, 0);
+    av_opt_set_int(*s, "srch", inlink0 ->h >> !!field, 0);
+    av_opt_set_int(*s, "src_format", inlink0->format, 0);
+    av_opt_set_int(*s, "dstw", outlink->w, 0);
+    av_opt_set_int(*s, "dsth", outlink->h >> !!field, 0);
+    av_opt_set_int(*s, "dst_format", outfmt, 0);
+    av_opt_set_int(*s, "sws_flags", scale->flags, 0);
+    av_opt_set_int(*s, "param0", scale->param[0], 0);
+    av_opt_set_int(*s, "param1", scale->param[1], 0);
+    if (scale->in_range != AVCOL_RANGE_UNSPECIFIED)
+        av_opt_set_int(*s, "src_range",
+                       scale->in_range == AVCOL_RANGE_JPEG, 0);
+    if (scale->out_range != AVCOL_RANGE_UNSPECIFIED)
+        av_opt_set_int(*s, "dst_range",
+                       scale->out_range == AVCOL_RANGE_JPEG, 0);
+
+    if (scale->opts) {
+        AVDictionaryEntry *e = NULL;
+        while ((e = av_dict_get(scale->opts, "", e, AV_DICT_IGNORE_SUFFIX))) {
+            if ((ret = av_opt_set(*s, e->key, e->value, 0)) < 0)
+                return ret;
+        }
+    }
+    /* Override YUV420P default settings to have the correct (MPEG-2) chroma positions
+     * MPEG-2 chroma positions are used by convention
+     * XXX: support other 4:2:0 pixel formats */
+    if (inlink0->format == AV_PIX_FMT_YUV420P && scale->in_v_chr_pos == -513) {
+        scale->in_v_chr_pos = (field == 0) ? 128 : (field == 1) ? 64 : 192;
+    }
+
+    if (outlink->format == AV_PIX_FMT_YUV420P && scale->out_v_chr_pos == -513) {
+        scale->out_v_chr_pos = (field == 0) ? 128 : (field == 1) ? 64 : 192;
+    }
+
+    av_opt_set_int(*s, "src_h_chr_pos", scale->in_h_chr_pos, 0);
+    av_opt_set_int(*s, "src_v_chr_pos", scale->in_v_chr_pos, 0);
+    av_opt_set_int(*s, "dst_h_chr_pos", scale->out_h_chr_pos, 0);
+    av_opt_set_int(*s, "dst_v_chr_pos", scale->out_v_chr_pos, 0);
+
+    if (slice_h) {
+        av_opt_set_int(*s, "dst_slice_y", slice_y, 0);
+        av_opt_set_int(*s, "dst_slice_h", slice_h, 0);
+    }
+
+    return sws_init_context(*s, NULL, NULL);
+}
+
 static int config_props(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
@@ -354,6 +439,7 @@ static int config_props(AVFilterLink *outlink)
     scale->output_is_pal = av_pix_fmt_desc_get(outfmt)->flags & AV_PIX_FMT_FLAG_PAL ||
                            av_pix_fmt_desc_get(outfmt)->flags & AV_PIX_FMT_FLAG_PSEUDOPAL;
 
+    free_slice_contexts(scale);
     if (scale->sws)
         sws_freeContext(scale->sws);
     if (scale->isws[0])
@@ -361,6 +447,9 @@ static int config_props(AVFilterLink *outlink)
     if (scale->isws[1])
         sws_freeContext(scale->isws[1]);
     scale->isws[0] = scale->isws[1] = scale->sws = NULL;
+    /* the input format may have changed since the last configuration */
+    scale->in_v_chr_pos  = scale->in_v_chr_pos_opt;
+    scale->out_v_chr_pos = scale->out_v_chr_pos_opt;
     if (inlink0->w == outlink->w &&
         inlink0->h == outlink->h &&
         !scale->out_color_matrix &&
@@ -372,55 +461,41 @@ static int config_props(AVFilterLink *outlink)
         int i;
 
         for (i = 0; i < 3; i++) {
-            struct SwsContext **s = swscs[i];
-            *s = sws_alloc_context();
-            if (!*s)
-                return AVERROR(ENOMEM);
-
-            av_opt_set_int(*s, "srcw", inlink0 ->w, 0);
-            av_opt_set_int(*s, "srch", inlink0 ->h >> !!i, 0);
-            av_opt_set_int(*s, "src_format", inlink0->format, 0);
-            av_opt_set_int(*s, "dstw", outlink->w, 0);
-            av_opt_set_int(*s, "dsth", outlink->h >> !!i, 0);
-            av_opt_set_int(*s, "dst_format", outfmt, 0);
-            av_opt_set_int(*s, "sws_flags", scale->flags, 0);
-            av_opt_set_int(*s, "param0", scale->param[0], 0);
-            av_opt_set_int(*s, "param1", scale->param[1], 0);
-            if (scale->in_range != AVCOL_RANGE_UNSPECIFIED)
-                av_opt_set_int(*s, "src_range",
-                               scale->in_range == AVCOL_RANGE_JPEG, 0);
-            if (scale->out_range != AVCOL_RANGE_UNSPECIFIED)
-                av_opt_set_int(*s, "dst_range",
-                               scale->out_range == AVCOL_RANGE_JPEG, 0);
-
-            if (scale->opts) {
-                AVDictionaryEntry *e = NULL;
-                while ((e = av_dict_get(scale->opts, "", e, AV_DICT_IGNORE_SUFFIX))) {
-                    if ((ret = av_opt_set(*s, e->key, e->value, 0)) < 0)
-                        return ret;
-                }
-            }
-            /* Override YUV420P default settings to have the correct (MPEG-2) chroma positions
-             * MPEG-2 chroma positions are used by convention
-             * XXX: support other 4:2:0 pixel formats */
-            if (inlink0->format == AV_PIX_FMT_YUV420P && scale->in_v_chr_pos == -513) {
-                scale->in_v_chr_pos = (i == 0) ? 128 : (i == 1) ? 64 : 192;
-            }
-
-            if (outlink->format == AV_PIX_FMT_YUV420P && scale->out_v_chr_pos == -513) {
-                scale->out_v_chr_pos = (i == 0) ? 128 : (i == 1) ? 64 : 192;
-            }
-
-            av_opt_set_int(*s, "src_h_chr_pos", scale->in_h_chr_pos, 0);
-            av_opt_set_int(*s, "src_v_chr_pos", scale->in_v_chr_pos, 0);
-            av_opt_set_int(*s, "dst_h_chr_pos", scale->out_h_chr_pos, 0);
-            av_opt_set_int(*s, "dst_v_chr_pos", scale->out_v_chr_pos, 0);
-
-            if ((ret = sws_init_context(*s, NULL, NULL)) < 0)
+            if ((ret = init_sws_context(scale, swscs[i], inlink0, outlink,
+                                        outfmt, i, 0, 0)) < 0)
                 return ret;
             if (!scale->interlaced)
                 break;
         }
+
+        /* Slice threading: every job renders its own band of output lines
+         * from the whole input picture, using a scaler context of its own.
+         * Error diffusion dithering is carried from line to line, so it
+         * can not be split this way. */
+        if (!scale->interlaced && !scale->nb_slices &&
+            (inlink0->w != outlink->w || inlink0->h != outlink->h) &&
+            !(scale->flags & (SWS_ERROR_DIFFUSION | SWS_FULL_CHR_H_INT)) &&
+            !av_dict_get(scale->opts, "sws_dither", NULL, 0)) {
+            int vsub = av_pix_fmt_desc_get(outfmt)->log2_chroma_h;
+            int nb_slices = FFMIN3(MAX_SLICE_THREADS, ctx->graph->nb_threads,
+                                   outlink->h >> (vsub + 3));
+
+            for (i = 0; nb_slices > 1 && i < nb_slices; i++) {
+                int slice_start = (((outlink->h >> vsub) *  i     ) / nb_slices) << vsub;
+                int slice_end   = (((outlink->h >> vsub) * (i + 1)) / nb_slices) << vsub;
+
+                if (i == nb_slices - 1)
+                    slice_end = outlink->h;
+                ret = init_sws_context(scale, &scale->slice_sws[i], inlink0, outlink,
+                                       outfmt, 0, slice_start, slice_end - slice_start);
+                scale->nb_slice_sws = i + 1;
+                if (ret < 0) {
+                    av_log(ctx, AV_LOG_VERBOSE, "Slice threading is not available for this conversion\n");
+                    free_slice_contexts(scale);
+                    break;
+                }
+            }
+        }
     }
 
     if (inlink->sample_aspect_ratio.num){
@@ -490,14 +565,27 @@ static int scale_slice(AVFilterLink *link, AVFrame *out_buf, AVFrame *cur_pic, s
                          out,out_stride);
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ScaleContext *scale = ctx->priv;
+    ThreadData *td = arg;
+
+    return scale_slice(ctx->inputs[0], td->out, td->in, scale->slice_sws[jobnr],
+                       0, ctx->inputs[0]->h, 1, 0);
+}
+
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
     ScaleContext *scale = link->dst->priv;
     AVFilterLink *outlink = link->dst->outputs[0];
     AVFrame *out;
-    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
+    const AVPixFmtDescriptor *desc;
     char buf[32];
-    int in_range;
+    int in_range, i;
 
     if (av_frame_get_colorspace(in) == AVCOL_SPC_YCGCO)
         av_log(link->dst, AV_LOG_WARNING, "Detected unsupported YCgCo colorspace.\n");
@@ -530,6 +618,8 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     if (!scale->sws)
         return ff_filter_frame(outlink, in);
 
+    /* the input format may just have been changed above */
+    desc = av_pix_fmt_desc_get(link->format);
     scale->hsub = desc->log2_chroma_w;
     scale->vsub = desc->log2_chroma_h;
 
@@ -585,6 +675,10 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
             sws_setColorspaceDetails(scale->isws[1], inv_table, in_full,
                                      table, out_full,
                                      brightness, contrast, saturation);
+        for (i = 0; i < scale->nb_slice_sws; i++)
+            sws_setColorspaceDetails(scale->slice_sws[i], inv_table, in_full,
+                                     table, out_full,
+                                     brightness, contrast, saturation);
 
         av_frame_set_color_range(out, out_full ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG);
     }
@@ -597,8 +691,22 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     if(scale->interlaced>0 || (scale->interlaced<0 && in->interlaced_frame)){
         scale_slice(link, out, in, scale->isws[0], 0, (link->h+1)/2, 2, 0);
         scale_slice(link, out, in, scale->isws[1], 0,  link->h   /2, 2, 1);
+    }else if (scale->nb_slice_sws) {
+        ThreadData td = { .in = in, .out = out };
+        int rets[MAX_SLICE_THREADS];
+
+        link->dst->internal->execute(link->dst, filter_slice, &td, rets,
+                                     scale->nb_slice_sws);
+        for (i = 0; i < scale->nb_slice_sws; i++)
+            if (rets[i] < 0)
+                break;
+        if (i < scale->nb_slice_sws) {
+            av_log(link->dst, AV_LOG_VERBOSE, "Disabling slice threading\n");
+            free_slice_contexts(scale);
+            scale_slice(link, out, in, scale->sws, 0, link->h, 1, 0);
+        }
     }else if (scale->nb_slices) {
-        int i, slice_h, slice_start, slice_end = 0;
+        int slice_h, slice_start, slice_end = 0;
         const int nb_slices = FFMIN(scale->nb_slices, link->h);
         for (i = 0; i < nb_slices; i++) {
             slice_start = slice_end;
@@ -727,6 +835,7 @@ AVFilter ff_vf_scale = {
     .inputs          = avfilter_vf_scale_inputs,
     .outputs         = avfilter_vf_scale_outputs,
     .process_command = process_command,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
 
 static const AVClass scale2ref_class = {
@@ -779,4 +888,5 @@ AVFilter ff_vf_scale2ref = {
     .inputs          = avfilter_vf_scale2ref_inputs,
     .outputs         = avfilter_vf_scale2ref_outputs,
     .process_command = process_command,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -0,0 +1,241 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * video scene change detection filter
+ *
+ * The frames are compared on their first plane, i.e. the luma of YUV
+ * formats, optionally taking only every n-th pixel of every n-th row.
+ */
+
+#include "libavutil/imgutils.h"
+#include "libavutil/internal.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/timestamp.h"
+
+#include "avfilter.h"
+#include "formats.h"
+#include "internal.h"
+#include "scene_sad.h"
+#include "video.h"
+
+enum SCDetMethod {
+    METHOD_SAD,
+    METHOD_HISTOGRAM,
+    NB_METHOD
+};
+
+typedef struct SCDetContext {
+    const AVClass *class;
+
+    double threshold;               ///< score above which a scene change is reported
+    int sc_pass;                    ///< only pass the frames starting a new scene
+    int method;                     ///< scoring method, see enum SCDetMethod
+    int step;                       ///< distance between the compared pixels
+
+    int bytewidth;                  ///< bytes per row of the compared plane
+    ff_scene_sad_fn sad;
+    AVFrame *prev_picref;           ///< previous frame (sad)
+    double prev_mafd;               ///< previous MAFD (sad)
+    uint32_t hist[2][256];          ///< current and previous histograms (histogram)
+    int nb_hist;                    ///< number of histograms computed so far (histogram)
+} SCDetContext;
+
+#define OFFSET(x) offsetof(SCDetContext, x)
+#define V AV_OPT_FLAG_VIDEO_PARAM
+#define F AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption scdet_options[] = {
+    { "threshold", "set the scene change threshold", OFFSET(threshold), AV_OPT_TYPE_DOUBLE, {.dbl = 10.}, 0, 100., V|F },
+    { "t",         "set the scene change threshold", OFFSET(threshold), AV_OPT_TYPE_DOUBLE, {.dbl = 10.}, 0, 100., V|F },
+    { "sc_pass",   "only pass the frames starting a new scene", OFFSET(sc_pass), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, V|F },
+    { "s",         "only pass the frames starting a new scene", OFFSET(sc_pass), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, V|F },
+    { "method",    "set the scoring method", OFFSET(method), AV_OPT_TYPE_INT, {.i64 = METHOD_SAD}, 0, NB_METHOD - 1, V|F, "method" },
+        { "sad",       "mean absolute difference of the pixels", 0, AV_OPT_TYPE_CONST, {.i64 = METHOD_SAD},       INT_MIN, INT_MAX, V|F, "method" },
+        { "histogram", "difference of the histograms",           0, AV_OPT_TYPE_CONST, {.i64 = METHOD_HISTOGRAM}, INT_MIN, INT_MAX, V|F, "method" },
+    { "step",      "compare every n-th pixel of every n-th row", OFFSET(step), AV_OPT_TYPE_INT, {.i64 = 1}, 1, 64, V|F },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(scdet);
+
+static int query_formats(AVFilterContext *ctx)
+{
+    static const enum AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_GRAY8,
+        AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV411P,
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P,
+        AV_PIX_FMT_YUV440P, AV_PIX_FMT_YUV444P,
+        AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_YUVJ422P,
+        AV_PIX_FMT_YUVJ440P, AV_PIX_FMT_YUVJ444P,
+        AV_PIX_FMT_YUVJ411P,
+        AV_PIX_FMT_YUVA420P, AV_PIX_FMT_YUVA422P, AV_PIX_FMT_YUVA444P,
+        AV_PIX_FMT_NV12, AV_PIX_FMT_NV21,
+        AV_PIX_FMT_RGB24, AV_PIX_FMT_BGR24,
+        AV_PIX_FMT_NONE
+    };
+    AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
+
+    if (!fmts_list)
+        return AVERROR(ENOMEM);
+    return ff_set_common_formats(ctx, fmts_list);
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    SCDetContext *s = ctx->priv;
+
+    s->bytewidth = av_image_get_linesize(inlink->format, inlink->w, 0);
+    if (s->bytewidth < 0)
+        return s->bytewidth;
+    s->sad = ff_scene_sad_get_fn();
+
+    av_frame_free(&s->prev_picref);
+    s->prev_mafd = 0;
+    s->nb_hist   = 0;
+
+    return 0;
+}
+
+static double get_sad_score(SCDetContext *s, AVFrame *frame)
+{
+    AVFrame *prev_picref = s->prev_picref;
+    double ret = 0;
+
+    if (prev_picref &&
+        frame->height == prev_picref->height &&
+        frame->width  == prev_picref->width) {
+        const int w = s->bytewidth;
+        const int h = frame->height;
+        const int64_t count = (int64_t)((w + s->step - 1) / s->step) *
+                                       ((h + s->step - 1) / s->step);
+        uint64_t sad;
+        double mafd, diff;
+
+        s->sad(frame->data[0], frame->linesize[0],
+               prev_picref->data[0], prev_picref->linesize[0],
+               w, h, s->step, &sad);
+        /* mean absolute frame difference, in percent of the maximum */
+        mafd = count ? 100. * sad / count / 255. : 0;
+        diff = fabs(mafd - s->prev_mafd);
+        ret  = av_clipd(FFMIN(mafd, diff), 0, 100.);
+        s->prev_mafd = mafd;
+    }
+    av_frame_free(&s->prev_picref);
+    s->prev_picref = av_frame_clone(frame);
+
+    return ret;
+}
+
+static double get_histogram_score(SCDetContext *s, AVFrame *frame)
+{
+    uint32_t *hist = s->hist[s->nb_hist & 1];
+    const uint32_t *prev_hist = s->hist[!(s->nb_hist & 1)];
+    const uint8_t *p = frame->data[0];
+    const int step = s->step;
+    uint64_t count = 0, diff = 0;
+    int x, y;
+
+    memset(hist, 0, sizeof(s->hist[0]));
+    for (y = 0; y < frame->height; y += step) {
+        for (x = 0; x < s->bytewidth; x += step)
+            hist[p[x]]++;
+        p += step * frame->linesize[0];
+    }
+
+    if (!s->nb_hist++)
+        return 0;
+
+    for (x = 0; x < 256; x++) {
+        diff  += FFABS((int64_t)hist[x] - prev_hist[x]);
+        count += hist[x];
+    }
+
+    /* half of the difference is the proportion of pixels which changed bins */
+    return count ? av_clipd(50. * diff / count, 0, 100.) : 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
+{
+    AVFilterContext *ctx = inlink->dst;
+    SCDetContext *s = ctx->priv;
+    AVDictionary **metadata = avpriv_frame_get_metadatap(frame);
+    char buf[64];
+    double score;
+
+    if (s->method == METHOD_HISTOGRAM) {
+        score = get_histogram_score(s, frame);
+    } else {
+        score = get_sad_score(s, frame);
+        snprintf(buf, sizeof(buf), "%0.3f", s->prev_mafd);
+        av_dict_set(metadata, "lavfi.scd.mafd", buf, 0);
+    }
+    snprintf(buf, sizeof(buf), "%0.3f", score);
+    av_dict_set(metadata, "lavfi.scd.score", buf, 0);
+
+    if (score >= s->threshold) {
+        av_log(ctx, AV_LOG_INFO, "lavfi.scd.score: %.3f, lavfi.scd.time: %s\n",
+               score, av_ts2timestr(frame->pts, &inlink->time_base));
+        av_dict_set(metadata, "lavfi.scd.time",
+                    av_ts2timestr(frame->pts, &inlink->time_base), 0);
+    } else if (s->sc_pass) {
+        av_frame_free(&frame);
+        return 0;
+    }
+
+    return ff_filter_frame(ctx->outputs[0], frame);
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    SCDetContext *s = ctx->priv;
+
+    av_frame_free(&s->prev_picref);
+}
+
+static const AVFilterPad scdet_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .filter_frame = filter_frame,
+        .config_props = config_input,
+    },
+    { NULL }
+};
+
+static const AVFilterPad scdet_outputs[] = {
+    {
+        .name = "default",
+        .type = AVMEDIA_TYPE_VIDEO,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_scdet = {
+    .name          = "scdet",
+    .description   = NULL_IF_CONFIG_SMALL("Detect video scene changes."),
+    .priv_size     = sizeof(SCDetContext),
+    .priv_class    = &scdet_class,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .inputs        = scdet_inputs,
+    .outputs       = scdet_outputs,
+};
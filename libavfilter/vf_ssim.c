@@ -42,6 +42,7 @@
 #include "drawutils.h"
 #include "formats.h"
 #include "internal.h"
+#include "psnr.h"
 #include "ssim.h"
 #include "video.h"
 
@@ -59,16 +60,34 @@ typedef struct SSIMContext {
     int planewidth[4];
     int planeheight[4];
     int *temp;
+    int temp_size;              ///< per-thread size of temp, in ints
+    float *row_ssim[4];         ///< per-row SSIM sums, reduced once per frame
     int is_rgb;
+    int nb_threads;
     SSIMDSPContext dsp;
+
+    int psnr;
+    PSNRDSPContext psnr_dsp;
+    uint64_t (*score)[4];       ///< per-slice sums of squared errors
+    double mse, mse_comp[4];
+    double planeweight[4];
+    int max[4], average_max;
 } SSIMContext;
 
+typedef struct ThreadData {
+    uint8_t *main_data[4];
+    int main_linesize[4];
+    uint8_t *ref_data[4];
+    int ref_linesize[4];
+} ThreadData;
+
 #define OFFSET(x) offsetof(SSIMContext, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
 
 static const AVOption ssim_options[] = {
     {"stats_file", "Set file where to store per-frame difference information", OFFSET(stats_file_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
     {"f",          "Set file where to store per-frame difference information", OFFSET(stats_file_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    {"psnr",       "Also calculate the PSNR in the same pass", OFFSET(psnr), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS },
     { NULL }
 };
 
@@ -147,20 +166,25 @@ static float ssim_endn(const int (*sum0)[4], const int (*sum1)[4], int width)
     return ssim;
 }
 
-static float ssim_plane(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp)
+/* Each slice recomputes the block sums of the row above its first one, so
+ * that the slices are independent. */
+static void ssim_plane_slice(SSIMDSPContext *dsp,
+                             uint8_t *main, int main_stride,
+                             uint8_t *ref, int ref_stride,
+                             int width, int height, void *temp,
+                             float *row_ssim, int jobnr, int nb_jobs)
 {
-    int z = 0, y;
-    float ssim = 0.0;
     int (*sum0)[4] = temp;
     int (*sum1)[4] = sum0 + (width >> 2) + 3;
+    int z, y, slice_start, slice_end;
 
     width >>= 2;
     height >>= 2;
 
-    for (y = 1; y < height; y++) {
+    slice_start = 1 + ((height - 1) *  jobnr     ) / nb_jobs;
+    slice_end   = 1 + ((height - 1) * (jobnr + 1)) / nb_jobs;
+
+    for (z = slice_start - 1, y = slice_start; y < slice_end; y++) {
         for (; z <= y; z++) {
             FFSWAP(void*, sum0, sum1);
             dsp->ssim_4x4_line(&main[4 * z * main_stride], main_stride,
@@ -168,34 +192,113 @@ static float ssim_plane(SSIMDSPContext *dsp,
                                sum0, width);
         }
 
-        ssim += dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
+        row_ssim[y - 1] = dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
     }
+}
+
+static float ssim_plane(const float *row_ssim, int width, int height)
+{
+    float ssim = 0.0;
+    int y;
+
+    width >>= 2;
+    height >>= 2;
+
+    /* accumulate in line order so that the result does not depend on
+     * the number of slices */
+    for (y = 1; y < height; y++)
+        ssim += row_ssim[y - 1];
 
     return ssim / ((height - 1) * (width - 1));
 }
 
+static int ssim_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    SSIMContext *s = ctx->priv;
+    ThreadData *td = arg;
+    int i;
+
+    for (i = 0; i < s->nb_components; i++) {
+        ssim_plane_slice(&s->dsp, td->main_data[i], td->main_linesize[i],
+                         td->ref_data[i], td->ref_linesize[i],
+                         s->planewidth[i], s->planeheight[i],
+                         s->temp + jobnr * s->temp_size,
+                         s->row_ssim[i], jobnr, nb_jobs);
+
+        if (s->psnr) {
+            const int slice_start = (s->planeheight[i] *  jobnr     ) / nb_jobs;
+            const int slice_end   = (s->planeheight[i] * (jobnr + 1)) / nb_jobs;
+
+            s->score[jobnr][i] =
+                ff_psnr_sse_plane(&s->psnr_dsp,
+                                  td->main_data[i] + slice_start * td->main_linesize[i],
+                                  td->main_linesize[i],
+                                  td->ref_data[i] + slice_start * td->ref_linesize[i],
+                                  td->ref_linesize[i],
+                                  s->planewidth[i], slice_end - slice_start);
+        }
+    }
+
+    return 0;
+}
+
 static double ssim_db(double ssim, double weight)
 {
     return 10 * log10(weight / (weight - ssim));
 }
 
+static double get_psnr(double mse, uint64_t nb_frames, int max)
+{
+    return 10.0 * log10((double)max * max / (mse / nb_frames));
+}
+
 static AVFrame *do_ssim(AVFilterContext *ctx, AVFrame *main,
                         const AVFrame *ref)
 {
     AVDictionary **metadata = avpriv_frame_get_metadatap(main);
     SSIMContext *s = ctx->priv;
     float c[4], ssimv = 0.0;
-    int i;
+    double comp_mse[4], mse = 0;
+    ThreadData td;
+    int i, j;
 
     s->nb_frames++;
 
     for (i = 0; i < s->nb_components; i++) {
-        c[i] = ssim_plane(&s->dsp, main->data[i], main->linesize[i],
-                          ref->data[i], ref->linesize[i],
-                          s->planewidth[i], s->planeheight[i], s->temp);
+        td.main_data[i]     = main->data[i];
+        td.main_linesize[i] = main->linesize[i];
+        td.ref_data[i]      = ref->data[i];
+        td.ref_linesize[i]  = ref->linesize[i];
+    }
+    ctx->internal->execute(ctx, ssim_slice, &td, NULL, s->nb_threads);
+
+    for (i = 0; i < s->nb_components; i++) {
+        c[i] = ssim_plane(s->row_ssim[i], s->planewidth[i], s->planeheight[i]);
         ssimv += s->coefs[i] * c[i];
         s->ssim[i] += c[i];
     }
+
+    if (s->psnr) {
+        for (i = 0; i < s->nb_components; i++) {
+            uint64_t m = 0;
+
+            for (j = 0; j < s->nb_threads; j++)
+                m += s->score[j][i];
+            comp_mse[i] = m / (double)(s->planewidth[i] * s->planeheight[i]);
+            mse += comp_mse[i] * s->planeweight[i];
+            s->mse_comp[i] += comp_mse[i];
+        }
+        s->mse += mse;
+
+        for (i = 0; i < s->nb_components; i++) {
+            int cidx = s->is_rgb ? s->rgba_map[i] : i;
+            char comp = av_tolower(s->comps[i]);
+            set_meta(metadata, "lavfi.psnr.mse.", comp, comp_mse[cidx]);
+            set_meta(metadata, "lavfi.psnr.psnr.", comp, get_psnr(comp_mse[cidx], 1, s->max[cidx]));
+        }
+        set_meta(metadata, "lavfi.psnr.mse_avg", 0, mse);
+        set_meta(metadata, "lavfi.psnr.psnr_avg", 0, get_psnr(mse, 1, s->average_max));
+    }
     for (i = 0; i < s->nb_components; i++) {
         int cidx = s->is_rgb ? s->rgba_map[i] : i;
         set_meta(metadata, "lavfi.ssim.", s->comps[i], c[cidx]);
@@ -213,7 +316,17 @@ static AVFrame *do_ssim(AVFilterContext *ctx, AVFrame *main,
             fprintf(s->stats_file, "%c:%f ", s->comps[i], c[cidx]);
         }
 
-        fprintf(s->stats_file, "All:%f (%f)\n", ssimv, ssim_db(ssimv, 1.0));
+        fprintf(s->stats_file, "All:%f (%f)", ssimv, ssim_db(ssimv, 1.0));
+
+        if (s->psnr) {
+            for (i = 0; i < s->nb_components; i++) {
+                int cidx = s->is_rgb ? s->rgba_map[i] : i;
+                fprintf(s->stats_file, " psnr_%c:%0.2f", av_tolower(s->comps[i]),
+                        get_psnr(comp_mse[cidx], 1, s->max[cidx]));
+            }
+            fprintf(s->stats_file, " psnr_avg:%0.2f", get_psnr(mse, 1, s->average_max));
+        }
+        fprintf(s->stats_file, "\n");
     }
 
     return main;
@@ -294,18 +407,43 @@ static int config_input_ref(AVFilterLink *inlink)
     s->planewidth[0]  = s->planewidth[3]  = inlink->w;
     for (i = 0; i < s->nb_components; i++)
         sum += s->planeheight[i] * s->planewidth[i];
-    for (i = 0; i < s->nb_components; i++)
-        s->coefs[i] = (double) s->planeheight[i] * s->planewidth[i] / sum;
+    for (i = 0; i < s->nb_components; i++) {
+        s->planeweight[i] = (double) s->planeheight[i] * s->planewidth[i] / sum;
+        s->coefs[i] = s->planeweight[i];
+    }
 
-    s->temp = av_malloc((2 * inlink->w + 12) * sizeof(*s->temp));
+    s->nb_threads = FFMAX(1, FFMIN(ctx->graph->nb_threads, s->planeheight[1] >> 2));
+
+    s->temp_size = 2 * inlink->w + 12;
+    s->temp = av_malloc_array(s->nb_threads, s->temp_size * sizeof(*s->temp));
     if (!s->temp)
         return AVERROR(ENOMEM);
 
+    s->row_ssim[0] = av_malloc_array(s->nb_components * ((inlink->h >> 2) + 1), sizeof(*s->row_ssim[0]));
+    if (!s->row_ssim[0])
+        return AVERROR(ENOMEM);
+    for (i = 1; i < s->nb_components; i++)
+        s->row_ssim[i] = s->row_ssim[i - 1] + (s->planeheight[i - 1] >> 2);
+
     s->dsp.ssim_4x4_line = ssim_4x4xn;
     s->dsp.ssim_end_line = ssim_endn;
     if (ARCH_X86)
         ff_ssim_init_x86(&s->dsp);
 
+    if (s->psnr) {
+        s->average_max = 0;
+        for (i = 0; i < s->nb_components; i++) {
+            s->max[i] = (1 << desc->comp[i].depth) - 1;
+            s->average_max += s->max[i] * s->planeweight[i];
+        }
+
+        s->score = av_calloc(s->nb_threads, sizeof(*s->score));
+        if (!s->score)
+            return AVERROR(ENOMEM);
+
+        ff_psnr_init(&s->psnr_dsp, desc->comp[0].depth);
+    }
+
     return 0;
 }
 
@@ -355,6 +493,17 @@ static av_cold void uninit(AVFilterContext *ctx)
         }
         av_log(ctx, AV_LOG_INFO, "SSIM%s All:%f (%f)\n", buf,
                s->ssim_total / s->nb_frames, ssim_db(s->ssim_total, s->nb_frames));
+
+        if (s->psnr) {
+            buf[0] = 0;
+            for (i = 0; i < s->nb_components; i++) {
+                int c = s->is_rgb ? s->rgba_map[i] : i;
+                av_strlcatf(buf, sizeof(buf), " %c:%f", av_tolower(s->comps[i]),
+                            get_psnr(s->mse_comp[c], s->nb_frames, s->max[c]));
+            }
+            av_log(ctx, AV_LOG_INFO, "PSNR%s average:%f\n", buf,
+                   get_psnr(s->mse, s->nb_frames, s->average_max));
+        }
     }
 
     ff_dualinput_uninit(&s->dinput);
@@ -363,6 +512,8 @@ static av_cold void uninit(AVFilterContext *ctx)
         fclose(s->stats_file);
 
     av_freep(&s->temp);
+    av_freep(&s->row_ssim[0]);
+    av_freep(&s->score);
 }
 
 static const AVFilterPad ssim_inputs[] = {
@@ -399,4 +550,5 @@ AVFilter ff_vf_ssim = {
     .priv_class    = &ssim_class,
     .inputs        = ssim_inputs,
     .outputs       = ssim_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -29,6 +29,9 @@
 #include "framesync.h"
 #include "video.h"
 
+/* number of output frames the inputs can render into ahead of each other */
+#define MAX_COMPOSITES 4
+
 typedef struct StackContext {
     const AVClass *class;
     const AVPixFmtDescriptor *desc;
@@ -37,6 +40,19 @@ typedef struct StackContext {
     int is_vertical;
     int nb_planes;
 
+    /* position of each input in the output, in bytes and rows per plane */
+    int (*x_offset)[4];
+    int (*y_offset)[4];
+
+    /* Direct rendering: the inputs get windows into the next output frames
+     * from get_video_buffer(), and the frame is sent without copying when
+     * all the inputs rendered in place. */
+    int dr;
+    AVFrame *composites[MAX_COMPOSITES];
+    int composite_users[MAX_COMPOSITES];
+    int nb_composites;
+    int *next_composite;
+
     AVFrame **frames;
     FFFrameSync fs;
 } StackContext;
@@ -64,6 +80,88 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     return ff_framesync_filter_frame(&s->fs, inlink, in);
 }
 
+static void free_composites(StackContext *s)
+{
+    int i;
+
+    for (i = 0; i < s->nb_composites; i++)
+        av_frame_free(&s->composites[i]);
+    s->nb_composites = 0;
+}
+
+static AVFrame *get_video_buffer(AVFilterLink *inlink, int w, int h)
+{
+    AVFilterContext *ctx  = inlink->dst;
+    AVFilterLink *outlink = ctx->outputs[0];
+    StackContext *s = ctx->priv;
+    int i = FF_INLINK_IDX(inlink);
+    ptrdiff_t offsets[4] = { 0 };
+    AVFrame *frame;
+    int n, p;
+
+    n = s->dr ? s->next_composite[i] : MAX_COMPOSITES;
+    if (w != inlink->w || h != inlink->h || n >= MAX_COMPOSITES)
+        return ff_default_get_video_buffer(inlink, w, h);
+
+    if (n == s->nb_composites) {
+        s->composites[n] = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!s->composites[n])
+            return NULL;
+        s->composite_users[n] = 0;
+        s->nb_composites++;
+    }
+
+    for (p = 0; p < s->nb_planes; p++)
+        offsets[p] = s->x_offset[i][p] +
+                     (ptrdiff_t)s->y_offset[i][p] * s->composites[n]->linesize[p];
+    if (!(frame = ff_video_frame_window(s->composites[n], w, h, offsets)))
+        return NULL;
+
+    s->next_composite[i]++;
+    s->composite_users[n]++;
+    /* the inputs hold references to the frames they all got a window in */
+    while (s->nb_composites && s->composite_users[0] == s->nb_inputs) {
+        av_frame_free(&s->composites[0]);
+        s->nb_composites--;
+        memmove(s->composites, s->composites + 1,
+                s->nb_composites * sizeof(*s->composites));
+        memmove(s->composite_users, s->composite_users + 1,
+                s->nb_composites * sizeof(*s->composite_users));
+        for (i = 0; i < s->nb_inputs; i++)
+            s->next_composite[i]--;
+    }
+
+    return frame;
+}
+
+/**
+ * Return the output frame if the inputs are the areas of a single frame,
+ * as happens when they were rendered in the windows from get_video_buffer(),
+ * NULL otherwise.
+ */
+static AVFrame *get_composite(StackContext *s, AVFilterLink *outlink,
+                              AVFrame **in)
+{
+    static const ptrdiff_t offsets[4] = { 0 };
+    int i, p;
+
+    for (i = 1; i < s->nb_inputs; i++) {
+        for (p = 0; p < s->nb_planes; p++) {
+            AVBufferRef *buf0 = av_frame_get_plane_buffer(in[0], p);
+            AVBufferRef *buf  = av_frame_get_plane_buffer(in[i], p);
+            ptrdiff_t offset  = s->x_offset[i][p] +
+                                (ptrdiff_t)s->y_offset[i][p] * in[0]->linesize[p];
+
+            if (!buf0 || !buf || buf->buffer != buf0->buffer ||
+                in[i]->linesize[p] != in[0]->linesize[p] ||
+                in[i]->data[p] != in[0]->data[p] + offset)
+                return NULL;
+        }
+    }
+
+    return ff_video_frame_window(in[0], outlink->w, outlink->h, offsets);
+}
+
 static av_cold int init(AVFilterContext *ctx)
 {
     StackContext *s = ctx->priv;
@@ -84,6 +182,7 @@ static av_cold int init(AVFilterContext *ctx)
         if (!pad.name)
             return AVERROR(ENOMEM);
         pad.filter_frame = filter_frame;
+        pad.get_video_buffer = get_video_buffer;
 
         if ((ret = ff_insert_inpad(ctx, i, &pad)) < 0) {
             av_freep(&pad.name);
@@ -108,6 +207,18 @@ static int process_frame(FFFrameSync *fs)
             return ret;
     }
 
+    if (s->dr && (out = get_composite(s, outlink, in))) {
+        out->pts = av_rescale_q(s->fs.pts, s->fs.time_base, outlink->time_base);
+        return ff_filter_frame(outlink, out);
+    }
+    if (s->dr) {
+        /* the frames do not come back in the order the windows were handed
+         * out, or do not come from them at all */
+        av_log(ctx, AV_LOG_VERBOSE, "Inputs not rendered in place, copying them.\n");
+        s->dr = 0;
+        free_composites(s);
+    }
+
     out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
     if (!out)
         return AVERROR(ENOMEM);
@@ -182,6 +293,38 @@ static int config_output(AVFilterLink *outlink)
         return AVERROR_BUG;
     s->nb_planes = av_pix_fmt_count_planes(outlink->format);
 
+    free_composites(s);
+    av_freep(&s->x_offset);
+    av_freep(&s->y_offset);
+    av_freep(&s->next_composite);
+    s->x_offset       = av_calloc(s->nb_inputs, sizeof(*s->x_offset));
+    s->y_offset       = av_calloc(s->nb_inputs, sizeof(*s->y_offset));
+    s->next_composite = av_calloc(s->nb_inputs, sizeof(*s->next_composite));
+    if (!s->x_offset || !s->y_offset || !s->next_composite)
+        return AVERROR(ENOMEM);
+
+    /* the windows are only handed out when they stay aligned for SIMD */
+    s->dr = 1;
+    for (i = 1; i < s->nb_inputs; i++) {
+        AVFilterLink *prev = ctx->inputs[i - 1];
+        int p, linesize[4];
+
+        if ((ret = av_image_fill_linesizes(linesize, prev->format, prev->w)) < 0)
+            return ret;
+        for (p = 0; p < s->nb_planes; p++) {
+            int vsub = p == 1 || p == 2 ? s->desc->log2_chroma_h : 0;
+
+            s->x_offset[i][p] = s->x_offset[i - 1][p];
+            s->y_offset[i][p] = s->y_offset[i - 1][p];
+            if (s->is_vertical)
+                s->y_offset[i][p] += AV_CEIL_RSHIFT(prev->h, vsub);
+            else
+                s->x_offset[i][p] += linesize[p];
+            if (s->x_offset[i][p] % 32)
+                s->dr = 0;
+        }
+    }
+
     outlink->w          = width;
     outlink->h          = height;
     outlink->time_base  = time_base;
@@ -219,6 +362,10 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     ff_framesync_uninit(&s->fs);
     av_freep(&s->frames);
+    free_composites(s);
+    av_freep(&s->x_offset);
+    av_freep(&s->y_offset);
+    av_freep(&s->next_composite);
 
     for (i = 0; i < ctx->nb_inputs; i++)
         av_freep(&ctx->input_pads[i].name);
@@ -30,6 +30,7 @@
 #include "libavutil/opt.h"
 #include "avfilter.h"
 #include "internal.h"
+#include "video.h"
 
 #define HIST_SIZE (3*256)
 
@@ -44,13 +45,21 @@ typedef struct {
     int n_frames;               ///< number of frames for analysis
     struct thumb_frame *frames; ///< the n_frames frames
     AVRational tb;              ///< copy of the input timebase to ease access
+    int downscale;              ///< factor by which the frames are reduced before being kept
+    int nb_threads;
+    int *thread_hist;           ///< per-thread histograms of the current frame
 } ThumbContext;
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
 #define OFFSET(x) offsetof(ThumbContext, x)
 #define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
 
 static const AVOption thumbnail_options[] = {
     { "n", "set the frames batch size", OFFSET(n_frames), AV_OPT_TYPE_INT, {.i64=100}, 2, INT_MAX, FLAGS },
+    { "downscale", "set the factor by which the analyzed and selected frames are downscaled", OFFSET(downscale), AV_OPT_TYPE_INT, {.i64=1}, 1, 64, FLAGS },
     { NULL }
 };
 
@@ -128,28 +137,90 @@ static AVFrame *get_best_frame(AVFilterContext *ctx)
     return picref;
 }
 
+/**
+ * Compute the RGB histogram of a slice of the kept frame, after averaging
+ * it from the blocks of the input frame if it is downscaled.
+ */
+static int compute_histogram(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ThumbContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    const AVFrame *in = td->in;
+    AVFrame *out = td->out;
+    const int f = s->downscale;
+    const int slice_start = (out->height *  jobnr   ) / nb_jobs;
+    const int slice_end   = (out->height * (jobnr+1)) / nb_jobs;
+    int *hist = s->thread_hist + jobnr * HIST_SIZE;
+    int i, j, x, y, c;
+
+    memset(hist, 0, HIST_SIZE * sizeof(*hist));
+
+    for (j = slice_start; j < slice_end; j++) {
+        uint8_t *p = out->data[0] + j * out->linesize[0];
+
+        if (f > 1) {
+            const int y0 = j * f, y1 = FFMIN(y0 + f, in->height);
+
+            for (i = 0; i < out->width; i++) {
+                const int x0 = i * f, x1 = FFMIN(x0 + f, in->width);
+                const int n = (x1 - x0) * (y1 - y0);
+                int sum[3] = { 0 };
+
+                for (y = y0; y < y1; y++) {
+                    const uint8_t *src = in->data[0] + y * in->linesize[0];
+                    for (x = x0; x < x1; x++)
+                        for (c = 0; c < 3; c++)
+                            sum[c] += src[x*3 + c];
+                }
+                for (c = 0; c < 3; c++)
+                    p[i*3 + c] = (sum[c] + n / 2) / n;
+            }
+        }
+
+        for (i = 0; i < out->width; i++) {
+            hist[0*256 + p[i*3    ]]++;
+            hist[1*256 + p[i*3 + 1]]++;
+            hist[2*256 + p[i*3 + 2]]++;
+        }
+    }
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
-    int i, j;
+    int i, j, nb_jobs;
     AVFilterContext *ctx  = inlink->dst;
     ThumbContext *s   = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
     int *hist = s->frames[s->n].histogram;
-    const uint8_t *p = frame->data[0];
-
-    // keep a reference of each frame
-    s->frames[s->n].buf = frame;
-
-    // update current frame RGB histogram
-    for (j = 0; j < inlink->h; j++) {
-        for (i = 0; i < inlink->w; i++) {
-            hist[0*256 + p[i*3    ]]++;
-            hist[1*256 + p[i*3 + 1]]++;
-            hist[2*256 + p[i*3 + 2]]++;
+    AVFrame *out = frame;
+    ThreadData td;
+
+    // only keep the downscaled frame
+    if (s->downscale > 1) {
+        out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!out) {
+            av_frame_free(&frame);
+            return AVERROR(ENOMEM);
         }
-        p += frame->linesize[0];
+        av_frame_copy_props(out, frame);
     }
 
+    // update current frame RGB histogram
+    td.in  = frame;
+    td.out = out;
+    nb_jobs = FFMIN(outlink->h, s->nb_threads);
+    ctx->internal->execute(ctx, compute_histogram, &td, NULL, nb_jobs);
+    for (j = 0; j < nb_jobs; j++)
+        for (i = 0; i < HIST_SIZE; i++)
+            hist[i] += s->thread_hist[j * HIST_SIZE + i];
+
+    if (out != frame)
+        av_frame_free(&frame);
+
+    // keep a reference of each frame
+    s->frames[s->n].buf = out;
+
     // no selection until the buffer of N frames is filled up
     s->n++;
     if (s->n < s->n_frames)
@@ -165,6 +236,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     for (i = 0; i < s->n_frames && s->frames[i].buf; i++)
         av_frame_free(&s->frames[i].buf);
     av_freep(&s->frames);
+    av_freep(&s->thread_hist);
 }
 
 static int request_frame(AVFilterLink *link)
@@ -190,6 +262,23 @@ static int config_props(AVFilterLink *inlink)
     ThumbContext *s = ctx->priv;
 
     s->tb = inlink->time_base;
+
+    s->nb_threads = FFMAX(1, ctx->graph->nb_threads);
+    av_freep(&s->thread_hist);
+    s->thread_hist = av_malloc_array(s->nb_threads, HIST_SIZE * sizeof(*s->thread_hist));
+    if (!s->thread_hist)
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink = ctx->inputs[0];
+    ThumbContext *s = ctx->priv;
+
+    outlink->w = (inlink->w + s->downscale - 1) / s->downscale;
+    outlink->h = (inlink->h + s->downscale - 1) / s->downscale;
     return 0;
 }
 
@@ -219,6 +308,7 @@ static const AVFilterPad thumbnail_outputs[] = {
     {
         .name          = "default",
         .type          = AVMEDIA_TYPE_VIDEO,
+        .config_props  = config_output,
         .request_frame = request_frame,
     },
     { NULL }
@@ -234,4 +324,5 @@ AVFilter ff_vf_thumbnail = {
     .inputs        = thumbnail_inputs,
     .outputs       = thumbnail_outputs,
     .priv_class    = &thumbnail_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
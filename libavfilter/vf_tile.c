@@ -31,6 +31,9 @@
 #include "video.h"
 #include "internal.h"
 
+/* number of output frames the input can render into ahead of the filter */
+#define MAX_COMPOSITES 4
+
 typedef struct {
     const AVClass *class;
     unsigned w, h;
@@ -42,6 +45,14 @@ typedef struct {
     FFDrawColor blank;
     AVFrame *out_ref;
     uint8_t rgba_color[4];
+
+    /* Direct rendering: the input gets windows into the frames being
+     * assembled from get_video_buffer(), and the tiles rendered in place
+     * are not copied. */
+    int dr;
+    unsigned pending;   /*< windows handed out and not received yet */
+    AVFrame *composites[MAX_COMPOSITES]; /*< output frames after out_ref */
+    int nb_composites;
 } TileContext;
 
 #define REASONABLE_SIZE 1024
@@ -97,6 +108,7 @@ static int config_props(AVFilterLink *outlink)
     AVFilterLink *inlink = ctx->inputs[0];
     const unsigned total_margin_w = (tile->w - 1) * tile->padding + 2*tile->margin;
     const unsigned total_margin_h = (tile->h - 1) * tile->padding + 2*tile->margin;
+    int p;
 
     if (inlink->w > (INT_MAX - total_margin_w) / tile->w) {
         av_log(ctx, AV_LOG_ERROR, "Total width %ux%u is too much.\n",
@@ -116,20 +128,164 @@ static int config_props(AVFilterLink *outlink)
     ff_draw_init(&tile->draw, inlink->format, 0);
     ff_draw_color(&tile->draw, &tile->blank, tile->rgba_color);
 
+    /* the windows are only handed out when they stay aligned for SIMD and
+     * overwriting the end of their lines does not spill on the padding */
+    tile->dr = 1;
+    for (p = 0; p < tile->draw.nb_planes; p++) {
+        const unsigned sizes[3] = { tile->margin, tile->padding, inlink->w };
+        int i;
+
+        for (i = 0; i < FF_ARRAY_ELEMS(sizes); i++)
+            if (sizes[i] & ((1 << tile->draw.hsub_max) - 1) ||
+                ((sizes[i] >> tile->draw.hsub[p]) * tile->draw.pixelstep[p]) % 32)
+                tile->dr = 0;
+    }
+    if ((tile->margin | tile->padding | inlink->h) & ((1 << tile->draw.vsub_max) - 1))
+        tile->dr = 0;
+
     return 0;
 }
 
-static void get_current_tile_pos(AVFilterContext *ctx, unsigned *x, unsigned *y)
+static void get_tile_pos(AVFilterContext *ctx, unsigned current,
+                         unsigned *x, unsigned *y)
 {
     TileContext *tile    = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
-    const unsigned tx = tile->current % tile->w;
-    const unsigned ty = tile->current / tile->w;
+    const unsigned tx = current % tile->w;
+    const unsigned ty = current / tile->w;
 
     *x = tile->margin + (inlink->w + tile->padding) * tx;
     *y = tile->margin + (inlink->h + tile->padding) * ty;
 }
 
+static void get_current_tile_pos(AVFilterContext *ctx, unsigned *x, unsigned *y)
+{
+    TileContext *tile = ctx->priv;
+
+    get_tile_pos(ctx, tile->current, x, y);
+}
+
+static void get_tile_offsets(TileContext *tile, const AVFrame *frame,
+                             unsigned x, unsigned y, ptrdiff_t offsets[4])
+{
+    int p;
+
+    for (p = 0; p < tile->draw.nb_planes; p++)
+        offsets[p] = (x >> tile->draw.hsub[p]) * tile->draw.pixelstep[p] +
+                     (ptrdiff_t)(y >> tile->draw.vsub[p]) * frame->linesize[p];
+}
+
+static AVFrame *alloc_out_frame(AVFilterContext *ctx)
+{
+    TileContext *tile     = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    AVFrame *out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+
+    if (!out)
+        return NULL;
+    /* fill surface once for margin/padding */
+    if (tile->margin || tile->padding)
+        ff_fill_rectangle(&tile->draw, &tile->blank, out->data, out->linesize,
+                          0, 0, outlink->w, outlink->h);
+    return out;
+}
+
+static void free_composites(TileContext *tile)
+{
+    int i;
+
+    for (i = 0; i < tile->nb_composites; i++)
+        av_frame_free(&tile->composites[i]);
+    tile->nb_composites = 0;
+}
+
+static AVFrame *get_video_buffer(AVFilterLink *inlink, int w, int h)
+{
+    AVFilterContext *ctx = inlink->dst;
+    TileContext *tile    = ctx->priv;
+    const unsigned next  = tile->current + tile->pending;
+    int n = next / tile->nb_frames - !!tile->current;
+    ptrdiff_t offsets[4] = { 0 };
+    AVFrame *composite, *frame;
+    unsigned x, y;
+
+    if (!tile->dr || w != inlink->w || h != inlink->h)
+        return ff_default_get_video_buffer(inlink, w, h);
+    if (n >= MAX_COMPOSITES) {
+        /* this frame would take the place of the next window */
+        tile->dr = 0;
+        return ff_default_get_video_buffer(inlink, w, h);
+    }
+
+    if (n == tile->nb_composites) {
+        if (!(tile->composites[n] = alloc_out_frame(ctx)))
+            return NULL;
+        tile->nb_composites++;
+    }
+    composite = n < 0 ? tile->out_ref : tile->composites[n];
+
+    get_tile_pos(ctx, next % tile->nb_frames, &x, &y);
+    get_tile_offsets(tile, composite, x, y, offsets);
+    if (!(frame = ff_video_frame_window(composite, w, h, offsets)))
+        return NULL;
+    tile->pending++;
+
+    return frame;
+}
+
+/**
+ * Check if the frame was rendered in the window of the current tile.
+ */
+static int is_in_place(AVFilterContext *ctx, AVFrame *frame)
+{
+    TileContext *tile = ctx->priv;
+    ptrdiff_t offsets[4];
+    unsigned x, y;
+    int p;
+
+    get_current_tile_pos(ctx, &x, &y);
+    get_tile_offsets(tile, tile->out_ref, x, y, offsets);
+    for (p = 0; p < tile->draw.nb_planes; p++) {
+        AVBufferRef *buf     = av_frame_get_plane_buffer(frame, p);
+        AVBufferRef *out_buf = av_frame_get_plane_buffer(tile->out_ref, p);
+
+        if (!buf || !out_buf || buf->buffer != out_buf->buffer ||
+            frame->linesize[p] != tile->out_ref->linesize[p] ||
+            frame->data[p] != tile->out_ref->data[p] + offsets[p])
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * Stop direct rendering: the windows still handed out keep their buffers,
+ * and the frame being assembled is moved to a buffer of its own so that
+ * the frames rendered in them can be copied at their actual place.
+ */
+static int stop_direct_rendering(AVFilterContext *ctx)
+{
+    TileContext *tile = ctx->priv;
+    AVFrame *out;
+    int ret;
+
+    av_log(ctx, AV_LOG_VERBOSE, "Input not rendered in place, copying it.\n");
+    tile->dr      = 0;
+    tile->pending = 0;
+    free_composites(tile);
+
+    if (!(out = ff_get_video_buffer(ctx->outputs[0], tile->out_ref->width,
+                                    tile->out_ref->height)))
+        return AVERROR(ENOMEM);
+    if ((ret = av_frame_copy(out, tile->out_ref)) < 0 ||
+        (ret = av_frame_copy_props(out, tile->out_ref)) < 0) {
+        av_frame_free(&out);
+        return ret;
+    }
+    av_frame_free(&tile->out_ref);
+    tile->out_ref = out;
+    return 0;
+}
+
 static void draw_blank_frame(AVFilterContext *ctx, AVFrame *out_buf)
 {
     TileContext *tile    = ctx->priv;
@@ -152,13 +308,14 @@ static int end_last_frame(AVFilterContext *ctx)
     while (tile->current < tile->nb_frames)
         draw_blank_frame(ctx, out_buf);
     ret = ff_filter_frame(outlink, out_buf);
+    tile->out_ref = NULL;
     tile->current = 0;
     return ret;
 }
 
-/* Note: direct rendering is not possible since there is no guarantee that
- * buffers are fed to filter_frame in the order they were obtained from
- * get_buffer (think B-frames). */
+/* Note: there is no guarantee that buffers are fed to filter_frame in the
+ * order they were obtained from get_buffer (think B-frames), so direct
+ * rendering stops as soon as a frame is not found at its place. */
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
 {
@@ -166,9 +323,17 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     TileContext *tile     = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
     unsigned x0, y0;
+    int ret;
 
     if (!tile->current) {
-        tile->out_ref = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (tile->nb_composites) {
+            tile->out_ref = tile->composites[0];
+            tile->nb_composites--;
+            memmove(tile->composites, tile->composites + 1,
+                    tile->nb_composites * sizeof(*tile->composites));
+        } else {
+            tile->out_ref = alloc_out_frame(ctx);
+        }
         if (!tile->out_ref) {
             av_frame_free(&picref);
             return AVERROR(ENOMEM);
@@ -176,20 +341,21 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
         av_frame_copy_props(tile->out_ref, picref);
         tile->out_ref->width  = outlink->w;
         tile->out_ref->height = outlink->h;
-
-        /* fill surface once for margin/padding */
-        if (tile->margin || tile->padding)
-            ff_fill_rectangle(&tile->draw, &tile->blank,
-                              tile->out_ref->data,
-                              tile->out_ref->linesize,
-                              0, 0, outlink->w, outlink->h);
     }
 
-    get_current_tile_pos(ctx, &x0, &y0);
-    ff_copy_rectangle2(&tile->draw,
-                       tile->out_ref->data, tile->out_ref->linesize,
-                       picref->data, picref->linesize,
-                       x0, y0, 0, 0, inlink->w, inlink->h);
+    if (is_in_place(ctx, picref)) {
+        tile->pending--;
+    } else {
+        if (tile->pending && (ret = stop_direct_rendering(ctx)) < 0) {
+            av_frame_free(&picref);
+            return ret;
+        }
+        get_current_tile_pos(ctx, &x0, &y0);
+        ff_copy_rectangle2(&tile->draw,
+                           tile->out_ref->data, tile->out_ref->linesize,
+                           picref->data, picref->linesize,
+                           x0, y0, 0, 0, inlink->w, inlink->h);
+    }
 
     av_frame_free(&picref);
     if (++tile->current == tile->nb_frames)
@@ -211,11 +377,20 @@ static int request_frame(AVFilterLink *outlink)
     return r;
 }
 
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    TileContext *tile = ctx->priv;
+
+    free_composites(tile);
+    av_frame_free(&tile->out_ref);
+}
+
 static const AVFilterPad tile_inputs[] = {
     {
-        .name         = "default",
-        .type         = AVMEDIA_TYPE_VIDEO,
-        .filter_frame = filter_frame,
+        .name             = "default",
+        .type             = AVMEDIA_TYPE_VIDEO,
+        .get_video_buffer = get_video_buffer,
+        .filter_frame     = filter_frame,
     },
     { NULL }
 };
@@ -234,6 +409,7 @@ AVFilter ff_vf_tile = {
     .name          = "tile",
     .description   = NULL_IF_CONFIG_SMALL("Tile several successive frames together."),
     .init          = init,
+    .uninit        = uninit,
     .query_formats = query_formats,
     .priv_size     = sizeof(TileContext),
     .inputs        = tile_inputs,
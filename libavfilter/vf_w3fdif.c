@@ -156,6 +156,18 @@ static void filter_scale(uint8_t *out_pixel, const int32_t *work_pixel, int line
         *out_pixel = av_clip(*work_pixel, 0, 255 * 256 * 128) >> 15;
 }
 
+av_cold void ff_w3fdif_init(W3FDIFDSPContext *dsp)
+{
+    dsp->filter_simple_low   = filter_simple_low;
+    dsp->filter_complex_low  = filter_complex_low;
+    dsp->filter_simple_high  = filter_simple_high;
+    dsp->filter_complex_high = filter_complex_high;
+    dsp->filter_scale        = filter_scale;
+
+    if (ARCH_X86)
+        ff_w3fdif_init_x86(dsp);
+}
+
 static int config_input(AVFilterLink *inlink)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -181,14 +193,7 @@ static int config_input(AVFilterLink *inlink)
             return AVERROR(ENOMEM);
     }
 
-    s->dsp.filter_simple_low   = filter_simple_low;
-    s->dsp.filter_complex_low  = filter_complex_low;
-    s->dsp.filter_simple_high  = filter_simple_high;
-    s->dsp.filter_complex_high = filter_complex_high;
-    s->dsp.filter_scale        = filter_scale;
-
-    if (ARCH_X86)
-        ff_w3fdif_init_x86(&s->dsp);
+    ff_w3fdif_init(&s->dsp);
 
     return 0;
 }
@@ -87,3 +87,31 @@ AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h)
 
     return ret;
 }
+
+AVFrame *ff_video_frame_window(const AVFrame *src, int w, int h,
+                               const ptrdiff_t offsets[4])
+{
+    AVFrame *frame;
+    int i;
+
+    if (src->nb_extended_buf)
+        return NULL;
+    if (!(frame = av_frame_alloc()))
+        return NULL;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(src->buf) && src->buf[i]; i++) {
+        if (!(frame->buf[i] = av_buffer_ref(src->buf[i]))) {
+            av_frame_free(&frame);
+            return NULL;
+        }
+    }
+    for (i = 0; i < 4 && src->data[i]; i++) {
+        frame->data[i]     = src->data[i] + offsets[i];
+        frame->linesize[i] = src->linesize[i];
+    }
+    frame->width  = w;
+    frame->height = h;
+    frame->format = src->format;
+
+    return frame;
+}
@@ -38,4 +38,18 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h);
  */
 AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h);
 
+/**
+ * Create a frame referencing a w x h area of the buffers of another frame,
+ * for example to let the source of a link render directly into a part of a
+ * larger frame.
+ *
+ * @param src      the frame holding the buffers
+ * @param offsets  offset in bytes of the area from the data pointers of src,
+ *                 for each plane
+ * @return the new frame, or NULL on failure or if the buffers of src cannot
+ *         be referenced that way
+ */
+AVFrame *ff_video_frame_window(const AVFrame *src, int w, int h,
+                               const ptrdiff_t offsets[4]);
+
 #endif /* AVFILTER_VIDEO_H */
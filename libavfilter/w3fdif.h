@@ -42,6 +42,7 @@ typedef struct W3FDIFDSPContext {
     void (*filter_scale)(uint8_t *out_pixel, const int32_t *work_pixel, int linesize);
 } W3FDIFDSPContext;
 
+void ff_w3fdif_init(W3FDIFDSPContext *dsp);
 void ff_w3fdif_init_x86(W3FDIFDSPContext *dsp);
 
 #endif /* AVFILTER_W3FDIF_H */
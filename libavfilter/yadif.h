@@ -69,6 +69,10 @@ typedef struct YADIFContext {
     int temp_line_size;
 } YADIFContext;
 
+/**
+ * Set filter_line and filter_edges for the pixel format described by csp.
+ */
+void ff_yadif_init(YADIFContext *yadif);
 void ff_yadif_init_x86(YADIFContext *yadif);
 
 #endif /* AVFILTER_YADIF_H */
@@ -106,6 +106,7 @@ AVInputFormat ff_aac_demuxer = {
     .name         = "aac",
     .long_name    = NULL_IF_CONFIG_SMALL("raw ADTS AAC (Advanced Audio Coding)"),
     .read_probe   = adts_aac_probe,
+    .probe_score_max = AVPROBE_SCORE_EXTENSION + 1,
     .read_header  = adts_aac_read_header,
     .read_packet  = ff_raw_read_partial_packet,
     .flags        = AVFMT_GENERIC_INDEX,
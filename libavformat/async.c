@@ -53,6 +53,16 @@ typedef struct RingBuffer
     int           read_pos;
 } RingBuffer;
 
+/**
+ * A range kept buffered after a seek away from it.
+ */
+typedef struct RangeBuffer
+{
+    RingBuffer    ring;
+    int64_t       end;        /**< logical position of the end of the data */
+    int64_t       last_used;
+} RangeBuffer;
+
 typedef struct Context {
     AVClass        *class;
     URLContext     *inner;
@@ -69,7 +79,15 @@ typedef struct Context {
 
     int64_t         logical_pos;
     int64_t         logical_size;
+    int64_t         inner_pos;
     RingBuffer      ring;
+    int             buffer_capacity;
+    int             grow_request;
+    int             read_since_seek;
+
+    RangeBuffer    *ranges;
+    int             nb_ranges_used;
+    int64_t         range_counter;
 
     pthread_cond_t  cond_wakeup_main;
     pthread_cond_t  cond_wakeup_background;
@@ -78,6 +96,18 @@ typedef struct Context {
 
     int             abort_request;
     AVIOInterruptCB interrupt_callback;
+
+    /* options */
+    int             buffer_size;
+    int             read_back_size;
+    int             max_buffer_size;
+    int             nb_ranges;
+
+    /* statistics, exported as read-only options */
+    int64_t         buffer_fill;
+    int64_t         underruns;
+    int64_t         range_hits;
+    int64_t         range_misses;
 } Context;
 
 static int ring_init(RingBuffer *ring, unsigned int capacity, int read_back_capacity)
@@ -147,6 +177,65 @@ static int ring_drain(RingBuffer *ring, int offset)
     return 0;
 }
 
+static RangeBuffer *find_range(Context *c, int64_t pos)
+{
+    int i;
+
+    for (i = 0; i < c->nb_ranges_used; i++) {
+        RangeBuffer *range = &c->ranges[i];
+        int64_t start = range->end - av_fifo_size(range->ring.fifo);
+        if (pos >= start && pos <= range->end)
+            return range;
+    }
+    return NULL;
+}
+
+/**
+ * Keep the current ring as a buffered range, and continue with the ring of
+ * the range hit by the seek to pos, or with an empty one.
+ * Called from the background thread with the mutex locked, once the inner
+ * protocol has seeked to the end of the hit range, or to pos.
+ */
+static int save_range(Context *c, RangeBuffer *hit, int64_t pos)
+{
+    RangeBuffer *range = hit;
+    RingBuffer tmp;
+    int i, ret;
+
+    if (!range && c->nb_ranges_used < c->nb_ranges) {
+        /* keep the current ring in a free slot, and start a new one */
+        range = &c->ranges[c->nb_ranges_used];
+        ret = ring_init(&range->ring, c->buffer_capacity, c->read_back_size);
+        if (ret < 0)
+            return ret;
+        c->nb_ranges_used++;
+    } else if (!range) {
+        /* replace the least recently used range */
+        range = &c->ranges[0];
+        for (i = 1; i < c->nb_ranges_used; i++)
+            if (c->ranges[i].last_used < range->last_used)
+                range = &c->ranges[i];
+    }
+
+    tmp          = range->ring;
+    range->ring  = c->ring;
+    c->ring      = tmp;
+    if (hit) {
+        int64_t start  = hit->end - av_fifo_size(c->ring.fifo);
+        int64_t end    = hit->end;
+        c->ring.read_pos = pos - start;
+        hit->end       = c->inner_pos;
+        c->inner_pos   = end;
+    } else {
+        ring_reset(&c->ring);
+        range->end   = c->inner_pos;
+        c->inner_pos = pos;
+    }
+    range->last_used = ++c->range_counter;
+
+    return 0;
+}
+
 static int async_check_interrupt(void *arg)
 {
     URLContext *h   = arg;
@@ -193,12 +282,34 @@ static void *async_buffer_task(void *arg)
             break;
         }
 
+        if (c->grow_request) {
+            int grow = FFMIN(c->buffer_capacity, c->max_buffer_size - c->buffer_capacity);
+            if (grow > 0 && av_fifo_grow(ring->fifo, grow) >= 0) {
+                c->buffer_capacity += grow;
+                av_log(h, AV_LOG_DEBUG, "async: buffer size raised to %d\n",
+                       c->buffer_capacity);
+            }
+            c->grow_request = 0;
+        }
+
         if (c->seek_request) {
-            seek_ret = ffurl_seek(c->inner, c->seek_pos, c->seek_whence);
+            RangeBuffer *range = c->nb_ranges ? find_range(c, c->seek_pos) : NULL;
+
+            seek_ret = ffurl_seek(c->inner, range ? range->end : c->seek_pos,
+                                  c->seek_whence);
             if (seek_ret >= 0) {
                 c->io_eof_reached = 0;
                 c->io_error       = 0;
-                ring_reset(ring);
+                if (range)
+                    c->range_hits++;
+                else
+                    c->range_misses++;
+                if (!c->nb_ranges || save_range(c, range, c->seek_pos) < 0) {
+                    ring_reset(ring);
+                    c->inner_pos = seek_ret;
+                }
+                if (range)
+                    seek_ret = c->seek_pos;
             }
 
             c->seek_completed = 1;
@@ -228,7 +339,9 @@ static void *async_buffer_task(void *arg)
             c->io_eof_reached = 1;
             if (c->inner_io_error < 0)
                 c->io_error = c->inner_io_error;
-        }
+        } else
+            c->inner_pos += ret;
+        c->buffer_fill = ring_size(ring);
 
         pthread_cond_signal(&c->cond_wakeup_main);
         pthread_mutex_unlock(&c->mutex);
@@ -245,10 +358,20 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "async:", &arg);
 
-    ret = ring_init(&c->ring, BUFFER_CAPACITY, READ_BACK_CAPACITY);
+    c->buffer_capacity = c->buffer_size;
+    c->max_buffer_size = FFMAX(c->max_buffer_size, c->buffer_size);
+    ret = ring_init(&c->ring, c->buffer_capacity, c->read_back_size);
     if (ret < 0)
         goto fifo_fail;
 
+    if (c->nb_ranges) {
+        c->ranges = av_mallocz_array(c->nb_ranges, sizeof(*c->ranges));
+        if (!c->ranges) {
+            ret = AVERROR(ENOMEM);
+            goto url_fail;
+        }
+    }
+
     /* wrap interrupt callback */
     c->interrupt_callback = h->interrupt_callback;
     ret = ffurl_open_whitelist(&c->inner, arg, flags, &interrupt_callback, options, h->protocol_whitelist, h->protocol_blacklist);
@@ -295,6 +418,7 @@ cond_wakeup_main_fail:
 mutex_fail:
     ffurl_close(c->inner);
 url_fail:
+    av_freep(&c->ranges);
     ring_destroy(&c->ring);
 fifo_fail:
     return ret;
@@ -314,11 +438,18 @@ static int async_close(URLContext *h)
     if (ret != 0)
         av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(ret));
 
+    av_log(h, AV_LOG_VERBOSE, "Statistics, buffer size:%d underruns:%"PRId64
+           " range hits:%"PRId64" range misses:%"PRId64"\n", c->buffer_capacity,
+           c->underruns, c->range_hits, c->range_misses);
+
     pthread_cond_destroy(&c->cond_wakeup_background);
     pthread_cond_destroy(&c->cond_wakeup_main);
     pthread_mutex_destroy(&c->mutex);
     ffurl_close(c->inner);
     ring_destroy(&c->ring);
+    while (c->nb_ranges_used--)
+        ring_destroy(&c->ranges[c->nb_ranges_used].ring);
+    av_freep(&c->ranges);
 
     return 0;
 }
@@ -348,6 +479,7 @@ static int async_read_internal(URLContext *h, void *dest, int size, int read_com
             c->logical_pos += to_copy;
             to_read        -= to_copy;
             ret             = size - to_read;
+            c->read_since_seek = 1;
 
             if (to_read <= 0 || !read_complete)
                 break;
@@ -359,11 +491,18 @@ static int async_read_internal(URLContext *h, void *dest, int size, int read_com
                     ret = AVERROR_EOF;
             }
             break;
+        } else if (c->read_since_seek) {
+            /* the reader is faster than the buffer is filled, a larger buffer
+             * absorbs more of the stalls of the source */
+            c->underruns++;
+            if (c->buffer_capacity < c->max_buffer_size)
+                c->grow_request = 1;
         }
         pthread_cond_signal(&c->cond_wakeup_background);
         pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
     }
 
+    c->buffer_fill = ring_size(ring);
     pthread_cond_signal(&c->cond_wakeup_background);
     pthread_mutex_unlock(&c->mutex);
 
@@ -448,8 +587,10 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
             break;
         }
         if (c->seek_completed) {
-            if (c->seek_ret >= 0)
-                c->logical_pos  = c->seek_ret;
+            if (c->seek_ret >= 0) {
+                c->logical_pos     = c->seek_ret;
+                c->read_since_seek = 0;
+            }
             ret = c->seek_ret;
             break;
         }
@@ -466,6 +607,14 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
 #define D AV_OPT_FLAG_DECODING_PARAM
 
 static const AVOption options[] = {
+    { "async_buffer_size", "Initial size in bytes of the read-ahead buffer", OFFSET(buffer_size), AV_OPT_TYPE_INT, { .i64 = BUFFER_CAPACITY }, 4096, INT_MAX / 4, D },
+    { "async_read_back_size", "Size in bytes of the data kept behind the read position", OFFSET(read_back_size), AV_OPT_TYPE_INT, { .i64 = READ_BACK_CAPACITY }, 0, INT_MAX / 4, D },
+    { "async_max_buffer_size", "Size in bytes up to which the read-ahead buffer grows when the reader has to wait, 0 for a fixed size", OFFSET(max_buffer_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX / 4, D },
+    { "async_ranges", "Number of ranges kept buffered when seeking away from them", OFFSET(nb_ranges), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, D },
+    { "buffer_fill", "Bytes buffered ahead of the read position", OFFSET(buffer_fill), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "underruns", "Number of reads that had to wait for data", OFFSET(underruns), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "range_hits", "Number of seeks served from a buffered range", OFFSET(range_hits), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "range_misses", "Number of seeks that restarted the buffering", OFFSET(range_misses), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     {NULL},
 };
 
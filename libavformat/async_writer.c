@@ -0,0 +1,308 @@
+/*
+ * Background writing of complete output files
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+
+#include "async_writer.h"
+#include "avio.h"
+#include "avio_internal.h"
+#include "internal.h"
+
+typedef struct AsyncWriteJob {
+    char *url;
+    char *move_to;
+    AVDictionary *options;
+    uint8_t *data;
+    int size;
+    int flags;
+    int64_t seq;
+} AsyncWriteJob;
+
+/* file opened with ff_async_writer_open(), not closed yet */
+typedef struct PendingFile {
+    AVIOContext *pb;
+    AVIOContext **owner;
+    char *url;
+    AVDictionary *options;
+    struct PendingFile *next;
+} PendingFile;
+
+struct FFAsyncWriter {
+    AVFormatContext *s;
+    PendingFile *pending;
+    int64_t nb_queued;
+
+#if HAVE_THREADS
+    AVThreadMessageQueue *queue;
+    pthread_t *threads;
+    int nb_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    /* seq of the first job not written yet, and ring of the written-state
+     * of the following ones, which may complete out of order */
+    int64_t next_undone;
+    uint8_t *done;
+    int nb_done_slots;
+    int error;
+#endif
+};
+
+static void free_job(AsyncWriteJob *job)
+{
+    av_freep(&job->url);
+    av_freep(&job->move_to);
+    av_freep(&job->data);
+    av_dict_free(&job->options);
+}
+
+#if HAVE_THREADS
+static void free_job_msg(void *msg)
+{
+    free_job(msg);
+}
+
+static int write_job(FFAsyncWriter *w, AsyncWriteJob *job)
+{
+    AVFormatContext *s = w->s;
+    AVIOContext *pb = NULL;
+    int ret;
+
+    if ((ret = s->io_open(s, &pb, job->url, AVIO_FLAG_WRITE, &job->options)) < 0) {
+        av_log(s, AV_LOG_ERROR, "Failed to open %s for writing\n", job->url);
+        return ret;
+    }
+    avio_write(pb, job->data, job->size);
+    avio_flush(pb);
+    ret = pb->error;
+    ff_format_io_close(s, &pb);
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Failed to write %s\n", job->url);
+        return ret;
+    }
+    if (job->move_to)
+        ret = ff_rename(job->url, job->move_to, s);
+    return ret;
+}
+
+static void *writer_thread(void *arg)
+{
+    FFAsyncWriter *w = arg;
+    AsyncWriteJob job;
+
+    while (av_thread_message_queue_recv(w->queue, &job, 0) >= 0) {
+        int ret;
+
+        if (job.flags & FF_ASYNC_WRITER_ORDERED) {
+            pthread_mutex_lock(&w->lock);
+            while (w->next_undone != job.seq)
+                pthread_cond_wait(&w->cond, &w->lock);
+            pthread_mutex_unlock(&w->lock);
+        }
+
+        ret = write_job(w, &job);
+
+        pthread_mutex_lock(&w->lock);
+        if (ret < 0 && !w->error)
+            w->error = ret;
+        w->done[job.seq % w->nb_done_slots] = 1;
+        while (w->done[w->next_undone % w->nb_done_slots]) {
+            w->done[w->next_undone % w->nb_done_slots] = 0;
+            w->next_undone++;
+        }
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+
+        free_job(&job);
+    }
+
+    return NULL;
+}
+#endif /* HAVE_THREADS */
+
+int ff_async_writer_init(FFAsyncWriter **pw, AVFormatContext *s,
+                         int nb_threads, int queue_size)
+{
+#if HAVE_THREADS
+    FFAsyncWriter *w;
+    int i, ret;
+
+    if (nb_threads <= 0 || queue_size <= 0)
+        return AVERROR(EINVAL);
+    if (!(w = av_mallocz(sizeof(*w))))
+        return AVERROR(ENOMEM);
+    w->s = s;
+
+    /* a job is either queued, or being written by one of the threads */
+    w->nb_done_slots = queue_size + nb_threads + 1;
+    w->done    = av_mallocz(w->nb_done_slots);
+    w->threads = av_malloc_array(nb_threads, sizeof(*w->threads));
+    if (!w->done || !w->threads) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = av_thread_message_queue_alloc(&w->queue, queue_size,
+                                             sizeof(AsyncWriteJob))) < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(w->queue, free_job_msg);
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+
+    for (i = 0; i < nb_threads; i++) {
+        if ((ret = pthread_create(&w->threads[i], NULL, writer_thread, w))) {
+            av_log(s, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+            w->nb_threads = i;
+            *pw = w;
+            ff_async_writer_free(pw);
+            return AVERROR(ret);
+        }
+        w->nb_threads++;
+    }
+
+    *pw = w;
+    return 0;
+
+fail:
+    av_thread_message_queue_free(&w->queue);
+    av_freep(&w->threads);
+    av_freep(&w->done);
+    av_freep(&w);
+    return ret;
+#else
+    return AVERROR(ENOSYS);
+#endif /* HAVE_THREADS */
+}
+
+int ff_async_writer_open(FFAsyncWriter *w, AVIOContext **pb, const char *url,
+                         AVDictionary **options)
+{
+    PendingFile *pf = av_mallocz(sizeof(*pf));
+    int ret;
+
+    if (!pf)
+        return AVERROR(ENOMEM);
+    if (!(pf->url = av_strdup(url))) {
+        av_free(pf);
+        return AVERROR(ENOMEM);
+    }
+    if (options)
+        av_dict_copy(&pf->options, *options, 0);
+    if ((ret = avio_open_dyn_buf(pb)) < 0) {
+        av_dict_free(&pf->options);
+        av_free(pf->url);
+        av_free(pf);
+        return ret;
+    }
+    pf->pb      = *pb;
+    pf->owner   = pb;
+    pf->next    = w->pending;
+    w->pending  = pf;
+    return 0;
+}
+
+int ff_async_writer_close(FFAsyncWriter *w, AVIOContext **pb,
+                          const char *move_to, int flags)
+{
+    PendingFile **ppf, *pf;
+    AsyncWriteJob job = { 0 };
+    int ret = 0;
+
+    if (!*pb)
+        return 0;
+    for (ppf = &w->pending; *ppf && (*ppf)->pb != *pb; ppf = &(*ppf)->next)
+        ;
+    if (!(pf = *ppf))
+        return AVERROR_BUG;
+    *ppf = pf->next;
+
+    job.size    = avio_close_dyn_buf(*pb, &job.data);
+    *pb         = NULL;
+    job.url     = pf->url;
+    job.options = pf->options;
+    job.flags   = flags;
+    av_free(pf);
+    if (move_to && !(job.move_to = av_strdup(move_to))) {
+        free_job(&job);
+        return AVERROR(ENOMEM);
+    }
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&w->lock);
+    ret = w->error;
+    pthread_mutex_unlock(&w->lock);
+    if (ret < 0) {
+        free_job(&job);
+        return ret;
+    }
+    job.seq = w->nb_queued++;
+    /* blocks while the queue is full */
+    if ((ret = av_thread_message_queue_send(w->queue, &job, 0)) < 0)
+        free_job(&job);
+#else
+    free_job(&job);
+    ret = AVERROR(ENOSYS);
+#endif
+    return ret;
+}
+
+int ff_async_writer_free(FFAsyncWriter **pw)
+{
+    FFAsyncWriter *w = *pw;
+    int ret = 0;
+
+    if (!w)
+        return 0;
+
+    while (w->pending) {
+        PendingFile *pf = w->pending;
+        w->pending = pf->next;
+        if (*pf->owner == pf->pb)
+            *pf->owner = NULL;
+        ffio_free_dyn_buf(&pf->pb);
+        av_dict_free(&pf->options);
+        av_free(pf->url);
+        av_free(pf);
+    }
+
+#if HAVE_THREADS
+    {
+        int i;
+
+        /* the threads write the remaining jobs, then get EOF */
+        av_thread_message_queue_set_err_recv(w->queue, AVERROR_EOF);
+        for (i = 0; i < w->nb_threads; i++)
+            pthread_join(w->threads[i], NULL);
+        ret = w->error;
+
+        av_thread_message_queue_free(&w->queue);
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+        av_freep(&w->threads);
+        av_freep(&w->done);
+    }
+#endif
+    av_freep(pw);
+    return ret;
+}
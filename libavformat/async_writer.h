@@ -0,0 +1,82 @@
+/*
+ * Background writing of complete output files
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_ASYNC_WRITER_H
+#define AVFORMAT_ASYNC_WRITER_H
+
+#include "avformat.h"
+
+/**
+ * @file
+ * Segmenting muxers write every file, segment or playlist, in one go. An
+ * FFAsyncWriter lets them write to memory instead, and hands the complete
+ * files to a pool of threads which open, write and close the real outputs.
+ * The queue of complete files is bounded: once it is full, closing a file
+ * blocks, so that a slow output slows down the muxer instead of making the
+ * memory use grow without limit.
+ */
+
+typedef struct FFAsyncWriter FFAsyncWriter;
+
+/**
+ * Only write the file once all the files closed before it are written,
+ * e.g. for playlists, which must not reference segments not written yet.
+ */
+#define FF_ASYNC_WRITER_ORDERED 1
+
+/**
+ * Create a writer with nb_threads threads, and at most queue_size complete
+ * files waiting for a thread.
+ *
+ * The files are opened with the io_open callback of s, from the threads.
+ */
+int ff_async_writer_init(FFAsyncWriter **w, AVFormatContext *s,
+                         int nb_threads, int queue_size);
+
+/**
+ * Open an in-memory AVIOContext, which will be written to url with the
+ * given protocol options when closed with ff_async_writer_close().
+ *
+ * If the file is still open when the writer is freed, its content is
+ * discarded and *pb is set to NULL, so pb must remain valid until then.
+ */
+int ff_async_writer_open(FFAsyncWriter *w, AVIOContext **pb, const char *url,
+                         AVDictionary **options);
+
+/**
+ * Close an AVIOContext opened with ff_async_writer_open() and queue its
+ * content for writing.
+ *
+ * @param move_to if not NULL, the file is renamed to move_to once written
+ * @param flags   a combination of FF_ASYNC_WRITER_* flags
+ * @return 0 on success, or the error of a previous write that failed
+ */
+int ff_async_writer_close(FFAsyncWriter *w, AVIOContext **pb,
+                          const char *move_to, int flags);
+
+/**
+ * Wait until all the queued files are written and free the writer.
+ * The files not closed yet are discarded.
+ *
+ * @return 0 on success, or the error of the first write that failed
+ */
+int ff_async_writer_free(FFAsyncWriter **w);
+
+#endif /* AVFORMAT_ASYNC_WRITER_H */
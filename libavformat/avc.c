@@ -20,6 +20,9 @@
  */
 
 #include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavcodec/get_bits.h"
+#include "libavcodec/golomb.h"
 #include "avformat.h"
 #include "avio.h"
 #include "avc.h"
@@ -208,3 +211,138 @@ const uint8_t *ff_avc_mp4_find_startcode(const uint8_t *start,
 
     return start + res;
 }
+
+static void avc_skip_scaling_list(GetBitContext *gb, int size)
+{
+    int i, last = 8, next = 8;
+
+    for (i = 0; i < size && next; i++) {
+        next = (last + get_se_golomb_long(gb)) & 0xff;
+        if (next)
+            last = next;
+    }
+}
+
+static int avc_decode_sps_dimensions(const uint8_t *rbsp, int size,
+                                     int *width, int *height)
+{
+    GetBitContext gb;
+    int profile_idc, chroma_format_idc = 1, separate_planes = 0;
+    int poc_type, mb_width, mb_height, frame_mbs_only;
+    int crop_unit_x, crop_unit_y, i, ret;
+
+    if ((ret = init_get_bits8(&gb, rbsp, size)) < 0)
+        return ret;
+
+    skip_bits(&gb, 8);                          // nal_unit_header
+    profile_idc = get_bits(&gb, 8);
+    skip_bits(&gb, 16);                         // constraint flags, level_idc
+    get_ue_golomb_long(&gb);                    // seq_parameter_set_id
+
+    if (profile_idc == 100 || profile_idc == 110 || profile_idc == 122 ||
+        profile_idc == 244 || profile_idc ==  44 || profile_idc ==  83 ||
+        profile_idc ==  86 || profile_idc == 118 || profile_idc == 128 ||
+        profile_idc == 138 || profile_idc == 139 || profile_idc == 134 ||
+        profile_idc == 135) {
+        chroma_format_idc = get_ue_golomb_long(&gb);
+        if (chroma_format_idc > 3)
+            return AVERROR_INVALIDDATA;
+        if (chroma_format_idc == 3)
+            separate_planes = get_bits1(&gb);
+        get_ue_golomb_long(&gb);                // bit_depth_luma_minus8
+        get_ue_golomb_long(&gb);                // bit_depth_chroma_minus8
+        skip_bits1(&gb);                        // qpprime_y_zero_transform_bypass_flag
+        if (get_bits1(&gb))                     // seq_scaling_matrix_present_flag
+            for (i = 0; i < (chroma_format_idc != 3 ? 8 : 12); i++)
+                if (get_bits1(&gb))
+                    avc_skip_scaling_list(&gb, i < 6 ? 16 : 64);
+    }
+
+    get_ue_golomb_long(&gb);                    // log2_max_frame_num_minus4
+    poc_type = get_ue_golomb_long(&gb);
+    if (poc_type == 0) {
+        get_ue_golomb_long(&gb);                // log2_max_poc_lsb_minus4
+    } else if (poc_type == 1) {
+        unsigned nb_ref_frames_in_cycle;
+        skip_bits1(&gb);                        // delta_pic_order_always_zero_flag
+        get_se_golomb_long(&gb);                // offset_for_non_ref_pic
+        get_se_golomb_long(&gb);                // offset_for_top_to_bottom_field
+        nb_ref_frames_in_cycle = get_ue_golomb_long(&gb);
+        if (nb_ref_frames_in_cycle > 255)
+            return AVERROR_INVALIDDATA;
+        for (i = 0; i < nb_ref_frames_in_cycle; i++)
+            get_se_golomb_long(&gb);            // offset_for_ref_frame
+    } else if (poc_type != 2) {
+        return AVERROR_INVALIDDATA;
+    }
+    get_ue_golomb_long(&gb);                    // max_num_ref_frames
+    skip_bits1(&gb);                            // gaps_in_frame_num_value_allowed_flag
+    mb_width       = get_ue_golomb_long(&gb) + 1;
+    mb_height      = get_ue_golomb_long(&gb) + 1;
+    frame_mbs_only = get_bits1(&gb);
+    if (!frame_mbs_only)
+        skip_bits1(&gb);                        // mb_adaptive_frame_field_flag
+    skip_bits1(&gb);                            // direct_8x8_inference_flag
+
+    if (mb_width > 4096 || mb_height > 4096 || get_bits_left(&gb) < 0)
+        return AVERROR_INVALIDDATA;
+
+    *width  = 16 * mb_width;
+    *height = 16 * mb_height * (2 - frame_mbs_only);
+
+    if (get_bits1(&gb)) {                       // frame_cropping_flag
+        unsigned crop_left   = get_ue_golomb_long(&gb);
+        unsigned crop_right  = get_ue_golomb_long(&gb);
+        unsigned crop_top    = get_ue_golomb_long(&gb);
+        unsigned crop_bottom = get_ue_golomb_long(&gb);
+
+        if (separate_planes || !chroma_format_idc) {
+            crop_unit_x = 1;
+            crop_unit_y = 2 - frame_mbs_only;
+        } else {
+            crop_unit_x = chroma_format_idc == 3 ? 1 : 2;
+            crop_unit_y = (chroma_format_idc == 1 ? 2 : 1) * (2 - frame_mbs_only);
+        }
+        if (get_bits_left(&gb) >= 0 &&
+            (crop_left + (int64_t)crop_right)  * crop_unit_x < *width &&
+            (crop_top  + (int64_t)crop_bottom) * crop_unit_y < *height) {
+            *width  -= (crop_left + crop_right)  * crop_unit_x;
+            *height -= (crop_top  + crop_bottom) * crop_unit_y;
+        }
+    }
+
+    return 0;
+}
+
+int ff_avc_get_avcc_dimensions(const uint8_t *data, int size,
+                               int *width, int *height)
+{
+    const uint8_t *sps;
+    uint8_t *rbsp;
+    int sps_size, rbsp_size = 0, i, ret;
+
+    /* configurationVersion, profile, compatibility, level, NAL length size,
+     * number of SPS, then the size of the first SPS */
+    if (size < 8 || data[0] != 1 || !(data[5] & 0x1f))
+        return AVERROR_INVALIDDATA;
+    sps_size = AV_RB16(data + 6);
+    sps      = data + 8;
+    if (sps_size < 4 || sps_size > size - 8)
+        return AVERROR_INVALIDDATA;
+
+    rbsp = av_malloc(sps_size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!rbsp)
+        return AVERROR(ENOMEM);
+    /* remove the emulation prevention bytes */
+    for (i = 0; i < sps_size; i++) {
+        if (i >= 2 && i < sps_size - 1 && sps[i] == 3 &&
+            !sps[i - 1] && !sps[i - 2] && sps[i + 1] <= 3)
+            continue;
+        rbsp[rbsp_size++] = sps[i];
+    }
+    memset(rbsp + rbsp_size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    ret = avc_decode_sps_dimensions(rbsp, rbsp_size, width, height);
+    av_free(rbsp);
+    return ret;
+}
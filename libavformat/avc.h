@@ -34,4 +34,13 @@ const uint8_t *ff_avc_mp4_find_startcode(const uint8_t *start,
                                          const uint8_t *end,
                                          int nal_length_size);
 
+/**
+ * Get the picture size from the first SPS of an AVC decoder configuration
+ * record (avcC), with the cropping applied.
+ *
+ * @return 0 on success, a negative AVERROR code otherwise
+ */
+int ff_avc_get_avcc_dimensions(const uint8_t *data, int size,
+                               int *width, int *height);
+
 #endif /* AVFORMAT_AVC_H */
@@ -787,6 +787,15 @@ typedef struct AVInputFormat {
      * @see avdevice_capabilities_free() for more details.
      */
     int (*free_device_capabilities)(struct AVFormatContext *s, struct AVDeviceCapabilitiesQuery *caps);
+
+    /**
+     * Upper bound of the scores read_probe() can return, 0 if it can
+     * return up to AVPROBE_SCORE_MAX. Should be set by the demuxers whose
+     * probe is costly, typically those scanning the whole buffer for
+     * frame headers: they are then probed after the others and skipped
+     * once another format scored higher than they can.
+     */
+    int probe_score_max;
 } AVInputFormat;
 /**
  * @}
@@ -1434,6 +1443,14 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_PRIV_OPT    0x20000 ///< Enable use of private options by delaying codec open (this could be made default once all code is converted)
 #define AVFMT_FLAG_KEEP_SIDE_DATA 0x40000 ///< Don't merge side data but keep it separate.
 #define AVFMT_FLAG_FAST_SEEK   0x80000 ///< Enable fast, but inaccurate seeks for some formats
+/**
+ * Make avformat_find_stream_info() take the codec parameters from the
+ * parsers and the extradata, and only decode the streams for which these are
+ * not enough. The sample and pixel formats may then be left unset, and the
+ * frame rate is not estimated from the timestamps. With AVFMTCTX_NOHEADER,
+ * probing stops once the streams found so far have their parameters.
+ */
+#define AVFMT_FLAG_FAST_PROBE 0x100000
 
     /**
      * Maximum size of the data read from input for determining
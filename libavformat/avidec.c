@@ -64,6 +64,11 @@ typedef struct AVIStream {
     uint8_t *sub_buffer;
 
     int64_t seek_pos;
+
+    int64_t *odml_chunks;   /* positions of the standard index chunks listed
+                             * in the OpenDML super index, with lazy_odml */
+    int nb_odml_chunks;
+    int odml_chunks_loaded; /* number of them read into the index so far */
 } AVIStream;
 
 typedef struct AVIContext {
@@ -81,6 +86,7 @@ typedef struct AVIContext {
     DVDemuxContext *dv_demux;
     int odml_depth;
     int use_odml;
+    int lazy_odml;
 #define MAX_ODML_DEPTH 1000
     int64_t dts_max;
 } AVIContext;
@@ -88,6 +94,7 @@ typedef struct AVIContext {
 
 static const AVOption options[] = {
     { "use_odml", "use odml index", offsetof(AVIContext, use_odml), AV_OPT_TYPE_BOOL, {.i64 = 1}, -1, 1, AV_OPT_FLAG_DECODING_PARAM},
+    { "lazy_odml", "read the odml standard indexes only when seeking", offsetof(AVIContext, lazy_odml), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM},
     { NULL },
 };
 
@@ -243,6 +250,19 @@ static int read_braindead_odml_indx(AVFormatContext *s, int frame_num)
             if (avio_feof(pb))
                 return AVERROR_INVALIDDATA;
 
+            if (avi->lazy_odml && !avi->odml_depth) {
+                /* only remember where the standard index is, it is read
+                 * by load_odml_chunks() when needed */
+                if (av_reallocp_array(&ast->odml_chunks, ast->nb_odml_chunks + 1,
+                                      sizeof(*ast->odml_chunks)) < 0) {
+                    ast->nb_odml_chunks = ast->odml_chunks_loaded = 0;
+                    return AVERROR(ENOMEM);
+                }
+                ast->odml_chunks[ast->nb_odml_chunks++] = offset;
+                frame_num += duration;
+                continue;
+            }
+
             pos = avio_tell(pb);
 
             if (avi->odml_depth > MAX_ODML_DEPTH) {
@@ -268,6 +288,44 @@ static int read_braindead_odml_indx(AVFormatContext *s, int frame_num)
     return 0;
 }
 
+/**
+ * Read the standard index chunks of st listed in its super index, in order,
+ * until the index covers timestamp (in st->time_base) or all of them are
+ * read.
+ */
+static int load_odml_chunks(AVFormatContext *s, AVStream *st, int64_t timestamp)
+{
+    AVIContext *avi = s->priv_data;
+    AVIStream *ast  = st->priv_data;
+    AVIOContext *pb = s->pb;
+    int64_t pos     = avio_tell(pb);
+    int ret         = 0;
+
+    if (timestamp != INT64_MIN && timestamp != INT64_MAX)
+        timestamp *= FFMAX(ast->sample_size, 1);
+
+    while (ast->odml_chunks_loaded < ast->nb_odml_chunks &&
+           (!st->nb_index_entries ||
+            st->index_entries[st->nb_index_entries - 1].timestamp <= timestamp)) {
+        if (avio_seek(pb, ast->odml_chunks[ast->odml_chunks_loaded++] + 8, SEEK_SET) < 0) {
+            ret = -1;
+            break;
+        }
+        avi->odml_depth++;
+        ret = read_braindead_odml_indx(s, 0);
+        avi->odml_depth--;
+        if (ret < 0 && (s->error_recognition & AV_EF_EXPLODE))
+            break;
+        ret = 0;
+    }
+
+    if (avio_seek(pb, pos, SEEK_SET) < 0) {
+        av_log(s, AV_LOG_ERROR, "Failed to restore position after reading index\n");
+        return -1;
+    }
+    return ret;
+}
+
 static void clean_index(AVFormatContext *s)
 {
     int i;
@@ -1002,6 +1060,13 @@ fail:
 
     if (!avi->index_loaded && pb->seekable)
         avi_load_index(s);
+
+    /* with lazy_odml, only the first standard index of every stream is read
+     * here, which is enough to detect the interleaving */
+    for (i = 0; i < s->nb_streams; i++)
+        if ((ret = load_odml_chunks(s, s->streams[i], INT64_MIN)) < 0)
+            return ret;
+
     calculate_bitrate(s);
     avi->index_loaded    |= 1;
 
@@ -1010,6 +1075,13 @@ fail:
 
     avi->non_interleaved |= ret | (s->flags & AVFMT_FLAG_SORT_DTS);
 
+    /* reading non-interleaved files requires the whole index */
+    if (avi->non_interleaved) {
+        for (i = 0; i < s->nb_streams; i++)
+            if ((ret = load_odml_chunks(s, s->streams[i], INT64_MAX)) < 0)
+                return ret;
+    }
+
     dict_entry = av_dict_get(s->metadata, "ISFT", NULL, 0);
     if (dict_entry && !strcmp(dict_entry->value, "PotEncoder"))
         for (i = 0; i < s->nb_streams; i++) {
@@ -1516,8 +1588,11 @@ resync:
             int64_t dts= av_rescale_q(pkt->dts, st->time_base, AV_TIME_BASE_Q);
 
             if (avi->dts_max - dts > 2*AV_TIME_BASE) {
+                int i;
                 avi->non_interleaved= 1;
                 av_log(s, AV_LOG_INFO, "Switching to NI mode, due to poor interleaving\n");
+                for (i = 0; i < s->nb_streams; i++)
+                    load_odml_chunks(s, s->streams[i], INT64_MAX);
             }else if (avi->dts_max < dts)
                 avi->dts_max = dts;
         }
@@ -1796,6 +1871,22 @@ static int avi_read_seek(AVFormatContext *s, int stream_index,
 
     st    = s->streams[stream_index];
     ast   = st->priv_data;
+
+    /* read the standard indexes up to the seek target */
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st2 = s->streams[i];
+        int64_t ts2   = av_rescale_q(timestamp, st->time_base, st2->time_base);
+        if (load_odml_chunks(s, st2, ts2) < 0)
+            return -1;
+    }
+    /* a later key frame may be in the following ones */
+    while (!(flags & AVSEEK_FLAG_BACKWARD) && st->nb_index_entries &&
+           ast->odml_chunks_loaded < ast->nb_odml_chunks &&
+           av_index_search_timestamp(st, timestamp * FFMAX(ast->sample_size, 1), flags) < 0)
+        if (load_odml_chunks(s, st, st->index_entries[st->nb_index_entries - 1].timestamp /
+                                    FFMAX(ast->sample_size, 1)) < 0)
+            return -1;
+
     index = av_index_search_timestamp(st,
                                       timestamp * FFMAX(ast->sample_size, 1),
                                       flags);
@@ -1905,6 +1996,7 @@ static int avi_read_close(AVFormatContext *s)
             }
             av_freep(&ast->sub_buffer);
             av_packet_unref(&ast->sub_pkt);
+            av_freep(&ast->odml_chunks);
         }
     }
 
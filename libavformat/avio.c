@@ -30,6 +30,9 @@
 #include "network.h"
 #endif
 #include "url.h"
+#if HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 
 /** @name Logging context. */
 /*@{*/
@@ -351,11 +354,30 @@ int ffurl_open(URLContext **puc, const char *filename, int flags,
                                 int_cb, options, NULL, NULL);
 }
 
+/* advance iov past the first size bytes */
+static void iov_skip(URLIOVec **iov, int *nb_iov, int size)
+{
+    while (*nb_iov && size >= (*iov)->size) {
+        size -= (*iov)->size;
+        (*iov)++;
+        (*nb_iov)--;
+    }
+    if (*nb_iov) {
+        (*iov)->buf  += size;
+        (*iov)->size -= size;
+    }
+}
+
+/* transfer into or from buf, or the nb_iov buffers of iov if it is set */
 static inline int retry_transfer_wrapper(URLContext *h, uint8_t *buf,
                                          int size, int size_min,
                                          int (*transfer_func)(URLContext *h,
                                                               uint8_t *buf,
-                                                              int size))
+                                                              int size),
+                                         URLIOVec *iov, int nb_iov,
+                                         int (*transfer_iov_func)(URLContext *h,
+                                                                  const URLIOVec *iov,
+                                                                  int nb_iov))
 {
     int ret, len;
     int fast_retries = 5;
@@ -365,7 +387,10 @@ static inline int retry_transfer_wrapper(URLContext *h, uint8_t *buf,
     while (len < size_min) {
         if (ff_check_interrupt(&h->interrupt_callback))
             return AVERROR_EXIT;
-        ret = transfer_func(h, buf + len, size - len);
+        if (iov)
+            ret = transfer_iov_func(h, iov, nb_iov);
+        else
+            ret = transfer_func(h, buf + len, size - len);
         if (ret == AVERROR(EINTR))
             continue;
         if (h->flags & AVIO_FLAG_NONBLOCK)
@@ -388,6 +413,8 @@ static inline int retry_transfer_wrapper(URLContext *h, uint8_t *buf,
         if (ret)
             fast_retries = FFMAX(fast_retries, 2);
         len += ret;
+        if (iov)
+            iov_skip(&iov, &nb_iov, ret);
     }
     return len;
 }
@@ -396,14 +423,16 @@ int ffurl_read(URLContext *h, unsigned char *buf, int size)
 {
     if (!(h->flags & AVIO_FLAG_READ))
         return AVERROR(EIO);
-    return retry_transfer_wrapper(h, buf, size, 1, h->prot->url_read);
+    return retry_transfer_wrapper(h, buf, size, 1, h->prot->url_read,
+                                  NULL, 0, NULL);
 }
 
 int ffurl_read_complete(URLContext *h, unsigned char *buf, int size)
 {
     if (!(h->flags & AVIO_FLAG_READ))
         return AVERROR(EIO);
-    return retry_transfer_wrapper(h, buf, size, size, h->prot->url_read);
+    return retry_transfer_wrapper(h, buf, size, size, h->prot->url_read,
+                                  NULL, 0, NULL);
 }
 
 int ffurl_write(URLContext *h, const unsigned char *buf, int size)
@@ -416,8 +445,91 @@ int ffurl_write(URLContext *h, const unsigned char *buf, int size)
 
     return retry_transfer_wrapper(h, (unsigned char *)buf, size, size,
                                   (int (*)(struct URLContext *, uint8_t *, int))
-                                  h->prot->url_write);
+                                  h->prot->url_write, NULL, 0, NULL);
+}
+
+int ffurl_readv(URLContext *h, const URLIOVec *iov, int nb_iov)
+{
+    URLIOVec vec[URL_IOV_MAX];
+    int i;
+
+    if (!(h->flags & AVIO_FLAG_READ))
+        return AVERROR(EIO);
+    if (nb_iov < 0 || nb_iov > URL_IOV_MAX)
+        return AVERROR(EINVAL);
+
+    if (!h->prot->url_readv) {
+        for (i = 0; i < nb_iov; i++)
+            if (iov[i].size > 0)
+                return ffurl_read(h, iov[i].buf, iov[i].size);
+        return 0;
+    }
+
+    /* drop the empty buffers, the wrapper stops once the rest is filled */
+    for (i = 0; nb_iov; iov++, nb_iov--)
+        if (iov->size > 0)
+            vec[i++] = *iov;
+    if (!i)
+        return 0;
+    return retry_transfer_wrapper(h, NULL, 0, 1, NULL, vec, i,
+                                  h->prot->url_readv);
+}
+
+int ffurl_writev(URLContext *h, const URLIOVec *iov, int nb_iov)
+{
+    URLIOVec vec[URL_IOV_MAX];
+    uint8_t *buf, *p;
+    int64_t size = 0;
+    int i, ret;
+
+    if (!(h->flags & AVIO_FLAG_WRITE))
+        return AVERROR(EIO);
+    if (nb_iov < 0 || nb_iov > URL_IOV_MAX)
+        return AVERROR(EINVAL);
+    for (i = 0; i < nb_iov; i++)
+        size += iov[i].size;
+    if (size > INT_MAX)
+        return AVERROR(EINVAL);
+    if (h->max_packet_size && size > h->max_packet_size)
+        return AVERROR(EIO);
+
+    if (h->prot->url_writev) {
+        memcpy(vec, iov, nb_iov * sizeof(*vec));
+        return retry_transfer_wrapper(h, NULL, 0, size, NULL, vec, nb_iov,
+                                      h->prot->url_writev);
+    }
+
+    if (!h->max_packet_size) {
+        for (i = 0; i < nb_iov; i++)
+            if ((ret = ffurl_write(h, iov[i].buf, iov[i].size)) < 0)
+                return ret;
+        return size;
+    }
+
+    /* the buffers form one packet */
+    if (!(buf = av_malloc(size)))
+        return AVERROR(ENOMEM);
+    for (i = 0, p = buf; i < nb_iov; p += iov[i++].size)
+        memcpy(p, iov[i].buf, iov[i].size);
+    ret = ffurl_write(h, buf, size);
+    av_free(buf);
+    return ret;
+}
+
+#if HAVE_SYS_UIO_H
+int ff_url_iovec(struct iovec *vec, const URLIOVec *iov, int nb_iov,
+                 int max_size)
+{
+    int i;
+
+    for (i = 0; i < nb_iov && max_size > 0; i++) {
+        vec[i].iov_base = iov[i].buf;
+        vec[i].iov_len  = FFMIN(iov[i].size, max_size);
+        max_size       -= vec[i].iov_len;
+    }
+    return i;
 }
+#endif
 
 int64_t ffurl_seek(URLContext *h, int64_t pos, int whence)
 {
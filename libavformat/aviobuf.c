@@ -35,6 +35,12 @@
 
 #define IO_BUFFER_SIZE 32768
 
+/**
+ * Size up to which the write buffer of a seekable protocol grows while it
+ * keeps being filled, to write files in large blocks.
+ */
+#define IO_WRITE_BUFFER_MAX_SIZE (256 * 1024)
+
 /**
  * Do seeks within this distance ahead of the current buffer by skipping
  * data instead of calling the protocol seek function, for seekable
@@ -77,6 +83,9 @@ const AVClass ff_avio_class = {
 
 static void fill_buffer(AVIOContext *s);
 static int url_resetbuf(AVIOContext *s, int flags);
+static int io_read_packet(void *opaque, uint8_t *buf, int buf_size);
+static int io_write_packet(void *opaque, uint8_t *buf, int buf_size);
+static int dyn_buf_write(void *opaque, uint8_t *buf, int buf_size);
 
 int ffio_init_context(AVIOContext *s,
                   unsigned char *buffer,
@@ -147,8 +156,60 @@ static void writeout(AVIOContext *s, const uint8_t *data, int len)
     s->pos += len;
 }
 
+/**
+ * Double the size of an empty write buffer which was filled up, for
+ * protocols writing to files; the writes to streamed and packetized
+ * protocols are rather bound by latency.
+ */
+static void grow_write_buffer(AVIOContext *s)
+{
+    int size = FFMIN(2 * s->buffer_size, IO_WRITE_BUFFER_MAX_SIZE);
+    uint8_t *buffer;
+
+    if (size <= s->buffer_size || s->write_packet != io_write_packet ||
+        !s->seekable || s->max_packet_size || s->direct)
+        return;
+    if (!(buffer = av_malloc(size)))
+        return;
+
+    av_free(s->buffer);
+    s->buffer      = s->buf_ptr = buffer;
+    s->buffer_size = size;
+    s->buf_end     = buffer + size;
+    if (s->update_checksum)
+        s->checksum_ptr = buffer;
+}
+
+/**
+ * Write the buffered bytes and then data with a single protocol call.
+ */
+static void writeout_buffered(AVIOContext *s, const uint8_t *data, int len)
+{
+    AVIOInternal *internal = s->opaque;
+    int buffered = s->buf_ptr - s->buffer;
+    URLIOVec iov[2] = { { s->buffer, buffered }, { (uint8_t *)data, len } };
+
+    if (s->update_checksum) {
+        s->checksum     = s->update_checksum(s->checksum, s->checksum_ptr,
+                                             s->buf_ptr - s->checksum_ptr);
+        s->checksum     = s->update_checksum(s->checksum, data, len);
+        s->checksum_ptr = s->buffer;
+    }
+    if (!s->error) {
+        int ret = ffurl_writev(internal->h, iov, 2);
+        if (ret < 0)
+            s->error = ret;
+    }
+    s->writeout_count ++;
+    s->pos       += buffered + len;
+    s->buf_ptr    = s->buffer;
+    s->must_flush = 0;
+}
+
 static void flush_buffer(AVIOContext *s)
 {
+    int full = s->write_flag && s->buf_ptr >= s->buf_end;
+
     if (s->write_flag && s->buf_ptr > s->buffer) {
         writeout(s, s->buffer, s->buf_ptr - s->buffer);
         if (s->update_checksum) {
@@ -160,6 +221,8 @@ static void flush_buffer(AVIOContext *s)
     s->buf_ptr = s->buffer;
     if (!s->write_flag)
         s->buf_end = s->buffer;
+    else if (full)
+        grow_write_buffer(s);
 }
 
 void avio_w8(AVIOContext *s, int b)
@@ -186,8 +249,22 @@ void ffio_fill(AVIOContext *s, int b, int count)
 
 void avio_write(AVIOContext *s, const unsigned char *buf, int size)
 {
-    if (s->direct && !s->update_checksum) {
+    /* Pass writes which would fill the buffer anyway to the protocol without
+     * copying them. The write callbacks given to avio_alloc_context() may
+     * expect no more than buffer_size bytes though. */
+    if (s->direct ||
+        size >= s->buffer_size && !s->max_packet_size &&
+        (s->write_packet == io_write_packet || s->write_packet == dyn_buf_write)) {
+        /* the buffered header and the payload are written together unless
+         * they would form separate packets */
+        if (s->write_packet == io_write_packet && !s->max_packet_size &&
+            s->buf_ptr > s->buffer) {
+            writeout_buffered(s, buf, size);
+            return;
+        }
         avio_flush(s);
+        if (s->update_checksum)
+            s->checksum = s->update_checksum(s->checksum, buf, size);
         writeout(s, buf, size);
         return;
     }
@@ -557,7 +634,12 @@ int avio_read(AVIOContext *s, unsigned char *buf, int size)
         if (len == 0 || s->write_flag) {
             if((s->direct || size > s->buffer_size) && !s->update_checksum) {
                 // bypass the buffer and read data directly into buf
-                if(s->read_packet)
+                if (s->read_packet == io_read_packet && !s->direct && !s->write_flag) {
+                    // and the bytes following it into the buffer
+                    AVIOInternal *internal = s->opaque;
+                    URLIOVec iov[2] = { { buf, size }, { s->buffer, s->buffer_size } };
+                    len = ffurl_readv(internal->h, iov, 2);
+                } else if(s->read_packet)
                     len = s->read_packet(s->opaque, buf, size);
 
                 if (len <= 0) {
@@ -567,6 +649,12 @@ int avio_read(AVIOContext *s, unsigned char *buf, int size)
                     if(len<0)
                         s->error= len;
                     break;
+                } else if (len > size) {
+                    s->pos += len;
+                    s->bytes_read += len;
+                    s->buf_ptr = s->buffer;
+                    s->buf_end = s->buffer + len - size;
+                    size = 0;
                 } else {
                     s->pos += len;
                     s->bytes_read += len;
@@ -820,6 +908,18 @@ static int64_t io_read_seek(void *opaque, int stream_index, int64_t timestamp, i
     return internal->h->prot->url_read_seek(internal->h, stream_index, timestamp, flags);
 }
 
+URLContext *ffio_geturlcontext(AVIOContext *s)
+{
+    AVIOInternal *internal;
+
+    if (!s)
+        return NULL;
+    internal = s->opaque;
+    if (internal && s->write_packet == io_write_packet)
+        return internal->h;
+    return NULL;
+}
+
 int ffio_fdopen(AVIOContext **s, URLContext *h)
 {
     AVIOInternal *internal = NULL;
@@ -1102,7 +1202,8 @@ int avio_read_to_bprint(AVIOContext *h, AVBPrint *pb, size_t max_size)
 int avio_accept(AVIOContext *s, AVIOContext **c)
 {
     int ret;
-    URLContext *sc = s->opaque;
+    AVIOInternal *internal = s->opaque;
+    URLContext *sc = internal->h;
     URLContext *cc = NULL;
     ret = ffurl_accept(sc, &cc);
     if (ret < 0)
@@ -1112,7 +1213,8 @@ int avio_accept(AVIOContext *s, AVIOContext **c)
 
 int avio_handshake(AVIOContext *c)
 {
-    URLContext *cc = c->opaque;
+    AVIOInternal *internal = c->opaque;
+    URLContext *cc = internal->h;
     return ffurl_handshake(cc);
 }
 
@@ -30,10 +30,15 @@
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
+#include "libavutil/md5.h"
 #include "libavutil/opt.h"
+#include "libavutil/random_seed.h"
 #include "libavutil/tree.h"
 #include "avformat.h"
 #include <fcntl.h>
+#if HAVE_DIRENT_H
+#include <dirent.h>
+#endif
 #if HAVE_IO_H
 #include <io.h>
 #endif
@@ -42,6 +47,7 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#include "internal.h"
 #include "os_support.h"
 #include "url.h"
 
@@ -63,6 +69,15 @@ typedef struct Context {
     URLContext *inner;
     int64_t cache_hit, cache_miss;
     int read_ahead_limit;
+
+    /* shared cache directory */
+    char *cache_dir;
+    int chunk_size;
+    int64_t max_size;
+    char key[33];
+    uint8_t *chunk;
+    int64_t chunk_index;
+    int chunk_len;
 } Context;
 
 static int cmp(const void *key, const void *node)
@@ -70,6 +85,67 @@ static int cmp(const void *key, const void *node)
     return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->logical_pos);
 }
 
+#if HAVE_DIRENT_H
+typedef struct ChunkFile {
+    char *path;
+    int64_t size;
+    time_t mtime;
+} ChunkFile;
+
+static int cmp_mtime(const void *a, const void *b)
+{
+    return FFDIFFSIGN(((const ChunkFile *)a)->mtime, ((const ChunkFile *)b)->mtime);
+}
+
+/**
+ * Remove the least recently written chunks of the cache directory until
+ * it holds at most max_size bytes.
+ */
+static void evict_chunks(URLContext *h)
+{
+    Context *c = h->priv_data;
+    ChunkFile *files = NULL;
+    int nb_files = 0, i;
+    int64_t total = 0;
+    struct dirent *entry;
+    DIR *dir = opendir(c->cache_dir);
+
+    if (!dir)
+        return;
+    while ((entry = readdir(dir))) {
+        struct stat st;
+        ChunkFile file;
+
+        if (!av_match_ext(entry->d_name, "chunk"))
+            continue;
+        file.path = av_asprintf("%s/%s", c->cache_dir, entry->d_name);
+        if (!file.path)
+            break;
+        if (stat(file.path, &st) < 0) {
+            av_free(file.path);
+            continue;
+        }
+        file.size  = st.st_size;
+        file.mtime = st.st_mtime;
+        if (av_dynarray2_add((void **)&files, &nb_files, sizeof(*files),
+                             (uint8_t *)&file) == NULL) {
+            av_free(file.path);
+            break;
+        }
+        total += file.size;
+    }
+    closedir(dir);
+
+    qsort(files, nb_files, sizeof(*files), cmp_mtime);
+    for (i = 0; i < nb_files; i++) {
+        if (total > c->max_size && unlink(files[i].path) >= 0)
+            total -= files[i].size;
+        av_free(files[i].path);
+    }
+    av_free(files);
+}
+#endif
+
 static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
 {
     char *buffername;
@@ -77,6 +153,26 @@ static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "cache:", &arg);
 
+    if (c->cache_dir) {
+        uint8_t md5[16];
+
+        av_md5_sum(md5, (const uint8_t *)arg, strlen(arg));
+        ff_data_to_hex(c->key, md5, sizeof(md5), 1);
+        c->key[32] = 0;
+
+        c->chunk = av_malloc(c->chunk_size);
+        if (!c->chunk)
+            return AVERROR(ENOMEM);
+        c->chunk_index = -1;
+        c->fd = -1;
+#if HAVE_DIRENT_H
+        if (c->max_size > 0)
+            evict_chunks(h);
+#endif
+        return ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
+                                    options, h->protocol_whitelist, h->protocol_blacklist);
+    }
+
     c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
     if (c->fd < 0){
         av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
@@ -153,12 +249,140 @@ fail:
     return ret;
 }
 
+static char *chunk_path(Context *c, int64_t index)
+{
+    return av_asprintf("%s/%s-%"PRId64".chunk", c->cache_dir, c->key, index);
+}
+
+static int read_chunk_file(Context *c, const char *path)
+{
+    int fd = avpriv_open(path, O_RDONLY);
+    int len = 0, ret;
+
+    if (fd < 0)
+        return AVERROR(errno);
+    while (len < c->chunk_size) {
+        ret = read(fd, c->chunk + len, c->chunk_size - len);
+        if (ret < 0) {
+            ret = AVERROR(errno);
+            close(fd);
+            return ret;
+        }
+        if (!ret)
+            break;
+        len += ret;
+    }
+    close(fd);
+    return len;
+}
+
+/**
+ * Publish a chunk in the cache directory. It is written to a temporary file
+ * first and renamed, so that the other processes never see it partially
+ * written.
+ */
+static void write_chunk_file(URLContext *h, const char *path)
+{
+    Context *c = h->priv_data;
+    char *tmp = av_asprintf("%s.%08x", path, av_get_random_seed());
+    int fd, ret = -1;
+
+    if (!tmp)
+        return;
+    fd = avpriv_open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        ret = write(fd, c->chunk, c->chunk_len) == c->chunk_len ? 0 : -1;
+        close(fd);
+        if (!ret)
+            ret = ff_rename(tmp, path, h);
+        if (ret < 0)
+            unlink(tmp);
+    }
+    if (ret < 0)
+        av_log(h, AV_LOG_WARNING, "Failed to write cache chunk %s\n", path);
+    av_free(tmp);
+}
+
+static int load_chunk(URLContext *h, int64_t index)
+{
+    Context *c = h->priv_data;
+    int64_t pos = index * c->chunk_size;
+    char *path = chunk_path(c, index);
+    int ret;
+
+    if (!path)
+        return AVERROR(ENOMEM);
+
+    c->chunk_index = -1;
+    ret = read_chunk_file(c, path);
+    if (ret >= 0) {
+        c->cache_hit++;
+        c->chunk_len = ret;
+    } else {
+        // Fetch the missing chunk from the source
+        if (c->inner_pos != pos) {
+            int64_t r = ffurl_seek(c->inner, pos, SEEK_SET);
+            if (r < 0) {
+                av_log(h, AV_LOG_ERROR, "Failed to perform internal seek\n");
+                av_free(path);
+                return r;
+            }
+            c->inner_pos = r;
+        }
+        ret = ffurl_read_complete(c->inner, c->chunk, c->chunk_size);
+        if (ret < 0) {
+            av_free(path);
+            return ret;
+        }
+        c->inner_pos += ret;
+        c->cache_miss++;
+        c->chunk_len = ret;
+        if (ret > 0)
+            write_chunk_file(h, path);
+    }
+    av_free(path);
+
+    c->chunk_index = index;
+    if (ret < c->chunk_size) {
+        c->is_true_eof = 1;
+        c->end = pos + ret;
+    } else
+        c->end = FFMAX(c->end, pos + ret);
+
+    return 0;
+}
+
+static int shared_cache_read(URLContext *h, unsigned char *buf, int size)
+{
+    Context *c = h->priv_data;
+    int64_t index  = c->logical_pos / c->chunk_size;
+    int     offset = c->logical_pos % c->chunk_size;
+    int ret;
+
+    if (index != c->chunk_index) {
+        ret = load_chunk(h, index);
+        if (ret < 0)
+            return ret;
+    }
+    if (offset >= c->chunk_len)
+        return 0;
+
+    size = FFMIN(size, c->chunk_len - offset);
+    memcpy(buf, c->chunk + offset, size);
+    c->logical_pos += size;
+
+    return size;
+}
+
 static int cache_read(URLContext *h, unsigned char *buf, int size)
 {
     Context *c= h->priv_data;
     CacheEntry *entry, *next[2] = {NULL, NULL};
     int64_t r;
 
+    if (c->cache_dir)
+        return shared_cache_read(h, buf, size);
+
     entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
 
     if (!entry)
@@ -239,7 +463,14 @@ static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
     if (whence == SEEK_CUR) {
         whence = SEEK_SET;
         pos += c->logical_pos;
-    } else if (whence == SEEK_END && c->is_true_eof) {
+    } else if (whence == SEEK_END && c->cache_dir && !c->is_true_eof) {
+        int64_t size = ffurl_seek(c->inner, 0, AVSEEK_SIZE);
+        if (size < 0)
+            return size;
+        c->is_true_eof = 1;
+        c->end = size;
+    }
+    if (whence == SEEK_END && c->is_true_eof) {
 resolve_eof:
         whence = SEEK_SET;
         pos += c->end;
@@ -251,6 +482,14 @@ resolve_eof:
         return pos;
     }
 
+    if (c->cache_dir) {
+        // The chunks are fetched with a seek on the source when read
+        if (whence != SEEK_SET || pos < 0)
+            return AVERROR(EINVAL);
+        c->logical_pos = pos;
+        return pos;
+    }
+
     //cache miss
     ret= ffurl_seek(c->inner, pos, whence);
     if ((whence == SEEK_SET && pos >= c->logical_pos ||
@@ -296,7 +535,9 @@ static int cache_close(URLContext *h)
     av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64"\n",
            c->cache_hit, c->cache_miss);
 
-    close(c->fd);
+    if (c->fd >= 0)
+        close(c->fd);
+    av_freep(&c->chunk);
     ffurl_close(c->inner);
     av_tree_enumerate(c->root, NULL, NULL, enu_free);
     av_tree_destroy(c->root);
@@ -309,6 +550,9 @@ static int cache_close(URLContext *h)
 
 static const AVOption options[] = {
     { "read_ahead_limit", "Amount in bytes that may be read ahead when seeking isn't supported, -1 for unlimited", OFFSET(read_ahead_limit), AV_OPT_TYPE_INT, { .i64 = 65536 }, -1, INT_MAX, D },
+    { "cache_dir", "Directory of a cache shared between processes", OFFSET(cache_dir), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { "cache_chunk_size", "Size in bytes of the chunks of the shared cache", OFFSET(chunk_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 4096, INT_MAX / 2, D },
+    { "cache_max_size", "Size in bytes above which the oldest chunks of the shared cache are removed, 0 for unlimited", OFFSET(max_size), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
     {NULL},
 };
 
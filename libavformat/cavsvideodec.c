@@ -66,4 +66,5 @@ static int cavsvideo_probe(AVProbeData *p)
     return 0;
 }
 
-FF_DEF_RAWVIDEO_DEMUXER(cavsvideo, "raw Chinese AVS (Audio Video Standard)", cavsvideo_probe, NULL, AV_CODEC_ID_CAVS)
+FF_DEF_RAWVIDEO_DEMUXER3(cavsvideo, "raw Chinese AVS (Audio Video Standard)", cavsvideo_probe, NULL, AV_CODEC_ID_CAVS,
+                         AVFMT_GENERIC_INDEX, AVPROBE_SCORE_EXTENSION + 1)
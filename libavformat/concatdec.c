@@ -23,6 +23,7 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 #include "libavutil/timestamp.h"
 #include "avformat.h"
 #include "internal.h"
@@ -63,6 +64,14 @@ typedef struct {
     ConcatMatchMode stream_match_mode;
     unsigned auto_convert;
     int segment_time_metadata;
+    int prefetch;
+#if HAVE_THREADS
+    /* the file following the current one, opened in the background */
+    pthread_t prefetch_thread;
+    int prefetch_running;
+    unsigned prefetch_fileno;
+    AVFormatContext *prefetch_avf;
+#endif
 } ConcatContext;
 
 static int concat_probe(AVProbeData *probe)
@@ -286,6 +295,86 @@ static int match_streams(AVFormatContext *avf)
     return 0;
 }
 
+static int open_input(AVFormatContext *avf, ConcatFile *file,
+                      AVFormatContext **ret_avf)
+{
+    AVFormatContext *s;
+    int ret;
+
+    s = avformat_alloc_context();
+    if (!s)
+        return AVERROR(ENOMEM);
+
+    s->interrupt_callback = avf->interrupt_callback;
+
+    if ((ret = ff_copy_whiteblacklists(s, avf)) < 0) {
+        avformat_free_context(s);
+        return ret;
+    }
+
+    if ((ret = avformat_open_input(&s, file->url, NULL, NULL)) < 0 ||
+        (ret = avformat_find_stream_info(s, NULL)) < 0) {
+        avformat_close_input(&s);
+        return ret;
+    }
+    *ret_avf = s;
+    return 0;
+}
+
+#if HAVE_THREADS
+static void *prefetch_thread(void *arg)
+{
+    AVFormatContext *avf = arg;
+    ConcatContext *cat   = avf->priv_data;
+
+    if (open_input(avf, &cat->files[cat->prefetch_fileno], &cat->prefetch_avf) < 0)
+        cat->prefetch_avf = NULL;
+    return NULL;
+}
+
+static void prefetch_start(AVFormatContext *avf, unsigned fileno)
+{
+    ConcatContext *cat = avf->priv_data;
+    int ret;
+
+    if (!cat->prefetch || cat->prefetch_running || fileno >= cat->nb_files)
+        return;
+
+    cat->prefetch_fileno = fileno;
+    cat->prefetch_avf    = NULL;
+    ret = pthread_create(&cat->prefetch_thread, NULL, prefetch_thread, avf);
+    if (ret) {
+        av_log(avf, AV_LOG_WARNING, "Could not start prefetching: %s\n",
+               av_err2str(AVERROR(ret)));
+        return;
+    }
+    cat->prefetch_running = 1;
+}
+
+/**
+ * Wait for the file being prefetched.
+ *
+ * @return the context opened for fileno, NULL if another file was
+ *         prefetched or the opening failed
+ */
+static AVFormatContext *prefetch_finish(AVFormatContext *avf, unsigned fileno)
+{
+    ConcatContext *cat = avf->priv_data;
+    AVFormatContext *s;
+
+    if (!cat->prefetch_running)
+        return NULL;
+    pthread_join(cat->prefetch_thread, NULL);
+    cat->prefetch_running = 0;
+
+    s = cat->prefetch_avf;
+    cat->prefetch_avf = NULL;
+    if (s && cat->prefetch_fileno != fileno)
+        avformat_close_input(&s);
+    return s;
+}
+#endif
+
 static int open_file(AVFormatContext *avf, unsigned fileno)
 {
     ConcatContext *cat = avf->priv_data;
@@ -295,19 +384,12 @@ static int open_file(AVFormatContext *avf, unsigned fileno)
     if (cat->avf)
         avformat_close_input(&cat->avf);
 
-    cat->avf = avformat_alloc_context();
-    if (!cat->avf)
-        return AVERROR(ENOMEM);
-
-    cat->avf->interrupt_callback = avf->interrupt_callback;
-
-    if ((ret = ff_copy_whiteblacklists(cat->avf, avf)) < 0)
-        return ret;
-
-    if ((ret = avformat_open_input(&cat->avf, file->url, NULL, NULL)) < 0 ||
-        (ret = avformat_find_stream_info(cat->avf, NULL)) < 0) {
+#if HAVE_THREADS
+    cat->avf = prefetch_finish(avf, fileno);
+#endif
+    /* a failed prefetch is retried here so that errors are reported */
+    if (!cat->avf && (ret = open_input(avf, file, &cat->avf)) < 0) {
         av_log(avf, AV_LOG_ERROR, "Impossible to open '%s'\n", file->url);
-        avformat_close_input(&cat->avf);
         return ret;
     }
     cat->cur_file = file;
@@ -332,6 +414,9 @@ static int open_file(AVFormatContext *avf, unsigned fileno)
        if ((ret = avformat_seek_file(cat->avf, -1, INT64_MIN, file->inpoint, file->inpoint, 0)) < 0)
            return ret;
     }
+#if HAVE_THREADS
+    prefetch_start(avf, fileno + 1);
+#endif
     return 0;
 }
 
@@ -340,6 +425,10 @@ static int concat_read_close(AVFormatContext *avf)
     ConcatContext *cat = avf->priv_data;
     unsigned i;
 
+#if HAVE_THREADS
+    AVFormatContext *next = prefetch_finish(avf, cat->prefetch_fileno);
+    avformat_close_input(&next);
+#endif
     if (cat->avf)
         avformat_close_input(&cat->avf);
     for (i = 0; i < cat->nb_files; i++) {
@@ -715,6 +804,8 @@ static const AVOption options[] = {
       OFFSET(auto_convert), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, DEC },
     { "segment_time_metadata", "output file segment start time and duration as packet metadata",
       OFFSET(segment_time_metadata), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DEC },
+    { "prefetch", "open the next file in the background",
+      OFFSET(prefetch), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DEC },
     { NULL }
 };
 
@@ -33,6 +33,7 @@
 #include "libavutil/time_internal.h"
 
 #include "avc.h"
+#include "async_writer.h"
 #include "avformat.h"
 #include "avio_internal.h"
 #include "internal.h"
@@ -76,6 +77,12 @@ typedef struct OutputStream {
     char bandwidth_str[64];
 
     char codec_str[100];
+
+    /* streaming: the segment being written chunk by chunk */
+    int segment_open;
+    int64_t segment_start_pos;
+    int64_t chunk_start_pts;
+    int chunk_packets;
 } OutputStream;
 
 typedef struct DASHContext {
@@ -98,8 +105,53 @@ typedef struct DASHContext {
     const char *media_seg_name;
     AVRational min_frame_rate, max_frame_rate;
     int ambiguous_frame_rate;
+    int async_io_threads;
+    int async_io_queue_size;
+    FFAsyncWriter *writer;
+    int streaming;
+    int64_t frag_duration;
+    const char *method;
 } DASHContext;
 
+static void set_http_options(DASHContext *c, AVDictionary **options)
+{
+    if (c->method)
+        av_dict_set(options, "method", c->method, 0);
+}
+
+/**
+ * Open an output file, in memory if it is to be written by the async writer.
+ */
+static int dash_open_output(AVFormatContext *s, AVIOContext **pb, const char *url)
+{
+    DASHContext *c = s->priv_data;
+    AVDictionary *opts = NULL;
+    int ret;
+
+    set_http_options(c, &opts);
+    if (c->writer)
+        ret = ff_async_writer_open(c->writer, pb, url, &opts);
+    else
+        ret = s->io_open(s, pb, url, AVIO_FLAG_WRITE, &opts);
+    av_dict_free(&opts);
+    return ret;
+}
+
+/**
+ * Close a file opened with dash_open_output() and rename it to move_to if
+ * not NULL. The manifest is written after the segments queued before it.
+ */
+static int dash_close_output(AVFormatContext *s, AVIOContext **pb, const char *url,
+                             const char *move_to, int flags)
+{
+    DASHContext *c = s->priv_data;
+
+    if (c->writer)
+        return ff_async_writer_close(c->writer, pb, move_to, flags);
+    ff_format_io_close(s, pb);
+    return move_to ? avpriv_io_move(url, move_to) : 0;
+}
+
 static int dash_write(void *opaque, uint8_t *buf, int buf_size)
 {
     OutputStream *os = opaque;
@@ -178,6 +230,9 @@ static void dash_free(AVFormatContext *s)
 {
     DASHContext *c = s->priv_data;
     int i, j;
+
+    /* discards the files still open, and resets the os->out using them */
+    ff_async_writer_free(&c->writer);
     if (!c->streams)
         return;
     for (i = 0; i < s->nb_streams; i++) {
@@ -186,7 +241,9 @@ static void dash_free(AVFormatContext *s)
             av_write_trailer(os->ctx);
         if (os->ctx && os->ctx->pb)
             av_free(os->ctx->pb);
-        ff_format_io_close(s, &os->out);
+        if (os->segment_open)
+            ff_format_io_close(s, &os->out);
+        dash_close_output(s, &os->out, NULL, NULL, 0);
         if (os->ctx)
             avformat_free_context(os->ctx);
         for (j = 0; j < os->nb_segments; j++)
@@ -196,20 +253,34 @@ static void dash_free(AVFormatContext *s)
     av_freep(&c->streams);
 }
 
-static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext *c)
+static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext *c,
+                                int final)
 {
     int i, start_index = 0, start_number = 1;
+    char availability_str[80] = "";
+    int64_t offset;
     if (c->window_size) {
         start_index  = FFMAX(os->nb_segments   - c->window_size, 0);
         start_number = FFMAX(os->segment_index - c->window_size, 1);
     }
+    /* the first chunks of a segment can be fetched while it is written */
+    if (c->streaming && !final) {
+        int64_t chunk_duration = c->frag_duration;
+        if (!chunk_duration && c->max_frame_rate.num)
+            chunk_duration = av_rescale(AV_TIME_BASE, c->max_frame_rate.den,
+                                        c->max_frame_rate.num);
+        offset = FFMAX(c->last_duration - chunk_duration, 0);
+        snprintf(availability_str, sizeof(availability_str),
+                 " availabilityTimeOffset=\"%.3f\" availabilityTimeComplete=\"false\"",
+                 offset / (double)AV_TIME_BASE);
+    }
 
     if (c->use_template) {
         int timescale = c->use_timeline ? os->ctx->streams[0]->time_base.den : AV_TIME_BASE;
         avio_printf(out, "\t\t\t\t<SegmentTemplate timescale=\"%d\" ", timescale);
         if (!c->use_timeline)
             avio_printf(out, "duration=\"%"PRId64"\" ", c->last_duration);
-        avio_printf(out, "initialization=\"%s\" media=\"%s\" startNumber=\"%d\">\n", c->init_seg_name, c->media_seg_name, c->use_timeline ? start_number : 1);
+        avio_printf(out, "initialization=\"%s\" media=\"%s\" startNumber=\"%d\"%s>\n", c->init_seg_name, c->media_seg_name, c->use_timeline ? start_number : 1, availability_str);
         if (c->use_timeline) {
             int64_t cur_time = 0;
             avio_printf(out, "\t\t\t\t\t<SegmentTimeline>\n");
@@ -248,7 +319,7 @@ static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext
         }
         avio_printf(out, "\t\t\t\t</SegmentList>\n");
     } else {
-        avio_printf(out, "\t\t\t\t<SegmentList timescale=\"%d\" duration=\"%"PRId64"\" startNumber=\"%d\">\n", AV_TIME_BASE, c->last_duration, start_number);
+        avio_printf(out, "\t\t\t\t<SegmentList timescale=\"%d\" duration=\"%"PRId64"\" startNumber=\"%d\"%s>\n", AV_TIME_BASE, c->last_duration, start_number, availability_str);
         avio_printf(out, "\t\t\t\t\t<Initialization sourceURL=\"%s\" />\n", os->initfile);
         for (i = start_index; i < os->nb_segments; i++) {
             Segment *seg = os->segments[i];
@@ -438,6 +509,19 @@ static void format_date_now(char *buf, int size)
     }
 }
 
+/**
+ * Check the return value of the snprintf() of a file name into a buffer of
+ * the given size: a truncated name would write or remove the wrong file.
+ */
+static int path_fits(AVFormatContext *s, int len, int size)
+{
+    if (len < 0 || len >= size) {
+        av_log(s, AV_LOG_ERROR, "File name too long\n");
+        return 0;
+    }
+    return 1;
+}
+
 static int write_manifest(AVFormatContext *s, int final)
 {
     DASHContext *c = s->priv_data;
@@ -446,8 +530,10 @@ static int write_manifest(AVFormatContext *s, int final)
     int ret, i;
     AVDictionaryEntry *title = av_dict_get(s->metadata, "title", NULL, 0);
 
-    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", s->filename);
-    ret = s->io_open(s, &out, temp_filename, AVIO_FLAG_WRITE, NULL);
+    if (!path_fits(s, snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", s->filename),
+                   sizeof(temp_filename)))
+        return AVERROR(EINVAL);
+    ret = dash_open_output(s, &out, temp_filename);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Unable to open %s for writing\n", temp_filename);
         return ret;
@@ -523,7 +609,7 @@ static int write_manifest(AVFormatContext *s, int final)
                 avio_printf(out, " frameRate=\"%d/%d\"", st->avg_frame_rate.num, st->avg_frame_rate.den);
             avio_printf(out, ">\n");
 
-            output_segment_list(&c->streams[i], out, c);
+            output_segment_list(&c->streams[i], out, c, final);
             avio_printf(out, "\t\t\t</Representation>\n");
         }
         avio_printf(out, "\t\t</AdaptationSet>\n");
@@ -539,7 +625,7 @@ static int write_manifest(AVFormatContext *s, int final)
 
             avio_printf(out, "\t\t\t<Representation id=\"%d\" mimeType=\"audio/mp4\" codecs=\"%s\"%s audioSamplingRate=\"%d\">\n", i, os->codec_str, os->bandwidth_str, st->codec->sample_rate);
             avio_printf(out, "\t\t\t\t<AudioChannelConfiguration schemeIdUri=\"urn:mpeg:dash:23003:3:audio_channel_configuration:2011\" value=\"%d\" />\n", st->codec->channels);
-            output_segment_list(&c->streams[i], out, c);
+            output_segment_list(&c->streams[i], out, c, final);
             avio_printf(out, "\t\t\t</Representation>\n");
         }
         avio_printf(out, "\t\t</AdaptationSet>\n");
@@ -547,8 +633,8 @@ static int write_manifest(AVFormatContext *s, int final)
     avio_printf(out, "\t</Period>\n");
     avio_printf(out, "</MPD>\n");
     avio_flush(out);
-    ff_format_io_close(s, &out);
-    return avpriv_io_move(temp_filename, s->filename);
+    return dash_close_output(s, &out, temp_filename, s->filename,
+                             FF_ASYNC_WRITER_ORDERED);
 }
 
 static int dash_write_header(AVFormatContext *s)
@@ -564,6 +650,18 @@ static int dash_write_header(AVFormatContext *s)
     if (c->single_file)
         c->use_template = 0;
     c->ambiguous_frame_rate = 0;
+    if (c->streaming && c->single_file) {
+        av_log(s, AV_LOG_WARNING, "Streaming is not supported with single_file, disabling it\n");
+        c->streaming = 0;
+    }
+
+    /* single files are read back to find the segment indexes */
+    if (c->async_io_threads && !c->single_file &&
+        (ret = ff_async_writer_init(&c->writer, s, c->async_io_threads,
+                                    c->async_io_queue_size)) < 0) {
+        av_log(s, AV_LOG_ERROR, "Could not start the async writer threads\n");
+        return ret;
+    }
 
     av_strlcpy(c->dirname, s->filename, sizeof(c->dirname));
     ptr = strrchr(c->dirname, '/');
@@ -644,13 +742,20 @@ static int dash_write_header(AVFormatContext *s)
         if (c->single_file) {
             if (c->single_file_name)
                 dash_fill_tmpl_params(os->initfile, sizeof(os->initfile), c->single_file_name, i, 0, os->bit_rate, 0);
-            else
-                snprintf(os->initfile, sizeof(os->initfile), "%s-stream%d.m4s", basename, i);
+            else if (!path_fits(s, snprintf(os->initfile, sizeof(os->initfile), "%s-stream%d.m4s", basename, i),
+                                sizeof(os->initfile))) {
+                ret = AVERROR(EINVAL);
+                goto fail;
+            }
         } else {
             dash_fill_tmpl_params(os->initfile, sizeof(os->initfile), c->init_seg_name, i, 0, os->bit_rate, 0);
         }
-        snprintf(filename, sizeof(filename), "%s%s", c->dirname, os->initfile);
-        ret = s->io_open(s, &os->out, filename, AVIO_FLAG_WRITE, NULL);
+        if (!path_fits(s, snprintf(filename, sizeof(filename), "%s%s", c->dirname, os->initfile),
+                       sizeof(filename))) {
+            ret = AVERROR(EINVAL);
+            goto fail;
+        }
+        ret = dash_open_output(s, &os->out, filename);
         if (ret < 0)
             goto fail;
         os->init_start_pos = 0;
@@ -796,6 +901,65 @@ static int update_stream_extradata(AVFormatContext *s, OutputStream *os,
     return 0;
 }
 
+static int get_segment_path(AVFormatContext *s, OutputStream *os, int stream,
+                            char *filename, char *full_path, int size)
+{
+    DASHContext *c = s->priv_data;
+
+    dash_fill_tmpl_params(filename, size, c->media_seg_name, stream, os->segment_index, os->bit_rate, os->start_pts);
+    if (!path_fits(s, snprintf(full_path, size, "%s%s", c->dirname, filename), size))
+        return AVERROR(EINVAL);
+    return 0;
+}
+
+static int write_init_segment(AVFormatContext *s, OutputStream *os)
+{
+    DASHContext *c = s->priv_data;
+
+    av_write_frame(os->ctx, NULL);
+    os->init_range_length = avio_tell(os->ctx->pb);
+    if (!c->single_file)
+        return dash_close_output(s, &os->out, NULL, NULL, 0);
+    return 0;
+}
+
+/**
+ * Streaming: write the packets muxed since the last chunk as a moof/mdat,
+ * and send them at once. The segment is written directly to its final
+ * name, so that it can be fetched while it is written.
+ */
+static int dash_flush_chunk(AVFormatContext *s, int stream)
+{
+    DASHContext *c = s->priv_data;
+    OutputStream *os = &c->streams[stream];
+    int ret;
+
+    if (!os->init_range_length && (ret = write_init_segment(s, os)) < 0)
+        return ret;
+
+    if (!os->segment_open) {
+        char filename[1024], full_path[1024];
+        AVDictionary *opts = NULL;
+
+        if ((ret = get_segment_path(s, os, stream, filename, full_path, sizeof(filename))) < 0)
+            return ret;
+        set_http_options(c, &opts);
+        ret = s->io_open(s, &os->out, full_path, AVIO_FLAG_WRITE, &opts);
+        av_dict_free(&opts);
+        if (ret < 0)
+            return ret;
+        os->segment_open      = 1;
+        os->segment_start_pos = avio_tell(os->ctx->pb);
+        write_styp(os->ctx->pb);
+    }
+
+    av_write_frame(os->ctx, NULL);
+    avio_flush(os->ctx->pb);
+    avio_flush(os->out);
+    os->chunk_packets = 0;
+    return 0;
+}
+
 static int dash_flush(AVFormatContext *s, int final, int stream)
 {
     DASHContext *c = s->priv_data;
@@ -825,25 +989,40 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
                 continue;
         }
 
-        if (!os->init_range_length) {
-            av_write_frame(os->ctx, NULL);
-            os->init_range_length = avio_tell(os->ctx->pb);
-            if (!c->single_file)
-                ff_format_io_close(s, &os->out);
+        if (c->streaming) {
+            if ((ret = dash_flush_chunk(s, i)) < 0)
+                break;
+            get_segment_path(s, os, i, filename, full_path, sizeof(filename));
+            range_length = avio_tell(os->ctx->pb) - os->segment_start_pos;
+            ff_format_io_close(s, &os->out);
+            os->segment_open    = 0;
+            os->packets_written = 0;
+            add_segment(os, filename, os->start_pts, os->max_pts - os->start_pts, os->segment_start_pos, range_length, 0);
+            av_log(s, AV_LOG_VERBOSE, "Representation %d media segment %d written to: %s\n", i, os->segment_index, full_path);
+            continue;
         }
 
+        if (!os->init_range_length && (ret = write_init_segment(s, os)) < 0)
+            break;
+
         start_pos = avio_tell(os->ctx->pb);
 
         if (!c->single_file) {
-            dash_fill_tmpl_params(filename, sizeof(filename), c->media_seg_name, i, os->segment_index, os->bit_rate, os->start_pts);
-            snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, filename);
-            snprintf(temp_path, sizeof(temp_path), "%s.tmp", full_path);
-            ret = s->io_open(s, &os->out, temp_path, AVIO_FLAG_WRITE, NULL);
+            if ((ret = get_segment_path(s, os, i, filename, full_path, sizeof(filename))) < 0)
+                break;
+            if (!path_fits(s, snprintf(temp_path, sizeof(temp_path), "%s.tmp", full_path),
+                           sizeof(temp_path))) {
+                ret = AVERROR(EINVAL);
+                break;
+            }
+            ret = dash_open_output(s, &os->out, temp_path);
             if (ret < 0)
                 break;
             write_styp(os->ctx->pb);
-        } else {
-            snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, os->initfile);
+        } else if (!path_fits(s, snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, os->initfile),
+                              sizeof(full_path))) {
+            ret = AVERROR(EINVAL);
+            break;
         }
 
         av_write_frame(os->ctx, NULL);
@@ -854,8 +1033,7 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
         if (c->single_file) {
             find_index_range(s, full_path, start_pos, &index_length);
         } else {
-            ff_format_io_close(s, &os->out);
-            ret = avpriv_io_move(temp_path, full_path);
+            ret = dash_close_output(s, &os->out, temp_path, full_path, 0);
             if (ret < 0)
                 break;
         }
@@ -873,8 +1051,9 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
             if (remove > 0) {
                 for (j = 0; j < remove; j++) {
                     char filename[1024];
-                    snprintf(filename, sizeof(filename), "%s%s", c->dirname, os->segments[j]->file);
-                    unlink(filename);
+                    if (path_fits(s, snprintf(filename, sizeof(filename), "%s%s", c->dirname, os->segments[j]->file),
+                                  sizeof(filename)))
+                        unlink(filename);
                     av_free(os->segments[j]);
                 }
                 os->nb_segments -= remove;
@@ -955,7 +1134,15 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
             os->start_pts = os->max_pts;
         else
             os->start_pts = pkt->pts;
+    } else if (c->streaming && os->chunk_packets &&
+               av_compare_ts(pkt->pts - os->chunk_start_pts, st->time_base,
+                             c->frag_duration, AV_TIME_BASE_Q) >= 0) {
+        if ((ret = dash_flush_chunk(s, pkt->stream_index)) < 0)
+            return ret;
     }
+    if (!os->chunk_packets)
+        os->chunk_start_pts = pkt->pts;
+    os->chunk_packets++;
     if (os->max_pts == AV_NOPTS_VALUE)
         os->max_pts = pkt->pts + pkt->duration;
     else
@@ -967,6 +1154,7 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
 static int dash_write_trailer(AVFormatContext *s)
 {
     DASHContext *c = s->priv_data;
+    int ret, err;
 
     if (s->nb_streams > 0) {
         OutputStream *os = &c->streams[0];
@@ -980,21 +1168,27 @@ static int dash_write_trailer(AVFormatContext *s)
                                          s->streams[0]->time_base,
                                          AV_TIME_BASE_Q);
     }
-    dash_flush(s, 1, -1);
+    ret = dash_flush(s, 1, -1);
+
+    /* all the files must be written before they can be removed */
+    err = ff_async_writer_free(&c->writer);
+    if (ret >= 0)
+        ret = err;
 
     if (c->remove_at_exit) {
         char filename[1024];
         int i;
         for (i = 0; i < s->nb_streams; i++) {
             OutputStream *os = &c->streams[i];
-            snprintf(filename, sizeof(filename), "%s%s", c->dirname, os->initfile);
-            unlink(filename);
+            if (path_fits(s, snprintf(filename, sizeof(filename), "%s%s", c->dirname, os->initfile),
+                          sizeof(filename)))
+                unlink(filename);
         }
         unlink(s->filename);
     }
 
     dash_free(s);
-    return 0;
+    return ret;
 }
 
 #define OFFSET(x) offsetof(DASHContext, x)
@@ -1008,8 +1202,13 @@ static const AVOption options[] = {
     { "use_timeline", "Use SegmentTimeline in SegmentTemplate", OFFSET(use_timeline), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, E },
     { "single_file", "Store all segments in one file, accessed using byte ranges", OFFSET(single_file), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     { "single_file_name", "DASH-templated name to be used for baseURL. Implies storing all segments in one file, accessed using byte ranges", OFFSET(single_file_name), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
+    { "async_io_threads", "write segments and manifests from this many background threads", OFFSET(async_io_threads), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, E },
+    { "async_io_queue_size", "set the maximum number of complete files waiting to be written", OFFSET(async_io_queue_size), AV_OPT_TYPE_INT, { .i64 = 8 }, 1, INT_MAX, E },
     { "init_seg_name", "DASH-templated name to used for the initialization segment", OFFSET(init_seg_name), AV_OPT_TYPE_STRING, {.str = "init-stream$RepresentationID$.m4s"}, 0, 0, E },
     { "media_seg_name", "DASH-templated name to used for the media segments", OFFSET(media_seg_name), AV_OPT_TYPE_STRING, {.str = "chunk-stream$RepresentationID$-$Number%05d$.m4s"}, 0, 0, E },
+    { "streaming", "write the segments chunk by chunk, each chunk being sent as soon as it is muxed", OFFSET(streaming), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
+    { "frag_duration", "minimum duration (in microseconds) of the chunks written with streaming, 0 for a chunk per packet", OFFSET(frag_duration), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
+    { "method", "set the HTTP method used to write the files", OFFSET(method), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { NULL },
 };
 
@@ -19,9 +19,12 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE     /* Needed for O_DIRECT */
+
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "avformat.h"
 #if HAVE_DIRENT_H
 #include <dirent.h>
@@ -35,6 +38,12 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#if HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -67,11 +76,47 @@
 
 /* standard file protocol */
 
+/* alignment of the buffers, positions and sizes of the O_DIRECT I/O */
+#define DIRECT_ALIGN 4096
+
+typedef struct FileBlock {
+    uint8_t *data;
+    int64_t pos;        ///< file position of data[0]
+    int size;
+    int error;          ///< read error, or 0
+} FileBlock;
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
     int trunc;
     int blocksize;
+    int use_mmap;
+    uint8_t *map;       ///< the whole file mapped in memory, if use_mmap
+    int64_t map_size;
+    int64_t map_pos;    ///< position of the next read from the mapping
+    int async_depth;
+    int async_block_size;
+    int direct;
+#if HAVE_THREADS
+    /* Background I/O: a thread reads the blocks ahead of the reads, or
+     * writes the filled blocks behind the writes. The blocks in use are
+     * blocks[head] to blocks[head + nb_blocks - 1], modulo async_depth. */
+    int async;          ///< AVIO_FLAG_READ or AVIO_FLAG_WRITE if enabled
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint8_t *block_mem;
+    FileBlock *blocks;
+    int head, nb_blocks;
+    int64_t pos;        ///< position of the reads or writes of the caller
+    int64_t fetch_pos;  ///< position of the next block read ahead
+    int generation;     ///< incremented by each seek of the reads
+    int eof;
+    int error;          ///< first write error
+    int abort;
+    int direct_active;
+#endif
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -80,6 +125,10 @@ typedef struct FileContext {
 static const AVOption file_options[] = {
     { "truncate", "truncate existing files on write", offsetof(FileContext, trunc), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "map regular files in memory and read from the mapping", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "async_depth", "number of blocks read ahead or written behind by a background thread, 0 to disable", offsetof(FileContext, async_depth), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1024, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "async_block_size", "size of the blocks of the background I/O", offsetof(FileContext, async_block_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, DIRECT_ALIGN, 1 << 28, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "direct", "bypass the page cache with O_DIRECT, with the background I/O", offsetof(FileContext, direct), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
     { NULL }
 };
 
@@ -102,11 +151,86 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_THREADS
+static int file_read_async(FileContext *c, unsigned char *buf, int size)
+{
+    FileBlock *b;
+    int offset;
+
+    pthread_mutex_lock(&c->mutex);
+    for (;;) {
+        while (!c->nb_blocks)
+            pthread_cond_wait(&c->cond, &c->mutex);
+        b = &c->blocks[c->head];
+        offset = c->pos - b->pos;
+        if (b->error || !b->size || offset < b->size)
+            break;
+        c->head = (c->head + 1) % c->async_depth;
+        c->nb_blocks--;
+        pthread_cond_broadcast(&c->cond);
+    }
+    /* the last block, empty, holds the EOF or the read error */
+    if (!b->size) {
+        pthread_mutex_unlock(&c->mutex);
+        return b->error;
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    /* the thread does not touch the blocks in use */
+    size = FFMIN(size, b->size - offset);
+    memcpy(buf, b->data + offset, size);
+    c->pos += size;
+    return size;
+}
+
+static int file_write_async(FileContext *c, const unsigned char *buf, int size)
+{
+    FileBlock *b;
+    int ret;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!c->error && c->nb_blocks == c->async_depth)
+        pthread_cond_wait(&c->cond, &c->mutex);
+    ret = c->error;
+    b   = &c->blocks[(c->head + c->nb_blocks) % c->async_depth];
+    pthread_mutex_unlock(&c->mutex);
+    if (ret < 0)
+        return ret;
+
+    if (!b->size)
+        b->pos = c->pos;
+    size = FFMIN(size, c->async_block_size - b->size);
+    memcpy(b->data + b->size, buf, size);
+    b->size += size;
+    c->pos  += size;
+
+    if (b->size == c->async_block_size) {
+        pthread_mutex_lock(&c->mutex);
+        c->nb_blocks++;
+        pthread_cond_broadcast(&c->cond);
+        pthread_mutex_unlock(&c->mutex);
+    }
+    return size;
+}
+#endif /* HAVE_THREADS */
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_THREADS
+    if (c->async)
+        return file_read_async(c, buf, size);
+#endif
+    if (c->map) {
+        if (c->map_pos >= c->map_size)
+            return 0;
+        size = FFMIN(size, c->map_size - c->map_pos);
+        memcpy(buf, c->map + c->map_pos, size);
+        c->map_pos += size;
+        return size;
+    }
     ret = read(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
 }
@@ -116,10 +240,46 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_THREADS
+    if (c->async)
+        return file_write_async(c, buf, size);
+#endif
     ret = write(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
 }
 
+#if HAVE_SYS_UIO_H
+static int file_readv(URLContext *h, const URLIOVec *iov, int nb_iov)
+{
+    FileContext *c = h->priv_data;
+    struct iovec vec[URL_IOV_MAX];
+    int ret;
+
+#if HAVE_THREADS
+    if (c->async)
+        return file_read(h, iov[0].buf, iov[0].size);
+#endif
+    if (c->map)
+        return file_read(h, iov[0].buf, iov[0].size);
+    ret = readv(c->fd, vec, ff_url_iovec(vec, iov, nb_iov, c->blocksize));
+    return (ret == -1) ? AVERROR(errno) : ret;
+}
+
+static int file_writev(URLContext *h, const URLIOVec *iov, int nb_iov)
+{
+    FileContext *c = h->priv_data;
+    struct iovec vec[URL_IOV_MAX];
+    int ret;
+
+#if HAVE_THREADS
+    if (c->async)
+        return file_write(h, iov[0].buf, iov[0].size);
+#endif
+    ret = writev(c->fd, vec, ff_url_iovec(vec, iov, nb_iov, c->blocksize));
+    return (ret == -1) ? AVERROR(errno) : ret;
+}
+#endif
+
 static int file_get_handle(URLContext *h)
 {
     FileContext *c = h->priv_data;
@@ -189,6 +349,253 @@ static int file_move(URLContext *h_src, URLContext *h_dst)
 
 #if CONFIG_FILE_PROTOCOL
 
+#if HAVE_MMAP
+static void file_map(URLContext *h, const struct stat *st)
+{
+    FileContext *c = h->priv_data;
+    void *data;
+
+    if (!S_ISREG(st->st_mode) || st->st_size <= 0 ||
+        (uint64_t)st->st_size > SIZE_MAX)
+        return;
+
+    data = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, c->fd, 0);
+    if (data == MAP_FAILED) {
+        av_log(h, AV_LOG_WARNING, "Cannot map %s in memory, reading it instead: %s\n",
+               h->filename, av_err2str(AVERROR(errno)));
+        return;
+    }
+    c->map      = data;
+    c->map_size = st->st_size;
+    c->map_pos  = 0;
+}
+#endif /* HAVE_MMAP */
+
+#if HAVE_THREADS
+static void *file_read_thread(void *arg)
+{
+    FileContext *c = arg;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!c->abort) {
+        FileBlock *b;
+        int64_t pos;
+        int generation, ret;
+
+        if (c->eof || c->nb_blocks == c->async_depth) {
+            pthread_cond_wait(&c->cond, &c->mutex);
+            continue;
+        }
+        b          = &c->blocks[(c->head + c->nb_blocks) % c->async_depth];
+        pos        = c->fetch_pos;
+        generation = c->generation;
+        pthread_mutex_unlock(&c->mutex);
+
+        if (lseek(c->fd, pos, SEEK_SET) < 0)
+            ret = AVERROR(errno);
+        else if ((ret = read(c->fd, b->data, c->async_block_size)) < 0)
+            ret = AVERROR(errno);
+
+        pthread_mutex_lock(&c->mutex);
+        /* the block was read for the position before a seek */
+        if (generation != c->generation)
+            continue;
+        b->pos   = pos;
+        b->size  = FFMAX(ret, 0);
+        b->error = FFMIN(ret, 0);
+        if (ret <= 0)
+            c->eof = 1;
+        c->fetch_pos += b->size;
+        c->nb_blocks++;
+        pthread_cond_broadcast(&c->cond);
+    }
+    pthread_mutex_unlock(&c->mutex);
+    return NULL;
+}
+
+static int write_block(FileContext *c, FileBlock *b)
+{
+    int done = 0, ret;
+
+#ifdef O_DIRECT
+    /* the bytes not aligned, typically at the end, are written through the
+     * page cache */
+    if (c->direct_active && ((b->pos | b->size) & (DIRECT_ALIGN - 1))) {
+        fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) & ~O_DIRECT);
+        c->direct_active = 0;
+    }
+#endif
+    while (done < b->size) {
+        ret = write(c->fd, b->data + done, b->size - done);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return AVERROR(errno);
+        }
+        done += ret;
+    }
+    return 0;
+}
+
+static void *file_write_thread(void *arg)
+{
+    FileContext *c = arg;
+
+    pthread_mutex_lock(&c->mutex);
+    for (;;) {
+        FileBlock *b;
+        int ret;
+
+        if (!c->nb_blocks) {
+            if (c->abort)
+                break;
+            pthread_cond_wait(&c->cond, &c->mutex);
+            continue;
+        }
+        b = &c->blocks[c->head];
+        pthread_mutex_unlock(&c->mutex);
+
+        ret = write_block(c, b);
+
+        pthread_mutex_lock(&c->mutex);
+        if (ret < 0 && !c->error)
+            c->error = ret;
+        b->size = 0;
+        c->head = (c->head + 1) % c->async_depth;
+        c->nb_blocks--;
+        pthread_cond_broadcast(&c->cond);
+    }
+    pthread_mutex_unlock(&c->mutex);
+    return NULL;
+}
+
+/* queue the block being filled and wait until all the blocks are written */
+static int file_flush_async(FileContext *c)
+{
+    int ret;
+
+    pthread_mutex_lock(&c->mutex);
+    if (c->nb_blocks < c->async_depth &&
+        c->blocks[(c->head + c->nb_blocks) % c->async_depth].size) {
+        c->nb_blocks++;
+        pthread_cond_broadcast(&c->cond);
+    }
+    while (c->nb_blocks)
+        pthread_cond_wait(&c->cond, &c->mutex);
+    ret = c->error;
+    pthread_mutex_unlock(&c->mutex);
+    return ret;
+}
+
+static int64_t file_seek_async(URLContext *h, int64_t pos, int whence)
+{
+    FileContext *c = h->priv_data;
+    struct stat st;
+    int64_t ret;
+
+    if (c->async == AVIO_FLAG_WRITE) {
+        if ((ret = file_flush_async(c)) < 0)
+            return ret;
+        if (whence == AVSEEK_SIZE)
+            return fstat(c->fd, &st) < 0 ? AVERROR(errno) : st.st_size;
+        if ((ret = lseek(c->fd, pos, whence)) < 0)
+            return AVERROR(errno);
+        return c->pos = ret;
+    }
+
+    if (whence == AVSEEK_SIZE || whence == SEEK_END) {
+        if (fstat(c->fd, &st) < 0)
+            return AVERROR(errno);
+        if (whence == AVSEEK_SIZE)
+            return st.st_size;
+        pos += st.st_size;
+    } else if (whence == SEEK_CUR) {
+        pos += c->pos;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    pthread_mutex_lock(&c->mutex);
+    /* keep the blocks read ahead if pos is in one of them */
+    while (c->nb_blocks) {
+        FileBlock *b = &c->blocks[c->head];
+        if (pos < b->pos || !b->size)
+            break;
+        if (pos < b->pos + b->size) {
+            pthread_mutex_unlock(&c->mutex);
+            return c->pos = pos;
+        }
+        c->head = (c->head + 1) % c->async_depth;
+        c->nb_blocks--;
+    }
+    c->generation++;
+    c->nb_blocks = 0;
+    c->eof       = 0;
+    c->fetch_pos = c->direct_active ? pos & ~(int64_t)(DIRECT_ALIGN - 1) : pos;
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->mutex);
+    return c->pos = pos;
+}
+
+static int file_async_init(URLContext *h, int flags)
+{
+    FileContext *c = h->priv_data;
+    int i, ret;
+
+    if (c->direct_active)
+        c->async_block_size &= ~(DIRECT_ALIGN - 1);
+    c->blocks    = av_mallocz_array(c->async_depth, sizeof(*c->blocks));
+    c->block_mem = av_malloc((size_t)c->async_depth * c->async_block_size + DIRECT_ALIGN);
+    if (!c->blocks || !c->block_mem) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (i = 0; i < c->async_depth; i++)
+        c->blocks[i].data = c->block_mem + (-(uintptr_t)c->block_mem & (DIRECT_ALIGN - 1)) +
+                            (size_t)i * c->async_block_size;
+
+    c->pos       = lseek(c->fd, 0, SEEK_CUR);
+    c->fetch_pos = c->pos;
+    pthread_mutex_init(&c->mutex, NULL);
+    pthread_cond_init(&c->cond, NULL);
+    ret = pthread_create(&c->thread, NULL,
+                         flags & AVIO_FLAG_WRITE ? file_write_thread : file_read_thread, c);
+    if (ret) {
+        pthread_cond_destroy(&c->cond);
+        pthread_mutex_destroy(&c->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    c->async = flags & AVIO_FLAG_WRITE ? AVIO_FLAG_WRITE : AVIO_FLAG_READ;
+    return 0;
+fail:
+    av_freep(&c->blocks);
+    av_freep(&c->block_mem);
+    return ret;
+}
+
+static int file_async_close(FileContext *c)
+{
+    int ret = 0;
+
+    if (c->async == AVIO_FLAG_WRITE)
+        ret = file_flush_async(c);
+    pthread_mutex_lock(&c->mutex);
+    c->abort = 1;
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->mutex);
+    pthread_join(c->thread, NULL);
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->mutex);
+    av_freep(&c->blocks);
+    av_freep(&c->block_mem);
+    c->async = 0;
+    return ret;
+}
+#endif /* HAVE_THREADS */
+
 static int file_open(URLContext *h, const char *filename, int flags)
 {
     FileContext *c = h->priv_data;
@@ -212,12 +619,43 @@ static int file_open(URLContext *h, const char *filename, int flags)
 #ifdef O_BINARY
     access |= O_BINARY;
 #endif
-    fd = avpriv_open(filename, access, 0666);
+    /* the background I/O is either reads or writes */
+    if (flags & AVIO_FLAG_WRITE && flags & AVIO_FLAG_READ)
+        c->async_depth = 0;
+    fd = -1;
+#if HAVE_THREADS && defined(O_DIRECT)
+    if (c->direct && c->async_depth) {
+        fd = avpriv_open(filename, access | O_DIRECT, 0666);
+        if (fd != -1)
+            c->direct_active = 1;
+        else
+            av_log(h, AV_LOG_VERBOSE, "Cannot open %s with O_DIRECT: %s\n",
+                   filename, av_err2str(AVERROR(errno)));
+    }
+#endif
+    if (fd == -1)
+        fd = avpriv_open(filename, access, 0666);
     if (fd == -1)
         return AVERROR(errno);
     c->fd = fd;
 
-    h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
+    if (fstat(fd, &st) < 0)
+        return 0;
+    h->is_streamed = S_ISFIFO(st.st_mode);
+
+#if HAVE_MMAP
+    if (c->use_mmap && !(flags & AVIO_FLAG_WRITE))
+        file_map(h, &st);
+#endif
+#if HAVE_THREADS
+    if (c->async_depth && S_ISREG(st.st_mode) && !c->map) {
+        int ret = file_async_init(h, flags);
+        if (ret < 0) {
+            close(fd);
+            return ret;
+        }
+    }
+#endif
 
     return 0;
 }
@@ -228,6 +666,25 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+#if HAVE_THREADS
+    if (c->async)
+        return file_seek_async(h, pos, whence);
+#endif
+
+    if (c->map) {
+        if (whence == AVSEEK_SIZE)
+            return c->map_size;
+        if (whence == SEEK_CUR)
+            pos += c->map_pos;
+        else if (whence == SEEK_END)
+            pos += c->map_size;
+        else if (whence != SEEK_SET)
+            return AVERROR(EINVAL);
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        return c->map_pos = pos;
+    }
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
@@ -242,7 +699,19 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    return close(c->fd);
+    int ret = 0;
+
+#if HAVE_THREADS
+    if (c->async)
+        ret = file_async_close(c);
+#endif
+#if HAVE_MMAP
+    if (c->map)
+        munmap(c->map, c->map_size);
+#endif
+    if (close(c->fd) < 0 && !ret)
+        ret = AVERROR(errno);
+    return ret;
 }
 
 static int file_open_dir(URLContext *h)
@@ -334,6 +803,10 @@ const URLProtocol ff_file_protocol = {
     .url_open            = file_open,
     .url_read            = file_read,
     .url_write           = file_write,
+#if HAVE_SYS_UIO_H
+    .url_readv           = file_readv,
+    .url_writev          = file_writev,
+#endif
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
@@ -380,6 +853,10 @@ const URLProtocol ff_pipe_protocol = {
     .url_open            = pipe_open,
     .url_read            = file_read,
     .url_write           = file_write,
+#if HAVE_SYS_UIO_H
+    .url_readv           = file_readv,
+    .url_writev          = file_writev,
+#endif
     .url_get_file_handle = file_get_handle,
     .url_check           = file_check,
     .priv_data_size      = sizeof(FileContext),
@@ -35,12 +35,16 @@
 #include "avformat.h"
 #include "internal.h"
 #include "avio_internal.h"
+#include "avc.h"
 #include "flv.h"
 
 #define VALIDATE_INDEX_TS_THRESH 2500
 
 #define RESYNC_BUFFER_SIZE (1<<20)
 
+#define STREAM_HEADERS_SCAN_SIZE (1<<20)
+#define MAX_HEADER_TAGS 8
+
 typedef struct FLVContext {
     const AVClass *class; ///< Class for private options.
     int trust_metadata;   ///< configure streams according onMetaData
@@ -61,6 +65,11 @@ typedef struct FLVContext {
 
     int broken_sizes;
     int sum_flv_tag_size;
+
+    int parse_headers;    ///< read the stream parameters from the first tags
+    int64_t header_tags[MAX_HEADER_TAGS]; ///< tags consumed by flv_read_stream_headers()
+    int nb_header_tags;
+    int64_t data_offset;  ///< position of the first tag
 } FLVContext;
 
 static int probe(AVProbeData *p, int live)
@@ -627,6 +636,204 @@ static int flv_read_metabody(AVFormatContext *s, int64_t next_pos)
     return 0;
 }
 
+static void flv_set_audio_params(AVFormatContext *s, AVStream *st, int flags,
+                                 int *sample_rate, int *channels)
+{
+    FLVContext *flv = s->priv_data;
+    int bits_per_coded_sample;
+
+    *channels    = (flags & FLV_AUDIO_CHANNEL_MASK) == FLV_STEREO ? 2 : 1;
+    *sample_rate = 44100 << ((flags & FLV_AUDIO_SAMPLERATE_MASK) >>
+                             FLV_AUDIO_SAMPLERATE_OFFSET) >> 3;
+    bits_per_coded_sample = (flags & FLV_AUDIO_SAMPLESIZE_MASK) ? 16 : 8;
+    if (!st->codec->channels || !st->codec->sample_rate ||
+        !st->codec->bits_per_coded_sample) {
+        st->codec->channels              = *channels;
+        st->codec->channel_layout        = *channels == 1
+                                           ? AV_CH_LAYOUT_MONO
+                                           : AV_CH_LAYOUT_STEREO;
+        st->codec->sample_rate           = *sample_rate;
+        st->codec->bits_per_coded_sample = bits_per_coded_sample;
+    }
+    if (!st->codec->codec_id) {
+        flv_set_audio_codec(s, st, st->codec,
+                            flags & FLV_AUDIO_CODECID_MASK);
+        flv->last_sample_rate =
+        *sample_rate          = st->codec->sample_rate;
+        flv->last_channels    =
+        *channels             = st->codec->channels;
+    } else {
+        AVCodecContext ctx = {0};
+        ctx.sample_rate = *sample_rate;
+        ctx.bits_per_coded_sample = bits_per_coded_sample;
+        flv_set_audio_codec(s, st, &ctx, flags & FLV_AUDIO_CODECID_MASK);
+        *sample_rate = ctx.sample_rate;
+    }
+}
+
+static int flv_get_extradata(AVFormatContext *s, AVStream *st, int size)
+{
+    av_freep(&st->codec->extradata);
+    if (ff_get_extradata(st->codec, s->pb, size) < 0)
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+/* Set the codec parameters carried by the AAC and AVC sequence headers. */
+static void flv_set_extradata_params(AVFormatContext *s, AVStream *st)
+{
+    if (st->codec->codec_id == AV_CODEC_ID_AAC) {
+        MPEG4AudioConfig cfg;
+
+        if (avpriv_mpeg4audio_get_config(&cfg, st->codec->extradata,
+                                         st->codec->extradata_size * 8, 1) >= 0) {
+            if (cfg.channels) {
+                st->codec->channels       = cfg.channels;
+                st->codec->channel_layout = 0;
+            }
+            if (cfg.ext_sample_rate)
+                st->codec->sample_rate = cfg.ext_sample_rate;
+            else
+                st->codec->sample_rate = cfg.sample_rate;
+            av_log(s, AV_LOG_TRACE, "mp4a config channels %d sample rate %d\n",
+                   st->codec->channels, st->codec->sample_rate);
+        }
+    } else if (st->codec->codec_id == AV_CODEC_ID_H264) {
+        int width, height;
+
+        if (ff_avc_get_avcc_dimensions(st->codec->extradata,
+                                       st->codec->extradata_size,
+                                       &width, &height) >= 0) {
+            st->codec->width  = width;
+            st->codec->height = height;
+        }
+    }
+}
+
+static int flv_streams_ready(AVFormatContext *s)
+{
+    int i;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVCodecContext *avctx = s->streams[i]->codec;
+        if (avctx->codec_type != AVMEDIA_TYPE_AUDIO &&
+            avctx->codec_type != AVMEDIA_TYPE_VIDEO)
+            continue;
+        if (!avctx->codec_id)
+            return 0;
+        if ((avctx->codec_id == AV_CODEC_ID_AAC ||
+             avctx->codec_id == AV_CODEC_ID_H264) && !avctx->extradata)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * Read the tags following the file header until the codecs of the announced
+ * streams and their sequence headers are known, without reading the coded
+ * frames, then go back to the first tag. The onMetaData and sequence header
+ * tags consumed here are skipped by flv_read_packet().
+ */
+static int flv_read_stream_headers(AVFormatContext *s)
+{
+    FLVContext *flv = s->priv_data;
+    AVIOContext *pb = s->pb;
+    int64_t start   = avio_tell(pb);
+    int i, ret;
+
+    if (!pb->seekable &&
+        (ret = ffio_ensure_seekback(pb, STREAM_HEADERS_SCAN_SIZE)) < 0)
+        return ret;
+
+    while (!flv_streams_ready(s) &&
+           avio_tell(pb) - start < STREAM_HEADERS_SCAN_SIZE) {
+        int64_t pos   = avio_tell(pb), next;
+        int type      = avio_r8(pb) & 0x1F;
+        int size      = avio_rb24(pb);
+        unsigned dts  = avio_rb24(pb);
+        int consumed  = 0;
+        AVStream *st  = NULL;
+        enum AVMediaType codec_type;
+
+        dts |= (unsigned)avio_r8(pb) << 24;
+        avio_skip(pb, 3); /* stream id, always 0 */
+        if (avio_feof(pb))
+            break;
+        next = avio_tell(pb) + size;
+
+        if (type == FLV_TAG_TYPE_META) {
+            /* flv_read_packet() outputs the other script data tags */
+            if (size > 13 + 1 + 4 && !dts)
+                consumed = !flv_read_metabody(s, next);
+            goto next_tag;
+        } else if (type == FLV_TAG_TYPE_AUDIO) {
+            codec_type = AVMEDIA_TYPE_AUDIO;
+        } else if (type == FLV_TAG_TYPE_VIDEO) {
+            codec_type = AVMEDIA_TYPE_VIDEO;
+        } else
+            goto next_tag;
+
+        for (i = 0; i < s->nb_streams; i++)
+            if (s->streams[i]->codec->codec_type == codec_type)
+                st = s->streams[i];
+        if (!st || size < 2)
+            goto next_tag;
+
+        if (codec_type == AVMEDIA_TYPE_AUDIO) {
+            int flags = avio_r8(pb), sample_rate, channels;
+            if (!st->codec->codec_id)
+                flv_set_audio_params(s, st, flags, &sample_rate, &channels);
+        } else {
+            int flags = avio_r8(pb);
+            if ((flags & FLV_VIDEO_FRAMETYPE_MASK) == FLV_FRAME_VIDEO_INFO_CMD)
+                goto next_tag;
+            if (!st->codec->codec_id)
+                flv_set_video_codec(s, st, flags & FLV_VIDEO_CODECID_MASK, 0);
+        }
+
+        if ((st->codec->codec_id == AV_CODEC_ID_AAC ||
+             st->codec->codec_id == AV_CODEC_ID_H264) && !st->codec->extradata) {
+            int header_size = st->codec->codec_id == AV_CODEC_ID_H264 ? 5 : 2;
+            if (size > header_size && avio_r8(pb) == 0) {
+                avio_skip(pb, header_size - 2); /* composition time */
+                if ((ret = flv_get_extradata(s, st, size - header_size)) < 0)
+                    return ret;
+                flv_set_extradata_params(s, st);
+                consumed = 1;
+            }
+        }
+
+next_tag:
+        if (consumed)
+            flv->header_tags[flv->nb_header_tags++] = pos;
+        if (flv->nb_header_tags == MAX_HEADER_TAGS)
+            break;
+        avio_seek(pb, next + 4, SEEK_SET);
+    }
+
+    if (avio_seek(pb, start, SEEK_SET) < 0) {
+        av_log(s, AV_LOG_ERROR, "Could not go back to the first tag\n");
+        return AVERROR(EIO);
+    }
+
+    if (flv_streams_ready(s))
+        s->ctx_flags &= ~AVFMTCTX_NOHEADER;
+    else
+        av_log(s, AV_LOG_VERBOSE, "Stream parameters not found in the first tags\n");
+
+    return 0;
+}
+
+static int flv_is_header_tag(FLVContext *flv, int64_t pos)
+{
+    int i;
+
+    for (i = 0; i < flv->nb_header_tags; i++)
+        if (flv->header_tags[i] == pos)
+            return 1;
+    return 0;
+}
+
 static int flv_read_header(AVFormatContext *s)
 {
     int offset, flags;
@@ -649,10 +856,14 @@ static int flv_read_header(AVFormatContext *s)
     offset = avio_rb32(s->pb);
     avio_seek(s->pb, offset, SEEK_SET);
     avio_skip(s->pb, 4);
+    flv->data_offset = offset + 4;
 
     s->start_time = 0;
     flv->sum_flv_tag_size = 0;
 
+    if (flv->parse_headers)
+        return flv_read_stream_headers(s);
+
     return 0;
 }
 
@@ -665,14 +876,6 @@ static int flv_read_close(AVFormatContext *s)
     return 0;
 }
 
-static int flv_get_extradata(AVFormatContext *s, AVStream *st, int size)
-{
-    av_freep(&st->codec->extradata);
-    if (ff_get_extradata(st->codec, s->pb, size) < 0)
-        return AVERROR(ENOMEM);
-    return 0;
-}
-
 static int flv_queue_extradata(FLVContext *flv, AVIOContext *pb, int stream,
                                int size)
 {
@@ -892,6 +1095,9 @@ retry:
 
         next = size + avio_tell(s->pb);
 
+        if (flv->nb_header_tags && flv_is_header_tag(flv, pos))
+            goto skip;
+
         if (type == FLV_TAG_TYPE_AUDIO) {
             stream_type = FLV_STREAM_TYPE_AUDIO;
             flags    = avio_r8(s->pb);
@@ -1014,34 +1220,7 @@ retry_duration:
     }
 
     if (stream_type == FLV_STREAM_TYPE_AUDIO) {
-        int bits_per_coded_sample;
-        channels = (flags & FLV_AUDIO_CHANNEL_MASK) == FLV_STEREO ? 2 : 1;
-        sample_rate = 44100 << ((flags & FLV_AUDIO_SAMPLERATE_MASK) >>
-                                FLV_AUDIO_SAMPLERATE_OFFSET) >> 3;
-        bits_per_coded_sample = (flags & FLV_AUDIO_SAMPLESIZE_MASK) ? 16 : 8;
-        if (!st->codec->channels || !st->codec->sample_rate ||
-            !st->codec->bits_per_coded_sample) {
-            st->codec->channels              = channels;
-            st->codec->channel_layout        = channels == 1
-                                               ? AV_CH_LAYOUT_MONO
-                                               : AV_CH_LAYOUT_STEREO;
-            st->codec->sample_rate           = sample_rate;
-            st->codec->bits_per_coded_sample = bits_per_coded_sample;
-        }
-        if (!st->codec->codec_id) {
-            flv_set_audio_codec(s, st, st->codec,
-                                flags & FLV_AUDIO_CODECID_MASK);
-            flv->last_sample_rate =
-            sample_rate           = st->codec->sample_rate;
-            flv->last_channels    =
-            channels              = st->codec->channels;
-        } else {
-            AVCodecContext ctx = {0};
-            ctx.sample_rate = sample_rate;
-            ctx.bits_per_coded_sample = bits_per_coded_sample;
-            flv_set_audio_codec(s, st, &ctx, flags & FLV_AUDIO_CODECID_MASK);
-            sample_rate = ctx.sample_rate;
-        }
+        flv_set_audio_params(s, st, flags, &sample_rate, &channels);
     } else if (stream_type == FLV_STREAM_TYPE_VIDEO) {
         size -= flv_set_video_codec(s, st, flags & FLV_VIDEO_CODECID_MASK, 1);
     } else if (stream_type == FLV_STREAM_TYPE_DATA) {
@@ -1086,21 +1265,8 @@ retry_duration:
             if (st->codec->codec_id == AV_CODEC_ID_AAC && t && !strcmp(t->value, "Omnia A/XE"))
                 st->codec->extradata_size = 2;
 
-            if (st->codec->codec_id == AV_CODEC_ID_AAC && 0) {
-                MPEG4AudioConfig cfg;
-
-                if (avpriv_mpeg4audio_get_config(&cfg, st->codec->extradata,
-                                             st->codec->extradata_size * 8, 1) >= 0) {
-                st->codec->channels       = cfg.channels;
-                st->codec->channel_layout = 0;
-                if (cfg.ext_sample_rate)
-                    st->codec->sample_rate = cfg.ext_sample_rate;
-                else
-                    st->codec->sample_rate = cfg.sample_rate;
-                av_log(s, AV_LOG_TRACE, "mp4a config channels %d sample rate %d\n",
-                        st->codec->channels, st->codec->sample_rate);
-                }
-            }
+            if (flv->parse_headers)
+                flv_set_extradata_params(s, st);
 
             ret = FFERROR_REDO;
             goto leave;
@@ -1158,18 +1324,132 @@ leave:
     return ret;
 }
 
+/**
+ * Find the first tag starting at or after pos, checking the tag size written
+ * after it rather than reading the payloads.
+ */
+static int64_t flv_find_tag(AVFormatContext *s, int64_t pos, int64_t pos_limit)
+{
+    FLVContext *flv = s->priv_data;
+    AVIOContext *pb = s->pb;
+    uint8_t header[11];
+
+    for (pos = FFMAX(pos, flv->data_offset); pos < pos_limit; pos++) {
+        int type, size;
+
+        if (avio_seek(pb, pos, SEEK_SET) < 0 ||
+            avio_read(pb, header, sizeof(header)) != sizeof(header))
+            break;
+        type = header[0] & 0x1F;
+        size = AV_RB24(header + 1);
+        if ((type != FLV_TAG_TYPE_AUDIO && type != FLV_TAG_TYPE_VIDEO &&
+             type != FLV_TAG_TYPE_META) || AV_RB24(header + 8))
+            continue;
+        if (flv->broken_sizes)
+            return pos;
+        if (avio_seek(pb, pos + 11 + size, SEEK_SET) >= 0 &&
+            avio_rb32(pb) == size + 11)
+            return pos;
+    }
+    return AVERROR_EOF;
+}
+
+/**
+ * Return the timestamp of the next keyframe of the stream, walking the tag
+ * headers only.
+ */
+static int64_t flv_read_timestamp(AVFormatContext *s, int stream_index,
+                                  int64_t *ppos, int64_t pos_limit)
+{
+    AVIOContext *pb = s->pb;
+    AVStream *st    = s->streams[stream_index];
+    int64_t pos     = flv_find_tag(s, *ppos, pos_limit);
+    uint8_t header[12];
+
+    if (pos < 0)
+        return AV_NOPTS_VALUE;
+
+    while (pos < pos_limit) {
+        int type, size;
+        int64_t dts;
+
+        if (avio_seek(pb, pos, SEEK_SET) < 0 ||
+            avio_read(pb, header, sizeof(header)) != sizeof(header))
+            break;
+        type = header[0] & 0x1F;
+        size = AV_RB24(header + 1);
+        dts  = AV_RB24(header + 4) | (unsigned)header[7] << 24;
+
+        if (size > 0 &&
+            ((type == FLV_TAG_TYPE_VIDEO &&
+              st->codec->codec_type == AVMEDIA_TYPE_VIDEO &&
+              (header[11] & FLV_VIDEO_FRAMETYPE_MASK) == FLV_FRAME_KEY) ||
+             (type == FLV_TAG_TYPE_AUDIO &&
+              st->codec->codec_type == AVMEDIA_TYPE_AUDIO))) {
+            av_add_index_entry(st, pos, dts, size - 1, 0, AVINDEX_KEYFRAME);
+            *ppos = pos;
+            return dts;
+        }
+        pos += 11 + size + 4;
+    }
+    return AV_NOPTS_VALUE;
+}
+
 static int flv_read_seek(AVFormatContext *s, int stream_index,
                          int64_t ts, int flags)
 {
     FLVContext *flv = s->priv_data;
+    AVStream *st    = s->streams[stream_index];
+    int64_t pos_min, pos_max, ts_min, ts_max, pos;
+    int ret, index;
+
     flv->validate_count = 0;
-    return avio_seek_time(s->pb, stream_index, ts, flags);
+    ret = avio_seek_time(s->pb, stream_index, ts, flags);
+    if (ret != AVERROR(ENOSYS) || !s->pb->seekable)
+        return ret;
+
+    /* Use the keyframes index from onMetaData, or built while reading, as
+     * long as it covers the target; otherwise, search the tag headers. */
+    if (st->nb_index_entries &&
+        ts <= st->index_entries[st->nb_index_entries - 1].timestamp) {
+        index = av_index_search_timestamp(st, ts, flags);
+        if (index >= 0) {
+            AVIndexEntry *ie = &st->index_entries[index];
+            if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
+                return ret;
+            ff_update_cur_dts(s, st, ie->timestamp);
+            return 0;
+        }
+    }
+
+    pos_min = flv->data_offset;
+    ts_min  = flv_read_timestamp(s, stream_index, &pos_min, INT64_MAX);
+    if (ts_min == AV_NOPTS_VALUE)
+        return -1;
+    if ((ret = ff_find_last_ts(s, stream_index, &ts_max, &pos_max,
+                               flv_read_timestamp)) < 0)
+        return ret;
+
+    /* Fail if there is no keyframe in the seek direction, as the generic
+     * seeking did, instead of clamping to the first or last one. */
+    if (flags & AVSEEK_FLAG_BACKWARD ? ts < ts_min : ts > ts_max)
+        return -1;
+
+    pos = ff_gen_search(s, stream_index, ts, pos_min, pos_max, pos_max,
+                        ts_min, ts_max, flags, &ts, flv_read_timestamp);
+    if (pos < 0)
+        return -1;
+    if ((ret = avio_seek(s->pb, pos, SEEK_SET)) < 0)
+        return ret;
+    ff_update_cur_dts(s, st, ts);
+    return 0;
 }
 
 #define OFFSET(x) offsetof(FLVContext, x)
 #define VD AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_DECODING_PARAM
 static const AVOption options[] = {
     { "flv_metadata", "Allocate streams according to the onMetaData array", OFFSET(trust_metadata), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VD },
+    { "flv_parse_headers", "Read the stream parameters from the metadata and sequence headers when opening", OFFSET(parse_headers), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VD },
     { NULL }
 };
 
@@ -166,19 +166,63 @@ AVInputFormat *av_find_input_format(const char *short_name)
     return NULL;
 }
 
+enum nodat {
+    NO_ID3,
+    ID3_ALMOST_GREATER_PROBE,
+    ID3_GREATER_PROBE,
+    ID3_GREATER_MAX_PROBE,
+};
+
+/**
+ * Compute the score of fmt, read_probe() being skipped when it is known
+ * not to reach score_max.
+ */
+static int probe_format(AVInputFormat *fmt, AVProbeData *pd,
+                        enum nodat nodat, int score_max)
+{
+    int score = 0;
+    int ext   = fmt->extensions && av_match_ext(pd->filename, fmt->extensions);
+
+    if (fmt->read_probe) {
+        if (ext) {
+            switch (nodat) {
+            case NO_ID3:
+                score = 1;
+                break;
+            case ID3_GREATER_PROBE:
+            case ID3_ALMOST_GREATER_PROBE:
+                score = AVPROBE_SCORE_EXTENSION / 2 - 1;
+                break;
+            case ID3_GREATER_MAX_PROBE:
+                score = AVPROBE_SCORE_EXTENSION;
+                break;
+            }
+        }
+    } else if (ext) {
+        score = AVPROBE_SCORE_EXTENSION;
+    }
+    if (av_match_name(pd->mime_type, fmt->mime_type))
+        score = FFMAX(score, AVPROBE_SCORE_MIME);
+
+    if (fmt->read_probe &&
+        (!fmt->probe_score_max || FFMAX(fmt->probe_score_max, score) >= score_max)) {
+        int probe_score = fmt->read_probe(pd);
+        if (probe_score)
+            av_log(NULL, AV_LOG_TRACE, "Probing %s score:%d size:%d\n", fmt->name, probe_score, pd->buf_size);
+        score = FFMAX(score, probe_score);
+    }
+
+    return score;
+}
+
 AVInputFormat *av_probe_input_format3(AVProbeData *pd, int is_opened,
                                       int *score_ret)
 {
     AVProbeData lpd = *pd;
-    AVInputFormat *fmt1 = NULL, *fmt;
-    int score, score_max = 0;
+    AVInputFormat *fmt1, *fmt;
+    int pass, score, score_max = 0;
     const static uint8_t zerobuffer[AVPROBE_PADDING_SIZE];
-    enum nodat {
-        NO_ID3,
-        ID3_ALMOST_GREATER_PROBE,
-        ID3_GREATER_PROBE,
-        ID3_GREATER_MAX_PROBE,
-    } nodat = NO_ID3;
+    enum nodat nodat = NO_ID3;
 
     if (!lpd.buf)
         lpd.buf = (unsigned char *) zerobuffer;
@@ -196,40 +240,26 @@ AVInputFormat *av_probe_input_format3(AVProbeData *pd, int is_opened,
             nodat = ID3_GREATER_PROBE;
     }
 
+    /* The result is the format with the highest score, or none if that
+     * score is shared, whatever the order in which they are probed. So the
+     * formats with a bounded probe score, which are the costly ones, are
+     * probed in a second pass, where they can be skipped once a higher
+     * score than theirs has been found. */
     fmt = NULL;
-    while ((fmt1 = av_iformat_next(fmt1))) {
-        if (!is_opened == !(fmt1->flags & AVFMT_NOFILE) && strcmp(fmt1->name, "image2"))
-            continue;
-        score = 0;
-        if (fmt1->read_probe) {
-            score = fmt1->read_probe(&lpd);
-            if (score)
-                av_log(NULL, AV_LOG_TRACE, "Probing %s score:%d size:%d\n", fmt1->name, score, lpd.buf_size);
-            if (fmt1->extensions && av_match_ext(lpd.filename, fmt1->extensions)) {
-                switch (nodat) {
-                case NO_ID3:
-                    score = FFMAX(score, 1);
-                    break;
-                case ID3_GREATER_PROBE:
-                case ID3_ALMOST_GREATER_PROBE:
-                    score = FFMAX(score, AVPROBE_SCORE_EXTENSION / 2 - 1);
-                    break;
-                case ID3_GREATER_MAX_PROBE:
-                    score = FFMAX(score, AVPROBE_SCORE_EXTENSION);
-                    break;
-                }
-            }
-        } else if (fmt1->extensions) {
-            if (av_match_ext(lpd.filename, fmt1->extensions))
-                score = AVPROBE_SCORE_EXTENSION;
+    for (pass = 0; pass < 2; pass++) {
+        fmt1 = NULL;
+        while ((fmt1 = av_iformat_next(fmt1))) {
+            if (!is_opened == !(fmt1->flags & AVFMT_NOFILE) && strcmp(fmt1->name, "image2"))
+                continue;
+            if (!fmt1->probe_score_max != !pass)
+                continue;
+            score = probe_format(fmt1, &lpd, nodat, score_max);
+            if (score > score_max) {
+                score_max = score;
+                fmt       = fmt1;
+            } else if (score == score_max)
+                fmt = NULL;
         }
-        if (av_match_name(lpd.mime_type, fmt1->mime_type))
-            score = FFMAX(score, AVPROBE_SCORE_MIME);
-        if (score > score_max) {
-            score_max = score;
-            fmt       = fmt1;
-        } else if (score == score_max)
-            fmt = NULL;
     }
     if (nodat == ID3_GREATER_PROBE)
         score_max = FFMIN(AVPROBE_SCORE_EXTENSION / 2 - 1, score_max);
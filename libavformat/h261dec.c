@@ -59,4 +59,5 @@ static int h261_probe(AVProbeData *p)
     return 0;
 }
 
-FF_DEF_RAWVIDEO_DEMUXER(h261, "raw H.261", h261_probe, "h261", AV_CODEC_ID_H261)
+FF_DEF_RAWVIDEO_DEMUXER3(h261, "raw H.261", h261_probe, "h261", AV_CODEC_ID_H261,
+                         AVFMT_GENERIC_INDEX, AVPROBE_SCORE_EXTENSION)
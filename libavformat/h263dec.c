@@ -75,4 +75,5 @@ static int h263_probe(AVProbeData *p)
     return 0;
 }
 
-FF_DEF_RAWVIDEO_DEMUXER(h263, "raw H.263", h263_probe, NULL, AV_CODEC_ID_H263)
+FF_DEF_RAWVIDEO_DEMUXER3(h263, "raw H.263", h263_probe, NULL, AV_CODEC_ID_H263,
+                         AVFMT_GENERIC_INDEX, AVPROBE_SCORE_EXTENSION)
@@ -79,4 +79,5 @@ static int h264_probe(AVProbeData *p)
     return 0;
 }
 
-FF_DEF_RAWVIDEO_DEMUXER(h264, "raw H.264 video", h264_probe, "h26l,h264,264,avc", AV_CODEC_ID_H264)
+FF_DEF_RAWVIDEO_DEMUXER3(h264, "raw H.264 video", h264_probe, "h26l,h264,264,avc", AV_CODEC_ID_H264,
+                         AVFMT_GENERIC_INDEX, AVPROBE_SCORE_EXTENSION + 1)
@@ -61,4 +61,5 @@ static int hevc_probe(AVProbeData *p)
     return 0;
 }
 
-FF_DEF_RAWVIDEO_DEMUXER(hevc, "raw HEVC video", hevc_probe, "hevc,h265,265", AV_CODEC_ID_HEVC)
+FF_DEF_RAWVIDEO_DEMUXER3(hevc, "raw HEVC video", hevc_probe, "hevc,h265,265", AV_CODEC_ID_HEVC,
+                         AVFMT_GENERIC_INDEX, AVPROBE_SCORE_EXTENSION + 1)
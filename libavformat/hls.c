@@ -32,6 +32,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "internal.h"
@@ -46,6 +47,9 @@
 #define MPEG_TIME_BASE 90000
 #define MPEG_TIME_BASE_Q (AVRational){1, MPEG_TIME_BASE}
 
+/* larger segments are not prefetched, but read from the network */
+#define MAX_PREFETCH_SIZE (64 << 20)
+
 /*
  * An apple http stream consists of a playlist with media segment files,
  * played sequentially. There may be several playlists with the same
@@ -77,6 +81,7 @@ struct segment {
 };
 
 struct rendition;
+struct prefetch_segment;
 
 enum PlaylistType {
     PLS_TYPE_UNSPECIFIED,
@@ -148,6 +153,36 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* Set if input reads from a prefetched segment, instead of the network */
+    struct prefetch_segment *prefetched;
+};
+
+enum PrefetchState {
+    PREFETCH_QUEUED,
+    PREFETCH_RUNNING,
+    PREFETCH_DONE
+};
+
+/*
+ * A segment being downloaded in the background, before the demuxer
+ * needs it. Only the prefetch thread accesses data while it is running.
+ */
+struct prefetch_segment {
+    struct playlist *pls;
+    int seq_no;
+    char *url;
+    AVDictionary *opts;
+    int64_t url_offset;
+    int64_t size;
+    uint8_t *data;
+    unsigned int data_size;
+    int data_len;
+    int read_pos;
+    enum PrefetchState state;
+    int cancelled;
+    int ret;
+    struct prefetch_segment *next;
 };
 
 /*
@@ -199,6 +234,17 @@ typedef struct HLSContext {
     char *http_proxy;                    ///< holds the address of the HTTP proxy server
     AVDictionary *avio_opts;
     int strict_std_compliance;
+    int http_persistent;
+    int prefetch;
+#if HAVE_THREADS
+    pthread_t prefetch_thread;
+    pthread_mutex_t prefetch_lock;
+    pthread_cond_t prefetch_cond;
+    int prefetch_thread_started;
+    int prefetch_abort;
+    /* download queue, in the order the segments are needed */
+    struct prefetch_segment *prefetch_queue;
+#endif
 } HLSContext;
 
 static int read_chomp_line(AVIOContext *s, char *buf, int maxlen)
@@ -232,6 +278,8 @@ static void free_init_section_list(struct playlist *pls)
     pls->n_init_sections = 0;
 }
 
+static void close_input(struct playlist *pls);
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
@@ -247,7 +295,7 @@ static void free_playlist_list(HLSContext *c)
         av_packet_unref(&pls->pkt);
         av_freep(&pls->pb.buffer);
         if (pls->input)
-            ff_format_io_close(c->ctx, &pls->input);
+            close_input(pls);
         if (pls->ctx) {
             pls->ctx->pb = NULL;
             avformat_close_input(&pls->ctx);
@@ -589,16 +637,10 @@ static void update_options(char **dest, const char *name, void *src)
         av_freep(dest);
 }
 
-static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary *opts, AVDictionary *opts2)
+/* return 0 if url may be opened, only http(s) & file are allowed */
+static int check_url(const char *url)
 {
-    HLSContext *c = s->priv_data;
-    AVDictionary *tmp = NULL;
     const char *proto_name = NULL;
-    int ret;
-
-    av_dict_copy(&tmp, opts, 0);
-    av_dict_copy(&tmp, opts2, 0);
 
     if (av_strstart(url, "crypto", NULL)) {
         if (url[6] == '+' || url[6] == ':')
@@ -621,6 +663,22 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     else if (strcmp(proto_name, "file") || !strncmp(url, "file,", 5))
         return AVERROR_INVALIDDATA;
 
+    return 0;
+}
+
+static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
+                    AVDictionary *opts, AVDictionary *opts2)
+{
+    HLSContext *c = s->priv_data;
+    AVDictionary *tmp = NULL;
+    int ret;
+
+    if ((ret = check_url(url)) < 0)
+        return ret;
+
+    av_dict_copy(&tmp, opts, 0);
+    av_dict_copy(&tmp, opts2, 0);
+
     ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
     if (ret >= 0) {
         // update cookies on http response with setcookies.
@@ -665,6 +723,8 @@ static int parse_playlist(HLSContext *c, const char *url,
         av_dict_set(&opts, "cookies", c->cookies, 0);
         av_dict_set(&opts, "headers", c->headers, 0);
         av_dict_set(&opts, "http_proxy", c->http_proxy, 0);
+        if (c->http_persistent)
+            av_dict_set(&opts, "connection_pool", "1", 0);
 
         ret = c->ctx->io_open(c->ctx, &in, url, AVIO_FLAG_READ, &opts);
         av_dict_free(&opts);
@@ -1068,24 +1128,51 @@ static void intercept_id3(struct playlist *pls, uint8_t *buf,
         pls->is_id3_timestamped = (pls->id3_mpegts_timestamp != AV_NOPTS_VALUE);
 }
 
-static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
+static void set_segment_options(HLSContext *c, struct segment *seg,
+                                AVDictionary **opts)
 {
-    AVDictionary *opts = NULL;
-    int ret;
-
     // broker prior HTTP options that should be consistent across requests
-    av_dict_set(&opts, "user-agent", c->user_agent, 0);
-    av_dict_set(&opts, "cookies", c->cookies, 0);
-    av_dict_set(&opts, "headers", c->headers, 0);
-    av_dict_set(&opts, "http_proxy", c->http_proxy, 0);
-    av_dict_set(&opts, "seekable", "0", 0);
+    av_dict_set(opts, "user-agent", c->user_agent, 0);
+    av_dict_set(opts, "cookies", c->cookies, 0);
+    av_dict_set(opts, "headers", c->headers, 0);
+    av_dict_set(opts, "http_proxy", c->http_proxy, 0);
+    av_dict_set(opts, "seekable", "0", 0);
+    if (c->http_persistent)
+        av_dict_set(opts, "connection_pool", "1", 0);
 
     if (seg->size >= 0) {
         /* try to restrict the HTTP request to the part we want
          * (if this is in fact a HTTP request) */
-        av_dict_set_int(&opts, "offset", seg->url_offset, 0);
-        av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
+        av_dict_set_int(opts, "offset", seg->url_offset, 0);
+        av_dict_set_int(opts, "end_offset", seg->url_offset + seg->size, 0);
     }
+}
+
+/* set the crypto protocol URL and options of an AES-128 segment whose
+ * key is loaded */
+static void set_crypto_url(struct playlist *pls, struct segment *seg,
+                           char *url, int url_size, AVDictionary **opts)
+{
+    char iv[33], key[33];
+
+    ff_data_to_hex(iv, seg->iv, sizeof(seg->iv), 0);
+    ff_data_to_hex(key, pls->key, sizeof(pls->key), 0);
+    iv[32] = key[32] = '\0';
+    if (strstr(seg->url, "://"))
+        snprintf(url, url_size, "crypto+%s", seg->url);
+    else
+        snprintf(url, url_size, "crypto:%s", seg->url);
+
+    av_dict_set(opts, "key", key, 0);
+    av_dict_set(opts, "iv", iv, 0);
+}
+
+static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
+{
+    AVDictionary *opts = NULL;
+    int ret;
+
+    set_segment_options(c, seg, &opts);
 
     av_log(pls->parent, AV_LOG_VERBOSE, "HLS request for url '%s', offset %"PRId64", playlist %d\n",
            seg->url, seg->url_offset, pls->index);
@@ -1094,7 +1181,7 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
         ret = open_url(pls->parent, &pls->input, seg->url, c->avio_opts, opts);
     } else if (seg->key_type == KEY_AES_128) {
         AVDictionary *opts2 = NULL;
-        char iv[33], key[33], url[MAX_URL_SIZE];
+        char url[MAX_URL_SIZE];
         if (strcmp(seg->key, pls->key_url)) {
             AVIOContext *pb;
             if (open_url(pls->parent, &pb, seg->key, c->avio_opts, opts) == 0) {
@@ -1110,17 +1197,8 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
             }
             av_strlcpy(pls->key_url, seg->key, sizeof(pls->key_url));
         }
-        ff_data_to_hex(iv, seg->iv, sizeof(seg->iv), 0);
-        ff_data_to_hex(key, pls->key, sizeof(pls->key), 0);
-        iv[32] = key[32] = '\0';
-        if (strstr(seg->url, "://"))
-            snprintf(url, sizeof(url), "crypto+%s", seg->url);
-        else
-            snprintf(url, sizeof(url), "crypto:%s", seg->url);
-
         av_dict_copy(&opts2, c->avio_opts, 0);
-        av_dict_set(&opts2, "key", key, 0);
-        av_dict_set(&opts2, "iv", iv, 0);
+        set_crypto_url(pls, seg, url, sizeof(url), &opts2);
 
         ret = open_url(pls->parent, &pls->input, url, opts2, opts);
 
@@ -1156,6 +1234,319 @@ cleanup:
     return ret;
 }
 
+static void free_prefetch_segment(struct prefetch_segment *e)
+{
+    av_freep(&e->url);
+    av_dict_free(&e->opts);
+    av_freep(&e->data);
+    av_free(e);
+}
+
+static int prefetch_read(void *opaque, uint8_t *buf, int buf_size)
+{
+    struct prefetch_segment *e = opaque;
+    int len = FFMIN(buf_size, e->data_len - e->read_pos);
+
+    if (len <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, e->data + e->read_pos, len);
+    e->read_pos += len;
+    return len;
+}
+
+static void close_input(struct playlist *pls)
+{
+    if (pls->prefetched) {
+        av_freep(&pls->input->buffer);
+        av_freep(&pls->input);
+        free_prefetch_segment(pls->prefetched);
+        pls->prefetched = NULL;
+    } else {
+        ff_format_io_close(pls->parent, &pls->input);
+    }
+}
+
+/* read from a prefetched segment instead of opening it */
+static int open_prefetched(struct playlist *pls, struct prefetch_segment *e)
+{
+    uint8_t *buf = av_malloc(INITIAL_BUFFER_SIZE);
+
+    if (!buf ||
+        !(pls->input = avio_alloc_context(buf, INITIAL_BUFFER_SIZE, 0, e,
+                                          prefetch_read, NULL, NULL))) {
+        av_free(buf);
+        free_prefetch_segment(e);
+        return AVERROR(ENOMEM);
+    }
+    pls->prefetched     = e;
+    pls->cur_seg_offset = 0;
+    return 0;
+}
+
+#if HAVE_THREADS
+static int download_segment(HLSContext *c, struct prefetch_segment *e)
+{
+    AVFormatContext *s = c->ctx;
+    AVIOContext *pb = NULL;
+    int ret, cancelled = 0;
+
+    ret = s->io_open(s, &pb, e->url, AVIO_FLAG_READ, &e->opts);
+    if (ret < 0)
+        return ret;
+    if (e->url_offset && avio_seek(pb, e->url_offset, SEEK_SET) < 0) {
+        ret = AVERROR(EIO);
+        goto end;
+    }
+
+    while (!cancelled && (e->size < 0 || e->data_len < e->size)) {
+        int len = e->size < 0 ? INITIAL_BUFFER_SIZE :
+                  FFMIN(INITIAL_BUFFER_SIZE, e->size - e->data_len);
+        uint8_t *data;
+
+        if (e->data_len + len > MAX_PREFETCH_SIZE) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        data = av_fast_realloc(e->data, &e->data_size, e->data_len + len);
+        if (!data) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        e->data = data;
+
+        ret = avio_read(pb, e->data + e->data_len, len);
+        if (ret <= 0) {
+            ret = ret == AVERROR_EOF || !ret ? 0 : ret;
+            break;
+        }
+        e->data_len += ret;
+        ret = 0;
+
+        pthread_mutex_lock(&c->prefetch_lock);
+        cancelled = e->cancelled || c->prefetch_abort;
+        pthread_mutex_unlock(&c->prefetch_lock);
+    }
+
+end:
+    ff_format_io_close(s, &pb);
+    return ret;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    HLSContext *c = arg;
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    while (!c->prefetch_abort) {
+        struct prefetch_segment *e, **pe;
+        int ret;
+
+        for (e = c->prefetch_queue; e && e->state != PREFETCH_QUEUED; e = e->next)
+            ;
+        if (!e) {
+            pthread_cond_wait(&c->prefetch_cond, &c->prefetch_lock);
+            continue;
+        }
+        e->state = PREFETCH_RUNNING;
+        pthread_mutex_unlock(&c->prefetch_lock);
+
+        ret = download_segment(c, e);
+
+        pthread_mutex_lock(&c->prefetch_lock);
+        e->ret   = ret;
+        e->state = PREFETCH_DONE;
+        if (e->cancelled) {
+            for (pe = &c->prefetch_queue; *pe != e; pe = &(*pe)->next)
+                ;
+            *pe = e->next;
+            free_prefetch_segment(e);
+        }
+        pthread_cond_broadcast(&c->prefetch_cond);
+    }
+    pthread_mutex_unlock(&c->prefetch_lock);
+
+    return NULL;
+}
+
+/* must be called with the prefetch lock held */
+static void cancel_prefetch_segment(struct prefetch_segment **pe)
+{
+    struct prefetch_segment *e = *pe;
+
+    if (e->state == PREFETCH_RUNNING) {
+        /* freed by the thread once it notices */
+        e->cancelled = 1;
+        return;
+    }
+    *pe = e->next;
+    free_prefetch_segment(e);
+}
+
+/* cancel the prefetching of the segments of pls, or of all if NULL */
+static void cancel_prefetch(HLSContext *c, struct playlist *pls)
+{
+    struct prefetch_segment **pe;
+
+    if (!c->prefetch_thread_started)
+        return;
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    for (pe = &c->prefetch_queue; *pe;) {
+        if ((*pe)->cancelled || (pls && (*pe)->pls != pls))
+            pe = &(*pe)->next;
+        else
+            cancel_prefetch_segment(pe);
+    }
+    pthread_mutex_unlock(&c->prefetch_lock);
+}
+
+/**
+ * Take segment seq_no of pls out of the prefetch queue, waiting for its
+ * download to complete, and drop the earlier segments, not needed anymore.
+ * Return NULL if the segment is not downloaded yet, or failed.
+ */
+static struct prefetch_segment *take_prefetched(HLSContext *c,
+                                                struct playlist *pls, int seq_no)
+{
+    struct prefetch_segment **pe, *e = NULL;
+
+    if (!c->prefetch_thread_started)
+        return NULL;
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    for (pe = &c->prefetch_queue; *pe;) {
+        if ((*pe)->pls != pls || (*pe)->cancelled || (*pe)->seq_no > seq_no) {
+            pe = &(*pe)->next;
+        } else if ((*pe)->seq_no < seq_no) {
+            cancel_prefetch_segment(pe);
+        } else {
+            e = *pe;
+            break;
+        }
+    }
+    if (e && e->state == PREFETCH_QUEUED) {
+        /* opening it now is as fast as having it downloaded */
+        cancel_prefetch_segment(pe);
+        e = NULL;
+    }
+    while (e && e->state != PREFETCH_DONE) {
+        if (ff_check_interrupt(c->interrupt_callback)) {
+            e->cancelled = 1;
+            e = NULL;
+            break;
+        }
+        pthread_cond_wait(&c->prefetch_cond, &c->prefetch_lock);
+    }
+    if (e) {
+        /* the queue may have changed while waiting */
+        for (pe = &c->prefetch_queue; *pe != e; pe = &(*pe)->next)
+            ;
+        *pe = e->next;
+    }
+    pthread_mutex_unlock(&c->prefetch_lock);
+
+    if (e && e->ret < 0) {
+        av_log(pls->parent, AV_LOG_WARNING,
+               "Failed to prefetch segment %d of playlist %d\n",
+               seq_no, pls->index);
+        free_prefetch_segment(e);
+        e = NULL;
+    }
+    return e;
+}
+
+/* queue the download of the segments following the current one */
+static void schedule_prefetch(HLSContext *c, struct playlist *pls)
+{
+    struct prefetch_segment *e, **pe;
+    int seq_no;
+
+    if (!c->prefetch_thread_started)
+        return;
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    for (seq_no = pls->cur_seq_no + 1;
+         seq_no <= pls->cur_seq_no + c->prefetch &&
+         seq_no < pls->start_seq_no + pls->n_segments; seq_no++) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+        char url[MAX_URL_SIZE];
+
+        for (pe = &c->prefetch_queue; *pe; pe = &(*pe)->next)
+            if ((*pe)->pls == pls && (*pe)->seq_no == seq_no && !(*pe)->cancelled)
+                break;
+        if (*pe)
+            continue;
+
+        /* the key is loaded when the segment is opened */
+        if (seg->key_type == KEY_SAMPLE_AES ||
+            (seg->key_type == KEY_AES_128 && strcmp(seg->key, pls->key_url)))
+            break;
+        if (!(e = av_mallocz(sizeof(*e))))
+            break;
+        e->pls        = pls;
+        e->seq_no     = seq_no;
+        e->size       = seg->size;
+        e->url_offset = seg->key_type == KEY_NONE ? seg->url_offset : 0;
+        av_dict_copy(&e->opts, c->avio_opts, 0);
+        set_segment_options(c, seg, &e->opts);
+        av_strlcpy(url, seg->url, sizeof(url));
+        if (seg->key_type == KEY_AES_128) {
+            set_crypto_url(pls, seg, url, sizeof(url), &e->opts);
+            /* the range is the one of the encrypted data */
+            e->size = -1;
+        }
+        if (check_url(url) < 0 || !(e->url = av_strdup(url))) {
+            free_prefetch_segment(e);
+            break;
+        }
+        *pe = e;
+    }
+    pthread_cond_broadcast(&c->prefetch_cond);
+    pthread_mutex_unlock(&c->prefetch_lock);
+}
+
+static int start_prefetch(HLSContext *c)
+{
+    int ret;
+
+    pthread_mutex_init(&c->prefetch_lock, NULL);
+    pthread_cond_init(&c->prefetch_cond, NULL);
+    if ((ret = pthread_create(&c->prefetch_thread, NULL, prefetch_thread, c))) {
+        pthread_cond_destroy(&c->prefetch_cond);
+        pthread_mutex_destroy(&c->prefetch_lock);
+        return AVERROR(ret);
+    }
+    c->prefetch_thread_started = 1;
+    return 0;
+}
+
+static void stop_prefetch(HLSContext *c)
+{
+    if (!c->prefetch_thread_started)
+        return;
+
+    pthread_mutex_lock(&c->prefetch_lock);
+    c->prefetch_abort = 1;
+    pthread_cond_broadcast(&c->prefetch_cond);
+    pthread_mutex_unlock(&c->prefetch_lock);
+    pthread_join(c->prefetch_thread, NULL);
+
+    while (c->prefetch_queue) {
+        struct prefetch_segment *e = c->prefetch_queue;
+        c->prefetch_queue = e->next;
+        free_prefetch_segment(e);
+    }
+    pthread_cond_destroy(&c->prefetch_cond);
+    pthread_mutex_destroy(&c->prefetch_lock);
+    c->prefetch_thread_started = 0;
+}
+#else
+#define take_prefetched(c, pls, seq_no) NULL
+#define schedule_prefetch(c, pls)
+#define cancel_prefetch(c, pls)
+#define stop_prefetch(c)
+#endif /* HAVE_THREADS */
+
 static int update_init_section(struct playlist *pls, struct segment *seg)
 {
     static const int max_init_section_size = 1024*1024;
@@ -1234,6 +1625,7 @@ restart:
     if (!v->input) {
         int64_t reload_interval;
         struct segment *seg;
+        struct prefetch_segment *e;
 
         /* Check that the playlist is still needed before opening a new
          * segment. */
@@ -1249,6 +1641,7 @@ restart:
         if (!v->needed) {
             av_log(v->parent, AV_LOG_INFO, "No longer receiving playlist %d\n",
                 v->index);
+            cancel_prefetch(c, v);
             return AVERROR_EOF;
         }
 
@@ -1294,7 +1687,11 @@ reload:
         if (ret)
             return ret;
 
-        ret = open_input(c, v, seg);
+        if ((e = take_prefetched(c, v, v->cur_seq_no)))
+            ret = open_prefetched(v, e);
+        else
+            ret = open_input(c, v, seg);
+        schedule_prefetch(c, v);
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback))
                 return AVERROR_EXIT;
@@ -1324,7 +1721,7 @@ reload:
 
         return ret;
     }
-    ff_format_io_close(v->parent, &v->input);
+    close_input(v);
     v->cur_seq_no++;
 
     c->cur_seq_no = v->cur_seq_no;
@@ -1701,6 +2098,17 @@ static int hls_read_header(AVFormatContext *s)
         }
     }
 
+    if (c->prefetch) {
+#if HAVE_THREADS
+        if ((ret = start_prefetch(c)) < 0) {
+            av_log(s, AV_LOG_ERROR, "Could not start the prefetch thread\n");
+            goto fail;
+        }
+#else
+        av_log(s, AV_LOG_WARNING, "Prefetching requires threads, disabled\n");
+#endif
+    }
+
     return 0;
 fail:
     free_playlist_list(c);
@@ -1740,7 +2148,8 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %d\n", i, pls->cur_seq_no);
         } else if (first && !pls->cur_needed && pls->needed) {
             if (pls->input)
-                ff_format_io_close(pls->parent, &pls->input);
+                close_input(pls);
+            cancel_prefetch(c, pls);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -1889,6 +2298,7 @@ static int hls_close(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
 
+    stop_prefetch(c);
     free_playlist_list(c);
     free_variant_list(c);
     free_rendition_list(c);
@@ -1942,11 +2352,13 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     seek_pls->cur_seq_no = seq_no;
     seek_pls->seek_stream_index = stream_index - seek_pls->stream_offset;
 
+    cancel_prefetch(c, NULL);
+
     for (i = 0; i < c->n_playlists; i++) {
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
         if (pls->input)
-            ff_format_io_close(pls->parent, &pls->input);
+            close_input(pls);
         av_packet_unref(&pls->pkt);
         reset_packet(&pls->pkt);
         pls->pb.eof_reached = 0;
@@ -1995,6 +2407,10 @@ static int hls_probe(AVProbeData *p)
 static const AVOption hls_options[] = {
     {"live_start_index", "segment index to start live streams at (negative values are from the end)",
         OFFSET(live_start_index), AV_OPT_TYPE_INT, {.i64 = -3}, INT_MIN, INT_MAX, FLAGS},
+    {"http_persistent", "reuse HTTP connections for playlists and segments",
+        OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS},
+    {"prefetch", "number of segments of each playlist to download ahead in a background thread",
+        OFFSET(prefetch), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
     {NULL}
 };
 
@@ -27,6 +27,7 @@
 #endif
 
 #include "libavutil/avassert.h"
+#include "libavutil/bprint.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/avstring.h"
@@ -34,6 +35,7 @@
 #include "libavutil/log.h"
 #include "libavutil/time_internal.h"
 
+#include "async_writer.h"
 #include "avformat.h"
 #include "avio_internal.h"
 #include "internal.h"
@@ -71,28 +73,21 @@ typedef enum {
     PLAYLIST_TYPE_NB,
 } PlaylistType;
 
-typedef struct HLSContext {
-    const AVClass *class;  // Class for private options.
+typedef enum {
+    SEGMENT_TYPE_MPEGTS,
+    SEGMENT_TYPE_FMP4,
+} SegmentType;
+
+/**
+ * State of one variant stream, i.e. of one media playlist and its segments.
+ */
+typedef struct VariantStream {
     unsigned number;
     int64_t sequence;
-    int64_t start_sequence;
-    AVOutputFormat *oformat;
-    AVOutputFormat *vtt_oformat;
 
     AVFormatContext *avf;
     AVFormatContext *vtt_avf;
 
-    float time;            // Set by a private option.
-    int max_nb_segments;   // Set by a private option.
-    int  wrap;             // Set by a private option.
-    uint32_t flags;        // enum HLSFlags
-    uint32_t pl_type;      // enum PlaylistType
-    char *segment_filename;
-
-    int use_localtime;      ///< flag to expand filename with localtime
-    int use_localtime_mkdir;///< flag to mkdir dirname in timebased filename
-    int allowcache;
-    int64_t recording_time;
     int has_video;
     int has_subtitle;
     int64_t start_pts;
@@ -110,6 +105,41 @@ typedef struct HLSContext {
     char *basename;
     char *vtt_basename;
     char *vtt_m3u8_name;
+    char *m3u8_name;
+    char *init_filename;  // path of the fMP4 initialization segment
+    char *init_uri;       // the same, relative to the playlist
+
+    AVStream **streams;
+    unsigned nb_streams;
+} VariantStream;
+
+typedef struct HLSContext {
+    const AVClass *class;  // Class for private options.
+    int64_t start_sequence;
+    AVOutputFormat *oformat;
+    AVOutputFormat *vtt_oformat;
+
+    VariantStream *var_streams;
+    unsigned nb_varstreams;
+    int *stream_var_index;   // variant stream of each input stream
+    int *stream_inner_index; // index of each input stream in its muxer
+
+    float time;            // Set by a private option.
+    int max_nb_segments;   // Set by a private option.
+    int  wrap;             // Set by a private option.
+    uint32_t flags;        // enum HLSFlags
+    uint32_t pl_type;      // enum PlaylistType
+    char *segment_filename;
+
+    int use_localtime;      ///< flag to expand filename with localtime
+    int use_localtime_mkdir;///< flag to mkdir dirname in timebased filename
+    int allowcache;
+    int64_t recording_time;
+    int segment_type;       // enum SegmentType
+    char *fmp4_init_filename;
+    char *var_stream_map;   ///< variant streams, "v:0,a:0 v:1,a:1"
+    char *master_pl_name;
+    int master_pl_written;
     char *baseurl;
     char *format_options_str;
     char *vtt_format_options_str;
@@ -125,9 +155,13 @@ typedef struct HLSContext {
 
     char *method;
 
+    int async_io_threads;
+    int async_io_queue_size;
+    FFAsyncWriter *writer;
+
 } HLSContext;
 
-static int hls_delete_old_segments(HLSContext *hls) {
+static int hls_delete_old_segments(HLSContext *hls, VariantStream *vs) {
 
     HLSSegment *segment, *previous_segment = NULL;
     float playlist_duration = 0.0f;
@@ -135,13 +169,13 @@ static int hls_delete_old_segments(HLSContext *hls) {
     char *dirname = NULL, *p, *sub_path;
     char *path = NULL;
 
-    segment = hls->segments;
+    segment = vs->segments;
     while (segment) {
         playlist_duration += segment->duration;
         segment = segment->next;
     }
 
-    segment = hls->old_segments;
+    segment = vs->old_segments;
     while (segment) {
         playlist_duration -= segment->duration;
         previous_segment = segment;
@@ -154,9 +188,9 @@ static int hls_delete_old_segments(HLSContext *hls) {
 
     if (segment) {
         if (hls->segment_filename) {
-            dirname = av_strdup(hls->segment_filename);
+            dirname = av_strdup(vs->basename);
         } else {
-            dirname = av_strdup(hls->avf->filename);
+            dirname = av_strdup(vs->avf->filename);
         }
         if (!dirname) {
             ret = AVERROR(ENOMEM);
@@ -264,17 +298,17 @@ static int hls_encryption_start(AVFormatContext *s)
     return 0;
 }
 
-static int hls_mux_init(AVFormatContext *s)
+static int hls_mux_init(AVFormatContext *s, VariantStream *vs)
 {
     HLSContext *hls = s->priv_data;
     AVFormatContext *oc;
     AVFormatContext *vtt_oc = NULL;
-    int i, ret;
+    int i, ret, nb_inner = 0;
 
-    ret = avformat_alloc_output_context2(&hls->avf, hls->oformat, NULL, NULL);
+    ret = avformat_alloc_output_context2(&vs->avf, hls->oformat, NULL, NULL);
     if (ret < 0)
         return ret;
-    oc = hls->avf;
+    oc = vs->avf;
 
     oc->oformat            = hls->oformat;
     oc->interrupt_callback = s->interrupt_callback;
@@ -284,36 +318,41 @@ static int hls_mux_init(AVFormatContext *s)
     oc->io_close           = s->io_close;
     av_dict_copy(&oc->metadata, s->metadata, 0);
 
-    if(hls->vtt_oformat) {
-        ret = avformat_alloc_output_context2(&hls->vtt_avf, hls->vtt_oformat, NULL, NULL);
+    if (vs->has_subtitle) {
+        ret = avformat_alloc_output_context2(&vs->vtt_avf, hls->vtt_oformat, NULL, NULL);
         if (ret < 0)
             return ret;
-        vtt_oc          = hls->vtt_avf;
+        vtt_oc          = vs->vtt_avf;
         vtt_oc->oformat = hls->vtt_oformat;
         av_dict_copy(&vtt_oc->metadata, s->metadata, 0);
     }
 
-    for (i = 0; i < s->nb_streams; i++) {
+    for (i = 0; i < vs->nb_streams; i++) {
         AVStream *st;
         AVFormatContext *loc;
-        if (s->streams[i]->codec->codec_type == AVMEDIA_TYPE_SUBTITLE)
+        AVStream *outer_st = vs->streams[i];
+        if (outer_st->codec->codec_type == AVMEDIA_TYPE_SUBTITLE) {
             loc = vtt_oc;
-        else
+            hls->stream_inner_index[outer_st->index] = 0;
+        } else {
             loc = oc;
+            hls->stream_inner_index[outer_st->index] = nb_inner++;
+        }
 
         if (!(st = avformat_new_stream(loc, NULL)))
             return AVERROR(ENOMEM);
-        avcodec_copy_context(st->codec, s->streams[i]->codec);
-        st->sample_aspect_ratio = s->streams[i]->sample_aspect_ratio;
-        st->time_base = s->streams[i]->time_base;
+        avcodec_copy_context(st->codec, outer_st->codec);
+        st->sample_aspect_ratio = outer_st->sample_aspect_ratio;
+        st->time_base = outer_st->time_base;
     }
-    hls->start_pos = 0;
+    vs->start_pos = 0;
 
     return 0;
 }
 
 /* Create a new segment and append it to the segment list */
-static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls, double duration,
+static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
+                              VariantStream *vs, double duration,
                               int64_t pos, int64_t size)
 {
     HLSSegment *en = av_malloc(sizeof(*en));
@@ -324,27 +363,27 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls, double
     if (!en)
         return AVERROR(ENOMEM);
 
-    filename = av_basename(hls->avf->filename);
+    filename = av_basename(vs->avf->filename);
 
     if (hls->use_localtime_mkdir) {
         /* Possibly prefix with mkdir'ed subdir, if playlist share same
          * base path. */
-        tmp = av_strdup(s->filename);
+        tmp = av_strdup(vs->m3u8_name);
         if (!tmp) {
             av_free(en);
             return AVERROR(ENOMEM);
         }
 
         pl_dir = av_dirname(tmp);
-        p = hls->avf->filename;
+        p = vs->avf->filename;
         if (strstr(p, pl_dir) == p)
-            filename = hls->avf->filename + strlen(pl_dir) + 1;
+            filename = vs->avf->filename + strlen(pl_dir) + 1;
         av_free(tmp);
     }
     av_strlcpy(en->filename, filename, sizeof(en->filename));
 
-    if(hls->has_subtitle)
-        av_strlcpy(en->sub_filename, av_basename(hls->vtt_avf->filename), sizeof(en->sub_filename));
+    if(vs->has_subtitle)
+        av_strlcpy(en->sub_filename, av_basename(vs->vtt_avf->filename), sizeof(en->sub_filename));
     else
         en->sub_filename[0] = '\0';
 
@@ -358,32 +397,32 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls, double
         av_strlcpy(en->iv_string, hls->iv_string, sizeof(en->iv_string));
     }
 
-    if (!hls->segments)
-        hls->segments = en;
+    if (!vs->segments)
+        vs->segments = en;
     else
-        hls->last_segment->next = en;
+        vs->last_segment->next = en;
 
-    hls->last_segment = en;
+    vs->last_segment = en;
 
     // EVENT or VOD playlists imply sliding window cannot be used
     if (hls->pl_type != PLAYLIST_TYPE_NONE)
         hls->max_nb_segments = 0;
 
-    if (hls->max_nb_segments && hls->nb_entries >= hls->max_nb_segments) {
-        en = hls->segments;
-        hls->segments = en->next;
+    if (hls->max_nb_segments && vs->nb_entries >= hls->max_nb_segments) {
+        en = vs->segments;
+        vs->segments = en->next;
         if (en && hls->flags & HLS_DELETE_SEGMENTS &&
                 !(hls->flags & HLS_SINGLE_FILE || hls->wrap)) {
-            en->next = hls->old_segments;
-            hls->old_segments = en;
-            if ((ret = hls_delete_old_segments(hls)) < 0)
+            en->next = vs->old_segments;
+            vs->old_segments = en;
+            if ((ret = hls_delete_old_segments(hls, vs)) < 0)
                 return ret;
         } else
             av_free(en);
     } else
-        hls->nb_entries++;
+        vs->nb_entries++;
 
-    hls->sequence++;
+    vs->sequence++;
 
     return 0;
 }
@@ -405,7 +444,113 @@ static void set_http_options(AVDictionary **options, HLSContext *c)
         av_dict_set(options, "method", c->method, 0);
 }
 
-static int hls_window(AVFormatContext *s, int last)
+/* Return url relative to the directory of the playlist pl_name, if it lies
+ * inside of it. */
+static const char *get_relative_url(const char *pl_name, const char *url)
+{
+    const char *p = strrchr(pl_name, '/');
+    size_t dir_len;
+
+    if (!p)
+        return url;
+    dir_len = p - pl_name + 1;
+    if (!strncmp(pl_name, url, dir_len))
+        return url + dir_len;
+    return url;
+}
+
+/**
+ * Open an output file, in memory if it is to be written by the async writer.
+ * Segments are only written asynchronously when each one is a separate file.
+ */
+static int hls_open_output(AVFormatContext *s, AVIOContext **pb, const char *url,
+                           AVDictionary **options, int segment)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (hls->writer && !(segment && hls->flags & HLS_SINGLE_FILE))
+        return ff_async_writer_open(hls->writer, pb, url, options);
+    return s->io_open(s, pb, url, AVIO_FLAG_WRITE, options);
+}
+
+/**
+ * Close a file opened with hls_open_output() and rename it to move_to if
+ * not NULL. Playlists are written after the segments queued before them.
+ */
+static int hls_close_output(AVFormatContext *s, AVIOContext **pb, const char *url,
+                            const char *move_to, int segment)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (hls->writer && !(segment && hls->flags & HLS_SINGLE_FILE))
+        return ff_async_writer_close(hls->writer, pb, move_to,
+                                     segment ? 0 : FF_ASYNC_WRITER_ORDERED);
+    ff_format_io_close(s, pb);
+    if (move_to)
+        ff_rename(url, move_to, s);
+    return 0;
+}
+
+static int hls_write_master_playlist(AVFormatContext *s)
+{
+    HLSContext *hls = s->priv_data;
+    AVIOContext *out = NULL;
+    AVDictionary *options = NULL;
+    int ret, i, j;
+
+    set_http_options(&options, hls);
+    ret = hls_open_output(s, &out, hls->master_pl_name, &options, 0);
+    av_dict_free(&options);
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Failed to open master playlist file '%s'\n",
+               hls->master_pl_name);
+        return ret;
+    }
+
+    avio_printf(out, "#EXTM3U\n");
+    avio_printf(out, "#EXT-X-VERSION:%d\n",
+                hls->segment_type == SEGMENT_TYPE_FMP4 ? 7 : 3);
+
+    for (i = 0; i < hls->nb_varstreams; i++) {
+        VariantStream *vs = &hls->var_streams[i];
+        AVStream *vid_st = NULL;
+        int64_t bandwidth = 0;
+
+        for (j = 0; j < vs->nb_streams; j++) {
+            AVCodecContext *enc = vs->streams[j]->codec;
+            bandwidth += enc->bit_rate;
+            if (enc->codec_type == AVMEDIA_TYPE_VIDEO && !vid_st)
+                vid_st = vs->streams[j];
+        }
+        /* estimate it from the segments when the bitrate is not known */
+        if (!bandwidth && vs->segments) {
+            HLSSegment *en;
+            double duration = 0;
+            int64_t size = 0;
+
+            for (en = vs->segments; en; en = en->next) {
+                duration += en->duration;
+                size     += en->size;
+            }
+            if (duration > 0)
+                bandwidth = size * 8 / duration;
+        }
+        if (!bandwidth)
+            av_log(s, AV_LOG_WARNING, "Bandwidth of variant stream %d unknown\n", i);
+
+        avio_printf(out, "#EXT-X-STREAM-INF:BANDWIDTH=%"PRId64, bandwidth);
+        if (vid_st && vid_st->codec->width && vid_st->codec->height)
+            avio_printf(out, ",RESOLUTION=%dx%d",
+                        vid_st->codec->width, vid_st->codec->height);
+        avio_printf(out, "\n%s\n",
+                    get_relative_url(hls->master_pl_name, vs->m3u8_name));
+    }
+
+    hls->master_pl_written = 1;
+    return hls_close_output(s, &out, hls->master_pl_name, NULL, 0);
+}
+
+static int hls_window(AVFormatContext *s, VariantStream *vs, int last)
 {
     HLSContext *hls = s->priv_data;
     HLSSegment *en;
@@ -414,9 +559,10 @@ static int hls_window(AVFormatContext *s, int last)
     AVIOContext *out = NULL;
     AVIOContext *sub_out = NULL;
     char temp_filename[1024];
-    int64_t sequence = FFMAX(hls->start_sequence, hls->sequence - hls->nb_entries);
-    int version = hls->flags & HLS_SINGLE_FILE ? 4 : 3;
-    const char *proto = avio_find_protocol_name(s->filename);
+    int64_t sequence = FFMAX(hls->start_sequence, vs->sequence - vs->nb_entries);
+    int version = hls->segment_type == SEGMENT_TYPE_FMP4 ? 7 :
+                  hls->flags & HLS_SINGLE_FILE ? 4 : 3;
+    const char *proto = avio_find_protocol_name(vs->m3u8_name);
     int use_rename = proto && !strcmp(proto, "file");
     static unsigned warned_non_file;
     char *key_uri = NULL;
@@ -426,17 +572,29 @@ static int hls_window(AVFormatContext *s, int last)
     if (!use_rename && !warned_non_file++)
         av_log(s, AV_LOG_ERROR, "Cannot use rename on non file protocol, this may lead to races and temporarly partial files\n");
 
+    if (hls->master_pl_name && !hls->master_pl_written) {
+        int i, ready = 1;
+
+        /* wait for a segment of every variant, the bandwidth of those
+         * without a bitrate is estimated from their segments */
+        for (i = 0; i < hls->nb_varstreams; i++)
+            if (!hls->var_streams[i].segments)
+                ready = 0;
+        if (ready && (ret = hls_write_master_playlist(s)) < 0)
+            return ret;
+    }
+
     set_http_options(&options, hls);
-    snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", s->filename);
-    if ((ret = s->io_open(s, &out, temp_filename, AVIO_FLAG_WRITE, &options)) < 0)
+    snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", vs->m3u8_name);
+    if ((ret = hls_open_output(s, &out, temp_filename, &options, 0)) < 0)
         goto fail;
 
-    for (en = hls->segments; en; en = en->next) {
+    for (en = vs->segments; en; en = en->next) {
         if (target_duration < en->duration)
             target_duration = ceil(en->duration);
     }
 
-    hls->discontinuity_set = 0;
+    vs->discontinuity_set = 0;
     avio_printf(out, "#EXTM3U\n");
     avio_printf(out, "#EXT-X-VERSION:%d\n", version);
     if (hls->allowcache == 0 || hls->allowcache == 1) {
@@ -452,11 +610,14 @@ static int hls_window(AVFormatContext *s, int last)
 
     av_log(s, AV_LOG_VERBOSE, "EXT-X-MEDIA-SEQUENCE:%"PRId64"\n",
            sequence);
-    if((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && hls->discontinuity_set==0 ){
+    if((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && vs->discontinuity_set==0 ){
         avio_printf(out, "#EXT-X-DISCONTINUITY\n");
-        hls->discontinuity_set = 1;
+        vs->discontinuity_set = 1;
     }
-    for (en = hls->segments; en; en = en->next) {
+    if (vs->init_uri)
+        avio_printf(out, "#EXT-X-MAP:URI=\"%s%s\"\n",
+                    hls->baseurl ? hls->baseurl : "", vs->init_uri);
+    for (en = vs->segments; en; en = en->next) {
         if (hls->key_info_file && (!key_uri || strcmp(en->key_uri, key_uri) ||
                                     av_strcasecmp(en->iv_string, iv_string))) {
             avio_printf(out, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"", en->key_uri);
@@ -482,8 +643,8 @@ static int hls_window(AVFormatContext *s, int last)
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         avio_printf(out, "#EXT-X-ENDLIST\n");
 
-    if( hls->vtt_m3u8_name ) {
-        if ((ret = s->io_open(s, &sub_out, hls->vtt_m3u8_name, AVIO_FLAG_WRITE, &options)) < 0)
+    if( vs->vtt_m3u8_name ) {
+        if ((ret = hls_open_output(s, &sub_out, vs->vtt_m3u8_name, &options, 0)) < 0)
             goto fail;
         avio_printf(sub_out, "#EXTM3U\n");
         avio_printf(sub_out, "#EXT-X-VERSION:%d\n", version);
@@ -496,7 +657,7 @@ static int hls_window(AVFormatContext *s, int last)
         av_log(s, AV_LOG_VERBOSE, "EXT-X-MEDIA-SEQUENCE:%"PRId64"\n",
                sequence);
 
-        for (en = hls->segments; en; en = en->next) {
+        for (en = vs->segments; en; en = en->next) {
             avio_printf(sub_out, "#EXTINF:%f,\n", en->duration);
             if (hls->flags & HLS_SINGLE_FILE)
                  avio_printf(sub_out, "#EXT-X-BYTERANGE:%"PRIi64"@%"PRIi64"\n",
@@ -513,27 +674,32 @@ static int hls_window(AVFormatContext *s, int last)
 
 fail:
     av_dict_free(&options);
-    ff_format_io_close(s, &out);
-    ff_format_io_close(s, &sub_out);
-    if (ret >= 0 && use_rename)
-        ff_rename(temp_filename, s->filename, s);
+    if (out) {
+        int err = hls_close_output(s, &out, temp_filename,
+                                   ret >= 0 && use_rename ? vs->m3u8_name : NULL, 0);
+        ret = ret < 0 ? ret : err;
+    }
+    if (sub_out) {
+        int err = hls_close_output(s, &sub_out, vs->vtt_m3u8_name, NULL, 0);
+        ret = ret < 0 ? ret : err;
+    }
     return ret;
 }
 
-static int hls_start(AVFormatContext *s)
+static int hls_start(AVFormatContext *s, VariantStream *vs)
 {
     HLSContext *c = s->priv_data;
-    AVFormatContext *oc = c->avf;
-    AVFormatContext *vtt_oc = c->vtt_avf;
+    AVFormatContext *oc = vs->avf;
+    AVFormatContext *vtt_oc = vs->vtt_avf;
     AVDictionary *options = NULL;
     char *filename, iv_string[KEYSIZE*2 + 1];
     int err = 0;
 
     if (c->flags & HLS_SINGLE_FILE) {
-        av_strlcpy(oc->filename, c->basename,
+        av_strlcpy(oc->filename, vs->basename,
                    sizeof(oc->filename));
-        if (c->vtt_basename)
-            av_strlcpy(vtt_oc->filename, c->vtt_basename,
+        if (vs->vtt_basename)
+            av_strlcpy(vtt_oc->filename, vs->vtt_basename,
                   sizeof(vtt_oc->filename));
     } else {
         if (c->use_localtime) {
@@ -541,7 +707,7 @@ static int hls_start(AVFormatContext *s)
             struct tm *tm, tmpbuf;
             time(&now0);
             tm = localtime_r(&now0, &tmpbuf);
-            if (!strftime(oc->filename, sizeof(oc->filename), c->basename, tm)) {
+            if (!strftime(oc->filename, sizeof(oc->filename), vs->basename, tm)) {
                 av_log(oc, AV_LOG_ERROR, "Could not get segment filename with use_localtime\n");
                 return AVERROR(EINVAL);
             }
@@ -561,19 +727,19 @@ static int hls_start(AVFormatContext *s)
                 av_free(fn_copy);
             }
         } else if (av_get_frame_filename(oc->filename, sizeof(oc->filename),
-                                  c->basename, c->wrap ? c->sequence % c->wrap : c->sequence) < 0) {
-            av_log(oc, AV_LOG_ERROR, "Invalid segment filename template '%s' you can try use -use_localtime 1 with it\n", c->basename);
+                                  vs->basename, c->wrap ? vs->sequence % c->wrap : vs->sequence) < 0) {
+            av_log(oc, AV_LOG_ERROR, "Invalid segment filename template '%s' you can try use -use_localtime 1 with it\n", vs->basename);
             return AVERROR(EINVAL);
         }
-        if( c->vtt_basename) {
+        if( vs->vtt_basename) {
             if (av_get_frame_filename(vtt_oc->filename, sizeof(vtt_oc->filename),
-                              c->vtt_basename, c->wrap ? c->sequence % c->wrap : c->sequence) < 0) {
-                av_log(vtt_oc, AV_LOG_ERROR, "Invalid segment filename template '%s'\n", c->vtt_basename);
+                              vs->vtt_basename, c->wrap ? vs->sequence % c->wrap : vs->sequence) < 0) {
+                av_log(vtt_oc, AV_LOG_ERROR, "Invalid segment filename template '%s'\n", vs->vtt_basename);
                 return AVERROR(EINVAL);
             }
        }
     }
-    c->number++;
+    vs->number++;
 
     set_http_options(&options, c);
 
@@ -585,7 +751,7 @@ static int hls_start(AVFormatContext *s)
             goto fail;
         err = av_strlcpy(iv_string, c->iv_string, sizeof(iv_string));
         if (!err)
-            snprintf(iv_string, sizeof(iv_string), "%032"PRIx64, c->sequence);
+            snprintf(iv_string, sizeof(iv_string), "%032"PRIx64, vs->sequence);
         if ((err = av_dict_set(&options, "encryption_iv", iv_string, 0)) < 0)
            goto fail;
 
@@ -594,23 +760,24 @@ static int hls_start(AVFormatContext *s)
             err = AVERROR(ENOMEM);
             goto fail;
         }
-        err = s->io_open(s, &oc->pb, filename, AVIO_FLAG_WRITE, &options);
+        err = hls_open_output(s, &oc->pb, filename, &options, 1);
         av_free(filename);
         av_dict_free(&options);
         if (err < 0)
             return err;
     } else
-        if ((err = s->io_open(s, &oc->pb, oc->filename, AVIO_FLAG_WRITE, &options)) < 0)
+        if ((err = hls_open_output(s, &oc->pb, oc->filename, &options, 1)) < 0)
             goto fail;
-    if (c->vtt_basename) {
+    if (vs->vtt_basename) {
         set_http_options(&options, c);
-        if ((err = s->io_open(s, &vtt_oc->pb, vtt_oc->filename, AVIO_FLAG_WRITE, &options)) < 0)
+        if ((err = hls_open_output(s, &vtt_oc->pb, vtt_oc->filename, &options, 1)) < 0)
             goto fail;
     }
     av_dict_free(&options);
 
     /* We only require one PAT/PMT per segment. */
-    if (oc->oformat->priv_class && oc->priv_data) {
+    if (c->segment_type == SEGMENT_TYPE_MPEGTS &&
+        oc->oformat->priv_class && oc->priv_data) {
         char period[21];
 
         snprintf(period, sizeof(period), "%d", (INT_MAX / 2) - 1);
@@ -620,7 +787,7 @@ static int hls_start(AVFormatContext *s)
         av_opt_set(oc->priv_data, "pat_period", period, 0);
     }
 
-    if (c->vtt_basename) {
+    if (vs->vtt_basename) {
         err = avformat_write_header(vtt_oc,NULL);
         if (err < 0)
             return err;
@@ -633,158 +800,435 @@ fail:
     return err;
 }
 
-static int hls_write_header(AVFormatContext *s)
+/**
+ * Replace every "%v" in template with the variant stream index.
+ * A template without "%v" is only valid with a single variant stream.
+ */
+static int format_variant_name(AVFormatContext *s, char **name,
+                               const char *template, int var_index)
 {
     HLSContext *hls = s->priv_data;
-    int ret, i;
-    char *p;
-    const char *pattern = "%d.ts";
-    const char *pattern_localtime_fmt = "-%s.ts";
-    const char *vtt_pattern = "%d.vtt";
-    AVDictionary *options = NULL;
-    int basename_size;
-    int vtt_basename_size;
+    AVBPrint buf;
+    const char *p;
 
-    hls->sequence       = hls->start_sequence;
-    hls->recording_time = hls->time * AV_TIME_BASE;
-    hls->start_pts      = AV_NOPTS_VALUE;
+    if (!strstr(template, "%v") && hls->nb_varstreams > 1) {
+        av_log(s, AV_LOG_ERROR, "'%s' needs a %%v to tell the variant streams apart\n",
+               template);
+        return AVERROR(EINVAL);
+    }
 
-    if (hls->format_options_str) {
-        ret = av_dict_parse_string(&hls->format_options, hls->format_options_str, "=", ":", 0);
-        if (ret < 0) {
-            av_log(s, AV_LOG_ERROR, "Could not parse format options list '%s'\n", hls->format_options_str);
-            goto fail;
+    av_bprint_init(&buf, 0, AV_BPRINT_SIZE_UNLIMITED);
+    for (p = template; *p; p++) {
+        if (p[0] == '%' && p[1] == 'v') {
+            av_bprintf(&buf, "%d", var_index);
+            p++;
+        } else {
+            av_bprint_chars(&buf, *p, 1);
         }
     }
+    return av_bprint_finalize(&buf, name);
+}
 
-    for (i = 0; i < s->nb_streams; i++) {
-        hls->has_video +=
-            s->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO;
-        hls->has_subtitle +=
-            s->streams[i]->codec->codec_type == AVMEDIA_TYPE_SUBTITLE;
-    }
+/* Return the index of the nth stream of media type type, or -1. */
+static int get_nth_stream_index(AVFormatContext *s, enum AVMediaType type, int n)
+{
+    int i;
 
-    if (hls->has_video > 1)
-        av_log(s, AV_LOG_WARNING,
-               "More than a single video stream present, "
-               "expect issues decoding it.\n");
+    for (i = 0; i < s->nb_streams; i++)
+        if (s->streams[i]->codec->codec_type == type && !n--)
+            return i;
+    return -1;
+}
 
-    hls->oformat = av_guess_format("mpegts", NULL, NULL);
+static int parse_variant_stream_map(AVFormatContext *s)
+{
+    HLSContext *hls = s->priv_data;
+    char *map, *varstr, *saveptr1 = NULL, *saveptr2 = NULL, *stream_spec;
+    int i, ret = 0;
 
-    if (!hls->oformat) {
-        ret = AVERROR_MUXER_NOT_FOUND;
-        goto fail;
-    }
+    for (i = 0; i < s->nb_streams; i++)
+        hls->stream_var_index[i] = -1;
 
-    if(hls->has_subtitle) {
-        hls->vtt_oformat = av_guess_format("webvtt", NULL, NULL);
-        if (!hls->oformat) {
-            ret = AVERROR_MUXER_NOT_FOUND;
-            goto fail;
+    if (!hls->var_stream_map) {
+        /* all the streams go to a single variant stream */
+        hls->var_streams = av_mallocz(sizeof(*hls->var_streams));
+        if (!hls->var_streams)
+            return AVERROR(ENOMEM);
+        hls->nb_varstreams = 1;
+        hls->var_streams[0].streams = av_malloc_array(s->nb_streams,
+                                                      sizeof(*hls->var_streams[0].streams));
+        if (!hls->var_streams[0].streams)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < s->nb_streams; i++) {
+            hls->var_streams[0].streams[i] = s->streams[i];
+            hls->stream_var_index[i] = 0;
         }
+        hls->var_streams[0].nb_streams = s->nb_streams;
+        return 0;
     }
 
-    if (hls->segment_filename) {
-        hls->basename = av_strdup(hls->segment_filename);
-        if (!hls->basename) {
+    map = av_strdup(hls->var_stream_map);
+    if (!map)
+        return AVERROR(ENOMEM);
+
+    for (varstr = av_strtok(map, " \t", &saveptr1); varstr;
+         varstr = av_strtok(NULL, " \t", &saveptr1)) {
+        VariantStream *vs;
+
+        if ((ret = av_reallocp_array(&hls->var_streams, hls->nb_varstreams + 1,
+                                     sizeof(*hls->var_streams))) < 0) {
+            hls->nb_varstreams = 0;
+            goto end;
+        }
+        vs = &hls->var_streams[hls->nb_varstreams++];
+        memset(vs, 0, sizeof(*vs));
+        vs->streams = av_malloc_array(s->nb_streams, sizeof(*vs->streams));
+        if (!vs->streams) {
             ret = AVERROR(ENOMEM);
-            goto fail;
+            goto end;
         }
+
+        for (stream_spec = av_strtok(varstr, ",", &saveptr2); stream_spec;
+             stream_spec = av_strtok(NULL, ",", &saveptr2)) {
+            enum AVMediaType type;
+            char *end;
+            int n, idx;
+
+            switch (stream_spec[0]) {
+            case 'v': type = AVMEDIA_TYPE_VIDEO;    break;
+            case 'a': type = AVMEDIA_TYPE_AUDIO;    break;
+            case 's': type = AVMEDIA_TYPE_SUBTITLE; break;
+            default:  type = AVMEDIA_TYPE_UNKNOWN;
+            }
+            n = stream_spec[0] && stream_spec[1] == ':' ?
+                strtol(stream_spec + 2, &end, 10) : -1;
+            if (type == AVMEDIA_TYPE_UNKNOWN || n < 0 || *end ||
+                end == stream_spec + 2) {
+                av_log(s, AV_LOG_ERROR, "Invalid stream specifier '%s' in var_stream_map\n",
+                       stream_spec);
+                ret = AVERROR(EINVAL);
+                goto end;
+            }
+            idx = get_nth_stream_index(s, type, n);
+            if (idx < 0) {
+                av_log(s, AV_LOG_ERROR, "Stream '%s' in var_stream_map does not exist\n",
+                       stream_spec);
+                ret = AVERROR(EINVAL);
+                goto end;
+            }
+            if (hls->stream_var_index[idx] >= 0) {
+                av_log(s, AV_LOG_ERROR, "Stream '%s' is mapped to several variant streams\n",
+                       stream_spec);
+                ret = AVERROR(EINVAL);
+                goto end;
+            }
+            hls->stream_var_index[idx] = hls->nb_varstreams - 1;
+            vs->streams[vs->nb_streams++] = s->streams[idx];
+        }
+        if (!vs->nb_streams) {
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+    }
+
+    if (!hls->nb_varstreams) {
+        av_log(s, AV_LOG_ERROR, "Empty var_stream_map\n");
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+    for (i = 0; i < s->nb_streams; i++)
+        if (hls->stream_var_index[i] < 0)
+            av_log(s, AV_LOG_WARNING, "Stream #%d is not part of any variant "
+                   "stream, its packets are dropped\n", i);
+
+end:
+    av_free(map);
+    return ret;
+}
+
+/*
+ * Free the async writer, which discards the segments still open with it,
+ * and close the outputs opened without it.
+ */
+static int hls_free_outputs(AVFormatContext *s)
+{
+    HLSContext *hls = s->priv_data;
+    int i, ret = ff_async_writer_free(&hls->writer);
+
+    for (i = 0; i < hls->nb_varstreams; i++) {
+        VariantStream *vs = &hls->var_streams[i];
+
+        if (vs->avf)
+            ff_format_io_close(s, &vs->avf->pb);
+        if (vs->vtt_avf)
+            ff_format_io_close(s, &vs->vtt_avf->pb);
+    }
+    return ret;
+}
+
+static void hls_free_variant_streams(HLSContext *hls)
+{
+    int i;
+
+    for (i = 0; i < hls->nb_varstreams; i++) {
+        VariantStream *vs = &hls->var_streams[i];
+
+        hls_free_segments(vs->segments);
+        hls_free_segments(vs->old_segments);
+        av_freep(&vs->basename);
+        av_freep(&vs->vtt_basename);
+        av_freep(&vs->vtt_m3u8_name);
+        av_freep(&vs->m3u8_name);
+        av_freep(&vs->init_filename);
+        av_freep(&vs->init_uri);
+        av_freep(&vs->streams);
+        avformat_free_context(vs->avf);
+        vs->avf = NULL;
+        avformat_free_context(vs->vtt_avf);
+        vs->vtt_avf = NULL;
+    }
+    av_freep(&hls->var_streams);
+    hls->nb_varstreams = 0;
+    av_freep(&hls->stream_var_index);
+    av_freep(&hls->stream_inner_index);
+}
+
+/* Set up the file names of a variant stream. */
+static int hls_init_variant_names(AVFormatContext *s, VariantStream *vs, int var_index)
+{
+    HLSContext *hls = s->priv_data;
+    const char *seg_ext = hls->segment_type == SEGMENT_TYPE_FMP4 ? "m4s" : "ts";
+    char pattern[16], pattern_localtime_fmt[16], *p;
+    const char *vtt_pattern = "%d.vtt";
+    int ret, basename_size, vtt_basename_size;
+
+    snprintf(pattern, sizeof(pattern), "%%d.%s", seg_ext);
+    snprintf(pattern_localtime_fmt, sizeof(pattern_localtime_fmt), "-%%s.%s", seg_ext);
+
+    if ((ret = format_variant_name(s, &vs->m3u8_name, s->filename, var_index)) < 0)
+        return ret;
+
+    if (hls->segment_filename) {
+        if ((ret = format_variant_name(s, &vs->basename, hls->segment_filename, var_index)) < 0)
+            return ret;
     } else {
         if (hls->flags & HLS_SINGLE_FILE)
-            pattern = ".ts";
+            snprintf(pattern, sizeof(pattern), ".%s", seg_ext);
 
         if (hls->use_localtime) {
-            basename_size = strlen(s->filename) + strlen(pattern_localtime_fmt) + 1;
+            basename_size = strlen(vs->m3u8_name) + strlen(pattern_localtime_fmt) + 1;
         } else {
-            basename_size = strlen(s->filename) + strlen(pattern) + 1;
-        }
-        hls->basename = av_malloc(basename_size);
-        if (!hls->basename) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
+            basename_size = strlen(vs->m3u8_name) + strlen(pattern) + 1;
         }
+        vs->basename = av_malloc(basename_size);
+        if (!vs->basename)
+            return AVERROR(ENOMEM);
 
-        av_strlcpy(hls->basename, s->filename, basename_size);
+        av_strlcpy(vs->basename, vs->m3u8_name, basename_size);
 
-        p = strrchr(hls->basename, '.');
+        p = strrchr(vs->basename, '.');
         if (p)
             *p = '\0';
         if (hls->use_localtime) {
-            av_strlcat(hls->basename, pattern_localtime_fmt, basename_size);
+            av_strlcat(vs->basename, pattern_localtime_fmt, basename_size);
         } else {
-            av_strlcat(hls->basename, pattern, basename_size);
+            av_strlcat(vs->basename, pattern, basename_size);
         }
     }
 
-    if(hls->has_subtitle) {
+    if (hls->segment_type == SEGMENT_TYPE_FMP4) {
+        char *init_name;
+        const char *dir_end = strrchr(vs->m3u8_name, '/');
+        int dir_len = dir_end ? dir_end - vs->m3u8_name + 1 : 0;
+
+        /* with several variant streams, tell the init segments apart by
+         * default, even if the name has no %v */
+        if (hls->nb_varstreams > 1 && !strstr(hls->fmp4_init_filename, "%v")) {
+            const char *ext = strrchr(hls->fmp4_init_filename, '.');
+            int prefix_len = ext ? ext - hls->fmp4_init_filename : strlen(hls->fmp4_init_filename);
+            init_name = av_asprintf("%.*s_%d%s", prefix_len, hls->fmp4_init_filename,
+                                    var_index, ext ? ext : "");
+            if (!init_name)
+                return AVERROR(ENOMEM);
+        } else if ((ret = format_variant_name(s, &init_name, hls->fmp4_init_filename, var_index)) < 0) {
+            return ret;
+        }
+        /* the init segment is stored next to the playlist */
+        vs->init_uri      = init_name;
+        vs->init_filename = av_asprintf("%.*s%s", dir_len, vs->m3u8_name, init_name);
+        if (!vs->init_filename)
+            return AVERROR(ENOMEM);
+    }
 
+    if (vs->has_subtitle) {
         if (hls->flags & HLS_SINGLE_FILE)
             vtt_pattern = ".vtt";
-        vtt_basename_size = strlen(s->filename) + strlen(vtt_pattern) + 1;
-        hls->vtt_basename = av_malloc(vtt_basename_size);
-        if (!hls->vtt_basename) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
-        }
-        hls->vtt_m3u8_name = av_malloc(vtt_basename_size);
-        if (!hls->vtt_m3u8_name ) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
-        }
-        av_strlcpy(hls->vtt_basename, s->filename, vtt_basename_size);
-        p = strrchr(hls->vtt_basename, '.');
+        vtt_basename_size = strlen(vs->m3u8_name) + strlen(vtt_pattern) + 1;
+        vs->vtt_basename = av_malloc(vtt_basename_size);
+        if (!vs->vtt_basename)
+            return AVERROR(ENOMEM);
+        av_strlcpy(vs->vtt_basename, vs->m3u8_name, vtt_basename_size);
+        p = strrchr(vs->vtt_basename, '.');
         if (p)
             *p = '\0';
 
-        if( hls->subtitle_filename ) {
-            strcpy(hls->vtt_m3u8_name, hls->subtitle_filename);
+        if (hls->subtitle_filename) {
+            if ((ret = format_variant_name(s, &vs->vtt_m3u8_name, hls->subtitle_filename, var_index)) < 0)
+                return ret;
         } else {
-            strcpy(hls->vtt_m3u8_name, hls->vtt_basename);
-            av_strlcat(hls->vtt_m3u8_name, "_vtt.m3u8", vtt_basename_size);
+            vs->vtt_m3u8_name = av_asprintf("%s_vtt.m3u8", vs->vtt_basename);
+            if (!vs->vtt_m3u8_name)
+                return AVERROR(ENOMEM);
         }
-        av_strlcat(hls->vtt_basename, vtt_pattern, vtt_basename_size);
+        av_strlcat(vs->vtt_basename, vtt_pattern, vtt_basename_size);
     }
 
-    if ((ret = hls_mux_init(s)) < 0)
-        goto fail;
+    return 0;
+}
+
+/* Write the header of the fMP4 muxer, which is the initialization segment. */
+static int hls_write_init_segment(AVFormatContext *s, VariantStream *vs,
+                                  AVDictionary **options)
+{
+    HLSContext *hls = s->priv_data;
+    AVDictionary *io_options = NULL;
+    int ret;
+
+    set_http_options(&io_options, hls);
+    ret = hls_open_output(s, &vs->avf->pb, vs->init_filename, &io_options, 1);
+    av_dict_free(&io_options);
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Failed to open init segment '%s'\n", vs->init_filename);
+        return ret;
+    }
+    av_dict_set(options, "movflags", "frag_custom+empty_moov+default_base_moof", 0);
+    ret = avformat_write_header(vs->avf, options);
+    if (vs->avf->pb) {
+        int err = hls_close_output(s, &vs->avf->pb, vs->init_filename, NULL, 1);
+        ret = ret < 0 ? ret : err;
+    }
+    return ret;
+}
+
+static int hls_write_header(AVFormatContext *s)
+{
+    HLSContext *hls = s->priv_data;
+    int ret, i, j;
+    AVDictionary *options = NULL;
+
+    hls->recording_time = hls->time * AV_TIME_BASE;
+
+    if (hls->format_options_str) {
+        ret = av_dict_parse_string(&hls->format_options, hls->format_options_str, "=", ":", 0);
+        if (ret < 0) {
+            av_log(s, AV_LOG_ERROR, "Could not parse format options list '%s'\n", hls->format_options_str);
+            goto fail;
+        }
+    }
 
-    if ((ret = hls_start(s)) < 0)
+    if (hls->async_io_threads &&
+        (ret = ff_async_writer_init(&hls->writer, s, hls->async_io_threads,
+                                    hls->async_io_queue_size)) < 0) {
+        av_log(s, AV_LOG_ERROR, "Could not start the async writer threads\n");
         goto fail;
+    }
 
-    av_dict_copy(&options, hls->format_options, 0);
-    ret = avformat_write_header(hls->avf, &options);
-    if (av_dict_count(options)) {
-        av_log(s, AV_LOG_ERROR, "Some of provided format options in '%s' are not recognized\n", hls->format_options_str);
+    if (hls->segment_type == SEGMENT_TYPE_FMP4 && hls->flags & HLS_SINGLE_FILE) {
+        av_log(s, AV_LOG_ERROR, "fmp4 segments can not be used with single_file\n");
         ret = AVERROR(EINVAL);
         goto fail;
     }
-    //av_assert0(s->nb_streams == hls->avf->nb_streams);
-    for (i = 0; i < s->nb_streams; i++) {
-        AVStream *inner_st;
-        AVStream *outer_st = s->streams[i];
-        if (outer_st->codec->codec_type != AVMEDIA_TYPE_SUBTITLE)
-            inner_st = hls->avf->streams[i];
-        else if (hls->vtt_avf)
-            inner_st = hls->vtt_avf->streams[0];
-        else {
-            /* We have a subtitle stream, when the user does not want one */
-            inner_st = NULL;
-            continue;
-        }
-        avpriv_set_pts_info(outer_st, inner_st->pts_wrap_bits, inner_st->time_base.num, inner_st->time_base.den);
+
+    hls->stream_var_index   = av_malloc_array(s->nb_streams, sizeof(*hls->stream_var_index));
+    hls->stream_inner_index = av_malloc_array(s->nb_streams, sizeof(*hls->stream_inner_index));
+    if (!hls->stream_var_index || !hls->stream_inner_index) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = parse_variant_stream_map(s)) < 0)
+        goto fail;
+
+    hls->oformat = av_guess_format(hls->segment_type == SEGMENT_TYPE_FMP4 ?
+                                   "mp4" : "mpegts", NULL, NULL);
+
+    if (!hls->oformat) {
+        ret = AVERROR_MUXER_NOT_FOUND;
+        goto fail;
+    }
+
+    for (i = 0; i < hls->nb_varstreams; i++) {
+        VariantStream *vs = &hls->var_streams[i];
+
+        vs->sequence  = hls->start_sequence;
+        vs->start_pts = AV_NOPTS_VALUE;
+
+        for (j = 0; j < vs->nb_streams; j++) {
+            vs->has_video +=
+                vs->streams[j]->codec->codec_type == AVMEDIA_TYPE_VIDEO;
+            vs->has_subtitle +=
+                vs->streams[j]->codec->codec_type == AVMEDIA_TYPE_SUBTITLE;
+        }
+
+        if (vs->has_video > 1)
+            av_log(s, AV_LOG_WARNING,
+                   "More than a single video stream present, "
+                   "expect issues decoding it.\n");
+
+        if (vs->has_subtitle && !hls->vtt_oformat) {
+            hls->vtt_oformat = av_guess_format("webvtt", NULL, NULL);
+            if (!hls->vtt_oformat) {
+                ret = AVERROR_MUXER_NOT_FOUND;
+                goto fail;
+            }
+        }
+
+        if ((ret = hls_init_variant_names(s, vs, i)) < 0)
+            goto fail;
+
+        if ((ret = hls_mux_init(s, vs)) < 0)
+            goto fail;
+
+        av_dict_copy(&options, hls->format_options, 0);
+        if (hls->segment_type == SEGMENT_TYPE_FMP4) {
+            if ((ret = hls_write_init_segment(s, vs, &options)) < 0)
+                goto fail;
+            if ((ret = hls_start(s, vs)) < 0)
+                goto fail;
+        } else {
+            if ((ret = hls_start(s, vs)) < 0)
+                goto fail;
+            ret = avformat_write_header(vs->avf, &options);
+        }
+        if (av_dict_count(options)) {
+            av_log(s, AV_LOG_ERROR, "Some of provided format options in '%s' are not recognized\n", hls->format_options_str);
+            ret = AVERROR(EINVAL);
+            goto fail;
+        }
+        av_dict_free(&options);
+        if (ret < 0)
+            goto fail;
+
+        for (j = 0; j < vs->nb_streams; j++) {
+            AVStream *inner_st;
+            AVStream *outer_st = vs->streams[j];
+            if (outer_st->codec->codec_type != AVMEDIA_TYPE_SUBTITLE)
+                inner_st = vs->avf->streams[hls->stream_inner_index[outer_st->index]];
+            else if (vs->vtt_avf)
+                inner_st = vs->vtt_avf->streams[0];
+            else {
+                /* We have a subtitle stream, when the user does not want one */
+                inner_st = NULL;
+                continue;
+            }
+            avpriv_set_pts_info(outer_st, inner_st->pts_wrap_bits, inner_st->time_base.num, inner_st->time_base.den);
+        }
     }
 fail:
 
     av_dict_free(&options);
     if (ret < 0) {
-        av_freep(&hls->basename);
-        av_freep(&hls->vtt_basename);
-        if (hls->avf)
-            avformat_free_context(hls->avf);
-        if (hls->vtt_avf)
-            avformat_free_context(hls->vtt_avf);
-
+        hls_free_outputs(s);
+        hls_free_variant_streams(hls);
     }
     return ret;
 }
@@ -794,24 +1238,30 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
     HLSContext *hls = s->priv_data;
     AVFormatContext *oc = NULL;
     AVStream *st = s->streams[pkt->stream_index];
-    int64_t end_pts = hls->recording_time * hls->number;
+    VariantStream *vs;
+    int64_t end_pts;
     int is_ref_pkt = 1;
     int ret, can_split = 1;
-    int stream_index = 0;
+    int stream_index = hls->stream_inner_index[pkt->stream_index];
+
+    if (hls->stream_var_index[pkt->stream_index] < 0)
+        return 0;
+    vs = &hls->var_streams[hls->stream_var_index[pkt->stream_index]];
+    end_pts = hls->recording_time * vs->number;
 
     if( st->codec->codec_type == AVMEDIA_TYPE_SUBTITLE ) {
-        oc = hls->vtt_avf;
-        stream_index = 0;
+        oc = vs->vtt_avf;
     } else {
-        oc = hls->avf;
-        stream_index = pkt->stream_index;
+        oc = vs->avf;
     }
-    if (hls->start_pts == AV_NOPTS_VALUE) {
-        hls->start_pts = pkt->pts;
-        hls->end_pts   = pkt->pts;
+    if (vs->start_pts == AV_NOPTS_VALUE) {
+        vs->start_pts = pkt->pts;
+        vs->end_pts   = pkt->pts;
     }
 
-    if (hls->has_video) {
+    /* Every variant stream applies the same cut rule, so renditions with
+     * keyframes at the same times get aligned segments. */
+    if (vs->has_video) {
         can_split = st->codec->codec_type == AVMEDIA_TYPE_VIDEO &&
                     pkt->flags & AV_PKT_FLAG_KEY;
         is_ref_pkt = st->codec->codec_type == AVMEDIA_TYPE_VIDEO;
@@ -820,45 +1270,48 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         is_ref_pkt = can_split = 0;
 
     if (is_ref_pkt)
-        hls->duration = (double)(pkt->pts - hls->end_pts)
+        vs->duration = (double)(pkt->pts - vs->end_pts)
                                    * st->time_base.num / st->time_base.den;
 
-    if (can_split && av_compare_ts(pkt->pts - hls->start_pts, st->time_base,
+    if (can_split && av_compare_ts(pkt->pts - vs->start_pts, st->time_base,
                                    end_pts, AV_TIME_BASE_Q) >= 0) {
         int64_t new_start_pos;
-        av_write_frame(oc, NULL); /* Flush any buffered data */
+        av_write_frame(vs->avf, NULL); /* Flush any buffered data */
 
-        new_start_pos = avio_tell(hls->avf->pb);
-        hls->size = new_start_pos - hls->start_pos;
-        ret = hls_append_segment(s, hls, hls->duration, hls->start_pos, hls->size);
-        hls->start_pos = new_start_pos;
+        new_start_pos = avio_tell(vs->avf->pb);
+        vs->size = new_start_pos - vs->start_pos;
+        ret = hls_append_segment(s, hls, vs, vs->duration, vs->start_pos, vs->size);
+        vs->start_pos = new_start_pos;
         if (ret < 0)
             return ret;
 
-        hls->end_pts = pkt->pts;
-        hls->duration = 0;
+        vs->end_pts = pkt->pts;
+        vs->duration = 0;
 
         if (hls->flags & HLS_SINGLE_FILE) {
-            if (hls->avf->oformat->priv_class && hls->avf->priv_data)
-                av_opt_set(hls->avf->priv_data, "mpegts_flags", "resend_headers", 0);
-            hls->number++;
+            if (vs->avf->oformat->priv_class && vs->avf->priv_data)
+                av_opt_set(vs->avf->priv_data, "mpegts_flags", "resend_headers", 0);
+            vs->number++;
         } else {
-            ff_format_io_close(s, &oc->pb);
-            if (hls->vtt_avf)
-                ff_format_io_close(s, &hls->vtt_avf->pb);
+            ret = hls_close_output(s, &vs->avf->pb, vs->avf->filename, NULL, 1);
+            if (vs->vtt_avf) {
+                int err = hls_close_output(s, &vs->vtt_avf->pb, vs->vtt_avf->filename, NULL, 1);
+                ret = ret < 0 ? ret : err;
+            }
 
-            ret = hls_start(s);
+            if (ret >= 0)
+                ret = hls_start(s, vs);
         }
 
         if (ret < 0)
             return ret;
 
         if( st->codec->codec_type == AVMEDIA_TYPE_SUBTITLE )
-            oc = hls->vtt_avf;
+            oc = vs->vtt_avf;
         else
-        oc = hls->avf;
+        oc = vs->avf;
 
-        if ((ret = hls_window(s, 0)) < 0)
+        if ((ret = hls_window(s, vs, 0)) < 0)
             return ret;
     }
 
@@ -870,37 +1323,44 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 static int hls_write_trailer(struct AVFormatContext *s)
 {
     HLSContext *hls = s->priv_data;
-    AVFormatContext *oc = hls->avf;
-    AVFormatContext *vtt_oc = hls->vtt_avf;
+    int i, ret = 0, err;
+
+    for (i = 0; i < hls->nb_varstreams; i++) {
+        VariantStream *vs = &hls->var_streams[i];
+        AVFormatContext *oc = vs->avf;
+        AVFormatContext *vtt_oc = vs->vtt_avf;
+
+        av_write_trailer(oc);
+        if (oc->pb) {
+            vs->size = avio_tell(vs->avf->pb) - vs->start_pos;
+            err = hls_close_output(s, &oc->pb, oc->filename, NULL, 1);
+            ret = ret < 0 ? ret : err;
+            err = hls_append_segment(s, hls, vs, vs->duration, vs->start_pos, vs->size);
+            ret = ret < 0 ? ret : err;
+        }
 
-    av_write_trailer(oc);
-    if (oc->pb) {
-        hls->size = avio_tell(hls->avf->pb) - hls->start_pos;
-        ff_format_io_close(s, &oc->pb);
-        hls_append_segment(s, hls, hls->duration, hls->start_pos, hls->size);
-    }
+        if (vtt_oc) {
+            if (vtt_oc->pb)
+                av_write_trailer(vtt_oc);
+            vs->size = avio_tell(vs->vtt_avf->pb) - vs->start_pos;
+            err = hls_close_output(s, &vtt_oc->pb, vtt_oc->filename, NULL, 1);
+            ret = ret < 0 ? ret : err;
+        }
 
-    if (vtt_oc) {
-        if (vtt_oc->pb)
-            av_write_trailer(vtt_oc);
-        hls->size = avio_tell(hls->vtt_avf->pb) - hls->start_pos;
-        ff_format_io_close(s, &vtt_oc->pb);
+        err = hls_window(s, vs, 1);
+        ret = ret < 0 ? ret : err;
     }
-    av_freep(&hls->basename);
-    avformat_free_context(oc);
 
-    if (vtt_oc) {
-        av_freep(&hls->vtt_basename);
-        av_freep(&hls->vtt_m3u8_name);
-        avformat_free_context(vtt_oc);
+    /* some variant streams got no segment */
+    if (hls->master_pl_name && !hls->master_pl_written) {
+        err = hls_write_master_playlist(s);
+        ret = ret < 0 ? ret : err;
     }
 
-    hls->avf = NULL;
-    hls_window(s, 1);
-
-    hls_free_segments(hls->segments);
-    hls_free_segments(hls->old_segments);
-    return 0;
+    err = hls_free_outputs(s);
+    ret = ret < 0 ? ret : err;
+    hls_free_variant_streams(hls);
+    return ret;
 }
 
 #define OFFSET(x) offsetof(HLSContext, x)
@@ -929,6 +1389,14 @@ static const AVOption options[] = {
     {"event", "EVENT playlist", 0, AV_OPT_TYPE_CONST, {.i64 = PLAYLIST_TYPE_EVENT }, INT_MIN, INT_MAX, E, "pl_type" },
     {"vod", "VOD playlist", 0, AV_OPT_TYPE_CONST, {.i64 = PLAYLIST_TYPE_VOD }, INT_MIN, INT_MAX, E, "pl_type" },
     {"method", "set the HTTP method", OFFSET(method), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
+    {"hls_segment_type", "set the type of the segment files", OFFSET(segment_type), AV_OPT_TYPE_INT, {.i64 = SEGMENT_TYPE_MPEGTS }, 0, SEGMENT_TYPE_FMP4, E, "segment_type"},
+    {"mpegts", "MPEG-TS segments", 0, AV_OPT_TYPE_CONST, {.i64 = SEGMENT_TYPE_MPEGTS }, 0, UINT_MAX, E, "segment_type"},
+    {"fmp4", "fragmented MP4 segments", 0, AV_OPT_TYPE_CONST, {.i64 = SEGMENT_TYPE_FMP4 }, 0, UINT_MAX, E, "segment_type"},
+    {"hls_fmp4_init_filename", "set the name of the fragmented MP4 initialization segment", OFFSET(fmp4_init_filename), AV_OPT_TYPE_STRING, {.str = "init.mp4"}, 0, 0, E},
+    {"var_stream_map", "set the streams of each variant stream", OFFSET(var_stream_map), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
+    {"master_pl_name", "create a master playlist with this name", OFFSET(master_pl_name), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
+    {"async_io_threads", "write segments and playlists from this many background threads", OFFSET(async_io_threads), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, E},
+    {"async_io_queue_size", "set the maximum number of complete files waiting to be written", OFFSET(async_io_queue_size), AV_OPT_TYPE_INT, {.i64 = 8}, 1, INT_MAX, E},
 
     { NULL },
 };
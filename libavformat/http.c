@@ -28,6 +28,7 @@
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 
 #include "avformat.h"
@@ -48,6 +49,8 @@
 #define MAX_REDIRECTS 8
 #define HTTP_SINGLE   1
 #define HTTP_MUTLI    2
+/* maximum number of idle connections kept in the connection pool */
+#define HTTP_POOL_SIZE 32
 typedef enum {
     LOWER_PROTO,
     READ_HEADERS,
@@ -117,6 +120,16 @@ typedef struct HTTPContext {
     int is_multi_client;
     HandshakeState handshake_step;
     int is_connected_server;
+    /* Set once the last chunk and the trailer of a chunked reply are read. */
+    int chunk_end;
+    /* Set if the reply is HTTP/1.0, which closes the connection by default. */
+    int http10;
+    int connection_pool;
+    int pool_max_per_host;
+    int pool_idle_timeout;
+    /* lower protocol URL and options identifying the connection, empty
+     * if it cannot be pooled */
+    char pool_key[2048];
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -155,6 +168,9 @@ static const AVOption options[] = {
     { "listen", "listen on HTTP", OFFSET(listen), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 2, D | E },
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
+    { "connection_pool", "reuse idle connections from a process-wide pool", OFFSET(connection_pool), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "connection_pool_max_per_host", "maximum number of idle pooled connections to a host", OFFSET(pool_max_per_host), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, HTTP_POOL_SIZE, D },
+    { "connection_pool_idle_timeout", "close pooled connections idle for more than this many seconds", OFFSET(pool_idle_timeout), AV_OPT_TYPE_INT, { .i64 = 10 }, 0, INT_MAX / 1000000, D },
     { NULL }
 };
 
@@ -173,6 +189,184 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
            sizeof(HTTPAuthState));
 }
 
+typedef struct HTTPPoolEntry {
+    URLContext *hd;
+    char *key;
+    /* connections are only handed to contexts with the same callback, as
+     * the lower protocols keep a copy of it */
+    AVIOInterruptCB interrupt_callback;
+    int64_t expires;
+} HTTPPoolEntry;
+
+static HTTPPoolEntry http_pool[HTTP_POOL_SIZE];
+static int http_pool_nb;
+static AVMutex http_pool_lock;
+static AVOnce http_pool_once = AV_ONCE_INIT;
+
+static void http_pool_init(void)
+{
+    ff_mutex_init(&http_pool_lock, NULL);
+}
+
+/* lower protocol options that must match for a connection to be reused */
+static const char * const http_pool_key_options[] = {
+    "ca_file", "cafile", "tls_verify", "cert_file", "key_file", "verifyhost",
+    "timeout", "rw_timeout", NULL
+};
+
+static void http_pool_make_key(HTTPContext *s, const char *lower_url,
+                               AVDictionary *options)
+{
+    const char * const *name;
+    size_t len = av_strlcpy(s->pool_key, lower_url, sizeof(s->pool_key));
+
+    for (name = http_pool_key_options; *name; name++) {
+        AVDictionaryEntry *e = av_dict_get(options, *name, NULL, 0);
+        if (e)
+            len = av_strlcatf(s->pool_key, sizeof(s->pool_key), "|%s=%s",
+                              *name, e->value);
+    }
+    if (len >= sizeof(s->pool_key))
+        s->pool_key[0] = '\0';
+}
+
+/* must be called with the pool locked, returns the connection to close */
+static URLContext *http_pool_remove(int i)
+{
+    URLContext *hd = http_pool[i].hd;
+
+    av_freep(&http_pool[i].key);
+    http_pool[i] = http_pool[--http_pool_nb];
+    memset(&http_pool[http_pool_nb], 0, sizeof(http_pool[http_pool_nb]));
+    return hd;
+}
+
+/* must be called with the pool locked */
+static int http_pool_expire(URLContext **closed, int nb_closed)
+{
+    int64_t now = av_gettime_relative();
+    int i;
+
+    for (i = http_pool_nb - 1; i >= 0; i--)
+        if (http_pool[i].expires <= now)
+            closed[nb_closed++] = http_pool_remove(i);
+    return nb_closed;
+}
+
+static void http_pool_close(URLContext **closed, int nb_closed)
+{
+    while (nb_closed > 0)
+        ffurl_close(closed[--nb_closed]);
+}
+
+/**
+ * Take an idle connection matching s->pool_key out of the pool.
+ */
+static URLContext *http_pool_get(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    URLContext *closed[HTTP_POOL_SIZE], *hd = NULL;
+    int i, nb_closed;
+
+    if (!s->pool_key[0])
+        return NULL;
+
+    ff_thread_once(&http_pool_once, http_pool_init);
+    ff_mutex_lock(&http_pool_lock);
+    nb_closed = http_pool_expire(closed, 0);
+    for (i = http_pool_nb - 1; i >= 0; i--) {
+        HTTPPoolEntry *e = &http_pool[i];
+        if (!strcmp(e->key, s->pool_key) &&
+            e->interrupt_callback.callback == h->interrupt_callback.callback &&
+            e->interrupt_callback.opaque   == h->interrupt_callback.opaque) {
+            hd = http_pool_remove(i);
+            break;
+        }
+    }
+    ff_mutex_unlock(&http_pool_lock);
+    http_pool_close(closed, nb_closed);
+
+    if (hd)
+        av_log(h, AV_LOG_DEBUG, "Reusing pooled connection %s\n", s->pool_key);
+    return hd;
+}
+
+/**
+ * Hand s->hd over to the pool, evicting the oldest connection to the
+ * same host, or the oldest one overall, if there are too many.
+ */
+static void http_pool_put(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    URLContext *closed[HTTP_POOL_SIZE + 1];
+    char *key = av_strdup(s->pool_key);
+    int i, nb_closed, nb_host = 0, oldest_host = -1, oldest = -1;
+
+    if (!key) {
+        ffurl_closep(&s->hd);
+        return;
+    }
+
+    ff_thread_once(&http_pool_once, http_pool_init);
+    ff_mutex_lock(&http_pool_lock);
+    nb_closed = http_pool_expire(closed, 0);
+    for (i = 0; i < http_pool_nb; i++) {
+        if (oldest < 0 || http_pool[i].expires < http_pool[oldest].expires)
+            oldest = i;
+        if (strcmp(http_pool[i].key, key))
+            continue;
+        nb_host++;
+        if (oldest_host < 0 || http_pool[i].expires < http_pool[oldest_host].expires)
+            oldest_host = i;
+    }
+    if (nb_host >= s->pool_max_per_host)
+        closed[nb_closed++] = http_pool_remove(oldest_host);
+    else if (http_pool_nb == HTTP_POOL_SIZE)
+        closed[nb_closed++] = http_pool_remove(oldest);
+
+    http_pool[http_pool_nb].hd                 = s->hd;
+    http_pool[http_pool_nb].key                = key;
+    http_pool[http_pool_nb].interrupt_callback = h->interrupt_callback;
+    http_pool[http_pool_nb].expires            = av_gettime_relative() +
+                                                 s->pool_idle_timeout * 1000000LL;
+    http_pool_nb++;
+    s->hd = NULL;
+    ff_mutex_unlock(&http_pool_lock);
+    http_pool_close(closed, nb_closed);
+}
+
+void ff_http_pool_flush(void)
+{
+    URLContext *closed[HTTP_POOL_SIZE];
+    int nb_closed = 0;
+
+    ff_thread_once(&http_pool_once, http_pool_init);
+    ff_mutex_lock(&http_pool_lock);
+    while (http_pool_nb)
+        closed[nb_closed++] = http_pool_remove(http_pool_nb - 1);
+    ff_mutex_unlock(&http_pool_lock);
+    http_pool_close(closed, nb_closed);
+}
+
+/* return non zero if the connection can serve another request */
+static int http_is_reusable(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    int64_t target_end = s->end_off ? s->end_off : s->filesize;
+
+    if (!s->connection_pool || !s->pool_key[0] || !s->hd || !s->end_header ||
+        s->willclose || s->http10 || s->listen || s->post_data ||
+        h->flags & AVIO_FLAG_WRITE)
+        return 0;
+    /* the whole reply, and nothing more, must have been read */
+    if (s->buf_ptr != s->buf_end)
+        return 0;
+    if (s->chunksize >= 0)
+        return s->chunk_end;
+    return target_end >= 0 && s->off == target_end &&
+           (!s->end_off || s->http_code == 206);
+}
+
 static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 {
     const char *path, *proxy_path, *lower_proto = "tcp", *local_path;
@@ -180,7 +374,8 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     char auth[1024], proxyauth[1024] = "";
     char path1[MAX_URL_SIZE];
     char buf[1024], urlbuf[MAX_URL_SIZE];
-    int port, use_proxy, err, location_changed = 0;
+    int port, use_proxy, err, location_changed = 0, reused = 0;
+    int64_t off;
     HTTPContext *s = h->priv_data;
 
     av_url_split(proto, sizeof(proto), auth, sizeof(auth),
@@ -218,6 +413,12 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
+    if (s->connection_pool && !s->hd && !(h->flags & AVIO_FLAG_WRITE)) {
+        http_pool_make_key(s, buf, *options);
+        reused = !!(s->hd = http_pool_get(h));
+    }
+
+redo:
     if (!s->hd) {
         err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
                                    &h->interrupt_callback, options,
@@ -226,8 +427,18 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
             return err;
     }
 
+    off           = s->off;
+    s->line_count = 0;
     err = http_connect(h, path, local_path, hoststr,
                        auth, proxyauth, &location_changed);
+    if (err < 0 && reused && !s->line_count) {
+        /* the server closed the idle connection, get a new one */
+        av_log(h, AV_LOG_DEBUG, "Pooled connection failed, reconnecting\n");
+        ffurl_closep(&s->hd);
+        s->off = off;
+        reused = 0;
+        goto redo;
+    }
     if (err < 0)
         return err;
 
@@ -773,6 +984,7 @@ static int process_line(URLContext *h, char *line, int line_count,
             }
             av_log(h, AV_LOG_TRACE, "HTTP version string: %s\n", version);
         } else {
+            s->http10 = !av_strncasecmp(p, "HTTP/1.0", 8);
             while (!av_isspace(*p) && *p != '\0')
                 p++;
             while (av_isspace(*p))
@@ -1057,7 +1269,7 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
                            "Expect: 100-continue\r\n");
 
     if (!has_header(s->headers, "\r\nConnection: ")) {
-        if (s->multiple_requests)
+        if (s->multiple_requests || s->connection_pool)
             len += av_strlcpy(headers + len, "Connection: keep-alive\r\n",
                               sizeof(headers) - len);
         else
@@ -1122,6 +1334,8 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
     s->icy_data_read    = 0;
     s->filesize         = -1;
     s->willclose        = 0;
+    s->http10           = 0;
+    s->chunk_end        = 0;
     s->end_chunked_post = 0;
     s->end_header       = 0;
     if (post && !s->post_data && !send_expect_100) {
@@ -1232,6 +1446,8 @@ static int http_read_stream(URLContext *h, uint8_t *buf, int size)
     }
 
     if (s->chunksize >= 0) {
+        if (s->chunk_end)
+            return 0;
         if (!s->chunksize) {
             char line[32];
 
@@ -1245,8 +1461,15 @@ static int http_read_stream(URLContext *h, uint8_t *buf, int size)
                 av_log(NULL, AV_LOG_TRACE, "Chunked encoding data size: %"PRId64"'\n",
                         s->chunksize);
 
-                if (!s->chunksize)
+                if (!s->chunksize) {
+                    /* skip the trailer, so that the connection can be reused */
+                    do {
+                        if ((err = http_get_line(s, line, sizeof(line))) < 0)
+                            return err;
+                    } while (*line);
+                    s->chunk_end = 1;
                     return 0;
+                }
         }
         size = FFMIN(size, s->chunksize);
     }
@@ -1429,6 +1652,8 @@ static int http_close(URLContext *h)
         /* Close the write direction by sending the end of chunked encoding. */
         ret = http_shutdown(h, h->flags);
 
+    if (ret >= 0 && http_is_reusable(h))
+        http_pool_put(h);
     if (s->hd)
         ffurl_closep(&s->hd);
     av_dict_free(&s->chained_options);
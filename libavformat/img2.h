@@ -61,6 +61,8 @@ typedef struct VideoDemuxData {
     int start_number_range;
     int frame_size;
     int ts_from_file;
+    int prefetch;           /**< number of files read ahead, set by a private option */
+    struct ImgPrefetch *prefetch_ctx;
 } VideoDemuxData;
 
 typedef struct IdStrMap {
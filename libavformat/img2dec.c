@@ -29,6 +29,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/intreadwrite.h"
+#include "libavutil/thread.h"
 #include "avformat.h"
 #include "avio_internal.h"
 #include "internal.h"
@@ -176,6 +177,249 @@ static int img_read_probe(AVProbeData *p)
     return 0;
 }
 
+static int img_filename(VideoDemuxData *s, int number, char *buf, int buf_size)
+{
+    if (s->pattern_type == PT_NONE) {
+        av_strlcpy(buf, s->path, buf_size);
+    } else if (s->use_glob) {
+#if HAVE_GLOB
+        av_strlcpy(buf, s->globstate.gl_pathv[number], buf_size);
+#endif
+    } else if (av_get_frame_filename(buf, buf_size, s->path, number) < 0 &&
+               number > 1) {
+        return AVERROR(EIO);
+    }
+    return 0;
+}
+
+#if HAVE_THREADS
+enum PrefetchState {
+    SLOT_EMPTY,
+    SLOT_QUEUED,
+    SLOT_READING,
+    SLOT_DONE,
+};
+
+typedef struct PrefetchSlot {
+    enum PrefetchState state;
+    int number;
+    char filename[1024];
+    uint8_t *data;
+    int size;
+} PrefetchSlot;
+
+/**
+ * Files read ahead of the demuxer by a pool of threads, the image number
+ * n being read into the slot n % nb_slots. A file which was not read
+ * ahead, or could not be, is read by ff_img_read_packet() as usual.
+ */
+typedef struct ImgPrefetch {
+    AVFormatContext *s1;
+    PrefetchSlot *slots;
+    int nb_slots;
+    pthread_t *threads;
+    int nb_threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_work;
+    pthread_cond_t cond_done;
+    int abort;
+} ImgPrefetch;
+
+static int prefetch_read_file(ImgPrefetch *p, const char *filename,
+                              uint8_t **data)
+{
+    AVFormatContext *s1 = p->s1;
+    AVIOContext *pb;
+    int64_t size;
+    int ret;
+
+    ret = ffio_open_whitelist(&pb, filename, AVIO_FLAG_READ,
+                              &s1->interrupt_callback, NULL,
+                              s1->protocol_whitelist, s1->protocol_blacklist);
+    if (ret < 0)
+        return ret;
+
+    size = avio_size(pb);
+    if (size <= 0 || size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE) {
+        ret = AVERROR(ENOSYS);
+        goto end;
+    }
+    *data = av_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!*data) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ret = avio_read(pb, *data, size);
+    if (ret <= 0)
+        av_freep(data);
+    else
+        memset(*data + ret, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+end:
+    avio_closep(&pb);
+    return ret;
+}
+
+static void *prefetch_worker(void *arg)
+{
+    ImgPrefetch *p = arg;
+
+    pthread_mutex_lock(&p->mutex);
+    while (!p->abort) {
+        PrefetchSlot *slot = NULL;
+        uint8_t *data = NULL;
+        int i, ret;
+
+        /* read the files in image order */
+        for (i = 0; i < p->nb_slots; i++)
+            if (p->slots[i].state == SLOT_QUEUED &&
+                (!slot || p->slots[i].number < slot->number))
+                slot = &p->slots[i];
+        if (!slot) {
+            pthread_cond_wait(&p->cond_work, &p->mutex);
+            continue;
+        }
+
+        slot->state = SLOT_READING;
+        pthread_mutex_unlock(&p->mutex);
+        ret = prefetch_read_file(p, slot->filename, &data);
+        pthread_mutex_lock(&p->mutex);
+
+        slot->data  = data;
+        slot->size  = FFMAX(ret, 0);
+        slot->state = SLOT_DONE;
+        pthread_cond_broadcast(&p->cond_done);
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return NULL;
+}
+
+static PrefetchSlot *prefetch_slot(ImgPrefetch *p, int number)
+{
+    return &p->slots[(unsigned)number % p->nb_slots];
+}
+
+/* queue the files following the current one, must be called with the
+ * mutex locked */
+static void prefetch_schedule(VideoDemuxData *s, ImgPrefetch *p)
+{
+    int n;
+
+    for (n = s->img_number; n < s->img_number + p->nb_slots && n <= s->img_last; n++) {
+        PrefetchSlot *slot = prefetch_slot(p, n);
+
+        if (slot->state == SLOT_READING ||
+            slot->state != SLOT_EMPTY && slot->number == n)
+            continue;
+
+        av_freep(&slot->data);
+        slot->state = SLOT_EMPTY;
+        if (img_filename(s, n, slot->filename, sizeof(slot->filename)) < 0)
+            continue;
+        slot->number = n;
+        slot->state  = SLOT_QUEUED;
+    }
+    pthread_cond_broadcast(&p->cond_work);
+}
+
+/**
+ * Get the current image from the prefetched files.
+ *
+ * @return 1 if pkt was filled with the file content, 0 if the file must
+ *         be read directly, a negative error code on failure
+ */
+static int prefetch_get(AVFormatContext *s1, AVPacket *pkt)
+{
+    VideoDemuxData *s = s1->priv_data;
+    ImgPrefetch *p    = s->prefetch_ctx;
+    PrefetchSlot *slot = prefetch_slot(p, s->img_number);
+    int ret = 0;
+
+    pthread_mutex_lock(&p->mutex);
+    prefetch_schedule(s, p);
+    while (slot->number == s->img_number &&
+           (slot->state == SLOT_QUEUED || slot->state == SLOT_READING))
+        pthread_cond_wait(&p->cond_done, &p->mutex);
+
+    if (slot->number == s->img_number && slot->state == SLOT_DONE) {
+        if (slot->data) {
+            ret = av_packet_from_data(pkt, slot->data, slot->size);
+            if (ret < 0)
+                av_freep(&slot->data);
+            else
+                ret = 1;
+            slot->data = NULL;
+        }
+        slot->state = SLOT_EMPTY;
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return ret;
+}
+
+static void prefetch_uninit(VideoDemuxData *s)
+{
+    ImgPrefetch *p = s->prefetch_ctx;
+    int i;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->mutex);
+    p->abort = 1;
+    pthread_cond_broadcast(&p->cond_work);
+    pthread_mutex_unlock(&p->mutex);
+    for (i = 0; i < p->nb_threads; i++)
+        pthread_join(p->threads[i], NULL);
+
+    for (i = 0; i < p->nb_slots; i++)
+        av_freep(&p->slots[i].data);
+    pthread_cond_destroy(&p->cond_done);
+    pthread_cond_destroy(&p->cond_work);
+    pthread_mutex_destroy(&p->mutex);
+    av_freep(&p->threads);
+    av_freep(&p->slots);
+    av_freep(&s->prefetch_ctx);
+}
+
+static int prefetch_init(AVFormatContext *s1)
+{
+    VideoDemuxData *s = s1->priv_data;
+    ImgPrefetch *p;
+    int i, ret;
+
+    p = s->prefetch_ctx = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+    p->s1       = s1;
+    p->nb_slots = s->prefetch;
+    p->slots    = av_mallocz_array(p->nb_slots, sizeof(*p->slots));
+    p->threads  = av_mallocz_array(p->nb_slots, sizeof(*p->threads));
+    if (!p->slots || !p->threads) {
+        av_freep(&p->slots);
+        av_freep(&p->threads);
+        av_freep(&s->prefetch_ctx);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->cond_work, NULL);
+    pthread_cond_init(&p->cond_done, NULL);
+
+    for (i = 0; i < p->nb_slots; i++) {
+        ret = pthread_create(&p->threads[i], NULL, prefetch_worker, p);
+        if (ret) {
+            av_log(s1, AV_LOG_ERROR, "pthread_create failed: %s\n",
+                   av_err2str(AVERROR(ret)));
+            prefetch_uninit(s);
+            return AVERROR(ret);
+        }
+        p->nb_threads++;
+    }
+    return 0;
+}
+#endif
+
 int ff_img_read_header(AVFormatContext *s1)
 {
     VideoDemuxData *s = s1->priv_data;
@@ -366,6 +610,18 @@ int ff_img_read_header(AVFormatContext *s1)
         pix_fmt != AV_PIX_FMT_NONE)
         st->codec->pix_fmt = pix_fmt;
 
+    if (s->prefetch && !s->is_pipe && !s->split_planes &&
+        s->pattern_type != PT_NONE) {
+#if HAVE_THREADS
+        int ret = prefetch_init(s1);
+        if (ret < 0)
+            return ret;
+#else
+        av_log(s1, AV_LOG_WARNING,
+               "Prefetching is not supported without threads, option ignored\n");
+#endif
+    }
+
     return 0;
 }
 
@@ -374,7 +630,7 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
     VideoDemuxData *s = s1->priv_data;
     char filename_bytes[1024];
     char *filename = filename_bytes;
-    int i, res;
+    int i, res, prefetched = 0;
     int size[3]           = { 0 }, ret[3] = { 0 };
     AVIOContext *f[3]     = { NULL };
     AVCodecContext *codec = s1->streams[0]->codec;
@@ -386,19 +642,17 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
         }
         if (s->img_number > s->img_last)
             return AVERROR_EOF;
-        if (s->pattern_type == PT_NONE) {
-            av_strlcpy(filename_bytes, s->path, sizeof(filename_bytes));
-        } else if (s->use_glob) {
-#if HAVE_GLOB
-            filename = s->globstate.gl_pathv[s->img_number];
-#endif
-        } else {
-        if (av_get_frame_filename(filename_bytes, sizeof(filename_bytes),
-                                  s->path,
-                                  s->img_number) < 0 && s->img_number > 1)
+        if (img_filename(s, s->img_number, filename_bytes, sizeof(filename_bytes)) < 0)
             return AVERROR(EIO);
+#if HAVE_THREADS
+        if (s->prefetch_ctx) {
+            prefetched = prefetch_get(s1, pkt);
+            if (prefetched < 0)
+                return prefetched;
+            size[0] = pkt->size;
         }
-        for (i = 0; i < 3; i++) {
+#endif
+        for (i = 0; i < 3 && !prefetched; i++) {
             if (s1->pb &&
                 !strcmp(filename_bytes, s->path) &&
                 !s->loop &&
@@ -425,11 +679,16 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
             int ret;
             int score = 0;
 
-            ret = avio_read(f[0], header, PROBE_BUF_MIN);
-            if (ret < 0)
-                return ret;
+            if (prefetched) {
+                ret = FFMIN(pkt->size, PROBE_BUF_MIN);
+                memcpy(header, pkt->data, ret);
+            } else {
+                ret = avio_read(f[0], header, PROBE_BUF_MIN);
+                if (ret < 0)
+                    return ret;
+                avio_skip(f[0], -ret);
+            }
             memset(header + ret, 0, sizeof(header) - ret);
-            avio_skip(f[0], -ret);
             pd.buf = header;
             pd.buf_size = ret;
             pd.filename = filename;
@@ -456,9 +715,11 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
         }
     }
 
-    res = av_new_packet(pkt, size[0] + size[1] + size[2]);
-    if (res < 0) {
-        goto fail;
+    if (!prefetched) {
+        res = av_new_packet(pkt, size[0] + size[1] + size[2]);
+        if (res < 0) {
+            goto fail;
+        }
     }
     pkt->stream_index = 0;
     pkt->flags       |= AV_PKT_FLAG_KEY;
@@ -481,6 +742,13 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
     if (s->is_pipe)
         pkt->pos = avio_tell(f[0]);
 
+    if (prefetched) {
+        s->img_count++;
+        s->img_number++;
+        s->pts++;
+        return 0;
+    }
+
     pkt->size = 0;
     for (i = 0; i < 3; i++) {
         if (f[i]) {
@@ -529,8 +797,11 @@ fail:
 
 static int img_read_close(struct AVFormatContext* s1)
 {
-#if HAVE_GLOB
     VideoDemuxData *s = s1->priv_data;
+#if HAVE_THREADS
+    prefetch_uninit(s);
+#endif
+#if HAVE_GLOB
     if (s->use_glob) {
         globfree(&s->globstate);
     }
@@ -571,6 +842,7 @@ const AVOption ff_img_options[] = {
     { "none",         "disable pattern matching",            0, AV_OPT_TYPE_CONST,  {.i64=PT_NONE         }, INT_MIN, INT_MAX, DEC, "pattern_type" },
 
     { "pixel_format", "set video pixel format",              OFFSET(pixel_format), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0,       DEC },
+    { "prefetch",     "set number of files read ahead",      OFFSET(prefetch),     AV_OPT_TYPE_INT,    {.i64 = 0   }, 0, 64,      DEC },
     { "start_number", "set first number in the sequence",    OFFSET(start_number), AV_OPT_TYPE_INT,    {.i64 = 0   }, INT_MIN, INT_MAX, DEC },
     { "start_number_range", "set range for looking at the first sequence number", OFFSET(start_number_range), AV_OPT_TYPE_INT, {.i64 = 5}, 1, INT_MAX, DEC },
     { "video_size",   "set video size",                      OFFSET(width),        AV_OPT_TYPE_IMAGE_SIZE, {.str = NULL}, 0, 0,   DEC },
@@ -20,17 +20,34 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include "libavutil/intreadwrite.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/fifo.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 #include "libavutil/time_internal.h"
 #include "avformat.h"
 #include "avio_internal.h"
 #include "internal.h"
 #include "img2.h"
+#include "url.h"
+
+#if HAVE_THREADS
+typedef struct WriteJob {
+    AVPacket pkt;
+    char filename[1024];
+    char target[1024];          ///< final name, empty if not renamed
+} WriteJob;
+#endif
 
 typedef struct VideoMuxData {
     const AVClass *class;  /**< Class for private options. */
@@ -44,8 +61,179 @@ typedef struct VideoMuxData {
     int use_strftime;
     const char *muxer;
     int use_rename;
+    int use_fsync;
+    int nb_writers;
+#if HAVE_THREADS
+    /* files written by a pool of threads, the queue holding at most two
+     * jobs per thread */
+    pthread_t *writers;
+    int nb_writers_started;
+    AVFifoBuffer *queue;
+    int nb_queued;              ///< jobs queued or being written
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_work;
+    pthread_cond_t cond_done;
+    int finish;
+    int error;
+#endif
 } VideoMuxData;
 
+#if HAVE_THREADS
+static int write_file(AVFormatContext *s, WriteJob *job)
+{
+    VideoMuxData *img = s->priv_data;
+    AVIOContext *pb;
+    int ret;
+
+    ret = ffio_open_whitelist(&pb, job->filename, AVIO_FLAG_WRITE,
+                              &s->interrupt_callback, NULL,
+                              s->protocol_whitelist, s->protocol_blacklist);
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Could not open file : %s\n", job->filename);
+        return AVERROR(EIO);
+    }
+    avio_write(pb, job->pkt.data, job->pkt.size);
+    avio_flush(pb);
+    ret = pb->error;
+#if HAVE_FSYNC
+    if (img->use_fsync && ret >= 0) {
+        URLContext *h = ffio_geturlcontext(pb);
+        int fd = h ? ffurl_get_file_handle(h) : -1;
+        if (fd >= 0 && fsync(fd) < 0) {
+            ret = AVERROR(errno);
+            av_log(s, AV_LOG_ERROR, "Could not sync file : %s\n", job->filename);
+        }
+    }
+#endif
+    avio_closep(&pb);
+
+    if (ret >= 0 && job->target[0])
+        ret = ff_rename(job->filename, job->target, s);
+    return ret;
+}
+
+static void *writer_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    VideoMuxData *img  = s->priv_data;
+    WriteJob job;
+    int ret;
+
+    pthread_mutex_lock(&img->mutex);
+    for (;;) {
+        if (!av_fifo_size(img->queue)) {
+            if (img->finish)
+                break;
+            pthread_cond_wait(&img->cond_work, &img->mutex);
+            continue;
+        }
+        av_fifo_generic_read(img->queue, &job, sizeof(job), NULL);
+        pthread_cond_broadcast(&img->cond_done);
+        pthread_mutex_unlock(&img->mutex);
+
+        ret = write_file(s, &job);
+        av_packet_unref(&job.pkt);
+
+        pthread_mutex_lock(&img->mutex);
+        if (ret < 0 && !img->error)
+            img->error = ret;
+        img->nb_queued--;
+        pthread_cond_broadcast(&img->cond_done);
+    }
+    pthread_mutex_unlock(&img->mutex);
+
+    return NULL;
+}
+
+static int writers_init(AVFormatContext *s)
+{
+    VideoMuxData *img = s->priv_data;
+    int i, ret;
+
+    img->queue   = av_fifo_alloc_array(2 * img->nb_writers, sizeof(WriteJob));
+    img->writers = av_mallocz_array(img->nb_writers, sizeof(*img->writers));
+    if (!img->queue || !img->writers) {
+        av_fifo_freep(&img->queue);
+        av_freep(&img->writers);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&img->mutex, NULL);
+    pthread_cond_init(&img->cond_work, NULL);
+    pthread_cond_init(&img->cond_done, NULL);
+
+    for (i = 0; i < img->nb_writers; i++) {
+        ret = pthread_create(&img->writers[i], NULL, writer_thread, s);
+        if (ret) {
+            av_log(s, AV_LOG_ERROR, "pthread_create failed: %s\n",
+                   av_err2str(AVERROR(ret)));
+            return AVERROR(ret);
+        }
+        img->nb_writers_started++;
+    }
+    return 0;
+}
+
+static int queue_file(AVFormatContext *s, AVPacket *pkt,
+                      const char *filename, const char *target)
+{
+    VideoMuxData *img = s->priv_data;
+    WriteJob job = { { 0 } };
+    int ret;
+
+    ret = av_packet_ref(&job.pkt, pkt);
+    if (ret < 0)
+        return ret;
+    av_strlcpy(job.filename, filename, sizeof(job.filename));
+    av_strlcpy(job.target, target ? target : "", sizeof(job.target));
+
+    pthread_mutex_lock(&img->mutex);
+    while (!img->error && !av_fifo_space(img->queue))
+        pthread_cond_wait(&img->cond_done, &img->mutex);
+    ret = img->error;
+    if (!ret) {
+        av_fifo_generic_write(img->queue, &job, sizeof(job), NULL);
+        img->nb_queued++;
+        pthread_cond_signal(&img->cond_work);
+    }
+    pthread_mutex_unlock(&img->mutex);
+
+    if (ret < 0)
+        av_packet_unref(&job.pkt);
+    return ret;
+}
+
+/* wait for the queued files to be written and stop the threads */
+static int writers_uninit(AVFormatContext *s)
+{
+    VideoMuxData *img = s->priv_data;
+    WriteJob job;
+    int i, ret;
+
+    if (!img->writers)
+        return 0;
+
+    pthread_mutex_lock(&img->mutex);
+    img->finish = 1;
+    pthread_cond_broadcast(&img->cond_work);
+    pthread_mutex_unlock(&img->mutex);
+    for (i = 0; i < img->nb_writers_started; i++)
+        pthread_join(img->writers[i], NULL);
+    ret = img->error;
+
+    /* left over if no thread could be started */
+    while (av_fifo_size(img->queue) >= sizeof(job)) {
+        av_fifo_generic_read(img->queue, &job, sizeof(job), NULL);
+        av_packet_unref(&job.pkt);
+    }
+    av_fifo_freep(&img->queue);
+    av_freep(&img->writers);
+    pthread_cond_destroy(&img->cond_done);
+    pthread_cond_destroy(&img->cond_work);
+    pthread_mutex_destroy(&img->mutex);
+    return ret;
+}
+#endif
+
 static int write_header(AVFormatContext *s)
 {
     VideoMuxData *img = s->priv_data;
@@ -72,6 +260,19 @@ static int write_header(AVFormatContext *s)
                              && desc->nb_components >= 3;
     }
 
+    if (img->nb_writers && !img->is_pipe && !img->update &&
+        !img->split_planes && !img->muxer) {
+#if HAVE_THREADS
+        int ret = writers_init(s);
+        if (ret < 0)
+            writers_uninit(s);
+        return ret;
+#else
+        av_log(s, AV_LOG_WARNING,
+               "Writer threads are not supported in this build, option ignored\n");
+#endif
+    }
+
     return 0;
 }
 
@@ -104,6 +305,20 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
                    img->img_number, img->path);
             return AVERROR(EINVAL);
         }
+#if HAVE_THREADS
+        if (img->writers) {
+            int ret;
+            if (img->use_rename) {
+                snprintf(img->tmp[0], sizeof(img->tmp[0]), "%s.tmp", filename);
+                ret = queue_file(s, pkt, img->tmp[0], filename);
+            } else
+                ret = queue_file(s, pkt, filename, NULL);
+            if (ret < 0)
+                return ret;
+            img->img_number++;
+            return 0;
+        }
+#endif
         for (i = 0; i < 4; i++) {
             snprintf(img->tmp[i], sizeof(img->tmp[i]), "%s.tmp", filename);
             av_strlcpy(img->target[i], filename, sizeof(img->target[i]));
@@ -186,6 +401,22 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
     return 0;
 }
 
+static int write_trailer(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    return writers_uninit(s);
+#else
+    return 0;
+#endif
+}
+
+static void deinit(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    writers_uninit(s);
+#endif
+}
+
 static int query_codec(enum AVCodecID id, int std_compliance)
 {
     int i;
@@ -205,6 +436,8 @@ static const AVOption muxoptions[] = {
     { "start_number", "set first number in the sequence", OFFSET(img_number), AV_OPT_TYPE_INT,  { .i64 = 1 }, 0, INT_MAX, ENC },
     { "strftime",     "use strftime for filename", OFFSET(use_strftime),  AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, ENC },
     { "atomic_writing", "write files atomically (using temporary files and renames)", OFFSET(use_rename), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, ENC },
+    { "writers",      "set number of threads writing the files", OFFSET(nb_writers), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, ENC },
+    { "fsync",        "sync each file to storage before closing it", OFFSET(use_fsync), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, ENC },
     { NULL },
 };
 
@@ -226,6 +459,8 @@ AVOutputFormat ff_image2_muxer = {
     .video_codec    = AV_CODEC_ID_MJPEG,
     .write_header   = write_header,
     .write_packet   = write_packet,
+    .write_trailer  = write_trailer,
+    .deinit         = deinit,
     .query_codec    = query_codec,
     .flags          = AVFMT_NOTIMESTAMPS | AVFMT_NODIMENSIONS | AVFMT_NOFILE,
     .priv_class     = &img2mux_class,
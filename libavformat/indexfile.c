@@ -0,0 +1,115 @@
+/*
+ * Packet index files
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/mathematics.h"
+#include "libavutil/mem.h"
+#include "avformat.h"
+#include "avio.h"
+#include "internal.h"
+
+#define INDEX_FILE_TAG     MKBETAG('F', 'F', 'I', 'X')
+#define INDEX_FILE_VERSION 1
+
+typedef struct IndexedStream {
+    AVStream *st;           ///< NULL if the stream does not match
+    AVRational time_base;
+} IndexedStream;
+
+int ff_load_index_file(AVFormatContext *s, const char *url)
+{
+    AVIOContext *pb = NULL;
+    IndexedStream *streams = NULL;
+    int64_t file_size, size;
+    unsigned int i, nb_streams;
+    int ret, nb_entries = 0;
+
+    if ((ret = avio_open2(&pb, url, AVIO_FLAG_READ, &s->interrupt_callback, NULL)) < 0) {
+        av_log(s, AV_LOG_ERROR, "Could not open index file %s\n", url);
+        return ret;
+    }
+
+    if (avio_rb32(pb) != INDEX_FILE_TAG || avio_rb32(pb) != INDEX_FILE_VERSION) {
+        av_log(s, AV_LOG_ERROR, "%s is not a packet index file\n", url);
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+    file_size  = avio_rb64(pb);
+    nb_streams = avio_rb32(pb);
+    size       = s->pb ? avio_size(s->pb) : -1;
+    if (file_size > 0 && size > 0 && file_size != size) {
+        av_log(s, AV_LOG_WARNING, "Index file %s is for a file of %"PRId64
+               " bytes instead of %"PRId64", ignoring it\n", url, file_size, size);
+        ret = 0;
+        goto end;
+    }
+    if (nb_streams > 0xFFFF || avio_feof(pb)) {
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+
+    if (!(streams = av_mallocz_array(nb_streams, sizeof(*streams)))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (i = 0; i < nb_streams; i++) {
+        int id = avio_rb32(pb);
+
+        streams[i].time_base.num = avio_rb32(pb);
+        streams[i].time_base.den = avio_rb32(pb);
+        if (streams[i].time_base.num <= 0 || streams[i].time_base.den <= 0) {
+            ret = AVERROR_INVALIDDATA;
+            goto end;
+        }
+        if (i < s->nb_streams && s->streams[i]->id == id)
+            streams[i].st = s->streams[i];
+        else
+            av_log(s, AV_LOG_VERBOSE, "Stream %u of index file %s does not "
+                   "match the input\n", i, url);
+    }
+
+    for (;;) {
+        unsigned int stream_index = avio_rb16(pb);
+        int flags    = avio_rb16(pb);
+        int64_t pts  = avio_rb64(pb);
+        int64_t dts  = avio_rb64(pb);
+        int64_t pos  = avio_rb64(pb);
+        int pkt_size = avio_rb32(pb);
+        int64_t ts   = dts != AV_NOPTS_VALUE ? dts : pts;
+        AVStream *st;
+
+        if (avio_feof(pb))
+            break;
+        if (stream_index >= nb_streams || !(st = streams[stream_index].st) ||
+            !(flags & AV_PKT_FLAG_KEY) || ts == AV_NOPTS_VALUE || pos < 0)
+            continue;
+
+        ts = av_rescale_q(ts, streams[stream_index].time_base, st->time_base);
+        ff_reduce_index(s, stream_index);
+        if (av_add_index_entry(st, pos, ts, pkt_size, 0, AVINDEX_KEYFRAME) >= 0)
+            nb_entries++;
+    }
+    av_log(s, AV_LOG_VERBOSE, "Loaded %d index entries from %s\n", nb_entries, url);
+    ret = nb_entries;
+
+end:
+    av_free(streams);
+    avio_closep(&pb);
+    return ret;
+}
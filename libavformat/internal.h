@@ -76,6 +76,15 @@ struct AVFormatInternal {
     struct AVPacketList *packet_buffer;
     struct AVPacketList *packet_buffer_end;
 
+    /**
+     * List nodes released by the interleaver, reused for the next packets
+     * instead of allocating one per queued packet.
+     * Muxing only.
+     */
+#define PACKET_POOL_MAX_SIZE 64
+    struct AVPacketList *packet_pool;
+    int packet_pool_size;
+
     /* av_seek_frame() support */
     int64_t data_offset; /**< offset of the first packet */
 
@@ -318,6 +327,23 @@ AVChapter *avpriv_new_chapter(AVFormatContext *s, int id, AVRational time_base,
  */
 void ff_reduce_index(AVFormatContext *s, int stream_index);
 
+/**
+ * Add the keyframes of a packet index file, as written by ffprobe
+ * -write_index, to the index of the streams.
+ *
+ * The file starts with the tag "FFIX", a version equal to 1, the size of
+ * the indexed file or 0 if unknown, and the number of streams, followed for
+ * each stream by its id and time base. It then contains one entry per
+ * packet: the stream index and packet flags on 16 bits each, the pts, the
+ * dts and the position on 64 bits each, and the size on 32 bits. All values
+ * are big-endian.
+ *
+ * Streams which do not match the file, by index and id, are left untouched.
+ *
+ * @return the number of entries added, or a negative AVERROR code
+ */
+int ff_load_index_file(AVFormatContext *s, const char *url);
+
 enum AVCodecID ff_guess_image2_codec(const char *filename);
 
 /**
@@ -113,6 +113,7 @@ typedef struct MOVFragmentIndex {
     unsigned item_count;
     unsigned current_item;
     MOVFragmentIndexItem *items;
+    int from_mfra;          ///< read from a tfra, only used for timestamps with use_mfra_for
 } MOVFragmentIndex;
 
 typedef struct MOVStreamContext {
@@ -216,6 +217,7 @@ typedef struct MOVContext {
     int moov_retry;
     int use_mfra_for;
     int has_looked_for_mfra;
+    int lazy_fragments;     ///< read the fragments when playback or seeking reaches them
     MOVFragmentIndex** fragment_index_data;
     unsigned fragment_index_count;
     int fragment_index_complete;
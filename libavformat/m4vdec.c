@@ -56,5 +56,6 @@ static int mpeg4video_probe(AVProbeData *probe_packet)
     return 0;
 }
 
-FF_DEF_RAWVIDEO_DEMUXER2(m4v, "raw MPEG-4 video", mpeg4video_probe, "m4v",
-                         AV_CODEC_ID_MPEG4, AVFMT_GENERIC_INDEX | AVFMT_TS_DISCONT)
+FF_DEF_RAWVIDEO_DEMUXER3(m4v, "raw MPEG-4 video", mpeg4video_probe, "m4v",
+                         AV_CODEC_ID_MPEG4, AVFMT_GENERIC_INDEX | AVFMT_TS_DISCONT,
+                         AVPROBE_SCORE_EXTENSION)
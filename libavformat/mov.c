@@ -1080,9 +1080,30 @@ static int mov_read_moov(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     return 0; /* now go for mdat */
 }
 
+/* estimate the durations from the last random access points, as the
+ * fragments are not all read */
+static void mov_estimate_fragmented_duration(MOVContext *c)
+{
+    int i, j;
+
+    for (i = 0; i < c->fragment_index_count; i++) {
+        MOVFragmentIndex *index = c->fragment_index_data[i];
+        if (!index->item_count)
+            continue;
+        for (j = 0; j < c->fc->nb_streams; j++) {
+            AVStream *st = c->fc->streams[j];
+            if (st->id == index->track_id) {
+                st->duration = FFMAX(st->duration,
+                                     index->items[index->item_count - 1].time);
+                break;
+            }
+        }
+    }
+}
+
 static int mov_read_moof(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 {
-    if (!c->has_looked_for_mfra && c->use_mfra_for > 0) {
+    if (!c->has_looked_for_mfra && (c->use_mfra_for > 0 || c->lazy_fragments)) {
         c->has_looked_for_mfra = 1;
         if (pb->seekable) {
             int ret;
@@ -1091,6 +1112,10 @@ static int mov_read_moof(MOVContext *c, AVIOContext *pb, MOVAtom atom)
             if ((ret = mov_read_mfra(c, pb)) < 0) {
                 av_log(c->fc, AV_LOG_VERBOSE, "found a moof box but failed to "
                         "read the mfra (may be a live ismv)\n");
+            } else if (c->lazy_fragments && c->fragment_index_count) {
+                /* the other fragments are read when they are reached */
+                c->fragment_index_complete = 1;
+                mov_estimate_fragmented_duration(c);
             }
         } else {
             av_log(c->fc, AV_LOG_VERBOSE, "found a moof box but stream is not "
@@ -2820,6 +2845,19 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         }
         if (st->duration > 0)
             st->codec->bit_rate = stream_size*8*sc->time_scale/st->duration;
+
+        /* the samples of the other stsd entries are not indexed */
+        if (st->nb_index_entries * sizeof(*st->index_entries) <
+            st->index_entries_allocated_size / 2) {
+            AVIndexEntry *entries = av_realloc_array(st->index_entries,
+                                                     FFMAX(st->nb_index_entries, 1),
+                                                     sizeof(*st->index_entries));
+            if (entries) {
+                st->index_entries = entries;
+                st->index_entries_allocated_size = FFMAX(st->nb_index_entries, 1) *
+                                                   sizeof(*st->index_entries);
+            }
+        }
     } else {
         unsigned chunk_samples, total = 0;
 
@@ -3437,7 +3475,10 @@ static int mov_read_tfhd(MOVContext *c, AVIOContext *pb, MOVAtom atom)
                     av_log(c->fc, AV_LOG_DEBUG, "found fragment index entry "
                             "for track %u and moof_offset %"PRId64"\n",
                             frag->track_id, index->items[j].moof_offset);
-                    frag->time = index->items[j].time;
+                    /* a mfra only read to locate the fragments leaves
+                     * the timestamps to the tfdt */
+                    if (!index->from_mfra || c->use_mfra_for > 0)
+                        frag->time = index->items[j].time;
                     index->current_item = j + 1;
                     found = 1;
                     break;
@@ -4401,14 +4442,18 @@ static int mov_read_default(MOVContext *c, AVIOContext *pb, MOVAtom atom)
             int64_t start_pos = avio_tell(pb);
             int64_t left;
             int err = parse(c, pb, a);
+            int on_demand;
             if (err < 0) {
                 c->atom_depth --;
                 return err;
             }
+            /* read the next fragments only when they are needed */
+            on_demand = !pb->seekable || c->fc->flags & AVFMT_FLAG_IGNIDX ||
+                        c->fragment_index_complete ||
+                        (c->lazy_fragments && c->trex_count);
             if (c->found_moov && c->found_mdat &&
-                ((!pb->seekable || c->fc->flags & AVFMT_FLAG_IGNIDX || c->fragment_index_complete) ||
-                 start_pos + a.size == avio_size(pb))) {
-                if (!pb->seekable || c->fc->flags & AVFMT_FLAG_IGNIDX || c->fragment_index_complete)
+                (on_demand || start_pos + a.size == avio_size(pb))) {
+                if (on_demand)
                     c->next_root_atom = start_pos + a.size;
                 c->atom_depth --;
                 return 0;
@@ -4766,6 +4811,7 @@ static int read_tfra(MOVContext *mov, AVIOContext *f)
     version = avio_r8(f);
     avio_rb24(f);
     index->track_id = avio_rb32(f);
+    index->from_mfra = 1;
     fieldlength = avio_rb32(f);
     index->item_count = avio_rb32(f);
     index->items = av_mallocz_array(
@@ -5186,10 +5232,18 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 static int mov_seek_fragment(AVFormatContext *s, AVStream *st, int64_t timestamp)
 {
     MOVContext *mov = s->priv_data;
-    int i, j;
-
-    if (!mov->fragment_index_complete)
+    int i, j, ret;
+
+    if (!mov->fragment_index_complete) {
+        /* without a fragment index, read the fragments up to the timestamp */
+        while (mov->lazy_fragments && mov->next_root_atom &&
+               (!st->nb_index_entries ||
+                st->index_entries[st->nb_index_entries - 1].timestamp < timestamp)) {
+            if ((ret = mov_switch_root(s, mov->next_root_atom)) < 0)
+                return ret == AVERROR_EOF ? 0 : ret;
+        }
         return 0;
+    }
 
     for (i = 0; i < mov->fragment_index_count; i++) {
         if (mov->fragment_index_data[i]->track_id == st->id) {
@@ -5315,6 +5369,10 @@ static const AVOption mov_options[] = {
         0, 1, FLAGS},
     {"ignore_chapters", "", OFFSET(ignore_chapters), AV_OPT_TYPE_BOOL, {.i64 = 0},
         0, 1, FLAGS},
+    {"lazy_fragments",
+        "read the fragments when reading or seeking reaches them instead of on open",
+        OFFSET(lazy_fragments), AV_OPT_TYPE_BOOL, {.i64 = 0},
+        0, 1, FLAGS},
     {"use_mfra_for",
         "use mfra for fragment timestamps",
         OFFSET(use_mfra_for), AV_OPT_TYPE_INT, {.i64 = FF_MOV_FLAG_MFRA_AUTO},
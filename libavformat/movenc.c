@@ -60,6 +60,7 @@ static const AVOption options[] = {
     { "frag_custom", "Flush fragments on caller requests", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_CUSTOM}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "isml", "Create a live smooth streaming feed (for pushing to a publishing point)", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_ISML}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "faststart", "Run a second pass to put the index (moov atom) at the beginning of the file", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FASTSTART}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "faststart_duration", "expected duration of the output, to reserve the space of the moov atom at the beginning with faststart instead of running a second pass", offsetof(MOVMuxContext, faststart_duration), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "omit_tfhd_offset", "Omit the base data offset in tfhd atoms", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_OMIT_TFHD_OFFSET}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "disable_chpl", "Disable Nero chapter atom", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_DISABLE_CHPL}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "default_base_moof", "Set the default-base-is-moof flag in tfhd atoms", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_DEFAULT_BASE_MOOF}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -98,6 +99,7 @@ static const AVClass flavor ## _muxer_class = {\
 };
 
 static int get_moov_size(AVFormatContext *s);
+static int estimate_moov_size(AVFormatContext *s);
 
 static int utf8len(const uint8_t *b)
 {
@@ -5129,6 +5131,8 @@ static int mov_write_header(AVFormatContext *s)
 
     if (mov->flags & FF_MOV_FLAG_FASTSTART) {
         mov->reserved_moov_size = -1;
+        if (!(mov->flags & FF_MOV_FLAG_FRAGMENT))
+            mov->reserved_moov_size = estimate_moov_size(s);
     }
 
     if (mov->use_editlist < 0) {
@@ -5434,7 +5438,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -5512,6 +5516,54 @@ static int get_moov_size(AVFormatContext *s)
     return ffio_close_null_buf(moov_buf);
 }
 
+/*
+ * With faststart, estimate the size of the moov atom from the expected
+ * duration, to reserve its space before the media data. The sample tables
+ * take, per sample, 4 bytes in stsz, and at most 8 in ctts, 4 in stss and
+ * 8 in co64 with one chunk per sample. Return -1 without an expected
+ * duration, for the second pass.
+ */
+static int estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int64_t duration = mov->faststart_duration, size = 4096;
+    int i;
+
+    /* the duration hints of the caller */
+    for (i = 0; !mov->faststart_duration && i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        if (st->duration > 0)
+            duration = FFMAX(duration, av_rescale_q(st->duration, st->time_base,
+                                                    AV_TIME_BASE_Q));
+    }
+    if (duration <= 0)
+        return -1;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVCodecContext *enc = s->streams[i]->codec;
+        double rate = 1;
+        int sample_size = 24;
+
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
+            AVRational fr = s->streams[i]->avg_frame_rate;
+            if (fr.num > 0 && fr.den > 0)
+                rate = av_q2d(fr);
+            else if (enc->time_base.num > 0 && enc->time_base.den > 0)
+                rate = 1 / av_q2d(enc->time_base);
+            else
+                rate = 60;
+        } else if (enc->codec_type == AVMEDIA_TYPE_AUDIO) {
+            /* no ctts nor stss, and several samples per chunk */
+            rate = enc->sample_rate / (double)(enc->frame_size > 0 ? enc->frame_size : 1024);
+            sample_size = 8;
+        }
+        size += rate * duration / AV_TIME_BASE * sample_size + 1024;
+    }
+    /* a margin for the estimate of the sample rates */
+    size += size / 8;
+    return FFMIN(size, INT_MAX);
+}
+
 static int get_sidx_size(AVFormatContext *s)
 {
     int ret;
@@ -5671,6 +5723,22 @@ static int mov_write_trailer(AVFormatContext *s)
     if (!(mov->flags & FF_MOV_FLAG_FRAGMENT)) {
         moov_pos = avio_tell(pb);
 
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size > 0) {
+            /* the space reserved from the estimate, followed by a free atom */
+            if ((res = get_moov_size(s)) < 0)
+                goto error;
+            if (res + 8 > mov->reserved_moov_size) {
+                av_log(s, AV_LOG_INFO, "The space reserved for the moov atom is too small, "
+                       "needed %d bytes instead of %d\n", res + 8, mov->reserved_moov_size);
+                /* the reserved space is moved after the moov, as a free atom */
+                avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+                avio_wb32(pb, mov->reserved_moov_size);
+                ffio_wfourcc(pb, "free");
+                avio_seek(pb, moov_pos, SEEK_SET);
+                mov->reserved_moov_size = -1;
+            }
+        }
+
         /* Write size of mdat tag */
         if (mov->mdat_size + 8 <= UINT32_MAX) {
             avio_seek(pb, mov->mdat_pos, SEEK_SET);
@@ -5686,7 +5754,7 @@ static int mov_write_trailer(AVFormatContext *s)
         }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
             res = shift_data(s);
             if (res == 0) {
@@ -195,6 +195,7 @@ typedef struct MOVMuxContext {
 
     int reserved_moov_size; ///< 0 for disabled, -1 for automatic, size otherwise
     int64_t reserved_header_pos;
+    int64_t faststart_duration;
 
     char *major_brand;
 
@@ -669,6 +669,7 @@ AVInputFormat ff_mpegps_demuxer = {
     .long_name      = NULL_IF_CONFIG_SMALL("MPEG-PS (MPEG-2 Program Stream)"),
     .priv_data_size = sizeof(MpegDemuxContext),
     .read_probe     = mpegps_probe,
+    .probe_score_max = AVPROBE_SCORE_EXTENSION + 2,
     .read_header    = mpegps_read_header,
     .read_packet    = mpegps_read_packet,
     .read_timestamp = mpegps_read_dts,
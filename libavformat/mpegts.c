@@ -148,6 +148,8 @@ struct MpegTSContext {
 
     int resync_size;
 
+    char *index_file;
+
     /******************************************/
     /* private mpegts data */
     /* scan context */
@@ -155,6 +157,13 @@ struct MpegTSContext {
     unsigned int nb_prg;
     struct Program *prg;
 
+    /** pids only comprised in discarded programs, see update_discard_pids() */
+    uint8_t discard_pids[NB_PID_MAX];
+    /** if false, discard_pids must be updated before use */
+    int discard_pids_valid;
+    /** if true, discard_pids is not all zero */
+    int has_discard_pids;
+
     int8_t crc_validity[NB_PID_MAX];
     /** filters for various streams specified by PMT + for the PAT and PMT */
     MpegTSFilter *pids[NB_PID_MAX];
@@ -176,6 +185,8 @@ static const AVOption options[] = {
      {.i64 = 0}, 0, 1, 0 },
     {"skip_clear", "skip clearing programs", offsetof(MpegTSContext, skip_clear), AV_OPT_TYPE_BOOL,
      {.i64 = 0}, 0, 1, 0 },
+    {"index_file", "load the keyframes from a packet index file written by ffprobe", offsetof(MpegTSContext, index_file), AV_OPT_TYPE_STRING,
+     {.str = NULL}, 0, 0, AV_OPT_FLAG_DECODING_PARAM },
     { NULL },
 };
 
@@ -281,12 +292,14 @@ static void clear_program(MpegTSContext *ts, unsigned int programid)
             ts->prg[i].nb_pids = 0;
             ts->prg[i].pmt_found = 0;
         }
+    ts->discard_pids_valid = 0;
 }
 
 static void clear_programs(MpegTSContext *ts)
 {
     av_freep(&ts->prg);
     ts->nb_prg = 0;
+    ts->discard_pids_valid = 0;
 }
 
 static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
@@ -301,6 +314,7 @@ static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
     p->nb_pids = 0;
     p->pmt_found = 0;
     ts->nb_prg++;
+    ts->discard_pids_valid = 0;
 }
 
 static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid,
@@ -319,6 +333,7 @@ static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid,
             return;
 
     p->pids[p->nb_pids++] = pid;
+    ts->discard_pids_valid = 0;
 }
 
 static void set_pmt_found(MpegTSContext *ts, unsigned int programid)
@@ -342,45 +357,62 @@ static void set_pcr_pid(AVFormatContext *s, unsigned int programid, unsigned int
 }
 
 /**
- * @brief discard_pid() decides if the pid is to be discarded according
- *                      to caller's programs selection
+ * @brief update_discard_pids() marks in ts->discard_pids the pids to be
+ *                              discarded according to caller's programs
+ *                              selection, i.e. the pids only comprised in
+ *                              programs that have .discard=AVDISCARD_ALL
  * @param ts    : - TS context
- * @param pid   : - pid
- * @return 1 if the pid is only comprised in programs that have .discard=AVDISCARD_ALL
- *         0 otherwise
  */
-static int discard_pid(MpegTSContext *ts, unsigned int pid)
+static void update_discard_pids(MpegTSContext *ts)
 {
-    int i, j, k;
-    int used = 0, discarded = 0;
+    int i, j, k, discard;
     struct Program *p;
 
+    ts->discard_pids_valid = 1;
+    if (ts->has_discard_pids)
+        memset(ts->discard_pids, 0, sizeof(ts->discard_pids));
+    ts->has_discard_pids = 0;
+
     /* If none of the programs have .discard=AVDISCARD_ALL then there's
-     * no way we have to discard this packet */
+     * no way we have to discard a packet */
     for (k = 0; k < ts->stream->nb_programs; k++)
         if (ts->stream->programs[k]->discard == AVDISCARD_ALL)
             break;
     if (k == ts->stream->nb_programs)
-        return 0;
+        return;
 
-    for (i = 0; i < ts->nb_prg; i++) {
-        p = &ts->prg[i];
-        for (j = 0; j < p->nb_pids; j++) {
-            if (p->pids[j] != pid)
-                continue;
+    /* first mark the pids of the discarded programs, then unmark the ones
+     * also comprised in a used program */
+    for (discard = 1; discard >= 0; discard--) {
+        for (i = 0; i < ts->nb_prg; i++) {
+            p = &ts->prg[i];
             // is program with id p->id set to be discarded?
-            for (k = 0; k < ts->stream->nb_programs; k++) {
-                if (ts->stream->programs[k]->id == p->id) {
-                    if (ts->stream->programs[k]->discard == AVDISCARD_ALL)
-                        discarded++;
-                    else
-                        used++;
-                }
-            }
+            for (k = 0; k < ts->stream->nb_programs; k++)
+                if (ts->stream->programs[k]->id == p->id &&
+                    (ts->stream->programs[k]->discard == AVDISCARD_ALL) == discard)
+                    break;
+            if (k == ts->stream->nb_programs)
+                continue;
+            for (j = 0; j < p->nb_pids; j++)
+                ts->discard_pids[p->pids[j]] = discard;
+            ts->has_discard_pids |= discard;
         }
     }
+}
 
-    return !used && discarded;
+/**
+ * @brief discard_pid() decides if the pid is to be discarded according
+ *                      to caller's programs selection
+ * @param ts    : - TS context
+ * @param pid   : - pid
+ * @return 1 if the pid is only comprised in programs that have .discard=AVDISCARD_ALL
+ *         0 otherwise
+ */
+static av_always_inline int discard_pid(MpegTSContext *ts, unsigned int pid)
+{
+    if (!ts->discard_pids_valid)
+        update_discard_pids(ts);
+    return ts->discard_pids[pid];
 }
 
 /**
@@ -2423,6 +2455,9 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         }
     }
 
+    /* the caller may have changed the programs to discard since last time */
+    ts->discard_pids_valid = 0;
+
     ts->stop_parse = 0;
     packet_num = 0;
     memset(packet + TS_PACKET_SIZE, 0, AV_INPUT_BUFFER_PADDING_SIZE);
@@ -2559,6 +2594,11 @@ static int mpegts_read_header(AVFormatContext *s)
         av_log(ts->stream, AV_LOG_TRACE, "tuning done\n");
 
         s->ctx_flags |= AVFMTCTX_NOHEADER;
+
+        /* seeking then starts from the indexed keyframes instead of
+         * bisecting the whole file */
+        if (ts->index_file && ff_load_index_file(s, ts->index_file) < 0)
+            av_log(s, AV_LOG_WARNING, "Seeking without the index file\n");
     } else {
         AVStream *st;
         int pcr_pid, pid, nb_packets, nb_pcrs, ret, pcr_l;
@@ -2811,6 +2851,7 @@ int avpriv_mpegts_parse_packet(MpegTSContext *ts, AVPacket *pkt,
 
     len1 = len;
     ts->pkt = pkt;
+    ts->discard_pids_valid = 0;
     for (;;) {
         ts->stop_parse = 0;
         if (len < TS_PACKET_SIZE)
@@ -109,6 +109,8 @@ typedef struct MpegTSWrite {
     int64_t last_sdt_ts;
 
     int omit_video_pes_length;
+
+    uint8_t null_packet[TS_PACKET_SIZE]; ///< prebuilt CBR stuffing packet
 } MpegTSWrite;
 
 /* a PES packet header is generated every DEFAULT_PES_HEADER_FREQ packets */
@@ -799,6 +801,12 @@ static int mpegts_init(AVFormatContext *s)
     ts->sdt.write_packet = section_write_packet;
     ts->sdt.opaque       = s;
 
+    ts->null_packet[0] = 0x47;
+    ts->null_packet[1] = 0x00 | 0x1f;
+    ts->null_packet[2] = 0xff;
+    ts->null_packet[3] = 0x10;
+    memset(ts->null_packet + 4, 0xff, TS_PACKET_SIZE - 4);
+
     pids = av_malloc_array(s->nb_streams, sizeof(*pids));
     if (!pids) {
         ret = AVERROR(ENOMEM);
@@ -1019,17 +1027,10 @@ static int write_pcr_bits(uint8_t *buf, int64_t pcr)
 /* Write a single null transport stream packet */
 static void mpegts_insert_null_packet(AVFormatContext *s)
 {
-    uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
+    MpegTSWrite *ts = s->priv_data;
 
-    q    = buf;
-    *q++ = 0x47;
-    *q++ = 0x00 | 0x1f;
-    *q++ = 0xff;
-    *q++ = 0x10;
-    memset(q, 0x0FF, TS_PACKET_SIZE - (q - buf));
     mpegts_prefix_m2ts_header(s);
-    avio_write(s->pb, buf, TS_PACKET_SIZE);
+    avio_write(s->pb, ts->null_packet, TS_PACKET_SIZE);
 }
 
 /* Write a single transport stream packet with a PCR and no payload */
@@ -1348,17 +1349,19 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
             }
         }
 
+        /* the payload is written from the packet data, only the header
+         * goes through the local buffer */
+        mpegts_prefix_m2ts_header(s);
+        avio_write(s->pb, buf, TS_PACKET_SIZE - len);
         if (is_dvb_subtitle && payload_size == len) {
-            memcpy(buf + TS_PACKET_SIZE - len, payload, len - 1);
-            buf[TS_PACKET_SIZE - 1] = 0xff; /* end_of_PES_data_field_marker: an 8-bit field with fixed contents 0xff for DVB subtitle */
+            avio_write(s->pb, payload, len - 1);
+            avio_w8(s->pb, 0xff); /* end_of_PES_data_field_marker: an 8-bit field with fixed contents 0xff for DVB subtitle */
         } else {
-            memcpy(buf + TS_PACKET_SIZE - len, payload, len);
+            avio_write(s->pb, payload, len);
         }
 
         payload      += len;
         payload_size -= len;
-        mpegts_prefix_m2ts_header(s);
-        avio_write(s->pb, buf, TS_PACKET_SIZE);
     }
     ts_st->prev_payload_key = key;
 }
@@ -88,4 +88,5 @@ static int mpegvideo_probe(AVProbeData *p)
     return 0;
 }
 
-FF_DEF_RAWVIDEO_DEMUXER(mpegvideo, "raw MPEG video", mpegvideo_probe, NULL, AV_CODEC_ID_MPEG1VIDEO)
+FF_DEF_RAWVIDEO_DEMUXER3(mpegvideo, "raw MPEG video", mpegvideo_probe, NULL, AV_CODEC_ID_MPEG1VIDEO,
+                         AVFMT_GENERIC_INDEX, AVPROBE_SCORE_EXTENSION + 1)
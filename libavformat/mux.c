@@ -821,9 +821,16 @@ int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
     AVStream *st   = s->streams[pkt->stream_index];
     int chunked    = s->max_chunk_size || s->max_chunk_duration;
 
-    this_pktl      = av_mallocz(sizeof(AVPacketList));
-    if (!this_pktl)
-        return AVERROR(ENOMEM);
+    if (s->internal->packet_pool) {
+        this_pktl = s->internal->packet_pool;
+        s->internal->packet_pool = this_pktl->next;
+        s->internal->packet_pool_size--;
+        memset(this_pktl, 0, sizeof(*this_pktl));
+    } else {
+        this_pktl = av_mallocz(sizeof(AVPacketList));
+        if (!this_pktl)
+            return AVERROR(ENOMEM);
+    }
     if ((pkt->flags & AV_PKT_FLAG_UNCODED_FRAME)) {
         av_assert0(pkt->size == UNCODED_FRAME_PACKET_SIZE);
         av_assert0(((AVFrame *)pkt->data)->buf);
@@ -985,7 +992,13 @@ int ff_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out,
 
         if (st->last_in_packet_buffer == pktl)
             st->last_in_packet_buffer = NULL;
-        av_freep(&pktl);
+
+        if (s->internal->packet_pool_size < PACKET_POOL_MAX_SIZE) {
+            pktl->next = s->internal->packet_pool;
+            s->internal->packet_pool = pktl;
+            s->internal->packet_pool_size++;
+        } else
+            av_freep(&pktl);
 
         return 1;
     } else {
@@ -90,6 +90,8 @@ typedef struct MXFPartition {
     int64_t index_byte_count;
     int pack_length;
     int64_t pack_ofs;               ///< absolute offset of pack in file, including run-in
+    uint64_t body_offset;           ///< offset of the partition essence in the essence container
+    int index_skipped;              ///< IndexTableSegments not read, see mxf_index_covers_partitions()
 } MXFPartition;
 
 typedef struct MXFCryptoContext {
@@ -234,6 +236,8 @@ typedef struct MXFIndexTable {
     MXFIndexTableSegment **segments;    /* sorted by IndexStartPosition */
     AVIndexEntry *fake_index;   /* used for calling ff_index_search_timestamp() */
     int8_t *offsets;            /* temporal offsets for display order to stored order conversion */
+    int64_t *edit_unit_offsets; /* maps EditUnit - first IndexStartPosition -> absolute offset, VBR only */
+    int nb_edit_unit_offsets;
 } MXFIndexTable;
 
 typedef struct MXFContext {
@@ -249,6 +253,9 @@ typedef struct MXFContext {
     uint8_t *local_tags;
     int local_tags_count;
     uint64_t footer_partition;
+    uint64_t *rip_offsets;          ///< ByteOffsets of the RandomIndexPack, sorted
+    int nb_rip_offsets;
+    int footer_index;               ///< the FooterPartition has IndexTableSegments
     KLVPacket current_klv_data;
     int current_klv_index;
     int run_in;
@@ -291,6 +298,7 @@ static const uint8_t mxf_crypto_source_container_ul[]      = { 0x06,0x0e,0x2b,0x
 static const uint8_t mxf_encrypted_triplet_key[]           = { 0x06,0x0e,0x2b,0x34,0x02,0x04,0x01,0x07,0x0d,0x01,0x03,0x01,0x02,0x7e,0x01,0x00 };
 static const uint8_t mxf_encrypted_essence_container[]     = { 0x06,0x0e,0x2b,0x34,0x04,0x01,0x01,0x07,0x0d,0x01,0x03,0x01,0x02,0x0b,0x01,0x00 };
 static const uint8_t mxf_random_index_pack_key[]           = { 0x06,0x0e,0x2b,0x34,0x02,0x05,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x11,0x01,0x00 };
+static const uint8_t mxf_index_table_segment_key[]         = { 0x06,0x0e,0x2b,0x34,0x02,0x53,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x10,0x01,0x00 };
 static const uint8_t mxf_sony_mpeg4_extradata[]            = { 0x06,0x0e,0x2b,0x34,0x04,0x01,0x01,0x01,0x0e,0x06,0x06,0x02,0x02,0x01,0x00,0x00 };
 static const uint8_t mxf_avid_project_name[]               = { 0xa5,0xfb,0x7b,0x25,0xf6,0x15,0x94,0xb9,0x62,0xfc,0x37,0x17,0x49,0x2d,0x42,0xbf };
 static const uint8_t mxf_jp2k_rsiz[]                       = { 0x06,0x0e,0x2b,0x34,0x02,0x05,0x01,0x01,0x0d,0x01,0x02,0x01,0x01,0x02,0x01,0x00 };
@@ -564,7 +572,7 @@ static int mxf_read_partition_pack(void *arg, AVIOContext *pb, int tag, int size
     partition->header_byte_count = avio_rb64(pb);
     partition->index_byte_count = avio_rb64(pb);
     partition->index_sid = avio_rb32(pb);
-    avio_skip(pb, 8);
+    partition->body_offset = avio_rb64(pb);
     partition->body_sid = avio_rb32(pb);
     if (avio_read(pb, op, sizeof(UID)) != sizeof(UID)) {
         av_log(mxf->fc, AV_LOG_ERROR, "Failed reading UID\n");
@@ -1299,6 +1307,30 @@ static int mxf_edit_unit_absolute_offset(MXFContext *mxf, MXFIndexTable *index_t
     int i;
     int64_t offset_temp = 0;
 
+    if (index_table->edit_unit_offsets) {
+        int64_t start = index_table->segments[0]->index_start_position;
+
+        edit_unit = FFMAX(edit_unit, start);    /* clamp if trying to seek before start */
+
+        if (edit_unit - start < index_table->nb_edit_unit_offsets) {
+            int64_t offset = index_table->edit_unit_offsets[edit_unit - start];
+
+            if (offset < 0) {
+                av_log(mxf->fc, AV_LOG_ERROR,
+                       "failed to find absolute offset of EditUnit %"PRId64" in BodySID %i - partial file?\n",
+                       edit_unit, index_table->body_sid);
+                return AVERROR_INVALIDDATA;
+            }
+
+            if (edit_unit_out)
+                *edit_unit_out = edit_unit;
+            *offset_out = offset;
+            return 0;
+        }
+
+        goto not_found;
+    }
+
     for (i = 0; i < index_table->nb_segments; i++) {
         MXFIndexTableSegment *s = index_table->segments[i];
 
@@ -1336,6 +1368,7 @@ static int mxf_edit_unit_absolute_offset(MXFContext *mxf, MXFIndexTable *index_t
         }
     }
 
+not_found:
     if (nag)
         av_log(mxf->fc, AV_LOG_ERROR, "failed to map EditUnit %"PRId64" in IndexSID %i to an offset\n", edit_unit, index_table->index_sid);
 
@@ -1456,6 +1489,71 @@ static int mxf_compute_ptses_fake_index(MXFContext *mxf, MXFIndexTable *index_ta
     return 0;
 }
 
+/**
+ * Flattens the IndexEntryArrays of a VBR index table into the absolute file
+ * offset of each EditUnit, so that seeking and mxf_set_current_edit_unit()
+ * don't have to walk all the segments and partitions.
+ * Tables with CBR or non-contiguous segments are left to
+ * mxf_edit_unit_absolute_offset().
+ */
+static int mxf_compute_edit_unit_offsets(MXFContext *mxf, MXFIndexTable *index_table)
+{
+    int i, j, x, p = 0;
+    int64_t nb_edit_units = 0, start = index_table->segments[0]->index_start_position;
+    int64_t partition_start = 0;    /* essence container offset of partition p */
+
+    for (i = 0; i < index_table->nb_segments; i++) {
+        MXFIndexTableSegment *s = index_table->segments[i];
+
+        if (s->edit_unit_byte_count || !s->index_duration ||
+            s->index_start_position != start + nb_edit_units ||
+            s->nb_index_entries < s->index_duration)
+            return 0;
+
+        nb_edit_units += s->index_duration;
+    }
+
+    if (nb_edit_units > INT_MAX / sizeof(*index_table->edit_unit_offsets))
+        return 0;
+
+    index_table->edit_unit_offsets = av_malloc_array(nb_edit_units, sizeof(*index_table->edit_unit_offsets));
+    if (!index_table->edit_unit_offsets)
+        return AVERROR(ENOMEM);
+    index_table->nb_edit_unit_offsets = nb_edit_units;
+
+    for (i = x = 0; i < index_table->nb_segments; i++) {
+        MXFIndexTableSegment *s = index_table->segments[i];
+        int index_delta = s->nb_index_entries == 2 * s->index_duration + 1 ? 2 : 1; /* Avid index */
+
+        for (j = 0; j < s->index_duration; j++, x++) {
+            int64_t offset = s->stream_offset_entries[j * index_delta];
+
+            /* the offsets normally increase, so resume from the last partition */
+            if (offset < partition_start) {
+                p = 0;
+                partition_start = 0;
+            }
+
+            index_table->edit_unit_offsets[x] = -1;
+            for (; p < mxf->partitions_count; p++) {
+                MXFPartition *part = &mxf->partitions[p];
+
+                if (part->body_sid != index_table->body_sid)
+                    continue;
+
+                if (offset - partition_start < part->essence_length || !part->essence_length) {
+                    index_table->edit_unit_offsets[x] = part->essence_offset + offset - partition_start;
+                    break;
+                }
+
+                partition_start += part->essence_length;
+            }
+        }
+    }
+
+    return 0;
+}
+
 /**
  * Sorts and collects index table segments into index tables.
  * Also computes PTSes if possible.
@@ -1544,6 +1642,9 @@ static int mxf_compute_index_tables(MXFContext *mxf)
             t->segments[k]->index_duration = mxf->fc->streams[0]->duration;
             break;
         }
+
+        if ((ret = mxf_compute_edit_unit_offsets(mxf, t)) < 0)
+            goto finish_decoding_index;
     }
 
     ret = 0;
@@ -2413,6 +2514,29 @@ static int mxf_parse_klv(MXFContext *mxf, KLVPacket klv, MXFMetadataReadFunc *re
     return 0;
 }
 
+/**
+ * Returns the offset of the partition before the given one, from the RIP if
+ * it lists the partition, which does not depend on PreviousPartition being
+ * set properly
+ */
+static uint64_t mxf_previous_partition(MXFContext *mxf, MXFPartition *partition)
+{
+    int lo = 1, hi = mxf->nb_rip_offsets - 1;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) >> 1;
+
+        if (mxf->rip_offsets[mid] == partition->this_partition)
+            return mxf->rip_offsets[mid - 1];
+        if (mxf->rip_offsets[mid] < partition->this_partition)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+
+    return partition->previous_partition;
+}
+
 /**
  * Seeks to the previous partition and parses it, if possible
  * @return <= 0 if we should stop parsing, > 0 if we should keep going
@@ -2422,15 +2546,19 @@ static int mxf_seek_to_previous_partition(MXFContext *mxf)
     AVIOContext *pb = mxf->fc->pb;
     KLVPacket klv;
     int64_t current_partition_ofs;
+    uint64_t previous_partition;
     int ret;
 
-    if (!mxf->current_partition ||
-        mxf->run_in + mxf->current_partition->previous_partition <= mxf->last_forward_tell)
+    if (!mxf->current_partition)
+        return 0;
+
+    previous_partition = mxf_previous_partition(mxf, mxf->current_partition);
+    if (mxf->run_in + previous_partition <= mxf->last_forward_tell)
         return 0;   /* we've parsed all partitions */
 
     /* seek to previous partition */
     current_partition_ofs = mxf->current_partition->pack_ofs;   //includes run-in
-    avio_seek(pb, mxf->run_in + mxf->current_partition->previous_partition, SEEK_SET);
+    avio_seek(pb, mxf->run_in + previous_partition, SEEK_SET);
     mxf->current_partition = NULL;
 
     av_log(mxf->fc, AV_LOG_TRACE, "seeking to previous partition\n");
@@ -2516,6 +2644,111 @@ static int mxf_parse_handle_partition_or_eof(MXFContext *mxf)
     return mxf->parsing_backward ? mxf_seek_to_previous_partition(mxf) : 1;
 }
 
+/**
+ * Checks whether the IndexTableSegments read so far for the given IndexSID
+ * cover the essence of all partitions, which makes the ones skipped in the
+ * body partitions redundant. This is the case of files with a complete index
+ * in the footer.
+ */
+static int mxf_index_covers_partitions(MXFContext *mxf, int index_sid)
+{
+    uint64_t next_edit_unit = 0, end = 0;
+    int i, body_sid = -1;
+
+    /* follow the segments from EditUnit 0 */
+    for (;;) {
+        MXFIndexTableSegment *segment = NULL;
+
+        for (i = 0; i < mxf->metadata_sets_count; i++) {
+            MXFIndexTableSegment *s = (MXFIndexTableSegment *)mxf->metadata_sets[i];
+
+            if (s->type == IndexTableSegment && s->index_sid == index_sid &&
+                s->index_start_position == next_edit_unit && s->index_duration) {
+                segment = s;
+                break;
+            }
+        }
+        if (!segment)
+            break;
+
+        if (segment->edit_unit_byte_count)
+            end += segment->edit_unit_byte_count * segment->index_duration;
+        else if (segment->nb_index_entries)
+            end = segment->stream_offset_entries[segment->nb_index_entries - 1] + 1;
+        else
+            return 0;
+
+        body_sid        = segment->body_sid;
+        next_edit_unit += segment->index_duration;
+    }
+
+    if (body_sid < 0)
+        return 0;
+
+    for (i = 0; i < mxf->partitions_count; i++) {
+        MXFPartition *p = &mxf->partitions[i];
+
+        if (p->body_sid == body_sid && p->body_offset >= end)
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Reads the IndexTableSegments of the body partitions that were skipped
+ * because of a footer index, if the latter turns out to be incomplete
+ */
+static int mxf_read_skipped_index_segments(MXFContext *mxf)
+{
+    AVIOContext *pb = mxf->fc->pb;
+    int i, ret, index_sid = -1;
+    KLVPacket klv;
+
+    for (i = 0; i < mxf->partitions_count; i++) {
+        MXFPartition *p = &mxf->partitions[i];
+
+        if (p->index_skipped && p->index_sid != index_sid) {
+            index_sid = p->index_sid;
+            if (!mxf_index_covers_partitions(mxf, index_sid))
+                break;
+        }
+    }
+    if (i == mxf->partitions_count)
+        return 0;
+
+    av_log(mxf->fc, AV_LOG_VERBOSE, "incomplete footer index, reading the body partition indexes\n");
+
+    for (i = 0; i < mxf->partitions_count; i++) {
+        MXFPartition *p = &mxf->partitions[i];
+
+        if (!p->index_skipped)
+            continue;
+        p->index_skipped = 0;
+
+        if ((ret = avio_seek(pb, p->pack_ofs + p->pack_length, SEEK_SET)) < 0)
+            return ret;
+
+        while (klv_read_packet(&klv, pb) >= 0) {
+            if (IS_KLV_KEY(klv.key, mxf_index_table_segment_key)) {
+                if ((ret = mxf_parse_klv(mxf, klv, mxf_read_index_table_segment,
+                                         sizeof(MXFIndexTableSegment), IndexTableSegment)) < 0)
+                    return ret;
+            } else if (mxf_is_partition_pack_key(klv.key) ||
+                       IS_KLV_KEY(klv.key, mxf_encrypted_triplet_key) ||
+                       IS_KLV_KEY(klv.key, mxf_essence_element_key) ||
+                       IS_KLV_KEY(klv.key, mxf_avid_essence_element_key) ||
+                       IS_KLV_KEY(klv.key, mxf_system_item_key)) {
+                break;
+            } else {
+                avio_skip(pb, klv.length);
+            }
+        }
+    }
+
+    return 0;
+}
+
 /**
  * Figures out the proper offset and length of the essence container in each partition
  */
@@ -2657,6 +2890,7 @@ static void mxf_read_random_index_pack(AVFormatContext *s)
     uint32_t length;
     int64_t file_size, max_rip_length, min_rip_length;
     KLVPacket klv;
+    int i, nb_entries, sorted = 1;
 
     if (!s->pb->seekable)
         return;
@@ -2689,15 +2923,37 @@ static void mxf_read_random_index_pack(AVFormatContext *s)
         klv.length != length - 20)
         goto end;
 
-    avio_skip(s->pb, klv.length - 12);
-    mxf->footer_partition = avio_rb64(s->pb);
+    nb_entries = (klv.length - 4) / 12;
+    if ((klv.length - 4) % 12 ||
+        !(mxf->rip_offsets = av_malloc_array(nb_entries, sizeof(*mxf->rip_offsets)))) {
+        /* only use the last entry */
+        avio_skip(s->pb, klv.length - 12);
+        mxf->footer_partition = avio_rb64(s->pb);
+        sorted = 0;
+    } else {
+        for (i = 0; i < nb_entries; i++) {
+            avio_skip(s->pb, 4);    /* BodySID */
+            mxf->rip_offsets[i] = avio_rb64(s->pb);
+
+            if (i && mxf->rip_offsets[i] <= mxf->rip_offsets[i - 1])
+                sorted = 0;
+        }
+        mxf->footer_partition = mxf->rip_offsets[nb_entries - 1];
+    }
 
     /* sanity check */
     if (mxf->run_in + mxf->footer_partition >= file_size) {
         av_log(s, AV_LOG_WARNING, "bad FooterPartition in RIP - ignoring\n");
         mxf->footer_partition = 0;
+        sorted = 0;
     }
 
+    /* only use the partition offsets if they look sane */
+    if (sorted)
+        mxf->nb_rip_offsets = nb_entries;
+    else
+        av_freep(&mxf->rip_offsets);
+
 end:
     avio_seek(s->pb, mxf->run_in, SEEK_SET);
 }
@@ -2787,6 +3043,16 @@ static int mxf_read_header(AVFormatContext *s)
 
         for (metadata = mxf_metadata_read_table; metadata->read; metadata++) {
             if (IS_KLV_KEY(klv.key, metadata->key)) {
+                if (metadata->type == IndexTableSegment && mxf->current_partition) {
+                    if (mxf->current_partition->type == Footer) {
+                        mxf->footer_index = 1;
+                    } else if (mxf->footer_index && mxf->current_partition->type == BodyPartition) {
+                        /* read later if the footer index is incomplete */
+                        mxf->current_partition->index_skipped = 1;
+                        avio_skip(s->pb, klv.length);
+                        break;
+                    }
+                }
                 if ((ret = mxf_parse_klv(mxf, klv, metadata->read, metadata->ctx_size, metadata->type)) < 0)
                     goto fail;
                 break;
@@ -2804,6 +3070,10 @@ static int mxf_read_header(AVFormatContext *s)
         ret = AVERROR_INVALIDDATA;
         goto fail;
     }
+
+    if ((ret = mxf_read_skipped_index_segments(mxf)) < 0)
+        goto fail;
+
     avio_seek(s->pb, essence_offset, SEEK_SET);
 
     mxf_compute_essence_containers(mxf);
@@ -3117,6 +3387,7 @@ static int mxf_read_close(AVFormatContext *s)
         mxf_free_metadataset(mxf->metadata_sets + i, 1);
     }
     av_freep(&mxf->partitions);
+    av_freep(&mxf->rip_offsets);
     av_freep(&mxf->metadata_sets);
     av_freep(&mxf->aesc);
     av_freep(&mxf->local_tags);
@@ -3127,6 +3398,7 @@ static int mxf_read_close(AVFormatContext *s)
             av_freep(&mxf->index_tables[i].ptses);
             av_freep(&mxf->index_tables[i].fake_index);
             av_freep(&mxf->index_tables[i].offsets);
+            av_freep(&mxf->index_tables[i].edit_unit_offsets);
         }
     }
     av_freep(&mxf->index_tables);
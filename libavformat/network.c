@@ -24,7 +24,10 @@
 #include "url.h"
 #include "libavcodec/internal.h"
 #include "libavutil/avutil.h"
+#include "libavutil/avassert.h"
+#include "libavutil/avstring.h"
 #include "libavutil/mem.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 
 int ff_tls_init(void)
@@ -199,9 +202,14 @@ int ff_listen(int fd, const struct sockaddr *addr,
     if (ret)
         return ff_neterrno();
 
-    ret = listen(fd, 1);
+    /* a long queue lets a multi-client server take connections arriving
+     * while it handles another one */
+    ret = listen(fd, SOMAXCONN);
     if (ret)
         return ff_neterrno();
+    /* so that accept() cannot block if the client went away after poll() */
+    if (ff_socket_nonblock(fd, 1) < 0)
+        av_log(NULL, AV_LOG_DEBUG, "ff_socket_nonblock failed\n");
     return ret;
 }
 
@@ -210,13 +218,24 @@ int ff_accept(int fd, int timeout, URLContext *h)
     int ret;
     struct pollfd lp = { fd, POLLIN, 0 };
 
-    ret = ff_poll_interrupt(&lp, 1, timeout, &h->interrupt_callback);
-    if (ret < 0)
-        return ret;
+    for (;;) {
+        ret = ff_poll_interrupt(&lp, 1, timeout, &h->interrupt_callback);
+        if (ret < 0)
+            return ret;
 
-    ret = accept(fd, NULL, NULL);
-    if (ret < 0)
-        return ff_neterrno();
+        ret = accept(fd, NULL, NULL);
+        if (ret >= 0)
+            break;
+        ret = ff_neterrno();
+        /* the pending connection was taken by another process sharing the
+         * socket, or aborted by the client */
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)
+#ifdef ECONNABORTED
+            && ret != AVERROR(ECONNABORTED)
+#endif
+            )
+            return ret;
+    }
     if (ff_socket_nonblock(ret, 1) < 0)
         av_log(NULL, AV_LOG_DEBUG, "ff_socket_nonblock failed\n");
 
@@ -280,6 +299,352 @@ int ff_listen_connect(int fd, const struct sockaddr *addr,
     return ret;
 }
 
+/* Copy an address list into a single allocation, freed with av_free() */
+static struct addrinfo *copy_addrinfo(const struct addrinfo *ai)
+{
+    const struct addrinfo *cur;
+    struct addrinfo *res, *dst;
+    uint8_t *addr;
+    size_t size = 0;
+    int nb = 0;
+
+    for (cur = ai; cur; cur = cur->ai_next) {
+        size += FFALIGN(cur->ai_addrlen, sizeof(void *));
+        nb++;
+    }
+    if (!nb)
+        return NULL;
+    res = av_malloc(nb * sizeof(*res) + size);
+    if (!res)
+        return NULL;
+
+    addr = (uint8_t *)(res + nb);
+    for (cur = ai, dst = res; cur; cur = cur->ai_next, dst++) {
+        *dst = *cur;
+        dst->ai_canonname = NULL;
+        dst->ai_addr      = (struct sockaddr *)addr;
+        dst->ai_next      = cur->ai_next ? dst + 1 : NULL;
+        memcpy(addr, cur->ai_addr, cur->ai_addrlen);
+        addr += FFALIGN(cur->ai_addrlen, sizeof(void *));
+    }
+    return res;
+}
+
+#define DNS_CACHE_SIZE 64
+
+typedef struct DNSCacheEntry {
+    char *node;
+    char *service;
+    int family, socktype, protocol, flags;
+    int64_t expiry;
+    struct addrinfo *ai;
+} DNSCacheEntry;
+
+static DNSCacheEntry dns_cache[DNS_CACHE_SIZE];
+static AVMutex dns_cache_mutex;
+static AVOnce dns_cache_once = AV_ONCE_INIT;
+
+static void dns_cache_init(void)
+{
+    ff_mutex_init(&dns_cache_mutex, NULL);
+}
+
+static void dns_cache_entry_free(DNSCacheEntry *e)
+{
+    av_freep(&e->node);
+    av_freep(&e->service);
+    av_freep(&e->ai);
+}
+
+static DNSCacheEntry *dns_cache_find(const char *node, const char *service,
+                                     const struct addrinfo *hints)
+{
+    int i;
+
+    for (i = 0; i < DNS_CACHE_SIZE; i++) {
+        DNSCacheEntry *e = &dns_cache[i];
+        if (e->ai &&
+            !strcmp(e->node, node) && !strcmp(e->service, service) &&
+            e->family   == hints->ai_family   &&
+            e->socktype == hints->ai_socktype &&
+            e->protocol == hints->ai_protocol &&
+            e->flags    == hints->ai_flags)
+            return e;
+    }
+    return NULL;
+}
+
+/* the free or expired entry to reuse, or else the one expiring first */
+static DNSCacheEntry *dns_cache_slot(int64_t now)
+{
+    DNSCacheEntry *slot = &dns_cache[0];
+    int i;
+
+    for (i = 0; i < DNS_CACHE_SIZE; i++) {
+        DNSCacheEntry *e = &dns_cache[i];
+        if (!e->ai || e->expiry <= now)
+            return e;
+        if (e->expiry < slot->expiry)
+            slot = e;
+    }
+    return slot;
+}
+
+int ff_getaddrinfo_cached(const char *node, const char *service,
+                          const struct addrinfo *hints, struct addrinfo **res,
+                          int cache_timeout)
+{
+    DNSCacheEntry *e;
+    struct addrinfo *ai;
+    int64_t now = 0;
+    int ret;
+
+    *res = NULL;
+    if (cache_timeout > 0 && node) {
+        ff_thread_once(&dns_cache_once, dns_cache_init);
+        now = av_gettime_relative();
+        ff_mutex_lock(&dns_cache_mutex);
+        e = dns_cache_find(node, service, hints);
+        if (e && e->expiry > now)
+            *res = copy_addrinfo(e->ai);
+        ff_mutex_unlock(&dns_cache_mutex);
+        if (*res)
+            return 0;
+    }
+
+    ret = getaddrinfo(node, service, hints, &ai);
+    if (ret)
+        return ret;
+    *res = copy_addrinfo(ai);
+    freeaddrinfo(ai);
+    if (!*res)
+        return EAI_MEMORY;
+
+    if (cache_timeout > 0 && node) {
+        ff_mutex_lock(&dns_cache_mutex);
+        if (!(e = dns_cache_find(node, service, hints)))
+            e = dns_cache_slot(now);
+        dns_cache_entry_free(e);
+        e->node     = av_strdup(node);
+        e->service  = av_strdup(service);
+        e->ai       = copy_addrinfo(*res);
+        if (!e->node || !e->service || !e->ai) {
+            dns_cache_entry_free(e);
+        } else {
+            e->family   = hints->ai_family;
+            e->socktype = hints->ai_socktype;
+            e->protocol = hints->ai_protocol;
+            e->flags    = hints->ai_flags;
+            e->expiry   = now + cache_timeout * 1000000LL;
+        }
+        ff_mutex_unlock(&dns_cache_mutex);
+    }
+    return 0;
+}
+
+/* Reorder the list so that the address families alternate, keeping the
+ * relative order within each family, as described in RFC 8305 */
+static void interleave_addrinfo(struct addrinfo *base)
+{
+    struct addrinfo **next = &base->ai_next;
+    while (*next) {
+        struct addrinfo *cur = *next;
+        /* look for the next entry of another family */
+        if (cur->ai_family == base->ai_family) {
+            next = &cur->ai_next;
+            continue;
+        }
+        if (cur == base->ai_next) {
+            base = cur;
+            next = &base->ai_next;
+            continue;
+        }
+        /* move it right after base; everything between was of the
+         * family of base, so next still points to the following entry */
+        *next         = cur->ai_next;
+        cur->ai_next  = base->ai_next;
+        base->ai_next = cur;
+        base          = cur->ai_next;
+    }
+}
+
+typedef struct ConnectionAttempt {
+    int fd;
+    int64_t deadline_us;
+    struct addrinfo *addr;
+} ConnectionAttempt;
+
+/* Delay before starting a connection attempt to the next address while
+ * the previous ones are still pending, as recommended by RFC 8305 */
+#define NEXT_ATTEMPT_DELAY_MS 250
+#define MAX_PARALLEL_ATTEMPTS 3
+
+/* return 1 if connected, 0 if in progress, AVERROR on failure */
+static int start_connect_attempt(ConnectionAttempt *attempt,
+                                 struct addrinfo **ptr, int timeout,
+                                 URLContext *h,
+                                 void (*customize_fd)(void *, int),
+                                 void *customize_ctx)
+{
+    struct addrinfo *ai = *ptr;
+    int ret;
+
+    *ptr = ai->ai_next;
+
+    attempt->fd = ff_socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (attempt->fd < 0)
+        return ff_neterrno();
+    attempt->deadline_us = timeout > 0 ?
+                           av_gettime_relative() + timeout * 1000LL : INT64_MAX;
+    attempt->addr = ai;
+
+    if (ff_socket_nonblock(attempt->fd, 1) < 0)
+        av_log(NULL, AV_LOG_DEBUG, "ff_socket_nonblock failed\n");
+
+    if (customize_fd)
+        customize_fd(customize_ctx, attempt->fd);
+
+    while ((ret = connect(attempt->fd, ai->ai_addr, ai->ai_addrlen))) {
+        ret = ff_neterrno();
+        switch (ret) {
+        case AVERROR(EINTR):
+            if (ff_check_interrupt(&h->interrupt_callback)) {
+                ret = AVERROR_EXIT;
+                break;
+            }
+            continue;
+        case AVERROR(EINPROGRESS):
+        case AVERROR(EAGAIN):
+            return 0;
+        }
+        break;
+    }
+    if (ret) {
+        closesocket(attempt->fd);
+        attempt->fd = -1;
+        return ret;
+    }
+    return 1;
+}
+
+static void log_attempt(URLContext *h, const struct addrinfo *ai,
+                        const char *msg, int err)
+{
+    char host[100], port[20], errbuf[100] = "";
+
+    if (getnameinfo(ai->ai_addr, ai->ai_addrlen, host, sizeof(host),
+                    port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV)) {
+        av_strlcpy(host, "unknown", sizeof(host));
+        port[0] = 0;
+    }
+    if (err)
+        av_strerror(err, errbuf, sizeof(errbuf));
+    av_log(h, AV_LOG_VERBOSE, "%s %s port %s%s%s\n",
+           msg, host, port, err ? ": " : "", errbuf);
+}
+
+int ff_connect_parallel(struct addrinfo *addrs, int timeout, int parallel,
+                        URLContext *h, int *fd,
+                        void (*customize_fd)(void *, int), void *customize_ctx)
+{
+    ConnectionAttempt attempts[MAX_PARALLEL_ATTEMPTS];
+    struct pollfd pfd[MAX_PARALLEL_ATTEMPTS];
+    int nb_attempts = 0, i, j;
+    int64_t next_attempt_us = av_gettime_relative(), next_deadline_us, now;
+    int last_err = AVERROR(EIO);
+    socklen_t optlen;
+    char errbuf[100];
+
+    parallel = av_clip(parallel, 1, MAX_PARALLEL_ATTEMPTS);
+
+    /* the head of the list stays the same, so the caller can free it */
+    interleave_addrinfo(addrs);
+
+    while (nb_attempts > 0 || addrs) {
+        if (nb_attempts < parallel && addrs &&
+            (!nb_attempts || av_gettime_relative() >= next_attempt_us)) {
+            struct addrinfo *ai = addrs;
+            log_attempt(h, ai, "Starting connection attempt to", 0);
+            last_err = start_connect_attempt(&attempts[nb_attempts], &addrs,
+                                             timeout, h,
+                                             customize_fd, customize_ctx);
+            if (last_err == AVERROR_EXIT)
+                break;
+            if (last_err < 0) {
+                log_attempt(h, ai, "Connection attempt failed to", last_err);
+                continue;
+            }
+            if (last_err > 0) {
+                for (i = 0; i < nb_attempts; i++)
+                    closesocket(attempts[i].fd);
+                *fd = attempts[nb_attempts].fd;
+                return 0;
+            }
+            pfd[nb_attempts].fd      = attempts[nb_attempts].fd;
+            pfd[nb_attempts].events  = POLLOUT;
+            pfd[nb_attempts].revents = 0;
+            next_attempt_us = av_gettime_relative() + NEXT_ATTEMPT_DELAY_MS * 1000;
+            nb_attempts++;
+        }
+
+        av_assert0(nb_attempts > 0);
+        /* the attempts are sorted from the oldest, which expires first */
+        next_deadline_us = attempts[0].deadline_us;
+        if (nb_attempts < parallel && addrs)
+            next_deadline_us = FFMIN(next_deadline_us, next_attempt_us);
+        now = av_gettime_relative();
+        last_err = ff_poll_interrupt(pfd, nb_attempts,
+                                     next_deadline_us == INT64_MAX ? 0 :
+                                     FFMAX((next_deadline_us - now) / 1000, 1),
+                                     &h->interrupt_callback);
+        if (last_err < 0 && last_err != AVERROR(ETIMEDOUT))
+            break;
+
+        now = av_gettime_relative();
+        for (i = 0; i < nb_attempts; i++) {
+            last_err = 0;
+            if (pfd[i].revents) {
+                optlen = sizeof(last_err);
+                if (getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &last_err, &optlen))
+                    last_err = ff_neterrno();
+                else if (last_err)
+                    last_err = AVERROR(last_err);
+                if (!last_err) {
+                    for (j = 0; j < nb_attempts; j++)
+                        if (j != i)
+                            closesocket(attempts[j].fd);
+                    *fd = attempts[i].fd;
+                    log_attempt(h, attempts[i].addr, "Connected to", 0);
+                    return 0;
+                }
+            }
+            if (!last_err && attempts[i].deadline_us <= now)
+                last_err = AVERROR(ETIMEDOUT);
+            if (!last_err)
+                continue;
+            /* drop the failed attempt, letting the next one start now */
+            log_attempt(h, attempts[i].addr, "Connection attempt failed to", last_err);
+            closesocket(attempts[i].fd);
+            memmove(&attempts[i], &attempts[i + 1],
+                    (nb_attempts - i - 1) * sizeof(*attempts));
+            memmove(&pfd[i], &pfd[i + 1], (nb_attempts - i - 1) * sizeof(*pfd));
+            i--;
+            nb_attempts--;
+            next_attempt_us = now;
+        }
+    }
+    for (i = 0; i < nb_attempts; i++)
+        closesocket(attempts[i].fd);
+    if (last_err >= 0)
+        last_err = AVERROR(ECONNREFUSED);
+    if (last_err != AVERROR_EXIT) {
+        av_strerror(last_err, errbuf, sizeof(errbuf));
+        av_log(h, AV_LOG_ERROR, "Connection to %s failed: %s\n",
+               h->filename, errbuf);
+    }
+    return last_err;
+}
+
 static int match_host_pattern(const char *pattern, const char *hostname)
 {
     int len_p, len_h;
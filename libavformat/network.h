@@ -256,6 +256,8 @@ int ff_listen_bind(int fd, const struct sockaddr *addr,
 
 /**
  * Bind to a file descriptor to an address without accepting connections.
+ * The socket is made non-blocking and can queue up to SOMAXCONN pending
+ * connections.
  * @param fd      First argument of bind().
  * @param addr    Second argument of bind().
  * @param addrlen Third argument of bind().
@@ -264,7 +266,8 @@ int ff_listen_bind(int fd, const struct sockaddr *addr,
 int ff_listen(int fd, const struct sockaddr *addr, socklen_t addrlen);
 
 /**
- * Poll for a single connection on the passed file descriptor.
+ * Poll for a single connection on the passed file descriptor, until one
+ * can be accepted.
  * @param fd      The listening socket file descriptor.
  * @param timeout Polling timeout in milliseconds.
  * @param h       URLContext providing interrupt check
@@ -293,6 +296,41 @@ int ff_listen_connect(int fd, const struct sockaddr *addr,
                       socklen_t addrlen, int timeout,
                       URLContext *h, int will_try_next);
 
+/**
+ * Resolve a host name like getaddrinfo(), optionally through a cache shared
+ * by the whole process.
+ *
+ * @param cache_timeout Time in seconds during which the result is reused
+ *                      for the same node, service and hints, 0 to disable
+ *                      the cache.
+ * @param res      Set to the list of addresses, to be freed with av_free()
+ *                 instead of freeaddrinfo(); ai_canonname is not set.
+ * @return         0 on success, an EAI_ error code on failure.
+ */
+int ff_getaddrinfo_cached(const char *node, const char *service,
+                          const struct addrinfo *hints, struct addrinfo **res,
+                          int cache_timeout);
+
+/**
+ * Connect to any of the given addresses, starting new connection attempts
+ * in parallel while the previous ones are pending, as described in
+ * RFC 8305 (Happy Eyeballs).
+ *
+ * @param addrs    The list of addresses, reordered in place so that the
+ *                 address families alternate; its head does not change.
+ * @param timeout  Timeout in milliseconds for each connection attempt.
+ * @param parallel Maximum number of concurrent attempts.
+ * @param h        URLContext providing interrupt check
+ *                 callback and logging context.
+ * @param fd       Set to the non-blocking connected socket on success.
+ * @param customize_fd Function called on each socket before connect(),
+ *                 with customize_ctx, or NULL.
+ * @return         0 on success, AVERROR on failure.
+ */
+int ff_connect_parallel(struct addrinfo *addrs, int timeout, int parallel,
+                        URLContext *h, int *fd,
+                        void (*customize_fd)(void *, int), void *customize_ctx);
+
 int ff_http_match_no_proxy(const char *no_proxy, const char *hostname);
 
 int ff_socket(int domain, int type, int protocol);
@@ -51,12 +51,13 @@ static const AVClass name ## _demuxer_class = {\
     .version    = LIBAVUTIL_VERSION_INT,\
 };
 
-#define FF_DEF_RAWVIDEO_DEMUXER2(shortname, longname, probe, ext, id, flag)\
+#define FF_DEF_RAWVIDEO_DEMUXER3(shortname, longname, probe, ext, id, flag, score_max)\
 FF_RAWVIDEO_DEMUXER_CLASS(shortname)\
 AVInputFormat ff_ ## shortname ## _demuxer = {\
     .name           = #shortname,\
     .long_name      = NULL_IF_CONFIG_SMALL(longname),\
     .read_probe     = probe,\
+    .probe_score_max = score_max,\
     .read_header    = ff_raw_video_read_header,\
     .read_packet    = ff_raw_read_partial_packet,\
     .extensions     = ext,\
@@ -66,6 +67,9 @@ AVInputFormat ff_ ## shortname ## _demuxer = {\
     .priv_class     = &shortname ## _demuxer_class,\
 };
 
+#define FF_DEF_RAWVIDEO_DEMUXER2(shortname, longname, probe, ext, id, flag)\
+FF_DEF_RAWVIDEO_DEMUXER3(shortname, longname, probe, ext, id, flag, 0)
+
 #define FF_DEF_RAWVIDEO_DEMUXER(shortname, longname, probe, ext, id)\
 FF_DEF_RAWVIDEO_DEMUXER2(shortname, longname, probe, ext, id, AVFMT_GENERIC_INDEX)
 
@@ -302,15 +302,27 @@ int ff_rtmp_packet_read_internal(URLContext *h, RTMPPacket *p, int chunk_size,
     }
 }
 
-int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
-                         int chunk_size, RTMPPacket **prev_pkt_ptr,
-                         int *nb_prev_pkt)
+static void put_basic_header(uint8_t **p, int channel_id, int mode)
 {
-    uint8_t pkt_hdr[16], *p = pkt_hdr;
+    if (channel_id < 64) {
+        bytestream_put_byte(p, channel_id | (mode << 6));
+    } else if (channel_id < 64 + 256) {
+        bytestream_put_byte(p, 0          | (mode << 6));
+        bytestream_put_byte(p, channel_id - 64);
+    } else {
+        bytestream_put_byte(p, 1          | (mode << 6));
+        bytestream_put_le16(p, channel_id - 64);
+    }
+}
+
+int ff_rtmp_packet_serialize(RTMPPacket *pkt, int chunk_size,
+                             RTMPPacket **prev_pkt_ptr, int *nb_prev_pkt,
+                             uint8_t **buf, unsigned int *buf_size)
+{
+    uint8_t *p;
     int mode = RTMP_PS_TWELVEBYTES;
     int off = 0;
-    int written = 0;
-    int ret;
+    int ret, nb_chunks, max_size;
     RTMPPacket *prev_pkt;
     int use_delta; // flag if using timestamp delta, not RTMP_PS_TWELVEBYTES
     uint32_t timestamp; // full 32-bit timestamp or delta value
@@ -320,6 +332,17 @@ int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
         return ret;
     prev_pkt = *prev_pkt_ptr;
 
+    /* each chunk has at most a 3 bytes basic header, the first one an
+     * 11 bytes message header, and all an extended timestamp */
+    nb_chunks = pkt->size ? (pkt->size + chunk_size - 1) / chunk_size : 1;
+    if (nb_chunks > (INT_MAX - 11 - pkt->size) / 7)
+        return AVERROR(EINVAL);
+    max_size = pkt->size + 11 + nb_chunks * 7;
+    av_fast_malloc(buf, buf_size, max_size);
+    if (!*buf)
+        return AVERROR(ENOMEM);
+    p = *buf;
+
     //if channel_id = 0, this is first presentation of prev_pkt, send full hdr.
     use_delta = prev_pkt[pkt->channel_id].channel_id &&
         pkt->extra == prev_pkt[pkt->channel_id].extra &&
@@ -346,15 +369,7 @@ int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
         }
     }
 
-    if (pkt->channel_id < 64) {
-        bytestream_put_byte(&p, pkt->channel_id | (mode << 6));
-    } else if (pkt->channel_id < 64 + 256) {
-        bytestream_put_byte(&p, 0               | (mode << 6));
-        bytestream_put_byte(&p, pkt->channel_id - 64);
-    } else {
-        bytestream_put_byte(&p, 1               | (mode << 6));
-        bytestream_put_le16(&p, pkt->channel_id - 64);
-    }
+    put_basic_header(&p, pkt->channel_id, mode);
     if (mode != RTMP_PS_ONEBYTE) {
         bytestream_put_be24(&p, pkt->ts_field);
         if (mode != RTMP_PS_FOURBYTES) {
@@ -374,29 +389,36 @@ int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
     prev_pkt[pkt->channel_id].ts_field   = pkt->ts_field;
     prev_pkt[pkt->channel_id].extra      = pkt->extra;
 
-    if ((ret = ffurl_write(h, pkt_hdr, p - pkt_hdr)) < 0)
-        return ret;
-    written = p - pkt_hdr + pkt->size;
     while (off < pkt->size) {
         int towrite = FFMIN(chunk_size, pkt->size - off);
-        if ((ret = ffurl_write(h, pkt->data + off, towrite)) < 0)
-            return ret;
+        bytestream_put_buffer(&p, pkt->data + off, towrite);
         off += towrite;
         if (off < pkt->size) {
-            uint8_t marker = 0xC0 | pkt->channel_id;
-            if ((ret = ffurl_write(h, &marker, 1)) < 0)
-                return ret;
-            written++;
-            if (pkt->ts_field == 0xFFFFFF) {
-                uint8_t ts_header[4];
-                AV_WB32(ts_header, timestamp);
-                if ((ret = ffurl_write(h, ts_header, 4)) < 0)
-                    return ret;
-                written += 4;
-            }
+            put_basic_header(&p, pkt->channel_id, RTMP_PS_ONEBYTE);
+            if (pkt->ts_field == 0xFFFFFF)
+                bytestream_put_be32(&p, timestamp);
         }
     }
-    return written;
+    return p - *buf;
+}
+
+int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
+                         int chunk_size, RTMPPacket **prev_pkt_ptr,
+                         int *nb_prev_pkt)
+{
+    uint8_t *buf = NULL;
+    unsigned int buf_size = 0;
+    int ret, size;
+
+    /* send all the chunks of the packet at once */
+    size = ff_rtmp_packet_serialize(pkt, chunk_size, prev_pkt_ptr, nb_prev_pkt,
+                                    &buf, &buf_size);
+    if (size < 0)
+        return size;
+    ret = ffurl_write(h, buf, size);
+    av_free(buf);
+
+    return ret < 0 ? ret : size;
 }
 
 int ff_rtmp_packet_create(RTMPPacket *pkt, int channel_id, RTMPPacketType type,
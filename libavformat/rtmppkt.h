@@ -136,6 +136,22 @@ int ff_rtmp_packet_read_internal(URLContext *h, RTMPPacket *p, int chunk_size,
                                  RTMPPacket **prev_pkt, int *nb_prev_pkt,
                                  uint8_t c);
 
+/**
+ * Split an RTMP packet into the chunks sent to the peer.
+ *
+ * @param p          packet to split
+ * @param chunk_size current chunk size
+ * @param prev_pkt   previously sent packet headers for all channels
+ *                   (may be used for packet header compressing)
+ * @param nb_prev_pkt number of allocated elements in prev_pkt
+ * @param buf        buffer for the chunks, reallocated with av_fast_malloc()
+ * @param buf_size   allocated size of buf
+ * @return size of the chunks on success, negative value otherwise
+ */
+int ff_rtmp_packet_serialize(RTMPPacket *p, int chunk_size,
+                             RTMPPacket **prev_pkt, int *nb_prev_pkt,
+                             uint8_t **buf, unsigned int *buf_size);
+
 /**
  * Send RTMP packet to the server.
  *
@@ -130,6 +130,17 @@ typedef struct RTMPContext {
     char          auth_params[500];
     int           do_reconnect;
     int           auth_tried;
+    int           chunk_size;                 ///< chunk size to announce to the server when publishing
+    int           send_buffer_size;           ///< maximum size of the queued audio and video data, 0 to send it right away
+    RTMPPacket    *send_queue;                ///< audio and video packets waiting to be sent
+    unsigned int  send_queue_alloc;           ///< allocated size of send_queue in bytes
+    int           nb_send_queue;              ///< number of packets in send_queue
+    int64_t       send_queue_bytes;           ///< size of the packets in send_queue
+    uint8_t       *send_buf;                  ///< chunks of the packet being sent
+    unsigned int  send_buf_size;              ///< allocated size of send_buf
+    int           send_buf_len;               ///< size of the chunks in send_buf
+    int           send_buf_off;               ///< number of bytes of send_buf already sent
+    int           drop_video;                 ///< dropping video packets until the next keyframe
 } RTMPContext;
 
 #define PLAYER_KEY_OPEN_PART_LEN 30   ///< length of partial key used for first client digest signing
@@ -893,6 +904,31 @@ static int gen_server_bw(URLContext *s, RTMPContext *rt)
     return rtmp_send_packet(rt, &pkt, 0);
 }
 
+/**
+ * Generate chunk size message and send it to the server, then use the new
+ * chunk size for the following packets.
+ */
+static int gen_chunk_size(URLContext *s, RTMPContext *rt, int chunk_size)
+{
+    RTMPPacket pkt;
+    uint8_t *p;
+    int ret;
+
+    if ((ret = ff_rtmp_packet_create(&pkt, RTMP_SYSTEM_CHANNEL, RTMP_PT_CHUNK_SIZE,
+                                     0, 4)) < 0)
+        return ret;
+
+    p = pkt.data;
+    bytestream_put_be32(&p, chunk_size);
+
+    if ((ret = rtmp_send_packet(rt, &pkt, 0)) < 0)
+        return ret;
+    rt->out_chunk_size = chunk_size;
+    av_log(s, AV_LOG_DEBUG, "Sending chunks of %d bytes\n", chunk_size);
+
+    return 0;
+}
+
 /**
  * Generate check bandwidth message and send it to the server.
  */
@@ -2048,6 +2084,11 @@ static int handle_invoke_result(URLContext *s, RTMPPacket *pkt)
 
     if (!strcmp(tracked_method, "connect")) {
         if (!rt->is_input) {
+            if (rt->chunk_size != rt->out_chunk_size) {
+                if ((ret = gen_chunk_size(s, rt, rt->chunk_size)) < 0)
+                    goto fail;
+            }
+
             if ((ret = gen_release_stream(s, rt)) < 0)
                 goto fail;
 
@@ -2476,6 +2517,157 @@ static int get_packet(URLContext *s, int for_header)
     }
 }
 
+/**
+ * Send the chunks of the packet being sent, and of the queued packets if
+ * all is set, without waiting for the network unless block is set.
+ */
+static int send_queued_packets(URLContext *s, int all, int block)
+{
+    RTMPContext *rt = s->priv_data;
+    int ret;
+
+    for (;;) {
+        if (rt->send_buf_off == rt->send_buf_len) {
+            RTMPPacket pkt;
+
+            if (!all || !rt->nb_send_queue)
+                return 0;
+            pkt = rt->send_queue[0];
+            memmove(rt->send_queue, rt->send_queue + 1,
+                    --rt->nb_send_queue * sizeof(*rt->send_queue));
+            rt->send_queue_bytes -= pkt.size;
+
+            /* the chunk headers depend on the previously sent packets, so
+             * packets are only split when it is their turn to be sent */
+            ret = ff_rtmp_packet_serialize(&pkt, rt->out_chunk_size,
+                                           &rt->prev_pkt[1], &rt->nb_prev_pkt[1],
+                                           &rt->send_buf, &rt->send_buf_size);
+            ff_rtmp_packet_destroy(&pkt);
+            if (ret < 0)
+                return ret;
+            rt->send_buf_len = ret;
+            rt->send_buf_off = 0;
+        }
+
+        if (!block)
+            rt->stream->flags |= AVIO_FLAG_NONBLOCK;
+        ret = ffurl_write(rt->stream, rt->send_buf + rt->send_buf_off,
+                          rt->send_buf_len - rt->send_buf_off);
+        rt->stream->flags &= ~AVIO_FLAG_NONBLOCK;
+
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        if (ret < 0)
+            return ret;
+        rt->send_buf_off += ret;
+    }
+}
+
+static int is_video_keyframe(const RTMPPacket *pkt)
+{
+    return pkt->type == RTMP_PT_VIDEO && pkt->size &&
+           (pkt->data[0] & 0xf0) == FLV_FRAME_KEY;
+}
+
+/**
+ * Remove the queued packets selected by drop, oldest first, until the
+ * queue has room for size more bytes.
+ *
+ * @return number of removed packets
+ */
+static int drop_queued_packets(RTMPContext *rt, int size,
+                               int (*drop)(const RTMPPacket *pkt))
+{
+    int i = 0, nb_dropped = 0;
+
+    while (i < rt->nb_send_queue &&
+           rt->send_queue_bytes + size > rt->send_buffer_size) {
+        RTMPPacket *pkt = &rt->send_queue[i];
+
+        if (!drop(pkt)) {
+            i++;
+            continue;
+        }
+        rt->send_queue_bytes -= pkt->size;
+        ff_rtmp_packet_destroy(pkt);
+        memmove(pkt, pkt + 1, (--rt->nb_send_queue - i) * sizeof(*pkt));
+        nb_dropped++;
+    }
+    return nb_dropped;
+}
+
+static int is_inter_video(const RTMPPacket *pkt)
+{
+    return pkt->type == RTMP_PT_VIDEO && !is_video_keyframe(pkt);
+}
+
+static int is_video(const RTMPPacket *pkt)
+{
+    return pkt->type == RTMP_PT_VIDEO;
+}
+
+static int is_audio(const RTMPPacket *pkt)
+{
+    return pkt->type == RTMP_PT_AUDIO;
+}
+
+/**
+ * Queue an audio or video packet for sending, taking ownership of its data.
+ * When the network is too slow for the queue to stay under
+ * send_buffer_size, inter video frames are dropped first, then keyframes,
+ * then audio.
+ */
+static int queue_packet(URLContext *s, RTMPPacket *pkt)
+{
+    RTMPContext *rt = s->priv_data;
+    RTMPPacket *queue;
+    int nb_dropped = 0;
+
+    if (pkt->type == RTMP_PT_VIDEO) {
+        if (is_video_keyframe(pkt))
+            rt->drop_video = 0;
+        else if (rt->drop_video)
+            goto drop;
+    }
+
+    if (rt->send_queue_bytes + pkt->size > rt->send_buffer_size) {
+        nb_dropped = drop_queued_packets(rt, pkt->size, is_inter_video);
+        if (nb_dropped)
+            rt->drop_video = 1;
+        if (rt->send_queue_bytes + pkt->size > rt->send_buffer_size) {
+            int n = drop_queued_packets(rt, pkt->size, is_video);
+            if (n)
+                rt->drop_video = 1;
+            nb_dropped += n;
+        }
+        if (rt->send_queue_bytes + pkt->size > rt->send_buffer_size)
+            nb_dropped += drop_queued_packets(rt, pkt->size, is_audio);
+        if (nb_dropped)
+            av_log(s, AV_LOG_WARNING,
+                   "The network is too slow, dropped %d queued packets\n",
+                   nb_dropped);
+        if (is_inter_video(pkt) && rt->drop_video)
+            goto drop;
+    }
+
+    queue = av_fast_realloc(rt->send_queue, &rt->send_queue_alloc,
+                            (rt->nb_send_queue + 1) * sizeof(*rt->send_queue));
+    if (!queue) {
+        ff_rtmp_packet_destroy(pkt);
+        return AVERROR(ENOMEM);
+    }
+    rt->send_queue = queue;
+    rt->send_queue[rt->nb_send_queue++] = *pkt;
+    rt->send_queue_bytes += pkt->size;
+    pkt->data = NULL;
+    pkt->size = 0;
+    return 0;
+
+drop:
+    ff_rtmp_packet_destroy(pkt);
+    return 0;
+}
+
 static int rtmp_close(URLContext *h)
 {
     RTMPContext *rt = h->priv_data;
@@ -2485,6 +2677,12 @@ static int rtmp_close(URLContext *h)
         rt->flv_data = NULL;
         if (rt->out_pkt.size)
             ff_rtmp_packet_destroy(&rt->out_pkt);
+        if (rt->stream)
+            send_queued_packets(h, 1, 1);
+        for (i = 0; i < rt->nb_send_queue; i++)
+            ff_rtmp_packet_destroy(&rt->send_queue[i]);
+        av_freep(&rt->send_queue);
+        av_freep(&rt->send_buf);
         if (rt->state > STATE_FCPUBLISH)
             ret = gen_fcunpublish_stream(h, rt);
     }
@@ -2617,6 +2815,11 @@ static int rtmp_open(URLContext *s, const char *uri, int flags)
                proto);
         return AVERROR(EINVAL);
     }
+    if (rt->send_buffer_size && !rt->is_input && strcmp(proto, "rtmp")) {
+        av_log(s, AV_LOG_WARNING, "rtmp_send_buffer is only supported by "
+               "rtmp, sending the packets right away\n");
+        rt->send_buffer_size = 0;
+    }
     if (!strcmp(proto, "rtmpt") || !strcmp(proto, "rtmpts")) {
         if (!strcmp(proto, "rtmpts"))
             av_dict_set(&opts, "ffrtmphttp_tls", "1", 1);
@@ -2979,6 +3182,9 @@ static int rtmp_write(URLContext *s, const uint8_t *buf, int size)
                                                      &rt->nb_prev_pkt[1],
                                                      channel)) < 0)
                     return ret;
+                // The queued packets must be sent with the current headers
+                if ((ret = send_queued_packets(s, 1, 1)) < 0)
+                    return ret;
                 // Force sending a full 12 bytes header by clearing the
                 // channel id, to make it not match a potential earlier
                 // packet in the same channel.
@@ -3029,7 +3235,14 @@ static int rtmp_write(URLContext *s, const uint8_t *buf, int size)
                 }
             }
 
-            if ((ret = rtmp_send_packet(rt, &rt->out_pkt, 0)) < 0)
+            if (rt->send_buffer_size &&
+                (rt->out_pkt.type == RTMP_PT_AUDIO ||
+                 rt->out_pkt.type == RTMP_PT_VIDEO)) {
+                ret = queue_packet(s, &rt->out_pkt);
+            } else if ((ret = send_queued_packets(s, 1, 1)) >= 0) {
+                ret = rtmp_send_packet(rt, &rt->out_pkt, 0);
+            }
+            if (ret < 0)
                 return ret;
             rt->flv_size = 0;
             rt->flv_off = 0;
@@ -3038,6 +3251,9 @@ static int rtmp_write(URLContext *s, const uint8_t *buf, int size)
         }
     } while (buf_temp - buf < size);
 
+    if ((ret = send_queued_packets(s, 1, 0)) < 0)
+        return ret;
+
     if (rt->flv_nb_packets < rt->flush_interval)
         return size;
     rt->flv_nb_packets = 0;
@@ -3059,6 +3275,10 @@ static int rtmp_write(URLContext *s, const uint8_t *buf, int size)
     } else if (ret == 1) {
         RTMPPacket rpkt = { 0 };
 
+        // The replies must not be sent in the middle of a packet
+        if ((ret = send_queued_packets(s, 0, 1)) < 0)
+            return ret;
+
         if ((ret = ff_rtmp_packet_read_internal(rt->stream, &rpkt,
                                                 rt->in_chunk_size,
                                                 &rt->prev_pkt[0],
@@ -3081,6 +3301,7 @@ static int rtmp_write(URLContext *s, const uint8_t *buf, int size)
 static const AVOption rtmp_options[] = {
     {"rtmp_app", "Name of application to connect to on the RTMP server", OFFSET(app), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, DEC|ENC},
     {"rtmp_buffer", "Set buffer time in milliseconds. The default is 3000.", OFFSET(client_buffer_time), AV_OPT_TYPE_INT, {.i64 = 3000}, 0, INT_MAX, DEC|ENC},
+    {"rtmp_chunk_size", "Size of the chunks sent to the server when publishing.", OFFSET(chunk_size), AV_OPT_TYPE_INT, {.i64 = 4096}, 128, 65536, ENC},
     {"rtmp_conn", "Append arbitrary AMF data to the Connect message", OFFSET(conn), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, DEC|ENC},
     {"rtmp_flashver", "Version of the Flash plugin used to run the SWF player.", OFFSET(flashver), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, DEC|ENC},
     {"rtmp_flush_interval", "Number of packets flushed in the same request (RTMPT only).", OFFSET(flush_interval), AV_OPT_TYPE_INT, {.i64 = 10}, 0, INT_MAX, ENC},
@@ -3090,6 +3311,7 @@ static const AVOption rtmp_options[] = {
     {"recorded", "recorded stream", 0, AV_OPT_TYPE_CONST, {.i64 = 0}, 0, 0, DEC, "rtmp_live"},
     {"rtmp_pageurl", "URL of the web page in which the media was embedded. By default no value will be sent.", OFFSET(pageurl), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, DEC},
     {"rtmp_playpath", "Stream identifier to play or to publish", OFFSET(playpath), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, DEC|ENC},
+    {"rtmp_send_buffer", "Maximum size of the audio and video data queued when the network is slow, dropping data beyond it. 0 sends the data right away.", OFFSET(send_buffer_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, ENC},
     {"rtmp_subscribe", "Name of live stream to subscribe to. Defaults to rtmp_playpath.", OFFSET(subscribe), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, DEC},
     {"rtmp_swfhash", "SHA256 hash of the decompressed SWF file (32 bytes).", OFFSET(swfhash), AV_OPT_TYPE_BINARY, .flags = DEC},
     {"rtmp_swfsize", "Size of the decompressed SWF file, required for SWFVerification.", OFFSET(swfsize), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, DEC},
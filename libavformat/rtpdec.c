@@ -520,6 +520,8 @@ RTPDemuxContext *ff_rtp_parse_open(AVFormatContext *s1, AVStream *st,
     s->ic                  = s1;
     s->st                  = st;
     s->queue_size          = queue_size;
+    /* start from the maximum delay, and lower it while packets arrive in order */
+    s->reorder_delay       = FFMAX(s1->max_delay, 0);
 
     av_log(s->ic, AV_LOG_VERBOSE, "setting jitter buffer size to %d\n",
            s->queue_size);
@@ -714,7 +716,6 @@ static int enqueue_packet(RTPDemuxContext *s, uint8_t *buf, int len)
     packet->next     = *cur;
     *cur = packet;
     s->queue_len++;
-    av_log(0, AV_LOG_ERROR, "queue: %d\n", s->queue_len);
 
     return 0;
 }
@@ -729,6 +730,44 @@ int64_t ff_rtp_queued_packet_time(RTPDemuxContext *s)
     return s->queue ? s->queue->recvtime : 0;
 }
 
+/**
+ * Return how long the queued packets are kept waiting for the missing ones,
+ * in microseconds: unless the delay is adaptive, always the max_delay of
+ * the demuxer, otherwise enough for the packet reordering observed lately
+ * and for the interarrival jitter.
+ */
+int64_t ff_rtp_queue_delay(RTPDemuxContext *s)
+{
+    int64_t jitter = 0;
+
+    if (!s->adaptive_delay)
+        return s->ic->max_delay;
+    if (s->st)
+        jitter = av_rescale_q(s->statistics.jitter >> 4, s->st->time_base,
+                              AV_TIME_BASE_Q);
+    return FFMIN(s->ic->max_delay, FFMAX(s->reorder_delay, 4 * jitter));
+}
+
+static void update_reorder_delay(RTPDemuxContext *s, int64_t now, int late)
+{
+    if (!s->adaptive_delay)
+        return;
+
+    if (late) {
+        /* a packet arrived after the queued ones were returned */
+        s->reorder_delay = FFMAX(2 * s->reorder_delay, 10000);
+    } else if (s->queue) {
+        /* the expected packet arrived while later ones were waiting */
+        int64_t waited = now - s->queue->recvtime;
+        s->reorder_delay = FFMAX(s->reorder_delay, waited + waited / 2);
+    } else if (now - s->last_delay_update > 100000) {
+        /* slowly forget the reordering once the network behaves */
+        s->reorder_delay -= s->reorder_delay >> 6;
+        s->last_delay_update = now;
+    }
+    s->reorder_delay = FFMIN(s->reorder_delay, s->ic->max_delay);
+}
+
 static int rtp_parse_queued_packet(RTPDemuxContext *s, AVPacket *pkt)
 {
     int rv;
@@ -757,6 +796,7 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
     uint8_t *buf = bufptr ? *bufptr : NULL;
     int flags = 0;
     uint32_t timestamp;
+    int64_t received;
     int rv = 0;
 
     if (!buf) {
@@ -787,8 +827,8 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
         return rtcp_parse_packet(s, buf, len);
     }
 
+    received = av_gettime_relative();
     if (s->st) {
-        int64_t received = av_gettime_relative();
         uint32_t arrival_ts = av_rescale_q(received, AV_TIME_BASE_Q,
                                            s->st->time_base);
         timestamp = AV_RB32(buf + 4);
@@ -807,9 +847,11 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
             /* Packet older than the previously emitted one, drop */
             av_log(s->ic, AV_LOG_WARNING,
                    "RTP: dropping old packet received too late\n");
+            update_reorder_delay(s, received, 1);
             return -1;
         } else if (diff <= 1) {
             /* Correct packet */
+            update_reorder_delay(s, received, 0);
             rv = rtp_parse_packet_internal(s, pkt, buf, len);
             return rv;
         } else {
@@ -846,8 +888,11 @@ int ff_rtp_parse_packet(RTPDemuxContext *s, AVPacket *pkt,
         return -1;
     rv = rtp_parse_one_packet(s, pkt, bufptr, len);
     s->prev_ret = rv;
-    while (rv == AVERROR(EAGAIN) && has_next_packet(s))
+    while (rv == AVERROR(EAGAIN) && has_next_packet(s)) {
         rv = rtp_parse_queued_packet(s, pkt);
+        /* the rest of this packet must be returned before the next one */
+        s->prev_ret = rv;
+    }
     return rv ? rv : has_next_packet(s);
 }
 
@@ -50,6 +50,7 @@ int ff_rtp_parse_packet(RTPDemuxContext *s, AVPacket *pkt,
                         uint8_t **buf, int len);
 void ff_rtp_parse_close(RTPDemuxContext *s);
 int64_t ff_rtp_queued_packet_time(RTPDemuxContext *s);
+int64_t ff_rtp_queue_delay(RTPDemuxContext *s);
 void ff_rtp_reset_packet_queue(RTPDemuxContext *s);
 
 /**
@@ -172,6 +173,9 @@ struct RTPDemuxContext {
     RTPPacket* queue; ///< A sorted queue of buffered packets not yet returned
     int queue_len;    ///< The number of packets in queue
     int queue_size;   ///< The size of queue, or 0 if reordering is disabled
+    int adaptive_delay;         ///< Adapt the reordering delay to the network, up to max_delay
+    int64_t reorder_delay;      ///< Time the late packets were waited for, in microseconds
+    int64_t last_delay_update;
     /*@}*/
 
     /* rtcp sender statistics receive */
@@ -0,0 +1,377 @@
+/*
+ * SMPTE 2022-1 FEC recovery of RTP packets
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * SMPTE 2022-1 FEC recovery of RTP packets
+ *
+ * Each FEC packet carries the XOR of the payloads, lengths, payload types
+ * and timestamps of NA media packets, starting at sequence number SNBase
+ * and spaced by Offset: the columns of an L x D matrix of packets are
+ * protected with an offset of L, and its rows with an offset of 1. A
+ * media packet is recovered when it is the only missing one of a FEC
+ * packet; recovering it may in turn make another FEC packet usable.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "avformat.h"
+#include "rtp.h"
+#include "rtpfec.h"
+
+#define RTP_HEADER_SIZE 12
+#define FEC_HEADER_SIZE 16
+
+#define WINDOW_MASK (RTP_FEC_WINDOW - 1)
+
+static int has_media(struct RTPFECContext *s, uint16_t seq)
+{
+    int slot = seq & WINDOW_MASK;
+    return s->media_len[slot] && s->media_seq[slot] == seq &&
+           (uint16_t)(s->last_seq - seq) < RTP_FEC_WINDOW;
+}
+
+static int store_media(struct RTPFECContext *s, const uint8_t *buf, int len)
+{
+    uint16_t seq = AV_RB16(buf + 2);
+    int slot     = seq & WINDOW_MASK;
+
+    av_fast_malloc(&s->media[slot], &s->media_size[slot], len);
+    if (!s->media[slot]) {
+        s->media_len[slot] = 0;
+        return AVERROR(ENOMEM);
+    }
+    memcpy(s->media[slot], buf, len);
+    s->media_len[slot] = len;
+    s->media_seq[slot] = seq;
+
+    if (!s->have_seq || (int16_t)(seq - s->last_seq) > 0)
+        s->last_seq = seq;
+    s->have_seq = 1;
+    return 0;
+}
+
+static void remove_fec(struct RTPFECContext *s, int i)
+{
+    av_freep(&s->fec[i]);
+    s->nb_fec--;
+    memmove(s->fec + i, s->fec + i + 1, (s->nb_fec - i) * sizeof(*s->fec));
+    memmove(s->fec_len + i, s->fec_len + i + 1,
+            (s->nb_fec - i) * sizeof(*s->fec_len));
+}
+
+static int recover(struct RTPFECContext *s, const uint8_t *fec, int fec_len,
+                   uint16_t missing)
+{
+    uint16_t snbase = AV_RB16(fec);
+    int len         = AV_RB16(fec + 2);
+    int pt          = fec[4] & 0x7f;
+    uint32_t ts     = AV_RB32(fec + 8);
+    int offset = fec[13], na = fec[14];
+    uint32_t ssrc = s->ssrc;
+    uint8_t *pkt;
+    int i, j;
+
+    for (i = 0; i < na; i++) {
+        uint16_t seq = snbase + i * offset;
+        const uint8_t *media;
+        if (seq == missing)
+            continue;
+        media = s->media[seq & WINDOW_MASK];
+        len  ^= s->media_len[seq & WINDOW_MASK] - RTP_HEADER_SIZE;
+        pt   ^= media[1] & 0x7f;
+        ts   ^= AV_RB32(media + 4);
+        ssrc  = AV_RB32(media + 8);
+    }
+    if (len > fec_len - FEC_HEADER_SIZE)
+        return AVERROR_INVALIDDATA;
+
+    pkt = av_malloc(RTP_HEADER_SIZE + len);
+    if (!pkt)
+        return AVERROR(ENOMEM);
+    pkt[0] = RTP_VERSION << 6;
+    pkt[1] = pt;
+    AV_WB16(pkt + 2, missing);
+    AV_WB32(pkt + 4, ts);
+    AV_WB32(pkt + 8, ssrc);
+    memcpy(pkt + RTP_HEADER_SIZE, fec + FEC_HEADER_SIZE, len);
+    for (i = 0; i < na; i++) {
+        uint16_t seq = snbase + i * offset;
+        int slot = seq & WINDOW_MASK;
+        int media_len;
+        if (seq == missing)
+            continue;
+        media_len = FFMIN(s->media_len[slot] - RTP_HEADER_SIZE, len);
+        for (j = 0; j < media_len; j++)
+            pkt[RTP_HEADER_SIZE + j] ^= s->media[slot][RTP_HEADER_SIZE + j];
+    }
+
+    if (store_media(s, pkt, RTP_HEADER_SIZE + len) < 0 ||
+        s->nb_recovered == RTP_FEC_MAX_RECOVERED) {
+        av_free(pkt);
+        return AVERROR(ENOMEM);
+    }
+    s->recovered[s->nb_recovered]       = pkt;
+    s->recovered_len[s->nb_recovered++] = RTP_HEADER_SIZE + len;
+    s->nb_recovered_total++;
+    return 0;
+}
+
+/**
+ * Recover the missing media packet of a FEC packet if possible.
+ *
+ * @return 1 if the FEC packet is of no more use, 0 if it must be kept
+ */
+static int try_fec(struct RTPFECContext *s, int i, int *recovered)
+{
+    const uint8_t *fec = s->fec[i];
+    uint16_t snbase = AV_RB16(fec), missing = 0;
+    int offset = fec[13], na = fec[14];
+    int j, nb_missing = 0;
+
+    for (j = 0; j < na; j++) {
+        uint16_t seq = snbase + j * offset;
+        if (!has_media(s, seq)) {
+            missing = seq;
+            nb_missing++;
+        }
+    }
+
+    if (nb_missing == 1) {
+        *recovered = recover(s, fec, s->fec_len[i], missing) >= 0;
+        return 1;
+    }
+    /* too old for the missing packets to ever arrive */
+    return !nb_missing ||
+           (int16_t)(s->last_seq - snbase) >= RTP_FEC_WINDOW / 2;
+}
+
+static void try_all_fec(struct RTPFECContext *s)
+{
+    int i, recovered;
+
+    do {
+        recovered = 0;
+        for (i = 0; i < s->nb_fec; ) {
+            int done = 0;
+            if (try_fec(s, i, &done)) {
+                remove_fec(s, i);
+                recovered |= done;
+            } else {
+                i++;
+            }
+        }
+    } while (recovered);
+}
+
+int ff_rtp_fec_add_media(struct RTPFECContext *s, const uint8_t *buf, int len)
+{
+    uint16_t seq;
+    int reordered;
+
+    if (len < RTP_HEADER_SIZE || (buf[0] & 0xc0) != (RTP_VERSION << 6) ||
+        RTP_PT_IS_RTCP(buf[1]))
+        return 0;
+
+    seq = AV_RB16(buf + 2);
+    if (s->have_seq && has_media(s, seq))
+        return 1;
+
+    reordered = s->have_seq && seq != (uint16_t)(s->last_seq + 1);
+    s->ssrc   = AV_RB32(buf + 8);
+    if (store_media(s, buf, len) < 0)
+        return 0;
+
+    /* a packet received late may complete a FEC packet missing two */
+    if (reordered && s->nb_fec)
+        try_all_fec(s);
+    return 0;
+}
+
+int ff_rtp_fec_add_fec(struct RTPFECContext *s, const uint8_t *buf, int len)
+{
+    int header_len, offset, na;
+
+    if (len < RTP_HEADER_SIZE || (buf[0] & 0xc0) != (RTP_VERSION << 6))
+        return AVERROR_INVALIDDATA;
+    header_len = RTP_HEADER_SIZE + 4 * (buf[0] & 0x0f);
+    if (buf[0] & 0x10) {
+        if (len < header_len + 4)
+            return AVERROR_INVALIDDATA;
+        header_len += 4 + 4 * AV_RB16(buf + header_len + 2);
+    }
+    if (len < header_len + FEC_HEADER_SIZE)
+        return AVERROR_INVALIDDATA;
+    buf += header_len;
+    len -= header_len;
+
+    offset = buf[13];
+    na     = buf[14];
+    /* only the XOR of the 2022-1 level A is supported */
+    if ((buf[12] & 0x38) || !offset || !na ||
+        (na - 1) * offset >= RTP_FEC_WINDOW / 2)
+        return AVERROR_INVALIDDATA;
+
+    if (s->nb_fec == RTP_FEC_MAX_PENDING)
+        remove_fec(s, 0);
+    s->fec[s->nb_fec] = av_memdup(buf, len);
+    if (!s->fec[s->nb_fec])
+        return AVERROR(ENOMEM);
+    s->fec_len[s->nb_fec++] = len;
+
+    if (s->have_seq)
+        try_all_fec(s);
+    return 0;
+}
+
+int ff_rtp_fec_get_recovered(struct RTPFECContext *s, uint8_t *buf, int size)
+{
+    int len;
+
+    if (!s->nb_recovered)
+        return 0;
+    len = FFMIN(s->recovered_len[0], size);
+    memcpy(buf, s->recovered[0], len);
+    av_freep(&s->recovered[0]);
+    s->nb_recovered--;
+    memmove(s->recovered, s->recovered + 1,
+            s->nb_recovered * sizeof(*s->recovered));
+    memmove(s->recovered_len, s->recovered_len + 1,
+            s->nb_recovered * sizeof(*s->recovered_len));
+    return len;
+}
+
+void ff_rtp_fec_free(struct RTPFECContext *s)
+{
+    int i;
+
+    for (i = 0; i < RTP_FEC_WINDOW; i++)
+        av_freep(&s->media[i]);
+    for (i = 0; i < s->nb_fec; i++)
+        av_freep(&s->fec[i]);
+    for (i = 0; i < s->nb_recovered; i++)
+        av_freep(&s->recovered[i]);
+    memset(s, 0, sizeof(*s));
+}
+
+#ifdef TEST
+#include <stdio.h>
+#include "libavutil/lfg.h"
+
+#define L 4
+#define D 3
+#define NB_PACKETS (L * D)
+#define MAX_PAYLOAD 200
+
+static uint8_t media[NB_PACKETS][RTP_HEADER_SIZE + MAX_PAYLOAD];
+static int media_len[NB_PACKETS];
+
+/* build a FEC packet protecting na packets from first, spaced by offset */
+static int make_fec(uint8_t *fec, int first, int offset, int na, int row)
+{
+    uint8_t *p = fec + RTP_HEADER_SIZE;
+    int i, j, len = 0, len_rec = 0, pt = 0;
+    uint32_t ts = 0;
+
+    memset(fec, 0, RTP_HEADER_SIZE + FEC_HEADER_SIZE + MAX_PAYLOAD);
+    fec[0] = RTP_VERSION << 6;
+    fec[1] = 96;
+    for (i = 0; i < na; i++) {
+        const uint8_t *m = media[first + i * offset];
+        int plen = media_len[first + i * offset] - RTP_HEADER_SIZE;
+        len_rec ^= plen;
+        pt      ^= m[1] & 0x7f;
+        ts      ^= AV_RB32(m + 4);
+        for (j = 0; j < plen; j++)
+            p[FEC_HEADER_SIZE + j] ^= m[RTP_HEADER_SIZE + j];
+        len = FFMAX(len, plen);
+    }
+    AV_WB16(p, AV_RB16(media[first] + 2));
+    AV_WB16(p + 2, len_rec);
+    p[4] = 0x80 | pt;
+    AV_WB32(p + 8, ts);
+    p[12] = row << 6;
+    p[13] = offset;
+    p[14] = na;
+    return RTP_HEADER_SIZE + FEC_HEADER_SIZE + len;
+}
+
+int main(void)
+{
+    /* lose a full row, and one more packet: needs both dimensions */
+    static const int lost[] = { 4, 5, 6, 7, 10 };
+    struct RTPFECContext s = { 0 };
+    uint8_t fec[RTP_HEADER_SIZE + FEC_HEADER_SIZE + MAX_PAYLOAD];
+    uint8_t buf[RTP_HEADER_SIZE + MAX_PAYLOAD];
+    int i, j, len, nb_lost = FF_ARRAY_ELEMS(lost), found[NB_PACKETS] = { 0 };
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 1);
+    for (i = 0; i < NB_PACKETS; i++) {
+        uint8_t *m = media[i];
+        media_len[i] = RTP_HEADER_SIZE + 1 + av_lfg_get(&lfg) % MAX_PAYLOAD;
+        m[0] = RTP_VERSION << 6;
+        m[1] = 33;
+        AV_WB16(m + 2, 65530 + i);
+        AV_WB32(m + 4, 1000 * (i / 2));
+        AV_WB32(m + 8, 0x12345678);
+        for (j = RTP_HEADER_SIZE; j < media_len[i]; j++)
+            m[j] = av_lfg_get(&lfg);
+    }
+
+    for (i = 0; i < NB_PACKETS; i++) {
+        for (j = 0; j < nb_lost; j++)
+            if (lost[j] == i)
+                break;
+        if (j == nb_lost && ff_rtp_fec_add_media(&s, media[i], media_len[i]))
+            printf("packet %d reported as duplicate\n", i);
+    }
+    for (i = 0; i < D; i++) {
+        len = make_fec(fec, i * L, 1, L, 1);
+        if (ff_rtp_fec_add_fec(&s, fec, len) < 0)
+            printf("row %d rejected\n", i);
+    }
+    for (i = 0; i < L; i++) {
+        len = make_fec(fec, i, L, D, 0);
+        if (ff_rtp_fec_add_fec(&s, fec, len) < 0)
+            printf("column %d rejected\n", i);
+    }
+
+    while ((len = ff_rtp_fec_get_recovered(&s, buf, sizeof(buf)))) {
+        i = (uint16_t)(AV_RB16(buf + 2) - 65530);
+        if (i >= NB_PACKETS || len != media_len[i] ||
+            memcmp(buf, media[i], len))
+            printf("packet %d recovered wrongly\n", i);
+        else
+            found[i] = 1;
+    }
+    for (j = 0; j < nb_lost; j++)
+        printf("packet %d: %s\n", lost[j],
+               found[lost[j]] ? "recovered" : "missing");
+    if (ff_rtp_fec_add_media(&s, media[lost[0]], media_len[lost[0]]) != 1)
+        printf("late packet not reported as duplicate\n");
+
+    ff_rtp_fec_free(&s);
+    return 0;
+}
+#endif /* TEST */
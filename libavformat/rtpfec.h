@@ -0,0 +1,78 @@
+/*
+ * SMPTE 2022-1 FEC recovery of RTP packets
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_RTPFEC_H
+#define AVFORMAT_RTPFEC_H
+
+#include <stdint.h>
+
+/** Number of media packets kept for recovery, a power of two */
+#define RTP_FEC_WINDOW        512
+/** Number of FEC packets kept while they cannot be used yet */
+#define RTP_FEC_MAX_PENDING   64
+/** Number of recovered packets not yet returned */
+#define RTP_FEC_MAX_RECOVERED 64
+
+struct RTPFECContext {
+    uint8_t *media[RTP_FEC_WINDOW];     ///< received media packets, by sequence number modulo the window
+    unsigned int media_size[RTP_FEC_WINDOW];
+    int media_len[RTP_FEC_WINDOW];      ///< 0 if the slot is empty
+    uint16_t media_seq[RTP_FEC_WINDOW];
+    uint16_t last_seq;                  ///< highest sequence number received
+    int have_seq;
+    uint32_t ssrc;
+
+    uint8_t *fec[RTP_FEC_MAX_PENDING];  ///< FEC headers and payloads, oldest first
+    int fec_len[RTP_FEC_MAX_PENDING];
+    int nb_fec;
+
+    uint8_t *recovered[RTP_FEC_MAX_RECOVERED];
+    int recovered_len[RTP_FEC_MAX_RECOVERED];
+    int nb_recovered;
+
+    unsigned int nb_recovered_total;
+};
+
+/**
+ * Add a media packet received on the RTP port.
+ *
+ * @return 1 if the packet was already recovered and must be dropped,
+ *         0 otherwise
+ */
+int ff_rtp_fec_add_media(struct RTPFECContext *s, const uint8_t *buf, int len);
+
+/**
+ * Add a packet received on a FEC port, and recover the media packets it
+ * allows to.
+ *
+ * @return 0 on success, a negative error code if the packet is invalid
+ */
+int ff_rtp_fec_add_fec(struct RTPFECContext *s, const uint8_t *buf, int len);
+
+/**
+ * Return the next recovered media packet.
+ *
+ * @return the length of the packet, or 0 if no packet is left
+ */
+int ff_rtp_fec_get_recovered(struct RTPFECContext *s, uint8_t *buf, int size);
+
+void ff_rtp_fec_free(struct RTPFECContext *s);
+
+#endif /* AVFORMAT_RTPFEC_H */
@@ -30,6 +30,7 @@
 #include "avformat.h"
 #include "avio_internal.h"
 #include "rtp.h"
+#include "rtpfec.h"
 #include "rtpproto.h"
 #include "url.h"
 
@@ -58,6 +59,10 @@ typedef struct RTPContext {
     int dscp;
     char *sources;
     char *block;
+    int fec;
+    URLContext *fec_hd[2];      ///< column and row FEC
+    int fec_fd[2];
+    struct RTPFECContext fec_ctx;
 } RTPContext;
 
 #define OFFSET(x) offsetof(RTPContext, x)
@@ -75,6 +80,7 @@ static const AVOption options[] = {
     { "dscp",               "DSCP class",                                                       OFFSET(dscp),            AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, .flags = D|E },
     { "sources",            "Source list",                                                      OFFSET(sources),         AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",              "Block list",                                                       OFFSET(block),           AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "fec",                "Recover lost packets with the SMPTE 2022-1 FEC of the two next port pairs", OFFSET(fec), AV_OPT_TYPE_BOOL, { .i64 =  0 },     0, 1,       .flags = D },
     { NULL }
 };
 
@@ -304,6 +310,7 @@ static void rtp_parse_addr_list(URLContext *h, char *buf,
  *         'block=ip[,ip]'    : list disallowed source IP addresses
  *         'write_to_source=0/1' : send packets to the source address of the latest received packet
  *         'dscp=n'           : set DSCP value to n (QoS)
+ *         'fec=0/1'          : receive the FEC packets on the rtp port + 2 and + 4
  * deprecated option:
  *         'localport=n'      : set the local port to n
  *
@@ -360,6 +367,9 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "dscp", p)) {
             s->dscp = strtol(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "fec", p)) {
+            s->fec = strtol(buf, NULL, 10);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "sources", p)) {
             av_strlcpy(include_sources, buf, sizeof(include_sources));
 
@@ -412,6 +422,20 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
         break;
     }
 
+    /* the column and row FEC packets use the two next port pairs */
+    if (s->fec && (flags & AVIO_FLAG_READ)) {
+        for (i = 0; i < 2; i++) {
+            build_udp_url(s, buf, sizeof(buf),
+                          hostname, rtp_port + 2 * (i + 1),
+                          s->local_rtpport + 2 * (i + 1), sources, block);
+            if (ffurl_open_whitelist(&s->fec_hd[i], buf, AVIO_FLAG_READ,
+                                     &h->interrupt_callback, NULL,
+                                     h->protocol_whitelist, h->protocol_blacklist) < 0)
+                goto fail;
+            s->fec_fd[i] = ffurl_get_file_handle(s->fec_hd[i]);
+        }
+    }
+
     /* just to ease handle access. XXX: need to suppress direct handle
        access */
     s->rtp_fd = ffurl_get_file_handle(s->rtp_hd);
@@ -426,6 +450,8 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
         ffurl_close(s->rtp_hd);
     if (s->rtcp_hd)
         ffurl_close(s->rtcp_hd);
+    ffurl_closep(&s->fec_hd[0]);
+    ffurl_closep(&s->fec_hd[1]);
     return AVERROR(EIO);
 }
 
@@ -433,18 +459,26 @@ static int rtp_read(URLContext *h, uint8_t *buf, int size)
 {
     RTPContext *s = h->priv_data;
     int len, n, i;
-    struct pollfd p[2] = {{s->rtp_fd, POLLIN, 0}, {s->rtcp_fd, POLLIN, 0}};
+    struct pollfd p[4] = {{s->rtp_fd, POLLIN, 0}, {s->rtcp_fd, POLLIN, 0},
+                          {s->fec_fd[0], POLLIN, 0}, {s->fec_fd[1], POLLIN, 0}};
+    int nb_fds = s->fec_hd[0] ? 4 : 2;
     int poll_delay = h->flags & AVIO_FLAG_NONBLOCK ? 0 : 100;
-    struct sockaddr_storage *addrs[2] = { &s->last_rtp_source, &s->last_rtcp_source };
-    socklen_t *addr_lens[2] = { &s->last_rtp_source_len, &s->last_rtcp_source_len };
+    struct sockaddr_storage fec_source;
+    socklen_t fec_source_len;
+    struct sockaddr_storage *addrs[4] = { &s->last_rtp_source, &s->last_rtcp_source,
+                                          &fec_source, &fec_source };
+    socklen_t *addr_lens[4] = { &s->last_rtp_source_len, &s->last_rtcp_source_len,
+                                &fec_source_len, &fec_source_len };
 
     for(;;) {
         if (ff_check_interrupt(&h->interrupt_callback))
             return AVERROR_EXIT;
-        n = poll(p, 2, poll_delay);
+        if ((len = ff_rtp_fec_get_recovered(&s->fec_ctx, buf, size)) > 0)
+            return len;
+        n = poll(p, nb_fds, poll_delay);
         if (n > 0) {
-            /* first try RTCP, then RTP */
-            for (i = 1; i >= 0; i--) {
+            /* first try FEC, then RTCP, then RTP */
+            for (i = nb_fds - 1; i >= 0; i--) {
                 if (!(p[i].revents & POLLIN))
                     continue;
                 *addr_lens[i] = sizeof(*addrs[i]);
@@ -458,6 +492,15 @@ static int rtp_read(URLContext *h, uint8_t *buf, int size)
                 }
                 if (rtp_check_source_lists(s, addrs[i]))
                     continue;
+                if (i >= 2) {
+                    if (ff_rtp_fec_add_fec(&s->fec_ctx, buf, len) < 0)
+                        av_log(h, AV_LOG_DEBUG, "Ignoring invalid FEC packet\n");
+                    continue;
+                }
+                /* the packet may have been recovered already */
+                if (!i && s->fec_hd[0] &&
+                    ff_rtp_fec_add_media(&s->fec_ctx, buf, len))
+                    continue;
                 return len;
             }
         } else if (n < 0) {
@@ -465,7 +508,7 @@ static int rtp_read(URLContext *h, uint8_t *buf, int size)
                 continue;
             return AVERROR(EIO);
         }
-        if (h->flags & AVIO_FLAG_NONBLOCK)
+        if (h->flags & AVIO_FLAG_NONBLOCK && !s->fec_ctx.nb_recovered)
             return AVERROR(EAGAIN);
     }
     return len;
@@ -561,6 +604,13 @@ static int rtp_close(URLContext *h)
 
     ffurl_close(s->rtp_hd);
     ffurl_close(s->rtcp_hd);
+    if (s->fec_hd[0]) {
+        av_log(h, AV_LOG_VERBOSE, "%u packets recovered with FEC\n",
+               s->fec_ctx.nb_recovered_total);
+        ffurl_closep(&s->fec_hd[0]);
+        ffurl_closep(&s->fec_hd[1]);
+    }
+    ff_rtp_fec_free(&s->fec_ctx);
     return 0;
 }
 
@@ -598,12 +648,17 @@ static int rtp_get_multi_file_handle(URLContext *h, int **handles,
                                      int *numhandles)
 {
     RTPContext *s = h->priv_data;
-    int *hs       = *handles = av_malloc(sizeof(**handles) * 2);
+    int *hs       = *handles = av_malloc(sizeof(**handles) * 4);
     if (!hs)
         return AVERROR(ENOMEM);
     hs[0] = s->rtp_fd;
     hs[1] = s->rtcp_fd;
     *numhandles = 2;
+    if (s->fec_hd[0]) {
+        hs[2] = s->fec_fd[0];
+        hs[3] = s->fec_fd[1];
+        *numhandles = 4;
+    }
     return 0;
 }
 
@@ -76,6 +76,8 @@
 
 #define COMMON_OPTS() \
     { "reorder_queue_size", "set number of packets to buffer for handling of reordered packets", OFFSET(reordering_queue_size), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, DEC }, \
+    { "adaptive_delay",     "adapt the reordering delay to the network, up to max_delay",    OFFSET(adaptive_delay),        AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, DEC }, \
+    { "recv_fifo_size",     "size of the FIFO of the UDP receiving thread, 0 to disable the thread", OFFSET(recv_fifo_size), AV_OPT_TYPE_INT, { .i64 = HAVE_PTHREADS ? 4 * 1024 * 1024 : 0 }, 0, INT_MAX, DEC }, \
     { "buffer_size",        "Underlying protocol send/receive buffer size",                  OFFSET(buffer_size),           AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, DEC|ENC } \
 
 
@@ -88,7 +90,7 @@ const AVOption ff_rtsp_options[] = {
     { "udp_multicast", "UDP multicast", 0, AV_OPT_TYPE_CONST, {.i64 = 1 << RTSP_LOWER_TRANSPORT_UDP_MULTICAST}, 0, 0, DEC, "rtsp_transport" },
     { "http", "HTTP tunneling", 0, AV_OPT_TYPE_CONST, {.i64 = (1 << RTSP_LOWER_TRANSPORT_HTTP)}, 0, 0, DEC, "rtsp_transport" },
     RTSP_FLAG_OPTS("rtsp_flags", "set RTSP flags"),
-    { "listen", "wait for incoming connections", 0, AV_OPT_TYPE_CONST, {.i64 = RTSP_FLAG_LISTEN}, 0, 0, DEC, "rtsp_flags" },
+    { "listen", "wait for incoming connections", 0, AV_OPT_TYPE_CONST, {.i64 = RTSP_FLAG_LISTEN}, 0, 0, DEC|ENC, "rtsp_flags" },
     { "prefer_tcp", "try RTP via TCP first, if available", 0, AV_OPT_TYPE_CONST, {.i64 = RTSP_FLAG_PREFER_TCP}, 0, 0, DEC|ENC, "rtsp_flags" },
     RTSP_MEDIATYPE_OPTS("allowed_media_types", "set media types to accept from the server"),
     { "min_port", "set minimum local UDP port", OFFSET(rtp_port_min), AV_OPT_TYPE_INT, {.i64 = RTSP_RTP_PORT_MIN}, 0, 65535, DEC|ENC },
@@ -100,8 +102,12 @@ const AVOption ff_rtsp_options[] = {
     { NULL },
 };
 
+#define FEC_OPTS() \
+    { "fec", "recover lost packets with the SMPTE 2022-1 FEC of the two next port pairs", OFFSET(fec), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, DEC }
+
 static const AVOption sdp_options[] = {
     RTSP_FLAG_OPTS("sdp_flags", "SDP flags"),
+    FEC_OPTS(),
     { "custom_io", "use custom I/O", 0, AV_OPT_TYPE_CONST, {.i64 = RTSP_FLAG_CUSTOM_IO}, 0, 0, DEC, "rtsp_flags" },
     { "rtcp_to_source", "send RTCP packets to the source address of received packets", 0, AV_OPT_TYPE_CONST, {.i64 = RTSP_FLAG_RTCP_TO_SOURCE}, 0, 0, DEC, "rtsp_flags" },
     RTSP_MEDIATYPE_OPTS("allowed_media_types", "set media types to accept from the server"),
@@ -111,6 +117,7 @@ static const AVOption sdp_options[] = {
 
 static const AVOption rtp_options[] = {
     RTSP_FLAG_OPTS("rtp_flags", "set RTP flags"),
+    FEC_OPTS(),
     COMMON_OPTS(),
     { NULL },
 };
@@ -123,6 +130,8 @@ static AVDictionary *map_to_opts(RTSPState *rt)
 
     snprintf(buf, sizeof(buf), "%d", rt->buffer_size);
     av_dict_set(&opts, "buffer_size", buf, 0);
+    if (rt->fec)
+        av_dict_set(&opts, "fec", "1", 0);
 
     return opts;
 }
@@ -713,17 +722,169 @@ int ff_sdp_parse(AVFormatContext *s, const char *content)
         av_freep(&s1->default_exclude_source_addrs[i]);
     av_freep(&s1->default_exclude_source_addrs);
 
-    rt->p = av_malloc_array(rt->nb_rtsp_streams + 1, sizeof(struct pollfd) * 2);
+    rt->p = av_malloc_array(rt->nb_rtsp_streams + 1, sizeof(struct pollfd) * 4);
     if (!rt->p) return AVERROR(ENOMEM);
     return 0;
 }
 #endif /* CONFIG_RTPDEC */
 
+#if HAVE_PTHREADS
+static int get_rtp_fds(AVFormatContext *s, struct pollfd *p)
+{
+    RTSPState *rt = s->priv_data;
+    int *fds = NULL, fdsnum, i, j, ret, nb_fds = 0;
+
+    for (i = 0; i < rt->nb_rtsp_streams; i++) {
+        RTSPStream *rtsp_st = rt->rtsp_streams[i];
+        if (!rtsp_st->rtp_handle)
+            continue;
+        if ((ret = ffurl_get_multi_file_handle(rtsp_st->rtp_handle,
+                                               &fds, &fdsnum)) < 0)
+            return ret;
+        for (j = 0; j < fdsnum; j++) {
+            p[nb_fds].fd       = fds[j];
+            p[nb_fds++].events = POLLIN;
+        }
+        rtsp_st->nb_rtp_fds = fdsnum;
+        av_freep(&fds);
+    }
+    return nb_fds;
+}
+
+/* receive the packets of all the UDP streams into the FIFO */
+static void *attribute_align_arg udp_recv_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    RTSPState *rt = s->priv_data;
+    struct pollfd *p = rt->p;
+    int i, j, n, len, nb_fds, ret = 0, dropping = 0;
+
+    if ((nb_fds = get_rtp_fds(s, p)) < 0) {
+        ret = nb_fds;
+        goto end;
+    }
+
+    pthread_mutex_lock(&rt->recv_lock);
+    while (!rt->recv_thread_stop) {
+        pthread_mutex_unlock(&rt->recv_lock);
+        n = poll(p, nb_fds, POLL_TIMEOUT_MS);
+        if (n < 0 && errno != EINTR) {
+            ret = AVERROR(errno);
+            goto end;
+        }
+        for (i = 0, j = 0; n > 0 && i < rt->nb_rtsp_streams; i++) {
+            RTSPStream *rtsp_st = rt->rtsp_streams[i];
+            int k, readable = 0;
+            if (!rtsp_st->rtp_handle)
+                continue;
+            for (k = 0; k < rtsp_st->nb_rtp_fds; k++)
+                readable |= p[j++].revents & POLLIN;
+            if (!readable)
+                continue;
+            while ((len = ffurl_read(rtsp_st->rtp_handle, rt->recv_thread_buf,
+                                     RECVBUF_SIZE)) > 0) {
+                uint8_t header[8];
+                AV_WL32(header,     i);
+                AV_WL32(header + 4, len);
+                pthread_mutex_lock(&rt->recv_lock);
+                if (av_fifo_space(rt->recv_fifo) < sizeof(header) + len) {
+                    if (!dropping)
+                        av_log(s, AV_LOG_WARNING, "Receiving FIFO full, "
+                               "dropping packets. To avoid, increase "
+                               "recv_fifo_size\n");
+                    dropping = 1;
+                } else {
+                    dropping = 0;
+                    av_fifo_generic_write(rt->recv_fifo, header,
+                                          sizeof(header), NULL);
+                    av_fifo_generic_write(rt->recv_fifo, rt->recv_thread_buf,
+                                          len, NULL);
+                    pthread_cond_signal(&rt->recv_cond);
+                }
+                pthread_mutex_unlock(&rt->recv_lock);
+            }
+            if (len < 0 && len != AVERROR(EAGAIN)) {
+                ret = len;
+                goto end;
+            }
+        }
+        pthread_mutex_lock(&rt->recv_lock);
+    }
+    pthread_mutex_unlock(&rt->recv_lock);
+
+end:
+    pthread_mutex_lock(&rt->recv_lock);
+    rt->recv_thread_error = ret ? ret : AVERROR_EOF;
+    pthread_cond_signal(&rt->recv_cond);
+    pthread_mutex_unlock(&rt->recv_lock);
+    return NULL;
+}
+
+static int udp_recv_thread_start(AVFormatContext *s)
+{
+    RTSPState *rt = s->priv_data;
+    int i, ret;
+
+    rt->recv_fifo       = av_fifo_alloc(rt->recv_fifo_size);
+    rt->recv_thread_buf = av_malloc(RECVBUF_SIZE);
+    if (!rt->recv_fifo || !rt->recv_thread_buf) {
+        av_fifo_freep(&rt->recv_fifo);
+        av_freep(&rt->recv_thread_buf);
+        return AVERROR(ENOMEM);
+    }
+    /* the demuxing thread keeps sending the RTCP packets */
+    for (i = 0; i < rt->nb_rtsp_streams; i++)
+        if (rt->rtsp_streams[i]->rtp_handle)
+            rt->rtsp_streams[i]->rtp_handle->flags |= AVIO_FLAG_NONBLOCK;
+
+    pthread_mutex_init(&rt->recv_lock, NULL);
+    pthread_cond_init(&rt->recv_cond, NULL);
+    rt->recv_thread_stop  = 0;
+    rt->recv_thread_error = 0;
+    if ((ret = pthread_create(&rt->recv_thread, NULL, udp_recv_thread, s))) {
+        pthread_cond_destroy(&rt->recv_cond);
+        pthread_mutex_destroy(&rt->recv_lock);
+        av_fifo_freep(&rt->recv_fifo);
+        av_freep(&rt->recv_thread_buf);
+        return AVERROR(ret);
+    }
+    rt->recv_thread_started = 1;
+    return 0;
+}
+
+static void udp_recv_thread_stop(AVFormatContext *s)
+{
+    RTSPState *rt = s->priv_data;
+    int i;
+
+    if (!rt->recv_thread_started)
+        return;
+
+    pthread_mutex_lock(&rt->recv_lock);
+    rt->recv_thread_stop = 1;
+    pthread_mutex_unlock(&rt->recv_lock);
+    pthread_join(rt->recv_thread, NULL);
+
+    for (i = 0; i < rt->nb_rtsp_streams; i++)
+        if (rt->rtsp_streams[i] && rt->rtsp_streams[i]->rtp_handle)
+            rt->rtsp_streams[i]->rtp_handle->flags &= ~AVIO_FLAG_NONBLOCK;
+    pthread_cond_destroy(&rt->recv_cond);
+    pthread_mutex_destroy(&rt->recv_lock);
+    av_fifo_freep(&rt->recv_fifo);
+    av_freep(&rt->recv_thread_buf);
+    rt->recv_thread_started = 0;
+}
+#endif /* HAVE_PTHREADS */
+
 void ff_rtsp_undo_setup(AVFormatContext *s, int send_packets)
 {
     RTSPState *rt = s->priv_data;
     int i;
 
+#if HAVE_PTHREADS
+    udp_recv_thread_stop(s);
+#endif
+
     for (i = 0; i < rt->nb_rtsp_streams; i++) {
         RTSPStream *rtsp_st = rt->rtsp_streams[i];
         if (!rtsp_st)
@@ -831,6 +992,10 @@ int ff_rtsp_open_transport_ctx(AVFormatContext *s, RTSPStream *rtsp_st)
     if (!rtsp_st->transport_priv) {
          return AVERROR(ENOMEM);
     } else if (CONFIG_RTPDEC && rt->transport == RTSP_TRANSPORT_RTP) {
+        if (!s->oformat) {
+            RTPDemuxContext *rtpctx = rtsp_st->transport_priv;
+            rtpctx->adaptive_delay = rt->adaptive_delay;
+        }
         if (rtsp_st->dynamic_handler) {
             ff_rtp_parse_set_dynamic_protocol(rtsp_st->transport_priv,
                                               rtsp_st->dynamic_protocol_context,
@@ -1350,6 +1515,52 @@ int ff_rtsp_send_cmd_async(AVFormatContext *s, const char *method,
     return rtsp_send_cmd_with_content_async(s, method, url, headers, NULL, 0);
 }
 
+static const struct RTSPStatusMessage {
+    enum RTSPStatusCode code;
+    const char *message;
+} status_messages[] = {
+    { RTSP_STATUS_OK,             "OK"                               },
+    { RTSP_STATUS_NOT_FOUND,      "Not Found"                        },
+    { RTSP_STATUS_METHOD,         "Method Not Allowed"               },
+    { RTSP_STATUS_BANDWIDTH,      "Not Enough Bandwidth"             },
+    { RTSP_STATUS_SESSION,        "Session Not Found"                },
+    { RTSP_STATUS_STATE,          "Method Not Valid in This State"   },
+    { RTSP_STATUS_AGGREGATE,      "Aggregate operation not allowed"  },
+    { RTSP_STATUS_ONLY_AGGREGATE, "Only aggregate operation allowed" },
+    { RTSP_STATUS_TRANSPORT,      "Unsupported transport"            },
+    { RTSP_STATUS_INTERNAL,       "Internal Server Error"            },
+    { RTSP_STATUS_SERVICE,        "Service Unavailable"              },
+    { RTSP_STATUS_VERSION,        "RTSP Version not supported"       },
+    { 0,                          "NULL"                             }
+};
+
+int ff_rtsp_send_reply(AVFormatContext *s, URLContext *hd,
+                       enum RTSPStatusCode code, const char *extracontent,
+                       uint16_t seq)
+{
+    char message[4096];
+    int index = 0;
+    while (status_messages[index].code) {
+        if (status_messages[index].code == code) {
+            snprintf(message, sizeof(message), "RTSP/1.0 %d %s\r\n",
+                     code, status_messages[index].message);
+            break;
+        }
+        index++;
+    }
+    if (!status_messages[index].code)
+        return AVERROR(EINVAL);
+    av_strlcatf(message, sizeof(message), "CSeq: %d\r\n", seq);
+    av_strlcatf(message, sizeof(message), "Server: %s\r\n", LIBAVFORMAT_IDENT);
+    if (extracontent)
+        av_strlcat(message, extracontent, sizeof(message));
+    av_strlcat(message, "\r\n", sizeof(message));
+    av_log(s, AV_LOG_TRACE, "Sending response:\n%s", message);
+    ffurl_write(hd, message, strlen(message));
+
+    return 0;
+}
+
 int ff_rtsp_send_cmd(AVFormatContext *s, const char *method, const char *url,
                      const char *headers, RTSPMessageHeader *reply,
                      unsigned char **content_ptr)
@@ -1907,6 +2118,108 @@ redirect:
 #endif /* CONFIG_RTSP_DEMUXER || CONFIG_RTSP_MUXER */
 
 #if CONFIG_RTPDEC
+/**
+ * Handle a message received on the RTSP connection while streaming.
+ *
+ * @return 1 to keep reading packets, 0 or a negative error code to return
+ */
+static int handle_rtsp_message(AVFormatContext *s)
+{
+#if CONFIG_RTSP_DEMUXER
+    RTSPState *rt = s->priv_data;
+    int ret;
+
+    if (rt->rtsp_flags & RTSP_FLAG_LISTEN) {
+        if (rt->state == RTSP_STATE_STREAMING) {
+            if (!ff_rtsp_parse_streaming_commands(s))
+                return AVERROR_EOF;
+            else
+                av_log(s, AV_LOG_WARNING,
+                       "Unable to answer to TEARDOWN\n");
+        } else
+            return 0;
+    } else {
+        RTSPMessageHeader reply;
+        ret = ff_rtsp_read_reply(s, &reply, NULL, 0, NULL);
+        if (ret < 0)
+            return ret;
+        /* XXX: parse message */
+        if (rt->state != RTSP_STATE_STREAMING)
+            return 0;
+    }
+#endif
+    return 1;
+}
+
+#if HAVE_PTHREADS
+static int udp_read_queued_packet(AVFormatContext *s, RTSPStream **prtsp_st,
+                                  uint8_t *buf, int buf_size, int64_t wait_end)
+{
+    RTSPState *rt = s->priv_data;
+    int ret, timeout_cnt = 0;
+
+    if (!rt->recv_thread_started && (ret = udp_recv_thread_start(s)) < 0)
+        return ret;
+
+    for (;;) {
+        int64_t now = av_gettime_relative(), timeout = POLL_TIMEOUT_MS * 1000;
+        struct timespec tv;
+        int64_t t;
+
+        if (ff_check_interrupt(&s->interrupt_callback))
+            return AVERROR_EXIT;
+        if (wait_end && wait_end - now < 0)
+            return AVERROR(EAGAIN);
+
+        pthread_mutex_lock(&rt->recv_lock);
+        if (av_fifo_size(rt->recv_fifo)) {
+            uint8_t header[8];
+            int index, len;
+
+            av_fifo_generic_read(rt->recv_fifo, header, sizeof(header), NULL);
+            index = AV_RL32(header);
+            len   = AV_RL32(header + 4);
+            av_fifo_generic_read(rt->recv_fifo, buf, FFMIN(len, buf_size), NULL);
+            if (len > buf_size) {
+                av_fifo_drain(rt->recv_fifo, len - buf_size);
+                len = buf_size;
+            }
+            pthread_mutex_unlock(&rt->recv_lock);
+            *prtsp_st = rt->rtsp_streams[index];
+            return len;
+        }
+        if (rt->recv_thread_error) {
+            ret = rt->recv_thread_error;
+            pthread_mutex_unlock(&rt->recv_lock);
+            return ret;
+        }
+        if (wait_end)
+            timeout = FFMIN(timeout, wait_end - now);
+        /* FIXME: using the monotonic clock would be better,
+           but it does not exist on all supported platforms. */
+        t  = av_gettime() + timeout;
+        tv.tv_sec  =  t / 1000000;
+        tv.tv_nsec = (t % 1000000) * 1000;
+        ret = pthread_cond_timedwait(&rt->recv_cond, &rt->recv_lock, &tv);
+        pthread_mutex_unlock(&rt->recv_lock);
+
+        if (ret == ETIMEDOUT && timeout == POLL_TIMEOUT_MS * 1000 &&
+            ++timeout_cnt >= MAX_TIMEOUTS)
+            return AVERROR(ETIMEDOUT);
+        if (ret != ETIMEDOUT)
+            timeout_cnt = 0;
+
+        /* the RTSP connection is only watched between the waits */
+        if (rt->rtsp_hd) {
+            struct pollfd p = { ffurl_get_file_handle(rt->rtsp_hd), POLLIN, 0 };
+            if (poll(&p, 1, 0) > 0 && p.revents & POLLIN &&
+                (ret = handle_rtsp_message(s)) <= 0)
+                return ret;
+        }
+    }
+}
+#endif /* HAVE_PTHREADS */
+
 static int udp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
                            uint8_t *buf, int buf_size, int64_t wait_end)
 {
@@ -1917,6 +2230,11 @@ static int udp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
     struct pollfd *p = rt->p;
     int *fds = NULL, fdsnum, fdsidx;
 
+#if HAVE_PTHREADS
+    if (rt->recv_fifo_size)
+        return udp_read_queued_packet(s, prtsp_st, buf, buf_size, wait_end);
+#endif
+
     for (;;) {
         if (ff_check_interrupt(&s->interrupt_callback))
             return AVERROR_EXIT;
@@ -1938,15 +2256,17 @@ static int udp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
                     av_log(s, AV_LOG_ERROR, "Unable to recover rtp ports\n");
                     return ret;
                 }
-                if (fdsnum != 2) {
+                if (fdsnum != 2 && fdsnum != 4) {
                     av_log(s, AV_LOG_ERROR,
                            "Number of fds %d not supported\n", fdsnum);
+                    av_freep(&fds);
                     return AVERROR_INVALIDDATA;
                 }
                 for (fdsidx = 0; fdsidx < fdsnum; fdsidx++) {
                     p[max_p].fd       = fds[fdsidx];
                     p[max_p++].events = POLLIN;
                 }
+                rtsp_st->nb_rtp_fds = fdsnum;
                 av_freep(&fds);
             }
         }
@@ -1957,38 +2277,22 @@ static int udp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
             for (i = 0; i < rt->nb_rtsp_streams; i++) {
                 rtsp_st = rt->rtsp_streams[i];
                 if (rtsp_st->rtp_handle) {
-                    if (p[j].revents & POLLIN || p[j+1].revents & POLLIN) {
+                    int k, readable = 0;
+                    for (k = 0; k < rtsp_st->nb_rtp_fds; k++)
+                        readable |= p[j + k].revents & POLLIN;
+                    if (readable) {
                         ret = ffurl_read(rtsp_st->rtp_handle, buf, buf_size);
                         if (ret > 0) {
                             *prtsp_st = rtsp_st;
                             return ret;
                         }
                     }
-                    j+=2;
-                }
-            }
-#if CONFIG_RTSP_DEMUXER
-            if (tcp_fd != -1 && p[0].revents & POLLIN) {
-                if (rt->rtsp_flags & RTSP_FLAG_LISTEN) {
-                    if (rt->state == RTSP_STATE_STREAMING) {
-                        if (!ff_rtsp_parse_streaming_commands(s))
-                            return AVERROR_EOF;
-                        else
-                            av_log(s, AV_LOG_WARNING,
-                                   "Unable to answer to TEARDOWN\n");
-                    } else
-                        return 0;
-                } else {
-                    RTSPMessageHeader reply;
-                    ret = ff_rtsp_read_reply(s, &reply, NULL, 0, NULL);
-                    if (ret < 0)
-                        return ret;
-                    /* XXX: parse message */
-                    if (rt->state != RTSP_STATE_STREAMING)
-                        return 0;
+                    j += rtsp_st->nb_rtp_fds;
                 }
             }
-#endif
+            if (tcp_fd != -1 && p[0].revents & POLLIN &&
+                (ret = handle_rtsp_message(s)) <= 0)
+                return ret;
         } else if (n == 0 && ++timeout_cnt >= MAX_TIMEOUTS) {
             return AVERROR(ETIMEDOUT);
         } else if (n < 0 && errno != EINTR)
@@ -2076,25 +2380,22 @@ int ff_rtsp_fetch_packet(AVFormatContext *s, AVPacket *pkt)
 redo:
     if (rt->transport == RTSP_TRANSPORT_RTP) {
         int i;
-        int64_t first_queue_time = 0;
+        wait_end       = 0;
+        first_queue_st = NULL;
         for (i = 0; i < rt->nb_rtsp_streams; i++) {
             RTPDemuxContext *rtpctx = rt->rtsp_streams[i]->transport_priv;
-            int64_t queue_time;
+            int64_t queue_time, deadline;
             if (!rtpctx)
                 continue;
             queue_time = ff_rtp_queued_packet_time(rtpctx);
-            if (queue_time && (queue_time - first_queue_time < 0 ||
-                               !first_queue_time)) {
-                first_queue_time = queue_time;
-                first_queue_st   = rt->rtsp_streams[i];
+            if (!queue_time)
+                continue;
+            deadline = queue_time + ff_rtp_queue_delay(rtpctx);
+            if (!wait_end || deadline - wait_end < 0) {
+                wait_end       = deadline;
+                first_queue_st = rt->rtsp_streams[i];
             }
         }
-        if (first_queue_time) {
-            wait_end = first_queue_time + s->max_delay;
-        } else {
-            wait_end = 0;
-            first_queue_st = NULL;
-        }
     }
 
     /* read next RTP packet */
@@ -2382,10 +2683,16 @@ static int rtp_read_header(AVFormatContext *s)
     AVIOContext pb;
     socklen_t addrlen = sizeof(addr);
     RTSPState *rt = s->priv_data;
+    const char *p;
+    char buf[16];
 
     if (!ff_network_init())
         return AVERROR(EIO);
 
+    p = strchr(s->filename, '?');
+    if (p && av_find_info_tag(buf, sizeof(buf), "fec", p))
+        rt->fec = strtol(buf, NULL, 10);
+
     ret = ffurl_open_whitelist(&in, s->filename, AVIO_FLAG_READ,
                      &s->interrupt_callback, NULL, s->protocol_whitelist, s->protocol_blacklist);
     if (ret)
@@ -28,8 +28,10 @@
 #include "network.h"
 #include "httpauth.h"
 
+#include "libavutil/fifo.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 
 /**
  * Network layer over which RTP/etc packet data will be transported.
@@ -408,6 +410,43 @@ typedef struct RTSPState {
 
     char default_lang[4];
     int buffer_size;
+
+    /**
+     * Receive the SMPTE 2022-1 FEC of the RTP streams.
+     */
+    int fec;
+
+    /**
+     * Adapt the reordering delay to the network, up to max_delay.
+     */
+    int adaptive_delay;
+
+    /**
+     * Size in bytes of the FIFO of the packets received over UDP by a
+     * separate thread, 0 to receive them on the demuxing thread.
+     */
+    int recv_fifo_size;
+
+    /** The following are used by the muxer in listen mode */
+    //@{
+    struct RTSPServerClient **clients; ///< connected clients
+    int nb_clients;
+    char *sdp;                  ///< session description sent on DESCRIBE
+    //@}
+
+#if HAVE_PTHREADS
+    /** The following are used by the receiving thread */
+    //@{
+    pthread_t recv_thread;
+    pthread_mutex_t recv_lock;
+    pthread_cond_t recv_cond;
+    AVFifoBuffer *recv_fifo;    ///< stream index, length and data of the packets
+    uint8_t *recv_thread_buf;
+    int recv_thread_started;
+    int recv_thread_stop;
+    int recv_thread_error;
+    //@}
+#endif
 } RTSPState;
 
 #define RTSP_FLAG_FILTER_SRC  0x1    /**< Filter incoming UDP packets -
@@ -431,6 +470,7 @@ typedef struct RTSPSource {
  */
 typedef struct RTSPStream {
     URLContext *rtp_handle;   /**< RTP stream handle (if UDP) */
+    int nb_rtp_fds;           /**< number of file descriptors polled for rtp_handle */
     void *transport_priv; /**< RTP/RDT parse context if input, RTP AVFormatContext if output */
 
     /** corresponding stream index, if any. -1 if none (MPEG2TS case) */
@@ -474,6 +514,21 @@ void ff_rtsp_parse_line(AVFormatContext *s,
                         RTSPMessageHeader *reply, const char *buf,
                         RTSPState *rt, const char *method);
 
+/**
+ * Send a reply to an RTSP request, when acting as a server.
+ *
+ * @param s RTSP (de)muxer context
+ * @param hd the connection of the client the request came from
+ * @param code the status code of the reply
+ * @param extracontent additional header lines, each terminated by "\r\n",
+ *                     or NULL
+ * @param seq the CSeq of the request
+ * @return 0 on success, AVERROR(EINVAL) for an unknown status code
+ */
+int ff_rtsp_send_reply(AVFormatContext *s, URLContext *hd,
+                       enum RTSPStatusCode code, const char *extracontent,
+                       uint16_t seq);
+
 /**
  * Send a command to the RTSP server without waiting for the reply.
  *
@@ -35,24 +35,6 @@
 #include "tls.h"
 #include "url.h"
 
-static const struct RTSPStatusMessage {
-    enum RTSPStatusCode code;
-    const char *message;
-} status_messages[] = {
-    { RTSP_STATUS_OK,             "OK"                               },
-    { RTSP_STATUS_METHOD,         "Method Not Allowed"               },
-    { RTSP_STATUS_BANDWIDTH,      "Not Enough Bandwidth"             },
-    { RTSP_STATUS_SESSION,        "Session Not Found"                },
-    { RTSP_STATUS_STATE,          "Method Not Valid in This State"   },
-    { RTSP_STATUS_AGGREGATE,      "Aggregate operation not allowed"  },
-    { RTSP_STATUS_ONLY_AGGREGATE, "Only aggregate operation allowed" },
-    { RTSP_STATUS_TRANSPORT,      "Unsupported transport"            },
-    { RTSP_STATUS_INTERNAL,       "Internal Server Error"            },
-    { RTSP_STATUS_SERVICE,        "Service Unavailable"              },
-    { RTSP_STATUS_VERSION,        "RTSP Version not supported"       },
-    { 0,                          "NULL"                             }
-};
-
 static int rtsp_read_close(AVFormatContext *s)
 {
     RTSPState *rt = s->priv_data;
@@ -97,27 +79,7 @@ static int rtsp_send_reply(AVFormatContext *s, enum RTSPStatusCode code,
                            const char *extracontent, uint16_t seq)
 {
     RTSPState *rt = s->priv_data;
-    char message[4096];
-    int index = 0;
-    while (status_messages[index].code) {
-        if (status_messages[index].code == code) {
-            snprintf(message, sizeof(message), "RTSP/1.0 %d %s\r\n",
-                     code, status_messages[index].message);
-            break;
-        }
-        index++;
-    }
-    if (!status_messages[index].code)
-        return AVERROR(EINVAL);
-    av_strlcatf(message, sizeof(message), "CSeq: %d\r\n", seq);
-    av_strlcatf(message, sizeof(message), "Server: %s\r\n", LIBAVFORMAT_IDENT);
-    if (extracontent)
-        av_strlcat(message, extracontent, sizeof(message));
-    av_strlcat(message, "\r\n", sizeof(message));
-    av_log(s, AV_LOG_TRACE, "Sending response:\n%s", message);
-    ffurl_write(rt->rtsp_hd_out, message, strlen(message));
-
-    return 0;
+    return ff_rtsp_send_reply(s, rt->rtsp_hd_out, code, extracontent, seq);
 }
 
 static inline int check_sessionid(AVFormatContext *s,
@@ -26,15 +26,43 @@
 #endif
 #include "network.h"
 #include "os_support.h"
+#include "rtpproto.h"
 #include "rtsp.h"
 #include "internal.h"
 #include "avio_internal.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/avstring.h"
+#include "libavutil/random_seed.h"
 #include "libavutil/time.h"
 #include "url.h"
 
 #define SDP_MAX_SIZE 16384
+#define RTSP_SERVER_BUF_SIZE 4096
+
+/**
+ * Per-stream transport of a client in listen mode.
+ */
+typedef struct RTSPServerStream {
+    int setup;                  /**< the client has set up this stream */
+    URLContext *rtp_handle;     /**< RTP/RTCP over UDP, NULL if interleaved */
+    int interleaved_min, interleaved_max;
+    int wait_key;               /**< hold the packets back until a keyframe */
+} RTSPServerStream;
+
+/**
+ * A client connected to the muxer in listen mode.
+ */
+typedef struct RTSPServerClient {
+    URLContext *hd;             /**< RTSP connection, also carries interleaved data */
+    char host[128];             /**< numeric address of the client */
+    char session_id[32];
+    int playing;
+    int error;                  /**< the connection failed, close it */
+    RTSPServerStream *streams;  /**< one per AVStream */
+    char buf[RTSP_SERVER_BUF_SIZE]; /**< partially received requests */
+    int buf_len;
+    int skip;                   /**< bytes of interleaved data left to skip */
+} RTSPServerClient;
 
 static const AVClass rtsp_muxer_class = {
     .class_name = "RTSP muxer",
@@ -43,20 +71,15 @@ static const AVClass rtsp_muxer_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
-int ff_rtsp_setup_output_streams(AVFormatContext *s, const char *addr)
+static int rtsp_create_sdp(AVFormatContext *s, const char *addr, char **sdp)
 {
-    RTSPState *rt = s->priv_data;
-    RTSPMessageHeader reply1, *reply = &reply1;
-    int i;
-    char *sdp;
     AVFormatContext sdp_ctx, *ctx_array[1];
 
     if (s->start_time_realtime == 0  ||  s->start_time_realtime == AV_NOPTS_VALUE)
         s->start_time_realtime = av_gettime();
 
-    /* Announce the stream */
-    sdp = av_mallocz(SDP_MAX_SIZE);
-    if (!sdp)
+    *sdp = av_mallocz(SDP_MAX_SIZE);
+    if (!*sdp)
         return AVERROR(ENOMEM);
     /* We create the SDP based on the RTSP AVFormatContext where we
      * aren't allowed to change the filename field. (We create the SDP
@@ -74,11 +97,24 @@ int ff_rtsp_setup_output_streams(AVFormatContext *s, const char *addr)
     ff_url_join(sdp_ctx.filename, sizeof(sdp_ctx.filename),
                 "rtsp", NULL, addr, -1, NULL);
     ctx_array[0] = &sdp_ctx;
-    if (av_sdp_create(ctx_array, 1, sdp, SDP_MAX_SIZE)) {
-        av_free(sdp);
+    if (av_sdp_create(ctx_array, 1, *sdp, SDP_MAX_SIZE)) {
+        av_freep(sdp);
         return AVERROR_INVALIDDATA;
     }
-    av_log(s, AV_LOG_VERBOSE, "SDP:\n%s\n", sdp);
+    av_log(s, AV_LOG_VERBOSE, "SDP:\n%s\n", *sdp);
+    return 0;
+}
+
+int ff_rtsp_setup_output_streams(AVFormatContext *s, const char *addr)
+{
+    RTSPState *rt = s->priv_data;
+    RTSPMessageHeader reply1, *reply = &reply1;
+    int i, ret;
+    char *sdp;
+
+    /* Announce the stream */
+    if ((ret = rtsp_create_sdp(s, addr, &sdp)) < 0)
+        return ret;
     ff_rtsp_send_cmd_with_content(s, "ANNOUNCE", rt->control_uri,
                                   "Content-Type: application/sdp\r\n",
                                   reply, NULL, sdp, strlen(sdp));
@@ -121,10 +157,417 @@ static int rtsp_write_record(AVFormatContext *s)
     return 0;
 }
 
+static void rtsp_server_close_client(AVFormatContext *s, int index)
+{
+    RTSPState *rt = s->priv_data;
+    RTSPServerClient *c = rt->clients[index];
+    int i;
+
+    av_log(s, AV_LOG_VERBOSE, "Closing connection of client %s\n", c->host);
+    for (i = 0; i < s->nb_streams; i++)
+        ffurl_closep(&c->streams[i].rtp_handle);
+    av_freep(&c->streams);
+    ffurl_closep(&c->hd);
+    av_freep(&rt->clients[index]);
+    rt->clients[index] = rt->clients[--rt->nb_clients];
+}
+
+static int rtsp_server_accept(AVFormatContext *s)
+{
+    RTSPState *rt = s->priv_data;
+    RTSPServerClient *c;
+    struct sockaddr_storage peer;
+    socklen_t peer_len = sizeof(peer);
+    int ret;
+
+    c = av_mallocz(sizeof(*c));
+    if (!c)
+        return AVERROR(ENOMEM);
+    c->streams = av_mallocz_array(s->nb_streams, sizeof(*c->streams));
+    if (!c->streams) {
+        av_free(c);
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = ffurl_accept(rt->rtsp_hd, &c->hd)) < 0 ||
+        (ret = ffurl_handshake(c->hd)) < 0) {
+        /* A failed connection attempt does not stop the other clients */
+        av_log(s, AV_LOG_WARNING, "Unable to accept a client: %s\n",
+               av_err2str(ret));
+        ffurl_closep(&c->hd);
+        av_free(c->streams);
+        av_free(c);
+        return 0;
+    }
+    if (!getpeername(ffurl_get_file_handle(c->hd),
+                     (struct sockaddr*) &peer, &peer_len))
+        getnameinfo((struct sockaddr*) &peer, peer_len, c->host,
+                    sizeof(c->host), NULL, 0, NI_NUMERICHOST);
+    if ((ret = av_dynarray_add_nofree(&rt->clients, &rt->nb_clients, c)) < 0) {
+        ffurl_closep(&c->hd);
+        av_free(c->streams);
+        av_free(c);
+        return ret;
+    }
+    av_log(s, AV_LOG_VERBOSE, "New client %s\n", c->host);
+    return 0;
+}
+
+static int rtsp_server_setup(AVFormatContext *s, RTSPServerClient *c,
+                             const char *uri, RTSPMessageHeader *request)
+{
+    RTSPState *rt = s->priv_data;
+    RTSPTransportField *th = &request->transports[0];
+    RTSPServerStream *sst;
+    char headers[1024], url[1024];
+    const char *p = strstr(uri, "streamid=");
+    int id = p ? strtol(p + 9, NULL, 10) : -1;
+    int port, ret;
+
+    if (id < 0 || id >= s->nb_streams)
+        return ff_rtsp_send_reply(s, c->hd, RTSP_STATUS_NOT_FOUND, NULL,
+                                  request->seq);
+    sst = &c->streams[id];
+    ffurl_closep(&sst->rtp_handle);
+    sst->setup = 0;
+
+    if (request->nb_transports > 0 &&
+        th->lower_transport == RTSP_LOWER_TRANSPORT_TCP) {
+        if (!th->interleaved_max) {
+            th->interleaved_min = 2 * id;
+            th->interleaved_max = 2 * id + 1;
+        }
+        sst->interleaved_min = th->interleaved_min;
+        sst->interleaved_max = th->interleaved_max;
+        snprintf(headers, sizeof(headers), "Transport: RTP/AVP/TCP;unicast;"
+                 "interleaved=%d-%d\r\n",
+                 sst->interleaved_min, sst->interleaved_max);
+    } else if (request->nb_transports > 0 &&
+               th->lower_transport == RTSP_LOWER_TRANSPORT_UDP &&
+               th->client_port_min > 0) {
+        int rtcp_port = th->client_port_max > th->client_port_min ?
+                        th->client_port_max : th->client_port_min + 1;
+        ret = AVERROR(EADDRINUSE);
+        for (port = rt->rtp_port_min; port < rt->rtp_port_max; port += 2) {
+            ff_url_join(url, sizeof(url), "rtp", NULL, c->host,
+                        th->client_port_min, "?localport=%d&rtcpport=%d",
+                        port, rtcp_port);
+            ret = ffurl_open_whitelist(&sst->rtp_handle, url, AVIO_FLAG_WRITE,
+                                       &s->interrupt_callback, NULL,
+                                       s->protocol_whitelist,
+                                       s->protocol_blacklist);
+            if (!ret)
+                break;
+        }
+        if (ret) {
+            av_log(s, AV_LOG_ERROR, "Unable to open an UDP port for %s\n",
+                   c->host);
+            return ff_rtsp_send_reply(s, c->hd, RTSP_STATUS_SERVICE, NULL,
+                                      request->seq);
+        }
+        port = ff_rtp_get_local_rtp_port(sst->rtp_handle);
+        snprintf(headers, sizeof(headers), "Transport: RTP/AVP/UDP;unicast;"
+                 "client_port=%d-%d;server_port=%d-%d\r\n",
+                 th->client_port_min, rtcp_port, port, port + 1);
+    } else {
+        return ff_rtsp_send_reply(s, c->hd, RTSP_STATUS_TRANSPORT, NULL,
+                                  request->seq);
+    }
+    sst->setup = 1;
+
+    /* RFC 2326: session id must be at least 8 digits */
+    if (!c->session_id[0])
+        snprintf(c->session_id, sizeof(c->session_id), "%08X%08X",
+                 av_get_random_seed(), av_get_random_seed());
+    av_strlcatf(headers, sizeof(headers), "Session: %s\r\n", c->session_id);
+    return ff_rtsp_send_reply(s, c->hd, RTSP_STATUS_OK, headers, request->seq);
+}
+
+/**
+ * Answer one request of a client.
+ *
+ * @return 0 on success, a negative AVERROR code if the connection has to
+ *         be closed
+ */
+static int rtsp_server_handle_request(AVFormatContext *s, RTSPServerClient *c,
+                                      const char *method, const char *uri,
+                                      RTSPMessageHeader *request)
+{
+    RTSPState *rt = s->priv_data;
+    char headers[1024] = "";
+    int i;
+
+    av_log(s, AV_LOG_DEBUG, "%s %s from %s\n", method, uri, c->host);
+    if (request->session_id[0] && strcmp(request->session_id, c->session_id))
+        return ff_rtsp_send_reply(s, c->hd, RTSP_STATUS_SESSION, NULL,
+                                  request->seq);
+    if (c->session_id[0])
+        snprintf(headers, sizeof(headers), "Session: %s\r\n", c->session_id);
+
+    if (!strcmp(method, "OPTIONS")) {
+        return ff_rtsp_send_reply(s, c->hd, RTSP_STATUS_OK,
+                                  "Public: OPTIONS, DESCRIBE, SETUP, PLAY, "
+                                  "PAUSE, TEARDOWN, GET_PARAMETER\r\n",
+                                  request->seq);
+    } else if (!strcmp(method, "DESCRIBE")) {
+        int len = strlen(rt->sdp);
+        snprintf(headers, sizeof(headers), "Content-Type: application/sdp\r\n"
+                 "Content-Length: %d\r\n", len);
+        ff_rtsp_send_reply(s, c->hd, RTSP_STATUS_OK, headers, request->seq);
+        return ffurl_write(c->hd, rt->sdp, len);
+    } else if (!strcmp(method, "SETUP")) {
+        return rtsp_server_setup(s, c, uri, request);
+    } else if (!strcmp(method, "PLAY")) {
+        if (!c->session_id[0])
+            return ff_rtsp_send_reply(s, c->hd, RTSP_STATUS_STATE, NULL,
+                                      request->seq);
+        /* Start the video streams at the next keyframe, the clients
+         * cannot decode anything before it */
+        for (i = 0; i < s->nb_streams; i++)
+            c->streams[i].wait_key =
+                s->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO;
+        c->playing = 1;
+        av_strlcat(headers, "Range: npt=0.000-\r\n", sizeof(headers));
+    } else if (!strcmp(method, "PAUSE")) {
+        c->playing = 0;
+    } else if (!strcmp(method, "TEARDOWN")) {
+        ff_rtsp_send_reply(s, c->hd, RTSP_STATUS_OK, headers, request->seq);
+        return AVERROR_EOF;
+    } else if (strcmp(method, "GET_PARAMETER") &&
+               strcmp(method, "SET_PARAMETER")) {
+        return ff_rtsp_send_reply(s, c->hd, RTSP_STATUS_METHOD, NULL,
+                                  request->seq);
+    }
+    return ff_rtsp_send_reply(s, c->hd, RTSP_STATUS_OK, headers, request->seq);
+}
+
+/**
+ * Read from the connection of a client and handle its complete requests.
+ *
+ * @return 0 on success, a negative AVERROR code if the connection has to
+ *         be closed
+ */
+static int rtsp_server_read(AVFormatContext *s, RTSPServerClient *c)
+{
+    char header[RTSP_SERVER_BUF_SIZE], method[32], uri[1024];
+    char *line, *next, *end;
+    int ret, len;
+
+    ret = ffurl_read(c->hd, c->buf + c->buf_len,
+                     sizeof(c->buf) - 1 - c->buf_len);
+    if (ret <= 0)
+        return ret ? ret : AVERROR_EOF;
+    c->buf_len += ret;
+
+    while (c->buf_len > 0) {
+        RTSPMessageHeader request = { 0 };
+
+        if (c->skip || c->buf[0] == '$') {
+            /* RTCP receiver reports interleaved by the client */
+            if (!c->skip) {
+                if (c->buf_len < 4)
+                    break;
+                c->skip = 4 + AV_RB16(c->buf + 2);
+            }
+            len = FFMIN(c->skip, c->buf_len);
+            c->skip -= len;
+        } else {
+            c->buf[c->buf_len] = '\0';
+            end = strstr(c->buf, "\r\n\r\n");
+            if (!end) {
+                if (c->buf_len == sizeof(c->buf) - 1)
+                    return AVERROR_INVALIDDATA;
+                break;
+            }
+            len = end + 4 - c->buf;
+            memcpy(header, c->buf, len);
+            header[len] = '\0';
+
+            method[0] = uri[0] = '\0';
+            for (line = header; (next = strchr(line, '\n')); line = next + 1) {
+                *next = '\0';
+                if (next > line && next[-1] == '\r')
+                    next[-1] = '\0';
+                if (line == header)
+                    sscanf(line, "%31s %1023s", method, uri);
+                else if (*line)
+                    ff_rtsp_parse_line(s, &request, line, NULL, method);
+            }
+            if (!method[0] || !uri[0] || request.content_length < 0)
+                return AVERROR_INVALIDDATA;
+            if (request.content_length > sizeof(c->buf) - 1 - len)
+                return AVERROR_INVALIDDATA;
+            if (c->buf_len < len + request.content_length)
+                break;
+            len += request.content_length;
+            if ((ret = rtsp_server_handle_request(s, c, method, uri,
+                                                  &request)) < 0)
+                return ret;
+        }
+        c->buf_len -= len;
+        memmove(c->buf, c->buf + len, c->buf_len);
+    }
+    return 0;
+}
+
+/**
+ * Accept the new clients and handle the pending requests, without blocking.
+ */
+static int rtsp_server_poll(AVFormatContext *s)
+{
+    RTSPState *rt = s->priv_data;
+    int i, ret;
+
+    for (i = rt->nb_clients - 1; i >= 0; i--)
+        if (rt->clients[i]->error)
+            rtsp_server_close_client(s, i);
+
+    if ((ret = av_reallocp_array(&rt->p, rt->nb_clients + 1,
+                                 sizeof(*rt->p))) < 0)
+        return ret;
+    rt->p[0].fd     = ffurl_get_file_handle(rt->rtsp_hd);
+    rt->p[0].events = POLLIN;
+    for (i = 0; i < rt->nb_clients; i++) {
+        rt->p[i + 1].fd     = ffurl_get_file_handle(rt->clients[i]->hd);
+        rt->p[i + 1].events = POLLIN;
+    }
+    if (poll(rt->p, rt->nb_clients + 1, 0) <= 0)
+        return 0;
+
+    /* Go backwards, closing a client moves the last one into its slot */
+    for (i = rt->nb_clients - 1; i >= 0; i--) {
+        if (!(rt->p[i + 1].revents & (POLLIN | POLLERR | POLLHUP)))
+            continue;
+        ret = rtsp_server_read(s, rt->clients[i]);
+        if (ret == AVERROR(ENOMEM))
+            return ret;
+        if (ret < 0)
+            rtsp_server_close_client(s, i);
+    }
+    if (rt->p[0].revents & POLLIN)
+        return rtsp_server_accept(s);
+    return 0;
+}
+
+/**
+ * Send the packets queued by the RTP muxer of a stream to all the clients
+ * playing it.
+ */
+static int rtsp_server_send_packets(AVFormatContext *s, RTSPStream *rtsp_st)
+{
+    RTSPState *rt = s->priv_data;
+    AVFormatContext *rtpctx = rtsp_st->transport_priv;
+    int index = rtsp_st->stream_index;
+    uint8_t *buf, *ptr;
+    int size, i;
+
+    size = avio_close_dyn_buf(rtpctx->pb, &buf);
+    rtpctx->pb = NULL;
+    ptr = buf;
+    while (size > 4) {
+        uint32_t packet_len = AV_RB32(ptr);
+        if (packet_len > size - 4 || packet_len < 2)
+            break;
+        for (i = 0; i < rt->nb_clients; i++) {
+            RTSPServerClient *c = rt->clients[i];
+            RTSPServerStream *sst = &c->streams[index];
+            if (!c->playing || c->error || !sst->setup || sst->wait_key)
+                continue;
+            if (sst->rtp_handle) {
+                /* Errors like ICMP port unreachable are not fatal */
+                ffurl_write(sst->rtp_handle, ptr + 4, packet_len);
+            } else {
+                /* Like in ff_rtsp_tcp_write_packet, the interleaving
+                 * header replaces the packet length, with the channel
+                 * of each client */
+                ptr[0] = '$';
+                ptr[1] = RTP_PT_IS_RTCP(ptr[5]) ? sst->interleaved_max
+                                                : sst->interleaved_min;
+                AV_WB16(ptr + 2, packet_len);
+                if (ffurl_write(c->hd, ptr, 4 + packet_len) < 0)
+                    c->error = 1;
+            }
+        }
+        ptr  += 4 + packet_len;
+        size -= 4 + packet_len;
+    }
+    av_free(buf);
+    return ffio_open_dyn_packet_buf(&rtpctx->pb, RTSP_TCP_MAX_PACKET_SIZE);
+}
+
+static int rtsp_server_open(AVFormatContext *s)
+{
+    RTSPState *rt = s->priv_data;
+    char proto[128], host[1024], path[1024], tcpname[1024];
+    int port, i, ret;
+
+    if (rt->rtp_port_max < rt->rtp_port_min) {
+        av_log(s, AV_LOG_ERROR, "Invalid UDP port range, max port %d less "
+                                "than min port %d\n", rt->rtp_port_max,
+                                                      rt->rtp_port_min);
+        return AVERROR(EINVAL);
+    }
+
+    av_url_split(proto, sizeof(proto), NULL, 0, host, sizeof(host),
+                 &port, path, sizeof(path), s->filename);
+    if (strcmp(proto, "rtsp")) {
+        av_log(s, AV_LOG_ERROR, "Only rtsp:// URLs are supported in listen "
+                                "mode\n");
+        return AVERROR(EINVAL);
+    }
+    if (port < 0)
+        port = RTSP_DEFAULT_PORT;
+
+    if (!ff_network_init())
+        return AVERROR(EIO);
+
+    ff_url_join(tcpname, sizeof(tcpname), "tcp", NULL, host, port,
+                "?listen=2");
+    ret = ffurl_open_whitelist(&rt->rtsp_hd, tcpname, AVIO_FLAG_READ_WRITE,
+                               &s->interrupt_callback, NULL,
+                               s->protocol_whitelist, s->protocol_blacklist);
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Unable to open RTSP for listening\n");
+        goto fail;
+    }
+    rt->rtsp_hd_out = rt->rtsp_hd;
+
+    if ((ret = rtsp_create_sdp(s, host[0] ? host : "0.0.0.0", &rt->sdp)) < 0)
+        goto fail;
+
+    /* Each stream is packetized once into a packet buffer, as for TCP
+     * transport, and rtsp_server_send_packets() sends the packets to the
+     * clients. */
+    rt->lower_transport = RTSP_LOWER_TRANSPORT_TCP;
+    for (i = 0; i < s->nb_streams; i++) {
+        RTSPStream *rtsp_st = av_mallocz(sizeof(RTSPStream));
+        if (!rtsp_st) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        dynarray_add(&rt->rtsp_streams, &rt->nb_rtsp_streams, rtsp_st);
+        rtsp_st->stream_index = i;
+        if ((ret = ff_rtsp_open_transport_ctx(s, rtsp_st)) < 0)
+            goto fail;
+    }
+    rt->state = RTSP_STATE_STREAMING;
+    return 0;
+
+fail:
+    av_freep(&rt->sdp);
+    ff_rtsp_close_streams(s);
+    ff_rtsp_close_connections(s);
+    ff_network_close();
+    return ret;
+}
+
 static int rtsp_write_header(AVFormatContext *s)
 {
+    RTSPState *rt = s->priv_data;
     int ret;
 
+    if (rt->rtsp_flags & RTSP_FLAG_LISTEN)
+        return rtsp_server_open(s);
+
     ret = ff_rtsp_connect(s);
     if (ret)
         return ret;
@@ -145,6 +588,9 @@ int ff_rtsp_tcp_write_packet(AVFormatContext *s, RTSPStream *rtsp_st)
     int size;
     uint8_t *interleave_header, *interleaved_packet;
 
+    if (rt->rtsp_flags & RTSP_FLAG_LISTEN)
+        return rtsp_server_send_packets(s, rtsp_st);
+
     size = avio_close_dyn_buf(rtpctx->pb, &buf);
     rtpctx->pb = NULL;
     ptr = buf;
@@ -180,12 +626,12 @@ static int rtsp_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
     RTSPState *rt = s->priv_data;
     RTSPStream *rtsp_st;
-    int n;
+    int n, i;
     struct pollfd p = {ffurl_get_file_handle(rt->rtsp_hd), POLLIN, 0};
     AVFormatContext *rtpctx;
     int ret;
 
-    while (1) {
+    while (!(rt->rtsp_flags & RTSP_FLAG_LISTEN)) {
         n = poll(&p, 1, 0);
         if (n <= 0)
             break;
@@ -212,10 +658,19 @@ static int rtsp_write_packet(AVFormatContext *s, AVPacket *pkt)
     rtsp_st = rt->rtsp_streams[pkt->stream_index];
     rtpctx = rtsp_st->transport_priv;
 
+    if (rt->rtsp_flags & RTSP_FLAG_LISTEN) {
+        if ((ret = rtsp_server_poll(s)) < 0)
+            return ret;
+        if (pkt->flags & AV_PKT_FLAG_KEY)
+            for (i = 0; i < rt->nb_clients; i++)
+                rt->clients[i]->streams[pkt->stream_index].wait_key = 0;
+    }
+
     ret = ff_write_chained(rtpctx, 0, pkt, s, 0);
     /* ff_write_chained does all the RTP packetization. If using TCP as
      * transport, rtpctx->pb is only a dyn_packet_buf that queues up the
      * packets, so we need to send them out on the TCP connection separately.
+     * In listen mode, the packets are sent to all the clients.
      */
     if (!ret && rt->lower_transport == RTSP_LOWER_TRANSPORT_TCP)
         ret = ff_rtsp_tcp_write_packet(s, rtsp_st);
@@ -231,7 +686,14 @@ static int rtsp_write_close(AVFormatContext *s)
     // done within ff_rtsp_undo_setup.
     ff_rtsp_undo_setup(s, 1);
 
-    ff_rtsp_send_cmd_async(s, "TEARDOWN", rt->control_uri, NULL);
+    if (rt->rtsp_flags & RTSP_FLAG_LISTEN) {
+        while (rt->nb_clients)
+            rtsp_server_close_client(s, rt->nb_clients - 1);
+        av_freep(&rt->clients);
+        av_freep(&rt->sdp);
+    } else {
+        ff_rtsp_send_cmd_async(s, "TEARDOWN", rt->control_uri, NULL);
+    }
 
     ff_rtsp_close_streams(s);
     ff_rtsp_close_connections(s);
@@ -34,12 +34,14 @@
 #include "internal.h"
 
 #include "libavutil/avassert.h"
+#include "libavutil/fifo.h"
 #include "libavutil/internal.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/avstring.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/timecode.h"
 #include "libavutil/time_internal.h"
@@ -68,6 +70,15 @@ typedef enum {
 #define SEGMENT_LIST_FLAG_CACHE 1
 #define SEGMENT_LIST_FLAG_LIVE  2
 
+#if HAVE_THREADS
+/* a segment handed to the finalizing thread */
+typedef struct SegmentCloseJob {
+    AVFormatContext *avf;
+    SegmentListEntry entry;
+    int segment_count;
+} SegmentCloseJob;
+#endif
+
 typedef struct SegmentContext {
     const AVClass *class;  /**< Class for private options. */
     int segment_idx;       ///< index of the segment file to write, starting from 0
@@ -125,6 +136,20 @@ typedef struct SegmentContext {
     SegmentListEntry cur_entry;
     SegmentListEntry *segment_list_entries;
     SegmentListEntry *segment_list_entries_end;
+
+    int async_close;       ///< maximum number of segments finalized in the background
+#if HAVE_THREADS
+    /* the segments are finalized in order by a single thread, which owns
+     * the list file and entries while it runs */
+    pthread_t close_thread;
+    int close_thread_started;
+    AVFifoBuffer *close_queue;
+    int nb_closes_pending;
+    pthread_mutex_t close_mutex;
+    pthread_cond_t close_cond;
+    int close_finish;
+    int close_error;
+#endif
 } SegmentContext;
 
 static void print_csv_escaped_str(AVIOContext *ctx, const char *str)
@@ -334,17 +359,13 @@ static void segment_list_print_entry(AVIOContext      *list_ioctx,
     }
 }
 
-static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
+/* write the trailer of a segment, close it and update the list */
+static int segment_finalize(AVFormatContext *s, AVFormatContext *oc,
+                            const SegmentListEntry *cur_entry,
+                            int segment_count, int write_trailer, int is_last)
 {
     SegmentContext *seg = s->priv_data;
-    AVFormatContext *oc = seg->avf;
     int ret = 0;
-    AVTimecode tc;
-    AVRational rate;
-    AVDictionaryEntry *tcr;
-    char buf[AV_TIMECODE_STR_SIZE];
-    int i;
-    int err;
 
     av_write_frame(oc, NULL); /* Flush any buffered data (fragmented mp4) */
     if (write_trailer)
@@ -363,7 +384,7 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
             }
 
             /* append new element */
-            memcpy(entry, &seg->cur_entry, sizeof(*entry));
+            memcpy(entry, cur_entry, sizeof(*entry));
             entry->filename = av_strdup(entry->filename);
             if (!seg->segment_list_entries)
                 seg->segment_list_entries = seg->segment_list_entries_end = entry;
@@ -372,7 +393,7 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
             seg->segment_list_entries_end = entry;
 
             /* drop first item */
-            if (seg->list_size && seg->segment_count >= seg->list_size) {
+            if (seg->list_size && segment_count >= seg->list_size) {
                 entry = seg->segment_list_entries;
                 seg->segment_list_entries = seg->segment_list_entries->next;
                 av_freep(&entry->filename);
@@ -389,13 +410,147 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
             if (seg->use_rename)
                 ff_rename(seg->temp_list_filename, seg->list, s);
         } else {
-            segment_list_print_entry(seg->list_pb, seg->list_type, &seg->cur_entry, s);
+            segment_list_print_entry(seg->list_pb, seg->list_type, cur_entry, s);
             avio_flush(seg->list_pb);
         }
     }
 
     av_log(s, AV_LOG_VERBOSE, "segment:'%s' count:%d ended\n",
-           seg->avf->filename, seg->segment_count);
+           oc->filename, segment_count);
+
+end:
+    ff_format_io_close(oc, &oc->pb);
+
+    return ret;
+}
+
+#if HAVE_THREADS
+static void *segment_close_thread(void *arg)
+{
+    AVFormatContext *s  = arg;
+    SegmentContext *seg = s->priv_data;
+    SegmentCloseJob job;
+    int ret;
+
+    pthread_mutex_lock(&seg->close_mutex);
+    for (;;) {
+        if (!av_fifo_size(seg->close_queue)) {
+            if (seg->close_finish)
+                break;
+            pthread_cond_wait(&seg->close_cond, &seg->close_mutex);
+            continue;
+        }
+        av_fifo_generic_read(seg->close_queue, &job, sizeof(job), NULL);
+        pthread_mutex_unlock(&seg->close_mutex);
+
+        ret = segment_finalize(s, job.avf, &job.entry, job.segment_count, 1, 0);
+        avformat_free_context(job.avf);
+        av_freep(&job.entry.filename);
+
+        pthread_mutex_lock(&seg->close_mutex);
+        if (ret < 0 && !seg->close_error)
+            seg->close_error = ret;
+        seg->nb_closes_pending--;
+        pthread_cond_broadcast(&seg->close_cond);
+    }
+    pthread_mutex_unlock(&seg->close_mutex);
+
+    return NULL;
+}
+
+static int segment_close_init(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    int ret;
+
+    seg->close_queue = av_fifo_alloc_array(seg->async_close, sizeof(SegmentCloseJob));
+    if (!seg->close_queue)
+        return AVERROR(ENOMEM);
+    pthread_mutex_init(&seg->close_mutex, NULL);
+    pthread_cond_init(&seg->close_cond, NULL);
+
+    ret = pthread_create(&seg->close_thread, NULL, segment_close_thread, s);
+    if (ret) {
+        av_log(s, AV_LOG_ERROR, "pthread_create failed: %s\n",
+               av_err2str(AVERROR(ret)));
+        pthread_cond_destroy(&seg->close_cond);
+        pthread_mutex_destroy(&seg->close_mutex);
+        av_fifo_freep(&seg->close_queue);
+        return AVERROR(ret);
+    }
+    seg->close_thread_started = 1;
+    return 0;
+}
+
+/* wait for the pending segments to be finalized and stop the thread */
+static int segment_close_uninit(SegmentContext *seg)
+{
+    if (!seg->close_thread_started)
+        return 0;
+
+    pthread_mutex_lock(&seg->close_mutex);
+    seg->close_finish = 1;
+    pthread_cond_broadcast(&seg->close_cond);
+    pthread_mutex_unlock(&seg->close_mutex);
+    pthread_join(seg->close_thread, NULL);
+    seg->close_thread_started = 0;
+
+    av_fifo_freep(&seg->close_queue);
+    pthread_cond_destroy(&seg->close_cond);
+    pthread_mutex_destroy(&seg->close_mutex);
+    return seg->close_error;
+}
+
+/* hand the current segment to the finalizing thread */
+static int segment_close_queue(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    SegmentCloseJob job = { 0 };
+    int ret;
+
+    job.avf            = seg->avf;
+    job.entry          = seg->cur_entry;
+    job.entry.filename = av_strdup(seg->cur_entry.filename);
+    job.segment_count  = seg->segment_count;
+    if (!job.entry.filename)
+        return AVERROR(ENOMEM);
+
+    pthread_mutex_lock(&seg->close_mutex);
+    while (!seg->close_error && !av_fifo_space(seg->close_queue))
+        pthread_cond_wait(&seg->close_cond, &seg->close_mutex);
+    ret = seg->close_error;
+    if (!ret) {
+        av_fifo_generic_write(seg->close_queue, &job, sizeof(job), NULL);
+        seg->nb_closes_pending++;
+        pthread_cond_broadcast(&seg->close_cond);
+        seg->avf = NULL;
+    }
+    pthread_mutex_unlock(&seg->close_mutex);
+
+    if (ret < 0)
+        av_freep(&job.entry.filename);
+    return ret;
+}
+#endif
+
+static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
+{
+    SegmentContext *seg = s->priv_data;
+    int ret;
+    AVTimecode tc;
+    AVRational rate;
+    AVDictionaryEntry *tcr;
+    char buf[AV_TIMECODE_STR_SIZE];
+    int i;
+    int err;
+
+#if HAVE_THREADS
+    if (seg->close_thread_started && !is_last)
+        ret = segment_close_queue(s);
+    else
+#endif
+    ret = segment_finalize(s, seg->avf, &seg->cur_entry, seg->segment_count,
+                           write_trailer, is_last);
     seg->segment_count++;
 
     if (seg->increment_tc) {
@@ -421,9 +576,6 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
         }
     }
 
-end:
-    ff_format_io_close(oc, &oc->pb);
-
     return ret;
 }
 
@@ -623,6 +775,9 @@ static int select_reference_stream(AVFormatContext *s)
 
 static void seg_free_context(SegmentContext *seg)
 {
+#if HAVE_THREADS
+    segment_close_uninit(seg);
+#endif
     ff_format_io_close(seg->avf, &seg->list_pb);
     avformat_free_context(seg->avf);
     seg->avf = NULL;
@@ -783,6 +938,15 @@ static int seg_write_header(AVFormatContext *s)
             oc->pb->seekable = 0;
     }
 
+    if (seg->async_close && seg->individual_header_trailer) {
+#if HAVE_THREADS
+        ret = segment_close_init(s);
+#else
+        av_log(s, AV_LOG_WARNING,
+               "Asynchronous closing is not supported without threads, option ignored\n");
+#endif
+    }
+
 fail:
     av_dict_free(&options);
     if (ret < 0)
@@ -908,7 +1072,11 @@ static int seg_write_trailer(struct AVFormatContext *s)
     SegmentListEntry *cur, *next;
     int ret = 0;
 
-    if (!oc)
+#if HAVE_THREADS
+    /* the last segment and list update must come after the pending ones */
+    ret = segment_close_uninit(seg);
+#endif
+    if (!oc || ret < 0)
         goto fail;
 
     if (!seg->write_header_trailer) {
@@ -986,6 +1154,7 @@ static const AVOption options[] = {
     { "write_header_trailer", "write a header to the first segment and a trailer to the last one", OFFSET(write_header_trailer), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, E },
     { "reset_timestamps", "reset timestamps at the begin of each segment", OFFSET(reset_timestamps), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { "initial_offset", "set initial timestamp offset", OFFSET(initial_offset), AV_OPT_TYPE_DURATION, {.i64 = 0}, -INT64_MAX, INT64_MAX, E },
+    { "segment_async_close", "set maximum number of segments finalized in the background", OFFSET(async_close), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, E },
     { NULL },
 };
 
@@ -52,9 +52,11 @@ typedef struct OutputStream {
     int ctx_inited;
     char dirname[1024];
     uint8_t iobuf[32768];
-    URLContext *out;  // Current output stream where all output is written
-    URLContext *out2; // Auxiliary output stream where all output is also written
-    URLContext *tail_out; // The actual main output stream, if we're currently seeked back to write elsewhere
+    URLContext *out;  // Earlier fragment being updated, if we're currently seeked back to write there
+    URLContext *out2; // Its FragmentInfo file, where all output is also written
+    uint8_t *frag_buf; // The current fragment, starting at cur_start_pos
+    unsigned int frag_buf_size;
+    int64_t frag_size;
     int64_t tail_pos, cur_pos, cur_start_pos;
     int packets_written;
     const char *stream_type_tag;
@@ -82,10 +84,24 @@ typedef struct SmoothStreamingContext {
 static int ism_write(void *opaque, uint8_t *buf, int buf_size)
 {
     OutputStream *os = opaque;
-    if (os->out)
+    if (os->out) {
         ffurl_write(os->out, buf, buf_size);
-    if (os->out2)
-        ffurl_write(os->out2, buf, buf_size);
+        if (os->out2)
+            ffurl_write(os->out2, buf, buf_size);
+    } else if (os->cur_pos >= os->cur_start_pos) {
+        int64_t pos = os->cur_pos - os->cur_start_pos;
+        uint8_t *frag_buf;
+        if (pos + buf_size > INT_MAX)
+            return AVERROR(ERANGE);
+        frag_buf = av_fast_realloc(os->frag_buf, &os->frag_buf_size, pos + buf_size);
+        if (!frag_buf)
+            return AVERROR(ENOMEM);
+        os->frag_buf = frag_buf;
+        if (pos > os->frag_size)
+            memset(frag_buf + os->frag_size, 0, pos - os->frag_size);
+        memcpy(frag_buf + pos, buf, buf_size);
+        os->frag_size = FFMAX(os->frag_size, pos + buf_size);
+    }
     os->cur_pos += buf_size;
     if (os->cur_pos >= os->tail_pos)
         os->tail_pos = os->cur_pos;
@@ -98,20 +114,9 @@ static int64_t ism_seek(void *opaque, int64_t offset, int whence)
     int i;
     if (whence != SEEK_SET)
         return AVERROR(ENOSYS);
-    if (os->tail_out) {
-        if (os->out) {
-            ffurl_close(os->out);
-        }
-        if (os->out2) {
-            ffurl_close(os->out2);
-        }
-        os->out = os->tail_out;
-        os->out2 = NULL;
-        os->tail_out = NULL;
-    }
+    ffurl_closep(&os->out);
+    ffurl_closep(&os->out2);
     if (offset >= os->cur_start_pos) {
-        if (os->out)
-            ffurl_seek(os->out, offset - os->cur_start_pos, SEEK_SET);
         os->cur_pos = offset;
         return offset;
     }
@@ -120,16 +125,12 @@ static int64_t ism_seek(void *opaque, int64_t offset, int whence)
         if (offset >= frag->start_pos && offset < frag->start_pos + frag->size) {
             int ret;
             AVDictionary *opts = NULL;
-            os->tail_out = os->out;
             av_dict_set(&opts, "truncate", "0", 0);
             ret = ffurl_open_whitelist(&os->out, frag->file, AVIO_FLAG_WRITE,
                                        &os->ctx->interrupt_callback, &opts, os->ctx->protocol_whitelist, os->ctx->protocol_blacklist);
             av_dict_free(&opts);
-            if (ret < 0) {
-                os->out = os->tail_out;
-                os->tail_out = NULL;
+            if (ret < 0)
                 return ret;
-            }
             av_dict_set(&opts, "truncate", "0", 0);
             ffurl_open_whitelist(&os->out2, frag->infofile, AVIO_FLAG_WRITE,
                                  &os->ctx->interrupt_callback, &opts, os->ctx->protocol_whitelist, os->ctx->protocol_blacklist);
@@ -175,12 +176,11 @@ static void ism_free(AVFormatContext *s)
         return;
     for (i = 0; i < s->nb_streams; i++) {
         OutputStream *os = &c->streams[i];
-        ffurl_close(os->out);
-        ffurl_close(os->out2);
-        ffurl_close(os->tail_out);
-        os->out = os->out2 = os->tail_out = NULL;
         if (os->ctx && os->ctx_inited)
             av_write_trailer(os->ctx);
+        ffurl_closep(&os->out);
+        ffurl_closep(&os->out2);
+        av_freep(&os->frag_buf);
         if (os->ctx && os->ctx->pb)
             av_freep(&os->ctx->pb);
         if (os->ctx)
@@ -213,6 +213,15 @@ static void output_chunk_list(OutputStream *os, AVIOContext *out, int final, int
     }
 }
 
+static int path_fits(AVFormatContext *s, int len, int size)
+{
+    if (len < 0 || len >= size) {
+        av_log(s, AV_LOG_ERROR, "File name too long\n");
+        return 0;
+    }
+    return 1;
+}
+
 static int write_manifest(AVFormatContext *s, int final)
 {
     SmoothStreamingContext *c = s->priv_data;
@@ -221,8 +230,11 @@ static int write_manifest(AVFormatContext *s, int final)
     int ret, i, video_chunks = 0, audio_chunks = 0, video_streams = 0, audio_streams = 0;
     int64_t duration = 0;
 
-    snprintf(filename, sizeof(filename), "%s/Manifest", s->filename);
-    snprintf(temp_filename, sizeof(temp_filename), "%s/Manifest.tmp", s->filename);
+    if (!path_fits(s, snprintf(filename, sizeof(filename), "%s/Manifest", s->filename),
+                   sizeof(filename)) ||
+        !path_fits(s, snprintf(temp_filename, sizeof(temp_filename), "%s/Manifest.tmp", s->filename),
+                   sizeof(temp_filename)))
+        return AVERROR(EINVAL);
     ret = s->io_open(s, &out, temp_filename, AVIO_FLAG_WRITE, NULL);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Unable to open %s for writing\n", temp_filename);
@@ -324,7 +336,12 @@ static int ism_write_header(AVFormatContext *s)
             ret = AVERROR(EINVAL);
             goto fail;
         }
-        snprintf(os->dirname, sizeof(os->dirname), "%s/QualityLevels(%"PRId64")", s->filename, (int64_t)s->streams[i]->codec->bit_rate);
+        if (!path_fits(s, snprintf(os->dirname, sizeof(os->dirname), "%s/QualityLevels(%"PRId64")",
+                                   s->filename, (int64_t)s->streams[i]->codec->bit_rate),
+                       sizeof(os->dirname))) {
+            ret = AVERROR(EINVAL);
+            goto fail;
+        }
         if (mkdir(os->dirname, 0777) == -1 && errno != EEXIST) {
             ret = AVERROR(errno);
             av_log(s, AV_LOG_ERROR, "mkdir failed\n");
@@ -407,14 +424,12 @@ fail:
     return ret;
 }
 
-static int parse_fragment(AVFormatContext *s, const char *filename, int64_t *start_ts, int64_t *duration, int64_t *moof_size, int64_t size)
+static int parse_fragment(uint8_t *buf, int64_t *start_ts, int64_t *duration, int64_t *moof_size, int64_t size)
 {
-    AVIOContext *in;
-    int ret;
+    AVIOContext pb, *in = &pb;
+    int ret = AVERROR(EIO);
     uint32_t len;
-    if ((ret = s->io_open(s, &in, filename, AVIO_FLAG_READ, NULL)) < 0)
-        return ret;
-    ret = AVERROR(EIO);
+    ffio_init_context(in, buf, size, 0, NULL, NULL, NULL, NULL);
     *moof_size = avio_rb32(in);
     if (*moof_size < 8 || *moof_size > size)
         goto fail;
@@ -453,7 +468,6 @@ static int parse_fragment(AVFormatContext *s, const char *filename, int64_t *sta
         avio_seek(in, end, SEEK_SET);
     }
 fail:
-    ff_format_io_close(s, &in);
     return ret;
 }
 
@@ -485,30 +499,16 @@ static int add_fragment(OutputStream *os, const char *file, const char *infofile
     return 0;
 }
 
-static int copy_moof(AVFormatContext *s, const char* infile, const char *outfile, int64_t size)
+static int write_file(AVFormatContext *s, const char *filename, const uint8_t *buf, int64_t size)
 {
-    AVIOContext *in, *out;
-    int ret = 0;
-    if ((ret = s->io_open(s, &in, infile, AVIO_FLAG_READ, NULL)) < 0)
-        return ret;
-    if ((ret = s->io_open(s, &out, outfile, AVIO_FLAG_WRITE, NULL)) < 0) {
-        ff_format_io_close(s, &in);
+    AVIOContext *out;
+    int ret;
+    if ((ret = s->io_open(s, &out, filename, AVIO_FLAG_WRITE, NULL)) < 0)
         return ret;
-    }
-    while (size > 0) {
-        uint8_t buf[8192];
-        int n = FFMIN(size, sizeof(buf));
-        n = avio_read(in, buf, n);
-        if (n <= 0) {
-            ret = AVERROR(EIO);
-            break;
-        }
-        avio_write(out, buf, n);
-        size -= n;
-    }
+    avio_write(out, buf, size);
     avio_flush(out);
+    ret = out->error;
     ff_format_io_close(s, &out);
-    ff_format_io_close(s, &in);
     return ret;
 }
 
@@ -525,25 +525,35 @@ static int ism_flush(AVFormatContext *s, int final)
         if (!os->packets_written)
             continue;
 
-        snprintf(filename, sizeof(filename), "%s/temp", os->dirname);
-        ret = ffurl_open_whitelist(&os->out, filename, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL, s->protocol_whitelist, s->protocol_blacklist);
-        if (ret < 0)
-            break;
+        /* the fragment is kept in memory as it is muxed, then written
+         * out once along with the copy of its moof */
         os->cur_start_pos = os->tail_pos;
+        os->frag_size = 0;
         av_write_frame(os->ctx, NULL);
         avio_flush(os->ctx->pb);
         os->packets_written = 0;
-        if (!os->out || os->tail_out)
+        if (os->out || os->ctx->pb->error < 0)
             return AVERROR(EIO);
 
-        ffurl_close(os->out);
-        os->out = NULL;
         size = os->tail_pos - os->cur_start_pos;
-        if ((ret = parse_fragment(s, filename, &start_ts, &duration, &moof_size, size)) < 0)
+        if (size != os->frag_size)
+            return AVERROR(EIO);
+        if ((ret = parse_fragment(os->frag_buf, &start_ts, &duration, &moof_size, size)) < 0)
+            break;
+        if (!path_fits(s, snprintf(filename, sizeof(filename), "%s/temp", os->dirname),
+                       sizeof(filename)) ||
+            !path_fits(s, snprintf(header_filename, sizeof(header_filename), "%s/FragmentInfo(%s=%"PRIu64")",
+                                   os->dirname, os->stream_type_tag, start_ts),
+                       sizeof(header_filename)) ||
+            !path_fits(s, snprintf(target_filename, sizeof(target_filename), "%s/Fragments(%s=%"PRIu64")",
+                                   os->dirname, os->stream_type_tag, start_ts),
+                       sizeof(target_filename))) {
+            ret = AVERROR(EINVAL);
+            break;
+        }
+        if ((ret = write_file(s, filename, os->frag_buf, size)) < 0)
             break;
-        snprintf(header_filename, sizeof(header_filename), "%s/FragmentInfo(%s=%"PRIu64")", os->dirname, os->stream_type_tag, start_ts);
-        snprintf(target_filename, sizeof(target_filename), "%s/Fragments(%s=%"PRIu64")", os->dirname, os->stream_type_tag, start_ts);
-        copy_moof(s, filename, header_filename, moof_size);
+        write_file(s, header_filename, os->frag_buf, moof_size);
         ret = ff_rename(filename, target_filename, s);
         if (ret < 0)
             break;
@@ -609,8 +619,9 @@ static int ism_write_trailer(AVFormatContext *s)
 
     if (c->remove_at_exit) {
         char filename[1024];
-        snprintf(filename, sizeof(filename), "%s/Manifest", s->filename);
-        unlink(filename);
+        if (path_fits(s, snprintf(filename, sizeof(filename), "%s/Manifest", s->filename),
+                      sizeof(filename)))
+            unlink(filename);
         rmdir(s->filename);
     }
 
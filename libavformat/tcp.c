@@ -31,6 +31,12 @@
 #if HAVE_POLL_H
 #include <poll.h>
 #endif
+#if !HAVE_WINSOCK2_H
+#include <netinet/tcp.h>
+#endif
+#if HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 
 typedef struct TCPContext {
     const AVClass *class;
@@ -41,6 +47,10 @@ typedef struct TCPContext {
     int listen_timeout;
     int recv_buffer_size;
     int send_buffer_size;
+    int tcp_nodelay;
+    int tcp_fastopen;
+    int reuse_port;
+    int dns_cache_timeout;
 } TCPContext;
 
 #define OFFSET(x) offsetof(TCPContext, x)
@@ -52,6 +62,10 @@ static const AVOption options[] = {
     { "listen_timeout",  "Connection awaiting timeout (in milliseconds)",      OFFSET(listen_timeout), AV_OPT_TYPE_INT, { .i64 = -1 },         -1, INT_MAX, .flags = D|E },
     { "send_buffer_size", "Socket send buffer size (in bytes)",                OFFSET(send_buffer_size), AV_OPT_TYPE_INT, { .i64 = -1 },         -1, INT_MAX, .flags = D|E },
     { "recv_buffer_size", "Socket receive buffer size (in bytes)",             OFFSET(recv_buffer_size), AV_OPT_TYPE_INT, { .i64 = -1 },         -1, INT_MAX, .flags = D|E },
+    { "tcp_nodelay", "Use TCP_NODELAY to disable Nagle's algorithm",           OFFSET(tcp_nodelay), AV_OPT_TYPE_BOOL, { .i64 = 0 },             0, 1, .flags = D|E },
+    { "tcp_fastopen", "Enable TCP Fast Open, with the given queue length when listening", OFFSET(tcp_fastopen), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, .flags = D|E },
+    { "reuse_port",  "Let several listening sockets bind to the same port",    OFFSET(reuse_port),  AV_OPT_TYPE_BOOL, { .i64 = 0 },             0, 1, .flags = D|E },
+    { "dns_cache_timeout", "Reuse resolved addresses of a host for this long (in seconds)", OFFSET(dns_cache_timeout), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, .flags = D|E },
     { NULL }
 };
 
@@ -62,6 +76,48 @@ static const AVClass tcp_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+/* options which must be set before listen() or connect(), and are
+ * inherited by the accepted sockets on most systems */
+static void customize_fd(void *ctx, int fd)
+{
+    URLContext *h = ctx;
+    TCPContext *s = h->priv_data;
+
+    /* Set the socket's send or receive buffer sizes, if specified.
+       If unspecified or setting fails, system default is used. */
+    if (s->recv_buffer_size > 0) {
+        setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &s->recv_buffer_size, sizeof (s->recv_buffer_size));
+    }
+    if (s->send_buffer_size > 0) {
+        setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &s->send_buffer_size, sizeof (s->send_buffer_size));
+    }
+    if (s->tcp_nodelay > 0) {
+        if (setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &s->tcp_nodelay, sizeof (s->tcp_nodelay)))
+            av_log(h, AV_LOG_WARNING, "setsockopt(TCP_NODELAY) failed\n");
+    }
+    if (s->reuse_port > 0 && s->listen) {
+#ifdef SO_REUSEPORT
+        if (setsockopt (fd, SOL_SOCKET, SO_REUSEPORT, &s->reuse_port, sizeof (s->reuse_port)))
+#endif
+            av_log(h, AV_LOG_WARNING, "setsockopt(SO_REUSEPORT) failed\n");
+    }
+    if (s->tcp_fastopen > 0) {
+        int ret = -1;
+        if (s->listen) {
+#ifdef TCP_FASTOPEN
+            ret = setsockopt (fd, IPPROTO_TCP, TCP_FASTOPEN, &s->tcp_fastopen, sizeof (s->tcp_fastopen));
+#endif
+        } else {
+#ifdef TCP_FASTOPEN_CONNECT
+            int enable = 1;
+            ret = setsockopt (fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &enable, sizeof (enable));
+#endif
+        }
+        if (ret)
+            av_log(h, AV_LOG_WARNING, "TCP Fast Open is not available\n");
+    }
+}
+
 /* return non zero if error */
 static int tcp_open(URLContext *h, const char *uri, int flags)
 {
@@ -98,6 +154,9 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "listen_timeout", p)) {
             s->listen_timeout = strtol(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "tcp_nodelay", p)) {
+            s->tcp_nodelay = strtol(buf, NULL, 10);
+        }
     }
     if (s->rw_timeout >= 0) {
         s->open_timeout =
@@ -108,10 +167,8 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
     snprintf(portstr, sizeof(portstr), "%d", port);
     if (s->listen)
         hints.ai_flags |= AI_PASSIVE;
-    if (!hostname[0])
-        ret = getaddrinfo(NULL, portstr, &hints, &ai);
-    else
-        ret = getaddrinfo(hostname, portstr, &hints, &ai);
+    ret = ff_getaddrinfo_cached(hostname[0] ? hostname : NULL, portstr,
+                                &hints, &ai, s->dns_cache_timeout);
     if (ret) {
         av_log(h, AV_LOG_ERROR,
                "Failed to resolve hostname %s: %s\n",
@@ -121,6 +178,17 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
 
     cur_ai = ai;
 
+    if (!s->listen) {
+        ret = ff_connect_parallel(ai, s->open_timeout / 1000, 3, h, &fd,
+                                  customize_fd, h);
+        if (ret < 0)
+            goto fail1;
+        h->is_streamed = 1;
+        s->fd = fd;
+        av_free(ai);
+        return 0;
+    }
+
  restart:
     fd = ff_socket(cur_ai->ai_family,
                    cur_ai->ai_socktype,
@@ -130,6 +198,8 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
         goto fail;
     }
 
+    customize_fd(h, fd);
+
     if (s->listen == 2) {
         // multi-client
         if ((ret = ff_listen(fd, cur_ai->ai_addr, cur_ai->ai_addrlen)) < 0)
@@ -141,29 +211,12 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
             goto fail1;
         // Socket descriptor already closed here. Safe to overwrite to client one.
         fd = ret;
-    } else {
-        if ((ret = ff_listen_connect(fd, cur_ai->ai_addr, cur_ai->ai_addrlen,
-                                     s->open_timeout / 1000, h, !!cur_ai->ai_next)) < 0) {
-
-            if (ret == AVERROR_EXIT)
-                goto fail1;
-            else
-                goto fail;
-        }
     }
 
     h->is_streamed = 1;
     s->fd = fd;
-    /* Set the socket's send or receive buffer sizes, if specified.
-       If unspecified or setting fails, system default is used. */
-    if (s->recv_buffer_size > 0) {
-        setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &s->recv_buffer_size, sizeof (s->recv_buffer_size));
-    }
-    if (s->send_buffer_size > 0) {
-        setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &s->send_buffer_size, sizeof (s->send_buffer_size));
-    }
 
-    freeaddrinfo(ai);
+    av_free(ai);
     return 0;
 
  fail:
@@ -178,7 +231,7 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
  fail1:
     if (fd >= 0)
         closesocket(fd);
-    freeaddrinfo(ai);
+    av_free(ai);
     return ret;
 }
 
@@ -192,9 +245,14 @@ static int tcp_accept(URLContext *s, URLContext **c)
         return ret;
     cc = (*c)->priv_data;
     ret = ff_accept(sc->fd, sc->listen_timeout, s);
-    if (ret < 0)
-        return ff_neterrno();
+    if (ret < 0) {
+        ffurl_closep(c);
+        return ret;
+    }
     cc->fd = ret;
+    /* TCP_NODELAY is not inherited from the listening socket everywhere */
+    if (sc->tcp_nodelay > 0)
+        setsockopt (cc->fd, IPPROTO_TCP, TCP_NODELAY, &sc->tcp_nodelay, sizeof (sc->tcp_nodelay));
     return 0;
 }
 
@@ -226,6 +284,44 @@ static int tcp_write(URLContext *h, const uint8_t *buf, int size)
     return ret < 0 ? ff_neterrno() : ret;
 }
 
+#if HAVE_SYS_UIO_H
+static int tcp_readv(URLContext *h, const URLIOVec *iov, int nb_iov)
+{
+    TCPContext *s = h->priv_data;
+    struct iovec vec[URL_IOV_MAX];
+    struct msghdr msg = { 0 };
+    int ret;
+
+    if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+        ret = ff_network_wait_fd_timeout(s->fd, 0, h->rw_timeout, &h->interrupt_callback);
+        if (ret)
+            return ret;
+    }
+    msg.msg_iov    = vec;
+    msg.msg_iovlen = ff_url_iovec(vec, iov, nb_iov, INT_MAX);
+    ret = recvmsg(s->fd, &msg, 0);
+    return ret < 0 ? ff_neterrno() : ret;
+}
+
+static int tcp_writev(URLContext *h, const URLIOVec *iov, int nb_iov)
+{
+    TCPContext *s = h->priv_data;
+    struct iovec vec[URL_IOV_MAX];
+    struct msghdr msg = { 0 };
+    int ret;
+
+    if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+        ret = ff_network_wait_fd_timeout(s->fd, 1, h->rw_timeout, &h->interrupt_callback);
+        if (ret)
+            return ret;
+    }
+    msg.msg_iov    = vec;
+    msg.msg_iovlen = ff_url_iovec(vec, iov, nb_iov, INT_MAX);
+    ret = sendmsg(s->fd, &msg, MSG_NOSIGNAL);
+    return ret < 0 ? ff_neterrno() : ret;
+}
+#endif
+
 static int tcp_shutdown(URLContext *h, int flags)
 {
     TCPContext *s = h->priv_data;
@@ -261,6 +357,10 @@ const URLProtocol ff_tcp_protocol = {
     .url_accept          = tcp_accept,
     .url_read            = tcp_read,
     .url_write           = tcp_write,
+#if HAVE_SYS_UIO_H
+    .url_readv           = tcp_readv,
+    .url_writev          = tcp_writev,
+#endif
     .url_close           = tcp_close,
     .url_get_file_handle = tcp_get_file_handle,
     .url_shutdown        = tcp_shutdown,
@@ -23,12 +23,21 @@
 #include "libavutil/avutil.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
 #include "internal.h"
 #include "avformat.h"
 #include "avio_internal.h"
+#include "url.h"
 
 #define MAX_SLAVES 16
 
+enum TeeOverflowPolicy {
+    ON_OVERFLOW_BLOCK,
+    ON_OVERFLOW_DROP,
+    ON_OVERFLOW_DISCONNECT,
+};
+
 typedef struct {
     AVFormatContext *avf;
     AVBitStreamFilterContext **bsfs; ///< bitstream filters per stream
@@ -36,12 +45,32 @@ typedef struct {
     /** map from input to output streams indexes,
      * disabled output streams are set to -1 */
     int *stream_map;
+
+    int use_thread;
+    int queue_size;
+    int on_overflow;                 ///< enum TeeOverflowPolicy
+
+    /** packets waiting for the slave thread, NULL if the slave is written
+     * from the caller's thread */
+    AVThreadMessageQueue *queue;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    int error;                       ///< error that stopped the slave thread
+    uint8_t *wait_keyframe;          ///< per output stream, set after a drop
+    int64_t nb_dropped;
+    volatile int disconnected;
+    AVIOInterruptCB interrupt_callback; ///< of the tee muxer
 } TeeSlave;
 
 typedef struct TeeContext {
     const AVClass *class;
     unsigned nb_slaves;
     TeeSlave slaves[MAX_SLAVES];
+
+    int use_thread;
+    int queue_size;
+    int on_overflow;
 } TeeContext;
 
 static const char *const slave_delim     = "|";
@@ -51,9 +80,22 @@ static const char *const slave_opt_delim = ":]"; /* must have the close too */
 static const char *const slave_bsfs_spec_sep = "/";
 static const char *const slave_select_sep = ",";
 
+#define OFFSET(x) offsetof(TeeContext, x)
+#define E AV_OPT_FLAG_ENCODING_PARAM
+static const AVOption options[] = {
+    { "use_thread",  "write each slave from its own thread", OFFSET(use_thread), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
+    { "queue_size",  "maximum number of packets queued for a threaded slave", OFFSET(queue_size), AV_OPT_TYPE_INT, { .i64 = 256 }, 1, INT_MAX, E },
+    { "on_overflow", "what to do when the queue of a threaded slave is full", OFFSET(on_overflow), AV_OPT_TYPE_INT, { .i64 = ON_OVERFLOW_BLOCK }, 0, ON_OVERFLOW_DISCONNECT, E, "on_overflow" },
+        { "block",      "wait for the slave",                               0, AV_OPT_TYPE_CONST, { .i64 = ON_OVERFLOW_BLOCK },      0, 0, E, "on_overflow" },
+        { "drop",       "drop packets, until the next keyframe",            0, AV_OPT_TYPE_CONST, { .i64 = ON_OVERFLOW_DROP },       0, 0, E, "on_overflow" },
+        { "disconnect", "stop writing to the slave",                        0, AV_OPT_TYPE_CONST, { .i64 = ON_OVERFLOW_DISCONNECT }, 0, 0, E, "on_overflow" },
+    { NULL },
+};
+
 static const AVClass tee_muxer_class = {
     .class_name = "Tee muxer",
     .item_name  = av_default_item_name,
+    .option     = options,
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
@@ -135,6 +177,58 @@ end:
     return ret;
 }
 
+static int slave_interrupt_cb(void *opaque)
+{
+    TeeSlave *tee_slave = opaque;
+    return tee_slave->disconnected ||
+           ff_check_interrupt(&tee_slave->interrupt_callback);
+}
+
+static int parse_thread_options(AVFormatContext *avf, TeeSlave *tee_slave,
+                                const char *use_thread, const char *queue_size,
+                                const char *on_overflow)
+{
+    TeeContext *tee = avf->priv_data;
+    char *end;
+
+    tee_slave->use_thread  = tee->use_thread;
+    tee_slave->queue_size  = tee->queue_size;
+    tee_slave->on_overflow = tee->on_overflow;
+
+    if (use_thread) {
+        tee_slave->use_thread = strtol(use_thread, &end, 10);
+        if (*end || (unsigned)tee_slave->use_thread > 1) {
+            av_log(avf, AV_LOG_ERROR, "Invalid use_thread value '%s'\n", use_thread);
+            return AVERROR(EINVAL);
+        }
+    }
+    if (queue_size) {
+        tee_slave->queue_size = strtol(queue_size, &end, 10);
+        if (*end || tee_slave->queue_size <= 0) {
+            av_log(avf, AV_LOG_ERROR, "Invalid queue_size value '%s'\n", queue_size);
+            return AVERROR(EINVAL);
+        }
+    }
+    if (on_overflow) {
+        if (!strcmp(on_overflow, "block")) {
+            tee_slave->on_overflow = ON_OVERFLOW_BLOCK;
+        } else if (!strcmp(on_overflow, "drop")) {
+            tee_slave->on_overflow = ON_OVERFLOW_DROP;
+        } else if (!strcmp(on_overflow, "disconnect")) {
+            tee_slave->on_overflow = ON_OVERFLOW_DISCONNECT;
+        } else {
+            av_log(avf, AV_LOG_ERROR, "Invalid on_overflow value '%s', "
+                   "must be block, drop or disconnect\n", on_overflow);
+            return AVERROR(EINVAL);
+        }
+    }
+    if (tee_slave->use_thread && !HAVE_THREADS) {
+        av_log(avf, AV_LOG_ERROR, "Threaded slaves require thread support\n");
+        return AVERROR(ENOSYS);
+    }
+    return 0;
+}
+
 static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
 {
     int i, ret;
@@ -142,6 +236,7 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     AVDictionaryEntry *entry;
     char *filename;
     char *format = NULL, *select = NULL;
+    char *use_thread = NULL, *queue_size = NULL, *on_overflow = NULL;
     AVFormatContext *avf2 = NULL;
     AVStream *st, *st2;
     int stream_count;
@@ -161,6 +256,13 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
 
     STEAL_OPTION("f", format);
     STEAL_OPTION("select", select);
+    STEAL_OPTION("use_thread", use_thread);
+    STEAL_OPTION("queue_size", queue_size);
+    STEAL_OPTION("on_overflow", on_overflow);
+
+    if ((ret = parse_thread_options(avf, tee_slave, use_thread, queue_size,
+                                    on_overflow)) < 0)
+        goto end;
 
     ret = avformat_alloc_output_context2(&avf2, NULL, format, filename);
     if (ret < 0)
@@ -169,6 +271,12 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     avf2->opaque   = avf->opaque;
     avf2->io_open  = avf->io_open;
     avf2->io_close = avf->io_close;
+    if (tee_slave->use_thread) {
+        /* lets a disconnected slave give up on blocking I/O */
+        tee_slave->interrupt_callback   = avf->interrupt_callback;
+        avf2->interrupt_callback.callback = slave_interrupt_cb;
+        avf2->interrupt_callback.opaque   = tee_slave;
+    }
 
     tee_slave->stream_map = av_calloc(avf->nb_streams, sizeof(*tee_slave->stream_map));
     if (!tee_slave->stream_map) {
@@ -306,11 +414,114 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
 end:
     av_free(format);
     av_free(select);
+    av_free(use_thread);
+    av_free(queue_size);
+    av_free(on_overflow);
     av_dict_free(&options);
     av_freep(&tmp_select);
     return ret;
 }
 
+static int write_slave_packet(TeeSlave *tee_slave, AVPacket *pkt)
+{
+    AVFormatContext *avf2 = tee_slave->avf;
+    int s2 = pkt->stream_index;
+    int ret;
+
+    if ((ret = av_apply_bitstream_filters(avf2->streams[s2]->codec, pkt,
+                                          tee_slave->bsfs[s2])) < 0) {
+        av_packet_unref(pkt);
+        return ret;
+    }
+    return av_interleaved_write_frame(avf2, pkt);
+}
+
+#if HAVE_THREADS
+static void *slave_thread(void *arg)
+{
+    TeeSlave *tee_slave = arg;
+    AVPacket pkt;
+    int ret;
+
+    while ((ret = av_thread_message_queue_recv(tee_slave->queue, &pkt, 0)) >= 0)
+        if ((ret = write_slave_packet(tee_slave, &pkt)) < 0)
+            break;
+
+    if (ret != AVERROR_EOF && !tee_slave->disconnected) {
+        av_log(tee_slave->avf, AV_LOG_ERROR, "Error writing packet: %s\n",
+               av_err2str(ret));
+        tee_slave->error = ret;
+    }
+    /* make the next av_thread_message_queue_send() fail */
+    av_thread_message_queue_set_err_send(tee_slave->queue, ret);
+    return NULL;
+}
+
+static void free_packet(void *msg)
+{
+    av_packet_unref(msg);
+}
+#endif
+
+static int start_slave_thread(TeeSlave *tee_slave)
+{
+#if HAVE_THREADS
+    int ret;
+
+    tee_slave->wait_keyframe = av_mallocz(tee_slave->avf->nb_streams);
+    if (!tee_slave->wait_keyframe)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_alloc(&tee_slave->queue, tee_slave->queue_size,
+                                        sizeof(AVPacket));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(tee_slave->queue, free_packet);
+
+    ret = pthread_create(&tee_slave->thread, NULL, slave_thread, tee_slave);
+    if (ret) {
+        av_thread_message_queue_free(&tee_slave->queue);
+        return AVERROR(ret);
+    }
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+/**
+ * Stop writing to a threaded slave: the queued packets are dropped and the
+ * thread exits as soon as it can, which the interrupt callback of the slave
+ * makes happen even if it is blocked on I/O. The thread is joined when the
+ * slave is closed.
+ */
+static void disconnect_slave(TeeSlave *tee_slave)
+{
+    tee_slave->disconnected = 1;
+    av_thread_message_flush(tee_slave->queue);
+    av_thread_message_queue_set_err_recv(tee_slave->queue, AVERROR_EXIT);
+}
+
+/**
+ * Wait for the thread of a slave to exit, once it has written all the
+ * queued packets if err is AVERROR_EOF.
+ *
+ * @return the error which stopped the thread early, if any
+ */
+static int stop_slave_thread(TeeSlave *tee_slave, int err)
+{
+#if HAVE_THREADS
+    if (!tee_slave->queue)
+        return 0;
+    if (err != AVERROR_EOF)
+        disconnect_slave(tee_slave);
+    av_thread_message_queue_set_err_recv(tee_slave->queue, err);
+    pthread_join(tee_slave->thread, NULL);
+    av_thread_message_queue_free(&tee_slave->queue);
+#endif
+    return tee_slave->error;
+}
+
 static void close_slaves(AVFormatContext *avf)
 {
     TeeContext *tee = avf->priv_data;
@@ -318,6 +529,7 @@ static void close_slaves(AVFormatContext *avf)
     unsigned i, j;
 
     for (i = 0; i < tee->nb_slaves; i++) {
+        stop_slave_thread(&tee->slaves[i], AVERROR_EXIT);
         avf2 = tee->slaves[i].avf;
 
         for (j = 0; j < avf2->nb_streams; j++) {
@@ -330,6 +542,7 @@ static void close_slaves(AVFormatContext *avf)
         }
         av_freep(&tee->slaves[i].stream_map);
         av_freep(&tee->slaves[i].bsfs);
+        av_freep(&tee->slaves[i].wait_keyframe);
 
         ff_format_io_close(avf2, &avf2->pb);
         avformat_free_context(avf2);
@@ -340,8 +553,14 @@ static void close_slaves(AVFormatContext *avf)
 static void log_slave(TeeSlave *slave, void *log_ctx, int log_level)
 {
     int i;
-    av_log(log_ctx, log_level, "filename:'%s' format:%s\n",
+    av_log(log_ctx, log_level, "filename:'%s' format:%s",
            slave->avf->filename, slave->avf->oformat->name);
+    if (slave->use_thread)
+        av_log(log_ctx, log_level, " thread queue_size:%d on_overflow:%s",
+               slave->queue_size,
+               slave->on_overflow == ON_OVERFLOW_BLOCK ? "block" :
+               slave->on_overflow == ON_OVERFLOW_DROP  ? "drop"  : "disconnect");
+    av_log(log_ctx, log_level, "\n");
     for (i = 0; i < slave->avf->nb_streams; i++) {
         AVStream *st = slave->avf->streams[i];
         AVBitStreamFilterContext *bsf = slave->bsfs[i];
@@ -393,6 +612,15 @@ static int tee_write_header(AVFormatContext *avf)
 
     tee->nb_slaves = nb_slaves;
 
+    for (i = 0; i < nb_slaves; i++) {
+        if (tee->slaves[i].use_thread &&
+            (ret = start_slave_thread(&tee->slaves[i])) < 0) {
+            av_log(avf, AV_LOG_ERROR, "Slave '%s': error starting thread: %s\n",
+                   tee->slaves[i].avf->filename, av_err2str(ret));
+            goto fail;
+        }
+    }
+
     for (i = 0; i < avf->nb_streams; i++) {
         int j, mapped = 0;
         for (j = 0; j < tee->nb_slaves; j++)
@@ -418,8 +646,16 @@ static int tee_write_trailer(AVFormatContext *avf)
     unsigned i;
 
     for (i = 0; i < tee->nb_slaves; i++) {
-        avf2 = tee->slaves[i].avf;
-        if ((ret = av_write_trailer(avf2)) < 0)
+        TeeSlave *tee_slave = &tee->slaves[i];
+        avf2 = tee_slave->avf;
+        if ((ret = stop_slave_thread(tee_slave, AVERROR_EOF)) < 0 &&
+            !tee_slave->disconnected)
+            if (!ret_all)
+                ret_all = ret;
+        if (tee_slave->nb_dropped)
+            av_log(avf, AV_LOG_WARNING, "Slave '%s': %"PRId64" packets dropped\n",
+                   avf2->filename, tee_slave->nb_dropped);
+        if (!tee_slave->disconnected && (ret = av_write_trailer(avf2)) < 0)
             if (!ret_all)
                 ret_all = ret;
         if (!(avf2->oformat->flags & AVFMT_NOFILE))
@@ -429,6 +665,51 @@ static int tee_write_trailer(AVFormatContext *avf)
     return ret_all;
 }
 
+/**
+ * Queue a packet for the thread of a slave, applying its overflow policy if
+ * the queue is full.
+ */
+static int queue_slave_packet(AVFormatContext *avf, TeeSlave *tee_slave,
+                              AVPacket *pkt)
+{
+    int s2 = pkt->stream_index;
+    int ret;
+
+    /* after a drop, the stream cannot be decoded until the next keyframe */
+    if (tee_slave->wait_keyframe[s2]) {
+        if (!(pkt->flags & AV_PKT_FLAG_KEY)) {
+            tee_slave->nb_dropped++;
+            av_packet_unref(pkt);
+            return 0;
+        }
+        tee_slave->wait_keyframe[s2] = 0;
+    }
+
+    ret = av_thread_message_queue_send(tee_slave->queue, pkt,
+                                       tee_slave->on_overflow == ON_OVERFLOW_BLOCK ?
+                                       0 : AV_THREAD_MESSAGE_NONBLOCK);
+    if (ret >= 0)
+        return 0;
+    av_packet_unref(pkt);
+
+    if (ret == AVERROR(EAGAIN) && tee_slave->on_overflow == ON_OVERFLOW_DROP) {
+        if (!tee_slave->nb_dropped)
+            av_log(avf, AV_LOG_WARNING, "Slave '%s': queue full, dropping packets\n",
+                   tee_slave->avf->filename);
+        tee_slave->nb_dropped++;
+        tee_slave->wait_keyframe[s2] = 1;
+        return 0;
+    }
+    if (tee_slave->on_overflow == ON_OVERFLOW_DISCONNECT) {
+        av_log(avf, AV_LOG_ERROR, "Slave '%s': %s, disconnecting\n",
+               tee_slave->avf->filename,
+               ret == AVERROR(EAGAIN) ? "queue full" : av_err2str(ret));
+        disconnect_slave(tee_slave);
+        return 0;
+    }
+    return ret;
+}
+
 static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
 {
     TeeContext *tee = avf->priv_data;
@@ -440,18 +721,19 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
     AVRational tb, tb2;
 
     for (i = 0; i < tee->nb_slaves; i++) {
-        avf2 = tee->slaves[i].avf;
+        TeeSlave *tee_slave = &tee->slaves[i];
+        avf2 = tee_slave->avf;
         s = pkt->stream_index;
-        s2 = tee->slaves[i].stream_map[s];
-        if (s2 < 0)
+        s2 = tee_slave->stream_map[s];
+        if (s2 < 0 || tee_slave->disconnected)
             continue;
 
-        if ((ret = av_copy_packet(&pkt2, pkt)) < 0 ||
-            (ret = av_dup_packet(&pkt2))< 0)
-            if (!ret_all) {
+        av_init_packet(&pkt2);
+        if ((ret = av_packet_ref(&pkt2, pkt)) < 0) {
+            if (!ret_all)
                 ret_all = ret;
-                continue;
-            }
+            continue;
+        }
         tb  = avf ->streams[s ]->time_base;
         tb2 = avf2->streams[s2]->time_base;
         pkt2.pts      = av_rescale_q(pkt->pts,      tb, tb2);
@@ -459,11 +741,12 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
         pkt2.duration = av_rescale_q(pkt->duration, tb, tb2);
         pkt2.stream_index = s2;
 
-        if ((ret = av_apply_bitstream_filters(avf2->streams[s2]->codec, &pkt2,
-                                              tee->slaves[i].bsfs[s2])) < 0 ||
-            (ret = av_interleaved_write_frame(avf2, &pkt2)) < 0)
-            if (!ret_all)
-                ret_all = ret;
+        if (tee_slave->queue)
+            ret = queue_slave_packet(avf, tee_slave, &pkt2);
+        else
+            ret = write_slave_packet(tee_slave, &pkt2);
+        if (ret < 0 && !ret_all)
+            ret_all = ret;
     }
     return ret_all;
 }
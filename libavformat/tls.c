@@ -28,6 +28,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 
 static void set_options(TLSShared *c, const char *uri)
 {
@@ -68,6 +69,7 @@ int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AV
         snprintf(opts, sizeof(opts), "?listen=1");
 
     av_url_split(NULL, 0, NULL, 0, c->underlying_host, sizeof(c->underlying_host), &port, NULL, 0, uri);
+    c->underlying_port = port;
 
     p = strchr(uri, '?');
 
@@ -108,3 +110,103 @@ int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AV
                                 &parent->interrupt_callback, options,
                                 parent->protocol_whitelist, parent->protocol_blacklist);
 }
+
+#define SESSION_CACHE_SIZE 32
+
+typedef struct TLSSessionEntry {
+    char *key;
+    uint8_t *data;
+    int size;
+    unsigned last_use;
+} TLSSessionEntry;
+
+static TLSSessionEntry session_cache[SESSION_CACHE_SIZE];
+static unsigned session_cache_clock;
+static AVMutex session_cache_mutex;
+static AVOnce session_cache_once = AV_ONCE_INIT;
+
+static void session_cache_init(void)
+{
+    ff_mutex_init(&session_cache_mutex, NULL);
+}
+
+/* a session may only be resumed with the settings it was verified with */
+static char *session_key(TLSShared *c)
+{
+    return av_asprintf("%s:%d:%d:%s:%s", c->underlying_host, c->underlying_port,
+                       c->verify, c->host ? c->host : "",
+                       c->ca_file ? c->ca_file : "");
+}
+
+static TLSSessionEntry *session_cache_find(const char *key)
+{
+    int i;
+
+    for (i = 0; i < SESSION_CACHE_SIZE; i++)
+        if (session_cache[i].key && !strcmp(session_cache[i].key, key))
+            return &session_cache[i];
+    return NULL;
+}
+
+int ff_tls_session_load(TLSShared *c, uint8_t **data, int *size)
+{
+    TLSSessionEntry *e;
+    char *key;
+    int ret = AVERROR(ENOENT);
+
+    if (!c->reuse_session || c->listen)
+        return AVERROR(ENOENT);
+    if (!(key = session_key(c)))
+        return AVERROR(ENOMEM);
+
+    ff_thread_once(&session_cache_once, session_cache_init);
+    ff_mutex_lock(&session_cache_mutex);
+    if ((e = session_cache_find(key))) {
+        *data = av_memdup(e->data, e->size);
+        *size = e->size;
+        e->last_use = ++session_cache_clock;
+        ret = *data ? 0 : AVERROR(ENOMEM);
+    }
+    ff_mutex_unlock(&session_cache_mutex);
+
+    av_free(key);
+    return ret;
+}
+
+void ff_tls_session_store(TLSShared *c, const uint8_t *data, int size)
+{
+    TLSSessionEntry *e;
+    uint8_t *copy;
+    char *key;
+    int i;
+
+    if (!c->reuse_session || c->listen || size <= 0)
+        return;
+    key  = session_key(c);
+    copy = av_memdup(data, size);
+    if (!key || !copy) {
+        av_free(key);
+        av_free(copy);
+        return;
+    }
+
+    ff_thread_once(&session_cache_once, session_cache_init);
+    ff_mutex_lock(&session_cache_mutex);
+    if (!(e = session_cache_find(key))) {
+        /* replace the least recently used entry */
+        e = &session_cache[0];
+        for (i = 1; i < SESSION_CACHE_SIZE && e->key; i++)
+            if (!session_cache[i].key || session_cache[i].last_use < e->last_use)
+                e = &session_cache[i];
+        av_freep(&e->key);
+        e->key = key;
+        key    = NULL;
+    }
+    av_free(e->data);
+    e->data     = copy;
+    e->size     = size;
+    e->last_use = ++session_cache_clock;
+    ff_mutex_unlock(&session_cache_mutex);
+
+    av_free(key);
+}
@@ -34,10 +34,12 @@ typedef struct TLSShared {
     char *cert_file;
     char *key_file;
     int listen;
+    int reuse_session;
 
     char *host;
 
     char underlying_host[200];
+    int underlying_port;
     int numerichost;
 
     URLContext *tcp;
@@ -51,10 +53,26 @@ typedef struct TLSShared {
     {"cert_file",  "Certificate file",                    offsetof(pstruct, options_field . cert_file), AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
     {"key_file",   "Private key file",                    offsetof(pstruct, options_field . key_file),  AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
     {"listen",     "Listen for incoming connections",     offsetof(pstruct, options_field . listen),    AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, .flags = TLS_OPTFL }, \
-    {"verifyhost", "Verify against a specific hostname",  offsetof(pstruct, options_field . host),      AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }
+    {"verifyhost", "Verify against a specific hostname",  offsetof(pstruct, options_field . host),      AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
+    {"reuse_session", "Resume the sessions of earlier connections to the same host", offsetof(pstruct, options_field . reuse_session), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, .flags = TLS_OPTFL }
 
 int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AVDictionary **options);
 
+/**
+ * Look up the serialized session of an earlier connection with the same
+ * host, port and verification settings, when reuse_session is set.
+ *
+ * @param data set to a copy of the session, to be freed with av_free()
+ * @return 0 if a session was found, a negative value otherwise
+ */
+int ff_tls_session_load(TLSShared *c, uint8_t **data, int *size);
+
+/**
+ * Store the serialized session of a connection, replacing any earlier one
+ * for the same host, when reuse_session is set.
+ */
+void ff_tls_session_store(TLSShared *c, const uint8_t *data, int size);
+
 void ff_gnutls_init(void);
 void ff_gnutls_deinit(void);
 
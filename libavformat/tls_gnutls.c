@@ -49,6 +49,19 @@ typedef struct TLSContext {
     int need_shutdown;
 } TLSContext;
 
+/* keep the session of a completed handshake for later connections */
+static void store_session(TLSContext *c)
+{
+    gnutls_datum_t data;
+
+    if (!c->tls_shared.reuse_session)
+        return;
+    if (!gnutls_session_get_data2(c->session, &data)) {
+        ff_tls_session_store(&c->tls_shared, data.data, data.size);
+        gnutls_free(data.data);
+    }
+}
+
 void ff_gnutls_init(void)
 {
     avpriv_lock_avformat();
@@ -86,8 +99,10 @@ static int print_tls_error(URLContext *h, int ret)
 static int tls_close(URLContext *h)
 {
     TLSContext *c = h->priv_data;
-    if (c->need_shutdown)
+    if (c->need_shutdown) {
+        store_session(c);
         gnutls_bye(c->session, GNUTLS_SHUT_WR);
+    }
     if (c->session)
         gnutls_deinit(c->session);
     if (c->cred)
@@ -128,6 +143,8 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
 {
     TLSContext *p = h->priv_data;
     TLSShared *c = &p->tls_shared;
+    uint8_t *session_data;
+    int session_size;
     int ret;
 
     ff_gnutls_init();
@@ -168,12 +185,18 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     gnutls_transport_set_push_function(p->session, gnutls_url_push);
     gnutls_transport_set_ptr(p->session, c->tcp);
     gnutls_priority_set_direct(p->session, "NORMAL", NULL);
+    if (!ff_tls_session_load(c, &session_data, &session_size)) {
+        gnutls_session_set_data(p->session, session_data, session_size);
+        av_free(session_data);
+    }
     ret = gnutls_handshake(p->session);
     if (ret) {
         ret = print_tls_error(h, ret);
         goto fail;
     }
     p->need_shutdown = 1;
+    if (gnutls_session_is_resumed(p->session))
+        av_log(h, AV_LOG_VERBOSE, "Resumed TLS session\n");
     if (c->verify) {
         unsigned int status, cert_list_size;
         gnutls_x509_crt_t cert;
@@ -43,6 +43,7 @@ typedef struct TLSContext {
     TLSShared tls_shared;
     SSL_CTX *ctx;
     SSL *ssl;
+    int connected;
 } TLSContext;
 
 #if HAVE_THREADS
@@ -117,9 +118,30 @@ static int print_tls_error(URLContext *h, int ret)
     return AVERROR(EIO);
 }
 
+/* keep the session of a completed handshake for later connections */
+static void store_session(TLSContext *c)
+{
+    SSL_SESSION *session;
+    uint8_t *data, *p;
+    int size;
+
+    if (!c->tls_shared.reuse_session || !(session = SSL_get1_session(c->ssl)))
+        return;
+    size = i2d_SSL_SESSION(session, NULL);
+    if (size > 0 && (data = av_malloc(size))) {
+        p = data;
+        i2d_SSL_SESSION(session, &p);
+        ff_tls_session_store(&c->tls_shared, data, size);
+        av_free(data);
+    }
+    SSL_SESSION_free(session);
+}
+
 static int tls_close(URLContext *h)
 {
     TLSContext *c = h->priv_data;
+    if (c->connected)
+        store_session(c);
     if (c->ssl) {
         SSL_shutdown(c->ssl);
         SSL_free(c->ssl);
@@ -200,6 +222,8 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     TLSContext *p = h->priv_data;
     TLSShared *c = &p->tls_shared;
     BIO *bio;
+    uint8_t *session_data;
+    int session_size;
     int ret;
 
     if ((ret = ff_openssl_init()) < 0)
@@ -245,6 +269,15 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     SSL_set_bio(p->ssl, bio, bio);
     if (!c->listen && !c->numerichost)
         SSL_set_tlsext_host_name(p->ssl, c->host);
+    if (!ff_tls_session_load(c, &session_data, &session_size)) {
+        const unsigned char *ptr = session_data;
+        SSL_SESSION *session = d2i_SSL_SESSION(NULL, &ptr, session_size);
+        if (session) {
+            SSL_set_session(p->ssl, session);
+            SSL_SESSION_free(session);
+        }
+        av_free(session_data);
+    }
     ret = c->listen ? SSL_accept(p->ssl) : SSL_connect(p->ssl);
     if (ret == 0) {
         av_log(h, AV_LOG_ERROR, "Unable to negotiate TLS/SSL session\n");
@@ -254,6 +287,9 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
         ret = print_tls_error(h, ret);
         goto fail;
     }
+    p->connected = 1;
+    if (SSL_session_reused(p->ssl))
+        av_log(h, AV_LOG_VERBOSE, "Resumed TLS session\n");
 
     return 0;
 fail:
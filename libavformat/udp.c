@@ -24,6 +24,7 @@
  * UDP protocol
  */
 
+#define _GNU_SOURCE     /* Needed for recvmmsg(), sendmmsg() and sched_setaffinity() */
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
 
@@ -59,6 +60,14 @@
 #include <pthread.h>
 #endif
 
+#if HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#endif
+
+#if HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
 #ifndef HAVE_PTHREAD_CANCEL
 #define HAVE_PTHREAD_CANCEL 0
 #endif
@@ -71,6 +80,8 @@
 #define UDP_TX_BUF_SIZE 32768
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_MAX_BATCH 64
+#define TS_PCR_WRAP ((1LL << 33) * 300)
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -88,7 +99,8 @@ typedef struct UDPContext {
     int dest_addr_len;
     int is_connected;
 
-    /* Circular Buffer variables for use in UDP receive code */
+    /* Circular Buffer variables for use in UDP receive code, and in the
+     * paced send code, where the thread sends from the buffer */
     int circular_buffer_size;
     AVFifoBuffer *fifo;
     int circular_buffer_error;
@@ -97,14 +109,34 @@ typedef struct UDPContext {
     pthread_mutex_t mutex;
     pthread_cond_t cond;
     int thread_started;
+    int close_req;
 #endif
     uint8_t tmp[UDP_MAX_PKT_SIZE+4];
+    int recv_batch;
+    int thread_cpu;
+#if HAVE_RECVMMSG
+    /* recv_batch buffers of UDP_MAX_PKT_SIZE+4 bytes, laid out like tmp */
+    uint8_t *recv_buf;
+    struct mmsghdr *recv_msgs;
+    struct iovec *recv_iov;
+#endif
+    int send_batch;
+#if HAVE_SENDMMSG
+    /* datagrams written but not sent yet, of at most pkt_size bytes */
+    uint8_t *send_buf;
+    struct mmsghdr *send_msgs;
+    struct iovec *send_iov;
+    int nb_send_pending;
+#endif
     int remaining_in_dg;
     char *localaddr;
     int timeout;
     struct sockaddr_storage local_addr_storage;
     char *sources;
     char *block;
+    int64_t bitrate;
+    int64_t burst_bits;
+    int pcr_pacing;
 } UDPContext;
 
 #define OFFSET(x) offsetof(UDPContext, x)
@@ -122,11 +154,17 @@ static const AVOption options[] = {
     { "broadcast", "explicitly allow or disallow broadcast destination",   OFFSET(is_broadcast),   AV_OPT_TYPE_BOOL,   { .i64 = 0  },     0, 1,       E },
     { "ttl",            "Time to live (multicast only)",                   OFFSET(ttl),            AV_OPT_TYPE_INT,    { .i64 = 16 },     0, INT_MAX, E },
     { "connect",        "set if connect() should be called on socket",     OFFSET(is_connected),   AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = D|E },
-    { "fifo_size",      "set the UDP receiving circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D },
+    { "fifo_size",      "set the UDP receiving circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D|E },
     { "overrun_nonfatal", "survive in case of UDP receiving circular buffer overrun", OFFSET(overrun_nonfatal), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,    D },
     { "timeout",        "set raise error timeout (only in read mode)",     OFFSET(timeout),        AV_OPT_TYPE_INT,    { .i64 = 0 },      0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "recv_batch",     "maximum number of datagrams read by the receiving thread per system call", OFFSET(recv_batch), AV_OPT_TYPE_INT, { .i64 = 16 }, 1, UDP_MAX_BATCH, D },
+    { "send_batch",     "number of datagrams sent together, per system call", OFFSET(send_batch), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, UDP_MAX_BATCH, E },
+    { "thread_cpu",     "pin the receiving thread to this CPU",            OFFSET(thread_cpu),     AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, D },
+    { "bitrate",        "send the data at this rate, in bits per second",  OFFSET(bitrate),        AV_OPT_TYPE_INT64,  { .i64 = 0 },      0, INT64_MAX, E },
+    { "burst_bits",     "number of bits that may be sent ahead of the rate", OFFSET(burst_bits),   AV_OPT_TYPE_INT64,  { .i64 = 0 },      0, INT64_MAX, E },
+    { "pcr_pacing",     "send MPEG-TS data at the pace of its PCRs",       OFFSET(pcr_pacing),     AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       E },
     { NULL }
 };
 
@@ -493,6 +531,17 @@ static void *circular_buffer_task( void *_URLContext)
     int old_cancelstate;
 
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
+#if HAVE_SCHED_SETAFFINITY
+    if (s->thread_cpu >= 0) {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+        CPU_SET(s->thread_cpu, &cpus);
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0)
+            av_log(h, AV_LOG_WARNING, "Failed to pin the receiving thread to CPU %d\n",
+                   s->thread_cpu);
+    }
+#endif
     pthread_mutex_lock(&s->mutex);
     if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
         av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
@@ -500,13 +549,19 @@ static void *circular_buffer_task( void *_URLContext)
         goto end;
     }
     while(1) {
-        int len;
+        int len, i, nb_pkts = 1;
 
         pthread_mutex_unlock(&s->mutex);
         /* Blocking operations are always cancellation points;
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
+#if HAVE_RECVMMSG
+        if (s->recv_msgs)
+            len = nb_pkts = recvmmsg(s->udp_fd, s->recv_msgs, s->recv_batch,
+                                     MSG_WAITFORONE, NULL);
+        else
+#endif
         len = recv(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
@@ -517,23 +572,35 @@ static void *circular_buffer_task( void *_URLContext)
             }
             continue;
         }
-        AV_WL32(s->tmp, len);
 
-        if(av_fifo_space(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
-                continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
+        /* the whole batch is queued with the lock taken once */
+        for (i = 0; i < nb_pkts; i++) {
+            uint8_t *pkt = s->tmp;
+
+#if HAVE_RECVMMSG
+            if (s->recv_msgs) {
+                pkt = s->recv_buf + i * (UDP_MAX_PKT_SIZE + 4);
+                len = s->recv_msgs[i].msg_len;
+            }
+#endif
+            AV_WL32(pkt, len);
+
+            if(av_fifo_space(s->fifo) < len + 4) {
+                /* No Space left */
+                if (s->overrun_nonfatal) {
+                    av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                            "Surviving due to overrun_nonfatal option\n");
+                    continue;
+                } else {
+                    av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                            "To avoid, increase fifo_size URL option. "
+                            "To survive in such case, use overrun_nonfatal option\n");
+                    s->circular_buffer_error = AVERROR(EIO);
+                    goto end;
+                }
             }
+            av_fifo_generic_write(s->fifo, pkt, len+4, NULL);
         }
-        av_fifo_generic_write(s->fifo, s->tmp, len+4, NULL);
         pthread_cond_signal(&s->cond);
     }
 
@@ -544,6 +611,215 @@ end:
 }
 #endif
 
+static int udp_send_dgram(UDPContext *s, const uint8_t *buf, int size)
+{
+    int ret;
+
+    if (!s->is_connected) {
+        ret = sendto (s->udp_fd, buf, size, 0,
+                      (struct sockaddr *) &s->dest_addr,
+                      s->dest_addr_len);
+    } else
+        ret = send(s->udp_fd, buf, size, 0);
+
+    return ret < 0 ? ff_neterrno() : ret;
+}
+
+#if HAVE_PTHREAD_CANCEL
+/* return the PCR of the first TS packet of buf carrying one, or -1 */
+static int64_t udp_find_pcr(const uint8_t *buf, int size)
+{
+    for (; size >= 188; buf += 188, size -= 188) {
+        if (buf[0] != 0x47)
+            break;
+        if ((buf[3] & 0x20) && buf[4] >= 7 && (buf[5] & 0x10))
+            return ((int64_t)AV_RB32(buf + 6) << 1 | buf[10] >> 7) * 300 +
+                   ((buf[10] & 1) << 8 | buf[11]);
+    }
+    return -1;
+}
+
+/*
+ * Paced sender: the datagrams queued by udp_write() are sent so that the
+ * output never exceeds the rate by more than burst_bits.  The rate is the
+ * bitrate option or, with pcr_pacing, the one measured between the last two
+ * PCRs.  With pcr_pacing, a datagram carrying a PCR is also held until the
+ * wall clock reaches that PCR, so the rate errors do not accumulate.
+ */
+static void *udp_tx_task(void *_URLContext)
+{
+    URLContext *h = _URLContext;
+    UDPContext *s = h->priv_data;
+    int64_t rate = s->bitrate;
+    int64_t tx_start = 0, tx_bits = 0;  /* rate shaper: bits sent since tx_start */
+    int64_t pcr_last = -1, pcr_clock = 0, pcr_wall = 0, pcr_bytes = 0;
+
+    pthread_mutex_lock(&s->mutex);
+    if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
+        av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
+        s->circular_buffer_error = AVERROR(EIO);
+        goto end;
+    }
+    while (1) {
+        uint8_t tmp[4];
+        int64_t now, due, burst, pcr;
+        int len, ret;
+
+        while (!av_fifo_size(s->fifo) && !s->close_req)
+            pthread_cond_wait(&s->cond, &s->mutex);
+        /* the queue is drained before closing */
+        if (!av_fifo_size(s->fifo))
+            goto end;
+        av_fifo_generic_read(s->fifo, tmp, 4, NULL);
+        len = AV_RL32(tmp);
+        av_fifo_generic_read(s->fifo, s->tmp, len, NULL);
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+
+        now = due = av_gettime_relative();
+        pcr = s->pcr_pacing ? udp_find_pcr(s->tmp, len) : -1;
+        if (pcr >= 0) {
+            if (pcr_last >= 0) {
+                int64_t delta = pcr - pcr_last;
+                if (delta < 0)
+                    delta += TS_PCR_WRAP;
+                if (delta > 27000000) {
+                    av_log(h, AV_LOG_VERBOSE, "PCR discontinuity\n");
+                    pcr_last = -1;
+                } else {
+                    pcr_clock += delta;
+                    if (!s->bitrate && delta)
+                        rate = av_rescale(pcr_bytes * 8, 27000000, delta);
+                }
+            }
+            if (pcr_last < 0) {
+                pcr_wall  = now;
+                pcr_clock = 0;
+            }
+            due = pcr_wall + pcr_clock / 27;
+            if (FFABS(due - now) > 1000000) {
+                av_log(h, AV_LOG_VERBOSE, "Wall clock and PCR drifted apart, resyncing\n");
+                pcr_wall = now - pcr_clock / 27;
+                due      = now;
+            }
+            pcr_last  = pcr;
+            pcr_bytes = 0;
+            tx_start  = due;
+            tx_bits   = 0;
+        } else if (rate) {
+            due = tx_start + av_rescale(tx_bits, 1000000, rate);
+            /* idle: the burst allowance is available again */
+            if (due < now) {
+                tx_start = due = now;
+                tx_bits  = 0;
+            }
+        }
+        burst = rate ? av_rescale(s->burst_bits, 1000000, rate) : 0;
+        if (due - burst > now)
+            av_usleep(due - burst - now);
+
+        do {
+            ret = udp_send_dgram(s, s->tmp, len);
+        } while (ret == AVERROR(EINTR));
+        tx_bits   += len * 8;
+        pcr_bytes += len;
+
+        pthread_mutex_lock(&s->mutex);
+        if (ret < 0) {
+            s->circular_buffer_error = ret;
+            goto end;
+        }
+    }
+
+end:
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+#endif
+
+static int udp_alloc_batches(URLContext *h, int is_output)
+{
+    UDPContext *s = h->priv_data;
+    int i;
+
+#if HAVE_RECVMMSG
+    /* only read by the circular buffer thread */
+    if (!is_output && HAVE_PTHREAD_CANCEL && s->circular_buffer_size &&
+        s->recv_batch > 1) {
+        s->recv_buf  = av_malloc_array(s->recv_batch, UDP_MAX_PKT_SIZE + 4);
+        s->recv_msgs = av_mallocz_array(s->recv_batch, sizeof(*s->recv_msgs));
+        s->recv_iov  = av_malloc_array(s->recv_batch, sizeof(*s->recv_iov));
+        if (!s->recv_buf || !s->recv_msgs || !s->recv_iov)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < s->recv_batch; i++) {
+            s->recv_iov[i].iov_base = s->recv_buf + i * (UDP_MAX_PKT_SIZE + 4) + 4;
+            s->recv_iov[i].iov_len  = UDP_MAX_PKT_SIZE;
+            s->recv_msgs[i].msg_hdr.msg_iov    = &s->recv_iov[i];
+            s->recv_msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+#endif
+#if HAVE_SENDMMSG
+    /* with non-blocking writes, the queued datagrams could not be
+     * reported as failed */
+    if (is_output && s->send_batch > 1 && s->pkt_size > 0 &&
+        !(h->flags & AVIO_FLAG_NONBLOCK) && !s->bitrate && !s->pcr_pacing) {
+        s->send_buf  = av_malloc_array(s->send_batch, s->pkt_size);
+        s->send_msgs = av_mallocz_array(s->send_batch, sizeof(*s->send_msgs));
+        s->send_iov  = av_malloc_array(s->send_batch, sizeof(*s->send_iov));
+        if (!s->send_buf || !s->send_msgs || !s->send_iov)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < s->send_batch; i++) {
+            s->send_iov[i].iov_base = s->send_buf + i * s->pkt_size;
+            s->send_msgs[i].msg_hdr.msg_iov    = &s->send_iov[i];
+            s->send_msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+#endif
+    return 0;
+}
+
+static void udp_free_batches(UDPContext *s)
+{
+#if HAVE_RECVMMSG
+    av_freep(&s->recv_buf);
+    av_freep(&s->recv_msgs);
+    av_freep(&s->recv_iov);
+#endif
+#if HAVE_SENDMMSG
+    av_freep(&s->send_buf);
+    av_freep(&s->send_msgs);
+    av_freep(&s->send_iov);
+#endif
+}
+
+#if HAVE_SENDMMSG
+static int udp_send_pending(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int i, ret, sent = 0;
+
+    /* the destination may have been changed by ff_udp_set_remote_url() */
+    for (i = 0; i < s->nb_send_pending; i++) {
+        s->send_msgs[i].msg_hdr.msg_name    = s->is_connected ? NULL : &s->dest_addr;
+        s->send_msgs[i].msg_hdr.msg_namelen = s->is_connected ? 0 : s->dest_addr_len;
+    }
+    while (sent < s->nb_send_pending) {
+        ret = sendmmsg(s->udp_fd, s->send_msgs + sent, s->nb_send_pending - sent, 0);
+        if (ret < 0) {
+            if (ff_neterrno() == AVERROR(EINTR))
+                continue;
+            s->nb_send_pending = 0;
+            return ff_neterrno();
+        }
+        sent += ret;
+    }
+    s->nb_send_pending = 0;
+    return 0;
+}
+#endif
+
 static int parse_source_list(char *buf, char **sources, int *num_sources,
                              int max_sources)
 {
@@ -667,6 +943,18 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             s->timeout = strtol(buf, NULL, 10);
         if (is_output && av_find_info_tag(buf, sizeof(buf), "broadcast", p))
             s->is_broadcast = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "recv_batch", p))
+            s->recv_batch = av_clip(strtol(buf, NULL, 10), 1, UDP_MAX_BATCH);
+        if (av_find_info_tag(buf, sizeof(buf), "send_batch", p))
+            s->send_batch = av_clip(strtol(buf, NULL, 10), 1, UDP_MAX_BATCH);
+        if (av_find_info_tag(buf, sizeof(buf), "thread_cpu", p))
+            s->thread_cpu = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "bitrate", p))
+            s->bitrate = strtoll(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "burst_bits", p))
+            s->burst_bits = strtoll(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "pcr_pacing", p))
+            s->pcr_pacing = strtol(buf, NULL, 10);
     }
     /* handling needed to support options picking from both AVOption and URL */
     s->circular_buffer_size *= 188;
@@ -828,8 +1116,20 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     s->udp_fd = udp_fd;
 
+    if (udp_alloc_batches(h, is_output) < 0)
+        goto fail;
+    if (!HAVE_SCHED_SETAFFINITY && s->thread_cpu >= 0)
+        av_log(h, AV_LOG_WARNING,
+               "'thread_cpu' option was set but it is not supported on this build\n");
+    if (is_output && (s->bitrate || s->pcr_pacing) &&
+        (!HAVE_PTHREAD_CANCEL || !s->circular_buffer_size))
+        av_log(h, AV_LOG_WARNING,
+               "Pacing requires pthread support and a non-zero fifo_size, "
+               "sending the data as it comes\n");
+
 #if HAVE_PTHREAD_CANCEL
-    if (!is_output && s->circular_buffer_size) {
+    if (s->circular_buffer_size &&
+        (!is_output || s->bitrate || s->pcr_pacing)) {
         int ret;
 
         /* start the task going */
@@ -844,7 +1144,8 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             av_log(h, AV_LOG_ERROR, "pthread_cond_init failed : %s\n", strerror(ret));
             goto cond_fail;
         }
-        ret = pthread_create(&s->circular_buffer_thread, NULL, circular_buffer_task, h);
+        ret = pthread_create(&s->circular_buffer_thread, NULL,
+                             is_output ? udp_tx_task : circular_buffer_task, h);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", strerror(ret));
             goto thread_fail;
@@ -864,6 +1165,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep(&s->fifo);
+    udp_free_batches(s);
     for (i = 0; i < num_include_sources; i++)
         av_freep(&include_sources[i]);
     for (i = 0; i < num_exclude_sources; i++)
@@ -881,14 +1183,17 @@ static int udplite_open(URLContext *h, const char *uri, int flags)
     return udp_open(h, uri, flags);
 }
 
-static int udp_read(URLContext *h, uint8_t *buf, int size)
+/* scatter one datagram over the nb_iov buffers of iov */
+static int udp_readv(URLContext *h, const URLIOVec *iov, int nb_iov)
 {
     UDPContext *s = h->priv_data;
-    int ret;
+    int i, ret;
 #if HAVE_PTHREAD_CANCEL
-    int avail, nonblock = h->flags & AVIO_FLAG_NONBLOCK;
+    int avail, size = 0, nonblock = h->flags & AVIO_FLAG_NONBLOCK;
 
     if (s->fifo) {
+        for (i = 0; i < nb_iov; i++)
+            size += iov[i].size;
         pthread_mutex_lock(&s->mutex);
         do {
             avail = av_fifo_size(s->fifo);
@@ -902,7 +1207,11 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
                     avail= size;
                 }
 
-                av_fifo_generic_read(s->fifo, buf, avail, NULL);
+                for (i = 0, size = avail; i < nb_iov && size > 0; i++) {
+                    int len = FFMIN(iov[i].size, size);
+                    av_fifo_generic_read(s->fifo, iov[i].buf, len, NULL);
+                    size -= len;
+                }
                 av_fifo_drain(s->fifo, AV_RL32(tmp) - avail);
                 pthread_mutex_unlock(&s->mutex);
                 return avail;
@@ -935,15 +1244,85 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
         if (ret < 0)
             return ret;
     }
-    ret = recv(s->udp_fd, buf, size, 0);
+#if HAVE_SYS_UIO_H
+    if (nb_iov > 1) {
+        struct iovec vec[URL_IOV_MAX];
+        struct msghdr msg = { 0 };
+
+        msg.msg_iov    = vec;
+        msg.msg_iovlen = ff_url_iovec(vec, iov, nb_iov, INT_MAX);
+        ret = recvmsg(s->udp_fd, &msg, 0);
+        return ret < 0 ? ff_neterrno() : ret;
+    }
+#endif
+    ret = recv(s->udp_fd, iov[0].buf, iov[0].size, 0);
 
     return ret < 0 ? ff_neterrno() : ret;
 }
 
-static int udp_write(URLContext *h, const uint8_t *buf, int size)
+static int udp_read(URLContext *h, uint8_t *buf, int size)
+{
+    URLIOVec iov = { buf, size };
+    return udp_readv(h, &iov, 1);
+}
+
+/* the nb_iov buffers of iov form one datagram */
+static int udp_writev(URLContext *h, const URLIOVec *iov, int nb_iov)
 {
     UDPContext *s = h->priv_data;
-    int ret;
+    int i, ret, size = 0;
+
+    for (i = 0; i < nb_iov; i++)
+        size += iov[i].size;
+
+#if HAVE_PTHREAD_CANCEL
+    /* paced: queue the datagram for the sending thread */
+    if (s->fifo && !(h->flags & AVIO_FLAG_READ)) {
+        uint8_t tmp[4];
+
+        if (size > FFMIN(UDP_MAX_PKT_SIZE, s->circular_buffer_size - 4))
+            return AVERROR(EINVAL);
+        pthread_mutex_lock(&s->mutex);
+        while (!s->circular_buffer_error && av_fifo_space(s->fifo) < size + 4) {
+            if (h->flags & AVIO_FLAG_NONBLOCK) {
+                pthread_mutex_unlock(&s->mutex);
+                return AVERROR(EAGAIN);
+            }
+            pthread_cond_wait(&s->cond, &s->mutex);
+        }
+        if (s->circular_buffer_error) {
+            ret = s->circular_buffer_error;
+            pthread_mutex_unlock(&s->mutex);
+            return ret;
+        }
+        AV_WL32(tmp, size);
+        av_fifo_generic_write(s->fifo, tmp, 4, NULL);
+        for (i = 0; i < nb_iov; i++)
+            av_fifo_generic_write(s->fifo, iov[i].buf, iov[i].size, NULL);
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+        return size;
+    }
+#endif
+
+#if HAVE_SENDMMSG
+    if (s->send_msgs) {
+        if (size <= s->pkt_size) {
+            int n = s->nb_send_pending++;
+            uint8_t *p = s->send_iov[n].iov_base;
+            for (i = 0; i < nb_iov; p += iov[i++].size)
+                memcpy(p, iov[i].buf, iov[i].size);
+            s->send_iov[n].iov_len = size;
+            if (s->nb_send_pending == s->send_batch &&
+                (ret = udp_send_pending(h)) < 0)
+                return ret;
+            return size;
+        }
+        /* keep the datagrams in order */
+        if ((ret = udp_send_pending(h)) < 0)
+            return ret;
+    }
+#endif
 
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 1);
@@ -951,35 +1330,69 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
             return ret;
     }
 
-    if (!s->is_connected) {
-        ret = sendto (s->udp_fd, buf, size, 0,
-                      (struct sockaddr *) &s->dest_addr,
-                      s->dest_addr_len);
-    } else
-        ret = send(s->udp_fd, buf, size, 0);
+#if HAVE_SYS_UIO_H
+    if (nb_iov > 1) {
+        struct iovec vec[URL_IOV_MAX];
+        struct msghdr msg = { 0 };
 
-    return ret < 0 ? ff_neterrno() : ret;
+        if (!s->is_connected) {
+            msg.msg_name    = &s->dest_addr;
+            msg.msg_namelen = s->dest_addr_len;
+        }
+        msg.msg_iov    = vec;
+        msg.msg_iovlen = ff_url_iovec(vec, iov, nb_iov, INT_MAX);
+        ret = sendmsg(s->udp_fd, &msg, 0);
+        return ret < 0 ? ff_neterrno() : ret;
+    }
+#endif
+    return udp_send_dgram(s, iov[0].buf, iov[0].size);
+}
+
+static int udp_write(URLContext *h, const uint8_t *buf, int size)
+{
+    URLIOVec iov = { (uint8_t *)buf, size };
+    return udp_writev(h, &iov, 1);
 }
 
 static int udp_close(URLContext *h)
 {
     UDPContext *s = h->priv_data;
+#if HAVE_PTHREAD_CANCEL
+    int ret;
 
+    if (s->thread_started && !(h->flags & AVIO_FLAG_READ)) {
+        /* let the sending thread send what is queued */
+        pthread_mutex_lock(&s->mutex);
+        s->close_req = 1;
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+        ret = pthread_join(s->circular_buffer_thread, NULL);
+        if (ret != 0)
+            av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", strerror(ret));
+    }
+#endif
+
+#if HAVE_SENDMMSG
+    if (s->nb_send_pending)
+        udp_send_pending(h);
+#endif
     if (s->is_multicast && (h->flags & AVIO_FLAG_READ))
         udp_leave_multicast_group(s->udp_fd, (struct sockaddr *)&s->dest_addr,(struct sockaddr *)&s->local_addr_storage);
     closesocket(s->udp_fd);
 #if HAVE_PTHREAD_CANCEL
     if (s->thread_started) {
-        int ret;
-        pthread_cancel(s->circular_buffer_thread);
-        ret = pthread_join(s->circular_buffer_thread, NULL);
-        if (ret != 0)
-            av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", strerror(ret));
+        if (h->flags & AVIO_FLAG_READ) {
+            pthread_cancel(s->circular_buffer_thread);
+            ret = pthread_join(s->circular_buffer_thread, NULL);
+            if (ret != 0)
+                av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", strerror(ret));
+        }
         pthread_mutex_destroy(&s->mutex);
         pthread_cond_destroy(&s->cond);
     }
 #endif
     av_fifo_freep(&s->fifo);
+    udp_free_batches(s);
     return 0;
 }
 
@@ -988,6 +1401,10 @@ const URLProtocol ff_udp_protocol = {
     .url_open            = udp_open,
     .url_read            = udp_read,
     .url_write           = udp_write,
+#if HAVE_SYS_UIO_H
+    .url_readv           = udp_readv,
+    .url_writev          = udp_writev,
+#endif
     .url_close           = udp_close,
     .url_get_file_handle = udp_get_file_handle,
     .priv_data_size      = sizeof(UDPContext),
@@ -1000,6 +1417,10 @@ const URLProtocol ff_udplite_protocol = {
     .url_open            = udplite_open,
     .url_read            = udp_read,
     .url_write           = udp_write,
+#if HAVE_SYS_UIO_H
+    .url_readv           = udp_readv,
+    .url_writev          = udp_writev,
+#endif
     .url_close           = udp_close,
     .url_get_file_handle = udp_get_file_handle,
     .priv_data_size      = sizeof(UDPContext),
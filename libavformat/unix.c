@@ -30,6 +30,9 @@
 #include "os_support.h"
 #include "network.h"
 #include <sys/un.h>
+#if HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 #include "url.h"
 
 typedef struct UnixContext {
@@ -125,6 +128,44 @@ static int unix_write(URLContext *h, const uint8_t *buf, int size)
     return ret < 0 ? ff_neterrno() : ret;
 }
 
+#if HAVE_SYS_UIO_H
+static int unix_readv(URLContext *h, const URLIOVec *iov, int nb_iov)
+{
+    UnixContext *s = h->priv_data;
+    struct iovec vec[URL_IOV_MAX];
+    struct msghdr msg = { 0 };
+    int ret;
+
+    if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+        ret = ff_network_wait_fd(s->fd, 0);
+        if (ret < 0)
+            return ret;
+    }
+    msg.msg_iov    = vec;
+    msg.msg_iovlen = ff_url_iovec(vec, iov, nb_iov, INT_MAX);
+    ret = recvmsg(s->fd, &msg, 0);
+    return ret < 0 ? ff_neterrno() : ret;
+}
+
+static int unix_writev(URLContext *h, const URLIOVec *iov, int nb_iov)
+{
+    UnixContext *s = h->priv_data;
+    struct iovec vec[URL_IOV_MAX];
+    struct msghdr msg = { 0 };
+    int ret;
+
+    if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+        ret = ff_network_wait_fd(s->fd, 1);
+        if (ret < 0)
+            return ret;
+    }
+    msg.msg_iov    = vec;
+    msg.msg_iovlen = ff_url_iovec(vec, iov, nb_iov, INT_MAX);
+    ret = sendmsg(s->fd, &msg, MSG_NOSIGNAL);
+    return ret < 0 ? ff_neterrno() : ret;
+}
+#endif
+
 static int unix_close(URLContext *h)
 {
     UnixContext *s = h->priv_data;
@@ -145,6 +186,10 @@ const URLProtocol ff_unix_protocol = {
     .url_open            = unix_open,
     .url_read            = unix_read,
     .url_write           = unix_write,
+#if HAVE_SYS_UIO_H
+    .url_readv           = unix_readv,
+    .url_writev          = unix_writev,
+#endif
     .url_close           = unix_close,
     .url_get_file_handle = unix_get_file_handle,
     .priv_data_size      = sizeof(UnixContext),
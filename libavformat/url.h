@@ -33,8 +33,21 @@
 #define URL_PROTOCOL_FLAG_NESTED_SCHEME 1 /*< The protocol name can be the first part of a nested protocol scheme */
 #define URL_PROTOCOL_FLAG_NETWORK       2 /*< The protocol uses network */
 
+/**
+ * Maximum number of buffers passed to url_readv() and url_writev().
+ */
+#define URL_IOV_MAX 16
+
 extern const AVClass ffurl_context_class;
 
+/**
+ * One buffer of a scatter/gather transfer.
+ */
+typedef struct URLIOVec {
+    uint8_t *buf;
+    int size;
+} URLIOVec;
+
 typedef struct URLContext {
     const AVClass *av_class;    /**< information for av_log(). Set by url_open(). */
     const struct URLProtocol *prot;
@@ -95,6 +108,18 @@ typedef struct URLProtocol {
     int (*url_delete)(URLContext *h);
     int (*url_move)(URLContext *h_src, URLContext *h_dst);
     const char *default_whitelist;
+
+    /**
+     * Vectored variants of url_read and url_write, filling or sending the
+     * nb_iov (at most URL_IOV_MAX) buffers in order with a single system
+     * call where possible. They return the total number of bytes
+     * transferred, and follow the rules of url_read and url_write
+     * otherwise, short transfers included. For packetized protocols the
+     * buffers of one url_writev call form one packet.
+     * Both are optional, see ffurl_readv() and ffurl_writev().
+     */
+    int (*url_readv)(URLContext *h, const URLIOVec *iov, int nb_iov);
+    int (*url_writev)(URLContext *h, const URLIOVec *iov, int nb_iov);
 } URLProtocol;
 
 /**
@@ -197,6 +222,38 @@ int ffurl_read_complete(URLContext *h, unsigned char *buf, int size);
  */
 int ffurl_write(URLContext *h, const unsigned char *buf, int size);
 
+/**
+ * Read into the nb_iov buffers of iov in order, like ffurl_read() would
+ * into one buffer: up to their total size, at least one byte unless an
+ * error occurs or the end of the resource is reached.
+ * Protocols without url_readv() fill the first non-empty buffer only.
+ *
+ * @param nb_iov number of buffers, at most URL_IOV_MAX
+ * @return the number of bytes read, or a negative AVERROR code
+ */
+int ffurl_readv(URLContext *h, const URLIOVec *iov, int nb_iov);
+
+/**
+ * Write the nb_iov buffers of iov in order, like ffurl_write() would
+ * write their concatenation. This avoids copying small headers and large
+ * payloads together before writing them.
+ *
+ * @param nb_iov number of buffers, at most URL_IOV_MAX
+ * @return the total number of bytes written, or a negative AVERROR code
+ */
+int ffurl_writev(URLContext *h, const URLIOVec *iov, int nb_iov);
+
+struct iovec;
+
+/**
+ * Convert iov to the struct iovec array of readv() and writev(), keeping
+ * at most max_size bytes in total. Only available if HAVE_SYS_UIO_H.
+ *
+ * @return the number of entries set in vec
+ */
+int ff_url_iovec(struct iovec *vec, const URLIOVec *iov, int nb_iov,
+                 int max_size);
+
 /**
  * Change the position that will be used by the next read/write
  * operation on the resource accessed by h.
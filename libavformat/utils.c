@@ -43,6 +43,7 @@
 #include "audiointerleave.h"
 #include "avformat.h"
 #include "avio_internal.h"
+#include "http.h"
 #include "id3v2.h"
 #include "internal.h"
 #include "metadata.h"
@@ -1349,6 +1350,21 @@ static int parse_packet(AVFormatContext *s, AVPacket *pkt, int stream_index)
 
         compute_pkt_fields(s, st, st->parser, &out_pkt, next_dts, next_pts);
 
+        /* Parsers return the input itself when it holds exactly one frame;
+         * reference it instead of copying it. Any other slice of the input
+         * is followed by the next frame rather than by zeroed padding, and
+         * the data in the parser's own buffer is only valid until the next
+         * call, so add_to_pktbuf() copies those. */
+        if (pkt->buf && out_pkt.data == pkt->data &&
+            out_pkt.data + out_pkt.size == pkt->data + pkt->size) {
+            out_pkt.buf = av_buffer_ref(pkt->buf);
+            if (!out_pkt.buf) {
+                av_packet_unref(&out_pkt);
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+        }
+
         ret = add_to_pktbuf(&s->internal->parse_queue, &out_pkt,
                             &s->internal->parse_queue_end, 1);
         av_packet_unref(&out_pkt);
@@ -2706,9 +2722,13 @@ static void estimate_timings(AVFormatContext *ic, int64_t old_offset)
     }
 }
 
-static int has_codec_parameters(AVStream *st, const char **errmsg_ptr)
+static int has_codec_parameters(AVFormatContext *ic, AVStream *st,
+                                const char **errmsg_ptr)
 {
     AVCodecContext *avctx = st->codec;
+    /* the formats are only known after decoding, which fast probing avoids */
+    int need_formats = st->info->found_decoder >= 0 &&
+                       !(ic->flags & AVFMT_FLAG_FAST_PROBE);
 
 #define FAIL(errmsg) do {                                         \
         if (errmsg_ptr)                                           \
@@ -2723,8 +2743,7 @@ static int has_codec_parameters(AVStream *st, const char **errmsg_ptr)
     case AVMEDIA_TYPE_AUDIO:
         if (!avctx->frame_size && determinable_frame_size(avctx))
             FAIL("unspecified frame size");
-        if (st->info->found_decoder >= 0 &&
-            avctx->sample_fmt == AV_SAMPLE_FMT_NONE)
+        if (need_formats && avctx->sample_fmt == AV_SAMPLE_FMT_NONE)
             FAIL("unspecified sample format");
         if (!avctx->sample_rate)
             FAIL("unspecified sample rate");
@@ -2736,7 +2755,7 @@ static int has_codec_parameters(AVStream *st, const char **errmsg_ptr)
     case AVMEDIA_TYPE_VIDEO:
         if (!avctx->width)
             FAIL("unspecified size");
-        if (st->info->found_decoder >= 0 && avctx->pix_fmt == AV_PIX_FMT_NONE)
+        if (need_formats && avctx->pix_fmt == AV_PIX_FMT_NONE)
             FAIL("unspecified pixel format");
         if (st->codec->codec_id == AV_CODEC_ID_RV30 || st->codec->codec_id == AV_CODEC_ID_RV40)
             if (!st->sample_aspect_ratio.num && !st->codec->sample_aspect_ratio.num && !st->codec_info_nb_frames)
@@ -2753,6 +2772,37 @@ static int has_codec_parameters(AVStream *st, const char **errmsg_ptr)
     return 1;
 }
 
+/* Fill in the parameters found by the parser but not exported to the codec
+ * context by it, so that the stream may not need to be decoded. */
+static void update_stream_from_parser(AVStream *st)
+{
+    AVCodecParserContext *pc = st->parser;
+    AVCodecContext *avctx    = st->codec;
+
+    if (!pc)
+        return;
+
+    switch (avctx->codec_type) {
+    case AVMEDIA_TYPE_VIDEO:
+        if (!avctx->width && pc->width > 0 && pc->height > 0) {
+            avctx->width  = pc->width;
+            avctx->height = pc->height;
+            if (pc->coded_width > 0 && pc->coded_height > 0) {
+                avctx->coded_width  = pc->coded_width;
+                avctx->coded_height = pc->coded_height;
+            }
+        }
+        if (avctx->pix_fmt == AV_PIX_FMT_NONE && pc->format >= 0)
+            avctx->pix_fmt = pc->format;
+        break;
+    case AVMEDIA_TYPE_AUDIO:
+        if (!avctx->frame_size && determinable_frame_size(avctx) &&
+            pc->duration > 0)
+            avctx->frame_size = pc->duration;
+        break;
+    }
+}
+
 /* returns 1 or 0 if or if not decoded data was returned, or a negative error */
 static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
                             AVDictionary **options)
@@ -2810,7 +2860,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
 
     while ((pkt.size > 0 || (!pkt.data && got_picture)) &&
            ret >= 0 &&
-           (!has_codec_parameters(st, NULL) || !has_decode_delay_been_guessed(st) ||
+           (!has_codec_parameters(s, st, NULL) || !has_decode_delay_been_guessed(st) ||
             (!st->codec_info_nb_frames &&
              (st->codec->codec->capabilities & AV_CODEC_CAP_CHANNEL_CONF)))) {
         got_picture = 0;
@@ -3195,6 +3245,7 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t max_subtitle_analyze_duration;
     int64_t probesize = ic->probesize;
     int eof_reached = 0;
+    int fast_probe = ic->flags & AVFMT_FLAG_FAST_PROBE;
 
     flush_codecs = probesize > 0;
 
@@ -3261,7 +3312,8 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         }
 
         // Try to just open decoders, in case this is enough to get parameters.
-        if (!has_codec_parameters(st, NULL) && st->request_probe <= 0) {
+        // When fast probing, this is also what sets most sample formats.
+        if ((!has_codec_parameters(ic, st, NULL) || fast_probe) && st->request_probe <= 0) {
             if (codec && !st->codec->codec)
                 if (avcodec_open2(st->codec, codec, options ? &options[i] : &thread_opt) < 0)
                     av_log(ic, AV_LOG_WARNING,
@@ -3294,14 +3346,17 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
             int fps_analyze_framecount = 20;
 
             st = ic->streams[i];
-            if (!has_codec_parameters(st, NULL))
+            /* only the streams the caller reads are needed when fast probing */
+            if (fast_probe && st->discard >= AVDISCARD_ALL)
+                continue;
+            if (!has_codec_parameters(ic, st, NULL))
                 break;
             /* If the timebase is coarse (like the usual millisecond precision
              * of mkv), we need to analyze more frames to reliably arrive at
              * the correct fps. */
             if (av_q2d(st->time_base) > 0.0005)
                 fps_analyze_framecount *= 2;
-            if (!tb_unreliable(st->codec))
+            if (!tb_unreliable(st->codec) || fast_probe)
                 fps_analyze_framecount = 0;
             if (ic->fps_probe_size >= 0)
                 fps_analyze_framecount = ic->fps_probe_size;
@@ -3330,8 +3385,9 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         if (i == ic->nb_streams) {
             analyzed_all_streams = 1;
             /* NOTE: If the format has no header, then we need to read some
-             * packets to get most of the streams, so we cannot stop here. */
-            if (!(ic->ctx_flags & AVFMTCTX_NOHEADER)) {
+             * packets to get most of the streams, so we cannot stop here,
+             * unless fast probing, which accepts the streams found so far. */
+            if (!(ic->ctx_flags & AVFMTCTX_NOHEADER) || (fast_probe && count)) {
                 /* If we found the info for all the codecs, we can stop. */
                 ret = count;
                 av_log(ic, AV_LOG_DEBUG, "All info found\n");
@@ -3476,9 +3532,15 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
          * If AV_CODEC_CAP_CHANNEL_CONF is set this will force decoding of at
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
-         * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+         * the container.
+         *
+         * When fast probing, we only decode if the parser could not provide
+         * the parameters. */
+        if (fast_probe)
+            update_stream_from_parser(st);
+        if (!fast_probe || !has_codec_parameters(ic, st, NULL))
+            try_decode_frame(ic, st, pkt,
+                             (options && i < orig_nb_streams) ? &options[i] : NULL);
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(pkt);
@@ -3513,7 +3575,7 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
                     err = try_decode_frame(ic, st, &empty_pkt,
                                             (options && i < orig_nb_streams)
                                             ? &options[i] : NULL);
-                } while (err > 0 && !has_codec_parameters(st, NULL));
+                } while (err > 0 && !has_codec_parameters(ic, st, NULL));
 
                 if (err < 0) {
                     av_log(ic, AV_LOG_INFO,
@@ -3623,7 +3685,7 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     for (i = 0; i < ic->nb_streams; i++) {
         const char *errmsg;
         st = ic->streams[i];
-        if (!has_codec_parameters(st, &errmsg)) {
+        if (!has_codec_parameters(ic, st, &errmsg)) {
             char buf[256];
             avcodec_string(buf, sizeof(buf), st->codec, 0);
             av_log(ic, AV_LOG_WARNING,
@@ -3828,6 +3890,11 @@ void avformat_free_context(AVFormatContext *s)
     av_freep(&s->chapters);
     av_dict_free(&s->metadata);
     av_freep(&s->streams);
+    while (s->internal->packet_pool) {
+        AVPacketList *pktl = s->internal->packet_pool;
+        s->internal->packet_pool = pktl->next;
+        av_free(pktl);
+    }
     av_freep(&s->internal);
     flush_packet_queue(s);
     av_free(s);
@@ -4326,6 +4393,9 @@ int avformat_network_init(void)
 int avformat_network_deinit(void)
 {
 #if CONFIG_NETWORK
+#if CONFIG_HTTP_PROTOCOL
+    ff_http_pool_flush();
+#endif
     ff_network_close();
     ff_tls_deinit();
     ff_network_inited_globally = 0;
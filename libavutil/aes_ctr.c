@@ -22,15 +22,18 @@
 #include "common.h"
 #include "aes_ctr.h"
 #include "aes.h"
+#include "intreadwrite.h"
 #include "random_seed.h"
 
 #define AES_BLOCK_SIZE (16)
+#define AES_CTR_BATCH  (32) ///< number of whole blocks encrypted at once
 
 typedef struct AVAESCTR {
     struct AVAES* aes;
     uint8_t counter[AES_BLOCK_SIZE];
     uint8_t encrypted_counter[AES_BLOCK_SIZE];
     int block_offset;
+    uint8_t keystream[AES_BLOCK_SIZE * AES_CTR_BATCH];
 } AVAESCTR;
 
 struct AVAESCTR *av_aes_ctr_alloc(void)
@@ -107,9 +110,28 @@ void av_aes_ctr_crypt(struct AVAESCTR *a, uint8_t *dst, const uint8_t *src, int
     const uint8_t* src_end = src + count;
     const uint8_t* cur_end_pos;
     uint8_t* encrypted_counter_pos;
+    int i;
 
     while (src < src_end) {
         if (a->block_offset == 0) {
+            /* encrypt the counters of consecutive whole blocks in one call,
+             * so that they can be processed in parallel */
+            int nb_blocks = FFMIN((src_end - src) / AES_BLOCK_SIZE, AES_CTR_BATCH);
+
+            if (nb_blocks > 1) {
+                for (i = 0; i < nb_blocks; i++) {
+                    memcpy(a->keystream + i * AES_BLOCK_SIZE, a->counter, AES_BLOCK_SIZE);
+                    av_aes_ctr_increment_be64(a->counter + 8);
+                }
+                av_aes_crypt(a->aes, a->keystream, a->keystream, nb_blocks, NULL, 0);
+
+                for (i = 0; i < nb_blocks * AES_BLOCK_SIZE; i += 8)
+                    AV_WN64(dst + i, AV_RN64(src + i) ^ AV_RN64(a->keystream + i));
+                src += nb_blocks * AES_BLOCK_SIZE;
+                dst += nb_blocks * AES_BLOCK_SIZE;
+                continue;
+            }
+
             av_aes_crypt(a->aes, a->encrypted_counter, a->counter, 1, NULL, 0);
 
             av_aes_ctr_increment_be64(a->counter + 8);
@@ -25,9 +25,11 @@
  */
 
 #include "avutil.h"
+#include "atomic.h"
 #include "audio_fifo.h"
 #include "common.h"
 #include "fifo.h"
+#include "frame.h"
 #include "mem.h"
 #include "samplefmt.h"
 
@@ -40,8 +42,29 @@ struct AVAudioFifo {
     int channels;                   /**< number of channels */
     enum AVSampleFormat sample_fmt; /**< sample format */
     int sample_size;                /**< size, in bytes, of one sample in a buffer */
+    int flags;                      /**< AV_AUDIO_FIFO_FLAG_* */
 };
 
+/**
+ * With AV_AUDIO_FIFO_FLAG_SPSC the writer only touches the write side of the
+ * AVFifoBuffers and the reader the read side, so nb_samples is the only
+ * shared state. It is updated atomically after the data, and read before it.
+ */
+static int fifo_size(AVAudioFifo *af)
+{
+    if (af->flags & AV_AUDIO_FIFO_FLAG_SPSC)
+        return avpriv_atomic_int_get(&af->nb_samples);
+    return af->nb_samples;
+}
+
+static void fifo_add(AVAudioFifo *af, int nb_samples)
+{
+    if (af->flags & AV_AUDIO_FIFO_FLAG_SPSC)
+        avpriv_atomic_int_add_and_fetch(&af->nb_samples, nb_samples);
+    else
+        af->nb_samples += nb_samples;
+}
+
 void av_audio_fifo_free(AVAudioFifo *af)
 {
     if (af) {
@@ -59,6 +82,12 @@ void av_audio_fifo_free(AVAudioFifo *af)
 
 AVAudioFifo *av_audio_fifo_alloc(enum AVSampleFormat sample_fmt, int channels,
                                  int nb_samples)
+{
+    return av_audio_fifo_alloc2(sample_fmt, channels, nb_samples, 0);
+}
+
+AVAudioFifo *av_audio_fifo_alloc2(enum AVSampleFormat sample_fmt, int channels,
+                                  int nb_samples, int flags)
 {
     AVAudioFifo *af;
     int buf_size, i;
@@ -71,6 +100,7 @@ AVAudioFifo *av_audio_fifo_alloc(enum AVSampleFormat sample_fmt, int channels,
     if (!af)
         return NULL;
 
+    af->flags       = flags;
     af->channels    = channels;
     af->sample_fmt  = sample_fmt;
     af->sample_size = buf_size / nb_samples;
@@ -114,8 +144,14 @@ int av_audio_fifo_write(AVAudioFifo *af, void **data, int nb_samples)
 {
     int i, ret, size;
 
-    /* automatically reallocate buffers if needed */
-    if (av_audio_fifo_space(af) < nb_samples) {
+    if (af->flags & AV_AUDIO_FIFO_FLAG_SPSC) {
+        if (nb_samples < 0)
+            return AVERROR(EINVAL);
+        nb_samples = FFMIN(nb_samples, av_audio_fifo_space(af));
+        if (!nb_samples)
+            return 0;
+    } else if (av_audio_fifo_space(af) < nb_samples) {
+        /* automatically reallocate buffers if needed */
         int current_size = av_audio_fifo_size(af);
         /* check for integer overflow in new size calculation */
         if (INT_MAX / 2 - current_size < nb_samples)
@@ -131,7 +167,7 @@ int av_audio_fifo_write(AVAudioFifo *af, void **data, int nb_samples)
         if (ret != size)
             return AVERROR_BUG;
     }
-    af->nb_samples += nb_samples;
+    fifo_add(af, nb_samples);
 
     return nb_samples;
 }
@@ -142,7 +178,7 @@ int av_audio_fifo_peek(AVAudioFifo *af, void **data, int nb_samples)
 
     if (nb_samples < 0)
         return AVERROR(EINVAL);
-    nb_samples = FFMIN(nb_samples, af->nb_samples);
+    nb_samples = FFMIN(nb_samples, fifo_size(af));
     if (!nb_samples)
         return 0;
 
@@ -157,16 +193,16 @@ int av_audio_fifo_peek(AVAudioFifo *af, void **data, int nb_samples)
 
 int av_audio_fifo_peek_at(AVAudioFifo *af, void **data, int nb_samples, int offset)
 {
-    int i, ret, size;
+    int i, ret, size, fifo_samples = fifo_size(af);
 
-    if (offset < 0 || offset >= af->nb_samples)
+    if (offset < 0 || offset >= fifo_samples)
         return AVERROR(EINVAL);
     if (nb_samples < 0)
         return AVERROR(EINVAL);
-    nb_samples = FFMIN(nb_samples, af->nb_samples);
+    nb_samples = FFMIN(nb_samples, fifo_samples);
     if (!nb_samples)
         return 0;
-    if (offset > af->nb_samples - nb_samples)
+    if (offset > fifo_samples - nb_samples)
         return AVERROR(EINVAL);
 
     offset *= af->sample_size;
@@ -179,13 +215,38 @@ int av_audio_fifo_peek_at(AVAudioFifo *af, void **data, int nb_samples, int offs
     return nb_samples;
 }
 
+int av_audio_fifo_peek_ptr(AVAudioFifo *af, uint8_t **data, int nb_samples, int offset)
+{
+    int i, fifo_samples = fifo_size(af);
+
+    if (offset < 0 || offset > fifo_samples || nb_samples < 0)
+        return AVERROR(EINVAL);
+    nb_samples = FFMIN(nb_samples, fifo_samples - offset);
+    if (!nb_samples)
+        return 0;
+
+    /* all the buffers have the same size and are written and read by the
+     * same amounts, so they wrap around at the same sample */
+    offset *= af->sample_size;
+    for (i = 0; i < af->nb_buffers; i++) {
+        AVFifoBuffer *f = af->buf[i];
+
+        if (offset >= f->end - f->rptr)
+            data[i] = f->rptr + offset - (f->end - f->buffer);
+        else
+            data[i] = f->rptr + offset;
+    }
+
+    return FFMIN(nb_samples, (af->buf[0]->end - data[0]) / af->sample_size);
+}
+
 int av_audio_fifo_read(AVAudioFifo *af, void **data, int nb_samples)
 {
     int i, ret, size;
 
     if (nb_samples < 0)
         return AVERROR(EINVAL);
-    nb_samples = FFMIN(nb_samples, af->nb_samples);
+    nb_samples = FFMIN(nb_samples, fifo_size(af));
     if (!nb_samples)
         return 0;
 
@@ -194,24 +255,54 @@ int av_audio_fifo_read(AVAudioFifo *af, void **data, int nb_samples)
         if ((ret = av_fifo_generic_read(af->buf[i], data[i], size, NULL)) < 0)
             return AVERROR_BUG;
     }
-    af->nb_samples -= nb_samples;
+    fifo_add(af, -nb_samples);
 
     return nb_samples;
 }
 
+int av_audio_fifo_read_frame(AVAudioFifo *af, AVFrame *frame, int nb_samples)
+{
+    int ret;
+
+    if (nb_samples < 0)
+        return AVERROR(EINVAL);
+    nb_samples = FFMIN(nb_samples, fifo_size(af));
+    if (!nb_samples)
+        return 0;
+
+    if (!frame->buf[0]) {
+        frame->format     = af->sample_fmt;
+        frame->nb_samples = nb_samples;
+        if (!frame->channel_layout)
+            av_frame_set_channels(frame, af->channels);
+        if ((ret = av_frame_get_buffer(frame, 0)) < 0)
+            return ret;
+    } else if (frame->format != af->sample_fmt ||
+               av_frame_get_channels(frame) != af->channels ||
+               frame->linesize[0] < nb_samples * af->sample_size) {
+        return AVERROR(EINVAL);
+    }
+
+    if ((ret = av_audio_fifo_read(af, (void **)frame->extended_data, nb_samples)) < 0)
+        return ret;
+    frame->nb_samples = ret;
+
+    return ret;
+}
+
 int av_audio_fifo_drain(AVAudioFifo *af, int nb_samples)
 {
     int i, size;
 
     if (nb_samples < 0)
         return AVERROR(EINVAL);
-    nb_samples = FFMIN(nb_samples, af->nb_samples);
+    nb_samples = FFMIN(nb_samples, fifo_size(af));
 
     if (nb_samples) {
         size = nb_samples * af->sample_size;
         for (i = 0; i < af->nb_buffers; i++)
             av_fifo_drain(af->buf[i], size);
-        af->nb_samples -= nb_samples;
+        fifo_add(af, -nb_samples);
     }
     return 0;
 }
@@ -228,10 +319,10 @@ void av_audio_fifo_reset(AVAudioFifo *af)
 
 int av_audio_fifo_size(AVAudioFifo *af)
 {
-    return af->nb_samples;
+    return fifo_size(af);
 }
 
 int av_audio_fifo_space(AVAudioFifo *af)
 {
-    return af->allocated_samples - af->nb_samples;
+    return af->allocated_samples - fifo_size(af);
 }
@@ -29,6 +29,7 @@
 
 #include "avutil.h"
 #include "fifo.h"
+#include "frame.h"
 #include "samplefmt.h"
 
 /**
@@ -45,9 +46,28 @@
  * - Operates at the sample level rather than the byte level.
  * - Supports multiple channels with either planar or packed sample format.
  * - Automatic reallocation when writing to a full buffer.
+ * - Optional lock-free operation with one writer and one reader thread,
+ *   see AV_AUDIO_FIFO_FLAG_SPSC.
  */
 typedef struct AVAudioFifo AVAudioFifo;
 
+/**
+ * The FIFO is written by one thread and read by another one, without any
+ * locking.
+ *
+ * Only av_audio_fifo_write() may be called by the writer thread, and only
+ * av_audio_fifo_read(), av_audio_fifo_read_frame(), av_audio_fifo_peek(),
+ * av_audio_fifo_peek_at(), av_audio_fifo_peek_ptr() and
+ * av_audio_fifo_drain() by the reader thread. av_audio_fifo_size() and
+ * av_audio_fifo_space() may be called from either of them, and
+ * av_audio_fifo_realloc() and av_audio_fifo_reset() from neither while the
+ * other one is running.
+ *
+ * The FIFO is never reallocated automatically in this mode: writes are
+ * limited to the space available.
+ */
+#define AV_AUDIO_FIFO_FLAG_SPSC 1
+
 /**
  * Free an AVAudioFifo.
  *
@@ -66,6 +86,18 @@ void av_audio_fifo_free(AVAudioFifo *af);
 AVAudioFifo *av_audio_fifo_alloc(enum AVSampleFormat sample_fmt, int channels,
                                  int nb_samples);
 
+/**
+ * Allocate an AVAudioFifo.
+ *
+ * @param sample_fmt  sample format
+ * @param channels    number of channels
+ * @param nb_samples  initial allocation size, in samples
+ * @param flags       a combination of AV_AUDIO_FIFO_FLAG_*
+ * @return            newly allocated AVAudioFifo, or NULL on error
+ */
+AVAudioFifo *av_audio_fifo_alloc2(enum AVSampleFormat sample_fmt, int channels,
+                                  int nb_samples, int flags);
+
 /**
  * Reallocate an AVAudioFifo.
  *
@@ -90,7 +122,9 @@ int av_audio_fifo_realloc(AVAudioFifo *af, int nb_samples);
  * @param nb_samples  number of samples to write
  * @return            number of samples actually written, or negative AVERROR
  *                    code on failure. If successful, the number of samples
- *                    actually written will always be nb_samples.
+ *                    actually written will always be nb_samples, unless the
+ *                    FIFO was allocated with AV_AUDIO_FIFO_FLAG_SPSC, in
+ *                    which case it is limited to av_audio_fifo_space().
  */
 int av_audio_fifo_write(AVAudioFifo *af, void **data, int nb_samples);
 
@@ -127,6 +161,29 @@ int av_audio_fifo_peek(AVAudioFifo *af, void **data, int nb_samples);
  */
 int av_audio_fifo_peek_at(AVAudioFifo *af, void **data, int nb_samples, int offset);
 
+/**
+ * Get pointers to the data in an AVAudioFifo, without copying it.
+ *
+ * The samples are stored in a ring buffer, so the requested range may be
+ * split where the buffer wraps around; only the part before the wrap is
+ * returned, and the rest can be obtained with a second call at the
+ * corresponding offset.
+ *
+ * The pointers stay valid until the samples are read or drained, or the
+ * FIFO is written to without AV_AUDIO_FIFO_FLAG_SPSC (which may reallocate
+ * it), or reallocated.
+ *
+ * @param af          AVAudioFifo to peek into
+ * @param data        audio data plane pointers, set to the samples at offset
+ * @param nb_samples  number of samples wanted
+ * @param offset      offset from current read position
+ * @return            number of contiguous samples available at data, or
+ *                    negative AVERROR code on failure. It is less than
+ *                    nb_samples if the FIFO holds fewer samples or wraps
+ *                    around within the range.
+ */
+int av_audio_fifo_peek_ptr(AVAudioFifo *af, uint8_t **data, int nb_samples, int offset);
+
 /**
  * Read data from an AVAudioFifo.
  *
@@ -143,6 +200,24 @@ int av_audio_fifo_peek_at(AVAudioFifo *af, void **data, int nb_samples, int offs
  */
 int av_audio_fifo_read(AVAudioFifo *af, void **data, int nb_samples);
 
+/**
+ * Read data from an AVAudioFifo into an AVFrame.
+ *
+ * If the frame has no buffers yet, they are allocated with
+ * av_frame_get_buffer(), after setting the format and channel count of the
+ * FIFO. Otherwise the samples are read directly into the existing buffers,
+ * e.g. ones obtained from a buffer pool, which must be large enough.
+ *
+ * On success frame->nb_samples is set to the number of samples read.
+ *
+ * @param af          AVAudioFifo to read from
+ * @param frame       frame to read into
+ * @param nb_samples  number of samples to read
+ * @return            number of samples actually read, or negative AVERROR code
+ *                    on failure, as with av_audio_fifo_read()
+ */
+int av_audio_fifo_read_frame(AVAudioFifo *af, AVFrame *frame, int nb_samples);
+
 /**
  * Drain data from an AVAudioFifo.
  *
@@ -214,6 +214,15 @@ int av_buffer_realloc(AVBufferRef **pbuf, int size)
     return 0;
 }
 
+static void buffer_pool_init_locks(AVBufferPool *pool)
+{
+    int i;
+
+    for (i = 0; i < BUFFER_POOL_STRIPES; i++)
+        ff_mutex_init(&pool->stripes[i].mutex, NULL);
+    ff_mutex_init(&pool->alloc_mutex, NULL);
+}
+
 AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
                                    AVBufferRef* (*alloc)(void *opaque, int size),
                                    void (*pool_free)(void *opaque))
@@ -222,7 +231,7 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
     if (!pool)
         return NULL;
 
-    ff_mutex_init(&pool->mutex, NULL);
+    buffer_pool_init_locks(pool);
 
     pool->size      = size;
     pool->opaque    = opaque;
@@ -240,7 +249,7 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
     if (!pool)
         return NULL;
 
-    ff_mutex_init(&pool->mutex, NULL);
+    buffer_pool_init_locks(pool);
 
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
@@ -256,14 +265,21 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    int i;
 
-        buf->free(buf->opaque, buf->data);
-        av_freep(&buf);
+    for (i = 0; i < BUFFER_POOL_STRIPES; i++) {
+        BufferPoolStripe *stripe = &pool->stripes[i];
+
+        while (stripe->pool) {
+            BufferPoolEntry *buf = stripe->pool;
+            stripe->pool = buf->next;
+
+            buf->free(buf->opaque, buf->data);
+            av_freep(&buf);
+        }
+        ff_mutex_destroy(&stripe->mutex);
     }
-    ff_mutex_destroy(&pool->mutex);
+    ff_mutex_destroy(&pool->alloc_mutex);
 
     if (pool->pool_free)
         pool->pool_free(pool->opaque);
@@ -284,60 +300,19 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
         buffer_pool_free(pool);
 }
 
-#if USE_ATOMICS
-/* remove the whole buffer list from the pool and return it */
-static BufferPoolEntry *get_pool(AVBufferPool *pool)
-{
-    BufferPoolEntry *cur = *(void * volatile *)&pool->pool, *last = NULL;
-
-    while (cur != last) {
-        last = cur;
-        cur = avpriv_atomic_ptr_cas((void * volatile *)&pool->pool, last, NULL);
-        if (!cur)
-            return NULL;
-    }
-
-    return cur;
-}
-
-static void add_to_pool(BufferPoolEntry *buf)
-{
-    AVBufferPool *pool;
-    BufferPoolEntry *cur, *end = buf;
-
-    if (!buf)
-        return;
-    pool = buf->pool;
-
-    while (end->next)
-        end = end->next;
-
-    while (avpriv_atomic_ptr_cas((void * volatile *)&pool->pool, NULL, buf)) {
-        /* pool is not empty, retrieve it and append it to our list */
-        cur = get_pool(pool);
-        end->next = cur;
-        while (end->next)
-            end = end->next;
-    }
-}
-#endif
-
 static void pool_release_buffer(void *opaque, uint8_t *data)
 {
     BufferPoolEntry *buf = opaque;
     AVBufferPool *pool = buf->pool;
+    BufferPoolStripe *stripe = &pool->stripes[buf->stripe];
 
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-#if USE_ATOMICS
-    add_to_pool(buf);
-#else
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
-#endif
+    ff_mutex_lock(&stripe->mutex);
+    buf->next = stripe->pool;
+    stripe->pool = buf;
+    ff_mutex_unlock(&stripe->mutex);
 
     if (!avpriv_atomic_int_add_and_fetch(&pool->refcount, -1))
         buffer_pool_free(pool);
@@ -345,13 +320,15 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
 
 /* allocate a new buffer and override its free() callback so that
  * it is returned to the pool on free */
-static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
+static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool, int stripe)
 {
     BufferPoolEntry *buf;
     AVBufferRef     *ret;
 
+    ff_mutex_lock(&pool->alloc_mutex);
     ret = pool->alloc2 ? pool->alloc2(pool->opaque, pool->size) :
                          pool->alloc(pool->size);
+    ff_mutex_unlock(&pool->alloc_mutex);
     if (!ret)
         return NULL;
 
@@ -365,63 +342,69 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
     buf->opaque = ret->buffer->opaque;
     buf->free   = ret->buffer->free;
     buf->pool   = pool;
+    buf->stripe = stripe;
 
     ret->buffer->opaque = buf;
     ret->buffer->free   = pool_release_buffer;
 
-#if USE_ATOMICS
-    avpriv_atomic_int_add_and_fetch(&pool->refcount, 1);
     avpriv_atomic_int_add_and_fetch(&pool->nb_allocated, 1);
-#endif
 
     return ret;
 }
 
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
 {
-    AVBufferRef *ret;
-    BufferPoolEntry *buf;
-
-#if USE_ATOMICS
-    /* check whether the pool is empty */
-    buf = get_pool(pool);
-    if (!buf && pool->refcount <= pool->nb_allocated) {
-        av_log(NULL, AV_LOG_DEBUG, "Pool race dectected, spining to avoid overallocation and eventual OOM\n");
-        while (!buf && avpriv_atomic_int_get(&pool->refcount) <= avpriv_atomic_int_get(&pool->nb_allocated))
-            buf = get_pool(pool);
-    }
-
-    if (!buf)
-        return pool_alloc_buffer(pool);
-
-    /* keep the first entry, return the rest of the list to the pool */
-    add_to_pool(buf->next);
-    buf->next = NULL;
-
-    ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
-                           buf, 0);
-    if (!ret) {
-        add_to_pool(buf);
-        return NULL;
-    }
-#else
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
-    if (buf) {
-        ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
-                               buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
+    AVBufferRef *ret = NULL;
+    BufferPoolEntry *buf = NULL;
+    uintptr_t stack = (uintptr_t)&buf;
+    int i, first;
+
+    /* Start from a free list picked from the address of the stack: calls
+     * from the same thread keep using the same list, and buffers go back to
+     * the list they were taken from, so that in the common case every thread
+     * recycles its own buffers without touching the other threads' locks. */
+    first = ((uint32_t)(stack >> 16) * 0x9E3779B1U) >> 24;
+
+    for (i = 0; i < BUFFER_POOL_STRIPES && !buf; i++) {
+        BufferPoolStripe *stripe = &pool->stripes[(first + i) & (BUFFER_POOL_STRIPES - 1)];
+
+        ff_mutex_lock(&stripe->mutex);
+        buf = stripe->pool;
+        if (buf) {
+            ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
+                                   buf, 0);
+            if (ret) {
+                stripe->pool = buf->next;
+                buf->next = NULL;
+                stripe->hits++;
+            }
         }
-    } else {
-        ret = pool_alloc_buffer(pool);
+        ff_mutex_unlock(&stripe->mutex);
     }
-    ff_mutex_unlock(&pool->mutex);
-#endif
+    if (!buf)
+        ret = pool_alloc_buffer(pool, first & (BUFFER_POOL_STRIPES - 1));
 
     if (ret)
         avpriv_atomic_int_add_and_fetch(&pool->refcount, 1);
 
     return ret;
 }
+
+int av_buffer_pool_get_stats(AVBufferPool *pool, AVBufferPoolStats *stats)
+{
+    int i;
+
+    memset(stats, 0, sizeof(*stats));
+    for (i = 0; i < BUFFER_POOL_STRIPES; i++) {
+        BufferPoolStripe *stripe = &pool->stripes[i];
+
+        ff_mutex_lock(&stripe->mutex);
+        stats->hits += stripe->hits;
+        ff_mutex_unlock(&stripe->mutex);
+    }
+    stats->misses     = avpriv_atomic_int_get(&pool->nb_allocated);
+    stats->peak_bytes = stats->misses * (int64_t)pool->size;
+    stats->nb_in_use  = avpriv_atomic_int_get(&pool->refcount) - 1;
+
+    return 0;
+}
@@ -206,7 +206,7 @@ int av_buffer_realloc(AVBufferRef **buf, int size);
  * @ingroup lavu_data
  *
  * @{
- * AVBufferPool is an API for a lock-free thread-safe pool of AVBuffers.
+ * AVBufferPool is an API for a thread-safe pool of AVBuffers.
  *
  * Frequently allocating and freeing large buffers may be slow. AVBufferPool is
  * meant to solve this in cases when the caller needs a set of buffers of the
@@ -284,6 +284,43 @@ void av_buffer_pool_uninit(AVBufferPool **pool);
  */
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool);
 
+/**
+ * Usage statistics of a buffer pool, filled by av_buffer_pool_get_stats().
+ *
+ * New fields may be added at the end with a minor version bump.
+ */
+typedef struct AVBufferPoolStats {
+    /**
+     * Number of av_buffer_pool_get() calls served with a buffer
+     * already in the pool.
+     */
+    int64_t hits;
+    /**
+     * Number of av_buffer_pool_get() calls which had to allocate a new
+     * buffer.
+     */
+    int64_t misses;
+    /**
+     * Size in bytes of all the buffers allocated by the pool. Buffers are
+     * only freed with the pool, so this is also the peak memory use of the
+     * pool.
+     */
+    int64_t peak_bytes;
+    /**
+     * Number of buffers currently handed out to the caller.
+     */
+    int nb_in_use;
+} AVBufferPoolStats;
+
+/**
+ * Get the usage statistics of a buffer pool.
+ * This function may be called simultaneously with av_buffer_pool_get() and
+ * with buffers being released, the statistics are then a snapshot.
+ *
+ * @return 0 on success, a negative AVERROR on error.
+ */
+int av_buffer_pool_get_stats(AVBufferPool *pool, AVBufferPoolStats *stats);
+
 /**
  * @}
  */
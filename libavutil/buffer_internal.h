@@ -70,11 +70,31 @@ typedef struct BufferPoolEntry {
 
     AVBufferPool *pool;
     struct BufferPoolEntry *next;
+
+    /* index of the free list the entry is returned to */
+    int stripe;
 } BufferPoolEntry;
 
-struct AVBufferPool {
+/*
+ * Number of free lists in a pool, must be a power of two. Each list has its
+ * own lock, so that threads getting and releasing buffers at the same time
+ * mostly work on different lists.
+ */
+#define BUFFER_POOL_STRIPES 8
+
+typedef struct BufferPoolStripe {
     AVMutex mutex;
     BufferPoolEntry *pool;
+    int64_t hits;
+    /* keep the stripes on different cache lines */
+    uint8_t padding[64];
+} BufferPoolStripe;
+
+struct AVBufferPool {
+    BufferPoolStripe stripes[BUFFER_POOL_STRIPES];
+
+    /* serializes calls to the alloc callbacks */
+    AVMutex alloc_mutex;
 
     /*
      * This is used to track when the pool is to be freed.
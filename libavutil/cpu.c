@@ -16,18 +16,24 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+/* must come before any system header for sched.h to declare CPU_SET() */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "cpu.h"
 #include "cpu_internal.h"
 #include "config.h"
 #include "opt.h"
 #include "common.h"
+#include "error.h"
 
 #if HAVE_SCHED_GETAFFINITY
-#ifndef _GNU_SOURCE
-# define _GNU_SOURCE
-#endif
 #include <sched.h>
 #endif
 #if HAVE_GETPROCESSAFFINITYMASK || HAVE_WINRT
@@ -295,6 +301,218 @@ int av_cpu_count(void)
     return nb_cpus;
 }
 
+#define MAX_CPUS 1024
+
+typedef struct CPUSet {
+    uint64_t bits[MAX_CPUS / 64];
+} CPUSet;
+
+static void cpuset_add(CPUSet *set, int cpu)
+{
+    set->bits[cpu >> 6] |= UINT64_C(1) << (cpu & 63);
+}
+
+static int cpuset_has(const CPUSet *set, int cpu)
+{
+    return set->bits[cpu >> 6] >> (cpu & 63) & 1;
+}
+
+static int cpuset_count(const CPUSet *set)
+{
+    int i, n = 0;
+    for (i = 0; i < FF_ARRAY_ELEMS(set->bits); i++)
+        n += av_popcount64(set->bits[i]);
+    return n;
+}
+
+/* parse a list like "0-3,8,10-11", the format used by taskset -c and sysfs */
+static int cpuset_parse(CPUSet *set, const char *s)
+{
+    memset(set, 0, sizeof(*set));
+    while (*s && *s != '\n') {
+        char *end;
+        long first = strtol(s, &end, 10), last = first;
+
+        if (end == s || first < 0 || first >= MAX_CPUS)
+            return AVERROR(EINVAL);
+        s = end;
+        if (*s == '-') {
+            last = strtol(++s, &end, 10);
+            if (end == s || last < first || last >= MAX_CPUS)
+                return AVERROR(EINVAL);
+            s = end;
+        }
+        for (; first <= last; first++)
+            cpuset_add(set, first);
+        if (*s == ',')
+            s++;
+        else if (*s && *s != '\n')
+            return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+#ifdef __linux__
+static int cpuset_read(CPUSet *set, const char *fmt, int n)
+{
+    char path[128], buf[4096];
+    FILE *f;
+    int ret = AVERROR(ENOENT);
+
+    snprintf(path, sizeof(path), fmt, n);
+    if (!(f = fopen(path, "r")))
+        return ret;
+    if (fgets(buf, sizeof(buf), f))
+        ret = cpuset_parse(set, buf);
+    fclose(f);
+    return ret;
+}
+#endif
+
+/* the CPUs the process may run on */
+static void cpuset_process(CPUSet *set)
+{
+    int i;
+
+    memset(set, 0, sizeof(*set));
+#if HAVE_SCHED_GETAFFINITY && defined(CPU_COUNT)
+    {
+        cpu_set_t cpuset;
+
+        CPU_ZERO(&cpuset);
+        if (!sched_getaffinity(0, sizeof(cpuset), &cpuset)) {
+            for (i = 0; i < FFMIN(CPU_SETSIZE, MAX_CPUS); i++)
+                if (CPU_ISSET(i, &cpuset))
+                    cpuset_add(set, i);
+            return;
+        }
+    }
+#endif
+    for (i = 0; i < FFMIN(av_cpu_count(), MAX_CPUS); i++)
+        cpuset_add(set, i);
+}
+
+static int cpuset_from_spec(CPUSet *set, const char *spec)
+{
+    if (!strncmp(spec, "node", 4)) {
+#ifdef __linux__
+        char *end;
+        long node = strtol(spec + 4, &end, 10);
+
+        if (end == spec + 4 || *end || node < 0 || node >= MAX_CPUS)
+            return AVERROR(EINVAL);
+        return cpuset_read(set, "/sys/devices/system/node/node%d/cpulist", node);
+#else
+        return AVERROR(ENOSYS);
+#endif
+    }
+    return cpuset_parse(set, spec);
+}
+
+int av_cpu_count_cores(void)
+{
+    CPUSet allowed;
+    int nb_cores = 0;
+#ifdef __linux__
+    int i;
+
+    cpuset_process(&allowed);
+    for (i = 0; i < MAX_CPUS; i++) {
+        CPUSet siblings;
+        int j;
+
+        if (!cpuset_has(&allowed, i))
+            continue;
+        if (cpuset_read(&siblings, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", i) < 0)
+            return av_cpu_count();
+        /* count each core once, through its first allowed thread */
+        for (j = 0; j < i; j++)
+            if (cpuset_has(&siblings, j) && cpuset_has(&allowed, j))
+                break;
+        nb_cores += j == i;
+    }
+#else
+    cpuset_process(&allowed);
+    nb_cores = cpuset_count(&allowed);
+#endif
+    return FFMAX(nb_cores, 1);
+}
+
+int av_cpu_count_numa_nodes(void)
+{
+    int nb_nodes = 0;
+#ifdef __linux__
+    CPUSet allowed, online;
+    int i;
+
+    cpuset_process(&allowed);
+    if (cpuset_read(&online, "/sys/devices/system/node/online", 0) < 0)
+        return 1;
+    for (i = 0; i < MAX_CPUS; i++) {
+        CPUSet cpus;
+        int j;
+
+        if (!cpuset_has(&online, i) ||
+            cpuset_read(&cpus, "/sys/devices/system/node/node%d/cpulist", i) < 0)
+            continue;
+        for (j = 0; j < FF_ARRAY_ELEMS(cpus.bits); j++)
+            if (cpus.bits[j] & allowed.bits[j])
+                break;
+        nb_nodes += j < FF_ARRAY_ELEMS(cpus.bits);
+    }
+#endif
+    return FFMAX(nb_nodes, 1);
+}
+
+int av_cpu_affinity_count(const char *cpus)
+{
+    CPUSet set;
+    int ret = cpuset_from_spec(&set, cpus);
+
+    if (ret < 0)
+        return ret;
+    return cpuset_count(&set) ? cpuset_count(&set) : AVERROR(EINVAL);
+}
+
+int av_cpu_set_thread_affinity(const char *cpus)
+{
+    CPUSet set;
+    int i, ret = cpuset_from_spec(&set, cpus);
+
+    if (ret < 0)
+        return ret;
+    if (!cpuset_count(&set))
+        return AVERROR(EINVAL);
+
+#if HAVE_SCHED_GETAFFINITY && defined(CPU_SET) && defined(__linux__)
+    {
+        cpu_set_t cpuset;
+
+        CPU_ZERO(&cpuset);
+        for (i = 0; i < FFMIN(CPU_SETSIZE, MAX_CPUS); i++)
+            if (cpuset_has(&set, i))
+                CPU_SET(i, &cpuset);
+        /* on Linux, pid 0 designates the calling thread */
+        if (sched_setaffinity(0, sizeof(cpuset), &cpuset))
+            return AVERROR(errno);
+        return 0;
+    }
+#elif HAVE_GETPROCESSAFFINITYMASK
+    {
+        DWORD_PTR mask = 0;
+
+        for (i = 0; i < 8 * sizeof(mask); i++)
+            if (cpuset_has(&set, i))
+                mask |= (DWORD_PTR)1 << i;
+        if (!mask || !SetThreadAffinityMask(GetCurrentThread(), mask))
+            return AVERROR(EINVAL);
+        return 0;
+    }
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
 #ifdef TEST
 
 #include <stdio.h>
@@ -114,4 +114,34 @@ int av_parse_cpu_caps(unsigned *flags, const char *s);
  */
 int av_cpu_count(void);
 
+/**
+ * @return the number of physical cores the process may run on, counting SMT
+ *         siblings once, or av_cpu_count() if the topology is unknown
+ */
+int av_cpu_count_cores(void);
+
+/**
+ * @return the number of NUMA nodes the process may run on, 1 if unknown
+ */
+int av_cpu_count_numa_nodes(void);
+
+/**
+ * Count the CPUs of a CPU set.
+ *
+ * @param cpus a comma separated list of CPU numbers and ranges, e.g.
+ *             "0-3,8,10-11", or "nodeN" for the CPUs of NUMA node N
+ * @return the number of CPUs in the set, or a negative AVERROR code if the
+ *         set is invalid or empty
+ */
+int av_cpu_affinity_count(const char *cpus);
+
+/**
+ * Restrict the calling thread to a set of CPUs.
+ *
+ * @param cpus a CPU set, in the format described for av_cpu_affinity_count()
+ * @return 0 on success, AVERROR(ENOSYS) if the platform does not support it,
+ *         another negative AVERROR code on failure
+ */
+int av_cpu_set_thread_affinity(const char *cpus);
+
 #endif /* AVUTIL_CPU_H */
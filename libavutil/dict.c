@@ -26,11 +26,117 @@
 #include "mem.h"
 #include "bprint.h"
 
+/**
+ * Dictionaries with at least that many entries get a hash index of their
+ * keys, so that exact lookups do not scan all the entries.
+ */
+#define HASH_THRESHOLD 16
+
+typedef struct DictHash {
+    uint32_t hash;          ///< case insensitive hash of the key
+    int next;               ///< next entry in the same bucket, -1 if none
+} DictHash;
+
 struct AVDictionary {
     int count;
     AVDictionaryEntry *elems;
+    /* optional hash index of the keys, see HASH_THRESHOLD */
+    DictHash *hash;         ///< one per entry, NULL if there is no index
+    int *buckets;           ///< first entry of each bucket, -1 if none
+    int nb_buckets;         ///< power of 2, 0 if there is no index
 };
 
+static uint32_t hash_key(const char *key)
+{
+    uint32_t h = 2166136261U;
+
+    while (*key)
+        h = (h ^ av_toupper(*key++)) * 16777619U;
+    return h;
+}
+
+static void free_index(AVDictionary *m)
+{
+    av_freep(&m->hash);
+    av_freep(&m->buckets);
+    m->nb_buckets = 0;
+}
+
+static int rehash(AVDictionary *m, int nb_buckets)
+{
+    int i, *buckets = av_malloc_array(nb_buckets, sizeof(*buckets));
+
+    if (!buckets)
+        return AVERROR(ENOMEM);
+    memset(buckets, -1, nb_buckets * sizeof(*buckets));
+    for (i = 0; i < m->count; i++) {
+        int *b = &buckets[m->hash[i].hash & (nb_buckets - 1)];
+        m->hash[i].next = *b;
+        *b = i;
+    }
+    av_free(m->buckets);
+    m->buckets    = buckets;
+    m->nb_buckets = nb_buckets;
+    return 0;
+}
+
+static void build_index(AVDictionary *m)
+{
+    int i, nb_buckets = 1;
+
+    m->hash = av_malloc_array(m->count, sizeof(*m->hash));
+    if (!m->hash)
+        return;
+    for (i = 0; i < m->count; i++)
+        m->hash[i].hash = hash_key(m->elems[i].key);
+    while (nb_buckets < 2 * m->count)
+        nb_buckets <<= 1;
+    if (rehash(m, nb_buckets) < 0)
+        free_index(m);
+}
+
+/* the index is an optimization only, it is dropped if it cannot be kept */
+static void index_add(AVDictionary *m)
+{
+    int idx = m->count - 1, *b;
+
+    if (!m->nb_buckets) {
+        if (m->count >= HASH_THRESHOLD)
+            build_index(m);
+        return;
+    }
+    m->hash[idx].hash = hash_key(m->elems[idx].key);
+    if (m->count > m->nb_buckets) {
+        if (rehash(m, 2 * m->nb_buckets) < 0)
+            free_index(m);
+        return;
+    }
+    b = &m->buckets[m->hash[idx].hash & (m->nb_buckets - 1)];
+    m->hash[idx].next = *b;
+    *b = idx;
+}
+
+static int *index_find_link(AVDictionary *m, int idx)
+{
+    int *p = &m->buckets[m->hash[idx].hash & (m->nb_buckets - 1)];
+
+    while (*p != idx)
+        p = &m->hash[*p].next;
+    return p;
+}
+
+/* remove entry idx, the last entry is about to be moved in its place */
+static void index_remove(AVDictionary *m, int idx)
+{
+    int last = m->count - 1;
+
+    *index_find_link(m, idx) = m->hash[idx].next;
+    if (idx != last) {
+        *index_find_link(m, last) = idx;
+        m->hash[idx] = m->hash[last];
+    }
+}
+
 int av_dict_count(const AVDictionary *m)
 {
     return m ? m->count : 0;
@@ -49,6 +155,22 @@ AVDictionaryEntry *av_dict_get(const AVDictionary *m, const char *key,
     else
         i = 0;
 
+    if (m->nb_buckets && !(flags & AV_DICT_IGNORE_SUFFIX)) {
+        uint32_t hash = hash_key(key);
+        int k, best = -1;
+
+        /* the buckets are not ordered, look for the first match after prev */
+        for (k = m->buckets[hash & (m->nb_buckets - 1)]; k >= 0; k = m->hash[k].next) {
+            if ((unsigned)k < i || (best >= 0 && k > best) || m->hash[k].hash != hash)
+                continue;
+            if (flags & AV_DICT_MATCH_CASE ? strcmp(m->elems[k].key, key)
+                                           : av_strcasecmp(m->elems[k].key, key))
+                continue;
+            best = k;
+        }
+        return best >= 0 ? &m->elems[best] : NULL;
+    }
+
     for (; i < m->count; i++) {
         const char *s = m->elems[i].key;
         if (flags & AV_DICT_MATCH_CASE)
@@ -97,6 +219,8 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
         else
             av_free(tag->value);
         av_free(tag->key);
+        if (m->nb_buckets)
+            index_remove(m, tag - m->elems);
         *tag = m->elems[--m->count];
     } else if (copy_value) {
         AVDictionaryEntry *tmp = av_realloc(m->elems,
@@ -104,6 +228,13 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
         if (!tmp)
             goto err_out;
         m->elems = tmp;
+        if (m->nb_buckets) {
+            DictHash *hash = av_realloc_array(m->hash, m->count + 1, sizeof(*hash));
+            if (hash)
+                m->hash = hash;
+            else
+                free_index(m);
+        }
     }
     if (copy_value) {
         m->elems[m->count].key = copy_key;
@@ -120,10 +251,12 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
             av_freep(&copy_value);
         }
         m->count++;
+        index_add(m);
     } else {
         av_freep(&copy_key);
     }
     if (!m->count) {
+        free_index(m);
         av_freep(&m->elems);
         av_freep(pm);
     }
@@ -132,6 +265,7 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
 
 err_out:
     if (m && !m->count) {
+        free_index(m);
         av_freep(&m->elems);
         av_freep(pm);
     }
@@ -205,6 +339,7 @@ void av_dict_free(AVDictionary **pm)
             av_freep(&m->elems[m->count].key);
             av_freep(&m->elems[m->count].value);
         }
+        free_index(m);
         av_freep(&m->elems);
     }
     av_freep(pm);
@@ -283,6 +418,8 @@ int main(void)
     AVDictionary *dict = NULL;
     AVDictionaryEntry *e;
     char *buffer = NULL;
+    char key[16];
+    int i;
 
     printf("Testing av_dict_get_string() and av_dict_parse_string()\n");
     av_dict_get_string(dict, &buffer, '=', ',');
@@ -361,6 +498,33 @@ int main(void)
     printf("%s\n", e->value);
     av_dict_free(&dict);
 
+    printf("\nTesting av_dict_get() with many entries\n");
+    for (i = 0; i < 40; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        av_dict_set(&dict, key, key, 0);
+    }
+    av_dict_set(&dict, "KEY5", "five", 0);
+    av_dict_set(&dict, "key7", NULL, 0);
+    av_dict_set(&dict, "Key9", "nine", AV_DICT_MATCH_CASE);
+    av_dict_set(&dict, "key11", "eleven", AV_DICT_APPEND);
+    av_dict_set(&dict, "key13", "thirteen", AV_DICT_DONT_OVERWRITE);
+    print_dict(dict);
+    e = NULL;
+    while ((e = av_dict_get(dict, "KEY9", e, 0)))
+        printf("%s %s\n", e->key, e->value);
+    e = av_dict_get(dict, "KEY9", NULL, AV_DICT_MATCH_CASE);
+    printf("%s\n", e ? e->value : "(null)");
+    e = av_dict_get(dict, "key7", NULL, 0);
+    printf("%s\n", e ? e->value : "(null)");
+    e = av_dict_get(dict, "key3", NULL, AV_DICT_IGNORE_SUFFIX);
+    printf("%s\n", e ? e->value : "(null)");
+    for (i = 0; i < 40; i += 2) {
+        snprintf(key, sizeof(key), "KEY%d", i);
+        av_dict_set(&dict, key, NULL, 0);
+    }
+    print_dict(dict);
+    av_dict_free(&dict);
+
     return 0;
 }
 #endif
@@ -0,0 +1,314 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+
+#include "common.h"
+#include "cpu.h"
+#include "error.h"
+#include "executor.h"
+#include "intmath.h"
+#include "mem.h"
+#include "thread.h"
+
+/* one av_executor_execute() call, living on the stack of its caller */
+typedef struct Batch {
+    av_executor_func *func;
+    void *arg;
+    int *rets;
+    int nb_jobs;
+    int next_job;
+    int nb_done;
+    uint64_t all_slots;     ///< mask of the thread indexes the jobs may use
+    uint64_t busy_slots;    ///< thread indexes of the running jobs
+    struct Batch *next;
+} Batch;
+
+struct AVExecutor {
+#if HAVE_THREADS
+    pthread_t *workers;
+    int nb_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;   ///< signaled when jobs can be started
+    pthread_cond_t done_cond;   ///< broadcast when a job is done
+    Batch *queue;               ///< calls with jobs left to start, oldest first
+    int die;
+#else
+    int dummy;
+#endif
+};
+
+#if HAVE_THREADS
+
+/* start the next job of b if it has one and a free thread index, with the
+ * lock held */
+static int take_job(AVExecutor *e, Batch *b, int *jobnr, int *slot)
+{
+    uint64_t free_slots = b->all_slots & ~b->busy_slots;
+
+    if (b->next_job >= b->nb_jobs || !free_slots)
+        return 0;
+
+    *slot  = ff_ctzll(free_slots);
+    *jobnr = b->next_job++;
+    b->busy_slots |= UINT64_C(1) << *slot;
+
+    if (b->next_job == b->nb_jobs) {
+        Batch **p = &e->queue;
+        while (*p != b)
+            p = &(*p)->next;
+        *p = b->next;
+    }
+    return 1;
+}
+
+/* with the lock held; b must not be accessed afterwards, as the caller of
+ * av_executor_execute() may have returned */
+static void finish_job(AVExecutor *e, Batch *b, int jobnr, int slot, int ret)
+{
+    b->busy_slots &= ~(UINT64_C(1) << slot);
+    if (b->rets)
+        b->rets[jobnr] = ret;
+    b->nb_done++;
+    /* a worker may have skipped b for lack of a free thread index */
+    if (b->next_job < b->nb_jobs)
+        pthread_cond_signal(&e->work_cond);
+    pthread_cond_broadcast(&e->done_cond);
+}
+
+static void *attribute_align_arg worker(void *arg)
+{
+    AVExecutor *e = arg;
+
+    pthread_mutex_lock(&e->lock);
+    while (!e->die) {
+        int jobnr, slot, ret;
+        Batch *b;
+
+        for (b = e->queue; b; b = b->next)
+            if (take_job(e, b, &jobnr, &slot))
+                break;
+        if (!b) {
+            pthread_cond_wait(&e->work_cond, &e->lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&e->lock);
+        ret = b->func(b->arg, jobnr, slot);
+        pthread_mutex_lock(&e->lock);
+
+        finish_job(e, b, jobnr, slot, ret);
+    }
+    pthread_mutex_unlock(&e->lock);
+
+    return NULL;
+}
+
+#endif /* HAVE_THREADS */
+
+int av_executor_alloc(AVExecutor **pe, int nb_threads)
+{
+#if HAVE_THREADS
+    AVExecutor *e;
+    int i, ret;
+
+    *pe = NULL;
+    if (nb_threads < 0)
+        return AVERROR(EINVAL);
+    if (!nb_threads)
+        nb_threads = av_cpu_count();
+    nb_threads = FFMIN(nb_threads, AV_EXECUTOR_MAX_THREADS);
+
+    if (!(e = av_mallocz(sizeof(*e))))
+        return AVERROR(ENOMEM);
+    if (!(e->workers = av_mallocz_array(nb_threads, sizeof(*e->workers)))) {
+        av_free(e);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&e->lock, NULL);
+    pthread_cond_init(&e->work_cond, NULL);
+    pthread_cond_init(&e->done_cond, NULL);
+
+    for (i = 0; i < nb_threads; i++) {
+        if ((ret = pthread_create(&e->workers[i], NULL, worker, e))) {
+            av_executor_free(&e);
+            return AVERROR(ret);
+        }
+        e->nb_threads++;
+    }
+
+    *pe = e;
+    return 0;
+#else
+    *pe = NULL;
+    return AVERROR(ENOSYS);
+#endif /* HAVE_THREADS */
+}
+
+void av_executor_free(AVExecutor **pe)
+{
+#if HAVE_THREADS
+    AVExecutor *e = *pe;
+    int i;
+
+    if (!e)
+        return;
+
+    pthread_mutex_lock(&e->lock);
+    e->die = 1;
+    pthread_cond_broadcast(&e->work_cond);
+    pthread_mutex_unlock(&e->lock);
+
+    for (i = 0; i < e->nb_threads; i++)
+        pthread_join(e->workers[i], NULL);
+
+    pthread_cond_destroy(&e->done_cond);
+    pthread_cond_destroy(&e->work_cond);
+    pthread_mutex_destroy(&e->lock);
+    av_freep(&e->workers);
+#endif /* HAVE_THREADS */
+    av_freep(pe);
+}
+
+int av_executor_get_nb_threads(const AVExecutor *e)
+{
+#if HAVE_THREADS
+    return e->nb_threads;
+#else
+    return 0;
+#endif
+}
+
+int av_executor_execute(AVExecutor *e, av_executor_func *func, void *arg,
+                        int *rets, int nb_jobs, int max_threads)
+{
+#if HAVE_THREADS
+    Batch b = { 0 };
+    int nb_slots = av_executor_get_nb_threads(e) + 1;
+
+    if (max_threads > 0)
+        nb_slots = FFMIN(nb_slots, max_threads);
+
+    if (nb_jobs > 1 && nb_slots > 1) {
+        b.func      = func;
+        b.arg       = arg;
+        b.rets      = rets;
+        b.nb_jobs   = nb_jobs;
+        b.all_slots = nb_slots == 64 ? UINT64_MAX : (UINT64_C(1) << nb_slots) - 1;
+
+        pthread_mutex_lock(&e->lock);
+        {
+            Batch **p = &e->queue;
+            while (*p)
+                p = &(*p)->next;
+            *p = &b;
+        }
+        pthread_cond_broadcast(&e->work_cond);
+
+        while (b.nb_done < b.nb_jobs) {
+            int jobnr, slot, ret;
+
+            if (!take_job(e, &b, &jobnr, &slot)) {
+                pthread_cond_wait(&e->done_cond, &e->lock);
+                continue;
+            }
+            pthread_mutex_unlock(&e->lock);
+            ret = func(arg, jobnr, slot);
+            pthread_mutex_lock(&e->lock);
+            finish_job(e, &b, jobnr, slot, ret);
+        }
+        pthread_mutex_unlock(&e->lock);
+
+        return 0;
+    }
+#endif /* HAVE_THREADS */
+    {
+        int i;
+
+        for (i = 0; i < nb_jobs; i++) {
+            int ret = func(arg, i, 0);
+            if (rets)
+                rets[i] = ret;
+        }
+    }
+    return 0;
+}
+
+#ifdef TEST
+
+#include <stdio.h>
+
+#define NB_JOBS 100
+
+typedef struct TestContext {
+    AVExecutor *e;
+    int max_threads;
+    volatile int running[64];
+    int fail;
+} TestContext;
+
+static int nested_job(void *arg, int jobnr, int threadnr)
+{
+    return jobnr * 2;
+}
+
+static int test_job(void *arg, int jobnr, int threadnr)
+{
+    TestContext *t = arg;
+    int i, sum = 0, rets[NB_JOBS];
+
+    if (threadnr >= t->max_threads || t->running[threadnr]++)
+        t->fail = 1;
+    /* jobs may themselves use the executor */
+    if (!(jobnr % 10)) {
+        av_executor_execute(t->e, nested_job, NULL, rets, NB_JOBS, 0);
+        for (i = 0; i < NB_JOBS; i++)
+            sum += rets[i] - 2 * i;
+    }
+    t->running[threadnr]--;
+    return sum + jobnr;
+}
+
+int main(void)
+{
+    TestContext t = { 0 };
+    int i, j, ret, rets[NB_JOBS];
+
+    if ((ret = av_executor_alloc(&t.e, 4)) < 0) {
+        if (ret != AVERROR(ENOSYS))
+            return 1;
+        /* without threads, the jobs are run by the calling thread */
+        printf("OK\n");
+        return 0;
+    }
+
+    for (j = 1; j <= 6; j++) {
+        t.max_threads = FFMIN(j, av_executor_get_nb_threads(t.e) + 1);
+        av_executor_execute(t.e, test_job, &t, rets, NB_JOBS, j);
+        for (i = 0; i < NB_JOBS; i++)
+            if (rets[i] != i)
+                t.fail = 1;
+    }
+    av_executor_free(&t.e);
+
+    printf("%s\n", t.fail ? "FAIL" : "OK");
+    return t.fail;
+}
+
+#endif /* TEST */
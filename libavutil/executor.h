@@ -0,0 +1,93 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_EXECUTOR_H
+#define AVUTIL_EXECUTOR_H
+
+/**
+ * @file
+ * A pool of worker threads which can be shared by several codec and filter
+ * contexts, so that the total number of threads does not grow with the
+ * number of contexts.
+ */
+
+/**
+ * Maximum number of worker threads of an executor.
+ */
+#define AV_EXECUTOR_MAX_THREADS 63
+
+typedef struct AVExecutor AVExecutor;
+
+/**
+ * A job run by an executor.
+ *
+ * @param arg      the opaque argument given to av_executor_execute()
+ * @param jobnr    index of the job, from 0 to nb_jobs - 1
+ * @param threadnr index of the thread running the job, from 0 to the
+ *                 max_threads given to av_executor_execute() minus 1;
+ *                 two jobs of the same call running at the same time
+ *                 always have different indexes
+ * @return the value stored in the rets array of av_executor_execute()
+ */
+typedef int (av_executor_func)(void *arg, int jobnr, int threadnr);
+
+/**
+ * Allocate an executor and start its worker threads.
+ *
+ * @param e          pointer to the executor
+ * @param nb_threads number of worker threads, 0 to use one per CPU; at most
+ *                   AV_EXECUTOR_MAX_THREADS
+ * @return  >=0 for success; <0 for error, in particular AVERROR(ENOSYS) if
+ *          lavu was built without thread support
+ */
+int av_executor_alloc(AVExecutor **e, int nb_threads);
+
+/**
+ * Stop the worker threads and free an executor. No call to
+ * av_executor_execute() may be in progress.
+ */
+void av_executor_free(AVExecutor **e);
+
+/**
+ * @return the number of worker threads of the executor
+ */
+int av_executor_get_nb_threads(const AVExecutor *e);
+
+/**
+ * Run nb_jobs jobs on the worker threads and the calling thread, and return
+ * once all of them are done.
+ *
+ * Several threads may call this function at the same time, including jobs
+ * run by the executor. The jobs of all the calls are shared among the
+ * worker threads, in the order of the calls, and the calling thread only
+ * runs jobs of its own call, so a call can always complete.
+ *
+ * @param func        function run for each job
+ * @param arg         opaque argument passed to func
+ * @param rets        if not NULL, array of nb_jobs entries where the return
+ *                    values of func are stored
+ * @param nb_jobs     number of jobs
+ * @param max_threads maximum number of jobs of this call running at the same
+ *                    time, 0 for no other limit than the number of worker
+ *                    threads plus one
+ * @return 0
+ */
+int av_executor_execute(AVExecutor *e, av_executor_func *func, void *arg,
+                        int *rets, int nb_jobs, int max_threads);
+
+#endif /* AVUTIL_EXECUTOR_H */
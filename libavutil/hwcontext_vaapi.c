@@ -0,0 +1,588 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <va/va.h>
+
+#include "buffer.h"
+#include "common.h"
+#include "frame.h"
+#include "hwcontext.h"
+#include "hwcontext_internal.h"
+#include "hwcontext_vaapi.h"
+#include "mem.h"
+#include "pixdesc.h"
+#include "pixfmt.h"
+
+typedef struct VAAPISurfaceFormat {
+    enum AVPixelFormat pix_fmt;
+    VAImageFormat image_format;
+} VAAPISurfaceFormat;
+
+typedef struct VAAPIDeviceContext {
+    /* image formats supported by the device, with a matching pixel format */
+    VAAPISurfaceFormat *formats;
+    int              nb_formats;
+} VAAPIDeviceContext;
+
+typedef struct VAAPIFramesContext {
+    /* surface attributes used for the internal pool */
+    VASurfaceAttrib *attributes;
+    int           nb_attributes;
+    /* RT format of the surfaces */
+    unsigned int rt_format;
+    /* the surfaces can be mapped directly with vaDeriveImage() */
+    int derive_works;
+} VAAPIFramesContext;
+
+enum {
+    VAAPI_MAP_READ   = 0x01,
+    VAAPI_MAP_WRITE  = 0x02,
+    VAAPI_MAP_DIRECT = 0x04,
+};
+
+typedef struct VAAPISurfaceMap {
+    AVHWFramesContext *hwfc;
+    VASurfaceID surface_id;
+    int flags;               /* VAAPI_MAP_* */
+    VAImage image;           /* derived or copied image which is mapped */
+} VAAPISurfaceMap;
+
+#define MAP(va, rt, av) { VA_FOURCC_ ## va, VA_RT_FORMAT_ ## rt, AV_PIX_FMT_ ## av }
+/* the mapping is not bijective, YV12/YV16 are the YUV planar formats with
+ * the U and V planes swapped, which the mapping of the frames hides */
+static const struct {
+    unsigned int fourcc;
+    unsigned int rt_format;
+    enum AVPixelFormat pix_fmt;
+} vaapi_format_map[] = {
+    MAP(NV12, YUV420,  NV12),
+    MAP(YV12, YUV420,  YUV420P),
+#ifdef VA_FOURCC_IYUV
+    MAP(IYUV, YUV420,  YUV420P),
+#endif
+#ifdef VA_FOURCC_YV16
+    MAP(YV16, YUV422,  YUV422P),
+#endif
+    MAP(422H, YUV422,  YUV422P),
+    MAP(UYVY, YUV422,  UYVY422),
+    MAP(YUY2, YUV422,  YUYV422),
+#ifdef VA_FOURCC_Y800
+    MAP(Y800, YUV400,  GRAY8),
+#endif
+#ifdef VA_FOURCC_P010
+    MAP(P010, YUV420_10BPP, P010),
+#endif
+    MAP(BGRA, RGB32,   BGRA),
+    MAP(BGRX, RGB32,   BGR0),
+    MAP(RGBA, RGB32,   RGBA),
+    MAP(RGBX, RGB32,   RGB0),
+    MAP(ABGR, RGB32,   ABGR),
+    MAP(XBGR, RGB32,   0BGR),
+    MAP(ARGB, RGB32,   ARGB),
+    MAP(XRGB, RGB32,   0RGB),
+};
+#undef MAP
+
+static enum AVPixelFormat vaapi_pix_fmt_from_fourcc(unsigned int fourcc)
+{
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(vaapi_format_map); i++)
+        if (vaapi_format_map[i].fourcc == fourcc)
+            return vaapi_format_map[i].pix_fmt;
+    return AV_PIX_FMT_NONE;
+}
+
+static int vaapi_is_uv_swapped(unsigned int fourcc)
+{
+#ifdef VA_FOURCC_YV16
+    if (fourcc == VA_FOURCC_YV16)
+        return 1;
+#endif
+    return fourcc == VA_FOURCC_YV12;
+}
+
+static const VAImageFormat *vaapi_get_image_format(AVHWDeviceContext *hwdev,
+                                                   enum AVPixelFormat pix_fmt)
+{
+    VAAPIDeviceContext *priv = hwdev->internal->priv;
+    int i;
+
+    for (i = 0; i < priv->nb_formats; i++)
+        if (priv->formats[i].pix_fmt == pix_fmt)
+            return &priv->formats[i].image_format;
+    return NULL;
+}
+
+static int vaapi_device_init(AVHWDeviceContext *hwdev)
+{
+    AVVAAPIDeviceContext *hwctx = hwdev->hwctx;
+    VAAPIDeviceContext    *priv = hwdev->internal->priv;
+    VAImageFormat *image_list = NULL;
+    VAStatus vas;
+    int i, image_count, err = 0;
+
+    image_count = vaMaxNumImageFormats(hwctx->display);
+    if (image_count <= 0)
+        return AVERROR(EIO);
+    image_list = av_malloc_array(image_count, sizeof(*image_list));
+    priv->formats = av_malloc_array(image_count, sizeof(*priv->formats));
+    if (!image_list || !priv->formats) {
+        err = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    vas = vaQueryImageFormats(hwctx->display, image_list, &image_count);
+    if (vas != VA_STATUS_SUCCESS) {
+        av_log(hwdev, AV_LOG_ERROR, "Error querying the image formats: %d (%s)\n",
+               vas, vaErrorStr(vas));
+        err = AVERROR(EIO);
+        goto fail;
+    }
+
+    for (i = 0; i < image_count; i++) {
+        enum AVPixelFormat pix_fmt = vaapi_pix_fmt_from_fourcc(image_list[i].fourcc);
+        if (pix_fmt == AV_PIX_FMT_NONE)
+            continue;
+        av_log(hwdev, AV_LOG_DEBUG, "Format %#x -> %s.\n",
+               image_list[i].fourcc, av_get_pix_fmt_name(pix_fmt));
+        priv->formats[priv->nb_formats].pix_fmt      = pix_fmt;
+        priv->formats[priv->nb_formats].image_format = image_list[i];
+        priv->nb_formats++;
+    }
+
+    av_free(image_list);
+    return 0;
+fail:
+    av_freep(&priv->formats);
+    av_free(image_list);
+    return err;
+}
+
+static void vaapi_device_uninit(AVHWDeviceContext *hwdev)
+{
+    VAAPIDeviceContext *priv = hwdev->internal->priv;
+
+    av_freep(&priv->formats);
+}
+
+static void vaapi_buffer_free(void *opaque, uint8_t *data)
+{
+    AVHWFramesContext     *hwfc = opaque;
+    AVVAAPIDeviceContext *hwctx = hwfc->device_ctx->hwctx;
+    VASurfaceID surface_id      = (VASurfaceID)(uintptr_t)data;
+    VAStatus vas;
+
+    vas = vaDestroySurfaces(hwctx->display, &surface_id, 1);
+    if (vas != VA_STATUS_SUCCESS)
+        av_log(hwfc, AV_LOG_ERROR, "Error destroying surface %#x: %d (%s)\n",
+               surface_id, vas, vaErrorStr(vas));
+}
+
+static AVBufferRef *vaapi_pool_alloc(void *opaque, int size)
+{
+    AVHWFramesContext     *hwfc = opaque;
+    VAAPIFramesContext    *priv = hwfc->internal->priv;
+    AVVAAPIDeviceContext *hwctx = hwfc->device_ctx->hwctx;
+    AVVAAPIFramesContext *avfc  = hwfc->hwctx;
+    VASurfaceID surface_id;
+    AVBufferRef *ref;
+    VAStatus vas;
+
+    /* the surfaces of a fixed size pool are all known to the decoders and
+     * encoders, more of them cannot be used */
+    if (hwfc->initial_pool_size > 0 &&
+        avfc->nb_surfaces >= hwfc->initial_pool_size)
+        return NULL;
+
+    vas = vaCreateSurfaces(hwctx->display, priv->rt_format,
+                           hwfc->width, hwfc->height, &surface_id, 1,
+                           priv->attributes, priv->nb_attributes);
+    if (vas != VA_STATUS_SUCCESS) {
+        av_log(hwfc, AV_LOG_ERROR, "Error creating a surface: %d (%s)\n",
+               vas, vaErrorStr(vas));
+        return NULL;
+    }
+
+    ref = av_buffer_create((uint8_t*)(uintptr_t)surface_id, sizeof(surface_id),
+                           vaapi_buffer_free, hwfc, AV_BUFFER_FLAG_READONLY);
+    if (!ref) {
+        vaDestroySurfaces(hwctx->display, &surface_id, 1);
+        return NULL;
+    }
+
+    if (hwfc->initial_pool_size > 0)
+        avfc->surface_ids[avfc->nb_surfaces++] = surface_id;
+
+    return ref;
+}
+
+static int vaapi_frames_init(AVHWFramesContext *hwfc)
+{
+    AVVAAPIFramesContext  *avfc = hwfc->hwctx;
+    VAAPIFramesContext    *priv = hwfc->internal->priv;
+    AVVAAPIDeviceContext *hwctx = hwfc->device_ctx->hwctx;
+    const VAImageFormat *expected_format;
+    AVBufferRef *test_surface = NULL;
+    VASurfaceID test_surface_id;
+    VAImage test_image;
+    VAStatus vas;
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(vaapi_format_map); i++) {
+        if (vaapi_format_map[i].pix_fmt == hwfc->sw_format) {
+            priv->rt_format = vaapi_format_map[i].rt_format;
+            break;
+        }
+    }
+    expected_format = vaapi_get_image_format(hwfc->device_ctx, hwfc->sw_format);
+    if (i == FF_ARRAY_ELEMS(vaapi_format_map) || !expected_format) {
+        av_log(hwfc, AV_LOG_ERROR, "Unsupported data layout: %s\n",
+               av_get_pix_fmt_name(hwfc->sw_format));
+        return AVERROR(ENOSYS);
+    }
+
+    if (!hwfc->pool) {
+        /* the layout of the surfaces is set explicitly, as the default one
+         * of the driver may not be the sw_format */
+        priv->nb_attributes = avfc->nb_attributes + 1;
+        priv->attributes = av_malloc_array(priv->nb_attributes,
+                                           sizeof(*priv->attributes));
+        if (!priv->attributes)
+            return AVERROR(ENOMEM);
+        if (avfc->nb_attributes)
+            memcpy(priv->attributes, avfc->attributes,
+                   avfc->nb_attributes * sizeof(*priv->attributes));
+        priv->attributes[avfc->nb_attributes] = (VASurfaceAttrib) {
+            .type          = VASurfaceAttribPixelFormat,
+            .flags         = VA_SURFACE_ATTRIB_SETTABLE,
+            .value.type    = VAGenericValueTypeInteger,
+            .value.value.i = expected_format->fourcc,
+        };
+
+        if (hwfc->initial_pool_size > 0) {
+            avfc->surface_ids = av_malloc_array(hwfc->initial_pool_size,
+                                                sizeof(*avfc->surface_ids));
+            if (!avfc->surface_ids)
+                return AVERROR(ENOMEM);
+        }
+        avfc->nb_surfaces = 0;
+
+        hwfc->internal->pool_internal = av_buffer_pool_init2(sizeof(VASurfaceID), hwfc,
+                                                             vaapi_pool_alloc, NULL);
+        if (!hwfc->internal->pool_internal)
+            return AVERROR(ENOMEM);
+    }
+
+    /* check whether the surfaces can be mapped directly */
+    test_surface = av_buffer_pool_get(hwfc->pool ? hwfc->pool :
+                                      hwfc->internal->pool_internal);
+    if (!test_surface) {
+        av_log(hwfc, AV_LOG_ERROR, "Unable to allocate a surface from the pool\n");
+        return AVERROR(ENOMEM);
+    }
+    test_surface_id = (VASurfaceID)(uintptr_t)test_surface->data;
+
+    priv->derive_works = 0;
+    vas = vaDeriveImage(hwctx->display, test_surface_id, &test_image);
+    if (vas == VA_STATUS_SUCCESS) {
+        if (test_image.format.fourcc == expected_format->fourcc) {
+            av_log(hwfc, AV_LOG_DEBUG, "Direct mapping possible.\n");
+            priv->derive_works = 1;
+        } else {
+            av_log(hwfc, AV_LOG_DEBUG, "Direct mapping disabled: derived "
+                   "image format %#x does not match expected format %#x.\n",
+                   test_image.format.fourcc, expected_format->fourcc);
+        }
+        vaDestroyImage(hwctx->display, test_image.image_id);
+    } else {
+        av_log(hwfc, AV_LOG_DEBUG, "Direct mapping disabled: deriving image "
+               "does not work: %d (%s).\n", vas, vaErrorStr(vas));
+    }
+
+    /* the test surface is kept in the pool for later use */
+    av_buffer_unref(&test_surface);
+    return 0;
+}
+
+static void vaapi_frames_uninit(AVHWFramesContext *hwfc)
+{
+    AVVAAPIFramesContext *avfc = hwfc->hwctx;
+    VAAPIFramesContext   *priv = hwfc->internal->priv;
+
+    av_freep(&avfc->surface_ids);
+    av_freep(&priv->attributes);
+}
+
+static int vaapi_get_buffer(AVHWFramesContext *hwfc, AVFrame *frame)
+{
+    frame->buf[0] = av_buffer_pool_get(hwfc->pool);
+    if (!frame->buf[0])
+        return AVERROR(ENOMEM);
+
+    frame->data[3] = frame->buf[0]->data;
+    frame->format  = AV_PIX_FMT_VAAPI;
+    frame->width   = hwfc->width;
+    frame->height  = hwfc->height;
+
+    return 0;
+}
+
+static int vaapi_transfer_get_formats(AVHWFramesContext *hwfc,
+                                      enum AVHWFrameTransferDirection dir,
+                                      enum AVPixelFormat **formats)
+{
+    VAAPIDeviceContext *device_priv = hwfc->device_ctx->internal->priv;
+    enum AVPixelFormat *pix_fmts;
+    int i, j, k;
+
+    /* the sw_format comes first, since it can be mapped without conversion */
+    pix_fmts = av_malloc_array(device_priv->nb_formats + 2, sizeof(*pix_fmts));
+    if (!pix_fmts)
+        return AVERROR(ENOMEM);
+
+    k = 0;
+    pix_fmts[k++] = hwfc->sw_format;
+    for (i = 0; i < device_priv->nb_formats; i++) {
+        enum AVPixelFormat pix_fmt = device_priv->formats[i].pix_fmt;
+        for (j = 0; j < k; j++)
+            if (pix_fmts[j] == pix_fmt)
+                break;
+        if (j == k)
+            pix_fmts[k++] = pix_fmt;
+    }
+    pix_fmts[k] = AV_PIX_FMT_NONE;
+
+    *formats = pix_fmts;
+    return 0;
+}
+
+static void vaapi_unmap_frame(void *opaque, uint8_t *data)
+{
+    VAAPISurfaceMap       *map = opaque;
+    AVHWFramesContext    *hwfc = map->hwfc;
+    AVVAAPIDeviceContext *hwctx = hwfc->device_ctx->hwctx;
+    VAStatus vas;
+
+    vas = vaUnmapBuffer(hwctx->display, map->image.buf);
+    if (vas != VA_STATUS_SUCCESS)
+        av_log(hwfc, AV_LOG_ERROR, "Error unmapping image from surface "
+               "%#x: %d (%s)\n", map->surface_id, vas, vaErrorStr(vas));
+
+    if ((map->flags & VAAPI_MAP_WRITE) && !(map->flags & VAAPI_MAP_DIRECT)) {
+        vas = vaPutImage(hwctx->display, map->surface_id, map->image.image_id,
+                         0, 0, hwfc->width, hwfc->height,
+                         0, 0, hwfc->width, hwfc->height);
+        if (vas != VA_STATUS_SUCCESS)
+            av_log(hwfc, AV_LOG_ERROR, "Error writing image to surface "
+                   "%#x: %d (%s)\n", map->surface_id, vas, vaErrorStr(vas));
+    }
+
+    vas = vaDestroyImage(hwctx->display, map->image.image_id);
+    if (vas != VA_STATUS_SUCCESS)
+        av_log(hwfc, AV_LOG_ERROR, "Error destroying image from surface "
+               "%#x: %d (%s)\n", map->surface_id, vas, vaErrorStr(vas));
+
+    av_free(map);
+}
+
+/**
+ * Map a surface to memory, as a frame of format dst->format (or the
+ * sw_format when not set). With a derived image, the memory is the surface
+ * itself, otherwise it is an image copied from the surface when reading,
+ * and copied to the surface when unmapping after writing.
+ */
+static int vaapi_map_frame(AVHWFramesContext *hwfc,
+                           AVFrame *dst, const AVFrame *src, int flags)
+{
+    AVVAAPIDeviceContext *hwctx = hwfc->device_ctx->hwctx;
+    VAAPIFramesContext    *priv = hwfc->internal->priv;
+    VASurfaceID surface_id      = (VASurfaceID)(uintptr_t)src->data[3];
+    const VAImageFormat *image_format;
+    VAAPISurfaceMap *map;
+    void *address = NULL;
+    VAStatus vas;
+    int i, err;
+
+    if (dst->format == AV_PIX_FMT_NONE)
+        dst->format = hwfc->sw_format;
+    if ((flags & VAAPI_MAP_DIRECT) &&
+        (!priv->derive_works || dst->format != hwfc->sw_format))
+        return AVERROR(ENOSYS);
+
+    image_format = vaapi_get_image_format(hwfc->device_ctx, dst->format);
+    if (!image_format) {
+        av_log(hwfc, AV_LOG_ERROR, "Unsupported pixel format: %s\n",
+               av_get_pix_fmt_name(dst->format));
+        return AVERROR(EINVAL);
+    }
+
+    map = av_mallocz(sizeof(*map));
+    if (!map)
+        return AVERROR(ENOMEM);
+    map->hwfc           = hwfc;
+    map->surface_id     = surface_id;
+    map->flags          = flags;
+    map->image.image_id = VA_INVALID_ID;
+
+    vas = vaSyncSurface(hwctx->display, surface_id);
+    if (vas != VA_STATUS_SUCCESS) {
+        av_log(hwfc, AV_LOG_ERROR, "Failed to sync surface %#x: %d (%s)\n",
+               surface_id, vas, vaErrorStr(vas));
+        err = AVERROR(EIO);
+        goto fail;
+    }
+
+    if (priv->derive_works && dst->format == hwfc->sw_format) {
+        vas = vaDeriveImage(hwctx->display, surface_id, &map->image);
+        if (vas != VA_STATUS_SUCCESS) {
+            av_log(hwfc, AV_LOG_ERROR, "Failed to derive image from surface "
+                   "%#x: %d (%s)\n", surface_id, vas, vaErrorStr(vas));
+            err = AVERROR(EIO);
+            goto fail;
+        }
+        map->flags |= VAAPI_MAP_DIRECT;
+    } else {
+        vas = vaCreateImage(hwctx->display, (VAImageFormat*)image_format,
+                            hwfc->width, hwfc->height, &map->image);
+        if (vas != VA_STATUS_SUCCESS) {
+            av_log(hwfc, AV_LOG_ERROR, "Failed to create image for surface "
+                   "%#x: %d (%s)\n", surface_id, vas, vaErrorStr(vas));
+            err = AVERROR(EIO);
+            goto fail;
+        }
+        if (flags & VAAPI_MAP_READ) {
+            vas = vaGetImage(hwctx->display, surface_id, 0, 0,
+                             hwfc->width, hwfc->height, map->image.image_id);
+            if (vas != VA_STATUS_SUCCESS) {
+                av_log(hwfc, AV_LOG_ERROR, "Failed to read image from surface "
+                       "%#x: %d (%s)\n", surface_id, vas, vaErrorStr(vas));
+                err = AVERROR(EIO);
+                goto fail;
+            }
+        }
+    }
+
+    vas = vaMapBuffer(hwctx->display, map->image.buf, &address);
+    if (vas != VA_STATUS_SUCCESS) {
+        av_log(hwfc, AV_LOG_ERROR, "Failed to map image from surface "
+               "%#x: %d (%s)\n", surface_id, vas, vaErrorStr(vas));
+        err = AVERROR(EIO);
+        goto fail;
+    }
+
+    dst->buf[0] = av_buffer_create(address, map->image.data_size,
+                                   vaapi_unmap_frame, map, 0);
+    if (!dst->buf[0]) {
+        vaUnmapBuffer(hwctx->display, map->image.buf);
+        err = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    for (i = 0; i < map->image.num_planes; i++) {
+        dst->data[i]     = (uint8_t*)address + map->image.offsets[i];
+        dst->linesize[i] = map->image.pitches[i];
+    }
+    if (vaapi_is_uv_swapped(map->image.format.fourcc)) {
+        FFSWAP(uint8_t*, dst->data[1], dst->data[2]);
+        FFSWAP(int, dst->linesize[1], dst->linesize[2]);
+    }
+    dst->width  = src->width;
+    dst->height = src->height;
+
+    return 0;
+
+fail:
+    if (map->image.image_id != VA_INVALID_ID)
+        vaDestroyImage(hwctx->display, map->image.image_id);
+    av_free(map);
+    return err;
+}
+
+static int vaapi_transfer_data_from(AVHWFramesContext *hwfc,
+                                    AVFrame *dst, const AVFrame *src)
+{
+    AVFrame *map;
+    int err;
+
+    map = av_frame_alloc();
+    if (!map)
+        return AVERROR(ENOMEM);
+    map->format = dst->format;
+
+    err = vaapi_map_frame(hwfc, map, src, VAAPI_MAP_READ);
+    if (err < 0)
+        goto fail;
+
+    map->width  = dst->width;
+    map->height = dst->height;
+    err = av_frame_copy(dst, map);
+
+fail:
+    av_frame_free(&map);
+    return err;
+}
+
+static int vaapi_transfer_data_to(AVHWFramesContext *hwfc,
+                                  AVFrame *dst, const AVFrame *src)
+{
+    AVFrame *map;
+    int err;
+
+    map = av_frame_alloc();
+    if (!map)
+        return AVERROR(ENOMEM);
+    map->format = src->format;
+
+    err = vaapi_map_frame(hwfc, map, dst, VAAPI_MAP_WRITE);
+    if (err < 0)
+        goto fail;
+
+    map->width  = src->width;
+    map->height = src->height;
+    err = av_frame_copy(map, src);
+
+fail:
+    /* the image is written to the surface when unmapped */
+    av_frame_free(&map);
+    return err;
+}
+
+const HWContextType ff_hwcontext_type_vaapi = {
+    .type                 = AV_HWDEVICE_TYPE_VAAPI,
+    .name                 = "VAAPI",
+
+    .device_hwctx_size    = sizeof(AVVAAPIDeviceContext),
+    .device_priv_size     = sizeof(VAAPIDeviceContext),
+    .frames_hwctx_size    = sizeof(AVVAAPIFramesContext),
+    .frames_priv_size     = sizeof(VAAPIFramesContext),
+
+    .device_init          = vaapi_device_init,
+    .device_uninit        = vaapi_device_uninit,
+    .frames_init          = vaapi_frames_init,
+    .frames_uninit        = vaapi_frames_uninit,
+    .frames_get_buffer    = vaapi_get_buffer,
+    .transfer_get_formats = vaapi_transfer_get_formats,
+    .transfer_data_to     = vaapi_transfer_data_to,
+    .transfer_data_from   = vaapi_transfer_data_from,
+
+    .pix_fmts = (const enum AVPixelFormat[]){ AV_PIX_FMT_VAAPI, AV_PIX_FMT_NONE },
+};
@@ -0,0 +1,71 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_HWCONTEXT_VAAPI_H
+#define AVUTIL_HWCONTEXT_VAAPI_H
+
+#include <va/va.h>
+
+/**
+ * @file
+ * An API-specific header for AV_HWDEVICE_TYPE_VAAPI.
+ *
+ * This API supports dynamic frame pools, but a pool used as the render
+ * target of a decoder or an encoder must have a fixed size (i.e.
+ * AVHWFramesContext.initial_pool_size must be set), since vaCreateContext()
+ * needs the list of all the surfaces.
+ *
+ * AVHWFramesContext.pool must return AVBufferRefs whose data pointer is a
+ * VASurfaceID, cast to a pointer with (uint8_t*)(uintptr_t).
+ *
+ * The sw_format of the frames context is the exact layout of the surfaces,
+ * e.g. AV_PIX_FMT_NV12 for the usual 8-bit 4:2:0 YUV surfaces.
+ */
+
+/**
+ * This struct is allocated as AVHWDeviceContext.hwctx
+ */
+typedef struct AVVAAPIDeviceContext {
+    /**
+     * The VADisplay handle, already initialized with vaInitialize() by the
+     * caller, who also terminates it when the device is freed.
+     */
+    VADisplay display;
+} AVVAAPIDeviceContext;
+
+/**
+ * This struct is allocated as AVHWFramesContext.hwctx
+ */
+typedef struct AVVAAPIFramesContext {
+    /**
+     * Set by the user to apply surface attributes to all the surfaces in
+     * the frame pool. If null, default settings are used.
+     */
+    VASurfaceAttrib *attributes;
+    int           nb_attributes;
+    /**
+     * The surfaces IDs of all the surfaces in the pool after creation.
+     * Only valid if AVHWFramesContext.initial_pool_size was positive.
+     * These are intended to be used as the render_targets arguments to
+     * vaCreateContext().
+     */
+    VASurfaceID     *surface_ids;
+    int           nb_surfaces;
+} AVVAAPIFramesContext;
+
+#endif /* AVUTIL_HWCONTEXT_VAAPI_H */
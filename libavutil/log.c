@@ -245,17 +245,16 @@ static const char *get_level_str(int level)
     }
 }
 
-static void format_line(void *avcl, int level, const char *fmt, va_list vl,
-                        AVBPrint part[4], int *print_prefix, int type[2])
+static void format_prefix(void *avcl, int level, AVBPrint part[3],
+                          int print_prefix, int type[2])
 {
     AVClass* avc = avcl ? *(AVClass **) avcl : NULL;
     av_bprint_init(part+0, 0, 1);
     av_bprint_init(part+1, 0, 1);
     av_bprint_init(part+2, 0, 1);
-    av_bprint_init(part+3, 0, 65536);
 
     if(type) type[0] = type[1] = AV_CLASS_CATEGORY_NA + 16;
-    if (*print_prefix && avc) {
+    if (print_prefix && avc) {
         if (avc->parent_log_context_offset) {
             AVClass** parent = *(AVClass ***) (((uint8_t *) avcl) +
                                    avc->parent_log_context_offset);
@@ -272,15 +271,25 @@ static void format_line(void *avcl, int level, const char *fmt, va_list vl,
         if (flags & AV_LOG_PRINT_LEVEL)
             av_bprintf(part+2, "[%s] ", get_level_str(level));
     }
+}
 
-    av_vbprintf(part+3, fmt, vl);
-
+static void update_print_prefix(AVBPrint part[4], int *print_prefix)
+{
     if(*part[0].str || *part[1].str || *part[2].str || *part[3].str) {
         char lastc = part[3].len && part[3].len <= part[3].size ? part[3].str[part[3].len - 1] : 0;
         *print_prefix = lastc == '\n' || lastc == '\r';
     }
 }
 
+static void format_line(void *avcl, int level, const char *fmt, va_list vl,
+                        AVBPrint part[4], int *print_prefix, int type[2])
+{
+    format_prefix(avcl, level, part, *print_prefix, type);
+    av_bprint_init(part+3, 0, 65536);
+    av_vbprintf(part+3, fmt, vl);
+    update_print_prefix(part, print_prefix);
+}
+
 void av_log_format_line(void *ptr, int level, const char *fmt, va_list vl,
                         char *line, int line_size, int *print_prefix)
 {
@@ -290,6 +299,22 @@ void av_log_format_line(void *ptr, int level, const char *fmt, va_list vl,
     av_bprint_finalize(part+3, NULL);
 }
 
+/* stderr is unbuffered, without colors write the line with a single call */
+static int write_line(AVBPrint part[4])
+{
+    AVBPrint out;
+    int ret = 0;
+
+    av_bprint_init(&out, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&out, "%s%s%s%s", part[0].str, part[1].str, part[2].str, part[3].str);
+    if (av_bprint_is_complete(&out))
+        fputs(out.str, stderr);
+    else
+        ret = AVERROR(ENOMEM);
+    av_bprint_finalize(&out, NULL);
+    return ret;
+}
+
 void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
 {
     static int print_prefix = 1;
@@ -308,11 +333,17 @@ void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
 
     if (level > av_log_level)
         return;
+
+    /* the message does not depend on the shared state, only the prefix does */
+    av_bprint_init(part+3, 0, 65536);
+    av_vbprintf(part+3, fmt, vl);
+
 #if HAVE_PTHREADS
     pthread_mutex_lock(&mutex);
 #endif
 
-    format_line(ptr, level, fmt, vl, part, &print_prefix, type);
+    format_prefix(ptr, level, part, print_prefix, type);
+    update_print_prefix(part, &print_prefix);
     snprintf(line, sizeof(line), "%s%s%s%s", part[0].str, part[1].str, part[2].str, part[3].str);
 
 #if HAVE_ISATTY
@@ -333,13 +364,17 @@ void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
     }
     strcpy(prev, line);
     sanitize(part[0].str);
-    colored_fputs(type[0], 0, part[0].str);
     sanitize(part[1].str);
-    colored_fputs(type[1], 0, part[1].str);
     sanitize(part[2].str);
-    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[2].str);
     sanitize(part[3].str);
-    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[3].str);
+    if (use_color < 0)
+        check_color_terminal();
+    if (use_color || write_line(part) < 0) {
+        colored_fputs(type[0], 0, part[0].str);
+        colored_fputs(type[1], 0, part[1].str);
+        colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[2].str);
+        colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[3].str);
+    }
 
 #if CONFIG_VALGRIND_BACKTRACE
     if (level <= BACKTRACE_LOGLEVEL)
@@ -35,6 +35,9 @@
 #if HAVE_MALLOC_H
 #include <malloc.h>
 #endif
+#if CONFIG_MEMORY_TRACKING
+#include <pthread.h>
+#endif
 
 #include "avassert.h"
 #include "avutil.h"
@@ -74,6 +77,169 @@ void av_max_alloc(size_t max){
     max_alloc_size = max;
 }
 
+#if CONFIG_MEMORY_TRACKING
+/* Each allocation is preceded by a header of ALIGN bytes recording its size
+ * and the usage it is accounted against. */
+#define HEADER_SIZE ALIGN
+
+typedef struct MemUsage {
+    const void *ctx;            ///< tagged context, NULL once released
+    int64_t current, peak;
+    struct MemUsage *next;
+} MemUsage;
+
+typedef struct MemHeader {
+    size_t size;
+    MemUsage *usage;
+} MemHeader;
+
+static MemUsage total_usage;
+static MemUsage *usages;
+static pthread_mutex_t usage_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t usage_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t usage_key;
+
+static void usage_key_init(void)
+{
+    pthread_key_create(&usage_key, NULL);
+}
+
+static MemUsage *current_usage(void)
+{
+    pthread_once(&usage_key_once, usage_key_init);
+    return pthread_getspecific(usage_key);
+}
+
+static void account(MemUsage *usage, int64_t delta)
+{
+    pthread_mutex_lock(&usage_mutex);
+    total_usage.current += delta;
+    total_usage.peak     = FFMAX(total_usage.peak, total_usage.current);
+    if (usage) {
+        usage->current += delta;
+        usage->peak     = FFMAX(usage->peak, usage->current);
+    }
+    pthread_mutex_unlock(&usage_mutex);
+}
+
+static void *track_alloc(void *ptr, size_t size)
+{
+    MemHeader *hdr = ptr;
+
+    hdr->size  = size;
+    hdr->usage = current_usage();
+    account(hdr->usage, size);
+    return (char *)ptr + HEADER_SIZE;
+}
+
+static void *track_free(void *ptr)
+{
+    MemHeader *hdr = (MemHeader *)((char *)ptr - HEADER_SIZE);
+
+    account(hdr->usage, -(int64_t)hdr->size);
+    return hdr;
+}
+
+static MemUsage *find_usage(const void *ctx)
+{
+    MemUsage *usage;
+
+    for (usage = usages; usage; usage = usage->next)
+        if (usage->ctx == ctx)
+            return usage;
+    return NULL;
+}
+#endif
+
+void *av_mem_set_context(void *avcl)
+{
+#if CONFIG_MEMORY_TRACKING
+    MemUsage *prev = current_usage(), *usage = NULL;
+    void *prev_ctx;
+
+    pthread_mutex_lock(&usage_mutex);
+    prev_ctx = prev ? (void *)prev->ctx : NULL;
+    if (avcl && !(usage = find_usage(avcl))) {
+        /* reuse a released usage once nothing is accounted against it */
+        for (usage = usages; usage; usage = usage->next)
+            if (!usage->ctx && !usage->current)
+                break;
+        if (!usage && (usage = malloc(sizeof(*usage)))) {
+            usage->next = usages;
+            usages      = usage;
+        }
+        if (usage) {
+            usage->ctx     = avcl;
+            usage->current = 0;
+            usage->peak    = 0;
+        }
+    }
+    pthread_mutex_unlock(&usage_mutex);
+
+    pthread_setspecific(usage_key, usage);
+    return prev_ctx;
+#else
+    return NULL;
+#endif
+}
+
+void *avpriv_mem_enter(void *avcl)
+{
+#if CONFIG_MEMORY_TRACKING
+    MemUsage *usage = current_usage();
+    void *ctx;
+
+    if (!usage)
+        return av_mem_set_context(avcl);
+
+    pthread_mutex_lock(&usage_mutex);
+    ctx = (void *)usage->ctx;
+    pthread_mutex_unlock(&usage_mutex);
+    return ctx;
+#else
+    return NULL;
+#endif
+}
+
+void av_mem_release_context(const void *avcl)
+{
+#if CONFIG_MEMORY_TRACKING
+    MemUsage *usage;
+    int64_t peak = 0;
+
+    pthread_mutex_lock(&usage_mutex);
+    if ((usage = find_usage(avcl))) {
+        usage->ctx = NULL;
+        peak       = usage->peak;
+    }
+    pthread_mutex_unlock(&usage_mutex);
+
+    if (usage)
+        av_log((void *)avcl, AV_LOG_DEBUG, "Peak memory usage: %"PRId64" bytes\n", peak);
+#endif
+}
+
+int av_mem_get_usage(const void *avcl, int64_t *current, int64_t *peak)
+{
+#if CONFIG_MEMORY_TRACKING
+    MemUsage *usage;
+
+    pthread_mutex_lock(&usage_mutex);
+    usage = avcl ? find_usage(avcl) : &total_usage;
+    if (usage) {
+        if (current)
+            *current = usage->current;
+        if (peak)
+            *peak    = usage->peak;
+    }
+    pthread_mutex_unlock(&usage_mutex);
+
+    return usage ? 0 : AVERROR(ENOENT);
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
 void *av_malloc(size_t size)
 {
     void *ptr = NULL;
@@ -85,6 +251,12 @@ void *av_malloc(size_t size)
     if (size > (max_alloc_size - 32))
         return NULL;
 
+#if CONFIG_MEMORY_TRACKING
+    if (size > SIZE_MAX - HEADER_SIZE)
+        return NULL;
+    size += HEADER_SIZE;
+#endif
+
 #if CONFIG_MEMALIGN_HACK
     ptr = malloc(size + ALIGN);
     if (!ptr)
@@ -135,6 +307,12 @@ void *av_malloc(size_t size)
         size = 1;
         ptr= av_malloc(1);
     }
+#if CONFIG_MEMORY_TRACKING
+    if (ptr) {
+        size -= HEADER_SIZE;
+        ptr   = track_alloc(ptr, size);
+    }
+#endif
 #if CONFIG_MEMORY_POISONING
     if (ptr)
         memset(ptr, FF_MEMORY_POISON, size);
@@ -142,16 +320,12 @@ void *av_malloc(size_t size)
     return ptr;
 }
 
-void *av_realloc(void *ptr, size_t size)
+static void *mem_realloc(void *ptr, size_t size)
 {
 #if CONFIG_MEMALIGN_HACK
     int diff;
 #endif
 
-    /* let's disallow possibly ambiguous cases */
-    if (size > (max_alloc_size - 32))
-        return NULL;
-
 #if CONFIG_MEMALIGN_HACK
     //FIXME this isn't aligned correctly, though it probably isn't needed
     if (!ptr)
@@ -169,6 +343,34 @@ void *av_realloc(void *ptr, size_t size)
 #endif
 }
 
+void *av_realloc(void *ptr, size_t size)
+{
+#if CONFIG_MEMORY_TRACKING
+    MemHeader *hdr;
+    size_t old_size;
+#endif
+
+    /* let's disallow possibly ambiguous cases */
+    if (size > (max_alloc_size - 32))
+        return NULL;
+
+#if CONFIG_MEMORY_TRACKING
+    if (!ptr)
+        return av_malloc(size);
+    if (size > SIZE_MAX - HEADER_SIZE)
+        return NULL;
+    hdr      = (MemHeader *)((char *)ptr - HEADER_SIZE);
+    old_size = hdr->size;
+    if (!(hdr = mem_realloc(hdr, size + HEADER_SIZE)))
+        return NULL;
+    hdr->size = size;
+    account(hdr->usage, (int64_t)size - (int64_t)old_size);
+    return (char *)hdr + HEADER_SIZE;
+#else
+    return mem_realloc(ptr, size);
+#endif
+}
+
 void *av_realloc_f(void *ptr, size_t nelem, size_t elsize)
 {
     size_t size;
@@ -227,6 +429,11 @@ int av_reallocp_array(void *ptr, size_t nmemb, size_t size)
 
 void av_free(void *ptr)
 {
+#if CONFIG_MEMORY_TRACKING
+    if (!ptr)
+        return;
+    ptr = track_free(ptr);
+#endif
 #if CONFIG_MEMALIGN_HACK
     if (ptr) {
         int v= ((char *)ptr)[-1];
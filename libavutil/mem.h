@@ -399,6 +399,51 @@ void av_fast_malloc(void *ptr, unsigned int *size, size_t min_size);
  */
 void av_fast_mallocz(void *ptr, unsigned int *size, size_t min_size);
 
+/**
+ * @defgroup lavu_mem_tracking Memory accounting
+ *
+ * When FFmpeg is configured with --enable-memory-tracking, the heap memory
+ * allocated with the functions above is accounted, in total and against the
+ * context that is current in the allocating thread. The codec and
+ * filtergraph API functions and their worker threads make their context
+ * current, so that the usage of a codec context includes its frame threads
+ * and frame pools, and the usage of a filtergraph its filters and frame
+ * pools. The memory is accounted against its allocating context until it
+ * is freed, even when that happens elsewhere.
+ *
+ * @{
+ */
+
+/**
+ * Make a context current for the memory accounting of the calling thread.
+ *
+ * @param avcl a pointer to a struct whose first field is a pointer to an
+ *             AVClass, or NULL to stop accounting against a context
+ * @return the context previously current, to be restored with this function
+ *         when done
+ */
+void *av_mem_set_context(void *avcl);
+
+/**
+ * Stop accounting against a context, to be called when it is freed.
+ */
+void av_mem_release_context(const void *avcl);
+
+/**
+ * Get the memory usage of a context.
+ *
+ * @param avcl    the context, or NULL for the total usage
+ * @param current if not NULL, set to the number of bytes currently allocated
+ * @param peak    if not NULL, set to the maximum of current
+ * @return 0 on success, AVERROR(ENOENT) if nothing was accounted against
+ *         avcl, AVERROR(ENOSYS) if the memory is not tracked
+ */
+int av_mem_get_usage(const void *avcl, int64_t *current, int64_t *peak);
+
+/**
+ * @}
+ */
+
 /**
  * @}
  */
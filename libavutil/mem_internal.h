@@ -42,4 +42,15 @@ static inline int ff_fast_malloc(void *ptr, unsigned int *size, size_t min_size,
     *size = min_size;
     return 1;
 }
+
+/**
+ * Make a context current for the memory accounting of the calling thread,
+ * unless one already is, so that the library calls made by another one,
+ * like a decoder opening a nested decoder, are accounted against the
+ * outermost context.
+ *
+ * @return the context to restore with av_mem_set_context() when done
+ */
+void *avpriv_mem_enter(void *avcl);
+
 #endif /* AVUTIL_MEM_INTERNAL_H */
@@ -28,6 +28,7 @@
 #include "avutil.h"
 #include "avassert.h"
 #include "avstring.h"
+#include "atomic.h"
 #include "channel_layout.h"
 #include "common.h"
 #include "opt.h"
@@ -1500,11 +1501,101 @@ const AVOption *av_opt_find(void *obj, const char *name, const char *unit,
     return av_opt_find2(obj, name, unit, opt_flags, search_flags, NULL);
 }
 
+/**
+ * Options of a class sorted by name, options with the same name staying in
+ * their original order. The indexes are built on the first lookup and kept
+ * for the lifetime of the process, in a fixed size table keyed by the address
+ * of the AVClass.
+ *
+ * This assumes that the AVClass and its option table are static, as all the
+ * classes in the libraries are: a class allocated at runtime could be freed
+ * and another one later allocated at the same address. Such a class is only
+ * detected if its option table moved; its options must not be changed in
+ * place after the first lookup. Lookups for classes that do not get an index,
+ * because the table is full or an allocation failed, fall back to a linear
+ * scan of the options.
+ */
+typedef struct OptIndex {
+    const AVClass *class;
+    const AVOption *option;     ///< option table the index was built from
+    int nb_opts;
+    const AVOption **opts;
+} OptIndex;
+
+#define OPT_INDEX_SIZE  4096    ///< number of slots, power of 2
+#define OPT_INDEX_PROBE 32      ///< slots tried before giving up
+
+static OptIndex *volatile opt_index[OPT_INDEX_SIZE];
+
+static int compare_opt(const void *a, const void *b)
+{
+    const AVOption *oa = *(const AVOption * const *)a;
+    const AVOption *ob = *(const AVOption * const *)b;
+    int ret = strcmp(oa->name, ob->name);
+
+    return ret ? ret : (oa > ob) - (oa < ob);
+}
+
+static OptIndex *build_opt_index(const AVClass *c)
+{
+    OptIndex *idx;
+    int i, nb_opts = 0;
+
+    while (c->option && c->option[nb_opts].name)
+        nb_opts++;
+    idx = av_malloc(sizeof(*idx) + nb_opts * sizeof(*idx->opts));
+    if (!idx)
+        return NULL;
+    idx->class   = c;
+    idx->option  = c->option;
+    idx->nb_opts = nb_opts;
+    idx->opts    = (const AVOption **)(idx + 1);
+    for (i = 0; i < nb_opts; i++)
+        idx->opts[i] = &c->option[i];
+    qsort(idx->opts, nb_opts, sizeof(*idx->opts), compare_opt);
+    return idx;
+}
+
+static const OptIndex *get_opt_index(const AVClass *c)
+{
+    unsigned hash = (uintptr_t)c / sizeof(void *) * 2654435761U;
+    OptIndex *idx, *new_idx = NULL;
+    int i;
+
+    for (i = 0; i < OPT_INDEX_PROBE; i++) {
+        OptIndex *volatile *slot = &opt_index[(hash + i) & (OPT_INDEX_SIZE - 1)];
+
+        idx = *slot;
+        if (!idx) {
+            if (!new_idx && !(new_idx = build_opt_index(c)))
+                return NULL;
+            idx = avpriv_atomic_ptr_cas((void * volatile *)slot, NULL, new_idx);
+            if (!idx)
+                return new_idx;
+        }
+        if (idx->class == c) {
+            av_free(new_idx);
+            return idx->option == c->option ? idx : NULL;
+        }
+    }
+    /* the table is full around this class, use the linear scan */
+    av_free(new_idx);
+    return NULL;
+}
+
+static int option_matches(const AVOption *o, const char *unit, int opt_flags)
+{
+    return (o->flags & opt_flags) == opt_flags &&
+           ((!unit && o->type != AV_OPT_TYPE_CONST) ||
+            (unit  && o->type == AV_OPT_TYPE_CONST && o->unit && !strcmp(o->unit, unit)));
+}
+
 const AVOption *av_opt_find2(void *obj, const char *name, const char *unit,
                              int opt_flags, int search_flags, void **target_obj)
 {
     const AVClass  *c;
     const AVOption *o = NULL;
+    const OptIndex *idx;
 
     if(!obj)
         return NULL;
@@ -1528,20 +1619,35 @@ const AVOption *av_opt_find2(void *obj, const char *name, const char *unit,
         }
     }
 
-    while (o = av_opt_next(obj, o)) {
-        if (!strcmp(o->name, name) && (o->flags & opt_flags) == opt_flags &&
-            ((!unit && o->type != AV_OPT_TYPE_CONST) ||
-             (unit  && o->type == AV_OPT_TYPE_CONST && o->unit && !strcmp(o->unit, unit)))) {
-            if (target_obj) {
-                if (!(search_flags & AV_OPT_SEARCH_FAKE_OBJ))
-                    *target_obj = obj;
-                else
-                    *target_obj = NULL;
+    if (idx = get_opt_index(c)) {
+        int lo = 0, hi = idx->nb_opts;
+
+        while (lo < hi) {
+            int mid = (lo + hi) >> 1;
+            if (strcmp(idx->opts[mid]->name, name) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (o = NULL; lo < idx->nb_opts && !strcmp(idx->opts[lo]->name, name); lo++) {
+            if (option_matches(idx->opts[lo], unit, opt_flags)) {
+                o = idx->opts[lo];
+                break;
             }
-            return o;
         }
+    } else {
+        while (o = av_opt_next(obj, o))
+            if (!strcmp(o->name, name) && option_matches(o, unit, opt_flags))
+                break;
     }
-    return NULL;
+
+    if (o && target_obj) {
+        if (!(search_flags & AV_OPT_SEARCH_FAKE_OBJ))
+            *target_obj = obj;
+        else
+            *target_obj = NULL;
+    }
+    return o;
 }
 
 void *av_opt_child_next(void *obj, void *prev)
@@ -40,28 +40,142 @@ static av_always_inline int sad_wxh(const uint8_t *src1, ptrdiff_t stride1,
     return sum;
 }
 
+static av_always_inline int sad16_wxh(const uint8_t *_src1, ptrdiff_t stride1,
+                                      const uint8_t *_src2, ptrdiff_t stride2,
+                                      int w, int h)
+{
+    int x, y, sum = 0;
+
+    for (y = 0; y < h; y++) {
+        const uint16_t *src1 = (const uint16_t *)_src1;
+        const uint16_t *src2 = (const uint16_t *)_src2;
+
+        for (x = 0; x < w; x++)
+            sum += abs(src1[x] - src2[x]);
+        _src1 += stride1;
+        _src2 += stride2;
+    }
+    return sum;
+}
+
 #define DECLARE_BLOCK_FUNCTIONS(size)                                               \
 static int block_sad_##size##x##size##_c(const uint8_t *src1, ptrdiff_t stride1,    \
                                          const uint8_t *src2, ptrdiff_t stride2)    \
 {                                                                                   \
     return sad_wxh(src1, stride1, src2, stride2, size, size);                       \
+}                                                                                   \
+                                                                                    \
+static int block_sad16_##size##x##size##_c(const uint8_t *src1, ptrdiff_t stride1,  \
+                                           const uint8_t *src2, ptrdiff_t stride2)  \
+{                                                                                   \
+    return sad16_wxh(src1, stride1, src2, stride2, size, size);                     \
 }
 
 DECLARE_BLOCK_FUNCTIONS(2)
 DECLARE_BLOCK_FUNCTIONS(4)
 DECLARE_BLOCK_FUNCTIONS(8)
 DECLARE_BLOCK_FUNCTIONS(16)
+DECLARE_BLOCK_FUNCTIONS(32)
+DECLARE_BLOCK_FUNCTIONS(64)
 
 static const av_pixelutils_sad_fn sad_c[] = {
     block_sad_2x2_c,
     block_sad_4x4_c,
     block_sad_8x8_c,
     block_sad_16x16_c,
+    block_sad_32x32_c,
+    block_sad_64x64_c,
+};
+
+static const av_pixelutils_sad_fn sad16_c[] = {
+    block_sad16_2x2_c,
+    block_sad16_4x4_c,
+    block_sad16_8x8_c,
+    block_sad16_16x16_c,
+    block_sad16_32x32_c,
+    block_sad16_64x64_c,
 };
 
+/* The 8-bit SAD row sums fit in 32 bits for any width below 2^24, which
+ * keeps the inner loop simple enough to be vectorized. */
+static uint64_t plane_sad_8_c(const uint8_t *src1, ptrdiff_t stride1,
+                              const uint8_t *src2, ptrdiff_t stride2,
+                              int w, int h)
+{
+    uint64_t sum = 0;
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        uint32_t row = 0;
+        for (x = 0; x < w; x++)
+            row += abs(src1[x] - src2[x]);
+        sum  += row;
+        src1 += stride1;
+        src2 += stride2;
+    }
+    return sum;
+}
+
+static uint64_t plane_sad_16_c(const uint8_t *src1, ptrdiff_t stride1,
+                               const uint8_t *src2, ptrdiff_t stride2,
+                               int w, int h)
+{
+    uint64_t sum = 0;
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        const uint16_t *s1 = (const uint16_t *)src1;
+        const uint16_t *s2 = (const uint16_t *)src2;
+        for (x = 0; x < w; x++)
+            sum += abs(s1[x] - s2[x]);
+        src1 += stride1;
+        src2 += stride2;
+    }
+    return sum;
+}
+
+static uint64_t plane_sse_8_c(const uint8_t *src1, ptrdiff_t stride1,
+                              const uint8_t *src2, ptrdiff_t stride2,
+                              int w, int h)
+{
+    uint64_t sum = 0;
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            int d = src1[x] - src2[x];
+            sum += d * d;
+        }
+        src1 += stride1;
+        src2 += stride2;
+    }
+    return sum;
+}
+
+static uint64_t plane_sse_16_c(const uint8_t *src1, ptrdiff_t stride1,
+                               const uint8_t *src2, ptrdiff_t stride2,
+                               int w, int h)
+{
+    uint64_t sum = 0;
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        const uint16_t *s1 = (const uint16_t *)src1;
+        const uint16_t *s2 = (const uint16_t *)src2;
+        for (x = 0; x < w; x++) {
+            int64_t d = s1[x] - s2[x];
+            sum += d * d;
+        }
+        src1 += stride1;
+        src2 += stride2;
+    }
+    return sum;
+}
+
 #endif /* CONFIG_PIXELUTILS */
 
-av_pixelutils_sad_fn av_pixelutils_get_sad_fn(int w_bits, int h_bits, int aligned, void *log_ctx)
+static av_pixelutils_sad_fn get_sad_fn(int w_bits, int h_bits, int aligned,
+                                       int depth16, void *log_ctx)
 {
 #if !CONFIG_PIXELUTILS
     av_log(log_ctx, AV_LOG_ERROR, "pixelutils support is required "
@@ -70,7 +184,7 @@ av_pixelutils_sad_fn av_pixelutils_get_sad_fn(int w_bits, int h_bits, int aligne
 #else
     av_pixelutils_sad_fn sad[FF_ARRAY_ELEMS(sad_c)];
 
-    memcpy(sad, sad_c, sizeof(sad));
+    memcpy(sad, depth16 ? sad16_c : sad_c, sizeof(sad));
 
     if (w_bits < 1 || w_bits > FF_ARRAY_ELEMS(sad) ||
         h_bits < 1 || h_bits > FF_ARRAY_ELEMS(sad))
@@ -79,13 +193,51 @@ av_pixelutils_sad_fn av_pixelutils_get_sad_fn(int w_bits, int h_bits, int aligne
         return NULL;
 
 #if ARCH_X86
-    ff_pixelutils_sad_init_x86(sad, aligned);
+    if (!depth16)
+        ff_pixelutils_sad_init_x86(sad, aligned);
 #endif
 
     return sad[w_bits - 1];
 #endif
 }
 
+av_pixelutils_sad_fn av_pixelutils_get_sad_fn(int w_bits, int h_bits, int aligned, void *log_ctx)
+{
+    return get_sad_fn(w_bits, h_bits, aligned, 0, log_ctx);
+}
+
+av_pixelutils_sad_fn av_pixelutils_get_sad16_fn(int w_bits, int h_bits, int aligned, void *log_ctx)
+{
+    return get_sad_fn(w_bits, h_bits, aligned, 1, log_ctx);
+}
+
+static av_pixelutils_plane_fn get_plane_fn(int depth, int sse, void *log_ctx)
+{
+#if !CONFIG_PIXELUTILS
+    av_log(log_ctx, AV_LOG_ERROR, "pixelutils support is required "
+           "but libavutil is not compiled with it\n");
+    return NULL;
+#else
+    av_pixelutils_plane_fn sad[2] = { plane_sad_8_c, plane_sad_16_c };
+    av_pixelutils_plane_fn sse_fn[2] = { plane_sse_8_c, plane_sse_16_c };
+
+    if (depth < 1 || depth > 16)
+        return NULL;
+
+    return sse ? sse_fn[depth > 8] : sad[depth > 8];
+#endif
+}
+
+av_pixelutils_plane_fn av_pixelutils_get_plane_sad_fn(int depth, void *log_ctx)
+{
+    return get_plane_fn(depth, 0, log_ctx);
+}
+
+av_pixelutils_plane_fn av_pixelutils_get_plane_sse_fn(int depth, void *log_ctx)
+{
+    return get_plane_fn(depth, 1, log_ctx);
+}
+
 #ifdef TEST
 #define W1 320
 #define H1 240
@@ -95,43 +247,38 @@ av_pixelutils_sad_fn av_pixelutils_get_sad_fn(int w_bits, int h_bits, int aligne
 static int run_single_test(const char *test,
                            const uint8_t *block1, ptrdiff_t stride1,
                            const uint8_t *block2, ptrdiff_t stride2,
-                           int align, int n)
+                           int align, int n, int depth16)
 {
     int out, ref;
-    av_pixelutils_sad_fn f_ref = sad_c[n - 1];
-    av_pixelutils_sad_fn f_out = av_pixelutils_get_sad_fn(n, n, align, NULL);
+    int bps = depth16 ? 2 : 1;
+    av_pixelutils_sad_fn f_ref = depth16 ? sad16_c[n - 1] : sad_c[n - 1];
+    av_pixelutils_sad_fn f_out = depth16 ? av_pixelutils_get_sad16_fn(n, n, align, NULL)
+                                         : av_pixelutils_get_sad_fn(n, n, align, NULL);
 
     switch (align) {
-    case 0: block1++; block2++; break;
-    case 1:           block2++; break;
-    case 2:                     break;
+    case 0: block1 += bps; block2 += bps; break;
+    case 1:                block2 += bps; break;
+    case 2:                               break;
     }
 
     out = f_out(block1, stride1, block2, stride2);
     ref = f_ref(block1, stride1, block2, stride2);
-    printf("[%s] [%c%c] SAD [%s] %dx%d=%d ref=%d\n",
+    printf("[%s] [%c%c] SAD%s [%s] %dx%d=%d ref=%d\n",
            out == ref ? "OK" : "FAIL",
            align ? 'A' : 'U', align == 2 ? 'A' : 'U',
-           test, 1<<n, 1<<n, out, ref);
+           depth16 ? "16" : "", test, 1<<n, 1<<n, out, ref);
     return out != ref;
 }
 
 static int run_test(const char *test,
-                    const uint8_t *b1, const uint8_t *b2)
+                    const uint8_t *b1, const uint8_t *b2, int depth16)
 {
     int i, a, ret = 0;
+    int bps = depth16 ? 2 : 1;
 
     for (a = 0; a < 3; a++) {
-        const uint8_t *block1 = b1;
-        const uint8_t *block2 = b2;
-
-        switch (a) {
-        case 0: block1++; block2++; break;
-        case 1:           block2++; break;
-        case 2:                     break;
-        }
         for (i = 1; i <= FF_ARRAY_ELEMS(sad_c); i++) {
-            int r = run_single_test(test, b1, W1, b2, W2, a, i);
+            int r = run_single_test(test, b1, W1 * bps, b2, W2 * bps, a, i, depth16);
             if (r)
                 ret = r;
         }
@@ -139,14 +286,38 @@ static int run_test(const char *test,
     return ret;
 }
 
+static int run_plane_test(const char *test,
+                          const uint8_t *b1, const uint8_t *b2,
+                          int depth16, int w, int h)
+{
+    int bps = depth16 ? 2 : 1;
+    int depth = depth16 ? 16 : 8;
+    av_pixelutils_plane_fn sad_ref = depth16 ? plane_sad_16_c : plane_sad_8_c;
+    av_pixelutils_plane_fn sse_ref = depth16 ? plane_sse_16_c : plane_sse_8_c;
+    av_pixelutils_plane_fn sad = av_pixelutils_get_plane_sad_fn(depth, NULL);
+    av_pixelutils_plane_fn sse = av_pixelutils_get_plane_sse_fn(depth, NULL);
+    uint64_t out_sad = sad(b1, W1 * bps, b2, W2 * bps, w, h);
+    uint64_t ref_sad = sad_ref(b1, W1 * bps, b2, W2 * bps, w, h);
+    uint64_t out_sse = sse(b1, W1 * bps, b2, W2 * bps, w, h);
+    uint64_t ref_sse = sse_ref(b1, W1 * bps, b2, W2 * bps, w, h);
+
+    printf("[%s] PLANE SAD%d [%s] %dx%d=%"PRIu64" ref=%"PRIu64"\n",
+           out_sad == ref_sad ? "OK" : "FAIL", depth, test, w, h, out_sad, ref_sad);
+    printf("[%s] PLANE SSE%d [%s] %dx%d=%"PRIu64" ref=%"PRIu64"\n",
+           out_sse == ref_sse ? "OK" : "FAIL", depth, test, w, h, out_sse, ref_sse);
+    return out_sad != ref_sad || out_sse != ref_sse;
+}
+
 int main(void)
 {
     int i, align, ret;
     uint8_t *buf1 = av_malloc(W1*H1);
     uint8_t *buf2 = av_malloc(W2*H2);
+    uint16_t *buf16_1 = av_malloc_array(W1*H1, sizeof(*buf16_1));
+    uint16_t *buf16_2 = av_malloc_array(W2*H2, sizeof(*buf16_2));
     uint32_t state = 0;
 
-    if (!buf1 || !buf2) {
+    if (!buf1 || !buf2 || !buf16_1 || !buf16_2) {
         fprintf(stderr, "malloc failure\n");
         ret = 1;
         goto end;
@@ -158,33 +329,33 @@ int main(void)
     int k;                                      \
     for (k = 0; k < size; k++) {                \
         state = state * 1664525 + 1013904223;   \
-        buf[k] = state>>24;                     \
+        buf[k] = state >> (32 - 8 * sizeof(*buf));\
     }                                           \
 } while (0)
 
     /* Normal test with different strides */
     RANDOM_INIT(buf1, W1*H1);
     RANDOM_INIT(buf2, W2*H2);
-    ret = run_test("random", buf1, buf2);
+    ret = run_test("random", buf1, buf2, 0);
     if (ret < 0)
         goto end;
 
     /* Check for maximum SAD */
     memset(buf1, 0xff, W1*H1);
     memset(buf2, 0x00, W2*H2);
-    ret = run_test("max", buf1, buf2);
+    ret = run_test("max", buf1, buf2, 0);
     if (ret < 0)
         goto end;
 
     /* Check for minimum SAD */
     memset(buf1, 0x90, W1*H1);
     memset(buf2, 0x90, W2*H2);
-    ret = run_test("min", buf1, buf2);
+    ret = run_test("min", buf1, buf2, 0);
     if (ret < 0)
         goto end;
 
     /* Exact buffer sizes, to check for overreads */
-    for (i = 1; i <= 4; i++) {
+    for (i = 1; i <= FF_ARRAY_ELEMS(sad_c); i++) {
         for (align = 0; align < 3; align++) {
             int size1, size2;
 
@@ -208,15 +379,64 @@ int main(void)
             }
             RANDOM_INIT(buf1, size1);
             RANDOM_INIT(buf2, size2);
-            ret = run_single_test("small", buf1, 1<<i, buf2, 1<<i, align, i);
+            ret = run_single_test("small", buf1, 1<<i, buf2, 1<<i, align, i, 0);
             if (ret < 0)
                 goto end;
         }
     }
 
+    /* 16-bit samples */
+    RANDOM_INIT(buf16_1, W1*H1);
+    RANDOM_INIT(buf16_2, W2*H2);
+    ret = run_test("random", (uint8_t *)buf16_1, (uint8_t *)buf16_2, 1);
+    if (ret < 0)
+        goto end;
+
+    for (i = 0; i < W1*H1; i++)
+        buf16_1[i] = 0xffff;
+    memset(buf16_2, 0, W2*H2 * sizeof(*buf16_2));
+    ret = run_test("max", (uint8_t *)buf16_1, (uint8_t *)buf16_2, 1);
+    if (ret < 0)
+        goto end;
+
+    /* Whole planes, with widths that are not a multiple of the SIMD width */
+    ret = run_plane_test("max", (uint8_t *)buf16_1, (uint8_t *)buf16_2, 1, W1, H1);
+    if (ret < 0)
+        goto end;
+    av_freep(&buf1);
+    av_freep(&buf2);
+    buf1 = av_malloc(W1*H1);
+    buf2 = av_malloc(W2*H2);
+    if (!buf1 || !buf2) {
+        fprintf(stderr, "malloc failure\n");
+        ret = 1;
+        goto end;
+    }
+    memset(buf1, 0xff, W1*H1);
+    memset(buf2, 0x00, W2*H2);
+    ret = run_plane_test("max", buf1, buf2, 0, W1, H1);
+    if (ret < 0)
+        goto end;
+
+    RANDOM_INIT(buf1, W1*H1);
+    RANDOM_INIT(buf2, W2*H2);
+    RANDOM_INIT(buf16_1, W1*H1);
+    RANDOM_INIT(buf16_2, W2*H2);
+    for (i = 0; i < 3; i++) {
+        static const int w[] = { W1, W1 - 3, 7 };
+        ret = run_plane_test("random", buf1, buf2, 0, w[i], H1 - i);
+        if (ret < 0)
+            goto end;
+        ret = run_plane_test("random", (uint8_t *)buf16_1, (uint8_t *)buf16_2, 1, w[i], H1 - i);
+        if (ret < 0)
+            goto end;
+    }
+
 end:
     av_free(buf1);
     av_free(buf2);
+    av_free(buf16_1);
+    av_free(buf16_2);
     return ret;
 }
 #endif /* TEST */
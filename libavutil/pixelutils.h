@@ -49,4 +49,46 @@ typedef int (*av_pixelutils_sad_fn)(const uint8_t *src1, ptrdiff_t stride1,
 av_pixelutils_sad_fn av_pixelutils_get_sad_fn(int w_bits, int h_bits,
                                               int aligned, void *log_ctx);
 
+/**
+ * Get a potentially optimized pointer to a Sum-of-absolute-differences
+ * function working on blocks of native endian 16-bit samples. The returned
+ * function takes pointers to the first sample and strides in bytes.
+ *
+ * The parameters are the same as for av_pixelutils_get_sad_fn().
+ */
+av_pixelutils_sad_fn av_pixelutils_get_sad16_fn(int w_bits, int h_bits,
+                                                int aligned, void *log_ctx);
+
+/**
+ * Sum of abs(src1[x] - src2[x]) or of (src1[x] - src2[x])^2 over a whole
+ * w x h plane. Strides are in bytes.
+ */
+typedef uint64_t (*av_pixelutils_plane_fn)(const uint8_t *src1, ptrdiff_t stride1,
+                                           const uint8_t *src2, ptrdiff_t stride2,
+                                           int w, int h);
+
+/**
+ * Get a potentially optimized pointer to a function computing the sum of
+ * absolute differences of two planes (see the av_pixelutils_plane_fn
+ * prototype).
+ *
+ * @param depth   bit depth of the samples; samples are stored in bytes for
+ *                depths up to 8 and in native endian 16-bit words for depths
+ *                9 to 16
+ * @param log_ctx context used for logging, can be NULL
+ *
+ * @return a pointer to the SAD function or NULL in case of error (because of
+ *         invalid parameters)
+ */
+av_pixelutils_plane_fn av_pixelutils_get_plane_sad_fn(int depth, void *log_ctx);
+
+/**
+ * Get a potentially optimized pointer to a function computing the sum of
+ * squared differences of two planes (see the av_pixelutils_plane_fn
+ * prototype).
+ *
+ * The parameters are the same as for av_pixelutils_get_plane_sad_fn().
+ */
+av_pixelutils_plane_fn av_pixelutils_get_plane_sse_fn(int depth, void *log_ctx);
+
 #endif /* AVUTIL_PIXELUTILS_H */
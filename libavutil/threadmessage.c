@@ -18,6 +18,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "atomic.h"
 #include "fifo.h"
 #include "threadmessage.h"
 #include "thread.h"
@@ -32,6 +33,16 @@ struct AVThreadMessageQueue {
     int err_recv;
     unsigned elsize;
     void (*free_func)(void *msg);
+
+    /* lock-free ring buffer, used instead of fifo in single producer,
+     * single consumer mode; the indexes run modulo 2 * nelem so that a full
+     * ring can be told apart from an empty one */
+    uint8_t *ring;
+    int nelem;
+    volatile int windex;
+    volatile int rindex;
+    volatile int send_waiting;
+    volatile int recv_waiting;
 #else
     int dummy;
 #endif
@@ -40,12 +51,20 @@ struct AVThreadMessageQueue {
 int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize)
+{
+    return av_thread_message_queue_alloc2(mq, nelem, elsize, 0);
+}
+
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags)
 {
 #if HAVE_THREADS
     AVThreadMessageQueue *rmq;
     int ret = 0;
 
-    if (nelem > INT_MAX / elsize)
+    if (!elsize || nelem > INT_MAX / 2 || nelem > INT_MAX / elsize)
         return AVERROR(EINVAL);
     if (!(rmq = av_mallocz(sizeof(*rmq))))
         return AVERROR(ENOMEM);
@@ -64,12 +83,18 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
         av_free(rmq);
         return AVERROR(ret);
     }
-    if (!(rmq->fifo = av_fifo_alloc(elsize * nelem))) {
+    if (flags & AV_THREAD_MESSAGE_QUEUE_SPSC) {
+        rmq->nelem = FFMAX(nelem, 1);
+        rmq->ring  = av_malloc_array(rmq->nelem, elsize);
+    } else {
+        rmq->fifo = av_fifo_alloc(elsize * nelem);
+    }
+    if (!rmq->fifo && !rmq->ring) {
         pthread_cond_destroy(&rmq->cond_send);
         pthread_cond_destroy(&rmq->cond_recv);
         pthread_mutex_destroy(&rmq->lock);
         av_free(rmq);
-        return AVERROR(ret);
+        return AVERROR(ENOMEM);
     }
     rmq->elsize = elsize;
     *mq = rmq;
@@ -94,6 +119,7 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
     if (*mq) {
         av_thread_message_flush(*mq);
         av_fifo_freep(&(*mq)->fifo);
+        av_freep(&(*mq)->ring);
         pthread_cond_destroy(&(*mq)->cond_send);
         pthread_cond_destroy(&(*mq)->cond_recv);
         pthread_mutex_destroy(&(*mq)->lock);
@@ -105,7 +131,8 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
 #if HAVE_THREADS
 
 static int av_thread_message_queue_send_locked(AVThreadMessageQueue *mq,
-                                               void *msg,
+                                               void *msgs,
+                                               unsigned nb_msgs,
                                                unsigned flags)
 {
     while (!mq->err_send && av_fifo_space(mq->fifo) < mq->elsize) {
@@ -115,14 +142,19 @@ static int av_thread_message_queue_send_locked(AVThreadMessageQueue *mq,
     }
     if (mq->err_send)
         return mq->err_send;
-    av_fifo_generic_write(mq->fifo, msg, mq->elsize, NULL);
-    /* one message is sent, signal one receiver */
-    pthread_cond_signal(&mq->cond_recv);
-    return 0;
+    nb_msgs = FFMIN(nb_msgs, av_fifo_space(mq->fifo) / mq->elsize);
+    av_fifo_generic_write(mq->fifo, msgs, nb_msgs * mq->elsize, NULL);
+    /* messages are sent, signal the receivers */
+    if (nb_msgs > 1)
+        pthread_cond_broadcast(&mq->cond_recv);
+    else
+        pthread_cond_signal(&mq->cond_recv);
+    return nb_msgs;
 }
 
 static int av_thread_message_queue_recv_locked(AVThreadMessageQueue *mq,
-                                               void *msg,
+                                               void *msgs,
+                                               unsigned nb_msgs,
                                                unsigned flags)
 {
     while (!mq->err_recv && av_fifo_size(mq->fifo) < mq->elsize) {
@@ -132,23 +164,144 @@ static int av_thread_message_queue_recv_locked(AVThreadMessageQueue *mq,
     }
     if (av_fifo_size(mq->fifo) < mq->elsize)
         return mq->err_recv;
-    av_fifo_generic_read(mq->fifo, msg, mq->elsize, NULL);
-    /* one message space appeared, signal one sender */
-    pthread_cond_signal(&mq->cond_send);
-    return 0;
+    nb_msgs = FFMIN(nb_msgs, av_fifo_size(mq->fifo) / mq->elsize);
+    av_fifo_generic_read(mq->fifo, msgs, nb_msgs * mq->elsize, NULL);
+    /* message space appeared, signal the senders */
+    if (nb_msgs > 1)
+        pthread_cond_broadcast(&mq->cond_send);
+    else
+        pthread_cond_signal(&mq->cond_send);
+    return nb_msgs;
+}
+
+static int ring_used(AVThreadMessageQueue *mq, int rindex, int windex)
+{
+    int used = windex - rindex;
+    return used < 0 ? used + 2 * mq->nelem : used;
+}
+
+static int ring_advance(AVThreadMessageQueue *mq, int index, int n)
+{
+    index += n;
+    return index >= 2 * mq->nelem ? index - 2 * mq->nelem : index;
+}
+
+/* Copy n messages between msgs and the ring, starting at index. */
+static void ring_copy(AVThreadMessageQueue *mq, int index, uint8_t *msgs,
+                      int n, int to_ring)
+{
+    int pos = index >= mq->nelem ? index - mq->nelem : index;
+    int n1  = FFMIN(n, mq->nelem - pos);
+    uint8_t *slot = mq->ring + pos * mq->elsize;
+
+    if (to_ring) {
+        memcpy(slot,     msgs,                    n1       * mq->elsize);
+        memcpy(mq->ring, msgs + n1 * mq->elsize, (n - n1) * mq->elsize);
+    } else {
+        memcpy(msgs,                    slot,     n1       * mq->elsize);
+        memcpy(msgs + n1 * mq->elsize, mq->ring, (n - n1) * mq->elsize);
+    }
+}
+
+/* Only the sending thread writes windex and only the receiving thread writes
+ * rindex. A thread that has to wait raises its *_waiting flag under the lock
+ * and checks the indexes again before sleeping; as index updates and flag
+ * reads are full barriers, the other side either sees the flag and signals,
+ * or the waiting thread sees the new index. */
+
+static int av_thread_message_queue_send_spsc(AVThreadMessageQueue *mq,
+                                             void *msgs,
+                                             unsigned nb_msgs,
+                                             unsigned flags)
+{
+    int windex = mq->windex;
+    int space, err;
+
+    while (1) {
+        if ((err = avpriv_atomic_int_get(&mq->err_send)))
+            return err;
+        space = mq->nelem - ring_used(mq, avpriv_atomic_int_get(&mq->rindex), windex);
+        if (space)
+            break;
+        if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
+            return AVERROR(EAGAIN);
+        pthread_mutex_lock(&mq->lock);
+        avpriv_atomic_int_set(&mq->send_waiting, 1);
+        while (!mq->err_send &&
+               ring_used(mq, avpriv_atomic_int_get(&mq->rindex), windex) == mq->nelem)
+            pthread_cond_wait(&mq->cond_send, &mq->lock);
+        avpriv_atomic_int_set(&mq->send_waiting, 0);
+        pthread_mutex_unlock(&mq->lock);
+    }
+
+    nb_msgs = FFMIN(nb_msgs, space);
+    ring_copy(mq, windex, msgs, nb_msgs, 1);
+    avpriv_atomic_int_set(&mq->windex, ring_advance(mq, windex, nb_msgs));
+    if (avpriv_atomic_int_get(&mq->recv_waiting)) {
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_signal(&mq->cond_recv);
+        pthread_mutex_unlock(&mq->lock);
+    }
+    return nb_msgs;
+}
+
+static int av_thread_message_queue_recv_spsc(AVThreadMessageQueue *mq,
+                                             void *msgs,
+                                             unsigned nb_msgs,
+                                             unsigned flags)
+{
+    int rindex = mq->rindex;
+    int used, err;
+
+    while (1) {
+        used = ring_used(mq, rindex, avpriv_atomic_int_get(&mq->windex));
+        if (used)
+            break;
+        if ((err = avpriv_atomic_int_get(&mq->err_recv))) {
+            /* the sender may have queued messages before setting the error */
+            used = ring_used(mq, rindex, avpriv_atomic_int_get(&mq->windex));
+            if (used)
+                break;
+            return err;
+        }
+        if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
+            return AVERROR(EAGAIN);
+        pthread_mutex_lock(&mq->lock);
+        avpriv_atomic_int_set(&mq->recv_waiting, 1);
+        while (!mq->err_recv &&
+               !ring_used(mq, rindex, avpriv_atomic_int_get(&mq->windex)))
+            pthread_cond_wait(&mq->cond_recv, &mq->lock);
+        avpriv_atomic_int_set(&mq->recv_waiting, 0);
+        pthread_mutex_unlock(&mq->lock);
+    }
+
+    nb_msgs = FFMIN(nb_msgs, used);
+    ring_copy(mq, rindex, msgs, nb_msgs, 0);
+    avpriv_atomic_int_set(&mq->rindex, ring_advance(mq, rindex, nb_msgs));
+    if (avpriv_atomic_int_get(&mq->send_waiting)) {
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_signal(&mq->cond_send);
+        pthread_mutex_unlock(&mq->lock);
+    }
+    return nb_msgs;
 }
 
 #endif /* HAVE_THREADS */
 
-int av_thread_message_queue_send(AVThreadMessageQueue *mq,
-                                 void *msg,
-                                 unsigned flags)
+int av_thread_message_queue_send_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags)
 {
 #if HAVE_THREADS
     int ret;
 
+    if (!nb_msgs)
+        return 0;
+    if (mq->ring)
+        return av_thread_message_queue_send_spsc(mq, msgs, nb_msgs, flags);
     pthread_mutex_lock(&mq->lock);
-    ret = av_thread_message_queue_send_locked(mq, msg, flags);
+    ret = av_thread_message_queue_send_locked(mq, msgs, nb_msgs, flags);
     pthread_mutex_unlock(&mq->lock);
     return ret;
 #else
@@ -156,17 +309,55 @@ int av_thread_message_queue_send(AVThreadMessageQueue *mq,
 #endif /* HAVE_THREADS */
 }
 
+int av_thread_message_queue_recv_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags)
+{
+#if HAVE_THREADS
+    int ret;
+
+    if (!nb_msgs)
+        return 0;
+    if (mq->ring)
+        return av_thread_message_queue_recv_spsc(mq, msgs, nb_msgs, flags);
+    pthread_mutex_lock(&mq->lock);
+    ret = av_thread_message_queue_recv_locked(mq, msgs, nb_msgs, flags);
+    pthread_mutex_unlock(&mq->lock);
+    return ret;
+#else
+    return AVERROR(ENOSYS);
+#endif /* HAVE_THREADS */
+}
+
+int av_thread_message_queue_send(AVThreadMessageQueue *mq,
+                                 void *msg,
+                                 unsigned flags)
+{
+    int ret = av_thread_message_queue_send_batch(mq, msg, 1, flags);
+    return FFMIN(ret, 0);
+}
+
 int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
                                  void *msg,
                                  unsigned flags)
+{
+    int ret = av_thread_message_queue_recv_batch(mq, msg, 1, flags);
+    return FFMIN(ret, 0);
+}
+
+int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq)
 {
 #if HAVE_THREADS
     int ret;
 
+    if (mq->ring)
+        return ring_used(mq, avpriv_atomic_int_get(&mq->rindex),
+                         avpriv_atomic_int_get(&mq->windex));
     pthread_mutex_lock(&mq->lock);
-    ret = av_thread_message_queue_recv_locked(mq, msg, flags);
+    ret = av_fifo_size(mq->fifo);
     pthread_mutex_unlock(&mq->lock);
-    return ret;
+    return ret / mq->elsize;
 #else
     return AVERROR(ENOSYS);
 #endif /* HAVE_THREADS */
@@ -209,11 +400,21 @@ void av_thread_message_flush(AVThreadMessageQueue *mq)
     void *free_func = mq->free_func;
 
     pthread_mutex_lock(&mq->lock);
-    used = av_fifo_size(mq->fifo);
-    if (free_func)
-        for (off = 0; off < used; off += mq->elsize)
-            av_fifo_generic_peek_at(mq->fifo, mq, off, mq->elsize, free_func_wrap);
-    av_fifo_drain(mq->fifo, used);
+    if (mq->ring) {
+        int rindex = mq->rindex;
+        int windex = avpriv_atomic_int_get(&mq->windex);
+
+        if (free_func)
+            for (; rindex != windex; rindex = ring_advance(mq, rindex, 1))
+                mq->free_func(mq->ring + (rindex >= mq->nelem ? rindex - mq->nelem : rindex) * mq->elsize);
+        avpriv_atomic_int_set(&mq->rindex, windex);
+    } else {
+        used = av_fifo_size(mq->fifo);
+        if (free_func)
+            for (off = 0; off < used; off += mq->elsize)
+                av_fifo_generic_peek_at(mq->fifo, mq, off, mq->elsize, free_func_wrap);
+        av_fifo_drain(mq->fifo, used);
+    }
     /* only the senders need to be notified since the queue is empty and there
      * is nothing to read */
     pthread_cond_broadcast(&mq->cond_send);
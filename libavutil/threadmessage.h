@@ -32,6 +32,20 @@ typedef enum AVThreadMessageFlags {
 
 } AVThreadMessageFlags;
 
+typedef enum AVThreadMessageQueueFlags {
+
+    /**
+     * Single producer, single consumer queue.
+     * If this flag is set, the queue is implemented as a lock-free ring
+     * buffer: sending and receiving only take a lock when they have to wait.
+     * At most one thread may send and at most one thread may receive at any
+     * given time. Queues with several sending threads must not set it and
+     * use the default locked implementation instead.
+     */
+    AV_THREAD_MESSAGE_QUEUE_SPSC = 1,
+
+} AVThreadMessageQueueFlags;
+
 /**
  * Allocate a new message queue.
  *
@@ -45,6 +59,21 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize);
 
+/**
+ * Allocate a new message queue.
+ *
+ * @param mq      pointer to the message queue
+ * @param nelem   maximum number of elements in the queue
+ * @param elsize  size of each element in the queue
+ * @param flags   combination of AVThreadMessageQueueFlags
+ * @return  >=0 for success; <0 for error, in particular AVERROR(ENOSYS) if
+ *          lavu was built without thread support
+ */
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags);
+
 /**
  * Free a message queue.
  *
@@ -66,6 +95,40 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
                                  void *msg,
                                  unsigned flags);
 
+/**
+ * Send several messages on the queue.
+ *
+ * The messages are stored contiguously in msgs. Unless the operation is
+ * non-blocking, wait until there is room for at least one message.
+ *
+ * @return  the number of messages sent (at least 1); <0 for error
+ */
+int av_thread_message_queue_send_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags);
+
+/**
+ * Receive several messages from the queue.
+ *
+ * Up to nb_msgs messages are stored contiguously in msgs. Unless the
+ * operation is non-blocking, wait until at least one message is available.
+ *
+ * @return  the number of messages received (at least 1); <0 for error
+ */
+int av_thread_message_queue_recv_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags);
+
+/**
+ * Return the current number of messages in the queue.
+ *
+ * @return the current number of messages or AVERROR(ENOSYS) if lavu was built
+ *         without thread support
+ */
+int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq);
+
 /**
  * Set the sending error code.
  *
@@ -101,6 +164,9 @@ void av_thread_message_queue_set_free_func(AVThreadMessageQueue *mq,
  * This function is mostly equivalent to reading and free-ing every message
  * except that it will be done in a single operation (no lock/unlock between
  * reads).
+ *
+ * With AV_THREAD_MESSAGE_QUEUE_SPSC, it must not run concurrently with
+ * av_thread_message_queue_recv() in another thread.
  */
 void av_thread_message_flush(AVThreadMessageQueue *mq);
 
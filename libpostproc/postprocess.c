@@ -846,6 +846,13 @@ void pp_free_mode(pp_mode *mode){
     av_free(mode);
 }
 
+int pp_mode_supports_slices(const pp_mode *vm){
+    const PPMode *mode = vm;
+    const int global = LEVEL_FIX | TEMP_NOISE_FILTER;
+
+    return !((mode->lumMode | mode->chromMode) & global);
+}
+
 static void reallocAlign(void **p, int size){
     av_free(*p);
     *p= av_mallocz(size);
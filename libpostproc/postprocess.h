@@ -84,6 +84,16 @@ void  pp_postprocess(const uint8_t * src[3], const int srcStride[3],
 pp_mode *pp_get_mode_by_name_and_quality(const char *name, int quality);
 void pp_free_mode(pp_mode *mode);
 
+/**
+ * Check whether a mode can be applied to horizontal slices of a frame.
+ *
+ * @return 1 if the filters of mode only look at neighbouring blocks, so that
+ *         the slices of a frame can be processed independently, each with
+ *         its own context and a few rows of overlap; 0 if the mode keeps
+ *         frame-wide or temporal state (autolevels, temporal noise reducer)
+ */
+int pp_mode_supports_slices(const pp_mode *mode);
+
 pp_context *pp_get_context(int width, int height, int flags);
 void pp_free_context(pp_context *ppContext);
 
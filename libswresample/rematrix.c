@@ -379,25 +379,27 @@ av_cold int swri_rematrix_init(SwrContext *s){
         s->mix_2_1_f = (mix_2_1_func_type*)sum2_s16;
         s->mix_any_f = (mix_any_func_type*)get_mix_any_func_s16(s);
     }else if(s->midbuf.fmt == AV_SAMPLE_FMT_FLTP){
-        s->native_matrix = av_calloc(nb_in * nb_out, sizeof(float));
+        s->native_matrix = av_calloc(nb_in * nb_out + 1, sizeof(float));
         s->native_one    = av_mallocz(sizeof(float));
         if (!s->native_matrix || !s->native_one)
             return AVERROR(ENOMEM);
         for (i = 0; i < nb_out; i++)
             for (j = 0; j < nb_in; j++)
                 ((float*)s->native_matrix)[i * nb_in + j] = s->matrix[i][j];
+        ((float*)s->native_matrix)[nb_in * nb_out] = 1.0;
         *((float*)s->native_one) = 1.0;
         s->mix_1_1_f = (mix_1_1_func_type*)copy_float;
         s->mix_2_1_f = (mix_2_1_func_type*)sum2_float;
         s->mix_any_f = (mix_any_func_type*)get_mix_any_func_float(s);
     }else if(s->midbuf.fmt == AV_SAMPLE_FMT_DBLP){
-        s->native_matrix = av_calloc(nb_in * nb_out, sizeof(double));
+        s->native_matrix = av_calloc(nb_in * nb_out + 1, sizeof(double));
         s->native_one    = av_mallocz(sizeof(double));
         if (!s->native_matrix || !s->native_one)
             return AVERROR(ENOMEM);
         for (i = 0; i < nb_out; i++)
             for (j = 0; j < nb_in; j++)
                 ((double*)s->native_matrix)[i * nb_in + j] = s->matrix[i][j];
+        ((double*)s->native_matrix)[nb_in * nb_out] = 1.0;
         *((double*)s->native_one) = 1.0;
         s->mix_1_1_f = (mix_1_1_func_type*)copy_double;
         s->mix_2_1_f = (mix_2_1_func_type*)sum2_double;
@@ -441,6 +443,17 @@ av_cold void swri_rematrix_free(SwrContext *s){
     av_freep(&s->native_simd_one);
 }
 
+static void mix_2_1(SwrContext *s, uint8_t *out, uint8_t *in1, uint8_t *in2,
+                    int index1, int index2, int len, int len1, int off)
+{
+    if(s->mix_2_1_simd && len1)
+        s->mix_2_1_simd(out    , in1    , in2    , s->native_simd_matrix, index1, index2, len1);
+    else
+        s->mix_2_1_f   (out    , in1    , in2    , s->native_matrix, index1, index2, len1);
+    if(len != len1)
+        s->mix_2_1_f   (out+off, in1+off, in2+off, s->native_matrix, index1, index2, len-len1);
+}
+
 int swri_rematrix(SwrContext *s, AudioData *out, AudioData *in, int len, int mustcopy){
     int out_i, in_i, i, j;
     int len1 = 0;
@@ -481,31 +494,25 @@ int swri_rematrix(SwrContext *s, AudioData *out, AudioData *in, int len, int mus
         case 2: {
             int in_i1 = s->matrix_ch[out_i][1];
             int in_i2 = s->matrix_ch[out_i][2];
-            if(s->mix_2_1_simd && len1)
-                s->mix_2_1_simd(out->ch[out_i]    , in->ch[in_i1]    , in->ch[in_i2]    , s->native_simd_matrix, in->ch_count*out_i + in_i1, in->ch_count*out_i + in_i2, len1);
-            else
-                s->mix_2_1_f   (out->ch[out_i]    , in->ch[in_i1]    , in->ch[in_i2]    , s->native_matrix, in->ch_count*out_i + in_i1, in->ch_count*out_i + in_i2, len1);
-            if(len != len1)
-                s->mix_2_1_f   (out->ch[out_i]+off, in->ch[in_i1]+off, in->ch[in_i2]+off, s->native_matrix, in->ch_count*out_i + in_i1, in->ch_count*out_i + in_i2, len-len1);
+            mix_2_1(s, out->ch[out_i], in->ch[in_i1], in->ch[in_i2],
+                    in->ch_count*out_i + in_i1, in->ch_count*out_i + in_i2, len, len1, off);
             break;}
         default:
-            if(s->int_sample_fmt == AV_SAMPLE_FMT_FLTP){
-                for(i=0; i<len; i++){
-                    float v=0;
-                    for(j=0; j<s->matrix_ch[out_i][0]; j++){
-                        in_i= s->matrix_ch[out_i][1+j];
-                        v+= ((float*)in->ch[in_i])[i] * s->matrix[out_i][in_i];
-                    }
-                    ((float*)out->ch[out_i])[i]= v;
-                }
-            }else if(s->int_sample_fmt == AV_SAMPLE_FMT_DBLP){
-                for(i=0; i<len; i++){
-                    double v=0;
-                    for(j=0; j<s->matrix_ch[out_i][0]; j++){
-                        in_i= s->matrix_ch[out_i][1+j];
-                        v+= ((double*)in->ch[in_i])[i] * s->matrix[out_i][in_i];
-                    }
-                    ((double*)out->ch[out_i])[i]= v;
+            if(s->int_sample_fmt == AV_SAMPLE_FMT_FLTP || s->int_sample_fmt == AV_SAMPLE_FMT_DBLP){
+                /* Sum the inputs two at a time over whole channels, which
+                 * streams through memory and uses the SIMD 2:1 mixer; the
+                 * partial sum is fed back with the trailing 1.0 coefficient
+                 * of the native matrix. The order of the additions is the
+                 * same as in the per-sample loop. */
+                int one = in->ch_count * out->ch_count;
+                int in_i1 = s->matrix_ch[out_i][1];
+                int in_i2 = s->matrix_ch[out_i][2];
+                mix_2_1(s, out->ch[out_i], in->ch[in_i1], in->ch[in_i2],
+                        in->ch_count*out_i + in_i1, in->ch_count*out_i + in_i2, len, len1, off);
+                for(j=3; j<=s->matrix_ch[out_i][0]; j++){
+                    in_i= s->matrix_ch[out_i][j];
+                    mix_2_1(s, out->ch[out_i], out->ch[out_i], in->ch[in_i],
+                            one, in->ch_count*out_i + in_i, len, len1, off);
                 }
             }else{
                 for(i=0; i<len; i++){
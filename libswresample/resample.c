@@ -27,6 +27,7 @@
  */
 
 #include "libavutil/avassert.h"
+#include "libavutil/thread.h"
 #include "resample.h"
 
 static inline double eval_poly(const double *coeff, int size, double x) {
@@ -295,6 +296,112 @@ fail:
     return 0;
 }
 
+/* Filter banks only depend on these parameters, and are kept in a small
+ * process-wide cache, so that contexts converting between the same rates
+ * share them instead of computing them again. */
+#define FILTER_BANK_CACHE_SIZE 16
+
+typedef struct FilterBankKey {
+    enum AVSampleFormat format;
+    int phase_shift;
+    int filter_length;
+    double factor;
+    enum SwrFilterType filter_type;
+    double kaiser_beta;
+} FilterBankKey;
+
+typedef struct FilterBankCacheEntry {
+    FilterBankKey key;
+    AVBufferRef *buf;
+} FilterBankCacheEntry;
+
+static FilterBankCacheEntry filter_bank_cache[FILTER_BANK_CACHE_SIZE];
+static int filter_bank_cache_next;
+static AVMutex filter_bank_cache_lock;
+static AVOnce filter_bank_cache_once = AV_ONCE_INIT;
+
+static av_cold void filter_bank_cache_init(void)
+{
+    ff_mutex_init(&filter_bank_cache_lock, NULL);
+}
+
+static int filter_bank_key_equal(const FilterBankKey *a, const FilterBankKey *b)
+{
+    return a->format        == b->format        &&
+           a->phase_shift   == b->phase_shift   &&
+           a->filter_length == b->filter_length &&
+           a->factor        == b->factor        &&
+           a->filter_type   == b->filter_type   &&
+           a->kaiser_beta   == b->kaiser_beta;
+}
+
+/**
+ * Set the filter bank of c, from the cache or built for its parameters.
+ * The filter bank is read-only and owned by c->filter_bank_buf.
+ */
+static av_cold int get_filter_bank(ResampleContext *c)
+{
+    FilterBankKey key = {
+        .format        = c->format,
+        .phase_shift   = c->phase_shift,
+        .filter_length = c->filter_length,
+        .factor        = c->factor,
+        .filter_type   = c->filter_type,
+        .kaiser_beta   = c->kaiser_beta,
+    };
+    int phase_count = 1 << c->phase_shift;
+    int64_t size = (int64_t)c->filter_alloc * (phase_count + 1) * c->felem_size;
+    AVBufferRef *buf = NULL;
+    uint8_t *bank;
+    int i;
+
+    ff_thread_once(&filter_bank_cache_once, filter_bank_cache_init);
+
+    ff_mutex_lock(&filter_bank_cache_lock);
+    for (i = 0; i < FILTER_BANK_CACHE_SIZE; i++) {
+        FilterBankCacheEntry *e = &filter_bank_cache[i];
+        if (e->buf && filter_bank_key_equal(&e->key, &key)) {
+            buf = av_buffer_ref(e->buf);
+            break;
+        }
+    }
+    ff_mutex_unlock(&filter_bank_cache_lock);
+
+    if (!buf) {
+        if (size > INT_MAX)
+            return AVERROR(ENOMEM);
+        buf = av_buffer_allocz(size);
+        if (!buf)
+            return AVERROR(ENOMEM);
+        bank = buf->data;
+        if (build_filter(c, (void*)bank, c->factor, c->filter_length, c->filter_alloc, phase_count, 1<<c->filter_shift, c->filter_type, c->kaiser_beta)) {
+            av_buffer_unref(&buf);
+            return AVERROR(ENOMEM);
+        }
+        memcpy(bank + (c->filter_alloc*phase_count+1)*c->felem_size, bank, (c->filter_alloc-1)*c->felem_size);
+        memcpy(bank + (c->filter_alloc*phase_count  )*c->felem_size, bank + (c->filter_alloc - 1)*c->felem_size, c->felem_size);
+
+        ff_mutex_lock(&filter_bank_cache_lock);
+        {
+            FilterBankCacheEntry *e = &filter_bank_cache[filter_bank_cache_next];
+            AVBufferRef *ref = av_buffer_ref(buf);
+
+            /* not caching it is harmless */
+            if (ref) {
+                av_buffer_unref(&e->buf);
+                e->key = key;
+                e->buf = ref;
+                filter_bank_cache_next = (filter_bank_cache_next + 1) % FILTER_BANK_CACHE_SIZE;
+            }
+        }
+        ff_mutex_unlock(&filter_bank_cache_lock);
+    }
+
+    c->filter_bank_buf = buf;
+    c->filter_bank     = buf->data;
+    return 0;
+}
+
 static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_rate, int filter_size, int phase_shift, int linear,
                                     double cutoff0, enum AVSampleFormat format, enum SwrFilterType filter_type, double kaiser_beta,
                                     double precision, int cheby)
@@ -341,15 +448,10 @@ static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_r
         c->factor        = factor;
         c->filter_length = FFMAX((int)ceil(filter_size/factor), 1);
         c->filter_alloc  = FFALIGN(c->filter_length, 8);
-        c->filter_bank   = av_calloc(c->filter_alloc, (phase_count+1)*c->felem_size);
         c->filter_type   = filter_type;
         c->kaiser_beta   = kaiser_beta;
-        if (!c->filter_bank)
-            goto error;
-        if (build_filter(c, (void*)c->filter_bank, factor, c->filter_length, c->filter_alloc, phase_count, 1<<c->filter_shift, filter_type, kaiser_beta))
+        if (get_filter_bank(c) < 0)
             goto error;
-        memcpy(c->filter_bank + (c->filter_alloc*phase_count+1)*c->felem_size, c->filter_bank, (c->filter_alloc-1)*c->felem_size);
-        memcpy(c->filter_bank + (c->filter_alloc*phase_count  )*c->felem_size, c->filter_bank + (c->filter_alloc - 1)*c->felem_size, c->felem_size);
     }
 
     c->compensation_distance= 0;
@@ -370,7 +472,7 @@ static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_r
 
     return c;
 error:
-    av_freep(&c->filter_bank);
+    av_buffer_unref(&c->filter_bank_buf);
     av_free(c);
     return NULL;
 }
@@ -378,7 +480,7 @@ error:
 static void resample_free(ResampleContext **c){
     if(!*c)
         return;
-    av_freep(&(*c)->filter_bank);
+    av_buffer_unref(&(*c)->filter_bank_buf);
     av_freep(c);
 }
 
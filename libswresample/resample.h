@@ -22,6 +22,7 @@
 #ifndef SWRESAMPLE_RESAMPLE_H
 #define SWRESAMPLE_RESAMPLE_H
 
+#include "libavutil/buffer.h"
 #include "libavutil/log.h"
 #include "libavutil/samplefmt.h"
 
@@ -56,6 +57,8 @@ typedef struct ResampleContext {
         int (*resample)(struct ResampleContext *c, void *dst,
                         const void *src, int n, int update_ctx);
     } dsp;
+
+    AVBufferRef *filter_bank_buf; ///< owns filter_bank, shared with other contexts
 } ResampleContext;
 
 void swri_resample_dsp_init(ResampleContext *c);
@@ -87,6 +87,16 @@ void (*interleaveBytes)(const uint8_t *src1, const uint8_t *src2, uint8_t *dst,
 void (*deinterleaveBytes)(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
                           int width, int height, int srcStride,
                           int dst1Stride, int dst2Stride);
+void (*shiftWords)(const uint8_t *src, uint8_t *dst,
+                   int width, int height, int srcStride,
+                   int dstStride, int shift);
+void (*deinterleaveWords)(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
+                          int width, int height, int srcStride,
+                          int dst1Stride, int dst2Stride, int shift);
+void (*ditherWordsToBytes)(const uint8_t *src, uint8_t *dst,
+                           int width, int height, int srcStride,
+                           int dstStride, const uint8_t (*dither)[8],
+                           int scale, int shift);
 void (*vu9_to_vu12)(const uint8_t *src1, const uint8_t *src2,
                     uint8_t *dst1, uint8_t *dst2,
                     int width, int height,
@@ -139,6 +139,35 @@ extern void (*deinterleaveBytes)(const uint8_t *src, uint8_t *dst1, uint8_t *dst
                                  int width, int height, int srcStride,
                                  int dst1Stride, int dst2Stride);
 
+/**
+ * Shift native endian 16-bit samples right by shift bits.
+ * Strides are in bytes, width is in samples.
+ */
+extern void (*shiftWords)(const uint8_t *src, uint8_t *dst,
+                          int width, int height, int srcStride,
+                          int dstStride, int shift);
+
+/**
+ * Split interleaved native endian 16-bit samples into two planes, shifting
+ * them right by shift bits.
+ * Strides are in bytes, width is in samples per output plane.
+ */
+extern void (*deinterleaveWords)(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
+                                 int width, int height, int srcStride,
+                                 int dst1Stride, int dst2Stride, int shift);
+
+/**
+ * Reduce native endian 16-bit samples to 8 bits as
+ * dst = (src + dither[y & 7][x & 7]) * scale >> shift.
+ * src + dither must not exceed 16 bits except for samples whose result
+ * is 255 anyway.
+ * Strides are in bytes, width is in samples.
+ */
+extern void (*ditherWordsToBytes)(const uint8_t *src, uint8_t *dst,
+                                  int width, int height, int srcStride,
+                                  int dstStride, const uint8_t (*dither)[8],
+                                  int scale, int shift);
+
 extern void (*vu9_to_vu12)(const uint8_t *src1, const uint8_t *src2,
                            uint8_t *dst1, uint8_t *dst2,
                            int width, int height,
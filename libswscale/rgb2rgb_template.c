@@ -725,6 +725,62 @@ static void deinterleaveBytes_c(const uint8_t *src, uint8_t *dst1, uint8_t *dst2
     }
 }
 
+static void shiftWords_c(const uint8_t *src, uint8_t *dst,
+                         int width, int height, int srcStride,
+                         int dstStride, int shift)
+{
+    int h;
+
+    for (h = 0; h < height; h++) {
+        const uint16_t *s = (const uint16_t *)src;
+        uint16_t *d = (uint16_t *)dst;
+        int w;
+        for (w = 0; w < width; w++)
+            d[w] = s[w] >> shift;
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+static void deinterleaveWords_c(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
+                                int width, int height, int srcStride,
+                                int dst1Stride, int dst2Stride, int shift)
+{
+    int h;
+
+    for (h = 0; h < height; h++) {
+        const uint16_t *s = (const uint16_t *)src;
+        uint16_t *d1 = (uint16_t *)dst1;
+        uint16_t *d2 = (uint16_t *)dst2;
+        int w;
+        for (w = 0; w < width; w++) {
+            d1[w] = s[2 * w + 0] >> shift;
+            d2[w] = s[2 * w + 1] >> shift;
+        }
+        src  += srcStride;
+        dst1 += dst1Stride;
+        dst2 += dst2Stride;
+    }
+}
+
+static void ditherWordsToBytes_c(const uint8_t *src, uint8_t *dst,
+                                 int width, int height, int srcStride,
+                                 int dstStride, const uint8_t (*dither)[8],
+                                 int scale, int shift)
+{
+    int h;
+
+    for (h = 0; h < height; h++) {
+        const uint16_t *s = (const uint16_t *)src;
+        const uint8_t *d  = dither[h & 7];
+        int w;
+        for (w = 0; w < width; w++)
+            dst[w] = (s[w] + d[w & 7]) * scale >> shift;
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
 static inline void vu9_to_vu12_c(const uint8_t *src1, const uint8_t *src2,
                                  uint8_t *dst1, uint8_t *dst2,
                                  int width, int height,
@@ -961,6 +1017,9 @@ static av_cold void rgb2rgb_init_c(void)
     ff_rgb24toyv12     = ff_rgb24toyv12_c;
     interleaveBytes    = interleaveBytes_c;
     deinterleaveBytes  = deinterleaveBytes_c;
+    shiftWords         = shiftWords_c;
+    deinterleaveWords  = deinterleaveWords_c;
+    ditherWordsToBytes = ditherWordsToBytes_c;
     vu9_to_vu12        = vu9_to_vu12_c;
     yvu9_to_yuy2       = yvu9_to_yuy2_c;
 
@@ -330,6 +330,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
 #endif
     const int dstW                   = c->dstW;
     const int dstH                   = c->dstH;
+    const int dstSliceEnd            = c->dst_slice_h ? c->dst_slice_y + c->dst_slice_h : dstH;
 #ifndef NEW_FILTER
     const int chrDstW                = c->chrDstW;
     const int chrSrcW                = c->chrSrcW;
@@ -460,7 +461,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     if (srcSliceY == 0) {
         lumBufIndex  = -1;
         chrBufIndex  = -1;
-        dstY         = 0;
+        dstY         = c->dst_slice_y;
         lastInLumBuf = -1;
         lastInChrBuf = -1;
     }
@@ -494,7 +495,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     }
 #endif
 
-    for (; dstY < dstH; dstY++) {
+    for (; dstY < dstSliceEnd; dstY++) {
         const int chrDstY = dstY >> c->chrDstVSubSample;
 #ifndef NEW_FILTER
         uint8_t *dest[4]  = {
@@ -1055,6 +1056,12 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
         return 0;
     }
 
+    if (c->dst_slice_h && (srcSliceY || srcSliceH != c->srcH ||
+                           c->swscale != swscale || c->cascaded_context[0])) {
+        av_log(c, AV_LOG_ERROR, "Destination slices need whole input frames and a scaling context\n");
+        return AVERROR(EINVAL);
+    }
+
     if ((srcSliceY & (macro_height-1)) ||
         ((srcSliceH& (macro_height-1)) && srcSliceY + srcSliceH != c->srcH) ||
         srcSliceY + srcSliceH > c->srcH) {
@@ -31,6 +31,7 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/avutil.h"
+#include "libavutil/buffer.h"
 #include "libavutil/common.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
@@ -312,6 +313,8 @@ typedef struct SwsContext {
     int chrDstVSubSample;         ///< Binary logarithm of vertical   subsampling factor between luma/alpha and chroma planes in destination image.
     int vChrDrop;                 ///< Binary logarithm of extra vertical subsampling factor in source image chroma planes specified by user.
     int sliceDir;                 ///< Direction that slices are fed to the scaler (1 = top-to-bottom, -1 = bottom-to-top).
+    int dst_slice_y;              ///< First destination line output per frame, see dst_slice_h.
+    int dst_slice_h;              ///< Number of destination lines output per frame (0 = all), requires whole input frames.
     double param[2];              ///< Input parameters for scaling algorithms that need them.
 
     /* The cascaded_* fields allow spliting a scaler task into multiple
@@ -386,6 +389,10 @@ typedef struct SwsContext {
     int32_t *hChrFilterPos;       ///< Array of horizontal filter starting positions for each dst[i] for chroma     planes.
     int32_t *vLumFilterPos;       ///< Array of vertical   filter starting positions for each dst[i] for luma/alpha planes.
     int32_t *vChrFilterPos;       ///< Array of vertical   filter starting positions for each dst[i] for chroma     planes.
+    AVBufferRef *hLumFilterBuf;   ///< Shared storage of hLumFilter and hLumFilterPos, if any; they are read-only then.
+    AVBufferRef *hChrFilterBuf;   ///< Shared storage of hChrFilter and hChrFilterPos, if any; they are read-only then.
+    AVBufferRef *vLumFilterBuf;   ///< Shared storage of vLumFilter and vLumFilterPos, if any; they are read-only then.
+    AVBufferRef *vChrFilterBuf;   ///< Shared storage of vChrFilter and vChrFilterPos, if any; they are read-only then.
     int hLumFilterSize;           ///< Horizontal filter size for luma/alpha pixels.
     int hChrFilterSize;           ///< Horizontal filter size for chroma     pixels.
     int vLumFilterSize;           ///< Vertical   filter size for luma/alpha pixels.
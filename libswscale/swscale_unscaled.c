@@ -197,6 +197,25 @@ static int nv12ToPlanarWrapper(SwsContext *c, const uint8_t *src[],
     return srcSliceH;
 }
 
+static int p010ToPlanarWrapper(SwsContext *c, const uint8_t *src[],
+                               int srcStride[], int srcSliceY,
+                               int srcSliceH, uint8_t *dstParam[],
+                               int dstStride[])
+{
+    uint8_t *dst0 = dstParam[0] + dstStride[0] * srcSliceY;
+    uint8_t *dst1 = dstParam[1] + dstStride[1] * (srcSliceY / 2);
+    uint8_t *dst2 = dstParam[2] + dstStride[2] * (srcSliceY / 2);
+
+    /* P010 keeps the 10 significant bits at the top of each sample */
+    shiftWords(src[0], dst0, c->srcW, srcSliceH,
+               srcStride[0], dstStride[0], 6);
+    deinterleaveWords(src[1], dst1, dst2, AV_CEIL_RSHIFT(c->srcW, 1),
+                      AV_CEIL_RSHIFT(srcSliceH, 1),
+                      srcStride[1], dstStride[1], dstStride[2], 6);
+
+    return srcSliceH;
+}
+
 static int planarToYuy2Wrapper(SwsContext *c, const uint8_t *src[],
                                int srcStride[], int srcSliceY, int srcSliceH,
                                uint8_t *dstParam[], int dstStride[])
@@ -1444,7 +1463,11 @@ static int planarCopyWrapper(SwsContext *c, const uint8_t *src[],
 
                 if (dst_depth == 8) {
                     if(isBE(c->srcFormat) == HAVE_BIGENDIAN){
-                        DITHER_COPY(dstPtr, dstStride[plane], srcPtr2, srcStride[plane]/2, , )
+                        ditherWordsToBytes(srcPtr, dstPtr, length, height,
+                                           srcStride[plane], dstStride[plane],
+                                           dithers[src_depth-9],
+                                           dither_scale[dst_depth-1][src_depth-1],
+                                           src_depth-dst_depth + dither_scale[src_depth-2][dst_depth-1]);
                     } else {
                         DITHER_COPY(dstPtr, dstStride[plane], srcPtr2, srcStride[plane]/2, av_bswap16, )
                     }
@@ -1594,6 +1617,10 @@ void ff_get_unscaled_swscale(SwsContext *c)
         (srcFormat == AV_PIX_FMT_NV12 || srcFormat == AV_PIX_FMT_NV21)) {
         c->swscale = nv12ToPlanarWrapper;
     }
+    /* p010_to_yuv420p10 */
+    if (srcFormat == AV_PIX_FMT_P010 && dstFormat == AV_PIX_FMT_YUV420P10) {
+        c->swscale = p010ToPlanarWrapper;
+    }
     /* yuv2bgr */
     if ((srcFormat == AV_PIX_FMT_YUV420P || srcFormat == AV_PIX_FMT_YUV422P ||
          srcFormat == AV_PIX_FMT_YUVA420P) && isAnyRGB(dstFormat) &&
@@ -50,6 +50,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/ppc/cpu.h"
+#include "libavutil/thread.h"
 #include "libavutil/x86/asm.h"
 #include "libavutil/x86/cpu.h"
 #include "rgb2rgb.h"
@@ -699,6 +700,170 @@ fail:
     return ret;
 }
 
+/* Filters without source/destination vectors only depend on the initFilter()
+ * arguments, and are kept in a small process-wide cache, so that contexts with
+ * the same geometry share them instead of computing them again. */
+#define FILTER_CACHE_SIZE 32
+
+typedef struct FilterKey {
+    int xInc;
+    int srcW;
+    int dstW;
+    int filterAlign;
+    int one;
+    int flags;
+    int cpu_flags;
+    double param[2];
+    int srcPos;
+    int dstPos;
+} FilterKey;
+
+typedef struct FilterCacheEntry {
+    FilterKey key;
+    int filterSize;
+    AVBufferRef *buf;   ///< filterPos, followed by the filter at FILTER_OFFSET(dstW)
+} FilterCacheEntry;
+
+#define FILTER_OFFSET(dstW) FFALIGN(((dstW) + 7) * sizeof(int32_t), 64)
+
+static FilterCacheEntry filter_cache[FILTER_CACHE_SIZE];
+static int filter_cache_next;
+static AVMutex filter_cache_lock;
+static AVOnce filter_cache_once = AV_ONCE_INIT;
+
+static av_cold void filter_cache_init(void)
+{
+    ff_mutex_init(&filter_cache_lock, NULL);
+}
+
+static int filter_key_equal(const FilterKey *a, const FilterKey *b)
+{
+    return a->xInc        == b->xInc        &&
+           a->srcW        == b->srcW        &&
+           a->dstW        == b->dstW        &&
+           a->filterAlign == b->filterAlign &&
+           a->one         == b->one         &&
+           a->flags       == b->flags       &&
+           a->cpu_flags   == b->cpu_flags   &&
+           a->param[0]    == b->param[0]    &&
+           a->param[1]    == b->param[1]    &&
+           a->srcPos      == b->srcPos      &&
+           a->dstPos      == b->dstPos;
+}
+
+static void set_cached_filter(AVBufferRef *buf, int dstW,
+                              int16_t **outFilter, int32_t **filterPos)
+{
+    *filterPos = (int32_t *)buf->data;
+    *outFilter = (int16_t *)(buf->data + FILTER_OFFSET(dstW));
+}
+
+/**
+ * Same as initFilter(), but share the result with the other contexts through
+ * the filter cache when possible. The filter is then read-only and owned by
+ * *outBuf, otherwise *outBuf is NULL and the arrays are owned by the caller.
+ */
+static av_cold int getFilter(AVBufferRef **outBuf,
+                             int16_t **outFilter, int32_t **filterPos,
+                             int *outFilterSize, int xInc, int srcW,
+                             int dstW, int filterAlign, int one,
+                             int flags, int cpu_flags,
+                             SwsVector *srcFilter, SwsVector *dstFilter,
+                             double param[2], int srcPos, int dstPos)
+{
+    FilterKey key = {
+        .xInc        = xInc,
+        .srcW        = srcW,
+        .dstW        = dstW,
+        .filterAlign = filterAlign,
+        .one         = one,
+        .flags       = flags,
+        .cpu_flags   = cpu_flags,
+        .param       = { param[0], param[1] },
+        .srcPos      = srcPos,
+        .dstPos      = dstPos,
+    };
+    int16_t *filter = NULL;
+    int32_t *pos    = NULL;
+    AVBufferRef *buf;
+    int i, size, ret;
+
+    *outBuf = NULL;
+    if (srcFilter || dstFilter)
+        return initFilter(outFilter, filterPos, outFilterSize, xInc, srcW,
+                          dstW, filterAlign, one, flags, cpu_flags,
+                          srcFilter, dstFilter, param, srcPos, dstPos);
+
+    ff_thread_once(&filter_cache_once, filter_cache_init);
+
+    ff_mutex_lock(&filter_cache_lock);
+    for (i = 0; i < FILTER_CACHE_SIZE; i++) {
+        FilterCacheEntry *e = &filter_cache[i];
+        if (e->buf && filter_key_equal(&e->key, &key)) {
+            *outBuf = av_buffer_ref(e->buf);
+            size    = e->filterSize;
+            break;
+        }
+    }
+    ff_mutex_unlock(&filter_cache_lock);
+
+    if (*outBuf) {
+        set_cached_filter(*outBuf, dstW, outFilter, filterPos);
+        *outFilterSize = size;
+        return 0;
+    }
+
+    ret = initFilter(&filter, &pos, &size, xInc, srcW, dstW, filterAlign,
+                     one, flags, cpu_flags, NULL, NULL, param, srcPos, dstPos);
+    if (ret < 0)
+        return ret;
+
+    buf = av_buffer_alloc(FILTER_OFFSET(dstW) + (dstW + 7) * size * sizeof(*filter));
+    if (!buf) {
+        av_free(filter);
+        av_free(pos);
+        return AVERROR(ENOMEM);
+    }
+    memcpy(buf->data, pos, (dstW + 7) * sizeof(*pos));
+    memcpy(buf->data + FILTER_OFFSET(dstW), filter,
+           (dstW + 7) * size * sizeof(*filter));
+    av_free(filter);
+    av_free(pos);
+
+    ff_mutex_lock(&filter_cache_lock);
+    {
+        FilterCacheEntry *e = &filter_cache[filter_cache_next];
+        AVBufferRef *ref = av_buffer_ref(buf);
+
+        /* not caching it is harmless */
+        if (ref) {
+            av_buffer_unref(&e->buf);
+            e->key        = key;
+            e->filterSize = size;
+            e->buf        = ref;
+            filter_cache_next = (filter_cache_next + 1) % FILTER_CACHE_SIZE;
+        }
+    }
+    ff_mutex_unlock(&filter_cache_lock);
+
+    *outBuf        = buf;
+    *outFilterSize = size;
+    set_cached_filter(buf, dstW, outFilter, filterPos);
+    return 0;
+}
+
+static void freeFilter(AVBufferRef **buf, int16_t **filter, int32_t **filterPos)
+{
+    if (*buf) {
+        av_buffer_unref(buf);
+        *filter    = NULL;
+        *filterPos = NULL;
+    } else {
+        av_freep(filter);
+        av_freep(filterPos);
+    }
+}
+
 static void fill_rgb2yuv_table(SwsContext *c, const int table[4], int dstRange)
 {
     int64_t W, V, Z, Cy, Cu, Cv;
@@ -1223,6 +1388,11 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                srcW, srcH, dstW, dstH);
         return AVERROR(EINVAL);
     }
+    if (c->dst_slice_h && c->dst_slice_y + (int64_t)c->dst_slice_h > dstH) {
+        av_log(c, AV_LOG_ERROR, "Destination slice %d+%d is outside of the %d lines of output\n",
+               c->dst_slice_y, c->dst_slice_h, dstH);
+        return AVERROR(EINVAL);
+    }
     if (flags & SWS_FAST_BILINEAR) {
         if (srcW < 8 || dstW < 8) {
             flags ^= SWS_FAST_BILINEAR | SWS_BILINEAR;
@@ -1300,6 +1470,10 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
             }
         }
     }
+    if (c->dst_slice_h && c->dither == SWS_DITHER_ED) {
+        av_log(c, AV_LOG_ERROR, "Error diffusion dither does not support destination slices\n");
+        return AVERROR(EINVAL);
+    }
     if (isPlanarRGB(dstFormat)) {
         if (!(flags & SWS_FULL_CHR_H_INT)) {
             av_log(c, AV_LOG_DEBUG,
@@ -1616,7 +1790,7 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
             const int filterAlign = X86_MMX(cpu_flags)     ? 4 :
                                     PPC_ALTIVEC(cpu_flags) ? 8 : 1;
 
-            if ((ret = initFilter(&c->hLumFilter, &c->hLumFilterPos,
+            if ((ret = getFilter(&c->hLumFilterBuf, &c->hLumFilter, &c->hLumFilterPos,
                            &c->hLumFilterSize, c->lumXInc,
                            srcW, dstW, filterAlign, 1 << 14,
                            (flags & SWS_BICUBLIN) ? (flags | SWS_BICUBIC) : flags,
@@ -1625,7 +1799,7 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                            get_local_pos(c, 0, 0, 0),
                            get_local_pos(c, 0, 0, 0))) < 0)
                 goto fail;
-            if ((ret = initFilter(&c->hChrFilter, &c->hChrFilterPos,
+            if ((ret = getFilter(&c->hChrFilterBuf, &c->hChrFilter, &c->hChrFilterPos,
                            &c->hChrFilterSize, c->chrXInc,
                            c->chrSrcW, c->chrDstW, filterAlign, 1 << 14,
                            (flags & SWS_BICUBLIN) ? (flags | SWS_BILINEAR) : flags,
@@ -1642,7 +1816,7 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
         const int filterAlign = X86_MMX(cpu_flags)     ? 2 :
                                 PPC_ALTIVEC(cpu_flags) ? 8 : 1;
 
-        if ((ret = initFilter(&c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize,
+        if ((ret = getFilter(&c->vLumFilterBuf, &c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize,
                        c->lumYInc, srcH, dstH, filterAlign, (1 << 12),
                        (flags & SWS_BICUBLIN) ? (flags | SWS_BICUBIC) : flags,
                        cpu_flags, srcFilter->lumV, dstFilter->lumV,
@@ -1650,7 +1824,7 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                        get_local_pos(c, 0, 0, 1),
                        get_local_pos(c, 0, 0, 1))) < 0)
             goto fail;
-        if ((ret = initFilter(&c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize,
+        if ((ret = getFilter(&c->vChrFilterBuf, &c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize,
                        c->chrYInc, c->chrSrcH, c->chrDstH,
                        filterAlign, (1 << 12),
                        (flags & SWS_BICUBLIN) ? (flags | SWS_BILINEAR) : flags,
@@ -2299,20 +2473,15 @@ void sws_freeContext(SwsContext *c)
     for (i = 0; i < 4; i++)
         av_freep(&c->dither_error[i]);
 
-    av_freep(&c->vLumFilter);
-    av_freep(&c->vChrFilter);
-    av_freep(&c->hLumFilter);
-    av_freep(&c->hChrFilter);
+    freeFilter(&c->vLumFilterBuf, &c->vLumFilter, &c->vLumFilterPos);
+    freeFilter(&c->vChrFilterBuf, &c->vChrFilter, &c->vChrFilterPos);
+    freeFilter(&c->hLumFilterBuf, &c->hLumFilter, &c->hLumFilterPos);
+    freeFilter(&c->hChrFilterBuf, &c->hChrFilter, &c->hChrFilterPos);
 #if HAVE_ALTIVEC
     av_freep(&c->vYCoeffsBank);
     av_freep(&c->vCCoeffsBank);
 #endif
 
-    av_freep(&c->vLumFilterPos);
-    av_freep(&c->vChrFilterPos);
-    av_freep(&c->hLumFilterPos);
-    av_freep(&c->hChrFilterPos);
-
 #if HAVE_MMX_INLINE
 #if USE_MMAP
     if (c->lumMmxextFilterCode)
@@ -1991,6 +1991,155 @@ static void RENAME(deinterleaveBytes)(const uint8_t *src, uint8_t *dst1, uint8_t
 #endif /* !COMPILE_TEMPLATE_AMD3DNOW */
 #endif /* !COMPILE_TEMPLATE_AVX || HAVE_AVX_EXTERNAL */
 
+#if COMPILE_TEMPLATE_SSE2 && !COMPILE_TEMPLATE_AVX
+static void RENAME(shiftWords)(const uint8_t *src, uint8_t *dst,
+                               int width, int height, int srcStride,
+                               int dstStride, int shift)
+{
+    int h;
+
+    for (h = 0; h < height; h++) {
+        const uint16_t *s = (const uint16_t *)src;
+        uint16_t *d = (uint16_t *)dst;
+        int w = width & ~7;
+
+        if (w) {
+            __asm__ volatile(
+                "movd                     %3, %%xmm2        \n\t"
+                "xor              %%"REG_a", %%"REG_a"      \n\t"
+                "1:                                         \n\t"
+                "movdqu     (%0, %%"REG_a"), %%xmm0         \n\t"
+                "psrlw                %%xmm2, %%xmm0        \n\t"
+                "movdqu               %%xmm0, (%1, %%"REG_a") \n\t"
+                "add                     $16, %%"REG_a"     \n\t"
+                "cmp                      %2, %%"REG_a"     \n\t"
+                " jb                      1b                \n\t"
+                :: "r"(s), "r"(d), "r"((x86_reg)w * 2), "r"(shift)
+                : "memory", XMM_CLOBBERS("xmm0", "xmm2",) "%"REG_a
+            );
+        }
+        for (; w < width; w++)
+            d[w] = s[w] >> shift;
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+static void RENAME(deinterleaveWords)(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
+                                      int width, int height, int srcStride,
+                                      int dst1Stride, int dst2Stride, int shift)
+{
+    int h;
+
+    for (h = 0; h < height; h++) {
+        const uint16_t *s = (const uint16_t *)src;
+        uint16_t *d1 = (uint16_t *)dst1;
+        uint16_t *d2 = (uint16_t *)dst2;
+        int w = width & ~7;
+
+        if (w) {
+            __asm__ volatile(
+                "movd                     %4, %%xmm4        \n\t"
+                "xor              %%"REG_a", %%"REG_a"      \n\t"
+                "1:                                         \n\t"
+                "movdqu   (%0, %%"REG_a", 2), %%xmm0        \n\t"
+                "movdqu 16(%0, %%"REG_a", 2), %%xmm1        \n\t"
+                "psrlw                %%xmm4, %%xmm0        \n\t"
+                "psrlw                %%xmm4, %%xmm1        \n\t"
+                /* even samples to the low, odd ones to the high quadword */
+                "pshuflw      $0xD8, %%xmm0, %%xmm0         \n\t"
+                "pshuflw      $0xD8, %%xmm1, %%xmm1         \n\t"
+                "pshufhw      $0xD8, %%xmm0, %%xmm0         \n\t"
+                "pshufhw      $0xD8, %%xmm1, %%xmm1         \n\t"
+                "pshufd       $0xD8, %%xmm0, %%xmm0         \n\t"
+                "pshufd       $0xD8, %%xmm1, %%xmm1         \n\t"
+                "movdqa               %%xmm0, %%xmm2        \n\t"
+                "punpcklqdq           %%xmm1, %%xmm0        \n\t"
+                "punpckhqdq           %%xmm1, %%xmm2        \n\t"
+                "movdqu               %%xmm0, (%1, %%"REG_a") \n\t"
+                "movdqu               %%xmm2, (%2, %%"REG_a") \n\t"
+                "add                     $16, %%"REG_a"     \n\t"
+                "cmp                      %3, %%"REG_a"     \n\t"
+                " jb                      1b                \n\t"
+                :: "r"(s), "r"(d1), "r"(d2), "r"((x86_reg)w * 2), "r"(shift)
+                : "memory", XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm4",) "%"REG_a
+            );
+        }
+        for (; w < width; w++) {
+            d1[w] = s[2 * w + 0] >> shift;
+            d2[w] = s[2 * w + 1] >> shift;
+        }
+        src  += srcStride;
+        dst1 += dst1Stride;
+        dst2 += dst2Stride;
+    }
+}
+
+static void RENAME(ditherWordsToBytes)(const uint8_t *src, uint8_t *dst,
+                                       int width, int height, int srcStride,
+                                       int dstStride, const uint8_t (*dither)[8],
+                                       int scale, int shift)
+{
+    DECLARE_ALIGNED(16, uint16_t, dither16)[8][8];
+    DECLARE_ALIGNED(16, uint16_t, scale16)[8];
+    /* the 32-bit product is (hi << 16 | lo), its bits from shift on are
+     * (hi << shifts[0] >> shifts[1]) | (lo >> shifts[2]) */
+    DECLARE_ALIGNED(8, uint64_t, shifts)[3];
+    int h, w;
+
+    for (h = 0; h < 8; h++)
+        for (w = 0; w < 8; w++)
+            dither16[h][w] = dither[h][w];
+    for (w = 0; w < 8; w++)
+        scale16[w] = scale;
+    shifts[0] = FFMAX(16 - shift, 0);
+    shifts[1] = FFMAX(shift - 16, 0);
+    shifts[2] = shift;
+
+    for (h = 0; h < height; h++) {
+        const uint16_t *s = (const uint16_t *)src;
+        const uint8_t *d  = dither[h & 7];
+
+        w = width & ~7;
+        if (w) {
+            __asm__ volatile(
+                "movdqa                   %3, %%xmm5        \n\t"
+                "movdqa                   %4, %%xmm6        \n\t"
+                "movq                     %5, %%xmm2        \n\t"
+                "movq                     %6, %%xmm3        \n\t"
+                "movq                     %7, %%xmm4        \n\t"
+                "xor              %%"REG_a", %%"REG_a"      \n\t"
+                "1:                                         \n\t"
+                "movdqu   (%0, %%"REG_a", 2), %%xmm0        \n\t"
+                /* saturation only affects sums whose result is 255 */
+                "paddusw              %%xmm5, %%xmm0        \n\t"
+                "movdqa               %%xmm0, %%xmm1        \n\t"
+                "pmulhuw              %%xmm6, %%xmm0        \n\t"
+                "pmullw               %%xmm6, %%xmm1        \n\t"
+                "psllw                %%xmm2, %%xmm0        \n\t"
+                "psrlw                %%xmm3, %%xmm0        \n\t"
+                "psrlw                %%xmm4, %%xmm1        \n\t"
+                "por                  %%xmm1, %%xmm0        \n\t"
+                "packuswb             %%xmm0, %%xmm0        \n\t"
+                "movq                 %%xmm0, (%1, %%"REG_a") \n\t"
+                "add                      $8, %%"REG_a"     \n\t"
+                "cmp                      %2, %%"REG_a"     \n\t"
+                " jb                      1b                \n\t"
+                :: "r"(s), "r"(dst), "r"((x86_reg)w),
+                   "m"(*dither16[h & 7]), "m"(*scale16),
+                   "m"(shifts[0]), "m"(shifts[1]), "m"(shifts[2])
+                : "memory", XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                                         "xmm4", "xmm5", "xmm6",) "%"REG_a
+            );
+        }
+        for (; w < width; w++)
+            dst[w] = (s[w] + d[w & 7]) * scale >> shift;
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+#endif /* COMPILE_TEMPLATE_SSE2 && !COMPILE_TEMPLATE_AVX */
+
 #if !COMPILE_TEMPLATE_SSE2
 #if !COMPILE_TEMPLATE_AMD3DNOW
 static inline void RENAME(vu9_to_vu12)(const uint8_t *src1, const uint8_t *src2,
@@ -2605,4 +2754,9 @@ static av_cold void RENAME(rgb2rgb_init)(void)
     deinterleaveBytes  = RENAME(deinterleaveBytes);
 #endif
 #endif
+#if COMPILE_TEMPLATE_SSE2 && !COMPILE_TEMPLATE_AVX
+    shiftWords         = RENAME(shiftWords);
+    deinterleaveWords  = RENAME(deinterleaveWords);
+    ditherWordsToBytes = RENAME(ditherWordsToBytes);
+#endif
 }
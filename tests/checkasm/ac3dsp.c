@@ -0,0 +1,91 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavcodec/ac3.h"
+#include "libavcodec/ac3dsp.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+
+/* exponents of one channel for all blocks, as extracted by the encoder */
+#define NB_COEFS (AC3_MAX_COEFS * AC3_MAX_BLOCKS)
+
+static void check_extract_exponents(AC3DSPContext *c)
+{
+    LOCAL_ALIGNED_32(int32_t, coef, [NB_COEFS]);
+    LOCAL_ALIGNED_32(uint8_t, exp0, [NB_COEFS]);
+    LOCAL_ALIGNED_32(uint8_t, exp1, [NB_COEFS]);
+    int i;
+
+    declare_func(void, uint8_t *exp, int32_t *coef, int nb_coefs);
+
+    if (check_func(c->extract_exponents, "ac3_extract_exponents")) {
+        /* 24-bit signed coefficients, including zeros and the extremes */
+        for (i = 0; i < NB_COEFS; i++)
+            coef[i] = (int32_t)(rnd() % ((1 << 25) - 1)) - ((1 << 24) - 1);
+        for (i = 0; i < 16; i++)
+            coef[rnd() % NB_COEFS] = 0;
+        coef[rnd() % NB_COEFS] =   (1 << 24) - 1;
+        coef[rnd() % NB_COEFS] = -((1 << 24) - 1);
+        for (i = 0; i < NB_COEFS; i += 1 + rnd() % 8)
+            coef[i] >>= rnd() % 24;
+
+        memset(exp0, 0, NB_COEFS);
+        memset(exp1, 0, NB_COEFS);
+        call_ref(exp0, coef, NB_COEFS);
+        call_new(exp1, coef, NB_COEFS);
+        if (memcmp(exp0, exp1, NB_COEFS))
+            fail();
+        bench_new(exp1, coef, NB_COEFS);
+    }
+
+    report("extract_exponents");
+}
+
+static void check_compute_mantissa_size(AC3DSPContext *c)
+{
+    LOCAL_ALIGNED_16(uint16_t, mant_cnt, [AC3_MAX_BLOCKS * 16]);
+    int blk, bap;
+
+    declare_func(int, uint16_t mant_cnt[6][16]);
+
+    if (check_func(c->compute_mantissa_size, "ac3_compute_mantissa_size")) {
+        /* at most 256 coefficients in each of 6 channels per block */
+        for (blk = 0; blk < AC3_MAX_BLOCKS; blk++)
+            for (bap = 0; bap < 16; bap++)
+                mant_cnt[blk * 16 + bap] = rnd() % (AC3_MAX_COEFS * 6 + 1);
+
+        if (call_ref((uint16_t (*)[16])mant_cnt) !=
+            call_new((uint16_t (*)[16])mant_cnt))
+            fail();
+        bench_new((uint16_t (*)[16])mant_cnt);
+    }
+
+    report("compute_mantissa_size");
+}
+
+void checkasm_check_ac3dsp(void)
+{
+    AC3DSPContext c;
+
+    ff_ac3dsp_init(&c, 0);
+
+    check_extract_exponents(&c);
+    check_compute_mantissa_size(&c);
+}
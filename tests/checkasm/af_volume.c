@@ -0,0 +1,82 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+
+#include "libavfilter/af_volume.h"
+
+#include "checkasm.h"
+
+/* a multiple of every samples_align */
+#define SAMPLES 264
+
+static void check_scale_samples(const char *name, enum AVSampleFormat format,
+                                int volume, int max_diff)
+{
+    LOCAL_ALIGNED_32(int32_t, src, [SAMPLES]);
+    LOCAL_ALIGNED_32(int32_t, dst0, [SAMPLES]);
+    LOCAL_ALIGNED_32(int32_t, dst1, [SAMPLES]);
+    VolumeContext vol = { 0 };
+    int i, bps = av_get_bytes_per_sample(format);
+
+    declare_func(void, uint8_t *dst, const uint8_t *src, int nb_samples,
+                 int volume);
+
+    vol.sample_fmt = format;
+    vol.volume_i   = volume;
+    ff_volume_init(&vol);
+
+    if (check_func(vol.scale_samples, "%s", name)) {
+        for (i = 0; i < SAMPLES; i++)
+            src[i] = rnd();
+        memset(dst0, 0, sizeof(*dst0) * SAMPLES);
+        memset(dst1, 0, sizeof(*dst1) * SAMPLES);
+
+        call_ref((uint8_t *)dst0, (const uint8_t *)src, SAMPLES * 4 / bps, volume);
+        call_new((uint8_t *)dst1, (const uint8_t *)src, SAMPLES * 4 / bps, volume);
+        if (bps == 2) {
+            if (memcmp(dst0, dst1, SAMPLES * 4))
+                fail();
+        } else {
+            for (i = 0; i < SAMPLES; i++)
+                if (FFABS((int64_t)dst0[i] - dst1[i]) > max_diff)
+                    break;
+            if (i < SAMPLES)
+                fail();
+        }
+        bench_new((uint8_t *)dst1, (const uint8_t *)src, SAMPLES * 4 / bps, volume);
+    }
+}
+
+void checkasm_check_volume(void)
+{
+    /* volume_i is the gain in 1/256 units; the SIMD s16 version is only
+     * used below 32768 */
+    check_scale_samples("scale_samples_s16", AV_SAMPLE_FMT_S16,
+                        (rnd() & 0x3FFF) + 1, 0);
+    report("s16");
+
+    /* the SIMD s32 versions round halves to even and clip to -INT32_MAX */
+    check_scale_samples("scale_samples_s32", AV_SAMPLE_FMT_S32,
+                        (rnd() & 0x3FF) + 1, 1);
+    report("s32");
+}
@@ -65,6 +65,9 @@ static const struct {
     void (*func)(void);
 } tests[] = {
 #if CONFIG_AVCODEC
+    #if CONFIG_AC3DSP
+        { "ac3dsp", checkasm_check_ac3dsp },
+    #endif
     #if CONFIG_ALAC_DECODER
         { "alacdsp", checkasm_check_alacdsp },
     #endif
@@ -74,6 +77,12 @@ static const struct {
     #if CONFIG_DCA_DECODER
         { "synth_filter", checkasm_check_synth_filter },
     #endif
+    #if CONFIG_DIRAC_DECODER
+        { "dirac_dwt", checkasm_check_dirac_dwt },
+    #endif
+    #if CONFIG_DNXHD_ENCODER
+        { "dnxhdenc", checkasm_check_dnxhdenc },
+    #endif
     #if CONFIG_FLACDSP
         { "flacdsp", checkasm_check_flacdsp },
     #endif
@@ -86,12 +95,22 @@ static const struct {
     #if CONFIG_H264QPEL
         { "h264qpel", checkasm_check_h264qpel },
     #endif
+    #if CONFIG_HEVC_DECODER
+        { "hevc_idct", checkasm_check_hevc_idct },
+        { "hevc_mc", checkasm_check_hevc_mc },
+    #endif
     #if CONFIG_JPEG2000_DECODER
         { "jpeg2000dsp", checkasm_check_jpeg2000dsp },
     #endif
+    #if CONFIG_LLVIDDSP
+        { "llviddsp", checkasm_check_llviddsp },
+    #endif
     #if CONFIG_PIXBLOCKDSP
         { "pixblockdsp", checkasm_check_pixblockdsp },
     #endif
+    #if CONFIG_V210_DECODER
+        { "v210dec", checkasm_check_v210dec },
+    #endif
     #if CONFIG_V210_ENCODER
         { "v210enc", checkasm_check_v210enc },
     #endif
@@ -103,10 +122,30 @@ static const struct {
     #endif
 #endif
 #if CONFIG_AVFILTER
+    #if CONFIG_VOLUME_FILTER
+        { "af_volume", checkasm_check_volume },
+    #endif
     #if CONFIG_BLEND_FILTER
         { "vf_blend", checkasm_check_blend },
     #endif
+    #if CONFIG_BWDIF_FILTER
+        { "vf_bwdif", checkasm_check_bwdif },
+    #endif
+    #if CONFIG_W3FDIF_FILTER
+        { "vf_w3fdif", checkasm_check_w3fdif },
+    #endif
+    #if CONFIG_YADIF_FILTER
+        { "vf_yadif", checkasm_check_yadif },
+    #endif
+#endif
+#if CONFIG_SWRESAMPLE
+    { "sw_resample", checkasm_check_sw_resample },
+#endif
+#if CONFIG_SWSCALE
+    { "sw_scale", checkasm_check_sw_scale },
 #endif
+    { "fixed_dsp", checkasm_check_fixed_dsp },
+    { "float_dsp", checkasm_check_float_dsp },
     { NULL }
 };
 
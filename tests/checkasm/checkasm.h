@@ -30,19 +30,34 @@
 #include "libavutil/lfg.h"
 #include "libavutil/timer.h"
 
+void checkasm_check_ac3dsp(void);
 void checkasm_check_alacdsp(void);
 void checkasm_check_blend(void);
 void checkasm_check_bswapdsp(void);
+void checkasm_check_bwdif(void);
+void checkasm_check_dirac_dwt(void);
+void checkasm_check_dnxhdenc(void);
+void checkasm_check_fixed_dsp(void);
 void checkasm_check_flacdsp(void);
+void checkasm_check_float_dsp(void);
 void checkasm_check_fmtconvert(void);
 void checkasm_check_h264pred(void);
 void checkasm_check_h264qpel(void);
+void checkasm_check_hevc_idct(void);
+void checkasm_check_hevc_mc(void);
 void checkasm_check_jpeg2000dsp(void);
+void checkasm_check_llviddsp(void);
 void checkasm_check_pixblockdsp(void);
+void checkasm_check_sw_resample(void);
+void checkasm_check_sw_scale(void);
 void checkasm_check_synth_filter(void);
+void checkasm_check_v210dec(void);
 void checkasm_check_v210enc(void);
 void checkasm_check_vp9dsp(void);
 void checkasm_check_videodsp(void);
+void checkasm_check_volume(void);
+void checkasm_check_w3fdif(void);
+void checkasm_check_yadif(void);
 
 void *checkasm_check_func(void *func, const char *name, ...) av_printf_format(2, 3);
 int checkasm_bench_func(void);
@@ -0,0 +1,144 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavcodec/dirac_dwt.h"
+#include "libavcodec/mathops.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+
+#define WIDTH 1920
+#define ROWS  5
+/* room for the widest element, plus an unaligned tail for the C code */
+#define ROW_SIZE ((WIDTH + 16) * 4)
+
+static const struct {
+    enum dwt_type type;
+    const char *name;
+} wavelets[] = {
+    { DWT_DIRAC_DD9_7,     "dd97"   },
+    { DWT_DIRAC_LEGALL5_3, "legall" },
+    { DWT_DIRAC_DD13_7,    "dd137"  },
+    { DWT_DIRAC_HAAR0,     "haar"   },
+};
+
+static void randomize_rows(uint8_t *buf, int bit_depth)
+{
+    int i;
+
+    /* keep clear of overflows, which the 8-bit SIMD saturates */
+    if (bit_depth == 8) {
+        int16_t *b = (int16_t *)buf;
+        for (i = 0; i < ROWS * ROW_SIZE / 2; i++)
+            b[i] = sign_extend(rnd(), 11);
+    } else {
+        int32_t *b = (int32_t *)buf;
+        for (i = 0; i < ROWS * ROW_SIZE / 4; i++)
+            b[i] = sign_extend(rnd(), bit_depth + 6);
+    }
+}
+
+static void check_vertical(int bit_depth)
+{
+    LOCAL_ALIGNED_32(uint8_t, buf0, [ROWS * ROW_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, buf1, [ROWS * ROW_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, tmp,  [ROW_SIZE]);
+    uint8_t *ref[ROWS], *new[ROWS];
+    int i, j;
+
+    for (i = 0; i < ROWS; i++) {
+        ref[i] = buf0 + i * ROW_SIZE;
+        new[i] = buf1 + i * ROW_SIZE;
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(wavelets); i++) {
+        DWTPlane p = {
+            .width  = WIDTH,
+            .height = 64,
+            .stride = ROW_SIZE,
+            .buf    = buf0,
+            .tmp    = tmp,
+        };
+        DWTContext d;
+        int w = WIDTH - (rnd() & 15);
+
+        if (ff_spatial_idwt_init(&d, &p, wavelets[i].type, 1, bit_depth) < 0)
+            continue;
+
+        if (wavelets[i].type == DWT_DIRAC_HAAR0) {
+            if (check_func(d.vertical_compose, "dirac_vertical_compose_%s_%d",
+                           wavelets[i].name, bit_depth)) {
+                declare_func(void, uint8_t *b0, uint8_t *b1, int width);
+
+                randomize_rows(buf0, bit_depth);
+                memcpy(buf1, buf0, ROWS * ROW_SIZE);
+                call_ref(ref[0], ref[1], w);
+                call_new(new[0], new[1], w);
+                if (memcmp(buf0, buf1, ROWS * ROW_SIZE))
+                    fail();
+                bench_new(new[0], new[1], WIDTH);
+            }
+            continue;
+        }
+
+        for (j = 0; j < 2; j++) {
+            void (*func)(void) = j ? d.vertical_compose_h0 : d.vertical_compose_l0;
+            const char *step   = j ? "h0" : "l0";
+            int taps = wavelets[i].type == DWT_DIRAC_LEGALL5_3 ||
+                       (wavelets[i].type == DWT_DIRAC_DD9_7 && !j) ? 3 : 5;
+
+            if (!check_func(func, "dirac_vertical_compose_%s_%s_%d",
+                            wavelets[i].name, step, bit_depth))
+                continue;
+
+            randomize_rows(buf0, bit_depth);
+            memcpy(buf1, buf0, ROWS * ROW_SIZE);
+            if (taps == 3) {
+                declare_func(void, uint8_t *b0, uint8_t *b1, uint8_t *b2, int width);
+
+                call_ref(ref[0], ref[1], ref[2], w);
+                call_new(new[0], new[1], new[2], w);
+                if (memcmp(buf0, buf1, ROWS * ROW_SIZE))
+                    fail();
+                bench_new(new[0], new[1], new[2], WIDTH);
+            } else {
+                declare_func(void, uint8_t *b0, uint8_t *b1, uint8_t *b2,
+                             uint8_t *b3, uint8_t *b4, int width);
+
+                call_ref(ref[0], ref[1], ref[2], ref[3], ref[4], w);
+                call_new(new[0], new[1], new[2], new[3], new[4], w);
+                if (memcmp(buf0, buf1, ROWS * ROW_SIZE))
+                    fail();
+                bench_new(new[0], new[1], new[2], new[3], new[4], WIDTH);
+            }
+        }
+    }
+}
+
+void checkasm_check_dirac_dwt(void)
+{
+    check_vertical(8);
+    report("vertical_compose_8");
+
+    check_vertical(10);
+    report("vertical_compose_10");
+
+    check_vertical(12);
+    report("vertical_compose_12");
+}
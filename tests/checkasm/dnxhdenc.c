@@ -0,0 +1,62 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavcodec/dnxhdenc.h"
+#include "libavcodec/mathops.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+
+static void check_quantize_10bit(void)
+{
+    LOCAL_ALIGNED_16(int16_t, block0, [64]);
+    LOCAL_ALIGNED_16(int16_t, block1, [64]);
+    LOCAL_ALIGNED_16(int, qmat, [64]);
+    const CIDEntry cid = { .bit_depth = 10 };
+    DNXHDEncContext ctx = { .cid_table = &cid };
+    int i;
+
+    ff_dnxhdenc_init(&ctx);
+
+    if (check_func(ctx.quantize_10bit, "dnxhd_10bit_quantize")) {
+        declare_func(void, int16_t *block, const int *qmat);
+
+        /* the 10-bit forward DCT output fits in 15 bits, and the matrix
+         * is at most (1 << 19) / (qscale * weight) with weights >= 32 */
+        for (i = 0; i < 64; i++) {
+            block0[i] = sign_extend(rnd(), 15);
+            qmat[i]   = (1 << 19) / ((1 + rnd() % 64) * (32 + rnd() % 64));
+        }
+        qmat[0] = 0;
+        memcpy(block1, block0, sizeof(*block0) * 64);
+
+        call_ref(block0, qmat);
+        call_new(block1, qmat);
+        if (memcmp(block0, block1, sizeof(*block0) * 64))
+            fail();
+        bench_new(block1, qmat);
+    }
+
+    report("quantize_10bit");
+}
+
+void checkasm_check_dnxhdenc(void)
+{
+    check_quantize_10bit();
+}
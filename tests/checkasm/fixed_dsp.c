@@ -0,0 +1,174 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include <string.h>
+
+#include "libavutil/fixed_dsp.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+
+#include "checkasm.h"
+
+/* a multiple of 4 which is not a multiple of 8, for the tails */
+#define LEN 260
+
+/* small enough for the sums of products not to overflow */
+#define randomize_buffer(buf, len)                              \
+    do {                                                        \
+        int i;                                                  \
+        for (i = 0; i < len; i++)                               \
+            buf[i] = (int32_t)rnd() >> 8;                       \
+    } while (0)
+
+static void check_vector_fmul(const int *src0, const int *src1)
+{
+    LOCAL_ALIGNED_32(int, dst0, [LEN]);
+    LOCAL_ALIGNED_32(int, dst1, [LEN]);
+    declare_func(void, int *dst, const int *src0, const int *src1, int len);
+
+    call_ref(dst0, src0, src1, LEN - 4);
+    call_new(dst1, src0, src1, LEN - 4);
+    if (memcmp(dst0, dst1, (LEN - 4) * sizeof(*dst0)))
+        fail();
+    bench_new(dst1, src0, src1, LEN - 4);
+}
+
+static void check_vector_fmul_add(const int *src0, const int *src1, const int *src2)
+{
+    LOCAL_ALIGNED_32(int, dst0, [LEN]);
+    LOCAL_ALIGNED_32(int, dst1, [LEN]);
+    declare_func(void, int *dst, const int *src0, const int *src1,
+                 const int *src2, int len);
+
+    call_ref(dst0, src0, src1, src2, LEN - 4);
+    call_new(dst1, src0, src1, src2, LEN - 4);
+    if (memcmp(dst0, dst1, (LEN - 4) * sizeof(*dst0)))
+        fail();
+    bench_new(dst1, src0, src1, src2, LEN - 4);
+}
+
+static void check_vector_fmul_window(const int32_t *src0, const int32_t *src1,
+                                     const int32_t *win)
+{
+    LOCAL_ALIGNED_16(int32_t, dst0, [LEN]);
+    LOCAL_ALIGNED_16(int32_t, dst1, [LEN]);
+    declare_func(void, int32_t *dst, const int32_t *src0, const int32_t *src1,
+                 const int32_t *win, int len);
+
+    call_ref(dst0, src0, src1, win, LEN / 2 - 2);
+    call_new(dst1, src0, src1, win, LEN / 2 - 2);
+    if (memcmp(dst0, dst1, (LEN - 4) * sizeof(*dst0)))
+        fail();
+    bench_new(dst1, src0, src1, win, LEN / 2 - 2);
+}
+
+static void check_vector_fmul_window_scaled(const int32_t *src0, const int32_t *src1,
+                                            const int32_t *win)
+{
+    LOCAL_ALIGNED_16(int16_t, dst0, [LEN]);
+    LOCAL_ALIGNED_16(int16_t, dst1, [LEN]);
+    declare_func(void, int16_t *dst, const int32_t *src0, const int32_t *src1,
+                 const int32_t *win, int len, uint8_t bits);
+
+    call_ref(dst0, src0, src1, win, LEN / 2 - 2, 2);
+    call_new(dst1, src0, src1, win, LEN / 2 - 2, 2);
+    if (memcmp(dst0, dst1, (LEN - 4) * sizeof(*dst0)))
+        fail();
+    bench_new(dst1, src0, src1, win, LEN / 2 - 2, 2);
+}
+
+static void check_vector_fmul_reverse(const int *src0, const int *src1)
+{
+    LOCAL_ALIGNED_32(int, dst0, [LEN]);
+    LOCAL_ALIGNED_32(int, dst1, [LEN]);
+    declare_func(void, int *dst, const int *src0, const int *src1, int len);
+
+    call_ref(dst0, src0, src1, LEN - 4);
+    call_new(dst1, src0, src1, LEN - 4);
+    if (memcmp(dst0, dst1, (LEN - 4) * sizeof(*dst0)))
+        fail();
+    bench_new(dst1, src0, src1, LEN - 4);
+}
+
+static void check_butterflies(const int *src0, const int *src1)
+{
+    LOCAL_ALIGNED_16(int, v1_0, [LEN]);
+    LOCAL_ALIGNED_16(int, v2_0, [LEN]);
+    LOCAL_ALIGNED_16(int, v1_1, [LEN]);
+    LOCAL_ALIGNED_16(int, v2_1, [LEN]);
+    declare_func(void, int *av_restrict v1, int *av_restrict v2, int len);
+
+    memcpy(v1_0, src0, LEN * sizeof(*v1_0));
+    memcpy(v2_0, src1, LEN * sizeof(*v2_0));
+    memcpy(v1_1, src0, LEN * sizeof(*v1_1));
+    memcpy(v2_1, src1, LEN * sizeof(*v2_1));
+    call_ref(v1_0, v2_0, LEN);
+    call_new(v1_1, v2_1, LEN);
+    if (memcmp(v1_0, v1_1, LEN * sizeof(*v1_0)) ||
+        memcmp(v2_0, v2_1, LEN * sizeof(*v2_0)))
+        fail();
+    bench_new(v1_1, v2_1, LEN);
+}
+
+static void check_scalarproduct_fixed(const int *src0, const int *src1)
+{
+    int res0, res1;
+    declare_func(int, const int *v1, const int *v2, int len);
+
+    res0 = call_ref(src0, src1, LEN);
+    res1 = call_new(src0, src1, LEN);
+    if (res0 != res1)
+        fail();
+    bench_new(src0, src1, LEN);
+}
+
+void checkasm_check_fixed_dsp(void)
+{
+    LOCAL_ALIGNED_32(int, src0, [LEN]);
+    LOCAL_ALIGNED_32(int, src1, [LEN]);
+    LOCAL_ALIGNED_32(int, src2, [LEN]);
+    AVFixedDSPContext *fdsp = avpriv_alloc_fixed_dsp(1);
+
+    if (!fdsp) {
+        fprintf(stderr, "fixed_dsp: Out of memory error\n");
+        return;
+    }
+
+    randomize_buffer(src0, LEN);
+    randomize_buffer(src1, LEN);
+    randomize_buffer(src2, LEN);
+
+    if (check_func(fdsp->vector_fmul, "vector_fmul_fixed"))
+        check_vector_fmul(src0, src1);
+    if (check_func(fdsp->vector_fmul_add, "vector_fmul_add_fixed"))
+        check_vector_fmul_add(src0, src1, src2);
+    if (check_func(fdsp->vector_fmul_reverse, "vector_fmul_reverse_fixed"))
+        check_vector_fmul_reverse(src0, src1);
+    if (check_func(fdsp->vector_fmul_window, "vector_fmul_window_fixed"))
+        check_vector_fmul_window(src0, src1, src2);
+    if (check_func(fdsp->vector_fmul_window_scaled, "vector_fmul_window_scaled"))
+        check_vector_fmul_window_scaled(src0, src1, src2);
+    if (check_func(fdsp->butterflies_fixed, "butterflies_fixed"))
+        check_butterflies(src0, src1);
+    if (check_func(fdsp->scalarproduct_fixed, "scalarproduct_fixed"))
+        check_scalarproduct_fixed(src0, src1);
+    report("fixed_dsp");
+
+    av_freep(&fdsp);
+}
@@ -0,0 +1,228 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include <float.h>
+#include <string.h>
+
+#include "libavutil/float_dsp.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+
+#include "checkasm.h"
+
+/* a multiple of 4 which is not a multiple of 8, for the tails */
+#define LEN 260
+
+#define randomize_buffer(buf, len)                              \
+    do {                                                        \
+        int i;                                                  \
+        for (i = 0; i < len; i++)                               \
+            buf[i] = (float)rnd() / (UINT_MAX >> 1) - 1.0f;     \
+    } while (0)
+
+static void check_vector_fmul(AVFloatDSPContext *fdsp, const float *src0,
+                              const float *src1)
+{
+    LOCAL_ALIGNED_32(float, dst0, [LEN]);
+    LOCAL_ALIGNED_32(float, dst1, [LEN]);
+    declare_func(void, float *dst, const float *src0, const float *src1, int len);
+
+    if (check_func(fdsp->vector_fmul, "vector_fmul")) {
+        call_ref(dst0, src0, src1, LEN - 4);
+        call_new(dst1, src0, src1, LEN - 4);
+        if (!float_near_ulp_array(dst0, dst1, 1, LEN - 4))
+            fail();
+        bench_new(dst1, src0, src1, LEN - 4);
+    }
+}
+
+static void check_vector_fmac_scalar(AVFloatDSPContext *fdsp, const float *src0,
+                                     const float *src1, float mul)
+{
+    LOCAL_ALIGNED_32(float, dst0, [LEN]);
+    LOCAL_ALIGNED_32(float, dst1, [LEN]);
+    declare_func(void, float *dst, const float *src, float mul, int len);
+
+    if (check_func(fdsp->vector_fmac_scalar, "vector_fmac_scalar")) {
+        memcpy(dst0, src1, LEN * sizeof(*dst0));
+        memcpy(dst1, src1, LEN * sizeof(*dst1));
+        call_ref(dst0, src0, mul, LEN - 4);
+        call_new(dst1, src0, mul, LEN - 4);
+        if (!float_near_abs_eps_array(dst0, dst1, 2 * FLT_EPSILON, LEN - 4))
+            fail();
+        bench_new(dst1, src0, mul, LEN - 4);
+    }
+}
+
+static void check_vector_fmul_scalar(AVFloatDSPContext *fdsp, const float *src,
+                                     float mul)
+{
+    LOCAL_ALIGNED_16(float, dst0, [LEN]);
+    LOCAL_ALIGNED_16(float, dst1, [LEN]);
+    declare_func(void, float *dst, const float *src, float mul, int len);
+
+    if (check_func(fdsp->vector_fmul_scalar, "vector_fmul_scalar")) {
+        call_ref(dst0, src, mul, LEN);
+        call_new(dst1, src, mul, LEN);
+        if (!float_near_ulp_array(dst0, dst1, 1, LEN))
+            fail();
+        bench_new(dst1, src, mul, LEN);
+    }
+}
+
+static void check_vector_dmul_scalar(AVFloatDSPContext *fdsp)
+{
+    LOCAL_ALIGNED_32(double, src,  [LEN]);
+    LOCAL_ALIGNED_32(double, dst0, [LEN]);
+    LOCAL_ALIGNED_32(double, dst1, [LEN]);
+    double mul = (double)rnd() / (UINT_MAX >> 1) - 1.0;
+    int i;
+    declare_func(void, double *dst, const double *src, double mul, int len);
+
+    for (i = 0; i < LEN; i++)
+        src[i] = (double)rnd() / (UINT_MAX >> 1) - 1.0;
+
+    if (check_func(fdsp->vector_dmul_scalar, "vector_dmul_scalar")) {
+        call_ref(dst0, src, mul, LEN - 4);
+        call_new(dst1, src, mul, LEN - 4);
+        if (memcmp(dst0, dst1, (LEN - 4) * sizeof(*dst0)))
+            fail();
+        bench_new(dst1, src, mul, LEN - 4);
+    }
+}
+
+static void check_vector_fmul_window(AVFloatDSPContext *fdsp, const float *src0,
+                                     const float *src1, const float *win)
+{
+    LOCAL_ALIGNED_16(float, dst0, [2 * LEN]);
+    LOCAL_ALIGNED_16(float, dst1, [2 * LEN]);
+    declare_func(void, float *dst, const float *src0, const float *src1,
+                 const float *win, int len);
+
+    if (check_func(fdsp->vector_fmul_window, "vector_fmul_window")) {
+        call_ref(dst0, src0, src1, win, LEN / 2 - 2);
+        call_new(dst1, src0, src1, win, LEN / 2 - 2);
+        if (!float_near_abs_eps_array(dst0, dst1, 2 * FLT_EPSILON, LEN - 4))
+            fail();
+        bench_new(dst1, src0, src1, win, LEN / 2 - 2);
+    }
+}
+
+static void check_vector_fmul_add(AVFloatDSPContext *fdsp, const float *src0,
+                                  const float *src1, const float *src2)
+{
+    LOCAL_ALIGNED_32(float, dst0, [LEN]);
+    LOCAL_ALIGNED_32(float, dst1, [LEN]);
+    declare_func(void, float *dst, const float *src0, const float *src1,
+                 const float *src2, int len);
+
+    if (check_func(fdsp->vector_fmul_add, "vector_fmul_add")) {
+        call_ref(dst0, src0, src1, src2, LEN - 4);
+        call_new(dst1, src0, src1, src2, LEN - 4);
+        if (!float_near_abs_eps_array(dst0, dst1, 2 * FLT_EPSILON, LEN - 4))
+            fail();
+        bench_new(dst1, src0, src1, src2, LEN - 4);
+    }
+}
+
+static void check_vector_fmul_reverse(AVFloatDSPContext *fdsp, const float *src0,
+                                      const float *src1)
+{
+    LOCAL_ALIGNED_32(float, dst0, [LEN]);
+    LOCAL_ALIGNED_32(float, dst1, [LEN]);
+    declare_func(void, float *dst, const float *src0, const float *src1, int len);
+
+    if (check_func(fdsp->vector_fmul_reverse, "vector_fmul_reverse")) {
+        call_ref(dst0, src0, src1, LEN - 4);
+        call_new(dst1, src0, src1, LEN - 4);
+        if (!float_near_ulp_array(dst0, dst1, 1, LEN - 4))
+            fail();
+        bench_new(dst1, src0, src1, LEN - 4);
+    }
+}
+
+static void check_butterflies_float(AVFloatDSPContext *fdsp, const float *src0,
+                                    const float *src1)
+{
+    LOCAL_ALIGNED_16(float, v1_0, [LEN]);
+    LOCAL_ALIGNED_16(float, v2_0, [LEN]);
+    LOCAL_ALIGNED_16(float, v1_1, [LEN]);
+    LOCAL_ALIGNED_16(float, v2_1, [LEN]);
+    declare_func(void, float *av_restrict v1, float *av_restrict v2, int len);
+
+    if (check_func(fdsp->butterflies_float, "butterflies_float")) {
+        memcpy(v1_0, src0, LEN * sizeof(*v1_0));
+        memcpy(v2_0, src1, LEN * sizeof(*v2_0));
+        memcpy(v1_1, src0, LEN * sizeof(*v1_1));
+        memcpy(v2_1, src1, LEN * sizeof(*v2_1));
+        call_ref(v1_0, v2_0, LEN);
+        call_new(v1_1, v2_1, LEN);
+        if (!float_near_ulp_array(v1_0, v1_1, 1, LEN) ||
+            !float_near_ulp_array(v2_0, v2_1, 1, LEN))
+            fail();
+        bench_new(v1_1, v2_1, LEN);
+    }
+}
+
+static void check_scalarproduct_float(AVFloatDSPContext *fdsp, const float *src0,
+                                      const float *src1)
+{
+    float res0, res1;
+    declare_func(float, const float *v1, const float *v2, int len);
+
+    if (check_func(fdsp->scalarproduct_float, "scalarproduct_float")) {
+        res0 = call_ref(src0, src1, LEN);
+        res1 = call_new(src0, src1, LEN);
+        /* the products are summed in a different order */
+        if (!float_near_abs_eps(res0, res1, LEN * 2 * FLT_EPSILON))
+            fail();
+        bench_new(src0, src1, LEN);
+    }
+}
+
+void checkasm_check_float_dsp(void)
+{
+    LOCAL_ALIGNED_32(float, src0, [LEN]);
+    LOCAL_ALIGNED_32(float, src1, [LEN]);
+    LOCAL_ALIGNED_32(float, src2, [LEN]);
+    AVFloatDSPContext *fdsp = avpriv_float_dsp_alloc(1);
+    float mul = (float)rnd() / (UINT_MAX >> 1) - 1.0f;
+
+    if (!fdsp) {
+        fprintf(stderr, "float_dsp: Out of memory error\n");
+        return;
+    }
+
+    randomize_buffer(src0, LEN);
+    randomize_buffer(src1, LEN);
+    randomize_buffer(src2, LEN);
+
+    check_vector_fmul(fdsp, src0, src1);
+    check_vector_fmac_scalar(fdsp, src0, src1, mul);
+    check_vector_fmul_scalar(fdsp, src0, mul);
+    check_vector_dmul_scalar(fdsp);
+    check_vector_fmul_window(fdsp, src0, src1, src2);
+    check_vector_fmul_add(fdsp, src0, src1, src2);
+    check_vector_fmul_reverse(fdsp, src0, src1);
+    check_butterflies_float(fdsp, src0, src1);
+    check_scalarproduct_float(fdsp, src0, src1);
+    report("float_dsp");
+
+    av_freep(&fdsp);
+}
@@ -0,0 +1,139 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavcodec/hevcdsp.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/intreadwrite.h"
+
+static const uint32_t pixel_mask[3] = { 0xffffffff, 0x03ff03ff, 0x0fff0fff };
+
+#define SIZEOF_PIXEL ((bit_depth + 7) / 8)
+
+/* the residuals of 8-bit content fit in 9 bits, and one more per extra bit */
+#define randomize_coeffs(buf, len)                                   \
+    do {                                                             \
+        int range = 1 << (bit_depth + 1);                            \
+        int k;                                                       \
+        for (k = 0; k < len; k++)                                    \
+            buf[k] = (int)(rnd() % range) - (range >> 1);            \
+    } while (0)
+
+#define randomize_pixels(buf0, buf1, len)                            \
+    do {                                                             \
+        uint32_t mask = pixel_mask[(bit_depth - 8) >> 1];            \
+        int k;                                                       \
+        for (k = 0; k < len; k += 4) {                               \
+            uint32_t r = rnd() & mask;                               \
+            AV_WN32A(buf0 + k, r);                                   \
+            AV_WN32A(buf1 + k, r);                                   \
+        }                                                            \
+    } while (0)
+
+static void check_idct_dc(HEVCDSPContext *h, int bit_depth)
+{
+    LOCAL_ALIGNED_32(int16_t, coeffs0, [32 * 32]);
+    LOCAL_ALIGNED_32(int16_t, coeffs1, [32 * 32]);
+    int i;
+    declare_func(void, int16_t *coeffs);
+
+    for (i = 0; i < 4; i++) {
+        int size = 4 << i;
+        if (check_func(h->idct_dc[i], "hevc_idct%dx%d_dc_%d", size, size, bit_depth)) {
+            randomize_coeffs(coeffs0, size * size);
+            memcpy(coeffs1, coeffs0, sizeof(*coeffs0) * size * size);
+            call_ref(coeffs0);
+            call_new(coeffs1);
+            if (memcmp(coeffs0, coeffs1, sizeof(*coeffs0) * size * size))
+                fail();
+            bench_new(coeffs1);
+        }
+    }
+}
+
+static void check_idct(HEVCDSPContext *h, int bit_depth)
+{
+    LOCAL_ALIGNED_32(int16_t, coeffs0, [32 * 32]);
+    LOCAL_ALIGNED_32(int16_t, coeffs1, [32 * 32]);
+    int i;
+    declare_func(void, int16_t *coeffs, int col_limit);
+
+    for (i = 0; i < 4; i++) {
+        int size = 4 << i;
+        if (check_func(h->idct[i], "hevc_idct%dx%d_%d", size, size, bit_depth)) {
+            randomize_coeffs(coeffs0, size * size);
+            memcpy(coeffs1, coeffs0, sizeof(*coeffs0) * size * size);
+            call_ref(coeffs0, size);
+            call_new(coeffs1, size);
+            if (memcmp(coeffs0, coeffs1, sizeof(*coeffs0) * size * size))
+                fail();
+            bench_new(coeffs1, size);
+        }
+    }
+}
+
+static void check_transform_add(HEVCDSPContext *h, int bit_depth)
+{
+    LOCAL_ALIGNED_32(int16_t, coeffs0, [32 * 32]);
+    LOCAL_ALIGNED_32(int16_t, coeffs1, [32 * 32]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [32 * 32 * 2]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [32 * 32 * 2]);
+    int i;
+    declare_func(void, uint8_t *dst, int16_t *coeffs, ptrdiff_t stride);
+
+    for (i = 0; i < 4; i++) {
+        int size = 4 << i;
+        ptrdiff_t stride = size * SIZEOF_PIXEL;
+        if (check_func(h->transform_add[i], "hevc_transform_add%d_%d", size, bit_depth)) {
+            randomize_coeffs(coeffs0, size * size);
+            memcpy(coeffs1, coeffs0, sizeof(*coeffs0) * size * size);
+            randomize_pixels(dst0, dst1, size * stride);
+            call_ref(dst0, coeffs0, stride);
+            call_new(dst1, coeffs1, stride);
+            if (memcmp(dst0, dst1, size * stride))
+                fail();
+            bench_new(dst1, coeffs1, stride);
+        }
+    }
+}
+
+void checkasm_check_hevc_idct(void)
+{
+    HEVCDSPContext h;
+    int bit_depth;
+
+    for (bit_depth = 8; bit_depth <= 12; bit_depth += 2) {
+        ff_hevc_dsp_init(&h, bit_depth);
+        check_idct_dc(&h, bit_depth);
+    }
+    report("idct_dc");
+
+    for (bit_depth = 8; bit_depth <= 12; bit_depth += 2) {
+        ff_hevc_dsp_init(&h, bit_depth);
+        check_idct(&h, bit_depth);
+    }
+    report("idct");
+
+    for (bit_depth = 8; bit_depth <= 12; bit_depth += 2) {
+        ff_hevc_dsp_init(&h, bit_depth);
+        check_transform_add(&h, bit_depth);
+    }
+    report("transform_add");
+}
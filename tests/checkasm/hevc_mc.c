@@ -0,0 +1,190 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavcodec/hevcdsp.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/intreadwrite.h"
+
+static const uint32_t pixel_mask[3] = { 0xffffffff, 0x03ff03ff, 0x0fff0fff };
+static const int sizes[10] = { 2, 4, 6, 8, 12, 16, 24, 32, 48, 64 };
+
+#define SIZEOF_PIXEL ((bit_depth + 7) / 8)
+#define BORDER 4
+#define SRC_STRIDE ((MAX_PB_SIZE + 2 * BORDER) * 2)
+#define SRC_SIZE (SRC_STRIDE * (MAX_PB_SIZE + 2 * BORDER))
+#define DST_SIZE (MAX_PB_SIZE * MAX_PB_SIZE * 2)
+
+#define randomize_buffers()                                \
+    do {                                                   \
+        uint32_t mask = pixel_mask[(bit_depth - 8) >> 1];  \
+        int k;                                             \
+        for (k = 0; k < SRC_SIZE; k += 4) {                \
+            uint32_t r = rnd() & mask;                     \
+            AV_WN32A(buf0 + k, r);                         \
+            AV_WN32A(buf1 + k, r);                         \
+        }                                                  \
+        for (k = 0; k < DST_SIZE; k += 4) {                \
+            uint32_t r = rnd();                            \
+            AV_WN32A(dst0 + k, r);                         \
+            AV_WN32A(dst1 + k, r);                         \
+            /* the intermediate predictions are 14-bit */  \
+            r = rnd() & 0x3fff3fff;                        \
+            AV_WN32A(ref + k, r);                          \
+        }                                                  \
+    } while (0)
+
+/* the filters read BORDER pixels before and after the block */
+#define src0 (buf0 + BORDER * SRC_STRIDE + BORDER * 2)
+#define src1 (buf1 + BORDER * SRC_STRIDE + BORDER * 2)
+
+static void check_put_hevc(HEVCDSPContext *h, int bit_depth,
+                           uint8_t *buf0, uint8_t *buf1, uint8_t *dst0, uint8_t *dst1,
+                           uint8_t *ref)
+{
+    int qpel, i, j;
+    declare_func(void, int16_t *dst, uint8_t *src, ptrdiff_t srcstride,
+                 int height, intptr_t mx, intptr_t my, int width);
+
+    for (qpel = 0; qpel < 2; qpel++) {
+        const char *type = qpel ? "qpel" : "epel";
+        int nb_filters   = qpel ? 3 : 7;
+
+        for (i = 0; i < 10; i++) {
+            int size = sizes[i];
+            for (j = 0; j < 4; j++) {
+                intptr_t mx = (j & 1) ? 1 + rnd() % nb_filters : 0;
+                intptr_t my = (j & 2) ? 1 + rnd() % nb_filters : 0;
+                if (check_func(qpel ? h->put_hevc_qpel[i][j >> 1][j & 1] :
+                                      h->put_hevc_epel[i][j >> 1][j & 1],
+                               "put_hevc_%s%d_%s%s_%d", type, size,
+                               j & 1 ? "h" : "", j & 2 ? "v" : "", bit_depth)) {
+                    randomize_buffers();
+                    call_ref((int16_t *)dst0, src0, SRC_STRIDE, size, mx, my, size);
+                    call_new((int16_t *)dst1, src1, SRC_STRIDE, size, mx, my, size);
+                    if (memcmp(dst0, dst1, DST_SIZE))
+                        fail();
+                    bench_new((int16_t *)dst1, src1, SRC_STRIDE, size, mx, my, size);
+                }
+            }
+        }
+    }
+}
+
+static void check_put_hevc_uni(HEVCDSPContext *h, int bit_depth,
+                               uint8_t *buf0, uint8_t *buf1, uint8_t *dst0, uint8_t *dst1,
+                               uint8_t *ref)
+{
+    int qpel, i, j;
+    declare_func(void, uint8_t *dst, ptrdiff_t dststride, uint8_t *src,
+                 ptrdiff_t srcstride, int height, intptr_t mx, intptr_t my, int width);
+
+    for (qpel = 0; qpel < 2; qpel++) {
+        const char *type = qpel ? "qpel" : "epel";
+        int nb_filters   = qpel ? 3 : 7;
+
+        for (i = 0; i < 10; i++) {
+            int size = sizes[i];
+            for (j = 0; j < 4; j++) {
+                intptr_t mx = (j & 1) ? 1 + rnd() % nb_filters : 0;
+                intptr_t my = (j & 2) ? 1 + rnd() % nb_filters : 0;
+                if (check_func(qpel ? h->put_hevc_qpel_uni[i][j >> 1][j & 1] :
+                                      h->put_hevc_epel_uni[i][j >> 1][j & 1],
+                               "put_hevc_%s_uni%d_%s%s_%d", type, size,
+                               j & 1 ? "h" : "", j & 2 ? "v" : "", bit_depth)) {
+                    ptrdiff_t dststride = MAX_PB_SIZE * SIZEOF_PIXEL;
+                    randomize_buffers();
+                    call_ref(dst0, dststride, src0, SRC_STRIDE, size, mx, my, size);
+                    call_new(dst1, dststride, src1, SRC_STRIDE, size, mx, my, size);
+                    if (memcmp(dst0, dst1, DST_SIZE))
+                        fail();
+                    bench_new(dst1, dststride, src1, SRC_STRIDE, size, mx, my, size);
+                }
+            }
+        }
+    }
+}
+
+static void check_put_hevc_bi(HEVCDSPContext *h, int bit_depth,
+                              uint8_t *buf0, uint8_t *buf1, uint8_t *dst0, uint8_t *dst1,
+                              uint8_t *ref)
+{
+    int qpel, i, j;
+    declare_func(void, uint8_t *dst, ptrdiff_t dststride, uint8_t *src,
+                 ptrdiff_t srcstride, int16_t *src2,
+                 int height, intptr_t mx, intptr_t my, int width);
+
+    for (qpel = 0; qpel < 2; qpel++) {
+        const char *type = qpel ? "qpel" : "epel";
+        int nb_filters   = qpel ? 3 : 7;
+
+        for (i = 0; i < 10; i++) {
+            int size = sizes[i];
+            for (j = 0; j < 4; j++) {
+                intptr_t mx = (j & 1) ? 1 + rnd() % nb_filters : 0;
+                intptr_t my = (j & 2) ? 1 + rnd() % nb_filters : 0;
+                if (check_func(qpel ? h->put_hevc_qpel_bi[i][j >> 1][j & 1] :
+                                      h->put_hevc_epel_bi[i][j >> 1][j & 1],
+                               "put_hevc_%s_bi%d_%s%s_%d", type, size,
+                               j & 1 ? "h" : "", j & 2 ? "v" : "", bit_depth)) {
+                    ptrdiff_t dststride = MAX_PB_SIZE * SIZEOF_PIXEL;
+                    randomize_buffers();
+                    call_ref(dst0, dststride, src0, SRC_STRIDE, (int16_t *)ref,
+                             size, mx, my, size);
+                    call_new(dst1, dststride, src1, SRC_STRIDE, (int16_t *)ref,
+                             size, mx, my, size);
+                    if (memcmp(dst0, dst1, DST_SIZE))
+                        fail();
+                    bench_new(dst1, dststride, src1, SRC_STRIDE, (int16_t *)ref,
+                              size, mx, my, size);
+                }
+            }
+        }
+    }
+}
+
+void checkasm_check_hevc_mc(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, buf0, [SRC_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, buf1, [SRC_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [DST_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [DST_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, ref,  [DST_SIZE]);
+    HEVCDSPContext h;
+    int bit_depth;
+
+    for (bit_depth = 8; bit_depth <= 12; bit_depth += 2) {
+        ff_hevc_dsp_init(&h, bit_depth);
+        check_put_hevc(&h, bit_depth, buf0, buf1, dst0, dst1, ref);
+    }
+    report("put_hevc");
+
+    for (bit_depth = 8; bit_depth <= 12; bit_depth += 2) {
+        ff_hevc_dsp_init(&h, bit_depth);
+        check_put_hevc_uni(&h, bit_depth, buf0, buf1, dst0, dst1, ref);
+    }
+    report("put_hevc_uni");
+
+    for (bit_depth = 8; bit_depth <= 12; bit_depth += 2) {
+        ff_hevc_dsp_init(&h, bit_depth);
+        check_put_hevc_bi(&h, bit_depth, buf0, buf1, dst0, dst1, ref);
+    }
+    report("put_hevc_bi");
+}
@@ -0,0 +1,113 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavcodec/lossless_videodsp.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+
+#define WIDTH 1920
+/* the SIMD versions process whole registers past the end of the line */
+#define PAD   32
+
+#define randomize_buffers(buf, mask)            \
+    do {                                        \
+        int k;                                  \
+        for (k = 0; k < WIDTH + PAD; k++)       \
+            buf[k] = rnd() & (mask);            \
+    } while (0)
+
+static void check_sub_median_pred(int depth)
+{
+    LOCAL_ALIGNED_16(uint16_t, src1, [WIDTH + PAD]);
+    LOCAL_ALIGNED_16(uint16_t, src2, [WIDTH + PAD]);
+    LOCAL_ALIGNED_16(uint16_t, dst0, [WIDTH + PAD]);
+    LOCAL_ALIGNED_16(uint16_t, dst1, [WIDTH + PAD]);
+    const unsigned mask = (1 << depth) - 1;
+    LLVidDSPContext c;
+    AVCodecContext avctx = {
+        .pix_fmt = depth == 10 ? AV_PIX_FMT_YUV422P10 : AV_PIX_FMT_YUV422P12,
+    };
+
+    ff_llviddsp_init(&c, &avctx);
+
+    if (check_func(c.sub_hfyu_median_pred_int16, "sub_hfyu_median_pred_int16_%d", depth)) {
+        int w = 1 + rnd() % WIDTH;
+        int left0, left1, left_top0, left_top1;
+        declare_func(void, uint16_t *dst, const uint16_t *src1, const uint16_t *src2,
+                     unsigned mask, int w, int *left, int *left_top);
+
+        randomize_buffers(src1, mask);
+        randomize_buffers(src2, mask);
+        left0 = left1 = rnd() & mask;
+        left_top0 = left_top1 = rnd() & mask;
+
+        call_ref(dst0, src1, src2, mask, w, &left0, &left_top0);
+        call_new(dst1, src1, src2, mask, w, &left1, &left_top1);
+        if (memcmp(dst0, dst1, w * sizeof(*dst0)) ||
+            left0 != left1 || left_top0 != left_top1)
+            fail();
+        bench_new(dst1, src1, src2, mask, WIDTH, &left1, &left_top1);
+    }
+}
+
+static void check_add_median_pred(int depth)
+{
+    LOCAL_ALIGNED_16(uint16_t, top,  [WIDTH + PAD]);
+    LOCAL_ALIGNED_16(uint16_t, diff, [WIDTH + PAD]);
+    LOCAL_ALIGNED_16(uint16_t, dst0, [WIDTH + PAD]);
+    LOCAL_ALIGNED_16(uint16_t, dst1, [WIDTH + PAD]);
+    const unsigned mask = (1 << depth) - 1;
+    LLVidDSPContext c;
+    AVCodecContext avctx = {
+        .pix_fmt = depth == 10 ? AV_PIX_FMT_YUV422P10 : AV_PIX_FMT_YUV422P12,
+    };
+
+    ff_llviddsp_init(&c, &avctx);
+
+    if (check_func(c.add_hfyu_median_pred_int16, "add_hfyu_median_pred_int16_%d", depth)) {
+        int w = 1 + rnd() % WIDTH;
+        int left0, left1, left_top0, left_top1;
+        declare_func(void, uint16_t *dst, const uint16_t *top, const uint16_t *diff,
+                     unsigned mask, int w, int *left, int *left_top);
+
+        randomize_buffers(top, mask);
+        randomize_buffers(diff, mask);
+        left0 = left1 = rnd() & mask;
+        left_top0 = left_top1 = rnd() & mask;
+
+        call_ref(dst0, top, diff, mask, w, &left0, &left_top0);
+        call_new(dst1, top, diff, mask, w, &left1, &left_top1);
+        if (memcmp(dst0, dst1, w * sizeof(*dst0)) ||
+            left0 != left1 || left_top0 != left_top1)
+            fail();
+        bench_new(dst1, top, diff, mask, WIDTH, &left1, &left_top1);
+    }
+}
+
+void checkasm_check_llviddsp(void)
+{
+    check_sub_median_pred(10);
+    check_sub_median_pred(12);
+    report("sub_hfyu_median_pred_int16");
+
+    check_add_median_pred(10);
+    check_add_median_pred(12);
+    report("add_hfyu_median_pred_int16");
+}
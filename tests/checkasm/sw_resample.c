@@ -0,0 +1,162 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+
+#include "libswresample/resample.h"
+
+#include "checkasm.h"
+
+#define SRC_SAMPLES 1024
+#define DST_SAMPLES 257     /* not a multiple of the SIMD widths */
+/* the SIMD versions read the filter taps in blocks of up to 8 */
+#define PADDING 64
+
+static int int16_near_array(const int16_t *a, const int16_t *b, int max_diff,
+                            int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        if (FFABS(a[i] - b[i]) > max_diff)
+            return 0;
+    return 1;
+}
+
+static int double_near_abs_eps_array(const double *a, const double *b,
+                                     double eps, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        if (fabs(a[i] - b[i]) > eps)
+            return 0;
+    return 1;
+}
+
+static void randomize_src(uint8_t *src, enum AVSampleFormat format)
+{
+    int i;
+
+    for (i = 0; i < SRC_SAMPLES + PADDING; i++) {
+        switch (format) {
+        case AV_SAMPLE_FMT_S16P:
+            ((int16_t *)src)[i] = rnd();
+            break;
+        case AV_SAMPLE_FMT_FLTP:
+            ((float *)src)[i] = (float)rnd() / UINT_MAX * 2.0f - 1.0f;
+            break;
+        case AV_SAMPLE_FMT_DBLP:
+            ((double *)src)[i] = (double)rnd() / UINT_MAX * 2.0 - 1.0;
+            break;
+        }
+    }
+}
+
+static int check_output(const uint8_t *a, const uint8_t *b,
+                        enum AVSampleFormat format, int linear)
+{
+    switch (format) {
+    case AV_SAMPLE_FMT_S16P:
+        /* the interpolation between two phases is rounded differently */
+        return int16_near_array((const int16_t *)a, (const int16_t *)b,
+                                linear, DST_SAMPLES);
+    case AV_SAMPLE_FMT_FLTP:
+        return float_near_abs_eps_array((const float *)a, (const float *)b,
+                                        1e-5, DST_SAMPLES);
+    case AV_SAMPLE_FMT_DBLP:
+        return double_near_abs_eps_array((const double *)a, (const double *)b,
+                                         1e-12, DST_SAMPLES);
+    }
+    return 0;
+}
+
+static void check_resample(void)
+{
+    static const struct {
+        enum AVSampleFormat format;
+        const char *name;
+    } formats[] = {
+        { AV_SAMPLE_FMT_S16P, "int16"  },
+        { AV_SAMPLE_FMT_FLTP, "float"  },
+        { AV_SAMPLE_FMT_DBLP, "double" },
+    };
+    static const int rates[][2] = {
+        { 44100, 48000 },
+        { 48000, 44100 },
+        { 48000, 22050 },
+    };
+    LOCAL_ALIGNED_32(uint8_t, src, [(SRC_SAMPLES + PADDING) * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [(DST_SAMPLES + PADDING) * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [(DST_SAMPLES + PADDING) * 8]);
+    int f, r, linear;
+
+    declare_func_emms(AV_CPU_FLAG_MMXEXT, int, ResampleContext *c, void *dst,
+                      const void *src, int n, int update_ctx);
+
+    for (f = 0; f < FF_ARRAY_ELEMS(formats); f++) {
+        randomize_src(src, formats[f].format);
+
+        for (linear = 0; linear <= 1; linear++) {
+            for (r = 0; r < FF_ARRAY_ELEMS(rates); r++) {
+                ResampleContext *c = swri_resampler.init(NULL, rates[r][1], rates[r][0],
+                                                         32, 10, linear, 0.97,
+                                                         formats[f].format,
+                                                         SWR_FILTER_TYPE_KAISER,
+                                                         9, 0, 0);
+                if (!c) {
+                    fail();
+                    return;
+                }
+
+                if (check_func(c->dsp.resample, "resample_%s_%s_%d_%d",
+                               linear ? "linear" : "common", formats[f].name,
+                               rates[r][0], rates[r][1])) {
+                    /* start between two phases, at the beginning of the
+                     * input, as swresample does with a padded input */
+                    int phase = rnd() & c->phase_mask;
+                    int ret0, ret1;
+
+                    memset(dst0, 0, (DST_SAMPLES + PADDING) * 8);
+                    memset(dst1, 0, (DST_SAMPLES + PADDING) * 8);
+
+                    c->index = phase;
+                    c->frac  = rnd() % c->src_incr;
+                    ret0 = call_ref(c, dst0, src, DST_SAMPLES, 0);
+                    ret1 = call_new(c, dst1, src, DST_SAMPLES, 0);
+                    if (ret0 != ret1 ||
+                        !check_output(dst0, dst1, formats[f].format, linear))
+                        fail();
+                    bench_new(c, dst1, src, DST_SAMPLES, 0);
+                }
+                swri_resampler.free(&c);
+            }
+        }
+    }
+}
+
+void checkasm_check_sw_resample(void)
+{
+    check_resample();
+    report("resample");
+}
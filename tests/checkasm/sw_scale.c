@@ -0,0 +1,530 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+
+#include "libswscale/rgb2rgb.h"
+#include "libswscale/swscale.h"
+#include "libswscale/swscale_internal.h"
+
+#include "checkasm.h"
+
+#define SRC_PIXELS 512
+#define DST_PIXELS 123      /* not a multiple of the SIMD widths */
+#define MAX_FILTER_WIDTH 40
+/* the SIMD scalers read and write up to 7 pixels past the end */
+#define PADDING 8
+
+static void check_hscale(void)
+{
+    static const int filter_sizes[] = { 4, 8, 12, 16, MAX_FILTER_WIDTH };
+    static const struct {
+        enum AVPixelFormat src, dst;
+    } formats[] = {
+        { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P     },
+        { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P16LE },
+        { AV_PIX_FMT_YUV420P9LE,  AV_PIX_FMT_YUV420P     },
+        { AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV420P16LE },
+        { AV_PIX_FMT_YUV420P12LE, AV_PIX_FMT_YUV420P     },
+        { AV_PIX_FMT_YUV420P14LE, AV_PIX_FMT_YUV420P16LE },
+        { AV_PIX_FMT_YUV420P16LE, AV_PIX_FMT_YUV420P     },
+        { AV_PIX_FMT_YUV420P16LE, AV_PIX_FMT_YUV420P16LE },
+    };
+    LOCAL_ALIGNED_32(uint16_t, src, [SRC_PIXELS + MAX_FILTER_WIDTH]);
+    LOCAL_ALIGNED_32(int32_t, dst0, [DST_PIXELS + PADDING]);
+    LOCAL_ALIGNED_32(int32_t, dst1, [DST_PIXELS + PADDING]);
+    LOCAL_ALIGNED_32(int16_t, filter, [(DST_PIXELS + PADDING) * MAX_FILTER_WIDTH]);
+    LOCAL_ALIGNED_32(int32_t, filterPos, [DST_PIXELS + PADDING]);
+    int i, j, k, f;
+
+    declare_func(void, SwsContext *c, int16_t *dst, int dstW,
+                 const uint8_t *src, const int16_t *filter,
+                 const int32_t *filterPos, int filterSize);
+
+    for (f = 0; f < FF_ARRAY_ELEMS(formats); f++) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(formats[f].src);
+        int depth = desc->comp[0].depth;
+        SwsContext *ctx = sws_getContext(SRC_PIXELS, 2, formats[f].src,
+                                         DST_PIXELS, 2, formats[f].dst,
+                                         SWS_BILINEAR, NULL, NULL, NULL);
+        if (!ctx) {
+            fail();
+            return;
+        }
+
+        for (i = 0; i < SRC_PIXELS + MAX_FILTER_WIDTH; i++) {
+            if (depth == 8)
+                ((uint8_t *)src)[i] = rnd();
+            else
+                src[i] = rnd() & ((1 << depth) - 1);
+        }
+
+        for (k = 0; k < FF_ARRAY_ELEMS(filter_sizes); k++) {
+            int width = filter_sizes[k];
+
+            /* non-negative coefficients summing to 1 << 14, as the 16-bit
+             * scalers assume, so that the output needs no clipping to 0 */
+            for (i = 0; i < DST_PIXELS; i++) {
+                int sum = 0;
+
+                filterPos[i] = rnd() % (SRC_PIXELS - width);
+                for (j = 0; j < width - 1; j++) {
+                    filter[i * width + j] = rnd() % ((1 << 14) / width + 1);
+                    sum += filter[i * width + j];
+                }
+                filter[i * width + j] = (1 << 14) - sum;
+            }
+            for (; i < DST_PIXELS + PADDING; i++) {
+                filterPos[i] = filterPos[DST_PIXELS - 1];
+                memcpy(filter + i * width, filter + (DST_PIXELS - 1) * width,
+                       width * sizeof(*filter));
+            }
+
+            ctx->hLumFilterSize = ctx->hChrFilterSize = width;
+            ff_getSwsFunc(ctx);
+
+            if (check_func(ctx->hcScale, "hscale_%d_to_%d_%d",
+                           depth, ctx->dstBpc <= 14 ? 15 : 19, width)) {
+                memset(dst0, 0, sizeof(*dst0) * (DST_PIXELS + PADDING));
+                memset(dst1, 0, sizeof(*dst1) * (DST_PIXELS + PADDING));
+
+                call_ref(ctx, (int16_t *)dst0, DST_PIXELS, (const uint8_t *)src,
+                         filter, filterPos, width);
+                call_new(ctx, (int16_t *)dst1, DST_PIXELS, (const uint8_t *)src,
+                         filter, filterPos, width);
+                if (memcmp(dst0, dst1, ctx->dstBpc <= 14 ? DST_PIXELS * 2
+                                                         : DST_PIXELS * 4))
+                    fail();
+                bench_new(ctx, (int16_t *)dst1, DST_PIXELS, (const uint8_t *)src,
+                          filter, filterPos, width);
+            }
+        }
+        sws_freeContext(ctx);
+    }
+}
+
+#define VSCALE_PIXELS 259  /* not a multiple of the SIMD widths */
+#define VSCALE_PADDING 32
+#define MAX_VFILTER_SIZE 16
+
+static const enum AVPixelFormat vscale_formats[] = {
+    AV_PIX_FMT_YUV420P,
+    AV_PIX_FMT_YUV420P9LE,
+    AV_PIX_FMT_YUV420P10LE,
+    AV_PIX_FMT_YUV420P12LE,
+    AV_PIX_FMT_YUV420P14LE,
+    AV_PIX_FMT_YUV420P16LE,
+};
+
+static const uint8_t vscale_dither[8] = { 64, 80, 16, 112, 96, 32, 0, 48 };
+
+/* intermediate samples as the horizontal scalers output them: 15 bits up to
+ * 14-bit output, 19 bits for 16-bit output */
+static void fill_vscale_line(int16_t *line, int dst_bpc)
+{
+    int i;
+
+    if (dst_bpc <= 14) {
+        for (i = 0; i < VSCALE_PIXELS + VSCALE_PADDING; i++)
+            line[i] = rnd() & 0x7FFF;
+    } else {
+        int32_t *line32 = (int32_t *)line;
+        for (i = 0; i < VSCALE_PIXELS + VSCALE_PADDING; i++)
+            line32[i] = rnd() & 0x7FFFF;
+    }
+}
+
+static SwsContext *get_vscale_context(enum AVPixelFormat dst_fmt)
+{
+    /* the inline MMX vertical scaler, used without SWS_ACCURATE_RND, takes
+     * its filter in a different layout and is not checked here */
+    SwsContext *ctx = sws_getContext(VSCALE_PIXELS, 4, AV_PIX_FMT_YUV420P,
+                                     VSCALE_PIXELS, 2, dst_fmt,
+                                     SWS_BILINEAR | SWS_ACCURATE_RND,
+                                     NULL, NULL, NULL);
+    if (ctx)
+        ff_getSwsFunc(ctx);
+    return ctx;
+}
+
+static void check_yuv2plane1(void)
+{
+    LOCAL_ALIGNED_32(int32_t, src, [VSCALE_PIXELS + VSCALE_PADDING]);
+    LOCAL_ALIGNED_32(uint16_t, dst0, [VSCALE_PIXELS + VSCALE_PADDING]);
+    LOCAL_ALIGNED_32(uint16_t, dst1, [VSCALE_PIXELS + VSCALE_PADDING]);
+    int f, offset;
+
+    declare_func(void, const int16_t *src, uint8_t *dest, int dstW,
+                 const uint8_t *dither, int offset);
+
+    for (f = 0; f < FF_ARRAY_ELEMS(vscale_formats); f++) {
+        SwsContext *ctx = get_vscale_context(vscale_formats[f]);
+        int bytes;
+
+        if (!ctx) {
+            fail();
+            return;
+        }
+        bytes = VSCALE_PIXELS * (ctx->dstBpc > 8 ? 2 : 1);
+
+        fill_vscale_line((int16_t *)src, ctx->dstBpc);
+        /* the dither offset only matters for 8-bit output */
+        for (offset = 0; offset <= (ctx->dstBpc == 8 ? 3 : 0); offset += 3) {
+            if (check_func(ctx->yuv2plane1, "yuv2plane1_%d%s",
+                           ctx->dstBpc, offset ? "_offset" : "")) {
+                memset(dst0, 0, sizeof(*dst0) * (VSCALE_PIXELS + VSCALE_PADDING));
+                memset(dst1, 0, sizeof(*dst1) * (VSCALE_PIXELS + VSCALE_PADDING));
+
+                call_ref((const int16_t *)src, (uint8_t *)dst0, VSCALE_PIXELS,
+                         vscale_dither, offset);
+                call_new((const int16_t *)src, (uint8_t *)dst1, VSCALE_PIXELS,
+                         vscale_dither, offset);
+                if (memcmp(dst0, dst1, bytes))
+                    fail();
+                bench_new((const int16_t *)src, (uint8_t *)dst1, VSCALE_PIXELS,
+                          vscale_dither, offset);
+            }
+        }
+        sws_freeContext(ctx);
+    }
+}
+
+static void check_yuv2planeX(void)
+{
+    static const int filter_sizes[] = { 1, 2, 3, 4, 8, MAX_VFILTER_SIZE };
+    LOCAL_ALIGNED_32(int32_t, src_buf, [MAX_VFILTER_SIZE], [VSCALE_PIXELS + VSCALE_PADDING]);
+    LOCAL_ALIGNED_32(uint16_t, dst0, [VSCALE_PIXELS + VSCALE_PADDING]);
+    LOCAL_ALIGNED_32(uint16_t, dst1, [VSCALE_PIXELS + VSCALE_PADDING]);
+    const int16_t *src[MAX_VFILTER_SIZE];
+    int16_t filter[MAX_VFILTER_SIZE];
+    int i, f, k, offset;
+
+    declare_func(void, const int16_t *filter, int filterSize,
+                 const int16_t **src, uint8_t *dest, int dstW,
+                 const uint8_t *dither, int offset);
+
+    for (f = 0; f < FF_ARRAY_ELEMS(vscale_formats); f++) {
+        SwsContext *ctx = get_vscale_context(vscale_formats[f]);
+        int bytes;
+
+        if (!ctx) {
+            fail();
+            return;
+        }
+        bytes = VSCALE_PIXELS * (ctx->dstBpc > 8 ? 2 : 1);
+
+        for (i = 0; i < MAX_VFILTER_SIZE; i++) {
+            fill_vscale_line((int16_t *)src_buf[i], ctx->dstBpc);
+            src[i] = (const int16_t *)src_buf[i];
+        }
+
+        for (k = 0; k < FF_ARRAY_ELEMS(filter_sizes); k++) {
+            int size = filter_sizes[k];
+            int sum  = 0;
+
+            /* non-negative 12-bit coefficients summing to 1 << 12, as the
+             * vertical filters built by swscale, which keeps the sums of
+             * the 19-bit samples within 32 bits */
+            for (i = 0; i < size - 1; i++) {
+                filter[i] = rnd() % ((1 << 12) / size + 1);
+                sum += filter[i];
+            }
+            filter[i] = (1 << 12) - sum;
+
+            for (offset = 0; offset <= (ctx->dstBpc == 8 ? 3 : 0); offset += 3) {
+                if (check_func(ctx->yuv2planeX, "yuv2planeX_%d_%d%s",
+                               ctx->dstBpc, size, offset ? "_offset" : "")) {
+                    memset(dst0, 0, sizeof(*dst0) * (VSCALE_PIXELS + VSCALE_PADDING));
+                    memset(dst1, 0, sizeof(*dst1) * (VSCALE_PIXELS + VSCALE_PADDING));
+
+                    call_ref(filter, size, src, (uint8_t *)dst0, VSCALE_PIXELS,
+                             vscale_dither, offset);
+                    call_new(filter, size, src, (uint8_t *)dst1, VSCALE_PIXELS,
+                             vscale_dither, offset);
+                    if (memcmp(dst0, dst1, bytes))
+                        fail();
+                    bench_new(filter, size, src, (uint8_t *)dst1, VSCALE_PIXELS,
+                              vscale_dither, offset);
+                }
+            }
+        }
+        sws_freeContext(ctx);
+    }
+}
+
+/* even, as the C converters leave the last pixel of odd lines unset, and
+ * not a multiple of the SIMD widths */
+#define RGB_PIXELS 122
+#define RGB_STRIDE (FFALIGN(RGB_PIXELS, 32) + 32)
+
+static void check_yuv2rgb(void)
+{
+    static const enum AVPixelFormat formats[] = {
+        AV_PIX_FMT_RGB24, AV_PIX_FMT_BGR24, AV_PIX_FMT_RGB32, AV_PIX_FMT_BGR32,
+    };
+    LOCAL_ALIGNED_32(uint8_t, src_y, [RGB_STRIDE * 2]);
+    LOCAL_ALIGNED_32(uint8_t, src_u, [RGB_STRIDE]);
+    LOCAL_ALIGNED_32(uint8_t, src_v, [RGB_STRIDE]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [RGB_STRIDE * 4 * 2]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [RGB_STRIDE * 4 * 2]);
+    const uint8_t *src[4] = { src_y, src_u, src_v, NULL };
+    int src_stride[4]     = { RGB_STRIDE, RGB_STRIDE, RGB_STRIDE, 0 };
+    int dst_stride[4]     = { RGB_STRIDE * 4, 0, 0, 0 };
+    int i, f;
+
+    declare_func(int, SwsContext *c, const uint8_t *src[], int srcStride[],
+                 int srcSliceY, int srcSliceH, uint8_t *dst[], int dstStride[]);
+
+    for (i = 0; i < RGB_STRIDE * 2; i++)
+        src_y[i] = rnd();
+    for (i = 0; i < RGB_STRIDE; i++) {
+        src_u[i] = rnd();
+        src_v[i] = rnd();
+    }
+
+    for (f = 0; f < FF_ARRAY_ELEMS(formats); f++) {
+        int depth = av_get_bits_per_pixel(av_pix_fmt_desc_get(formats[f])) >> 3;
+        int log_level = av_log_get_level();
+        SwsContext *ctx;
+
+        /* the C fallback warns about the missing accelerated converter
+         * whenever the SIMD versions are disabled, which is expected here */
+        av_log_set_level(AV_LOG_ERROR);
+        ctx = sws_getContext(RGB_PIXELS, 2, AV_PIX_FMT_YUV420P,
+                             RGB_PIXELS, 2, formats[f],
+                             SWS_BILINEAR, NULL, NULL, NULL);
+        av_log_set_level(log_level);
+        if (!ctx) {
+            fail();
+            return;
+        }
+
+        if (check_func(ctx->swscale, "yuv420p_%s",
+                       av_get_pix_fmt_name(formats[f]))) {
+            uint8_t *dst[4] = { dst0, NULL, NULL, NULL };
+            int y;
+
+            memset(dst0, 0, RGB_STRIDE * 4 * 2);
+            memset(dst1, 0, RGB_STRIDE * 4 * 2);
+
+            call_ref(ctx, src, src_stride, 0, 2, dst, dst_stride);
+            dst[0] = dst1;
+            call_new(ctx, src, src_stride, 0, 2, dst, dst_stride);
+            /* the SIMD converters round differently from the C tables */
+            for (y = 0; y < 2; y++)
+                for (i = 0; i < RGB_PIXELS * depth; i++)
+                    if (abs(dst0[y * dst_stride[0] + i] -
+                            dst1[y * dst_stride[0] + i]) > 3) {
+                        fail();
+                        y = 2;
+                        break;
+                    }
+            bench_new(ctx, src, src_stride, 0, 2, dst, dst_stride);
+        }
+        sws_freeContext(ctx);
+    }
+}
+
+static void check_rgb2yuv(void)
+{
+    static const enum AVPixelFormat formats[] = {
+        AV_PIX_FMT_RGB24, AV_PIX_FMT_BGR24, AV_PIX_FMT_RGBA,
+        AV_PIX_FMT_BGRA,  AV_PIX_FMT_ARGB,  AV_PIX_FMT_ABGR,
+    };
+    LOCAL_ALIGNED_32(uint8_t, src, [RGB_STRIDE * 4]);
+    LOCAL_ALIGNED_32(uint16_t, dst0_y, [RGB_STRIDE]);
+    LOCAL_ALIGNED_32(uint16_t, dst1_y, [RGB_STRIDE]);
+    LOCAL_ALIGNED_32(uint16_t, dst0_u, [RGB_STRIDE]);
+    LOCAL_ALIGNED_32(uint16_t, dst1_u, [RGB_STRIDE]);
+    LOCAL_ALIGNED_32(uint16_t, dst0_v, [RGB_STRIDE]);
+    LOCAL_ALIGNED_32(uint16_t, dst1_v, [RGB_STRIDE]);
+    int i, f;
+
+    for (i = 0; i < RGB_STRIDE * 4; i++)
+        src[i] = rnd();
+
+    for (f = 0; f < FF_ARRAY_ELEMS(formats); f++) {
+        const char *name = av_get_pix_fmt_name(formats[f]);
+        /* full chroma input, so that the chroma is read for each pixel */
+        SwsContext *ctx = sws_getContext(RGB_PIXELS, 2, formats[f],
+                                         RGB_PIXELS, 2, AV_PIX_FMT_YUV444P,
+                                         SWS_BILINEAR | SWS_FULL_CHR_H_INP,
+                                         NULL, NULL, NULL);
+        if (!ctx) {
+            fail();
+            return;
+        }
+        ff_getSwsFunc(ctx);
+
+        if (check_func(ctx->lumToYV12, "%s_to_y", name)) {
+            declare_func(void, uint8_t *dst, const uint8_t *src,
+                         const uint8_t *src2, const uint8_t *src3,
+                         int width, uint32_t *table);
+
+            memset(dst0_y, 0, RGB_STRIDE * 2);
+            memset(dst1_y, 0, RGB_STRIDE * 2);
+            call_ref((uint8_t *)dst0_y, src, NULL, NULL, RGB_PIXELS,
+                     ctx->input_rgb2yuv_table);
+            call_new((uint8_t *)dst1_y, src, NULL, NULL, RGB_PIXELS,
+                     ctx->input_rgb2yuv_table);
+            if (memcmp(dst0_y, dst1_y, RGB_PIXELS * 2))
+                fail();
+            bench_new((uint8_t *)dst1_y, src, NULL, NULL, RGB_PIXELS,
+                      ctx->input_rgb2yuv_table);
+        }
+
+        if (check_func(ctx->chrToYV12, "%s_to_uv", name)) {
+            declare_func(void, uint8_t *dstU, uint8_t *dstV,
+                         const uint8_t *src1, const uint8_t *src2,
+                         const uint8_t *src3, int width, uint32_t *table);
+
+            memset(dst0_u, 0, RGB_STRIDE * 2);
+            memset(dst1_u, 0, RGB_STRIDE * 2);
+            memset(dst0_v, 0, RGB_STRIDE * 2);
+            memset(dst1_v, 0, RGB_STRIDE * 2);
+            call_ref((uint8_t *)dst0_u, (uint8_t *)dst0_v, NULL, src, src,
+                     RGB_PIXELS, ctx->input_rgb2yuv_table);
+            call_new((uint8_t *)dst1_u, (uint8_t *)dst1_v, NULL, src, src,
+                     RGB_PIXELS, ctx->input_rgb2yuv_table);
+            if (memcmp(dst0_u, dst1_u, RGB_PIXELS * 2) ||
+                memcmp(dst0_v, dst1_v, RGB_PIXELS * 2))
+                fail();
+            bench_new((uint8_t *)dst1_u, (uint8_t *)dst1_v, NULL, src, src,
+                      RGB_PIXELS, ctx->input_rgb2yuv_table);
+        }
+        sws_freeContext(ctx);
+    }
+}
+
+#define WORDS_PIXELS 61      /* not a multiple of the SIMD widths */
+#define WORDS_STRIDE 256
+#define WORDS_LINES 9
+
+static void check_words(void)
+{
+    static const struct {
+        int depth, scale, shift, max_dither;
+    } dither_params[] = {
+        { 10,   511, 11,   3 },
+        { 16, 32641, 23, 126 },
+    };
+    LOCAL_ALIGNED_32(uint16_t, src, [WORDS_STRIDE * WORDS_LINES]);
+    LOCAL_ALIGNED_32(uint16_t, dst0, [WORDS_STRIDE * WORDS_LINES]);
+    LOCAL_ALIGNED_32(uint16_t, dst1, [WORDS_STRIDE * WORDS_LINES]);
+    LOCAL_ALIGNED_32(uint16_t, dst2, [WORDS_STRIDE * WORDS_LINES]);
+    LOCAL_ALIGNED_32(uint16_t, dst3, [WORDS_STRIDE * WORDS_LINES]);
+    uint8_t dither[8][8];
+    const int size   = WORDS_STRIDE * WORDS_LINES * 2;
+    const int stride = WORDS_STRIDE * 2;
+    int i, p;
+
+    ff_sws_rgb2rgb_init();
+
+    for (i = 0; i < WORDS_STRIDE * WORDS_LINES; i++)
+        src[i] = rnd();
+
+    if (check_func(shiftWords, "shift_words")) {
+        declare_func(void, const uint8_t *src, uint8_t *dst,
+                     int width, int height, int srcStride,
+                     int dstStride, int shift);
+
+        memset(dst0, 0, size);
+        memset(dst1, 0, size);
+        call_ref((uint8_t *)src, (uint8_t *)dst0, WORDS_PIXELS, WORDS_LINES,
+                 stride, stride, 6);
+        call_new((uint8_t *)src, (uint8_t *)dst1, WORDS_PIXELS, WORDS_LINES,
+                 stride, stride, 6);
+        if (memcmp(dst0, dst1, size))
+            fail();
+        bench_new((uint8_t *)src, (uint8_t *)dst1, WORDS_PIXELS, WORDS_LINES,
+                  stride, stride, 6);
+    }
+
+    if (check_func(deinterleaveWords, "deinterleave_words")) {
+        declare_func(void, const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
+                     int width, int height, int srcStride,
+                     int dst1Stride, int dst2Stride, int shift);
+
+        memset(dst0, 0, size);
+        memset(dst1, 0, size);
+        memset(dst2, 0, size);
+        memset(dst3, 0, size);
+        call_ref((uint8_t *)src, (uint8_t *)dst0, (uint8_t *)dst1,
+                 WORDS_PIXELS, WORDS_LINES, stride, stride, stride, 6);
+        call_new((uint8_t *)src, (uint8_t *)dst2, (uint8_t *)dst3,
+                 WORDS_PIXELS, WORDS_LINES, stride, stride, stride, 6);
+        if (memcmp(dst0, dst2, size) || memcmp(dst1, dst3, size))
+            fail();
+        bench_new((uint8_t *)src, (uint8_t *)dst2, (uint8_t *)dst3,
+                  WORDS_PIXELS, WORDS_LINES, stride, stride, stride, 6);
+    }
+
+    for (p = 0; p < FF_ARRAY_ELEMS(dither_params); p++) {
+        const int depth = dither_params[p].depth;
+        const int scale = dither_params[p].scale;
+        const int shift = dither_params[p].shift;
+
+        if (!check_func(ditherWordsToBytes, "dither_words_to_bytes_%d", depth))
+            continue;
+        {
+            declare_func(void, const uint8_t *src, uint8_t *dst,
+                         int width, int height, int srcStride,
+                         int dstStride, const uint8_t (*dither)[8],
+                         int scale, int shift);
+
+            for (i = 0; i < WORDS_STRIDE * WORDS_LINES; i++)
+                dst2[i] = src[i] >> (16 - depth);
+            for (i = 0; i < 64; i++)
+                dither[i >> 3][i & 7] = rnd() % (dither_params[p].max_dither + 1);
+
+            memset(dst0, 0, size);
+            memset(dst1, 0, size);
+            call_ref((uint8_t *)dst2, (uint8_t *)dst0, WORDS_PIXELS, WORDS_LINES,
+                     stride, WORDS_STRIDE, dither, scale, shift);
+            call_new((uint8_t *)dst2, (uint8_t *)dst1, WORDS_PIXELS, WORDS_LINES,
+                     stride, WORDS_STRIDE, dither, scale, shift);
+            if (memcmp(dst0, dst1, size))
+                fail();
+            bench_new((uint8_t *)dst2, (uint8_t *)dst1, WORDS_PIXELS, WORDS_LINES,
+                      stride, WORDS_STRIDE, dither, scale, shift);
+        }
+    }
+}
+
+void checkasm_check_sw_scale(void)
+{
+    check_hscale();
+    report("hscale");
+    check_yuv2plane1();
+    report("yuv2plane1");
+    check_yuv2planeX();
+    report("yuv2planeX");
+    check_yuv2rgb();
+    report("yuv2rgb");
+    check_rgb2yuv();
+    report("rgb2yuv");
+    check_words();
+    report("words");
+}
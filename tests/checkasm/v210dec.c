@@ -0,0 +1,79 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavcodec/v210dec.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/intreadwrite.h"
+
+#define MAX_WIDTH 384
+/* room for the samples written past the end of the line by the SIMD
+ * versions */
+#define PAD       16
+
+static void check_unpack(int aligned)
+{
+    V210DecContext h = { 0 };
+    LOCAL_ALIGNED_32(uint32_t, src, [MAX_WIDTH * 2 / 3 + 8]);
+    LOCAL_ALIGNED_32(uint16_t, y0, [MAX_WIDTH + PAD]);
+    LOCAL_ALIGNED_32(uint16_t, y1, [MAX_WIDTH + PAD]);
+    LOCAL_ALIGNED_32(uint16_t, u0, [MAX_WIDTH / 2 + PAD]);
+    LOCAL_ALIGNED_32(uint16_t, u1, [MAX_WIDTH / 2 + PAD]);
+    LOCAL_ALIGNED_32(uint16_t, v0, [MAX_WIDTH / 2 + PAD]);
+    LOCAL_ALIGNED_32(uint16_t, v1, [MAX_WIDTH / 2 + PAD]);
+
+    declare_func(void, const uint32_t *src, uint16_t *y, uint16_t *u,
+                 uint16_t *v, int width);
+
+    h.aligned_input = aligned;
+    ff_v210dec_init(&h);
+
+    if (check_func(h.unpack_frame, "v210_unpack_%s",
+                   aligned ? "aligned" : "unaligned")) {
+        const uint32_t *in = src + (aligned ? 0 : 1);
+        int i, width, step = 6 * h.sample_factor;
+
+        for (width = step; width <= MAX_WIDTH; width += step) {
+            for (i = 0; i < MAX_WIDTH * 2 / 3 + 8; i++)
+                src[i] = rnd() & 0x3fffffff;
+            memset(y0, 0, (MAX_WIDTH + PAD) * sizeof(*y0));
+            memset(y1, 0, (MAX_WIDTH + PAD) * sizeof(*y1));
+            memset(u0, 0, (MAX_WIDTH / 2 + PAD) * sizeof(*u0));
+            memset(u1, 0, (MAX_WIDTH / 2 + PAD) * sizeof(*u1));
+            memset(v0, 0, (MAX_WIDTH / 2 + PAD) * sizeof(*v0));
+            memset(v1, 0, (MAX_WIDTH / 2 + PAD) * sizeof(*v1));
+
+            call_ref(in, y0, u0, v0, width);
+            call_new(in, y1, u1, v1, width);
+            if (memcmp(y0, y1, width * sizeof(*y0)) ||
+                memcmp(u0, u1, width / 2 * sizeof(*u0)) ||
+                memcmp(v0, v1, width / 2 * sizeof(*v0)))
+                fail();
+        }
+        bench_new(in, y1, u1, v1, MAX_WIDTH / step * step);
+    }
+}
+
+void checkasm_check_v210dec(void)
+{
+    check_unpack(1);
+    check_unpack(0);
+    report("v210_unpack");
+}
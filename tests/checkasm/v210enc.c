@@ -50,7 +50,7 @@
         }                                              \
     } while (0)
 
-#define check_pack_line(type, mask)                                                \
+#define check_pack_line(type, mask, factor)                                        \
     do {                                                                           \
         LOCAL_ALIGNED_16(type, y0, [BUF_SIZE]);                                    \
         LOCAL_ALIGNED_16(type, y1, [BUF_SIZE]);                                    \
@@ -63,7 +63,7 @@
                                                                                    \
         declare_func(void, const type * y, const type * u, const type * v,         \
                      uint8_t * dst, ptrdiff_t width);                              \
-        ptrdiff_t width, step = 12 / sizeof(type);                                 \
+        ptrdiff_t width, step = 12 / sizeof(type) * factor;                        \
                                                                                    \
         for (width = step; width < BUF_SIZE - 15; width += step) {                 \
             int y_offset  = rnd() & 15;                                            \
@@ -85,10 +85,10 @@ void checkasm_check_v210enc(void)
     ff_v210enc_init(&h);
 
     if (check_func(h.pack_line_8, "v210_planar_pack_8"))
-        check_pack_line(uint8_t, 0xffffffff);
+        check_pack_line(uint8_t, 0xffffffff, h.sample_factor_8);
 
     if (check_func(h.pack_line_10, "v210_planar_pack_10"))
-        check_pack_line(uint16_t, 0x03ff03ff);
+        check_pack_line(uint16_t, 0x03ff03ff, h.sample_factor_10);
 
     report("planar_pack");
 }
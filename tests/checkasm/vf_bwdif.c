@@ -0,0 +1,102 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+
+#include "libavfilter/bwdif.h"
+
+#include "checkasm.h"
+
+#define WIDTH 250           /* not a multiple of the SIMD widths */
+/* filter_line may write up to a full vector past the end */
+#define LINE_PIXELS (WIDTH + 32)
+/* filter_line reads four lines above and below the one it outputs */
+#define LINES 9
+
+static void randomize_lines(uint16_t *buf, int depth)
+{
+    int i;
+
+    for (i = 0; i < LINE_PIXELS * LINES; i++) {
+        if (depth == 8)
+            ((uint8_t *)buf)[i] = rnd();
+        else
+            buf[i] = rnd() & ((1 << depth) - 1);
+    }
+}
+
+static void check_filter_line(enum AVPixelFormat pix_fmt)
+{
+    LOCAL_ALIGNED_32(uint16_t, prev_buf, [LINE_PIXELS * LINES]);
+    LOCAL_ALIGNED_32(uint16_t, cur_buf,  [LINE_PIXELS * LINES]);
+    LOCAL_ALIGNED_32(uint16_t, next_buf, [LINE_PIXELS * LINES]);
+    LOCAL_ALIGNED_32(uint16_t, dst0, [LINE_PIXELS]);
+    LOCAL_ALIGNED_32(uint16_t, dst1, [LINE_PIXELS]);
+    BWDIFContext s = { 0 };
+    int depth, df, refs, clip_max, parity;
+
+    declare_func(void, void *dst, void *prev, void *cur, void *next,
+                 int w, int prefs, int mrefs, int prefs2, int mrefs2,
+                 int prefs3, int mrefs3, int prefs4, int mrefs4,
+                 int parity, int clip_max);
+
+    s.csp = av_pix_fmt_desc_get(pix_fmt);
+    ff_bwdif_init(&s);
+    depth    = s.csp->comp[0].depth;
+    df       = (depth + 7) / 8;
+    /* the refs are in pixels, as passed by the filter */
+    refs     = LINE_PIXELS;
+    clip_max = (1 << depth) - 1;
+
+    randomize_lines(prev_buf, depth);
+    randomize_lines(cur_buf,  depth);
+    randomize_lines(next_buf, depth);
+
+    if (check_func(s.filter_line, "bwdif_%d", depth)) {
+        uint8_t *prev = (uint8_t *)prev_buf + 4 * refs * df;
+        uint8_t *cur  = (uint8_t *)cur_buf  + 4 * refs * df;
+        uint8_t *next = (uint8_t *)next_buf + 4 * refs * df;
+
+        for (parity = 0; parity <= 1; parity++) {
+            memset(dst0, 0, sizeof(*dst0) * LINE_PIXELS);
+            memset(dst1, 0, sizeof(*dst1) * LINE_PIXELS);
+
+            call_ref(dst0, prev, cur, next, WIDTH, refs, -refs, 2 * refs, -2 * refs,
+                     3 * refs, -3 * refs, 4 * refs, -4 * refs, parity, clip_max);
+            call_new(dst1, prev, cur, next, WIDTH, refs, -refs, 2 * refs, -2 * refs,
+                     3 * refs, -3 * refs, 4 * refs, -4 * refs, parity, clip_max);
+            if (memcmp(dst0, dst1, WIDTH * df))
+                fail();
+        }
+        bench_new(dst1, prev, cur, next, WIDTH, refs, -refs, 2 * refs, -2 * refs,
+                  3 * refs, -3 * refs, 4 * refs, -4 * refs, 0, clip_max);
+    }
+}
+
+void checkasm_check_bwdif(void)
+{
+    check_filter_line(AV_PIX_FMT_YUV420P);
+    report("bwdif_8");
+    check_filter_line(AV_PIX_FMT_YUV420P12LE);
+    report("bwdif_12");
+}
@@ -0,0 +1,163 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+
+#include "libavfilter/w3fdif.h"
+
+#include "checkasm.h"
+
+#define WIDTH 250           /* not a multiple of the SIMD widths */
+/* the filters may process up to a full vector past the end, as the work
+ * line is allocated with FFALIGN(linesize, 32) in the filter */
+#define LINE_PIXELS (WIDTH + 32)
+#define MAX_TAPS 5
+
+/* the coefficients of the filter, see vf_w3fdif.c */
+static const int16_t coef_lf[2][4] = {{ 16384, 16384,     0,    0},
+                                      {  -852, 17236, 17236, -852}};
+static const int16_t coef_hf[2][5] = {{ -2048,  4096, -2048,     0,    0},
+                                      {  1016, -3801,  5570, -3801, 1016}};
+
+static void randomize_work_line(int32_t *buf)
+{
+    int i;
+
+    /* larger than the low-frequency filters can produce, to also check
+     * the clipping of filter_scale */
+    for (i = 0; i < LINE_PIXELS; i++)
+        buf[i] = (int32_t)rnd() >> 6;
+}
+
+static void check_filter_low(W3FDIFDSPContext *dsp, uint8_t *in[2][MAX_TAPS])
+{
+    LOCAL_ALIGNED_32(int32_t, work0, [LINE_PIXELS]);
+    LOCAL_ALIGNED_32(int32_t, work1, [LINE_PIXELS]);
+    int filter;
+
+    declare_func(void, int32_t *work_line, uint8_t *in_lines_cur[],
+                 const int16_t *coef, int linesize);
+
+    for (filter = 0; filter <= 1; filter++) {
+        void (*func)(int32_t *, uint8_t **, const int16_t *, int) =
+            filter ? dsp->filter_complex_low : dsp->filter_simple_low;
+
+        if (check_func(func, "w3fdif_%s_low", filter ? "complex" : "simple")) {
+            uint8_t *cur0[MAX_TAPS], *cur1[MAX_TAPS];
+
+            /* the functions advance the line pointers they are given */
+            memcpy(cur0, in[0], sizeof(cur0));
+            memcpy(cur1, in[0], sizeof(cur1));
+            memset(work0, 0, sizeof(*work0) * LINE_PIXELS);
+            memset(work1, 0, sizeof(*work1) * LINE_PIXELS);
+
+            call_ref(work0, cur0, coef_lf[filter], WIDTH);
+            call_new(work1, cur1, coef_lf[filter], WIDTH);
+            if (memcmp(work0, work1, sizeof(*work0) * WIDTH))
+                fail();
+
+            memcpy(cur1, in[0], sizeof(cur1));
+            bench_new(work1, cur1, coef_lf[filter], WIDTH);
+        }
+    }
+}
+
+static void check_filter_high(W3FDIFDSPContext *dsp, uint8_t *in[2][MAX_TAPS])
+{
+    LOCAL_ALIGNED_32(int32_t, work0, [LINE_PIXELS]);
+    LOCAL_ALIGNED_32(int32_t, work1, [LINE_PIXELS]);
+    int filter;
+
+    declare_func(void, int32_t *work_line, uint8_t *in_lines_cur[],
+                 uint8_t *in_lines_adj[], const int16_t *coef, int linesize);
+
+    for (filter = 0; filter <= 1; filter++) {
+        void (*func)(int32_t *, uint8_t **, uint8_t **, const int16_t *, int) =
+            filter ? dsp->filter_complex_high : dsp->filter_simple_high;
+
+        if (check_func(func, "w3fdif_%s_high", filter ? "complex" : "simple")) {
+            uint8_t *cur0[MAX_TAPS], *cur1[MAX_TAPS];
+            uint8_t *adj0[MAX_TAPS], *adj1[MAX_TAPS];
+
+            memcpy(cur0, in[0], sizeof(cur0));
+            memcpy(cur1, in[0], sizeof(cur1));
+            memcpy(adj0, in[1], sizeof(adj0));
+            memcpy(adj1, in[1], sizeof(adj1));
+            /* the high-frequency filters accumulate into the work line */
+            randomize_work_line(work0);
+            memcpy(work1, work0, sizeof(*work0) * LINE_PIXELS);
+
+            call_ref(work0, cur0, adj0, coef_hf[filter], WIDTH);
+            call_new(work1, cur1, adj1, coef_hf[filter], WIDTH);
+            if (memcmp(work0, work1, sizeof(*work0) * WIDTH))
+                fail();
+
+            memcpy(cur1, in[0], sizeof(cur1));
+            memcpy(adj1, in[1], sizeof(adj1));
+            bench_new(work1, cur1, adj1, coef_hf[filter], WIDTH);
+        }
+    }
+}
+
+static void check_filter_scale(W3FDIFDSPContext *dsp)
+{
+    LOCAL_ALIGNED_32(int32_t, work, [LINE_PIXELS]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [LINE_PIXELS]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [LINE_PIXELS]);
+
+    declare_func(void, uint8_t *out_pixel, const int32_t *work_pixel, int linesize);
+
+    if (check_func(dsp->filter_scale, "w3fdif_scale")) {
+        randomize_work_line(work);
+        memset(dst0, 0, LINE_PIXELS);
+        memset(dst1, 0, LINE_PIXELS);
+
+        call_ref(dst0, work, WIDTH);
+        call_new(dst1, work, WIDTH);
+        if (memcmp(dst0, dst1, WIDTH))
+            fail();
+
+        bench_new(dst1, work, WIDTH);
+    }
+}
+
+void checkasm_check_w3fdif(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, lines, [2 * MAX_TAPS * LINE_PIXELS]);
+    uint8_t *in[2][MAX_TAPS];
+    W3FDIFDSPContext dsp;
+    int i;
+
+    for (i = 0; i < 2 * MAX_TAPS * LINE_PIXELS; i++)
+        lines[i] = rnd();
+    for (i = 0; i < 2 * MAX_TAPS; i++)
+        in[i / MAX_TAPS][i % MAX_TAPS] = lines + i * LINE_PIXELS;
+
+    ff_w3fdif_init(&dsp);
+
+    check_filter_low(&dsp, in);
+    report("filter_low");
+    check_filter_high(&dsp, in);
+    report("filter_high");
+    check_filter_scale(&dsp);
+    report("filter_scale");
+}
@@ -0,0 +1,102 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+
+#include "libavfilter/yadif.h"
+
+#include "checkasm.h"
+
+#define WIDTH 250           /* not a multiple of the SIMD widths */
+/* filter_line reads 3 pixels on each side and writes up to a full vector
+ * past the end; the filter fixes both ends with filter_edges */
+#define OFFSET 3
+#define LINE_PIXELS (WIDTH + 32)
+/* filter_line reads two lines above and below the one it outputs */
+#define LINES 5
+
+static void randomize_lines(uint16_t *buf, int depth)
+{
+    int i;
+
+    for (i = 0; i < LINE_PIXELS * LINES; i++) {
+        if (depth == 8)
+            ((uint8_t *)buf)[i] = rnd();
+        else
+            buf[i] = rnd() & ((1 << depth) - 1);
+    }
+}
+
+static void check_filter_line(enum AVPixelFormat pix_fmt)
+{
+    LOCAL_ALIGNED_32(uint16_t, prev_buf, [LINE_PIXELS * LINES]);
+    LOCAL_ALIGNED_32(uint16_t, cur_buf,  [LINE_PIXELS * LINES]);
+    LOCAL_ALIGNED_32(uint16_t, next_buf, [LINE_PIXELS * LINES]);
+    LOCAL_ALIGNED_32(uint16_t, dst0, [LINE_PIXELS]);
+    LOCAL_ALIGNED_32(uint16_t, dst1, [LINE_PIXELS]);
+    YADIFContext s = { 0 };
+    int depth, df, refs, mode, parity;
+
+    declare_func(void, void *dst, void *prev, void *cur, void *next,
+                 int w, int prefs, int mrefs, int parity, int mode);
+
+    s.csp = av_pix_fmt_desc_get(pix_fmt);
+    ff_yadif_init(&s);
+    depth = s.csp->comp[0].depth;
+    df    = (depth + 7) / 8;
+    refs  = LINE_PIXELS * df;
+
+    randomize_lines(prev_buf, depth);
+    randomize_lines(cur_buf,  depth);
+    randomize_lines(next_buf, depth);
+
+    for (mode = 0; mode <= YADIF_MODE_SEND_FRAME_NOSPATIAL; mode += 2) {
+        if (check_func(s.filter_line, "yadif_%d%s", depth,
+                       mode ? "_nospatial" : "")) {
+            uint8_t *prev = (uint8_t *)prev_buf + 2 * refs + OFFSET * df;
+            uint8_t *cur  = (uint8_t *)cur_buf  + 2 * refs + OFFSET * df;
+            uint8_t *next = (uint8_t *)next_buf + 2 * refs + OFFSET * df;
+
+            for (parity = 0; parity <= 1; parity++) {
+                memset(dst0, 0, sizeof(*dst0) * LINE_PIXELS);
+                memset(dst1, 0, sizeof(*dst1) * LINE_PIXELS);
+
+                call_ref(dst0, prev, cur, next, WIDTH, refs, -refs, parity, mode);
+                call_new(dst1, prev, cur, next, WIDTH, refs, -refs, parity, mode);
+                if (memcmp(dst0, dst1, WIDTH * df))
+                    fail();
+            }
+            bench_new(dst1, prev, cur, next, WIDTH, refs, -refs, 0, mode);
+        }
+    }
+}
+
+void checkasm_check_yadif(void)
+{
+    check_filter_line(AV_PIX_FMT_YUV420P);
+    report("yadif_8");
+    check_filter_line(AV_PIX_FMT_YUV420P10LE);
+    report("yadif_10");
+    check_filter_line(AV_PIX_FMT_YUV420P16LE);
+    report("yadif_16");
+}
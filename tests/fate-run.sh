@@ -309,6 +309,67 @@ concat(){
     fi
 }
 
+# Run ffmpeg BENCH_RUNS times with -benchmark and print the figures of the
+# fastest run: frames per second (video only), CPU and real time in seconds,
+# and peak RSS in kB.
+bench(){
+    benchlog="${outdir}/${test}.bench"
+    progress="${outdir}/${test}.progress"
+    cleanfiles="$cleanfiles $benchlog $progress"
+    runs=${BENCH_RUNS:-3}
+    best=
+    while [ $runs -gt 0 ]; do
+        ffmpeg -benchmark -progress $(target_path $progress) "$@" 2>$benchlog >/dev/null || {
+            cat $benchlog
+            return 1
+        }
+        result=$(awk -F '[= ]' '
+            /^frame=[0-9]/ { frames = $2 }
+            /bench: utime=/ {
+                for (i = 1; i < NF; i++) {
+                    if ($i == "utime") utime = $(i + 1) + 0
+                    if ($i == "stime") stime = $(i + 1) + 0
+                    if ($i == "rtime") rtime = $(i + 1) + 0
+                }
+            }
+            /bench: maxrss=/ { maxrss = $3 + 0 }
+            END {
+                if (frames && rtime > 0)
+                    printf "fps=%.2f ", frames / rtime
+                printf "cputime=%.3f rtime=%.3f maxrss=%d\n", utime + stime, rtime, maxrss
+            }' $progress $benchlog)
+        if [ -z "$best" ] || [ $(compare_rtime "$result" "$best") = 1 ]; then
+            best=$result
+        fi
+        runs=$((runs - 1))
+    done
+    printf '%s\n' $best
+}
+
+# prints 1 if the first run of bench() was faster than the second one
+compare_rtime(){
+    printf '%s\n%s\n' "$1" "$2" | awk '
+        { for (i = 1; i <= NF; i++) if ($i ~ /^rtime=/) t[NR] = substr($i, 7) + 0 }
+        END { print (t[1] < t[2]) }'
+}
+
+# Compare the figures of bench() with the baseline, failing if one of them
+# is worse than it by more than BENCH_TOLERANCE percent.
+benchcmp(){
+    awk -F = -v tolerance=${BENCH_TOLERANCE:-10} '
+        FILENAME == ARGV[1] { ref[$1] = $2; next }
+        ($1 in ref) {
+            compared++
+            old = ref[$1] + 0; new = $2 + 0
+            change = old > 0 ? (new - old) * 100 / old : 0
+            worse = $1 == "fps" ? -change : change
+            status = worse > tolerance ? "REGRESSION" : "ok"
+            if (worse > tolerance) failed = 1
+            printf "%-8s %12s %12s %+8.1f%%  %s\n", $1, ref[$1], $2, change, status
+        }
+        END { exit failed || !compared }' "$1" "$2"
+}
+
 mkdir -p "$outdir"
 
 # Disable globbing: command arguments may contain globbing characters and
@@ -332,10 +393,12 @@ if test -e "$ref" || test $cmp = "oneline" ; then
         stddev) stddev     "$ref" "$outfile"            >$cmpfile ;;
         oneline)oneline    "$ref" "$outfile"            >$cmpfile ;;
         null)   cat               "$outfile"            >$cmpfile ;;
+        bench)  benchcmp   "$ref" "$outfile"            >$cmpfile &&
+                test $gen = "no" ;;
     esac
     cmperr=$?
     test $err = 0 && err=$cmperr
-    test $err = 0 || cat $cmpfile
+    test $err = 0 && test $cmp != "bench" || cat $cmpfile
 else
     echo "reference file '$ref' not found"
     err=1
@@ -351,6 +414,7 @@ echo "${test}:${sig:-$err}:$cmpo:$erro" >$repfile
 
 if test $err != 0 && test $gen != "no" ; then
     echo "GEN     $ref"
+    mkdir -p "$(dirname "$ref")"
     cp -f "$outfile" "$ref"
     err=$?
 fi
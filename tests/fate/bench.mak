@@ -0,0 +1,71 @@
+# Performance benchmarks. They are not part of "make fate": "make fate-bench"
+# runs them and compares the frames per second, CPU time, real time and peak
+# RSS with the baseline in BENCH_REF, failing on a regression larger than
+# BENCH_TOLERANCE percent. "make fate-bench GEN=1" records the baseline,
+# which is only meaningful for the machine and configuration it was made on.
+
+BENCH_REF       ?= tests/bench-ref
+BENCH_RUNS      ?= 3
+BENCH_TOLERANCE ?= 10
+
+BENCH_VSRC = -f lavfi -i testsrc=s=1280x720:r=25:d=8
+BENCH_ASRC = -f lavfi -i sine=f=440:sample_rate=48000:d=600
+
+# encoding
+FATE_BENCH-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER MPEG4_ENCODER NULL_MUXER) += fate-bench-enc-mpeg4
+fate-bench-enc-mpeg4: CMD = bench $(BENCH_VSRC) -c:v mpeg4 -q:v 4 -f null -
+
+FATE_BENCH-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER MPEG2VIDEO_ENCODER NULL_MUXER) += fate-bench-enc-mpeg2video
+fate-bench-enc-mpeg2video: CMD = bench $(BENCH_VSRC) -c:v mpeg2video -b:v 6M -bf 2 -f null -
+
+FATE_BENCH-$(call ALLYES, LAVFI_INDEV SINE_FILTER AAC_ENCODER NULL_MUXER) += fate-bench-enc-aac
+fate-bench-enc-aac: CMD = bench $(BENCH_ASRC) -ac 2 -c:a aac -b:a 128k -f null -
+
+FATE_BENCH-$(call ALLYES, LAVFI_INDEV SINE_FILTER FLAC_ENCODER NULL_MUXER) += fate-bench-enc-flac
+fate-bench-enc-flac: CMD = bench $(BENCH_ASRC) -ac 2 -c:a flac -f null -
+
+# filtering
+FATE_BENCH-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER SCALE_FILTER RAWVIDEO_ENCODER NULL_MUXER) += fate-bench-filter-scale
+fate-bench-filter-scale: CMD = bench $(BENCH_VSRC) -vf scale=1920:1080:flags=bicubic -c:v rawvideo -f null -
+
+FATE_BENCH-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER FORMAT_FILTER RAWVIDEO_ENCODER NULL_MUXER) += fate-bench-filter-yuv2rgb
+fate-bench-filter-yuv2rgb: CMD = bench $(BENCH_VSRC) -vf format=yuv420p,format=rgb24 -c:v rawvideo -f null -
+
+FATE_BENCH-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER YADIF_FILTER RAWVIDEO_ENCODER NULL_MUXER) += fate-bench-filter-yadif
+fate-bench-filter-yadif: CMD = bench $(BENCH_VSRC) -vf format=yuv420p,yadif -c:v rawvideo -f null -
+
+FATE_BENCH-$(call ALLYES, LAVFI_INDEV SINE_FILTER ARESAMPLE_FILTER PCM_S16LE_ENCODER NULL_MUXER) += fate-bench-filter-aresample
+fate-bench-filter-aresample: CMD = bench $(BENCH_ASRC) -af aresample=44100 -c:a pcm_s16le -f null -
+
+# decoding, with the samples looped to last long enough
+FATE_BENCH_SAMPLES-$(call DEMDEC, H264, H264) += fate-bench-dec-h264
+fate-bench-dec-h264: CMD = bench -stream_loop 19 -i $(TARGET_SAMPLES)/h264-conformance/CABA3_TOSHIBA_E.264 -f null -
+
+FATE_BENCH_SAMPLES-$(call DEMDEC, HEVC, HEVC) += fate-bench-dec-hevc
+fate-bench-dec-hevc: CMD = bench -stream_loop 19 -i $(TARGET_SAMPLES)/hevc-conformance/WPP_A_ericsson_MAIN_2.bit -f null -
+
+FATE_BENCH_SAMPLES-$(call DEMDEC, MATROSKA, VP9) += fate-bench-dec-vp9
+fate-bench-dec-vp9: CMD = bench -stream_loop 4 -i $(TARGET_SAMPLES)/vp9-test-vectors/vp90-2-tiling-pedestrian.webm -f null -
+
+FATE_BENCH_SAMPLES-$(call DEMDEC, MPEGTS, MPEG2VIDEO) += fate-bench-dec-mpeg2
+fate-bench-dec-mpeg2: CMD = bench -stream_loop 9 -i $(TARGET_SAMPLES)/mpeg2/mpeg2_field_encoding.ts -an -f null -
+
+# remuxing
+FATE_BENCH_SAMPLES-$(call DEMMUX, MPEGTS, MPEGTS) += fate-bench-remux-mpegts
+fate-bench-remux-mpegts: CMD = bench -stream_loop 49 -i $(TARGET_SAMPLES)/mpeg2/mpeg2_field_encoding.ts -map 0 -c copy -f mpegts -
+
+FATE_BENCH_SAMPLES-$(call ALLYES, MOV_DEMUXER H264_MP4TOANNEXB_BSF MPEGTS_MUXER) += fate-bench-remux-mp4-mpegts
+fate-bench-remux-mp4-mpegts: CMD = bench -stream_loop 49 -i $(TARGET_SAMPLES)/h264/interlaced_crop.mp4 -c copy -bsf:v h264_mp4toannexb -f mpegts -
+
+FATE_BENCH += $(FATE_BENCH-yes)
+ifdef SAMPLES
+FATE_BENCH += $(FATE_BENCH_SAMPLES-yes)
+endif
+
+$(FATE_BENCH): export BENCH_RUNS := $(BENCH_RUNS)
+$(FATE_BENCH): export BENCH_TOLERANCE := $(BENCH_TOLERANCE)
+$(FATE_BENCH): CMP = bench
+$(FATE_BENCH): REF = $(BENCH_REF)/$(@:fate-bench-%=%)
+$(FATE_BENCH): ffmpeg$(PROGSSUF)$(EXESUF)
+
+fate-bench: $(FATE_BENCH)
@@ -10,6 +10,10 @@ FATE_LIBAVFORMAT-$(CONFIG_FFRTMPCRYPT_PROTOCOL) += fate-rtmpdh
 fate-rtmpdh: libavformat/rtmpdh-test$(EXESUF)
 fate-rtmpdh: CMD = run libavformat/rtmpdh-test
 
+FATE_LIBAVFORMAT-$(CONFIG_RTP_PROTOCOL) += fate-rtpfec
+fate-rtpfec: libavformat/rtpfec-test$(EXESUF)
+fate-rtpfec: CMD = run libavformat/rtpfec-test
+
 FATE_LIBAVFORMAT-yes += fate-srtp
 fate-srtp: libavformat/srtp-test$(EXESUF)
 fate-srtp: CMD = run libavformat/srtp-test
@@ -0,0 +1,789 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Cut many clips out of one input, with frame accurate boundaries.
+ *
+ * The input is opened and probed once. For each time range, the demuxer
+ * seeks to the keyframe before the start and collects the packets up to
+ * the end in memory. Then a worker thread decodes them, drops what is
+ * outside of the range with the trim filters, encodes and writes the clip.
+ * The demuxing is sequential, but several clips are decoded and encoded at
+ * the same time, each with its own decoders and encoders.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "libavcodec/avcodec.h"
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libavformat/avformat.h"
+#include "libavutil/avstring.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/dict.h"
+#include "libavutil/mem.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+/* an input stream copied to the clips */
+typedef struct Track {
+    int index;
+    enum AVMediaType type;
+    AVCodecContext *par;        /* the probed parameters, never opened */
+    AVRational time_base;
+    AVRational frame_rate;
+} Track;
+
+/* a track in a clip being written */
+typedef struct ClipStream {
+    Track *track;
+    AVCodecContext *dec, *enc;
+    AVFilterGraph *graph;
+    AVFilterContext *src, *sink;
+    AVFrame *filtered;
+    AVStream *st;
+    int64_t last_pts;
+    int eof;                    /* the encoder has been flushed */
+} ClipStream;
+
+typedef struct Clip {
+    int index;
+    int64_t start, end;         /* in AV_TIME_BASE, relative to the input start */
+    char filename[1024];
+    AVPacket *packets;
+    int nb_packets;
+    int ret;
+    int finished;
+#if HAVE_PTHREADS
+    pthread_t thread;
+    int running;
+#endif
+} Clip;
+
+static const char *format_name;
+static const char *codec_names[AVMEDIA_TYPE_NB];
+static AVDictionary *codec_opts[AVMEDIA_TYPE_NB];
+static int jobs;
+static int threads = 1;
+static int video_only;
+
+static AVFormatContext *ifmt;
+static Track tracks[2];
+static int nb_tracks;
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: clip_extract [options] input output range [range...]\n"
+            "The output name contains %%d, replaced by the clip number from 1.\n"
+            "A range is start-end or start+duration, each time in seconds or\n"
+            "[HH:]MM:SS[.m...], from the start of the input.\n"
+            "Options:\n"
+            "    -j jobs     clips encoded at the same time (default: one per CPU)\n"
+            "    -t threads  threads of each decoder and encoder (default 1)\n"
+            "    -f format   output format (default: guessed from the name)\n"
+            "    -c codec    video encoder (default: the format's)\n"
+            "    -o options  video encoder options, as key=value:key=value\n"
+            "    -a codec    audio encoder (default: the format's)\n"
+            "    -O options  audio encoder options\n"
+            "    -n          leave out the audio\n"
+            );
+    exit(ret);
+}
+
+static int parse_range(Clip *clip, const char *arg)
+{
+    char buf[128], *sep;
+    int64_t t;
+    int duration;
+
+    av_strlcpy(buf, arg, sizeof(buf));
+    if (!(sep = strpbrk(buf + 1, "-+")))
+        return AVERROR(EINVAL);
+    duration = *sep == '+';
+    *sep = 0;
+    if (av_parse_time(&clip->start, buf, 1) < 0 ||
+        av_parse_time(&t, sep + 1, 1) < 0)
+        return AVERROR(EINVAL);
+    clip->end = duration ? clip->start + t : t;
+    return clip->start >= 0 && clip->end > clip->start ? 0 : AVERROR(EINVAL);
+}
+
+static int open_input(const char *filename)
+{
+    static const enum AVMediaType types[] = { AVMEDIA_TYPE_VIDEO, AVMEDIA_TYPE_AUDIO };
+    int i, idx, ret;
+
+    if ((ret = avformat_open_input(&ifmt, filename, NULL, NULL)) < 0) {
+        fprintf(stderr, "%s: %s\n", filename, av_err2str(ret));
+        return ret;
+    }
+    if ((ret = avformat_find_stream_info(ifmt, NULL)) < 0) {
+        fprintf(stderr, "%s: could not find codec parameters: %s\n", filename,
+                av_err2str(ret));
+        return ret;
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(types) - video_only; i++) {
+        Track *t = &tracks[nb_tracks];
+        AVStream *st;
+
+        idx = av_find_best_stream(ifmt, types[i], -1, -1, NULL, 0);
+        if (idx < 0)
+            continue;
+        st = ifmt->streams[idx];
+        t->index      = idx;
+        t->type       = types[i];
+        t->time_base  = st->time_base;
+        t->frame_rate = av_guess_frame_rate(ifmt, st, NULL);
+        if (!t->frame_rate.num || !t->frame_rate.den)
+            t->frame_rate = (AVRational){ 25, 1 };
+        /* copied once, as the demuxer may update st->codec while the
+         * workers open their decoders */
+        if (!(t->par = avcodec_alloc_context3(NULL)))
+            return AVERROR(ENOMEM);
+        if ((ret = avcodec_copy_context(t->par, st->codec)) < 0)
+            return ret;
+        nb_tracks++;
+    }
+    if (!nb_tracks) {
+        fprintf(stderr, "%s: no audio or video stream\n", filename);
+        return AVERROR_STREAM_NOT_FOUND;
+    }
+    return 0;
+}
+
+static Track *find_track(int index)
+{
+    int i;
+
+    for (i = 0; i < nb_tracks; i++)
+        if (tracks[i].index == index)
+            return &tracks[i];
+    return NULL;
+}
+
+static void free_clip_packets(Clip *clip)
+{
+    int i;
+
+    for (i = 0; i < clip->nb_packets; i++)
+        av_packet_unref(&clip->packets[i]);
+    av_freep(&clip->packets);
+    clip->nb_packets = 0;
+}
+
+/* Seek to the keyframe before the start of the clip and read the packets
+ * of the tracks until all of them are past its end. Some demuxers, e.g.
+ * mpegts, seek to a position before the start but after that keyframe, so
+ * the seek is retried earlier and earlier until a video keyframe at or
+ * before the start is found. */
+static int read_clip_packets(Clip *clip)
+{
+    int64_t offset = ifmt->start_time != AV_NOPTS_VALUE ? ifmt->start_time : 0;
+    int64_t start  = offset + clip->start, end = offset + clip->end;
+    int64_t preroll = 0, target;
+    int done[FF_ARRAY_ELEMS(tracks)], keyframe;
+    int nb_done, size = 0, ret;
+    AVPacket pkt;
+
+    av_init_packet(&pkt);
+retry:
+    target = FFMAX(start - preroll, offset);
+    ret = avformat_seek_file(ifmt, -1, INT64_MIN, target, target, 0);
+    if (ret < 0) {
+        fprintf(stderr, "Clip %d: could not seek to %.3f: %s\n", clip->index,
+                clip->start / 1000000.0, av_err2str(ret));
+        return ret;
+    }
+    memset(done, 0, sizeof(done));
+    nb_done  = 0;
+    keyframe = 0;
+
+    while (nb_done < nb_tracks && (ret = av_read_frame(ifmt, &pkt)) >= 0) {
+        Track *t = find_track(pkt.stream_index);
+        int64_t ts = pkt.dts != AV_NOPTS_VALUE ? pkt.dts : pkt.pts;
+        int i;
+
+        if (!t || done[i = t - tracks]) {
+            av_packet_unref(&pkt);
+            continue;
+        }
+        if (t->type == AVMEDIA_TYPE_VIDEO && !keyframe) {
+            int64_t pts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts;
+
+            /* not decodable */
+            if (!(pkt.flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(&pkt);
+                continue;
+            }
+            if (pts != AV_NOPTS_VALUE && target > offset &&
+                preroll < 64 * AV_TIME_BASE &&
+                av_compare_ts(pts, t->time_base, start, AV_TIME_BASE_Q) > 0) {
+                av_packet_unref(&pkt);
+                free_clip_packets(clip);
+                size    = 0;
+                preroll = preroll ? 2 * preroll : AV_TIME_BASE;
+                goto retry;
+            }
+            keyframe = 1;
+        }
+        /* the packets decoded after it all have a later pts */
+        if (ts != AV_NOPTS_VALUE &&
+            av_compare_ts(ts, t->time_base, end, AV_TIME_BASE_Q) >= 0) {
+            done[i] = 1;
+            nb_done++;
+            av_packet_unref(&pkt);
+            continue;
+        }
+
+        if (clip->nb_packets == size) {
+            size = FFMAX(2 * size, 256);
+            if ((ret = av_reallocp_array(&clip->packets, size, sizeof(*clip->packets))) < 0) {
+                clip->nb_packets = 0;
+                av_packet_unref(&pkt);
+                return ret;
+            }
+        }
+        av_init_packet(&clip->packets[clip->nb_packets]);
+        ret = av_packet_ref(&clip->packets[clip->nb_packets], &pkt);
+        av_packet_unref(&pkt);
+        if (ret < 0)
+            return ret;
+        clip->nb_packets++;
+    }
+    return ret == AVERROR_EOF ? 0 : FFMIN(ret, 0);
+}
+
+/* Build the filter converting the frames to a format supported by the
+ * encoder. */
+static void encoder_format_filter(char *buf, int size, const AVCodec *codec,
+                                  const AVCodecContext *par)
+{
+    int i;
+
+    if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+        enum AVPixelFormat fmt = par->pix_fmt;
+        if (codec->pix_fmts)
+            fmt = avcodec_find_best_pix_fmt_of_list(codec->pix_fmts, fmt, 0, NULL);
+        snprintf(buf, size, "format=pix_fmts=%s", av_get_pix_fmt_name(fmt));
+    } else {
+        enum AVSampleFormat fmt = par->sample_fmt;
+        int rate = par->sample_rate;
+        uint64_t layout = par->channel_layout;
+
+        if (!layout)
+            layout = av_get_default_channel_layout(par->channels);
+        if (codec->sample_fmts) {
+            for (i = 0; codec->sample_fmts[i] != AV_SAMPLE_FMT_NONE; i++)
+                if (codec->sample_fmts[i] == fmt)
+                    break;
+            if (codec->sample_fmts[i] == AV_SAMPLE_FMT_NONE)
+                fmt = codec->sample_fmts[0];
+        }
+        if (codec->supported_samplerates) {
+            for (i = 0; codec->supported_samplerates[i]; i++)
+                if (codec->supported_samplerates[i] == rate)
+                    break;
+            if (!codec->supported_samplerates[i])
+                rate = codec->supported_samplerates[0];
+        }
+        if (codec->channel_layouts) {
+            for (i = 0; codec->channel_layouts[i]; i++)
+                if (codec->channel_layouts[i] == layout)
+                    break;
+            if (!codec->channel_layouts[i])
+                layout = codec->channel_layouts[0];
+        }
+        snprintf(buf, size, "aformat=sample_fmts=%s:sample_rates=%d:channel_layouts=0x%"PRIx64,
+                 av_get_sample_fmt_name(fmt), rate, layout);
+    }
+}
+
+/* Trim the decoded frames to the clip, with timestamps from 0, and convert
+ * them for the encoder. */
+static int init_filters(ClipStream *cs, const Clip *clip, const AVCodec *codec)
+{
+    const AVCodecContext *par = cs->track->par;
+    AVRational tb = cs->track->time_base;
+    int video = par->codec_type == AVMEDIA_TYPE_VIDEO;
+    int64_t offset = ifmt->start_time != AV_NOPTS_VALUE ? ifmt->start_time : 0;
+    int64_t start = av_rescale_q(offset + clip->start, AV_TIME_BASE_Q, tb);
+    int64_t end   = av_rescale_q(offset + clip->end,   AV_TIME_BASE_Q, tb);
+    AVFilterInOut *inputs = NULL, *outputs = NULL;
+    char args[256], fmt[256], desc[512];
+    int ret;
+
+    if (!(cs->graph = avfilter_graph_alloc()))
+        return AVERROR(ENOMEM);
+    cs->graph->nb_threads = 1;
+
+    if (video) {
+        snprintf(args, sizeof(args),
+                 "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
+                 par->width, par->height, par->pix_fmt, tb.num, tb.den,
+                 par->sample_aspect_ratio.num,
+                 FFMAX(par->sample_aspect_ratio.den, 1));
+    } else {
+        uint64_t layout = par->channel_layout;
+        if (!layout)
+            layout = av_get_default_channel_layout(par->channels);
+        snprintf(args, sizeof(args),
+                 "time_base=%d/%d:sample_rate=%d:sample_fmt=%s:channel_layout=0x%"PRIx64,
+                 tb.num, tb.den, par->sample_rate,
+                 av_get_sample_fmt_name(par->sample_fmt), layout);
+    }
+    ret = avfilter_graph_create_filter(&cs->src,
+                                       avfilter_get_by_name(video ? "buffer" : "abuffer"),
+                                       "in", args, NULL, cs->graph);
+    if (ret < 0)
+        goto fail;
+    ret = avfilter_graph_create_filter(&cs->sink,
+                                       avfilter_get_by_name(video ? "buffersink" : "abuffersink"),
+                                       "out", NULL, NULL, cs->graph);
+    if (ret < 0)
+        goto fail;
+
+    outputs = avfilter_inout_alloc();
+    inputs  = avfilter_inout_alloc();
+    if (!outputs || !inputs) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    outputs->name       = av_strdup("in");
+    outputs->filter_ctx = cs->src;
+    inputs->name        = av_strdup("out");
+    inputs->filter_ctx  = cs->sink;
+    if (!outputs->name || !inputs->name) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    encoder_format_filter(fmt, sizeof(fmt), codec, par);
+    snprintf(desc, sizeof(desc),
+             "%strim=start_pts=%"PRId64":end_pts=%"PRId64",%ssetpts=PTS-%"PRId64",%s",
+             video ? "" : "a", start, end, video ? "" : "a", start, fmt);
+    if ((ret = avfilter_graph_parse_ptr(cs->graph, desc, &inputs, &outputs, NULL)) < 0 ||
+        (ret = avfilter_graph_config(cs->graph, NULL)) < 0)
+        fprintf(stderr, "Could not configure the filtergraph '%s': %s\n",
+                desc, av_err2str(ret));
+fail:
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    return ret;
+}
+
+static int open_clip_stream(ClipStream *cs, AVFormatContext *oc, const Clip *clip)
+{
+    const AVCodecContext *par = cs->track->par;
+    enum AVMediaType type = cs->track->type;
+    AVDictionary *opts = NULL;
+    AVDictionaryEntry *e;
+    AVFilterLink *link;
+    AVCodec *codec;
+    int ret;
+
+    /* decoder */
+    if (!(codec = avcodec_find_decoder(par->codec_id))) {
+        fprintf(stderr, "Decoder %s not found\n", avcodec_get_name(par->codec_id));
+        return AVERROR_DECODER_NOT_FOUND;
+    }
+    if (!(cs->dec = avcodec_alloc_context3(NULL)))
+        return AVERROR(ENOMEM);
+    if ((ret = avcodec_copy_context(cs->dec, par)) < 0)
+        return ret;
+    cs->dec->pkt_timebase      = cs->track->time_base;
+    cs->dec->refcounted_frames = 1;
+    cs->dec->thread_count      = threads;
+    if ((ret = avcodec_open2(cs->dec, codec, NULL)) < 0) {
+        fprintf(stderr, "Could not open decoder %s: %s\n", codec->name, av_err2str(ret));
+        return ret;
+    }
+
+    /* encoder and filters */
+    if (codec_names[type])
+        codec = avcodec_find_encoder_by_name(codec_names[type]);
+    else
+        codec = avcodec_find_encoder(av_guess_codec(oc->oformat, NULL, oc->filename,
+                                                    NULL, type));
+    if (!codec || codec->type != type) {
+        fprintf(stderr, "%s encoder %s not found\n", av_get_media_type_string(type),
+                codec_names[type] ? codec_names[type] : "for the output format");
+        return AVERROR_ENCODER_NOT_FOUND;
+    }
+    if ((ret = init_filters(cs, clip, codec)) < 0)
+        return ret;
+    if (!(cs->filtered = av_frame_alloc()) ||
+        !(cs->enc = avcodec_alloc_context3(codec)))
+        return AVERROR(ENOMEM);
+
+    link = cs->sink->inputs[0];
+    if (type == AVMEDIA_TYPE_VIDEO) {
+        cs->enc->width               = link->w;
+        cs->enc->height              = link->h;
+        cs->enc->pix_fmt             = link->format;
+        cs->enc->sample_aspect_ratio = link->sample_aspect_ratio;
+        cs->enc->framerate           = cs->track->frame_rate;
+        cs->enc->time_base           = av_inv_q(cs->track->frame_rate);
+    } else {
+        cs->enc->sample_fmt          = link->format;
+        cs->enc->sample_rate         = link->sample_rate;
+        cs->enc->channel_layout      = link->channel_layout;
+        cs->enc->channels            = avfilter_link_get_channels(link);
+        cs->enc->time_base           = (AVRational){ 1, link->sample_rate };
+    }
+    cs->enc->thread_count = threads;
+    if (oc->oformat->flags & AVFMT_GLOBALHEADER)
+        cs->enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    av_dict_copy(&opts, codec_opts[type], 0);
+    ret = avcodec_open2(cs->enc, codec, &opts);
+    if (ret >= 0 && (e = av_dict_get(opts, "", NULL, AV_DICT_IGNORE_SUFFIX))) {
+        fprintf(stderr, "Option %s not found\n", e->key);
+        ret = AVERROR_OPTION_NOT_FOUND;
+    }
+    av_dict_free(&opts);
+    if (ret < 0) {
+        fprintf(stderr, "Could not open encoder %s: %s\n", codec->name, av_err2str(ret));
+        return ret;
+    }
+    if (type == AVMEDIA_TYPE_AUDIO && cs->enc->frame_size &&
+        !(codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE))
+        av_buffersink_set_frame_size(cs->sink, cs->enc->frame_size);
+
+    /* output stream */
+    if (!(cs->st = avformat_new_stream(oc, NULL)))
+        return AVERROR(ENOMEM);
+    cs->st->time_base = cs->enc->time_base;
+    if ((ret = avcodec_copy_context(cs->st->codec, cs->enc)) < 0)
+        return ret;
+    cs->st->codec->codec_tag = 0;
+    cs->last_pts = AV_NOPTS_VALUE;
+    return 0;
+}
+
+static void close_clip_stream(ClipStream *cs)
+{
+    avcodec_free_context(&cs->dec);
+    avcodec_free_context(&cs->enc);
+    avfilter_graph_free(&cs->graph);
+    av_frame_free(&cs->filtered);
+}
+
+static int encode_frame(ClipStream *cs, AVFormatContext *oc, AVFrame *frame)
+{
+    AVPacket pkt;
+    int ret;
+
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+
+    if ((ret = avcodec_send_frame(cs->enc, frame)) < 0)
+        return ret;
+    while ((ret = avcodec_receive_packet(cs->enc, &pkt)) >= 0) {
+        av_packet_rescale_ts(&pkt, cs->enc->time_base, cs->st->time_base);
+        pkt.stream_index = cs->st->index;
+        if ((ret = av_interleaved_write_frame(oc, &pkt)) < 0)
+            return ret;
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+/* Send a decoded frame, or NULL at the end, through the filters to the
+ * encoder. */
+static int filter_frame(ClipStream *cs, AVFormatContext *oc, AVFrame *frame)
+{
+    AVFrame *out = cs->filtered;
+    int ret;
+
+    if (cs->eof)
+        return 0;
+    if ((ret = av_buffersrc_add_frame(cs->src, frame)) < 0)
+        return ret;
+
+    while ((ret = av_buffersink_get_frame(cs->sink, out)) >= 0) {
+        out->pts = av_rescale_q(out->pts, cs->sink->inputs[0]->time_base,
+                                cs->enc->time_base);
+        /* variable frame rate input, in a constant frame rate encoder */
+        if (cs->track->type == AVMEDIA_TYPE_VIDEO) {
+            if (cs->last_pts != AV_NOPTS_VALUE && out->pts <= cs->last_pts) {
+                av_frame_unref(out);
+                continue;
+            }
+            cs->last_pts   = out->pts;
+            out->pict_type = AV_PICTURE_TYPE_NONE;
+        }
+        ret = encode_frame(cs, oc, out);
+        av_frame_unref(out);
+        if (ret < 0)
+            return ret;
+    }
+    if (ret == AVERROR_EOF) {
+        cs->eof = 1;
+        return encode_frame(cs, oc, NULL);
+    }
+    return ret == AVERROR(EAGAIN) ? 0 : ret;
+}
+
+static int decode_packet(ClipStream *cs, AVFormatContext *oc, const AVPacket *pkt,
+                         AVFrame *frame)
+{
+    int ret = avcodec_send_packet(cs->dec, pkt);
+
+    if (ret < 0 && ret != AVERROR_EOF)
+        av_log(NULL, AV_LOG_WARNING, "Error decoding a packet: %s\n", av_err2str(ret));
+
+    while ((ret = avcodec_receive_frame(cs->dec, frame)) >= 0) {
+        frame->pts = av_frame_get_best_effort_timestamp(frame);
+        ret = filter_frame(cs, oc, frame);
+        av_frame_unref(frame);
+        if (ret < 0)
+            return ret;
+    }
+    if (ret == AVERROR_EOF)
+        return filter_frame(cs, oc, NULL);
+    return ret == AVERROR(EAGAIN) ? 0 : ret;
+}
+
+static int write_clip(Clip *clip)
+{
+    ClipStream streams[FF_ARRAY_ELEMS(tracks)] = { { 0 } };
+    AVFormatContext *oc = NULL;
+    AVFrame *frame = NULL;
+    int i, j, ret;
+
+    ret = avformat_alloc_output_context2(&oc, NULL, format_name, clip->filename);
+    if (!oc) {
+        fprintf(stderr, "%s: could not find the output format: %s\n",
+                clip->filename, av_err2str(ret));
+        return ret;
+    }
+    for (i = 0; i < nb_tracks; i++) {
+        streams[i].track = &tracks[i];
+        if ((ret = open_clip_stream(&streams[i], oc, clip)) < 0)
+            goto end;
+    }
+    if (!(frame = av_frame_alloc())) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    if (!(oc->oformat->flags & AVFMT_NOFILE) &&
+        (ret = avio_open(&oc->pb, clip->filename, AVIO_FLAG_WRITE)) < 0) {
+        fprintf(stderr, "%s: %s\n", clip->filename, av_err2str(ret));
+        goto end;
+    }
+    if ((ret = avformat_write_header(oc, NULL)) < 0) {
+        fprintf(stderr, "%s: could not write the header: %s\n",
+                clip->filename, av_err2str(ret));
+        goto end;
+    }
+
+    for (i = 0; i < clip->nb_packets; i++) {
+        AVPacket *pkt = &clip->packets[i];
+
+        for (j = 0; j < nb_tracks; j++)
+            if (streams[j].track->index == pkt->stream_index)
+                break;
+        ret = decode_packet(&streams[j], oc, pkt, frame);
+        av_packet_unref(pkt);
+        if (ret < 0)
+            goto end;
+    }
+    for (j = 0; j < nb_tracks; j++)
+        if ((ret = decode_packet(&streams[j], oc, NULL, frame)) < 0)
+            goto end;
+
+    ret = av_write_trailer(oc);
+end:
+    if (ret < 0)
+        fprintf(stderr, "Clip %d failed: %s\n", clip->index, av_err2str(ret));
+    for (j = 0; j < nb_tracks; j++)
+        close_clip_stream(&streams[j]);
+    av_frame_free(&frame);
+    if (!(oc->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+    return ret;
+}
+
+static void *clip_thread(void *arg)
+{
+    Clip *clip = arg;
+
+    clip->ret = write_clip(clip);
+    return NULL;
+}
+
+static void finish_clip(Clip *clip)
+{
+    if (clip->finished)
+        return;
+    clip->finished = 1;
+#if HAVE_PTHREADS
+    if (clip->running) {
+        pthread_join(clip->thread, NULL);
+        clip->running = 0;
+    }
+#endif
+    free_clip_packets(clip);
+    if (clip->ret >= 0)
+        printf("clip %d: %s, %.3f - %.3f\n", clip->index, clip->filename,
+               clip->start / 1000000.0, clip->end / 1000000.0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *filename, *output;
+    Clip *clips = NULL;
+    int64_t start;
+    int opt, i, nb_clips, nb_failed = 0, ret = 0;
+
+    while ((opt = getopt(argc, argv, "j:t:f:c:o:a:O:nh")) != -1) {
+        switch (opt) {
+        case 'j':
+            jobs = atoi(optarg);
+            if (jobs <= 0)
+                usage(1);
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'f':
+            format_name = optarg;
+            break;
+        case 'c':
+        case 'a':
+            codec_names[opt == 'c' ? AVMEDIA_TYPE_VIDEO : AVMEDIA_TYPE_AUDIO] = optarg;
+            break;
+        case 'o':
+        case 'O':
+            if (av_dict_parse_string(&codec_opts[opt == 'o' ? AVMEDIA_TYPE_VIDEO :
+                                                              AVMEDIA_TYPE_AUDIO],
+                                     optarg, "=", ":", 0) < 0) {
+                fprintf(stderr, "Invalid codec options '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            video_only = 1;
+            break;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc < 3)
+        usage(1);
+    filename = argv[0];
+    output   = argv[1];
+    nb_clips = argc - 2;
+    if (!jobs)
+        jobs = av_cpu_count();
+    if (!HAVE_PTHREADS)
+        jobs = 1;
+
+    if (!(clips = av_mallocz_array(nb_clips, sizeof(*clips))))
+        return 1;
+    for (i = 0; i < nb_clips; i++) {
+        clips[i].index = i + 1;
+        if (parse_range(&clips[i], argv[i + 2]) < 0) {
+            fprintf(stderr, "Invalid range '%s'\n", argv[i + 2]);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        if (av_get_frame_filename(clips[i].filename, sizeof(clips[i].filename),
+                                  output, clips[i].index) < 0) {
+            fprintf(stderr, "The output name '%s' must contain %%d\n", output);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+    }
+
+    av_register_all();
+    avfilter_register_all();
+
+    if ((ret = open_input(filename)) < 0)
+        goto end;
+
+    start = av_gettime_relative();
+    for (i = 0; i < nb_clips; i++) {
+        Clip *clip = &clips[i];
+
+        /* at most jobs clips in flight, their packets held in memory */
+        if (i >= jobs)
+            finish_clip(&clips[i - jobs]);
+
+        if ((clip->ret = read_clip_packets(clip)) < 0)
+            continue;
+#if HAVE_PTHREADS
+        if (jobs > 1) {
+            if ((ret = pthread_create(&clip->thread, NULL, clip_thread, clip))) {
+                fprintf(stderr, "pthread_create failed: %s\n", strerror(ret));
+                clip->ret = AVERROR(ret);
+                continue;
+            }
+            clip->running = 1;
+            continue;
+        }
+#endif
+        clip_thread(clip);
+    }
+    for (i = FFMAX(nb_clips - jobs, 0); i < nb_clips; i++)
+        finish_clip(&clips[i]);
+
+    for (i = 0; i < nb_clips; i++)
+        nb_failed += clips[i].ret < 0;
+    printf("%d clips in %.3fs, %d failed\n", nb_clips,
+           (av_gettime_relative() - start) / 1000000.0, nb_failed);
+    ret = nb_failed ? AVERROR(EINVAL) : 0;
+
+end:
+    if (clips)
+        for (i = 0; i < nb_clips; i++)
+            finish_clip(&clips[i]);
+    av_free(clips);
+    for (i = 0; i < nb_tracks; i++)
+        avcodec_free_context(&tracks[i].par);
+    for (i = 0; i < AVMEDIA_TYPE_NB; i++)
+        av_dict_free(&codec_opts[i]);
+    avformat_close_input(&ifmt);
+    return ret < 0;
+}
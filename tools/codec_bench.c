@@ -0,0 +1,845 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Decoder, encoder and filtergraph throughput benchmark.
+ *
+ * The input is demuxed (and, to benchmark an encoder or a filtergraph,
+ * decoded) into memory before the measurement, so that only the codec or
+ * the filters are timed. Each run reopens the codec or rebuilds the graph,
+ * outside of the measurement as well.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavcodec/avcodec.h"
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libavformat/avformat.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/dict.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#define HIST_BUCKETS 24
+
+enum Mode {
+    MODE_DECODE,
+    MODE_ENCODE,
+    MODE_FILTER,
+};
+
+typedef struct Samples {
+    int64_t *val;
+    int nb, size;
+} Samples;
+
+static enum Mode mode;
+static const char *codec_name;
+static AVDictionary *codec_opts;
+static int runs        = 5;
+static int threads     = 1;
+static int thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+static int max_frames  = -1;
+static enum AVMediaType media_type = AVMEDIA_TYPE_VIDEO;
+
+static AVFormatContext *ifmt;
+static AVStream *ist;
+static AVRational frame_rate;
+static AVPacket *packets;
+static int nb_packets;
+static AVFrame **frames;
+static int nb_frames;
+
+/* time at which each packet or frame was sent, indexed by packet position
+ * or frame pts */
+static int64_t *send_time;
+static int64_t last_time;
+static int nb_out;
+static Samples intervals, latencies;
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: codec_bench [options] decode input\n"
+            "       codec_bench [options] encode input\n"
+            "       codec_bench [options] filter input graph\n"
+            "Options:\n"
+            "    -n runs     number of runs (default 5)\n"
+            "    -c codec    decoder or encoder to benchmark, which can be a\n"
+            "                hardware decoder such as h264_cuvid or h264_qsv\n"
+            "    -o options  codec options, as key=value:key=value\n"
+            "    -j threads  number of codec or filter threads, 0 for automatic\n"
+            "                (default 1)\n"
+            "    -t type     thread type: frame, slice or frame+slice (default)\n"
+            "    -C flags    CPU flags, as the ffmpeg -cpuflags option\n"
+            "    -a          use the audio stream rather than the video stream\n"
+            "    -F frames   number of raw frames to preload for encode and\n"
+            "                filter (default 100), of packets for decode\n"
+            "                (default all)\n"
+            );
+    exit(ret);
+}
+
+static int add_sample(Samples *s, int64_t val)
+{
+    if (s->nb == s->size) {
+        int size = FFMAX(2 * s->size, 256);
+        int ret  = av_reallocp_array(&s->val, size, sizeof(*s->val));
+        if (ret < 0) {
+            s->nb = s->size = 0;
+            return ret;
+        }
+        s->size = size;
+    }
+    s->val[s->nb++] = val;
+    return 0;
+}
+
+/* Record an output frame or packet, and its latency if the time at which
+ * the corresponding input was sent is known. */
+static int tick(int64_t sent)
+{
+    int64_t now = av_gettime_relative();
+    int ret;
+
+    if ((ret = add_sample(&intervals, now - last_time)) < 0)
+        return ret;
+    if (sent >= 0 && (ret = add_sample(&latencies, now - sent)) < 0)
+        return ret;
+    last_time = now;
+    nb_out++;
+    return 0;
+}
+
+static int cmp_int64(const void *a, const void *b)
+{
+    int64_t va = *(const int64_t *)a, vb = *(const int64_t *)b;
+    return (va > vb) - (va < vb);
+}
+
+static void print_histogram(const char *name, Samples *s)
+{
+    int hist[HIST_BUCKETS] = { 0 };
+    int i, first = HIST_BUCKETS, last = 0, max = 0;
+
+    if (!s->nb)
+        return;
+
+    qsort(s->val, s->nb, sizeof(*s->val), cmp_int64);
+    printf("\n%s (us): min %"PRId64" median %"PRId64" p90 %"PRId64
+           " p99 %"PRId64" max %"PRId64"\n", name, s->val[0],
+           s->val[s->nb / 2], s->val[FFMIN(s->nb * 90LL / 100, s->nb - 1)],
+           s->val[FFMIN(s->nb * 99LL / 100, s->nb - 1)], s->val[s->nb - 1]);
+
+    /* bucket i holds the values in [2^(i-1), 2^i) */
+    for (i = 0; i < s->nb; i++) {
+        int b = s->val[i] > 0 ? av_log2(FFMIN(s->val[i], INT_MAX)) + 1 : 0;
+        b = FFMIN(b, HIST_BUCKETS - 1);
+        hist[b]++;
+        first = FFMIN(first, b);
+        last  = FFMAX(last,  b);
+    }
+    for (i = first; i <= last; i++)
+        max = FFMAX(max, hist[i]);
+    for (i = first; i <= last; i++) {
+        int lo = i ? 1 << (i - 1) : 0;
+        int len = (hist[i] * 50LL + max - 1) / max;
+        if (i == HIST_BUCKETS - 1)
+            printf("%9d -           %8d ", lo, hist[i]);
+        else
+            printf("%9d - %9d %8d ", lo, i ? (1 << i) - 1 : 0, hist[i]);
+        while (len--)
+            putchar('#');
+        putchar('\n');
+    }
+}
+
+static int load_packets(const char *filename)
+{
+    AVPacket pkt;
+    int ret, idx;
+
+    if ((ret = avformat_open_input(&ifmt, filename, NULL, NULL)) < 0) {
+        fprintf(stderr, "%s: %s\n", filename, av_err2str(ret));
+        return ret;
+    }
+    if ((ret = avformat_find_stream_info(ifmt, NULL)) < 0) {
+        fprintf(stderr, "%s: could not find codec parameters: %s\n", filename,
+                av_err2str(ret));
+        return ret;
+    }
+    idx = av_find_best_stream(ifmt, media_type, -1, -1, NULL, 0);
+    if (idx < 0) {
+        fprintf(stderr, "%s: no %s stream\n", filename,
+                av_get_media_type_string(media_type));
+        return idx;
+    }
+    ist = ifmt->streams[idx];
+    frame_rate = av_guess_frame_rate(ifmt, ist, NULL);
+    if (!frame_rate.num || !frame_rate.den)
+        frame_rate = (AVRational){ 25, 1 };
+
+    av_init_packet(&pkt);
+    while (av_read_frame(ifmt, &pkt) >= 0) {
+        if (pkt.stream_index == idx) {
+            if ((ret = av_reallocp_array(&packets, nb_packets + 1,
+                                         sizeof(*packets))) < 0) {
+                av_packet_unref(&pkt);
+                nb_packets = 0;
+                return ret;
+            }
+            av_init_packet(&packets[nb_packets]);
+            if ((ret = av_packet_ref(&packets[nb_packets], &pkt)) < 0) {
+                av_packet_unref(&pkt);
+                nb_packets = 0;
+                return ret;
+            }
+            /* passed through to the frames, to find when they were sent */
+            packets[nb_packets].pos = nb_packets;
+            nb_packets++;
+        }
+        av_packet_unref(&pkt);
+        if (mode == MODE_DECODE && max_frames >= 0 && nb_packets >= max_frames)
+            break;
+    }
+    if (!nb_packets) {
+        fprintf(stderr, "%s: no packets\n", filename);
+        return AVERROR_INVALIDDATA;
+    }
+    return 0;
+}
+
+/* Open the codec, failing if some of the options are not used by it. */
+static int open_codec(AVCodecContext *avctx, AVCodec *codec, int bench)
+{
+    AVDictionary *opts = NULL;
+    AVDictionaryEntry *e;
+    int ret;
+
+    if (bench)
+        av_dict_copy(&opts, codec_opts, 0);
+    ret = avcodec_open2(avctx, codec, &opts);
+    if (ret >= 0 && (e = av_dict_get(opts, "", NULL, AV_DICT_IGNORE_SUFFIX))) {
+        fprintf(stderr, "Option %s not found\n", e->key);
+        ret = AVERROR_OPTION_NOT_FOUND;
+    }
+    av_dict_free(&opts);
+    if (ret < 0)
+        fprintf(stderr, "Could not open %s %s: %s\n",
+                av_codec_is_encoder(codec) ? "encoder" : "decoder",
+                codec->name, av_err2str(ret));
+    return ret;
+}
+
+static int open_decoder(AVCodecContext **pdec, int bench)
+{
+    AVCodecContext *dec;
+    AVCodec *codec;
+    int ret;
+
+    if (bench && codec_name)
+        codec = avcodec_find_decoder_by_name(codec_name);
+    else
+        codec = avcodec_find_decoder(ist->codec->codec_id);
+    if (!codec) {
+        fprintf(stderr, "Decoder %s not found\n", bench && codec_name ?
+                codec_name : avcodec_get_name(ist->codec->codec_id));
+        return AVERROR_DECODER_NOT_FOUND;
+    }
+
+    if (!(dec = avcodec_alloc_context3(NULL)))
+        return AVERROR(ENOMEM);
+    if ((ret = avcodec_copy_context(dec, ist->codec)) < 0)
+        goto fail;
+    dec->pkt_timebase      = ist->time_base;
+    dec->refcounted_frames = 1;
+    if (bench) {
+        dec->thread_count = threads;
+        dec->thread_type  = thread_type;
+    } else {
+        dec->thread_count = 0;
+    }
+    if ((ret = open_codec(dec, codec, bench)) < 0)
+        goto fail;
+    *pdec = dec;
+    return 0;
+fail:
+    avcodec_free_context(&dec);
+    return ret;
+}
+
+/* Decode all the packets, calling got_frame() for each frame, which stops
+ * the decoding by returning nonzero. */
+static int decode_all(AVCodecContext *dec, int (*got_frame)(AVFrame *frame))
+{
+    AVFrame *frame = av_frame_alloc();
+    int i, ret = 0;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i <= nb_packets; i++) {
+        send_time[i] = av_gettime_relative();
+        ret = avcodec_send_packet(dec, i < nb_packets ? &packets[i] : NULL);
+        if (ret < 0 && ret != AVERROR_EOF)
+            av_log(NULL, AV_LOG_WARNING, "Error decoding packet %d: %s\n",
+                   i, av_err2str(ret));
+        while ((ret = avcodec_receive_frame(dec, frame)) >= 0) {
+            ret = got_frame(frame);
+            av_frame_unref(frame);
+            if (ret)
+                goto end;
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            break;
+        ret = 0;
+    }
+end:
+    av_frame_free(&frame);
+    return FFMIN(ret, 0);
+}
+
+static int bench_got_frame(AVFrame *frame)
+{
+    int64_t pos = av_frame_get_pkt_pos(frame);
+    return tick(pos >= 0 && pos < nb_packets ? send_time[pos] : -1);
+}
+
+static int store_frame(AVFrame *frame)
+{
+    AVFrame *f = av_frame_alloc();
+    int ret;
+
+    if (!f)
+        return AVERROR(ENOMEM);
+    if ((ret = av_reallocp_array(&frames, nb_frames + 1, sizeof(*frames))) < 0) {
+        nb_frames = 0;
+        av_frame_free(&f);
+        return ret;
+    }
+    av_frame_move_ref(f, frame);
+    frames[nb_frames++] = f;
+    return 0;
+}
+
+static int preload_got_frame(AVFrame *frame)
+{
+    int ret = store_frame(frame);
+    return ret < 0 ? ret : nb_frames >= max_frames;
+}
+
+/* Give the frames contiguous timestamps, in the frame or sample rate. */
+static void renumber_frames(void)
+{
+    int64_t pts = 0;
+    int i;
+
+    for (i = 0; i < nb_frames; i++) {
+        frames[i]->pts = pts;
+        pts += media_type == AVMEDIA_TYPE_AUDIO ? frames[i]->nb_samples : 1;
+    }
+}
+
+static AVRational frames_time_base(void)
+{
+    if (media_type == AVMEDIA_TYPE_AUDIO)
+        return (AVRational){ 1, frames[0]->sample_rate };
+    return av_inv_q(frame_rate);
+}
+
+static int init_graph(AVFilterGraph **pgraph, AVFilterContext **psrc,
+                      AVFilterContext **psink, const char *desc,
+                      int nb_threads, int frame_size)
+{
+    const AVFrame *ref = frames[0];
+    AVRational tb = frames_time_base();
+    AVFilterGraph *graph;
+    AVFilterInOut *inputs = NULL, *outputs = NULL;
+    AVFilterContext *src, *sink;
+    int video = media_type == AVMEDIA_TYPE_VIDEO;
+    char args[256];
+    int ret;
+
+    if (!(graph = avfilter_graph_alloc()))
+        return AVERROR(ENOMEM);
+    graph->nb_threads  = nb_threads;
+    graph->thread_type = thread_type & FF_THREAD_SLICE ? AVFILTER_THREAD_SLICE : 0;
+
+    if (video) {
+        snprintf(args, sizeof(args),
+                 "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
+                 ref->width, ref->height, ref->format, tb.num, tb.den,
+                 ref->sample_aspect_ratio.num,
+                 FFMAX(ref->sample_aspect_ratio.den, 1));
+    } else {
+        uint64_t layout = ref->channel_layout;
+        if (!layout)
+            layout = av_get_default_channel_layout(av_frame_get_channels(ref));
+        snprintf(args, sizeof(args),
+                 "time_base=%d/%d:sample_rate=%d:sample_fmt=%s:channel_layout=0x%"PRIx64,
+                 tb.num, tb.den, ref->sample_rate,
+                 av_get_sample_fmt_name(ref->format), layout);
+    }
+    ret = avfilter_graph_create_filter(&src,
+                                       avfilter_get_by_name(video ? "buffer" : "abuffer"),
+                                       "in", args, NULL, graph);
+    if (ret < 0)
+        goto fail;
+    ret = avfilter_graph_create_filter(&sink,
+                                       avfilter_get_by_name(video ? "buffersink" : "abuffersink"),
+                                       "out", NULL, NULL, graph);
+    if (ret < 0)
+        goto fail;
+
+    outputs = avfilter_inout_alloc();
+    inputs  = avfilter_inout_alloc();
+    if (!outputs || !inputs) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    outputs->name       = av_strdup("in");
+    outputs->filter_ctx = src;
+    inputs->name        = av_strdup("out");
+    inputs->filter_ctx  = sink;
+    if (!outputs->name || !inputs->name) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = avfilter_graph_parse_ptr(graph, desc, &inputs, &outputs, NULL)) < 0 ||
+        (ret = avfilter_graph_config(graph, NULL)) < 0) {
+        fprintf(stderr, "Could not configure the filtergraph '%s': %s\n",
+                desc, av_err2str(ret));
+        goto fail;
+    }
+    if (frame_size)
+        av_buffersink_set_frame_size(sink, frame_size);
+
+    *pgraph = graph;
+    *psrc   = src;
+    *psink  = sink;
+fail:
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    if (ret < 0)
+        avfilter_graph_free(&graph);
+    return ret;
+}
+
+/* Send the frames through the graph, calling got_frame() for each output
+ * frame. */
+static int filter_all(AVFilterContext *src, AVFilterContext *sink,
+                      AVFrame **in, int nb_in, int flags,
+                      int (*got_frame)(AVFrame *frame))
+{
+    AVFrame *frame = av_frame_alloc();
+    int i, ret = 0;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i <= nb_in; i++) {
+        ret = av_buffersrc_add_frame_flags(src, i < nb_in ? in[i] : NULL, flags);
+        if (ret < 0)
+            break;
+        while ((ret = av_buffersink_get_frame(sink, frame)) >= 0) {
+            ret = got_frame(frame);
+            av_frame_unref(frame);
+            if (ret < 0)
+                goto end;
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            break;
+        ret = 0;
+    }
+end:
+    av_frame_free(&frame);
+    return ret;
+}
+
+static int filter_got_frame(AVFrame *frame)
+{
+    return tick(-1);
+}
+
+/* Replace the preloaded frames with their output through a filtergraph. */
+static int convert_frames(const char *desc, int frame_size)
+{
+    AVFilterGraph *graph;
+    AVFilterContext *src, *sink;
+    AVFrame **in = frames;
+    int i, nb_in = nb_frames, ret;
+
+    if ((ret = init_graph(&graph, &src, &sink, desc, 0, frame_size)) < 0)
+        return ret;
+    frames    = NULL;
+    nb_frames = 0;
+    ret = filter_all(src, sink, in, nb_in, 0, store_frame);
+
+    for (i = 0; i < nb_in; i++)
+        av_frame_free(&in[i]);
+    av_free(in);
+    avfilter_graph_free(&graph);
+    if (ret >= 0 && !nb_frames)
+        ret = AVERROR(EINVAL);
+    if (ret < 0) {
+        fprintf(stderr, "Could not convert the frames: %s\n", av_err2str(ret));
+        return ret;
+    }
+    renumber_frames();
+    return 0;
+}
+
+static int preload_frames(void)
+{
+    AVCodecContext *dec;
+    int ret;
+
+    if ((ret = open_decoder(&dec, 0)) < 0)
+        return ret;
+    ret = decode_all(dec, preload_got_frame);
+    avcodec_free_context(&dec);
+    if (ret < 0)
+        return ret;
+    if (!nb_frames) {
+        fprintf(stderr, "No frames decoded\n");
+        return AVERROR_INVALIDDATA;
+    }
+    renumber_frames();
+    return 0;
+}
+
+/* Build the filter converting the frames to a format supported by the
+ * encoder. */
+static void encoder_format_filter(char *buf, int size, const AVCodec *codec)
+{
+    const AVFrame *ref = frames[0];
+    int i;
+
+    if (media_type == AVMEDIA_TYPE_VIDEO) {
+        enum AVPixelFormat fmt = ref->format;
+        if (codec->pix_fmts)
+            fmt = avcodec_find_best_pix_fmt_of_list(codec->pix_fmts, fmt, 0, NULL);
+        snprintf(buf, size, "format=pix_fmts=%s", av_get_pix_fmt_name(fmt));
+    } else {
+        enum AVSampleFormat fmt = ref->format;
+        int rate = ref->sample_rate;
+        uint64_t layout = ref->channel_layout;
+
+        if (!layout)
+            layout = av_get_default_channel_layout(av_frame_get_channels(ref));
+        if (codec->sample_fmts) {
+            for (i = 0; codec->sample_fmts[i] != AV_SAMPLE_FMT_NONE; i++)
+                if (codec->sample_fmts[i] == fmt)
+                    break;
+            if (codec->sample_fmts[i] == AV_SAMPLE_FMT_NONE)
+                fmt = codec->sample_fmts[0];
+        }
+        if (codec->supported_samplerates) {
+            for (i = 0; codec->supported_samplerates[i]; i++)
+                if (codec->supported_samplerates[i] == rate)
+                    break;
+            if (!codec->supported_samplerates[i])
+                rate = codec->supported_samplerates[0];
+        }
+        if (codec->channel_layouts) {
+            for (i = 0; codec->channel_layouts[i]; i++)
+                if (codec->channel_layouts[i] == layout)
+                    break;
+            if (!codec->channel_layouts[i])
+                layout = codec->channel_layouts[0];
+        }
+        snprintf(buf, size, "aformat=sample_fmts=%s:sample_rates=%d:channel_layouts=0x%"PRIx64,
+                 av_get_sample_fmt_name(fmt), rate, layout);
+    }
+}
+
+static int open_encoder(AVCodecContext **penc, AVCodec *codec)
+{
+    const AVFrame *ref = frames[0];
+    AVCodecContext *enc;
+    int ret;
+
+    if (!(enc = avcodec_alloc_context3(codec)))
+        return AVERROR(ENOMEM);
+
+    if (media_type == AVMEDIA_TYPE_VIDEO) {
+        enc->width               = ref->width;
+        enc->height              = ref->height;
+        enc->pix_fmt             = ref->format;
+        enc->sample_aspect_ratio = ref->sample_aspect_ratio;
+        enc->framerate           = frame_rate;
+    } else {
+        enc->sample_fmt          = ref->format;
+        enc->sample_rate         = ref->sample_rate;
+        enc->channel_layout      = ref->channel_layout;
+        enc->channels            = av_frame_get_channels(ref);
+    }
+    enc->time_base    = frames_time_base();
+    enc->thread_count = threads;
+    enc->thread_type  = thread_type;
+
+    if ((ret = open_codec(enc, codec, 1)) < 0) {
+        avcodec_free_context(&enc);
+        return ret;
+    }
+    *penc = enc;
+    return 0;
+}
+
+static int encode_all(AVCodecContext *enc)
+{
+    AVPacket pkt;
+    int i, ret;
+
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+
+    for (i = 0; i <= nb_frames; i++) {
+        send_time[i] = av_gettime_relative();
+        ret = avcodec_send_frame(enc, i < nb_frames ? frames[i] : NULL);
+        if (ret < 0) {
+            fprintf(stderr, "Error encoding frame %d: %s\n", i, av_err2str(ret));
+            return ret;
+        }
+        while ((ret = avcodec_receive_packet(enc, &pkt)) >= 0) {
+            int64_t sent = -1;
+            /* the video frames are numbered, the audio ones are not */
+            if (media_type == AVMEDIA_TYPE_VIDEO &&
+                pkt.pts >= 0 && pkt.pts < nb_frames)
+                sent = send_time[pkt.pts];
+            ret = tick(sent);
+            av_packet_unref(&pkt);
+            if (ret < 0)
+                return ret;
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            return ret;
+    }
+    return 0;
+}
+
+/* Open an encoder once to check the parameters, and group the audio
+ * samples in frames of the size it needs. */
+static int prepare_encoder(AVCodec **pcodec)
+{
+    AVCodecContext *enc;
+    AVCodec *codec;
+    char desc[256];
+    int frame_size, ret;
+
+    if (!codec_name) {
+        fprintf(stderr, "The encoder must be set with -c\n");
+        return AVERROR(EINVAL);
+    }
+    codec = avcodec_find_encoder_by_name(codec_name);
+    if (!codec || codec->type != media_type) {
+        fprintf(stderr, "%s encoder %s not found\n",
+                av_get_media_type_string(media_type), codec_name);
+        return AVERROR_ENCODER_NOT_FOUND;
+    }
+
+    encoder_format_filter(desc, sizeof(desc), codec);
+    if ((ret = convert_frames(desc, 0)) < 0 ||
+        (ret = open_encoder(&enc, codec)) < 0)
+        return ret;
+    frame_size = enc->frame_size;
+    avcodec_free_context(&enc);
+
+    if (media_type == AVMEDIA_TYPE_AUDIO && frame_size &&
+        !(codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE) &&
+        (ret = convert_frames("anull", frame_size)) < 0)
+        return ret;
+
+    *pcodec = codec;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filename, *graph_desc = NULL;
+    AVCodec *encoder = NULL;
+    int64_t elapsed, total = 0, best = INT64_MAX;
+    int opt, i, run, ret;
+
+    while ((opt = getopt(argc, argv, "n:c:o:j:t:C:aF:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            runs = atoi(optarg);
+            if (runs <= 0)
+                usage(1);
+            break;
+        case 'c':
+            codec_name = optarg;
+            break;
+        case 'o':
+            if (av_dict_parse_string(&codec_opts, optarg, "=", ":", 0) < 0) {
+                fprintf(stderr, "Invalid codec options '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 't':
+            thread_type = (strstr(optarg, "frame") ? FF_THREAD_FRAME : 0) |
+                          (strstr(optarg, "slice") ? FF_THREAD_SLICE : 0);
+            if (!thread_type)
+                usage(1);
+            break;
+        case 'C': {
+            unsigned flags = av_get_cpu_flags();
+            if (av_parse_cpu_caps(&flags, optarg) < 0) {
+                fprintf(stderr, "Invalid CPU flags '%s'\n", optarg);
+                return 1;
+            }
+            av_force_cpu_flags(flags);
+            break;
+        }
+        case 'a':
+            media_type = AVMEDIA_TYPE_AUDIO;
+            break;
+        case 'F':
+            max_frames = atoi(optarg);
+            if (max_frames <= 0)
+                usage(1);
+            break;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc < 2)
+        usage(1);
+    if (!strcmp(argv[0], "decode")) {
+        mode = MODE_DECODE;
+    } else if (!strcmp(argv[0], "encode")) {
+        mode = MODE_ENCODE;
+    } else if (!strcmp(argv[0], "filter") && argc >= 3) {
+        mode = MODE_FILTER;
+        graph_desc = argv[2];
+    } else {
+        usage(1);
+    }
+    filename = argv[1];
+    if (mode != MODE_DECODE && max_frames < 0)
+        max_frames = 100;
+
+    av_register_all();
+    avfilter_register_all();
+
+    if ((ret = load_packets(filename)) < 0 ||
+        (ret = av_reallocp_array(&send_time, nb_packets + 1,
+                                 sizeof(*send_time))) < 0 ||
+        (mode != MODE_DECODE && (ret = preload_frames()) < 0) ||
+        (mode == MODE_ENCODE && (ret = prepare_encoder(&encoder)) < 0) ||
+        (ret = av_reallocp_array(&send_time, FFMAX(nb_packets, nb_frames) + 1,
+                                 sizeof(*send_time))) < 0)
+        goto end;
+
+    if (mode == MODE_DECODE)
+        printf("decode: %d packets", nb_packets);
+    else
+        printf("%s: %d frames", mode == MODE_ENCODE ? "encode" : "filter",
+               nb_frames);
+    printf(", %d threads (%s%s%s)\n", threads,
+           thread_type & FF_THREAD_FRAME ? "frame" : "",
+           thread_type == (FF_THREAD_FRAME | FF_THREAD_SLICE) ? "+" : "",
+           thread_type & FF_THREAD_SLICE ? "slice" : "");
+
+    for (run = 0; run < runs; run++) {
+        AVCodecContext *avctx = NULL;
+        AVFilterGraph *graph  = NULL;
+        AVFilterContext *src, *sink;
+        int64_t start;
+
+        switch (mode) {
+        case MODE_DECODE: ret = open_decoder(&avctx, 1);         break;
+        case MODE_ENCODE: ret = open_encoder(&avctx, encoder);   break;
+        case MODE_FILTER: ret = init_graph(&graph, &src, &sink, graph_desc,
+                                           threads, 0);          break;
+        }
+        if (ret < 0)
+            goto end;
+
+        nb_out = 0;
+        start  = last_time = av_gettime_relative();
+        switch (mode) {
+        case MODE_DECODE: ret = decode_all(avctx, bench_got_frame); break;
+        case MODE_ENCODE: ret = encode_all(avctx);                  break;
+        case MODE_FILTER: ret = filter_all(src, sink, frames, nb_frames,
+                                           AV_BUFFERSRC_FLAG_KEEP_REF,
+                                           filter_got_frame);       break;
+        }
+        elapsed = FFMAX(av_gettime_relative() - start, 1);
+
+        avcodec_free_context(&avctx);
+        avfilter_graph_free(&graph);
+        if (ret < 0) {
+            fprintf(stderr, "Run %d failed: %s\n", run + 1, av_err2str(ret));
+            goto end;
+        }
+
+        printf("run %d: %d %s in %.3fs, %.2f fps\n", run + 1, nb_out,
+               mode == MODE_ENCODE ? "packets" : "frames", elapsed / 1000000.0,
+               (mode == MODE_ENCODE ? nb_frames : nb_out) * 1000000.0 / elapsed);
+        total += elapsed;
+        best   = FFMIN(best, elapsed);
+    }
+
+    i = mode == MODE_ENCODE ? nb_frames : nb_out;
+    printf("\nbest %.2f fps, average %.2f fps\n",
+           i * 1000000.0 / best, i * 1000000.0 * runs / total);
+    print_histogram("frame interval", &intervals);
+    print_histogram("frame latency", &latencies);
+    ret = 0;
+
+end:
+    for (i = 0; i < nb_packets; i++)
+        av_packet_unref(&packets[i]);
+    av_free(packets);
+    for (i = 0; i < nb_frames; i++)
+        av_frame_free(&frames[i]);
+    av_free(frames);
+    av_free(send_time);
+    av_free(intervals.val);
+    av_free(latencies.val);
+    av_dict_free(&codec_opts);
+    avformat_close_input(&ifmt);
+    return ret < 0;
+}